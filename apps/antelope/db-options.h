@@ -69,6 +69,16 @@
 #define DB_FEATURE_INTEGRITY		0
 #endif /* DB_FEATURE_INTEGRITY */
 
+/* Support batched tuple insertions through a RAM buffer. */
+#ifndef DB_FEATURE_BATCH
+#define DB_FEATURE_BATCH		0
+#endif /* DB_FEATURE_BATCH */
+
+/* Store tuples in compressed blocks of attribute values. */
+#ifndef DB_FEATURE_COLUMNAR
+#define DB_FEATURE_COLUMNAR		0
+#endif /* DB_FEATURE_COLUMNAR */
+
 /*----------------------------------------------------------------------------*/
 
 /* Configuration parameters that may be trimmed to save space. */
@@ -146,6 +156,22 @@
 #define DB_COFFEE_RESERVE_SIZE          (128 * 1024UL)
 #endif /* DB_COFFEE_RESERVE_SIZE */
 
+/* The size of the buffer holding the tuples of an insertion batch.
+   Preferably a multiple of the flash page size. */
+#ifndef DB_BATCH_BUFFER_SIZE
+#define DB_BATCH_BUFFER_SIZE		256
+#endif /* DB_BATCH_BUFFER_SIZE */
+
+/* The largest size of a compressed block, and the largest number
+   of tuples in it, when DB_FEATURE_COLUMNAR is enabled. */
+#ifndef DB_COLUMNAR_BLOCK_SIZE
+#define DB_COLUMNAR_BLOCK_SIZE		512
+#endif /* DB_COLUMNAR_BLOCK_SIZE */
+
+#ifndef DB_COLUMNAR_BLOCK_ROWS
+#define DB_COLUMNAR_BLOCK_ROWS		128
+#endif /* DB_COLUMNAR_BLOCK_ROWS */
+
 /* The maximum size of the physical storage of a tuple (labelled a "row" 
    in Antelope's terminology. */
 #ifndef DB_MAX_CHAR_SIZE_PER_ROW
@@ -82,10 +82,10 @@ typedef struct derivation derivation_t;
 
 /* Registered variables for a LVM expression. Their values may be 
    changed between executions of the expression. */
-static variable_t variables[LVM_MAX_VARIABLE_ID - 1];
+static variable_t variables[LVM_MAX_VARIABLE_ID];
 
 /* Range derivations of variables that are used for index searches. */
-static derivation_t derivations[LVM_MAX_VARIABLE_ID - 1];
+static derivation_t derivations[LVM_MAX_VARIABLE_ID];
 
 #if DEBUG
 static void
@@ -218,6 +218,32 @@ eval_expr(lvm_instance_t *p, operator_t op, operand_t *result)
   return TRUE;
 }
 
+static lvm_status_t
+skip_node(lvm_instance_t *p)
+{
+  operator_t *operator;
+  unsigned arguments;
+  unsigned i;
+
+  switch(get_type(p)) {
+  case LVM_OPERAND:
+    p->ip += sizeof(operand_t);
+    return TRUE;
+  case LVM_ARITH_OP:
+  case LVM_CMP_OP:
+    operator = get_operator(p);
+    arguments = *operator == LVM_NOT ? 1 : 2;
+    for(i = 0; i < arguments; i++) {
+      if(LVM_ERROR(skip_node(p))) {
+        return SEMANTIC_ERROR;
+      }
+    }
+    return TRUE;
+  default:
+    return SEMANTIC_ERROR;
+  }
+}
+
 static int
 eval_logic(lvm_instance_t *p, operator_t *op)
 {
@@ -243,6 +269,15 @@ eval_logic(lvm_instance_t *p, operator_t *op)
       if(LVM_ERROR(logic_result[i])) {
 	return logic_result[i];
       }
+
+      /* Skip the second operand if the first one decides the result. */
+      if(i == 0 && arguments == 2 &&
+         (logic_result[0] == TRUE) == (*op == LVM_OR)) {
+        if(LVM_ERROR(skip_node(p))) {
+          return SEMANTIC_ERROR;
+        }
+        return logic_result[0];
+      }
     }
 
     if(*op == LVM_NOT) {
@@ -596,6 +631,8 @@ derive_relation(lvm_instance_t *p, derivation_t *local_derivations)
   if(IS_CONNECTIVE(*operator)) {
     derivation_t d1[LVM_MAX_VARIABLE_ID];
     derivation_t d2[LVM_MAX_VARIABLE_ID];
+    lvm_ip_t start;
+    int underived = 0;
 
     if(*operator != LVM_AND && *operator != LVM_OR) {
       return DERIVATION_ERROR;
@@ -606,9 +643,31 @@ derive_relation(lvm_instance_t *p, derivation_t *local_derivations)
     memset(d1, 0, sizeof(d1));
     memset(d2, 0, sizeof(d2));
 
-    if(LVM_ERROR(derive_relation(p, d1)) ||
-       LVM_ERROR(derive_relation(p, d2))) {
-      return DERIVATION_ERROR;
+    start = p->ip;
+    if(LVM_ERROR(derive_relation(p, d1))) {
+      /* A conjunct from which no range can be derived does not
+         constrain the result. */
+      if(*operator != LVM_AND) {
+        return DERIVATION_ERROR;
+      }
+      memset(d1, 0, sizeof(d1));
+      p->ip = start;
+      if(LVM_ERROR(skip_node(p))) {
+        return DERIVATION_ERROR;
+      }
+      underived++;
+    }
+
+    start = p->ip;
+    if(LVM_ERROR(derive_relation(p, d2))) {
+      if(*operator != LVM_AND || underived > 0) {
+        return DERIVATION_ERROR;
+      }
+      memset(d2, 0, sizeof(d2));
+      p->ip = start;
+      if(LVM_ERROR(skip_node(p))) {
+        return DERIVATION_ERROR;
+      }
     }
 
     if(*operator == LVM_AND) {
@@ -634,6 +693,10 @@ derive_relation(lvm_instance_t *p, derivation_t *local_derivations)
     return DERIVATION_ERROR;
   }
 
+  if(operand[0].type != LVM_VARIABLE && operand[1].type != LVM_VARIABLE) {
+    return DERIVATION_ERROR;
+  }
+
   /* Determine which of the operands that is the variable. */
   if(operand[0].type == LVM_VARIABLE) {
     if(operand[1].type == LVM_VARIABLE) {
@@ -683,6 +746,284 @@ derive_relation(lvm_instance_t *p, derivation_t *local_derivations)
   return TRUE;
 }
 
+/*
+ * The compiler rewrites the code of an instance before it is executed
+ * for each tuple. Subexpressions without variables are folded into
+ * constants, connectives with a constant operand are reduced, and the
+ * operands of a connective are ordered so that the one more likely to
+ * decide the result is evaluated first.
+ */
+
+/* Estimated likelihood that a condition holds, from 1 (seldom) to 3. */
+#define RANK_EQ		1
+#define RANK_RANGE	2
+#define RANK_NEQ	3
+
+struct compile_state {
+  lvm_instance_t *p;
+  unsigned char *src;
+  lvm_ip_t ip;
+  lvm_ip_t size;
+};
+
+struct node_info {
+  lvm_ip_t start;
+  long value;
+  uint8_t constant;
+  uint8_t rank;
+};
+
+static int
+read_code(struct compile_state *s, void *dst, size_t size)
+{
+  if(s->ip + size > s->size) {
+    return 0;
+  }
+  memcpy(dst, s->src + s->ip, size);
+  s->ip += size;
+  return 1;
+}
+
+static lvm_status_t
+compile_expr(struct compile_state *s, struct node_info *info)
+{
+  node_type_t type;
+  operator_t op;
+  operand_t operand;
+  struct node_info c[2];
+  int i;
+
+  info->start = s->p->end;
+  info->value = 0;
+  info->constant = 0;
+
+  if(!read_code(s, &type, sizeof(type))) {
+    return SEMANTIC_ERROR;
+  }
+
+  switch(type) {
+  case LVM_OPERAND:
+    if(!read_code(s, &operand, sizeof(operand))) {
+      return SEMANTIC_ERROR;
+    }
+    lvm_set_operand(s->p, &operand);
+    if(operand.type != LVM_VARIABLE) {
+      info->constant = 1;
+      info->value = operand_to_long(&operand);
+    }
+    return TRUE;
+  case LVM_ARITH_OP:
+    if(!read_code(s, &op, sizeof(op))) {
+      return SEMANTIC_ERROR;
+    }
+    lvm_set_op(s->p, op);
+    for(i = 0; i < 2; i++) {
+      if(LVM_ERROR(compile_expr(s, &c[i]))) {
+        return SEMANTIC_ERROR;
+      }
+    }
+    if(!c[0].constant || !c[1].constant) {
+      return TRUE;
+    }
+    switch(op) {
+    case LVM_ADD:
+      info->value = c[0].value + c[1].value;
+      break;
+    case LVM_SUB:
+      info->value = c[0].value - c[1].value;
+      break;
+    case LVM_MUL:
+      info->value = c[0].value * c[1].value;
+      break;
+    case LVM_DIV:
+      if(c[1].value == 0) {
+        /* Leave the error to be reported at execution time. */
+        return TRUE;
+      }
+      info->value = c[0].value / c[1].value;
+      break;
+    default:
+      return SEMANTIC_ERROR;
+    }
+    s->p->end = info->start;
+    lvm_set_long(s->p, info->value);
+    info->constant = 1;
+    return TRUE;
+  default:
+    return SEMANTIC_ERROR;
+  }
+}
+
+static void
+reverse(unsigned char *start, unsigned char *end)
+{
+  unsigned char tmp;
+
+  while(start < --end) {
+    tmp = *start;
+    *start++ = *end;
+    *end = tmp;
+  }
+}
+
+static lvm_status_t
+compile_logic(struct compile_state *s, struct node_info *info)
+{
+  lvm_instance_t *p;
+  node_type_t type;
+  operator_t op;
+  struct node_info c[2];
+  lvm_ip_t length[2];
+  unsigned char *code;
+  int i;
+  int swap;
+
+  p = s->p;
+  info->start = p->end;
+  info->value = 0;
+  info->constant = 0;
+
+  if(!read_code(s, &type, sizeof(type)) || type != LVM_CMP_OP ||
+     !read_code(s, &op, sizeof(op))) {
+    return SEMANTIC_ERROR;
+  }
+  lvm_set_relation(p, op);
+
+  if(op == LVM_NOT) {
+    if(LVM_ERROR(compile_logic(s, &c[0]))) {
+      return SEMANTIC_ERROR;
+    }
+    info->constant = c[0].constant;
+    info->value = !c[0].value;
+    info->rank = RANK_EQ + RANK_NEQ - c[0].rank;
+  } else if(IS_CONNECTIVE(op)) {
+    for(i = 0; i < 2; i++) {
+      if(LVM_ERROR(compile_logic(s, &c[i]))) {
+        return SEMANTIC_ERROR;
+      }
+    }
+
+    for(i = 0; i < 2 && !c[i].constant; i++);
+    if(i < 2 && (op == LVM_OR) == (c[i].value != 0)) {
+      /* The constant operand decides the result. */
+      info->constant = 1;
+      info->value = c[i].value;
+    } else if(i < 2) {
+      /* The constant operand has no effect; keep the other one. */
+      code = p->code + c[1 - i].start;
+      length[0] = (i == 0 ? p->end : c[1].start) - c[1 - i].start;
+      memmove(p->code + info->start, code, length[0]);
+      p->end = info->start + length[0];
+      c[1 - i].start = info->start;
+      *info = c[1 - i];
+      return TRUE;
+    } else {
+      length[0] = c[1].start - c[0].start;
+      length[1] = p->end - c[1].start;
+      if(op == LVM_AND) {
+        info->rank = c[0].rank < c[1].rank ? c[0].rank : c[1].rank;
+        swap = c[1].rank < c[0].rank;
+      } else {
+        info->rank = c[0].rank > c[1].rank ? c[0].rank : c[1].rank;
+        swap = c[1].rank > c[0].rank;
+      }
+      if(c[0].rank == c[1].rank) {
+        /* Evaluate the cheaper operand first. */
+        swap = length[1] < length[0];
+      }
+      if(swap) {
+        /* Exchange the operands by rotating their code. */
+        code = p->code + c[0].start;
+        reverse(code, code + length[0]);
+        reverse(code + length[0], code + length[0] + length[1]);
+        reverse(code, code + length[0] + length[1]);
+      }
+    }
+  } else {
+    for(i = 0; i < 2; i++) {
+      if(LVM_ERROR(compile_expr(s, &c[i]))) {
+        return SEMANTIC_ERROR;
+      }
+    }
+
+    switch(op) {
+    case LVM_EQ:
+      info->value = c[0].value == c[1].value;
+      info->rank = RANK_EQ;
+      break;
+    case LVM_NEQ:
+      info->value = c[0].value != c[1].value;
+      info->rank = RANK_NEQ;
+      break;
+    case LVM_GE:
+      info->value = c[0].value > c[1].value;
+      info->rank = RANK_RANGE;
+      break;
+    case LVM_GEQ:
+      info->value = c[0].value >= c[1].value;
+      info->rank = RANK_RANGE;
+      break;
+    case LVM_LE:
+      info->value = c[0].value < c[1].value;
+      info->rank = RANK_RANGE;
+      break;
+    case LVM_LEQ:
+      info->value = c[0].value <= c[1].value;
+      info->rank = RANK_RANGE;
+      break;
+    default:
+      return SEMANTIC_ERROR;
+    }
+    info->constant = c[0].constant && c[1].constant;
+  }
+
+  if(info->constant) {
+    /* Replace the condition with the equivalent 0 = 0 or 0 <> 0. */
+    p->end = info->start;
+    lvm_set_relation(p, info->value ? LVM_EQ : LVM_NEQ);
+    lvm_set_long(p, 0);
+    lvm_set_long(p, 0);
+  }
+
+  return TRUE;
+}
+
+lvm_status_t
+lvm_compile(lvm_instance_t *p)
+{
+  struct compile_state s;
+  struct node_info info;
+  lvm_status_t status;
+
+  if(p->end == 0) {
+    return SEMANTIC_ERROR;
+  }
+
+  {
+    unsigned char src[p->end];
+
+    memcpy(src, p->code, p->end);
+    s.p = p;
+    s.src = src;
+    s.ip = 0;
+    s.size = p->end;
+
+    p->end = 0;
+    status = compile_logic(&s, &info);
+    if(LVM_ERROR(status) || s.ip != s.size) {
+      /* Keep the original code. */
+      memcpy(p->code, src, s.size);
+      p->end = s.size;
+      return SEMANTIC_ERROR;
+    }
+  }
+
+  PRINTF("Compiled %u bytes of code into %u bytes\n",
+         (unsigned)s.size, (unsigned)p->end);
+
+  return TRUE;
+}
+
 lvm_status_t
 lvm_derive(lvm_instance_t *p)
 {
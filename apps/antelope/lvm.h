@@ -122,6 +122,7 @@ typedef struct operand operand_t;
 
 void lvm_reset(lvm_instance_t *p, unsigned char *code, lvm_ip_t size);
 void lvm_clone(lvm_instance_t *dst, lvm_instance_t *src);
+lvm_status_t lvm_compile(lvm_instance_t *p);
 lvm_status_t lvm_derive(lvm_instance_t *p);
 lvm_status_t lvm_get_derived_range(lvm_instance_t *p, char *name, 
                                    operand_value_t *min,
@@ -88,6 +88,22 @@ static unsigned char * const left_row = row;
 static unsigned char * const right_row = extra_row;
 static unsigned char * const join_row = result_row;
 
+#if DB_FEATURE_BATCH
+/*
+ * The batch structure buffers the tuples inserted into a relation,
+ * until the buffer is full or the batch is committed. The tuples are
+ * then written with a single storage operation, after which the
+ * indexes of the relation are updated.
+ */
+struct batch {
+  relation_t *rel;
+  unsigned length;
+  unsigned char rows[DB_BATCH_BUFFER_SIZE];
+};
+
+static struct batch batch;
+#endif /* DB_FEATURE_BATCH */
+
 LIST(relations);
 MEMB(relations_memb, relation_t, DB_RELATION_POOL_SIZE);
 MEMB(attributes_memb, attribute_t, DB_ATTRIBUTE_POOL_SIZE);
@@ -98,6 +114,9 @@ static int get_attribute_value_offset(relation_t *, attribute_t *);
 static void attribute_free(relation_t *, attribute_t *);
 static void purge_relations(void);
 static void relation_clear(relation_t *);
+#if DB_FEATURE_BATCH
+static db_result_t batch_flush(void);
+#endif /* DB_FEATURE_BATCH */
 static relation_t *relation_allocate(void);
 static void relation_free(relation_t *);
 
@@ -176,6 +195,9 @@ relation_clear(relation_t *rel)
 {
   memset(rel, 0, sizeof(*rel));
   rel->tuple_storage = -1;
+#if DB_FEATURE_COLUMNAR
+  rel->tail_storage = -1;
+#endif /* DB_FEATURE_COLUMNAR */
   rel->cardinality = INVALID_TUPLE;
   rel->dir = DB_STORAGE;
   LIST_STRUCT_INIT(rel, attributes);
@@ -266,6 +288,11 @@ relation_release(relation_t *rel)
   }
 
   if(rel->references == 0) {
+#if DB_FEATURE_BATCH
+    if(batch.rel == rel) {
+      relation_batch_commit(rel);
+    }
+#endif /* DB_FEATURE_BATCH */
     storage_unload(rel);
   }
 
@@ -467,6 +494,12 @@ relation_remove(char *name, int remove_tuples)
     return DB_BUSY_ERROR;
   }
 
+#if DB_FEATURE_BATCH
+  if(batch.rel == rel) {
+    relation_batch_abort(rel);
+  }
+#endif /* DB_FEATURE_BATCH */
+
   result = storage_drop_relation(rel, remove_tuples);
   relation_free(rel);
   return result;
@@ -487,6 +520,18 @@ relation_insert(relation_t *rel, attribute_value_t *values)
 	 rel->name, (unsigned)rel->row_length);
   ptr = record;
 
+#if DB_FEATURE_BATCH
+  if(batch.rel == rel) {
+    if(batch.length + rel->row_length > sizeof(batch.rows)) {
+      result = batch_flush();
+      if(DB_ERROR(result)) {
+        return result;
+      }
+    }
+    ptr = batch.rows + batch.length;
+  }
+#endif /* DB_FEATURE_BATCH */
+
   PRINTF("DB: Insert (");
 
   for(attr = list_head(rel->attributes); attr != NULL; attr = attr->next, value++) {
@@ -533,6 +578,12 @@ relation_insert(relation_t *rel, attribute_value_t *values)
 #endif /* DEBUG */
 
     ptr += attr->element_size;
+#if DB_FEATURE_BATCH
+    if(batch.rel == rel) {
+      /* The indexes are updated when the batch is flushed. */
+      continue;
+    }
+#endif /* DB_FEATURE_BATCH */
     if(attr->index != NULL) {
       if(DB_ERROR(index_insert(attr->index, value, rel->next_row))) {
         return DB_INDEX_ERROR;
@@ -542,11 +593,105 @@ relation_insert(relation_t *rel, attribute_value_t *values)
 
   PRINTF(")\n");
 
+#if DB_FEATURE_BATCH
+  if(batch.rel == rel) {
+    batch.length += rel->row_length;
+    return DB_OK;
+  }
+#endif /* DB_FEATURE_BATCH */
+
   rel->cardinality++;
   rel->next_row++;
   return storage_put_row(rel, record);
 }
 
+#if DB_FEATURE_BATCH
+static db_result_t
+batch_flush(void)
+{
+  relation_t *rel;
+  attribute_t *attr;
+  attribute_value_t value;
+  unsigned char *ptr;
+  db_result_t result;
+
+  rel = batch.rel;
+  if(batch.length == 0) {
+    return DB_OK;
+  }
+
+  result = storage_put_rows(rel, batch.rows, batch.length / rel->row_length);
+  if(DB_ERROR(result)) {
+    return result;
+  }
+
+  /* Update the indexes with one tuple at a time, in the order in which
+     the tuples were stored. */
+  for(ptr = batch.rows; ptr < batch.rows + batch.length;
+      ptr += rel->row_length) {
+    for(attr = list_head(rel->attributes); attr != NULL; attr = attr->next) {
+      if(attr->index == NULL) {
+        continue;
+      }
+      if(DB_ERROR(relation_get_value(rel, attr, ptr, &value)) ||
+         DB_ERROR(index_insert(attr->index, &value, rel->next_row))) {
+        batch.length = 0;
+        return DB_INDEX_ERROR;
+      }
+    }
+    if(rel->cardinality != INVALID_TUPLE) {
+      rel->cardinality++;
+    }
+    rel->next_row++;
+  }
+
+  PRINTF("DB: Flushed %u tuples to relation %s\n",
+         batch.length / rel->row_length, rel->name);
+
+  batch.length = 0;
+  return DB_OK;
+}
+
+db_result_t
+relation_batch_begin(relation_t *rel)
+{
+  if(batch.rel != NULL) {
+    return DB_BUSY_ERROR;
+  }
+
+  if(rel->row_length > sizeof(batch.rows)) {
+    return DB_LIMIT_ERROR;
+  }
+
+  batch.rel = rel;
+  batch.length = 0;
+  return DB_OK;
+}
+
+db_result_t
+relation_batch_commit(relation_t *rel)
+{
+  db_result_t result;
+
+  if(batch.rel != rel) {
+    return DB_ARGUMENT_ERROR;
+  }
+
+  result = batch_flush();
+  batch.rel = NULL;
+  return result;
+}
+
+void
+relation_batch_abort(relation_t *rel)
+{
+  if(batch.rel == rel) {
+    batch.rel = NULL;
+    batch.length = 0;
+  }
+}
+#endif /* DB_FEATURE_BATCH */
+
 static void
 aggregate(attribute_t *attr, attribute_value_t *value)
 {
@@ -630,16 +775,17 @@ generate_attribute_map(struct source_dest_map *attr_map, unsigned attribute_coun
 static void
 select_index(db_handle_t *handle, lvm_instance_t *lvm_instance)
 {
-  index_t *index;
   attribute_t *attr;
   operand_value_t min;
   operand_value_t max;
   attribute_value_t av_min;
   attribute_value_t av_max;
-  long range;
+  index_iterator_t iterator;
+  unsigned long range;
   unsigned long min_range;
 
-  index = NULL;
+  /* An attribute whose range spans the whole domain is not restricted
+     by the condition, so searching its index would not save anything. */
   min_range = ULONG_MAX;
 
   /* Find all indexed and derived attributes, and select the index of 
@@ -647,30 +793,86 @@ select_index(db_handle_t *handle, lvm_instance_t *lvm_instance)
   for(attr = list_head(handle->rel->attributes);
       attr != NULL;
       attr = attr->next) {
-    if(attr->index != NULL &&
-       !LVM_ERROR(lvm_get_derived_range(lvm_instance, attr->name, &min, &max))) {
-      range = (unsigned long)max.l - (unsigned long)min.l;
-      PRINTF("DB: The search range for attribute \"%s\" comprises %ld values\n",
-             attr->name, range + 1);
-
-      if(range <= min_range) {
-        index = attr->index;
-        av_min.domain = av_max.domain = DOMAIN_INT;
-        VALUE_LONG(&av_min) = min.l;
-        VALUE_LONG(&av_max) = max.l;
-      }
+    if(attr->index == NULL ||
+       LVM_ERROR(lvm_get_derived_range(lvm_instance, attr->name, &min, &max))) {
+      continue;
+    }
+
+    range = (unsigned long)max.l - (unsigned long)min.l;
+    PRINTF("DB: The search range for attribute \"%s\" comprises %lu values\n",
+           attr->name, range + 1);
+    if(range >= min_range) {
+      continue;
     }
-  }
 
-  if(index != NULL) {
-    /* We found a suitable index; get an iterator for it. */
-    if(index_get_iterator(&handle->index_iterator, index, 
-                          &av_min, &av_max) == DB_OK) {
+    /* Indexes without range queries, such as the hash index, can only
+       look up a single value. */
+    if(range > 0 &&
+       !(((index_t *)attr->index)->api->flags & INDEX_API_RANGE_QUERIES)) {
+      continue;
+    }
+
+    av_min.domain = av_max.domain = DOMAIN_INT;
+    VALUE_LONG(&av_min) = min.l;
+    VALUE_LONG(&av_max) = max.l;
+    if(index_get_iterator(&iterator, attr->index, &av_min, &av_max) == DB_OK) {
+      handle->index_iterator = iterator;
       handle->flags |= DB_HANDLE_FLAG_SEARCH_INDEX;
+      min_range = range;
     }
   }
 }
 
+#if DB_FEATURE_COLUMNAR
+/* The tuples before this one have been checked against the block
+   summaries of the relation. */
+static tuple_id_t summary_end;
+
+static void
+skip_blocks(db_handle_t *handle, lvm_instance_t *lvm_instance)
+{
+  attribute_t *attr;
+  operand_value_t min;
+  operand_value_t max;
+  long block_min;
+  long block_max;
+  tuple_id_t next;
+
+  while(handle->tuple_id >= summary_end) {
+    next = handle->tuple_id;
+    for(attr = list_head(handle->rel->attributes);
+        attr != NULL;
+        attr = attr->next) {
+      if(LVM_ERROR(lvm_get_derived_range(lvm_instance, attr->name, &min, &max))) {
+        continue;
+      }
+      next = storage_get_summary(handle->rel, handle->tuple_id, attr,
+                                 &block_min, &block_max);
+      if(next == handle->tuple_id) {
+        /* The remaining tuples are not in blocks. */
+        summary_end = INVALID_TUPLE;
+        return;
+      }
+      if(block_max < min.l || block_min > max.l) {
+        break;
+      }
+    }
+
+    if(next == handle->tuple_id) {
+      /* No attribute has a derived range. */
+      summary_end = INVALID_TUPLE;
+    } else if(attr == NULL) {
+      /* The block may hold matching tuples. */
+      summary_end = next;
+    } else {
+      PRINTF("DB: Skipping the tuples %lu to %lu\n",
+             (unsigned long)handle->tuple_id, (unsigned long)next - 1);
+      handle->tuple_id = next;
+    }
+  }
+}
+#endif /* DB_FEATURE_COLUMNAR */
+
 static db_result_t
 generate_selection_result(db_handle_t *handle, relation_t *rel, aql_adt_t *adt)
 {
@@ -697,9 +899,21 @@ generate_selection_result(db_handle_t *handle, relation_t *rel, aql_adt_t *adt)
   }
 
   if(adt->lvm_instance != NULL) {
+    /* Simplify the condition before it is evaluated for each tuple. */
+    lvm_compile(adt->lvm_instance);
+
     /* Try to establish acceptable ranges for the attribute values. */
     if(!LVM_ERROR(lvm_derive(adt->lvm_instance))) {
       select_index(handle, adt->lvm_instance);
+#if DB_FEATURE_COLUMNAR
+      /* Blocks whose values are outside the derived ranges cannot hold
+         any matching tuples, unless the logic is inverted. */
+      if(!(handle->flags & DB_HANDLE_FLAG_SEARCH_INDEX) &&
+         !(AQL_GET_FLAGS(adt) & AQL_FLAG_INVERSE_LOGIC)) {
+        handle->flags |= DB_HANDLE_FLAG_SKIP_BLOCKS;
+        summary_end = 0;
+      }
+#endif /* DB_FEATURE_COLUMNAR */
     }
   }
 
@@ -756,11 +970,9 @@ relation_process_select(void *handle_ptr)
   if(handle->flags & DB_HANDLE_FLAG_SEARCH_INDEX) {
     handle->tuple_id = index_get_next(&handle->index_iterator);
     if(handle->tuple_id == INVALID_TUPLE) {
-      PRINTF("DB: An attribute value could not be found in the index\n");
-      if(handle->index_iterator.next_item_no == 0) {
-        return DB_INDEX_ERROR;
-      }
-
+      /* No more tuples match, or none at all if this is the first
+         item, which gives an empty result. */
+      PRINTF("DB: No more attribute values in the index\n");
       if(adt->flags & AQL_FLAG_AGGREGATE) {
         goto end_aggregation;
       }
@@ -769,6 +981,12 @@ relation_process_select(void *handle_ptr)
     }
   }
 
+#if DB_FEATURE_COLUMNAR
+  if(handle->flags & DB_HANDLE_FLAG_SKIP_BLOCKS) {
+    skip_blocks(handle, adt->lvm_instance);
+  }
+#endif /* DB_FEATURE_COLUMNAR */
+
   /* Put the tuples fulfilling the given condition into a new relation.
      The tuples may be projected. */
   result = storage_get_row(handle->rel, &handle->tuple_id, row);
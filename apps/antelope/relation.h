@@ -69,6 +69,11 @@ struct relation {
   tuple_id_t cardinality;
   tuple_id_t next_row;
   db_storage_id_t tuple_storage;
+#if DB_FEATURE_COLUMNAR
+  db_storage_id_t tail_storage;
+  tuple_id_t sealed_tuples;
+  uint8_t tail_tuples;
+#endif /* DB_FEATURE_COLUMNAR */
   db_direction_t dir;
   uint8_t references;
   char name[RELATION_NAME_LENGTH + 1];
@@ -95,6 +100,11 @@ db_result_t relation_attribute_remove(relation_t *, char *);
 db_result_t relation_set_primary_key(relation_t *, char *);
 db_result_t relation_remove(char *, int);
 db_result_t relation_insert(relation_t *, attribute_value_t *);
+#if DB_FEATURE_BATCH
+db_result_t relation_batch_begin(relation_t *);
+db_result_t relation_batch_commit(relation_t *);
+void relation_batch_abort(relation_t *);
+#endif /* DB_FEATURE_BATCH */
 db_result_t relation_select(void *, relation_t *, void *);
 db_result_t relation_join(void *, void *);
 tuple_id_t relation_cardinality(relation_t *);
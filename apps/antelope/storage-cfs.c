@@ -100,6 +100,7 @@ storage_generate_file(char *prefix, unsigned long size)
 #endif /* DB_FEATURE_COFFEE */
 }
 
+#if !DB_FEATURE_COLUMNAR
 db_result_t
 storage_load(relation_t *rel)
 {
@@ -124,6 +125,7 @@ storage_unload(relation_t *rel)
     rel->tuple_storage = -1;
   }
 }
+#endif /* !DB_FEATURE_COLUMNAR */
 
 db_result_t
 storage_get_relation(relation_t *rel, char *name)
@@ -280,7 +282,11 @@ db_result_t
 storage_drop_relation(relation_t *rel, int remove_tuples)
 {
   if(remove_tuples && RELATION_HAS_TUPLES(rel)) {
+#if DB_FEATURE_COLUMNAR
+    storage_remove_tuples(rel);
+#else
     cfs_remove(rel->tuple_filename);
+#endif /* DB_FEATURE_COLUMNAR */
   }
   return cfs_remove(rel->name) < 0 ? DB_STORAGE_ERROR : DB_OK;
 }
@@ -400,6 +406,7 @@ storage_put_index(index_t *index)
   return result;
 }
 
+#if !DB_FEATURE_COLUMNAR
 db_result_t
 storage_get_row(relation_t *rel, tuple_id_t *tuple_id, storage_row_t row)
 {
@@ -439,11 +446,18 @@ storage_get_row(relation_t *rel, tuple_id_t *tuple_id, storage_row_t row)
 
 db_result_t
 storage_put_row(relation_t *rel, storage_row_t row)
+{
+  return storage_put_rows(rel, row, 1);
+}
+
+db_result_t
+storage_put_rows(relation_t *rel, storage_row_t rows, unsigned count)
 {
   cfs_offset_t end;
   unsigned remaining;
+  unsigned i;
   int r;
-  unsigned char *last_byte;
+  unsigned char *ptr;
 #if DB_FEATURE_INTEGRITY
   int missing_bytes;
   char buf[rel->row_length];
@@ -467,24 +481,33 @@ storage_put_row(relation_t *rel, storage_row_t row)
 
   /* Ensure that last written byte is separated from 0, to make file
      lengths correct in Coffee. */
-  last_byte = row + rel->row_length - 1;
-  *last_byte ^= ROW_XOR;
+  for(i = 1; i <= count; i++) {
+    rows[i * rel->row_length - 1] ^= ROW_XOR;
+  }
 
-  remaining = rel->row_length;
+  /* Write all rows at once, so that the file system can store them in
+     as few flash writes as possible. */
+  ptr = rows;
+  remaining = count * rel->row_length;
   do {
-    r = cfs_write(rel->tuple_storage, row, remaining);
+    r = cfs_write(rel->tuple_storage, ptr, remaining);
     if(r < 0) {
       PRINTF("DB: Failed to store %u bytes\n", remaining);
-      *last_byte ^= ROW_XOR;
-      return DB_STORAGE_ERROR;
+      break;
     }
-    row += r;
+    ptr += r;
     remaining -= r;
   } while(remaining > 0);
 
-  PRINTF("DB: Stored a of %d bytes\n", rel->row_length);
+  for(i = 1; i <= count; i++) {
+    rows[i * rel->row_length - 1] ^= ROW_XOR;
+  }
+
+  if(remaining > 0) {
+    return DB_STORAGE_ERROR;
+  }
 
-  *last_byte ^= ROW_XOR;
+  PRINTF("DB: Stored %u rows of %d bytes\n", count, rel->row_length);
 
   return DB_OK;
 }
@@ -507,6 +530,7 @@ storage_get_row_amount(relation_t *rel, tuple_id_t *amount)
 
   return DB_OK;
 }
+#endif /* !DB_FEATURE_COLUMNAR */
 
 db_storage_id_t
 storage_open(const char *filename)
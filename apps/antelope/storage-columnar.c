@@ -0,0 +1,749 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \file
+ *	A column-oriented tuple storage for the database, intended for
+ *	time series. Tuples are first appended to a small tail file in
+ *	the row format. When the tail holds a block worth of tuples, the
+ *	tuples are compressed attribute by attribute into a block that is
+ *	appended to the tuple file, and the tail is started over.
+ *
+ *	Integer attributes are encoded as runs of equal deltas, which
+ *	shrinks monotonic timestamps and slowly changing sensor values
+ *	to a few bytes per block. Each block also records the smallest
+ *	and largest value of every integer attribute, so that a selection
+ *	can skip blocks that cannot match its condition.
+ */
+
+#include <limits.h>
+#include <string.h>
+
+#include "cfs/cfs.h"
+#include "cfs/cfs-coffee.h"
+
+#define DEBUG DEBUG_NONE
+#include "net/ip/uip-debug.h"
+
+#include "db-options.h"
+#include "storage.h"
+
+#if DB_FEATURE_COLUMNAR
+
+#if DB_COLUMNAR_BLOCK_ROWS > 255
+#error "DB_COLUMNAR_BLOCK_ROWS must not exceed 255"
+#endif
+
+/* Encodes the last byte of a tail tuple as in the row storage, so that
+   Coffee determines the correct file length. */
+#define ROW_XOR			0xf6U
+
+#define TAIL_NAME_SUFFIX	".t"
+/* The tail starts with the id of its first tuple and a marker. */
+#define TAIL_HEADER_SIZE	5
+
+/*
+ * A block starts with its length, its tuple count, and the id of its
+ * first tuple. A descriptor for each attribute follows, and then the
+ * attribute data. The block ends with a marker byte.
+ */
+#define BLOCK_PREFIX_SIZE	7
+#define BLOCK_COLUMN_SIZE	11
+#define BLOCK_HEADER_SIZE(rel)	(BLOCK_PREFIX_SIZE + \
+                                 (rel)->attribute_count * BLOCK_COLUMN_SIZE)
+#define BLOCK_MARKER		0xa5U
+
+/* Attribute data encodings. */
+#define COLUMN_RAW		0
+#define COLUMN_DELTA_RUNS	1
+
+/* The largest number of bytes of an encoded 32-bit integer. */
+#define VARINT_MAX_SIZE		5
+
+struct column_cursor {
+  uint16_t start;
+  uint16_t pos;
+  uint32_t value;
+  uint32_t delta;
+  uint8_t run;
+  uint8_t encoding;
+};
+
+/* The block that was accessed last. Its header is always loaded, and
+   its data is loaded when a tuple is read from it. */
+static struct {
+  relation_t *rel;
+  cfs_offset_t offset;
+  tuple_id_t first;
+  uint16_t length;
+  uint16_t loaded;
+  uint8_t rows;
+  uint8_t cursor;
+  struct column_cursor columns[DB_MAX_ATTRIBUTES_PER_RELATION];
+  unsigned char data[DB_COLUMNAR_BLOCK_SIZE];
+} block;
+
+/*---------------------------------------------------------------------------*/
+static void
+put_u16(unsigned char *ptr, uint16_t value)
+{
+  ptr[0] = value >> 8;
+  ptr[1] = value & 0xff;
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+get_u16(const unsigned char *ptr)
+{
+  return (uint16_t)ptr[0] << 8 | ptr[1];
+}
+/*---------------------------------------------------------------------------*/
+static void
+put_u32(unsigned char *ptr, uint32_t value)
+{
+  put_u16(ptr, value >> 16);
+  put_u16(ptr + 2, value & 0xffff);
+}
+/*---------------------------------------------------------------------------*/
+static uint32_t
+get_u32(const unsigned char *ptr)
+{
+  return (uint32_t)get_u16(ptr) << 16 | get_u16(ptr + 2);
+}
+/*---------------------------------------------------------------------------*/
+static unsigned
+put_varint(unsigned char *ptr, uint32_t value)
+{
+  unsigned length;
+
+  for(length = 1; value >= 0x80; length++) {
+    if(ptr != NULL) {
+      *ptr++ = (value & 0x7f) | 0x80;
+    }
+    value >>= 7;
+  }
+  if(ptr != NULL) {
+    *ptr = value;
+  }
+  return length;
+}
+/*---------------------------------------------------------------------------*/
+static int
+get_varint(uint16_t *pos, uint16_t end, uint32_t *value)
+{
+  unsigned shift;
+  unsigned char byte;
+
+  *value = 0;
+  for(shift = 0; shift < 32; shift += 7) {
+    if(*pos >= end) {
+      return 0;
+    }
+    byte = block.data[(*pos)++];
+    *value |= (uint32_t)(byte & 0x7f) << shift;
+    if(!(byte & 0x80)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static uint32_t
+zigzag(uint32_t value)
+{
+  return (value << 1) ^ ((value & 0x80000000UL) ? 0xffffffffUL : 0);
+}
+/*---------------------------------------------------------------------------*/
+static uint32_t
+unzigzag(uint32_t value)
+{
+  return (value >> 1) ^ ((value & 1) ? 0xffffffffUL : 0);
+}
+/*---------------------------------------------------------------------------*/
+static int
+is_integer(attribute_t *attr)
+{
+  return (attr->domain == DOMAIN_INT || attr->domain == DOMAIN_LONG) &&
+    attr->element_size <= sizeof(uint32_t);
+}
+/*---------------------------------------------------------------------------*/
+/* The value of an integer attribute as the logic engine sees it. */
+static long
+column_long(attribute_t *attr, uint32_t value)
+{
+  return attr->domain == DOMAIN_INT ? (long)(value & 0xffff) : (long)value;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned
+block_capacity(relation_t *rel)
+{
+  unsigned rows;
+
+  if(rel->row_length == 0 ||
+     BLOCK_HEADER_SIZE(rel) + 1 > DB_COLUMNAR_BLOCK_SIZE) {
+    return 0;
+  }
+  rows = (DB_COLUMNAR_BLOCK_SIZE - BLOCK_HEADER_SIZE(rel) - 1) /
+    rel->row_length;
+  return rows > DB_COLUMNAR_BLOCK_ROWS ? DB_COLUMNAR_BLOCK_ROWS : rows;
+}
+/*---------------------------------------------------------------------------*/
+static void
+tail_name(relation_t *rel, char *name)
+{
+  strcpy(name, rel->tuple_filename);
+  strcat(name, TAIL_NAME_SUFFIX);
+}
+/*---------------------------------------------------------------------------*/
+static db_result_t
+tail_create(relation_t *rel)
+{
+  char name[sizeof(rel->tuple_filename) + sizeof(TAIL_NAME_SUFFIX)];
+  unsigned char header[TAIL_HEADER_SIZE];
+
+  if(rel->tail_storage >= 0) {
+    cfs_close(rel->tail_storage);
+  }
+
+  tail_name(rel, name);
+  cfs_remove(name);
+#if DB_FEATURE_COFFEE
+  cfs_coffee_reserve(name, TAIL_HEADER_SIZE +
+                     block_capacity(rel) * rel->row_length);
+#endif
+  rel->tail_storage = cfs_open(name, CFS_READ | CFS_WRITE | CFS_APPEND);
+  rel->tail_tuples = 0;
+  if(rel->tail_storage < 0) {
+    return DB_STORAGE_ERROR;
+  }
+
+  put_u32(header, rel->sealed_tuples);
+  header[TAIL_HEADER_SIZE - 1] = BLOCK_MARKER;
+  if(cfs_write(rel->tail_storage, header, sizeof(header)) != sizeof(header)) {
+    return DB_STORAGE_ERROR;
+  }
+  return DB_OK;
+}
+/*---------------------------------------------------------------------------*/
+static db_result_t
+tail_read(relation_t *rel, unsigned index, unsigned offset,
+          unsigned char *buf, unsigned size)
+{
+  cfs_offset_t pos;
+
+  pos = TAIL_HEADER_SIZE + (cfs_offset_t)index * rel->row_length + offset;
+  if(cfs_seek(rel->tail_storage, pos, CFS_SEEK_SET) != pos ||
+     cfs_read(rel->tail_storage, buf, size) != size) {
+    return DB_STORAGE_ERROR;
+  }
+  if(offset + size == rel->row_length) {
+    buf[size - 1] ^= ROW_XOR;
+  }
+  return DB_OK;
+}
+/*---------------------------------------------------------------------------*/
+static db_result_t
+tail_read_value(relation_t *rel, unsigned index, unsigned offset,
+                attribute_t *attr, uint32_t *value)
+{
+  unsigned char buf[sizeof(uint32_t)];
+  unsigned i;
+
+  if(DB_ERROR(tail_read(rel, index, offset, buf, attr->element_size))) {
+    return DB_STORAGE_ERROR;
+  }
+  for(*value = 0, i = 0; i < attr->element_size; i++) {
+    *value = *value << 8 | buf[i];
+  }
+  return DB_OK;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Encodes the values of an integer attribute in the tail as runs of
+ * equal deltas, starting from zero. Only the size is computed if ptr
+ * is NULL.
+ */
+static int
+encode_runs(relation_t *rel, attribute_t *attr, unsigned offset,
+            unsigned char *ptr, uint32_t *min, uint32_t *max)
+{
+  unsigned i;
+  unsigned size;
+  unsigned run;
+  uint32_t value;
+  uint32_t previous;
+  uint32_t delta;
+  uint32_t run_delta;
+
+  size = 0;
+  run = 0;
+  run_delta = 0;
+  previous = 0;
+  for(i = 0; i < rel->tail_tuples; i++) {
+    if(DB_ERROR(tail_read_value(rel, i, offset, attr, &value))) {
+      return -1;
+    }
+    if(i == 0 || column_long(attr, value) < column_long(attr, *min)) {
+      *min = value;
+    }
+    if(i == 0 || column_long(attr, value) > column_long(attr, *max)) {
+      *max = value;
+    }
+
+    delta = value - previous;
+    previous = value;
+    if(run > 0 && delta == run_delta) {
+      run++;
+      continue;
+    }
+    if(run > 0) {
+      size += put_varint(ptr == NULL ? NULL : ptr + size, zigzag(run_delta));
+      size += put_varint(ptr == NULL ? NULL : ptr + size, run);
+    }
+    run_delta = delta;
+    run = 1;
+  }
+  if(run > 0) {
+    size += put_varint(ptr == NULL ? NULL : ptr + size, zigzag(run_delta));
+    size += put_varint(ptr == NULL ? NULL : ptr + size, run);
+  }
+
+  return size;
+}
+/*---------------------------------------------------------------------------*/
+static db_result_t
+seal_tail(relation_t *rel)
+{
+  attribute_t *attr;
+  unsigned char *descriptor;
+  unsigned offset;
+  unsigned pos;
+  unsigned i;
+  int size;
+  uint32_t min;
+  uint32_t max;
+  cfs_offset_t end;
+
+  /* The block buffer is reused for the new block. */
+  block.rel = NULL;
+
+  descriptor = block.data + BLOCK_PREFIX_SIZE;
+  pos = BLOCK_HEADER_SIZE(rel);
+  offset = 0;
+  for(attr = list_head(rel->attributes); attr != NULL; attr = attr->next) {
+    min = max = 0;
+    size = rel->tail_tuples * attr->element_size;
+    descriptor[0] = COLUMN_RAW;
+    if(is_integer(attr)) {
+      size = encode_runs(rel, attr, offset, NULL, &min, &max);
+      if(size < 0) {
+        return DB_STORAGE_ERROR;
+      }
+      if(size < rel->tail_tuples * attr->element_size) {
+        descriptor[0] = COLUMN_DELTA_RUNS;
+      } else {
+        size = rel->tail_tuples * attr->element_size;
+      }
+    }
+
+    if(descriptor[0] == COLUMN_DELTA_RUNS) {
+      encode_runs(rel, attr, offset, block.data + pos, &min, &max);
+    } else {
+      for(i = 0; i < rel->tail_tuples; i++) {
+        if(DB_ERROR(tail_read(rel, i, offset,
+                              block.data + pos + i * attr->element_size,
+                              attr->element_size))) {
+          return DB_STORAGE_ERROR;
+        }
+      }
+    }
+
+    put_u16(descriptor + 1, size);
+    put_u32(descriptor + 3, min);
+    put_u32(descriptor + 7, max);
+    descriptor += BLOCK_COLUMN_SIZE;
+    pos += size;
+    offset += attr->element_size;
+  }
+  block.data[pos++] = BLOCK_MARKER;
+
+  put_u16(block.data, pos);
+  block.data[2] = rel->tail_tuples;
+  put_u32(block.data + 3, rel->sealed_tuples);
+
+  end = cfs_seek(rel->tuple_storage, 0, CFS_SEEK_END);
+  if(end == (cfs_offset_t)-1 ||
+     cfs_write(rel->tuple_storage, block.data, pos) != pos) {
+    PRINTF("DB: Failed to store a block of %u bytes\n", pos);
+    return DB_STORAGE_ERROR;
+  }
+
+  PRINTF("DB: Sealed %u tuples of %u bytes into a block of %u bytes\n",
+         rel->tail_tuples, (unsigned)rel->row_length, pos);
+
+  rel->sealed_tuples += rel->tail_tuples;
+  return tail_create(rel);
+}
+/*---------------------------------------------------------------------------*/
+static db_result_t
+read_block(relation_t *rel, cfs_offset_t offset, uint16_t size)
+{
+  if(cfs_seek(rel->tuple_storage, offset, CFS_SEEK_SET) != offset ||
+     cfs_read(rel->tuple_storage, block.data, size) != size) {
+    return DB_STORAGE_ERROR;
+  }
+  return DB_OK;
+}
+/*---------------------------------------------------------------------------*/
+/* Loads the header of the block holding the given tuple. */
+static db_result_t
+find_block(relation_t *rel, tuple_id_t tuple_id)
+{
+  cfs_offset_t offset;
+  tuple_id_t first;
+  uint16_t length;
+  uint8_t rows;
+
+  if(block.rel == rel && tuple_id >= block.first) {
+    if(tuple_id < block.first + block.rows) {
+      return DB_OK;
+    }
+    offset = block.offset + block.length;
+    first = block.first + block.rows;
+  } else {
+    offset = 0;
+    first = 0;
+  }
+
+  block.rel = NULL;
+  for(;;) {
+    if(DB_ERROR(read_block(rel, offset, BLOCK_PREFIX_SIZE))) {
+      return DB_STORAGE_ERROR;
+    }
+    length = get_u16(block.data);
+    rows = block.data[2];
+    if(length < BLOCK_HEADER_SIZE(rel) + 1 ||
+       length > sizeof(block.data) || rows == 0) {
+      return DB_STORAGE_ERROR;
+    }
+    if(tuple_id < first + rows) {
+      break;
+    }
+    offset += length;
+    first += rows;
+  }
+
+  if(DB_ERROR(read_block(rel, offset, BLOCK_HEADER_SIZE(rel)))) {
+    return DB_STORAGE_ERROR;
+  }
+
+  block.rel = rel;
+  block.offset = offset;
+  block.first = first;
+  block.length = length;
+  block.rows = rows;
+  block.loaded = BLOCK_HEADER_SIZE(rel);
+  return DB_OK;
+}
+/*---------------------------------------------------------------------------*/
+static void
+reset_cursors(relation_t *rel)
+{
+  struct column_cursor *column;
+  unsigned char *descriptor;
+  uint16_t pos;
+  unsigned i;
+
+  descriptor = block.data + BLOCK_PREFIX_SIZE;
+  pos = BLOCK_HEADER_SIZE(rel);
+  for(i = 0; i < rel->attribute_count; i++) {
+    column = &block.columns[i];
+    column->encoding = descriptor[0];
+    column->start = column->pos = pos;
+    column->value = 0;
+    column->run = 0;
+    pos += get_u16(descriptor + 1);
+    descriptor += BLOCK_COLUMN_SIZE;
+  }
+  block.cursor = 0;
+}
+/*---------------------------------------------------------------------------*/
+static db_result_t
+decode_row(relation_t *rel, unsigned index, storage_row_t row)
+{
+  struct column_cursor *column;
+  attribute_t *attr;
+  uint32_t run;
+  unsigned i;
+  unsigned j;
+
+  if(block.loaded < block.length) {
+    if(cfs_seek(rel->tuple_storage, block.offset + block.loaded, CFS_SEEK_SET) ==
+       (cfs_offset_t)-1 ||
+       cfs_read(rel->tuple_storage, block.data + block.loaded,
+                block.length - block.loaded) != block.length - block.loaded ||
+       block.data[block.length - 1] != BLOCK_MARKER) {
+      return DB_STORAGE_ERROR;
+    }
+    block.loaded = block.length;
+    reset_cursors(rel);
+  }
+
+  if(index + 1 < block.cursor) {
+    reset_cursors(rel);
+  }
+
+  /* Advance the attributes encoded as runs to the requested tuple. */
+  for(; block.cursor <= index; block.cursor++) {
+    for(i = 0; i < rel->attribute_count; i++) {
+      column = &block.columns[i];
+      if(column->encoding != COLUMN_DELTA_RUNS) {
+        continue;
+      }
+      if(column->run == 0) {
+        if(!get_varint(&column->pos, block.length, &column->delta) ||
+           !get_varint(&column->pos, block.length, &run) || run == 0) {
+          return DB_STORAGE_ERROR;
+        }
+        column->delta = unzigzag(column->delta);
+        column->run = run;
+      }
+      column->value += column->delta;
+      column->run--;
+    }
+  }
+
+  for(attr = list_head(rel->attributes), i = 0;
+      attr != NULL;
+      attr = attr->next, i++) {
+    column = &block.columns[i];
+    if(column->encoding == COLUMN_DELTA_RUNS) {
+      for(j = attr->element_size; j > 0; j--) {
+        row[j - 1] = (column->value >> (8 * (attr->element_size - j))) & 0xff;
+      }
+    } else {
+      memcpy(row, block.data + column->start + index * attr->element_size,
+             attr->element_size);
+    }
+    row += attr->element_size;
+  }
+
+  return DB_OK;
+}
+/*---------------------------------------------------------------------------*/
+db_result_t
+storage_load(relation_t *rel)
+{
+  char name[sizeof(rel->tuple_filename) + sizeof(TAIL_NAME_SUFFIX)];
+  unsigned char header[TAIL_HEADER_SIZE];
+  cfs_offset_t offset;
+  cfs_offset_t end;
+
+  if(RELATION_HAS_TUPLES(rel)) {
+    return DB_OK;
+  }
+
+  PRINTF("DB: Opening the tuple file %s\n", rel->tuple_filename);
+  rel->tuple_storage = cfs_open(rel->tuple_filename,
+                                CFS_READ | CFS_WRITE | CFS_APPEND);
+  if(rel->tuple_storage < 0) {
+    PRINTF("DB: Failed to open the tuple file\n");
+    return DB_STORAGE_ERROR;
+  }
+
+  /* Count the tuples in the complete blocks. */
+  rel->sealed_tuples = 0;
+  for(offset = 0;; offset += get_u16(header)) {
+    if(cfs_seek(rel->tuple_storage, offset, CFS_SEEK_SET) != offset ||
+       cfs_read(rel->tuple_storage, header, 3) != 3 ||
+       get_u16(header) == 0 || header[2] == 0) {
+      break;
+    }
+    end = offset + get_u16(header) - 1;
+    if(cfs_seek(rel->tuple_storage, end, CFS_SEEK_SET) != end ||
+       cfs_read(rel->tuple_storage, &header[3], 1) != 1 ||
+       header[3] != BLOCK_MARKER) {
+      break;
+    }
+    rel->sealed_tuples += header[2];
+  }
+
+  tail_name(rel, name);
+  rel->tail_storage = cfs_open(name, CFS_READ | CFS_WRITE | CFS_APPEND);
+  if(rel->tail_storage >= 0 &&
+     cfs_seek(rel->tail_storage, 0, CFS_SEEK_SET) == 0 &&
+     cfs_read(rel->tail_storage, header, sizeof(header)) == sizeof(header) &&
+     get_u32(header) == rel->sealed_tuples) {
+    end = cfs_seek(rel->tail_storage, 0, CFS_SEEK_END);
+    rel->tail_tuples = rel->row_length == 0 ? 0 :
+      (end - TAIL_HEADER_SIZE) / rel->row_length;
+    return DB_OK;
+  }
+
+  /* The tail is missing, or it was sealed but not started over. */
+  if(DB_ERROR(tail_create(rel))) {
+    storage_unload(rel);
+    return DB_STORAGE_ERROR;
+  }
+  return DB_OK;
+}
+/*---------------------------------------------------------------------------*/
+void
+storage_unload(relation_t *rel)
+{
+  if(block.rel == rel) {
+    block.rel = NULL;
+  }
+
+  if(RELATION_HAS_TUPLES(rel)) {
+    PRINTF("DB: Unload tuple file %s\n", rel->tuple_filename);
+
+    cfs_close(rel->tuple_storage);
+    rel->tuple_storage = -1;
+    if(rel->tail_storage >= 0) {
+      cfs_close(rel->tail_storage);
+      rel->tail_storage = -1;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+storage_remove_tuples(relation_t *rel)
+{
+  char name[sizeof(rel->tuple_filename) + sizeof(TAIL_NAME_SUFFIX)];
+
+  storage_unload(rel);
+  cfs_remove(rel->tuple_filename);
+  tail_name(rel, name);
+  cfs_remove(name);
+}
+/*---------------------------------------------------------------------------*/
+db_result_t
+storage_get_row(relation_t *rel, tuple_id_t *tuple_id, storage_row_t row)
+{
+  if(*tuple_id >= rel->sealed_tuples + rel->tail_tuples) {
+    return DB_FINISHED;
+  }
+
+  if(*tuple_id >= rel->sealed_tuples) {
+    return tail_read(rel, *tuple_id - rel->sealed_tuples, 0,
+                     row, rel->row_length);
+  }
+
+  if(DB_ERROR(find_block(rel, *tuple_id)) ||
+     DB_ERROR(decode_row(rel, *tuple_id - block.first, row))) {
+    PRINTF("DB: Failed to decode tuple %lu of relation %s\n",
+           (unsigned long)*tuple_id, rel->name);
+    return DB_STORAGE_ERROR;
+  }
+
+  return DB_OK;
+}
+/*---------------------------------------------------------------------------*/
+db_result_t
+storage_put_row(relation_t *rel, storage_row_t row)
+{
+  return storage_put_rows(rel, row, 1);
+}
+/*---------------------------------------------------------------------------*/
+db_result_t
+storage_put_rows(relation_t *rel, storage_row_t rows, unsigned count)
+{
+  unsigned char *last_byte;
+  int r;
+
+  if(!RELATION_HAS_TUPLES(rel) || rel->tail_storage < 0) {
+    return DB_STORAGE_ERROR;
+  }
+
+  if(block_capacity(rel) == 0) {
+    PRINTF("DB: Tuples of %u bytes do not fit in a block\n",
+           (unsigned)rel->row_length);
+    return DB_LIMIT_ERROR;
+  }
+
+  for(; count > 0; count--, rows += rel->row_length) {
+    last_byte = rows + rel->row_length - 1;
+    *last_byte ^= ROW_XOR;
+    r = cfs_write(rel->tail_storage, rows, rel->row_length);
+    *last_byte ^= ROW_XOR;
+    if(r != rel->row_length) {
+      PRINTF("DB: Failed to store %u bytes\n", (unsigned)rel->row_length);
+      return DB_STORAGE_ERROR;
+    }
+
+    if(++rel->tail_tuples >= block_capacity(rel) &&
+       DB_ERROR(seal_tail(rel))) {
+      return DB_STORAGE_ERROR;
+    }
+  }
+
+  return DB_OK;
+}
+/*---------------------------------------------------------------------------*/
+db_result_t
+storage_get_row_amount(relation_t *rel, tuple_id_t *amount)
+{
+  *amount = rel->sealed_tuples + rel->tail_tuples;
+  return DB_OK;
+}
+/*---------------------------------------------------------------------------*/
+tuple_id_t
+storage_get_summary(relation_t *rel, tuple_id_t tuple_id, attribute_t *attr,
+                    long *min, long *max)
+{
+  attribute_t *a;
+  unsigned char *descriptor;
+
+  *min = LONG_MIN;
+  *max = LONG_MAX;
+
+  if(tuple_id >= rel->sealed_tuples ||
+     DB_ERROR(find_block(rel, tuple_id))) {
+    return tuple_id;
+  }
+
+  if(is_integer(attr)) {
+    descriptor = block.data + BLOCK_PREFIX_SIZE;
+    for(a = list_head(rel->attributes); a != NULL && a != attr; a = a->next) {
+      descriptor += BLOCK_COLUMN_SIZE;
+    }
+    if(a != NULL) {
+      *min = column_long(attr, get_u32(descriptor + 3));
+      *max = column_long(attr, get_u32(descriptor + 7));
+    }
+  }
+
+  return block.first + block.rows;
+}
+/*---------------------------------------------------------------------------*/
+#endif /* DB_FEATURE_COLUMNAR */
@@ -66,8 +66,15 @@ db_result_t storage_put_index(index_t *);
 
 db_result_t storage_get_row(relation_t *, tuple_id_t *, storage_row_t);
 db_result_t storage_put_row(relation_t *, storage_row_t);
+db_result_t storage_put_rows(relation_t *, storage_row_t, unsigned);
 db_result_t storage_get_row_amount(relation_t *, tuple_id_t *);
 
+#if DB_FEATURE_COLUMNAR
+void storage_remove_tuples(relation_t *);
+tuple_id_t storage_get_summary(relation_t *, tuple_id_t, attribute_t *,
+                               long *, long *);
+#endif /* DB_FEATURE_COLUMNAR */
+
 db_storage_id_t storage_open(const char *);
 void storage_close(db_storage_id_t);
 db_result_t storage_read(db_storage_id_t, void *, unsigned long, unsigned);
@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \file
+ *         Streaming application of code module deltas
+ */
+
+#include "codeprop-delta.h"
+#include "cfs/cfs.h"
+#include "lib/crc16.h"
+
+#ifdef CODEPROP_DELTA_CONF_BUFFER_SIZE
+#define BUFFER_SIZE CODEPROP_DELTA_CONF_BUFFER_SIZE
+#else
+#define BUFFER_SIZE 32
+#endif
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+enum {
+  STATE_HEADER,
+  STATE_COMMAND,
+  STATE_COPY_ARGS,
+  STATE_INSERT_ARGS,
+  STATE_INSERT_DATA,
+  STATE_DONE,
+};
+
+static uint8_t buffer[BUFFER_SIZE];
+/*---------------------------------------------------------------------------*/
+static uint16_t
+get16(const uint8_t *p)
+{
+  return (p[0] << 8) | p[1];
+}
+/*---------------------------------------------------------------------------*/
+static int
+write_new(struct codeprop_delta *d, const uint8_t *data, int len)
+{
+  if(cfs_write(d->newfd, data, len) != len) {
+    return 0;
+  }
+  d->crc = crc16_data(data, len, d->crc);
+  d->written += len;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+check_base(struct codeprop_delta *d, uint16_t crc)
+{
+  uint16_t left;
+  uint16_t acc;
+  int n;
+
+  cfs_seek(d->oldfd, 0, CFS_SEEK_SET);
+  acc = 0;
+  for(left = d->old_len; left > 0; left -= n) {
+    n = left < BUFFER_SIZE ? left : BUFFER_SIZE;
+    if(cfs_read(d->oldfd, buffer, n) != n) {
+      return 0;
+    }
+    acc = crc16_data(buffer, n, acc);
+  }
+  return acc == crc;
+}
+/*---------------------------------------------------------------------------*/
+static int
+copy_old(struct codeprop_delta *d)
+{
+  int n;
+
+  if((uint32_t)d->offset + d->len > d->old_len) {
+    return CODEPROP_DELTA_ERR_COMMAND;
+  }
+  cfs_seek(d->oldfd, d->offset, CFS_SEEK_SET);
+  for(; d->len > 0; d->len -= n) {
+    n = d->len < BUFFER_SIZE ? d->len : BUFFER_SIZE;
+    if(cfs_read(d->oldfd, buffer, n) != n) {
+      return CODEPROP_DELTA_ERR_BASE;
+    }
+    if(!write_new(d, buffer, n)) {
+      return CODEPROP_DELTA_ERR_WRITE;
+    }
+  }
+  return CODEPROP_DELTA_MORE;
+}
+/*---------------------------------------------------------------------------*/
+static int
+command_done(struct codeprop_delta *d)
+{
+  d->state = STATE_COMMAND;
+  if(d->written < d->new_len) {
+    return CODEPROP_DELTA_MORE;
+  }
+  d->state = STATE_DONE;
+  if(d->crc != d->new_crc) {
+    PRINTF("codeprop-delta: crc 0x%04x, expected 0x%04x\n",
+           d->crc, d->new_crc);
+    return CODEPROP_DELTA_ERR_CRC;
+  }
+  return CODEPROP_DELTA_DONE;
+}
+/*---------------------------------------------------------------------------*/
+void
+codeprop_delta_init(struct codeprop_delta *d, int oldfd, int newfd)
+{
+  d->oldfd = oldfd;
+  d->newfd = newfd;
+  d->state = STATE_HEADER;
+  d->pos = 0;
+  d->crc = 0;
+  d->written = 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+codeprop_delta_input(struct codeprop_delta *d, const uint8_t *data, int len)
+{
+  int n;
+  int ret;
+
+  while(len > 0) {
+    switch(d->state) {
+    case STATE_HEADER:
+      d->field[d->pos++] = *data++;
+      len--;
+      if(d->pos < CODEPROP_DELTA_HEADER_SIZE) {
+        break;
+      }
+      if(d->field[0] != 'C' || d->field[1] != 'D' ||
+         d->field[2] != CODEPROP_DELTA_VERSION) {
+        return CODEPROP_DELTA_ERR_HEADER;
+      }
+      d->old_len = get16(&d->field[4]);
+      d->new_len = get16(&d->field[8]);
+      d->new_crc = get16(&d->field[10]);
+      if(!check_base(d, get16(&d->field[6]))) {
+        PRINTF("codeprop-delta: not a delta of this module\n");
+        return CODEPROP_DELTA_ERR_BASE;
+      }
+      cfs_seek(d->newfd, 0, CFS_SEEK_SET);
+      ret = command_done(d);
+      if(ret != CODEPROP_DELTA_MORE) {
+        return ret;
+      }
+      break;
+    case STATE_COMMAND:
+      d->pos = 0;
+      if(*data == CODEPROP_DELTA_COPY) {
+        d->state = STATE_COPY_ARGS;
+      } else if(*data == CODEPROP_DELTA_INSERT) {
+        d->state = STATE_INSERT_ARGS;
+      } else {
+        return CODEPROP_DELTA_ERR_COMMAND;
+      }
+      data++;
+      len--;
+      break;
+    case STATE_COPY_ARGS:
+      d->field[d->pos++] = *data++;
+      len--;
+      if(d->pos < 4) {
+        break;
+      }
+      d->offset = get16(&d->field[0]);
+      d->len = get16(&d->field[2]);
+      if((uint32_t)d->written + d->len > d->new_len) {
+        return CODEPROP_DELTA_ERR_COMMAND;
+      }
+      ret = copy_old(d);
+      if(ret != CODEPROP_DELTA_MORE) {
+        return ret;
+      }
+      ret = command_done(d);
+      if(ret != CODEPROP_DELTA_MORE) {
+        return ret;
+      }
+      break;
+    case STATE_INSERT_ARGS:
+      d->field[d->pos++] = *data++;
+      len--;
+      if(d->pos < 2) {
+        break;
+      }
+      d->len = get16(&d->field[0]);
+      if((uint32_t)d->written + d->len > d->new_len) {
+        return CODEPROP_DELTA_ERR_COMMAND;
+      }
+      d->state = STATE_INSERT_DATA;
+      if(d->len == 0) {
+        ret = command_done(d);
+        if(ret != CODEPROP_DELTA_MORE) {
+          return ret;
+        }
+      }
+      break;
+    case STATE_INSERT_DATA:
+      n = len < d->len ? len : d->len;
+      if(!write_new(d, data, n)) {
+        return CODEPROP_DELTA_ERR_WRITE;
+      }
+      data += n;
+      len -= n;
+      d->len -= n;
+      if(d->len == 0) {
+        ret = command_done(d);
+        if(ret != CODEPROP_DELTA_MORE) {
+          return ret;
+        }
+      }
+      break;
+    case STATE_DONE:
+      return CODEPROP_DELTA_DONE;
+    }
+  }
+  return d->state == STATE_DONE ? CODEPROP_DELTA_DONE : CODEPROP_DELTA_MORE;
+}
+/*---------------------------------------------------------------------------*/
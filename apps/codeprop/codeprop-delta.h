@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Binary deltas of code modules: a new module is described as
+ *         pieces copied from the module already in the file system and
+ *         literal bytes. tools/codeprop -d builds them.
+ *
+ *         A delta starts with a header (big endian):
+ *
+ *           'C' 'D' version flags old-len(2) old-crc(2) new-len(2) new-crc(2)
+ *
+ *         followed by commands until the new module is complete:
+ *
+ *           0x00 offset(2) len(2)   copy len bytes of the old module
+ *           0x01 len(2) data        insert len bytes of data
+ *
+ *         The delta is applied as it comes, with a copy buffer of
+ *         CODEPROP_DELTA_CONF_BUFFER_SIZE bytes.
+ */
+
+#ifndef CODEPROP_DELTA_H_
+#define CODEPROP_DELTA_H_
+
+#include "contiki.h"
+
+#define CODEPROP_DELTA_VERSION     1
+#define CODEPROP_DELTA_HEADER_SIZE 12
+
+#define CODEPROP_DELTA_COPY        0x00
+#define CODEPROP_DELTA_INSERT      0x01
+
+/* Returned by codeprop_delta_input() */
+#define CODEPROP_DELTA_MORE         0
+#define CODEPROP_DELTA_DONE         1
+#define CODEPROP_DELTA_ERR_HEADER  -1
+#define CODEPROP_DELTA_ERR_BASE    -2
+#define CODEPROP_DELTA_ERR_COMMAND -3
+#define CODEPROP_DELTA_ERR_WRITE   -4
+#define CODEPROP_DELTA_ERR_CRC     -5
+
+struct codeprop_delta {
+  int oldfd, newfd;
+  uint16_t old_len, new_len;
+  uint16_t new_crc, crc;
+  uint16_t written;
+  /* Offset and length of the current command */
+  uint16_t offset, len;
+  uint8_t state;
+  uint8_t pos;
+  uint8_t field[CODEPROP_DELTA_HEADER_SIZE];
+};
+
+/**
+ * Start applying a delta.
+ *
+ * \param d     The state of the delta
+ * \param oldfd The old module, opened for reading
+ * \param newfd The file the new module is written to
+ */
+void codeprop_delta_init(struct codeprop_delta *d, int oldfd, int newfd);
+
+/**
+ * Apply the next part of a delta.
+ *
+ * \return CODEPROP_DELTA_MORE until the new module is complete,
+ * then CODEPROP_DELTA_DONE, or a negative CODEPROP_DELTA_ERR_ value.
+ * Input after the end of the delta is ignored.
+ */
+int codeprop_delta_input(struct codeprop_delta *d,
+                         const uint8_t *data, int len);
+
+#endif /* CODEPROP_DELTA_H_ */
@@ -47,6 +47,8 @@
  *    Point-to-point download over TCP
  *    Point-to-multipoint delivery over UDP broadcasts
  *    Versioning of code modules
+ *    Deltas against the module already in the file system (see
+ *    codeprop-delta.h), which are also what is propagated over UDP
  *
  * Procedure:
  *
@@ -69,6 +71,7 @@
 #include "contiki-net.h"
 #include "cfs/cfs.h"
 #include "codeprop-tmp.h"
+#include "codeprop-delta.h"
 #include "loader/elfloader.h"
 #include <string.h>
 
@@ -79,6 +82,13 @@ static const char *err_msgs[] =
 
 #define CODEPROP_DATA_PORT 6510
 
+/* The module as it was received, which deltas apply to and which is
+   propagated, the copy of it that elfloader relocates and runs, and
+   the last delta that was received */
+#define IMAGE_FILE "codeprop-image"
+#define LOAD_FILE  "codeprop-load"
+#define DELTA_FILE "codeprop-delta"
+
 /*static int random_rand(void) { return 1; }*/
 
 #if 1
@@ -104,6 +114,7 @@ struct codeprop_udphdr {
   uint16_t type;
 #define TYPE_DATA 0x0001
 #define TYPE_NACK 0x0002
+#define TYPE_DELTA 0x0003
   uint16_t addr;
   uint16_t len;
   uint8_t data[UDPDATASIZE];
@@ -111,7 +122,8 @@ struct codeprop_udphdr {
 
 struct codeprop_tcphdr {
   uint16_t len;
-  uint16_t pad;
+  uint16_t flags;
+#define FLAG_DELTA 0x0001
 };
 
 static void uipcall(void *state);
@@ -132,12 +144,14 @@ struct codeprop_state {
   struct timer nacktimer, timer, starttimer;
   uint8_t received;
   uint8_t send_counter;
+  /* The data is a delta rather than a module */
+  uint8_t delta;
   struct pt tcpthread_pt;
   struct pt udpthread_pt;
   struct pt recv_udpthread_pt;
 };
 
-static int fd;
+static int fd, deltafd;
 
 static struct uip_udp_conn *udp_conn;
 
@@ -178,7 +192,8 @@ PROCESS_THREAD(codeprop_process, ev, data)
   s.addr = 0;
   s.len = 0;
 
-  fd = cfs_open("codeprop-image", CFS_READ | CFS_WRITE);
+  fd = cfs_open(IMAGE_FILE, CFS_READ | CFS_WRITE);
+  deltafd = cfs_open(DELTA_FILE, CFS_READ | CFS_WRITE);
 
   while(1) {
 
@@ -194,12 +209,60 @@ PROCESS_THREAD(codeprop_process, ev, data)
   PROCESS_END();
 }
 /*---------------------------------------------------------------------*/
+static void
+copy_file(int from, int to)
+{
+  uint8_t buf[32];
+  int len;
+
+  cfs_seek(from, 0, CFS_SEEK_SET);
+  cfs_seek(to, 0, CFS_SEEK_SET);
+  while((len = cfs_read(from, buf, sizeof(buf))) > 0) {
+    cfs_write(to, buf, len);
+  }
+}
+/*---------------------------------------------------------------------*/
+static int
+apply_delta(void)
+{
+  static struct codeprop_delta delta;
+  uint8_t buf[32];
+  uint16_t addr;
+  int newfd, len, ret;
+
+  cfs_remove(LOAD_FILE);
+  newfd = cfs_open(LOAD_FILE, CFS_READ | CFS_WRITE);
+  codeprop_delta_init(&delta, fd, newfd);
+
+  cfs_seek(deltafd, 0, CFS_SEEK_SET);
+  ret = CODEPROP_DELTA_MORE;
+  for(addr = 0; addr < s.len && ret == CODEPROP_DELTA_MORE; addr += len) {
+    len = s.len - addr < sizeof(buf) ? s.len - addr : sizeof(buf);
+    if(cfs_read(deltafd, buf, len) != len) {
+      break;
+    }
+    ret = codeprop_delta_input(&delta, buf, len);
+  }
+
+  if(ret == CODEPROP_DELTA_DONE) {
+    /* The new module is what the next delta will apply to */
+    cfs_close(fd);
+    cfs_remove(IMAGE_FILE);
+    fd = cfs_open(IMAGE_FILE, CFS_READ | CFS_WRITE);
+    copy_file(newfd, fd);
+  } else {
+    PRINTF(("codeprop: delta failed (%d)\n", ret));
+  }
+  cfs_close(newfd);
+  return ret;
+}
+/*---------------------------------------------------------------------*/
 static uint16_t
 send_udpdata(struct codeprop_udphdr *uh)
 {
   uint16_t len;
 
-  uh->type = UIP_HTONS(TYPE_DATA);
+  uh->type = s.delta ? UIP_HTONS(TYPE_DELTA) : UIP_HTONS(TYPE_DATA);
   uh->addr = uip_htons(s.addr);
   uh->id = uip_htons(s.id);
 
@@ -209,8 +272,8 @@ send_udpdata(struct codeprop_udphdr *uh)
     len = s.len - s.addr;
   }
 
-  cfs_seek(fd, s.addr, CFS_SEEK_SET);
-  cfs_read(fd, &uh->data[0], len);
+  cfs_seek(s.delta ? deltafd : fd, s.addr, CFS_SEEK_SET);
+  cfs_read(s.delta ? deltafd : fd, &uh->data[0], len);
   /*  eeprom_read(EEPROMFS_ADDR_CODEPROP + s.addr,
       &uh->data[0], len);*/
 
@@ -264,6 +327,12 @@ PT_THREAD(send_udpthread(struct pt *pt))
   PT_END(pt);
 }
 /*---------------------------------------------------------------------*/
+static int
+is_data(struct codeprop_udphdr *uh)
+{
+  return uh->type == UIP_HTONS(TYPE_DATA) || uh->type == UIP_HTONS(TYPE_DELTA);
+}
+/*---------------------------------------------------------------------*/
 static void
 send_nack(struct codeprop_udphdr *uh, unsigned short addr)
 {
@@ -288,7 +357,7 @@ PT_THREAD(recv_udpthread(struct pt *pt))
 
     do {
       PT_WAIT_UNTIL(pt, uip_newdata() &&
-		    uh->type == UIP_HTONS(TYPE_DATA) &&
+		    is_data(uh) &&
 		    uip_htons(uh->id) > s.id);
 
       if(uip_htons(uh->addr) != 0) {
@@ -304,6 +373,7 @@ PT_THREAD(recv_udpthread(struct pt *pt))
     s.addr = 0;
     s.id = uip_htons(uh->id);
     s.len = uip_htons(uh->len);
+    s.delta = uh->type == UIP_HTONS(TYPE_DELTA);
 
     timer_set(&s.timer, CONNECTION_TIMEOUT);
 /*     process_post(PROCESS_BROADCAST, codeprop_event_quit, (process_data_t)NULL); */
@@ -316,8 +386,8 @@ PT_THREAD(recv_udpthread(struct pt *pt))
 	if(len > 0) {
 	  /*	  eeprom_write(EEPROMFS_ADDR_CODEPROP + s.addr,
 		  &uh->data[0], len);*/
-	  cfs_seek(fd, s.addr, CFS_SEEK_SET);
-	  cfs_write(fd, &uh->data[0], len);
+	  cfs_seek(s.delta ? deltafd : fd, s.addr, CFS_SEEK_SET);
+	  cfs_write(s.delta ? deltafd : fd, &uh->data[0], len);
 
 	  /*	  beep();*/
 	  PRINTF(("Saved %d bytes at address %d, %d bytes left\n",
@@ -340,7 +410,7 @@ PT_THREAD(recv_udpthread(struct pt *pt))
 	  timer_set(&s.nacktimer, HIT_NACK_TIMEOUT);
 	  PT_YIELD_UNTIL(pt, timer_expired(&s.nacktimer) ||
 			 (uip_newdata() &&
-			  uh->type == UIP_HTONS(TYPE_DATA) &&
+			  is_data(uh) &&
 			  uip_htons(uh->id) == s.id));
 	  if(timer_expired(&s.nacktimer)) {
 	    send_nack(uh, s.addr);
@@ -353,7 +423,9 @@ PT_THREAD(recv_udpthread(struct pt *pt))
     /*    leds_off(LEDS_YELLOW);
 	  beep_quick(2);*/
     /*    printf("Received entire bunary over udr\n");*/
-    codeprop_start_program();
+    if(!s.delta || apply_delta() == CODEPROP_DELTA_DONE) {
+      codeprop_start_program();
+    }
     PT_EXIT(pt);
   }
 
@@ -391,6 +463,7 @@ PT_THREAD(recv_tcpthread(struct pt *pt))
     }
     th = (struct codeprop_tcphdr *)uip_appdata;
     s.len = uip_htons(th->len);
+    s.delta = (uip_htons(th->flags) & FLAG_DELTA) != 0;
     s.addr = 0;
     uip_appdata += sizeof(struct codeprop_tcphdr);
     datalen -= sizeof(struct codeprop_tcphdr);
@@ -402,8 +475,8 @@ PT_THREAD(recv_tcpthread(struct pt *pt))
 	/*	eeprom_write(EEPROMFS_ADDR_CODEPROP + s.addr,
 		uip_appdata,
 		uip_datalen());*/
-	cfs_seek(fd, s.addr, CFS_SEEK_SET);
-	cfs_write(fd, uip_appdata, uip_datalen());
+	cfs_seek(s.delta ? deltafd : fd, s.addr, CFS_SEEK_SET);
+	cfs_write(s.delta ? deltafd : fd, uip_appdata, datalen);
 	s.addr += datalen;
       }
       if(s.addr < s.len) {
@@ -414,13 +487,17 @@ PT_THREAD(recv_tcpthread(struct pt *pt))
 #if 1
     
     {
-      static int err;
-      
-      err = codeprop_start_program();
-      
+      static const char *msg;
+
+      if(s.delta && apply_delta() != CODEPROP_DELTA_DONE) {
+	msg = "Bad delta\r\n";
+      } else {
+	msg = err_msgs[codeprop_start_program()];
+      }
+
       /* Print out the "OK"/error message. */
       do {
-	uip_send(err_msgs[err], strlen(err_msgs[err]));
+	uip_send(msg, strlen(msg));
 	PT_WAIT_UNTIL(pt, uip_acked() || uip_rexmit() || uip_closed());
       } while(uip_rexmit());
       
@@ -442,6 +519,7 @@ PT_THREAD(recv_tcpthread(struct pt *pt))
 void
 codeprop_start_broadcast(unsigned int len)
 {
+  s.delta = 0;
   s.addr = 0;
   s.len = len;
   ++s.id;
@@ -461,10 +539,17 @@ int
 codeprop_start_program(void)
 {
   int err;
+  int loadfd;
 
   codeprop_exit_program();
 
-  err = elfloader_load(fd);
+  /* elfloader relocates the module in its file, so it is given a copy
+     and the module stays as it was received */
+  cfs_remove(LOAD_FILE);
+  loadfd = cfs_open(LOAD_FILE, CFS_READ | CFS_WRITE);
+  copy_file(fd, loadfd);
+  err = elfloader_load(loadfd);
+  cfs_close(loadfd);
   if(err == ELFLOADER_OK) {
     PRINTF(("codeprop: starting %s\n",
 	    elfloader_autostart_processes[0]->name));
@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *      CoAP module for Block1 uploads reassembled into CFS files
+ */
+
+#include <string.h>
+#include "contiki.h"
+#include "cfs/cfs.h"
+#include "er-coap-block1-cfs.h"
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+typedef struct upload {
+  uip_ipaddr_t addr;
+  uint16_t port;
+  uint8_t token_len;
+  uint8_t token[COAP_TOKEN_LEN];
+  const resource_t *resource;
+  uint32_t len;                 /* bytes stored so far */
+  unsigned long expires;
+  uint8_t in_use;
+} upload_t;
+
+/* uploads are told apart by a single digit in their file names */
+#if COAP_BLOCK1_CFS_UPLOADS > 10
+#error COAP_BLOCK1_CFS_UPLOADS must not be over 10
+#endif
+
+static upload_t uploads[COAP_BLOCK1_CFS_UPLOADS];
+/*---------------------------------------------------------------------------*/
+static const char *
+filename(const upload_t *u)
+{
+  static char name[sizeof(COAP_BLOCK1_CFS_FILENAME) + 1];
+
+  memcpy(name, COAP_BLOCK1_CFS_FILENAME, sizeof(COAP_BLOCK1_CFS_FILENAME) - 1);
+  name[sizeof(COAP_BLOCK1_CFS_FILENAME) - 1] = '0' + (u - uploads);
+  name[sizeof(COAP_BLOCK1_CFS_FILENAME)] = '\0';
+  return name;
+}
+/*---------------------------------------------------------------------------*/
+static void
+release(upload_t *u)
+{
+  cfs_remove(filename(u));
+  u->in_use = 0;
+}
+/*---------------------------------------------------------------------------*/
+static upload_t *
+lookup(coap_packet_t *request, const resource_t *resource)
+{
+  unsigned long now = clock_seconds();
+  upload_t *found = NULL;
+  int i;
+
+  for(i = 0; i < COAP_BLOCK1_CFS_UPLOADS; i++) {
+    upload_t *u = &uploads[i];
+    if(!u->in_use) {
+      continue;
+    }
+    if((long)(u->expires - now) <= 0) {
+      PRINTF("CoAP Block1: upload %d timed out\n", i);
+      release(u);
+    } else if(u->resource == resource && u->port == UIP_UDP_BUF->srcport
+              && u->token_len == request->token_len
+              && memcmp(u->token, request->token, u->token_len) == 0
+              && uip_ipaddr_cmp(&u->addr, &UIP_IP_BUF->srcipaddr)) {
+      found = u;
+    }
+  }
+  return found;
+}
+/*---------------------------------------------------------------------------*/
+static upload_t *
+start(upload_t *u, coap_packet_t *request, const resource_t *resource)
+{
+  int i;
+
+  if(u == NULL) {
+    for(i = 0; i < COAP_BLOCK1_CFS_UPLOADS && uploads[i].in_use; i++);
+    if(i == COAP_BLOCK1_CFS_UPLOADS) {
+      return NULL;
+    }
+    u = &uploads[i];
+  }
+
+  uip_ipaddr_copy(&u->addr, &UIP_IP_BUF->srcipaddr);
+  u->port = UIP_UDP_BUF->srcport;
+  u->token_len = request->token_len;
+  memcpy(u->token, request->token, request->token_len);
+  u->resource = resource;
+  u->len = 0;
+  u->in_use = 1;
+  cfs_remove(filename(u));
+  return u;
+}
+/*---------------------------------------------------------------------------*/
+static int
+fail(coap_status_t code, char *message)
+{
+  erbium_status_code = code;
+  coap_error_message = message;
+  return -1;
+}
+/*---------------------------------------------------------------------------*/
+int
+coap_block1_cfs_handler(void *request, void *response,
+                        const resource_t *resource,
+                        coap_block1_cfs_callback_t callback)
+{
+  coap_packet_t *packet = (coap_packet_t *)request;
+  const uint8_t *payload = NULL;
+  uint32_t offset = 0;
+  uint32_t size1;
+  upload_t *u;
+  int pay_len;
+  int fd;
+
+  pay_len = REST.get_request_payload(request, &payload);
+  if(IS_OPTION(packet, COAP_OPTION_BLOCK1)) {
+    offset = packet->block1_offset;
+  }
+
+  u = lookup(packet, resource);
+  if(offset == 0) {
+    if(coap_get_header_size1(request, &size1)
+       && size1 > COAP_BLOCK1_CFS_MAX_SIZE) {
+      return fail(REQUEST_ENTITY_TOO_LARGE_4_13, "TooLarge");
+    }
+    u = start(u, packet, resource);
+    if(u == NULL) {
+      return fail(SERVICE_UNAVAILABLE_5_03, "NoFreeUpload");
+    }
+  } else if(u == NULL || offset > u->len) {
+    /* the blocks before this one are missing */
+    return fail(REQUEST_ENTITY_INCOMPLETE_4_08, "NoBlocksBefore");
+  }
+  u->expires = clock_seconds() + COAP_BLOCK1_CFS_TIMEOUT;
+
+  PRINTF("CoAP Block1: upload %d, %d bytes at %lu\n", (int)(u - uploads),
+         pay_len, (unsigned long)offset);
+
+  if(offset + pay_len > COAP_BLOCK1_CFS_MAX_SIZE) {
+    release(u);
+    return fail(REQUEST_ENTITY_TOO_LARGE_4_13, "TooLarge");
+  }
+
+  /* a block seen before is not stored again */
+  if(pay_len > 0 && offset == u->len) {
+    fd = cfs_open(filename(u), CFS_WRITE | CFS_APPEND);
+    if(fd < 0 || cfs_write(fd, payload, pay_len) != pay_len) {
+      if(fd >= 0) {
+        cfs_close(fd);
+      }
+      release(u);
+      return fail(INTERNAL_SERVER_ERROR_5_00, "NoStorage");
+    }
+    cfs_close(fd);
+    u->len += pay_len;
+  }
+
+  if(IS_OPTION(packet, COAP_OPTION_BLOCK1)) {
+    coap_set_header_block1(response, packet->block1_num,
+                           packet->block1_more, packet->block1_size);
+    if(packet->block1_more) {
+      coap_set_status_code(response, CONTINUE_2_31);
+      return 1;
+    }
+  }
+
+  PRINTF("CoAP Block1: upload %d complete, %lu bytes\n", (int)(u - uploads),
+         (unsigned long)u->len);
+  coap_set_status_code(response, CHANGED_2_04);
+  fd = cfs_open(filename(u), CFS_READ);
+  if(fd < 0 && u->len > 0) {
+    release(u);
+    return fail(INTERNAL_SERVER_ERROR_5_00, "NoStorage");
+  }
+  if(callback != NULL) {
+    callback(request, response, fd, u->len);
+  }
+  if(fd >= 0) {
+    cfs_close(fd);
+  }
+  release(u);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *      CoAP module for Block1 uploads reassembled into CFS files.
+ *
+ *      Each upload is kept apart by peer, token and resource, so that
+ *      clients can upload to the same resource at the same time. The
+ *      blocks are appended to a file and the resource gets the complete
+ *      body as an open file once the last block has arrived.
+ */
+
+#ifndef COAP_BLOCK1_CFS_H_
+#define COAP_BLOCK1_CFS_H_
+
+#include "er-coap.h"
+#include "rest-engine.h"
+
+/* The number of uploads in progress at the same time */
+#ifndef COAP_BLOCK1_CFS_UPLOADS
+#define COAP_BLOCK1_CFS_UPLOADS        2
+#endif /* COAP_BLOCK1_CFS_UPLOADS */
+
+/* Largest body accepted for an upload */
+#ifndef COAP_BLOCK1_CFS_MAX_SIZE
+#define COAP_BLOCK1_CFS_MAX_SIZE       8192
+#endif /* COAP_BLOCK1_CFS_MAX_SIZE */
+
+/* Time in seconds after the last block that an upload is abandoned */
+#ifndef COAP_BLOCK1_CFS_TIMEOUT
+#define COAP_BLOCK1_CFS_TIMEOUT        60
+#endif /* COAP_BLOCK1_CFS_TIMEOUT */
+
+/* Files are named with this prefix and the number of the upload */
+#ifndef COAP_BLOCK1_CFS_FILENAME
+#define COAP_BLOCK1_CFS_FILENAME       "coap-b1-"
+#endif /* COAP_BLOCK1_CFS_FILENAME */
+
+/**
+ * \brief Called with the complete body of an upload
+ * \param fd  The file of the body, open for reading at its start
+ * \param len The length of the body
+ *
+ *        The response code is CHANGED_2_04 unless the callback sets
+ *        another one. The file is closed and removed when the callback
+ *        returns.
+ */
+typedef void (*coap_block1_cfs_callback_t)(void *request, void *response,
+                                           int fd, uint32_t len);
+
+/**
+ * \brief Block1 support for a resource, with the body stored in CFS
+ *
+ *        To be called from a POST or PUT handler. A request without
+ *        Block1 option is handled as an upload of a single block.
+ *
+ * \param resource The resource of the handler, part of the upload key
+ * \param callback Called when the last block has been stored
+ *
+ * \return 1 if more blocks will follow, the response is a 2.31 Continue
+ *         0 if the upload is complete and the callback has been called
+ *         -1 on error, with erbium_status_code set
+ */
+int coap_block1_cfs_handler(void *request, void *response,
+                            const resource_t *resource,
+                            coap_block1_cfs_callback_t callback);
+
+#endif /* COAP_BLOCK1_CFS_H_ */
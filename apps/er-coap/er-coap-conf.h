@@ -41,18 +41,56 @@
 
 /* Features that can be disabled to achieve smaller memory footprint */
 #define COAP_LINK_FORMAT_FILTERING     0
+#ifndef COAP_PROXY_OPTION_PROCESSING
 #define COAP_PROXY_OPTION_PROCESSING   0
+#endif /* COAP_PROXY_OPTION_PROCESSING */
+
+/* Size of the serialized /.well-known/core cache, 0 to disable the cache */
+#ifndef COAP_LINK_FORMAT_CACHE_SIZE
+#define COAP_LINK_FORMAT_CACHE_SIZE    128
+#endif /* COAP_LINK_FORMAT_CACHE_SIZE */
+
+/*
+ * Only record the position of options that handlers rarely read (ETag,
+ * If-Match, Max-Age, Uri-Host, Uri-Query, Location-*, Size1/2) when
+ * parsing and decode them in the coap_get_header_*() functions.
+ */
+#ifndef COAP_LAZY_OPTION_PARSING
+#define COAP_LAZY_OPTION_PARSING       0
+#endif /* COAP_LAZY_OPTION_PARSING */
 
 /* Listening port for the CoAP REST Engine */
 #ifndef COAP_SERVER_PORT
 #define COAP_SERVER_PORT               COAP_DEFAULT_PORT
 #endif
 
+/*
+ * Serve requests sent to the multicast groups joined with
+ * coap_join_group() as in RFC 7390: no ACK, no error responses, and other
+ * responses delayed by a random time within the leisure so that the
+ * group members do not all answer at once. Groups need free multicast
+ * address slots, see UIP_CONF_DS6_MADDR_NBU.
+ */
+#ifndef COAP_GROUP_COMMUNICATION
+#define COAP_GROUP_COMMUNICATION       1
+#endif /* COAP_GROUP_COMMUNICATION */
+
+/* Leisure of group responses in seconds (DEFAULT_LEISURE of RFC 7252) */
+#ifndef COAP_GROUP_LEISURE
+#define COAP_GROUP_LEISURE             5
+#endif /* COAP_GROUP_LEISURE */
+#define COAP_GROUP_LEISURE_TICKS       ((clock_time_t)COAP_GROUP_LEISURE * CLOCK_SECOND)
+
 /* The number of concurrent messages that can be stored for retransmission in the transaction layer. */
 #ifndef COAP_MAX_OPEN_TRANSACTIONS
 #define COAP_MAX_OPEN_TRANSACTIONS     4
 #endif /* COAP_MAX_OPEN_TRANSACTIONS */
 
+/* Number of MID hash buckets used to look up transactions, a power of two */
+#ifndef COAP_TRANSACTION_HASH_SIZE
+#define COAP_TRANSACTION_HASH_SIZE     8
+#endif /* COAP_TRANSACTION_HASH_SIZE */
+
 /* Maximum number of failed request attempts before action */
 #ifndef COAP_MAX_ATTEMPTS
 #define COAP_MAX_ATTEMPTS              4
@@ -65,9 +103,19 @@
 
 /* Number of observer slots (each takes abot xxx bytes) */
 #ifndef COAP_MAX_OBSERVERS
-#define COAP_MAX_OBSERVERS    COAP_MAX_OPEN_TRANSACTIONS - 1
+#define COAP_MAX_OBSERVERS    COAP_MAX_OPEN_TRANSACTIONS
 #endif /* COAP_MAX_OBSERVERS */
 
+/* The number of serialized notifications that can be shared by observers. */
+#ifndef COAP_MAX_SHARED_PACKETS
+#define COAP_MAX_SHARED_PACKETS        2
+#endif /* COAP_MAX_SHARED_PACKETS */
+
+/* The number of confirmable notifications waiting for acknowledgement. */
+#ifndef COAP_MAX_OPEN_NOTIFICATIONS
+#define COAP_MAX_OPEN_NOTIFICATIONS    COAP_MAX_OBSERVERS
+#endif /* COAP_MAX_OPEN_NOTIFICATIONS */
+
 /* Interval in notifies in which NON notifies are changed to CON notifies to check client. */
 #define COAP_OBSERVE_REFRESH_INTERVAL  20
 
@@ -40,6 +40,7 @@
 #define ER_COAP_CONSTANTS_H_
 
 #define COAP_DEFAULT_PORT                    5683
+#define COAP_DEFAULT_SECURE_PORT             5684
 
 #define COAP_DEFAULT_MAX_AGE                 60
 #define COAP_RESPONSE_TIMEOUT                3
@@ -94,6 +95,7 @@ typedef enum {
   NOT_FOUND_4_04 = 132,         /* NOT_FOUND */
   METHOD_NOT_ALLOWED_4_05 = 133,        /* METHOD_NOT_ALLOWED */
   NOT_ACCEPTABLE_4_06 = 134,    /* NOT_ACCEPTABLE */
+  REQUEST_ENTITY_INCOMPLETE_4_08 = 136, /* REQUEST_ENTITY_INCOMPLETE */
   PRECONDITION_FAILED_4_12 = 140,       /* BAD_REQUEST */
   REQUEST_ENTITY_TOO_LARGE_4_13 = 141,  /* REQUEST_ENTITY_TOO_LARGE */
   UNSUPPORTED_MEDIA_TYPE_4_15 = 143,    /* UNSUPPORTED_MEDIA_TYPE */
@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *      CoAP module for duplicate detection of confirmable requests
+ */
+
+#include <string.h>
+#include "contiki.h"
+#include "er-coap-dedup.h"
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+#if COAP_DEDUP_CACHE_SIZE > 0
+static coap_dedup_entry_t cache[COAP_DEDUP_CACHE_SIZE];
+#endif /* COAP_DEDUP_CACHE_SIZE > 0 */
+/*---------------------------------------------------------------------------*/
+static int
+is_expired(const coap_dedup_entry_t *entry, unsigned long now)
+{
+  return (long)(entry->expires - now) <= 0;
+}
+/*---------------------------------------------------------------------------*/
+coap_dedup_entry_t *
+coap_dedup_lookup(const uip_ipaddr_t *addr, uint16_t port, uint16_t mid)
+{
+#if COAP_DEDUP_CACHE_SIZE > 0
+  unsigned long now = clock_seconds();
+  int i;
+
+  for(i = 0; i < COAP_DEDUP_CACHE_SIZE; i++) {
+    if(cache[i].mid == mid && cache[i].port == port &&
+       !is_expired(&cache[i], now) && uip_ipaddr_cmp(&cache[i].addr, addr)) {
+      PRINTF("CoAP dedup: duplicate MID %u\n", mid);
+      return &cache[i];
+    }
+  }
+#endif /* COAP_DEDUP_CACHE_SIZE > 0 */
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+coap_dedup_entry_t *
+coap_dedup_add(const uip_ipaddr_t *addr, uint16_t port, uint16_t mid)
+{
+#if COAP_DEDUP_CACHE_SIZE > 0
+  coap_dedup_entry_t *entry;
+  unsigned long now = clock_seconds();
+  int i;
+
+  /* Use an expired entry or the entry that expires first */
+  entry = &cache[0];
+  for(i = 0; i < COAP_DEDUP_CACHE_SIZE; i++) {
+    if(is_expired(&cache[i], now)) {
+      entry = &cache[i];
+      break;
+    }
+    if((long)(cache[i].expires - entry->expires) < 0) {
+      entry = &cache[i];
+    }
+  }
+
+  uip_ipaddr_copy(&entry->addr, addr);
+  entry->port = port;
+  entry->mid = mid;
+  entry->expires = now + COAP_DEDUP_LIFETIME;
+  entry->response_len = 0;
+  return entry;
+#else /* COAP_DEDUP_CACHE_SIZE > 0 */
+  return NULL;
+#endif /* COAP_DEDUP_CACHE_SIZE > 0 */
+}
+/*---------------------------------------------------------------------------*/
+void
+coap_dedup_set_response(coap_dedup_entry_t *entry,
+                        const uint8_t *data, uint16_t len)
+{
+  if(entry == NULL) {
+    return;
+  }
+  if(len > COAP_DEDUP_RESPONSE_SIZE) {
+    /* Too large - a duplicate will be handled as a new request */
+    PRINTF("CoAP dedup: response too large to cache (%u)\n", len);
+    entry->response_len = 0;
+    return;
+  }
+  memcpy(entry->response, data, len);
+  entry->response_len = len;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *      CoAP module for duplicate detection of confirmable requests.
+ *
+ *      A retransmitted request is answered with the cached response
+ *      instead of invoking the resource handler again.
+ */
+
+#ifndef COAP_DEDUP_H_
+#define COAP_DEDUP_H_
+
+#include "er-coap.h"
+
+/* The number of remembered requests, 0 disables duplicate detection */
+#ifndef COAP_DEDUP_CACHE_SIZE
+#define COAP_DEDUP_CACHE_SIZE          3
+#endif /* COAP_DEDUP_CACHE_SIZE */
+
+/* Largest response that is cached for retransmission */
+#ifndef COAP_DEDUP_RESPONSE_SIZE
+#define COAP_DEDUP_RESPONSE_SIZE       48
+#endif /* COAP_DEDUP_RESPONSE_SIZE */
+
+/* Time in seconds that a request is remembered (EXCHANGE_LIFETIME) */
+#ifndef COAP_DEDUP_LIFETIME
+#define COAP_DEDUP_LIFETIME            247
+#endif /* COAP_DEDUP_LIFETIME */
+
+typedef struct coap_dedup_entry {
+  uip_ipaddr_t addr;
+  uint16_t port;
+  uint16_t mid;
+  unsigned long expires;
+  uint16_t response_len;        /* 0 if no response has been cached */
+  uint8_t response[COAP_DEDUP_RESPONSE_SIZE];
+} coap_dedup_entry_t;
+
+/**
+ * \brief Find a request that already has been received
+ * \return The cache entry or NULL if the request is new
+ */
+coap_dedup_entry_t *coap_dedup_lookup(const uip_ipaddr_t *addr,
+                                      uint16_t port, uint16_t mid);
+
+/**
+ * \brief Remember a new request, replacing the oldest entry if needed
+ */
+coap_dedup_entry_t *coap_dedup_add(const uip_ipaddr_t *addr,
+                                   uint16_t port, uint16_t mid);
+
+/**
+ * \brief Cache the serialized response for a remembered request
+ */
+void coap_dedup_set_response(coap_dedup_entry_t *entry,
+                             const uint8_t *data, uint16_t len);
+
+#endif /* COAP_DEDUP_H_ */
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *      CoAP secure endpoint layer for coaps
+ */
+
+#include "contiki.h"
+#include "contiki-net.h"
+#include "er-coap-dtls.h"
+#include "er-coap-engine.h"
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+#if COAP_DTLS
+static struct uip_udp_conn *dtls_conn = NULL;
+#endif /* COAP_DTLS */
+/*---------------------------------------------------------------------------*/
+void
+coap_dtls_init(void)
+{
+#if COAP_DTLS
+  dtls_conn = udp_new(NULL, 0, NULL);
+  udp_bind(dtls_conn, UIP_HTONS(COAP_DTLS_PORT));
+  PRINTF("DTLS driver %s listening on port %u\n", COAP_DTLS_DRIVER.name,
+         COAP_DTLS_PORT);
+  COAP_DTLS_DRIVER.init();
+#endif /* COAP_DTLS */
+}
+/*---------------------------------------------------------------------------*/
+int
+coap_dtls_input(void)
+{
+#if COAP_DTLS
+  int len;
+
+  if(dtls_conn == NULL || uip_udp_conn != dtls_conn) {
+    return 0;
+  }
+  len = COAP_DTLS_DRIVER.input(&UIP_IP_BUF->srcipaddr, UIP_UDP_BUF->srcport,
+                               uip_appdata, uip_datalen());
+  if(len > 0) {
+    coap_receive(uip_appdata, len);
+  }
+  return 1;
+#else /* COAP_DTLS */
+  return 0;
+#endif /* COAP_DTLS */
+}
+/*---------------------------------------------------------------------------*/
+void
+coap_dtls_output(const uip_ipaddr_t *addr, uint16_t port,
+                 const uint8_t *data, uint16_t length)
+{
+#if COAP_DTLS
+  uip_udp_packet_sendto(dtls_conn, data, length, addr, port);
+#endif /* COAP_DTLS */
+}
+/*---------------------------------------------------------------------------*/
+int
+coap_dtls_set_psk(const uip_ipaddr_t *addr, uint16_t port,
+                  const uint8_t *identity, uint16_t identity_len,
+                  const uint8_t *key, uint16_t key_len)
+{
+#if COAP_DTLS
+  return COAP_DTLS_DRIVER.set_psk(addr, port, identity, identity_len,
+                                  key, key_len);
+#else /* COAP_DTLS */
+  return 0;
+#endif /* COAP_DTLS */
+}
+/*---------------------------------------------------------------------------*/
+int
+coap_dtls_connect(const uip_ipaddr_t *addr, uint16_t port)
+{
+#if COAP_DTLS
+  return COAP_DTLS_DRIVER.connect(addr, port);
+#else /* COAP_DTLS */
+  return 0;
+#endif /* COAP_DTLS */
+}
+/*---------------------------------------------------------------------------*/
+void
+coap_dtls_close(const uip_ipaddr_t *addr, uint16_t port)
+{
+#if COAP_DTLS
+  COAP_DTLS_DRIVER.close(addr, port);
+#endif /* COAP_DTLS */
+}
+/*---------------------------------------------------------------------------*/
+int
+coap_dtls_send(const uip_ipaddr_t *addr, uint16_t port, const uint8_t *data,
+               uint16_t length)
+{
+#if COAP_DTLS
+  if(!COAP_DTLS_DRIVER.has_session(addr, port)) {
+    return 0;
+  }
+  COAP_DTLS_DRIVER.send(addr, port, data, length);
+  return 1;
+#else /* COAP_DTLS */
+  return 0;
+#endif /* COAP_DTLS */
+}
+/*---------------------------------------------------------------------------*/
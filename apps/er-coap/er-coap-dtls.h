@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *      CoAP secure endpoint layer for coaps.
+ *
+ *      Messages to an endpoint with a DTLS session are passed to a DTLS
+ *      driver instead of being sent as plain UDP datagrams, and records
+ *      received on the secure port are decrypted by the driver before
+ *      they are handled by the engine. The driver implements the
+ *      handshake, session resumption and connection IDs, and can use
+ *      hardware crypto where the platform has it.
+ *
+ *      A driver is selected with COAP_DTLS_CONF_DRIVER. Without one,
+ *      coaps is not available.
+ */
+
+#ifndef COAP_DTLS_H_
+#define COAP_DTLS_H_
+
+#include "er-coap.h"
+
+#ifdef COAP_DTLS_CONF_DRIVER
+#define COAP_DTLS_DRIVER COAP_DTLS_CONF_DRIVER
+#define COAP_DTLS 1
+#else /* COAP_DTLS_CONF_DRIVER */
+#define COAP_DTLS 0
+#endif /* COAP_DTLS_CONF_DRIVER */
+
+/* Local port for coaps */
+#ifndef COAP_DTLS_PORT
+#define COAP_DTLS_PORT                 COAP_DEFAULT_SECURE_PORT
+#endif /* COAP_DTLS_PORT */
+
+struct coap_dtls_driver {
+  char *name;
+
+  /** Initialize the driver. Records are sent with coap_dtls_output(). */
+  void (* init)(void);
+
+  /** Set the pre-shared key used for sessions with a peer. */
+  int (* set_psk)(const uip_ipaddr_t *addr, uint16_t port,
+                  const uint8_t *identity, uint16_t identity_len,
+                  const uint8_t *key, uint16_t key_len);
+
+  /** Start a session with a peer, resuming a previous one if possible. */
+  int (* connect)(const uip_ipaddr_t *addr, uint16_t port);
+
+  /** Check if a session with a peer is established or being set up. */
+  int (* has_session)(const uip_ipaddr_t *addr, uint16_t port);
+
+  /** Protect and send application data, queued during a handshake. */
+  int (* send)(const uip_ipaddr_t *addr, uint16_t port,
+               const uint8_t *data, uint16_t length);
+
+  /**
+   * Process a received record. Application data is decrypted in place
+   * and its length returned, 0 if the record carried none.
+   */
+  int (* input)(const uip_ipaddr_t *addr, uint16_t port,
+                uint8_t *data, uint16_t length);
+
+  /** Close a session, keeping what is needed to resume it. */
+  void (* close)(const uip_ipaddr_t *addr, uint16_t port);
+};
+
+#if COAP_DTLS
+extern const struct coap_dtls_driver COAP_DTLS_DRIVER;
+#endif /* COAP_DTLS */
+
+/**
+ * \brief Open the secure port. Called by the engine.
+ */
+void coap_dtls_init(void);
+
+/**
+ * \brief Handle a datagram if it was received on the secure port
+ * \return 1 if the datagram was for the secure port, 0 otherwise
+ */
+int coap_dtls_input(void);
+
+/**
+ * \brief Send a DTLS record as a datagram from the secure port. Used by
+ *        the driver.
+ */
+void coap_dtls_output(const uip_ipaddr_t *addr, uint16_t port,
+                      const uint8_t *data, uint16_t length);
+
+/**
+ * \brief Set the pre-shared key for a peer
+ * \return 1 on success, 0 if no DTLS driver is available
+ */
+int coap_dtls_set_psk(const uip_ipaddr_t *addr, uint16_t port,
+                      const uint8_t *identity, uint16_t identity_len,
+                      const uint8_t *key, uint16_t key_len);
+
+/**
+ * \brief Start or resume a secure session with a peer
+ * \return 1 on success, 0 if no DTLS driver is available
+ */
+int coap_dtls_connect(const uip_ipaddr_t *addr, uint16_t port);
+
+/**
+ * \brief Close the secure session with a peer
+ */
+void coap_dtls_close(const uip_ipaddr_t *addr, uint16_t port);
+
+/**
+ * \brief Send a serialized message in the session with a peer
+ * \return 1 if the peer has a session, 0 otherwise
+ */
+int coap_dtls_send(const uip_ipaddr_t *addr, uint16_t port,
+                   const uint8_t *data, uint16_t length);
+
+#endif /* COAP_DTLS_H_ */
@@ -41,6 +41,12 @@
 #include <stdlib.h>
 #include <string.h>
 #include "er-coap-engine.h"
+#include "er-coap-dedup.h"
+#include "er-coap-snapshot.h"
+#include "sys/compower.h"
+#include "sys/trace.h"
+#include "net/net-stats.h"
+#include "lib/random.h"
 
 #define DEBUG 0
 #if DEBUG
@@ -64,33 +70,39 @@ static service_callback_t service_cbk = NULL;
 /*---------------------------------------------------------------------------*/
 /*- Internal API ------------------------------------------------------------*/
 /*---------------------------------------------------------------------------*/
-static int
-coap_receive(void)
+int
+coap_receive(uint8_t *data, uint16_t length)
 {
   erbium_status_code = NO_ERROR;
 
-  PRINTF("handle_incoming_data(): received uip_datalen=%u \n",
-         (uint16_t)uip_datalen());
+  PRINTF("handle_incoming_data(): received length=%u \n", length);
 
   /* static declaration reduces stack peaks and program code size */
   static coap_packet_t message[1]; /* this way the packet can be treated as pointer as usual */
   static coap_packet_t response[1];
   static coap_transaction_t *transaction = NULL;
+  coap_dedup_entry_t *dedup = NULL;
+  uint16_t len;
+  /* a group request, sent to a multicast address (RFC 7390) */
+  uint8_t is_group = 0;
 
-  if(uip_newdata()) {
+  if(length > 0) {
 
-    PRINTF("receiving UDP datagram from: ");
+    PRINTF("receiving message from: ");
     PRINT6ADDR(&UIP_IP_BUF->srcipaddr);
     PRINTF(":%u\n  Length: %u\n", uip_ntohs(UIP_UDP_BUF->srcport),
-           uip_datalen());
+           length);
 
-    erbium_status_code =
-      coap_parse_message(message, uip_appdata, uip_datalen());
+#if COAP_GROUP_COMMUNICATION
+    /* group requests are never acknowledged, a CON one is served as NON */
+    is_group = uip_is_addr_mcast(&UIP_IP_BUF->destipaddr);
+#endif /* COAP_GROUP_COMMUNICATION */
 
-    if(erbium_status_code == NO_ERROR) {
+    erbium_status_code = coap_parse_message(message, data, length);
 
-      /*TODO duplicates suppression, if required by application */
+    if(erbium_status_code == NO_ERROR) {
 
+      TRACE(COAP_RECEIVE, message->code, message->mid);
       PRINTF("  Parsed: v %u, t %u, tkl %u, c %u, mid %u\n", message->version,
              message->type, message->token_len, message->code, message->mid);
       PRINTF("  URL: %.*s\n", message->uri_path_len, message->uri_path);
@@ -99,6 +111,22 @@ coap_receive(void)
       /* handle requests */
       if(message->code >= COAP_GET && message->code <= COAP_DELETE) {
 
+        /* duplicate suppression of retransmitted confirmable requests */
+        if(message->type == COAP_TYPE_CON && !is_group) {
+          dedup = coap_dedup_lookup(&UIP_IP_BUF->srcipaddr,
+                                    UIP_UDP_BUF->srcport, message->mid);
+          if(dedup != NULL && dedup->response_len > 0) {
+            PRINTF("Duplicate request - resending cached response\n");
+            coap_send_message(&UIP_IP_BUF->srcipaddr, UIP_UDP_BUF->srcport,
+                              dedup->response, dedup->response_len);
+            return erbium_status_code;
+          }
+          if(dedup == NULL) {
+            dedup = coap_dedup_add(&UIP_IP_BUF->srcipaddr,
+                                   UIP_UDP_BUF->srcport, message->mid);
+          }
+        }
+
         /* use transaction buffer for response to confirmable request */
         if((transaction =
               coap_new_transaction(message->mid, &UIP_IP_BUF->srcipaddr,
@@ -109,7 +137,7 @@ coap_receive(void)
           int32_t new_offset = 0;
 
           /* prepare response */
-          if(message->type == COAP_TYPE_CON) {
+          if(message->type == COAP_TYPE_CON && !is_group) {
             /* reliable CON requests are answered with an ACK */
             coap_init_message(response, COAP_TYPE_ACK, CONTENT_2_05,
                               message->mid);
@@ -233,11 +261,13 @@ coap_receive(void)
         } else if(message->type == COAP_TYPE_ACK) {
           /* transactions are closed through lookup below */
           PRINTF("Received ACK\n");
+          coap_clear_notification_transaction_by_mid(message->mid);
         } else if(message->type == COAP_TYPE_RST) {
           PRINTF("Received RST\n");
           /* cancel possible subscriptions */
           coap_remove_observer_by_mid(&UIP_IP_BUF->srcipaddr,
                                       UIP_UDP_BUF->srcport, message->mid);
+          coap_clear_notification_transaction_by_mid(message->mid);
         }
 
         if((transaction = coap_get_transaction_by_mid(message->mid))) {
@@ -245,6 +275,7 @@ coap_receive(void)
           restful_response_handler callback = transaction->callback;
           void *callback_data = transaction->callback_data;
 
+          coap_transaction_rtt_sample(transaction);
           coap_clear_transaction(transaction);
 
           /* check if someone registered for the response */
@@ -268,13 +299,34 @@ coap_receive(void)
     } /* parsed correctly */
 
     /* if(parsed correctly) */
-    if(erbium_status_code == NO_ERROR) {
-      if(transaction) {
+    if(is_group && erbium_status_code != MANUAL_RESPONSE
+       && (erbium_status_code != NO_ERROR
+           || response->code >= BAD_REQUEST_4_00)) {
+      /* errors are not reported to a group, other members may have
+         answered */
+      PRINTF("Suppressing error %u to group request\n",
+             erbium_status_code != NO_ERROR ? erbium_status_code
+             : response->code);
+      coap_clear_transaction(transaction);
+    } else if(erbium_status_code == NO_ERROR) {
+      if(transaction && is_group) {
+        /* spread the responses of the group members over the leisure */
+        coap_send_transaction_later(transaction,
+                                    random_rand() % COAP_GROUP_LEISURE_TICKS);
+      } else if(transaction) {
+        coap_dedup_set_response(dedup, transaction->packet,
+                                transaction->packet_len);
         coap_send_transaction(transaction);
       }
     } else if(erbium_status_code == MANUAL_RESPONSE) {
       PRINTF("Clearing transaction for manual response");
       coap_clear_transaction(transaction);
+      if(dedup != NULL) {
+        /* remember the empty ACK so retransmissions are not handled again */
+        coap_init_message(message, COAP_TYPE_ACK, 0, message->mid);
+        len = coap_serialize_message(message, data);
+        coap_dedup_set_response(dedup, data, len);
+      }
     } else {
       coap_message_type_t reply_type = COAP_TYPE_ACK;
 
@@ -293,11 +345,14 @@ coap_receive(void)
                         message->mid);
       coap_set_payload(message, coap_error_message,
                        strlen(coap_error_message));
+      len = coap_serialize_message(message, data);
+      coap_dedup_set_response(dedup, data, len);
       coap_send_message(&UIP_IP_BUF->srcipaddr, UIP_UDP_BUF->srcport,
-                        uip_appdata, coap_serialize_message(message,
-                                                            uip_appdata));
+                        data, len);
     }
   }
+  /* the response has been sent on behalf of its resource */
+  compower_set_flow(COMPOWER_FLOW_NONE);
 
   /* if(new data) */
   return erbium_status_code;
@@ -306,6 +361,7 @@ coap_receive(void)
 void
 coap_init_engine(void)
 {
+  coap_request_event = process_alloc_event();
   process_start(&coap_engine, NULL);
 }
 /*---------------------------------------------------------------------------*/
@@ -330,6 +386,9 @@ extern resource_t res_well_known_core;
 #ifdef WITH_DTLS
 extern resource_t res_dtls;
 #endif
+#if NET_STATS_ENABLED
+extern resource_t res_stats;
+#endif
 
 /*---------------------------------------------------------------------------*/
 PROCESS_THREAD(coap_engine, ev, data)
@@ -338,15 +397,21 @@ PROCESS_THREAD(coap_engine, ev, data)
   PRINTF("Starting %s receiver...\n", coap_rest_implementation.name);
 
   rest_activate_resource(&res_well_known_core, ".well-known/core");
+#if NET_STATS_ENABLED
+  rest_activate_resource(&res_stats, "stats");
+#endif
 
   coap_register_as_transaction_handler();
   coap_init_connection(SERVER_LISTEN_PORT);
+  coap_dtls_init();
 
   while(1) {
     PROCESS_YIELD();
 
     if(ev == tcpip_event) {
-      coap_receive();
+      if(uip_newdata() && !coap_dtls_input()) {
+        coap_receive(uip_appdata, uip_datalen());
+      }
     } else if(ev == PROCESS_EVENT_TIMER) {
       /* retransmissions are handled here */
       coap_check_transactions();
@@ -468,6 +533,7 @@ const struct rest_implementation coap_rest_implementation = {
 
   coap_notify_observers,
   coap_observe_handler,
+  coap_snapshot_handler,
 
   {
     CONTENT_2_05,
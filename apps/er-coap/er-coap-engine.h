@@ -45,6 +45,9 @@
 #include "er-coap-observe.h"
 #include "er-coap-separate.h"
 #include "er-coap-observe-client.h"
+#include "er-coap-request.h"
+#include "er-coap-tcp.h"
+#include "er-coap-dtls.h"
 
 #define SERVER_LISTEN_PORT      UIP_HTONS(COAP_SERVER_PORT)
 
@@ -52,6 +55,7 @@ typedef coap_packet_t rest_request_t;
 typedef coap_packet_t rest_response_t;
 
 void coap_init_engine(void);
+int coap_receive(uint8_t *data, uint16_t length);
 
 /*---------------------------------------------------------------------------*/
 /*- Client Part -------------------------------------------------------------*/
@@ -72,6 +72,12 @@
 MEMB(obs_subjects_memb, coap_observee_t, COAP_MAX_OBSERVEES);
 LIST(obs_subjects_list);
 
+/* Observees hashed by token, notifications are matched by token only */
+static coap_observee_t *obs_subjects_hash[COAP_OBSERVEE_HASH_SIZE];
+
+/* Half of the 24-bit Observe sequence number space */
+#define OBSERVE_HALF_RANGE (1UL << 23)
+
 /*----------------------------------------------------------------------------*/
 static size_t
 get_token(void *packet, const uint8_t **token)
@@ -94,6 +100,17 @@ set_token(void *packet, const uint8_t *token, size_t token_len)
   return coap_pkt->token_len;
 }
 /*----------------------------------------------------------------------------*/
+static coap_observee_t **
+token_bucket(const uint8_t *token, size_t token_len)
+{
+  uint8_t hash = 0;
+
+  while(token_len-- > 0) {
+    hash = (hash << 1 | hash >> 7) ^ token[token_len];
+  }
+  return &obs_subjects_hash[hash & (COAP_OBSERVEE_HASH_SIZE - 1)];
+}
+/*----------------------------------------------------------------------------*/
 coap_observee_t *
 coap_obs_add_observee(uip_ipaddr_t *addr, uint16_t port,
                       const uint8_t *token, size_t token_len, const char *url,
@@ -114,10 +131,14 @@ coap_obs_add_observee(uip_ipaddr_t *addr, uint16_t port,
     /* o->last_mid = 0; */
     o->notification_callback = notification_callback;
     o->data = data;
+    o->last_observe = 0;
+    o->last_time = clock_seconds();
     /* stimer_set(&o->refresh_timer, COAP_OBSERVING_REFRESH_INTERVAL); */
     PRINTF("Adding obs_subject for /%s [0x%02X%02X]\n", o->url, o->token[0],
            o->token[1]);
     list_add(obs_subjects_list, o);
+    o->hash_next = *token_bucket(o->token, o->token_len);
+    *token_bucket(o->token, o->token_len) = o;
   }
 
   return o;
@@ -126,20 +147,27 @@ coap_obs_add_observee(uip_ipaddr_t *addr, uint16_t port,
 void
 coap_obs_remove_observee(coap_observee_t *o)
 {
+  coap_observee_t **prev;
+
   PRINTF("Removing obs_subject for /%s [0x%02X%02X]\n", o->url, o->token[0],
          o->token[1]);
-  memb_free(&obs_subjects_memb, o);
+  for(prev = token_bucket(o->token, o->token_len); *prev != NULL;
+      prev = &(*prev)->hash_next) {
+    if(*prev == o) {
+      *prev = o->hash_next;
+      break;
+    }
+  }
   list_remove(obs_subjects_list, o);
+  memb_free(&obs_subjects_memb, o);
 }
 /*----------------------------------------------------------------------------*/
 coap_observee_t *
-coap_get_obs_subject_by_token(const uint8_t *token, size_t token_len)
+coap_obs_get_observee_by_token(const uint8_t *token, size_t token_len)
 {
-  coap_observee_t *obs = NULL;
+  coap_observee_t *obs;
 
-  for(obs = (coap_observee_t *)list_head(obs_subjects_list); obs;
-      obs = obs->next) {
-    PRINTF("Looking for token 0x%02X%02X\n", token[0], token[1]);
+  for(obs = *token_bucket(token, token_len); obs; obs = obs->hash_next) {
     if(obs->token_len == token_len
        && memcmp(obs->token, token, token_len) == 0) {
       return obs;
@@ -153,21 +181,14 @@ int
 coap_obs_remove_observee_by_token(uip_ipaddr_t *addr, uint16_t port,
                                   uint8_t *token, size_t token_len)
 {
-  int removed = 0;
-  coap_observee_t *obs = NULL;
+  coap_observee_t *obs;
 
-  for(obs = (coap_observee_t *)list_head(obs_subjects_list); obs;
-      obs = obs->next) {
-    PRINTF("Remove check Token 0x%02X%02X\n", token[0], token[1]);
-    if(uip_ipaddr_cmp(&obs->addr, addr)
-       && obs->port == port
-       && obs->token_len == token_len
-       && memcmp(obs->token, token, token_len) == 0) {
-      coap_obs_remove_observee(obs);
-      removed++;
-    }
+  obs = coap_obs_get_observee_by_token(token, token_len);
+  if(obs != NULL && uip_ipaddr_cmp(&obs->addr, addr) && obs->port == port) {
+    coap_obs_remove_observee(obs);
+    return 1;
   }
-  return removed;
+  return 0;
 }
 /*----------------------------------------------------------------------------*/
 int
@@ -175,10 +196,12 @@ coap_obs_remove_observee_by_url(uip_ipaddr_t *addr, uint16_t port,
                                 const char *url)
 {
   int removed = 0;
-  coap_observee_t *obs = NULL;
+  coap_observee_t *obs;
+  coap_observee_t *next;
 
   for(obs = (coap_observee_t *)list_head(obs_subjects_list); obs;
-      obs = obs->next) {
+      obs = next) {
+    next = obs->next;
     PRINTF("Remove check URL %s\n", url);
     if(uip_ipaddr_cmp(&obs->addr, addr)
        && obs->port == port
@@ -227,6 +250,20 @@ classify_notification(void *response, int first)
   return NOTIFICATION_OK;
 }
 /*----------------------------------------------------------------------------*/
+/*
+ * Check if a notification is newer than the last one received for the
+ * observee, following the ordering rules of RFC 7641, section 3.4.
+ */
+static int
+is_fresh(const coap_observee_t *obs, uint32_t observe, unsigned long now)
+{
+  uint32_t v1 = obs->last_observe;
+
+  return (v1 < observe && observe - v1 < OBSERVE_HALF_RANGE)
+    || (v1 > observe && v1 - observe > OBSERVE_HALF_RANGE)
+    || now - obs->last_time > COAP_OBSERVE_CLIENT_FRESHNESS;
+}
+/*----------------------------------------------------------------------------*/
 void
 coap_handle_notification(uip_ipaddr_t *addr, uint16_t port,
                          coap_packet_t *notification)
@@ -248,7 +285,7 @@ coap_handle_notification(uip_ipaddr_t *addr, uint16_t port,
     return;
   }
   PRINTF("Getting observee info\n");
-  obs = coap_get_obs_subject_by_token(token, token_len);
+  obs = coap_obs_get_observee_by_token(token, token_len);
   if(NULL == obs) {
     PRINTF("Error while handling coap observe notification: "
            "no matching token found\n");
@@ -260,15 +297,16 @@ coap_handle_notification(uip_ipaddr_t *addr, uint16_t port,
   }
   if(obs->notification_callback != NULL) {
     flag = classify_notification(notification, 0);
-    /* TODO: the following mechanism for discarding duplicates is too trivial */
-    /* refer to Observe RFC for a better solution */
     if(flag == NOTIFICATION_OK) {
+      unsigned long now = clock_seconds();
+
       coap_get_header_observe(notification, &observe);
-      if(observe == obs->last_observe) {
-        PRINTF("Discarding duplicate\n");
+      if(!is_fresh(obs, observe, now)) {
+        PRINTF("Discarding duplicate or reordered notification\n");
         return;
       }
       obs->last_observe = observe;
+      obs->last_time = now;
     }
     obs->notification_callback(obs, notification, flag);
   }
@@ -285,6 +323,10 @@ handle_obs_registration_response(void *data, void *response)
   obs = (coap_observee_t *)data;
   notification_callback = obs->notification_callback;
   flag = classify_notification(response, 1);
+  if(flag == OBSERVE_OK) {
+    coap_get_header_observe(response, &obs->last_observe);
+    obs->last_time = clock_seconds();
+  }
   if(notification_callback) {
     notification_callback(obs, response, flag);
   }
@@ -296,11 +338,15 @@ handle_obs_registration_response(void *data, void *response)
 uint8_t
 coap_generate_token(uint8_t **token_ptr)
 {
-  static uint8_t token = 0;
+  static uint8_t token[2];
 
-  token++;
-  /* FIXME: we should check that this token is not already used */
-  *token_ptr = (uint8_t *)&token;
+  /* skip tokens of observees that are still active */
+  do {
+    if(++token[1] == 0) {
+      token[0]++;
+    }
+  } while(coap_obs_get_observee_by_token(token, sizeof(token)) != NULL);
+  *token_ptr = token;
   return sizeof(token);
 }
 /*----------------------------------------------------------------------------*/
@@ -53,6 +53,23 @@
 #define COAP_MAX_OBSERVEES      4
 #endif /* COAP_CONF_MAX_OBSERVEES */
 
+/* Number of token hash buckets used to look up observees, a power of two */
+#ifdef COAP_CONF_OBSERVEE_HASH_SIZE
+#define COAP_OBSERVEE_HASH_SIZE COAP_CONF_OBSERVEE_HASH_SIZE
+#else
+#define COAP_OBSERVEE_HASH_SIZE 16
+#endif /* COAP_CONF_OBSERVEE_HASH_SIZE */
+
+/*
+ * Seconds after which a notification is considered fresh regardless of
+ * its Observe sequence number (RFC 7641, section 3.4).
+ */
+#ifdef COAP_CONF_OBSERVE_CLIENT_FRESHNESS
+#define COAP_OBSERVE_CLIENT_FRESHNESS COAP_CONF_OBSERVE_CLIENT_FRESHNESS
+#else
+#define COAP_OBSERVE_CLIENT_FRESHNESS 128
+#endif /* COAP_CONF_OBSERVE_CLIENT_FRESHNESS */
+
 #if COAP_MAX_OPEN_TRANSACTIONS < COAP_MAX_OBSERVEES
 #warning "COAP_MAX_OPEN_TRANSACTIONS smaller than COAP_MAX_OBSERVEES: " \
   "this may be a problem"
@@ -79,6 +96,7 @@ typedef void (*notification_callback_t)(coap_observee_t *subject,
 
 struct coap_observee_s {
   coap_observee_t *next;        /* for LIST */
+  coap_observee_t *hash_next;   /* next in the token hash bucket */
   uip_ipaddr_t addr;
   uint16_t port;
   const char *url;
@@ -87,6 +105,7 @@ struct coap_observee_s {
   void *data;                   /* generic pointer for storing user data */
   notification_callback_t notification_callback;
   uint32_t last_observe;
+  unsigned long last_time;      /* clock_seconds() of the last notification */
 };
 
 /*----------------------------------------------------------------------------*/
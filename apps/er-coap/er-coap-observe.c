@@ -39,6 +39,8 @@
 #include <stdio.h>
 #include <string.h>
 #include "er-coap-observe.h"
+#include "sys/compower.h"
+#include "net/latency-trace.h"
 
 #define DEBUG 0
 #if DEBUG
@@ -55,13 +57,51 @@
 /*---------------------------------------------------------------------------*/
 MEMB(observers_memb, coap_observer_t, COAP_MAX_OBSERVERS);
 LIST(observers_list);
+
+/* Observers bucketed on their resource */
+static coap_observer_t *resource_buckets[COAP_OBSERVER_RESOURCE_BUCKETS];
+
+/*
+ * The packets of the notifications being generated, kept off the stack.
+ * A resource handler can notify observers of its own, so notifications
+ * nest, at most as deep as there are shared packets to generate them in.
+ */
+typedef struct notify_context {
+  coap_packet_t request[1];
+  coap_packet_t notification[1];
+  char url[COAP_OBSERVER_URL_LEN];
+} notify_context_t;
+
+static notify_context_t notify_contexts[COAP_MAX_SHARED_PACKETS];
+static uint8_t notify_depth;
 /*---------------------------------------------------------------------------*/
 /*- Internal API ------------------------------------------------------------*/
 /*---------------------------------------------------------------------------*/
+static uint16_t
+hash_url(const char *url, int len)
+{
+  uint16_t hash = 0;
+  int i;
+  for(i = 0; i < len; i++) {
+    hash = hash * 31 + (uint8_t)url[i];
+  }
+  return hash;
+}
+/*---------------------------------------------------------------------------*/
+static coap_observer_t **
+get_bucket(const resource_t *resource)
+{
+  return &resource_buckets[((uintptr_t)resource >> 2)
+                           % COAP_OBSERVER_RESOURCE_BUCKETS];
+}
+/*---------------------------------------------------------------------------*/
 static coap_observer_t *
-add_observer(uip_ipaddr_t *addr, uint16_t port, const uint8_t *token,
-             size_t token_len, const char *uri, int uri_len)
+add_observer(resource_t *resource, uip_ipaddr_t *addr, uint16_t port,
+             const uint8_t *token, size_t token_len,
+             const char *uri, int uri_len)
 {
+  coap_observer_t **bucket;
+
   /* Remove existing observe relationship, if any. */
   coap_remove_observer_by_uri(addr, port, uri);
 
@@ -74,6 +114,9 @@ add_observer(uip_ipaddr_t *addr, uint16_t port, const uint8_t *token,
     }
     memcpy(o->url, uri, max);
     o->url[max] = 0;
+    o->url_len = max;
+    o->url_hash = hash_url(o->url, max);
+    o->resource = resource;
     uip_ipaddr_copy(&o->addr, addr);
     o->port = port;
     o->token_len = token_len;
@@ -84,19 +127,38 @@ add_observer(uip_ipaddr_t *addr, uint16_t port, const uint8_t *token,
            list_length(observers_list) + 1, COAP_MAX_OBSERVERS,
            o->url, o->token[0], o->token[1]);
     list_add(observers_list, o);
+
+    bucket = get_bucket(resource);
+    o->resource_next = *bucket;
+    *bucket = o;
   }
 
   return o;
 }
 /*---------------------------------------------------------------------------*/
+list_t
+coap_get_observers(void)
+{
+  return observers_list;
+}
+/*---------------------------------------------------------------------------*/
 /*- Removal -----------------------------------------------------------------*/
 /*---------------------------------------------------------------------------*/
 void
 coap_remove_observer(coap_observer_t *o)
 {
+  coap_observer_t **r;
+
   PRINTF("Removing observer for /%s [0x%02X%02X]\n", o->url, o->token[0],
          o->token[1]);
 
+  for(r = get_bucket(o->resource); *r != NULL; r = &(*r)->resource_next) {
+    if(*r == o) {
+      *r = o->resource_next;
+      break;
+    }
+  }
+
   memb_free(&observers_memb, o);
   list_remove(observers_list, o);
 }
@@ -152,7 +214,7 @@ coap_remove_observer_by_uri(uip_ipaddr_t *addr, uint16_t port,
     PRINTF("Remove check URL %p\n", uri);
     if((addr == NULL
         || (uip_ipaddr_cmp(&obs->addr, addr) && obs->port == port))
-       && (obs->url == uri || memcmp(obs->url, uri, strlen(obs->url)) == 0)) {
+       && (obs->url == uri || memcmp(obs->url, uri, obs->url_len) == 0)) {
       coap_remove_observer(obs);
       removed++;
     }
@@ -185,17 +247,111 @@ coap_notify_observers(resource_t *resource)
 {
   coap_notify_observers_sub(resource, NULL);
 }
+/*
+ * Generate the notification once into a shared packet. The Observe option
+ * is serialized with three bytes to allow the sequence number of each
+ * observer to be patched in when sent.
+ */
+static coap_shared_packet_t *
+create_notification(resource_t *resource, notify_context_t *ctx)
+{
+  coap_packet_t *const notification = ctx->notification;
+  coap_shared_packet_t *shared;
+
+  shared = coap_new_shared_packet();
+  if(shared == NULL) {
+    PRINTF("Observe: no free shared notification buffer\n");
+    return NULL;
+  }
+
+  coap_init_message(notification, COAP_TYPE_NON, CONTENT_2_05, 0);
+  resource->get_handler(ctx->request, notification,
+                        shared->packet + COAP_MAX_HEADER_SIZE,
+                        REST_MAX_CHUNK_SIZE, NULL);
+  LATENCY_TRACE_STAMP(LATENCY_TRACE_FORMATTED);
+
+  if(notification->code < BAD_REQUEST_4_00) {
+    coap_set_header_observe(notification, 0x800000);
+  }
+
+  shared->packet_len = coap_serialize_message(notification, shared->packet);
+  LATENCY_TRACE_STAMP(LATENCY_TRACE_SERIALIZED);
+  if(shared->packet_len == 0 || !coap_finalize_shared_packet(shared)) {
+    coap_release_shared_packet(shared);
+    return NULL;
+  }
+  return shared;
+}
+/*---------------------------------------------------------------------------*/
+static notify_context_t *
+get_notify_context(void)
+{
+  if(notify_depth >= COAP_MAX_SHARED_PACKETS) {
+    PRINTF("Observe: notifications nested too deep\n");
+    return NULL;
+  }
+  return &notify_contexts[notify_depth++];
+}
+/*---------------------------------------------------------------------------*/
+static void
+init_notification_request(coap_packet_t *request, const char *url,
+                          uint16_t accept)
+{
+  /* create a "fake" request for the URI */
+  coap_init_message(request, COAP_TYPE_CON, COAP_GET, 0);
+  coap_set_header_uri_path(request, url);
+  if(accept != COAP_OBSERVER_NO_ACCEPT) {
+    coap_set_header_accept(request, accept);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+notify_observer(coap_observer_t *obs, coap_shared_packet_t *shared)
+{
+  coap_message_type_t type = COAP_TYPE_NON;
+  uint16_t mid;
+
+  if(obs->obs_counter % COAP_OBSERVE_REFRESH_INTERVAL == 0) {
+    PRINTF("           Force Confirmable for\n");
+    type = COAP_TYPE_CON;
+  }
+
+  PRINTF("           Observer ");
+  PRINT6ADDR(&obs->addr);
+  PRINTF(":%u\n", obs->port);
+
+  mid = coap_get_mid();
+  if(coap_send_shared_packet(shared, type, mid, &obs->addr, obs->port,
+                             obs->token, obs->token_len,
+                             obs->obs_counter & 0xFFFFFF)) {
+    /* update last MID for RST matching */
+    obs->last_mid = mid;
+    if(shared->observe_offset > 0) {
+      obs->obs_counter++;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
 void
 coap_notify_observers_sub(resource_t *resource, const char *subpath)
 {
-  /* build notification */
-  coap_packet_t notification[1]; /* this way the packet can be treated as pointer as usual */
-  coap_packet_t request[1]; /* this way the packet can be treated as pointer as usual */
+  notify_context_t *ctx;
+  coap_shared_packet_t *shared = NULL;
   coap_observer_t *obs = NULL;
   int url_len, obs_url_len;
-  char url[COAP_OBSERVER_URL_LEN];
+  uint16_t url_hash;
+  uint16_t shared_accept = COAP_OBSERVER_NO_ACCEPT;
+  uint16_t flow;
+  char *url;
+
+  if((ctx = get_notify_context()) == NULL) {
+    return;
+  }
+  url = ctx->url;
+  flow = compower_get_flow();
+  compower_set_flow(rest_get_resource_flow(resource));
 
-  url_len = strlen(resource->url);
+  url_len = resource->url_len;
   strncpy(url, resource->url, COAP_OBSERVER_URL_LEN - 1);
   if(url_len < COAP_OBSERVER_URL_LEN - 1 && subpath != NULL) {
     strncpy(&url[url_len], subpath, COAP_OBSERVER_URL_LEN - url_len - 1);
@@ -205,60 +361,70 @@ coap_notify_observers_sub(resource_t *resource, const char *subpath)
   /* url now contains the notify URL that needs to match the observer */
   PRINTF("Observe: Notification from %s\n", url);
 
-  coap_init_message(notification, COAP_TYPE_NON, CONTENT_2_05, 0);
-  /* create a "fake" request for the URI */
-  coap_init_message(request, COAP_TYPE_CON, COAP_GET, 0);
-  coap_set_header_uri_path(request, url);
-
-  /* iterate over observers */
+  /* iterate over the observers of this resource */
   url_len = strlen(url);
-  for(obs = (coap_observer_t *)list_head(observers_list); obs;
-      obs = obs->next) {
-    obs_url_len = strlen(obs->url);
+  url_hash = hash_url(url, url_len);
+  for(obs = *get_bucket(resource); obs; obs = obs->resource_next) {
+    if(obs->resource != resource) {
+      continue;
+    }
+    obs_url_len = obs->url_len;
 
     /* Do a match based on the parent/sub-resource match so that it is
        possible to do parent-node observe */
-    if((obs_url_len == url_len
+    if(((obs_url_len == url_len && obs->url_hash == url_hash)
         || (obs_url_len > url_len
             && (resource->flags & HAS_SUB_RESOURCES)
             && obs->url[url_len] == '/'))
        && strncmp(url, obs->url, url_len) == 0) {
-      coap_transaction_t *transaction = NULL;
-
-      /*TODO implement special transaction for CON, sharing the same buffer to allow for more observers */
-
-      if((transaction = coap_new_transaction(coap_get_mid(), &obs->addr, obs->port))) {
-        if(obs->obs_counter % COAP_OBSERVE_REFRESH_INTERVAL == 0) {
-          PRINTF("           Force Confirmable for\n");
-          notification->type = COAP_TYPE_CON;
+      /*
+       * The notification is generated once and shared by all observers
+       * that requested the same content format.
+       */
+      if(shared != NULL && obs->accept != shared_accept) {
+        coap_release_shared_packet(shared);
+        shared = NULL;
+      }
+      if(shared == NULL) {
+        shared_accept = obs->accept;
+        init_notification_request(ctx->request, url, shared_accept);
+        if((shared = create_notification(resource, ctx)) == NULL) {
+          break;
         }
+      }
+      notify_observer(obs, shared);
+    }
+  }
+  coap_release_shared_packet(shared);
+  compower_set_flow(flow);
+  notify_depth--;
+}
+/*---------------------------------------------------------------------------*/
+void
+coap_notify_observer(resource_t *resource, coap_observer_t *obs)
+{
+  notify_context_t *ctx;
+  coap_shared_packet_t *shared;
+  uint16_t flow;
 
-        PRINTF("           Observer ");
-        PRINT6ADDR(&obs->addr);
-        PRINTF(":%u\n", obs->port);
-
-        /* update last MID for RST matching */
-        obs->last_mid = transaction->mid;
-
-        /* prepare response */
-        notification->mid = transaction->mid;
-
-        resource->get_handler(request, notification,
-                              transaction->packet + COAP_MAX_HEADER_SIZE,
-                              REST_MAX_CHUNK_SIZE, NULL);
+  PRINTF("Observe: Notification for %s\n", obs->url);
 
-        if(notification->code < BAD_REQUEST_4_00) {
-          coap_set_header_observe(notification, (obs->obs_counter)++);
-        }
-        coap_set_token(notification, obs->token, obs->token_len);
+  if((ctx = get_notify_context()) == NULL) {
+    return;
+  }
+  flow = compower_get_flow();
+  compower_set_flow(rest_get_resource_flow(resource));
 
-        transaction->packet_len =
-          coap_serialize_message(notification, transaction->packet);
+  /* create a "fake" request for the URI of the observer */
+  init_notification_request(ctx->request, obs->url, obs->accept);
 
-        coap_send_transaction(transaction);
-      }
-    }
+  shared = create_notification(resource, ctx);
+  if(shared != NULL) {
+    notify_observer(obs, shared);
+    coap_release_shared_packet(shared);
   }
+  compower_set_flow(flow);
+  notify_depth--;
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -271,10 +437,14 @@ coap_observe_handler(resource_t *resource, void *request, void *response)
   if(coap_req->code == COAP_GET && coap_res->code < 128) { /* GET request and response without error code */
     if(IS_OPTION(coap_req, COAP_OPTION_OBSERVE)) {
       if(coap_req->observe == 0) {
-        obs = add_observer(&UIP_IP_BUF->srcipaddr, UIP_UDP_BUF->srcport,
+        obs = add_observer(resource,
+                           &UIP_IP_BUF->srcipaddr, UIP_UDP_BUF->srcport,
                            coap_req->token, coap_req->token_len,
                            coap_req->uri_path, coap_req->uri_path_len);
        if(obs) {
+          /* Notifications use the content format of the observe request */
+          obs->accept = IS_OPTION(coap_req, COAP_OPTION_ACCEPT)
+            ? coap_req->accept : COAP_OBSERVER_NO_ACCEPT;
           coap_set_header_observe(coap_res, (obs->obs_counter)++);
           /*
            * Following payload is for demonstration purposes only.
@@ -43,7 +43,18 @@
 #include "er-coap-transactions.h"
 #include "stimer.h"
 
+/* The longest url observed, including the terminating zero */
+#ifndef COAP_OBSERVER_URL_LEN
 #define COAP_OBSERVER_URL_LEN 20
+#endif /* COAP_OBSERVER_URL_LEN */
+
+/* Number of buckets used for looking up the observers of a resource */
+#ifndef COAP_OBSERVER_RESOURCE_BUCKETS
+#define COAP_OBSERVER_RESOURCE_BUCKETS 4
+#endif /* COAP_OBSERVER_RESOURCE_BUCKETS */
+
+/* Used as accept for observers that did not request a content format */
+#define COAP_OBSERVER_NO_ACCEPT 0xffff
 
 typedef struct coap_observable {
   uint32_t observe_clock;
@@ -55,8 +66,13 @@ typedef struct coap_observable {
 
 typedef struct coap_observer {
   struct coap_observer *next;   /* for LIST */
+  struct coap_observer *resource_next;  /* next in the resource bucket */
+  resource_t *resource;
 
   char url[COAP_OBSERVER_URL_LEN];
+  uint8_t url_len;
+  uint16_t url_hash;
+  uint16_t accept;              /* content format requested by the observer */
   uip_ipaddr_t addr;
   uint16_t port;
   uint8_t token_len;
@@ -81,6 +97,7 @@ int coap_remove_observer_by_mid(uip_ipaddr_t *addr, uint16_t port,
 
 void coap_notify_observers(resource_t *resource);
 void coap_notify_observers_sub(resource_t *resource, const char *subpath);
+void coap_notify_observer(resource_t *resource, coap_observer_t *obs);
 
 void coap_observe_handler(resource_t *resource, void *request,
                           void *response);
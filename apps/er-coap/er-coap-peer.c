@@ -0,0 +1,239 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *      CoAP module for per-peer congestion control
+ */
+
+#include <string.h>
+#include "contiki.h"
+#include "lib/random.h"
+#include "er-coap-peer.h"
+#include "er-coap-transactions.h"
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+/* RTO used for unknown peers, the fixed timeout of RFC 7252 */
+#define INITIAL_RTO ((uint32_t)COAP_RESPONSE_TIMEOUT_TICKS)
+#define MAX_RTO     ((uint32_t)COAP_PEER_MAX_RTO * CLOCK_SECOND)
+
+#if COAP_PEER_CACHE_SIZE > 0
+static coap_peer_t peers[COAP_PEER_CACHE_SIZE];
+/*---------------------------------------------------------------------------*/
+static coap_peer_t *
+lookup(const uip_ipaddr_t *addr)
+{
+  int i;
+
+  for(i = 0; i < COAP_PEER_CACHE_SIZE; i++) {
+    if(peers[i].used && uip_ipaddr_cmp(&peers[i].addr, addr)) {
+      return &peers[i];
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Find a peer or replace the least recently used one. Peers with
+ * outstanding exchanges are never replaced.
+ */
+static coap_peer_t *
+lookup_or_add(const uip_ipaddr_t *addr)
+{
+  coap_peer_t *p = lookup(addr);
+  coap_peer_t *oldest = NULL;
+  clock_time_t now;
+  int i;
+
+  if(p != NULL) {
+    return p;
+  }
+
+  now = clock_time();
+  for(i = 0; i < COAP_PEER_CACHE_SIZE; i++) {
+    if(!peers[i].used) {
+      oldest = &peers[i];
+      break;
+    }
+    if(peers[i].outstanding == 0 &&
+       (oldest == NULL || (clock_time_t)(now - peers[i].updated) >
+        (clock_time_t)(now - oldest->updated))) {
+      oldest = &peers[i];
+    }
+  }
+
+  if(oldest != NULL) {
+    memset(oldest, 0, sizeof(coap_peer_t));
+    uip_ipaddr_copy(&oldest->addr, addr);
+    oldest->used = 1;
+    oldest->rto = INITIAL_RTO;
+    oldest->updated = now;
+  }
+  return oldest;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Let an RTO that has not been updated for a while move back towards
+ * the initial RTO: a small one doubles after 16 RTOs, a large one is
+ * averaged with the initial one after 4 RTOs.
+ */
+static void
+age_rto(coap_peer_t *p, clock_time_t now)
+{
+  uint32_t idle = (clock_time_t)(now - p->updated);
+
+  if(p->rto < CLOCK_SECOND && idle > 16 * p->rto) {
+    p->rto *= 2;
+    p->updated = now;
+  } else if(p->rto > 3 * (uint32_t)CLOCK_SECOND && idle > 4 * p->rto) {
+    p->rto = (p->rto + INITIAL_RTO) / 2;
+    p->updated = now;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static uint32_t
+update_estimator(uint32_t *srtt, uint32_t *rttvar, uint32_t rtt, uint8_t k)
+{
+  uint32_t delta;
+
+  if(*srtt == 0) {
+    *srtt = rtt;
+    *rttvar = rtt / 2;
+  } else {
+    delta = rtt > *srtt ? rtt - *srtt : *srtt - rtt;
+    *rttvar = (3 * *rttvar + delta) / 4;
+    *srtt = (7 * *srtt + rtt) / 8;
+  }
+  return *srtt + (k * *rttvar > 0 ? k * *rttvar : 1);
+}
+#endif /* COAP_PEER_CACHE_SIZE > 0 */
+/*---------------------------------------------------------------------------*/
+clock_time_t
+coap_peer_initial_timeout(const uip_ipaddr_t *addr, uint8_t *backoff)
+{
+  uint32_t rto = INITIAL_RTO;
+#if COAP_PEER_CACHE_SIZE > 0
+  coap_peer_t *p = lookup(addr);
+
+  if(p != NULL) {
+    age_rto(p, clock_time());
+    rto = p->rto;
+  }
+#endif /* COAP_PEER_CACHE_SIZE > 0 */
+
+  /* variable backoff factor, in halves */
+  if(rto < CLOCK_SECOND) {
+    *backoff = 6;
+  } else if(rto > 3 * (uint32_t)CLOCK_SECOND) {
+    *backoff = 3;
+  } else {
+    *backoff = 4;
+  }
+
+  /* randomized between RTO and RTO * COAP_RESPONSE_RANDOM_FACTOR */
+  if(rto == INITIAL_RTO) {
+    return rto + (random_rand() %
+                  (clock_time_t)COAP_RESPONSE_TIMEOUT_BACKOFF_MASK);
+  }
+  return rto + (random_rand() % (rto / 2 + 1));
+}
+/*---------------------------------------------------------------------------*/
+void
+coap_peer_rtt_sample(const uip_ipaddr_t *addr, clock_time_t rtt,
+                     uint8_t retransmissions)
+{
+#if COAP_PEER_CACHE_SIZE > 0
+  coap_peer_t *p;
+  uint32_t estimate;
+
+  /* the source of a response after many retransmissions is ambiguous */
+  if(retransmissions > 2 || (p = lookup_or_add(addr)) == NULL) {
+    return;
+  }
+
+  if(rtt == 0) {
+    rtt = 1;
+  }
+
+  if(retransmissions == 0) {
+    estimate = update_estimator(&p->strong_srtt, &p->strong_rttvar, rtt, 4);
+    p->rto = (estimate + p->rto) / 2;
+  } else {
+    estimate = update_estimator(&p->weak_srtt, &p->weak_rttvar, rtt, 1);
+    p->rto = (estimate + 3 * p->rto) / 4;
+  }
+
+  if(p->rto > MAX_RTO) {
+    p->rto = MAX_RTO;
+  }
+  p->updated = clock_time();
+
+  PRINTF("CoAP peer: RTT %lu (%u), RTO %lu\n", (unsigned long)rtt,
+         retransmissions, (unsigned long)p->rto);
+#endif /* COAP_PEER_CACHE_SIZE > 0 */
+}
+/*---------------------------------------------------------------------------*/
+int
+coap_peer_start_exchange(const uip_ipaddr_t *addr)
+{
+#if COAP_PEER_CACHE_SIZE > 0
+  coap_peer_t *p = lookup_or_add(addr);
+
+  /* not limited if all peers are busy and none could be replaced */
+  if(p != NULL) {
+    if(p->outstanding >= COAP_NSTART) {
+      PRINTF("CoAP peer: NSTART reached\n");
+      return 0;
+    }
+    p->outstanding++;
+  }
+#endif /* COAP_PEER_CACHE_SIZE > 0 */
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+coap_peer_end_exchange(const uip_ipaddr_t *addr)
+{
+#if COAP_PEER_CACHE_SIZE > 0
+  coap_peer_t *p = lookup(addr);
+
+  if(p != NULL && p->outstanding > 0) {
+    p->outstanding--;
+  }
+#endif /* COAP_PEER_CACHE_SIZE > 0 */
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *      CoAP module for per-peer congestion control.
+ *
+ *      A small cache of peers keeps round-trip time estimates used to
+ *      adapt the retransmission timeout to each destination (CoCoA),
+ *      and counts the outstanding confirmable exchanges to bound them
+ *      to COAP_NSTART.
+ */
+
+#ifndef COAP_PEER_H_
+#define COAP_PEER_H_
+
+#include "er-coap.h"
+
+/* The number of remembered peers, 0 disables adaptive timeouts and NSTART */
+#ifndef COAP_PEER_CACHE_SIZE
+#define COAP_PEER_CACHE_SIZE           4
+#endif /* COAP_PEER_CACHE_SIZE */
+
+/* Maximum number of outstanding confirmable exchanges per peer */
+#ifndef COAP_NSTART
+#define COAP_NSTART                    1
+#endif /* COAP_NSTART */
+
+/* Upper bound of the adaptive retransmission timeout in seconds */
+#ifndef COAP_PEER_MAX_RTO
+#define COAP_PEER_MAX_RTO              60
+#endif /* COAP_PEER_MAX_RTO */
+
+typedef struct coap_peer {
+  uip_ipaddr_t addr;
+  uint8_t used;
+  uint8_t outstanding;          /* confirmable exchanges in progress */
+  uint32_t rto;                 /* overall RTO in clock ticks */
+  uint32_t strong_srtt;
+  uint32_t strong_rttvar;
+  uint32_t weak_srtt;
+  uint32_t weak_rttvar;
+  clock_time_t updated;         /* time of last RTO update or use */
+} coap_peer_t;
+
+/**
+ * \brief Get the timeout before the first retransmission to a peer
+ * \param addr The address of the peer
+ * \param backoff Set to the backoff factor, in halves, for later
+ *        retransmissions
+ * \return The timeout in clock ticks
+ */
+clock_time_t coap_peer_initial_timeout(const uip_ipaddr_t *addr,
+                                       uint8_t *backoff);
+
+/**
+ * \brief Update the RTT estimates of a peer with a new measurement
+ * \param addr The address of the peer
+ * \param rtt The time since the first transmission of the message
+ * \param retransmissions The number of retransmissions of the message
+ */
+void coap_peer_rtt_sample(const uip_ipaddr_t *addr, clock_time_t rtt,
+                          uint8_t retransmissions);
+
+/**
+ * \brief Start a confirmable exchange with a peer
+ * \return 1 if the exchange may start, 0 if COAP_NSTART exchanges
+ *         already are outstanding
+ */
+int coap_peer_start_exchange(const uip_ipaddr_t *addr);
+
+/**
+ * \brief End a confirmable exchange started with coap_peer_start_exchange()
+ */
+void coap_peer_end_exchange(const uip_ipaddr_t *addr);
+
+#endif /* COAP_PEER_H_ */
@@ -0,0 +1,433 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *      CoAP forward proxy with a response cache
+ */
+
+#include <string.h>
+#include "contiki.h"
+#include "contiki-net.h"
+#include "er-coap-engine.h"
+#include "er-coap-proxy.h"
+#include "rest-engine.h"
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+#if COAP_PROXY_OPTION_PROCESSING
+
+typedef struct proxy_fetch proxy_fetch_t;
+
+typedef struct proxy_entry {
+  char uri[COAP_PROXY_URI_SIZE];
+  uint8_t uri_len;              /* 0 if the entry is unused */
+  uint8_t valid;                /* the payload holds a 2.05 response */
+  uint8_t etag_len;
+  uint8_t etag[COAP_ETAG_LEN];
+  int content_format;           /* -1 if none */
+  unsigned long expires;        /* clock_seconds() when no longer fresh */
+  proxy_fetch_t *fetch;         /* outstanding origin request or NULL */
+  uint16_t payload_len;
+  uint8_t payload[COAP_PROXY_RESPONSE_SIZE];
+} proxy_entry_t;
+
+struct proxy_fetch {
+  coap_request_state_t state;
+  coap_packet_t request[1];
+  proxy_entry_t *entry;         /* NULL if the fetch is unused */
+  char path[COAP_PROXY_URI_SIZE];
+  uint8_t code;
+  uint8_t too_large;
+  uint32_t max_age;
+  coap_separate_slot_t *waiters[COAP_PROXY_MAX_WAITERS];
+};
+
+static proxy_entry_t cache[COAP_PROXY_CACHE_SIZE];
+static proxy_fetch_t fetches[COAP_PROXY_MAX_FETCHES];
+
+static void res_get_handler(void *request, void *response, uint8_t *buffer,
+                            uint16_t preferred_size, int32_t *offset);
+
+RESOURCE(res_coap_proxy, "", res_get_handler, NULL, NULL, NULL);
+/*---------------------------------------------------------------------------*/
+static proxy_entry_t *
+lookup_entry(const char *uri, int uri_len)
+{
+  int i;
+
+  for(i = 0; i < COAP_PROXY_CACHE_SIZE; i++) {
+    if(cache[i].uri_len == uri_len && memcmp(cache[i].uri, uri, uri_len) == 0) {
+      return &cache[i];
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static proxy_entry_t *
+alloc_entry(const char *uri, int uri_len)
+{
+  proxy_entry_t *entry = NULL;
+  int i;
+
+  /* take an unused entry or replace the one that expires first */
+  for(i = 0; i < COAP_PROXY_CACHE_SIZE; i++) {
+    if(cache[i].uri_len == 0) {
+      entry = &cache[i];
+      break;
+    }
+    if(cache[i].fetch == NULL
+       && (entry == NULL || (long)(cache[i].expires - entry->expires) < 0)) {
+      entry = &cache[i];
+    }
+  }
+  if(entry != NULL) {
+    memcpy(entry->uri, uri, uri_len);
+    entry->uri_len = uri_len;
+    entry->valid = 0;
+    entry->etag_len = 0;
+    entry->payload_len = 0;
+  }
+  return entry;
+}
+/*---------------------------------------------------------------------------*/
+static int
+is_fresh(const proxy_entry_t *entry)
+{
+  return entry->valid && (long)(entry->expires - clock_seconds()) > 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Add the cached representation to a response, from the given offset */
+static int
+set_cached_response(void *response, const proxy_entry_t *entry,
+                    int32_t offset, uint16_t size)
+{
+  coap_set_header_max_age(response, entry->expires - clock_seconds());
+  if(entry->etag_len > 0) {
+    coap_set_header_etag(response, entry->etag, entry->etag_len);
+  }
+  if(entry->content_format >= 0) {
+    coap_set_header_content_format(response, entry->content_format);
+  }
+  if(offset >= entry->payload_len && entry->payload_len > 0) {
+    return 0;
+  }
+  coap_set_payload(response, entry->payload + offset,
+                   MIN(size, entry->payload_len - offset));
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+respond_waiter(coap_separate_slot_t *slot, const proxy_entry_t *entry,
+               uint8_t code)
+{
+  coap_packet_t response[1];
+  uint32_t offset;
+
+  coap_separate_resume(response, &slot->store, code);
+  if(code == CONTENT_2_05) {
+    offset = slot->store.block2_num * slot->store.block2_size;
+    if(!set_cached_response(response, entry, offset,
+                            slot->store.block2_size)) {
+      coap_separate_resume(response, &slot->store, BAD_OPTION_4_02);
+    } else if(entry->payload_len > slot->store.block2_size) {
+      coap_set_header_block2(response, slot->store.block2_num,
+                             offset + slot->store.block2_size <
+                             entry->payload_len,
+                             slot->store.block2_size);
+    }
+  }
+  coap_separate_pool_send(slot, response);
+}
+/*---------------------------------------------------------------------------*/
+static void
+waiter_timeout(coap_separate_slot_t *slot, void *user_data)
+{
+  proxy_fetch_t *fetch = user_data;
+  int i;
+
+  for(i = 0; i < COAP_PROXY_MAX_WAITERS; i++) {
+    if(fetch->waiters[i] == slot) {
+      fetch->waiters[i] = NULL;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+add_waiter(proxy_fetch_t *fetch, void *request)
+{
+  int i;
+
+  for(i = 0; i < COAP_PROXY_MAX_WAITERS; i++) {
+    if(fetch->waiters[i] == NULL) {
+      fetch->waiters[i] = coap_separate_pool_accept(request, waiter_timeout,
+                                                    fetch);
+      return;
+    }
+  }
+  coap_separate_reject();
+}
+/*---------------------------------------------------------------------------*/
+static void
+fetch_callback(coap_request_state_t *state)
+{
+  proxy_fetch_t *fetch = state->user_data;
+  proxy_entry_t *entry = fetch->entry;
+  coap_packet_t *response = state->response;
+  const uint8_t *data;
+  unsigned int format;
+  int len;
+  int i;
+
+  if(state->status == COAP_REQUEST_STATUS_RESPONSE) {
+    if(state->block_num == 0) {
+      fetch->code = response->code;
+      if(!coap_get_header_max_age(response, &fetch->max_age)) {
+        fetch->max_age = COAP_DEFAULT_MAX_AGE;
+      }
+      if(fetch->code == VALID_2_03) {
+        /* the cached representation is still valid */
+        return;
+      }
+      entry->valid = 0;
+      entry->payload_len = 0;
+      entry->etag_len = coap_get_header_etag(response, &data);
+      if(entry->etag_len > 0) {
+        memcpy(entry->etag, data, entry->etag_len);
+      }
+      entry->content_format = -1;
+      if(coap_get_header_content_format(response, &format)) {
+        entry->content_format = format;
+      }
+    }
+    len = coap_get_payload(response, &data);
+    if(entry->payload_len + len > COAP_PROXY_RESPONSE_SIZE) {
+      fetch->too_large = 1;
+    } else {
+      memcpy(entry->payload + entry->payload_len, data, len);
+      entry->payload_len += len;
+    }
+    return;
+  }
+
+  if(state->status != COAP_REQUEST_STATUS_FINISHED) {
+    PRINTF("Proxy: origin request failed (%u)\n", state->status);
+    fetch->code = state->status == COAP_REQUEST_STATUS_TIMEOUT ?
+      GATEWAY_TIMEOUT_5_04 : BAD_GATEWAY_5_02;
+    entry->valid = 0;
+  } else if(fetch->too_large) {
+    PRINTF("Proxy: response larger than %u bytes\n", COAP_PROXY_RESPONSE_SIZE);
+    fetch->code = BAD_GATEWAY_5_02;
+    entry->valid = 0;
+  } else if(fetch->code == CONTENT_2_05 || fetch->code == VALID_2_03) {
+    entry->valid = 1;
+    entry->expires = clock_seconds() + fetch->max_age;
+    fetch->code = CONTENT_2_05;
+  }
+
+  for(i = 0; i < COAP_PROXY_MAX_WAITERS; i++) {
+    if(fetch->waiters[i] != NULL) {
+      respond_waiter(fetch->waiters[i], entry, fetch->code);
+      fetch->waiters[i] = NULL;
+    }
+  }
+  if(!entry->valid) {
+    /* error responses are not cached */
+    entry->uri_len = 0;
+  }
+  entry->fetch = NULL;
+  fetch->entry = NULL;
+}
+/*---------------------------------------------------------------------------*/
+/* Parse "coap://[address]:port/path?query" into the fetch request */
+static int
+parse_uri(proxy_fetch_t *fetch, const char *uri, int uri_len,
+          uip_ipaddr_t *addr, uint16_t *port)
+{
+  char *query;
+  int i;
+
+  for(i = 8; i < uri_len && uri[i] != ']'; i++);
+  if(i == uri_len || !uiplib_ipaddrconv(uri + 7, addr)) {
+    return 0;
+  }
+  i++;
+
+  *port = COAP_DEFAULT_PORT;
+  if(i < uri_len && uri[i] == ':') {
+    for(*port = 0, i++; i < uri_len && uri[i] >= '0' && uri[i] <= '9'; i++) {
+      *port = *port * 10 + uri[i] - '0';
+    }
+  }
+  if(i < uri_len && uri[i] != '/' && uri[i] != '?') {
+    return 0;
+  }
+
+  memcpy(fetch->path, uri + i, uri_len - i);
+  fetch->path[uri_len - i] = '\0';
+  query = strchr(fetch->path, '?');
+  if(query != NULL) {
+    *query++ = '\0';
+    coap_set_header_uri_query(fetch->request, query);
+  }
+  if(fetch->path[0] != '\0') {
+    coap_set_header_uri_path(fetch->request, fetch->path);
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static proxy_fetch_t *
+start_fetch(proxy_entry_t *entry)
+{
+  proxy_fetch_t *fetch = NULL;
+  uip_ipaddr_t addr;
+  uint16_t port;
+  int i;
+
+  for(i = 0; i < COAP_PROXY_MAX_FETCHES; i++) {
+    if(fetches[i].entry == NULL) {
+      fetch = &fetches[i];
+      break;
+    }
+  }
+  if(fetch == NULL) {
+    return NULL;
+  }
+
+  coap_init_message(fetch->request, COAP_TYPE_CON, COAP_GET, 0);
+  if(!parse_uri(fetch, entry->uri, entry->uri_len, &addr, &port)) {
+    PRINTF("Proxy: unsupported URI %.*s\n", entry->uri_len, entry->uri);
+    return NULL;
+  }
+  if(entry->valid && entry->etag_len > 0) {
+    /* revalidate the stale representation */
+    coap_set_header_etag(fetch->request, entry->etag, entry->etag_len);
+  }
+
+  memset(fetch->waiters, 0, sizeof(fetch->waiters));
+  fetch->too_large = 0;
+  fetch->state.user_data = fetch;
+  if(!coap_send_request(&fetch->state, &addr, UIP_HTONS(port),
+                        fetch->request, fetch_callback)) {
+    return NULL;
+  }
+  /* the result is delivered to the waiting clients, not as an event */
+  fetch->state.process = NULL;
+  fetch->entry = entry;
+  entry->fetch = fetch;
+  return fetch;
+}
+/*---------------------------------------------------------------------------*/
+static void
+res_get_handler(void *request, void *response, uint8_t *buffer,
+                uint16_t preferred_size, int32_t *offset)
+{
+  proxy_entry_t *entry;
+  proxy_fetch_t *fetch;
+  const uint8_t *etag;
+  const char *uri;
+  int uri_len;
+  int32_t start;
+
+  uri_len = coap_get_header_proxy_uri(request, &uri);
+  if(uri_len == 0) {
+    REST.set_response_status(response, NOT_FOUND_4_04);
+    return;
+  }
+  if(uri_len < 8 || strncmp(uri, "coap://[", 8) != 0
+     || uri_len >= COAP_PROXY_URI_SIZE) {
+    /* only coap:// origins with literal IPv6 addresses are supported */
+    REST.set_response_status(response, PROXYING_NOT_SUPPORTED_5_05);
+    return;
+  }
+
+  entry = lookup_entry(uri, uri_len);
+  if(entry != NULL && entry->fetch == NULL && is_fresh(entry)) {
+    PRINTF("Proxy: cache hit for %.*s\n", uri_len, uri);
+    if(entry->etag_len > 0
+       && coap_get_header_etag(request, &etag) == entry->etag_len
+       && memcmp(etag, entry->etag, entry->etag_len) == 0) {
+      REST.set_response_status(response, VALID_2_03);
+      coap_set_header_etag(response, entry->etag, entry->etag_len);
+      coap_set_header_max_age(response, entry->expires - clock_seconds());
+      return;
+    }
+    start = offset != NULL ? *offset : 0;
+    if(!set_cached_response(response, entry, start, preferred_size)) {
+      REST.set_response_status(response, BAD_OPTION_4_02);
+      REST.set_response_payload(response, "BlockOutOfScope", 15);
+    } else if(offset != NULL
+              && (start > 0 || entry->payload_len > preferred_size)) {
+      *offset = start + preferred_size < entry->payload_len ?
+        start + preferred_size : -1;
+    }
+    return;
+  }
+
+  if(entry == NULL) {
+    entry = alloc_entry(uri, uri_len);
+    if(entry == NULL) {
+      coap_separate_reject();
+      return;
+    }
+  }
+
+  fetch = entry->fetch;
+  if(fetch == NULL) {
+    PRINTF("Proxy: fetching %.*s\n", uri_len, uri);
+    fetch = start_fetch(entry);
+    if(fetch == NULL) {
+      if(!entry->valid) {
+        entry->uri_len = 0;
+      }
+      coap_separate_reject();
+      return;
+    }
+  } else {
+    PRINTF("Proxy: waiting for outstanding fetch of %.*s\n", uri_len, uri);
+  }
+  add_waiter(fetch, request);
+}
+/*---------------------------------------------------------------------------*/
+#endif /* COAP_PROXY_OPTION_PROCESSING */
+void
+coap_proxy_init(void)
+{
+#if COAP_PROXY_OPTION_PROCESSING
+  rest_activate_resource(&res_coap_proxy, "");
+#endif /* COAP_PROXY_OPTION_PROCESSING */
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *      CoAP forward proxy with a response cache.
+ *
+ *      GET requests carrying a Proxy-Uri for a coap:// origin are served
+ *      from a cache keyed by the URI while the cached response is fresh
+ *      according to its Max-Age. Stale responses are revalidated with
+ *      their ETag. Concurrent requests for a URI that is being fetched
+ *      wait for the same origin request in separate responses.
+ *
+ *      Requires COAP_PROXY_OPTION_PROCESSING. The proxy is made available
+ *      with coap_proxy_init() after rest_init_engine().
+ */
+
+#ifndef COAP_PROXY_H_
+#define COAP_PROXY_H_
+
+#include "er-coap-separate.h"
+
+/* Number of cached responses */
+#ifndef COAP_PROXY_CACHE_SIZE
+#define COAP_PROXY_CACHE_SIZE          2
+#endif /* COAP_PROXY_CACHE_SIZE */
+
+/* Longest Proxy-Uri that is handled */
+#ifndef COAP_PROXY_URI_SIZE
+#define COAP_PROXY_URI_SIZE            64
+#endif /* COAP_PROXY_URI_SIZE */
+
+/* Largest response payload that is cached and forwarded */
+#ifndef COAP_PROXY_RESPONSE_SIZE
+#define COAP_PROXY_RESPONSE_SIZE       128
+#endif /* COAP_PROXY_RESPONSE_SIZE */
+
+/* Number of concurrent requests to origin servers */
+#ifndef COAP_PROXY_MAX_FETCHES
+#define COAP_PROXY_MAX_FETCHES         1
+#endif /* COAP_PROXY_MAX_FETCHES */
+
+/* Number of clients that can wait for the same origin request */
+#ifndef COAP_PROXY_MAX_WAITERS
+#define COAP_PROXY_MAX_WAITERS         COAP_SEPARATE_POOL_SIZE
+#endif /* COAP_PROXY_MAX_WAITERS */
+
+/**
+ * \brief Activate the forward proxy resource
+ */
+void coap_proxy_init(void);
+
+#endif /* COAP_PROXY_H_ */
@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *      CoAP module for asynchronous client requests
+ */
+
+#include "contiki.h"
+#include "er-coap-request.h"
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+process_event_t coap_request_event;
+
+static void response_callback(void *callback_data, void *response);
+/*---------------------------------------------------------------------------*/
+static int
+send_block(coap_request_state_t *state)
+{
+  coap_transaction_t *t;
+
+  state->request->mid = coap_get_mid();
+  t = coap_new_transaction(state->request->mid, &state->addr, state->port);
+  if(t == NULL) {
+    PRINTF("Could not allocate transaction buffer\n");
+    return 0;
+  }
+
+  t->callback = response_callback;
+  t->callback_data = state;
+
+  if(state->single_block) {
+    coap_set_header_block2(state->request, state->block_num, 0,
+                           state->block_size);
+  } else if(state->block_num > 0) {
+    coap_set_header_block2(state->request, state->block_num, 0,
+                           REST_MAX_CHUNK_SIZE);
+  }
+  t->packet_len = coap_serialize_message(state->request, t->packet);
+
+  state->transaction = t;
+  coap_send_transaction(t);
+  PRINTF("Requested #%lu (MID %u)\n", (unsigned long)state->block_num,
+         state->request->mid);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+finish(coap_request_state_t *state, coap_request_status_t status)
+{
+  state->transaction = NULL;
+  state->response = NULL;
+  state->status = status;
+  if(state->callback != NULL) {
+    state->callback(state);
+  }
+  if(state->future != NULL) {
+    async_future_complete(state->future);
+  }
+  if(state->process != NULL) {
+    process_post(state->process, coap_request_event, state);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+response_callback(void *callback_data, void *response)
+{
+  coap_request_state_t *state = callback_data;
+  uint32_t res_block = 0;
+  uint8_t more = 0;
+
+  /* the transaction has been freed when the callback is called */
+  state->transaction = NULL;
+
+  if(response == NULL) {
+    PRINTF("Server not responding\n");
+    finish(state, COAP_REQUEST_STATUS_TIMEOUT);
+    return;
+  }
+
+  coap_get_header_block2(response, &res_block, &more, NULL, NULL);
+
+  if(res_block == state->block_num || state->single_block) {
+    state->response = response;
+    state->status = COAP_REQUEST_STATUS_RESPONSE;
+    if(state->callback != NULL) {
+      state->callback(state);
+    }
+    state->response = NULL;
+    ++(state->block_num);
+    if(state->single_block) {
+      more = 0;
+    }
+  } else {
+    PRINTF("WRONG BLOCK %lu/%lu\n", (unsigned long)res_block,
+           (unsigned long)state->block_num);
+    if(++(state->block_error) >= COAP_MAX_ATTEMPTS) {
+      finish(state, COAP_REQUEST_STATUS_BLOCK_ERROR);
+      return;
+    }
+    /* ask for the expected block again */
+    more = 1;
+  }
+
+  if(!more) {
+    finish(state, COAP_REQUEST_STATUS_FINISHED);
+  } else if(!send_block(state)) {
+    finish(state, COAP_REQUEST_STATUS_ERROR);
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+coap_send_request(coap_request_state_t *state, uip_ipaddr_t *addr,
+                  uint16_t port, coap_packet_t *request,
+                  coap_request_callback_t callback)
+{
+  uip_ipaddr_copy(&state->addr, addr);
+  state->port = port;
+  state->request = request;
+  state->response = NULL;
+  state->callback = callback;
+  state->process = PROCESS_CURRENT();
+  state->future = NULL;
+  state->block_num = 0;
+  state->block_error = 0;
+  state->single_block = 0;
+  state->transaction = NULL;
+
+  return send_block(state);
+}
+/*---------------------------------------------------------------------------*/
+int
+coap_send_block_request(coap_request_state_t *state, uip_ipaddr_t *addr,
+                        uint16_t port, coap_packet_t *request,
+                        uint32_t block_num, uint16_t block_size,
+                        coap_request_callback_t callback)
+{
+  uip_ipaddr_copy(&state->addr, addr);
+  state->port = port;
+  state->request = request;
+  state->response = NULL;
+  state->callback = callback;
+  state->process = PROCESS_CURRENT();
+  state->future = NULL;
+  state->block_num = block_num;
+  state->block_error = 0;
+  state->single_block = 1;
+  state->block_size = block_size;
+  state->transaction = NULL;
+
+  return send_block(state);
+}
+/*---------------------------------------------------------------------------*/
+int
+coap_send_request_async(coap_request_state_t *state,
+                        struct async_future *future,
+                        uip_ipaddr_t *addr, uint16_t port,
+                        coap_packet_t *request)
+{
+  async_future_init(future);
+  if(!coap_send_request(state, addr, port, request, NULL)) {
+    state->status = COAP_REQUEST_STATUS_ERROR;
+    async_future_complete(future);
+    return 0;
+  }
+  /* The response cannot arrive before we return to the scheduler */
+  state->future = future;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+coap_cancel_request(coap_request_state_t *state)
+{
+  if(state->transaction != NULL) {
+    coap_clear_transaction(state->transaction);
+    state->transaction = NULL;
+  }
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *      CoAP module for asynchronous client requests.
+ *
+ *      Each request keeps its own state, so a process can have several
+ *      requests outstanding at the same time. Block2 responses are
+ *      fetched block by block and handed to the request callback as
+ *      they arrive.
+ */
+
+#ifndef COAP_REQUEST_H_
+#define COAP_REQUEST_H_
+
+#include "er-coap.h"
+#include "er-coap-transactions.h"
+#include "sys/async.h"
+
+typedef enum {
+  COAP_REQUEST_STATUS_RESPONSE,    /* a response (block) was received */
+  COAP_REQUEST_STATUS_FINISHED,    /* the last block has been received */
+  COAP_REQUEST_STATUS_TIMEOUT,     /* the server did not respond */
+  COAP_REQUEST_STATUS_BLOCK_ERROR, /* too many out of order blocks */
+  COAP_REQUEST_STATUS_ERROR        /* no transaction could be allocated */
+} coap_request_status_t;
+
+typedef struct coap_request_state coap_request_state_t;
+
+typedef void (*coap_request_callback_t)(coap_request_state_t *state);
+
+struct coap_request_state {
+  coap_transaction_t *transaction;
+  coap_packet_t *request;
+  coap_packet_t *response;      /* only valid in the callback */
+  uip_ipaddr_t addr;
+  uint16_t port;
+  uint32_t block_num;
+  uint8_t block_error;
+  uint8_t single_block;         /* only fetch block_num */
+  uint16_t block_size;          /* of a single block */
+  coap_request_status_t status;
+  coap_request_callback_t callback;
+  struct process *process;
+  struct async_future *future;  /* completed when the request is done */
+  void *user_data;              /* free for use by the caller */
+};
+
+/*
+ * Posted to the process that sent a request when the request has
+ * completed, with the request state as data.
+ */
+extern process_event_t coap_request_event;
+
+/**
+ * \brief Send a confirmable request without waiting for the response
+ * \param state The state of the request, kept by the caller until the
+ *        request has completed
+ * \param addr The address of the server
+ * \param port The port of the server, in network byte order
+ * \param request The request, kept by the caller until the request has
+ *        completed as it is serialized again for each Block2 block
+ * \param callback Called with COAP_REQUEST_STATUS_RESPONSE for each
+ *        received block and once more with the final status
+ * \return 1 if the request was sent, 0 if no transaction was available
+ */
+int coap_send_request(coap_request_state_t *state, uip_ipaddr_t *addr,
+                      uint16_t port, coap_packet_t *request,
+                      coap_request_callback_t callback);
+
+/**
+ * \brief Send a confirmable request for a single Block2 block
+ * \param block_num The block to ask for
+ * \param block_size The size of the blocks, a power of two between 16
+ *        and REST_MAX_CHUNK_SIZE
+ *
+ * The other parameters are those of coap_send_request(). The request
+ * finishes after the response, which is handed to the callback even
+ * if the server answers with another block or block size. Several
+ * blocks of the same resource can be fetched at the same time with
+ * the same request packet.
+ */
+int coap_send_block_request(coap_request_state_t *state, uip_ipaddr_t *addr,
+                            uint16_t port, coap_packet_t *request,
+                            uint32_t block_num, uint16_t block_size,
+                            coap_request_callback_t callback);
+
+/**
+ * \brief Send a confirmable request for an asynchronous task
+ * \param future Completed when the request has completed, with the
+ *        final status in state->status. Completed right away, with
+ *        COAP_REQUEST_STATUS_ERROR, if the request could not be sent
+ *
+ * The other parameters are those of coap_send_request(). Block2
+ * responses are not handed to the task: use coap_send_request() with
+ * a callback, and complete a future from it, to process them.
+ */
+int coap_send_request_async(coap_request_state_t *state,
+                            struct async_future *future,
+                            uip_ipaddr_t *addr, uint16_t port,
+                            coap_packet_t *request);
+
+/**
+ * \brief Abort an outstanding request. The callback is not called.
+ */
+void coap_cancel_request(coap_request_state_t *state);
+
+/**
+ * \brief Check if a request is still waiting for a response
+ */
+static inline int
+coap_request_is_pending(const coap_request_state_t *state)
+{
+  return state->transaction != NULL;
+}
+
+#endif /* COAP_REQUEST_H_ */
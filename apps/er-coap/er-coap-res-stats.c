@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \file
+ *      The /stats resource, the counters of the network stack in a
+ *      compact binary format for collection from many nodes.
+ *
+ *      The payload is a version byte, the uptime in seconds, and then for
+ *      each group its name, nul-terminated, the number of counters and
+ *      the counters. Numbers are in network byte order, counters are four
+ *      bytes. The names of the counters are not sent, they are fixed for
+ *      a version of the firmware and can be had from the netstats shell
+ *      command.
+ */
+
+#include "er-coap-engine.h"
+#include "net/net-stats.h"
+
+#if NET_STATS_ENABLED
+
+#define STATS_FORMAT_VERSION 1
+
+/* The part of the serialized counters that goes into this block */
+struct stats_block {
+  uint8_t *buffer;
+  int32_t offset;
+  int32_t pos;
+  uint16_t size;
+};
+/*---------------------------------------------------------------------------*/
+static void
+put_byte(struct stats_block *b, uint8_t byte)
+{
+  if(b->pos >= b->offset && b->pos < b->offset + b->size) {
+    b->buffer[b->pos - b->offset] = byte;
+  }
+  b->pos++;
+}
+/*---------------------------------------------------------------------------*/
+static void
+put_uint32(struct stats_block *b, uint32_t value)
+{
+  put_byte(b, value >> 24);
+  put_byte(b, value >> 16);
+  put_byte(b, value >> 8);
+  put_byte(b, value);
+}
+/*---------------------------------------------------------------------------*/
+static void
+stats_get_handler(void *request, void *response, uint8_t *buffer,
+                  uint16_t preferred_size, int32_t *offset)
+{
+  struct stats_block b;
+  struct net_stats_group *g;
+  const char *name;
+  uint8_t i;
+
+  b.buffer = buffer;
+  b.offset = *offset;
+  b.pos = 0;
+  b.size = preferred_size;
+
+  put_byte(&b, STATS_FORMAT_VERSION);
+  put_uint32(&b, clock_seconds());
+  for(g = net_stats_list(); g != NULL && b.pos < b.offset + b.size;
+      g = g->next) {
+    for(name = g->name; *name != '\0'; name++) {
+      put_byte(&b, *name);
+    }
+    put_byte(&b, '\0');
+    put_byte(&b, g->num);
+    for(i = 0; i < g->num; i++) {
+      put_uint32(&b, g->get(i));
+    }
+  }
+
+  if(b.pos <= b.offset) {
+    coap_set_status_code(response, BAD_OPTION_4_02);
+    coap_set_payload(response, "BlockOutOfScope", 15);
+    return;
+  }
+
+  coap_set_header_content_format(response, APPLICATION_OCTET_STREAM);
+  if(g == NULL && b.pos <= b.offset + b.size) {
+    coap_set_payload(response, buffer, b.pos - b.offset);
+    *offset = -1;
+  } else {
+    coap_set_payload(response, buffer, b.size);
+    *offset += b.size;
+  }
+}
+/*---------------------------------------------------------------------------*/
+RESOURCE(res_stats, "title=\"Network stack counters\";ct=42",
+         stats_get_handler, NULL, NULL, NULL);
+/*---------------------------------------------------------------------------*/
+#endif /* NET_STATS_ENABLED */
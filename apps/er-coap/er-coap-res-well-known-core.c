@@ -73,6 +73,111 @@
   } \
   strpos += tmplen
 
+#if COAP_LINK_FORMAT_CACHE_SIZE > 0
+/*
+ * The unfiltered link format listing is kept serialized and rebuilt only
+ * when the resource list has changed. Blocks are then served directly
+ * from the cache and the resource list version is used as ETag.
+ */
+static char link_cache[COAP_LINK_FORMAT_CACHE_SIZE];
+static uint16_t link_cache_len;
+static uint16_t link_cache_version;
+static uint8_t link_cache_state; /* 0 = invalid, 1 = valid, 2 = too large */
+/*---------------------------------------------------------------------------*/
+static int
+append_link_string(size_t *pos, const char *string)
+{
+  size_t len = strlen(string);
+  if(*pos + len > sizeof(link_cache)) {
+    return 0;
+  }
+  memcpy(&link_cache[*pos], string, len);
+  *pos += len;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+update_link_cache(void)
+{
+  resource_t *resource;
+  size_t pos = 0;
+
+  if(link_cache_state != 0
+     && link_cache_version == rest_get_resources_version()) {
+    return link_cache_state == 1;
+  }
+  link_cache_version = rest_get_resources_version();
+  link_cache_state = 2;
+
+  for(resource = (resource_t *)list_head(rest_get_resources()); resource;
+      resource = resource->next) {
+    if(!append_link_string(&pos, pos > 0 ? ",</" : "</")
+       || !append_link_string(&pos, resource->url)
+       || !append_link_string(&pos, ">")) {
+      return 0;
+    }
+    if(resource->attributes != NULL && resource->attributes[0]) {
+      if(!append_link_string(&pos, ";")
+         || !append_link_string(&pos, resource->attributes)) {
+        return 0;
+      }
+    }
+  }
+  PRINTF("Link cache updated: %u bytes\n", (unsigned)pos);
+  link_cache_len = pos;
+  link_cache_state = 1;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+get_cached_links(void *request, void *response, uint8_t *buffer,
+                 uint16_t preferred_size, int32_t *offset)
+{
+  const uint8_t *etag;
+  uint8_t current[2];
+  size_t len;
+
+  if(!update_link_cache()) {
+    return 0;
+  }
+
+  current[0] = link_cache_version >> 8;
+  current[1] = link_cache_version & 0xff;
+  coap_set_header_etag(response, current, sizeof(current));
+
+  if(*offset == 0 && coap_get_header_etag(request, &etag) == sizeof(current)
+     && memcmp(etag, current, sizeof(current)) == 0) {
+    /* The client already has the current listing */
+    coap_set_status_code(response, VALID_2_03);
+    *offset = -1;
+    return 1;
+  }
+
+  if(*offset >= link_cache_len) {
+    if(link_cache_len > 0) {
+      coap_set_status_code(response, BAD_OPTION_4_02);
+      coap_set_payload(response, "BlockOutOfScope", 15);
+    }
+    *offset = -1;
+    return 1;
+  }
+
+  len = link_cache_len - *offset;
+  if(len > preferred_size) {
+    len = preferred_size;
+  }
+  memcpy(buffer, &link_cache[*offset], len);
+  coap_set_payload(response, buffer, len);
+  coap_set_header_content_format(response, APPLICATION_LINK_FORMAT);
+
+  if(*offset + len >= link_cache_len) {
+    *offset = -1;
+  } else {
+    *offset += preferred_size;
+  }
+  return 1;
+}
+#endif /* COAP_LINK_FORMAT_CACHE_SIZE > 0 */
 /*---------------------------------------------------------------------------*/
 /*- Resource Handlers -------------------------------------------------------*/
 /*---------------------------------------------------------------------------*/
@@ -113,6 +218,20 @@ well_known_core_get_handler(void *request, void *response, uint8_t *buffer,
   }
 #endif
 
+#if COAP_LINK_FORMAT_CACHE_SIZE > 0
+  /* Unfiltered requests are served from the link cache when it fits */
+#if COAP_LINK_FORMAT_FILTERING
+  if(len == 0
+     && get_cached_links(request, response, buffer, preferred_size, offset)) {
+    return;
+  }
+#else /* COAP_LINK_FORMAT_FILTERING */
+  if(get_cached_links(request, response, buffer, preferred_size, offset)) {
+    return;
+  }
+#endif /* COAP_LINK_FORMAT_FILTERING */
+#endif /* COAP_LINK_FORMAT_CACHE_SIZE > 0 */
+
   for(resource = (resource_t *)list_head(rest_get_resources()); resource;
       resource = resource->next) {
 #if COAP_LINK_FORMAT_FILTERING
@@ -41,6 +41,8 @@
 #include <string.h>
 #include "er-coap-separate.h"
 #include "er-coap-transactions.h"
+#include "lib/memb.h"
+#include "lib/list.h"
 
 #define DEBUG 0
 #if DEBUG
@@ -54,6 +56,9 @@
 #define PRINTLLADDR(addr)
 #endif
 
+MEMB(separate_memb, coap_separate_slot_t, COAP_SEPARATE_POOL_SIZE);
+LIST(separate_list);
+
 /*---------------------------------------------------------------------------*/
 /*- Separate Response API ---------------------------------------------------*/
 /*---------------------------------------------------------------------------*/
@@ -147,3 +152,164 @@ coap_separate_resume(void *response, coap_separate_t *separate_store,
   }
 }
 /*---------------------------------------------------------------------------*/
+/*- Separate Response Pool --------------------------------------------------*/
+/*---------------------------------------------------------------------------*/
+static coap_separate_slot_t *
+find_slot(const uip_ipaddr_t *addr, uint16_t port, uint16_t mid)
+{
+  coap_separate_slot_t *slot;
+
+  for(slot = list_head(separate_list); slot; slot = slot->next) {
+    if(slot->request_mid == mid && slot->store.port == port
+       && uip_ipaddr_cmp(&slot->store.addr, addr)) {
+      return slot;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+slot_expired(void *ptr)
+{
+  coap_separate_slot_t *slot = ptr;
+
+  PRINTF("Separate response for MID %u timed out\n", slot->request_mid);
+  if(slot->timeout != NULL) {
+    slot->timeout(slot, slot->user_data);
+  }
+  coap_separate_pool_respond(slot, SERVICE_UNAVAILABLE_5_03, -1, NULL, 0);
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Accept a request for a separate response from the shared pool
+ * \param request The request to accept
+ * \param timeout Callback if the response is not completed in time, or NULL
+ * \param user_data Pointer passed to the timeout callback
+ * \return The slot to complete with coap_separate_pool_respond(), or NULL
+ *
+ * NULL is returned both when the pool is exhausted, in which case the
+ * request is rejected with 5.03, and when the request is a retransmission
+ * of one that is already pending, in which case the empty ACK is sent
+ * again. In both cases the engine takes care of the reply and the caller
+ * must not start any work for the request.
+ */
+coap_separate_slot_t *
+coap_separate_pool_accept(void *request,
+                          coap_separate_timeout_callback_t timeout,
+                          void *user_data)
+{
+  coap_packet_t *const coap_req = (coap_packet_t *)request;
+  coap_separate_slot_t *slot;
+
+  if(find_slot(&UIP_IP_BUF->srcipaddr, UIP_UDP_BUF->srcport,
+               coap_req->mid) != NULL) {
+    PRINTF("Separate request MID %u already pending\n", coap_req->mid);
+    if(coap_req->type == COAP_TYPE_CON) {
+      coap_packet_t ack[1];
+
+      coap_init_message(ack, COAP_TYPE_ACK, 0, coap_req->mid);
+      coap_send_message(&UIP_IP_BUF->srcipaddr, UIP_UDP_BUF->srcport,
+                        uip_appdata, coap_serialize_message(ack, uip_appdata));
+    }
+    erbium_status_code = MANUAL_RESPONSE;
+    return NULL;
+  }
+
+  slot = memb_alloc(&separate_memb);
+  if(slot == NULL) {
+    PRINTF("No free separate response slot\n");
+    coap_separate_reject();
+    return NULL;
+  }
+
+  coap_separate_accept(request, &slot->store);
+  if(erbium_status_code != MANUAL_RESPONSE) {
+    memb_free(&separate_memb, slot);
+    return NULL;
+  }
+
+  slot->request_mid = coap_req->mid;
+  slot->timeout = timeout;
+  slot->user_data = user_data;
+  ctimer_set(&slot->timer, COAP_SEPARATE_LIFETIME * CLOCK_SECOND,
+             slot_expired, slot);
+  list_add(separate_list, slot);
+  return slot;
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Send the response for a pooled separate request and release it
+ * \param slot The slot returned by coap_separate_pool_accept()
+ * \param code The response code
+ * \param content_format The Content-Format of the payload, or -1 for none
+ * \param payload The response payload, or NULL
+ * \param length The payload length
+ * \return 1 if the response was sent, 0 if no transaction was available
+ *
+ * A payload larger than the block size requested by the client is
+ * truncated to the first block. The slot is released in either case.
+ */
+int
+coap_separate_pool_respond(coap_separate_slot_t *slot, uint8_t code,
+                           int content_format, const uint8_t *payload,
+                           uint16_t length)
+{
+  coap_packet_t response[1];
+
+  coap_separate_resume(response, &slot->store, code);
+  if(content_format >= 0) {
+    coap_set_header_content_format(response, content_format);
+  }
+  if(length > slot->store.block2_size) {
+    coap_set_header_block2(response, 0, 1, slot->store.block2_size);
+    length = slot->store.block2_size;
+  }
+  if(payload != NULL && length > 0) {
+    coap_set_payload(response, payload, length);
+  }
+  return coap_separate_pool_send(slot, response);
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Send a response for a pooled separate request and release it
+ * \param slot The slot returned by coap_separate_pool_accept()
+ * \param response A response prepared with coap_separate_resume() from
+ *        the store of the slot
+ * \return 1 if the response was sent, 0 otherwise
+ */
+int
+coap_separate_pool_send(coap_separate_slot_t *slot, coap_packet_t *response)
+{
+  coap_transaction_t *transaction;
+  int sent = 0;
+
+  transaction = coap_new_transaction(slot->store.mid, &slot->store.addr,
+                                     slot->store.port);
+  if(transaction != NULL) {
+    transaction->packet_len = coap_serialize_message(response,
+                                                     transaction->packet);
+    if(transaction->packet_len > 0) {
+      coap_send_transaction(transaction);
+      sent = 1;
+    } else {
+      coap_clear_transaction(transaction);
+    }
+  }
+
+  PRINTF("Separate response for MID %u %s\n", slot->request_mid,
+         sent ? "sent" : "failed");
+  coap_separate_pool_release(slot);
+  return sent;
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Release a pooled separate request without responding
+ */
+void
+coap_separate_pool_release(coap_separate_slot_t *slot)
+{
+  ctimer_stop(&slot->timer);
+  list_remove(separate_list, slot);
+  memb_free(&separate_memb, slot);
+}
+/*---------------------------------------------------------------------------*/
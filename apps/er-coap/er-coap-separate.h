@@ -40,6 +40,17 @@
 #define COAP_SEPARATE_H_
 
 #include "er-coap.h"
+#include "sys/ctimer.h"
+
+/* Number of separate responses that can be pending in the shared pool */
+#ifndef COAP_SEPARATE_POOL_SIZE
+#define COAP_SEPARATE_POOL_SIZE        2
+#endif /* COAP_SEPARATE_POOL_SIZE */
+
+/* Seconds a pooled separate response may be pending before it fails */
+#ifndef COAP_SEPARATE_LIFETIME
+#define COAP_SEPARATE_LIFETIME         30
+#endif /* COAP_SEPARATE_LIFETIME */
 
 typedef struct coap_separate {
 
@@ -59,6 +70,24 @@ typedef struct coap_separate {
   uint16_t block2_size;
 } coap_separate_t;
 
+typedef struct coap_separate_slot coap_separate_slot_t;
+
+/**
+ * Called when a pooled separate response was not completed in time.
+ * Afterwards a 5.03 is sent to the client and the slot is released.
+ */
+typedef void (* coap_separate_timeout_callback_t)(coap_separate_slot_t *slot,
+                                                  void *user_data);
+
+struct coap_separate_slot {
+  struct coap_separate_slot *next;
+  coap_separate_t store;
+  uint16_t request_mid;
+  struct ctimer timer;
+  coap_separate_timeout_callback_t timeout;
+  void *user_data;
+};
+
 int coap_separate_handler(resource_t *resource, void *request,
                           void *response);
 void coap_separate_reject(void);
@@ -66,4 +95,14 @@ void coap_separate_accept(void *request, coap_separate_t *separate_store);
 void coap_separate_resume(void *response, coap_separate_t *separate_store,
                           uint8_t code);
 
+coap_separate_slot_t *coap_separate_pool_accept(void *request,
+                                                coap_separate_timeout_callback_t timeout,
+                                                void *user_data);
+int coap_separate_pool_respond(coap_separate_slot_t *slot, uint8_t code,
+                               int content_format, const uint8_t *payload,
+                               uint16_t length);
+int coap_separate_pool_send(coap_separate_slot_t *slot,
+                            coap_packet_t *response);
+void coap_separate_pool_release(coap_separate_slot_t *slot);
+
 #endif /* COAP_SEPARATE_H_ */
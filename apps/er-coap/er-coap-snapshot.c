@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *      CoAP module for Block2 snapshots
+ */
+
+#include <string.h>
+#include "contiki.h"
+#include "er-coap-snapshot.h"
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+#if COAP_SNAPSHOT_CACHE_SIZE > 0
+static coap_snapshot_t snapshots[COAP_SNAPSHOT_CACHE_SIZE];
+/*---------------------------------------------------------------------------*/
+static uint16_t
+hash_url(const char *url, int len)
+{
+  uint16_t hash = 0;
+  int i;
+  for(i = 0; i < len; i++) {
+    hash = hash * 31 + (uint8_t)url[i];
+  }
+  return hash;
+}
+/*---------------------------------------------------------------------------*/
+static int
+is_expired(const coap_snapshot_t *s, unsigned long now)
+{
+  return s->len == 0 || (long)(s->expires - now) <= 0;
+}
+/*---------------------------------------------------------------------------*/
+static coap_snapshot_t *
+lookup(const uip_ipaddr_t *addr, uint16_t port, uint16_t url_hash,
+       uint8_t url_len, uint16_t accept, unsigned long now)
+{
+  int i;
+
+  for(i = 0; i < COAP_SNAPSHOT_CACHE_SIZE; i++) {
+    if(!is_expired(&snapshots[i], now)
+       && snapshots[i].url_hash == url_hash
+       && snapshots[i].url_len == url_len
+       && snapshots[i].accept == accept
+       && snapshots[i].port == port
+       && uip_ipaddr_cmp(&snapshots[i].addr, addr)) {
+      return &snapshots[i];
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+/* Take a free entry or the one closest to expire */
+static coap_snapshot_t *
+allocate(unsigned long now)
+{
+  coap_snapshot_t *s = &snapshots[0];
+  int i;
+
+  for(i = 0; i < COAP_SNAPSHOT_CACHE_SIZE; i++) {
+    if(is_expired(&snapshots[i], now)) {
+      return &snapshots[i];
+    }
+    if((long)(snapshots[i].expires - s->expires) < 0) {
+      s = &snapshots[i];
+    }
+  }
+  return s;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Render the full representation into the snapshot. Returns 1 if it was
+ * stored, 0 if it does not fit and -1 if the response is an error.
+ */
+static int
+render(coap_snapshot_t *s, resource_t *resource, void *request,
+       void *response)
+{
+  coap_packet_t *const pkt = (coap_packet_t *)response;
+  int32_t offset = 0;
+  unsigned int format;
+
+  s->len = 0;
+  resource->get_handler(request, response, s->data, COAP_SNAPSHOT_SIZE,
+                        &offset);
+
+  if(pkt->code >= BAD_REQUEST_4_00) {
+    return -1;
+  }
+  if((offset != 0 && offset != -1) || pkt->payload_len > COAP_SNAPSHOT_SIZE) {
+    return 0;
+  }
+  if(pkt->payload != s->data) {
+    memmove(s->data, pkt->payload, pkt->payload_len);
+  }
+  s->len = pkt->payload_len;
+  s->code = pkt->code;
+  if(coap_get_header_content_format(response, &format)) {
+    s->content_format = format;
+  } else {
+    s->content_format = -1;
+  }
+  PRINTF("CoAP snapshot: stored %u bytes\n", s->len);
+  return 1;
+}
+#endif /* COAP_SNAPSHOT_CACHE_SIZE > 0 */
+/*---------------------------------------------------------------------------*/
+void
+coap_snapshot_handler(resource_t *resource, void *request, void *response,
+                      uint8_t *buffer, uint16_t preferred_size,
+                      int32_t *offset)
+{
+#if COAP_SNAPSHOT_CACHE_SIZE > 0
+  coap_snapshot_t *s;
+  unsigned long now;
+  unsigned int accept;
+  uint16_t url_hash;
+  const char *url;
+  int32_t block_offset;
+  uint16_t len;
+  int status;
+
+  if(offset == NULL) {
+    resource->get_handler(request, response, buffer, preferred_size, offset);
+    return;
+  }
+
+  block_offset = *offset;
+  len = coap_get_header_uri_path(request, &url);
+  url_hash = hash_url(url, len);
+  if(!coap_get_header_accept(request, &accept)) {
+    accept = 0xffff;
+  }
+
+  now = clock_seconds();
+  s = lookup(&UIP_IP_BUF->srcipaddr, UIP_UDP_BUF->srcport, url_hash, len,
+             accept, now);
+  if(block_offset == 0 || s == NULL) {
+    /* a new transfer, or the snapshot has been lost */
+    if(s == NULL) {
+      s = allocate(now);
+      uip_ipaddr_copy(&s->addr, &UIP_IP_BUF->srcipaddr);
+      s->port = UIP_UDP_BUF->srcport;
+      s->url_hash = url_hash;
+      s->url_len = len;
+      s->accept = accept;
+    }
+    status = render(s, resource, request, response);
+    if(status < 0) {
+      /* the error response is sent as it is */
+      return;
+    }
+    if(status == 0) {
+      /* too large, serve this transfer directly from the handler */
+      resource->get_handler(request, response, buffer, preferred_size,
+                            offset);
+      return;
+    }
+    if(block_offset == 0 && s->len <= preferred_size) {
+      /* fits in one block, no need to keep it */
+      memcpy(buffer, s->data, s->len);
+      coap_set_payload(response, buffer, s->len);
+      s->len = 0;
+      return;
+    }
+  }
+
+  if(block_offset >= s->len) {
+    coap_set_status_code(response, BAD_OPTION_4_02);
+    coap_set_payload(response, "BlockOutOfScope", 15);
+    return;
+  }
+
+  len = MIN(s->len - block_offset, preferred_size);
+  memcpy(buffer, s->data + block_offset, len);
+  coap_set_status_code(response, s->code);
+  if(s->content_format >= 0) {
+    coap_set_header_content_format(response, s->content_format);
+  }
+  coap_set_payload(response, buffer, len);
+  *offset = block_offset + len < s->len ? block_offset + len : -1;
+  s->expires = now + COAP_SNAPSHOT_LIFETIME;
+#else /* COAP_SNAPSHOT_CACHE_SIZE > 0 */
+  resource->get_handler(request, response, buffer, preferred_size, offset);
+#endif /* COAP_SNAPSHOT_CACHE_SIZE > 0 */
+}
+/*---------------------------------------------------------------------------*/
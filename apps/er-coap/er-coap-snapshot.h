@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *      CoAP module for Block2 snapshots.
+ *
+ *      GET handlers of resources flagged IS_SNAPSHOT render their full
+ *      representation once, for the first block, and later blocks of the
+ *      same transfer are served from the stored copy.
+ */
+
+#ifndef COAP_SNAPSHOT_H_
+#define COAP_SNAPSHOT_H_
+
+#include "er-coap.h"
+
+/* The number of stored representations, 0 disables snapshots */
+#ifndef COAP_SNAPSHOT_CACHE_SIZE
+#define COAP_SNAPSHOT_CACHE_SIZE       1
+#endif /* COAP_SNAPSHOT_CACHE_SIZE */
+
+/* Largest representation that can be stored */
+#ifndef COAP_SNAPSHOT_SIZE
+#define COAP_SNAPSHOT_SIZE             256
+#endif /* COAP_SNAPSHOT_SIZE */
+
+/* Time in seconds that a representation is kept after its last use */
+#ifndef COAP_SNAPSHOT_LIFETIME
+#define COAP_SNAPSHOT_LIFETIME         30
+#endif /* COAP_SNAPSHOT_LIFETIME */
+
+typedef struct coap_snapshot {
+  uip_ipaddr_t addr;
+  uint16_t port;
+  uint16_t url_hash;
+  uint8_t url_len;
+  uint8_t code;
+  uint16_t accept;
+  int16_t content_format;       /* -1 if not set */
+  uint16_t len;                 /* 0 if the entry is free */
+  unsigned long expires;
+  uint8_t data[COAP_SNAPSHOT_SIZE];
+} coap_snapshot_t;
+
+/**
+ * \brief Call the GET handler of a resource, serving blocks after the
+ *        first one from a stored representation when possible
+ */
+void coap_snapshot_handler(resource_t *resource, void *request,
+                           void *response, uint8_t *buffer,
+                           uint16_t preferred_size, int32_t *offset);
+
+#endif /* COAP_SNAPSHOT_H_ */
@@ -0,0 +1,345 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *      CoAP over TCP (RFC 8323) transport binding
+ */
+
+#include <string.h>
+#include "contiki.h"
+#include "contiki-net.h"
+#include "net/ip/tcp-socket.h"
+#include "er-coap-tcp.h"
+#include "er-coap-engine.h"
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+#if COAP_TCP_CONNECTIONS > 0
+
+/* Signaling codes (7.xx) */
+#define SIGNAL_CSM     0xE1
+#define SIGNAL_PING    0xE2
+#define SIGNAL_PONG    0xE3
+#define SIGNAL_RELEASE 0xE4
+#define SIGNAL_ABORT   0xE5
+
+typedef struct coap_tcp_connection {
+  struct tcp_socket socket;
+  uip_ipaddr_t addr;
+  uint16_t port;                /* network byte order, 0 if free */
+  uint16_t input_len;
+  uint8_t input[COAP_TCP_BUFFER_SIZE];
+  uint8_t socket_input[COAP_TCP_BUFFER_SIZE];
+  uint8_t socket_output[COAP_TCP_BUFFER_SIZE];
+} coap_tcp_connection_t;
+
+static coap_tcp_connection_t connections[COAP_TCP_CONNECTIONS];
+
+/* A received frame converted to the UDP message format for parsing */
+static uint8_t message_buffer[COAP_TCP_BUFFER_SIZE];
+/*---------------------------------------------------------------------------*/
+static coap_tcp_connection_t *
+lookup(const uip_ipaddr_t *addr, uint16_t port)
+{
+  int i;
+
+  for(i = 0; i < COAP_TCP_CONNECTIONS; i++) {
+    if(connections[i].port == port && port != 0
+       && uip_ipaddr_cmp(&connections[i].addr, addr)) {
+      return &connections[i];
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Write a frame with the given code, token and body (options and
+ * payload). Returns 0 if it does not fit in the output buffer.
+ */
+static int
+send_frame(coap_tcp_connection_t *c, uint8_t code, const uint8_t *token,
+           uint8_t token_len, const uint8_t *body, uint16_t body_len)
+{
+  uint8_t header[4 + COAP_TOKEN_LEN];
+  uint16_t pos = 0;
+
+  if(body_len < 13) {
+    header[pos++] = (body_len << 4) | token_len;
+  } else if(body_len < 269) {
+    header[pos++] = (13 << 4) | token_len;
+    header[pos++] = body_len - 13;
+  } else {
+    header[pos++] = (14 << 4) | token_len;
+    header[pos++] = (body_len - 269) >> 8;
+    header[pos++] = (body_len - 269) & 0xFF;
+  }
+  header[pos++] = code;
+  memcpy(header + pos, token, token_len);
+  pos += token_len;
+
+  if(tcp_socket_max_sendlen(&c->socket) < pos + body_len) {
+    PRINTF("CoAP TCP: output buffer full\n");
+    return 0;
+  }
+  tcp_socket_send(&c->socket, header, pos);
+  if(body_len > 0) {
+    tcp_socket_send(&c->socket, body, body_len);
+  }
+  if(c->socket.c != NULL) {
+    tcpip_poll_tcp(c->socket.c);
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+release(coap_tcp_connection_t *c)
+{
+  PRINTF("CoAP TCP: connection closed\n");
+  coap_remove_observer_by_client(&c->addr, c->port);
+  tcp_socket_unregister(&c->socket);
+  c->port = 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_frame(coap_tcp_connection_t *c, uint8_t code,
+             const uint8_t *token, uint8_t token_len,
+             const uint8_t *body, uint16_t body_len)
+{
+  coap_transaction_t *t = NULL;
+  coap_message_type_t type = COAP_TYPE_NON;
+  uint16_t mid;
+
+  if(code >= SIGNAL_CSM) {
+    if(code == SIGNAL_PING) {
+      send_frame(c, SIGNAL_PONG, token, token_len, NULL, 0);
+    } else if(code == SIGNAL_RELEASE || code == SIGNAL_ABORT) {
+      tcp_socket_close(&c->socket);
+    }
+    return;
+  }
+  if(code == 0 || COAP_HEADER_LEN + token_len + body_len >
+     sizeof(message_buffer)) {
+    return;
+  }
+
+  /* a response takes the MID of the request it answers */
+  if((code >> 5) >= 2) {
+    t = coap_get_transaction_by_token(token, token_len);
+  }
+  if(t != NULL) {
+    type = COAP_TYPE_ACK;
+    mid = t->mid;
+  } else {
+    mid = coap_get_mid();
+  }
+
+  message_buffer[0] = (COAP_HEADER_VERSION_MASK &
+                       (1 << COAP_HEADER_VERSION_POSITION))
+    | (COAP_HEADER_TYPE_MASK & (type << COAP_HEADER_TYPE_POSITION))
+    | (COAP_HEADER_TOKEN_LEN_MASK & token_len);
+  message_buffer[1] = code;
+  message_buffer[2] = mid >> 8;
+  message_buffer[3] = mid & 0xFF;
+  memcpy(message_buffer + COAP_HEADER_LEN, token, token_len);
+  memcpy(message_buffer + COAP_HEADER_LEN + token_len, body, body_len);
+
+  coap_receive(message_buffer, COAP_HEADER_LEN + token_len + body_len);
+}
+/*---------------------------------------------------------------------------*/
+static int
+input(struct tcp_socket *s, void *ptr, const uint8_t *data, int len)
+{
+  coap_tcp_connection_t *c = ptr;
+  uint16_t pos, header_len, frame_len;
+  uint16_t body_len;
+  uint8_t token_len;
+
+  if(len > (int)(sizeof(c->input) - c->input_len)) {
+    PRINTF("CoAP TCP: frame too large\n");
+    tcp_socket_close(s);
+    c->input_len = 0;
+    return 0;
+  }
+  memcpy(c->input + c->input_len, data, len);
+  c->input_len += len;
+
+  /* handle all complete frames, keeping a partial one for later */
+  pos = 0;
+  while(pos < c->input_len) {
+    body_len = c->input[pos] >> 4;
+    token_len = c->input[pos] & 0x0F;
+    header_len = 2;
+    if(body_len == 13) {
+      header_len += 1;
+    } else if(body_len == 14) {
+      header_len += 2;
+    }
+    if(c->input_len - pos < header_len) {
+      break;
+    }
+    if(body_len == 13) {
+      body_len = 13 + c->input[pos + 1];
+    } else if(body_len == 14) {
+      body_len = 269 + ((c->input[pos + 1] << 8) | c->input[pos + 2]);
+    }
+    /* a length nibble of 15 (four extended bytes) never fits */
+    if(body_len == 15 || token_len > COAP_TOKEN_LEN
+       || header_len + token_len + body_len > sizeof(c->input)) {
+      PRINTF("CoAP TCP: bad or too large frame\n");
+      tcp_socket_close(s);
+      c->input_len = 0;
+      return 0;
+    }
+    frame_len = header_len + token_len + body_len;
+    if(c->input_len - pos < frame_len) {
+      break;
+    }
+    handle_frame(c, c->input[pos + header_len - 1],
+                 c->input + pos + header_len, token_len,
+                 c->input + pos + header_len + token_len, body_len);
+    pos += frame_len;
+  }
+
+  c->input_len -= pos;
+  memmove(c->input, c->input + pos, c->input_len);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+event(struct tcp_socket *s, void *ptr, tcp_socket_event_t ev)
+{
+  coap_tcp_connection_t *c = ptr;
+
+  if(ev == TCP_SOCKET_CONNECTED) {
+    PRINTF("CoAP TCP: connected\n");
+  } else if(ev == TCP_SOCKET_CLOSED || ev == TCP_SOCKET_TIMEDOUT
+            || ev == TCP_SOCKET_ABORTED) {
+    release(c);
+  }
+}
+#endif /* COAP_TCP_CONNECTIONS > 0 */
+/*---------------------------------------------------------------------------*/
+int
+coap_tcp_connect(const uip_ipaddr_t *addr, uint16_t port)
+{
+#if COAP_TCP_CONNECTIONS > 0
+  coap_tcp_connection_t *c = lookup(addr, port);
+  int i;
+
+  if(c != NULL) {
+    return 1;
+  }
+  for(i = 0; i < COAP_TCP_CONNECTIONS; i++) {
+    if(connections[i].port == 0) {
+      c = &connections[i];
+      break;
+    }
+  }
+  if(c == NULL) {
+    PRINTF("CoAP TCP: no free connection\n");
+    return 0;
+  }
+
+  memset(&c->socket, 0, sizeof(c->socket));
+  tcp_socket_register(&c->socket, c, c->socket_input,
+                      sizeof(c->socket_input), c->socket_output,
+                      sizeof(c->socket_output), input, event);
+  if(tcp_socket_connect(&c->socket, addr, uip_ntohs(port)) < 0) {
+    tcp_socket_unregister(&c->socket);
+    return 0;
+  }
+  uip_ipaddr_copy(&c->addr, addr);
+  c->port = port;
+  c->input_len = 0;
+
+  /* the Capabilities and Settings Message is sent first */
+  send_frame(c, SIGNAL_CSM, NULL, 0, NULL, 0);
+  return 1;
+#else /* COAP_TCP_CONNECTIONS > 0 */
+  return 0;
+#endif /* COAP_TCP_CONNECTIONS > 0 */
+}
+/*---------------------------------------------------------------------------*/
+void
+coap_tcp_close(const uip_ipaddr_t *addr, uint16_t port)
+{
+#if COAP_TCP_CONNECTIONS > 0
+  coap_tcp_connection_t *c = lookup(addr, port);
+
+  if(c != NULL) {
+    tcp_socket_close(&c->socket);
+  }
+#endif /* COAP_TCP_CONNECTIONS > 0 */
+}
+/*---------------------------------------------------------------------------*/
+int
+coap_tcp_is_connected(const uip_ipaddr_t *addr, uint16_t port)
+{
+#if COAP_TCP_CONNECTIONS > 0
+  return lookup(addr, port) != NULL;
+#else /* COAP_TCP_CONNECTIONS > 0 */
+  return 0;
+#endif /* COAP_TCP_CONNECTIONS > 0 */
+}
+/*---------------------------------------------------------------------------*/
+int
+coap_tcp_send(const uip_ipaddr_t *addr, uint16_t port, const uint8_t *data,
+              uint16_t length)
+{
+#if COAP_TCP_CONNECTIONS > 0
+  coap_tcp_connection_t *c = lookup(addr, port);
+  uint8_t token_len;
+
+  if(c == NULL) {
+    return 0;
+  }
+
+  /* the type and MID of the UDP header are not sent */
+  token_len = data[0] & COAP_HEADER_TOKEN_LEN_MASK;
+  if(length < COAP_HEADER_LEN + token_len || data[1] == 0) {
+    /* empty messages (ACK, RST) have no meaning on a reliable link */
+    return 1;
+  }
+  send_frame(c, data[1], data + COAP_HEADER_LEN, token_len,
+             data + COAP_HEADER_LEN + token_len,
+             length - COAP_HEADER_LEN - token_len);
+  return 1;
+#else /* COAP_TCP_CONNECTIONS > 0 */
+  return 0;
+#endif /* COAP_TCP_CONNECTIONS > 0 */
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \file
+ *      CoAP over TCP (RFC 8323) transport binding.
+ *
+ *      Messages to an endpoint with an open TCP connection are sent
+ *      with length-prefixed framing instead of as UDP datagrams. The
+ *      link is reliable, so no MID or retransmission state is kept for
+ *      such messages. Received responses are matched to their request
+ *      by token.
+ */
+
+#ifndef COAP_TCP_H_
+#define COAP_TCP_H_
+
+#include "er-coap.h"
+
+/* The number of TCP connections, 0 disables CoAP over TCP */
+#ifndef COAP_TCP_CONNECTIONS
+#define COAP_TCP_CONNECTIONS           0
+#endif /* COAP_TCP_CONNECTIONS */
+
+/* Size of the buffers for one frame in each direction */
+#ifndef COAP_TCP_BUFFER_SIZE
+#define COAP_TCP_BUFFER_SIZE           (COAP_MAX_PACKET_SIZE + 8)
+#endif /* COAP_TCP_BUFFER_SIZE */
+
+/**
+ * \brief Open a TCP connection to a CoAP endpoint. Messages to the
+ *        endpoint are queued on the connection while it is set up.
+ * \param addr The address of the endpoint
+ * \param port The port of the endpoint, in network byte order
+ * \return 1 if the connection is open or being opened, 0 on error
+ */
+int coap_tcp_connect(const uip_ipaddr_t *addr, uint16_t port);
+
+/**
+ * \brief Close the TCP connection to a CoAP endpoint
+ */
+void coap_tcp_close(const uip_ipaddr_t *addr, uint16_t port);
+
+/**
+ * \brief Check if messages to an endpoint are sent over TCP
+ */
+int coap_tcp_is_connected(const uip_ipaddr_t *addr, uint16_t port);
+
+/**
+ * \brief Send a serialized message on the TCP connection to an endpoint
+ * \param data The message, serialized with a UDP header
+ * \return 1 if the endpoint has a TCP connection, 0 otherwise
+ */
+int coap_tcp_send(const uip_ipaddr_t *addr, uint16_t port,
+                  const uint8_t *data, uint16_t length);
+
+#endif /* COAP_TCP_H_ */
@@ -40,6 +40,12 @@
 #include "contiki-net.h"
 #include "er-coap-transactions.h"
 #include "er-coap-observe.h"
+#include "er-coap-peer.h"
+#include "er-coap-tcp.h"
+#include "net/net-stats.h"
+#include "sys/compower.h"
+#include "sys/trace.h"
+#include <string.h>
 
 #define DEBUG 0
 #if DEBUG
@@ -55,10 +61,118 @@
 
 /*---------------------------------------------------------------------------*/
 MEMB(transactions_memb, coap_transaction_t, COAP_MAX_OPEN_TRANSACTIONS);
+/* Open transactions are found through a hash on the MID... */
+static coap_transaction_t *transactions_hash[COAP_TRANSACTION_HASH_SIZE];
+#define MID_HASH(mid) (((mid) ^ ((mid) >> 8)) & (COAP_TRANSACTION_HASH_SIZE - 1))
+/* ...while confirmable ones also wait in a list ordered by deadline */
 LIST(transactions_list);
+/* confirmable transactions waiting for an exchange with the peer to end */
+LIST_TAILQ(held_list);
+
+MEMB(shared_packets_memb, coap_shared_packet_t, COAP_MAX_SHARED_PACKETS);
+MEMB(notifications_memb, coap_notification_transaction_t,
+     COAP_MAX_OPEN_NOTIFICATIONS);
+LIST(notifications_list);
+
+/* Buffer used to assemble a notification for one observer */
+static uint8_t notification_buffer[COAP_MAX_PACKET_SIZE + COAP_TOKEN_LEN];
 
 static struct process *transaction_handler_process = NULL;
 
+/*
+ * A single timer is armed for the earliest retransmission deadline of
+ * all transactions and notifications.
+ */
+static struct etimer retrans_timer;
+
+enum {
+  STATS_TRANSACTIONS, STATS_NOTIFICATIONS, STATS_REXMIT, STATS_TIMEOUT,
+  STATS_OPEN, STATS_OBSERVERS, STATS_NUM
+};
+#if NET_STATS_ENABLED
+static uint32_t stats[STATS_OPEN];
+static const char * const stats_names[STATS_NUM] = {
+  "transactions", "notifications", "rexmit", "timeout",
+  "open", "observers"
+};
+static uint32_t
+stats_get(uint8_t index)
+{
+  switch(index) {
+  case STATS_OPEN:
+    return COAP_MAX_OPEN_TRANSACTIONS - memb_numfree(&transactions_memb)
+      + COAP_MAX_OPEN_NOTIFICATIONS - memb_numfree(&notifications_memb);
+  case STATS_OBSERVERS:
+    return list_length(coap_get_observers());
+  }
+  return stats[index];
+}
+static struct net_stats_group stats_group = {
+  NULL, "coap", stats_names, STATS_NUM, stats_get
+};
+#endif /* NET_STATS_ENABLED */
+
+/* Time to wait for the response to a request sent over a reliable link */
+#define RELIABLE_RESPONSE_TIMEOUT \
+  ((clock_time_t)COAP_RESPONSE_TIMEOUT_TICKS << COAP_MAX_RETRANSMIT)
+
+/* true if clock time a is before b, also when the clock wraps */
+#define TIME_BEFORE(a, b) \
+  ((clock_time_t)((a) - (b)) > ((clock_time_t)~(clock_time_t)0 >> 1))
+
+/*---------------------------------------------------------------------------*/
+static void
+update_retrans_timer(void)
+{
+  coap_transaction_t *t = list_head(transactions_list);
+  coap_notification_transaction_t *n = list_head(notifications_list);
+  clock_time_t deadline;
+  clock_time_t now;
+
+  if(t == NULL && n == NULL) {
+    etimer_stop(&retrans_timer);
+    return;
+  }
+
+  if(t == NULL || (n != NULL && TIME_BEFORE(n->retrans_time, t->retrans_time))) {
+    deadline = n->retrans_time;
+  } else {
+    deadline = t->retrans_time;
+  }
+
+  now = clock_time();
+  PROCESS_CONTEXT_BEGIN(transaction_handler_process);
+  etimer_set(&retrans_timer, TIME_BEFORE(now, deadline) ? deadline - now : 0);
+  PROCESS_CONTEXT_END(transaction_handler_process);
+}
+/*---------------------------------------------------------------------------*/
+static void
+schedule_transaction(coap_transaction_t *t)
+{
+  coap_transaction_t *prev = NULL;
+  coap_transaction_t *i;
+
+  for(i = list_head(transactions_list);
+      i != NULL && !TIME_BEFORE(t->retrans_time, i->retrans_time);
+      i = i->next) {
+    prev = i;
+  }
+  list_insert(transactions_list, prev, t);
+}
+/*---------------------------------------------------------------------------*/
+static void
+schedule_notification(coap_notification_transaction_t *n)
+{
+  coap_notification_transaction_t *prev = NULL;
+  coap_notification_transaction_t *i;
+
+  for(i = list_head(notifications_list);
+      i != NULL && !TIME_BEFORE(n->retrans_time, i->retrans_time);
+      i = i->next) {
+    prev = i;
+  }
+  list_insert(notifications_list, prev, n);
+}
 /*---------------------------------------------------------------------------*/
 /*- Internal API ------------------------------------------------------------*/
 /*---------------------------------------------------------------------------*/
@@ -66,6 +180,7 @@ void
 coap_register_as_transaction_handler()
 {
   transaction_handler_process = PROCESS_CURRENT();
+  net_stats_register(&stats_group);
 }
 coap_transaction_t *
 coap_new_transaction(uint16_t mid, uip_ipaddr_t *addr, uint16_t port)
@@ -73,65 +188,134 @@ coap_new_transaction(uint16_t mid, uip_ipaddr_t *addr, uint16_t port)
   coap_transaction_t *t = memb_alloc(&transactions_memb);
 
   if(t) {
+    NET_STATS_ADD(stats, STATS_TRANSACTIONS);
     t->mid = mid;
     t->retrans_counter = 0;
+    t->flags = 0;
+    t->flow = compower_get_flow();
 
     /* save client address */
     uip_ipaddr_copy(&t->addr, addr);
     t->port = port;
 
-    list_add(transactions_list, t); /* list itself makes sure same element is not added twice */
+    t->hash_next = transactions_hash[MID_HASH(mid)];
+    transactions_hash[MID_HASH(mid)] = t;
   }
 
   return t;
 }
 /*---------------------------------------------------------------------------*/
+/* Send a message with its energy attributed to a flow, also when resent
+   from the timer */
+static void
+send_message(uint16_t flow, uip_ipaddr_t *addr, uint16_t port,
+             uint8_t *data, uint16_t length)
+{
+  uint16_t current = compower_get_flow();
+
+  compower_set_flow(flow);
+  coap_send_message(addr, port, data, length);
+  compower_set_flow(current);
+}
+/*---------------------------------------------------------------------------*/
+static void
+timeout_transaction(coap_transaction_t *t)
+{
+  restful_response_handler callback = t->callback;
+  void *callback_data = t->callback_data;
+
+  PRINTF("Timeout\n");
+  NET_STATS_ADD(stats, STATS_TIMEOUT);
+
+  /* handle observers */
+  coap_remove_observer_by_client(&t->addr, t->port);
+
+  coap_clear_transaction(t);
+
+  if(callback) {
+    callback(callback_data, NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+schedule_reliable(coap_transaction_t *t)
+{
+  send_message(t->flow, &t->addr, t->port, t->packet, t->packet_len);
+
+  if(t->packet[1] == 0 || (t->packet[1] >> 5) != 0) {
+    /* no ACK will come for a response, it is done when sent */
+    coap_clear_transaction(t);
+    return;
+  }
+
+  /* a request is kept until its response arrives or it times out */
+  t->flags |= COAP_TRANSACTION_FLAG_RELIABLE;
+  t->retrans_interval = RELIABLE_RESPONSE_TIMEOUT;
+  list_remove(transactions_list, t);
+  t->retrans_time = clock_time() + t->retrans_interval;
+  schedule_transaction(t);
+  update_retrans_timer();
+}
+/*---------------------------------------------------------------------------*/
 void
 coap_send_transaction(coap_transaction_t *t)
 {
+  int is_con = COAP_TYPE_CON ==
+    ((COAP_HEADER_TYPE_MASK & t->packet[0]) >> COAP_HEADER_TYPE_POSITION);
+
+  if(t->flags & COAP_TRANSACTION_FLAG_RELIABLE) {
+    /* no retransmissions on a reliable link */
+    timeout_transaction(t);
+    return;
+  }
+  if(is_con && coap_tcp_is_connected(&t->addr, t->port)) {
+    PRINTF("Sending transaction %u on reliable link\n", t->mid);
+    schedule_reliable(t);
+    return;
+  }
+
+  if(is_con && !(t->flags & COAP_TRANSACTION_FLAG_EXCHANGE)) {
+    if(!coap_peer_start_exchange(&t->addr)) {
+      PRINTF("Holding transaction %u\n", t->mid);
+      list_add(held_list, t);
+      return;
+    }
+    t->flags |= COAP_TRANSACTION_FLAG_EXCHANGE;
+    t->start_time = clock_time();
+  }
+
   PRINTF("Sending transaction %u\n", t->mid);
 
-  coap_send_message(&t->addr, t->port, t->packet, t->packet_len);
+  if(t->flow == COMPOWER_FLOW_NONE) {
+    /* A response is created before the resource it comes from is known */
+    t->flow = compower_get_flow();
+  }
+  send_message(t->flow, &t->addr, t->port, t->packet, t->packet_len);
 
-  if(COAP_TYPE_CON ==
-     ((COAP_HEADER_TYPE_MASK & t->packet[0]) >> COAP_HEADER_TYPE_POSITION)) {
+  if(is_con) {
     if(t->retrans_counter < COAP_MAX_RETRANSMIT) {
       /* not timed out yet */
       PRINTF("Keeping transaction %u\n", t->mid);
 
       if(t->retrans_counter == 0) {
-        t->retrans_timer.timer.interval =
-          COAP_RESPONSE_TIMEOUT_TICKS + (random_rand()
-                                         %
-                                         (clock_time_t)
-                                         COAP_RESPONSE_TIMEOUT_BACKOFF_MASK);
+        t->retrans_interval = coap_peer_initial_timeout(&t->addr, &t->backoff);
         PRINTF("Initial interval %f\n",
-               (float)t->retrans_timer.timer.interval / CLOCK_SECOND);
+               (float)t->retrans_interval / CLOCK_SECOND);
       } else {
-        t->retrans_timer.timer.interval <<= 1;  /* double */
-        PRINTF("Doubled (%u) interval %f\n", t->retrans_counter,
-               (float)t->retrans_timer.timer.interval / CLOCK_SECOND);
+        t->retrans_interval = t->retrans_interval * t->backoff / 2;
+        PRINTF("Backed off (%u) interval %f\n", t->retrans_counter,
+               (float)t->retrans_interval / CLOCK_SECOND);
       }
 
-      PROCESS_CONTEXT_BEGIN(transaction_handler_process);
-      etimer_restart(&t->retrans_timer);        /* interval updated above */
-      PROCESS_CONTEXT_END(transaction_handler_process);
+      list_remove(transactions_list, t);
+      t->retrans_time = clock_time() + t->retrans_interval;
+      schedule_transaction(t);
+      update_retrans_timer();
 
       t = NULL;
     } else {
       /* timed out */
-      PRINTF("Timeout\n");
-      restful_response_handler callback = t->callback;
-      void *callback_data = t->callback_data;
-
-      /* handle observers */
-      coap_remove_observer_by_client(&t->addr, t->port);
-
-      coap_clear_transaction(t);
-
-      if(callback) {
-        callback(callback_data, NULL);
-      }
+      timeout_transaction(t);
     }
   } else {
     coap_clear_transaction(t);
@@ -139,22 +323,90 @@ coap_send_transaction(coap_transaction_t *t)
 }
 /*---------------------------------------------------------------------------*/
 void
+coap_send_transaction_later(coap_transaction_t *t, clock_time_t delay)
+{
+  /* sent by coap_check_transactions() like a retransmission is */
+  PRINTF("Sending transaction %u in %lu ticks\n", t->mid,
+         (unsigned long)delay);
+  list_remove(transactions_list, t);
+  t->retrans_time = clock_time() + delay;
+  schedule_transaction(t);
+  update_retrans_timer();
+}
+/*---------------------------------------------------------------------------*/
+void
 coap_clear_transaction(coap_transaction_t *t)
 {
+  coap_transaction_t **p;
+  uip_ipaddr_t addr;
+  int exchange;
+
   if(t) {
     PRINTF("Freeing transaction %u: %p\n", t->mid, t);
 
-    etimer_stop(&t->retrans_timer);
-    list_remove(transactions_list, t);
+    for(p = &transactions_hash[MID_HASH(t->mid)]; *p; p = &(*p)->hash_next) {
+      if(*p == t) {
+        *p = t->hash_next;
+        break;
+      }
+    }
+    if(list_head(transactions_list) == t) {
+      list_remove(transactions_list, t);
+      update_retrans_timer();
+    } else {
+      list_remove(transactions_list, t);
+    }
+    list_remove(held_list, t);
+
+    exchange = t->flags & COAP_TRANSACTION_FLAG_EXCHANGE;
+    uip_ipaddr_copy(&addr, &t->addr);
     memb_free(&transactions_memb, t);
+
+    if(exchange) {
+      /* let the next held transaction to the same peer go */
+      coap_peer_end_exchange(&addr);
+      for(t = list_head(held_list); t; t = t->next) {
+        if(uip_ipaddr_cmp(&t->addr, &addr)) {
+          list_remove(held_list, t);
+          coap_send_transaction(t);
+          break;
+        }
+      }
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+coap_transaction_rtt_sample(coap_transaction_t *t)
+{
+  if(t->flags & COAP_TRANSACTION_FLAG_EXCHANGE) {
+    coap_peer_rtt_sample(&t->addr, clock_time() - t->start_time,
+                         t->retrans_counter);
   }
 }
 coap_transaction_t *
+coap_get_transaction_by_token(const uint8_t *token, uint8_t token_len)
+{
+  coap_transaction_t *t;
+  int i;
+
+  for(i = 0; i < COAP_TRANSACTION_HASH_SIZE; i++) {
+    for(t = transactions_hash[i]; t; t = t->hash_next) {
+      if((t->packet[0] & COAP_HEADER_TOKEN_LEN_MASK) == token_len
+         && memcmp(t->packet + COAP_HEADER_LEN, token, token_len) == 0) {
+        return t;
+      }
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+coap_transaction_t *
 coap_get_transaction_by_mid(uint16_t mid)
 {
   coap_transaction_t *t = NULL;
 
-  for(t = (coap_transaction_t *)list_head(transactions_list); t; t = t->next) {
+  for(t = transactions_hash[MID_HASH(mid)]; t; t = t->hash_next) {
     if(t->mid == mid) {
       PRINTF("Found transaction for MID %u: %p\n", t->mid, t);
       return t;
@@ -163,17 +415,234 @@ coap_get_transaction_by_mid(uint16_t mid)
   return NULL;
 }
 /*---------------------------------------------------------------------------*/
+/*- Shared notifications ----------------------------------------------------*/
+/*---------------------------------------------------------------------------*/
+coap_shared_packet_t *
+coap_new_shared_packet(void)
+{
+  coap_shared_packet_t *shared = memb_alloc(&shared_packets_memb);
+  if(shared) {
+    shared->refs = 1;
+    shared->observe_offset = 0;
+    shared->packet_len = 0;
+  }
+  return shared;
+}
+/*---------------------------------------------------------------------------*/
 void
-coap_check_transactions()
+coap_release_shared_packet(coap_shared_packet_t *shared)
 {
-  coap_transaction_t *t = NULL;
+  if(shared && --shared->refs == 0) {
+    memb_free(&shared_packets_memb, shared);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Locate the Observe value in a packet serialized without token. Returns
+ * 0 if the packet has no Observe option or if it is not three bytes.
+ */
+int
+coap_finalize_shared_packet(coap_shared_packet_t *shared)
+{
+  uint8_t *p = shared->packet + COAP_HEADER_LEN;
+  uint8_t *end = shared->packet + shared->packet_len;
+  unsigned int number = 0;
+  unsigned int delta, len;
 
-  for(t = (coap_transaction_t *)list_head(transactions_list); t; t = t->next) {
-    if(etimer_expired(&t->retrans_timer)) {
-      ++(t->retrans_counter);
-      PRINTF("Retransmitting %u (%u)\n", t->mid, t->retrans_counter);
-      coap_send_transaction(t);
+  shared->observe_offset = 0;
+  while(p < end && *p != 0xFF) {
+    delta = *p >> 4;
+    len = *p & 0x0F;
+    p++;
+    if(delta == 13) {
+      delta = 13 + *p++;
+    } else if(delta == 14) {
+      delta = 269 + ((p[0] << 8) | p[1]);
+      p += 2;
+    }
+    if(len == 13) {
+      len = 13 + *p++;
+    } else if(len == 14) {
+      len = 269 + ((p[0] << 8) | p[1]);
+      p += 2;
     }
+    number += delta;
+    if(number == COAP_OPTION_OBSERVE) {
+      if(len != 3) {
+        return 0;
+      }
+      shared->observe_offset = p - shared->packet;
+      return 1;
+    } else if(number > COAP_OPTION_OBSERVE) {
+      break;
+    }
+    p += len;
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_shared(coap_shared_packet_t *shared, coap_message_type_t type,
+            uint16_t mid, uip_ipaddr_t *addr, uint16_t port,
+            const uint8_t *token, uint8_t token_len, uint32_t observe,
+            uint16_t flow)
+{
+  uint8_t *buf = notification_buffer;
+  uint16_t len;
+
+  buf[0] = (shared->packet[0] &
+            ~(COAP_HEADER_TYPE_MASK | COAP_HEADER_TOKEN_LEN_MASK))
+    | (COAP_HEADER_TYPE_MASK & (type << COAP_HEADER_TYPE_POSITION))
+    | (COAP_HEADER_TOKEN_LEN_MASK
+       & (token_len << COAP_HEADER_TOKEN_LEN_POSITION));
+  buf[1] = shared->packet[1];
+  buf[2] = (uint8_t)(mid >> 8);
+  buf[3] = (uint8_t)mid;
+  memcpy(buf + COAP_HEADER_LEN, token, token_len);
+
+  len = shared->packet_len - COAP_HEADER_LEN;
+  memcpy(buf + COAP_HEADER_LEN + token_len,
+         shared->packet + COAP_HEADER_LEN, len);
+
+  if(shared->observe_offset > 0) {
+    uint8_t *o = buf + shared->observe_offset + token_len;
+    o[0] = (uint8_t)(observe >> 16);
+    o[1] = (uint8_t)(observe >> 8);
+    o[2] = (uint8_t)observe;
+  }
+
+  send_message(flow, addr, port, buf, COAP_HEADER_LEN + token_len + len);
+}
+/*---------------------------------------------------------------------------*/
+static void
+clear_notification(coap_notification_transaction_t *n)
+{
+  PRINTF("Freeing notification %u: %p\n", n->mid, n);
+  if(list_head(notifications_list) == n) {
+    list_remove(notifications_list, n);
+    update_retrans_timer();
+  } else {
+    list_remove(notifications_list, n);
+  }
+  coap_release_shared_packet(n->shared);
+  memb_free(&notifications_memb, n);
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_notification(coap_notification_transaction_t *n)
+{
+  PRINTF("Sending notification %u\n", n->mid);
+
+  send_shared(n->shared, COAP_TYPE_CON, n->mid, &n->addr, n->port,
+              n->token, n->token_len, n->observe, n->flow);
+
+  if(n->retrans_counter < COAP_MAX_RETRANSMIT) {
+    if(n->retrans_counter == 0) {
+      n->start_time = clock_time();
+      n->retrans_interval = coap_peer_initial_timeout(&n->addr, &n->backoff);
+    } else {
+      n->retrans_interval = n->retrans_interval * n->backoff / 2;
+    }
+
+    list_remove(notifications_list, n);
+    n->retrans_time = clock_time() + n->retrans_interval;
+    schedule_notification(n);
+    update_retrans_timer();
+  } else {
+    /* timed out */
+    PRINTF("Notification timeout\n");
+    NET_STATS_ADD(stats, STATS_TIMEOUT);
+    coap_remove_observer_by_client(&n->addr, n->port);
+    clear_notification(n);
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+coap_send_shared_packet(coap_shared_packet_t *shared,
+                        coap_message_type_t type, uint16_t mid,
+                        uip_ipaddr_t *addr, uint16_t port,
+                        const uint8_t *token, uint8_t token_len,
+                        uint32_t observe)
+{
+  coap_notification_transaction_t *n;
+
+  if(type != COAP_TYPE_CON || coap_tcp_is_connected(addr, port)) {
+    /*
+     * Non-confirmable notifications, and any notification on a reliable
+     * link, are not kept for retransmission
+     */
+    send_shared(shared, type, mid, addr, port, token, token_len, observe,
+                compower_get_flow());
+    return 1;
+  }
+
+  n = memb_alloc(&notifications_memb);
+  if(n == NULL) {
+    PRINTF("No free notification transaction\n");
+    return 0;
+  }
+
+  NET_STATS_ADD(stats, STATS_NOTIFICATIONS);
+  n->mid = mid;
+  n->retrans_counter = 0;
+  uip_ipaddr_copy(&n->addr, addr);
+  n->port = port;
+  n->token_len = token_len;
+  memcpy(n->token, token, token_len);
+  n->observe = observe;
+  n->flow = compower_get_flow();
+  n->shared = shared;
+  shared->refs++;
+
+  send_notification(n);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+int
+coap_clear_notification_transaction_by_mid(uint16_t mid)
+{
+  coap_notification_transaction_t *n;
+
+  for(n = list_head(notifications_list); n; n = n->next) {
+    if(n->mid == mid) {
+      coap_peer_rtt_sample(&n->addr, clock_time() - n->start_time,
+                           n->retrans_counter);
+      clear_notification(n);
+      return 1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+coap_check_transactions()
+{
+  coap_transaction_t *t;
+  coap_notification_transaction_t *n;
+  clock_time_t now = clock_time();
+
+  /*
+   * Both lists are ordered by deadline, so only their heads need to be
+   * looked at. A resent entry is moved back into the list at its new,
+   * later deadline.
+   */
+  while((t = list_head(transactions_list)) != NULL &&
+        !TIME_BEFORE(now, t->retrans_time)) {
+    ++(t->retrans_counter);
+    PRINTF("Retransmitting %u (%u)\n", t->mid, t->retrans_counter);
+    TRACE(COAP_RETRANSMIT, t->mid, t->retrans_counter);
+    NET_STATS_ADD(stats, STATS_REXMIT);
+    coap_send_transaction(t);
+  }
+
+  while((n = list_head(notifications_list)) != NULL &&
+        !TIME_BEFORE(now, n->retrans_time)) {
+    ++(n->retrans_counter);
+    PRINTF("Retransmitting notification %u (%u)\n", n->mid,
+           n->retrans_counter);
+    TRACE(COAP_RETRANSMIT, n->mid, n->retrans_counter);
+    NET_STATS_ADD(stats, STATS_REXMIT);
+    send_notification(n);
   }
 }
 /*---------------------------------------------------------------------------*/
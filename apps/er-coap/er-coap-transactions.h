@@ -48,16 +48,27 @@
 #define COAP_RESPONSE_TIMEOUT_TICKS         (CLOCK_SECOND * COAP_RESPONSE_TIMEOUT)
 #define COAP_RESPONSE_TIMEOUT_BACKOFF_MASK  (long)((CLOCK_SECOND * COAP_RESPONSE_TIMEOUT * ((float)COAP_RESPONSE_RANDOM_FACTOR - 1.0)) + 0.5) + 1
 
+/* the transaction is a confirmable exchange counted towards COAP_NSTART */
+#define COAP_TRANSACTION_FLAG_EXCHANGE 1
+/* the transaction is a request sent over a reliable link */
+#define COAP_TRANSACTION_FLAG_RELIABLE 2
+
 /* container for transactions with message buffer and retransmission info */
 typedef struct coap_transaction {
   struct coap_transaction *next;        /* for LIST */
+  struct coap_transaction *hash_next;   /* next in same MID hash bucket */
 
   uint16_t mid;
-  struct etimer retrans_timer;
+  clock_time_t retrans_time;            /* deadline of next retransmission */
+  clock_time_t retrans_interval;
+  clock_time_t start_time;              /* first transmission, for RTT */
   uint8_t retrans_counter;
+  uint8_t backoff;                      /* interval factor in halves */
+  uint8_t flags;
 
   uip_ipaddr_t addr;
   uint16_t port;
+  uint16_t flow;                        /* energy attribution, see compower */
 
   restful_response_handler callback;
   void *callback_data;
@@ -67,14 +78,65 @@ typedef struct coap_transaction {
                                                  * Use snprintf(buf, len+1, "", ...) to completely fill payload */
 } coap_transaction_t;
 
+/*
+ * A serialized notification shared by all observers of a resource. The
+ * message is serialized without token and with a three byte Observe
+ * option that is patched together with the MID and token for each
+ * observer when sent.
+ */
+typedef struct coap_shared_packet {
+  uint8_t refs;
+  uint16_t observe_offset;      /* offset of Observe value, 0 if none */
+  uint16_t packet_len;
+  uint8_t packet[COAP_MAX_PACKET_SIZE + 1];
+} coap_shared_packet_t;
+
+/* container for confirmable notifications referencing a shared packet */
+typedef struct coap_notification_transaction {
+  struct coap_notification_transaction *next;   /* for LIST */
+
+  uint16_t mid;
+  clock_time_t retrans_time;
+  clock_time_t retrans_interval;
+  clock_time_t start_time;
+  uint8_t retrans_counter;
+  uint8_t backoff;
+
+  uip_ipaddr_t addr;
+  uint16_t port;
+  uint16_t flow;
+
+  uint8_t token_len;
+  uint8_t token[COAP_TOKEN_LEN];
+  uint32_t observe;
+
+  coap_shared_packet_t *shared;
+} coap_notification_transaction_t;
+
 void coap_register_as_transaction_handler(void);
 
 coap_transaction_t *coap_new_transaction(uint16_t mid, uip_ipaddr_t *addr,
                                          uint16_t port);
 void coap_send_transaction(coap_transaction_t *t);
+/* send a non-confirmable transaction after a delay, e.g. the leisure of
+   a group response */
+void coap_send_transaction_later(coap_transaction_t *t, clock_time_t delay);
 void coap_clear_transaction(coap_transaction_t *t);
+void coap_transaction_rtt_sample(coap_transaction_t *t);
 coap_transaction_t *coap_get_transaction_by_mid(uint16_t mid);
+coap_transaction_t *coap_get_transaction_by_token(const uint8_t *token,
+                                                  uint8_t token_len);
 
 void coap_check_transactions(void);
 
+coap_shared_packet_t *coap_new_shared_packet(void);
+void coap_release_shared_packet(coap_shared_packet_t *shared);
+int coap_finalize_shared_packet(coap_shared_packet_t *shared);
+int coap_send_shared_packet(coap_shared_packet_t *shared,
+                            coap_message_type_t type, uint16_t mid,
+                            uip_ipaddr_t *addr, uint16_t port,
+                            const uint8_t *token, uint8_t token_len,
+                            uint32_t observe);
+int coap_clear_notification_transaction_by_mid(uint16_t mid);
+
 #endif /* COAP_TRANSACTIONS_H_ */
@@ -41,9 +41,12 @@
 #include "contiki.h"
 #include "sys/cc.h"
 #include "contiki-net.h"
+#include "sys/trace.h"
 
 #include "er-coap.h"
 #include "er-coap-transactions.h"
+#include "er-coap-tcp.h"
+#include "er-coap-dtls.h"
 
 #define DEBUG 0
 #if DEBUG
@@ -217,6 +220,105 @@ coap_serialize_array_option(unsigned int number, unsigned int current_number,
   return i;
 }
 /*---------------------------------------------------------------------------*/
+static uint32_t
+coap_encode_block_option(uint32_t num, uint8_t more, uint16_t size)
+{
+  uint32_t block = num << 4;
+  if(more) {
+    block |= 0x8;
+  }
+  block |= 0xF & coap_log_2(size / 16);
+  return block;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Serialize one option that is set in the packet. Returns the number of
+ * bytes written or 0 for options that are not serialized.
+ */
+static size_t
+coap_serialize_option(coap_packet_t *coap_pkt, unsigned int number,
+                      unsigned int current_number, uint8_t *option)
+{
+  PRINTF("Serialize option %u\n", number);
+
+  switch(number) {
+  case COAP_OPTION_IF_MATCH:
+    return coap_serialize_array_option(number, current_number, option,
+                                       coap_pkt->if_match,
+                                       coap_pkt->if_match_len, '\0');
+  case COAP_OPTION_URI_HOST:
+    return coap_serialize_array_option(number, current_number, option,
+                                       (uint8_t *)coap_pkt->uri_host,
+                                       coap_pkt->uri_host_len, '\0');
+  case COAP_OPTION_ETAG:
+    return coap_serialize_array_option(number, current_number, option,
+                                       coap_pkt->etag, coap_pkt->etag_len,
+                                       '\0');
+  case COAP_OPTION_IF_NONE_MATCH:
+    return coap_serialize_int_option(number, current_number, option, 0);
+  case COAP_OPTION_OBSERVE:
+    return coap_serialize_int_option(number, current_number, option,
+                                     coap_pkt->observe);
+  case COAP_OPTION_URI_PORT:
+    return coap_serialize_int_option(number, current_number, option,
+                                     coap_pkt->uri_port);
+  case COAP_OPTION_LOCATION_PATH:
+    return coap_serialize_array_option(number, current_number, option,
+                                       (uint8_t *)coap_pkt->location_path,
+                                       coap_pkt->location_path_len, '/');
+  case COAP_OPTION_URI_PATH:
+    return coap_serialize_array_option(number, current_number, option,
+                                       (uint8_t *)coap_pkt->uri_path,
+                                       coap_pkt->uri_path_len, '/');
+  case COAP_OPTION_CONTENT_FORMAT:
+    return coap_serialize_int_option(number, current_number, option,
+                                     coap_pkt->content_format);
+  case COAP_OPTION_MAX_AGE:
+    return coap_serialize_int_option(number, current_number, option,
+                                     coap_pkt->max_age);
+  case COAP_OPTION_URI_QUERY:
+    return coap_serialize_array_option(number, current_number, option,
+                                       (uint8_t *)coap_pkt->uri_query,
+                                       coap_pkt->uri_query_len, '&');
+  case COAP_OPTION_ACCEPT:
+    return coap_serialize_int_option(number, current_number, option,
+                                     coap_pkt->accept);
+  case COAP_OPTION_LOCATION_QUERY:
+    return coap_serialize_array_option(number, current_number, option,
+                                       (uint8_t *)coap_pkt->location_query,
+                                       coap_pkt->location_query_len, '&');
+  case COAP_OPTION_BLOCK2:
+    return coap_serialize_int_option(number, current_number, option,
+                                     coap_encode_block_option(
+                                       coap_pkt->block2_num,
+                                       coap_pkt->block2_more,
+                                       coap_pkt->block2_size));
+  case COAP_OPTION_BLOCK1:
+    return coap_serialize_int_option(number, current_number, option,
+                                     coap_encode_block_option(
+                                       coap_pkt->block1_num,
+                                       coap_pkt->block1_more,
+                                       coap_pkt->block1_size));
+  case COAP_OPTION_SIZE2:
+    return coap_serialize_int_option(number, current_number, option,
+                                     coap_pkt->size2);
+  case COAP_OPTION_PROXY_URI:
+    return coap_serialize_array_option(number, current_number, option,
+                                       (uint8_t *)coap_pkt->proxy_uri,
+                                       coap_pkt->proxy_uri_len, '\0');
+  case COAP_OPTION_PROXY_SCHEME:
+    return coap_serialize_array_option(number, current_number, option,
+                                       (uint8_t *)coap_pkt->proxy_scheme,
+                                       coap_pkt->proxy_scheme_len, '\0');
+  case COAP_OPTION_SIZE1:
+    return coap_serialize_int_option(number, current_number, option,
+                                     coap_pkt->size1);
+  default:
+    /* options from parsed packets that are not forwarded */
+    return 0;
+  }
+}
+/*---------------------------------------------------------------------------*/
 static void
 coap_merge_multi_option(char **dst, size_t *dst_len, uint8_t *option,
                         size_t option_len, char separator)
@@ -287,6 +389,33 @@ coap_init_connection(uint16_t port)
   current_mid = random_rand();
 }
 /*---------------------------------------------------------------------------*/
+#if COAP_GROUP_COMMUNICATION
+int
+coap_join_group(const uip_ipaddr_t *group)
+{
+  if(!uip_is_addr_mcast(group)) {
+    return 0;
+  }
+  if(uip_ds6_maddr_lookup(group) != NULL) {
+    return 1;
+  }
+  PRINTF("Joining group ");
+  PRINT6ADDR(group);
+  PRINTF("\n");
+  return uip_ds6_maddr_add(group) != NULL;
+}
+/*---------------------------------------------------------------------------*/
+void
+coap_leave_group(const uip_ipaddr_t *group)
+{
+  uip_ds6_maddr_t *maddr = uip_ds6_maddr_lookup(group);
+
+  if(maddr != NULL) {
+    uip_ds6_maddr_rm(maddr);
+  }
+}
+#endif /* COAP_GROUP_COMMUNICATION */
+/*---------------------------------------------------------------------------*/
 uint16_t
 coap_get_mid()
 {
@@ -307,12 +436,25 @@ coap_init_message(void *packet, coap_message_type_t type, uint8_t code,
   coap_pkt->mid = mid;
 }
 /*---------------------------------------------------------------------------*/
+#if COAP_LAZY_OPTION_PARSING
+static void decode_lazy_options(coap_packet_t *coap_pkt);
+#endif /* COAP_LAZY_OPTION_PARSING */
+/*---------------------------------------------------------------------------*/
 size_t
 coap_serialize_message(void *packet, uint8_t *buffer)
 {
   coap_packet_t *const coap_pkt = (coap_packet_t *)packet;
   uint8_t *option;
   unsigned int current_number = 0;
+  unsigned int number;
+  uint8_t bits;
+  size_t len;
+  int i;
+
+#if COAP_LAZY_OPTION_PARSING
+  /* options of a parsed packet are still in the old buffer */
+  decode_lazy_options(coap_pkt);
+#endif /* COAP_LAZY_OPTION_PARSING */
 
   /* Initialize */
   coap_pkt->buffer = buffer;
@@ -354,39 +496,28 @@ coap_serialize_message(void *packet, uint8_t *buffer)
 
   PRINTF("-Serializing options at %p-\n", option);
 
-  /* The options must be serialized in the order of their number */
-  COAP_SERIALIZE_BYTE_OPTION(COAP_OPTION_IF_MATCH, if_match, "If-Match");
-  COAP_SERIALIZE_STRING_OPTION(COAP_OPTION_URI_HOST, uri_host, '\0',
-                               "Uri-Host");
-  COAP_SERIALIZE_BYTE_OPTION(COAP_OPTION_ETAG, etag, "ETag");
-  COAP_SERIALIZE_INT_OPTION(COAP_OPTION_IF_NONE_MATCH,
-                            content_format -
-                            coap_pkt->
-                            content_format /* hack to get a zero field */,
-                            "If-None-Match");
-  COAP_SERIALIZE_INT_OPTION(COAP_OPTION_OBSERVE, observe, "Observe");
-  COAP_SERIALIZE_INT_OPTION(COAP_OPTION_URI_PORT, uri_port, "Uri-Port");
-  COAP_SERIALIZE_STRING_OPTION(COAP_OPTION_LOCATION_PATH, location_path, '/',
-                               "Location-Path");
-  COAP_SERIALIZE_STRING_OPTION(COAP_OPTION_URI_PATH, uri_path, '/',
-                               "Uri-Path");
-  PRINTF("Serialize content format: %d\n", coap_pkt->content_format);
-  COAP_SERIALIZE_INT_OPTION(COAP_OPTION_CONTENT_FORMAT, content_format,
-                            "Content-Format");
-  COAP_SERIALIZE_INT_OPTION(COAP_OPTION_MAX_AGE, max_age, "Max-Age");
-  COAP_SERIALIZE_STRING_OPTION(COAP_OPTION_URI_QUERY, uri_query, '&',
-                               "Uri-Query");
-  COAP_SERIALIZE_INT_OPTION(COAP_OPTION_ACCEPT, accept, "Accept");
-  COAP_SERIALIZE_STRING_OPTION(COAP_OPTION_LOCATION_QUERY, location_query,
-                               '&', "Location-Query");
-  COAP_SERIALIZE_BLOCK_OPTION(COAP_OPTION_BLOCK2, block2, "Block2");
-  COAP_SERIALIZE_BLOCK_OPTION(COAP_OPTION_BLOCK1, block1, "Block1");
-  COAP_SERIALIZE_INT_OPTION(COAP_OPTION_SIZE2, size2, "Size2");
-  COAP_SERIALIZE_STRING_OPTION(COAP_OPTION_PROXY_URI, proxy_uri, '\0',
-                               "Proxy-Uri");
-  COAP_SERIALIZE_STRING_OPTION(COAP_OPTION_PROXY_SCHEME, proxy_scheme, '\0',
-                               "Proxy-Scheme");
-  COAP_SERIALIZE_INT_OPTION(COAP_OPTION_SIZE1, size1, "Size1");
+  /* Walk the set option bits - this gives the options in number order */
+  for(i = 0; i < sizeof(coap_pkt->options); i++) {
+    bits = coap_pkt->options[i];
+    number = i * OPTION_MAP_SIZE;
+    while(bits != 0) {
+      if((bits & 0x0f) == 0) {
+        /* skip four unset options at once */
+        bits >>= 4;
+        number += 4;
+        continue;
+      }
+      if(bits & 1) {
+        len = coap_serialize_option(coap_pkt, number, current_number, option);
+        if(len > 0) {
+          option += len;
+          current_number = number;
+        }
+      }
+      bits >>= 1;
+      number++;
+    }
+  }
 
   PRINTF("-Done serializing at %p----\n", option);
 
@@ -426,6 +557,16 @@ void
 coap_send_message(uip_ipaddr_t *addr, uint16_t port, uint8_t *data,
                   uint16_t length)
 {
+  TRACE(COAP_SEND, length, uip_ntohs(port));
+  if(coap_tcp_send(addr, port, data, length)) {
+    /* the endpoint is connected over TCP */
+    return;
+  }
+  if(coap_dtls_send(addr, port, data, length)) {
+    /* the endpoint has a secure session */
+    return;
+  }
+
   /* configure connection to reply to client */
   uip_ipaddr_copy(&udp_conn->ripaddr, addr);
   udp_conn->rport = port;
@@ -439,6 +580,276 @@ coap_send_message(uip_ipaddr_t *addr, uint16_t port, uint8_t *data,
   udp_conn->rport = 0;
 }
 /*---------------------------------------------------------------------------*/
+static uint8_t *
+parse_option_header(uint8_t *current_option, unsigned int *option_delta,
+                    size_t *option_length)
+{
+  *option_delta = current_option[0] >> 4;
+  *option_length = current_option[0] & 0x0F;
+  ++current_option;
+
+  if(*option_delta == 13) {
+    *option_delta += current_option[0];
+    ++current_option;
+  } else if(*option_delta == 14) {
+    *option_delta += 255;
+    *option_delta += current_option[0] << 8;
+    ++current_option;
+    *option_delta += current_option[0];
+    ++current_option;
+  }
+
+  if(*option_length == 13) {
+    *option_length += current_option[0];
+    ++current_option;
+  } else if(*option_length == 14) {
+    *option_length += 255;
+    *option_length += current_option[0] << 8;
+    ++current_option;
+    *option_length += current_option[0];
+    ++current_option;
+  }
+  return current_option;
+}
+/*---------------------------------------------------------------------------*/
+static coap_status_t
+parse_option(coap_packet_t *coap_pkt, unsigned int option_number,
+             uint8_t *current_option, size_t option_length)
+{
+  switch(option_number) {
+  case COAP_OPTION_CONTENT_FORMAT:
+    coap_pkt->content_format = coap_parse_int_option(current_option,
+                                                     option_length);
+    PRINTF("Content-Format [%u]\n", coap_pkt->content_format);
+    break;
+  case COAP_OPTION_MAX_AGE:
+    coap_pkt->max_age = coap_parse_int_option(current_option,
+                                              option_length);
+    PRINTF("Max-Age [%lu]\n", (unsigned long)coap_pkt->max_age);
+    break;
+  case COAP_OPTION_ETAG:
+    coap_pkt->etag_len = MIN(COAP_ETAG_LEN, option_length);
+    memcpy(coap_pkt->etag, current_option, coap_pkt->etag_len);
+    PRINTF("ETag %u [0x%02X%02X%02X%02X%02X%02X%02X%02X]\n",
+           coap_pkt->etag_len, coap_pkt->etag[0], coap_pkt->etag[1],
+           coap_pkt->etag[2], coap_pkt->etag[3], coap_pkt->etag[4],
+           coap_pkt->etag[5], coap_pkt->etag[6], coap_pkt->etag[7]
+           );                 /*FIXME always prints 8 bytes */
+    break;
+  case COAP_OPTION_ACCEPT:
+    coap_pkt->accept = coap_parse_int_option(current_option, option_length);
+    PRINTF("Accept [%u]\n", coap_pkt->accept);
+    break;
+  case COAP_OPTION_IF_MATCH:
+    /* TODO support multiple ETags */
+    coap_pkt->if_match_len = MIN(COAP_ETAG_LEN, option_length);
+    memcpy(coap_pkt->if_match, current_option, coap_pkt->if_match_len);
+    PRINTF("If-Match %u [0x%02X%02X%02X%02X%02X%02X%02X%02X]\n",
+           coap_pkt->if_match_len, coap_pkt->if_match[0],
+           coap_pkt->if_match[1], coap_pkt->if_match[2],
+           coap_pkt->if_match[3], coap_pkt->if_match[4],
+           coap_pkt->if_match[5], coap_pkt->if_match[6],
+           coap_pkt->if_match[7]
+           ); /* FIXME always prints 8 bytes */
+    break;
+  case COAP_OPTION_IF_NONE_MATCH:
+    coap_pkt->if_none_match = 1;
+    PRINTF("If-None-Match\n");
+    break;
+
+  case COAP_OPTION_PROXY_URI:
+#if COAP_PROXY_OPTION_PROCESSING
+    /* handled by the forward proxy resource, see er-coap-proxy.h */
+    coap_pkt->proxy_uri = (char *)current_option;
+    coap_pkt->proxy_uri_len = option_length;
+    PRINTF("Proxy-Uri [%.*s]\n", (int)coap_pkt->proxy_uri_len,
+           coap_pkt->proxy_uri);
+#else /* COAP_PROXY_OPTION_PROCESSING */
+    PRINTF("Proxy-Uri NOT IMPLEMENTED [%.*s]\n", (int)option_length,
+           (char *)current_option);
+    coap_error_message = "This is a constrained server (Contiki)";
+    return PROXYING_NOT_SUPPORTED_5_05;
+#endif /* COAP_PROXY_OPTION_PROCESSING */
+    break;
+  case COAP_OPTION_PROXY_SCHEME:
+#if COAP_PROXY_OPTION_PROCESSING
+    coap_pkt->proxy_scheme = (char *)current_option;
+    coap_pkt->proxy_scheme_len = option_length;
+#endif
+    PRINTF("Proxy-Scheme NOT IMPLEMENTED [%.*s]\n",
+           (int)coap_pkt->proxy_scheme_len, coap_pkt->proxy_scheme);
+    coap_error_message = "This is a constrained server (Contiki)";
+    return PROXYING_NOT_SUPPORTED_5_05;
+    break;
+
+  case COAP_OPTION_URI_HOST:
+    coap_pkt->uri_host = (char *)current_option;
+    coap_pkt->uri_host_len = option_length;
+    PRINTF("Uri-Host [%.*s]\n", (int)coap_pkt->uri_host_len,
+	     coap_pkt->uri_host);
+    break;
+  case COAP_OPTION_URI_PORT:
+    coap_pkt->uri_port = coap_parse_int_option(current_option,
+                                               option_length);
+    PRINTF("Uri-Port [%u]\n", coap_pkt->uri_port);
+    break;
+  case COAP_OPTION_URI_PATH:
+    /* coap_merge_multi_option() operates in-place on the IPBUF, but final packet field should be const string -> cast to string */
+    coap_merge_multi_option((char **)&(coap_pkt->uri_path),
+                            &(coap_pkt->uri_path_len), current_option,
+                            option_length, '/');
+    PRINTF("Uri-Path [%.*s]\n", (int)coap_pkt->uri_path_len, coap_pkt->uri_path);
+    break;
+  case COAP_OPTION_URI_QUERY:
+    /* coap_merge_multi_option() operates in-place on the IPBUF, but final packet field should be const string -> cast to string */
+    coap_merge_multi_option((char **)&(coap_pkt->uri_query),
+                            &(coap_pkt->uri_query_len), current_option,
+                            option_length, '&');
+    PRINTF("Uri-Query [%.*s]\n", (int)coap_pkt->uri_query_len,
+           coap_pkt->uri_query);
+    break;
+
+  case COAP_OPTION_LOCATION_PATH:
+    /* coap_merge_multi_option() operates in-place on the IPBUF, but final packet field should be const string -> cast to string */
+    coap_merge_multi_option((char **)&(coap_pkt->location_path),
+                            &(coap_pkt->location_path_len), current_option,
+                            option_length, '/');
+    PRINTF("Location-Path [%.*s]\n", (int)coap_pkt->location_path_len,
+           coap_pkt->location_path);
+    break;
+  case COAP_OPTION_LOCATION_QUERY:
+    /* coap_merge_multi_option() operates in-place on the IPBUF, but final packet field should be const string -> cast to string */
+    coap_merge_multi_option((char **)&(coap_pkt->location_query),
+                            &(coap_pkt->location_query_len), current_option,
+                            option_length, '&');
+    PRINTF("Location-Query [%.*s]\n", (int)coap_pkt->location_query_len,
+           coap_pkt->location_query);
+    break;
+
+  case COAP_OPTION_OBSERVE:
+    coap_pkt->observe = coap_parse_int_option(current_option,
+                                              option_length);
+    PRINTF("Observe [%lu]\n", (unsigned long)coap_pkt->observe);
+    break;
+  case COAP_OPTION_BLOCK2:
+    coap_pkt->block2_num = coap_parse_int_option(current_option,
+                                                 option_length);
+    coap_pkt->block2_more = (coap_pkt->block2_num & 0x08) >> 3;
+    coap_pkt->block2_size = 16 << (coap_pkt->block2_num & 0x07);
+    coap_pkt->block2_offset = (coap_pkt->block2_num & ~0x0000000F)
+      << (coap_pkt->block2_num & 0x07);
+    coap_pkt->block2_num >>= 4;
+    PRINTF("Block2 [%lu%s (%u B/blk)]\n",
+           (unsigned long)coap_pkt->block2_num,
+           coap_pkt->block2_more ? "+" : "", coap_pkt->block2_size);
+    break;
+  case COAP_OPTION_BLOCK1:
+    coap_pkt->block1_num = coap_parse_int_option(current_option,
+                                                 option_length);
+    coap_pkt->block1_more = (coap_pkt->block1_num & 0x08) >> 3;
+    coap_pkt->block1_size = 16 << (coap_pkt->block1_num & 0x07);
+    coap_pkt->block1_offset = (coap_pkt->block1_num & ~0x0000000F)
+      << (coap_pkt->block1_num & 0x07);
+    coap_pkt->block1_num >>= 4;
+    PRINTF("Block1 [%lu%s (%u B/blk)]\n",
+           (unsigned long)coap_pkt->block1_num,
+           coap_pkt->block1_more ? "+" : "", coap_pkt->block1_size);
+    break;
+  case COAP_OPTION_SIZE2:
+    coap_pkt->size2 = coap_parse_int_option(current_option, option_length);
+    PRINTF("Size2 [%lu]\n", (unsigned long)coap_pkt->size2);
+    break;
+  case COAP_OPTION_SIZE1:
+    coap_pkt->size1 = coap_parse_int_option(current_option, option_length);
+    PRINTF("Size1 [%lu]\n", (unsigned long)coap_pkt->size1);
+    break;
+  default:
+    PRINTF("unknown (%u)\n", option_number);
+    /* check if critical (odd) */
+    if(option_number & 1) {
+      coap_error_message = "Unsupported critical option";
+      return BAD_OPTION_4_02;
+    }
+  }
+  return NO_ERROR;
+}
+/*---------------------------------------------------------------------------*/
+#if COAP_LAZY_OPTION_PARSING
+/*
+ * Options that are only read through the coap_get_header_*() functions
+ * are not decoded by coap_parse_message(). Each has a slot with the
+ * offset of its first occurrence in the packet buffer.
+ */
+static int
+get_lazy_slot(unsigned int option_number)
+{
+  switch(option_number) {
+  case COAP_OPTION_IF_MATCH:
+    return 0;
+  case COAP_OPTION_URI_HOST:
+    return 1;
+  case COAP_OPTION_ETAG:
+    return 2;
+  case COAP_OPTION_LOCATION_PATH:
+    return 3;
+  case COAP_OPTION_MAX_AGE:
+    return 4;
+  case COAP_OPTION_URI_QUERY:
+    return 5;
+  case COAP_OPTION_LOCATION_QUERY:
+    return 6;
+  case COAP_OPTION_SIZE2:
+    return 7;
+  case COAP_OPTION_SIZE1:
+    return 8;
+  default:
+    return -1;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+decode_lazy_option(coap_packet_t *coap_pkt, unsigned int option_number)
+{
+  uint8_t *option;
+  uint8_t *end;
+  unsigned int option_delta;
+  size_t option_length;
+  int slot;
+
+  slot = get_lazy_slot(option_number);
+  if(slot < 0 || (coap_pkt->lazy_pending & (1 << slot)) == 0) {
+    return;
+  }
+  coap_pkt->lazy_pending &= ~(1 << slot);
+
+  option = coap_pkt->buffer + coap_pkt->lazy_offset[slot];
+  end = coap_pkt->buffer + coap_pkt->lazy_end;
+  /* repeated options follow directly with option delta 0 */
+  do {
+    option = parse_option_header(option, &option_delta, &option_length);
+    parse_option(coap_pkt, option_number, option, option_length);
+    option += option_length;
+  } while(option < end && (option[0] & 0xF0) == 0);
+}
+/*---------------------------------------------------------------------------*/
+static void
+decode_lazy_options(coap_packet_t *coap_pkt)
+{
+  static const uint8_t lazy_options[] = {
+    COAP_OPTION_IF_MATCH, COAP_OPTION_URI_HOST, COAP_OPTION_ETAG,
+    COAP_OPTION_LOCATION_PATH, COAP_OPTION_MAX_AGE, COAP_OPTION_URI_QUERY,
+    COAP_OPTION_LOCATION_QUERY, COAP_OPTION_SIZE2, COAP_OPTION_SIZE1
+  };
+  int i;
+  for(i = 0; coap_pkt->lazy_pending != 0 && i < sizeof(lazy_options); i++) {
+    decode_lazy_option(coap_pkt, lazy_options[i]);
+  }
+}
+#define DECODE_LAZY_OPTION(packet, number) decode_lazy_option(packet, number)
+#else /* COAP_LAZY_OPTION_PARSING */
+#define DECODE_LAZY_OPTION(packet, number)
+#endif /* COAP_LAZY_OPTION_PARSING */
+/*---------------------------------------------------------------------------*/
 coap_status_t
 coap_parse_message(void *packet, uint8_t *data, uint16_t data_len)
 {
@@ -486,10 +897,20 @@ coap_parse_message(void *packet, uint8_t *data, uint16_t data_len)
   unsigned int option_number = 0;
   unsigned int option_delta = 0;
   size_t option_length = 0;
+  coap_status_t status;
+#if COAP_LAZY_OPTION_PARSING
+  uint8_t *option_start;
+  int slot;
+
+  coap_pkt->lazy_end = data_len;
+#endif /* COAP_LAZY_OPTION_PARSING */
 
   while(current_option < data + data_len) {
     /* payload marker 0xFF, currently only checking for 0xF* because rest is reserved */
     if((current_option[0] & 0xF0) == 0xF0) {
+#if COAP_LAZY_OPTION_PARSING
+      coap_pkt->lazy_end = current_option - data;
+#endif /* COAP_LAZY_OPTION_PARSING */
       coap_pkt->payload = ++current_option;
       coap_pkt->payload_len = data_len - (coap_pkt->payload - data);
 
@@ -503,189 +924,36 @@ coap_parse_message(void *packet, uint8_t *data, uint16_t data_len)
       break;
     }
 
-    option_delta = current_option[0] >> 4;
-    option_length = current_option[0] & 0x0F;
-    ++current_option;
-
-    if(option_delta == 13) {
-      option_delta += current_option[0];
-      ++current_option;
-    } else if(option_delta == 14) {
-      option_delta += 255;
-      option_delta += current_option[0] << 8;
-      ++current_option;
-      option_delta += current_option[0];
-      ++current_option;
-    }
-
-    if(option_length == 13) {
-      option_length += current_option[0];
-      ++current_option;
-    } else if(option_length == 14) {
-      option_length += 255;
-      option_length += current_option[0] << 8;
-      ++current_option;
-      option_length += current_option[0];
-      ++current_option;
-    }
-
+#if COAP_LAZY_OPTION_PARSING
+    option_start = current_option;
+#endif /* COAP_LAZY_OPTION_PARSING */
+    current_option = parse_option_header(current_option, &option_delta,
+                                         &option_length);
     option_number += option_delta;
 
     PRINTF("OPTION %u (delta %u, len %zu): ", option_number, option_delta,
            option_length);
 
-    SET_OPTION(coap_pkt, option_number);
-
-    switch(option_number) {
-    case COAP_OPTION_CONTENT_FORMAT:
-      coap_pkt->content_format = coap_parse_int_option(current_option,
-                                                       option_length);
-      PRINTF("Content-Format [%u]\n", coap_pkt->content_format);
-      break;
-    case COAP_OPTION_MAX_AGE:
-      coap_pkt->max_age = coap_parse_int_option(current_option,
-                                                option_length);
-      PRINTF("Max-Age [%lu]\n", (unsigned long)coap_pkt->max_age);
-      break;
-    case COAP_OPTION_ETAG:
-      coap_pkt->etag_len = MIN(COAP_ETAG_LEN, option_length);
-      memcpy(coap_pkt->etag, current_option, coap_pkt->etag_len);
-      PRINTF("ETag %u [0x%02X%02X%02X%02X%02X%02X%02X%02X]\n",
-             coap_pkt->etag_len, coap_pkt->etag[0], coap_pkt->etag[1],
-             coap_pkt->etag[2], coap_pkt->etag[3], coap_pkt->etag[4],
-             coap_pkt->etag[5], coap_pkt->etag[6], coap_pkt->etag[7]
-             );                 /*FIXME always prints 8 bytes */
-      break;
-    case COAP_OPTION_ACCEPT:
-      coap_pkt->accept = coap_parse_int_option(current_option, option_length);
-      PRINTF("Accept [%u]\n", coap_pkt->accept);
-      break;
-    case COAP_OPTION_IF_MATCH:
-      /* TODO support multiple ETags */
-      coap_pkt->if_match_len = MIN(COAP_ETAG_LEN, option_length);
-      memcpy(coap_pkt->if_match, current_option, coap_pkt->if_match_len);
-      PRINTF("If-Match %u [0x%02X%02X%02X%02X%02X%02X%02X%02X]\n",
-             coap_pkt->if_match_len, coap_pkt->if_match[0],
-             coap_pkt->if_match[1], coap_pkt->if_match[2],
-             coap_pkt->if_match[3], coap_pkt->if_match[4],
-             coap_pkt->if_match[5], coap_pkt->if_match[6],
-             coap_pkt->if_match[7]
-             ); /* FIXME always prints 8 bytes */
-      break;
-    case COAP_OPTION_IF_NONE_MATCH:
-      coap_pkt->if_none_match = 1;
-      PRINTF("If-None-Match\n");
-      break;
-
-    case COAP_OPTION_PROXY_URI:
-#if COAP_PROXY_OPTION_PROCESSING
-      coap_pkt->proxy_uri = (char *)current_option;
-      coap_pkt->proxy_uri_len = option_length;
-#endif
-      PRINTF("Proxy-Uri NOT IMPLEMENTED [%.*s]\n", (int)coap_pkt->proxy_uri_len,
-             coap_pkt->proxy_uri);
-      coap_error_message = "This is a constrained server (Contiki)";
-      return PROXYING_NOT_SUPPORTED_5_05;
-      break;
-    case COAP_OPTION_PROXY_SCHEME:
-#if COAP_PROXY_OPTION_PROCESSING
-      coap_pkt->proxy_scheme = (char *)current_option;
-      coap_pkt->proxy_scheme_len = option_length;
-#endif
-      PRINTF("Proxy-Scheme NOT IMPLEMENTED [%.*s]\n",
-             (int)coap_pkt->proxy_scheme_len, coap_pkt->proxy_scheme);
-      coap_error_message = "This is a constrained server (Contiki)";
-      return PROXYING_NOT_SUPPORTED_5_05;
-      break;
-
-    case COAP_OPTION_URI_HOST:
-      coap_pkt->uri_host = (char *)current_option;
-      coap_pkt->uri_host_len = option_length;
-      PRINTF("Uri-Host [%.*s]\n", (int)coap_pkt->uri_host_len,
-	     coap_pkt->uri_host);
-      break;
-    case COAP_OPTION_URI_PORT:
-      coap_pkt->uri_port = coap_parse_int_option(current_option,
-                                                 option_length);
-      PRINTF("Uri-Port [%u]\n", coap_pkt->uri_port);
-      break;
-    case COAP_OPTION_URI_PATH:
-      /* coap_merge_multi_option() operates in-place on the IPBUF, but final packet field should be const string -> cast to string */
-      coap_merge_multi_option((char **)&(coap_pkt->uri_path),
-                              &(coap_pkt->uri_path_len), current_option,
-                              option_length, '/');
-      PRINTF("Uri-Path [%.*s]\n", (int)coap_pkt->uri_path_len, coap_pkt->uri_path);
-      break;
-    case COAP_OPTION_URI_QUERY:
-      /* coap_merge_multi_option() operates in-place on the IPBUF, but final packet field should be const string -> cast to string */
-      coap_merge_multi_option((char **)&(coap_pkt->uri_query),
-                              &(coap_pkt->uri_query_len), current_option,
-                              option_length, '&');
-      PRINTF("Uri-Query [%.*s]\n", (int)coap_pkt->uri_query_len,
-             coap_pkt->uri_query);
-      break;
+#if COAP_LAZY_OPTION_PARSING
+    slot = get_lazy_slot(option_number);
+    if(slot >= 0) {
+      /* only record where the option starts - decoded on first access */
+      if(!IS_OPTION(coap_pkt, option_number)) {
+        coap_pkt->lazy_offset[slot] = option_start - data;
+        coap_pkt->lazy_pending |= 1 << slot;
+      }
+      SET_OPTION(coap_pkt, option_number);
+      current_option += option_length;
+      continue;
+    }
+#endif /* COAP_LAZY_OPTION_PARSING */
 
-    case COAP_OPTION_LOCATION_PATH:
-      /* coap_merge_multi_option() operates in-place on the IPBUF, but final packet field should be const string -> cast to string */
-      coap_merge_multi_option((char **)&(coap_pkt->location_path),
-                              &(coap_pkt->location_path_len), current_option,
-                              option_length, '/');
-      PRINTF("Location-Path [%.*s]\n", (int)coap_pkt->location_path_len,
-             coap_pkt->location_path);
-      break;
-    case COAP_OPTION_LOCATION_QUERY:
-      /* coap_merge_multi_option() operates in-place on the IPBUF, but final packet field should be const string -> cast to string */
-      coap_merge_multi_option((char **)&(coap_pkt->location_query),
-                              &(coap_pkt->location_query_len), current_option,
-                              option_length, '&');
-      PRINTF("Location-Query [%.*s]\n", (int)coap_pkt->location_query_len,
-             coap_pkt->location_query);
-      break;
+    SET_OPTION(coap_pkt, option_number);
 
-    case COAP_OPTION_OBSERVE:
-      coap_pkt->observe = coap_parse_int_option(current_option,
-                                                option_length);
-      PRINTF("Observe [%lu]\n", (unsigned long)coap_pkt->observe);
-      break;
-    case COAP_OPTION_BLOCK2:
-      coap_pkt->block2_num = coap_parse_int_option(current_option,
-                                                   option_length);
-      coap_pkt->block2_more = (coap_pkt->block2_num & 0x08) >> 3;
-      coap_pkt->block2_size = 16 << (coap_pkt->block2_num & 0x07);
-      coap_pkt->block2_offset = (coap_pkt->block2_num & ~0x0000000F)
-        << (coap_pkt->block2_num & 0x07);
-      coap_pkt->block2_num >>= 4;
-      PRINTF("Block2 [%lu%s (%u B/blk)]\n",
-             (unsigned long)coap_pkt->block2_num,
-             coap_pkt->block2_more ? "+" : "", coap_pkt->block2_size);
-      break;
-    case COAP_OPTION_BLOCK1:
-      coap_pkt->block1_num = coap_parse_int_option(current_option,
-                                                   option_length);
-      coap_pkt->block1_more = (coap_pkt->block1_num & 0x08) >> 3;
-      coap_pkt->block1_size = 16 << (coap_pkt->block1_num & 0x07);
-      coap_pkt->block1_offset = (coap_pkt->block1_num & ~0x0000000F)
-        << (coap_pkt->block1_num & 0x07);
-      coap_pkt->block1_num >>= 4;
-      PRINTF("Block1 [%lu%s (%u B/blk)]\n",
-             (unsigned long)coap_pkt->block1_num,
-             coap_pkt->block1_more ? "+" : "", coap_pkt->block1_size);
-      break;
-    case COAP_OPTION_SIZE2:
-      coap_pkt->size2 = coap_parse_int_option(current_option, option_length);
-      PRINTF("Size2 [%lu]\n", (unsigned long)coap_pkt->size2);
-      break;
-    case COAP_OPTION_SIZE1:
-      coap_pkt->size1 = coap_parse_int_option(current_option, option_length);
-      PRINTF("Size1 [%lu]\n", (unsigned long)coap_pkt->size1);
-      break;
-    default:
-      PRINTF("unknown (%u)\n", option_number);
-      /* check if critical (odd) */
-      if(option_number & 1) {
-        coap_error_message = "Unsupported critical option";
-        return BAD_OPTION_4_02;
-      }
+    status = parse_option(coap_pkt, option_number, current_option,
+                          option_length);
+    if(status != NO_ERROR) {
+      return status;
     }
 
     current_option += option_length;
@@ -702,6 +970,7 @@ coap_get_query_variable(void *packet, const char *name, const char **output)
 {
   coap_packet_t *const coap_pkt = (coap_packet_t *)packet;
 
+  DECODE_LAZY_OPTION(coap_pkt, COAP_OPTION_URI_QUERY);
   if(IS_OPTION(coap_pkt, COAP_OPTION_URI_QUERY)) {
     return coap_get_variable(coap_pkt->uri_query, coap_pkt->uri_query_len,
                              name, output);
@@ -791,6 +1060,7 @@ coap_get_header_max_age(void *packet, uint32_t *age)
 {
   coap_packet_t *const coap_pkt = (coap_packet_t *)packet;
 
+  DECODE_LAZY_OPTION(coap_pkt, COAP_OPTION_MAX_AGE);
   if(!IS_OPTION(coap_pkt, COAP_OPTION_MAX_AGE)) {
     *age = COAP_DEFAULT_MAX_AGE;
   } else {
@@ -812,6 +1082,7 @@ coap_get_header_etag(void *packet, const uint8_t **etag)
 {
   coap_packet_t *const coap_pkt = (coap_packet_t *)packet;
 
+  DECODE_LAZY_OPTION(coap_pkt, COAP_OPTION_ETAG);
   if(!IS_OPTION(coap_pkt, COAP_OPTION_ETAG)) {
     return 0;
   }
@@ -836,6 +1107,7 @@ coap_get_header_if_match(void *packet, const uint8_t **etag)
 {
   coap_packet_t *const coap_pkt = (coap_packet_t *)packet;
 
+  DECODE_LAZY_OPTION(coap_pkt, COAP_OPTION_IF_MATCH);
   if(!IS_OPTION(coap_pkt, COAP_OPTION_IF_MATCH)) {
     return 0;
   }
@@ -897,6 +1169,7 @@ coap_get_header_uri_host(void *packet, const char **host)
 {
   coap_packet_t *const coap_pkt = (coap_packet_t *)packet;
 
+  DECODE_LAZY_OPTION(coap_pkt, COAP_OPTION_URI_HOST);
   if(!IS_OPTION(coap_pkt, COAP_OPTION_URI_HOST)) {
     return 0;
   }
@@ -946,6 +1219,7 @@ coap_get_header_uri_query(void *packet, const char **query)
 {
   coap_packet_t *const coap_pkt = (coap_packet_t *)packet;
 
+  DECODE_LAZY_OPTION(coap_pkt, COAP_OPTION_URI_QUERY);
   if(!IS_OPTION(coap_pkt, COAP_OPTION_URI_QUERY)) {
     return 0;
   }
@@ -972,6 +1246,7 @@ coap_get_header_location_path(void *packet, const char **path)
 {
   coap_packet_t *const coap_pkt = (coap_packet_t *)packet;
 
+  DECODE_LAZY_OPTION(coap_pkt, COAP_OPTION_LOCATION_PATH);
   if(!IS_OPTION(coap_pkt, COAP_OPTION_LOCATION_PATH)) {
     return 0;
   }
@@ -1006,6 +1281,7 @@ coap_get_header_location_query(void *packet, const char **query)
 {
   coap_packet_t *const coap_pkt = (coap_packet_t *)packet;
 
+  DECODE_LAZY_OPTION(coap_pkt, COAP_OPTION_LOCATION_QUERY);
   if(!IS_OPTION(coap_pkt, COAP_OPTION_LOCATION_QUERY)) {
     return 0;
   }
@@ -1147,6 +1423,7 @@ coap_get_header_size2(void *packet, uint32_t *size)
 {
   coap_packet_t *const coap_pkt = (coap_packet_t *)packet;
 
+  DECODE_LAZY_OPTION(coap_pkt, COAP_OPTION_SIZE2);
   if(!IS_OPTION(coap_pkt, COAP_OPTION_SIZE2)) {
     return 0;
   }
@@ -1168,6 +1445,7 @@ coap_get_header_size1(void *packet, uint32_t *size)
 {
   coap_packet_t *const coap_pkt = (coap_packet_t *)packet;
 
+  DECODE_LAZY_OPTION(coap_pkt, COAP_OPTION_SIZE1);
   if(!IS_OPTION(coap_pkt, COAP_OPTION_SIZE1)) {
     return 0;
   }
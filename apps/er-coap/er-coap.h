@@ -79,6 +79,9 @@ enum { OPTION_MAP_SIZE = sizeof(uint8_t) * 8 };
 #define SET_OPTION(packet, opt) ((packet)->options[opt / OPTION_MAP_SIZE] |= 1 << (opt % OPTION_MAP_SIZE))
 #define IS_OPTION(packet, opt) ((packet)->options[opt / OPTION_MAP_SIZE] & (1 << (opt % OPTION_MAP_SIZE)))
 
+/* number of options that are decoded on demand with lazy parsing */
+#define COAP_LAZY_OPTION_SLOTS 9
+
 /* parsed message struct */
 typedef struct {
   uint8_t *buffer; /* pointer to CoAP header / incoming packet buffer / memory to serialize packet */
@@ -128,55 +131,28 @@ typedef struct {
   const char *uri_query;
   uint8_t if_none_match;
 
+#if COAP_LAZY_OPTION_PARSING
+  /* options that have not been decoded yet, see coap_parse_message() */
+  uint16_t lazy_pending;
+  uint16_t lazy_end;
+  uint16_t lazy_offset[COAP_LAZY_OPTION_SLOTS];
+#endif /* COAP_LAZY_OPTION_PARSING */
+
   uint16_t payload_len;
   uint8_t *payload;
 } coap_packet_t;
 
-/* option format serialization */
-#define COAP_SERIALIZE_INT_OPTION(number, field, text) \
-  if(IS_OPTION(coap_pkt, number)) { \
-    PRINTF(text " [%u]\n", (unsigned int)coap_pkt->field);		\
-    option += coap_serialize_int_option(number, current_number, option, coap_pkt->field); \
-    current_number = number; \
-  }
-#define COAP_SERIALIZE_BYTE_OPTION(number, field, text) \
-  if(IS_OPTION(coap_pkt, number)) { \
-    PRINTF(text " %u [0x%02X%02X%02X%02X%02X%02X%02X%02X]\n", (unsigned int)coap_pkt->field##_len, \
-           coap_pkt->field[0], \
-           coap_pkt->field[1], \
-           coap_pkt->field[2], \
-           coap_pkt->field[3], \
-           coap_pkt->field[4], \
-           coap_pkt->field[5], \
-           coap_pkt->field[6], \
-           coap_pkt->field[7] \
-           ); /* FIXME always prints 8 bytes */ \
-    option += coap_serialize_array_option(number, current_number, option, coap_pkt->field, coap_pkt->field##_len, '\0'); \
-    current_number = number; \
-  }
-#define COAP_SERIALIZE_STRING_OPTION(number, field, splitter, text) \
-  if(IS_OPTION(coap_pkt, number)) { \
-    PRINTF(text " [%.*s]\n", (int)coap_pkt->field##_len, coap_pkt->field); \
-    option += coap_serialize_array_option(number, current_number, option, (uint8_t *)coap_pkt->field, coap_pkt->field##_len, splitter); \
-    current_number = number; \
-  }
-#define COAP_SERIALIZE_BLOCK_OPTION(number, field, text) \
-  if(IS_OPTION(coap_pkt, number)) \
-  { \
-    PRINTF(text " [%lu%s (%u B/blk)]\n", (unsigned long)coap_pkt->field##_num, coap_pkt->field##_more ? "+" : "", coap_pkt->field##_size); \
-    uint32_t block = coap_pkt->field##_num << 4; \
-    if(coap_pkt->field##_more) { block |= 0x8; } \
-    block |= 0xF & coap_log_2(coap_pkt->field##_size / 16); \
-    PRINTF(text " encoded: 0x%lX\n", (unsigned long)block);		\
-    option += coap_serialize_int_option(number, current_number, option, block); \
-    current_number = number; \
-  }
-
 /* to store error code and human-readable payload */
 extern coap_status_t erbium_status_code;
 extern char *coap_error_message;
 
 void coap_init_connection(uint16_t port);
+#if COAP_GROUP_COMMUNICATION
+/* receive requests sent to a multicast group, e.g. ff05::fd (All CoAP
+   Nodes), returns 0 if there is no free multicast address slot */
+int coap_join_group(const uip_ipaddr_t *group);
+void coap_leave_group(const uip_ipaddr_t *group);
+#endif /* COAP_GROUP_COMMUNICATION */
 uint16_t coap_get_mid(void);
 
 void coap_init_message(void *packet, coap_message_type_t type, uint8_t code,
@@ -117,6 +117,347 @@ httpd_state_alloc(void)
 /*---------------------------------------------------------------------------*/
 #define httpd_state_free(s) (s->state = HTTPD_WS_STATE_UNUSED)
 /*---------------------------------------------------------------------------*/
+#if HTTPD_WS_WEBSOCKET
+#define WS_FIN           0x80
+#define WS_MASKED        0x80
+#define WS_OPCODE        0x0f
+#define WS_OPCODE_TEXT   0x1
+#define WS_OPCODE_BINARY 0x2
+#define WS_OPCODE_CLOSE  0x8
+#define WS_OPCODE_PING   0x9
+#define WS_OPCODE_PONG   0xa
+
+/* Frame header, written in front of a payload once its length is known */
+#define WS_HEADER_MAX    4
+
+#define WS_READ_OPCODE   0
+#define WS_READ_LEN      1
+#define WS_READ_LEN16    2
+#define WS_READ_MASK     3
+#define WS_READ_PAYLOAD  4
+
+#define WS_FLAG_UPGRADE  0x01
+#define WS_FLAG_CLOSING  0x02
+
+#define WS_CLOSE_NORMAL   1000
+#define WS_CLOSE_PROTOCOL 1002
+#define WS_CLOSE_TOO_BIG  1009
+
+static const char http_ws_key[] = "Sec-WebSocket-Key:";
+static const char http_ws_guid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+static const char http_header_101[] =
+  "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n"
+  "Connection: Upgrade\r\nSec-WebSocket-Accept: ";
+static const char base64[] =
+  "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+#define ROL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+/*---------------------------------------------------------------------------*/
+static void
+sha1_block(uint32_t *h, const uint8_t *block)
+{
+  uint32_t w[16];
+  uint32_t a, b, c, d, e, f, k, t;
+  int i;
+
+  for(i = 0; i < 16; i++) {
+    w[i] = (uint32_t)block[4 * i] << 24 | (uint32_t)block[4 * i + 1] << 16 |
+      (uint32_t)block[4 * i + 2] << 8 | block[4 * i + 3];
+  }
+  a = h[0];
+  b = h[1];
+  c = h[2];
+  d = h[3];
+  e = h[4];
+  for(i = 0; i < 80; i++) {
+    if(i >= 16) {
+      /* The message schedule, 16 words at a time */
+      t = w[(i + 13) & 15] ^ w[(i + 8) & 15] ^ w[(i + 2) & 15] ^ w[i & 15];
+      w[i & 15] = ROL(t, 1);
+    }
+    if(i < 20) {
+      f = (b & c) | (~b & d);
+      k = 0x5a827999;
+    } else if(i < 40) {
+      f = b ^ c ^ d;
+      k = 0x6ed9eba1;
+    } else if(i < 60) {
+      f = (b & c) | (b & d) | (c & d);
+      k = 0x8f1bbcdc;
+    } else {
+      f = b ^ c ^ d;
+      k = 0xca62c1d6;
+    }
+    t = ROL(a, 5) + f + e + k + w[i & 15];
+    e = d;
+    d = c;
+    c = ROL(b, 30);
+    b = a;
+    a = t;
+  }
+  h[0] += a;
+  h[1] += b;
+  h[2] += c;
+  h[3] += d;
+  h[4] += e;
+}
+/*---------------------------------------------------------------------------*/
+static void
+sha1(const uint8_t *data, uint16_t len, uint8_t *digest)
+{
+  uint32_t h[5] = { 0x67452301, 0xefcdab89, 0x98badcfe,
+                    0x10325476, 0xc3d2e1f0 };
+  uint8_t block[64];
+  uint32_t bits;
+  uint16_t left;
+  int i;
+
+  bits = (uint32_t)len * 8;
+  for(left = len; left >= sizeof(block); left -= sizeof(block)) {
+    sha1_block(h, data);
+    data += sizeof(block);
+  }
+  memcpy(block, data, left);
+  block[left++] = 0x80;
+  if(left > sizeof(block) - 8) {
+    memset(&block[left], 0, sizeof(block) - left);
+    sha1_block(h, block);
+    left = 0;
+  }
+  memset(&block[left], 0, sizeof(block) - 4 - left);
+  for(i = 0; i < 4; i++) {
+    block[sizeof(block) - 1 - i] = bits >> (8 * i);
+  }
+  sha1_block(h, block);
+  for(i = 0; i < 20; i++) {
+    digest[i] = h[i / 4] >> (24 - 8 * (i & 3));
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+base64_encode(char *out, const uint8_t *in, int len)
+{
+  uint32_t v;
+  int i;
+
+  for(i = 0; i < len; i += 3) {
+    v = (uint32_t)in[i] << 16;
+    if(i + 1 < len) {
+      v |= (uint32_t)in[i + 1] << 8;
+    }
+    if(i + 2 < len) {
+      v |= in[i + 2];
+    }
+    *out++ = base64[(v >> 18) & 0x3f];
+    *out++ = base64[(v >> 12) & 0x3f];
+    *out++ = i + 1 < len ? base64[(v >> 6) & 0x3f] : '=';
+    *out++ = i + 2 < len ? base64[v & 0x3f] : '=';
+  }
+  *out = '\0';
+}
+/*---------------------------------------------------------------------------*/
+/* Look for the headers of a websocket upgrade in a request header */
+static void
+websocket_header(struct httpd_ws_state *s)
+{
+  uint8_t digest[20];
+  char *value;
+  int len;
+
+  if(strncasecmp(s->inputbuf, "Upgrade:", 8) == 0) {
+    for(value = &s->inputbuf[8]; *value == ISO_space; value++);
+    if(strncasecmp(value, "websocket", 9) == 0) {
+      s->ws_flags |= WS_FLAG_UPGRADE;
+    }
+  } else if(strncasecmp(s->inputbuf, http_ws_key,
+                        sizeof(http_ws_key) - 1) == 0) {
+    for(value = &s->inputbuf[sizeof(http_ws_key) - 1]; *value == ISO_space;
+        value++);
+    len = strlen(value);
+    /* The accept key is the hash of the key followed by the GUID */
+    if(value + len + sizeof(http_ws_guid) <= s->inputbuf + sizeof(s->inputbuf)) {
+      memcpy(value + len, http_ws_guid, sizeof(http_ws_guid) - 1);
+      sha1((uint8_t *)value, len + sizeof(http_ws_guid) - 1, digest);
+      base64_encode(s->ws_accept, digest, sizeof(digest));
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Frames are written in outbuf after those already queued, payload
+   first, leaving room for the longest header in front of it */
+static int
+frame_room(struct httpd_ws_state *s)
+{
+  return (int)sizeof(s->outbuf) - s->outbuf_pos - WS_HEADER_MAX;
+}
+/*---------------------------------------------------------------------------*/
+static char *
+frame_payload(struct httpd_ws_state *s)
+{
+  return &s->outbuf[s->outbuf_pos + WS_HEADER_MAX];
+}
+/*---------------------------------------------------------------------------*/
+static void
+frame_append(struct httpd_ws_state *s, uint8_t opcode, uint16_t len)
+{
+  char *frame;
+
+  frame = &s->outbuf[s->outbuf_pos];
+  frame[0] = WS_FIN | opcode;
+  if(len < 126) {
+    memmove(&frame[2], &frame[WS_HEADER_MAX], len);
+    frame[1] = len;
+    s->outbuf_pos += 2 + len;
+  } else {
+    frame[1] = 126;
+    frame[2] = len >> 8;
+    frame[3] = len & 0xff;
+    s->outbuf_pos += 4 + len;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+websocket_close(struct httpd_ws_state *s, uint16_t code)
+{
+  char *payload;
+
+  if(frame_room(s) >= 2) {
+    payload = frame_payload(s);
+    payload[0] = code >> 8;
+    payload[1] = code & 0xff;
+    frame_append(s, WS_OPCODE_CLOSE, 2);
+  }
+  /* The connection is closed once the queued frames are sent */
+  s->ws_flags |= WS_FLAG_CLOSING;
+}
+/*---------------------------------------------------------------------------*/
+/* A frame has been received, with its payload in inputbuf */
+static void
+websocket_frame(struct httpd_ws_state *s)
+{
+  uint16_t len;
+
+  s->ws_rstate = WS_READ_OPCODE;
+  len = s->ws_len;
+  if(len > sizeof(s->inputbuf) - 1) {
+    /* Only part of it was kept */
+    if((s->ws_opcode & WS_OPCODE) >= WS_OPCODE_CLOSE) {
+      websocket_close(s, WS_CLOSE_PROTOCOL);
+    }
+    return;
+  }
+  s->inputbuf[len] = '\0';
+
+  switch(s->ws_opcode & WS_OPCODE) {
+  case WS_OPCODE_TEXT:
+  case WS_OPCODE_BINARY:
+    /* Fragmented messages are not reassembled */
+    if((s->ws_opcode & WS_FIN) && s->frame_input != NULL) {
+      s->frame_input(s, s->inputbuf, len);
+    }
+    break;
+  case WS_OPCODE_PING:
+    /* Answered if there is room, or else on the peer's next ping */
+    if(frame_room(s) >= len) {
+      memcpy(frame_payload(s), s->inputbuf, len);
+      frame_append(s, WS_OPCODE_PONG, len);
+    }
+    break;
+  case WS_OPCODE_CLOSE:
+    websocket_close(s, len >= 2 ?
+                    (uint8_t)s->inputbuf[0] << 8 | (uint8_t)s->inputbuf[1] :
+                    WS_CLOSE_NORMAL);
+    break;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Parse the frames received on a websocket, right from uip_appdata */
+static void
+websocket_input(struct httpd_ws_state *s, const uint8_t *data, uint16_t len)
+{
+  uint8_t c;
+
+  for(; len > 0 && !(s->ws_flags & WS_FLAG_CLOSING); len--) {
+    c = *data++;
+    switch(s->ws_rstate) {
+    case WS_READ_OPCODE:
+      s->ws_opcode = c;
+      s->ws_rstate = WS_READ_LEN;
+      break;
+    case WS_READ_LEN:
+      /* The frames of a client are always masked */
+      if(!(c & WS_MASKED)) {
+        websocket_close(s, WS_CLOSE_PROTOCOL);
+      } else if((c & ~WS_MASKED) == 127) {
+        websocket_close(s, WS_CLOSE_TOO_BIG);
+      }
+      s->ws_len = c & ~WS_MASKED;
+      s->ws_pos = 0;
+      if(s->ws_len == 126) {
+        s->ws_len = 0;
+        s->ws_rstate = WS_READ_LEN16;
+      } else {
+        s->ws_rstate = WS_READ_MASK;
+      }
+      break;
+    case WS_READ_LEN16:
+      s->ws_len = s->ws_len << 8 | c;
+      if(++s->ws_pos == 2) {
+        s->ws_pos = 0;
+        s->ws_rstate = WS_READ_MASK;
+      }
+      break;
+    case WS_READ_MASK:
+      s->ws_mask[s->ws_pos++] = c;
+      if(s->ws_pos == sizeof(s->ws_mask)) {
+        s->ws_pos = 0;
+        s->ws_rstate = WS_READ_PAYLOAD;
+        if(s->ws_len == 0) {
+          websocket_frame(s);
+        }
+      }
+      break;
+    case WS_READ_PAYLOAD:
+      if(s->ws_pos < sizeof(s->inputbuf) - 1) {
+        s->inputbuf[s->ws_pos] = c ^ s->ws_mask[s->ws_pos & 3];
+      }
+      if(++s->ws_pos == s->ws_len) {
+        websocket_frame(s);
+      }
+      break;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Queue a frame for each updated topic, as long as they fit */
+static void
+websocket_fill(struct httpd_ws_state *s)
+{
+  uint32_t bit;
+  uint8_t topic;
+  int len;
+
+  for(topic = 0; topic < 32 && s->pending != 0; topic++) {
+    bit = (uint32_t)1 << topic;
+    if(!(s->pending & bit) || (s->ws_flags & WS_FLAG_CLOSING)) {
+      continue;
+    }
+    len = -1;
+    if(frame_room(s) > 0) {
+      len = s->frame_output(s, topic, frame_payload(s), frame_room(s));
+    }
+    if(len < 0 && s->outbuf_pos > 0) {
+      /* Again once the queued frames are sent */
+      return;
+    }
+    s->pending &= ~bit;
+    if(len > 0) {
+      frame_append(s, WS_OPCODE_TEXT, len);
+    }
+  }
+}
+#endif /* HTTPD_WS_WEBSOCKET */
+/*---------------------------------------------------------------------------*/
 static
 PT_THREAD(send_string(struct httpd_ws_state *s, const char *str, uint16_t len))
 {
@@ -150,6 +491,30 @@ PT_THREAD(handle_output(struct httpd_ws_state *s))
 
   s->content_type = http_content_type_html;
   s->script = httpd_ws_get_script(s);
+#if HTTPD_WS_WEBSOCKET
+  if(s->request_type == HTTPD_WS_UPGRADE && s->frame_output != NULL) {
+    s->conn = uip_conn;
+    s->outbuf_pos = snprintf(s->outbuf, sizeof(s->outbuf), "%s%s\r\n\r\n",
+                             http_header_101, s->ws_accept);
+    s->state = HTTPD_WS_STATE_WEBSOCKET;
+    /* Send what is queued, handshake first, while more frames are
+       queued behind it */
+    while(1) {
+      PT_WAIT_UNTIL(&s->outputpt, s->outbuf_pos > 0 ||
+                    (s->ws_flags & WS_FLAG_CLOSING));
+      if(s->outbuf_pos == 0) {
+        break;
+      }
+      s->ws_sent = s->outbuf_pos;
+      PT_WAIT_THREAD(&s->outputpt, send_string(s, s->outbuf, s->ws_sent));
+      s->outbuf_pos -= s->ws_sent;
+      memmove(s->outbuf, &s->outbuf[s->ws_sent], s->outbuf_pos);
+      s->ws_sent = 0;
+    }
+    PSOCK_CLOSE(&s->sout);
+    PT_EXIT(&s->outputpt);
+  }
+#endif /* HTTPD_WS_WEBSOCKET */
   if(s->script == NULL) {
     PT_WAIT_THREAD(&s->outputpt, send_headers(s, http_header_404));
     PT_WAIT_THREAD(&s->outputpt,
@@ -257,6 +622,12 @@ PT_THREAD(handle_input(struct httpd_ws_state *s))
 
 /*   webserver_log_file(&uip_conn->ripaddr, s->filename); */
   s->state = HTTPD_WS_STATE_OUTPUT;
+#if HTTPD_WS_WEBSOCKET
+  if(s->request_type == HTTPD_WS_GET) {
+    /* The headers tell whether it is to become a websocket */
+    s->state = HTTPD_WS_STATE_INPUT;
+  }
+#endif /* HTTPD_WS_WEBSOCKET */
 
   while(1) {
     PSOCK_READTO(&s->sin, ISO_nl);
@@ -271,12 +642,26 @@ PT_THREAD(handle_input(struct httpd_ws_state *s))
 
     if(PSOCK_DATALEN(&s->sin) > 2) {
       s->inputbuf[PSOCK_DATALEN(&s->sin) - 2] = 0;
+#if HTTPD_WS_WEBSOCKET
+      if(s->request_type == HTTPD_WS_GET) {
+        websocket_header(s);
+      }
+#endif /* HTTPD_WS_WEBSOCKET */
     } else if(s->request_type == HTTPD_WS_POST) {
       PSOCK_READBUF_LEN(&s->sin, s->content_len);
       s->inputbuf[PSOCK_DATALEN(&s->sin)] = 0;
       /* printf("Content: '%s'\nSize:%d\n", s->inputbuf, PSOCK_DATALEN(&s->sin)); */
       s->state = HTTPD_WS_STATE_OUTPUT;
     }
+#if HTTPD_WS_WEBSOCKET
+    else if(s->request_type == HTTPD_WS_GET) {
+      if((s->ws_flags & WS_FLAG_UPGRADE) && s->ws_accept[0] != '\0') {
+        /* The frames that follow are read by websocket_input() */
+        s->request_type = HTTPD_WS_UPGRADE;
+      }
+      s->state = HTTPD_WS_STATE_OUTPUT;
+    }
+#endif /* HTTPD_WS_WEBSOCKET */
   }
   PSOCK_END(&s->sin);
 }
@@ -287,6 +672,18 @@ handle_connection(struct httpd_ws_state *s)
   if(s->state == HTTPD_WS_STATE_REQUEST_OUTPUT) {
     handle_request(s);
   }
+#if HTTPD_WS_WEBSOCKET
+  if(s->request_type == HTTPD_WS_UPGRADE) {
+    if(s->state == HTTPD_WS_STATE_WEBSOCKET) {
+      if(uip_newdata()) {
+        websocket_input(s, (uint8_t *)uip_appdata, uip_datalen());
+      }
+      websocket_fill(s);
+    }
+    handle_output(s);
+    return;
+  }
+#endif /* HTTPD_WS_WEBSOCKET */
   handle_input(s);
   if(s->state == HTTPD_WS_STATE_OUTPUT) {
     handle_output(s);
@@ -320,6 +717,15 @@ httpd_ws_appcall(void *state)
 
       tcp_markconn(uip_conn, s);
       s->state = HTTPD_WS_STATE_INPUT;
+#if HTTPD_WS_WEBSOCKET
+      s->frame_output = NULL;
+      s->frame_input = NULL;
+      s->topics = s->pending = 0;
+      s->ws_sent = 0;
+      s->ws_rstate = WS_READ_OPCODE;
+      s->ws_flags = 0;
+      s->ws_accept[0] = '\0';
+#endif /* HTTPD_WS_WEBSOCKET */
     } else {
       /* this is a request that is to be sent! */
       s->state = HTTPD_WS_STATE_REQUEST_OUTPUT;
@@ -331,7 +737,7 @@ httpd_ws_appcall(void *state)
     handle_connection(s);
   } else if(s != NULL) {
     if(uip_poll()) {
-      if(timer_expired(&s->timer)) {
+      if(timer_expired(&s->timer) && s->state != HTTPD_WS_STATE_WEBSOCKET) {
         uip_abort();
         PRINTF("HTTPD-WS: aborting - http timeout (%d)\n", http_connections);
         http_connections--;
@@ -433,6 +839,24 @@ httpd_ws_request(char request_type, const char *host_ip, const char *host_hdr,
   return s;
 }
 /*---------------------------------------------------------------------------*/
+#if HTTPD_WS_WEBSOCKET
+void
+httpd_ws_push(uint8_t topic)
+{
+  uint32_t bit;
+  int i;
+
+  bit = (uint32_t)1 << topic;
+  for(i = 0; i < CONNS; i++) {
+    if(conns[i].state == HTTPD_WS_STATE_WEBSOCKET &&
+       (conns[i].topics & bit)) {
+      conns[i].pending |= bit;
+      tcpip_poll_tcp(conns[i].conn);
+    }
+  }
+}
+#endif /* HTTPD_WS_WEBSOCKET */
+/*---------------------------------------------------------------------------*/
 PROCESS_THREAD(httpd_ws_process, ev, data)
 {
   static struct etimer et;
@@ -460,6 +884,7 @@ PROCESS_THREAD(httpd_ws_process, ev, data)
       for(i = 0; i < CONNS; i++) {
         PRINTF("%d ", conns[i].state);
         if(conns[i].state != HTTPD_WS_STATE_UNUSED &&
+           conns[i].state != HTTPD_WS_STATE_WEBSOCKET &&
            timer_expired(&conns[i].timer)) {
           conns[i].state = HTTPD_WS_STATE_UNUSED;
           PRINTF("\n*** RELEASED HTTPD Session\n");
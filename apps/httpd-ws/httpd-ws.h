@@ -65,22 +65,44 @@
 #define  HTTPD_OUTBUF_SIZE WEBSERVER_CONF_OUTBUF_SIZE
 #endif /* WEBSERVER_CONF_OUTBUF_SIZE */
 
+/* Accept upgrades of GET requests to websockets (RFC 6455), on which
+   the application pushes updates of topics instead of being polled */
+#ifdef HTTPD_WS_CONF_WEBSOCKET
+#define HTTPD_WS_WEBSOCKET HTTPD_WS_CONF_WEBSOCKET
+#else /* HTTPD_WS_CONF_WEBSOCKET */
+#define HTTPD_WS_WEBSOCKET 0
+#endif /* HTTPD_WS_CONF_WEBSOCKET */
+
+#if HTTPD_WS_WEBSOCKET && HTTPD_OUTBUF_SIZE < 130
+#error HTTPD_OUTBUF_SIZE is too small for the websocket handshake.
+#endif
+
 struct httpd_ws_state;
 typedef char (* httpd_ws_script_t)(struct httpd_ws_state *s);
 typedef int (* httpd_ws_output_headers_t)(struct httpd_ws_state *s,
                                           char *buffer, int buf_size,
                                           int index);
+/* Write the payload of a frame for a topic into buffer, and return its
+   length, or -1 if it does not fit in buf_size */
+typedef int (* httpd_ws_frame_output_t)(struct httpd_ws_state *s,
+                                        uint8_t topic,
+                                        char *buffer, int buf_size);
+/* A text or binary message received on a websocket */
+typedef void (* httpd_ws_frame_input_t)(struct httpd_ws_state *s,
+                                        char *data, uint16_t len);
 
 #define HTTPD_WS_GET      1
 #define HTTPD_WS_POST     2
 #define HTTPD_WS_PUT      3
 #define HTTPD_WS_RESPONSE 4
+#define HTTPD_WS_UPGRADE  5
 
 #define HTTPD_WS_STATE_UNUSED         0
 #define HTTPD_WS_STATE_INPUT          1
 #define HTTPD_WS_STATE_OUTPUT         2
 #define HTTPD_WS_STATE_REQUEST_OUTPUT 3
 #define HTTPD_WS_STATE_REQUEST_INPUT  4
+#define HTTPD_WS_STATE_WEBSOCKET      5
 
 struct httpd_ws_state {
   struct timer timer;
@@ -99,6 +121,28 @@ struct httpd_ws_state {
   httpd_ws_output_headers_t output_extra_headers;
   httpd_ws_script_t script;
 
+#if HTTPD_WS_WEBSOCKET
+  /* Set by httpd_ws_get_script() to accept a websocket */
+  httpd_ws_frame_output_t frame_output;
+  httpd_ws_frame_input_t frame_input;
+  /* The topics subscribed to, and those updated since their last
+     frame, one bit each */
+  uint32_t topics;
+  uint32_t pending;
+
+  struct uip_conn *conn;
+  /* Frames are queued in outbuf, of which the first ws_sent bytes are
+     being sent */
+  uint16_t ws_sent;
+  uint16_t ws_len;
+  uint16_t ws_pos;
+  uint8_t ws_mask[4];
+  uint8_t ws_rstate;
+  uint8_t ws_opcode;
+  uint8_t ws_flags;
+  char ws_accept[29];
+#endif /* HTTPD_WS_WEBSOCKET */
+
 #ifdef HTTPD_WS_CONF_USER_STATE
   HTTPD_WS_CONF_USER_STATE;
 #endif
@@ -120,6 +164,18 @@ struct httpd_ws_state *httpd_ws_request(char request_type,
 
 httpd_ws_script_t httpd_ws_get_script(struct httpd_ws_state *s);
 
+#if HTTPD_WS_WEBSOCKET
+/**
+ * Tell the websockets subscribed to a topic that it was updated.
+ *
+ * Each of them gets a frame from its frame_output callback as soon as
+ * there is room for it. Updates made before then are sent together.
+ *
+ * \param topic The topic, 0 to 31
+ */
+void httpd_ws_push(uint8_t topic);
+#endif /* HTTPD_WS_WEBSOCKET */
+
 PROCESS_NAME(httpd_ws_process);
 
 #endif /* HTTPD_WS_H_ */
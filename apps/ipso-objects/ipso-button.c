@@ -97,9 +97,9 @@ LWM2M_RESOURCES(button_resources,
                 LWM2M_RESOURCE_CALLBACK(5505, { NULL, NULL, reset_counter }),
                 LWM2M_RESOURCE_STRING(5751, "Button")
                 );
-LWM2M_INSTANCES(button_instances,
-                LWM2M_INSTANCE(0, button_resources));
-LWM2M_OBJECT(button, 3200, button_instances);
+LWM2M_STATIC_INSTANCES(button_instances,
+                       LWM2M_INSTANCE_STATIC(0, button_resources));
+LWM2M_STATIC_OBJECT(button, 3200, button_instances);
 /*---------------------------------------------------------------------------*/
 void
 ipso_button_init(void)
@@ -131,9 +131,9 @@ PROCESS_THREAD(ipso_button_process, ev, data)
         input_state = 1;
         counter++;
         if((edge_selection & 2) != 0) {
-          lwm2m_object_notify_observers(&button, "/0/5500");
+          lwm2m_resource_changed(3200, 0, 5500);
         }
-        lwm2m_object_notify_observers(&button, "/0/5501");
+        lwm2m_resource_changed(3200, 0, 5501);
 
         time = (debounce_time * CLOCK_SECOND / 1000);
         if(time < 1) {
@@ -150,7 +150,7 @@ PROCESS_THREAD(ipso_button_process, ev, data)
       } else {
         input_state = 0;
         if((edge_selection & 1) != 0) {
-          lwm2m_object_notify_observers(&button, "/0/5500");
+          lwm2m_resource_changed(3200, 0, 5500);
         }
       }
     }
@@ -42,7 +42,7 @@
  *         Niclas Finne <nfi@sics.se>
  */
 
-#include "lwm2m-object.h"
+#include "ipso-object.h"
 #include "lwm2m-engine.h"
 #include "er-coap-engine.h"
 #include "dev/leds.h"
@@ -69,18 +69,17 @@ struct led_state {
   uint8_t led_value;
 };
 
-static struct led_state states[LEDS_CONTROL_NUMBER];
-static lwm2m_instance_t leds_control_instances[LEDS_CONTROL_NUMBER];
+static const ipso_object_t leds_control;
 /*---------------------------------------------------------------------------*/
 static int
 read_state(lwm2m_context_t *ctx, uint8_t *outbuf, size_t outsize)
 {
-  uint8_t idx = ctx->object_instance_index;
-  if(idx >= LEDS_CONTROL_NUMBER) {
+  struct led_state *state = ipso_object_get_state(&leds_control, ctx);
+  if(state == NULL) {
     return 0;
   }
   return ctx->writer->write_boolean(ctx, outbuf, outsize,
-                                    states[idx].is_on ? 1 : 0);
+                                    state->is_on ? 1 : 0);
 }
 /*---------------------------------------------------------------------------*/
 static int
@@ -90,26 +89,26 @@ write_state(lwm2m_context_t *ctx, const uint8_t *inbuf, size_t insize,
   int value;
   size_t len;
 
-  uint8_t idx = ctx->object_instance_index;
-  if(idx >= LEDS_CONTROL_NUMBER) {
+  struct led_state *state = ipso_object_get_state(&leds_control, ctx);
+  if(state == NULL) {
     return 0;
   }
 
   len = ctx->reader->read_boolean(ctx, inbuf, insize, &value);
   if(len > 0) {
     if(value) {
-      if(!states[idx].is_on) {
-        states[idx].is_on = 1;
-        states[idx].last_on_time = clock_seconds();
+      if(!state->is_on) {
+        state->is_on = 1;
+        state->last_on_time = clock_seconds();
 #if PLATFORM_HAS_LEDS
-        leds_on(states[idx].led_value);
+        leds_on(state->led_value);
 #endif /* PLATFORM_HAS_LEDS */
       }
-    } else if(states[idx].is_on) {
-      states[idx].total_on_time += clock_seconds() - states[idx].last_on_time;
-      states[idx].is_on = 0;
+    } else if(state->is_on) {
+      state->total_on_time += clock_seconds() - state->last_on_time;
+      state->is_on = 0;
 #if PLATFORM_HAS_LEDS
-      leds_off(states[idx].led_value);
+      leds_off(state->led_value);
 #endif /* PLATFORM_HAS_LEDS */
     }
   } else {
@@ -135,11 +134,11 @@ static int
 read_color(lwm2m_context_t *ctx, uint8_t *outbuf, size_t outsize)
 {
   char *value;
-  uint8_t idx = ctx->object_instance_index;
-  if(idx >= LEDS_CONTROL_NUMBER) {
+  struct led_state *state = ipso_object_get_state(&leds_control, ctx);
+  if(state == NULL) {
     return 0;
   }
-  value = get_color(states[idx].led_value);
+  value = get_color(state->led_value);
   return ctx->writer->write_string(ctx, outbuf, outsize,
                                    value, strlen(value));
 }
@@ -148,19 +147,19 @@ static int
 read_on_time(lwm2m_context_t *ctx, uint8_t *outbuf, size_t outsize)
 {
   unsigned long now;
-  uint8_t idx = ctx->object_instance_index;
-  if(idx >= LEDS_CONTROL_NUMBER) {
+  struct led_state *state = ipso_object_get_state(&leds_control, ctx);
+  if(state == NULL) {
     return 0;
   }
 
-  if(states[idx].is_on) {
+  if(state->is_on) {
     /* Update the on time */
     now = clock_seconds();
-    states[idx].total_on_time += now - states[idx].last_on_time;
-    states[idx].last_on_time = now;
+    state->total_on_time += now - state->last_on_time;
+    state->last_on_time = now;
   }
   return ctx->writer->write_int(ctx, outbuf, outsize,
-                                (int32_t)states[idx].total_on_time);
+                                (int32_t)state->total_on_time);
 }
 /*---------------------------------------------------------------------------*/
 static int
@@ -170,17 +169,17 @@ write_on_time(lwm2m_context_t *ctx,
 {
   int32_t value;
   size_t len;
-  uint8_t idx = ctx->object_instance_index;
-  if(idx >= LEDS_CONTROL_NUMBER) {
+  struct led_state *state = ipso_object_get_state(&leds_control, ctx);
+  if(state == NULL) {
     return 0;
   }
 
   len = ctx->reader->read_int(ctx, inbuf, insize, &value);
   if(len > 0 && value == 0) {
     PRINTF("IPSO leds control - reset On Time\n");
-    states[idx].total_on_time = 0;
-    if(states[idx].is_on) {
-      states[idx].last_on_time = clock_seconds();
+    state->total_on_time = 0;
+    if(state->is_on) {
+      state->last_on_time = clock_seconds();
     }
   } else {
     PRINTF("IPSO leds control - ignored illegal write to On Time\n");
@@ -193,7 +192,8 @@ LWM2M_RESOURCES(leds_control_resources,
                 LWM2M_RESOURCE_CALLBACK(5706, { read_color, NULL, NULL }),
                 LWM2M_RESOURCE_CALLBACK(5852, { read_on_time, write_on_time, NULL })
                 );
-LWM2M_OBJECT(leds_control, 3311, leds_control_instances);
+IPSO_OBJECT(leds_control, 3311, leds_control_resources, struct led_state,
+            LEDS_CONTROL_NUMBER);
 /*---------------------------------------------------------------------------*/
 static int
 bit_no(int bit)
@@ -216,19 +216,17 @@ bit_no(int bit)
 void
 ipso_leds_control_init(void)
 {
-  lwm2m_instance_t template = LWM2M_INSTANCE(0, leds_control_resources);
+  struct led_state *state;
   int i;
 
-  /* Initialize the instances */
-  for(i = 0; i < LEDS_CONTROL_NUMBER; i++) {
-    leds_control_instances[i] = template;
-    leds_control_instances[i].id = i;
-    states[i].led_value = bit_no(i);
-  }
-
   /* register this device and its handlers - the handlers automatically
      sends in the object to handle */
-  lwm2m_engine_register_object(&leds_control);
+  ipso_object_init(&leds_control, LEDS_CONTROL_NUMBER);
+
+  for(i = 0; i < LEDS_CONTROL_NUMBER; i++) {
+    state = ipso_object_state(&leds_control, i);
+    state->led_value = bit_no(i);
+  }
   PRINTF("IPSO leds control initialized with %u instances\n",
          LEDS_CONTROL_NUMBER);
 }
@@ -173,9 +173,9 @@ LWM2M_RESOURCES(light_control_resources,
                 LWM2M_RESOURCE_CALLBACK(5851, { read_dim, write_dim, NULL }),
                 LWM2M_RESOURCE_CALLBACK(5852, { read_on_time, write_on_time, NULL }),
                 );
-LWM2M_INSTANCES(light_control_instances,
-		LWM2M_INSTANCE(0, light_control_resources));
-LWM2M_OBJECT(light_control, 3311, light_control_instances);
+LWM2M_STATIC_INSTANCES(light_control_instances,
+		LWM2M_INSTANCE_STATIC(0, light_control_resources));
+LWM2M_STATIC_OBJECT(light_control, 3311, light_control_instances);
 /*---------------------------------------------------------------------------*/
 void
 ipso_light_control_init(void)
@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \addtogroup ipso-objects
+ * @{
+ */
+
+/**
+ * \file
+ *         Implementation of the template for IPSO objects with
+ *         several instances
+ */
+
+#include "contiki.h"
+#include "ipso-object.h"
+#include "lwm2m-engine.h"
+#include <stdio.h>
+#include <string.h>
+
+#define DEBUG 0
+#if DEBUG
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+/*---------------------------------------------------------------------------*/
+static uint8_t *
+state_of(const ipso_object_t *o, int index)
+{
+  return (uint8_t *)o->states + (size_t)o->state_size * index;
+}
+/*---------------------------------------------------------------------------*/
+static uint32_t
+sort_key(const lwm2m_instance_t *instance, int index)
+{
+  /* Free instances go last, in their current order */
+  if(instance->flag & LWM2M_INSTANCE_FLAG_USED) {
+    return instance->id;
+  }
+  return 0x10000UL + index;
+}
+/*---------------------------------------------------------------------------*/
+static void
+swap(const ipso_object_t *o, int a, int b)
+{
+  lwm2m_instance_t tmp;
+  uint8_t *sa, *sb, t;
+  uint16_t i;
+
+  tmp = o->object->instances[a];
+  o->object->instances[a] = o->object->instances[b];
+  o->object->instances[b] = tmp;
+
+  sa = state_of(o, a);
+  sb = state_of(o, b);
+  for(i = 0; i < o->state_size; i++) {
+    t = sa[i];
+    sa[i] = sb[i];
+    sb[i] = t;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Sort the instances by id, with their states, and give the free
+   instances ids after the used ones so that the engine can keep
+   searching the instance table */
+static void
+sort_instances(const ipso_object_t *o)
+{
+  lwm2m_instance_t *instances = o->object->instances;
+  uint16_t next_id = 0;
+  int i, j;
+
+  for(i = 1; i < o->object->count; i++) {
+    for(j = i; j > 0 && sort_key(&instances[j - 1], j - 1) >
+          sort_key(&instances[j], j); j--) {
+      swap(o, j - 1, j);
+    }
+  }
+  for(i = 0; i < o->object->count; i++) {
+    if(instances[i].flag & LWM2M_INSTANCE_FLAG_USED) {
+      next_id = instances[i].id + 1;
+    } else {
+      instances[i].id = next_id++;
+    }
+  }
+
+  /* Registering again updates the instance index of the engine and
+     the registration of the client */
+  lwm2m_engine_register_object(o->object);
+}
+/*---------------------------------------------------------------------------*/
+void
+ipso_object_init(const ipso_object_t *o, uint16_t count)
+{
+  lwm2m_instance_t *instance;
+  int i;
+
+  for(i = 0; i < o->object->count; i++) {
+    instance = &o->object->instances[i];
+    instance->id = i;
+    instance->count = o->resource_count;
+    instance->flag = i < count ? LWM2M_INSTANCE_FLAG_USED : 0;
+    instance->resources = o->resources;
+  }
+  memset(o->states, 0, (size_t)o->state_size * o->object->count);
+
+  lwm2m_engine_register_object(o->object);
+  PRINTF("ipso-object: %u initialized with %u of %u instances\n",
+         o->object->id, count, o->object->count);
+}
+/*---------------------------------------------------------------------------*/
+int
+ipso_object_get_index(const ipso_object_t *o, uint16_t id)
+{
+  int i;
+  for(i = 0; i < o->object->count; i++) {
+    if(o->object->instances[i].id == id &&
+       (o->object->instances[i].flag & LWM2M_INSTANCE_FLAG_USED)) {
+      return i;
+    }
+  }
+  return -1;
+}
+/*---------------------------------------------------------------------------*/
+int
+ipso_object_add_instance(const ipso_object_t *o, uint16_t id)
+{
+  lwm2m_instance_t *instances = o->object->instances;
+  int i;
+
+  if(ipso_object_get_index(o, id) >= 0) {
+    PRINTF("ipso-object: %u/%u already exists\n", o->object->id, id);
+    return -1;
+  }
+  for(i = 0; i < o->object->count; i++) {
+    if((instances[i].flag & LWM2M_INSTANCE_FLAG_USED) == 0) {
+      instances[i].flag |= LWM2M_INSTANCE_FLAG_USED;
+      instances[i].id = id;
+      memset(state_of(o, i), 0, o->state_size);
+      sort_instances(o);
+      return ipso_object_get_index(o, id);
+    }
+  }
+  PRINTF("ipso-object: no free instance in %u\n", o->object->id);
+  return -1;
+}
+/*---------------------------------------------------------------------------*/
+void
+ipso_object_remove_instance(const ipso_object_t *o, int index)
+{
+  if(index >= 0 && index < o->object->count) {
+    o->object->instances[index].flag &= ~LWM2M_INSTANCE_FLAG_USED;
+    memset(state_of(o, index), 0, o->state_size);
+    sort_instances(o);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void *
+ipso_object_state(const ipso_object_t *o, int index)
+{
+  if(index < 0 || index >= o->object->count ||
+     (o->object->instances[index].flag & LWM2M_INSTANCE_FLAG_USED) == 0) {
+    return NULL;
+  }
+  return state_of(o, index);
+}
+/*---------------------------------------------------------------------------*/
+void
+ipso_object_notify(const ipso_object_t *o, int index, uint16_t resource_id)
+{
+  if(ipso_object_state(o, index) == NULL) {
+    return;
+  }
+  lwm2m_resource_changed(o->object->id, o->object->instances[index].id,
+                         resource_id);
+}
+/*---------------------------------------------------------------------------*/
+/** @} */
@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \addtogroup ipso-objects
+ * @{
+ */
+
+/**
+ * \file
+ *         A template for IPSO objects with several instances.
+ *
+ *         The object is declared with IPSO_OBJECT() from its resource
+ *         table, a per-instance state type and the number of instances.
+ *         All instances share the resource table and the callbacks,
+ *         which get the state of the instance being accessed with
+ *         ipso_object_get_state(). The instance table is kept sorted
+ *         by instance id so the engine finds instances with a binary
+ *         search, whatever their number.
+ */
+
+#ifndef IPSO_OBJECT_H_
+#define IPSO_OBJECT_H_
+
+#include "lwm2m-object.h"
+
+typedef struct ipso_object {
+  const lwm2m_object_t *object;
+  const lwm2m_resource_t *resources;
+  uint16_t resource_count;
+  /* The state of each instance, state_size bytes apart */
+  uint16_t state_size;
+  void *states;
+} ipso_object_t;
+
+/**
+ * Declare an IPSO object with room for num instances, each with its
+ * own state_type. The resource table must be declared before with
+ * LWM2M_RESOURCES().
+ *
+ * Example:
+ \code
+LWM2M_RESOURCES(switch_resources,
+                LWM2M_RESOURCE_CALLBACK(5500, { read_state, NULL, NULL }));
+IPSO_OBJECT(switches, 3200, switch_resources, struct switch_state, 16);
+ \endcode
+ */
+#define IPSO_OBJECT(name, id, resources, state_type, num)               \
+  static lwm2m_instance_t name##_instances[num];                        \
+  static state_type name##_states[num];                                 \
+  LWM2M_OBJECT(name##_object, id, name##_instances);                    \
+  static const ipso_object_t name = {                                   \
+    &name##_object, resources,                                          \
+    sizeof(resources) / sizeof(lwm2m_resource_t),                       \
+    sizeof(state_type), name##_states }
+
+/**
+ * Initialize the instances of an object and register it with the
+ * engine. The first instances get the ids 0 to count - 1, the other
+ * instances are left free for ipso_object_add_instance() or for the
+ * LWM2M server to create.
+ *
+ * \param o     The object, declared with IPSO_OBJECT()
+ * \param count The number of instances to start with
+ */
+void ipso_object_init(const ipso_object_t *o, uint16_t count);
+
+/**
+ * Add an instance to an object.
+ *
+ * \param o  The object
+ * \param id The id of the new instance
+ * \return   The index of the instance, or -1 if the id is already
+ *           used or all instances are used
+ */
+int ipso_object_add_instance(const ipso_object_t *o, uint16_t id);
+
+/**
+ * Remove an instance from an object. Its state is cleared.
+ *
+ * \param o     The object
+ * \param index The index of the instance
+ */
+void ipso_object_remove_instance(const ipso_object_t *o, int index);
+
+/**
+ * Get the index of an instance.
+ *
+ * \return The index of the used instance with the id, or -1
+ */
+int ipso_object_get_index(const ipso_object_t *o, uint16_t id);
+
+/**
+ * Get the state of an instance.
+ *
+ * \param o     The object
+ * \param index The index of the instance
+ * \return      The state, or NULL if the index is not a used instance
+ */
+void *ipso_object_state(const ipso_object_t *o, int index);
+
+/**
+ * Get the state of the instance accessed in a resource callback.
+ */
+static inline void *
+ipso_object_get_state(const ipso_object_t *o, const lwm2m_context_t *ctx)
+{
+  return ipso_object_state(o, ctx->object_instance_index);
+}
+
+/**
+ * Notify the observers of a resource of an instance.
+ *
+ * \param o           The object
+ * \param index       The index of the instance
+ * \param resource_id The id of the resource
+ */
+void ipso_object_notify(const ipso_object_t *o, int index,
+                        uint16_t resource_id);
+
+#endif /* IPSO_OBJECT_H_ */
+/**
+ * @}
+ */
@@ -0,0 +1,266 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \addtogroup ipso-objects
+ * @{
+ */
+
+/**
+ * \file
+ *         Implementation of the IPSO sensor sampler
+ */
+
+#include "contiki.h"
+#include "ipso-sensor-sampler.h"
+#include "lwm2m-engine.h"
+#include "lwm2m-notification.h"
+#include <stdio.h>
+
+#define DEBUG 0
+#if DEBUG
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+#define FLAG_HAS_VALUE  0x01
+#define FLAG_HAS_WINDOW 0x02
+#define FLAG_ABOVE_GT   0x04
+#define FLAG_BELOW_LT   0x08
+
+/*---------------------------------------------------------------------------*/
+static void
+notify(ipso_sensor_sampler_t *s, uint16_t resource_id)
+{
+  PRINTF("ipso-sensor-sampler: notify /%s/%u/%u\n", s->object->path,
+         s->instance_id, resource_id);
+  lwm2m_resource_changed(s->object->id, s->instance_id, resource_id);
+}
+/*---------------------------------------------------------------------------*/
+/* Check if the latest sample should be notified, given the attributes
+   of the Sensor Value resource */
+static int
+is_significant(ipso_sensor_sampler_t *s, const lwm2m_attributes_t *a)
+{
+  int32_t diff;
+  int significant = 0;
+
+  if(a->flags & LWM2M_ATTRIBUTE_GT) {
+    if(s->flags & FLAG_ABOVE_GT) {
+      if(s->value < a->gt - s->hysteresis) {
+        s->flags &= ~FLAG_ABOVE_GT;
+        significant = 1;
+      }
+    } else if(s->value > a->gt) {
+      s->flags |= FLAG_ABOVE_GT;
+      significant = 1;
+    }
+  }
+  if(a->flags & LWM2M_ATTRIBUTE_LT) {
+    if(s->flags & FLAG_BELOW_LT) {
+      if(s->value > a->lt + s->hysteresis) {
+        s->flags &= ~FLAG_BELOW_LT;
+        significant = 1;
+      }
+    } else if(s->value < a->lt) {
+      s->flags |= FLAG_BELOW_LT;
+      significant = 1;
+    }
+  }
+
+  diff = s->value - s->notified_value;
+  if(diff < 0) {
+    diff = -diff;
+  }
+  if(a->flags & LWM2M_ATTRIBUTE_ST) {
+    if(diff != 0 && diff >= a->st) {
+      significant = 1;
+    }
+  } else if((a->flags & (LWM2M_ATTRIBUTE_GT | LWM2M_ATTRIBUTE_LT)) == 0) {
+    /* No attributes, the threshold of the sampler decides */
+    if(diff != 0 && diff >= s->threshold) {
+      significant = 1;
+    }
+  }
+  return significant;
+}
+/*---------------------------------------------------------------------------*/
+static void
+update_window(ipso_sensor_sampler_t *s)
+{
+  if(s->window == 0) {
+    return;
+  }
+  if(s->samples == 0 || s->value < s->window_lo) {
+    s->window_lo = s->value;
+  }
+  if(s->samples == 0 || s->value > s->window_hi) {
+    s->window_hi = s->value;
+  }
+  s->window_sum += s->value;
+  if(++s->samples >= s->window) {
+    s->window_min = s->window_lo;
+    s->window_max = s->window_hi;
+    s->window_avg = (int32_t)(s->window_sum / s->samples);
+    s->window_sum = 0;
+    s->samples = 0;
+    s->flags |= FLAG_HAS_WINDOW;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+new_sample(ipso_sensor_sampler_t *s)
+{
+  lwm2m_attributes_t a;
+  int32_t step;
+  int first;
+
+  /* Convert the average from 1/1000 units to fixpoint, in one go for
+     all readings */
+  s->value = (int32_t)((s->readings_sum * LWM2M_FLOAT32_FRAC) /
+                       (1000 * (int32_t)s->readings));
+  s->readings_sum = 0;
+  s->readings = 0;
+
+  first = (s->flags & FLAG_HAS_VALUE) == 0;
+  s->flags |= FLAG_HAS_VALUE;
+  update_window(s);
+
+  lwm2m_notification_get_attributes(s->object->id, s->instance_id,
+                                    IPSO_SENSOR_SAMPLER_VALUE_RESOURCE, 3,
+                                    &a);
+  if(first) {
+    /* Start on the right side of the limits without notifying */
+    if((a.flags & LWM2M_ATTRIBUTE_GT) && s->value > a.gt) {
+      s->flags |= FLAG_ABOVE_GT;
+    }
+    if((a.flags & LWM2M_ATTRIBUTE_LT) && s->value < a.lt) {
+      s->flags |= FLAG_BELOW_LT;
+    }
+    s->notified_value = s->value;
+    notify(s, IPSO_SENSOR_SAMPLER_VALUE_RESOURCE);
+  } else if(is_significant(s, &a)) {
+    s->notified_value = s->value;
+    notify(s, IPSO_SENSOR_SAMPLER_VALUE_RESOURCE);
+  }
+
+  /* The measured min and max move by at least the same step */
+  step = (a.flags & LWM2M_ATTRIBUTE_ST) ? a.st : s->threshold;
+  if(step <= 0) {
+    step = 1;
+  }
+  if(s->value < s->min) {
+    s->min = s->value;
+    if(first || s->notified_min - s->min >= step) {
+      s->notified_min = s->min;
+      notify(s, IPSO_SENSOR_SAMPLER_MIN_RESOURCE);
+    }
+  }
+  if(s->value > s->max) {
+    s->max = s->value;
+    if(first || s->max - s->notified_max >= step) {
+      s->notified_max = s->max;
+      notify(s, IPSO_SENSOR_SAMPLER_MAX_RESOURCE);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+read_sensor(ipso_sensor_sampler_t *s)
+{
+  int32_t raw;
+
+  if(s->sensor == NULL || s->sensor->read_value == NULL ||
+     s->sensor->read_value(&raw) != 0) {
+    return 0;
+  }
+  s->readings_sum += raw;
+  s->readings++;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_timer(void *ptr)
+{
+  ipso_sensor_sampler_t *s = ptr;
+
+  ctimer_reset(&s->timer);
+  if(read_sensor(s) && s->readings >= s->oversampling) {
+    new_sample(s);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+ipso_sensor_sampler_start(ipso_sensor_sampler_t *s)
+{
+  s->readings_sum = 0;
+  s->readings = 0;
+  s->window_sum = 0;
+  s->samples = 0;
+  s->flags = 0;
+  s->notified_min = s->min;
+  s->notified_max = s->max;
+  if(s->oversampling == 0) {
+    s->oversampling = 1;
+  }
+
+  if(read_sensor(s)) {
+    new_sample(s);
+  }
+  ctimer_set(&s->timer, s->interval, handle_timer, s);
+}
+/*---------------------------------------------------------------------------*/
+void
+ipso_sensor_sampler_stop(ipso_sensor_sampler_t *s)
+{
+  ctimer_stop(&s->timer);
+}
+/*---------------------------------------------------------------------------*/
+int
+ipso_sensor_sampler_get_value(const ipso_sensor_sampler_t *s, int32_t *value)
+{
+  if(s->flags & FLAG_HAS_VALUE) {
+    *value = s->value;
+    return 1;
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+ipso_sensor_sampler_has_window(const ipso_sensor_sampler_t *s)
+{
+  return (s->flags & FLAG_HAS_WINDOW) != 0;
+}
+/*---------------------------------------------------------------------------*/
+/** @} */
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \addtogroup ipso-objects
+ * @{
+ */
+
+/**
+ * \file
+ *         Sampling of IPSO sensors with oversampling, min/max/average
+ *         windows and change thresholds.
+ *
+ *         A sampler reads a sensor every interval and averages
+ *         oversampling readings into one sample. The observers of the
+ *         Sensor Value resource (5700) of its object instance are only
+ *         notified when a sample crosses the gt or lt attribute, by the
+ *         margin of the hysteresis when going back, or when it has
+ *         moved by st since the last notified sample. Without any of
+ *         these attributes, the threshold of the sampler is used. The
+ *         Min and Max Measured Value resources (5601, 5602) are
+ *         notified the same way.
+ */
+
+#ifndef IPSO_SENSOR_SAMPLER_H_
+#define IPSO_SENSOR_SAMPLER_H_
+
+#include "ipso-objects.h"
+#include "lwm2m-object.h"
+#include "sys/ctimer.h"
+
+#define IPSO_SENSOR_SAMPLER_VALUE_RESOURCE 5700
+#define IPSO_SENSOR_SAMPLER_MIN_RESOURCE   5601
+#define IPSO_SENSOR_SAMPLER_MAX_RESOURCE   5602
+
+typedef struct ipso_sensor_sampler {
+  /* Set before ipso_sensor_sampler_start() */
+  const struct ipso_objects_sensor *sensor;
+  const lwm2m_object_t *object;
+  uint16_t instance_id;
+  /* Time between two readings of the sensor */
+  clock_time_t interval;
+  /* Readings averaged into one sample, and samples in a window */
+  uint8_t oversampling;
+  uint8_t window;
+  /* Change that is notified when no attribute is set, and the margin
+     to get back over gt and lt. Both in LWM2M_FLOAT32_BITS fixpoint */
+  int32_t threshold;
+  int32_t hysteresis;
+
+  /* The last sample, the lowest and highest sample since start and the
+     statistics of the last complete window, in LWM2M_FLOAT32_BITS
+     fixpoint. min and max are set by the caller before start, for
+     example to the range of the sensor */
+  int32_t value;
+  int32_t min;
+  int32_t max;
+  int32_t window_min;
+  int32_t window_max;
+  int32_t window_avg;
+
+  struct ctimer timer;
+  int64_t readings_sum;
+  int64_t window_sum;
+  int32_t window_lo;
+  int32_t window_hi;
+  int32_t notified_value;
+  int32_t notified_min;
+  int32_t notified_max;
+  uint8_t readings;
+  uint8_t samples;
+  uint8_t flags;
+} ipso_sensor_sampler_t;
+
+/**
+ * \brief Start sampling
+ * \param s The sampler, with the sensor, object and sampling set
+ *
+ * The first sample is taken right away from a single reading.
+ */
+void ipso_sensor_sampler_start(ipso_sensor_sampler_t *s);
+
+/**
+ * \brief Stop sampling
+ */
+void ipso_sensor_sampler_stop(ipso_sensor_sampler_t *s);
+
+/**
+ * \brief Get the last sample
+ * \param s     The sampler
+ * \param value Set to the sample in LWM2M_FLOAT32_BITS fixpoint
+ * \return 1 if there is a sample, 0 otherwise
+ */
+int ipso_sensor_sampler_get_value(const ipso_sensor_sampler_t *s,
+                                  int32_t *value);
+
+/**
+ * \brief Check if a min/max/average window has been completed
+ */
+int ipso_sensor_sampler_has_window(const ipso_sensor_sampler_t *s);
+
+#endif /* IPSO_SENSOR_SAMPLER_H_ */
+/** @} */
@@ -43,6 +43,7 @@
 
 #include <stdint.h>
 #include "ipso-objects.h"
+#include "ipso-sensor-sampler.h"
 #include "lwm2m-object.h"
 #include "lwm2m-engine.h"
 #include "er-coap-engine.h"
@@ -59,16 +60,40 @@ extern const struct ipso_objects_sensor IPSO_TEMPERATURE;
 #define IPSO_TEMPERATURE_MAX (80 * LWM2M_FLOAT32_FRAC)
 #endif
 
-static struct ctimer periodic_timer;
-static int32_t min_temp;
-static int32_t max_temp;
-static int read_temp(int32_t *value);
+/* Time between two readings of the sensor */
+#ifdef IPSO_TEMPERATURE_CONF_INTERVAL
+#define IPSO_TEMPERATURE_INTERVAL IPSO_TEMPERATURE_CONF_INTERVAL
+#else
+#define IPSO_TEMPERATURE_INTERVAL (CLOCK_SECOND * 10)
+#endif
+
+/* Readings averaged into one temperature sample */
+#ifdef IPSO_TEMPERATURE_CONF_OVERSAMPLING
+#define IPSO_TEMPERATURE_OVERSAMPLING IPSO_TEMPERATURE_CONF_OVERSAMPLING
+#else
+#define IPSO_TEMPERATURE_OVERSAMPLING 1
+#endif
+
+/* Change notified when the server has set no gt, lt or st attribute */
+#ifdef IPSO_TEMPERATURE_CONF_THRESHOLD
+#define IPSO_TEMPERATURE_THRESHOLD IPSO_TEMPERATURE_CONF_THRESHOLD
+#else
+#define IPSO_TEMPERATURE_THRESHOLD (LWM2M_FLOAT32_FRAC / 10)
+#endif
+
+#ifdef IPSO_TEMPERATURE_CONF_HYSTERESIS
+#define IPSO_TEMPERATURE_HYSTERESIS IPSO_TEMPERATURE_CONF_HYSTERESIS
+#else
+#define IPSO_TEMPERATURE_HYSTERESIS (LWM2M_FLOAT32_FRAC / 2)
+#endif
+
+static ipso_sensor_sampler_t sampler;
 /*---------------------------------------------------------------------------*/
 static int
 temp(lwm2m_context_t *ctx, uint8_t *outbuf, size_t outsize)
 {
   int32_t value;
-  if(read_temp(&value)) {
+  if(ipso_sensor_sampler_get_value(&sampler, &value)) {
     return ctx->writer->write_float32fix(ctx, outbuf, outsize,
                                          value, LWM2M_FLOAT32_BITS);
   }
@@ -76,84 +101,47 @@ temp(lwm2m_context_t *ctx, uint8_t *outbuf, size_t outsize)
 }
 /*---------------------------------------------------------------------------*/
 LWM2M_RESOURCES(temperature_resources,
-                /* Temperature (Current) */
-                LWM2M_RESOURCE_CALLBACK(5700, { temp, NULL, NULL }),
-                /* Units */
-                LWM2M_RESOURCE_STRING(5701, "Cel"),
+                /* Min Measured Value */
+                LWM2M_RESOURCE_FLOATFIX_VAR(5601, &sampler.min),
+                /* Max Measured Value */
+                LWM2M_RESOURCE_FLOATFIX_VAR(5602, &sampler.max),
                 /* Min Range Value */
                 LWM2M_RESOURCE_FLOATFIX(5603, IPSO_TEMPERATURE_MIN),
                 /* Max Range Value */
                 LWM2M_RESOURCE_FLOATFIX(5604, IPSO_TEMPERATURE_MAX),
-                /* Min Measured Value */
-                LWM2M_RESOURCE_FLOATFIX_VAR(5601, &min_temp),
-                /* Max Measured Value */
-                LWM2M_RESOURCE_FLOATFIX_VAR(5602, &max_temp),
+                /* Temperature (Current) */
+                LWM2M_RESOURCE_CALLBACK(5700, { temp, NULL, NULL }),
+                /* Units */
+                LWM2M_RESOURCE_STRING(5701, "Cel"),
                 );
-LWM2M_INSTANCES(temperature_instances,
-                LWM2M_INSTANCE(0, temperature_resources));
-LWM2M_OBJECT(temperature, 3303, temperature_instances);
-/*---------------------------------------------------------------------------*/
-static int
-read_temp(int32_t *value)
-{
-#ifdef IPSO_TEMPERATURE
-  int32_t temp;
-  if(IPSO_TEMPERATURE.read_value == NULL ||
-     IPSO_TEMPERATURE.read_value(&temp) != 0) {
-    return 0;
-  }
-
-  /* Convert milliCelsius to fix float */
-  *value = (temp * LWM2M_FLOAT32_FRAC) / 1000;
-
-  if(*value < min_temp) {
-    min_temp = *value;
-    lwm2m_object_notify_observers(&temperature, "/0/5601");
-  }
-  if(*value > max_temp) {
-    max_temp = *value;
-    lwm2m_object_notify_observers(&temperature, "/0/5602");
-  }
-  return 1;
-#else /* IPSO_TEMPERATURE */
-  return 0;
-#endif /* IPSO_TEMPERATURE */
-}
-/*---------------------------------------------------------------------------*/
-static void
-handle_periodic_timer(void *ptr)
-{
-  static int32_t last_value = IPSO_TEMPERATURE_MIN;
-  int32_t v;
-
-  /* Only notify when the value has changed since last */
-  if(read_temp(&v) && v != last_value) {
-    last_value = v;
-    lwm2m_object_notify_observers(&temperature, "/0/5700");
-  }
-  ctimer_reset(&periodic_timer);
-}
+LWM2M_STATIC_INSTANCES(temperature_instances,
+                       LWM2M_INSTANCE_STATIC(0, temperature_resources));
+LWM2M_STATIC_OBJECT(temperature, 3303, temperature_instances);
 /*---------------------------------------------------------------------------*/
 void
 ipso_temperature_init(void)
 {
-  int32_t v;
-  min_temp = IPSO_TEMPERATURE_MAX;
-  max_temp = IPSO_TEMPERATURE_MIN;
-
 #ifdef IPSO_TEMPERATURE
   if(IPSO_TEMPERATURE.init) {
     IPSO_TEMPERATURE.init();
   }
+  sampler.sensor = &IPSO_TEMPERATURE;
 #endif /* IPSO_TEMPERATURE */
 
   /* register this device and its handlers - the handlers automatically
      sends in the object to handle */
   lwm2m_engine_register_object(&temperature);
 
-  /* update temp and min/max + notify any listeners */
-  read_temp(&v);
-  ctimer_set(&periodic_timer, CLOCK_SECOND * 10, handle_periodic_timer, NULL);
+  /* take the first sample and notify only the changes that matter */
+  sampler.object = &temperature;
+  sampler.instance_id = 0;
+  sampler.interval = IPSO_TEMPERATURE_INTERVAL;
+  sampler.oversampling = IPSO_TEMPERATURE_OVERSAMPLING;
+  sampler.threshold = IPSO_TEMPERATURE_THRESHOLD;
+  sampler.hysteresis = IPSO_TEMPERATURE_HYSTERESIS;
+  sampler.min = IPSO_TEMPERATURE_MAX;
+  sampler.max = IPSO_TEMPERATURE_MIN;
+  ipso_sensor_sampler_start(&sampler);
 }
 /*---------------------------------------------------------------------------*/
 /** @} */
@@ -347,3 +347,203 @@ jsonparse_has_next(struct jsonparse_state *state)
   return state->pos < state->len;
 }
 /*--------------------------------------------------------------------*/
+/*--------------------------------------------------------------------*/
+static int
+find_skip_ws(const struct jsonparse_state *state, int pos)
+{
+  char c;
+
+  while(pos < state->len && ((c = state->json[pos]) == ' ' || c == '\n'
+                             || c == '\r' || c == '\t')) {
+    pos++;
+  }
+  return pos;
+}
+/*--------------------------------------------------------------------*/
+/* returns the position after the string starting at pos, or -1 */
+static int
+find_skip_string(const struct jsonparse_state *state, int pos)
+{
+  char c;
+
+  for(pos++; pos < state->len && (c = state->json[pos]) != '\0'; pos++) {
+    if(c == '\\') {
+      pos++;
+    } else if(c == '"') {
+      return pos + 1;
+    }
+  }
+  return -1;
+}
+/*--------------------------------------------------------------------*/
+/* returns the position after the value starting at pos, or -1 */
+static int
+find_skip_value(const struct jsonparse_state *state, int pos)
+{
+  int depth = 0;
+  char c;
+
+  while(pos < state->len && (c = state->json[pos]) != '\0') {
+    if(c == '"') {
+      pos = find_skip_string(state, pos);
+      if(pos < 0 || depth == 0) {
+        return pos;
+      }
+    } else if(c == '{' || c == '[') {
+      depth++;
+      pos++;
+    } else if(c == '}' || c == ']' || c == ',') {
+      if(depth == 0) {
+        /* the end of an atom */
+        return pos;
+      }
+      if(c != ',' && --depth == 0) {
+        return pos + 1;
+      }
+      pos++;
+    } else if(depth == 0 && (c == ' ' || c == '\n' || c == '\r'
+                             || c == '\t')) {
+      return pos;
+    } else {
+      pos++;
+    }
+  }
+  return depth == 0 ? pos : -1;
+}
+/*--------------------------------------------------------------------*/
+/* moves pos to the member named name of the object starting at pos */
+static int
+find_member(const struct jsonparse_state *state, int pos,
+            const char *name, int name_len)
+{
+  int key;
+  int key_len;
+
+  if(pos >= state->len || state->json[pos] != '{') {
+    return -1;
+  }
+  pos = find_skip_ws(state, pos + 1);
+  if(pos < state->len && state->json[pos] == '}') {
+    return -1;
+  }
+  while(pos < state->len && state->json[pos] == '"') {
+    key = pos + 1;
+    pos = find_skip_string(state, pos);
+    if(pos < 0) {
+      return -1;
+    }
+    key_len = pos - key - 1;
+    pos = find_skip_ws(state, pos);
+    if(pos >= state->len || state->json[pos] != ':') {
+      return -1;
+    }
+    pos = find_skip_ws(state, pos + 1);
+    if(key_len == name_len && strncmp(&state->json[key], name, name_len) == 0) {
+      return pos;
+    }
+    pos = find_skip_value(state, pos);
+    if(pos < 0) {
+      return -1;
+    }
+    pos = find_skip_ws(state, pos);
+    if(pos >= state->len || state->json[pos] != ',') {
+      return -1;
+    }
+    pos = find_skip_ws(state, pos + 1);
+  }
+  return -1;
+}
+/*--------------------------------------------------------------------*/
+/* moves pos to the element at index of the array starting at pos */
+static int
+find_element(const struct jsonparse_state *state, int pos, int index)
+{
+  if(pos >= state->len || state->json[pos] != '[') {
+    return -1;
+  }
+  pos = find_skip_ws(state, pos + 1);
+  if(pos < state->len && state->json[pos] == ']') {
+    return -1;
+  }
+  while(index-- > 0) {
+    pos = find_skip_value(state, pos);
+    if(pos < 0) {
+      return -1;
+    }
+    pos = find_skip_ws(state, pos);
+    if(pos >= state->len || state->json[pos] != ',') {
+      return -1;
+    }
+    pos = find_skip_ws(state, pos + 1);
+  }
+  return pos;
+}
+/*--------------------------------------------------------------------*/
+int
+jsonparse_find(struct jsonparse_state *state, const char *path)
+{
+  int pos;
+  int len;
+  int end;
+  char c;
+
+  pos = find_skip_ws(state, state->pos);
+  while(*path != '\0' && pos >= 0) {
+    if(*path == '[') {
+      path++;
+      if(*path < '0' || *path > '9') {
+        state->error = JSON_ERROR_SYNTAX;
+        return JSON_TYPE_ERROR;
+      }
+      pos = find_element(state, pos, strtol(path, (char **)&path, 10));
+      if(*path++ != ']') {
+        state->error = JSON_ERROR_SYNTAX;
+        return JSON_TYPE_ERROR;
+      }
+    } else {
+      if(*path == '.') {
+        path++;
+      }
+      len = strcspn(path, ".[");
+      pos = find_member(state, pos, path, len);
+      path += len;
+    }
+  }
+  if(pos < 0 || pos >= state->len) {
+    state->error = JSON_ERROR_NOT_FOUND;
+    return JSON_TYPE_ERROR;
+  }
+
+  c = state->json[pos];
+  state->depth = 0;
+  state->error = JSON_ERROR_OK;
+  if(c == '{' || c == '[') {
+    end = find_skip_value(state, pos);
+    if(end < 0) {
+      state->error = JSON_ERROR_SYNTAX;
+      return JSON_TYPE_ERROR;
+    }
+    /* ready to parse the value as a document */
+    state->pos = pos;
+    state->vstart = pos;
+    state->vlen = end - pos;
+    state->vtype = 0;
+    return c;
+  }
+
+  state->pos = pos + 1;
+  if(c == '"') {
+    return atomic(state, JSON_TYPE_STRING);
+  } else if(c == '-' || (c >= '0' && c <= '9')) {
+    return atomic(state, JSON_TYPE_NUMBER);
+  } else if(c == 'n') {
+    return atomic(state, JSON_TYPE_NULL);
+  } else if(c == 't') {
+    return atomic(state, JSON_TYPE_TRUE);
+  } else if(c == 'f') {
+    return atomic(state, JSON_TYPE_FALSE);
+  }
+  state->error = JSON_ERROR_SYNTAX;
+  return JSON_TYPE_ERROR;
+}
+/*--------------------------------------------------------------------*/
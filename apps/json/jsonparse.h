@@ -88,4 +88,24 @@ int jsonparse_get_type(struct jsonparse_state *state);
 /* compare the JSON value with the specified string */
 int jsonparse_strcmp_value(struct jsonparse_state *state, const char *str);
 
+/**
+ * \brief      Find a value by its path.
+ * \param state A pointer to a JSON parser state
+ * \param path The path, such as "a.b[2].c", from the value at the current
+ *             position
+ * \return     The type of the value, or JSON_TYPE_ERROR with state->error
+ *             set to JSON_ERROR_NOT_FOUND or JSON_ERROR_SYNTAX
+ *
+ *             The values not on the path are skipped by counting brackets,
+ *             without being decoded or checked, and with no limit on their
+ *             nesting. Keys are compared as they are written in the
+ *             document, escapes included.
+ *
+ *             An atomic value can then be read with the jsonparse_copy_value()
+ *             and jsonparse_get_value_as_*() functions. For an object or an
+ *             array, jsonparse_get_len() gives the length of its text, and
+ *             jsonparse_next() parses it as if it were the whole document.
+ */
+int jsonparse_find(struct jsonparse_state *state, const char *path);
+
 #endif /* JSONPARSE_H_ */
@@ -50,32 +50,82 @@
 #define PRINTF(...)
 #endif
 
+/* The context being rendered by jsontree_print_buffer() */
+static const struct jsontree_context *buffer_ctx;
+
+static void output(const struct jsontree_context *js_ctx,
+                   const char *text, int len);
+/*---------------------------------------------------------------------------*/
+static int
+buffer_putchar(int c)
+{
+  char ch = c;
+
+  output(buffer_ctx, &ch, 1);
+  return c;
+}
+/*---------------------------------------------------------------------------*/
+static void
+output(const struct jsontree_context *js_ctx, const char *text, int len)
+{
+  struct jsontree_buffer *b;
+  uint32_t lo, hi;
+
+  if(js_ctx->putchar != buffer_putchar) {
+    while(len-- > 0) {
+      js_ctx->putchar(*text++);
+    }
+    return;
+  }
+
+  /* Copy the part of the text that falls within the buffer */
+  b = js_ctx->buffer;
+  lo = b->pos > b->start ? b->pos : b->start;
+  hi = b->pos + len < b->start + b->size ? b->pos + len : b->start + b->size;
+  if(lo < hi) {
+    memcpy(&b->data[lo - b->start], &text[lo - b->pos], hi - lo);
+  }
+  b->pos += len;
+}
+/*---------------------------------------------------------------------------*/
+static void
+put(const struct jsontree_context *js_ctx, char c)
+{
+  if(js_ctx->putchar != buffer_putchar) {
+    js_ctx->putchar(c);
+  } else {
+    output(js_ctx, &c, 1);
+  }
+}
 /*---------------------------------------------------------------------------*/
 void
 jsontree_write_atom(const struct jsontree_context *js_ctx, const char *text)
 {
   if(text == NULL) {
-    js_ctx->putchar('0');
+    put(js_ctx, '0');
   } else {
-    while(*text != '\0') {
-      js_ctx->putchar(*text++);
-    }
+    output(js_ctx, text, strlen(text));
   }
 }
 /*---------------------------------------------------------------------------*/
 void
 jsontree_write_string(const struct jsontree_context *js_ctx, const char *text)
 {
-  js_ctx->putchar('"');
+  size_t len;
+
+  put(js_ctx, '"');
   if(text != NULL) {
     while(*text != '\0') {
+      len = strcspn(text, "\"");
+      output(js_ctx, text, len);
+      text += len;
       if(*text == '"') {
-        js_ctx->putchar('\\');
+        output(js_ctx, "\\\"", 2);
+        text++;
       }
-      js_ctx->putchar(*text++);
     }
   }
-  js_ctx->putchar('"');
+  put(js_ctx, '"');
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -90,16 +140,14 @@ jsontree_write_uint(const struct jsontree_context *js_ctx, unsigned int value)
     value /= 10;
   } while(value > 0 && l >= 0);
 
-  while(++l < sizeof(buf)) {
-    js_ctx->putchar(buf[l]);
-  }
+  output(js_ctx, &buf[l + 1], sizeof(buf) - 1 - l);
 }
 /*---------------------------------------------------------------------------*/
 void
 jsontree_write_int(const struct jsontree_context *js_ctx, int value)
 {
   if(value < 0) {
-    js_ctx->putchar('-');
+    put(js_ctx, '-');
     value = -value;
   }
 
@@ -117,6 +165,84 @@ jsontree_setup(struct jsontree_context *js_ctx, struct jsontree_value *root,
 }
 /*---------------------------------------------------------------------------*/
 void
+jsontree_setup_buffer(struct jsontree_context *js_ctx,
+                      struct jsontree_value *root,
+                      struct jsontree_buffer *buffer)
+{
+  jsontree_setup(js_ctx, root, buffer_putchar);
+  js_ctx->buffer = buffer;
+  memset(buffer, 0, sizeof(*buffer));
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * A step of jsontree_print_next() changes the index at the current depth
+ * and the one above it, the callback state, and the depth by one. Saving
+ * these before each step lets the last step be rendered again.
+ */
+static void
+save_checkpoint(struct jsontree_context *js_ctx)
+{
+  struct jsontree_buffer *b = js_ctx->buffer;
+
+  b->checkpoint_pos = b->pos;
+  b->checkpoint_depth = js_ctx->depth;
+  b->checkpoint_index = js_ctx->index[js_ctx->depth];
+  if(js_ctx->depth > 0) {
+    b->checkpoint_parent_index = js_ctx->index[js_ctx->depth - 1];
+  }
+  b->checkpoint_callback_state = js_ctx->callback_state;
+  b->checkpoint_valid = 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+restore_checkpoint(struct jsontree_context *js_ctx)
+{
+  struct jsontree_buffer *b = js_ctx->buffer;
+
+  b->pos = b->checkpoint_pos;
+  js_ctx->depth = b->checkpoint_depth;
+  js_ctx->index[js_ctx->depth] = b->checkpoint_index;
+  if(js_ctx->depth > 0) {
+    js_ctx->index[js_ctx->depth - 1] = b->checkpoint_parent_index;
+  }
+  js_ctx->callback_state = b->checkpoint_callback_state;
+}
+/*---------------------------------------------------------------------------*/
+int
+jsontree_print_buffer(struct jsontree_context *js_ctx, uint32_t offset,
+                      char *data, uint16_t size)
+{
+  struct jsontree_buffer *b = js_ctx->buffer;
+  int more;
+
+  if(js_ctx->putchar != buffer_putchar) {
+    return 0;
+  }
+
+  if(b->checkpoint_valid && offset >= b->checkpoint_pos) {
+    restore_checkpoint(js_ctx);
+  } else {
+    jsontree_reset(js_ctx);
+    b->pos = 0;
+  }
+  b->data = data;
+  b->size = size;
+  b->start = offset;
+  buffer_ctx = js_ctx;
+
+  do {
+    save_checkpoint(js_ctx);
+    more = jsontree_print_next(js_ctx);
+  } while(more && b->pos < offset + size);
+
+  b->complete = !more && b->pos <= offset + size;
+  if(b->pos <= offset) {
+    return 0;
+  }
+  return b->pos - offset < size ? b->pos - offset : size;
+}
+/*---------------------------------------------------------------------------*/
+void
 jsontree_reset(struct jsontree_context *js_ctx)
 {
   js_ctx->depth = 0;
@@ -153,46 +279,46 @@ jsontree_print_next(struct jsontree_context *js_ctx)
 
     index = js_ctx->index[js_ctx->depth];
     if(index == 0) {
-      js_ctx->putchar(v->type);
+      put(js_ctx, v->type);
 #if JSONTREE_PRETTY
-      js_ctx->putchar('\n');
+      put(js_ctx, '\n');
 #endif
     }
     if(index >= o->count) {
 #if JSONTREE_PRETTY
-      js_ctx->putchar('\n');
+      put(js_ctx, '\n');
       indent = js_ctx->depth;
       while (indent--) {
-        js_ctx->putchar(' ');
-        js_ctx->putchar(' ');
+        put(js_ctx, ' ');
+        put(js_ctx, ' ');
       }
 #endif
-      js_ctx->putchar(v->type + 2);
+      put(js_ctx, v->type + 2);
       /* Default operation: back up one level! */
       break;
     }
 
     if(index > 0) {
-      js_ctx->putchar(',');
+      put(js_ctx, ',');
 #if JSONTREE_PRETTY
-      js_ctx->putchar('\n');
+      put(js_ctx, '\n');
 #endif
     }
 
 #if JSONTREE_PRETTY
     indent = js_ctx->depth + 1;
     while (indent--) {
-      js_ctx->putchar(' ');
-      js_ctx->putchar(' ');
+      put(js_ctx, ' ');
+      put(js_ctx, ' ');
     }
 #endif
 
     if(v->type == JSON_TYPE_OBJECT) {
       jsontree_write_string(js_ctx,
                             ((struct jsontree_object *)o)->pairs[index].name);
-      js_ctx->putchar(':');
+      put(js_ctx, ':');
 #if JSONTREE_PRETTY
-      js_ctx->putchar(' ');
+      put(js_ctx, ' ');
 #endif
       ov = ((struct jsontree_object *)o)->pairs[index].value;
     } else {
@@ -55,6 +55,29 @@
 #define JSONTREE_PRETTY 0
 #endif /* JSONTREE_CONF_PRETTY */
 
+/*
+ * Output into a buffer, see jsontree_setup_buffer(). Besides the bytes
+ * being written, it remembers the tree position at the start of the last
+ * output step, so that the next range of the document is rendered from
+ * there instead of from the start.
+ */
+struct jsontree_buffer {
+  char *data;
+  uint16_t size;
+  /* Set when the document ended within the last range rendered */
+  uint8_t complete;
+  /* Document offsets of data[0] and of the next byte produced */
+  uint32_t start;
+  uint32_t pos;
+  /* The tree position at document offset checkpoint_pos */
+  uint32_t checkpoint_pos;
+  int checkpoint_callback_state;
+  uint16_t checkpoint_index;
+  uint16_t checkpoint_parent_index;
+  uint8_t checkpoint_depth;
+  uint8_t checkpoint_valid;
+};
+
 struct jsontree_context {
   struct jsontree_value *values[JSONTREE_MAX_DEPTH];
   uint16_t index[JSONTREE_MAX_DEPTH];
@@ -62,6 +85,8 @@ struct jsontree_context {
   uint8_t depth;
   uint8_t path;
   int callback_state;
+  /* Only used when set up with jsontree_setup_buffer() */
+  struct jsontree_buffer *buffer;
 };
 
 struct jsontree_value {
@@ -143,6 +168,39 @@ void jsontree_setup(struct jsontree_context *js_ctx,
                     struct jsontree_value *root, int (* putchar)(int));
 void jsontree_reset(struct jsontree_context *js_ctx);
 
+/**
+ * \brief      Set up a context to render into buffers
+ * \param js_ctx The context
+ * \param root The value to render
+ * \param buffer State of the buffer output, kept as long as the context
+ *
+ *             Values are rendered by jsontree_print_buffer() instead of
+ *             jsontree_print_next(). Callbacks write through
+ *             jsontree_write_*() or js_ctx->putchar() as usual.
+ */
+void jsontree_setup_buffer(struct jsontree_context *js_ctx,
+                           struct jsontree_value *root,
+                           struct jsontree_buffer *buffer);
+
+/**
+ * \brief      Render a range of the document into a buffer
+ * \param js_ctx A context set up with jsontree_setup_buffer()
+ * \param offset The document offset of the first byte to render
+ * \param data The buffer
+ * \param size The size of the buffer
+ * \return     The number of bytes written, less than size only at the end
+ *             of the document
+ *
+ *             Rendering resumes from the tree position where the previous
+ *             call stopped when offset does not go backwards, as when
+ *             serving successive blocks or chunks, and starts over from the
+ *             root otherwise. The tree values must not change while a
+ *             document is being rendered. buffer->complete tells whether
+ *             the document ended within this range.
+ */
+int jsontree_print_buffer(struct jsontree_context *js_ctx, uint32_t offset,
+                          char *data, uint16_t size);
+
 const char *jsontree_path_name(const struct jsontree_context *js_ctx,
                                int depth);
 
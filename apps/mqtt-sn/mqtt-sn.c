@@ -0,0 +1,731 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/*---------------------------------------------------------------------------*/
+/**
+ * \addtogroup mqtt-sn
+ * @{
+ *
+ * \file
+ *    Implementation of the MQTT-SN client
+ */
+/*---------------------------------------------------------------------------*/
+#include "contiki.h"
+#include "contiki-net.h"
+#include "mqtt-sn.h"
+
+#include <string.h>
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+/*---------------------------------------------------------------------------*/
+#if MQTT_SN_MAX_PACKET_SIZE > 255
+#error "MQTT_SN_MAX_PACKET_SIZE must fit the one-byte length field"
+#endif
+/*---------------------------------------------------------------------------*/
+/* Message types */
+#define MQTT_SN_CONNECT     0x04
+#define MQTT_SN_CONNACK     0x05
+#define MQTT_SN_REGISTER    0x0A
+#define MQTT_SN_REGACK      0x0B
+#define MQTT_SN_PUBLISH     0x0C
+#define MQTT_SN_PUBACK      0x0D
+#define MQTT_SN_PUBCOMP     0x0E
+#define MQTT_SN_PUBREC      0x0F
+#define MQTT_SN_PUBREL      0x10
+#define MQTT_SN_SUBSCRIBE   0x12
+#define MQTT_SN_SUBACK      0x13
+#define MQTT_SN_UNSUBSCRIBE 0x14
+#define MQTT_SN_UNSUBACK    0x15
+#define MQTT_SN_PINGREQ     0x16
+#define MQTT_SN_PINGRESP    0x17
+#define MQTT_SN_DISCONNECT  0x18
+
+/* Flags */
+#define MQTT_SN_FLAG_DUP        0x80
+#define MQTT_SN_FLAG_QOS_SHIFT  5
+#define MQTT_SN_FLAG_QOS_MASK   0x60
+#define MQTT_SN_FLAG_RETAIN     0x10
+#define MQTT_SN_FLAG_CLEAN      0x04
+#define MQTT_SN_FLAG_TOPIC_MASK 0x03
+
+#define MQTT_SN_PROTOCOL_ID 0x01
+
+/* Length and type */
+#define MQTT_SN_HEADER_LEN 2
+/* The length field of messages longer than 255 bytes */
+#define MQTT_SN_LONG_LENGTH 0x01
+/*---------------------------------------------------------------------------*/
+/* Messages that are not acknowledged are built here */
+static uint8_t unacked_buffer[MQTT_SN_MAX_PACKET_SIZE];
+/*---------------------------------------------------------------------------*/
+static void
+call_event(struct mqtt_sn_connection *conn, mqtt_sn_event_t event, void *data)
+{
+  conn->event_callback(conn, event, data);
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+next_mid(struct mqtt_sn_connection *conn)
+{
+  if(++conn->mid_counter == 0) {
+    conn->mid_counter = 1;
+  }
+  return conn->mid_counter;
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t *
+write_u16(uint8_t *ptr, uint16_t value)
+{
+  ptr[0] = value >> 8;
+  ptr[1] = value & 0xFF;
+  return ptr + 2;
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+read_u16(const uint8_t *ptr)
+{
+  return ((uint16_t)ptr[0] << 8) | ptr[1];
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t *
+begin_packet(uint8_t *buf, uint8_t type)
+{
+  buf[1] = type;
+  return buf + MQTT_SN_HEADER_LEN;
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_unacked(struct mqtt_sn_connection *conn, const uint8_t *end)
+{
+  unacked_buffer[0] = end - unacked_buffer;
+  simple_udp_send(&conn->sock, unacked_buffer, unacked_buffer[0]);
+}
+/*---------------------------------------------------------------------------*/
+static void
+lost(struct mqtt_sn_connection *conn)
+{
+  PRINTF("MQTT-SN: no answer from the gateway\n");
+  ctimer_stop(&conn->keep_alive_timer);
+  conn->expected = 0;
+  conn->state = MQTT_SN_STATE_DISCONNECTED;
+  call_event(conn, MQTT_SN_EVENT_TIMEOUT_ERROR, NULL);
+}
+/*---------------------------------------------------------------------------*/
+static void
+retry(void *ptr)
+{
+  struct mqtt_sn_connection *conn = ptr;
+
+  if(conn->expected == 0) {
+    return;
+  }
+  if(++conn->retries > MQTT_SN_MAX_RETRIES) {
+    lost(conn);
+    return;
+  }
+  if(conn->out_buffer[1] == MQTT_SN_PUBLISH
+     || conn->out_buffer[1] == MQTT_SN_SUBSCRIBE) {
+    conn->out_buffer[MQTT_SN_HEADER_LEN] |= MQTT_SN_FLAG_DUP;
+  }
+  PRINTF("MQTT-SN: resending 0x%02x\n", conn->out_buffer[1]);
+  simple_udp_send(&conn->sock, conn->out_buffer, conn->out_length);
+  ctimer_restart(&conn->retry_timer);
+}
+/*---------------------------------------------------------------------------*/
+/* Sends the request in out_buffer, waiting for the expected answer */
+static void
+send_request(struct mqtt_sn_connection *conn, const uint8_t *end,
+             uint8_t expected, uint16_t mid)
+{
+  conn->out_length = end - conn->out_buffer;
+  conn->out_buffer[0] = conn->out_length;
+  conn->expected = expected;
+  conn->expected_mid = mid;
+  conn->retries = 0;
+  simple_udp_send(&conn->sock, conn->out_buffer, conn->out_length);
+  ctimer_set(&conn->retry_timer, MQTT_SN_RETRY_TIMEOUT, retry, conn);
+}
+/*---------------------------------------------------------------------------*/
+/* Tells whether an answer acknowledges the pending request */
+static int
+acknowledges(struct mqtt_sn_connection *conn, uint8_t type, uint16_t mid)
+{
+  if(conn->expected != type || conn->expected_mid != mid) {
+    return 0;
+  }
+  ctimer_stop(&conn->retry_timer);
+  conn->expected = 0;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+keep_alive(void *ptr)
+{
+  struct mqtt_sn_connection *conn = ptr;
+  uint8_t *p;
+
+  if(conn->state != MQTT_SN_STATE_CONNECTED) {
+    return;
+  }
+  ctimer_reset(&conn->keep_alive_timer);
+  if(conn->expected != 0) {
+    /* The pending request tells the gateway we are alive */
+    return;
+  }
+  p = begin_packet(conn->out_buffer, MQTT_SN_PINGREQ);
+  send_request(conn, p, MQTT_SN_PINGRESP, 0);
+}
+/*---------------------------------------------------------------------------*/
+static mqtt_sn_status_t
+check_request(struct mqtt_sn_connection *conn)
+{
+  if(conn->state != MQTT_SN_STATE_CONNECTED) {
+    return MQTT_SN_STATUS_NOT_CONNECTED_ERROR;
+  }
+  if(conn->expected != 0) {
+    return MQTT_SN_STATUS_OUT_QUEUE_FULL;
+  }
+  return MQTT_SN_STATUS_OK;
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_connack(struct mqtt_sn_connection *conn, const uint8_t *p, uint16_t len)
+{
+  uint8_t rc;
+
+  if(len < 1 || !acknowledges(conn, MQTT_SN_CONNACK, 0)) {
+    return;
+  }
+  rc = p[0];
+  if(rc != MQTT_SN_RC_ACCEPTED) {
+    conn->state = MQTT_SN_STATE_DISCONNECTED;
+    call_event(conn, MQTT_SN_EVENT_CONNECTION_REFUSED_ERROR, &rc);
+    return;
+  }
+  conn->state = MQTT_SN_STATE_CONNECTED;
+  if(conn->keep_alive > 0) {
+    ctimer_set(&conn->keep_alive_timer, conn->keep_alive * CLOCK_SECOND,
+               keep_alive, conn);
+  }
+  call_event(conn, MQTT_SN_EVENT_CONNECTED, NULL);
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_register(struct mqtt_sn_connection *conn, const uint8_t *p, uint16_t len)
+{
+  struct mqtt_sn_topic_event event;
+  uint8_t *out;
+
+  if(len < 4) {
+    return;
+  }
+  memset(&event, 0, sizeof(event));
+  event.topic_id = read_u16(p);
+  event.mid = read_u16(p + 2);
+  event.topic_name = (const char *)p + 4;
+  event.topic_name_length = len - 4;
+  call_event(conn, MQTT_SN_EVENT_REGISTER, &event);
+
+  out = begin_packet(unacked_buffer, MQTT_SN_REGACK);
+  out = write_u16(out, event.topic_id);
+  out = write_u16(out, event.mid);
+  *out++ = MQTT_SN_RC_ACCEPTED;
+  send_unacked(conn, out);
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_ack(struct mqtt_sn_connection *conn, uint8_t type,
+           const uint8_t *p, uint16_t len)
+{
+  struct mqtt_sn_topic_event event;
+  mqtt_sn_event_t ev;
+
+  memset(&event, 0, sizeof(event));
+  switch(type) {
+  case MQTT_SN_REGACK:
+  case MQTT_SN_PUBACK:
+    if(len < 5) {
+      return;
+    }
+    event.topic_id = read_u16(p);
+    event.mid = read_u16(p + 2);
+    event.return_code = p[4];
+    ev = type == MQTT_SN_REGACK ? MQTT_SN_EVENT_REGACK : MQTT_SN_EVENT_PUBACK;
+    break;
+  case MQTT_SN_SUBACK:
+    if(len < 6) {
+      return;
+    }
+    event.qos_level = (p[0] & MQTT_SN_FLAG_QOS_MASK) >> MQTT_SN_FLAG_QOS_SHIFT;
+    event.topic_id = read_u16(p + 1);
+    event.mid = read_u16(p + 3);
+    event.return_code = p[5];
+    ev = MQTT_SN_EVENT_SUBACK;
+    break;
+  case MQTT_SN_UNSUBACK:
+    if(len < 2) {
+      return;
+    }
+    event.mid = read_u16(p);
+    ev = MQTT_SN_EVENT_UNSUBACK;
+    break;
+  default:
+    return;
+  }
+  if(acknowledges(conn, type, event.mid)) {
+    call_event(conn, ev, &event);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_publish(struct mqtt_sn_connection *conn, const uint8_t *p, uint16_t len)
+{
+  struct mqtt_sn_message msg;
+  uint8_t *out;
+
+  if(len < 5) {
+    return;
+  }
+  msg.dup = (p[0] & MQTT_SN_FLAG_DUP) != 0;
+  msg.qos_level = (p[0] & MQTT_SN_FLAG_QOS_MASK) >> MQTT_SN_FLAG_QOS_SHIFT;
+  msg.retain = (p[0] & MQTT_SN_FLAG_RETAIN) != 0;
+  msg.topic_type = p[0] & MQTT_SN_FLAG_TOPIC_MASK;
+  msg.topic_id = read_u16(p + 1);
+  msg.mid = read_u16(p + 3);
+  msg.payload = p + 5;
+  msg.payload_length = len - 5;
+  call_event(conn, MQTT_SN_EVENT_PUBLISH, &msg);
+
+  if(msg.qos_level == MQTT_SN_QOS_LEVEL_1) {
+    out = begin_packet(unacked_buffer, MQTT_SN_PUBACK);
+    out = write_u16(out, msg.topic_id);
+    out = write_u16(out, msg.mid);
+    *out++ = MQTT_SN_RC_ACCEPTED;
+    send_unacked(conn, out);
+  } else if(msg.qos_level == MQTT_SN_QOS_LEVEL_2) {
+    /* Only answered to keep the gateway going: a PUBLISH sent again
+       before our PUBREC reached the gateway is delivered twice */
+    out = begin_packet(unacked_buffer, MQTT_SN_PUBREC);
+    out = write_u16(out, msg.mid);
+    send_unacked(conn, out);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_disconnect(struct mqtt_sn_connection *conn)
+{
+  ctimer_stop(&conn->retry_timer);
+  ctimer_stop(&conn->keep_alive_timer);
+  conn->expected = 0;
+  if(conn->state == MQTT_SN_STATE_GOING_ASLEEP) {
+    conn->state = MQTT_SN_STATE_ASLEEP;
+    call_event(conn, MQTT_SN_EVENT_ASLEEP, NULL);
+  } else {
+    conn->state = MQTT_SN_STATE_DISCONNECTED;
+    call_event(conn, MQTT_SN_EVENT_DISCONNECTED, NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+input(struct simple_udp_connection *c,
+      const uip_ipaddr_t *source_addr, uint16_t source_port,
+      const uip_ipaddr_t *dest_addr, uint16_t dest_port,
+      const uint8_t *data, uint16_t datalen)
+{
+  struct mqtt_sn_connection *conn = (struct mqtt_sn_connection *)c;
+  uint16_t len;
+  uint8_t header_len;
+  uint8_t type;
+  uint8_t *out;
+
+  if(datalen < MQTT_SN_HEADER_LEN) {
+    return;
+  }
+  if(data[0] == MQTT_SN_LONG_LENGTH) {
+    if(datalen < MQTT_SN_HEADER_LEN + 2) {
+      return;
+    }
+    len = read_u16(data + 1);
+    header_len = MQTT_SN_HEADER_LEN + 2;
+  } else {
+    len = data[0];
+    header_len = MQTT_SN_HEADER_LEN;
+  }
+  if(len < header_len || len > datalen) {
+    call_event(conn, MQTT_SN_EVENT_PROTOCOL_ERROR, NULL);
+    return;
+  }
+  type = data[header_len - 1];
+  data += header_len;
+  len -= header_len;
+
+  PRINTF("MQTT-SN: got 0x%02x, %u bytes\n", type, len);
+
+  switch(type) {
+  case MQTT_SN_CONNACK:
+    handle_connack(conn, data, len);
+    break;
+  case MQTT_SN_REGISTER:
+    handle_register(conn, data, len);
+    break;
+  case MQTT_SN_REGACK:
+  case MQTT_SN_PUBACK:
+  case MQTT_SN_SUBACK:
+  case MQTT_SN_UNSUBACK:
+    handle_ack(conn, type, data, len);
+    break;
+  case MQTT_SN_PUBLISH:
+    handle_publish(conn, data, len);
+    break;
+  case MQTT_SN_PUBREL:
+    if(len >= 2) {
+      out = begin_packet(unacked_buffer, MQTT_SN_PUBCOMP);
+      out = write_u16(out, read_u16(data));
+      send_unacked(conn, out);
+    }
+    break;
+  case MQTT_SN_PINGREQ:
+    out = begin_packet(unacked_buffer, MQTT_SN_PINGRESP);
+    send_unacked(conn, out);
+    break;
+  case MQTT_SN_PINGRESP:
+    if(acknowledges(conn, MQTT_SN_PINGRESP, 0)
+       && conn->state == MQTT_SN_STATE_AWAKE) {
+      /* The gateway has sent all it buffered for us */
+      conn->state = MQTT_SN_STATE_ASLEEP;
+      call_event(conn, MQTT_SN_EVENT_ASLEEP, NULL);
+    }
+    break;
+  case MQTT_SN_DISCONNECT:
+    handle_disconnect(conn);
+    break;
+  default:
+    PRINTF("MQTT-SN: unhandled message 0x%02x\n", type);
+    break;
+  }
+}
+/*---------------------------------------------------------------------------*/
+mqtt_sn_status_t
+mqtt_sn_register(struct mqtt_sn_connection *conn, const char *client_id,
+                 const uip_ipaddr_t *gateway, uint16_t port,
+                 mqtt_sn_event_callback_t event_callback)
+{
+  uip_ipaddr_t addr;
+  size_t len;
+
+  if(conn == NULL || client_id == NULL || gateway == NULL
+     || event_callback == NULL) {
+    return MQTT_SN_STATUS_INVALID_ARGS_ERROR;
+  }
+  len = strlen(client_id);
+  if(len == 0 || len > MQTT_SN_CLIENT_ID_MAX_LEN) {
+    return MQTT_SN_STATUS_INVALID_ARGS_ERROR;
+  }
+
+  memset(conn, 0, sizeof(*conn));
+  memcpy(conn->client_id, client_id, len);
+  conn->client_id_length = len;
+  conn->event_callback = event_callback;
+  conn->state = MQTT_SN_STATE_DISCONNECTED;
+
+  uip_ipaddr_copy(&addr, gateway);
+  if(!simple_udp_register(&conn->sock, MQTT_SN_LOCAL_PORT, &addr, port,
+                          input)) {
+    return MQTT_SN_STATUS_ERROR;
+  }
+  return MQTT_SN_STATUS_OK;
+}
+/*---------------------------------------------------------------------------*/
+mqtt_sn_status_t
+mqtt_sn_connect(struct mqtt_sn_connection *conn, uint16_t keep_alive)
+{
+  uint8_t *p;
+
+  if(conn->state == MQTT_SN_STATE_CONNECTED
+     || conn->state == MQTT_SN_STATE_CONNECTING) {
+    return MQTT_SN_STATUS_OK;
+  }
+  if(conn->expected != 0) {
+    return MQTT_SN_STATUS_OUT_QUEUE_FULL;
+  }
+  conn->keep_alive = keep_alive;
+
+  p = begin_packet(conn->out_buffer, MQTT_SN_CONNECT);
+  /* A sleeping client keeps its session */
+  *p++ = conn->state == MQTT_SN_STATE_DISCONNECTED ? MQTT_SN_FLAG_CLEAN : 0;
+  *p++ = MQTT_SN_PROTOCOL_ID;
+  p = write_u16(p, keep_alive);
+  memcpy(p, conn->client_id, conn->client_id_length);
+  p += conn->client_id_length;
+
+  conn->state = MQTT_SN_STATE_CONNECTING;
+  send_request(conn, p, MQTT_SN_CONNACK, 0);
+  return MQTT_SN_STATUS_OK;
+}
+/*---------------------------------------------------------------------------*/
+static mqtt_sn_status_t
+send_disconnect(struct mqtt_sn_connection *conn, int with_duration,
+                uint16_t duration)
+{
+  uint8_t *p;
+
+  if(conn->state != MQTT_SN_STATE_CONNECTED) {
+    return MQTT_SN_STATUS_NOT_CONNECTED_ERROR;
+  }
+  /* Do not wait for the pending request */
+  ctimer_stop(&conn->retry_timer);
+  ctimer_stop(&conn->keep_alive_timer);
+
+  p = begin_packet(conn->out_buffer, MQTT_SN_DISCONNECT);
+  if(with_duration) {
+    p = write_u16(p, duration);
+    conn->state = MQTT_SN_STATE_GOING_ASLEEP;
+  } else {
+    conn->state = MQTT_SN_STATE_DISCONNECTING;
+  }
+  send_request(conn, p, MQTT_SN_DISCONNECT, 0);
+  return MQTT_SN_STATUS_OK;
+}
+/*---------------------------------------------------------------------------*/
+mqtt_sn_status_t
+mqtt_sn_disconnect(struct mqtt_sn_connection *conn)
+{
+  return send_disconnect(conn, 0, 0);
+}
+/*---------------------------------------------------------------------------*/
+mqtt_sn_status_t
+mqtt_sn_sleep(struct mqtt_sn_connection *conn, uint16_t duration)
+{
+  return send_disconnect(conn, 1, duration);
+}
+/*---------------------------------------------------------------------------*/
+mqtt_sn_status_t
+mqtt_sn_wake(struct mqtt_sn_connection *conn)
+{
+  uint8_t *p;
+
+  if(conn->state != MQTT_SN_STATE_ASLEEP) {
+    return MQTT_SN_STATUS_NOT_CONNECTED_ERROR;
+  }
+  p = begin_packet(conn->out_buffer, MQTT_SN_PINGREQ);
+  memcpy(p, conn->client_id, conn->client_id_length);
+  p += conn->client_id_length;
+
+  conn->state = MQTT_SN_STATE_AWAKE;
+  send_request(conn, p, MQTT_SN_PINGRESP, 0);
+  return MQTT_SN_STATUS_OK;
+}
+/*---------------------------------------------------------------------------*/
+mqtt_sn_status_t
+mqtt_sn_register_topic(struct mqtt_sn_connection *conn, uint16_t *mid,
+                       const char *topic)
+{
+  mqtt_sn_status_t status;
+  size_t len;
+  uint16_t id;
+  uint8_t *p;
+
+  status = check_request(conn);
+  if(status != MQTT_SN_STATUS_OK) {
+    return status;
+  }
+  len = strlen(topic);
+  if(len == 0 || len > MQTT_SN_MAX_PACKET_SIZE - MQTT_SN_HEADER_LEN - 4) {
+    return MQTT_SN_STATUS_INVALID_ARGS_ERROR;
+  }
+  id = next_mid(conn);
+
+  p = begin_packet(conn->out_buffer, MQTT_SN_REGISTER);
+  p = write_u16(p, 0);
+  p = write_u16(p, id);
+  memcpy(p, topic, len);
+  p += len;
+
+  send_request(conn, p, MQTT_SN_REGACK, id);
+  if(mid != NULL) {
+    *mid = id;
+  }
+  return MQTT_SN_STATUS_OK;
+}
+/*---------------------------------------------------------------------------*/
+static mqtt_sn_status_t
+send_subscription(struct mqtt_sn_connection *conn, uint8_t type,
+                  uint16_t *mid, uint8_t flags,
+                  const char *topic, uint16_t topic_id)
+{
+  mqtt_sn_status_t status;
+  size_t len = 0;
+  uint16_t id;
+  uint8_t *p;
+
+  status = check_request(conn);
+  if(status != MQTT_SN_STATUS_OK) {
+    return status;
+  }
+  if(topic != NULL) {
+    len = strlen(topic);
+    if(len == 0 || len > MQTT_SN_MAX_PACKET_SIZE - MQTT_SN_HEADER_LEN - 3) {
+      return MQTT_SN_STATUS_INVALID_ARGS_ERROR;
+    }
+  }
+  id = next_mid(conn);
+
+  p = begin_packet(conn->out_buffer, type);
+  *p++ = flags;
+  p = write_u16(p, id);
+  if(topic != NULL) {
+    memcpy(p, topic, len);
+    p += len;
+  } else {
+    p = write_u16(p, topic_id);
+  }
+
+  send_request(conn, p,
+               type == MQTT_SN_SUBSCRIBE ? MQTT_SN_SUBACK : MQTT_SN_UNSUBACK,
+               id);
+  if(mid != NULL) {
+    *mid = id;
+  }
+  return MQTT_SN_STATUS_OK;
+}
+/*---------------------------------------------------------------------------*/
+mqtt_sn_status_t
+mqtt_sn_subscribe(struct mqtt_sn_connection *conn, uint16_t *mid,
+                  const char *topic, mqtt_sn_qos_level_t qos_level)
+{
+  if(topic == NULL || qos_level > MQTT_SN_QOS_LEVEL_1) {
+    return MQTT_SN_STATUS_INVALID_ARGS_ERROR;
+  }
+  return send_subscription(conn, MQTT_SN_SUBSCRIBE, mid,
+                           (qos_level << MQTT_SN_FLAG_QOS_SHIFT)
+                           | MQTT_SN_TOPIC_TYPE_NORMAL, topic, 0);
+}
+/*---------------------------------------------------------------------------*/
+mqtt_sn_status_t
+mqtt_sn_subscribe_id(struct mqtt_sn_connection *conn, uint16_t *mid,
+                     mqtt_sn_topic_type_t topic_type, uint16_t topic_id,
+                     mqtt_sn_qos_level_t qos_level)
+{
+  if(topic_type == MQTT_SN_TOPIC_TYPE_NORMAL
+     || topic_type > MQTT_SN_TOPIC_TYPE_SHORT
+     || qos_level > MQTT_SN_QOS_LEVEL_1) {
+    return MQTT_SN_STATUS_INVALID_ARGS_ERROR;
+  }
+  return send_subscription(conn, MQTT_SN_SUBSCRIBE, mid,
+                           (qos_level << MQTT_SN_FLAG_QOS_SHIFT) | topic_type,
+                           NULL, topic_id);
+}
+/*---------------------------------------------------------------------------*/
+mqtt_sn_status_t
+mqtt_sn_unsubscribe(struct mqtt_sn_connection *conn, uint16_t *mid,
+                    const char *topic)
+{
+  if(topic == NULL) {
+    return MQTT_SN_STATUS_INVALID_ARGS_ERROR;
+  }
+  return send_subscription(conn, MQTT_SN_UNSUBSCRIBE, mid,
+                           MQTT_SN_TOPIC_TYPE_NORMAL, topic, 0);
+}
+/*---------------------------------------------------------------------------*/
+mqtt_sn_status_t
+mqtt_sn_unsubscribe_id(struct mqtt_sn_connection *conn, uint16_t *mid,
+                       mqtt_sn_topic_type_t topic_type, uint16_t topic_id)
+{
+  if(topic_type == MQTT_SN_TOPIC_TYPE_NORMAL
+     || topic_type > MQTT_SN_TOPIC_TYPE_SHORT) {
+    return MQTT_SN_STATUS_INVALID_ARGS_ERROR;
+  }
+  return send_subscription(conn, MQTT_SN_UNSUBSCRIBE, mid, topic_type,
+                           NULL, topic_id);
+}
+/*---------------------------------------------------------------------------*/
+mqtt_sn_status_t
+mqtt_sn_publish(struct mqtt_sn_connection *conn, uint16_t *mid,
+                mqtt_sn_topic_type_t topic_type, uint16_t topic_id,
+                const uint8_t *payload, uint16_t payload_length,
+                mqtt_sn_qos_level_t qos_level, uint8_t retain)
+{
+  mqtt_sn_status_t status;
+  uint16_t id = 0;
+  uint8_t *buf;
+  uint8_t *p;
+
+  if(topic_type > MQTT_SN_TOPIC_TYPE_SHORT
+     || qos_level == MQTT_SN_QOS_LEVEL_2
+     || payload_length > MQTT_SN_MAX_PACKET_SIZE - MQTT_SN_HEADER_LEN - 5) {
+    return MQTT_SN_STATUS_INVALID_ARGS_ERROR;
+  }
+  if(qos_level == MQTT_SN_QOS_LEVEL_MINUS_1) {
+    if(topic_type == MQTT_SN_TOPIC_TYPE_NORMAL) {
+      return MQTT_SN_STATUS_INVALID_ARGS_ERROR;
+    }
+  } else if(qos_level == MQTT_SN_QOS_LEVEL_0) {
+    if(conn->state != MQTT_SN_STATE_CONNECTED) {
+      return MQTT_SN_STATUS_NOT_CONNECTED_ERROR;
+    }
+  } else {
+    status = check_request(conn);
+    if(status != MQTT_SN_STATUS_OK) {
+      return status;
+    }
+    id = next_mid(conn);
+  }
+
+  buf = qos_level == MQTT_SN_QOS_LEVEL_1 ? conn->out_buffer : unacked_buffer;
+  p = begin_packet(buf, MQTT_SN_PUBLISH);
+  *p++ = (qos_level << MQTT_SN_FLAG_QOS_SHIFT)
+    | (retain ? MQTT_SN_FLAG_RETAIN : 0) | topic_type;
+  p = write_u16(p, topic_id);
+  p = write_u16(p, id);
+  if(payload_length > 0) {
+    memcpy(p, payload, payload_length);
+    p += payload_length;
+  }
+
+  if(qos_level == MQTT_SN_QOS_LEVEL_1) {
+    send_request(conn, p, MQTT_SN_PUBACK, id);
+  } else {
+    send_unacked(conn, p);
+  }
+  if(mid != NULL) {
+    *mid = id;
+  }
+  return MQTT_SN_STATUS_OK;
+}
+/*---------------------------------------------------------------------------*/
+/** @} */
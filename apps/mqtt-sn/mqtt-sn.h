@@ -0,0 +1,400 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/*---------------------------------------------------------------------------*/
+/**
+ * \addtogroup apps
+ * @{
+ *
+ * \defgroup mqtt-sn MQTT-SN client
+ *
+ * An MQTT-SN v1.2 client that talks to a gateway over UDP, so that leaf
+ * nodes do not need TCP. Topics are referred to by 16-bit topic IDs: IDs
+ * obtained with mqtt_sn_register_topic(), IDs predefined in the gateway,
+ * or two-character short topic names. A client can go to sleep while the
+ * gateway buffers the messages meant for it.
+ *
+ * The API follows the MQTT engine (see mqtt-engine): one callback receives
+ * the events of a connection and at most one acknowledged request is in
+ * flight at a time; while it is, requests return
+ * MQTT_SN_STATUS_OUT_QUEUE_FULL. Gateway discovery (ADVERTISE, SEARCHGW)
+ * and wills are not supported; the gateway address is configured.
+ * @{
+ *
+ * \file
+ *    Header file for the MQTT-SN client
+ */
+/*---------------------------------------------------------------------------*/
+#ifndef MQTT_SN_H_
+#define MQTT_SN_H_
+/*---------------------------------------------------------------------------*/
+#include "contiki.h"
+#include "contiki-net.h"
+#include "net/ip/simple-udp.h"
+/*---------------------------------------------------------------------------*/
+/* Protocol constants */
+#define MQTT_SN_DEFAULT_PORT 1883
+#define MQTT_SN_CLIENT_ID_MAX_LEN 23
+
+/* Largest message we send or receive, at most 255 */
+#ifdef MQTT_SN_CONF_MAX_PACKET_SIZE
+#define MQTT_SN_MAX_PACKET_SIZE MQTT_SN_CONF_MAX_PACKET_SIZE
+#else
+#define MQTT_SN_MAX_PACKET_SIZE 64
+#endif
+
+/* Time to wait for the gateway to acknowledge a request, and how many
+ * times the request is sent again before the connection is deemed lost */
+#ifdef MQTT_SN_CONF_RETRY_TIMEOUT
+#define MQTT_SN_RETRY_TIMEOUT MQTT_SN_CONF_RETRY_TIMEOUT
+#else
+#define MQTT_SN_RETRY_TIMEOUT (10 * CLOCK_SECOND)
+#endif
+
+#ifdef MQTT_SN_CONF_MAX_RETRIES
+#define MQTT_SN_MAX_RETRIES MQTT_SN_CONF_MAX_RETRIES
+#else
+#define MQTT_SN_MAX_RETRIES 3
+#endif
+
+/* Local UDP port, 0 for an ephemeral one */
+#ifdef MQTT_SN_CONF_LOCAL_PORT
+#define MQTT_SN_LOCAL_PORT MQTT_SN_CONF_LOCAL_PORT
+#else
+#define MQTT_SN_LOCAL_PORT 0
+#endif
+/*---------------------------------------------------------------------------*/
+/* Forward declaration */
+struct mqtt_sn_connection;
+
+/**
+ * \brief MQTT-SN client events
+ */
+typedef enum {
+  MQTT_SN_EVENT_CONNECTED,
+  MQTT_SN_EVENT_DISCONNECTED,
+
+  MQTT_SN_EVENT_REGACK,
+  MQTT_SN_EVENT_REGISTER,
+  MQTT_SN_EVENT_SUBACK,
+  MQTT_SN_EVENT_UNSUBACK,
+  MQTT_SN_EVENT_PUBLISH,
+  MQTT_SN_EVENT_PUBACK,
+
+  MQTT_SN_EVENT_ASLEEP,
+
+  /* Errors */
+  MQTT_SN_EVENT_ERROR = 0x80,
+  MQTT_SN_EVENT_PROTOCOL_ERROR,
+  MQTT_SN_EVENT_CONNECTION_REFUSED_ERROR,
+  MQTT_SN_EVENT_TIMEOUT_ERROR,
+} mqtt_sn_event_t;
+
+typedef enum {
+  MQTT_SN_STATUS_OK,
+
+  MQTT_SN_STATUS_OUT_QUEUE_FULL,
+
+  /* Errors */
+  MQTT_SN_STATUS_ERROR = 0x80,
+  MQTT_SN_STATUS_NOT_CONNECTED_ERROR,
+  MQTT_SN_STATUS_INVALID_ARGS_ERROR,
+} mqtt_sn_status_t;
+
+/* QoS -1 publishes without a connection, to a predefined or short topic */
+typedef enum {
+  MQTT_SN_QOS_LEVEL_0,
+  MQTT_SN_QOS_LEVEL_1,
+  MQTT_SN_QOS_LEVEL_2,
+  MQTT_SN_QOS_LEVEL_MINUS_1,
+} mqtt_sn_qos_level_t;
+
+typedef enum {
+  MQTT_SN_TOPIC_TYPE_NORMAL,
+  MQTT_SN_TOPIC_TYPE_PREDEFINED,
+  MQTT_SN_TOPIC_TYPE_SHORT,
+} mqtt_sn_topic_type_t;
+
+/* The topic ID of a two-character short topic name */
+#define MQTT_SN_SHORT_TOPIC(a, b) (((uint16_t)(a) << 8) | (uint8_t)(b))
+
+/* Return codes of the gateway */
+typedef enum {
+  MQTT_SN_RC_ACCEPTED,
+  MQTT_SN_RC_CONGESTION,
+  MQTT_SN_RC_INVALID_TOPIC_ID,
+  MQTT_SN_RC_NOT_SUPPORTED,
+} mqtt_sn_return_code_t;
+
+typedef enum {
+  MQTT_SN_STATE_DISCONNECTED,
+  MQTT_SN_STATE_CONNECTING,
+  MQTT_SN_STATE_CONNECTED,
+  MQTT_SN_STATE_DISCONNECTING,
+  MQTT_SN_STATE_GOING_ASLEEP,
+  MQTT_SN_STATE_ASLEEP,
+  MQTT_SN_STATE_AWAKE,
+} mqtt_sn_state_t;
+/*---------------------------------------------------------------------------*/
+/*
+ * Data of the REGACK, REGISTER, SUBACK, UNSUBACK and PUBACK events.
+ * topic_name is only set for REGISTER, where the gateway tells the topic
+ * name it will publish with topic_id. It is not NUL-terminated.
+ */
+struct mqtt_sn_topic_event {
+  uint16_t mid;
+  uint16_t topic_id;
+  mqtt_sn_return_code_t return_code;
+  mqtt_sn_qos_level_t qos_level;
+  const char *topic_name;
+  uint8_t topic_name_length;
+};
+
+/* Data of the PUBLISH event. The payload is only valid in the callback */
+struct mqtt_sn_message {
+  uint16_t mid;
+  uint16_t topic_id;
+  mqtt_sn_topic_type_t topic_type;
+  mqtt_sn_qos_level_t qos_level;
+  uint8_t retain;
+  uint8_t dup;
+  const uint8_t *payload;
+  uint16_t payload_length;
+};
+
+/*
+ * The event callback gets called whenever there is an event on the
+ * connection. data points to a struct mqtt_sn_topic_event, a struct
+ * mqtt_sn_message (MQTT_SN_EVENT_PUBLISH), the return code
+ * (MQTT_SN_EVENT_CONNECTION_REFUSED_ERROR) or is NULL.
+ */
+typedef void (*mqtt_sn_event_callback_t)(struct mqtt_sn_connection *conn,
+                                         mqtt_sn_event_t event,
+                                         void *data);
+
+struct mqtt_sn_connection {
+  /* Must be first in the struct, the UDP callback casts it */
+  struct simple_udp_connection sock;
+
+  char client_id[MQTT_SN_CLIENT_ID_MAX_LEN + 1];
+  uint8_t client_id_length;
+  uint16_t keep_alive;
+  struct ctimer keep_alive_timer;
+
+  mqtt_sn_state_t state;
+  mqtt_sn_event_callback_t event_callback;
+  uint16_t mid_counter;
+
+  /* The request waiting to be acknowledged, if expected is not 0 */
+  uint8_t out_buffer[MQTT_SN_MAX_PACKET_SIZE];
+  uint8_t out_length;
+  uint8_t expected;
+  uint16_t expected_mid;
+  uint8_t retries;
+  struct ctimer retry_timer;
+};
+/*---------------------------------------------------------------------------*/
+/* This is the API exposed to the user. */
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Initializes an MQTT-SN connection.
+ * \param conn A pointer to the MQTT-SN connection.
+ * \param client_id The client ID, 1 to 23 characters.
+ * \param gateway The IPv6 address of the gateway.
+ * \param port The UDP port of the gateway.
+ * \param event_callback Callback function handling the events of the
+ *        connection.
+ * \return MQTT_SN_STATUS_OK or an error status
+ *
+ * This function shall be called before any other MQTT-SN function.
+ */
+mqtt_sn_status_t mqtt_sn_register(struct mqtt_sn_connection *conn,
+                                  const char *client_id,
+                                  const uip_ipaddr_t *gateway,
+                                  uint16_t port,
+                                  mqtt_sn_event_callback_t event_callback);
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Connects to the gateway.
+ * \param conn A pointer to the MQTT-SN connection.
+ * \param keep_alive Keep alive period in seconds, 0 to disable.
+ * \return MQTT_SN_STATUS_OK or an error status
+ *
+ * MQTT_SN_EVENT_CONNECTED is raised when the gateway accepts. This is also
+ * how a sleeping client becomes active again.
+ */
+mqtt_sn_status_t mqtt_sn_connect(struct mqtt_sn_connection *conn,
+                                 uint16_t keep_alive);
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Disconnects from the gateway.
+ * \param conn A pointer to the MQTT-SN connection.
+ * \return MQTT_SN_STATUS_OK or an error status
+ */
+mqtt_sn_status_t mqtt_sn_disconnect(struct mqtt_sn_connection *conn);
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Goes to sleep.
+ * \param conn A pointer to the MQTT-SN connection.
+ * \param duration Sleep duration in seconds.
+ * \return MQTT_SN_STATUS_OK or an error status
+ *
+ * The gateway keeps the subscriptions and buffers the messages for the
+ * client, which raises MQTT_SN_EVENT_ASLEEP once the gateway agreed. The
+ * client must call mqtt_sn_wake() or mqtt_sn_connect() within duration
+ * seconds, or the gateway considers it lost.
+ */
+mqtt_sn_status_t mqtt_sn_sleep(struct mqtt_sn_connection *conn,
+                               uint16_t duration);
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Fetches the messages buffered for a sleeping client.
+ * \param conn A pointer to the MQTT-SN connection.
+ * \return MQTT_SN_STATUS_OK or an error status
+ *
+ * The buffered messages are raised as MQTT_SN_EVENT_PUBLISH, then
+ * MQTT_SN_EVENT_ASLEEP tells that the client may sleep again.
+ */
+mqtt_sn_status_t mqtt_sn_wake(struct mqtt_sn_connection *conn);
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Registers a topic name, to publish to it.
+ * \param conn A pointer to the MQTT-SN connection.
+ * \param mid A pointer to where the message ID is stored, or NULL.
+ * \param topic The topic name, without wildcards.
+ * \return MQTT_SN_STATUS_OK or an error status
+ *
+ * MQTT_SN_EVENT_REGACK gives the topic ID assigned by the gateway.
+ */
+mqtt_sn_status_t mqtt_sn_register_topic(struct mqtt_sn_connection *conn,
+                                        uint16_t *mid, const char *topic);
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Subscribes to a topic name, which may contain wildcards.
+ * \param conn A pointer to the MQTT-SN connection.
+ * \param mid A pointer to where the message ID is stored, or NULL.
+ * \param topic The topic name.
+ * \param qos_level Maximum QoS level of the messages, 0 or 1.
+ * \return MQTT_SN_STATUS_OK or an error status
+ *
+ * MQTT_SN_EVENT_SUBACK gives the topic ID assigned by the gateway, which
+ * is 0 for topic names with wildcards: the gateway then registers the
+ * topics it publishes to, see MQTT_SN_EVENT_REGISTER.
+ */
+mqtt_sn_status_t mqtt_sn_subscribe(struct mqtt_sn_connection *conn,
+                                   uint16_t *mid, const char *topic,
+                                   mqtt_sn_qos_level_t qos_level);
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Subscribes to a predefined or short topic.
+ * \param conn A pointer to the MQTT-SN connection.
+ * \param mid A pointer to where the message ID is stored, or NULL.
+ * \param topic_type MQTT_SN_TOPIC_TYPE_PREDEFINED or MQTT_SN_TOPIC_TYPE_SHORT.
+ * \param topic_id The topic ID.
+ * \param qos_level Maximum QoS level of the messages, 0 or 1.
+ * \return MQTT_SN_STATUS_OK or an error status
+ */
+mqtt_sn_status_t mqtt_sn_subscribe_id(struct mqtt_sn_connection *conn,
+                                      uint16_t *mid,
+                                      mqtt_sn_topic_type_t topic_type,
+                                      uint16_t topic_id,
+                                      mqtt_sn_qos_level_t qos_level);
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Unsubscribes from a topic name.
+ * \param conn A pointer to the MQTT-SN connection.
+ * \param mid A pointer to where the message ID is stored, or NULL.
+ * \param topic The topic name used to subscribe.
+ * \return MQTT_SN_STATUS_OK or an error status
+ */
+mqtt_sn_status_t mqtt_sn_unsubscribe(struct mqtt_sn_connection *conn,
+                                     uint16_t *mid, const char *topic);
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Unsubscribes from a predefined or short topic.
+ * \param conn A pointer to the MQTT-SN connection.
+ * \param mid A pointer to where the message ID is stored, or NULL.
+ * \param topic_type MQTT_SN_TOPIC_TYPE_PREDEFINED or MQTT_SN_TOPIC_TYPE_SHORT.
+ * \param topic_id The topic ID.
+ * \return MQTT_SN_STATUS_OK or an error status
+ */
+mqtt_sn_status_t mqtt_sn_unsubscribe_id(struct mqtt_sn_connection *conn,
+                                        uint16_t *mid,
+                                        mqtt_sn_topic_type_t topic_type,
+                                        uint16_t topic_id);
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Publishes a message.
+ * \param conn A pointer to the MQTT-SN connection.
+ * \param mid A pointer to where the message ID is stored, or NULL.
+ * \param topic_type The type of topic_id.
+ * \param topic_id A registered, predefined or short topic ID.
+ * \param payload The payload.
+ * \param payload_length The payload length.
+ * \param qos_level MQTT_SN_QOS_LEVEL_0, 1 or MINUS_1.
+ * \param retain Whether the gateway shall retain the message.
+ * \return MQTT_SN_STATUS_OK or an error status
+ *
+ * With QoS 1, MQTT_SN_EVENT_PUBACK tells the outcome; the return code
+ * MQTT_SN_RC_INVALID_TOPIC_ID means the topic must be registered again.
+ * QoS -1 needs no connection, only a predefined or short topic.
+ */
+mqtt_sn_status_t mqtt_sn_publish(struct mqtt_sn_connection *conn,
+                                 uint16_t *mid,
+                                 mqtt_sn_topic_type_t topic_type,
+                                 uint16_t topic_id,
+                                 const uint8_t *payload,
+                                 uint16_t payload_length,
+                                 mqtt_sn_qos_level_t qos_level,
+                                 uint8_t retain);
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Tells whether the client is connected to the gateway.
+ * \param conn A pointer to the MQTT-SN connection.
+ * \return 1 if connected, 0 otherwise
+ */
+#define mqtt_sn_connected(conn) \
+  ((conn)->state == MQTT_SN_STATE_CONNECTED)
+
+/**
+ * \brief Tells whether a request can be sent.
+ * \param conn A pointer to the MQTT-SN connection.
+ * \return 1 if no request waits for its acknowledgement, 0 otherwise
+ */
+#define mqtt_sn_ready(conn) ((conn)->expected == 0)
+/*---------------------------------------------------------------------------*/
+#endif /* MQTT_SN_H_ */
+/*---------------------------------------------------------------------------*/
+/**
+ * @}
+ * @}
+ */
@@ -57,7 +57,12 @@
 
 #include "lib/assert.h"
 #include "lib/list.h"
+#include "lib/memb.h"
 #include "sys/cc.h"
+#if MQTT_INFLIGHT_PERSIST
+#include "cfs/cfs.h"
+#include "lib/crc16.h"
+#endif
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -127,6 +132,10 @@ typedef enum {
 /*---------------------------------------------------------------------------*/
 #define INCREMENT_MID(conn)   (conn)->mid_counter += 2
 #define MQTT_STRING_LENGTH(s) (((s)->length) == 0 ? 0 : (MQTT_STRING_LEN_SIZE + (s)->length))
+/* Total size of the incoming packet, fixed header included */
+#define IN_PACKET_LENGTH(conn) (MQTT_FHDR_SIZE +                               \
+                                (conn)->in_packet.remaining_length_bytes +     \
+                                (conn)->in_packet.remaining_length)
 /*---------------------------------------------------------------------------*/
 /* Protothread send macros */
 #define PT_MQTT_WRITE_BYTES(conn, data, len)                                   \
@@ -187,6 +196,39 @@ static void tcp_event(struct tcp_socket *s, void *ptr,
 
 static void reset_packet(struct mqtt_in_packet *packet);
 /*---------------------------------------------------------------------------*/
+#if MQTT_INFLIGHT_WINDOW > 1
+/* What is kept of a QoS 1 PUBLISH until its PUBACK, and persisted */
+struct inflight_msg {
+  uint16_t mid;
+  uint8_t retain;
+  uint8_t topic_length;
+  uint16_t payload_size;
+  char topic[MQTT_MAX_TOPIC_LENGTH];
+  uint8_t payload[MQTT_INFLIGHT_PAYLOAD_SIZE];
+};
+
+struct inflight {
+  struct inflight *next;
+  clock_time_t sent_at;
+  uint8_t flags;
+  struct inflight_msg msg;
+};
+
+#define INFLIGHT_SENT  0x01
+/* Sent at least once, further copies carry the DUP flag */
+#define INFLIGHT_DUP   0x02
+/* Acknowledged while being sent again, freed once that is done */
+#define INFLIGHT_ACKED 0x04
+
+MEMB(inflight_memb, struct inflight, MQTT_INFLIGHT_WINDOW);
+
+static void inflight_send(struct mqtt_connection *conn);
+#endif /* MQTT_INFLIGHT_WINDOW > 1 */
+
+#if MQTT_TOPIC_NODES > 0
+MEMB(topic_memb, struct mqtt_topic_node, MQTT_TOPIC_NODES);
+#endif
+/*---------------------------------------------------------------------------*/
 LIST(mqtt_conn_list);
 /*---------------------------------------------------------------------------*/
 PROCESS(mqtt_process, "MQTT process");
@@ -304,7 +346,7 @@ write_byte(struct mqtt_connection *conn, uint8_t data)
 }
 /*---------------------------------------------------------------------------*/
 static int
-write_bytes(struct mqtt_connection *conn, uint8_t *data, uint16_t len)
+write_bytes(struct mqtt_connection *conn, uint8_t *data, uint32_t len)
 {
   uint16_t write_bytes;
   write_bytes =
@@ -327,6 +369,42 @@ write_bytes(struct mqtt_connection *conn, uint8_t *data, uint16_t len)
   }
 }
 /*---------------------------------------------------------------------------*/
+/*
+ * Has the payload reader write as much of the payload as fits straight into
+ * the output buffer. Returns 0 when the whole payload has been written, -1 if
+ * the reader failed, and 1 otherwise.
+ */
+static int
+write_payload(struct mqtt_connection *conn)
+{
+  uint16_t len;
+
+  len = MIN(&conn->out_buffer[MQTT_TCP_OUTPUT_BUFF_SIZE] - conn->out_buffer_ptr,
+            conn->out_packet.payload_size - conn->out_write_pos);
+  if(len > 0) {
+    len = conn->out_packet.payload_reader(conn,
+                                          conn->out_packet.payload_reader_ptr,
+                                          conn->out_write_pos,
+                                          conn->out_buffer_ptr, len);
+    if(len == 0) {
+      conn->out_write_pos = 0;
+      return -1;
+    }
+    conn->out_write_pos += len;
+    conn->out_buffer_ptr += len;
+  }
+
+  DBG("MQTT - (write_payload) len: %lu write_pos: %lu\n",
+      conn->out_packet.payload_size, conn->out_write_pos);
+
+  if(conn->out_packet.payload_size - conn->out_write_pos == 0) {
+    conn->out_write_pos = 0;
+    return 0;
+  }
+  send_out_buffer(conn);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
 static void
 encode_remaining_length(uint8_t *remaining_length,
                         uint8_t *remaining_length_bytes,
@@ -375,6 +453,223 @@ reset_packet(struct mqtt_in_packet *packet)
   packet->remaining_multiplier = 1;
 }
 /*---------------------------------------------------------------------------*/
+#if MQTT_INFLIGHT_WINDOW > 1
+#if MQTT_INFLIGHT_PERSIST
+static void
+inflight_filename(struct mqtt_connection *conn, char *name)
+{
+  sprintf(name, "mqtt-%04x",
+          crc16_data((const unsigned char *)conn->client_id.string,
+                     conn->client_id.length, 0));
+}
+#endif /* MQTT_INFLIGHT_PERSIST */
+/*---------------------------------------------------------------------------*/
+static void
+inflight_save(struct mqtt_connection *conn)
+{
+#if MQTT_INFLIGHT_PERSIST
+  char name[10];
+  struct inflight *e;
+  int fd;
+
+  inflight_filename(conn, name);
+  fd = cfs_open(name, CFS_WRITE);
+  if(fd < 0) {
+    PRINTF("MQTT - Error, cannot save the resend queue\n");
+    return;
+  }
+  for(e = list_head(conn->inflight); e != NULL; e = list_item_next(e)) {
+    if(!(e->flags & INFLIGHT_ACKED)) {
+      cfs_write(fd, &e->msg, sizeof(e->msg));
+    }
+  }
+  cfs_close(fd);
+#endif /* MQTT_INFLIGHT_PERSIST */
+}
+/*---------------------------------------------------------------------------*/
+static void
+inflight_load(struct mqtt_connection *conn)
+{
+#if MQTT_INFLIGHT_PERSIST
+  char name[10];
+  struct inflight *e;
+  int fd;
+
+  inflight_filename(conn, name);
+  fd = cfs_open(name, CFS_READ);
+  if(fd < 0) {
+    return;
+  }
+  while((e = memb_alloc(&inflight_memb)) != NULL) {
+    if(cfs_read(fd, &e->msg, sizeof(e->msg)) != sizeof(e->msg)) {
+      memb_free(&inflight_memb, e);
+      break;
+    }
+    /* Restored messages have already been sent before the reboot */
+    e->flags = INFLIGHT_DUP;
+    list_add(conn->inflight, e);
+    /* Do not reuse their message IDs */
+    if(e->msg.mid > conn->mid_counter) {
+      conn->mid_counter = e->msg.mid;
+    }
+  }
+  cfs_close(fd);
+  DBG("MQTT - Restored %u messages\n", list_length(conn->inflight));
+#endif /* MQTT_INFLIGHT_PERSIST */
+}
+/*---------------------------------------------------------------------------*/
+static mqtt_status_t
+inflight_add(struct mqtt_connection *conn, char *topic, uint8_t *payload,
+             uint16_t payload_size, mqtt_retain_t retain, uint16_t *mid)
+{
+  struct inflight *e;
+
+  e = memb_alloc(&inflight_memb);
+  if(e == NULL) {
+    DBG("MQTT - Not accepted, window full!\n");
+    return MQTT_STATUS_OUT_QUEUE_FULL;
+  }
+
+  e->flags = 0;
+  e->msg.mid = INCREMENT_MID(conn);
+  e->msg.retain = retain;
+  e->msg.topic_length = strlen(topic);
+  memcpy(e->msg.topic, topic, e->msg.topic_length);
+  e->msg.payload_size = payload_size;
+  memcpy(e->msg.payload, payload, payload_size);
+  list_add(conn->inflight, e);
+  inflight_save(conn);
+
+  if(mid != NULL) {
+    *mid = e->msg.mid;
+  }
+
+  inflight_send(conn);
+  return MQTT_STATUS_OK;
+}
+/*---------------------------------------------------------------------------*/
+static void
+inflight_remove(struct mqtt_connection *conn, struct inflight *e)
+{
+  list_remove(conn->inflight, e);
+  memb_free(&inflight_memb, e);
+}
+/*---------------------------------------------------------------------------*/
+static void
+inflight_ack(struct mqtt_connection *conn, uint16_t mid)
+{
+  struct inflight *e;
+
+  for(e = list_head(conn->inflight); e != NULL; e = list_item_next(e)) {
+    if(e->msg.mid == mid) {
+      break;
+    }
+  }
+  if(e == NULL) {
+    return;
+  }
+
+  if(conn->out_queue_full && conn->out_packet.pipelined &&
+     conn->out_packet.mid == mid) {
+    /* A copy is being written from this entry, keep it until then */
+    e->flags |= INFLIGHT_ACKED;
+  } else {
+    inflight_remove(conn, e);
+  }
+  inflight_save(conn);
+}
+/*---------------------------------------------------------------------------*/
+/* Called when a PUBLISH from the queue has been written out */
+static void
+inflight_sent(struct mqtt_connection *conn)
+{
+  struct inflight *e;
+
+  for(e = list_head(conn->inflight); e != NULL; e = list_item_next(e)) {
+    if(e->flags & INFLIGHT_ACKED) {
+      inflight_remove(conn, e);
+      break;
+    }
+  }
+  inflight_send(conn);
+}
+/*---------------------------------------------------------------------------*/
+static void
+inflight_timeout(void *ptr)
+{
+  struct mqtt_connection *conn = ptr;
+  struct inflight *e;
+
+  for(e = list_head(conn->inflight); e != NULL; e = list_item_next(e)) {
+    if((e->flags & INFLIGHT_SENT) &&
+       clock_time() - e->sent_at >= RESPONSE_WAIT_TIMEOUT) {
+      DBG("MQTT - Timeout waiting for PUBACK %u\n", e->msg.mid);
+      e->flags &= ~INFLIGHT_SENT;
+    }
+  }
+  if(list_head(conn->inflight) != NULL) {
+    ctimer_set(&conn->inflight_timer, RESPONSE_WAIT_TIMEOUT,
+               inflight_timeout, conn);
+  }
+  inflight_send(conn);
+}
+/*---------------------------------------------------------------------------*/
+/* Sends the oldest queued message not sent yet, if the connection is idle */
+static void
+inflight_send(struct mqtt_connection *conn)
+{
+  struct inflight *e;
+
+  if(conn->state != MQTT_CONN_STATE_CONNECTED_TO_BROKER ||
+     conn->out_queue_full || !conn->out_buffer_sent) {
+    return;
+  }
+
+  for(e = list_head(conn->inflight); e != NULL; e = list_item_next(e)) {
+    if(!(e->flags & INFLIGHT_SENT)) {
+      break;
+    }
+  }
+  if(e == NULL) {
+    return;
+  }
+
+  conn->out_queue_full = 1;
+  conn->out_packet.mid = e->msg.mid;
+  conn->out_packet.retain = e->msg.retain;
+  conn->out_packet.topic = e->msg.topic;
+  conn->out_packet.topic_length = e->msg.topic_length;
+  conn->out_packet.payload = e->msg.payload;
+  conn->out_packet.payload_size = e->msg.payload_size;
+  conn->out_packet.payload_reader = NULL;
+  conn->out_packet.qos = MQTT_QOS_LEVEL_1;
+  conn->out_packet.qos_state = MQTT_QOS_STATE_NO_ACK;
+  conn->out_packet.dup = (e->flags & INFLIGHT_DUP) != 0;
+  conn->out_packet.pipelined = 1;
+
+  e->flags |= INFLIGHT_SENT | INFLIGHT_DUP;
+  e->sent_at = clock_time();
+  if(ctimer_expired(&conn->inflight_timer)) {
+    ctimer_set(&conn->inflight_timer, RESPONSE_WAIT_TIMEOUT,
+               inflight_timeout, conn);
+  }
+
+  process_post(&mqtt_process, mqtt_do_publish_event, conn);
+}
+/*---------------------------------------------------------------------------*/
+/* After a (re)connection, send all unacknowledged messages again */
+static void
+inflight_restart(struct mqtt_connection *conn)
+{
+  struct inflight *e;
+
+  for(e = list_head(conn->inflight); e != NULL; e = list_item_next(e)) {
+    e->flags &= ~INFLIGHT_SENT;
+  }
+  inflight_send(conn);
+}
+#endif /* MQTT_INFLIGHT_WINDOW > 1 */
+/*---------------------------------------------------------------------------*/
 static
 PT_THREAD(connect_pt(struct pt *pt, struct mqtt_connection *conn))
 {
@@ -626,6 +921,8 @@ PT_THREAD(unsubscribe_pt(struct pt *pt, struct mqtt_connection *conn))
 static
 PT_THREAD(publish_pt(struct pt *pt, struct mqtt_connection *conn))
 {
+  int ret;
+
   PT_BEGIN(pt);
 
   DBG("MQTT - Sending publish message! topic %s topic_length %i\n",
@@ -640,6 +937,9 @@ PT_THREAD(publish_pt(struct pt *pt, struct mqtt_connection *conn))
   if(conn->out_packet.retain == MQTT_RETAIN_ON) {
     conn->out_packet.fhdr |= MQTT_FHDR_RETAIN_FLAG;
   }
+  if(conn->out_packet.dup) {
+    conn->out_packet.fhdr |= MQTT_FHDR_DUP_FLAG;
+  }
   conn->out_packet.remaining_length = MQTT_STRING_LEN_SIZE +
     conn->out_packet.topic_length +
     conn->out_packet.payload_size;
@@ -665,13 +965,26 @@ PT_THREAD(publish_pt(struct pt *pt, struct mqtt_connection *conn))
   PT_MQTT_WRITE_BYTES(conn, (uint8_t *)conn->out_packet.topic,
                       conn->out_packet.topic_length);
   if(conn->out_packet.qos > MQTT_QOS_LEVEL_0) {
-    PT_MQTT_WRITE_BYTE(conn, (conn->out_packet.mid << 8));
+    PT_MQTT_WRITE_BYTE(conn, (conn->out_packet.mid >> 8));
     PT_MQTT_WRITE_BYTE(conn, (conn->out_packet.mid & 0x00FF));
   }
   /* Write Payload */
-  PT_MQTT_WRITE_BYTES(conn,
-                      conn->out_packet.payload,
-                      conn->out_packet.payload_size);
+  if(conn->out_packet.payload_reader != NULL) {
+    while((ret = write_payload(conn)) > 0) {
+      PT_WAIT_UNTIL(pt, conn->out_buffer_sent);
+    }
+    if(ret < 0) {
+      /* Part of the PUBLISH is out already, the stream cannot be recovered */
+      PRINTF("MQTT - Error, payload reader failed\n");
+      call_event(conn, MQTT_EVENT_ERROR, NULL);
+      disconnect_tcp(conn);
+      PT_EXIT(pt);
+    }
+  } else {
+    PT_MQTT_WRITE_BYTES(conn,
+                        conn->out_packet.payload,
+                        conn->out_packet.payload_size);
+  }
 
   send_out_buffer(conn);
   timer_set(&conn->t, RESPONSE_WAIT_TIMEOUT);
@@ -684,6 +997,8 @@ PT_THREAD(publish_pt(struct pt *pt, struct mqtt_connection *conn))
    */
   if(conn->out_packet.qos == 0) {
     process_post(conn->app_process, mqtt_update_event, NULL);
+  } else if(conn->out_packet.pipelined) {
+    /* The PUBACK is handled by the resend queue */
   } else if(conn->out_packet.qos == 1) {
     /* Wait for PUBACK */
     reset_packet(&conn->in_packet);
@@ -761,6 +1076,10 @@ handle_connack(struct mqtt_connection *conn)
   /* Always reset packet before callback since it might be used directly */
   conn->state = MQTT_CONN_STATE_CONNECTED_TO_BROKER;
   call_event(conn, MQTT_EVENT_CONNECTED, NULL);
+
+#if MQTT_INFLIGHT_WINDOW > 1
+  inflight_restart(conn);
+#endif
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -820,13 +1139,210 @@ handle_puback(struct mqtt_connection *conn)
 {
   DBG("MQTT - Got PUBACK\n");
 
-  conn->out_packet.qos_state = MQTT_QOS_STATE_GOT_ACK;
   conn->in_packet.mid = (conn->in_packet.payload[0] << 8) |
     (conn->in_packet.payload[1]);
+  if(conn->in_packet.mid == conn->out_packet.mid) {
+    conn->out_packet.qos_state = MQTT_QOS_STATE_GOT_ACK;
+  }
+
+#if MQTT_INFLIGHT_WINDOW > 1
+  inflight_ack(conn, conn->in_packet.mid);
+#endif
 
   call_event(conn, MQTT_EVENT_PUBACK, &conn->in_packet.mid);
 }
 /*---------------------------------------------------------------------------*/
+#if MQTT_TOPIC_NODES > 0
+/* The length of the topic level starting at level */
+static uint8_t
+topic_level_length(const char *level)
+{
+  const char *end = level;
+
+  while(*end != '\0' && *end != '/') {
+    end++;
+  }
+  return end - level;
+}
+/*---------------------------------------------------------------------------*/
+static struct mqtt_topic_node *
+topic_find(struct mqtt_topic_node *node, const char *level, uint8_t length)
+{
+  for(; node != NULL; node = node->sibling) {
+    if(node->level_length == length && memcmp(node->level, level, length) == 0) {
+      return node;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static int
+topic_deliver(struct mqtt_connection *conn, struct mqtt_topic_node *node,
+              struct mqtt_message *msg)
+{
+  struct mqtt_topic_filter *f;
+
+  for(f = node->filters; f != NULL; f = f->next) {
+    f->callback(conn, msg);
+  }
+  return node->filters != NULL;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Calls the filters under node matching the topic from level on. Wildcards
+ * do not match the first level of topics starting with '$'.
+ */
+static int
+topic_dispatch(struct mqtt_connection *conn, struct mqtt_topic_node *node,
+               const char *level, int first, struct mqtt_message *msg)
+{
+  uint8_t length = topic_level_length(level);
+  const char *next = level[length] == '/' ? level + length + 1 : NULL;
+  int wildcards = !(first && level[0] == '$');
+  struct mqtt_topic_node *hash;
+  int matched = 0;
+
+  for(; node != NULL; node = node->sibling) {
+    if(node->level_length == 1 && node->level[0] == '#') {
+      if(wildcards) {
+        matched |= topic_deliver(conn, node, msg);
+      }
+      continue;
+    }
+    if(node->level_length == 1 && node->level[0] == '+') {
+      if(!wildcards) {
+        continue;
+      }
+    } else if(node->level_length != length
+              || memcmp(node->level, level, length) != 0) {
+      continue;
+    }
+    if(next != NULL) {
+      matched |= topic_dispatch(conn, node->child, next, 0, msg);
+    } else {
+      matched |= topic_deliver(conn, node, msg);
+      /* "a/#" also matches "a" */
+      hash = topic_find(node->child, "#", 1);
+      if(hash != NULL) {
+        matched |= topic_deliver(conn, hash, msg);
+      }
+    }
+  }
+  return matched;
+}
+/*---------------------------------------------------------------------------*/
+/* Removes filter from the node of topic, and the nodes left unused */
+static void
+topic_unlink(struct mqtt_topic_node **np, const char *level,
+             struct mqtt_topic_filter *filter)
+{
+  uint8_t length = topic_level_length(level);
+  struct mqtt_topic_filter **fp;
+  struct mqtt_topic_node *node;
+
+  for(; *np != NULL; np = &(*np)->sibling) {
+    node = *np;
+    if(node->level_length != length
+       || memcmp(node->level, level, length) != 0) {
+      continue;
+    }
+    if(level[length] == '/') {
+      topic_unlink(&node->child, level + length + 1, filter);
+    } else {
+      for(fp = &node->filters; *fp != NULL; fp = &(*fp)->next) {
+        if(*fp == filter) {
+          *fp = filter->next;
+          break;
+        }
+      }
+    }
+    if(node->filters == NULL && node->child == NULL) {
+      *np = node->sibling;
+      memb_free(&topic_memb, node);
+    }
+    return;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+topic_valid(const char *topic)
+{
+  const char *level = topic;
+  uint8_t length;
+
+  while(1) {
+    length = topic_level_length(level);
+    if(length > MQTT_TOPIC_LEVEL_LENGTH) {
+      return 0;
+    }
+    if(length > 1 && (memchr(level, '+', length) || memchr(level, '#', length))) {
+      /* Wildcards take a whole level */
+      return 0;
+    }
+    if(level[length] == '\0') {
+      return 1;
+    }
+    if(level[0] == '#' && length == 1) {
+      /* '#' is the last level */
+      return 0;
+    }
+    level += length + 1;
+  }
+}
+/*---------------------------------------------------------------------------*/
+mqtt_status_t
+mqtt_topic_register(struct mqtt_connection *conn,
+                    struct mqtt_topic_filter *filter,
+                    const char *topic, mqtt_topic_callback_t callback)
+{
+  struct mqtt_topic_node **np = &conn->topics;
+  struct mqtt_topic_node *node = NULL;
+  const char *level = topic;
+  uint8_t length;
+
+  if(filter == NULL || callback == NULL || topic == NULL
+     || !topic_valid(topic)) {
+    return MQTT_STATUS_INVALID_ARGS_ERROR;
+  }
+
+  while(1) {
+    length = topic_level_length(level);
+    node = topic_find(*np, level, length);
+    if(node == NULL) {
+      node = memb_alloc(&topic_memb);
+      if(node == NULL) {
+        /* Free the nodes added so far */
+        filter->next = NULL;
+        topic_unlink(&conn->topics, topic, filter);
+        return MQTT_STATUS_ERROR;
+      }
+      memset(node, 0, sizeof(*node));
+      memcpy(node->level, level, length);
+      node->level_length = length;
+      node->sibling = *np;
+      *np = node;
+    }
+    if(level[length] == '\0') {
+      break;
+    }
+    np = &node->child;
+    level += length + 1;
+  }
+
+  filter->callback = callback;
+  filter->next = node->filters;
+  node->filters = filter;
+  return MQTT_STATUS_OK;
+}
+/*---------------------------------------------------------------------------*/
+void
+mqtt_topic_unregister(struct mqtt_connection *conn,
+                      struct mqtt_topic_filter *filter, const char *topic)
+{
+  topic_unlink(&conn->topics, topic, filter);
+}
+#endif /* MQTT_TOPIC_NODES > 0 */
+/*---------------------------------------------------------------------------*/
 static void
 handle_publish(struct mqtt_connection *conn)
 {
@@ -839,6 +1355,12 @@ handle_publish(struct mqtt_connection *conn)
     PRINTF("MQTT - Error, got incoming PUBLISH with QoS > 0, not supported atm!\n");
   }
 
+#if MQTT_TOPIC_NODES > 0
+  if(topic_dispatch(conn, conn->topics, conn->in_publish_msg.topic, 1,
+                    &conn->in_publish_msg)) {
+    process_post(conn->app_process, mqtt_update_event, NULL);
+  } else
+#endif
   call_event(conn, MQTT_EVENT_PUBLISH, &conn->in_publish_msg);
 
   if(conn->in_publish_msg.first_chunk == 1) {
@@ -900,6 +1422,8 @@ parse_publish_vhdr(struct mqtt_connection *conn,
       conn->in_publish_msg.payload_length =
         conn->in_packet.remaining_length - conn->in_packet.topic_len - 2;
       conn->in_publish_msg.payload_left = conn->in_publish_msg.payload_length;
+      conn->in_publish_msg.payload_chunk = conn->in_packet.payload;
+      conn->in_publish_msg.payload_chunk_length = 0;
     }
 
     /* Set this once per incomming publish message */
@@ -978,9 +1502,8 @@ tcp_input(struct tcp_socket *s,
 
     PRINTF("MQTT - Error, unsupported payload size for non-PUBLISH message\n");
 
-    conn->in_packet.byte_counter += input_data_len;
-    if(conn->in_packet.byte_counter >=
-       (MQTT_FHDR_SIZE + conn->in_packet.remaining_length)) {
+    conn->in_packet.byte_counter += input_data_len - pos;
+    if(conn->in_packet.byte_counter >= IN_PACKET_LENGTH(conn)) {
       conn->in_packet.packet_received = 1;
     }
     return 0;
@@ -992,12 +1515,37 @@ tcp_input(struct tcp_socket *s,
    * Note: There will always be at least one byte left to read when we enter
    *       this loop.
    */
-  while(conn->in_packet.byte_counter <
-        (MQTT_FHDR_SIZE + conn->in_packet.remaining_length)) {
+  while(conn->in_packet.byte_counter < IN_PACKET_LENGTH(conn)) {
+
+    if((conn->in_packet.fhdr & 0xF0) == MQTT_FHDR_MSG_TYPE_PUBLISH) {
+      if(conn->in_packet.topic_received == 0) {
+        parse_publish_vhdr(conn, &pos, input_data_ptr, input_data_len);
+      }
+
+      if(conn->in_packet.topic_received == 1) {
+        /* Hand the payload over without copying it. The last chunk is
+         * handled below, once the whole packet has been read. */
+        copy_bytes = MIN(input_data_len - pos,
+                         IN_PACKET_LENGTH(conn) - conn->in_packet.byte_counter);
+        conn->in_publish_msg.payload_chunk = (uint8_t *)&input_data_ptr[pos];
+        conn->in_publish_msg.payload_chunk_length = copy_bytes;
+        conn->in_publish_msg.payload_left -= copy_bytes;
+        conn->in_packet.byte_counter += copy_bytes;
+        pos += copy_bytes;
+
+        if(conn->in_packet.byte_counter < IN_PACKET_LENGTH(conn)) {
+          if(copy_bytes > 0) {
+            handle_publish(conn);
+          }
+          return 0;
+        }
+      }
 
-    if((conn->in_packet.fhdr & 0xF0) == MQTT_FHDR_MSG_TYPE_PUBLISH &&
-       conn->in_packet.topic_received == 0) {
-      parse_publish_vhdr(conn, &pos, input_data_ptr, input_data_len);
+      if(pos >= input_data_len &&
+         (conn->in_packet.byte_counter < IN_PACKET_LENGTH(conn))) {
+        return 0;
+      }
+      continue;
     }
 
     /* Read in as much as we can into the packet payload */
@@ -1018,20 +1566,8 @@ tcp_input(struct tcp_socket *s,
     }
     DBG("\n");
 
-    /* Full buffer, shall only happen to PUBLISH messages. */
-    if(MQTT_INPUT_BUFF_SIZE - conn->in_packet.payload_pos == 0) {
-      conn->in_publish_msg.payload_chunk = conn->in_packet.payload;
-      conn->in_publish_msg.payload_chunk_length = MQTT_INPUT_BUFF_SIZE;
-      conn->in_publish_msg.payload_left -= MQTT_INPUT_BUFF_SIZE;
-
-      handle_publish(conn);
-
-      conn->in_publish_msg.payload_chunk = conn->in_packet.payload;
-      conn->in_packet.payload_pos = 0;
-    }
-
     if(pos >= input_data_len &&
-       (conn->in_packet.byte_counter < (MQTT_FHDR_SIZE + conn->in_packet.remaining_length))) {
+       (conn->in_packet.byte_counter < IN_PACKET_LENGTH(conn))) {
       return 0;
     }
   }
@@ -1042,7 +1578,7 @@ tcp_input(struct tcp_socket *s,
   DBG("MQTT - Finished reading packet!\n");
   /* What to return? */
   DBG("MQTT - total data was %i bytes of data. \n",
-      (MQTT_FHDR_SIZE + conn->in_packet.remaining_length));
+      IN_PACKET_LENGTH(conn));
 
   /* Handle packet here. */
   switch(conn->in_packet.fhdr & 0xF0) {
@@ -1051,9 +1587,6 @@ tcp_input(struct tcp_socket *s,
     break;
   case MQTT_FHDR_MSG_TYPE_PUBLISH:
     /* This is the only or the last chunk of publish payload */
-    conn->in_publish_msg.payload_chunk = conn->in_packet.payload;
-    conn->in_publish_msg.payload_chunk_length = conn->in_packet.payload_pos;
-    conn->in_publish_msg.payload_left = 0;
     handle_publish(conn);
     break;
   case MQTT_FHDR_MSG_TYPE_PUBACK:
@@ -1131,6 +1664,9 @@ tcp_event(struct tcp_socket *s, void *ptr, tcp_socket_event_t event)
     if(conn->socket.output_data_len == 0) {
       conn->out_buffer_sent = 1;
       conn->out_buffer_ptr = conn->out_buffer;
+#if MQTT_INFLIGHT_WINDOW > 1
+      inflight_send(conn);
+#endif
     }
 
     ctimer_restart(&conn->keep_alive_timer);
@@ -1221,6 +1757,9 @@ PROCESS_THREAD(mqtt_process, ev, data)
               conn->state == MQTT_CONN_STATE_CONNECTED_TO_BROKER) {
           PT_MQTT_WAIT_SEND();
         }
+#if MQTT_INFLIGHT_WINDOW > 1
+        inflight_send(conn);
+#endif
       }
     }
     if(ev == mqtt_do_unsubscribe_event) {
@@ -1234,6 +1773,9 @@ PROCESS_THREAD(mqtt_process, ev, data)
               conn->state == MQTT_CONN_STATE_CONNECTED_TO_BROKER) {
           PT_MQTT_WAIT_SEND();
         }
+#if MQTT_INFLIGHT_WINDOW > 1
+        inflight_send(conn);
+#endif
       }
     }
     if(ev == mqtt_do_publish_event) {
@@ -1247,6 +1789,9 @@ PROCESS_THREAD(mqtt_process, ev, data)
               conn->state == MQTT_CONN_STATE_CONNECTED_TO_BROKER) {
           PT_MQTT_WAIT_SEND();
         }
+#if MQTT_INFLIGHT_WINDOW > 1
+        inflight_sent(conn);
+#endif
       }
     }
   }
@@ -1274,6 +1819,12 @@ mqtt_init(void)
     mqtt_continue_send_event = process_alloc_event();
 
     list_init(mqtt_conn_list);
+#if MQTT_INFLIGHT_WINDOW > 1
+    memb_init(&inflight_memb);
+#endif
+#if MQTT_TOPIC_NODES > 0
+    memb_init(&topic_memb);
+#endif
     process_start(&mqtt_process, NULL);
     inited = 1;
   }
@@ -1298,6 +1849,10 @@ mqtt_register(struct mqtt_connection *conn, struct process *app_process,
   reset_defaults(conn);
 
   mqtt_init();
+#if MQTT_INFLIGHT_WINDOW > 1
+  LIST_STRUCT_INIT(conn, inflight);
+  inflight_load(conn);
+#endif
   list_add(mqtt_conn_list, conn);
 
   DBG("MQTT - Registered successfully\n");
@@ -1410,10 +1965,11 @@ mqtt_unsubscribe(struct mqtt_connection *conn, uint16_t *mid, char *topic)
   return MQTT_STATUS_OK;
 }
 /*----------------------------------------------------------------------------*/
-mqtt_status_t
-mqtt_publish(struct mqtt_connection *conn, uint16_t *mid, char *topic,
-             uint8_t *payload, uint32_t payload_size,
-             mqtt_qos_level_t qos_level, mqtt_retain_t retain)
+static mqtt_status_t
+queue_publish(struct mqtt_connection *conn, uint16_t *mid, char *topic,
+              uint8_t *payload, mqtt_payload_reader_t reader, void *ptr,
+              uint32_t payload_size, mqtt_qos_level_t qos_level,
+              mqtt_retain_t retain)
 {
   if(conn->state != MQTT_CONN_STATE_CONNECTED_TO_BROKER) {
     return MQTT_STATUS_NOT_CONNECTED_ERROR;
@@ -1421,6 +1977,14 @@ mqtt_publish(struct mqtt_connection *conn, uint16_t *mid, char *topic,
 
   DBG("MQTT - Call to mqtt_publish...\n");
 
+#if MQTT_INFLIGHT_WINDOW > 1
+  if(qos_level == MQTT_QOS_LEVEL_1 && reader == NULL &&
+     payload_size <= MQTT_INFLIGHT_PAYLOAD_SIZE &&
+     strlen(topic) <= MQTT_MAX_TOPIC_LENGTH) {
+    return inflight_add(conn, topic, payload, payload_size, retain, mid);
+  }
+#endif
+
   /* Currently don't have a queue, so only one item at a time */
   if(conn->out_queue_full) {
     DBG("MQTT - Not accepted!\n");
@@ -1430,18 +1994,47 @@ mqtt_publish(struct mqtt_connection *conn, uint16_t *mid, char *topic,
   DBG("MQTT - Accepted!\n");
 
   conn->out_packet.mid = INCREMENT_MID(conn);
+  if(mid != NULL) {
+    *mid = conn->out_packet.mid;
+  }
   conn->out_packet.retain = retain;
   conn->out_packet.topic = topic;
   conn->out_packet.topic_length = strlen(topic);
   conn->out_packet.payload = payload;
   conn->out_packet.payload_size = payload_size;
+  conn->out_packet.payload_reader = reader;
+  conn->out_packet.payload_reader_ptr = ptr;
   conn->out_packet.qos = qos_level;
   conn->out_packet.qos_state = MQTT_QOS_STATE_NO_ACK;
+  conn->out_packet.dup = 0;
+  conn->out_packet.pipelined = 0;
 
   process_post(&mqtt_process, mqtt_do_publish_event, conn);
   return MQTT_STATUS_OK;
 }
 /*----------------------------------------------------------------------------*/
+mqtt_status_t
+mqtt_publish(struct mqtt_connection *conn, uint16_t *mid, char *topic,
+             uint8_t *payload, uint32_t payload_size,
+             mqtt_qos_level_t qos_level, mqtt_retain_t retain)
+{
+  return queue_publish(conn, mid, topic, payload, NULL, NULL, payload_size,
+                       qos_level, retain);
+}
+/*----------------------------------------------------------------------------*/
+mqtt_status_t
+mqtt_publish_stream(struct mqtt_connection *conn, uint16_t *mid, char *topic,
+                    uint32_t payload_size, mqtt_payload_reader_t reader,
+                    void *ptr, mqtt_qos_level_t qos_level,
+                    mqtt_retain_t retain)
+{
+  if(reader == NULL) {
+    return MQTT_STATUS_INVALID_ARGS_ERROR;
+  }
+  return queue_publish(conn, mid, topic, NULL, reader, ptr, payload_size,
+                       qos_level, retain);
+}
+/*----------------------------------------------------------------------------*/
 void
 mqtt_set_username_password(struct mqtt_connection *conn, char *username,
                            char *password)
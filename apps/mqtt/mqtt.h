@@ -108,7 +108,11 @@
 #define MQTT_TCP_INPUT_BUFF_SIZE 512
 #define MQTT_TCP_OUTPUT_BUFF_SIZE 512
 
-#define MQTT_INPUT_BUFF_SIZE 512
+/*
+ * Holds the variable header of incoming packets other than PUBLISH. PUBLISH
+ * payloads are handed to the application straight from the TCP input buffer.
+ */
+#define MQTT_INPUT_BUFF_SIZE 16
 #define MQTT_MAX_TOPIC_LENGTH 64
 #define MQTT_MAX_TOPICS_PER_SUBSCRIBE 1
 
@@ -117,6 +121,55 @@
 #define MQTT_PROTOCOL_VERSION 3
 #define MQTT_PROTOCOL_NAME "MQIsdp"
 #define MQTT_TOPIC_MAX_LENGTH 128
+
+/*
+ * Number of QoS 1 PUBLISH messages that may be waiting for their PUBACK at
+ * the same time, shared by all connections. With 1, a QoS 1 PUBLISH blocks
+ * the connection until its PUBACK comes back. With more, messages whose
+ * payload fits in MQTT_INFLIGHT_PAYLOAD_SIZE bytes are copied to a resend
+ * queue and sent back to back; they are sent again, with the DUP flag, if
+ * no PUBACK came in time or after a reconnection.
+ */
+#ifdef MQTT_CONF_INFLIGHT_WINDOW
+#define MQTT_INFLIGHT_WINDOW MQTT_CONF_INFLIGHT_WINDOW
+#else
+#define MQTT_INFLIGHT_WINDOW 1
+#endif
+
+#ifdef MQTT_CONF_INFLIGHT_PAYLOAD_SIZE
+#define MQTT_INFLIGHT_PAYLOAD_SIZE MQTT_CONF_INFLIGHT_PAYLOAD_SIZE
+#else
+#define MQTT_INFLIGHT_PAYLOAD_SIZE 64
+#endif
+
+/*
+ * Keep the resend queue in a CFS file named after the client ID, so that
+ * messages not acknowledged yet survive a reboot. The file is rewritten
+ * whenever the queue changes.
+ */
+#ifdef MQTT_CONF_INFLIGHT_PERSIST
+#define MQTT_INFLIGHT_PERSIST MQTT_CONF_INFLIGHT_PERSIST
+#else
+#define MQTT_INFLIGHT_PERSIST 0
+#endif
+
+/*
+ * Topic filter nodes shared by all connections, one per distinct level of
+ * the filters registered with mqtt_topic_register(). 0 disables the topic
+ * filter registry: every PUBLISH goes to the event callback.
+ */
+#ifdef MQTT_CONF_TOPIC_NODES
+#define MQTT_TOPIC_NODES MQTT_CONF_TOPIC_NODES
+#else
+#define MQTT_TOPIC_NODES 0
+#endif
+
+/* Longest level of a registered topic filter */
+#ifdef MQTT_CONF_TOPIC_LEVEL_LENGTH
+#define MQTT_TOPIC_LEVEL_LENGTH MQTT_CONF_TOPIC_LEVEL_LENGTH
+#else
+#define MQTT_TOPIC_LEVEL_LENGTH 16
+#endif
 /*---------------------------------------------------------------------------*/
 /*
  * Debug configuration, this is similar but not exactly like the Debugging
@@ -224,7 +277,14 @@ struct mqtt_suback_event {
   mqtt_qos_level_t qos_level;
 };
 
-/* This is the MQTT message that is exposed to the end user. */
+/*
+ * This is the MQTT message that is exposed to the end user.
+ *
+ * Incoming PUBLISH payloads are streamed: MQTT_EVENT_PUBLISH is raised for
+ * each chunk as it arrives, first_chunk set on the first one and payload_left
+ * reaching 0 on the last one. payload_chunk points into the TCP input buffer
+ * and is only valid during the event callback.
+ */
 struct mqtt_message {
   uint32_t mid;
   char topic[MQTT_MAX_TOPIC_LENGTH + 1]; /* +1 for string termination */
@@ -233,8 +293,8 @@ struct mqtt_message {
   uint16_t payload_chunk_length;
 
   uint8_t first_chunk;
-  uint16_t payload_length;
-  uint16_t payload_left;
+  uint32_t payload_length;
+  uint32_t payload_left;
 };
 
 /* This struct represents a packet received from the MQTT server. */
@@ -248,11 +308,11 @@ struct mqtt_in_packet {
   uint8_t packet_received;
 
   uint8_t fhdr;
-  uint16_t remaining_length;
+  uint32_t remaining_length;
   uint16_t mid;
 
   /* Helper variables needed to decode the remaining_length */
-  uint8_t remaining_multiplier;
+  uint32_t remaining_multiplier;
   uint8_t has_remaining_length;
   uint8_t remaining_length_bytes;
 
@@ -269,6 +329,25 @@ struct mqtt_in_packet {
   uint8_t topic_received;
 };
 
+/**
+ * \brief           Payload source of a streamed PUBLISH
+ * \param m         A pointer to the MQTT connection
+ * \param ptr       The pointer passed to mqtt_publish_stream()
+ * \param offset    Offset of the requested bytes within the payload
+ * \param buf       Where to write the bytes, in the TCP output buffer
+ * \param len       Number of bytes requested, at least 1
+ * \return          Number of bytes written to buf, between 1 and len
+ *
+ * Called by the MQTT engine each time there is room in the TCP output buffer,
+ * until the whole payload has been written. Returning 0 aborts the
+ * connection, since the PUBLISH cannot be completed.
+ */
+typedef uint16_t (*mqtt_payload_reader_t)(struct mqtt_connection *m,
+                                          void *ptr,
+                                          uint32_t offset,
+                                          uint8_t *buf,
+                                          uint16_t len);
+
 /* This struct represents a packet sent to the MQTT server. */
 struct mqtt_out_packet {
   uint8_t fhdr;
@@ -280,9 +359,14 @@ struct mqtt_out_packet {
   uint16_t topic_length;
   uint8_t *payload;
   uint32_t payload_size;
+  mqtt_payload_reader_t payload_reader;
+  void *payload_reader_ptr;
   mqtt_qos_level_t qos;
   mqtt_qos_state_t qos_state;
   mqtt_retain_t retain;
+  uint8_t dup;
+  /* Sent from the resend queue, no need to wait for the PUBACK */
+  uint8_t pipelined;
 };
 /*---------------------------------------------------------------------------*/
 /**
@@ -301,6 +385,28 @@ typedef void (*mqtt_event_callback_t)(struct mqtt_connection *m,
 
 typedef void (*mqtt_topic_callback_t)(struct mqtt_connection *m,
                                       struct mqtt_message *msg);
+
+/*
+ * A topic filter registered with mqtt_topic_register(). Its callback gets
+ * each chunk of the PUBLISH messages matching the filter.
+ */
+struct mqtt_topic_filter {
+  /* The next filter ending at the same node */
+  struct mqtt_topic_filter *next;
+  mqtt_topic_callback_t callback;
+};
+
+/*
+ * The registered filters make a trie with a node per topic level, so that
+ * matching a topic costs one lookup among siblings per level.
+ */
+struct mqtt_topic_node {
+  struct mqtt_topic_node *sibling;
+  struct mqtt_topic_node *child;
+  struct mqtt_topic_filter *filters;
+  uint8_t level_length;
+  char level[MQTT_TOPIC_LEVEL_LENGTH];
+};
 /*---------------------------------------------------------------------------*/
 struct mqtt_will {
   struct mqtt_string topic;
@@ -354,6 +460,17 @@ struct mqtt_connection {
   struct mqtt_in_packet in_packet;
   struct mqtt_message in_publish_msg;
 
+#if MQTT_INFLIGHT_WINDOW > 1
+  /* QoS 1 PUBLISH messages waiting for their PUBACK */
+  LIST_STRUCT(inflight);
+  struct ctimer inflight_timer;
+#endif
+
+#if MQTT_TOPIC_NODES > 0
+  /* First level of the registered topic filters */
+  struct mqtt_topic_node *topics;
+#endif
+
   /* TCP related information */
   char *server_host;
   uip_ipaddr_t server_ip;
@@ -450,7 +567,13 @@ mqtt_status_t mqtt_unsubscribe(struct mqtt_connection *conn,
  *        subscriptions match its topic name
  * \return MQTT_STATUS_OK or some error status
  *
- * This function publishes to a topic on a MQTT broker.
+ * This function publishes to a topic on a MQTT broker. If mid is not NULL, it
+ * is set to the message ID, which MQTT_EVENT_PUBACK reports for QoS 1.
+ *
+ * With an in-flight window (see MQTT_INFLIGHT_WINDOW), a small QoS 1 message
+ * is copied and the call returns MQTT_STATUS_OUT_QUEUE_FULL only when the
+ * window is full; otherwise the payload must stay valid until the message
+ * has been sent.
  */
 mqtt_status_t mqtt_publish(struct mqtt_connection *conn,
                            uint16_t *mid,
@@ -460,6 +583,31 @@ mqtt_status_t mqtt_publish(struct mqtt_connection *conn,
                            mqtt_qos_level_t qos_level,
                            mqtt_retain_t retain);
 /*---------------------------------------------------------------------------*/
+/**
+ * \brief Publish to a MQTT topic, pulling the payload from a callback.
+ * \param conn A pointer to the MQTT connection.
+ * \param mid A pointer to message ID.
+ * \param topic A pointer to the topic to publish to.
+ * \param payload_size Payload size.
+ * \param reader Called to write the payload into the TCP output buffer.
+ * \param ptr A user-defined pointer passed to the reader.
+ * \param qos_level Quality Of Service level to use. Currently supports 0, 1.
+ * \param retain See mqtt_publish().
+ * \return MQTT_STATUS_OK or some error status
+ *
+ * Unlike mqtt_publish(), the payload does not have to be in RAM all at once
+ * and may be larger than the TCP output buffer: the reader produces it piece
+ * by piece, in place, as the buffer is sent out.
+ */
+mqtt_status_t mqtt_publish_stream(struct mqtt_connection *conn,
+                                  uint16_t *mid,
+                                  char *topic,
+                                  uint32_t payload_size,
+                                  mqtt_payload_reader_t reader,
+                                  void *ptr,
+                                  mqtt_qos_level_t qos_level,
+                                  mqtt_retain_t retain);
+/*---------------------------------------------------------------------------*/
 /**
  * \brief Set the user name and password for a MQTT client.
  * \param conn A pointer to the MQTT connection.
@@ -495,6 +643,38 @@ void mqtt_set_last_will(struct mqtt_connection *conn,
                         char *message,
                         mqtt_qos_level_t qos);
 
+/*---------------------------------------------------------------------------*/
+#if MQTT_TOPIC_NODES > 0
+/**
+ * \brief Registers a callback for the messages matching a topic filter.
+ * \param conn A pointer to the MQTT connection.
+ * \param filter A pointer to the filter, kept until unregistered.
+ * \param topic The topic filter, which may contain + and # wildcards.
+ * \param callback The function called for each chunk of a matching PUBLISH.
+ * \return MQTT_STATUS_OK, MQTT_STATUS_INVALID_ARGS_ERROR for a malformed
+ *         filter or MQTT_STATUS_ERROR when out of topic nodes
+ *
+ * A matching PUBLISH goes to the callbacks of all its matching filters
+ * instead of raising MQTT_EVENT_PUBLISH, which is kept for those matching
+ * none. This does not subscribe to the topic, see mqtt_subscribe(). The
+ * topic string can be discarded on return.
+ */
+mqtt_status_t mqtt_topic_register(struct mqtt_connection *conn,
+                                  struct mqtt_topic_filter *filter,
+                                  const char *topic,
+                                  mqtt_topic_callback_t callback);
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Unregisters a topic filter.
+ * \param conn A pointer to the MQTT connection.
+ * \param filter A pointer to the filter.
+ * \param topic The topic filter it was registered with.
+ */
+void mqtt_topic_unregister(struct mqtt_connection *conn,
+                           struct mqtt_topic_filter *filter,
+                           const char *topic);
+#endif /* MQTT_TOPIC_NODES > 0 */
+
 #define mqtt_connected(conn) \
   ((conn)->state == MQTT_CONN_STATE_CONNECTED_TO_BROKER ? 1 : 0)
 
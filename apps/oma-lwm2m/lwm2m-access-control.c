@@ -0,0 +1,409 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \addtogroup oma-lwm2m
+ * @{
+ */
+
+/**
+ * \file
+ *         Implementation of the Contiki OMA LWM2M Access Control object
+ *
+ *         Each instance grants servers access to one object instance,
+ *         or to Create in an object, with the ACL resource as a list
+ *         of short server id and access right bits. Instead of finding
+ *         the instance for every request, the lists are compiled into
+ *         a hash table of (object, instance) entries that hold the
+ *         access rights of each registration server.
+ */
+
+#include "lwm2m-object.h"
+#include "lwm2m-engine.h"
+#include "lwm2m-access-control.h"
+#include "oma-tlv.h"
+#include "oma-tlv-reader.h"
+#include "oma-tlv-writer.h"
+#include <string.h>
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+#ifdef LWM2M_CONF_ACCESS_CONTROL_MAX_COUNT
+#define MAX_COUNT LWM2M_CONF_ACCESS_CONTROL_MAX_COUNT
+#else
+#define MAX_COUNT 4
+#endif
+
+/* Entries of the ACL resource of each instance */
+#ifdef LWM2M_CONF_ACCESS_CONTROL_MAX_ACL
+#define MAX_ACL LWM2M_CONF_ACCESS_CONTROL_MAX_ACL
+#else
+#define MAX_ACL (LWM2M_ENGINE_MAX_SERVERS + 1)
+#endif
+
+#define MAX_SERVERS LWM2M_ENGINE_MAX_SERVERS
+
+#define ACL_RES_OBJECT_ID       0
+#define ACL_RES_OBJECT_INSTANCE 1
+#define ACL_RES_ACL             2
+#define ACL_RES_OWNER           3
+
+typedef struct {
+  uint16_t short_server_id; /* 0 for the default access rights */
+  uint8_t access;
+} acl_entry_t;
+
+static int32_t object_id_arr[MAX_COUNT];
+static int32_t instance_id_arr[MAX_COUNT];
+static int32_t owner_arr[MAX_COUNT];
+static acl_entry_t acl_arr[MAX_COUNT][MAX_ACL];
+static uint8_t acl_count[MAX_COUNT];
+static lwm2m_instance_t acl_instances[MAX_COUNT];
+
+/*
+ * The compiled access rights: one entry for the target of each
+ * instance, one for each instance itself, one for the Access Control
+ * object, and one for the Server object instance of each server. The
+ * hash table is kept less than half full.
+ */
+#define MAX_ENTRIES (2 * MAX_COUNT + 1 + MAX_SERVERS)
+#define SLOTS       (2 * MAX_ENTRIES + 1)
+
+typedef struct {
+  uint16_t object_id;
+  uint16_t instance_id;
+  uint8_t access[MAX_SERVERS];
+} permission_t;
+
+static permission_t permissions[MAX_ENTRIES];
+/* Index + 1 of the entry in each slot, 0 if the slot is free */
+static uint8_t slots[SLOTS];
+static uint8_t permission_count;
+static uint8_t server_count;
+/*---------------------------------------------------------------------------*/
+static int
+read_acl(lwm2m_context_t *ctx, uint8_t *outbuf, size_t outsize)
+{
+  uint8_t values[MAX_ACL * 4];
+  const acl_entry_t *acl = acl_arr[ctx->object_instance_index];
+  oma_tlv_t tlv;
+  size_t len = 0;
+  size_t n;
+  int i;
+
+  if(ctx->writer != &oma_tlv_writer) {
+    /* A multiple resource can only be read as TLV */
+    return 0;
+  }
+
+  tlv.type = OMA_TLV_TYPE_RESOURCE_INSTANCE;
+  tlv.length = 1;
+  for(i = 0; i < acl_count[ctx->object_instance_index]; i++) {
+    tlv.id = acl[i].short_server_id;
+    tlv.value = &acl[i].access;
+    n = oma_tlv_write(&tlv, &values[len], sizeof(values) - len);
+    if(n == 0) {
+      return 0;
+    }
+    len += n;
+  }
+
+  tlv.type = OMA_TLV_TYPE_MULTI_RESOURCE;
+  tlv.id = ctx->resource_id;
+  tlv.length = len;
+  tlv.value = values;
+  return oma_tlv_write(&tlv, outbuf, outsize);
+}
+/*---------------------------------------------------------------------------*/
+static int
+set_access(int index, uint16_t short_server_id, uint8_t access)
+{
+  acl_entry_t *acl = acl_arr[index];
+  int i;
+
+  for(i = 0; i < acl_count[index]; i++) {
+    if(acl[i].short_server_id == short_server_id) {
+      acl[i].access = access;
+      return 1;
+    }
+  }
+  if(acl_count[index] >= MAX_ACL) {
+    PRINTF("lwm2m-acl: no room for server %u\n", short_server_id);
+    return 0;
+  }
+  acl[i].short_server_id = short_server_id;
+  acl[i].access = access;
+  acl_count[index]++;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+write_acl(lwm2m_context_t *ctx, const uint8_t *inbuf, size_t insize,
+          uint8_t *outbuf, size_t outsize)
+{
+  int32_t value;
+  size_t len;
+
+  if(ctx->reader != &oma_tlv_reader) {
+    /* The short server id is the id of the TLV resource instance */
+    return 0;
+  }
+  len = ctx->reader->read_int(ctx, inbuf, insize, &value);
+  if(len == 0 || value < 0 || value > LWM2M_ACCESS_CONTROL_ALL ||
+     !set_access(ctx->object_instance_index, ctx->resource_instance_id,
+                 value)) {
+    return 0;
+  }
+  return len;
+}
+/*---------------------------------------------------------------------------*/
+LWM2M_RESOURCES(acl_resources,
+                LWM2M_RESOURCE_INTEGER_VAR_ARR(ACL_RES_OBJECT_ID, MAX_COUNT,
+                                               object_id_arr),
+                LWM2M_RESOURCE_INTEGER_VAR_ARR(ACL_RES_OBJECT_INSTANCE,
+                                               MAX_COUNT, instance_id_arr),
+                LWM2M_RESOURCE_CALLBACK(ACL_RES_ACL,
+                                        { read_acl, write_acl, NULL }),
+                LWM2M_RESOURCE_INTEGER_VAR_ARR(ACL_RES_OWNER, MAX_COUNT,
+                                               owner_arr),
+                );
+LWM2M_OBJECT(access_control, LWM2M_OBJECT_ACCESS_CONTROL_ID, acl_instances);
+/*---------------------------------------------------------------------------*/
+static int
+get_slot(uint16_t object_id, uint16_t instance_id)
+{
+  return ((uint32_t)object_id * 31 + instance_id) % SLOTS;
+}
+/*---------------------------------------------------------------------------*/
+static permission_t *
+find_permission(uint16_t object_id, uint16_t instance_id, int *slot)
+{
+  permission_t *p;
+  int i;
+
+  for(i = get_slot(object_id, instance_id); slots[i] != 0;
+      i = (i + 1) % SLOTS) {
+    p = &permissions[slots[i] - 1];
+    if(p->object_id == object_id && p->instance_id == instance_id) {
+      return p;
+    }
+  }
+  if(slot != NULL) {
+    *slot = i;
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static permission_t *
+add_permission(uint16_t object_id, uint16_t instance_id)
+{
+  permission_t *p;
+  int slot;
+
+  p = find_permission(object_id, instance_id, &slot);
+  if(p == NULL && permission_count < MAX_ENTRIES) {
+    p = &permissions[permission_count++];
+    memset(p, 0, sizeof(permission_t));
+    p->object_id = object_id;
+    p->instance_id = instance_id;
+    slots[slot] = permission_count;
+  }
+  return p;
+}
+/*---------------------------------------------------------------------------*/
+/* The access rights of a server given by an instance */
+static uint8_t
+get_access(int index, int32_t short_server_id)
+{
+  const acl_entry_t *acl = acl_arr[index];
+  int i, def = -1;
+
+  for(i = 0; i < acl_count[index]; i++) {
+    if(acl[i].short_server_id == short_server_id) {
+      return acl[i].access;
+    }
+    if(acl[i].short_server_id == 0) {
+      def = i;
+    }
+  }
+  if(def >= 0) {
+    return acl[def].access;
+  }
+  /* The owner has full access unless its rights are in the list */
+  return owner_arr[index] == short_server_id ? LWM2M_ACCESS_CONTROL_ALL : 0;
+}
+/*---------------------------------------------------------------------------*/
+static int32_t
+get_short_server_id(int index)
+{
+  const lwm2m_resource_t *resource;
+  lwm2m_context_t context;
+  int32_t value;
+
+  memset(&context, 0, sizeof(context));
+  context.object_id = LWM2M_OBJECT_SERVER_ID;
+  context.object_instance_id = index;
+  context.resource_id = LWM2M_SERVER_SHORT_SERVER_ID;
+  resource = lwm2m_engine_get_resource(&context);
+  if(resource != NULL && lwm2m_object_is_resource_int(resource) &&
+     lwm2m_object_get_resource_int(resource, &context, &value)) {
+    return value;
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+lwm2m_access_control_update(void)
+{
+  int32_t short_server_ids[MAX_SERVERS];
+  permission_t *target;
+  permission_t *self;
+  int i, s;
+
+  server_count = 0;
+  for(s = 0; s < MAX_SERVERS; s++) {
+    short_server_ids[s] = get_short_server_id(s);
+    if(short_server_ids[s] > 0) {
+      server_count++;
+    }
+  }
+
+  memset(slots, 0, sizeof(slots));
+  permission_count = 0;
+  for(i = 0; i < MAX_COUNT; i++) {
+    if((acl_instances[i].flag & LWM2M_INSTANCE_FLAG_USED) == 0) {
+      continue;
+    }
+    target = add_permission(object_id_arr[i], instance_id_arr[i]);
+    self = add_permission(LWM2M_OBJECT_ACCESS_CONTROL_ID,
+                          acl_instances[i].id);
+    for(s = 0; s < MAX_SERVERS; s++) {
+      if(short_server_ids[s] <= 0) {
+        continue;
+      }
+      if(target != NULL) {
+        target->access[s] |= get_access(i, short_server_ids[s]);
+      }
+      if(self != NULL) {
+        /* Only the owner may change an Access Control instance */
+        self->access[s] |= owner_arr[i] == short_server_ids[s] ?
+          (LWM2M_ACCESS_CONTROL_READ | LWM2M_ACCESS_CONTROL_WRITE |
+           LWM2M_ACCESS_CONTROL_DELETE) : LWM2M_ACCESS_CONTROL_READ;
+      }
+    }
+  }
+  if(permission_count > 0) {
+    self = add_permission(LWM2M_OBJECT_ACCESS_CONTROL_ID,
+                          LWM2M_ACCESS_CONTROL_OBJECT);
+    if(self != NULL) {
+      memset(self->access, LWM2M_ACCESS_CONTROL_READ, sizeof(self->access));
+    }
+    for(s = 0; s < MAX_SERVERS; s++) {
+      /* A server has full access to its own Server object instance */
+      self = add_permission(LWM2M_OBJECT_SERVER_ID, s);
+      if(self != NULL && short_server_ids[s] > 0) {
+        self->access[s] |= LWM2M_ACCESS_CONTROL_ALL &
+          ~LWM2M_ACCESS_CONTROL_CREATE;
+      }
+    }
+  }
+  PRINTF("lwm2m-acl: %u entries for %u servers\n", permission_count,
+         server_count);
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+lwm2m_access_control_get(int index, uint16_t object_id, uint16_t instance_id)
+{
+  const permission_t *p;
+
+  if(server_count < 2 || permission_count == 0) {
+    /* Access control is only used with several servers */
+    return LWM2M_ACCESS_CONTROL_ALL;
+  }
+  if(index < 0 || index >= MAX_SERVERS) {
+    return 0;
+  }
+  p = find_permission(object_id, instance_id, NULL);
+  return p != NULL ? p->access[index] : 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+lwm2m_access_control_add(uint16_t object_id, uint16_t instance_id,
+                         uint16_t owner)
+{
+  int i;
+
+  for(i = 0; i < MAX_COUNT; i++) {
+    if((acl_instances[i].flag & LWM2M_INSTANCE_FLAG_USED) == 0) {
+      object_id_arr[i] = object_id;
+      instance_id_arr[i] = instance_id;
+      owner_arr[i] = owner;
+      acl_count[i] = 0;
+      acl_instances[i].flag |= LWM2M_INSTANCE_FLAG_USED;
+      lwm2m_access_control_update();
+      return i;
+    }
+  }
+  return -1;
+}
+/*---------------------------------------------------------------------------*/
+int
+lwm2m_access_control_set(int index, uint16_t short_server_id, uint8_t access)
+{
+  if(index < 0 || index >= MAX_COUNT ||
+     !set_access(index, short_server_id, access)) {
+    return 0;
+  }
+  lwm2m_access_control_update();
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+lwm2m_access_control_init(void)
+{
+  lwm2m_instance_t template = LWM2M_INSTANCE_UNUSED(0, acl_resources);
+  int i;
+
+  for(i = 0; i < MAX_COUNT; i++) {
+    acl_instances[i] = template;
+    acl_instances[i].id = i;
+  }
+
+  PRINTF("*** Init lwm2m-access-control\n");
+  lwm2m_engine_register_object(&access_control);
+}
+/*---------------------------------------------------------------------------*/
+/** @} */
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \addtogroup oma-lwm2m
+ * @{
+ */
+
+/**
+ * \file
+ *         Header file for the Contiki OMA LWM2M Access Control object
+ *
+ *         The access control lists are compiled into a table of
+ *         permission masks per server and object instance whenever they
+ *         change, so that checking a request is a single lookup. Access
+ *         control only applies when the device has several servers and
+ *         at least one Access Control instance exists.
+ */
+
+#ifndef LWM2M_ACCESS_CONTROL_H_
+#define LWM2M_ACCESS_CONTROL_H_
+
+#include "contiki-conf.h"
+#include <stdint.h>
+
+/* The access rights of the ACL resource */
+#define LWM2M_ACCESS_CONTROL_READ    1
+#define LWM2M_ACCESS_CONTROL_WRITE   2
+#define LWM2M_ACCESS_CONTROL_EXECUTE 4
+#define LWM2M_ACCESS_CONTROL_DELETE  8
+#define LWM2M_ACCESS_CONTROL_CREATE 16
+#define LWM2M_ACCESS_CONTROL_ALL    31
+
+/* The object instance id of an Access Control instance for Create */
+#define LWM2M_ACCESS_CONTROL_OBJECT  0xffff
+
+/* Register the Access Control object */
+void lwm2m_access_control_init(void);
+
+/*
+ * Add an Access Control instance for an object instance, owned by the
+ * server with the specified short server id. Returns the index of the
+ * instance or -1 if all instances are used.
+ */
+int lwm2m_access_control_add(uint16_t object_id, uint16_t instance_id,
+                             uint16_t owner);
+
+/*
+ * Set the access rights of a server, or the default rights of servers
+ * not in the list when the short server id is 0. Returns 0 if the list
+ * of the instance is full.
+ */
+int lwm2m_access_control_set(int index, uint16_t short_server_id,
+                             uint8_t access);
+
+/*
+ * Compile the permission masks again. Called by the engine after the
+ * Access Control or Server objects were written to, and needed after
+ * changing the short server ids of the Server object locally.
+ */
+void lwm2m_access_control_update(void);
+
+/*
+ * Get the access rights of registration server number index to an
+ * object instance, or to the object itself for Create.
+ */
+uint8_t lwm2m_access_control_get(int index, uint16_t object_id,
+                                 uint16_t instance_id);
+
+#endif /* LWM2M_ACCESS_CONTROL_H_ */
+/** @} */
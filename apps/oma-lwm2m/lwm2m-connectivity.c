@@ -0,0 +1,296 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \addtogroup oma-lwm2m
+ * @{
+ */
+
+/**
+ * \file
+ *         Implementation of the Contiki OMA LWM2M connectivity monitoring
+ *         and connectivity statistics objects.
+ *
+ *         Nothing is sampled in the background: the resources are
+ *         callbacks reading RPL, link-stats, uIP, sicslowpan and
+ *         energest when a server asks for them. The statistics object
+ *         only keeps the counters seen at the start and at the end of
+ *         the collection.
+ *
+ *         The stack counts packets, not bytes, so the Tx Data and Rx
+ *         Data resources of object 7 hold the number of IP packets sent
+ *         and received (uIP statistics must be enabled).
+ */
+
+#include "lwm2m-object.h"
+#include "lwm2m-engine.h"
+#include "lwm2m-connectivity.h"
+#include "net/ip/uip.h"
+#include "net/ipv6/uip-ds6.h"
+#include "net/ipv6/sicslowpan.h"
+#include "net/link-stats.h"
+#include "sys/energest.h"
+#if UIP_CONF_IPV6_RPL
+#include "net/rpl/rpl.h"
+#endif /* UIP_CONF_IPV6_RPL */
+#include <stdio.h>
+
+#define DEBUG 0
+#if DEBUG
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+/* Longest address: eight groups of four hex digits */
+#define IPADDR_STRING_SIZE 40
+/*---------------------------------------------------------------------------*/
+static int
+write_ipaddr(lwm2m_context_t *ctx, uint8_t *outbuf, size_t outsize,
+             const uip_ipaddr_t *addr)
+{
+  char str[IPADDR_STRING_SIZE];
+  int i, len = 0;
+
+  if(addr != NULL) {
+    for(i = 0; i < 8; i++) {
+      len += snprintf(&str[len], sizeof(str) - len, i > 0 ? ":%x" : "%x",
+                      uip_ntohs(addr->u16[i]));
+    }
+  }
+  return ctx->writer->write_string(ctx, outbuf, outsize, str, len);
+}
+/*---------------------------------------------------------------------------*/
+#if UIP_CONF_IPV6_RPL
+static rpl_parent_t *
+get_parent(void)
+{
+  rpl_dag_t *dag = rpl_get_any_dag();
+  return dag != NULL ? dag->preferred_parent : NULL;
+}
+#endif /* UIP_CONF_IPV6_RPL */
+/*---------------------------------------------------------------------------*/
+static int
+read_rssi(lwm2m_context_t *ctx, uint8_t *outbuf, size_t outsize)
+{
+  return ctx->writer->write_int(ctx, outbuf, outsize,
+                                sicslowpan_get_last_rssi());
+}
+/*---------------------------------------------------------------------------*/
+/* The delivery ratio to the parent in percent, from its ETX */
+static int
+read_link_quality(lwm2m_context_t *ctx, uint8_t *outbuf, size_t outsize)
+{
+  int32_t quality = 0;
+#if UIP_CONF_IPV6_RPL
+  const struct link_stats *stats;
+  uint16_t etx;
+
+  stats = rpl_get_parent_link_stats(get_parent());
+  if(stats != NULL) {
+    etx = link_stats_get_etx(stats);
+    if(etx > 0) {
+      quality = (100L * LINK_STATS_ETX_DIVISOR) / etx;
+    }
+  }
+#endif /* UIP_CONF_IPV6_RPL */
+  return ctx->writer->write_int(ctx, outbuf, outsize, quality);
+}
+/*---------------------------------------------------------------------------*/
+static int
+read_ipaddr(lwm2m_context_t *ctx, uint8_t *outbuf, size_t outsize)
+{
+  uip_ds6_addr_t *addr;
+
+  addr = uip_ds6_get_global(ADDR_PREFERRED);
+  if(addr == NULL) {
+    addr = uip_ds6_get_link_local(ADDR_PREFERRED);
+  }
+  return write_ipaddr(ctx, outbuf, outsize,
+                      addr != NULL ? &addr->ipaddr : NULL);
+}
+/*---------------------------------------------------------------------------*/
+static int
+read_router_ipaddr(lwm2m_context_t *ctx, uint8_t *outbuf, size_t outsize)
+{
+#if UIP_CONF_IPV6_RPL
+  rpl_parent_t *parent = get_parent();
+  return write_ipaddr(ctx, outbuf, outsize,
+                      parent != NULL ? rpl_get_parent_ipaddr(parent) : NULL);
+#else /* UIP_CONF_IPV6_RPL */
+  return write_ipaddr(ctx, outbuf, outsize, uip_ds6_defrt_choose());
+#endif /* UIP_CONF_IPV6_RPL */
+}
+/*---------------------------------------------------------------------------*/
+/* The share of time the radio is on, in percent */
+static int
+read_link_utilization(lwm2m_context_t *ctx, uint8_t *outbuf, size_t outsize)
+{
+  unsigned long radio, total;
+
+  energest_flush();
+  radio = energest_type_time(ENERGEST_TYPE_TRANSMIT) +
+    energest_type_time(ENERGEST_TYPE_LISTEN);
+  total = energest_type_time(ENERGEST_TYPE_CPU) +
+    energest_type_time(ENERGEST_TYPE_LPM);
+  return ctx->writer->write_int(ctx, outbuf, outsize,
+                                total >= 100 ? radio / (total / 100) : 0);
+}
+/*---------------------------------------------------------------------------*/
+LWM2M_RESOURCES(connectivity_resources,
+                /* Network Bearer */
+                LWM2M_RESOURCE_INTEGER(0, LWM2M_CONNECTIVITY_BEARER),
+                /* Available Network Bearer */
+                LWM2M_RESOURCE_INTEGER(1, LWM2M_CONNECTIVITY_BEARER),
+                /* Radio Signal Strength */
+                LWM2M_RESOURCE_CALLBACK(2, { read_rssi, NULL, NULL }),
+                /* Link Quality */
+                LWM2M_RESOURCE_CALLBACK(3, { read_link_quality, NULL, NULL }),
+                /* IP Addresses */
+                LWM2M_RESOURCE_CALLBACK(4, { read_ipaddr, NULL, NULL }),
+                /* Router IP Addresses */
+                LWM2M_RESOURCE_CALLBACK(5, { read_router_ipaddr, NULL, NULL }),
+                /* Link Utilization */
+                LWM2M_RESOURCE_CALLBACK(6, { read_link_utilization, NULL, NULL }),
+                );
+LWM2M_STATIC_INSTANCES(connectivity_instances,
+                       LWM2M_INSTANCE_STATIC(0, connectivity_resources));
+LWM2M_STATIC_OBJECT(connectivity, 4, connectivity_instances);
+/*---------------------------------------------------------------------------*/
+#if LWM2M_CONNECTIVITY_WITH_STATISTICS
+/* The counters when the collection started, and when it stopped */
+static uint32_t start_sent, start_recv;
+static uint32_t stop_sent, stop_recv;
+static uint8_t collecting = 1;
+static int32_t collection_period;
+static struct ctimer period_timer;
+/*---------------------------------------------------------------------------*/
+static uint32_t
+packets_sent(void)
+{
+#if UIP_STATISTICS
+  return collecting ? uip_stat.ip.sent : stop_sent;
+#else /* UIP_STATISTICS */
+  return 0;
+#endif /* UIP_STATISTICS */
+}
+/*---------------------------------------------------------------------------*/
+static uint32_t
+packets_received(void)
+{
+#if UIP_STATISTICS
+  return collecting ? uip_stat.ip.recv : stop_recv;
+#else /* UIP_STATISTICS */
+  return 0;
+#endif /* UIP_STATISTICS */
+}
+/*---------------------------------------------------------------------------*/
+static int
+read_tx_data(lwm2m_context_t *ctx, uint8_t *outbuf, size_t outsize)
+{
+  return ctx->writer->write_int(ctx, outbuf, outsize,
+                                packets_sent() - start_sent);
+}
+/*---------------------------------------------------------------------------*/
+static int
+read_rx_data(lwm2m_context_t *ctx, uint8_t *outbuf, size_t outsize)
+{
+  return ctx->writer->write_int(ctx, outbuf, outsize,
+                                packets_received() - start_recv);
+}
+/*---------------------------------------------------------------------------*/
+static void
+stop_collection(void *ptr)
+{
+  if(collecting) {
+    stop_sent = packets_sent();
+    stop_recv = packets_received();
+    collecting = 0;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+start(lwm2m_context_t *ctx, const uint8_t *arg, size_t argsize,
+      uint8_t *outbuf, size_t outsize)
+{
+  collecting = 1;
+  start_sent = packets_sent();
+  start_recv = packets_received();
+  if(collection_period > 0) {
+    ctimer_set(&period_timer, collection_period * CLOCK_SECOND,
+               stop_collection, NULL);
+  } else {
+    ctimer_stop(&period_timer);
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+stop(lwm2m_context_t *ctx, const uint8_t *arg, size_t argsize,
+     uint8_t *outbuf, size_t outsize)
+{
+  ctimer_stop(&period_timer);
+  stop_collection(NULL);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+LWM2M_RESOURCES(statistics_resources,
+                /* Tx Data */
+                LWM2M_RESOURCE_CALLBACK(2, { read_tx_data, NULL, NULL }),
+                /* Rx Data */
+                LWM2M_RESOURCE_CALLBACK(3, { read_rx_data, NULL, NULL }),
+                /* Max Message Size */
+                LWM2M_RESOURCE_INTEGER(4, UIP_LINK_MTU),
+                /* Start */
+                LWM2M_RESOURCE_CALLBACK(6, { NULL, NULL, start }),
+                /* Stop */
+                LWM2M_RESOURCE_CALLBACK(7, { NULL, NULL, stop }),
+                /* Collection Period */
+                LWM2M_RESOURCE_INTEGER_VAR(8, &collection_period),
+                );
+LWM2M_STATIC_INSTANCES(statistics_instances,
+                       LWM2M_INSTANCE_STATIC(0, statistics_resources));
+LWM2M_STATIC_OBJECT(statistics, 7, statistics_instances);
+#endif /* LWM2M_CONNECTIVITY_WITH_STATISTICS */
+/*---------------------------------------------------------------------------*/
+void
+lwm2m_connectivity_init(void)
+{
+  PRINTF("*** Init lwm2m-connectivity\n");
+  lwm2m_engine_register_object(&connectivity);
+#if LWM2M_CONNECTIVITY_WITH_STATISTICS
+  lwm2m_engine_register_object(&statistics);
+#endif /* LWM2M_CONNECTIVITY_WITH_STATISTICS */
+}
+/*---------------------------------------------------------------------------*/
+/** @} */
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \addtogroup oma-lwm2m
+ * @{
+ */
+
+/**
+ * \file
+ *         Header file for the Contiki OMA LWM2M connectivity monitoring
+ *         (object 4) and connectivity statistics (object 7) objects.
+ *         All values are read from the network stack when requested.
+ */
+
+#ifndef LWM2M_CONNECTIVITY_H_
+#define LWM2M_CONNECTIVITY_H_
+
+#include "contiki-conf.h"
+
+/* The network bearer: 23 is IEEE 802.15.4 */
+#ifdef LWM2M_CONNECTIVITY_CONF_BEARER
+#define LWM2M_CONNECTIVITY_BEARER LWM2M_CONNECTIVITY_CONF_BEARER
+#else
+#define LWM2M_CONNECTIVITY_BEARER 23
+#endif
+
+/* Also register the connectivity statistics object */
+#ifdef LWM2M_CONNECTIVITY_CONF_WITH_STATISTICS
+#define LWM2M_CONNECTIVITY_WITH_STATISTICS LWM2M_CONNECTIVITY_CONF_WITH_STATISTICS
+#else
+#define LWM2M_CONNECTIVITY_WITH_STATISTICS 1
+#endif
+
+void lwm2m_connectivity_init(void);
+
+#endif /* LWM2M_CONNECTIVITY_H_ */
+/** @} */
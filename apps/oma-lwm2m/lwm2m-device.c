@@ -114,9 +114,6 @@ LWM2M_RESOURCES(device_resources,
 #ifdef LWM2M_DEVICE_MANUFACTURER
                 LWM2M_RESOURCE_STRING(0, LWM2M_DEVICE_MANUFACTURER),
 #endif /* LWM2M_DEVICE_MANUFACTURER */
-#ifdef LWM2M_DEVICE_TYPE
-                LWM2M_RESOURCE_STRING(17, LWM2M_DEVICE_TYPE),
-#endif /* LWM2M_DEVICE_TYPE */
 #ifdef LWM2M_DEVICE_MODEL_NUMBER
                 LWM2M_RESOURCE_STRING(1, LWM2M_DEVICE_MODEL_NUMBER),
 #endif /* LWM2M_DEVICE_MODEL_NUMBER */
@@ -134,9 +131,19 @@ LWM2M_RESOURCES(device_resources,
 #endif /* PLATFORM_FACTORY_DEFAULT */
                 /* Current Time */
                 LWM2M_RESOURCE_CALLBACK(13, { read_lwtime, set_lwtime, NULL }),
+                /* Supported Binding and Modes */
+#if LWM2M_ENGINE_QUEUE_MODE
+                LWM2M_RESOURCE_STRING(16, "UQ"),
+#else /* LWM2M_ENGINE_QUEUE_MODE */
+                LWM2M_RESOURCE_STRING(16, "U"),
+#endif /* LWM2M_ENGINE_QUEUE_MODE */
+#ifdef LWM2M_DEVICE_TYPE
+                LWM2M_RESOURCE_STRING(17, LWM2M_DEVICE_TYPE),
+#endif /* LWM2M_DEVICE_TYPE */
                 );
-LWM2M_INSTANCES(device_instances, LWM2M_INSTANCE(0, device_resources));
-LWM2M_OBJECT(device, 3, device_instances);
+LWM2M_STATIC_INSTANCES(device_instances,
+                       LWM2M_INSTANCE_STATIC(0, device_resources));
+LWM2M_STATIC_OBJECT(device, 3, device_instances);
 /*---------------------------------------------------------------------------*/
 void
 lwm2m_device_init(void)
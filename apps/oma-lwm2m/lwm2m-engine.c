@@ -47,6 +47,10 @@
 #include "lwm2m-device.h"
 #include "lwm2m-plain-text.h"
 #include "lwm2m-json.h"
+#include "lwm2m-senml-cbor.h"
+#include "lwm2m-notification.h"
+#include "lwm2m-store.h"
+#include "lwm2m-access-control.h"
 #include "rest-engine.h"
 #include "er-coap-constants.h"
 #include "er-coap-engine.h"
@@ -54,6 +58,9 @@
 #include "oma-tlv-reader.h"
 #include "oma-tlv-writer.h"
 #include "net/ipv6/uip-ds6.h"
+#if LWM2M_ENGINE_QUEUE_MODE
+#include "net/netstack.h"
+#endif /* LWM2M_ENGINE_QUEUE_MODE */
 #include <stdio.h>
 #include <string.h>
 #include <inttypes.h>
@@ -79,17 +86,159 @@
 #define MAX_OBJECTS 10
 #endif /* LWM2M_ENGINE_CONF_MAX_OBJECTS */
 
+/* Registration lifetime in seconds */
+#ifdef LWM2M_ENGINE_CONF_LIFETIME
+#define LIFETIME LWM2M_ENGINE_CONF_LIFETIME
+#else /* LWM2M_ENGINE_CONF_LIFETIME */
+#define LIFETIME 86400
+#endif /* LWM2M_ENGINE_CONF_LIFETIME */
+
+#define MAX_SERVERS LWM2M_ENGINE_MAX_SERVERS
+
+/* Resources that can be written at once to an instance */
+#ifdef LWM2M_ENGINE_CONF_MAX_BULK_RECORDS
+#define MAX_BULK_RECORDS LWM2M_ENGINE_CONF_MAX_BULK_RECORDS
+#else /* LWM2M_ENGINE_CONF_MAX_BULK_RECORDS */
+#define MAX_BULK_RECORDS 16
+#endif /* LWM2M_ENGINE_CONF_MAX_BULK_RECORDS */
+
+/*
+ * Requests that can be handled at once. A request handler can notify
+ * an observer directly, which handles a request of its own, so the
+ * default allows one such nested request.
+ */
+#ifdef LWM2M_ENGINE_CONF_REQUEST_CONTEXTS
+#define REQUEST_CONTEXTS LWM2M_ENGINE_CONF_REQUEST_CONTEXTS
+#else /* LWM2M_ENGINE_CONF_REQUEST_CONTEXTS */
+#define REQUEST_CONTEXTS 2
+#endif /* LWM2M_ENGINE_CONF_REQUEST_CONTEXTS */
+
+/*
+ * The RD client runs when something happens (network joined, Bootstrap-
+ * Finish, new server info) and otherwise every PERIOD to keep the
+ * registrations updated. Failed requests are retried after RETRY_MIN,
+ * doubled after each failure up to RETRY_MAX.
+ */
+#ifdef LWM2M_ENGINE_CONF_PERIOD
+#define PERIOD LWM2M_ENGINE_CONF_PERIOD
+#else /* LWM2M_ENGINE_CONF_PERIOD */
+#define PERIOD (15 * CLOCK_SECOND)
+#endif /* LWM2M_ENGINE_CONF_PERIOD */
+
+#ifdef LWM2M_ENGINE_CONF_RETRY_MIN
+#define RETRY_MIN LWM2M_ENGINE_CONF_RETRY_MIN
+#else /* LWM2M_ENGINE_CONF_RETRY_MIN */
+#define RETRY_MIN (2 * CLOCK_SECOND)
+#endif /* LWM2M_ENGINE_CONF_RETRY_MIN */
+
+#ifdef LWM2M_ENGINE_CONF_RETRY_MAX
+#define RETRY_MAX LWM2M_ENGINE_CONF_RETRY_MAX
+#else /* LWM2M_ENGINE_CONF_RETRY_MAX */
+#define RETRY_MAX (120 * CLOCK_SECOND)
+#endif /* LWM2M_ENGINE_CONF_RETRY_MAX */
+
+/* How long to wait for Bootstrap-Finish before requesting again */
+#ifdef LWM2M_ENGINE_CONF_BOOTSTRAP_TIMEOUT
+#define BOOTSTRAP_TIMEOUT LWM2M_ENGINE_CONF_BOOTSTRAP_TIMEOUT
+#else /* LWM2M_ENGINE_CONF_BOOTSTRAP_TIMEOUT */
+#define BOOTSTRAP_TIMEOUT (30 * CLOCK_SECOND)
+#endif /* LWM2M_ENGINE_CONF_BOOTSTRAP_TIMEOUT */
+
 #define REMOTE_PORT        UIP_HTONS(COAP_DEFAULT_PORT)
 #define BS_REMOTE_PORT     UIP_HTONS(5685)
 
+/*
+ * The registered objects are kept sorted by object id to allow lookups
+ * using binary search. The instances sorted flag is set for an object
+ * when its instance array is sorted by instance id.
+ */
+#define OBJECT_FLAG_INSTANCES_SORTED 1
+
 static const lwm2m_object_t *objects[MAX_OBJECTS];
+static uint8_t object_flags[MAX_OBJECTS];
+static uint8_t object_count = 0;
 static char endpoint[32];
 static char rd_data[128]; /* allocate some data for the RD */
+static int rd_data_len = -1; /* length of the cached rd data or -1 if invalid */
+static char rd_query[sizeof(endpoint) + 24];
 
 PROCESS(lwm2m_rd_client, "LWM2M Engine");
 
-static uip_ipaddr_t server_ipaddr;
-static uint16_t server_port = REMOTE_PORT;
+/*
+ * Each registration server has its own registration state. Server
+ * number i uses the lifetime of instance i of the Server object if set.
+ */
+#define SERVER_FLAG_USED       1
+#define SERVER_FLAG_REGISTERED 2
+#define SERVER_FLAG_CHANGED    4 /* links changed since last registration */
+#define SERVER_FLAG_UPDATED    8 /* the last update was acknowledged */
+
+typedef struct {
+  uip_ipaddr_t ipaddr;
+  uint16_t port;
+  uint8_t flags;
+  char location[24]; /* registration location from the server */
+  struct stimer update_timer;
+} rd_server_t;
+
+static rd_server_t servers[MAX_SERVERS];
+/* the server of the ongoing request */
+static rd_server_t *current_server;
+
+/* The decoded resources of a bulk write */
+typedef struct {
+  const uint8_t *data;
+  const lwm2m_instance_t *instance;
+  const lwm2m_resource_t *resource;
+  /* The new value, or the new string when it is in the payload */
+  const uint8_t *string;
+  int32_t value;
+  uint16_t len;
+  uint16_t id;
+  uint16_t instance_id;
+  uint16_t resource_instance_id;
+  uint8_t instance_index;
+  uint8_t flags;
+} bulk_record_t;
+
+/* The record was in an object instance TLV */
+#define BULK_FLAG_INSTANCE          1
+/* The record is a resource instance of a multiple resource */
+#define BULK_FLAG_RESOURCE_INSTANCE 2
+
+static bulk_record_t bulk_records[MAX_BULK_RECORDS];
+/* The payload decoder of read_bulk_records(), which is not reentrant
+   anyway, kept off the stack */
+static union {
+  lwm2m_senml_cbor_iterator_t senml;
+  struct {
+    oma_tlv_cursor_t cursor;
+    oma_tlv_t tlv;
+  } tlv;
+} bulk_reader;
+
+/*
+ * The state of a request being handled. The requests nest (see
+ * REQUEST_CONTEXTS) and are taken from the pool in stack order, which
+ * keeps the stack of the handlers small.
+ *
+ * Stack budget (-Os, native x86-64, frames of the functions themselves):
+ * lwm2m_engine_handler() 208 bytes, write_resources() 144 and the TLV
+ * stream writers 96. A notification adds 32 for coap_notify_observer()
+ * and 48 for create_notification() in front of the handler, 288 in all
+ * compared to 800 with the contexts and packets on the stack.
+ */
+typedef struct request_context {
+  lwm2m_context_t context;
+  oma_tlv_stream_t stream;
+} request_context_t;
+
+static request_context_t request_contexts[REQUEST_CONTEXTS];
+static uint8_t request_depth;
+
+/* The request of the Execute being handled, for deferred responses */
+static void *exec_request;
+
 static uip_ipaddr_t bs_server_ipaddr;
 static uint16_t bs_server_port = BS_REMOTE_PORT;
 
@@ -97,8 +246,31 @@ static uint8_t use_bootstrap = 0;
 static uint8_t has_bootstrap_server_info = 0;
 static uint8_t use_registration = 0;
 static uint8_t has_registration_server_info = 0;
-static uint8_t registered = 0;
-static uint8_t bootstrapped = 0; /* bootstrap made... */
+
+#define BOOTSTRAP_NONE      0
+#define BOOTSTRAP_REQUESTED 1 /* waiting for the bootstrap server */
+#define BOOTSTRAP_FINISHED  2 /* Bootstrap-Finish received or info stored */
+#define BOOTSTRAP_DONE      3 /* registration server info set */
+static uint8_t bootstrap_state = BOOTSTRAP_NONE;
+static uint8_t bootstrap_accepted;
+static struct timer bootstrap_timer;
+
+/* Set when the RD client should run as soon as possible */
+static uint8_t rd_pending;
+static process_event_t rd_event;
+static uint8_t retries;
+#if UIP_DS6_NOTIFICATIONS
+static struct uip_ds6_notification route_notification;
+#endif /* UIP_DS6_NOTIFICATIONS */
+
+#if LWM2M_ENGINE_QUEUE_MODE
+#define BINDING_QUERY "&b=UQ"
+static uint8_t queue_awake = 1;
+static uint8_t queue_flush = 0;
+static struct ctimer queue_timer;
+#else /* LWM2M_ENGINE_QUEUE_MODE */
+#define BINDING_QUERY ""
+#endif /* LWM2M_ENGINE_QUEUE_MODE */
 
 void lwm2m_device_init(void);
 void lwm2m_security_init(void);
@@ -109,16 +281,67 @@ static const lwm2m_instance_t *get_instance(const lwm2m_object_t *object, lwm2m_
 static const lwm2m_resource_t *get_resource(const lwm2m_instance_t *instance, lwm2m_context_t *context);
 /*---------------------------------------------------------------------------*/
 static void
-client_chunk_handler(void *response)
+bootstrap_handler(void *response)
 {
-#if (DEBUG) & DEBUG_PRINT
-  const uint8_t *chunk;
+  uint8_t code = ((coap_packet_t *)response)->code;
 
-  int len = coap_get_payload(response, &chunk);
+  PRINTF("Bootstrap request: %u.%02u\n", code >> 5, code & 0x1f);
+  bootstrap_accepted = (code >> 5) == 2;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Run the RD client as soon as it is not waiting for a response. A
+ * poll would be taken as the response of an ongoing blocking request.
+ */
+static void
+rd_wake_up(void)
+{
+  rd_pending = 1;
+  process_post(&lwm2m_rd_client, rd_event, NULL);
+}
+/*---------------------------------------------------------------------------*/
+/* The delay before retrying a failed request */
+static clock_time_t
+get_retry_delay(void)
+{
+  clock_time_t delay;
 
-  PRINTF("|%.*s\n", len, (char *)chunk);
-#endif /* (DEBUG) & DEBUG_PRINT */
+  delay = RETRY_MIN << retries;
+  if(delay >= RETRY_MAX || (delay >> retries) != RETRY_MIN) {
+    delay = RETRY_MAX;
+  } else {
+    retries++;
+  }
+  return delay;
+}
+/*---------------------------------------------------------------------------*/
+static void
+bootstrap_finish_handler(void *request, void *response, uint8_t *buffer,
+                         uint16_t preferred_size, int32_t *offset)
+{
+  PRINTF("Bootstrap-Finish\n");
+  if(bootstrap_state != BOOTSTRAP_DONE) {
+    /* Also if the server was faster than the response to our request */
+    bootstrap_state = BOOTSTRAP_FINISHED;
+  }
+  REST.set_response_status(response, CHANGED_2_04);
+  rd_wake_up();
+}
+static RESOURCE(bootstrap_finish, "", NULL, bootstrap_finish_handler,
+                NULL, NULL);
+/*---------------------------------------------------------------------------*/
+#if UIP_DS6_NOTIFICATIONS
+static void
+route_callback(int event, uip_ipaddr_t *route, uip_ipaddr_t *nexthop,
+               int num_routes)
+{
+  if(event == UIP_DS6_NOTIFICATION_DEFRT_ADD) {
+    /* Joined a network - no need to wait for the next period */
+    retries = 0;
+    rd_wake_up();
+  }
 }
+#endif /* UIP_DS6_NOTIFICATIONS */
 /*---------------------------------------------------------------------------*/
 static int
 index_of(const uint8_t *data, int offset, int len, uint8_t c)
@@ -134,6 +357,40 @@ index_of(const uint8_t *data, int offset, int len, uint8_t c)
   return -1;
 }
 /*---------------------------------------------------------------------------*/
+/*
+ * Set up a DTLS session with a server using the PSK identity and key
+ * from a security instance.
+ */
+static int
+setup_secure_session(const lwm2m_instance_t *instance,
+                     lwm2m_context_t *context,
+                     const uip_ipaddr_t *addr, uint16_t port)
+{
+  const lwm2m_resource_t *rsc;
+  const uint8_t *identity;
+  const uint8_t *key;
+  int identity_len;
+  int key_len;
+
+  context->resource_id = LWM2M_SECURITY_CLIENT_PKI;
+  rsc = get_resource(instance, context);
+  identity = lwm2m_object_get_resource_string(rsc, context);
+  identity_len = lwm2m_object_get_resource_strlen(rsc, context);
+
+  context->resource_id = LWM2M_SECURITY_KEY;
+  rsc = get_resource(instance, context);
+  key = lwm2m_object_get_resource_string(rsc, context);
+  key_len = lwm2m_object_get_resource_strlen(rsc, context);
+
+  if(identity == NULL || identity_len <= 0 || key == NULL || key_len <= 0) {
+    PRINTF("No PSK identity or key for secure server\n");
+    return 0;
+  }
+
+  return coap_dtls_set_psk(addr, port, identity, identity_len, key, key_len)
+    && coap_dtls_connect(addr, port);
+}
+/*---------------------------------------------------------------------------*/
 static int
 has_network_access(void)
 {
@@ -150,7 +407,7 @@ lwm2m_engine_use_bootstrap_server(int use)
 {
   use_bootstrap = use != 0;
   if(use_bootstrap) {
-    process_poll(&lwm2m_rd_client);
+    rd_wake_up();
   }
 }
 /*---------------------------------------------------------------------------*/
@@ -159,26 +416,232 @@ lwm2m_engine_use_registration_server(int use)
 {
   use_registration = use != 0;
   if(use_registration) {
-    process_poll(&lwm2m_rd_client);
+    rd_wake_up();
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+set_servers_flag(uint8_t flag)
+{
+  int i;
+  for(i = 0; i < MAX_SERVERS; i++) {
+    servers[i].flags |= flag;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+clear_servers_flag(uint8_t flag)
+{
+  int i;
+  for(i = 0; i < MAX_SERVERS; i++) {
+    servers[i].flags &= ~flag;
   }
 }
 /*---------------------------------------------------------------------------*/
 void
 lwm2m_engine_register_with_server(const uip_ipaddr_t *server, uint16_t port)
 {
-  uip_ipaddr_copy(&server_ipaddr, server);
-  if(port != 0) {
-    server_port = port;
-  } else {
-    server_port = REMOTE_PORT;
+  rd_server_t *s = NULL;
+  int i;
+
+  if(port == 0) {
+    port = REMOTE_PORT;
   }
+  if(!has_registration_server_info) {
+    /* Forget any server found using the network */
+    clear_servers_flag(SERVER_FLAG_USED | SERVER_FLAG_REGISTERED);
+  }
+
+  for(i = 0; i < MAX_SERVERS; i++) {
+    if((servers[i].flags & SERVER_FLAG_USED)
+       && uip_ipaddr_cmp(&servers[i].ipaddr, server)
+       && servers[i].port == port) {
+      /* Already known - register again */
+      s = &servers[i];
+      break;
+    }
+    if(s == NULL && (servers[i].flags & SERVER_FLAG_USED) == 0) {
+      s = &servers[i];
+    }
+  }
+  if(s == NULL) {
+    printf("No free server slot - replacing the last server\n");
+    s = &servers[MAX_SERVERS - 1];
+  }
+
+  uip_ipaddr_copy(&s->ipaddr, server);
+  s->port = port;
+  s->flags = SERVER_FLAG_USED;
   has_registration_server_info = 1;
-  registered = 0;
   if(use_registration) {
-    process_poll(&lwm2m_rd_client);
+    rd_wake_up();
   }
 }
 /*---------------------------------------------------------------------------*/
+int
+lwm2m_engine_get_server(int index, uip_ipaddr_t *ipaddr, uint16_t *port)
+{
+  if(index < 0 || index >= MAX_SERVERS ||
+     (servers[index].flags & SERVER_FLAG_REGISTERED) == 0) {
+    return 0;
+  }
+#if LWM2M_ENGINE_QUEUE_MODE
+  if(!queue_awake) {
+    /* The radio is off and the server can not be reached */
+    return 0;
+  }
+#endif /* LWM2M_ENGINE_QUEUE_MODE */
+  uip_ipaddr_copy(ipaddr, &servers[index].ipaddr);
+  *port = servers[index].port;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+get_lifetime(const rd_server_t *s)
+{
+  int32_t lifetime = 0;
+
+  /* Use the lifetime from the matching Server object instance if set */
+  if(lwm2m_engine_read_float32fix(LWM2M_OBJECT_SERVER_ID, s - servers,
+                                  LWM2M_SERVER_LIFETIME, &lifetime)) {
+    lifetime >>= LWM2M_FLOAT32_BITS;
+  }
+  return lifetime > 0 ? lifetime : LIFETIME;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+get_update_interval(const rd_server_t *s)
+{
+  unsigned long lifetime = get_lifetime(s);
+  /* The registration is updated when three quarters of the lifetime passed */
+  return lifetime - lifetime / 4;
+}
+/*---------------------------------------------------------------------------*/
+#if LWM2M_ENGINE_QUEUE_MODE
+static void
+queue_sleep(void *ptr)
+{
+  int i;
+  for(i = 0; i < MAX_SERVERS; i++) {
+    if((servers[i].flags & SERVER_FLAG_USED)
+       && (servers[i].flags & SERVER_FLAG_REGISTERED) == 0) {
+      /* Stay awake until registered with all servers */
+      ctimer_restart(&queue_timer);
+      return;
+    }
+  }
+  PRINTF("Queue mode: radio off\n");
+  queue_awake = 0;
+  lwm2m_notification_set_queued(1);
+  NETSTACK_RDC.off(0);
+}
+/*---------------------------------------------------------------------------*/
+static void
+queue_stay_awake(void)
+{
+  ctimer_set(&queue_timer, LWM2M_ENGINE_QUEUE_MODE_AWAKE_TIME * CLOCK_SECOND,
+             queue_sleep, NULL);
+}
+/*---------------------------------------------------------------------------*/
+static void
+queue_wake_up(void)
+{
+  int i;
+
+  PRINTF("Queue mode: radio on\n");
+  NETSTACK_RDC.on();
+  queue_awake = 1;
+  queue_flush = 1;
+  /* The Update tells the servers that the node can be reached */
+  for(i = 0; i < MAX_SERVERS; i++) {
+    stimer_set(&servers[i].update_timer, 0);
+  }
+  queue_stay_awake();
+}
+/*---------------------------------------------------------------------------*/
+static int
+is_update_due(void)
+{
+  int i;
+  for(i = 0; i < MAX_SERVERS; i++) {
+    if((servers[i].flags & SERVER_FLAG_REGISTERED)
+       && ((servers[i].flags & SERVER_FLAG_CHANGED)
+           || stimer_expired(&servers[i].update_timer))) {
+      return 1;
+    }
+  }
+  return 0;
+}
+#endif /* LWM2M_ENGINE_QUEUE_MODE */
+/*---------------------------------------------------------------------------*/
+static void
+registration_handler(void *response)
+{
+  const char *location;
+  int len;
+
+  if(((coap_packet_t *)response)->code != CREATED_2_01) {
+    PRINTF("Registration failed: %u\n", ((coap_packet_t *)response)->code);
+    return;
+  }
+
+  len = coap_get_header_location_path(response, &location);
+  if(len <= 0 || len >= sizeof(current_server->location) - 1) {
+    PRINTF("Registration without usable location\n");
+    return;
+  }
+  current_server->location[0] = '/';
+  memcpy(&current_server->location[1], location, len);
+  current_server->location[len + 1] = '\0';
+
+  PRINTF("Registered at '%s'\n", current_server->location);
+  current_server->flags |= SERVER_FLAG_REGISTERED;
+  current_server->flags &= ~SERVER_FLAG_CHANGED;
+  stimer_set(&current_server->update_timer,
+             get_update_interval(current_server));
+#if LWM2M_ENGINE_QUEUE_MODE
+  queue_stay_awake();
+#endif /* LWM2M_ENGINE_QUEUE_MODE */
+}
+/*---------------------------------------------------------------------------*/
+static void
+update_handler(void *response)
+{
+  if(((coap_packet_t *)response)->code == CHANGED_2_04) {
+    current_server->flags |= SERVER_FLAG_UPDATED;
+  } else {
+    PRINTF("Update failed: %u\n", ((coap_packet_t *)response)->code);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+generate_rd_data(void)
+{
+  int pos;
+  int len, i, j;
+
+  if(rd_data_len >= 0) {
+    /* No instances created since the links were generated */
+    return rd_data_len;
+  }
+
+  pos = 0;
+  for(i = 0; i < object_count; i++) {
+    for(j = 0; j < objects[i]->count; j++) {
+      if(objects[i]->instances[j].flag & LWM2M_INSTANCE_FLAG_USED) {
+        len = snprintf(&rd_data[pos], sizeof(rd_data) - pos,
+                       "%s<%d/%d>", pos > 0 ? "," : "",
+                       objects[i]->id, objects[i]->instances[j].id);
+        if(len > 0 && len < sizeof(rd_data) - pos) {
+          pos += len;
+        }
+      }
+    }
+  }
+  rd_data_len = pos;
+  return pos;
+}
+/*---------------------------------------------------------------------------*/
 static int
 update_registration_server(void)
 {
@@ -193,8 +656,12 @@ update_registration_server(void)
     /* Use the DAG id as server address if no other has been specified */
     dag = rpl_get_any_dag();
     if(dag != NULL) {
-      uip_ipaddr_copy(&server_ipaddr, &dag->dag_id);
-      server_port = REMOTE_PORT;
+      if((servers[0].flags & SERVER_FLAG_USED) == 0
+         || !uip_ipaddr_cmp(&servers[0].ipaddr, &dag->dag_id)) {
+        uip_ipaddr_copy(&servers[0].ipaddr, &dag->dag_id);
+        servers[0].port = REMOTE_PORT;
+        servers[0].flags = SERVER_FLAG_USED;
+      }
       return 1;
     }
   }
@@ -214,10 +681,11 @@ lwm2m_engine_register_with_bootstrap_server(const uip_ipaddr_t *server,
     bs_server_port = BS_REMOTE_PORT;
   }
   has_bootstrap_server_info = 1;
-  bootstrapped = 0;
-  registered = 0;
+  bootstrap_state = BOOTSTRAP_NONE;
+  clear_servers_flag(SERVER_FLAG_REGISTERED);
   if(use_bootstrap) {
-    process_poll(&lwm2m_rd_client);
+    retries = 0;
+    rd_wake_up();
   }
 }
 /*---------------------------------------------------------------------------*/
@@ -245,144 +713,236 @@ update_bootstrap_server(void)
   return 0;
 }
 /*---------------------------------------------------------------------------*/
+/*
+ * Set up the registration server from the server URI of the first
+ * security instance. Returns 1 when the server is set, 0 otherwise.
+ */
+static int
+use_security_server(void)
+{
+  lwm2m_context_t context;
+  const lwm2m_instance_t *instance;
+  const lwm2m_resource_t *rsc;
+  const uint8_t *first;
+  int len, start, end;
+  uip_ipaddr_t addr;
+  int32_t port;
+  uint8_t secure;
+  uint8_t tcp;
+
+  instance = get_first_instance_of_object(LWM2M_OBJECT_SECURITY_ID, &context);
+  if(instance == NULL) {
+    return 0;
+  }
+  /* get the server URI */
+  context.resource_id = LWM2M_SECURITY_SERVER_URI;
+  rsc = get_resource(instance, &context);
+  first = lwm2m_object_get_resource_string(rsc, &context);
+  len = lwm2m_object_get_resource_strlen(rsc, &context);
+  if(first == NULL || len <= 0) {
+    return 0;
+  }
+
+  PRINTF("**** Found security instance using: %.*s\n", len, first);
+
+  /* Check if secure */
+  secure = strncmp((const char *)first, "coaps:", 6) == 0;
+  tcp = strncmp((const char *)first, "coap+tcp:", 9) == 0;
+
+  /* Only IPv6 supported */
+  start = index_of(first, 0, len, '[');
+  end = index_of(first, start, len, ']');
+  if(start <= 0 || end <= start ||
+     !uiplib_ipaddrconv((const char *)&first[start], &addr)) {
+    printf("** failed to parse URI %.*s\n", len, first);
+    return 0;
+  }
+  if(first[end + 1] == ':' &&
+     lwm2m_plain_text_read_int(first + end + 2, len - end - 2, &port)) {
+  } else if(secure) {
+    port = COAP_DEFAULT_SECURE_PORT;
+  } else {
+    port = COAP_DEFAULT_PORT;
+  }
+  PRINTF("Server address ");
+  PRINT6ADDR(&addr);
+  PRINTF(" port %" PRId32 "%s\n", port, secure ? " (secure)" : "");
+  if(secure && !setup_secure_session(instance, &context, &addr,
+                                     UIP_HTONS((uint16_t)port))) {
+    printf("Secure CoAP requested but not supported - can not bootstrap\n");
+    return 0;
+  }
+  if(tcp && !coap_tcp_connect(&addr, UIP_HTONS((uint16_t)port))) {
+    printf("CoAP over TCP requested but not available - can not bootstrap\n");
+    return 0;
+  }
+  /* The server is kept with the registration state */
+  lwm2m_engine_register_with_server(&addr, UIP_HTONS((uint16_t)port));
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+is_registered(void)
+{
+  int i;
+  for(i = 0; i < MAX_SERVERS; i++) {
+    if((servers[i].flags & SERVER_FLAG_USED)
+       && (servers[i].flags & SERVER_FLAG_REGISTERED) == 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
 PROCESS_THREAD(lwm2m_rd_client, ev, data)
 {
   static coap_packet_t request[1];      /* This way the packet can be treated as pointer as usual. */
   static struct etimer et;
+  static int server_index;
+  static clock_time_t delay;
 
   PROCESS_BEGIN();
 
   printf("RD Client started with endpoint '%s'\n", endpoint);
 
-  etimer_set(&et, 15 * CLOCK_SECOND);
+  etimer_set(&et, RETRY_MIN);
 
   while(1) {
-    PROCESS_YIELD();
+    PROCESS_YIELD_UNTIL(rd_pending || etimer_expired(&et));
+    rd_pending = 0;
+    delay = PERIOD;
 
-    if(etimer_expired(&et)) {
-      if(!has_network_access()) {
-        /* Wait until for a network to join */
-      } else if(use_bootstrap && bootstrapped == 0) {
-        if(update_bootstrap_server()) {
-          /* prepare request, TID is set by COAP_BLOCKING_REQUEST() */
-          coap_init_message(request, COAP_TYPE_CON, COAP_POST, 0);
-          coap_set_header_uri_path(request, "/bs");
-          coap_set_header_uri_query(request, endpoint);
-
-          printf("Registering ID with bootstrap server [");
-          uip_debug_ipaddr_print(&bs_server_ipaddr);
-          printf("]:%u as '%s'\n", uip_ntohs(bs_server_port), endpoint);
+#if LWM2M_ENGINE_QUEUE_MODE
+    if(!queue_awake && (lwm2m_notification_has_pending() || is_update_due())) {
+      queue_wake_up();
+    }
+#endif /* LWM2M_ENGINE_QUEUE_MODE */
+
+    if(!has_network_access()) {
+      /* Wait for a network to join */
+    } else if(use_bootstrap && bootstrap_state == BOOTSTRAP_NONE) {
+#if LWM2M_STORE_ENABLED
+      lwm2m_context_t context;
+      if(get_first_instance_of_object(LWM2M_OBJECT_SECURITY_ID, &context)
+         != NULL) {
+        /* Server info restored from storage - no need to bootstrap */
+        bootstrap_state = BOOTSTRAP_FINISHED;
+        delay = 0;
+      } else
+#endif /* LWM2M_STORE_ENABLED */
+      if(update_bootstrap_server()) {
+        /* prepare request, TID is set by COAP_BLOCKING_REQUEST() */
+        coap_init_message(request, COAP_TYPE_CON, COAP_POST, 0);
+        coap_set_header_uri_path(request, "/bs");
+        coap_set_header_uri_query(request, endpoint);
 
-          COAP_BLOCKING_REQUEST(&bs_server_ipaddr, bs_server_port, request,
-                                client_chunk_handler);
-          bootstrapped++;
-        }
-      } else if(use_bootstrap && bootstrapped == 1) {
-        lwm2m_context_t context;
-        const lwm2m_instance_t *instance = NULL;
-        const lwm2m_resource_t *rsc;
-        const uint8_t *first;
-        int len;
-
-        PRINTF("*** Bootstrap - checking for server info...\n");
-
-        /* get the security object */
-        instance = get_first_instance_of_object(LWM2M_OBJECT_SECURITY_ID, &context);
-        if(instance != NULL) {
-          /* get the server URI */
-          context.resource_id = LWM2M_SECURITY_SERVER_URI;
-          rsc = get_resource(instance, &context);
-          first = lwm2m_object_get_resource_string(rsc, &context);
-          len = lwm2m_object_get_resource_strlen(rsc, &context);
-          if(first != NULL && len > 0) {
-            int start, end;
-            uip_ipaddr_t addr;
-            int32_t port;
-            uint8_t secure = 0;
-
-            PRINTF("**** Found security instance using: %.*s\n", len, first);
-            /* TODO Should verify it is a URI */
-
-            /* Check if secure */
-            secure = strncmp((const char *)first, "coaps:", 6) == 0;
-
-            /* Only IPv6 supported */
-            start = index_of(first, 0, len, '[');
-            end = index_of(first, start, len, ']');
-            if(start > 0 && end > start &&
-               uiplib_ipaddrconv((const char *)&first[start], &addr)) {
-              if(first[end + 1] == ':' &&
-                 lwm2m_plain_text_read_int(first + end + 2, len - end - 2, &port)) {
-              } else if(secure) {
-                /**
-                 * Secure CoAP should use a different port but for now
-                 * the same port is used.
-                 */
-                port = COAP_DEFAULT_PORT;
-              } else {
-                port = COAP_DEFAULT_PORT;
-              }
-              PRINTF("Server address ");
-              PRINT6ADDR(&addr);
-              PRINTF(" port %" PRId32 "%s\n", port, secure ? " (secure)" : "");
-              if(secure) {
-                printf("Secure CoAP requested but not supported - can not bootstrap\n");
-              } else {
-                lwm2m_engine_register_with_server(&addr,
-                                                  UIP_HTONS((uint16_t)port));
-                bootstrapped++;
-              }
-            } else {
-              printf("** failed to parse URI %.*s\n", len, first);
-            }
-          }
+        printf("Registering ID with bootstrap server [");
+        uip_debug_ipaddr_print(&bs_server_ipaddr);
+        printf("]:%u as '%s'\n", uip_ntohs(bs_server_port), endpoint);
+
+        bootstrap_accepted = 0;
+        COAP_BLOCKING_REQUEST(&bs_server_ipaddr, bs_server_port, request,
+                              bootstrap_handler);
+        if(bootstrap_state == BOOTSTRAP_FINISHED) {
+          delay = 0;
+        } else if(bootstrap_accepted) {
+          /* The server writes the security objects and then sends
+             Bootstrap-Finish */
+          bootstrap_state = BOOTSTRAP_REQUESTED;
+          timer_set(&bootstrap_timer, BOOTSTRAP_TIMEOUT);
+          delay = BOOTSTRAP_TIMEOUT;
+        } else {
+          delay = get_retry_delay();
         }
-
-        if(bootstrapped == 1) {
-          /* Not ready. Lets retry with the bootstrap server again */
-          bootstrapped = 0;
+      }
+    } else if(use_bootstrap && bootstrap_state == BOOTSTRAP_REQUESTED
+              && !timer_expired(&bootstrap_timer)) {
+      /* Woken up before Bootstrap-Finish */
+      delay = timer_remaining(&bootstrap_timer);
+    } else if(use_bootstrap && bootstrap_state != BOOTSTRAP_DONE) {
+      PRINTF("*** Bootstrap - checking for server info...\n");
+      if(use_security_server()) {
+        bootstrap_state = BOOTSTRAP_DONE;
+        retries = 0;
+        /* Register right away */
+        delay = 0;
+      } else {
+        /* Not ready. Lets retry with the bootstrap server again */
+        bootstrap_state = BOOTSTRAP_NONE;
+        delay = get_retry_delay();
+      }
+    } else if(use_registration && update_registration_server()) {
+      /* Serve all servers on this wake-up, also if some do not respond */
+      for(server_index = 0; server_index < MAX_SERVERS; server_index++) {
+        current_server = &servers[server_index];
+        if((current_server->flags & SERVER_FLAG_USED) == 0) {
+          continue;
         }
 
-      } else if(use_registration && !registered &&
-                update_registration_server()) {
-        int pos;
-        int len, i, j;
-        registered = 1;
+        if((current_server->flags & SERVER_FLAG_REGISTERED) == 0) {
+          int pos;
 
-        /* prepare request, TID is set by COAP_BLOCKING_REQUEST() */
-        coap_init_message(request, COAP_TYPE_CON, COAP_POST, 0);
-        coap_set_header_uri_path(request, "/rd");
-        coap_set_header_uri_query(request, endpoint);
+          /* prepare request, TID is set by COAP_BLOCKING_REQUEST() */
+          coap_init_message(request, COAP_TYPE_CON, COAP_POST, 0);
+          coap_set_header_uri_path(request, "/rd");
+          snprintf(rd_query, sizeof(rd_query), "%s&lt=%lu" BINDING_QUERY,
+                   endpoint, get_lifetime(current_server));
+          coap_set_header_uri_query(request, rd_query);
+
+          /* generate the rd data */
+          pos = generate_rd_data();
+          coap_set_payload(request, (uint8_t *)rd_data, pos);
+
+          printf("Registering with [");
+          uip_debug_ipaddr_print(&current_server->ipaddr);
+          printf("]:%u lwm2m endpoint '%s': '%.*s'\n",
+                 uip_ntohs(current_server->port), endpoint, pos, rd_data);
+          COAP_BLOCKING_REQUEST(&current_server->ipaddr,
+                                current_server->port, request,
+                                registration_handler);
+        } else if((current_server->flags & SERVER_FLAG_CHANGED)
+                  || stimer_expired(&current_server->update_timer)) {
+          int pos;
+
+          /* Update the registration - the links are only sent if changed */
+          coap_init_message(request, COAP_TYPE_CON, COAP_POST, 0);
+          coap_set_header_uri_path(request, current_server->location);
 
-        /* generate the rd data */
-        pos = 0;
-        for(i = 0; i < MAX_OBJECTS; i++) {
-          if(objects[i] != NULL) {
-            for(j = 0; j < objects[i]->count; j++) {
-              if(objects[i]->instances[j].flag & LWM2M_INSTANCE_FLAG_USED) {
-                len = snprintf(&rd_data[pos], sizeof(rd_data) - pos,
-                               "%s<%d/%d>", pos > 0 ? "," : "",
-                               objects[i]->id, objects[i]->instances[j].id);
-                if(len > 0 && len < sizeof(rd_data) - pos) {
-                  pos += len;
-                }
-              }
-            }
+          pos = 0;
+          if(current_server->flags & SERVER_FLAG_CHANGED) {
+            pos = generate_rd_data();
+            coap_set_payload(request, (uint8_t *)rd_data, pos);
+          }
+          current_server->flags &= ~(SERVER_FLAG_CHANGED | SERVER_FLAG_UPDATED);
+
+          PRINTF("Updating registration at '%s': '%.*s'\n",
+                 current_server->location, pos, rd_data);
+          COAP_BLOCKING_REQUEST(&current_server->ipaddr,
+                                current_server->port, request,
+                                update_handler);
+          if(current_server->flags & SERVER_FLAG_UPDATED) {
+            stimer_set(&current_server->update_timer,
+                       get_update_interval(current_server));
+          } else {
+            /* The server did not accept the update - register again */
+            current_server->flags &= ~SERVER_FLAG_REGISTERED;
           }
         }
-
-        coap_set_payload(request, (uint8_t *)rd_data, pos);
-
-        printf("Registering with [");
-        uip_debug_ipaddr_print(&server_ipaddr);
-        printf("]:%u lwm2m endpoint '%s': '%.*s'\n", uip_ntohs(server_port),
-               endpoint, pos, rd_data);
-        COAP_BLOCKING_REQUEST(&server_ipaddr, server_port, request,
-                              client_chunk_handler);
       }
-      /* for now only register once...   registered = 0; */
-      etimer_set(&et, 15 * CLOCK_SECOND);
+#if LWM2M_ENGINE_QUEUE_MODE
+      if(queue_flush) {
+        /* The servers know that the node is awake - send the notifications */
+        queue_flush = 0;
+        lwm2m_notification_set_queued(0);
+      }
+#endif /* LWM2M_ENGINE_QUEUE_MODE */
+      if(is_registered()) {
+        retries = 0;
+      } else {
+        delay = get_retry_delay();
+      }
     }
+    etimer_set(&et, delay);
   }
   PROCESS_END();
 }
@@ -437,6 +997,12 @@ lwm2m_engine_init(void)
 #endif /* LWM2M_ENGINE_CLIENT_ENDPOINT_NAME */
 
   rest_init_engine();
+  lwm2m_notification_init();
+  rest_activate_resource(&bootstrap_finish, "bs");
+#if UIP_DS6_NOTIFICATIONS
+  uip_ds6_notification_add(&route_notification, route_callback);
+#endif /* UIP_DS6_NOTIFICATIONS */
+  rd_event = process_alloc_event();
   process_start(&lwm2m_rd_client, NULL);
 }
 /*---------------------------------------------------------------------------*/
@@ -496,30 +1062,129 @@ lwm2m_engine_parse_context(const lwm2m_object_t *object,
   return ret;
 }
 /*---------------------------------------------------------------------------*/
-const lwm2m_object_t *
-lwm2m_engine_get_object(uint16_t id)
+/**
+ * @brief  Find the position of an object in the sorted object table
+ *
+ * @param[in] id  Object id to search for
+ *
+ * @return The index of the object or, if not found, -1 minus the index
+ *         where the object should be inserted
+ */
+static int
+find_object_index(uint16_t id)
+{
+  int low, high, mid;
+
+  low = 0;
+  high = object_count - 1;
+  while(low <= high) {
+    mid = (low + high) / 2;
+    if(objects[mid]->id < id) {
+      low = mid + 1;
+    } else if(objects[mid]->id > id) {
+      high = mid - 1;
+    } else {
+      return mid;
+    }
+  }
+  return -1 - low;
+}
+/*---------------------------------------------------------------------------*/
+static int
+is_instances_sorted(const lwm2m_object_t *object)
 {
   int i;
-  for(i = 0; i < MAX_OBJECTS; i++) {
-    if(objects[i] != NULL && objects[i]->id == id) {
-      return objects[i];
+  for(i = 1; i < object->count; i++) {
+    if(object->instances[i - 1].id >= object->instances[i].id) {
+      return 0;
     }
   }
-  return NULL;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+is_resources_sorted(const lwm2m_instance_t *instance)
+{
+  int i;
+  for(i = 1; i < instance->count; i++) {
+    if(instance->resources[i - 1].id >= instance->resources[i].id) {
+      return 0;
+    }
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+update_object_index(const lwm2m_object_t *object)
+{
+  int index;
+  index = find_object_index(object->id);
+  if(index >= 0) {
+    if(is_instances_sorted(object)) {
+      object_flags[index] |= OBJECT_FLAG_INSTANCES_SORTED;
+    } else {
+      object_flags[index] &= ~OBJECT_FLAG_INSTANCES_SORTED;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+const lwm2m_object_t *
+lwm2m_engine_get_object(uint16_t id)
+{
+  int index;
+  index = find_object_index(id);
+  return index >= 0 ? objects[index] : NULL;
 }
 /*---------------------------------------------------------------------------*/
 int
 lwm2m_engine_register_object(const lwm2m_object_t *object)
 {
-  int i;
+  int i, index;
   int found = 0;
-  for(i = 0; i < MAX_OBJECTS; i++) {
-    if(objects[i] == NULL) {
-      objects[i] = object;
-      found = 1;
-      break;
+
+  if(object->flags & LWM2M_OBJECT_FLAG_STATIC) {
+    /* The instance table is in ROM and must already be in search order */
+    for(i = 0; i < object->count; i++) {
+      if((object->instances[i].flag & LWM2M_INSTANCE_FLAG_SORTED) == 0 ||
+         !is_resources_sorted(&object->instances[i])) {
+        PRINTF("lwm2m: static object %u has unsorted resources\n",
+               object->id);
+        return 0;
+      }
     }
   }
+
+  index = find_object_index(object->id);
+  if(index >= 0) {
+    /* Already registered - replace the old object */
+    objects[index] = object;
+    found = 1;
+  } else if(object_count < MAX_OBJECTS) {
+    index = -1 - index;
+    for(i = object_count; i > index; i--) {
+      objects[i] = objects[i - 1];
+      object_flags[i] = object_flags[i - 1];
+    }
+    objects[index] = object;
+    object_flags[index] = 0;
+    object_count++;
+    found = 1;
+  }
+
+  if(found) {
+    for(i = 0; (object->flags & LWM2M_OBJECT_FLAG_STATIC) == 0 &&
+          i < object->count; i++) {
+      if(is_resources_sorted(&object->instances[i])) {
+        object->instances[i].flag |= LWM2M_INSTANCE_FLAG_SORTED;
+      } else {
+        object->instances[i].flag &= ~LWM2M_INSTANCE_FLAG_SORTED;
+      }
+    }
+    update_object_index(object);
+    set_servers_flag(SERVER_FLAG_CHANGED);
+    rd_data_len = -1;
+  }
+
   rest_activate_resource(lwm2m_object_get_coap_resource(object),
                          (char *)object->path);
   return found;
@@ -554,9 +1219,29 @@ get_first_instance_of_object(uint16_t id, lwm2m_context_t *context)
 static const lwm2m_instance_t *
 get_instance(const lwm2m_object_t *object, lwm2m_context_t *context, int depth)
 {
-  int i;
+  int i, index, low, high;
   if(depth > 1) {
     PRINTF("lwm2m: searching for instance %u\n", context->object_instance_id);
+    index = find_object_index(object->id);
+    if(index >= 0 && objects[index] == object &&
+       (object_flags[index] & OBJECT_FLAG_INSTANCES_SORTED)) {
+      low = 0;
+      high = object->count - 1;
+      while(low <= high) {
+        i = (low + high) / 2;
+        if(object->instances[i].id < context->object_instance_id) {
+          low = i + 1;
+        } else if(object->instances[i].id > context->object_instance_id) {
+          high = i - 1;
+        } else if(object->instances[i].flag & LWM2M_INSTANCE_FLAG_USED) {
+          context->object_instance_index = i;
+          return &object->instances[i];
+        } else {
+          return NULL;
+        }
+      }
+      return NULL;
+    }
     for(i = 0; i < object->count; i++) {
       PRINTF("  Instance %d -> %u (used: %d)\n", i, object->instances[i].id,
              (object->instances[i].flag & LWM2M_INSTANCE_FLAG_USED) != 0);
@@ -573,9 +1258,25 @@ get_instance(const lwm2m_object_t *object, lwm2m_context_t *context, int depth)
 static const lwm2m_resource_t *
 get_resource(const lwm2m_instance_t *instance, lwm2m_context_t *context)
 {
-  int i;
+  int i, low, high;
   if(instance != NULL) {
     PRINTF("lwm2m: searching for resource %u\n", context->resource_id);
+    if(instance->flag & LWM2M_INSTANCE_FLAG_SORTED) {
+      low = 0;
+      high = instance->count - 1;
+      while(low <= high) {
+        i = (low + high) / 2;
+        if(instance->resources[i].id < context->resource_id) {
+          low = i + 1;
+        } else if(instance->resources[i].id > context->resource_id) {
+          high = i - 1;
+        } else {
+          context->resource_index = i;
+          return &instance->resources[i];
+        }
+      }
+      return NULL;
+    }
     for(i = 0; i < instance->count; i++) {
       PRINTF("  Resource %d -> %u\n", i, instance->resources[i].id);
       if(instance->resources[i].id == context->resource_id) {
@@ -587,6 +1288,65 @@ get_resource(const lwm2m_instance_t *instance, lwm2m_context_t *context)
   return NULL;
 }
 /*---------------------------------------------------------------------------*/
+const lwm2m_resource_t *
+lwm2m_engine_get_resource(lwm2m_context_t *context)
+{
+  const lwm2m_object_t *object;
+  const lwm2m_instance_t *instance;
+
+  object = lwm2m_engine_get_object(context->object_id);
+  if(object == NULL) {
+    return NULL;
+  }
+  instance = get_instance(object, context, 3);
+  return get_resource(instance, context);
+}
+/*---------------------------------------------------------------------------*/
+int
+lwm2m_engine_read_float32fix(uint16_t object_id, uint16_t instance_id,
+                             uint16_t resource_id, int32_t *value)
+{
+  const lwm2m_resource_t *resource;
+  lwm2m_context_t context;
+  int v;
+
+  memset(&context, 0, sizeof(context));
+  context.object_id = object_id;
+  context.object_instance_id = instance_id;
+  context.resource_id = resource_id;
+  resource = lwm2m_engine_get_resource(&context);
+  if(resource == NULL) {
+    return 0;
+  }
+
+  if(lwm2m_object_is_resource_floatfix(resource)) {
+    return lwm2m_object_get_resource_floatfix(resource, &context, value);
+  }
+  if(lwm2m_object_is_resource_int(resource)) {
+    if(lwm2m_object_get_resource_int(resource, &context, value)) {
+      *value = *value << LWM2M_FLOAT32_BITS;
+      return 1;
+    }
+  } else if(lwm2m_object_is_resource_boolean(resource)) {
+    if(lwm2m_object_get_resource_boolean(resource, &context, &v)) {
+      *value = v ? LWM2M_FLOAT32_FRAC : 0;
+      return 1;
+    }
+  } else if(lwm2m_object_is_resource_callback(resource) &&
+            resource->value.callback.read != NULL) {
+    uint8_t buf[16];
+    int len;
+    /* Let the callback format the value as text and parse it back */
+    context.writer = &lwm2m_plain_text_writer;
+    len = resource->value.callback.read(&context, buf, sizeof(buf));
+    if(len > 0 && lwm2m_plain_text_read_float32fix(buf, len, value,
+                                                   LWM2M_FLOAT32_BITS) > 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
 /**
  * @brief Write a list of object instances as a CoRE Link-format list
  */
@@ -743,6 +1503,41 @@ write_rd_json_data(const lwm2m_context_t *context,
   return rdlen;
 }
 /*---------------------------------------------------------------------------*/
+/**
+ * @brief  Set the response payload from a TLV stream and update the
+ *         block offset if more data remains
+ *
+ * @param[in]     response  The response to set the payload for
+ * @param[in]     stream    The TLV stream with output in buffer
+ * @param[in,out] offset    The block offset, set to the next offset or to
+ *                          -1 when the last block has been generated
+ */
+static void
+set_tlv_stream_response(void *response, const oma_tlv_stream_t *stream,
+                        int32_t *offset)
+{
+  uint32_t total;
+
+  total = oma_tlv_stream_get_total(stream);
+  if(stream->offset > 0 && stream->offset >= total) {
+    REST.set_response_status(response, BAD_OPTION_4_02);
+    return;
+  }
+
+  REST.set_response_payload(response, stream->buffer,
+                            oma_tlv_stream_get_length(stream));
+  REST.set_header_content_type(response, LWM2M_TLV);
+
+  if(offset == NULL) {
+    /* Notifications are not block-wise */
+  } else if(stream->offset + stream->size < total) {
+    *offset = stream->offset + stream->size;
+  } else if(stream->offset > 0) {
+    /* This was the last block */
+    *offset = -1;
+  }
+}
+/*---------------------------------------------------------------------------*/
 /**
  * @brief  Set the writer pointer to the proper writer based on the Accept: header
  *
@@ -766,6 +1561,9 @@ lwm2m_engine_select_writer(lwm2m_context_t *context, unsigned int accept)
     case APPLICATION_JSON:
       context->writer = &lwm2m_json_writer;
       break;
+    case LWM2M_SENML_CBOR:
+      context->writer = &lwm2m_senml_cbor_writer;
+      break;
     default:
       PRINTF("Unknown Accept type %u, using LWM2M plain text\n", accept);
       context->writer = &lwm2m_plain_text_writer;
@@ -793,6 +1591,9 @@ lwm2m_engine_select_reader(lwm2m_context_t *context, unsigned int content_format
     case TEXT_PLAIN:
       context->reader = &lwm2m_plain_text_reader;
       break;
+    case LWM2M_SENML_CBOR:
+      context->reader = &lwm2m_senml_cbor_reader;
+      break;
     default:
       PRINTF("Unknown content type %u, using LWM2M plain text\n", accept);
       context->reader = &lwm2m_plain_text_reader;
@@ -800,11 +1601,349 @@ lwm2m_engine_select_reader(lwm2m_context_t *context, unsigned int content_format
   }
 }
 /*---------------------------------------------------------------------------*/
-void
-lwm2m_engine_handler(const lwm2m_object_t *object,
-                     void *request, void *response,
-                     uint8_t *buffer, uint16_t preferred_size,
-                     int32_t *offset)
+static int
+is_resource_writable(const lwm2m_resource_t *resource)
+{
+  switch(resource->type) {
+  case LWM2M_RESOURCE_TYPE_STR_VARIABLE:
+  case LWM2M_RESOURCE_TYPE_STR_VARIABLE_ARRAY:
+  case LWM2M_RESOURCE_TYPE_INT_VARIABLE:
+  case LWM2M_RESOURCE_TYPE_INT_VARIABLE_ARRAY:
+  case LWM2M_RESOURCE_TYPE_FLOATFIX_VARIABLE:
+  case LWM2M_RESOURCE_TYPE_FLOATFIX_VARIABLE_ARRAY:
+  case LWM2M_RESOURCE_TYPE_BOOLEAN_VARIABLE:
+  case LWM2M_RESOURCE_TYPE_BOOLEAN_VARIABLE_ARRAY:
+    return 1;
+  case LWM2M_RESOURCE_TYPE_CALLBACK:
+    return resource->value.callback.write != NULL;
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+add_bulk_record(int count, const uint8_t *data, size_t len, uint16_t id)
+{
+  if(count >= MAX_BULK_RECORDS) {
+    return 0;
+  }
+  memset(&bulk_records[count], 0, sizeof(bulk_record_t));
+  bulk_records[count].data = data;
+  bulk_records[count].len = len;
+  bulk_records[count].id = id;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Split a TLV or SenML payload into one record per resource or resource
+   instance */
+static int
+read_bulk_records(const uint8_t *data, int len, unsigned int format)
+{
+  lwm2m_senml_cbor_iterator_t *it = &bulk_reader.senml;
+  oma_tlv_cursor_t *cursor = &bulk_reader.tlv.cursor;
+  oma_tlv_t *tlv = &bulk_reader.tlv.tlv;
+  bulk_record_t *r;
+  const uint8_t *record;
+  size_t record_len;
+  uint16_t id;
+  int count = 0, found;
+
+  if(format == LWM2M_SENML_CBOR) {
+    if(!lwm2m_senml_cbor_iterator_init(it, data, len)) {
+      return -1;
+    }
+    while((found = lwm2m_senml_cbor_next_record(it, &id, &record,
+                                                &record_len)) > 0) {
+      if(!add_bulk_record(count, record, record_len, id)) {
+        return MAX_BULK_RECORDS + 1;
+      }
+      count++;
+    }
+    return found < 0 ? -1 : count;
+  }
+
+  oma_tlv_cursor_init(cursor, data, len);
+  while((found = oma_tlv_cursor_next(cursor, tlv)) > 0) {
+    r = &bulk_records[count];
+    if(cursor->resource_id != OMA_TLV_CURSOR_NO_ID) {
+      /* A resource instance of a multiple resource */
+      if(!add_bulk_record(count, cursor->tlv, cursor->tlv_size,
+                          cursor->resource_id)) {
+        return MAX_BULK_RECORDS + 1;
+      }
+      r->flags |= BULK_FLAG_RESOURCE_INSTANCE;
+      r->resource_instance_id = tlv->id;
+    } else if(!add_bulk_record(count, cursor->tlv, cursor->tlv_size, tlv->id)) {
+      return MAX_BULK_RECORDS + 1;
+    }
+    if(cursor->instance_id != OMA_TLV_CURSOR_NO_ID) {
+      r->flags |= BULK_FLAG_INSTANCE;
+      r->instance_id = cursor->instance_id;
+    }
+    count++;
+  }
+  return found < 0 ? -1 : count;
+}
+/*---------------------------------------------------------------------------*/
+/* Order of the records: by instance, resource and resource instance */
+static int
+bulk_record_cmp(const bulk_record_t *a, const bulk_record_t *b)
+{
+  if(a->instance_id != b->instance_id) {
+    return a->instance_id < b->instance_id ? -1 : 1;
+  }
+  if(a->id != b->id) {
+    return a->id < b->id ? -1 : 1;
+  }
+  if(a->resource_instance_id != b->resource_instance_id) {
+    return a->resource_instance_id < b->resource_instance_id ? -1 : 1;
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Decode a string value and check that it fits its resource. A TLV
+ * string is used where it is in the payload, other formats are decoded
+ * into the scratch buffer, which is then used until the string has
+ * been written.
+ */
+static size_t
+decode_string(bulk_record_t *r, const lwm2m_context_t *context,
+              uint8_t *buffer, uint16_t size)
+{
+  oma_tlv_t tlv;
+  size_t max;
+
+  max = r->resource->type == LWM2M_RESOURCE_TYPE_STR_VARIABLE ?
+    r->resource->value.stringvar.size : r->resource->value.stringvararr.size;
+  r->string = NULL;
+  if(context->reader == &oma_tlv_reader) {
+    if(oma_tlv_read(&tlv, r->data, r->len) == 0 || tlv.length > max) {
+      return 0;
+    }
+    r->string = tlv.value;
+    r->value = tlv.length;
+    return r->len;
+  }
+  if(max >= size) {
+    max = size - 1;
+  }
+  if(context->reader->read_string(context, r->data, r->len,
+                                  buffer, max + 1) == 0) {
+    return 0;
+  }
+  r->value = strlen((const char *)buffer);
+  return r->len;
+}
+/*---------------------------------------------------------------------------*/
+/* Set up the context for the resource of a record */
+static void
+set_record_context(const bulk_record_t *r, lwm2m_context_t *context)
+{
+  context->object_instance_id = r->instance_id;
+  context->object_instance_index = r->instance_index;
+  context->resource_id = r->id;
+  context->resource_index = r->resource - r->instance->resources;
+  context->resource_instance_id = r->resource_instance_id;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Write resources from a TLV or SenML payload, either to one instance
+ * or, when instance is NULL, to the instances of the object given in
+ * the TLV payload. All values are decoded and checked before any of
+ * them is written, and the resources of each instance are found in
+ * one pass over its resource table when it is sorted. When creating
+ * an instance, resources that do not exist or can not be written are
+ * skipped instead of failing the request. Returns the CoAP status of
+ * the write.
+ */
+static int
+write_resources(const lwm2m_object_t *object, const lwm2m_instance_t *instance,
+                lwm2m_context_t *context, const uint8_t *data, int len,
+                unsigned int format, int create, uint8_t *buffer,
+                uint16_t size)
+{
+  const lwm2m_instance_t *current = NULL;
+  bulk_record_t *r;
+  bulk_record_t tmp;
+  size_t n;
+  int count, i, j, k = 0;
+
+  if(format != LWM2M_TLV &&
+     (format != LWM2M_SENML_CBOR || instance == NULL)) {
+    return NOT_ACCEPTABLE_4_06;
+  }
+  count = read_bulk_records(data, len, format);
+  if(count < 0) {
+    return BAD_REQUEST_4_00;
+  }
+  if(count > MAX_BULK_RECORDS) {
+    return REQUEST_ENTITY_TOO_LARGE_4_13;
+  }
+
+  /* Find the instance of each record */
+  for(i = 0; i < count; i++) {
+    r = &bulk_records[i];
+    if(instance != NULL) {
+      if((r->flags & BULK_FLAG_INSTANCE) &&
+         r->instance_id != context->object_instance_id) {
+        /* Only the addressed instance can be written */
+        return BAD_REQUEST_4_00;
+      }
+      r->instance_id = context->object_instance_id;
+      r->instance_index = context->object_instance_index;
+      r->instance = instance;
+    } else {
+      if((r->flags & BULK_FLAG_INSTANCE) == 0) {
+        return BAD_REQUEST_4_00;
+      }
+      /* The context is set up for each record further down anyway */
+      context->object_instance_id = r->instance_id;
+      r->instance = get_instance(object, context, 2);
+      if(r->instance == NULL) {
+        return NOT_FOUND_4_04;
+      }
+      r->instance_index = context->object_instance_index;
+    }
+  }
+
+  /* The payload is normally in order already */
+  for(i = 1; i < count; i++) {
+    for(j = i; j > 0 &&
+          bulk_record_cmp(&bulk_records[j - 1], &bulk_records[j]) > 0; j--) {
+      tmp = bulk_records[j];
+      bulk_records[j] = bulk_records[j - 1];
+      bulk_records[j - 1] = tmp;
+    }
+  }
+
+  /* Find the resources and decode the new values */
+  for(i = 0; i < count; i++) {
+    r = &bulk_records[i];
+    if(r->instance != current) {
+      current = r->instance;
+      k = 0;
+    }
+    context->object_instance_id = r->instance_id;
+    context->object_instance_index = r->instance_index;
+    context->resource_id = r->id;
+    if(current->flag & LWM2M_INSTANCE_FLAG_SORTED) {
+      while(k < current->count && current->resources[k].id < r->id) {
+        k++;
+      }
+      if(k < current->count && current->resources[k].id == r->id) {
+        r->resource = &current->resources[k];
+      } else {
+        r->resource = NULL;
+      }
+    } else {
+      r->resource = get_resource(current, context);
+    }
+    if(r->resource == NULL || !is_resource_writable(r->resource)) {
+      if(create) {
+        r->resource = NULL;
+        continue;
+      }
+      PRINTF("lwm2m: can not write resource %u\n", r->id);
+      return r->resource == NULL ? NOT_FOUND_4_04 : METHOD_NOT_ALLOWED_4_05;
+    }
+    set_record_context(r, context);
+
+    if(lwm2m_object_is_resource_callback(r->resource)) {
+      /* Callbacks decode their own value, and resource instances */
+      continue;
+    }
+    if(r->flags & BULK_FLAG_RESOURCE_INSTANCE) {
+      /* Only callbacks have resource instances */
+      n = 0;
+    } else if(lwm2m_object_is_resource_string(r->resource)) {
+      n = decode_string(r, context, buffer, size);
+    } else if(lwm2m_object_is_resource_int(r->resource)) {
+      n = context->reader->read_int(context, r->data, r->len, &r->value);
+    } else if(lwm2m_object_is_resource_floatfix(r->resource)) {
+      n = context->reader->read_float32fix(context, r->data, r->len,
+                                           &r->value, LWM2M_FLOAT32_BITS);
+    } else {
+      int value;
+      n = context->reader->read_boolean(context, r->data, r->len, &value);
+      r->value = value;
+    }
+    if(n == 0) {
+      PRINTF("lwm2m: bad value for resource %u\n", r->id);
+      return BAD_REQUEST_4_00;
+    }
+  }
+
+  /* Apply the values before the callbacks, which may use the scratch
+     buffer for their output */
+  for(i = 0; i < count; i++) {
+    r = &bulk_records[i];
+    if(r->resource == NULL || lwm2m_object_is_resource_callback(r->resource)) {
+      continue;
+    }
+    set_record_context(r, context);
+    if(lwm2m_object_is_resource_string(r->resource)) {
+      if(r->string == NULL) {
+        /* The scratch buffer only holds one string, decode it again */
+        decode_string(r, context, buffer, size);
+      }
+      lwm2m_object_set_resource_string(r->resource, context, r->value,
+                                       r->string != NULL ? r->string : buffer);
+    } else if(lwm2m_object_is_resource_int(r->resource)) {
+      lwm2m_object_set_resource_int(r->resource, context, r->value);
+    } else if(lwm2m_object_is_resource_floatfix(r->resource)) {
+      lwm2m_object_set_resource_floatfix(r->resource, context, r->value);
+    } else if(lwm2m_object_is_resource_boolean(r->resource)) {
+      lwm2m_object_set_resource_boolean(r->resource, context, r->value != 0);
+    }
+  }
+  for(i = 0; i < count; i++) {
+    r = &bulk_records[i];
+    if(r->resource == NULL || !lwm2m_object_is_resource_callback(r->resource)) {
+      continue;
+    }
+    set_record_context(r, context);
+    r->resource->value.callback.write(context, r->data, r->len, buffer, size);
+  }
+  return create ? CREATED_2_01 : CHANGED_2_04;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * The access rights the server of the request has to the object
+ * instance, or to the object for Create. The bootstrap server has
+ * full access, and so have notifications.
+ */
+static uint8_t
+get_request_access(const lwm2m_context_t *context, int depth, int create)
+{
+  int i;
+
+  if(lwm2m_notification_is_notifying()) {
+    /* Not a request - the observation has already been allowed */
+    return LWM2M_ACCESS_CONTROL_ALL;
+  }
+  if(has_bootstrap_server_info
+     && UIP_UDP_BUF->srcport == bs_server_port
+     && uip_ipaddr_cmp(&UIP_IP_BUF->srcipaddr, &bs_server_ipaddr)) {
+    return LWM2M_ACCESS_CONTROL_ALL;
+  }
+  for(i = 0; i < MAX_SERVERS; i++) {
+    if((servers[i].flags & SERVER_FLAG_USED)
+       && servers[i].port == UIP_UDP_BUF->srcport
+       && uip_ipaddr_cmp(&servers[i].ipaddr, &UIP_IP_BUF->srcipaddr)) {
+      break;
+    }
+  }
+  return lwm2m_access_control_get(i < MAX_SERVERS ? i : -1,
+                                  context->object_id,
+                                  depth < 2 || create ?
+                                  LWM2M_ACCESS_CONTROL_OBJECT :
+                                  context->object_instance_id);
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_request(const lwm2m_object_t *object, request_context_t *rc,
+               void *request, void *response,
+               uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
 {
   int len;
   const char *url;
@@ -812,15 +1951,23 @@ lwm2m_engine_handler(const lwm2m_object_t *object,
   unsigned int accept;
   unsigned int content_type;
   int depth;
-  lwm2m_context_t context;
+  lwm2m_context_t *const context = &rc->context;
   rest_resource_flags_t method;
   const lwm2m_instance_t *instance;
+  uint8_t access;
 #if (DEBUG) & DEBUG_PRINT
   const char *method_str;
 #endif /* (DEBUG) & DEBUG_PRINT */
 
   method = REST.get_method_type(request);
 
+#if LWM2M_ENGINE_QUEUE_MODE
+  if(queue_awake) {
+    /* The server is active - stay awake a while longer */
+    queue_stay_awake();
+  }
+#endif /* LWM2M_ENGINE_QUEUE_MODE */
+
   len = REST.get_url(request, &url);
   if(!REST.get_header_content_type(request, &format)) {
     PRINTF("No format given. Assume text plain...\n");
@@ -834,13 +1981,13 @@ lwm2m_engine_handler(const lwm2m_object_t *object,
     accept = format;
   }
 
-  depth = lwm2m_engine_parse_context(object, url, len, &context);
-  PRINTF("Context: %u/%u/%u  found: %d\n", context.object_id,
-         context.object_instance_id, context.resource_id, depth);
+  depth = lwm2m_engine_parse_context(object, url, len, context);
+  PRINTF("Context: %u/%u/%u  found: %d\n", context->object_id,
+         context->object_instance_id, context->resource_id, depth);
 
   /* Select reader and writer based on provided Content type and Accept headers */
-  lwm2m_engine_select_reader(&context, format);
-  content_type = lwm2m_engine_select_writer(&context, accept);
+  lwm2m_engine_select_reader(context, format);
+  content_type = lwm2m_engine_select_writer(context, accept);
 
 #if (DEBUG) & DEBUG_PRINT
   /* for debugging */
@@ -867,29 +2014,78 @@ lwm2m_engine_handler(const lwm2m_object_t *object,
   }
 #endif /* (DEBUG) & DEBUG_PRINT */
 
-  instance = get_instance(object, &context, depth);
+  instance = get_instance(object, context, depth);
+
+  if(method == METHOD_GET) {
+    access = LWM2M_ACCESS_CONTROL_READ;
+  } else if(depth == 3 && method == METHOD_POST) {
+    access = LWM2M_ACCESS_CONTROL_EXECUTE;
+  } else if(depth == 1 && method == METHOD_POST) {
+    access = LWM2M_ACCESS_CONTROL_CREATE;
+  } else if(depth > 1 && instance == NULL) {
+    access = LWM2M_ACCESS_CONTROL_CREATE;
+  } else {
+    access = LWM2M_ACCESS_CONTROL_WRITE;
+  }
+  if((get_request_access(context, depth,
+                         access == LWM2M_ACCESS_CONTROL_CREATE)
+      & access) == 0) {
+    PRINTF("lwm2m: access %u denied\n", access);
+    REST.set_response_status(response, UNAUTHORIZED_4_01);
+    return;
+  }
+
+  if(method != METHOD_GET) {
+    /* The request might change persisted state */
+    lwm2m_store_changed();
+  }
+
+  if(method == METHOD_PUT) {
+    const char *query;
+    int query_len;
+    query_len = REST.get_query(request, &query);
+    if(query_len > 0 && lwm2m_notification_has_attributes(query, query_len)) {
+      /* Write-Attributes */
+      if((depth > 1 && instance == NULL) ||
+         (depth > 2 && get_resource(instance, context) == NULL)) {
+        REST.set_response_status(response, NOT_FOUND_4_04);
+      } else if(lwm2m_notification_write_attributes(context, depth,
+                                                    query, query_len)) {
+        REST.set_response_status(response, CHANGED_2_04);
+      } else {
+        REST.set_response_status(response, BAD_REQUEST_4_00);
+      }
+      return;
+    }
+  } else if(method == METHOD_GET) {
+    uint32_t observe;
+    if(coap_get_header_observe(request, &observe) && observe == 0) {
+      /* A new observation - the response counts as first notification */
+      lwm2m_notification_observe(url, len);
+    }
+  }
 
   /* from POST */
   if(depth > 1 && instance == NULL) {
     if(method != METHOD_PUT && method != METHOD_POST) {
-      PRINTF("Error - do not have instance %d\n", context.object_instance_id);
+      PRINTF("Error - do not have instance %d\n", context->object_instance_id);
       REST.set_response_status(response, NOT_FOUND_4_04);
       return;
     } else {
       const uint8_t *data;
-      int i, len, plen, pos;
-      oma_tlv_t tlv;
-      PRINTF(">>> CREATE ? %d/%d\n", context.object_id,
-             context.object_instance_id);
+      int i, plen, status;
+      PRINTF(">>> CREATE ? %d/%d\n", context->object_id,
+             context->object_instance_id);
+
+      if(object->flags & LWM2M_OBJECT_FLAG_STATIC) {
+        /* The instances of a static object are fixed at compile time */
+        REST.set_response_status(response, METHOD_NOT_ALLOWED_4_05);
+        return;
+      }
 
       for(i = 0; i < object->count; i++) {
         if((object->instances[i].flag & LWM2M_INSTANCE_FLAG_USED) == 0) {
-          /* allocate this instance */
-          object->instances[i].flag |= LWM2M_INSTANCE_FLAG_USED;
-          object->instances[i].id = context.object_instance_id;
-          context.object_instance_index = i;
-          PRINTF("Created instance: %d\n", context.object_instance_id);
-          REST.set_response_status(response, CREATED_2_01);
+          context->object_instance_index = i;
           instance = &object->instances[i];
           break;
         }
@@ -902,87 +2098,71 @@ lwm2m_engine_handler(const lwm2m_object_t *object,
       }
 
       plen = REST.get_request_payload(request, &data);
-      if(plen == 0) {
-        /* do nothing more */
-        return;
+      status = CREATED_2_01;
+      if(plen > 0) {
+        status = write_resources(object, instance, context, data, plen,
+                                 format, 1, buffer, preferred_size);
       }
-      PRINTF("Payload: ");
-      for(i = 0; i < plen; i++) {
-        PRINTF("%02x", data[i]);
+      if(status == CREATED_2_01) {
+        /* allocate this instance */
+        object->instances[i].flag |= LWM2M_INSTANCE_FLAG_USED;
+        object->instances[i].id = context->object_instance_id;
+        /* The new instance id might break the instance ordering */
+        update_object_index(object);
+        set_servers_flag(SERVER_FLAG_CHANGED);
+        rd_data_len = -1;
+        PRINTF("Created instance: %d\n", context->object_instance_id);
       }
-      PRINTF("\n");
-
-      pos = 0;
-      do {
-        len = oma_tlv_read(&tlv, (uint8_t *)&data[pos], plen - pos);
-        PRINTF("Found TLV type=%u id=%u len=%lu\n",
-               tlv.type, tlv.id, (unsigned long)tlv.length);
-        /* here we need to do callbacks or write value */
-        if(tlv.type == OMA_TLV_TYPE_RESOURCE) {
-          context.resource_id = tlv.id;
-          const lwm2m_resource_t *rsc = get_resource(instance, &context);
-          if(rsc != NULL) {
-            /* write the value to the resource */
-            if(lwm2m_object_is_resource_string(rsc)) {
-              PRINTF("  new string value for /%d/%d/%d = %.*s\n",
-                     context.object_id, context.object_instance_id,
-                     context.resource_id, (int)tlv.length, tlv.value);
-              lwm2m_object_set_resource_string(rsc, &context,
-                                               tlv.length, tlv.value);
-            } else if(lwm2m_object_is_resource_int(rsc)) {
-              PRINTF("  new int value for /%d/%d/%d = %" PRId32 "\n",
-                     context.object_id, context.object_instance_id,
-                     context.resource_id, oma_tlv_get_int32(&tlv));
-              lwm2m_object_set_resource_int(rsc, &context,
-                                            oma_tlv_get_int32(&tlv));
-            } else if(lwm2m_object_is_resource_floatfix(rsc)) {
-              int32_t value;
-              if(oma_tlv_float32_to_fix(&tlv, &value, LWM2M_FLOAT32_BITS)) {
-                PRINTF("  new float value for /%d/%d/%d = %" PRId32 "\n",
-                     context.object_id, context.object_instance_id,
-                     context.resource_id, value >> LWM2M_FLOAT32_BITS);
-                lwm2m_object_set_resource_floatfix(rsc, &context, value);
-              } else {
-                PRINTF("  new float value for /%d/%d/%d: FAILED\n",
-                     context.object_id, context.object_instance_id,
-                     context.resource_id);
-              }
-            } else if(lwm2m_object_is_resource_boolean(rsc)) {
-              PRINTF("  new boolean value for /%d/%d/%d = %" PRId32 "\n",
-                     context.object_id, context.object_instance_id,
-                     context.resource_id, oma_tlv_get_int32(&tlv));
-              lwm2m_object_set_resource_boolean(rsc, &context,
-                                                oma_tlv_get_int32(&tlv) != 0);
-            }
-          }
-        }
-        pos = pos + len;
-      } while(len > 0 && pos < plen);
+      REST.set_response_status(response, status);
     }
     return;
   }
 
   if(depth == 3) {
-    const lwm2m_resource_t *resource = get_resource(instance, &context);
+    const lwm2m_resource_t *resource = get_resource(instance, context);
     size_t content_len = 0;
     if(resource == NULL) {
-      PRINTF("Error - do not have resource %d\n", context.resource_id);
+      PRINTF("Error - do not have resource %d\n", context->resource_id);
       REST.set_response_status(response, NOT_FOUND_4_04);
       return;
     }
     /* HANDLE PUT */
     if(method == METHOD_PUT) {
-      if(lwm2m_object_is_resource_callback(resource)) {
+      if(lwm2m_object_is_resource_callback(resource)
+         && resource->value.callback.write_block != NULL
+         && format != LWM2M_TLV) {
+        const uint8_t *data;
+        uint32_t block_num = 0;
+        uint32_t block_offset = 0;
+        uint16_t block_size = 0;
+        uint8_t more = 0;
+        int plen = REST.get_request_payload(request, &data);
+        int has_block1;
+
+        /* Pass each fragment on as it arrives instead of assembling it */
+        has_block1 = coap_get_header_block1(request, &block_num, &more,
+                                            &block_size, &block_offset);
+        PRINTF("PUT block callback offset %lu len %d%s\n",
+               (unsigned long)block_offset, plen, more ? " (more)" : "");
+        if(resource->value.callback.write_block(context, block_offset,
+                                                data, plen, more) < 0) {
+          REST.set_response_status(response, INTERNAL_SERVER_ERROR_5_00);
+        } else if(has_block1) {
+          coap_set_header_block1(response, block_num, more, block_size);
+          REST.set_response_status(response,
+                                   more ? CONTINUE_2_31 : CHANGED_2_04);
+        } else {
+          REST.set_response_status(response, CHANGED_2_04);
+        }
+      } else if(lwm2m_object_is_resource_callback(resource)) {
         if(resource->value.callback.write != NULL) {
           /* pick a reader ??? */
-          if(format == LWM2M_TEXT_PLAIN) {
-            /* a string */
+          if(format == LWM2M_TEXT_PLAIN || format == LWM2M_SENML_CBOR) {
+            /* a single value - the reader was selected from the format */
             const uint8_t *data;
             int plen = REST.get_request_payload(request, &data);
-            context.reader = &lwm2m_plain_text_reader;
             PRINTF("PUT Callback with data: '%.*s'\n", plen, data);
-            /* no specific reader for plain text */
-            content_len = resource->value.callback.write(&context, data, plen,
+            content_len = resource->value.callback.write(context, data, plen,
                                                     buffer, preferred_size);
             PRINTF("content_len:%u\n", (unsigned int)content_len);
             REST.set_response_status(response, CHANGED_2_04);
@@ -994,6 +2174,18 @@ lwm2m_engine_handler(const lwm2m_object_t *object,
           PRINTF("PUT - no write callback\n");
           REST.set_response_status(response, METHOD_NOT_ALLOWED_4_05);
         }
+      } else if(format == LWM2M_TLV || format == LWM2M_SENML_CBOR) {
+        /* The same as writing the instance with only this resource */
+        const uint8_t *data;
+        int plen = REST.get_request_payload(request, &data);
+        const lwm2m_instance_t single = { instance->id, 1,
+                                          LWM2M_INSTANCE_FLAG_USED |
+                                          LWM2M_INSTANCE_FLAG_SORTED,
+                                          resource };
+        REST.set_response_status(response,
+                                 write_resources(object, &single, context,
+                                                 data, plen, format, 0,
+                                                 buffer, preferred_size));
       } else {
         PRINTF("PUT on non-callback resource!\n");
         REST.set_response_status(response, METHOD_NOT_ALLOWED_4_05);
@@ -1002,30 +2194,30 @@ lwm2m_engine_handler(const lwm2m_object_t *object,
     } else if(method == METHOD_GET) {
       if(lwm2m_object_is_resource_string(resource)) {
         const uint8_t *value;
-        value = lwm2m_object_get_resource_string(resource, &context);
+        value = lwm2m_object_get_resource_string(resource, context);
         if(value != NULL) {
-          uint16_t len = lwm2m_object_get_resource_strlen(resource, &context);
+          uint16_t len = lwm2m_object_get_resource_strlen(resource, context);
           PRINTF("Get string value: %.*s\n", (int)len, (char *)value);
-          content_len = context.writer->write_string(&context, buffer,
+          content_len = context->writer->write_string(context, buffer,
             preferred_size, (const char *)value, len);
         }
       } else if(lwm2m_object_is_resource_int(resource)) {
         int32_t value;
-        if(lwm2m_object_get_resource_int(resource, &context, &value)) {
-          content_len = context.writer->write_int(&context, buffer, preferred_size, value);
+        if(lwm2m_object_get_resource_int(resource, context, &value)) {
+          content_len = context->writer->write_int(context, buffer, preferred_size, value);
         }
       } else if(lwm2m_object_is_resource_floatfix(resource)) {
         int32_t value;
-        if(lwm2m_object_get_resource_floatfix(resource, &context, &value)) {
+        if(lwm2m_object_get_resource_floatfix(resource, context, &value)) {
           /* export FLOATFIX */
           PRINTF("Exporting %d-bit fix as float: %" PRId32 "\n",
                  LWM2M_FLOAT32_BITS, value);
-          content_len = context.writer->write_float32fix(&context, buffer,
+          content_len = context->writer->write_float32fix(context, buffer,
             preferred_size, value, LWM2M_FLOAT32_BITS);
         }
       } else if(lwm2m_object_is_resource_callback(resource)) {
         if(resource->value.callback.read != NULL) {
-          content_len = resource->value.callback.read(&context,
+          content_len = resource->value.callback.read(context,
                                                  buffer, preferred_size);
         } else {
           REST.set_response_status(response, METHOD_NOT_ALLOWED_4_05);
@@ -1046,9 +2238,11 @@ lwm2m_engine_handler(const lwm2m_object_t *object,
           const uint8_t *data;
           int plen = REST.get_request_payload(request, &data);
           PRINTF("Execute Callback with data: '%.*s'\n", plen, data);
-          content_len = resource->value.callback.exec(&context,
+          exec_request = request;
+          content_len = resource->value.callback.exec(context,
                                                  data, plen,
                                                  buffer, preferred_size);
+          exec_request = NULL;
           REST.set_response_status(response, CHANGED_2_04);
         } else {
           PRINTF("Execute callback - no exec callback\n");
@@ -1061,17 +2255,32 @@ lwm2m_engine_handler(const lwm2m_object_t *object,
     }
   } else if(depth == 2) {
     /* produce an instance response */
-    if(method != METHOD_GET) {
+    if(method == METHOD_PUT || method == METHOD_POST) {
+      /* Write several resources of the instance in one request */
+      const uint8_t *data;
+      int plen = REST.get_request_payload(request, &data);
+      REST.set_response_status(response,
+                               write_resources(object, instance, context,
+                                               data, plen, format, 0,
+                                               buffer, preferred_size));
+    } else if(method != METHOD_GET) {
       REST.set_response_status(response, METHOD_NOT_ALLOWED_4_05);
     } else if(instance == NULL) {
       REST.set_response_status(response, NOT_FOUND_4_04);
+    } else if(accept == LWM2M_TLV) {
+      oma_tlv_stream_t *const stream = &rc->stream;
+      /* Serialize directly into the payload buffer, one block at a time */
+      oma_tlv_stream_init(stream, buffer, preferred_size,
+                          offset != NULL ? *offset : 0);
+      oma_tlv_writer_stream_instance(context, instance, stream);
+      set_tlv_stream_response(response, stream, offset);
     } else {
       int rdlen;
       if(accept == APPLICATION_LINK_FORMAT) {
         rdlen = write_rd_link_data(object, instance,
                                    (char *)buffer, preferred_size);
       } else {
-        rdlen = write_rd_json_data(&context, object, instance,
+        rdlen = write_rd_json_data(context, object, instance,
                                    (char *)buffer, preferred_size);
       }
       if(rdlen < 0) {
@@ -1088,8 +2297,23 @@ lwm2m_engine_handler(const lwm2m_object_t *object,
     }
   } else if(depth == 1) {
     /* produce a list of instances */
-    if(method != METHOD_GET) {
+    if(method == METHOD_PUT || method == METHOD_POST) {
+      /* Write resources of the instances given in the TLV payload */
+      const uint8_t *data;
+      int plen = REST.get_request_payload(request, &data);
+      REST.set_response_status(response,
+                               write_resources(object, NULL, context,
+                                               data, plen, format, 0,
+                                               buffer, preferred_size));
+    } else if(method != METHOD_GET) {
       REST.set_response_status(response, METHOD_NOT_ALLOWED_4_05);
+    } else if(accept == LWM2M_TLV) {
+      oma_tlv_stream_t *const stream = &rc->stream;
+      PRINTF("Sending TLV for object %u\n", object->id);
+      oma_tlv_stream_init(stream, buffer, preferred_size,
+                          offset != NULL ? *offset : 0);
+      oma_tlv_writer_stream_object(context, object, stream);
+      set_tlv_stream_response(response, stream, offset);
     } else {
       int rdlen;
       PRINTF("Sending instance list for object %u\n", object->id);
@@ -1107,21 +2331,72 @@ lwm2m_engine_handler(const lwm2m_object_t *object,
 }
 /*---------------------------------------------------------------------------*/
 void
+lwm2m_engine_handler(const lwm2m_object_t *object,
+                     void *request, void *response,
+                     uint8_t *buffer, uint16_t preferred_size,
+                     int32_t *offset)
+{
+  if(request_depth >= REQUEST_CONTEXTS) {
+    PRINTF("Too many nested requests\n");
+    REST.set_response_status(response, SERVICE_UNAVAILABLE_5_03);
+    return;
+  }
+  handle_request(object, &request_contexts[request_depth++],
+                 request, response, buffer, preferred_size, offset);
+  request_depth--;
+  if(REST.get_method_type(request) != METHOD_GET &&
+     (object->id == LWM2M_OBJECT_SERVER_ID ||
+      object->id == LWM2M_OBJECT_ACCESS_CONTROL_ID)) {
+    /* The access rights might have changed */
+    lwm2m_access_control_update();
+  }
+}
+/*---------------------------------------------------------------------------*/
+coap_separate_slot_t *
+lwm2m_engine_defer_execute(coap_separate_timeout_callback_t timeout,
+                           void *user_data)
+{
+  if(exec_request == NULL) {
+    PRINTF("Execute can only be deferred from an exec callback\n");
+    return NULL;
+  }
+  return coap_separate_pool_accept(exec_request, timeout, user_data);
+}
+/*---------------------------------------------------------------------------*/
+void
+lwm2m_engine_complete_execute(coap_separate_slot_t *execute, int success)
+{
+  coap_separate_pool_respond(execute, success ? CHANGED_2_04 :
+                             INTERNAL_SERVER_ERROR_5_00, -1, NULL, 0);
+}
+/*---------------------------------------------------------------------------*/
+void
 lwm2m_engine_delete_handler(const lwm2m_object_t *object, void *request,
                             void *response, uint8_t *buffer,
                             uint16_t preferred_size, int32_t *offset)
 {
   int len;
   const char *url;
-  lwm2m_context_t context;
+  lwm2m_context_t *context;
+
+  if(request_depth >= REQUEST_CONTEXTS) {
+    REST.set_response_status(response, SERVICE_UNAVAILABLE_5_03);
+    return;
+  }
+  context = &request_contexts[request_depth].context;
 
   len = REST.get_url(request, &url);
   PRINTF("*** DELETE URI:'%.*s' called... - responding with DELETED.\n",
          len, url);
-  len = lwm2m_engine_parse_context(object, url, len, &context);
-  PRINTF("Context: %u/%u/%u  found: %d\n", context.object_id,
-         context.object_instance_id, context.resource_id, len);
+  len = lwm2m_engine_parse_context(object, url, len, context);
+  PRINTF("Context: %u/%u/%u  found: %d\n", context->object_id,
+         context->object_instance_id, context->resource_id, len);
 
+  if((get_request_access(context, len, 0)
+      & LWM2M_ACCESS_CONTROL_DELETE) == 0) {
+    REST.set_response_status(response, UNAUTHORIZED_4_01);
+    return;
+  }
   REST.set_response_status(response, DELETED_2_02);
 }
 /*---------------------------------------------------------------------------*/
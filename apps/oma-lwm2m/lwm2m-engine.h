@@ -45,6 +45,32 @@
 #define LWM2M_ENGINE_H
 
 #include "lwm2m-object.h"
+#include "er-coap-separate.h"
+
+/* Number of LWM2M servers to register with */
+#ifdef LWM2M_ENGINE_CONF_MAX_SERVERS
+#define LWM2M_ENGINE_MAX_SERVERS LWM2M_ENGINE_CONF_MAX_SERVERS
+#else /* LWM2M_ENGINE_CONF_MAX_SERVERS */
+#define LWM2M_ENGINE_MAX_SERVERS 2
+#endif /* LWM2M_ENGINE_CONF_MAX_SERVERS */
+
+/*
+ * Queue mode (UQ binding) lets the radio sleep between registration
+ * updates. Notifications are held back while the radio is off and sent
+ * after the next Update.
+ */
+#ifdef LWM2M_ENGINE_CONF_QUEUE_MODE
+#define LWM2M_ENGINE_QUEUE_MODE LWM2M_ENGINE_CONF_QUEUE_MODE
+#else /* LWM2M_ENGINE_CONF_QUEUE_MODE */
+#define LWM2M_ENGINE_QUEUE_MODE 0
+#endif /* LWM2M_ENGINE_CONF_QUEUE_MODE */
+
+/* Seconds to stay awake in queue mode after the last server request */
+#ifdef LWM2M_ENGINE_CONF_QUEUE_MODE_AWAKE_TIME
+#define LWM2M_ENGINE_QUEUE_MODE_AWAKE_TIME LWM2M_ENGINE_CONF_QUEUE_MODE_AWAKE_TIME
+#else /* LWM2M_ENGINE_CONF_QUEUE_MODE_AWAKE_TIME */
+#define LWM2M_ENGINE_QUEUE_MODE_AWAKE_TIME 10
+#endif /* LWM2M_ENGINE_CONF_QUEUE_MODE_AWAKE_TIME */
 
 #define LWM2M_FLOAT32_BITS  10
 #define LWM2M_FLOAT32_FRAC (1L << LWM2M_FLOAT32_BITS)
@@ -54,7 +80,8 @@ typedef enum {
   LWM2M_TEXT_PLAIN = 1541,
   LWM2M_TLV        = 1542,
   LWM2M_JSON       = 1543,
-  LWM2M_OPAQUE     = 1544
+  LWM2M_OPAQUE     = 1544,
+  LWM2M_SENML_CBOR = 112    /* application/senml+cbor */
 } lwm2m_content_format_t;
 
 void lwm2m_engine_init(void);
@@ -68,6 +95,37 @@ const lwm2m_object_t *lwm2m_engine_get_object(uint16_t id);
 
 int lwm2m_engine_register_object(const lwm2m_object_t *object);
 
+/*
+ * Find the resource addressed by the object, instance, and resource id
+ * of the context. The instance and resource indices of the context are
+ * updated. Returns NULL if the resource does not exist.
+ */
+const lwm2m_resource_t *lwm2m_engine_get_resource(lwm2m_context_t *context);
+
+/*
+ * Get the address of registration server number index. Returns 0 if the
+ * node is not registered with the server or can not currently reach it.
+ */
+int lwm2m_engine_get_server(int index, uip_ipaddr_t *ipaddr, uint16_t *port);
+
+/* Read the numeric value of a resource as LWM2M_FLOAT32_BITS fixpoint */
+int lwm2m_engine_read_float32fix(uint16_t object_id, uint16_t instance_id,
+                                 uint16_t resource_id, int32_t *value);
+
+/*
+ * Defer the response to the Execute being handled. Called from an exec
+ * callback that finishes later; the response is then sent with
+ * lwm2m_engine_complete_execute(). Returns NULL if the request could
+ * not be deferred, and the callback must then not start any work. The
+ * timeout callback is called if the execution is not completed within
+ * COAP_SEPARATE_LIFETIME seconds.
+ */
+coap_separate_slot_t *lwm2m_engine_defer_execute(coap_separate_timeout_callback_t timeout,
+                                                 void *user_data);
+
+/* Send the response to a deferred Execute, 2.04 on success */
+void lwm2m_engine_complete_execute(coap_separate_slot_t *execute, int success);
+
 void lwm2m_engine_handler(const lwm2m_object_t *object,
                           void *request, void *response,
                           uint8_t *buffer, uint16_t preferred_size,
@@ -0,0 +1,620 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \addtogroup oma-lwm2m
+ * @{
+ */
+
+/**
+ * \file
+ *         Implementation of the Contiki OMA LWM2M firmware update object.
+ *         The firmware package is either received using Block1 transfers
+ *         or, when the server gives a Package URI, downloaded with a
+ *         window of Block2 requests. Each block is written directly to
+ *         the file system and added to a CRC of the image.
+ */
+
+#include "lwm2m-object.h"
+#include "lwm2m-engine.h"
+#include "lwm2m-firmware.h"
+#include "cfs/cfs.h"
+#include "lib/crc16.h"
+#if LWM2M_FIRMWARE_PULL
+#include "er-coap-engine.h"
+#include "er-coap-request.h"
+#include "net/ip/uiplib.h"
+#include <stdlib.h>
+#include <string.h>
+#endif /* LWM2M_FIRMWARE_PULL */
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+static int32_t state = LWM2M_FIRMWARE_STATE_IDLE;
+static int32_t result = LWM2M_FIRMWARE_RESULT_INITIAL;
+static int fd = -1;
+static uint32_t received;
+static uint16_t crc;
+static lwm2m_firmware_update_callback_t update_callback;
+static lwm2m_firmware_async_update_callback_t async_update_callback;
+static lwm2m_firmware_verify_callback_t verify_callback;
+static coap_separate_slot_t *pending_update;
+
+#if LWM2M_FIRMWARE_PULL
+#define BLOCK_FREE     0
+#define BLOCK_PENDING  1
+#define BLOCK_RECEIVED 2
+#define BLOCK_FAILED   3
+
+/* A block being downloaded */
+struct download_block {
+  coap_request_state_t request;
+  uint32_t offset;
+  uint16_t len;
+  uint8_t status;
+  uint8_t more;
+  uint8_t data[REST_MAX_CHUNK_SIZE];
+};
+
+static struct download_block blocks[LWM2M_FIRMWARE_WINDOW];
+static coap_packet_t download_request;
+static uip_ipaddr_t download_addr;
+static uint16_t download_port;
+static uint16_t block_size;
+/* The next byte to request, and the size of the image once known */
+static uint32_t next_offset;
+static uint32_t download_size;
+static int32_t download_error;
+static uint8_t package_uri[LWM2M_FIRMWARE_URI_SIZE];
+static uint16_t package_uri_len;
+static struct ctimer resume_timer;
+
+static void stop_download(void);
+#endif /* LWM2M_FIRMWARE_PULL */
+/*---------------------------------------------------------------------------*/
+static void
+download_failed(int32_t reason)
+{
+#if LWM2M_FIRMWARE_PULL
+  stop_download();
+  cfs_remove(LWM2M_FIRMWARE_STATE_FILENAME);
+#endif /* LWM2M_FIRMWARE_PULL */
+  if(fd >= 0) {
+    cfs_close(fd);
+    fd = -1;
+  }
+  cfs_remove(LWM2M_FIRMWARE_FILENAME);
+  state = LWM2M_FIRMWARE_STATE_IDLE;
+  result = reason;
+}
+/*---------------------------------------------------------------------------*/
+static int
+write_image(const uint8_t *data, size_t len)
+{
+  if(len > 0 && cfs_write(fd, data, len) != len) {
+    download_failed(LWM2M_FIRMWARE_RESULT_NO_STORAGE);
+    return 0;
+  }
+  crc = crc16_data(data, len, crc);
+  received += len;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+download_done(void)
+{
+  cfs_close(fd);
+  fd = -1;
+  PRINTF("Firmware: received %lu bytes, crc %04x\n",
+         (unsigned long)received, crc);
+  if(verify_callback != NULL && !verify_callback(received, crc)) {
+    download_failed(LWM2M_FIRMWARE_RESULT_CRC_FAILED);
+    return;
+  }
+#if LWM2M_FIRMWARE_PULL
+  stop_download();
+  cfs_remove(LWM2M_FIRMWARE_STATE_FILENAME);
+#endif /* LWM2M_FIRMWARE_PULL */
+  state = LWM2M_FIRMWARE_STATE_DOWNLOADED;
+}
+/*---------------------------------------------------------------------------*/
+static int
+write_package(lwm2m_context_t *ctx, uint32_t offset,
+              const uint8_t *chunk, size_t len, int more)
+{
+  if(offset == 0) {
+    /* A new package - restart the download */
+#if LWM2M_FIRMWARE_PULL
+    stop_download();
+    cfs_remove(LWM2M_FIRMWARE_STATE_FILENAME);
+    package_uri_len = 0;
+#endif /* LWM2M_FIRMWARE_PULL */
+    if(fd >= 0) {
+      cfs_close(fd);
+    }
+    cfs_remove(LWM2M_FIRMWARE_FILENAME);
+    fd = cfs_open(LWM2M_FIRMWARE_FILENAME, CFS_WRITE);
+    received = 0;
+    crc = 0;
+    result = LWM2M_FIRMWARE_RESULT_INITIAL;
+    if(fd < 0) {
+      download_failed(LWM2M_FIRMWARE_RESULT_NO_STORAGE);
+      return -1;
+    }
+    if(len == 0 && !more) {
+      /* An empty package resets the state machine */
+      cfs_close(fd);
+      fd = -1;
+      state = LWM2M_FIRMWARE_STATE_IDLE;
+      return 0;
+    }
+    state = LWM2M_FIRMWARE_STATE_DOWNLOADING;
+  } else if(fd < 0 || offset != received) {
+    PRINTF("Firmware: unexpected block at %lu (expected %lu)\n",
+           (unsigned long)offset, (unsigned long)received);
+    download_failed(LWM2M_FIRMWARE_RESULT_CONNECTION_LOST);
+    return -1;
+  }
+
+  if(!write_image(chunk, len)) {
+    return -1;
+  }
+  if(!more) {
+    download_done();
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+#if LWM2M_FIRMWARE_PULL
+static void block_callback(coap_request_state_t *request);
+/*---------------------------------------------------------------------------*/
+static void
+stop_download(void)
+{
+  int i;
+  for(i = 0; i < LWM2M_FIRMWARE_WINDOW; i++) {
+    coap_cancel_request(&blocks[i].request);
+    blocks[i].status = BLOCK_FREE;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Lose the connection, but keep what has been received to resume
+   from if the server writes the same Package URI again */
+static void
+connection_lost(void)
+{
+  stop_download();
+  cfs_remove(LWM2M_FIRMWARE_STATE_FILENAME);
+  if(fd >= 0) {
+    cfs_close(fd);
+    fd = -1;
+  }
+  state = LWM2M_FIRMWARE_STATE_IDLE;
+  result = LWM2M_FIRMWARE_RESULT_CONNECTION_LOST;
+}
+/*---------------------------------------------------------------------------*/
+/* Parse coap://[address]:port/path and set up the request */
+static int
+parse_uri(void)
+{
+  const char *uri = (const char *)package_uri;
+  const char *path;
+
+  if(strncmp(uri, "coap://[", 8) != 0) {
+    return 0;
+  }
+  uri += 8;
+  path = strchr(uri, ']');
+  if(path == NULL || !uiplib_ipaddrconv(uri, &download_addr)) {
+    return 0;
+  }
+  path++;
+  download_port = UIP_HTONS(COAP_DEFAULT_PORT);
+  if(*path == ':') {
+    download_port = UIP_HTONS(atoi(path + 1));
+    path = strchr(path, '/');
+  }
+  if(path == NULL || *path != '/') {
+    return 0;
+  }
+
+  coap_init_message(&download_request, COAP_TYPE_CON, COAP_GET, 0);
+  coap_set_header_uri_path(&download_request, path);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Request more blocks, up to the window */
+static void
+request_blocks(void)
+{
+  int i, pending = 0;
+
+  for(i = 0; i < LWM2M_FIRMWARE_WINDOW; i++) {
+    if(blocks[i].status == BLOCK_FREE && next_offset < download_size) {
+      blocks[i].request.user_data = &blocks[i];
+      if(!coap_send_block_request(&blocks[i].request, &download_addr,
+                                  download_port, &download_request,
+                                  next_offset / block_size, block_size,
+                                  block_callback)) {
+        break;
+      }
+      blocks[i].status = BLOCK_PENDING;
+      next_offset += block_size;
+    }
+  }
+  for(i = 0; i < LWM2M_FIRMWARE_WINDOW; i++) {
+    pending += blocks[i].status != BLOCK_FREE;
+  }
+  if(pending == 0 && state == LWM2M_FIRMWARE_STATE_DOWNLOADING) {
+    PRINTF("Firmware: could not request any block\n");
+    download_failed(LWM2M_FIRMWARE_RESULT_OUT_OF_MEMORY);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Write the received blocks that continue the image, in order */
+static void
+write_blocks(void)
+{
+  struct download_block *b;
+  uint32_t skip;
+  int i, found;
+
+  do {
+    found = 0;
+    for(i = 0; i < LWM2M_FIRMWARE_WINDOW; i++) {
+      b = &blocks[i];
+      if(b->status != BLOCK_RECEIVED || b->offset > received) {
+        continue;
+      }
+      found = 1;
+      b->status = BLOCK_FREE;
+      skip = received - b->offset;
+      if(skip < b->len && !write_image(&b->data[skip], b->len - skip)) {
+        return;
+      }
+      if(!b->more && b->offset + b->len == received) {
+        download_done();
+        return;
+      }
+    }
+  } while(found);
+}
+/*---------------------------------------------------------------------------*/
+static void
+block_callback(coap_request_state_t *request)
+{
+  struct download_block *b = request->user_data;
+  coap_packet_t *response = request->response;
+  const uint8_t *payload;
+  uint32_t num;
+  uint16_t size;
+  int len, i;
+
+  if(b->status != BLOCK_PENDING) {
+    return;
+  }
+
+  if(request->status == COAP_REQUEST_STATUS_RESPONSE) {
+    len = coap_get_payload(response, &payload);
+    if(response->code != CONTENT_2_05) {
+      PRINTF("Firmware: download failed with code %u\n", response->code);
+      download_error = response->code == NOT_FOUND_4_04 ?
+        LWM2M_FIRMWARE_RESULT_INVALID_URI :
+        LWM2M_FIRMWARE_RESULT_CONNECTION_LOST;
+      b->status = BLOCK_FAILED;
+    } else if(len > sizeof(b->data)) {
+      download_error = LWM2M_FIRMWARE_RESULT_UNSUPPORTED_TYPE;
+      b->status = BLOCK_FAILED;
+    } else {
+      if(!coap_get_header_block2(response, &num, &b->more, &size, NULL)) {
+        /* The whole image fits in one response */
+        num = 0;
+        b->more = 0;
+        size = block_size;
+      }
+      b->offset = num * size;
+      b->len = len;
+      memcpy(b->data, payload, len);
+      b->status = BLOCK_RECEIVED;
+      if(!b->more) {
+        download_size = b->offset + b->len;
+      }
+      if(size < block_size) {
+        /* The server wants smaller blocks - ask again for what
+           has not been received yet */
+        PRINTF("Firmware: block size %u\n", size);
+        block_size = size;
+        for(i = 0; i < LWM2M_FIRMWARE_WINDOW; i++) {
+          if(blocks[i].status == BLOCK_PENDING) {
+            coap_cancel_request(&blocks[i].request);
+            blocks[i].status = BLOCK_FREE;
+          }
+        }
+        next_offset = b->offset + b->len;
+        if(received < b->offset) {
+          next_offset = received - received % block_size;
+        }
+      }
+    }
+    return;
+  }
+
+  if(request->status == COAP_REQUEST_STATUS_FINISHED) {
+    if(b->status == BLOCK_FAILED) {
+      if(download_error == LWM2M_FIRMWARE_RESULT_CONNECTION_LOST) {
+        connection_lost();
+      } else {
+        download_failed(download_error);
+      }
+      return;
+    }
+    write_blocks();
+    if(state == LWM2M_FIRMWARE_STATE_DOWNLOADING) {
+      request_blocks();
+    }
+    return;
+  }
+
+  PRINTF("Firmware: block request failed (%u)\n", request->status);
+  b->status = BLOCK_FREE;
+  connection_lost();
+}
+/*---------------------------------------------------------------------------*/
+/* Download the image from the Package URI, continuing the image file
+   when resuming */
+static void
+start_download(int resume)
+{
+  stop_download();
+  if(fd >= 0) {
+    cfs_close(fd);
+    fd = -1;
+  }
+  result = LWM2M_FIRMWARE_RESULT_INITIAL;
+  if(!parse_uri()) {
+    PRINTF("Firmware: invalid Package URI\n");
+    download_failed(LWM2M_FIRMWARE_RESULT_INVALID_URI);
+    return;
+  }
+
+  if(resume) {
+    fd = cfs_open(LWM2M_FIRMWARE_FILENAME, CFS_WRITE | CFS_APPEND);
+  } else {
+    cfs_remove(LWM2M_FIRMWARE_FILENAME);
+    fd = cfs_open(LWM2M_FIRMWARE_FILENAME, CFS_WRITE);
+    received = 0;
+    crc = 0;
+  }
+  if(fd < 0) {
+    download_failed(LWM2M_FIRMWARE_RESULT_NO_STORAGE);
+    return;
+  }
+
+  if(!resume) {
+    /* Remember the URI to resume after a reboot */
+    int sfd;
+    cfs_remove(LWM2M_FIRMWARE_STATE_FILENAME);
+    sfd = cfs_open(LWM2M_FIRMWARE_STATE_FILENAME, CFS_WRITE);
+    if(sfd >= 0) {
+      cfs_write(sfd, package_uri, package_uri_len);
+      cfs_close(sfd);
+    }
+  }
+
+  PRINTF("Firmware: downloading %s from %lu\n", (char *)package_uri,
+         (unsigned long)received);
+  block_size = REST_MAX_CHUNK_SIZE;
+  next_offset = received - received % block_size;
+  download_size = 0xffffffffUL;
+  state = LWM2M_FIRMWARE_STATE_DOWNLOADING;
+  request_blocks();
+}
+/*---------------------------------------------------------------------------*/
+/* Get the size and the CRC of the image file, to resume from */
+static int
+read_image(void)
+{
+  uint8_t buf[32];
+  int ifd, len;
+
+  received = 0;
+  crc = 0;
+  ifd = cfs_open(LWM2M_FIRMWARE_FILENAME, CFS_READ);
+  if(ifd < 0) {
+    return 0;
+  }
+  while((len = cfs_read(ifd, buf, sizeof(buf))) > 0) {
+    crc = crc16_data(buf, len, crc);
+    received += len;
+  }
+  cfs_close(ifd);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+resume(void *ptr)
+{
+  int sfd, len;
+
+  sfd = cfs_open(LWM2M_FIRMWARE_STATE_FILENAME, CFS_READ);
+  if(sfd < 0) {
+    return;
+  }
+  len = cfs_read(sfd, package_uri, sizeof(package_uri) - 1);
+  cfs_close(sfd);
+  if(len <= 0 || !read_image()) {
+    cfs_remove(LWM2M_FIRMWARE_STATE_FILENAME);
+    return;
+  }
+  package_uri[len] = '\0';
+  package_uri_len = len;
+  start_download(1);
+}
+/*---------------------------------------------------------------------------*/
+static int
+read_package_uri(lwm2m_context_t *ctx, uint8_t *outbuf, size_t outsize)
+{
+  return ctx->writer->write_string(ctx, outbuf, outsize,
+                                   (const char *)package_uri, package_uri_len);
+}
+/*---------------------------------------------------------------------------*/
+static int
+write_package_uri(lwm2m_context_t *ctx, const uint8_t *inbuf, size_t insize,
+                  uint8_t *outbuf, size_t outsize)
+{
+  uint8_t uri[LWM2M_FIRMWARE_URI_SIZE];
+  size_t len;
+  int same;
+
+  len = ctx->reader->read_string(ctx, inbuf, insize, uri, sizeof(uri));
+  if(len == 0) {
+    return 0;
+  }
+  len = strlen((const char *)uri);
+  same = state == LWM2M_FIRMWARE_STATE_IDLE && received > 0 &&
+    len == package_uri_len && memcmp(uri, package_uri, len) == 0;
+  memcpy(package_uri, uri, len + 1);
+  package_uri_len = len;
+
+  if(len == 0) {
+    /* An empty URI resets the state machine */
+    download_failed(LWM2M_FIRMWARE_RESULT_INITIAL);
+    return insize;
+  }
+  /* The same URI again continues where the download was lost */
+  start_download(same && result == LWM2M_FIRMWARE_RESULT_CONNECTION_LOST);
+  return insize;
+}
+#endif /* LWM2M_FIRMWARE_PULL */
+/*---------------------------------------------------------------------------*/
+static void
+update_timeout(coap_separate_slot_t *slot, void *user_data)
+{
+  PRINTF("Firmware: update not verified in time\n");
+  pending_update = NULL;
+}
+/*---------------------------------------------------------------------------*/
+static int
+update(lwm2m_context_t *ctx, const uint8_t *arg, size_t argsize,
+       uint8_t *outbuf, size_t outsize)
+{
+  if(state != LWM2M_FIRMWARE_STATE_DOWNLOADED) {
+    PRINTF("Firmware: no firmware to update with\n");
+    return 0;
+  }
+  if(async_update_callback != NULL) {
+    /* Answer the server when the update has been verified */
+    pending_update = lwm2m_engine_defer_execute(update_timeout, NULL);
+    if(pending_update != NULL) {
+      state = LWM2M_FIRMWARE_STATE_UPDATING;
+      async_update_callback(LWM2M_FIRMWARE_FILENAME);
+    }
+    return 0;
+  }
+  state = LWM2M_FIRMWARE_STATE_UPDATING;
+  if(update_callback != NULL && update_callback(LWM2M_FIRMWARE_FILENAME)) {
+    /* The callback is expected to reboot into the new firmware */
+    result = LWM2M_FIRMWARE_RESULT_SUCCESS;
+  } else {
+    result = LWM2M_FIRMWARE_RESULT_UNSUPPORTED_TYPE;
+  }
+  state = LWM2M_FIRMWARE_STATE_IDLE;
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+LWM2M_RESOURCES(firmware_resources,
+                /* Package */
+                LWM2M_RESOURCE_CALLBACK(0, { NULL, NULL, NULL, write_package }),
+#if LWM2M_FIRMWARE_PULL
+                /* Package URI */
+                LWM2M_RESOURCE_CALLBACK(1, { read_package_uri, write_package_uri, NULL }),
+#endif /* LWM2M_FIRMWARE_PULL */
+                /* Update */
+                LWM2M_RESOURCE_CALLBACK(2, { NULL, NULL, update }),
+                /* State */
+                LWM2M_RESOURCE_INTEGER_VAR(3, &state),
+                /* Update Result */
+                LWM2M_RESOURCE_INTEGER_VAR(5, &result),
+                );
+LWM2M_STATIC_INSTANCES(firmware_instances,
+                       LWM2M_INSTANCE_STATIC(0, firmware_resources));
+LWM2M_STATIC_OBJECT(firmware, 5, firmware_instances);
+/*---------------------------------------------------------------------------*/
+void
+lwm2m_firmware_set_update_callback(lwm2m_firmware_update_callback_t callback)
+{
+  update_callback = callback;
+}
+/*---------------------------------------------------------------------------*/
+void
+lwm2m_firmware_set_async_update_callback(lwm2m_firmware_async_update_callback_t callback)
+{
+  async_update_callback = callback;
+}
+/*---------------------------------------------------------------------------*/
+void
+lwm2m_firmware_set_verify_callback(lwm2m_firmware_verify_callback_t callback)
+{
+  verify_callback = callback;
+}
+/*---------------------------------------------------------------------------*/
+void
+lwm2m_firmware_update_done(int success)
+{
+  if(state != LWM2M_FIRMWARE_STATE_UPDATING) {
+    return;
+  }
+  result = success ? LWM2M_FIRMWARE_RESULT_SUCCESS :
+    LWM2M_FIRMWARE_RESULT_CRC_FAILED;
+  state = LWM2M_FIRMWARE_STATE_IDLE;
+  if(pending_update != NULL) {
+    lwm2m_engine_complete_execute(pending_update, success);
+    pending_update = NULL;
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+lwm2m_firmware_init(void)
+{
+  PRINTF("*** Init lwm2m-firmware\n");
+  lwm2m_engine_register_object(&firmware);
+#if LWM2M_FIRMWARE_PULL
+  /* A download was going on before the reboot */
+  ctimer_set(&resume_timer, LWM2M_FIRMWARE_RESUME_DELAY, resume, NULL);
+#endif /* LWM2M_FIRMWARE_PULL */
+}
+/*---------------------------------------------------------------------------*/
+/** @} */
@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \addtogroup oma-lwm2m
+ * @{
+ */
+
+/**
+ * \file
+ *         Header file for the Contiki OMA LWM2M firmware update object
+ */
+
+#ifndef LWM2M_FIRMWARE_H_
+#define LWM2M_FIRMWARE_H_
+
+#include "contiki-conf.h"
+
+/* The file where the received firmware image is stored */
+#ifdef LWM2M_FIRMWARE_CONF_FILENAME
+#define LWM2M_FIRMWARE_FILENAME LWM2M_FIRMWARE_CONF_FILENAME
+#else /* LWM2M_FIRMWARE_CONF_FILENAME */
+#define LWM2M_FIRMWARE_FILENAME "firmware"
+#endif /* LWM2M_FIRMWARE_CONF_FILENAME */
+
+/*
+ * Set to let the server give a Package URI that the firmware image is
+ * downloaded from, with CoAP Block2 requests.
+ */
+#ifdef LWM2M_FIRMWARE_CONF_PULL
+#define LWM2M_FIRMWARE_PULL LWM2M_FIRMWARE_CONF_PULL
+#else /* LWM2M_FIRMWARE_CONF_PULL */
+#define LWM2M_FIRMWARE_PULL 1
+#endif /* LWM2M_FIRMWARE_CONF_PULL */
+
+/* Blocks requested at the same time when downloading */
+#ifdef LWM2M_FIRMWARE_CONF_WINDOW
+#define LWM2M_FIRMWARE_WINDOW LWM2M_FIRMWARE_CONF_WINDOW
+#else /* LWM2M_FIRMWARE_CONF_WINDOW */
+#define LWM2M_FIRMWARE_WINDOW 2
+#endif /* LWM2M_FIRMWARE_CONF_WINDOW */
+
+#ifdef LWM2M_FIRMWARE_CONF_URI_SIZE
+#define LWM2M_FIRMWARE_URI_SIZE LWM2M_FIRMWARE_CONF_URI_SIZE
+#else /* LWM2M_FIRMWARE_CONF_URI_SIZE */
+#define LWM2M_FIRMWARE_URI_SIZE 64
+#endif /* LWM2M_FIRMWARE_CONF_URI_SIZE */
+
+/*
+ * The file that keeps the Package URI while downloading, to resume the
+ * download after a reboot from where the image file ends
+ */
+#ifdef LWM2M_FIRMWARE_CONF_STATE_FILENAME
+#define LWM2M_FIRMWARE_STATE_FILENAME LWM2M_FIRMWARE_CONF_STATE_FILENAME
+#else /* LWM2M_FIRMWARE_CONF_STATE_FILENAME */
+#define LWM2M_FIRMWARE_STATE_FILENAME "fwstate"
+#endif /* LWM2M_FIRMWARE_CONF_STATE_FILENAME */
+
+/* Time to wait after boot before resuming a download */
+#ifdef LWM2M_FIRMWARE_CONF_RESUME_DELAY
+#define LWM2M_FIRMWARE_RESUME_DELAY LWM2M_FIRMWARE_CONF_RESUME_DELAY
+#else /* LWM2M_FIRMWARE_CONF_RESUME_DELAY */
+#define LWM2M_FIRMWARE_RESUME_DELAY (30 * CLOCK_SECOND)
+#endif /* LWM2M_FIRMWARE_CONF_RESUME_DELAY */
+
+#define LWM2M_FIRMWARE_STATE_IDLE               0
+#define LWM2M_FIRMWARE_STATE_DOWNLOADING        1
+#define LWM2M_FIRMWARE_STATE_DOWNLOADED         2
+#define LWM2M_FIRMWARE_STATE_UPDATING           3
+
+#define LWM2M_FIRMWARE_RESULT_INITIAL           0
+#define LWM2M_FIRMWARE_RESULT_SUCCESS           1
+#define LWM2M_FIRMWARE_RESULT_NO_STORAGE        2
+#define LWM2M_FIRMWARE_RESULT_OUT_OF_MEMORY     3
+#define LWM2M_FIRMWARE_RESULT_CONNECTION_LOST   4
+#define LWM2M_FIRMWARE_RESULT_CRC_FAILED        5
+#define LWM2M_FIRMWARE_RESULT_UNSUPPORTED_TYPE  6
+#define LWM2M_FIRMWARE_RESULT_INVALID_URI       7
+
+/**
+ * \brief Callback invoked when the server executes the Update resource.
+ * \param filename The file holding the downloaded firmware image
+ * \return Non-zero if the update was started
+ */
+typedef int (* lwm2m_firmware_update_callback_t)(const char *filename);
+
+void lwm2m_firmware_set_update_callback(lwm2m_firmware_update_callback_t callback);
+
+/**
+ * \brief Callback invoked when the server executes the Update resource
+ *        and the update is verified asynchronously, for example when
+ *        checking the image takes longer than the server waits for a
+ *        response. The result is reported with lwm2m_firmware_update_done().
+ * \param filename The file holding the downloaded firmware image
+ */
+typedef void (* lwm2m_firmware_async_update_callback_t)(const char *filename);
+
+void lwm2m_firmware_set_async_update_callback(lwm2m_firmware_async_update_callback_t callback);
+
+/**
+ * \brief Callback invoked when a firmware image has been received,
+ *        with or without a Package URI.
+ * \param size The size of the image
+ * \param crc  The CRC-16 of the image, as computed by crc16_data()
+ * \return Non-zero if the image is valid, zero to discard it
+ */
+typedef int (* lwm2m_firmware_verify_callback_t)(uint32_t size, uint16_t crc);
+
+void lwm2m_firmware_set_verify_callback(lwm2m_firmware_verify_callback_t callback);
+void lwm2m_firmware_update_done(int success);
+void lwm2m_firmware_init(void);
+
+#endif /* LWM2M_FIRMWARE_H_ */
+/** @} */
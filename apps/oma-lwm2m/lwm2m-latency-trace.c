@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \addtogroup oma-lwm2m
+ * @{
+ */
+
+/**
+ * \file
+ *         Implementation of the latency trace object
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "contiki.h"
+#include "net/latency-trace.h"
+#include "lwm2m-object.h"
+#include "lwm2m-engine.h"
+#include "lwm2m-latency-trace.h"
+
+#define DEBUG 0
+#if DEBUG
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+#if LATENCY_TRACE_ENABLED
+
+static lwm2m_instance_t latency_instances[LATENCY_TRACE_STAGES];
+/*---------------------------------------------------------------------------*/
+static int
+read_name(lwm2m_context_t *ctx, uint8_t *outbuf, size_t outsize)
+{
+  const char *name = latency_trace_stage_name(ctx->object_instance_id);
+
+  if(name == NULL) {
+    name = "";
+  }
+  return ctx->writer->write_string(ctx, outbuf, outsize, name, strlen(name));
+}
+/*---------------------------------------------------------------------------*/
+static int
+read_value(lwm2m_context_t *ctx, uint8_t *outbuf, size_t outsize)
+{
+  uint8_t stage = ctx->object_instance_id;
+  const struct latency_trace_stats *s = latency_trace_get(stage);
+  uint32_t failed, lost;
+  uint32_t value = 0;
+
+  latency_trace_incomplete(&failed, &lost);
+  switch(ctx->resource_id) {
+  case LWM2M_LATENCY_TRACE_COUNT:
+    value = s->count;
+    break;
+  case LWM2M_LATENCY_TRACE_MEAN:
+    value = s->count > 0 ? s->sum / s->count : 0;
+    break;
+  case LWM2M_LATENCY_TRACE_MAX:
+    value = s->max;
+    break;
+  case LWM2M_LATENCY_TRACE_P50:
+    value = latency_trace_percentile(stage, 50);
+    break;
+  case LWM2M_LATENCY_TRACE_P90:
+    value = latency_trace_percentile(stage, 90);
+    break;
+  case LWM2M_LATENCY_TRACE_P99:
+    value = latency_trace_percentile(stage, 99);
+    break;
+  case LWM2M_LATENCY_TRACE_FAILED:
+    value = failed;
+    break;
+  case LWM2M_LATENCY_TRACE_LOST:
+    value = lost;
+    break;
+  }
+  return ctx->writer->write_int(ctx, outbuf, outsize, (int32_t)value);
+}
+/*---------------------------------------------------------------------------*/
+static int
+read_histogram(lwm2m_context_t *ctx, uint8_t *outbuf, size_t outsize)
+{
+  const struct latency_trace_stats *s =
+    latency_trace_get(ctx->object_instance_id);
+  char buf[LATENCY_TRACE_BUCKETS * 6];
+  int len = 0;
+  uint8_t i;
+
+  buf[0] = '\0';
+  for(i = 0; i < LATENCY_TRACE_BUCKETS; i++) {
+    len += snprintf(&buf[len], sizeof(buf) - len, i > 0 ? ",%u" : "%u",
+                    s->histogram[i]);
+  }
+  return ctx->writer->write_string(ctx, outbuf, outsize, buf, strlen(buf));
+}
+/*---------------------------------------------------------------------------*/
+static int
+reset(lwm2m_context_t *ctx, const uint8_t *arg, size_t argsize,
+      uint8_t *outbuf, size_t outsize)
+{
+  PRINTF("lwm2m-latency-trace: reset\n");
+  latency_trace_reset();
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+LWM2M_RESOURCES(latency_resources,
+                LWM2M_RESOURCE_CALLBACK(LWM2M_LATENCY_TRACE_NAME,
+                                        { read_name, NULL, NULL }),
+                LWM2M_RESOURCE_CALLBACK(LWM2M_LATENCY_TRACE_COUNT,
+                                        { read_value, NULL, NULL }),
+                LWM2M_RESOURCE_CALLBACK(LWM2M_LATENCY_TRACE_MEAN,
+                                        { read_value, NULL, NULL }),
+                LWM2M_RESOURCE_CALLBACK(LWM2M_LATENCY_TRACE_MAX,
+                                        { read_value, NULL, NULL }),
+                LWM2M_RESOURCE_CALLBACK(LWM2M_LATENCY_TRACE_P50,
+                                        { read_value, NULL, NULL }),
+                LWM2M_RESOURCE_CALLBACK(LWM2M_LATENCY_TRACE_P90,
+                                        { read_value, NULL, NULL }),
+                LWM2M_RESOURCE_CALLBACK(LWM2M_LATENCY_TRACE_P99,
+                                        { read_value, NULL, NULL }),
+                LWM2M_RESOURCE_CALLBACK(LWM2M_LATENCY_TRACE_HISTOGRAM,
+                                        { read_histogram, NULL, NULL }),
+                LWM2M_RESOURCE_INTEGER(LWM2M_LATENCY_TRACE_BUCKET_MIN,
+                                       LATENCY_TRACE_BUCKET_MIN_US),
+                LWM2M_RESOURCE_CALLBACK(LWM2M_LATENCY_TRACE_FAILED,
+                                        { read_value, NULL, NULL }),
+                LWM2M_RESOURCE_CALLBACK(LWM2M_LATENCY_TRACE_LOST,
+                                        { read_value, NULL, NULL }),
+                LWM2M_RESOURCE_CALLBACK(LWM2M_LATENCY_TRACE_RESET,
+                                        { NULL, NULL, reset }),
+                );
+LWM2M_OBJECT(latency_trace, LWM2M_LATENCY_TRACE_OBJECT_ID,
+             latency_instances);
+#endif /* LATENCY_TRACE_ENABLED */
+/*---------------------------------------------------------------------------*/
+void
+lwm2m_latency_trace_init(void)
+{
+#if LATENCY_TRACE_ENABLED
+  lwm2m_instance_t template = LWM2M_INSTANCE(0, latency_resources);
+  int i;
+
+  for(i = 0; i < LATENCY_TRACE_STAGES; i++) {
+    latency_instances[i] = template;
+    latency_instances[i].id = i;
+  }
+
+  PRINTF("*** Init lwm2m-latency-trace\n");
+  lwm2m_engine_register_object(&latency_trace);
+#endif /* LATENCY_TRACE_ENABLED */
+}
+/*---------------------------------------------------------------------------*/
+/** @} */
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \addtogroup oma-lwm2m
+ * @{
+ */
+
+/**
+ * \file
+ *         Header file for the latency trace object, giving access to
+ *         the latency of each stage of the packets sent, from a change
+ *         notified to the end of its transmission by the MAC
+ *         (see LATENCY_TRACE_CONF_ENABLED)
+ */
+
+#ifndef LWM2M_LATENCY_TRACE_H_
+#define LWM2M_LATENCY_TRACE_H_
+
+#include "contiki-conf.h"
+
+/* Object id, from the private range */
+#ifdef LWM2M_LATENCY_TRACE_CONF_OBJECT_ID
+#define LWM2M_LATENCY_TRACE_OBJECT_ID LWM2M_LATENCY_TRACE_CONF_OBJECT_ID
+#else
+#define LWM2M_LATENCY_TRACE_OBJECT_ID 32771
+#endif
+
+/* Resources. Instance i describes stage i of net/latency-trace.h, and
+   instance 0 the whole trace. Times are in microseconds. */
+#define LWM2M_LATENCY_TRACE_NAME        0
+#define LWM2M_LATENCY_TRACE_COUNT       1
+#define LWM2M_LATENCY_TRACE_MEAN        2
+#define LWM2M_LATENCY_TRACE_MAX         3
+#define LWM2M_LATENCY_TRACE_P50         4
+#define LWM2M_LATENCY_TRACE_P90         5
+#define LWM2M_LATENCY_TRACE_P99         6
+/* The counts of the buckets, separated by commas */
+#define LWM2M_LATENCY_TRACE_HISTOGRAM   7
+/* The upper limit of the first bucket, each next one doubles it */
+#define LWM2M_LATENCY_TRACE_BUCKET_MIN  8
+/* Packets the MAC failed to send and traces lost, of all stages */
+#define LWM2M_LATENCY_TRACE_FAILED      9
+#define LWM2M_LATENCY_TRACE_LOST        10
+/* Clears the statistics of all stages */
+#define LWM2M_LATENCY_TRACE_RESET       11
+
+void lwm2m_latency_trace_init(void);
+
+#endif /* LWM2M_LATENCY_TRACE_H_ */
+/** @} */
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \addtogroup oma-lwm2m
+ * @{
+ */
+
+/**
+ * \file
+ *         Implementation of the memory pool object
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "contiki.h"
+#include "lib/memb.h"
+#include "lwm2m-object.h"
+#include "lwm2m-engine.h"
+#include "lwm2m-mempool.h"
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+#if MEMB_STATS
+
+#define MAX_COUNT LWM2M_MEMPOOL_MAX_COUNT
+
+static lwm2m_instance_t mempool_instances[MAX_COUNT];
+/*---------------------------------------------------------------------------*/
+static const struct memb *
+get_pool(const lwm2m_context_t *ctx)
+{
+  struct memb *m;
+  int i;
+
+  for(m = memb_pool_list(), i = 0; m != NULL && i < ctx->object_instance_index;
+      m = m->next, i++);
+  return m;
+}
+/*---------------------------------------------------------------------------*/
+static int
+read_name(lwm2m_context_t *ctx, uint8_t *outbuf, size_t outsize)
+{
+  const struct memb *m = get_pool(ctx);
+  const char *name = m != NULL ? m->name : "";
+
+  return ctx->writer->write_string(ctx, outbuf, outsize, name, strlen(name));
+}
+/*---------------------------------------------------------------------------*/
+static int
+read_value(lwm2m_context_t *ctx, uint8_t *outbuf, size_t outsize)
+{
+  const struct memb *m = get_pool(ctx);
+  int32_t value = 0;
+
+  if(m != NULL) {
+    switch(ctx->resource_id) {
+    case LWM2M_MEMPOOL_CHUNK_SIZE:
+      value = m->size;
+      break;
+    case LWM2M_MEMPOOL_CHUNKS:
+      value = m->num;
+      break;
+    case LWM2M_MEMPOOL_USED:
+      value = m->used;
+      break;
+    case LWM2M_MEMPOOL_PEAK:
+      value = m->peak;
+      break;
+    case LWM2M_MEMPOOL_FAILURES:
+      value = m->failures;
+      break;
+    }
+  }
+  return ctx->writer->write_int(ctx, outbuf, outsize, value);
+}
+/*---------------------------------------------------------------------------*/
+LWM2M_RESOURCES(mempool_resources,
+                LWM2M_RESOURCE_CALLBACK(LWM2M_MEMPOOL_NAME,
+                                        { read_name, NULL, NULL }),
+                LWM2M_RESOURCE_CALLBACK(LWM2M_MEMPOOL_CHUNK_SIZE,
+                                        { read_value, NULL, NULL }),
+                LWM2M_RESOURCE_CALLBACK(LWM2M_MEMPOOL_CHUNKS,
+                                        { read_value, NULL, NULL }),
+                LWM2M_RESOURCE_CALLBACK(LWM2M_MEMPOOL_USED,
+                                        { read_value, NULL, NULL }),
+                LWM2M_RESOURCE_CALLBACK(LWM2M_MEMPOOL_PEAK,
+                                        { read_value, NULL, NULL }),
+                LWM2M_RESOURCE_CALLBACK(LWM2M_MEMPOOL_FAILURES,
+                                        { read_value, NULL, NULL }),
+                );
+LWM2M_OBJECT(mempool, LWM2M_MEMPOOL_OBJECT_ID, mempool_instances);
+#endif /* MEMB_STATS */
+/*---------------------------------------------------------------------------*/
+void
+lwm2m_mempool_init(void)
+{
+#if MEMB_STATS
+  lwm2m_instance_t template = LWM2M_INSTANCE(0, mempool_resources);
+  int i;
+
+  /* All instances exist, and describe no pool when there are fewer
+     pools than instances */
+  for(i = 0; i < MAX_COUNT; i++) {
+    mempool_instances[i] = template;
+    mempool_instances[i].id = i;
+  }
+
+  PRINTF("*** Init lwm2m-mempool\n");
+  lwm2m_engine_register_object(&mempool);
+#endif /* MEMB_STATS */
+}
+/*---------------------------------------------------------------------------*/
+/** @} */
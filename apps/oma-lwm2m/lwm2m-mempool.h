@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \addtogroup oma-lwm2m
+ * @{
+ */
+
+/**
+ * \file
+ *         Header file for the memory pool object, giving access to the
+ *         usage statistics of the MEMB pools (see MEMB_CONF_STATS)
+ */
+
+#ifndef LWM2M_MEMPOOL_H_
+#define LWM2M_MEMPOOL_H_
+
+#include "contiki-conf.h"
+
+/* Object id, from the private range */
+#ifdef LWM2M_MEMPOOL_CONF_OBJECT_ID
+#define LWM2M_MEMPOOL_OBJECT_ID LWM2M_MEMPOOL_CONF_OBJECT_ID
+#else
+#define LWM2M_MEMPOOL_OBJECT_ID 32770
+#endif
+
+/* Number of instances. Instance i describes the i-th pool of
+   memb_pool_list(), most recently initialized first */
+#ifdef LWM2M_MEMPOOL_CONF_MAX_COUNT
+#define LWM2M_MEMPOOL_MAX_COUNT LWM2M_MEMPOOL_CONF_MAX_COUNT
+#else
+#define LWM2M_MEMPOOL_MAX_COUNT 16
+#endif
+
+/* Resources */
+#define LWM2M_MEMPOOL_NAME        0
+#define LWM2M_MEMPOOL_CHUNK_SIZE  1
+#define LWM2M_MEMPOOL_CHUNKS      2
+#define LWM2M_MEMPOOL_USED        3
+#define LWM2M_MEMPOOL_PEAK        4
+#define LWM2M_MEMPOOL_FAILURES    5
+
+void lwm2m_mempool_init(void);
+
+#endif /* LWM2M_MEMPOOL_H_ */
+/** @} */
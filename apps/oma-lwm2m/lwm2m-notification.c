@@ -0,0 +1,832 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \addtogroup oma-lwm2m
+ * @{
+ */
+
+/**
+ * \file
+ *         Implementation of the Contiki OMA LWM2M notification scheduler
+ */
+
+#include "contiki.h"
+#include "lwm2m-object.h"
+#include "lwm2m-engine.h"
+#include "lwm2m-notification.h"
+#include "lwm2m-plain-text.h"
+#include "er-coap-observe.h"
+#include "net/latency-trace.h"
+#include <stdio.h>
+#include <string.h>
+
+#define DEBUG 0
+#if DEBUG
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+#define OBSERVATION_FLAG_PENDING   1
+#define OBSERVATION_FLAG_SENT      2
+#define OBSERVATION_FLAG_HAS_VALUE 4
+
+typedef struct {
+  char url[COAP_OBSERVER_URL_LEN];
+  clock_time_t last_sent;
+  int32_t last_value;
+#if LATENCY_TRACE_ENABLED
+  /* When the first change not yet notified happened */
+  rtimer_clock_t changed;
+#endif /* LATENCY_TRACE_ENABLED */
+  uint8_t flags;
+} observation_t;
+
+/* The changed resources of an object instance, one bit per resource
+   index */
+typedef struct {
+  const lwm2m_object_t *object;
+  uint16_t instance_id;
+  uint32_t resources;
+} dirty_instance_t;
+
+#define DIRTY_MAX_RESOURCES 32
+
+static lwm2m_attributes_t attributes[LWM2M_NOTIFICATION_MAX_ATTRIBUTES];
+static observation_t observations[LWM2M_NOTIFICATION_MAX_OBSERVATIONS];
+static struct ctimer notification_timer;
+static dirty_instance_t dirty[LWM2M_NOTIFICATION_MAX_DIRTY];
+static struct ctimer dirty_timer;
+/* set while notifications are held back in queue mode */
+static uint8_t queued;
+/* set while a notification is generated */
+static uint8_t notifying;
+
+static void schedule(void);
+/*---------------------------------------------------------------------------*/
+static void
+notify_observer(const lwm2m_object_t *object, coap_observer_t *obs)
+{
+  notifying = 1;
+  coap_notify_observer(lwm2m_object_get_coap_resource(object), obs);
+  notifying = 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+parse_url(const char *url, int len, uint16_t *ids)
+{
+  int i, depth;
+
+  if(len > 0 && url[0] == '/') {
+    url++;
+    len--;
+  }
+  if(len == 0) {
+    return 0;
+  }
+
+  depth = 1;
+  ids[0] = ids[1] = ids[2] = 0;
+  for(i = 0; i < len && url[i] != '\0'; i++) {
+    if(url[i] >= '0' && url[i] <= '9') {
+      ids[depth - 1] = ids[depth - 1] * 10 + (url[i] - '0');
+    } else if(url[i] == '/' && depth < 3) {
+      depth++;
+    } else {
+      return 0;
+    }
+  }
+  return depth;
+}
+/*---------------------------------------------------------------------------*/
+/* Check if url is the same as or a parent path of path */
+static int
+is_prefix(const char *url, const char *path)
+{
+  int len;
+  len = strlen(url);
+  return strncmp(url, path, len) == 0 &&
+    (path[len] == '\0' || path[len] == '/');
+}
+/*---------------------------------------------------------------------------*/
+static int
+is_observed(const char *url)
+{
+  coap_observer_t *obs;
+  for(obs = list_head(coap_get_observers()); obs; obs = obs->next) {
+    if(strcmp(obs->url, url) == 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static lwm2m_attributes_t *
+find_attributes(uint16_t object_id, uint16_t object_instance_id,
+                uint16_t resource_id, int depth)
+{
+  lwm2m_attributes_t *a;
+  int i;
+  for(i = 0; i < LWM2M_NOTIFICATION_MAX_ATTRIBUTES; i++) {
+    a = &attributes[i];
+    if(a->flags != 0 && a->depth == depth && a->object_id == object_id &&
+       (depth < 2 || a->object_instance_id == object_instance_id) &&
+       (depth < 3 || a->resource_id == resource_id)) {
+      return a;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+int
+lwm2m_notification_get_attributes(uint16_t object_id,
+                                  uint16_t object_instance_id,
+                                  uint16_t resource_id, int depth,
+                                  lwm2m_attributes_t *result)
+{
+  const lwm2m_attributes_t *a;
+  int d;
+
+  memset(result, 0, sizeof(lwm2m_attributes_t));
+  result->object_id = object_id;
+  result->object_instance_id = object_instance_id;
+  result->resource_id = resource_id;
+  result->depth = depth;
+
+  /* More specific attributes overrides the inherited ones */
+  for(d = 1; d <= depth; d++) {
+    a = find_attributes(object_id, object_instance_id, resource_id, d);
+    if(a == NULL) {
+      continue;
+    }
+    if(a->flags & LWM2M_ATTRIBUTE_PMIN) {
+      result->pmin = a->pmin;
+      result->flags |= LWM2M_ATTRIBUTE_PMIN;
+    }
+    if(a->flags & LWM2M_ATTRIBUTE_PMAX) {
+      result->pmax = a->pmax;
+      result->flags |= LWM2M_ATTRIBUTE_PMAX;
+    }
+    if(d == 3) {
+      result->flags |= a->flags &
+        (LWM2M_ATTRIBUTE_GT | LWM2M_ATTRIBUTE_LT | LWM2M_ATTRIBUTE_ST);
+      result->gt = a->gt;
+      result->lt = a->lt;
+      result->st = a->st;
+    }
+  }
+  return result->flags != 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+get_url_attributes(const char *url, lwm2m_attributes_t *result)
+{
+  uint16_t ids[3];
+  int depth;
+  depth = parse_url(url, strlen(url), ids);
+  if(depth == 0) {
+    memset(result, 0, sizeof(lwm2m_attributes_t));
+    return 0;
+  }
+  lwm2m_notification_get_attributes(ids[0], ids[1], ids[2], depth, result);
+  return depth;
+}
+/*---------------------------------------------------------------------------*/
+static int
+read_url_value(const char *url, int32_t *value)
+{
+  uint16_t ids[3];
+  if(parse_url(url, strlen(url), ids) != 3) {
+    return 0;
+  }
+  return lwm2m_engine_read_float32fix(ids[0], ids[1], ids[2], value);
+}
+/*---------------------------------------------------------------------------*/
+static observation_t *
+get_observation(const char *url, int create)
+{
+  observation_t *free_obs = NULL;
+  int i;
+
+  for(i = 0; i < LWM2M_NOTIFICATION_MAX_OBSERVATIONS; i++) {
+    if(observations[i].url[0] == '\0') {
+      if(free_obs == NULL) {
+        free_obs = &observations[i];
+      }
+    } else if(strcmp(observations[i].url, url) == 0) {
+      return &observations[i];
+    }
+  }
+  if(!create) {
+    return NULL;
+  }
+
+  if(free_obs == NULL) {
+    /* Reuse the state of an url that no longer is observed */
+    for(i = 0; i < LWM2M_NOTIFICATION_MAX_OBSERVATIONS; i++) {
+      if(!is_observed(observations[i].url)) {
+        free_obs = &observations[i];
+        break;
+      }
+    }
+  }
+
+  if(free_obs != NULL) {
+    strncpy(free_obs->url, url, sizeof(free_obs->url) - 1);
+    free_obs->url[sizeof(free_obs->url) - 1] = '\0';
+    free_obs->last_sent = clock_time();
+    free_obs->flags = 0;
+  }
+  return free_obs;
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_notification(observation_t *o)
+{
+  const lwm2m_object_t *object;
+  coap_observer_t *obs;
+  uint16_t ids[3];
+  int32_t value;
+
+  if(parse_url(o->url, strlen(o->url), ids) == 0 ||
+     (object = lwm2m_engine_get_object(ids[0])) == NULL) {
+    return;
+  }
+
+  PRINTF("lwm2m-notification: notify /%s\n", o->url);
+
+  /* A notification for pmax, without a change, starts now */
+  LATENCY_TRACE_BEGIN((o->flags & OBSERVATION_FLAG_PENDING) ?
+                      o->changed : RTIMER_NOW());
+  for(obs = list_head(coap_get_observers()); obs; obs = obs->next) {
+    if(strcmp(obs->url, o->url) == 0) {
+      notify_observer(object, obs);
+    }
+  }
+  LATENCY_TRACE_END();
+
+  o->last_sent = clock_time();
+  o->flags = (o->flags & ~OBSERVATION_FLAG_PENDING) | OBSERVATION_FLAG_SENT;
+  if(read_url_value(o->url, &value)) {
+    o->last_value = value;
+    o->flags |= OBSERVATION_FLAG_HAS_VALUE;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+is_crossing(int32_t limit, int32_t old_value, int32_t new_value)
+{
+  return (old_value <= limit && new_value > limit) ||
+    (old_value > limit && new_value <= limit);
+}
+/*---------------------------------------------------------------------------*/
+/* Check if a change fulfills the gt, lt, and st attributes */
+static int
+is_significant_change(observation_t *o, const lwm2m_attributes_t *a)
+{
+  int32_t value, diff;
+
+  if((a->flags & (LWM2M_ATTRIBUTE_GT | LWM2M_ATTRIBUTE_LT |
+                  LWM2M_ATTRIBUTE_ST)) == 0) {
+    return 1;
+  }
+  if((o->flags & OBSERVATION_FLAG_HAS_VALUE) == 0 ||
+     !read_url_value(o->url, &value)) {
+    /* Nothing to compare with */
+    return 1;
+  }
+
+  if((a->flags & LWM2M_ATTRIBUTE_GT) &&
+     is_crossing(a->gt, o->last_value, value)) {
+    return 1;
+  }
+  if((a->flags & LWM2M_ATTRIBUTE_LT) &&
+     is_crossing(a->lt, o->last_value, value)) {
+    return 1;
+  }
+  if(a->flags & LWM2M_ATTRIBUTE_ST) {
+    diff = value - o->last_value;
+    if(diff < 0) {
+      diff = -diff;
+    }
+    if(diff >= a->st) {
+      return 1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static clock_time_t
+get_pmin(const lwm2m_attributes_t *a)
+{
+  if(a->flags & LWM2M_ATTRIBUTE_PMIN) {
+    return (clock_time_t)a->pmin * CLOCK_SECOND;
+  }
+  return (clock_time_t)LWM2M_NOTIFICATION_DEFAULT_PMIN * CLOCK_SECOND;
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_timer(void *ptr)
+{
+  lwm2m_attributes_t a;
+  observation_t *o;
+  clock_time_t elapsed;
+  int i;
+
+  for(i = 0; i < LWM2M_NOTIFICATION_MAX_OBSERVATIONS; i++) {
+    o = &observations[i];
+    if(o->url[0] == '\0') {
+      continue;
+    }
+    if(!is_observed(o->url)) {
+      /* The observation has been cancelled */
+      o->url[0] = '\0';
+      continue;
+    }
+
+    get_url_attributes(o->url, &a);
+    elapsed = clock_time() - o->last_sent;
+
+    if(queued) {
+      /* Keep the notifications until the queue is flushed */
+      if((a.flags & LWM2M_ATTRIBUTE_PMAX) && a.pmax > 0 &&
+         elapsed >= (clock_time_t)a.pmax * CLOCK_SECOND) {
+        o->flags |= OBSERVATION_FLAG_PENDING;
+      }
+      continue;
+    }
+
+    if((o->flags & OBSERVATION_FLAG_PENDING) &&
+       ((o->flags & OBSERVATION_FLAG_SENT) == 0 || elapsed >= get_pmin(&a))) {
+      if(is_significant_change(o, &a)) {
+        send_notification(o);
+        continue;
+      }
+      o->flags &= ~OBSERVATION_FLAG_PENDING;
+    }
+
+    if((a.flags & LWM2M_ATTRIBUTE_PMAX) && a.pmax > 0 &&
+       elapsed >= (clock_time_t)a.pmax * CLOCK_SECOND) {
+      send_notification(o);
+    }
+  }
+  schedule();
+}
+/*---------------------------------------------------------------------------*/
+static void
+schedule(void)
+{
+  lwm2m_attributes_t a;
+  observation_t *o;
+  clock_time_t elapsed, due, next;
+  int i, found;
+
+  found = 0;
+  next = 0;
+  for(i = 0; i < LWM2M_NOTIFICATION_MAX_OBSERVATIONS; i++) {
+    o = &observations[i];
+    if(o->url[0] == '\0') {
+      continue;
+    }
+    get_url_attributes(o->url, &a);
+    elapsed = clock_time() - o->last_sent;
+
+    if(o->flags & OBSERVATION_FLAG_PENDING) {
+      if(queued) {
+        /* Sent when the queue is flushed */
+        continue;
+      }
+      due = 0;
+      if((o->flags & OBSERVATION_FLAG_SENT) && elapsed < get_pmin(&a)) {
+        due = get_pmin(&a) - elapsed;
+      }
+      if(!found || due < next) {
+        next = due;
+        found = 1;
+      }
+    }
+    if((a.flags & LWM2M_ATTRIBUTE_PMAX) && a.pmax > 0) {
+      due = (clock_time_t)a.pmax * CLOCK_SECOND;
+      due = elapsed < due ? due - elapsed : 0;
+      if(!found || due < next) {
+        next = due;
+        found = 1;
+      }
+    }
+  }
+
+  if(found) {
+    ctimer_set(&notification_timer, next, handle_timer, NULL);
+  } else {
+    ctimer_stop(&notification_timer);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+lwm2m_notification_notify(const lwm2m_object_t *object, const char *path)
+{
+  char url[COAP_OBSERVER_URL_LEN];
+  coap_observer_t *obs;
+  observation_t *o;
+  int len;
+
+  len = strlen(object->path);
+  strncpy(url, object->path, sizeof(url) - 1);
+  if(len < sizeof(url) - 1 && path != NULL) {
+    strncpy(&url[len], path, sizeof(url) - len - 1);
+  }
+  url[sizeof(url) - 1] = '\0';
+
+  PRINTF("lwm2m-notification: changed /%s\n", url);
+
+  for(obs = list_head(coap_get_observers()); obs; obs = obs->next) {
+    /* Both observers of parent and sub paths are affected */
+    if(is_prefix(obs->url, url) || is_prefix(url, obs->url)) {
+      o = get_observation(obs->url, 1);
+      if(o != NULL) {
+#if LATENCY_TRACE_ENABLED
+        if(!(o->flags & OBSERVATION_FLAG_PENDING)) {
+          o->changed = RTIMER_NOW();
+        }
+#endif /* LATENCY_TRACE_ENABLED */
+        o->flags |= OBSERVATION_FLAG_PENDING;
+      } else {
+        /* No free notification state - notify directly */
+        LATENCY_TRACE_BEGIN(RTIMER_NOW());
+        notify_observer(object, obs);
+        LATENCY_TRACE_END();
+      }
+    }
+  }
+  schedule();
+}
+/*---------------------------------------------------------------------------*/
+static void
+notify_resource(const lwm2m_object_t *object, uint16_t instance_id,
+                uint16_t resource_id)
+{
+  char path[16];
+  snprintf(path, sizeof(path), "/%u/%u", instance_id, resource_id);
+  lwm2m_notification_notify(object, path);
+}
+/*---------------------------------------------------------------------------*/
+/* Notify the dirty resources and clear their dirty bits */
+static void
+notify_dirty(void *ptr)
+{
+  const lwm2m_instance_t *instance;
+  dirty_instance_t *d;
+  int i, j;
+
+  for(i = 0; i < LWM2M_NOTIFICATION_MAX_DIRTY; i++) {
+    d = &dirty[i];
+    if(d->object == NULL) {
+      continue;
+    }
+    /* Look the instance up again, it can have moved or been removed */
+    instance = NULL;
+    for(j = 0; j < d->object->count; j++) {
+      if(d->object->instances[j].id == d->instance_id &&
+         (d->object->instances[j].flag & LWM2M_INSTANCE_FLAG_USED)) {
+        instance = &d->object->instances[j];
+        break;
+      }
+    }
+    for(j = 0; instance != NULL && j < instance->count &&
+          j < DIRTY_MAX_RESOURCES; j++) {
+      if(d->resources & (1UL << j)) {
+        notify_resource(d->object, d->instance_id, instance->resources[j].id);
+      }
+    }
+    d->object = NULL;
+    d->resources = 0;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+mark_dirty(const lwm2m_object_t *object, const lwm2m_instance_t *instance,
+           int index)
+{
+  dirty_instance_t *d, *free_slot;
+  int i;
+
+  if(list_head(coap_get_observers()) == NULL) {
+    /* Nothing is observed */
+    return;
+  }
+
+  free_slot = NULL;
+  d = NULL;
+  for(i = 0; i < LWM2M_NOTIFICATION_MAX_DIRTY; i++) {
+    if(dirty[i].object == object && dirty[i].instance_id == instance->id) {
+      d = &dirty[i];
+      break;
+    }
+    if(dirty[i].object == NULL && free_slot == NULL) {
+      free_slot = &dirty[i];
+    }
+  }
+
+  if(d == NULL && free_slot != NULL && index < DIRTY_MAX_RESOURCES) {
+    d = free_slot;
+    d->object = object;
+    d->instance_id = instance->id;
+    d->resources = 0;
+  }
+  if(d == NULL || index >= DIRTY_MAX_RESOURCES) {
+    /* No dirty bit for this resource - notify it directly */
+    notify_resource(object, instance->id, instance->resources[index].id);
+    return;
+  }
+
+  d->resources |= 1UL << index;
+  if(ctimer_expired(&dirty_timer)) {
+    ctimer_set(&dirty_timer, 0, notify_dirty, NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+has_resource(const lwm2m_instance_t *instance,
+             const lwm2m_resource_t *resource)
+{
+  return instance != NULL && resource >= instance->resources &&
+    resource < instance->resources + instance->count;
+}
+/*---------------------------------------------------------------------------*/
+void
+lwm2m_notification_set_dirty(const lwm2m_resource_t *resource,
+                             const lwm2m_context_t *context)
+{
+  const lwm2m_object_t *object;
+  const lwm2m_instance_t *instance;
+  int i;
+
+  object = lwm2m_engine_get_object(context->object_id);
+  if(object == NULL) {
+    return;
+  }
+  /* Start with the instance given by the context, as the setters do */
+  instance = NULL;
+  if(context->object_instance_index < object->count) {
+    instance = &object->instances[context->object_instance_index];
+  }
+  for(i = 0; !has_resource(instance, resource) && i < object->count; i++) {
+    instance = &object->instances[i];
+  }
+  if(has_resource(instance, resource)) {
+    mark_dirty(object, instance, resource - instance->resources);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+lwm2m_resource_changed(uint16_t object_id, uint16_t instance_id,
+                       uint16_t resource_id)
+{
+  const lwm2m_object_t *object;
+  lwm2m_context_t context;
+
+  object = lwm2m_engine_get_object(object_id);
+  if(object == NULL) {
+    return;
+  }
+  memset(&context, 0, sizeof(context));
+  context.object_id = object_id;
+  context.object_instance_id = instance_id;
+  context.resource_id = resource_id;
+  if(lwm2m_engine_get_resource(&context) != NULL) {
+    mark_dirty(object, &object->instances[context.object_instance_index],
+               context.resource_index);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+lwm2m_notification_observe(const char *url, int len)
+{
+  char buf[COAP_OBSERVER_URL_LEN];
+  observation_t *o;
+  int32_t value;
+
+  if(len > 0 && url[0] == '/') {
+    url++;
+    len--;
+  }
+  if(len >= sizeof(buf)) {
+    len = sizeof(buf) - 1;
+  }
+  memcpy(buf, url, len);
+  buf[len] = '\0';
+
+  o = get_observation(buf, 1);
+  if(o != NULL) {
+    /* The observe response counts as the first notification */
+    o->last_sent = clock_time();
+    o->flags = OBSERVATION_FLAG_SENT;
+    if(read_url_value(o->url, &value)) {
+      o->last_value = value;
+      o->flags |= OBSERVATION_FLAG_HAS_VALUE;
+    }
+    schedule();
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+get_attribute_flag(const char *name, int len)
+{
+  if(len == 4 && strncmp(name, "pmin", 4) == 0) {
+    return LWM2M_ATTRIBUTE_PMIN;
+  }
+  if(len == 4 && strncmp(name, "pmax", 4) == 0) {
+    return LWM2M_ATTRIBUTE_PMAX;
+  }
+  if(len == 2 && strncmp(name, "gt", 2) == 0) {
+    return LWM2M_ATTRIBUTE_GT;
+  }
+  if(len == 2 && strncmp(name, "lt", 2) == 0) {
+    return LWM2M_ATTRIBUTE_LT;
+  }
+  if(len == 2 && strncmp(name, "st", 2) == 0) {
+    return LWM2M_ATTRIBUTE_ST;
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+lwm2m_notification_has_attributes(const char *query, int len)
+{
+  int start, end, name_len;
+
+  for(start = 0; start < len; start = end + 1) {
+    for(end = start; end < len && query[end] != '&'; end++);
+    for(name_len = 0; start + name_len < end && query[start + name_len] != '=';
+        name_len++);
+    if(get_attribute_flag(&query[start], name_len)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+lwm2m_notification_write_attributes(const lwm2m_context_t *context,
+                                    int depth, const char *query, int len)
+{
+  lwm2m_attributes_t *a;
+  lwm2m_attributes_t tmp;
+  int start, end, name_len, value_len, flag, i;
+  const uint8_t *value;
+  int32_t v;
+
+  a = find_attributes(context->object_id, context->object_instance_id,
+                      context->resource_id, depth);
+  if(a != NULL) {
+    tmp = *a;
+  } else {
+    memset(&tmp, 0, sizeof(tmp));
+    tmp.object_id = context->object_id;
+    tmp.object_instance_id = context->object_instance_id;
+    tmp.resource_id = context->resource_id;
+    tmp.depth = depth;
+  }
+
+  for(start = 0; start < len; start = end + 1) {
+    for(end = start; end < len && query[end] != '&'; end++);
+    for(name_len = 0; start + name_len < end && query[start + name_len] != '=';
+        name_len++);
+    flag = get_attribute_flag(&query[start], name_len);
+    if(flag == 0) {
+      PRINTF("lwm2m-notification: unknown attribute %.*s\n",
+             end - start, &query[start]);
+      return 0;
+    }
+    if(depth < 3 &&
+       (flag & (LWM2M_ATTRIBUTE_GT | LWM2M_ATTRIBUTE_LT | LWM2M_ATTRIBUTE_ST))) {
+      /* gt, lt and st are only valid for single numeric resources */
+      return 0;
+    }
+
+    if(start + name_len == end) {
+      /* An attribute without value removes the attribute */
+      tmp.flags &= ~flag;
+      continue;
+    }
+
+    value = (const uint8_t *)&query[start + name_len + 1];
+    value_len = end - start - name_len - 1;
+    if(flag & (LWM2M_ATTRIBUTE_PMIN | LWM2M_ATTRIBUTE_PMAX)) {
+      if(value_len == 0 ||
+         lwm2m_plain_text_read_int(value, value_len, &v) != value_len ||
+         v < 0) {
+        return 0;
+      }
+      if(flag == LWM2M_ATTRIBUTE_PMIN) {
+        tmp.pmin = v;
+      } else {
+        tmp.pmax = v;
+      }
+    } else {
+      if(value_len == 0 ||
+         lwm2m_plain_text_read_float32fix(value, value_len, &v,
+                                          LWM2M_FLOAT32_BITS) != value_len) {
+        return 0;
+      }
+      if(flag == LWM2M_ATTRIBUTE_GT) {
+        tmp.gt = v;
+      } else if(flag == LWM2M_ATTRIBUTE_LT) {
+        tmp.lt = v;
+      } else {
+        tmp.st = v;
+      }
+    }
+    tmp.flags |= flag;
+  }
+
+  if(a == NULL && tmp.flags != 0) {
+    for(i = 0; i < LWM2M_NOTIFICATION_MAX_ATTRIBUTES; i++) {
+      if(attributes[i].flags == 0) {
+        a = &attributes[i];
+        break;
+      }
+    }
+    if(a == NULL) {
+      PRINTF("lwm2m-notification: no space for attributes\n");
+      return 0;
+    }
+  }
+  if(a != NULL) {
+    *a = tmp;
+  }
+
+  PRINTF("lwm2m-notification: attributes for %u/%u/%u (%d) flags 0x%x\n",
+         tmp.object_id, tmp.object_instance_id, tmp.resource_id, depth,
+         tmp.flags);
+
+  schedule();
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+lwm2m_notification_set_queued(int queue)
+{
+  queued = queue != 0;
+  if(!queued) {
+    /* Flush the pending notifications */
+    schedule();
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+lwm2m_notification_is_notifying(void)
+{
+  return notifying;
+}
+/*---------------------------------------------------------------------------*/
+int
+lwm2m_notification_has_pending(void)
+{
+  int i;
+  for(i = 0; i < LWM2M_NOTIFICATION_MAX_OBSERVATIONS; i++) {
+    if(observations[i].url[0] != '\0' &&
+       (observations[i].flags & OBSERVATION_FLAG_PENDING)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+lwm2m_notification_init(void)
+{
+  memset(attributes, 0, sizeof(attributes));
+  memset(observations, 0, sizeof(observations));
+  memset(dirty, 0, sizeof(dirty));
+}
+/*---------------------------------------------------------------------------*/
+/** @} */
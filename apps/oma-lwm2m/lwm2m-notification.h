@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \addtogroup oma-lwm2m
+ * @{
+ */
+
+/**
+ * \file
+ *         Header file for the Contiki OMA LWM2M notification scheduler.
+ *
+ *         Changes reported by objects are collected and sent as at most
+ *         one notification per observer and pmin period. The notification
+ *         attributes pmin, pmax, gt, lt and st are set by the LWM2M
+ *         server using Write-Attributes.
+ */
+
+#ifndef LWM2M_NOTIFICATION_H_
+#define LWM2M_NOTIFICATION_H_
+
+#include "lwm2m-object.h"
+
+#ifdef LWM2M_NOTIFICATION_CONF_MAX_ATTRIBUTES
+#define LWM2M_NOTIFICATION_MAX_ATTRIBUTES LWM2M_NOTIFICATION_CONF_MAX_ATTRIBUTES
+#else /* LWM2M_NOTIFICATION_CONF_MAX_ATTRIBUTES */
+#define LWM2M_NOTIFICATION_MAX_ATTRIBUTES 6
+#endif /* LWM2M_NOTIFICATION_CONF_MAX_ATTRIBUTES */
+
+#ifdef LWM2M_NOTIFICATION_CONF_MAX_OBSERVATIONS
+#define LWM2M_NOTIFICATION_MAX_OBSERVATIONS LWM2M_NOTIFICATION_CONF_MAX_OBSERVATIONS
+#else /* LWM2M_NOTIFICATION_CONF_MAX_OBSERVATIONS */
+#define LWM2M_NOTIFICATION_MAX_OBSERVATIONS COAP_MAX_OBSERVERS
+#endif /* LWM2M_NOTIFICATION_CONF_MAX_OBSERVATIONS */
+
+/* Object instances that can have changed resources waiting to be
+   notified at the same time */
+#ifdef LWM2M_NOTIFICATION_CONF_MAX_DIRTY
+#define LWM2M_NOTIFICATION_MAX_DIRTY LWM2M_NOTIFICATION_CONF_MAX_DIRTY
+#else /* LWM2M_NOTIFICATION_CONF_MAX_DIRTY */
+#define LWM2M_NOTIFICATION_MAX_DIRTY 4
+#endif /* LWM2M_NOTIFICATION_CONF_MAX_DIRTY */
+
+/* Default minimum period in seconds between two notifications */
+#ifdef LWM2M_NOTIFICATION_CONF_DEFAULT_PMIN
+#define LWM2M_NOTIFICATION_DEFAULT_PMIN LWM2M_NOTIFICATION_CONF_DEFAULT_PMIN
+#else /* LWM2M_NOTIFICATION_CONF_DEFAULT_PMIN */
+#define LWM2M_NOTIFICATION_DEFAULT_PMIN 0
+#endif /* LWM2M_NOTIFICATION_CONF_DEFAULT_PMIN */
+
+#define LWM2M_ATTRIBUTE_PMIN    0x01
+#define LWM2M_ATTRIBUTE_PMAX    0x02
+#define LWM2M_ATTRIBUTE_GT      0x04
+#define LWM2M_ATTRIBUTE_LT      0x08
+#define LWM2M_ATTRIBUTE_ST      0x10
+
+typedef struct lwm2m_attributes {
+  uint16_t object_id;
+  uint16_t object_instance_id;
+  uint16_t resource_id;
+  uint8_t depth;
+  uint8_t flags;
+  uint32_t pmin;
+  uint32_t pmax;
+  /* gt, lt and st use LWM2M_FLOAT32_BITS fixpoint */
+  int32_t gt;
+  int32_t lt;
+  int32_t st;
+} lwm2m_attributes_t;
+
+void lwm2m_notification_init(void);
+
+/**
+ * \brief Report a changed value for an object
+ * \param object  The object with the changed value
+ * \param path    The sub path, relative to the object, that has changed
+ *
+ * The change is scheduled and all affected observers are notified once
+ * their pmin period has passed.
+ */
+void lwm2m_notification_notify(const lwm2m_object_t *object,
+                               const char *path);
+
+/**
+ * \brief Mark a resource as changed
+ * \param resource The changed resource
+ * \param context  The context with the object id and instance index
+ *
+ * Sets the dirty bit of the resource. The dirty resources are
+ * collected and the observed ones are notified from the event loop,
+ * so several changes in a row give one notification. Used by the
+ * lwm2m_object_set_resource_*() functions.
+ */
+void lwm2m_notification_set_dirty(const lwm2m_resource_t *resource,
+                                  const lwm2m_context_t *context);
+
+/**
+ * \brief Reset the notification state for a new observation
+ * \param url  The observed url without leading slash
+ * \param len  The length of the url
+ */
+void lwm2m_notification_observe(const char *url, int len);
+
+/**
+ * \brief Handle Write-Attributes for an object, instance or resource
+ * \param context The context with the target of the attributes
+ * \param depth   1 for object, 2 for instance, and 3 for resource
+ * \param query   The query with the attributes
+ * \param len     The length of the query
+ *
+ * \return 1 if the attributes has been updated and 0 if the attributes
+ *         could not be parsed or stored
+ */
+int lwm2m_notification_write_attributes(const lwm2m_context_t *context,
+                                        int depth,
+                                        const char *query, int len);
+
+/**
+ * \brief Check if a query contains notification attributes
+ */
+int lwm2m_notification_has_attributes(const char *query, int len);
+
+/**
+ * \brief  Get the effective attributes for an object, instance or resource.
+ *
+ *         pmin and pmax are inherited from the instance and object
+ *         if not set on the resource.
+ * \return 1 if any attribute is set, 0 otherwise
+ */
+int lwm2m_notification_get_attributes(uint16_t object_id,
+                                      uint16_t object_instance_id,
+                                      uint16_t resource_id, int depth,
+                                      lwm2m_attributes_t *attributes);
+
+/**
+ * \brief Hold back or flush notifications
+ * \param queue Non-zero to keep notifications pending, zero to send all
+ *              pending notifications
+ *
+ * Used in queue mode while the server can not reach the node.
+ */
+void lwm2m_notification_set_queued(int queue);
+
+/**
+ * \brief Check if any notification is waiting to be sent
+ */
+int lwm2m_notification_has_pending(void);
+
+/**
+ * \brief Check if a notification is being generated
+ *
+ * The access rights for a notification were checked when the
+ * observation was requested.
+ */
+int lwm2m_notification_is_notifying(void);
+
+#endif /* LWM2M_NOTIFICATION_H_ */
+/** @} */
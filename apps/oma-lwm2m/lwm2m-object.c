@@ -43,6 +43,7 @@
  */
 
 #include "lwm2m-object.h"
+#include "lwm2m-notification.h"
 #include <string.h>
 /*---------------------------------------------------------------------------*/
 int
@@ -119,17 +120,26 @@ lwm2m_object_set_resource_string(const lwm2m_resource_t *resource,
       /* Too large */
       return 0;
     }
-    memcpy(resource->value.stringvar.var, string, len);
-    *(resource->value.stringvar.len) = len;
+    if(len != *(resource->value.stringvar.len) ||
+       memcmp(*(resource->value.stringvar.var), string, len) != 0) {
+      memcpy(*(resource->value.stringvar.var), string, len);
+      *(resource->value.stringvar.len) = len;
+      lwm2m_notification_set_dirty(resource, context);
+    }
     return 1;
   }
   if(resource->type == LWM2M_RESOURCE_TYPE_STR_VARIABLE_ARRAY) {
     if(context->object_instance_index < resource->value.stringvararr.count &&
        len <= resource->value.stringvararr.size) {
-      memcpy(resource->value.stringvararr.var +
-             resource->value.stringvararr.size * context->object_instance_index,
-             string, len);
-      resource->value.stringvararr.len[context->object_instance_index] = len;
+      uint8_t *var = resource->value.stringvararr.var +
+        resource->value.stringvararr.size * context->object_instance_index;
+      uint16_t *var_len =
+        &resource->value.stringvararr.len[context->object_instance_index];
+      if(len != *var_len || memcmp(var, string, len) != 0) {
+        memcpy(var, string, len);
+        *var_len = len;
+        lwm2m_notification_set_dirty(resource, context);
+      }
       return 1;
     }
     return 0;
@@ -188,13 +198,19 @@ lwm2m_object_set_resource_int(const lwm2m_resource_t *resource,
     return 0;
   }
   if(resource->type == LWM2M_RESOURCE_TYPE_INT_VARIABLE) {
-    *(resource->value.integervar.var) = value;
+    if(*(resource->value.integervar.var) != value) {
+      *(resource->value.integervar.var) = value;
+      lwm2m_notification_set_dirty(resource, context);
+    }
     return 1;
   }
   if(resource->type == LWM2M_RESOURCE_TYPE_INT_VARIABLE_ARRAY) {
     if(context->object_instance_index < resource->value.integervararr.count) {
-      resource->value.integervararr.var[context->object_instance_index] =
-        value;
+      if(resource->value.integervararr.var[context->object_instance_index] !=
+         value) {
+        resource->value.integervararr.var[context->object_instance_index] = value;
+        lwm2m_notification_set_dirty(resource, context);
+      }
       return 1;
     }
     return 0;
@@ -253,13 +269,19 @@ lwm2m_object_set_resource_floatfix(const lwm2m_resource_t *resource,
     return 0;
   }
   if(resource->type == LWM2M_RESOURCE_TYPE_FLOATFIX_VARIABLE) {
-    *(resource->value.floatfixvar.var) = value;
+    if(*(resource->value.floatfixvar.var) != value) {
+      *(resource->value.floatfixvar.var) = value;
+      lwm2m_notification_set_dirty(resource, context);
+    }
     return 1;
   }
   if(resource->type == LWM2M_RESOURCE_TYPE_FLOATFIX_VARIABLE_ARRAY) {
     if(context->object_instance_index < resource->value.floatfixvararr.count) {
-      resource->value.floatfixvararr.var[context->object_instance_index] =
-        value;
+      if(resource->value.floatfixvararr.var[context->object_instance_index] !=
+         value) {
+        resource->value.floatfixvararr.var[context->object_instance_index] = value;
+        lwm2m_notification_set_dirty(resource, context);
+      }
       return 1;
     }
     return 0;
@@ -318,13 +340,19 @@ lwm2m_object_set_resource_boolean(const lwm2m_resource_t *resource,
     return 0;
   }
   if(resource->type == LWM2M_RESOURCE_TYPE_BOOLEAN_VARIABLE) {
-    *(resource->value.booleanvar.var) = value;
+    if(*(resource->value.booleanvar.var) != value) {
+      *(resource->value.booleanvar.var) = value;
+      lwm2m_notification_set_dirty(resource, context);
+    }
     return 1;
   }
   if(resource->type == LWM2M_RESOURCE_TYPE_BOOLEAN_VARIABLE_ARRAY) {
     if(context->object_instance_index < resource->value.booleanvararr.count) {
-      resource->value.booleanvararr.var[context->object_instance_index] =
-        value;
+      if(resource->value.booleanvararr.var[context->object_instance_index] !=
+         value) {
+        resource->value.booleanvararr.var[context->object_instance_index] = value;
+        lwm2m_notification_set_dirty(resource, context);
+      }
       return 1;
     }
     return 0;
@@ -71,6 +71,9 @@
 #define LWM2M_SECURITY_KEY                      5
 #define LWM2M_SECURITY_SHORT_SERVER_ID         10
 
+#define LWM2M_SERVER_SHORT_SERVER_ID             0
+#define LWM2M_SERVER_LIFETIME                    1
+
 /* Pre-shared key mode */
 #define LWM2M_SECURITY_MODE_PSK                 0
 /* Raw Public Key mode */
@@ -95,7 +98,8 @@ typedef struct lwm2m_context {
   uint16_t resource_id;
   uint8_t object_instance_index;
   uint8_t resource_index;
-  /* TODO - add uint16_t resource_instance_id */
+  /* The resource instance written to a multiple resource */
+  uint16_t resource_instance_id;
 
   const struct lwm2m_reader *reader;
   const struct lwm2m_writer *writer;
@@ -123,6 +127,13 @@ typedef struct lwm2m_value_callback {
                 uint8_t *outbuf, size_t outlen);
   int (* exec)(lwm2m_context_t *ctx, const uint8_t *arg, size_t len,
                uint8_t *outbuf, size_t outlen);
+  /*
+   * Streaming write - called once for each Block1 fragment with the
+   * offset of the fragment and whether more fragments will follow.
+   * Returns a negative value on failure.
+   */
+  int (* write_block)(lwm2m_context_t *ctx, uint32_t offset,
+                      const uint8_t *chunk, size_t len, int more);
 } lwm2m_value_callback_t;
 
 #define LWM2M_RESOURCE_TYPE_STR_VALUE                1
@@ -198,7 +209,9 @@ typedef struct lwm2m_resource {
   } value;
 } lwm2m_resource_t;
 
-#define LWM2M_INSTANCE_FLAG_USED 1
+#define LWM2M_INSTANCE_FLAG_USED   1
+/* Set by the engine when the resources are sorted by resource id */
+#define LWM2M_INSTANCE_FLAG_SORTED 2
 
 typedef struct lwm2m_instance {
   uint16_t id;
@@ -213,8 +226,16 @@ typedef struct lwm2m_object {
   const char *path;
   resource_t *coap_resource;
   lwm2m_instance_t *instances;
+  uint8_t flags;
 } lwm2m_object_t;
 
+/*
+ * The instance table of the object is const and kept in ROM. The
+ * instances are fixed at compile time and have their resources sorted
+ * by id, which the engine verifies when the object is registered.
+ */
+#define LWM2M_OBJECT_FLAG_STATIC   1
+
 #define LWM2M_RESOURCES(name, ...)                              \
   static const lwm2m_resource_t name[] = { __VA_ARGS__ }
 
@@ -266,13 +287,21 @@ typedef struct lwm2m_object {
 #define LWM2M_INSTANCES(name, ...)                              \
   static lwm2m_instance_t name[] = { __VA_ARGS__ }
 
-#define LWM2M_OBJECT(name, id, instances)                       \
+/* Instance in a static object - resources must be listed in id order */
+#define LWM2M_INSTANCE_STATIC(id, resources)                      \
+  { id, sizeof(resources)/sizeof(lwm2m_resource_t),               \
+    LWM2M_INSTANCE_FLAG_USED | LWM2M_INSTANCE_FLAG_SORTED, resources }
+
+#define LWM2M_STATIC_INSTANCES(name, ...)                         \
+  static const lwm2m_instance_t name[] = { __VA_ARGS__ }
+
+#define LWM2M_OBJECT_DEFINE(name, id, instances, flags)           \
     static void lwm2m_get_h_##name(void *request, void *response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset); \
     static void lwm2m_put_h_##name(void *request, void *response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset); \
     static void lwm2m_post_h_##name(void *request, void *response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset); \
     static void lwm2m_delete_h_##name(void *request, void *response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset); \
-    static resource_t rest_rsc_##name = { NULL, NULL, HAS_SUB_RESOURCES | IS_OBSERVABLE, NULL, lwm2m_get_h_##name, lwm2m_post_h_##name, lwm2m_put_h_##name, lwm2m_delete_h_##name, { NULL } }; \
-    static const lwm2m_object_t name = { id, sizeof(instances)/sizeof(lwm2m_instance_t), LWM2M_OBJECT_PATH_STR(id), &rest_rsc_##name, instances}; \
+    static resource_t rest_rsc_##name = { NULL, NULL, HAS_SUB_RESOURCES | IS_OBSERVABLE | IS_SNAPSHOT, NULL, lwm2m_get_h_##name, lwm2m_post_h_##name, lwm2m_put_h_##name, lwm2m_delete_h_##name, { NULL } }; \
+    static const lwm2m_object_t name = { id, sizeof(instances)/sizeof(lwm2m_instance_t), LWM2M_OBJECT_PATH_STR(id), &rest_rsc_##name, (lwm2m_instance_t *)instances, flags}; \
     static void lwm2m_get_h_##name(void *request, void *response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset) { \
       lwm2m_engine_handler(&name, request, response, buffer, preferred_size, offset); } \
     static void lwm2m_put_h_##name(void *request, void *response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset) { \
@@ -282,6 +311,16 @@ typedef struct lwm2m_object {
     static void lwm2m_delete_h_##name(void *request, void *response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset) { \
       lwm2m_engine_delete_handler(&name, request, response, buffer, preferred_size, offset); }
 
+#define LWM2M_OBJECT(name, id, instances)                       \
+  LWM2M_OBJECT_DEFINE(name, id, instances, 0)
+
+/*
+ * Object with a const instance table (see LWM2M_STATIC_INSTANCES) that
+ * can not be created or deleted at runtime.
+ */
+#define LWM2M_STATIC_OBJECT(name, id, instances)                \
+  LWM2M_OBJECT_DEFINE(name, id, instances, LWM2M_OBJECT_FLAG_STATIC)
+
 /* how do we register attributes in the above resource here ??? */
 
 int lwm2m_object_is_resource_string(const lwm2m_resource_t *resource);
@@ -344,12 +383,27 @@ lwm2m_object_get_coap_resource(const lwm2m_object_t *object)
   return (resource_t *)object->coap_resource;
 }
 
+void lwm2m_notification_notify(const lwm2m_object_t *object,
+                               const char *path);
+
 static inline void
 lwm2m_object_notify_observers(const lwm2m_object_t *object, char *path)
 {
-  coap_notify_observers_sub(lwm2m_object_get_coap_resource(object), path);
+  /* Notifications are scheduled based on the observe attributes */
+  lwm2m_notification_notify(object, path);
 }
 
+/**
+ * \brief Report that the value of a resource has changed
+ *
+ * The resource is marked as dirty and notified to its observers, if
+ * any, from the event loop. The lwm2m_object_set_resource_*()
+ * functions do this when they change a value, this is for resources
+ * with values kept elsewhere, such as callback resources.
+ */
+void lwm2m_resource_changed(uint16_t object_id, uint16_t instance_id,
+                            uint16_t resource_id);
+
 #include "lwm2m-engine.h"
 
 #endif /* LWM2M_OBJECT_H_ */
@@ -121,34 +121,71 @@ lwm2m_plain_text_read_float32fix(const uint8_t *inbuf, size_t len,
   return i;
 }
 /*---------------------------------------------------------------------------*/
+/*
+ * Powers of ten used for formatting decimal numbers by repeated
+ * subtraction. This avoids divisions which are expensive on targets
+ * without hardware divider.
+ */
+static const uint32_t powers_of_ten[] = {
+  1000000000UL, 100000000UL, 10000000UL, 1000000UL, 100000UL,
+  10000UL, 1000UL, 100UL, 10UL, 1UL
+};
+/*---------------------------------------------------------------------------*/
+static size_t
+write_decimal(uint8_t *outbuf, size_t outlen, uint32_t value, int min_digits)
+{
+  size_t len = 0;
+  int i;
+  uint8_t digit;
+
+  for(i = 0; i < sizeof(powers_of_ten) / sizeof(powers_of_ten[0]); i++) {
+    digit = '0';
+    while(value >= powers_of_ten[i]) {
+      value -= powers_of_ten[i];
+      digit++;
+    }
+    if(digit != '0' || len > 0 ||
+       i >= sizeof(powers_of_ten) / sizeof(powers_of_ten[0]) - min_digits) {
+      if(len >= outlen) {
+        return 0;
+      }
+      outbuf[len++] = digit;
+    }
+  }
+  return len;
+}
+/*---------------------------------------------------------------------------*/
 size_t
 lwm2m_plain_text_write_float32fix(uint8_t *outbuf, size_t outlen,
                                   int32_t value, int bits)
 {
-  int64_t v;
-  unsigned long integer_part;
-  unsigned long frac_part;
-  int n, o = 0;
+  uint32_t v;
+  uint32_t frac_part;
+  size_t n, o = 0;
 
   if(outlen == 0) {
     return 0;
   }
+  v = (uint32_t)value;
   if(value < 0) {
     *outbuf++ = '-';
     outlen--;
     o = 1;
-    value = -value;
+    v = -v;
   }
 
-  integer_part = (unsigned long)(value >> bits);
-  v = value - (integer_part << bits);
-  v = (v * 100) >> bits;
-  frac_part = (unsigned long)v;
+  /* Two decimals: multiply by 100 as (x << 6) + (x << 5) + (x << 2) */
+  frac_part = v & ((1UL << bits) - 1);
+  frac_part = ((frac_part << 6) + (frac_part << 5) + (frac_part << 2)) >> bits;
 
-  n = snprintf((char *)outbuf, outlen, "%lu.%02lu", integer_part, frac_part);
-  if(n < 0 || n >= outlen) {
+  n = write_decimal(outbuf, outlen, v >> bits, 1);
+  if(n == 0 || n + 3 >= outlen) {
+    /* leave room for a terminating zero as snprintf would */
     return 0;
   }
+  outbuf[n++] = '.';
+  n += write_decimal(&outbuf[n], outlen - n, frac_part, 2);
+  outbuf[n] = '\0';
   return n + o;
 }
 /*---------------------------------------------------------------------------*/
@@ -171,11 +208,24 @@ static size_t
 write_int(const lwm2m_context_t *ctx, uint8_t *outbuf, size_t outlen,
           int32_t value)
 {
-  int n = snprintf((char *)outbuf, outlen, "%ld", (long)value);
-  if(n < 0 || n >= outlen) {
+  size_t n, o = 0;
+  uint32_t v = (uint32_t)value;
+
+  if(value < 0) {
+    if(outlen == 0) {
+      return 0;
+    }
+    *outbuf++ = '-';
+    outlen--;
+    o = 1;
+    v = -v;
+  }
+  n = write_decimal(outbuf, outlen, v, 1);
+  if(n == 0 || n >= outlen) {
     return 0;
   }
-  return n;
+  outbuf[n] = '\0';
+  return n + o;
 }
 /*---------------------------------------------------------------------------*/
 static size_t
@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \addtogroup oma-lwm2m
+ * @{
+ */
+
+/**
+ * \file
+ *         Implementation of the process profile object
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "contiki.h"
+#include "lwm2m-object.h"
+#include "lwm2m-engine.h"
+#include "lwm2m-process-profile.h"
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+#if PROCESS_CONF_PROFILE
+
+#define MAX_COUNT LWM2M_PROCESS_PROFILE_MAX_COUNT
+
+static lwm2m_instance_t profile_instances[MAX_COUNT];
+/*---------------------------------------------------------------------------*/
+static const struct process *
+get_process(const lwm2m_context_t *ctx)
+{
+  struct process *p;
+  int i;
+
+  for(p = PROCESS_LIST(), i = 0; p != NULL && i < ctx->object_instance_index;
+      p = p->next, i++);
+  return p;
+}
+/*---------------------------------------------------------------------------*/
+static int
+write_value(lwm2m_context_t *ctx, uint8_t *outbuf, size_t outsize,
+            size_t offset)
+{
+  const struct process *p = get_process(ctx);
+  uint32_t value = 0;
+
+  if(p != NULL) {
+    memcpy(&value, (const uint8_t *)&p->profile + offset, sizeof(value));
+  }
+  return ctx->writer->write_int(ctx, outbuf, outsize, (int32_t)value);
+}
+/*---------------------------------------------------------------------------*/
+#define PROFILE_READER(field)                                           \
+  static int                                                            \
+  read_##field(lwm2m_context_t *ctx, uint8_t *outbuf, size_t outsize)   \
+  {                                                                     \
+    return write_value(ctx, outbuf, outsize,                            \
+                       offsetof(struct process_profile, field));        \
+  }
+PROFILE_READER(calls)
+PROFILE_READER(run_time)
+PROFILE_READER(max_run_time)
+PROFILE_READER(events)
+PROFILE_READER(latency)
+PROFILE_READER(max_latency)
+/*---------------------------------------------------------------------------*/
+static int
+read_name(lwm2m_context_t *ctx, uint8_t *outbuf, size_t outsize)
+{
+  const struct process *p = get_process(ctx);
+  const char *name = p != NULL ? PROCESS_NAME_STRING(p) : "";
+
+  return ctx->writer->write_string(ctx, outbuf, outsize, name, strlen(name));
+}
+/*---------------------------------------------------------------------------*/
+LWM2M_RESOURCES(profile_resources,
+                LWM2M_RESOURCE_CALLBACK(LWM2M_PROCESS_PROFILE_NAME,
+                                        { read_name, NULL, NULL }),
+                LWM2M_RESOURCE_CALLBACK(LWM2M_PROCESS_PROFILE_CALLS,
+                                        { read_calls, NULL, NULL }),
+                LWM2M_RESOURCE_CALLBACK(LWM2M_PROCESS_PROFILE_RUN_TIME,
+                                        { read_run_time, NULL, NULL }),
+                LWM2M_RESOURCE_CALLBACK(LWM2M_PROCESS_PROFILE_MAX_RUN_TIME,
+                                        { read_max_run_time, NULL, NULL }),
+                LWM2M_RESOURCE_CALLBACK(LWM2M_PROCESS_PROFILE_EVENTS,
+                                        { read_events, NULL, NULL }),
+                LWM2M_RESOURCE_CALLBACK(LWM2M_PROCESS_PROFILE_LATENCY,
+                                        { read_latency, NULL, NULL }),
+                LWM2M_RESOURCE_CALLBACK(LWM2M_PROCESS_PROFILE_MAX_LATENCY,
+                                        { read_max_latency, NULL, NULL }),
+                LWM2M_RESOURCE_INTEGER(LWM2M_PROCESS_PROFILE_TICKS,
+                                       RTIMER_SECOND),
+                );
+LWM2M_OBJECT(process_profile, LWM2M_PROCESS_PROFILE_OBJECT_ID,
+             profile_instances);
+#endif /* PROCESS_CONF_PROFILE */
+/*---------------------------------------------------------------------------*/
+void
+lwm2m_process_profile_init(void)
+{
+#if PROCESS_CONF_PROFILE
+  lwm2m_instance_t template = LWM2M_INSTANCE(0, profile_resources);
+  int i;
+
+  /* All instances exist, and describe no process when there are fewer
+     processes than instances */
+  for(i = 0; i < MAX_COUNT; i++) {
+    profile_instances[i] = template;
+    profile_instances[i].id = i;
+  }
+
+  PRINTF("*** Init lwm2m-process-profile\n");
+  lwm2m_engine_register_object(&process_profile);
+#endif /* PROCESS_CONF_PROFILE */
+}
+/*---------------------------------------------------------------------------*/
+/** @} */
@@ -0,0 +1,557 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \addtogroup oma-lwm2m
+ * @{
+ */
+
+/**
+ * \file
+ *         Implementation of the Contiki OMA LWM2M resource directory server
+ */
+
+#include "contiki.h"
+#include "lwm2m-rd-server.h"
+#include "rest-engine.h"
+#include "er-coap.h"
+#include "er-coap-engine.h"
+#include "er-coap-observe.h"
+#include "er-coap-observe-client.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEBUG 0
+#if DEBUG
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+#define CLIENT_FLAG_USED 1
+
+#define MAX_CLIENTS LWM2M_RD_SERVER_MAX_CLIENTS
+#define MAX_RELAYS  LWM2M_RD_SERVER_MAX_RELAYS
+
+#if COAP_OBSERVE_CLIENT && COAP_OBSERVER_URL_LEN < LWM2M_RD_SERVER_RELAY_URL_SIZE
+#warning "COAP_OBSERVER_URL_LEN is too short for some relays"
+#endif
+
+/* Seconds between the checks for ended registrations and unused relays */
+#define CHECK_INTERVAL 10
+
+#define RD_PATH    "rd"
+#define RELAY_PATH "ep"
+
+static lwm2m_rd_client_t clients[MAX_CLIENTS];
+/* The first client of each hash bucket, plus one */
+static uint8_t buckets[LWM2M_RD_SERVER_HASH_SIZE];
+static lwm2m_rd_server_callback_t client_callback;
+static struct ctimer check_timer;
+/* The Location-Path is only serialized after the handler has returned */
+static char location[sizeof(RD_PATH) + 4];
+
+#if COAP_OBSERVE_CLIENT
+#define RELAY_FLAG_OBSERVING 1
+#define RELAY_FLAG_HAS_VALUE 2
+
+/* One observation of a client resource, shared by all its observers */
+typedef struct {
+  coap_observee_t *observee;
+  const lwm2m_rd_client_t *client;
+  uint8_t flags;
+  uint8_t value_len;
+  uint16_t content_format;
+  /* The path on the client without leading slash */
+  char path[LWM2M_RD_SERVER_RELAY_PATH_SIZE];
+  uint8_t value[LWM2M_RD_SERVER_RELAY_VALUE_SIZE];
+} relay_t;
+
+static relay_t relays[MAX_RELAYS];
+#endif /* COAP_OBSERVE_CLIENT */
+/*---------------------------------------------------------------------------*/
+static unsigned int
+hash_endpoint(const char *name, int len)
+{
+  unsigned int hash = 5381;
+  while(len-- > 0) {
+    hash = hash * 33 + (uint8_t)*name++;
+  }
+  return hash & (LWM2M_RD_SERVER_HASH_SIZE - 1);
+}
+/*---------------------------------------------------------------------------*/
+static lwm2m_rd_client_t *
+find_client(const char *name, int len)
+{
+  lwm2m_rd_client_t *c;
+  int i;
+
+  for(i = buckets[hash_endpoint(name, len)]; i > 0; i = c->next) {
+    c = &clients[i - 1];
+    if(strncmp(c->endpoint, name, len) == 0 && c->endpoint[len] == '\0') {
+      return c;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+/* The client of a location path "rd/<index>" */
+static lwm2m_rd_client_t *
+find_client_by_location(const char *url, int len)
+{
+  int index = 0;
+  int i;
+
+  if(len <= sizeof(RD_PATH) || url[sizeof(RD_PATH) - 1] != '/') {
+    return NULL;
+  }
+  for(i = sizeof(RD_PATH); i < len; i++) {
+    if(url[i] < '0' || url[i] > '9') {
+      return NULL;
+    }
+    index = index * 10 + url[i] - '0';
+  }
+  if(index >= MAX_CLIENTS || (clients[index].flags & CLIENT_FLAG_USED) == 0) {
+    return NULL;
+  }
+  return &clients[index];
+}
+/*---------------------------------------------------------------------------*/
+#if COAP_OBSERVE_CLIENT
+static void
+remove_relay(relay_t *r)
+{
+  if(r->observee != NULL && (r->flags & RELAY_FLAG_OBSERVING)) {
+    /* The next notification from the client will be reset */
+    coap_obs_remove_observee(r->observee);
+  } else if(r->observee != NULL) {
+    /* Still waiting for the client, removed when it answers */
+    r->observee->data = NULL;
+  }
+  memset(r, 0, sizeof(relay_t));
+}
+#endif /* COAP_OBSERVE_CLIENT */
+/*---------------------------------------------------------------------------*/
+static void
+remove_client(lwm2m_rd_client_t *c, int event)
+{
+  uint8_t *prev;
+  int index = c - clients;
+#if COAP_OBSERVE_CLIENT
+  int i;
+
+  for(i = 0; i < MAX_RELAYS; i++) {
+    if(relays[i].client == c) {
+      remove_relay(&relays[i]);
+    }
+  }
+#endif /* COAP_OBSERVE_CLIENT */
+
+  for(prev = &buckets[hash_endpoint(c->endpoint, strlen(c->endpoint))];
+      *prev > 0; prev = &clients[*prev - 1].next) {
+    if(*prev == index + 1) {
+      *prev = c->next;
+      break;
+    }
+  }
+
+  PRINTF("lwm2m-rd-server: %s %s\n", c->endpoint,
+         event == LWM2M_RD_SERVER_EXPIRED ? "expired" : "deregistered");
+  if(client_callback != NULL) {
+    client_callback(c, event);
+  }
+  memset(c, 0, sizeof(lwm2m_rd_client_t));
+}
+/*---------------------------------------------------------------------------*/
+/* Read the lifetime and links of a registration or update */
+static void
+update_client(lwm2m_rd_client_t *c, void *request)
+{
+  const char *str;
+  const uint8_t *payload;
+  int len;
+
+  len = coap_get_query_variable(request, "lt", &str);
+  if(len > 0) {
+    c->lifetime = strtoul(str, NULL, 10);
+  }
+  if(c->lifetime == 0) {
+    c->lifetime = LWM2M_RD_SERVER_DEFAULT_LIFETIME;
+  }
+  c->expires = clock_seconds() + c->lifetime;
+
+  len = coap_get_payload(request, &payload);
+  if(len > 0) {
+    if(len > sizeof(c->links)) {
+      /* Keep the complete links only */
+      len = sizeof(c->links);
+      while(len > 0 && payload[len - 1] != ',') {
+        len--;
+      }
+    }
+    memcpy(c->links, payload, len);
+    c->links_len = len;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+rd_post_handler(void *request, void *response, uint8_t *buffer,
+                uint16_t preferred_size, int32_t *offset)
+{
+  lwm2m_rd_client_t *c;
+  const char *url;
+  const char *name;
+  unsigned int hash;
+  int url_len, len, i;
+
+  url_len = REST.get_url(request, &url);
+  if(url_len > sizeof(RD_PATH) - 1) {
+    /* Registration update */
+    c = find_client_by_location(url, url_len);
+    if(c == NULL) {
+      REST.set_response_status(response, REST.status.NOT_FOUND);
+      return;
+    }
+    uip_ipaddr_copy(&c->addr, &UIP_IP_BUF->srcipaddr);
+    c->port = UIP_UDP_BUF->srcport;
+    update_client(c, request);
+    if(client_callback != NULL) {
+      client_callback(c, LWM2M_RD_SERVER_UPDATED);
+    }
+    REST.set_response_status(response, REST.status.CHANGED);
+    return;
+  }
+
+  len = coap_get_query_variable(request, "ep", &name);
+  if(len <= 0 || len >= LWM2M_RD_SERVER_ENDPOINT_SIZE) {
+    REST.set_response_status(response, REST.status.BAD_REQUEST);
+    return;
+  }
+
+  c = find_client(name, len);
+  if(c == NULL) {
+    for(i = 0; i < MAX_CLIENTS && (clients[i].flags & CLIENT_FLAG_USED); i++);
+    if(i == MAX_CLIENTS) {
+      PRINTF("lwm2m-rd-server: no free client slot\n");
+      REST.set_response_status(response, REST.status.SERVICE_UNAVAILABLE);
+      return;
+    }
+    c = &clients[i];
+    memcpy(c->endpoint, name, len);
+    c->endpoint[len] = '\0';
+    c->flags = CLIENT_FLAG_USED;
+    hash = hash_endpoint(name, len);
+    c->next = buckets[hash];
+    buckets[hash] = i + 1;
+  } else {
+    /* Registering again replaces the old registration */
+    c->lifetime = 0;
+  }
+
+  uip_ipaddr_copy(&c->addr, &UIP_IP_BUF->srcipaddr);
+  c->port = UIP_UDP_BUF->srcport;
+  update_client(c, request);
+
+  PRINTF("lwm2m-rd-server: registered %s for %lu s: %.*s\n", c->endpoint,
+         (unsigned long)c->lifetime, c->links_len, c->links);
+  if(client_callback != NULL) {
+    client_callback(c, LWM2M_RD_SERVER_REGISTERED);
+  }
+
+  snprintf(location, sizeof(location), RD_PATH "/%u",
+           (unsigned int)(c - clients));
+  coap_set_header_location_path(response, location);
+  REST.set_response_status(response, REST.status.CREATED);
+}
+/*---------------------------------------------------------------------------*/
+static void
+rd_delete_handler(void *request, void *response, uint8_t *buffer,
+                  uint16_t preferred_size, int32_t *offset)
+{
+  lwm2m_rd_client_t *c;
+  const char *url;
+  int url_len;
+
+  url_len = REST.get_url(request, &url);
+  c = find_client_by_location(url, url_len);
+  if(c == NULL) {
+    REST.set_response_status(response, REST.status.NOT_FOUND);
+    return;
+  }
+  remove_client(c, LWM2M_RD_SERVER_DEREGISTERED);
+  REST.set_response_status(response, REST.status.DELETED);
+}
+static PARENT_RESOURCE(rd_resource, "rt=\"core.rd\"", NULL, rd_post_handler,
+                       NULL, rd_delete_handler);
+/*---------------------------------------------------------------------------*/
+#if COAP_OBSERVE_CLIENT
+static void relay_get_handler(void *request, void *response, uint8_t *buffer,
+                              uint16_t preferred_size, int32_t *offset);
+static resource_t relay_resource = {
+  NULL, NULL, HAS_SUB_RESOURCES | IS_OBSERVABLE, "title=\"LWM2M relay\"",
+  relay_get_handler, NULL, NULL, NULL, { NULL }
+};
+/*---------------------------------------------------------------------------*/
+/* Check if anyone observes the resource of a relay */
+static int
+is_observed(const relay_t *r)
+{
+  coap_observer_t *obs;
+  const char *url;
+  int len;
+
+  for(obs = list_head(coap_get_observers()); obs; obs = obs->next) {
+    if(obs->resource != &relay_resource || obs->url_len <= sizeof(RELAY_PATH)) {
+      continue;
+    }
+    /* The observer url is "ep/<endpoint>/<path>" */
+    url = obs->url + sizeof(RELAY_PATH);
+    len = strlen(r->client->endpoint);
+    if(strncmp(url, r->client->endpoint, len) == 0 && url[len] == '/' &&
+       strcmp(&url[len + 1], r->path) == 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+relay_callback(coap_observee_t *observee, void *notification,
+               coap_notification_flag_t flag)
+{
+  relay_t *r = observee->data;
+  const uint8_t *payload;
+  unsigned int format;
+  char subpath[LWM2M_RD_SERVER_RELAY_URL_SIZE];
+  int len;
+
+  if(r == NULL) {
+    /* The relay was removed while waiting for the client. Failed
+       registrations are removed by the observe client itself */
+    if(flag == OBSERVE_OK) {
+      coap_obs_remove_observee(observee);
+    }
+    return;
+  }
+
+  if(flag != OBSERVE_OK && flag != NOTIFICATION_OK) {
+    PRINTF("lwm2m-rd-server: observation of /%s failed (%u)\n",
+           r->path, flag);
+    if((r->flags & RELAY_FLAG_OBSERVING) == 0) {
+      /* The observe client removes failed registrations itself */
+      r->observee = NULL;
+    }
+    remove_relay(r);
+    return;
+  }
+
+  r->flags |= RELAY_FLAG_OBSERVING;
+  if(!is_observed(r)) {
+    /* All observers have left */
+    remove_relay(r);
+    return;
+  }
+
+  len = coap_get_payload(notification, &payload);
+  if(len > sizeof(r->value)) {
+    PRINTF("lwm2m-rd-server: notification of /%s too large\n", r->path);
+    len = 0;
+  }
+  memcpy(r->value, payload, len);
+  r->value_len = len;
+  r->content_format = TEXT_PLAIN;
+  if(coap_get_header_content_format(notification, &format)) {
+    r->content_format = format;
+  }
+  r->flags |= RELAY_FLAG_HAS_VALUE;
+
+  /* One notification from the client is sent to all the observers. A
+     truncated url would match the observers of other relays */
+  len = snprintf(subpath, sizeof(subpath), "/%s/%s",
+                 r->client->endpoint, r->path);
+  if(len < 0 || len + sizeof(RELAY_PATH) - 1 >= COAP_OBSERVER_URL_LEN) {
+    PRINTF("lwm2m-rd-server: url of /%s too long\n", r->path);
+    remove_relay(r);
+    return;
+  }
+  coap_notify_observers_sub(&relay_resource, subpath);
+}
+/*---------------------------------------------------------------------------*/
+static relay_t *
+find_relay(const lwm2m_rd_client_t *c, const char *path, int len)
+{
+  int i;
+  for(i = 0; i < MAX_RELAYS; i++) {
+    if(relays[i].client == c && strncmp(relays[i].path, path, len) == 0 &&
+       relays[i].path[len] == '\0') {
+      return &relays[i];
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static relay_t *
+add_relay(const lwm2m_rd_client_t *c, const char *path, int len)
+{
+  relay_t *r;
+  int i;
+
+  for(i = 0; i < MAX_RELAYS && relays[i].client != NULL; i++);
+  if(i == MAX_RELAYS || len >= sizeof(r->path) ||
+     sizeof(RELAY_PATH) + strlen(c->endpoint) + 1 + len >=
+     COAP_OBSERVER_URL_LEN) {
+    /* The url of the observers would be truncated */
+    return NULL;
+  }
+  r = &relays[i];
+  r->client = c;
+  memcpy(r->path, path, len);
+  r->path[len] = '\0';
+  r->observee = coap_obs_request_registration((uip_ipaddr_t *)&c->addr,
+                                              c->port, r->path,
+                                              relay_callback, r);
+  if(r->observee == NULL) {
+    memset(r, 0, sizeof(relay_t));
+    return NULL;
+  }
+  PRINTF("lwm2m-rd-server: observing /%s at %s\n", r->path, c->endpoint);
+  return r;
+}
+/*---------------------------------------------------------------------------*/
+static void
+relay_get_handler(void *request, void *response, uint8_t *buffer,
+                  uint16_t preferred_size, int32_t *offset)
+{
+  const lwm2m_rd_client_t *c;
+  const char *url;
+  const char *path;
+  relay_t *r;
+  uint32_t observe;
+  int url_len;
+
+  /* The url is "ep/<endpoint>/<path>" */
+  url_len = REST.get_url(request, &url);
+  url += sizeof(RELAY_PATH);
+  url_len -= sizeof(RELAY_PATH);
+  path = url_len > 0 ? memchr(url, '/', url_len) : NULL;
+  c = path != NULL ? find_client(url, path - url) : NULL;
+  if(c == NULL) {
+    REST.set_response_status(response, REST.status.NOT_FOUND);
+    return;
+  }
+  path++;
+  url_len -= path - url;
+
+  r = find_relay(c, path, url_len);
+  if(r == NULL && coap_get_header_observe(request, &observe) && observe == 0) {
+    r = add_relay(c, path, url_len);
+    if(r == NULL) {
+      REST.set_response_status(response, REST.status.SERVICE_UNAVAILABLE);
+      return;
+    }
+  }
+  if(r == NULL) {
+    /* Only observed resources are relayed */
+    REST.set_response_status(response, REST.status.NOT_FOUND);
+    return;
+  }
+  if(r->flags & RELAY_FLAG_HAS_VALUE) {
+    REST.set_header_content_type(response, r->content_format);
+    REST.set_response_payload(response, r->value, r->value_len);
+  }
+  /* Without a value yet, the first notification brings it */
+}
+#endif /* COAP_OBSERVE_CLIENT */
+/*---------------------------------------------------------------------------*/
+static void
+check_clients(void *ptr)
+{
+  unsigned long now = clock_seconds();
+  int i;
+
+  ctimer_reset(&check_timer);
+  for(i = 0; i < MAX_CLIENTS; i++) {
+    if((clients[i].flags & CLIENT_FLAG_USED) &&
+       (long)(now - clients[i].expires) >= 0) {
+      remove_client(&clients[i], LWM2M_RD_SERVER_EXPIRED);
+    }
+  }
+#if COAP_OBSERVE_CLIENT
+  for(i = 0; i < MAX_RELAYS; i++) {
+    if(relays[i].client != NULL && (relays[i].flags & RELAY_FLAG_OBSERVING)
+       && !is_observed(&relays[i])) {
+      /* Stop observing the client without waiting for a notification */
+      remove_relay(&relays[i]);
+    }
+  }
+#endif /* COAP_OBSERVE_CLIENT */
+}
+/*---------------------------------------------------------------------------*/
+void
+lwm2m_rd_server_set_callback(lwm2m_rd_server_callback_t callback)
+{
+  client_callback = callback;
+}
+/*---------------------------------------------------------------------------*/
+const lwm2m_rd_client_t *
+lwm2m_rd_server_get_client(const char *endpoint)
+{
+  return find_client(endpoint, strlen(endpoint));
+}
+/*---------------------------------------------------------------------------*/
+const lwm2m_rd_client_t *
+lwm2m_rd_server_get_client_by_index(int index)
+{
+  if(index < 0 || index >= MAX_CLIENTS ||
+     (clients[index].flags & CLIENT_FLAG_USED) == 0) {
+    return NULL;
+  }
+  return &clients[index];
+}
+/*---------------------------------------------------------------------------*/
+void
+lwm2m_rd_server_init(void)
+{
+  memset(clients, 0, sizeof(clients));
+  memset(buckets, 0, sizeof(buckets));
+  rest_init_engine();
+  rest_activate_resource(&rd_resource, RD_PATH);
+#if COAP_OBSERVE_CLIENT
+  memset(relays, 0, sizeof(relays));
+  rest_activate_resource(&relay_resource, RELAY_PATH);
+#endif /* COAP_OBSERVE_CLIENT */
+  ctimer_set(&check_timer, CHECK_INTERVAL * CLOCK_SECOND, check_clients, NULL);
+}
+/*---------------------------------------------------------------------------*/
+/** @} */
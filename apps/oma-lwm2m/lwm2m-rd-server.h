@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \addtogroup oma-lwm2m
+ * @{
+ */
+
+/**
+ * \file
+ *         Header file for the Contiki OMA LWM2M resource directory server
+ *
+ *         Lets a border router act as a local LWM2M server. Clients
+ *         register, update and deregister with /rd, and are removed
+ *         when their lifetime ends. Resources of the clients can be
+ *         observed through the router at /ep/<endpoint>/<path>: all
+ *         observers of a resource share one observation of the node,
+ *         so traffic into the mesh does not grow with the observers.
+ */
+
+#ifndef LWM2M_RD_SERVER_H_
+#define LWM2M_RD_SERVER_H_
+
+#include "contiki-conf.h"
+#include "net/ip/uip.h"
+
+/* Registered clients */
+#ifdef LWM2M_RD_SERVER_CONF_MAX_CLIENTS
+#define LWM2M_RD_SERVER_MAX_CLIENTS LWM2M_RD_SERVER_CONF_MAX_CLIENTS
+#else /* LWM2M_RD_SERVER_CONF_MAX_CLIENTS */
+#define LWM2M_RD_SERVER_MAX_CLIENTS 32
+#endif /* LWM2M_RD_SERVER_CONF_MAX_CLIENTS */
+
+/* Hash buckets of the client table, a power of two */
+#ifdef LWM2M_RD_SERVER_CONF_HASH_SIZE
+#define LWM2M_RD_SERVER_HASH_SIZE LWM2M_RD_SERVER_CONF_HASH_SIZE
+#else /* LWM2M_RD_SERVER_CONF_HASH_SIZE */
+#define LWM2M_RD_SERVER_HASH_SIZE 16
+#endif /* LWM2M_RD_SERVER_CONF_HASH_SIZE */
+
+#ifdef LWM2M_RD_SERVER_CONF_ENDPOINT_SIZE
+#define LWM2M_RD_SERVER_ENDPOINT_SIZE LWM2M_RD_SERVER_CONF_ENDPOINT_SIZE
+#else /* LWM2M_RD_SERVER_CONF_ENDPOINT_SIZE */
+#define LWM2M_RD_SERVER_ENDPOINT_SIZE 24
+#endif /* LWM2M_RD_SERVER_CONF_ENDPOINT_SIZE */
+
+/* Space for the object links of each client */
+#ifdef LWM2M_RD_SERVER_CONF_LINKS_SIZE
+#define LWM2M_RD_SERVER_LINKS_SIZE LWM2M_RD_SERVER_CONF_LINKS_SIZE
+#else /* LWM2M_RD_SERVER_CONF_LINKS_SIZE */
+#define LWM2M_RD_SERVER_LINKS_SIZE 64
+#endif /* LWM2M_RD_SERVER_CONF_LINKS_SIZE */
+
+/* Lifetime in seconds of registrations that do not give one */
+#ifdef LWM2M_RD_SERVER_CONF_DEFAULT_LIFETIME
+#define LWM2M_RD_SERVER_DEFAULT_LIFETIME LWM2M_RD_SERVER_CONF_DEFAULT_LIFETIME
+#else /* LWM2M_RD_SERVER_CONF_DEFAULT_LIFETIME */
+#define LWM2M_RD_SERVER_DEFAULT_LIFETIME 86400
+#endif /* LWM2M_RD_SERVER_CONF_DEFAULT_LIFETIME */
+
+/* Resources of the clients observed through the router at a time. The
+   relay needs the CoAP observe client (COAP_OBSERVE_CLIENT) */
+#ifdef LWM2M_RD_SERVER_CONF_MAX_RELAYS
+#define LWM2M_RD_SERVER_MAX_RELAYS LWM2M_RD_SERVER_CONF_MAX_RELAYS
+#else /* LWM2M_RD_SERVER_CONF_MAX_RELAYS */
+#define LWM2M_RD_SERVER_MAX_RELAYS 8
+#endif /* LWM2M_RD_SERVER_CONF_MAX_RELAYS */
+
+/* The largest notification kept for the observers of a relay */
+#ifdef LWM2M_RD_SERVER_CONF_RELAY_VALUE_SIZE
+#define LWM2M_RD_SERVER_RELAY_VALUE_SIZE LWM2M_RD_SERVER_CONF_RELAY_VALUE_SIZE
+#else /* LWM2M_RD_SERVER_CONF_RELAY_VALUE_SIZE */
+#define LWM2M_RD_SERVER_RELAY_VALUE_SIZE 32
+#endif /* LWM2M_RD_SERVER_CONF_RELAY_VALUE_SIZE */
+
+/* The longest path of a relayed resource, including the terminating
+   zero */
+#ifdef LWM2M_RD_SERVER_CONF_RELAY_PATH_SIZE
+#define LWM2M_RD_SERVER_RELAY_PATH_SIZE LWM2M_RD_SERVER_CONF_RELAY_PATH_SIZE
+#else /* LWM2M_RD_SERVER_CONF_RELAY_PATH_SIZE */
+#define LWM2M_RD_SERVER_RELAY_PATH_SIZE 16
+#endif /* LWM2M_RD_SERVER_CONF_RELAY_PATH_SIZE */
+
+/*
+ * Relays are observed as "ep/<endpoint>/<path>", which COAP_OBSERVER_URL_LEN
+ * has to fit: with the sizes above, "ep/" and "/" take 4 bytes out of the
+ * two terminating zeros counted. Relays with longer urls are refused.
+ */
+#define LWM2M_RD_SERVER_RELAY_URL_SIZE \
+  (LWM2M_RD_SERVER_ENDPOINT_SIZE + LWM2M_RD_SERVER_RELAY_PATH_SIZE + 3)
+
+typedef struct lwm2m_rd_client {
+  uip_ipaddr_t addr;
+  uint16_t port;
+  /* The next client in the same hash bucket, plus one */
+  uint8_t next;
+  uint8_t flags;
+  uint32_t lifetime;
+  /* clock_seconds() when the registration ends */
+  unsigned long expires;
+  uint16_t links_len;
+  char endpoint[LWM2M_RD_SERVER_ENDPOINT_SIZE];
+  char links[LWM2M_RD_SERVER_LINKS_SIZE];
+} lwm2m_rd_client_t;
+
+#define LWM2M_RD_SERVER_REGISTERED   0
+#define LWM2M_RD_SERVER_UPDATED      1
+#define LWM2M_RD_SERVER_DEREGISTERED 2
+#define LWM2M_RD_SERVER_EXPIRED      3
+
+typedef void (* lwm2m_rd_server_callback_t)(const lwm2m_rd_client_t *client,
+                                            int event);
+
+/**
+ * \brief Start the resource directory and the observe relay
+ */
+void lwm2m_rd_server_init(void);
+
+/**
+ * \brief Set the function called when clients come and go
+ */
+void lwm2m_rd_server_set_callback(lwm2m_rd_server_callback_t callback);
+
+/**
+ * \brief Find a registered client by endpoint name
+ */
+const lwm2m_rd_client_t *lwm2m_rd_server_get_client(const char *endpoint);
+
+/**
+ * \brief Get the registered client in slot index
+ * \return The client or NULL if the slot is free
+ *
+ * Iterate over index 0 to LWM2M_RD_SERVER_MAX_CLIENTS - 1 to get all
+ * registered clients.
+ */
+const lwm2m_rd_client_t *lwm2m_rd_server_get_client_by_index(int index);
+
+#endif /* LWM2M_RD_SERVER_H_ */
+/** @} */
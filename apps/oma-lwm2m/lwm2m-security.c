@@ -45,6 +45,7 @@
 #include <stdint.h>
 #include "lwm2m-object.h"
 #include "lwm2m-engine.h"
+#include "lwm2m-store.h"
 
 #define DEBUG 0
 #if DEBUG
@@ -107,6 +108,9 @@ lwm2m_security_init(void)
    */
   PRINTF("*** Init lwm2m-security\n");
   lwm2m_engine_register_object(&security);
+#if LWM2M_STORE_ENABLED
+  lwm2m_store_add(&security);
+#endif /* LWM2M_STORE_ENABLED */
 }
 /*---------------------------------------------------------------------------*/
 /** @} */
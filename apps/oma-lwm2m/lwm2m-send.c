@@ -0,0 +1,292 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \addtogroup oma-lwm2m
+ * @{
+ */
+
+/**
+ * \file
+ *         Implementation of the Contiki OMA LWM2M Send operation
+ *
+ *         The payload uses the LWM2M JSON format with the root as base
+ *         name and the full path of each resource as record name:
+ *         {"bn":"/","e":[{"n":"3303/0/5700","v":22.5},...]}
+ */
+
+#include "contiki.h"
+#include "lwm2m-engine.h"
+#include "lwm2m-send.h"
+#include "lwm2m-plain-text.h"
+#include "er-coap.h"
+#include "er-coap-transactions.h"
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#define DEBUG 0
+#if DEBUG
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+/*---------------------------------------------------------------------------*/
+static size_t
+write_name(const lwm2m_context_t *ctx, uint8_t *outbuf, size_t outlen)
+{
+  int len;
+  len = snprintf((char *)outbuf, outlen, "{\"n\":\"%u/%u/%u\",",
+                 ctx->object_id, ctx->object_instance_id, ctx->resource_id);
+  if(len < 0 || len >= outlen) {
+    return 0;
+  }
+  return len;
+}
+/*---------------------------------------------------------------------------*/
+static size_t
+write_int(const lwm2m_context_t *ctx, uint8_t *outbuf, size_t outlen,
+          int32_t value)
+{
+  size_t pos;
+  int len;
+  pos = write_name(ctx, outbuf, outlen);
+  if(pos == 0) {
+    return 0;
+  }
+  len = snprintf((char *)&outbuf[pos], outlen - pos, "\"v\":%" PRId32 "}",
+                 value);
+  if(len < 0 || len >= outlen - pos) {
+    return 0;
+  }
+  return pos + len;
+}
+/*---------------------------------------------------------------------------*/
+static size_t
+write_string(const lwm2m_context_t *ctx, uint8_t *outbuf, size_t outlen,
+             const char *value, size_t stringlen)
+{
+  size_t pos;
+  int len;
+  pos = write_name(ctx, outbuf, outlen);
+  if(pos == 0) {
+    return 0;
+  }
+  len = snprintf((char *)&outbuf[pos], outlen - pos, "\"sv\":\"%.*s\"}",
+                 (int)stringlen, value);
+  if(len < 0 || len >= outlen - pos) {
+    return 0;
+  }
+  return pos + len;
+}
+/*---------------------------------------------------------------------------*/
+static size_t
+write_float32fix(const lwm2m_context_t *ctx, uint8_t *outbuf, size_t outlen,
+                 int32_t value, int bits)
+{
+  size_t pos, len;
+  pos = write_name(ctx, outbuf, outlen);
+  if(pos == 0 || outlen - pos < 4) {
+    return 0;
+  }
+  memcpy(&outbuf[pos], "\"v\":", 4);
+  pos += 4;
+  len = lwm2m_plain_text_write_float32fix(&outbuf[pos], outlen - pos,
+                                          value, bits);
+  if(len == 0 || pos + len + 1 >= outlen) {
+    return 0;
+  }
+  pos += len;
+  outbuf[pos++] = '}';
+  return pos;
+}
+/*---------------------------------------------------------------------------*/
+static size_t
+write_boolean(const lwm2m_context_t *ctx, uint8_t *outbuf, size_t outlen,
+              int value)
+{
+  size_t pos;
+  int len;
+  pos = write_name(ctx, outbuf, outlen);
+  if(pos == 0) {
+    return 0;
+  }
+  len = snprintf((char *)&outbuf[pos], outlen - pos, "\"bv\":%s}",
+                 value ? "true" : "false");
+  if(len < 0 || len >= outlen - pos) {
+    return 0;
+  }
+  return pos + len;
+}
+/*---------------------------------------------------------------------------*/
+/* Writes one record for each resource value read by a callback */
+static const lwm2m_writer_t send_record_writer = {
+  write_int,
+  write_string,
+  write_float32fix,
+  write_boolean
+};
+/*---------------------------------------------------------------------------*/
+static int
+write_record(lwm2m_context_t *context, const lwm2m_resource_t *resource,
+             uint8_t *outbuf, size_t outlen)
+{
+  if(lwm2m_object_is_resource_string(resource)) {
+    const uint8_t *value;
+    value = lwm2m_object_get_resource_string(resource, context);
+    if(value != NULL) {
+      return write_string(context, outbuf, outlen, (const char *)value,
+                          lwm2m_object_get_resource_strlen(resource, context));
+    }
+  } else if(lwm2m_object_is_resource_int(resource)) {
+    int32_t value;
+    if(lwm2m_object_get_resource_int(resource, context, &value)) {
+      return write_int(context, outbuf, outlen, value);
+    }
+  } else if(lwm2m_object_is_resource_floatfix(resource)) {
+    int32_t value;
+    if(lwm2m_object_get_resource_floatfix(resource, context, &value)) {
+      return write_float32fix(context, outbuf, outlen, value,
+                              LWM2M_FLOAT32_BITS);
+    }
+  } else if(lwm2m_object_is_resource_boolean(resource)) {
+    int value;
+    if(lwm2m_object_get_resource_boolean(resource, context, &value)) {
+      return write_boolean(context, outbuf, outlen, value);
+    }
+  } else if(lwm2m_object_is_resource_callback(resource) &&
+            resource->value.callback.read != NULL) {
+    context->writer = &send_record_writer;
+    return resource->value.callback.read(context, outbuf, outlen);
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+lwm2m_send_write(const lwm2m_send_path_t *paths, int count,
+                 uint8_t *outbuf, size_t outlen)
+{
+  const lwm2m_resource_t *resource;
+  lwm2m_context_t context;
+  size_t pos;
+  int i, len, sep;
+
+  if(outlen < 16) {
+    return -1;
+  }
+  memcpy(outbuf, "{\"bn\":\"/\",\"e\":[", 15);
+  pos = 15;
+
+  for(i = 0; i < count; i++) {
+    memset(&context, 0, sizeof(context));
+    context.object_id = paths[i].object_id;
+    context.object_instance_id = paths[i].object_instance_id;
+    context.resource_id = paths[i].resource_id;
+    resource = lwm2m_engine_get_resource(&context);
+    if(resource == NULL) {
+      PRINTF("lwm2m-send: no resource %u/%u/%u\n", context.object_id,
+             context.object_instance_id, context.resource_id);
+      continue;
+    }
+
+    /* Records after the first are preceded by a separator */
+    sep = pos > 15 ? 1 : 0;
+    if(pos + sep >= outlen) {
+      return -1;
+    }
+    outbuf[pos] = ',';
+    len = write_record(&context, resource, &outbuf[pos + sep],
+                       outlen - pos - sep);
+    if(len > 0) {
+      pos += sep + len;
+    } else {
+      /* No value or no space for this resource - leave it out */
+      PRINTF("lwm2m-send: no value for %u/%u/%u\n", context.object_id,
+             context.object_instance_id, context.resource_id);
+    }
+  }
+
+  if(pos + 2 > outlen) {
+    return -1;
+  }
+  outbuf[pos++] = ']';
+  outbuf[pos++] = '}';
+  return pos;
+}
+/*---------------------------------------------------------------------------*/
+int
+lwm2m_send(const lwm2m_send_path_t *paths, int count)
+{
+  coap_packet_t request[1]; /* this way the packet can be treated as pointer as usual */
+  coap_transaction_t *transaction;
+  uip_ipaddr_t ipaddr;
+  uint16_t port;
+  uint16_t mid;
+  int i, len, sent = 0;
+
+  for(i = 0; i < LWM2M_ENGINE_MAX_SERVERS; i++) {
+    if(!lwm2m_engine_get_server(i, &ipaddr, &port)) {
+      continue;
+    }
+    mid = coap_get_mid();
+    transaction = coap_new_transaction(mid, &ipaddr, port);
+    if(transaction == NULL) {
+      PRINTF("lwm2m-send: no free transaction\n");
+      break;
+    }
+
+    len = lwm2m_send_write(paths, count,
+                           transaction->packet + COAP_MAX_HEADER_SIZE,
+                           REST_MAX_CHUNK_SIZE);
+    if(len < 0) {
+      PRINTF("lwm2m-send: payload does not fit\n");
+      coap_clear_transaction(transaction);
+      break;
+    }
+
+    coap_init_message(request, LWM2M_SEND_CONFIRMABLE ?
+                      COAP_TYPE_CON : COAP_TYPE_NON, COAP_POST, mid);
+    coap_set_header_uri_path(request, LWM2M_SEND_URI);
+    coap_set_header_content_format(request, LWM2M_JSON);
+    coap_set_payload(request, transaction->packet + COAP_MAX_HEADER_SIZE, len);
+    transaction->packet_len = coap_serialize_message(request,
+                                                     transaction->packet);
+    if(transaction->packet_len == 0) {
+      coap_clear_transaction(transaction);
+      break;
+    }
+    coap_send_transaction(transaction);
+    sent++;
+  }
+  return sent;
+}
+/*---------------------------------------------------------------------------*/
+/** @} */
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \addtogroup oma-lwm2m
+ * @{
+ */
+
+/**
+ * \file
+ *         Header file for the Contiki OMA LWM2M Send operation
+ *
+ *         A set of resources, possibly from different objects, is read
+ *         in one call and reported to the LWM2M servers in a single
+ *         LWM2M JSON payload instead of one notification per resource.
+ */
+
+#ifndef LWM2M_SEND_H_
+#define LWM2M_SEND_H_
+
+#include "lwm2m-object.h"
+
+/* The uri path of the data collection interface on the server */
+#ifdef LWM2M_SEND_CONF_URI
+#define LWM2M_SEND_URI LWM2M_SEND_CONF_URI
+#else /* LWM2M_SEND_CONF_URI */
+#define LWM2M_SEND_URI "dp"
+#endif /* LWM2M_SEND_CONF_URI */
+
+/* Send the report as confirmable instead of non-confirmable message */
+#ifdef LWM2M_SEND_CONF_CONFIRMABLE
+#define LWM2M_SEND_CONFIRMABLE LWM2M_SEND_CONF_CONFIRMABLE
+#else /* LWM2M_SEND_CONF_CONFIRMABLE */
+#define LWM2M_SEND_CONFIRMABLE 0
+#endif /* LWM2M_SEND_CONF_CONFIRMABLE */
+
+typedef struct lwm2m_send_path {
+  uint16_t object_id;
+  uint16_t object_instance_id;
+  uint16_t resource_id;
+} lwm2m_send_path_t;
+
+#define LWM2M_SEND_PATH(object_id, instance_id, resource_id)  \
+  { object_id, instance_id, resource_id }
+
+#define LWM2M_SEND_PATHS(name, ...)                             \
+  static const lwm2m_send_path_t name[] = { __VA_ARGS__ }
+
+#define LWM2M_SEND_PATH_COUNT(name) (sizeof(name) / sizeof(lwm2m_send_path_t))
+
+/**
+ * \brief Write the resources as one LWM2M JSON payload
+ * \param paths  The resources to read
+ * \param count  The number of resources
+ * \param outbuf The buffer for the payload
+ * \param outlen The size of the buffer
+ *
+ * Resources that do not exist, can not be read, or do not fit in the
+ * buffer are left out.
+ * \return The length of the payload or -1 if it does not fit in the buffer
+ */
+int lwm2m_send_write(const lwm2m_send_path_t *paths, int count,
+                     uint8_t *outbuf, size_t outlen);
+
+/**
+ * \brief Read the resources and send them to all registered servers
+ * \param paths  The resources to read
+ * \param count  The number of resources
+ *
+ * The payload must fit in REST_MAX_CHUNK_SIZE.
+ * \return The number of servers the report was sent to
+ */
+int lwm2m_send(const lwm2m_send_path_t *paths, int count);
+
+#endif /* LWM2M_SEND_H_ */
+/** @} */
@@ -0,0 +1,623 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \addtogroup oma-lwm2m
+ * @{
+ */
+
+/**
+ * \file
+ *         Implementation of the Contiki OMA LWM2M SenML CBOR reader / writer.
+ *         A resource is written as a SenML pack with a single record
+ *         holding the resource id as name and the value. Fixed point
+ *         values are converted to single precision floats using integer
+ *         operations only.
+ */
+
+#include "lwm2m-object.h"
+#include "lwm2m-senml-cbor.h"
+#include <string.h>
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+/* CBOR major types */
+#define CBOR_UNSIGNED      0
+#define CBOR_NEGATIVE      1
+#define CBOR_BYTE_STRING   2
+#define CBOR_TEXT_STRING   3
+#define CBOR_ARRAY         4
+#define CBOR_MAP           5
+#define CBOR_TAG           6
+#define CBOR_SIMPLE        7
+
+#define CBOR_FALSE         0xf4
+#define CBOR_TRUE          0xf5
+#define CBOR_FLOAT16       0xf9
+#define CBOR_FLOAT32       0xfa
+#define CBOR_FLOAT64       0xfb
+
+/* SenML CBOR labels */
+#define SENML_BASE_NAME    -2
+#define SENML_NAME         0
+#define SENML_VALUE        2
+#define SENML_STRING_VALUE 3
+#define SENML_BOOL_VALUE   4
+/*---------------------------------------------------------------------------*/
+static size_t
+write_head(uint8_t *outbuf, size_t outlen, uint8_t major, uint32_t value)
+{
+  major <<= 5;
+  if(value < 24) {
+    if(outlen < 1) {
+      return 0;
+    }
+    outbuf[0] = major | value;
+    return 1;
+  }
+  if(value <= 0xff) {
+    if(outlen < 2) {
+      return 0;
+    }
+    outbuf[0] = major | 24;
+    outbuf[1] = value;
+    return 2;
+  }
+  if(value <= 0xffff) {
+    if(outlen < 3) {
+      return 0;
+    }
+    outbuf[0] = major | 25;
+    outbuf[1] = value >> 8;
+    outbuf[2] = value;
+    return 3;
+  }
+  if(outlen < 5) {
+    return 0;
+  }
+  outbuf[0] = major | 26;
+  outbuf[1] = value >> 24;
+  outbuf[2] = value >> 16;
+  outbuf[3] = value >> 8;
+  outbuf[4] = value;
+  return 5;
+}
+/*---------------------------------------------------------------------------*/
+/* Write the start of the record up to and including the value label */
+static size_t
+write_record(const lwm2m_context_t *ctx, uint8_t *outbuf, size_t outlen,
+             uint8_t label)
+{
+  uint8_t name[6];
+  size_t pos, len;
+  uint16_t id;
+  int i;
+
+  /* the name is the resource id as text */
+  id = ctx->resource_id;
+  i = sizeof(name);
+  do {
+    name[--i] = '0' + id % 10;
+    id /= 10;
+  } while(id > 0 && i > 0);
+
+  len = sizeof(name) - i;
+  if(outlen < 4 + len) {
+    return 0;
+  }
+  outbuf[0] = (CBOR_ARRAY << 5) | 1;
+  outbuf[1] = (CBOR_MAP << 5) | 2;
+  outbuf[2] = SENML_NAME;
+  outbuf[3] = (CBOR_TEXT_STRING << 5) | len;
+  memcpy(&outbuf[4], &name[i], len);
+  pos = 4 + len;
+  if(pos >= outlen) {
+    return 0;
+  }
+  outbuf[pos++] = label;
+  return pos;
+}
+/*---------------------------------------------------------------------------*/
+static size_t
+write_signed(uint8_t *outbuf, size_t outlen, int32_t value)
+{
+  if(value < 0) {
+    return write_head(outbuf, outlen, CBOR_NEGATIVE,
+                      (uint32_t)(-(value + 1)));
+  }
+  return write_head(outbuf, outlen, CBOR_UNSIGNED, (uint32_t)value);
+}
+/*---------------------------------------------------------------------------*/
+static size_t
+write_int(const lwm2m_context_t *ctx, uint8_t *outbuf, size_t outlen,
+          int32_t value)
+{
+  size_t pos, len;
+
+  pos = write_record(ctx, outbuf, outlen, SENML_VALUE);
+  if(pos == 0) {
+    return 0;
+  }
+  len = write_signed(&outbuf[pos], outlen - pos, value);
+  return len == 0 ? 0 : pos + len;
+}
+/*---------------------------------------------------------------------------*/
+static size_t
+write_float32fix(const lwm2m_context_t *ctx, uint8_t *outbuf, size_t outlen,
+                 int32_t value, int bits)
+{
+  uint32_t mantissa;
+  uint32_t f;
+  size_t pos, len;
+  int msb;
+
+  pos = write_record(ctx, outbuf, outlen, SENML_VALUE);
+  if(pos == 0) {
+    return 0;
+  }
+
+  if((value & ((1L << bits) - 1)) == 0) {
+    /* No fraction - an integer is more compact */
+    len = write_signed(&outbuf[pos], outlen - pos, value >> bits);
+    return len == 0 ? 0 : pos + len;
+  }
+
+  if(outlen - pos < 5) {
+    return 0;
+  }
+
+  f = 0;
+  mantissa = value < 0 ? -(uint32_t)value : (uint32_t)value;
+  if(value < 0) {
+    f = 0x80000000UL;
+  }
+  for(msb = 31; (mantissa & (1UL << msb)) == 0; msb--);
+  /* normalize the mantissa to 24 bits with the implicit leading one */
+  if(msb > 23) {
+    mantissa >>= msb - 23;
+  } else {
+    mantissa <<= 23 - msb;
+  }
+  f |= ((uint32_t)(msb - bits + 127) << 23) | (mantissa & 0x7fffffUL);
+
+  outbuf[pos++] = CBOR_FLOAT32;
+  outbuf[pos++] = f >> 24;
+  outbuf[pos++] = f >> 16;
+  outbuf[pos++] = f >> 8;
+  outbuf[pos++] = f;
+  return pos;
+}
+/*---------------------------------------------------------------------------*/
+static size_t
+write_boolean(const lwm2m_context_t *ctx, uint8_t *outbuf, size_t outlen,
+              int value)
+{
+  size_t pos;
+
+  pos = write_record(ctx, outbuf, outlen, SENML_BOOL_VALUE);
+  if(pos == 0 || pos >= outlen) {
+    return 0;
+  }
+  outbuf[pos++] = value ? CBOR_TRUE : CBOR_FALSE;
+  return pos;
+}
+/*---------------------------------------------------------------------------*/
+static size_t
+write_string(const lwm2m_context_t *ctx, uint8_t *outbuf, size_t outlen,
+             const char *value, size_t stringlen)
+{
+  size_t pos, len;
+
+  pos = write_record(ctx, outbuf, outlen, SENML_STRING_VALUE);
+  if(pos == 0) {
+    return 0;
+  }
+  len = write_head(&outbuf[pos], outlen - pos, CBOR_TEXT_STRING, stringlen);
+  if(len == 0 || pos + len + stringlen > outlen) {
+    return 0;
+  }
+  pos += len;
+  memcpy(&outbuf[pos], value, stringlen);
+  return pos + stringlen;
+}
+/*---------------------------------------------------------------------------*/
+const lwm2m_writer_t lwm2m_senml_cbor_writer = {
+  write_int,
+  write_string,
+  write_float32fix,
+  write_boolean
+};
+/*---------------------------------------------------------------------------*/
+/*
+ * Read the head of a data item. Returns the size of the head or 0 if
+ * the item is malformed or not supported (indefinite lengths, 64-bit
+ * arguments).
+ */
+static size_t
+read_head(const uint8_t *inbuf, size_t len, uint8_t *major, uint32_t *value)
+{
+  uint8_t info;
+  size_t size, i;
+
+  if(len < 1) {
+    return 0;
+  }
+  *major = inbuf[0] >> 5;
+  info = inbuf[0] & 0x1f;
+  if(info < 24) {
+    *value = info;
+    return 1;
+  }
+  if(info > 26) {
+    return 0;
+  }
+  size = 1 + (1 << (info - 24));
+  if(len < size) {
+    return 0;
+  }
+  *value = 0;
+  for(i = 1; i < size; i++) {
+    *value = (*value << 8) | inbuf[i];
+  }
+  return size;
+}
+/*---------------------------------------------------------------------------*/
+/* Skip one non-container data item */
+static size_t
+skip_item(const uint8_t *inbuf, size_t len)
+{
+  uint8_t major;
+  uint32_t value;
+  size_t size;
+
+  if(len > 0 && inbuf[0] == CBOR_FLOAT64) {
+    return len < 9 ? 0 : 9;
+  }
+  size = read_head(inbuf, len, &major, &value);
+  if(size == 0) {
+    return 0;
+  }
+  if(major == CBOR_BYTE_STRING || major == CBOR_TEXT_STRING) {
+    if(value > len - size) {
+      return 0;
+    }
+    size += value;
+  } else if(major == CBOR_ARRAY || major == CBOR_MAP || major == CBOR_TAG) {
+    return 0;
+  }
+  return size;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Find the value of the first record. The payload can either be a
+ * SenML pack or a single bare value. Returns the offset of the value.
+ */
+static int
+find_value(const uint8_t *inbuf, size_t len, uint8_t label)
+{
+  uint8_t major;
+  uint32_t value, pairs;
+  size_t pos, size;
+  int32_t key;
+
+  pos = 0;
+  size = read_head(inbuf, len, &major, &value);
+  if(size == 0) {
+    return -1;
+  }
+  if(major == CBOR_ARRAY) {
+    if(value == 0) {
+      return -1;
+    }
+    pos += size;
+    size = read_head(&inbuf[pos], len - pos, &major, &value);
+    if(size == 0) {
+      return -1;
+    }
+  }
+  if(major != CBOR_MAP) {
+    /* A bare value */
+    return pos < len ? pos : -1;
+  }
+  pos += size;
+
+  for(pairs = value; pairs > 0; pairs--) {
+    size = read_head(&inbuf[pos], len - pos, &major, &value);
+    if(size == 0 || (major != CBOR_UNSIGNED && major != CBOR_NEGATIVE)) {
+      return -1;
+    }
+    key = major == CBOR_UNSIGNED ? (int32_t)value : -1 - (int32_t)value;
+    pos += size;
+    if(key == label) {
+      return pos < len ? pos : -1;
+    }
+    size = skip_item(&inbuf[pos], len - pos);
+    if(size == 0) {
+      return -1;
+    }
+    pos += size;
+  }
+  return -1;
+}
+/*---------------------------------------------------------------------------*/
+/* Convert an IEEE 754 value split into parts to fixed point */
+static int32_t
+to_fix(int negative, int exponent, uint32_t mantissa, int mantissa_bits,
+       int bits)
+{
+  int shift;
+  uint32_t v;
+
+  shift = exponent - mantissa_bits + bits;
+  if(shift >= 0) {
+    v = shift > 31 ? 0x7fffffffUL : mantissa << shift;
+  } else {
+    v = -shift > 31 ? 0 : mantissa >> -shift;
+  }
+  return negative ? -(int32_t)v : (int32_t)v;
+}
+/*---------------------------------------------------------------------------*/
+static size_t
+read_number(const uint8_t *inbuf, size_t len, int32_t *value, int bits)
+{
+  uint8_t major;
+  uint32_t v;
+  size_t size;
+  int pos, exponent;
+
+  pos = find_value(inbuf, len, SENML_VALUE);
+  if(pos < 0) {
+    return 0;
+  }
+
+  if(inbuf[pos] == CBOR_FLOAT32) {
+    if(len - pos < 5) {
+      return 0;
+    }
+    v = ((uint32_t)inbuf[pos + 1] << 24) | ((uint32_t)inbuf[pos + 2] << 16)
+      | ((uint32_t)inbuf[pos + 3] << 8) | inbuf[pos + 4];
+    exponent = (v >> 23) & 0xff;
+    *value = exponent == 0 ? 0 :
+      to_fix(v >> 31, exponent - 127, (v & 0x7fffffUL) | 0x800000UL, 23, bits);
+    return pos + 5;
+  }
+  if(inbuf[pos] == CBOR_FLOAT16) {
+    if(len - pos < 3) {
+      return 0;
+    }
+    v = ((uint32_t)inbuf[pos + 1] << 8) | inbuf[pos + 2];
+    exponent = (v >> 10) & 0x1f;
+    *value = exponent == 0 ? 0 :
+      to_fix(v >> 15, exponent - 15, (v & 0x3ff) | 0x400, 10, bits);
+    return pos + 3;
+  }
+  if(inbuf[pos] == CBOR_FLOAT64) {
+    if(len - pos < 9) {
+      return 0;
+    }
+    v = ((uint32_t)inbuf[pos + 1] << 8) | inbuf[pos + 2];
+    exponent = (v >> 4) & 0x7ff;
+    /* keep the 28 most significant bits of the mantissa */
+    v = ((v & 0xf) << 24) | ((uint32_t)inbuf[pos + 3] << 16)
+      | ((uint32_t)inbuf[pos + 4] << 8) | inbuf[pos + 5];
+    *value = exponent == 0 ? 0 :
+      to_fix(inbuf[pos + 1] >> 7, exponent - 1023, v | 0x10000000UL, 28, bits);
+    return pos + 9;
+  }
+
+  size = read_head(&inbuf[pos], len - pos, &major, &v);
+  if(size == 0 || v > 0x7fffffffUL) {
+    return 0;
+  }
+  if(major == CBOR_UNSIGNED) {
+    *value = (int32_t)v << bits;
+  } else if(major == CBOR_NEGATIVE) {
+    *value = (-1 - (int32_t)v) << bits;
+  } else {
+    return 0;
+  }
+  return pos + size;
+}
+/*---------------------------------------------------------------------------*/
+static size_t
+read_int(const lwm2m_context_t *ctx, const uint8_t *inbuf, size_t len,
+         int32_t *value)
+{
+  return read_number(inbuf, len, value, 0);
+}
+/*---------------------------------------------------------------------------*/
+static size_t
+read_float32fix(const lwm2m_context_t *ctx, const uint8_t *inbuf, size_t len,
+                int32_t *value, int bits)
+{
+  return read_number(inbuf, len, value, bits);
+}
+/*---------------------------------------------------------------------------*/
+static size_t
+read_string(const lwm2m_context_t *ctx, const uint8_t *inbuf, size_t len,
+            uint8_t *value, size_t stringlen)
+{
+  uint8_t major;
+  uint32_t v;
+  size_t size;
+  int pos;
+
+  pos = find_value(inbuf, len, SENML_STRING_VALUE);
+  if(pos < 0) {
+    return 0;
+  }
+  size = read_head(&inbuf[pos], len - pos, &major, &v);
+  if(size == 0 || major != CBOR_TEXT_STRING
+     || v > len - pos - size || v >= stringlen) {
+    /* The outbuffer can not contain the full string including ending zero */
+    return 0;
+  }
+  memcpy(value, &inbuf[pos + size], v);
+  value[v] = '\0';
+  return pos + size + v;
+}
+/*---------------------------------------------------------------------------*/
+static size_t
+read_boolean(const lwm2m_context_t *ctx, const uint8_t *inbuf, size_t len,
+             int *value)
+{
+  int pos;
+
+  pos = find_value(inbuf, len, SENML_BOOL_VALUE);
+  if(pos < 0 || (inbuf[pos] != CBOR_TRUE && inbuf[pos] != CBOR_FALSE)) {
+    return 0;
+  }
+  *value = inbuf[pos] == CBOR_TRUE;
+  return pos + 1;
+}
+/*---------------------------------------------------------------------------*/
+const lwm2m_reader_t lwm2m_senml_cbor_reader = {
+  read_int,
+  read_string,
+  read_float32fix,
+  read_boolean
+};
+/*---------------------------------------------------------------------------*/
+int
+lwm2m_senml_cbor_iterator_init(lwm2m_senml_cbor_iterator_t *it,
+                               const uint8_t *data, size_t len)
+{
+  uint8_t major;
+  uint32_t value;
+  size_t size;
+
+  memset(it, 0, sizeof(lwm2m_senml_cbor_iterator_t));
+  size = read_head(data, len, &major, &value);
+  if(size == 0 || major != CBOR_ARRAY) {
+    return 0;
+  }
+  it->data = data;
+  it->len = len;
+  it->pos = size;
+  it->remaining = value;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Continue the number after the last '/' of a name with more of it */
+static int
+parse_name_id(const uint8_t *name, size_t len, uint32_t *id, uint8_t *has_id)
+{
+  size_t i;
+  for(i = 0; i < len; i++) {
+    if(name[i] == '/') {
+      *id = 0;
+      *has_id = 0;
+    } else if(name[i] >= '0' && name[i] <= '9' && *id <= 0xffff) {
+      *id = *id * 10 + (name[i] - '0');
+      *has_id = 1;
+    } else {
+      return 0;
+    }
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+int
+lwm2m_senml_cbor_next_record(lwm2m_senml_cbor_iterator_t *it,
+                             uint16_t *resource_id,
+                             const uint8_t **record, size_t *record_len)
+{
+  const uint8_t *name = NULL;
+  uint8_t major, has_id;
+  uint32_t value, pairs, id, name_len = 0;
+  size_t start, pos, size;
+  int32_t key;
+
+  if(it->remaining == 0) {
+    return 0;
+  }
+  it->remaining--;
+
+  start = pos = it->pos;
+  size = read_head(&it->data[pos], it->len - pos, &major, &value);
+  if(size == 0 || major != CBOR_MAP) {
+    return -1;
+  }
+  pos += size;
+
+  for(pairs = value; pairs > 0; pairs--) {
+    size = read_head(&it->data[pos], it->len - pos, &major, &value);
+    if(size == 0 || (major != CBOR_UNSIGNED && major != CBOR_NEGATIVE)) {
+      return -1;
+    }
+    key = major == CBOR_UNSIGNED ? (int32_t)value : -1 - (int32_t)value;
+    pos += size;
+    if(key == SENML_BASE_NAME || key == SENML_NAME) {
+      size = read_head(&it->data[pos], it->len - pos, &major, &value);
+      if(size == 0 || major != CBOR_TEXT_STRING
+         || value > it->len - pos - size) {
+        return -1;
+      }
+      if(key == SENML_BASE_NAME) {
+        /* The base name applies to this and the following records */
+        it->base_id = 0;
+        it->base_has_id = 0;
+        if(!parse_name_id(&it->data[pos + size], value,
+                          &it->base_id, &it->base_has_id)) {
+          return -1;
+        }
+      } else {
+        name = &it->data[pos + size];
+        name_len = value;
+      }
+    }
+    size = skip_item(&it->data[pos], it->len - pos);
+    if(size == 0) {
+      return -1;
+    }
+    pos += size;
+  }
+
+  id = it->base_id;
+  has_id = it->base_has_id;
+  if((name != NULL && !parse_name_id(name, name_len, &id, &has_id))
+     || !has_id || id > 0xffff) {
+    return -1;
+  }
+
+  it->pos = pos;
+  *resource_id = (uint16_t)id;
+  *record = &it->data[start];
+  *record_len = pos - start;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/** @} */
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \addtogroup oma-lwm2m
+ * @{
+ */
+
+/**
+ * \file
+ *         Header file for the Contiki OMA LWM2M SenML CBOR reader / writer
+ */
+
+#ifndef LWM2M_SENML_CBOR_H_
+#define LWM2M_SENML_CBOR_H_
+
+#include "lwm2m-object.h"
+
+extern const lwm2m_reader_t lwm2m_senml_cbor_reader;
+extern const lwm2m_writer_t lwm2m_senml_cbor_writer;
+
+/* Walks the records of a SenML pack */
+typedef struct lwm2m_senml_cbor_iterator {
+  const uint8_t *data;
+  size_t len;
+  size_t pos;
+  uint32_t remaining;
+  /* The number ending the base name, if any */
+  uint32_t base_id;
+  uint8_t base_has_id;
+} lwm2m_senml_cbor_iterator_t;
+
+/**
+ * Start walking the records of a SenML pack.
+ *
+ * \return Non-zero if the data starts like a SenML pack
+ */
+int lwm2m_senml_cbor_iterator_init(lwm2m_senml_cbor_iterator_t *it,
+                                   const uint8_t *data, size_t len);
+
+/**
+ * Get the next record of a SenML pack. The resource id is the number
+ * ending the name of the record, appended to the base name. The
+ * record can be passed on to lwm2m_senml_cbor_reader.
+ *
+ * \return 1 if a record was found, 0 after the last record and -1 if
+ *         the pack is malformed
+ */
+int lwm2m_senml_cbor_next_record(lwm2m_senml_cbor_iterator_t *it,
+                                 uint16_t *resource_id,
+                                 const uint8_t **record, size_t *record_len);
+
+#endif /* LWM2M_SENML_CBOR_H_ */
+/** @} */
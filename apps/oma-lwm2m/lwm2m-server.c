@@ -45,6 +45,7 @@
 #include <stdint.h>
 #include "lwm2m-object.h"
 #include "lwm2m-engine.h"
+#include "lwm2m-store.h"
 
 #define DEBUG 0
 #if DEBUG
@@ -88,6 +89,9 @@ lwm2m_server_init(void)
    */
   PRINTF("*** Init lwm2m-server\n");
   lwm2m_engine_register_object(&server);
+#if LWM2M_STORE_ENABLED
+  lwm2m_store_add(&server);
+#endif /* LWM2M_STORE_ENABLED */
 }
 /*---------------------------------------------------------------------------*/
 /** @} */
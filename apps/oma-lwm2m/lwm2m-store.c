@@ -0,0 +1,385 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \addtogroup oma-lwm2m
+ * @{
+ */
+
+/**
+ * \file
+ *         Persistent storage of Contiki OMA LWM2M objects.
+ *
+ *         The file holds one record for each added object:
+ *           object id (2), record length (2), and for each instance slot
+ *           the flags (1) and id (2) followed by the value of each
+ *           variable resource. Strings are stored with their length and
+ *           full buffer size to keep the layout fixed.
+ */
+
+#include "contiki.h"
+#include "lwm2m-object.h"
+#include "lwm2m-engine.h"
+#include "lwm2m-store.h"
+#include "cfs/cfs.h"
+#if LWM2M_STORE_COFFEE
+#include "cfs/cfs-coffee.h"
+#endif /* LWM2M_STORE_COFFEE */
+#include <string.h>
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+#ifndef LWM2M_STORE_MAX_STRING_SIZE
+#define LWM2M_STORE_MAX_STRING_SIZE    64
+#endif /* LWM2M_STORE_MAX_STRING_SIZE */
+
+#ifndef LWM2M_STORE_COFFEE_LOG_SIZE
+#define LWM2M_STORE_COFFEE_LOG_SIZE    1024
+#endif /* LWM2M_STORE_COFFEE_LOG_SIZE */
+
+#ifndef LWM2M_STORE_COFFEE_RECORD_SIZE
+#define LWM2M_STORE_COFFEE_RECORD_SIZE 64
+#endif /* LWM2M_STORE_COFFEE_RECORD_SIZE */
+
+static const lwm2m_object_t *store_objects[LWM2M_STORE_MAX_OBJECTS];
+static struct ctimer store_timer;
+/* large enough for the largest stored value */
+static uint8_t value_buf[2 + LWM2M_STORE_MAX_STRING_SIZE];
+/*---------------------------------------------------------------------------*/
+static int
+is_persistent(const lwm2m_resource_t *resource)
+{
+  switch(resource->type) {
+  case LWM2M_RESOURCE_TYPE_STR_VARIABLE:
+  case LWM2M_RESOURCE_TYPE_STR_VARIABLE_ARRAY:
+  case LWM2M_RESOURCE_TYPE_INT_VARIABLE:
+  case LWM2M_RESOURCE_TYPE_INT_VARIABLE_ARRAY:
+  case LWM2M_RESOURCE_TYPE_FLOATFIX_VARIABLE:
+  case LWM2M_RESOURCE_TYPE_FLOATFIX_VARIABLE_ARRAY:
+  case LWM2M_RESOURCE_TYPE_BOOLEAN_VARIABLE:
+  case LWM2M_RESOURCE_TYPE_BOOLEAN_VARIABLE_ARRAY:
+    return 1;
+  default:
+    return 0;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+get_string_size(const lwm2m_resource_t *resource)
+{
+  if(resource->type == LWM2M_RESOURCE_TYPE_STR_VARIABLE) {
+    return resource->value.stringvar.size;
+  }
+  return resource->value.stringvararr.size;
+}
+/*---------------------------------------------------------------------------*/
+static int
+get_value_size(const lwm2m_resource_t *resource)
+{
+  if(lwm2m_object_is_resource_string(resource)) {
+    return 2 + get_string_size(resource);
+  }
+  if(lwm2m_object_is_resource_boolean(resource)) {
+    return 1;
+  }
+  return 4;
+}
+/*---------------------------------------------------------------------------*/
+static void
+write_value(const lwm2m_resource_t *resource, lwm2m_context_t *context,
+            uint8_t *buf)
+{
+  const uint8_t *s;
+  uint16_t len, max;
+  int32_t v;
+  int b;
+
+  if(lwm2m_object_is_resource_string(resource)) {
+    max = get_string_size(resource);
+    s = lwm2m_object_get_resource_string(resource, context);
+    len = lwm2m_object_get_resource_strlen(resource, context);
+    if(s == NULL || len > max) {
+      len = 0;
+    }
+    buf[0] = len >> 8;
+    buf[1] = len & 0xff;
+    memset(&buf[2], 0, max);
+    if(len > 0) {
+      memcpy(&buf[2], s, len);
+    }
+  } else if(lwm2m_object_is_resource_boolean(resource)) {
+    b = 0;
+    lwm2m_object_get_resource_boolean(resource, context, &b);
+    buf[0] = b != 0;
+  } else {
+    v = 0;
+    if(lwm2m_object_is_resource_floatfix(resource)) {
+      lwm2m_object_get_resource_floatfix(resource, context, &v);
+    } else {
+      lwm2m_object_get_resource_int(resource, context, &v);
+    }
+    buf[0] = v >> 24;
+    buf[1] = v >> 16;
+    buf[2] = v >> 8;
+    buf[3] = v;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+read_value(const lwm2m_resource_t *resource, lwm2m_context_t *context,
+           const uint8_t *buf)
+{
+  uint16_t len;
+  int32_t v;
+
+  if(lwm2m_object_is_resource_string(resource)) {
+    len = (buf[0] << 8) | buf[1];
+    if(len <= get_string_size(resource)) {
+      lwm2m_object_set_resource_string(resource, context, len, &buf[2]);
+    }
+  } else if(lwm2m_object_is_resource_boolean(resource)) {
+    lwm2m_object_set_resource_boolean(resource, context, buf[0]);
+  } else {
+    v = ((uint32_t)buf[0] << 24) | ((uint32_t)buf[1] << 16) |
+      ((uint32_t)buf[2] << 8) | buf[3];
+    if(lwm2m_object_is_resource_floatfix(resource)) {
+      lwm2m_object_set_resource_floatfix(resource, context, v);
+    } else {
+      lwm2m_object_set_resource_int(resource, context, v);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* The size of the record of an object or -1 if it can not be stored */
+static int
+get_object_size(const lwm2m_object_t *object)
+{
+  const lwm2m_instance_t *instance;
+  int i, j, len, size;
+
+  size = 0;
+  for(i = 0; i < object->count; i++) {
+    instance = &object->instances[i];
+    size += 3;
+    for(j = 0; j < instance->count; j++) {
+      if(is_persistent(&instance->resources[j])) {
+        len = get_value_size(&instance->resources[j]);
+        if(len > sizeof(value_buf)) {
+          PRINTF("lwm2m-store: can not store /%u/%u/%u\n", object->id,
+                 instance->id, instance->resources[j].id);
+          return -1;
+        }
+        size += len;
+      }
+    }
+  }
+  return size;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Write all instance slots of an object to the file, or restore them
+ * from the file. The record header has already been handled.
+ */
+static int
+serialize_object(const lwm2m_object_t *object, int fd, int restore)
+{
+  lwm2m_instance_t *instance;
+  const lwm2m_resource_t *resource;
+  lwm2m_context_t context;
+  int i, j, len;
+
+  memset(&context, 0, sizeof(context));
+  context.object_id = object->id;
+  for(i = 0; i < object->count; i++) {
+    instance = &object->instances[i];
+    context.object_instance_index = i;
+    if(restore) {
+      if(cfs_read(fd, value_buf, 3) != 3) {
+        return 0;
+      }
+      if((object->flags & LWM2M_OBJECT_FLAG_STATIC) == 0) {
+        instance->flag = (instance->flag & ~LWM2M_INSTANCE_FLAG_USED) |
+          (value_buf[0] & LWM2M_INSTANCE_FLAG_USED);
+        instance->id = (value_buf[1] << 8) | value_buf[2];
+      }
+    } else {
+      value_buf[0] = instance->flag & LWM2M_INSTANCE_FLAG_USED;
+      value_buf[1] = instance->id >> 8;
+      value_buf[2] = instance->id & 0xff;
+      if(cfs_write(fd, value_buf, 3) != 3) {
+        return 0;
+      }
+    }
+    context.object_instance_id = instance->id;
+
+    for(j = 0; j < instance->count; j++) {
+      resource = &instance->resources[j];
+      if(!is_persistent(resource)) {
+        continue;
+      }
+      context.resource_id = resource->id;
+      len = get_value_size(resource);
+      if(restore) {
+        if(cfs_read(fd, value_buf, len) != len) {
+          return 0;
+        }
+        read_value(resource, &context, value_buf);
+      } else {
+        write_value(resource, &context, value_buf);
+        if(cfs_write(fd, value_buf, len) != len) {
+          return 0;
+        }
+      }
+    }
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+save(void *ptr)
+{
+  uint8_t header[4];
+  int fd, i, len;
+
+  fd = cfs_open(LWM2M_STORE_FILENAME, CFS_WRITE);
+  if(fd < 0) {
+    PRINTF("lwm2m-store: failed to open file\n");
+    return;
+  }
+#if LWM2M_STORE_COFFEE
+  cfs_coffee_set_io_semantics(fd, CFS_COFFEE_IO_FLASH_AWARE);
+#endif /* LWM2M_STORE_COFFEE */
+
+  for(i = 0; i < LWM2M_STORE_MAX_OBJECTS; i++) {
+    if(store_objects[i] == NULL
+       || (len = get_object_size(store_objects[i])) < 0) {
+      continue;
+    }
+    header[0] = store_objects[i]->id >> 8;
+    header[1] = store_objects[i]->id & 0xff;
+    header[2] = len >> 8;
+    header[3] = len & 0xff;
+    if(cfs_write(fd, header, sizeof(header)) != sizeof(header)
+       || !serialize_object(store_objects[i], fd, 0)) {
+      PRINTF("lwm2m-store: failed to write object %u\n", store_objects[i]->id);
+      break;
+    }
+  }
+  cfs_close(fd);
+  PRINTF("lwm2m-store: saved\n");
+}
+/*---------------------------------------------------------------------------*/
+static int
+restore(const lwm2m_object_t *object)
+{
+  uint8_t header[4];
+  int fd, len, restored;
+  uint16_t id;
+
+  fd = cfs_open(LWM2M_STORE_FILENAME, CFS_READ);
+  if(fd < 0) {
+    return 0;
+  }
+
+  restored = 0;
+  while(cfs_read(fd, header, sizeof(header)) == sizeof(header)) {
+    id = (header[0] << 8) | header[1];
+    len = (header[2] << 8) | header[3];
+    if(id != object->id) {
+      /* Skip to the next record */
+      if(cfs_seek(fd, len, CFS_SEEK_CUR) == (cfs_offset_t)-1) {
+        break;
+      }
+      continue;
+    }
+    /* Only restore records with the same layout as the object */
+    if(len == get_object_size(object)) {
+      restored = serialize_object(object, fd, 1);
+    }
+    break;
+  }
+  cfs_close(fd);
+  return restored;
+}
+/*---------------------------------------------------------------------------*/
+int
+lwm2m_store_add(const lwm2m_object_t *object)
+{
+  int i, restored;
+
+  for(i = 0; i < LWM2M_STORE_MAX_OBJECTS; i++) {
+    if(store_objects[i] == object) {
+      return 0;
+    }
+  }
+  for(i = 0; i < LWM2M_STORE_MAX_OBJECTS; i++) {
+    if(store_objects[i] == NULL) {
+      break;
+    }
+  }
+  if(i == LWM2M_STORE_MAX_OBJECTS) {
+    PRINTF("lwm2m-store: too many objects\n");
+    return 0;
+  }
+
+#if LWM2M_STORE_COFFEE
+  if(store_objects[0] == NULL) {
+    cfs_coffee_configure_log(LWM2M_STORE_FILENAME,
+                             LWM2M_STORE_COFFEE_LOG_SIZE,
+                             LWM2M_STORE_COFFEE_RECORD_SIZE);
+  }
+#endif /* LWM2M_STORE_COFFEE */
+
+  restored = restore(object);
+  if(restored) {
+    PRINTF("lwm2m-store: restored object %u\n", object->id);
+    /* Restored instances may change the instance order */
+    lwm2m_engine_register_object(object);
+  }
+  store_objects[i] = object;
+  return restored;
+}
+/*---------------------------------------------------------------------------*/
+void
+lwm2m_store_changed(void)
+{
+  if(store_objects[0] != NULL) {
+    ctimer_set(&store_timer, LWM2M_STORE_WRITE_DELAY * CLOCK_SECOND,
+               save, NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/** @} */
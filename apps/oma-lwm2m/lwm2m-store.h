@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \addtogroup oma-lwm2m
+ * @{
+ */
+
+/**
+ * \file
+ *         Header file for persistent storage of Contiki OMA LWM2M objects.
+ *         The instances and variable resources of the added objects are
+ *         saved to a file a short while after each change, and restored
+ *         when the object is added after a reboot.
+ */
+
+#ifndef LWM2M_STORE_H_
+#define LWM2M_STORE_H_
+
+#include "lwm2m-object.h"
+
+/* Persist the Security and Server objects */
+#ifdef LWM2M_STORE_CONF_ENABLED
+#define LWM2M_STORE_ENABLED LWM2M_STORE_CONF_ENABLED
+#else /* LWM2M_STORE_CONF_ENABLED */
+#define LWM2M_STORE_ENABLED 0
+#endif /* LWM2M_STORE_CONF_ENABLED */
+
+#ifdef LWM2M_STORE_CONF_FILENAME
+#define LWM2M_STORE_FILENAME LWM2M_STORE_CONF_FILENAME
+#else /* LWM2M_STORE_CONF_FILENAME */
+#define LWM2M_STORE_FILENAME "lwm2m"
+#endif /* LWM2M_STORE_CONF_FILENAME */
+
+#ifdef LWM2M_STORE_CONF_MAX_OBJECTS
+#define LWM2M_STORE_MAX_OBJECTS LWM2M_STORE_CONF_MAX_OBJECTS
+#else /* LWM2M_STORE_CONF_MAX_OBJECTS */
+#define LWM2M_STORE_MAX_OBJECTS 4
+#endif /* LWM2M_STORE_CONF_MAX_OBJECTS */
+
+/* Seconds to wait for more changes before writing the file */
+#ifdef LWM2M_STORE_CONF_WRITE_DELAY
+#define LWM2M_STORE_WRITE_DELAY LWM2M_STORE_CONF_WRITE_DELAY
+#else /* LWM2M_STORE_CONF_WRITE_DELAY */
+#define LWM2M_STORE_WRITE_DELAY 5
+#endif /* LWM2M_STORE_CONF_WRITE_DELAY */
+
+/*
+ * Set to use a Coffee micro log for the file. The layout of the file
+ * does not change between writes which lets Coffee log the modified
+ * pages instead of rewriting the file.
+ */
+#ifdef LWM2M_STORE_CONF_COFFEE
+#define LWM2M_STORE_COFFEE LWM2M_STORE_CONF_COFFEE
+#else /* LWM2M_STORE_CONF_COFFEE */
+#define LWM2M_STORE_COFFEE 0
+#endif /* LWM2M_STORE_CONF_COFFEE */
+
+/**
+ * \brief Add an object to the persistent storage
+ * \param object The object to persist
+ * \return 1 if stored state was restored into the object, 0 otherwise
+ *
+ * Should be called after the object has been registered.
+ */
+int lwm2m_store_add(const lwm2m_object_t *object);
+
+/**
+ * \brief Schedule the objects to be saved
+ *
+ * Bursts of changes are coalesced into a single write.
+ */
+void lwm2m_store_changed(void);
+
+#endif /* LWM2M_STORE_H_ */
+/** @} */
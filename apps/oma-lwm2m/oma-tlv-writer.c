@@ -44,6 +44,13 @@
 
 #include "lwm2m-object.h"
 #include "oma-tlv.h"
+#include "oma-tlv-writer.h"
+
+#ifdef OMA_TLV_WRITER_CONF_CALLBACK_BUFFER_SIZE
+#define CALLBACK_BUFFER_SIZE OMA_TLV_WRITER_CONF_CALLBACK_BUFFER_SIZE
+#else /* OMA_TLV_WRITER_CONF_CALLBACK_BUFFER_SIZE */
+#define CALLBACK_BUFFER_SIZE 64
+#endif /* OMA_TLV_WRITER_CONF_CALLBACK_BUFFER_SIZE */
 /*---------------------------------------------------------------------------*/
 static size_t
 write_boolean_tlv(const lwm2m_context_t *ctx, uint8_t *outbuf, size_t outlen,
@@ -86,4 +93,153 @@ const lwm2m_writer_t oma_tlv_writer = {
   write_boolean_tlv
 };
 /*---------------------------------------------------------------------------*/
+/*
+ * While streaming, callbacks get a writer that serializes directly to the
+ * stream instead of to their output buffer. Callback output of any length
+ * then ends up in the response and the callback is only called once.
+ */
+static oma_tlv_stream_t *callback_stream;
+/*---------------------------------------------------------------------------*/
+static size_t
+stream_int_tlv(const lwm2m_context_t *ctx, uint8_t *outbuf, size_t outlen,
+               int32_t value)
+{
+  uint32_t pos = callback_stream->pos;
+  oma_tlv_stream_write_int32(callback_stream, ctx->resource_id, value);
+  return callback_stream->pos - pos;
+}
+/*---------------------------------------------------------------------------*/
+static size_t
+stream_boolean_tlv(const lwm2m_context_t *ctx, uint8_t *outbuf, size_t outlen,
+                   int value)
+{
+  return stream_int_tlv(ctx, outbuf, outlen, value != 0 ? 1 : 0);
+}
+/*---------------------------------------------------------------------------*/
+static size_t
+stream_float32fix_tlv(const lwm2m_context_t *ctx, uint8_t *outbuf,
+                      size_t outlen, int32_t value, int bits)
+{
+  uint32_t pos = callback_stream->pos;
+  oma_tlv_stream_write_float32(callback_stream, ctx->resource_id, value, bits);
+  return callback_stream->pos - pos;
+}
+/*---------------------------------------------------------------------------*/
+static size_t
+stream_string_tlv(const lwm2m_context_t *ctx, uint8_t *outbuf, size_t outlen,
+                  const char *value, size_t stringlen)
+{
+  oma_tlv_t tlv;
+  uint32_t pos = callback_stream->pos;
+  tlv.type = OMA_TLV_TYPE_RESOURCE;
+  tlv.value = (uint8_t *) value;
+  tlv.length = (uint32_t) stringlen;
+  tlv.id = ctx->resource_id;
+  oma_tlv_stream_write_tlv(callback_stream, &tlv);
+  return callback_stream->pos - pos;
+}
+/*---------------------------------------------------------------------------*/
+static const lwm2m_writer_t oma_tlv_stream_writer = {
+  stream_int_tlv,
+  stream_string_tlv,
+  stream_float32fix_tlv,
+  stream_boolean_tlv
+};
+/*---------------------------------------------------------------------------*/
+static void
+stream_resource(lwm2m_context_t *ctx, const lwm2m_resource_t *resource,
+                oma_tlv_stream_t *stream)
+{
+  if(lwm2m_object_is_resource_string(resource)) {
+    const uint8_t *value;
+    oma_tlv_t tlv;
+    value = lwm2m_object_get_resource_string(resource, ctx);
+    if(value != NULL) {
+      tlv.type = OMA_TLV_TYPE_RESOURCE;
+      tlv.id = resource->id;
+      tlv.value = value;
+      tlv.length = lwm2m_object_get_resource_strlen(resource, ctx);
+      oma_tlv_stream_write_tlv(stream, &tlv);
+    }
+  } else if(lwm2m_object_is_resource_int(resource)) {
+    int32_t value;
+    if(lwm2m_object_get_resource_int(resource, ctx, &value)) {
+      oma_tlv_stream_write_int32(stream, resource->id, value);
+    }
+  } else if(lwm2m_object_is_resource_floatfix(resource)) {
+    int32_t value;
+    if(lwm2m_object_get_resource_floatfix(resource, ctx, &value)) {
+      oma_tlv_stream_write_float32(stream, resource->id, value,
+                                   LWM2M_FLOAT32_BITS);
+    }
+  } else if(lwm2m_object_is_resource_boolean(resource)) {
+    int value;
+    if(lwm2m_object_get_resource_boolean(resource, ctx, &value)) {
+      oma_tlv_stream_write_int32(stream, resource->id, value != 0 ? 1 : 0);
+    }
+  } else if(lwm2m_object_is_resource_callback(resource)) {
+    if(resource->value.callback.read != NULL) {
+      /* Callbacks generate a complete TLV using the TLV writer */
+      static uint8_t buffer[CALLBACK_BUFFER_SIZE];
+      oma_tlv_stream_t *saved;
+      uint32_t pos;
+      int len;
+
+      saved = callback_stream;
+      callback_stream = stream;
+      pos = stream->pos;
+      len = resource->value.callback.read(ctx, buffer, sizeof(buffer));
+      callback_stream = saved;
+      if(len > 0 && stream->pos == pos) {
+        /* The callback wrote its TLV without using the writer */
+        oma_tlv_stream_write(stream, buffer, len);
+      }
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+oma_tlv_writer_stream_instance(lwm2m_context_t *ctx,
+                               const lwm2m_instance_t *instance,
+                               oma_tlv_stream_t *stream)
+{
+  const lwm2m_writer_t *writer;
+  int i;
+
+  writer = ctx->writer;
+  ctx->writer = &oma_tlv_stream_writer;
+  for(i = 0; i < instance->count; i++) {
+    ctx->resource_id = instance->resources[i].id;
+    ctx->resource_index = i;
+    stream_resource(ctx, &instance->resources[i], stream);
+  }
+  ctx->writer = writer;
+}
+/*---------------------------------------------------------------------------*/
+void
+oma_tlv_writer_stream_object(lwm2m_context_t *ctx,
+                             const lwm2m_object_t *object,
+                             oma_tlv_stream_t *stream)
+{
+  const lwm2m_instance_t *instance;
+  uint32_t start;
+  int i;
+
+  for(i = 0; i < object->count; i++) {
+    instance = &object->instances[i];
+    if((instance->flag & LWM2M_INSTANCE_FLAG_USED) == 0) {
+      continue;
+    }
+    ctx->object_instance_id = instance->id;
+    ctx->object_instance_index = i;
+
+    /* The length is filled in afterwards to read each resource only once */
+    start = oma_tlv_stream_begin(stream, OMA_TLV_TYPE_OBJECT_INSTANCE,
+                                 instance->id);
+    oma_tlv_writer_stream_instance(ctx, instance, stream);
+    oma_tlv_stream_end(stream, OMA_TLV_TYPE_OBJECT_INSTANCE, instance->id,
+                       start);
+  }
+}
+/*---------------------------------------------------------------------------*/
 /** @} */
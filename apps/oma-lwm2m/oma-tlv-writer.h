@@ -43,8 +43,19 @@
 #define OMA_TLV_WRITER_H_
 
 #include "lwm2m-object.h"
+#include "oma-tlv.h"
 
 extern const lwm2m_writer_t oma_tlv_writer;
 
+/* Serialize all resources of an object instance to a TLV stream */
+void oma_tlv_writer_stream_instance(lwm2m_context_t *ctx,
+                                    const lwm2m_instance_t *instance,
+                                    oma_tlv_stream_t *stream);
+
+/* Serialize all used object instances as nested TLVs to a TLV stream */
+void oma_tlv_writer_stream_object(lwm2m_context_t *ctx,
+                                  const lwm2m_object_t *object,
+                                  oma_tlv_stream_t *stream);
+
 #endif /* OMA_TLV_WRITER_H_ */
 /** @} */
@@ -76,9 +76,16 @@ oma_tlv_read(oma_tlv_t *tlv, const uint8_t *buffer, size_t len)
   uint8_t len_pos = 1;
   size_t tlv_len;
 
+  if(len < 2) {
+    return 0;
+  }
   tlv->type = (buffer[0] >> 6) & 3;
   len_type = (buffer[0] >> 3) & 3;
   len_pos = 1 + (((buffer[0] & (1 << 5)) != 0) ? 2 : 1);
+  if(len < (size_t)len_pos + len_type) {
+    /* Truncated header */
+    return 0;
+  }
 
   tlv->id = buffer[1];
   /* if len_pos is larger than two it means that there is more ID to read */
@@ -96,13 +103,86 @@ oma_tlv_read(oma_tlv_t *tlv, const uint8_t *buffer, size_t len)
       len_type--;
     }
   }
-  /* and read out the data??? */
+  if(tlv_len > len - len_pos) {
+    /* The value would go past the end of the buffer */
+    return 0;
+  }
   tlv->length = tlv_len;
   tlv->value = &buffer[len_pos];
 
   return len_pos + tlv_len;
 }
 /*---------------------------------------------------------------------------*/
+void
+oma_tlv_cursor_init(oma_tlv_cursor_t *cursor,
+                    const uint8_t *buffer, size_t len)
+{
+  cursor->buffer = buffer;
+  cursor->pos = 0;
+  cursor->end[0] = len;
+  cursor->depth = 0;
+  cursor->instance_id = OMA_TLV_CURSOR_NO_ID;
+  cursor->resource_id = OMA_TLV_CURSOR_NO_ID;
+}
+/*---------------------------------------------------------------------------*/
+int
+oma_tlv_cursor_next(oma_tlv_cursor_t *cursor, oma_tlv_t *tlv)
+{
+  size_t size;
+
+  while(1) {
+    /* Leave the TLVs that have been walked through */
+    while(cursor->pos >= cursor->end[cursor->depth]) {
+      if(cursor->depth == 0) {
+        return 0;
+      }
+      cursor->depth--;
+      if(cursor->resource_id != OMA_TLV_CURSOR_NO_ID) {
+        cursor->resource_id = OMA_TLV_CURSOR_NO_ID;
+      } else {
+        cursor->instance_id = OMA_TLV_CURSOR_NO_ID;
+      }
+    }
+
+    size = oma_tlv_read(tlv, &cursor->buffer[cursor->pos],
+                        cursor->end[cursor->depth] - cursor->pos);
+    if(size == 0) {
+      return -1;
+    }
+    cursor->tlv = &cursor->buffer[cursor->pos];
+    cursor->tlv_size = size;
+
+    if((tlv->type == OMA_TLV_TYPE_OBJECT_INSTANCE &&
+        cursor->instance_id == OMA_TLV_CURSOR_NO_ID &&
+        cursor->resource_id == OMA_TLV_CURSOR_NO_ID) ||
+       (tlv->type == OMA_TLV_TYPE_MULTI_RESOURCE &&
+        cursor->resource_id == OMA_TLV_CURSOR_NO_ID)) {
+      /* Walk into the TLV - its end is the end of its value */
+      if(cursor->depth + 1 >= OMA_TLV_CURSOR_DEPTH) {
+        return -1;
+      }
+      cursor->pos = tlv->value - cursor->buffer;
+      cursor->depth++;
+      cursor->end[cursor->depth] = cursor->pos + tlv->length;
+      if(tlv->type == OMA_TLV_TYPE_OBJECT_INSTANCE) {
+        cursor->instance_id = tlv->id;
+      } else {
+        cursor->resource_id = tlv->id;
+      }
+      continue;
+    }
+
+    if(tlv->type != (cursor->resource_id != OMA_TLV_CURSOR_NO_ID ?
+                     OMA_TLV_TYPE_RESOURCE_INSTANCE : OMA_TLV_TYPE_RESOURCE)) {
+      /* Only resource instances can be in a multiple resource, and
+         object instances can not be nested */
+      return -1;
+    }
+    cursor->pos += size;
+    return 1;
+  }
+}
+/*---------------------------------------------------------------------------*/
 size_t
 oma_tlv_get_size(const oma_tlv_t *tlv)
 {
@@ -117,20 +197,10 @@ oma_tlv_get_size(const oma_tlv_t *tlv)
   return size;
 }
 /*---------------------------------------------------------------------------*/
-size_t
-oma_tlv_write(const oma_tlv_t *tlv, uint8_t *buffer, size_t len)
+static size_t
+write_header_len_type(const oma_tlv_t *tlv, uint8_t len_type, uint8_t *buffer)
 {
   int pos;
-  uint8_t len_type;
-
-  /* len type is the same as number of bytes required for length */
-  len_type = get_len_type(tlv);
-  pos = 1 + len_type;
-  /* ensure that we do not write too much */
-  if(len < tlv->length + pos) {
-    PRINTF("OMA-TLV: Could not write the TLV - buffer overflow.\n");
-    return 0;
-  }
 
   /* first type byte in TLV header */
   buffer[0] = (tlv->type << 6) |
@@ -154,6 +224,28 @@ oma_tlv_write(const oma_tlv_t *tlv, uint8_t *buffer, size_t len)
   if(len_type > 0) {
     buffer[pos++] = tlv->length & 0xff;
   }
+  return pos;
+}
+/*---------------------------------------------------------------------------*/
+static size_t
+write_header(const oma_tlv_t *tlv, uint8_t *buffer)
+{
+  /* len type is the same as number of bytes required for length */
+  return write_header_len_type(tlv, get_len_type(tlv), buffer);
+}
+/*---------------------------------------------------------------------------*/
+size_t
+oma_tlv_write(const oma_tlv_t *tlv, uint8_t *buffer, size_t len)
+{
+  int pos;
+
+  /* ensure that we do not write too much */
+  if(len < oma_tlv_get_size(tlv)) {
+    PRINTF("OMA-TLV: Could not write the TLV - buffer overflow.\n");
+    return 0;
+  }
+
+  pos = write_header(tlv, buffer);
 
   /* finally add the value */
   memcpy(&buffer[pos], tlv->value, tlv->length);
@@ -182,12 +274,10 @@ oma_tlv_get_int32(const oma_tlv_t *tlv)
   return value;
 }
 /*---------------------------------------------------------------------------*/
-size_t
-oma_tlv_write_int32(int16_t id, int32_t value, uint8_t *buffer, size_t len)
+static void
+int32_to_tlv(oma_tlv_t *tlv, int16_t id, int32_t value, uint8_t *buf)
 {
-  oma_tlv_t tlv;
   size_t tlvlen = 0;
-  uint8_t buf[4];
   int i;
   PRINTF("Exporting int32 %d %ld ", id, (long)value);
 
@@ -201,24 +291,30 @@ oma_tlv_write_int32(int16_t id, int32_t value, uint8_t *buffer, size_t len)
 
   /* export INT as TLV */
   PRINTF("len: %zu\n", tlvlen);
-  tlv.type = OMA_TLV_TYPE_RESOURCE;
-  tlv.length = tlvlen;
-  tlv.value = &buf[3 - (tlvlen - 1)];
-  tlv.id = id;
+  tlv->type = OMA_TLV_TYPE_RESOURCE;
+  tlv->length = tlvlen;
+  tlv->value = &buf[3 - (tlvlen - 1)];
+  tlv->id = id;
+}
+/*---------------------------------------------------------------------------*/
+size_t
+oma_tlv_write_int32(int16_t id, int32_t value, uint8_t *buffer, size_t len)
+{
+  oma_tlv_t tlv;
+  uint8_t buf[4];
+  int32_to_tlv(&tlv, id, value, buf);
   return oma_tlv_write(&tlv, buffer, len);
 }
 /*---------------------------------------------------------------------------*/
 /* convert fixpoint 32-bit to a IEEE Float in the byte array*/
-size_t
-oma_tlv_write_float32(int16_t id, int32_t value, int bits,
-                      uint8_t *buffer, size_t len)
+static void
+float32_to_tlv(oma_tlv_t *tlv, int16_t id, int32_t value, int bits,
+               uint8_t *b)
 {
   int i;
   int e = 0;
   int32_t val = 0;
   int32_t v;
-  uint8_t b[4];
-  oma_tlv_t tlv;
 
   v = value;
   if(v < 0) {
@@ -250,11 +346,19 @@ oma_tlv_write_float32(int16_t id, int32_t value, int bits,
   b[3] = val & 0xff;
 
   /* construct the TLV */
-  tlv.type = OMA_TLV_TYPE_RESOURCE;
-  tlv.length = 4;
-  tlv.value = b;
-  tlv.id = id;
-
+  tlv->type = OMA_TLV_TYPE_RESOURCE;
+  tlv->length = 4;
+  tlv->value = b;
+  tlv->id = id;
+}
+/*---------------------------------------------------------------------------*/
+size_t
+oma_tlv_write_float32(int16_t id, int32_t value, int bits,
+                      uint8_t *buffer, size_t len)
+{
+  oma_tlv_t tlv;
+  uint8_t b[4];
+  float32_to_tlv(&tlv, id, value, bits, b);
   return oma_tlv_write(&tlv, buffer, len);
 }
 /*---------------------------------------------------------------------------*/
@@ -293,4 +397,119 @@ oma_tlv_float32_to_fix(const oma_tlv_t *tlv, int32_t *value, int bits)
   return 4;
 }
 /*---------------------------------------------------------------------------*/
+void
+oma_tlv_stream_init(oma_tlv_stream_t *stream, uint8_t *buffer, size_t size,
+                    uint32_t offset)
+{
+  stream->buffer = buffer;
+  stream->size = size;
+  stream->offset = offset;
+  stream->pos = 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+oma_tlv_stream_write(oma_tlv_stream_t *stream, const uint8_t *data, size_t len)
+{
+  uint32_t start, end;
+
+  /* Only the part of the data that is inside the output window is copied */
+  start = MAX(stream->pos, stream->offset);
+  end = MIN(stream->pos + len, stream->offset + stream->size);
+  if(start < end && stream->buffer != NULL) {
+    memcpy(&stream->buffer[start - stream->offset],
+           &data[start - stream->pos], end - start);
+  }
+  stream->pos += len;
+}
+/*---------------------------------------------------------------------------*/
+void
+oma_tlv_stream_write_header(oma_tlv_stream_t *stream, oma_tlv_type_t type,
+                            uint16_t id, uint32_t length)
+{
+  oma_tlv_t tlv;
+  uint8_t hdr[6];
+  size_t len;
+
+  tlv.type = type;
+  tlv.id = id;
+  tlv.length = length;
+  len = write_header(&tlv, hdr);
+  oma_tlv_stream_write(stream, hdr, len);
+}
+/*---------------------------------------------------------------------------*/
+uint32_t
+oma_tlv_stream_begin(oma_tlv_stream_t *stream, oma_tlv_type_t type,
+                     uint16_t id)
+{
+  oma_tlv_t tlv;
+  uint8_t hdr[6];
+  uint32_t start;
+
+  /* Always a 24 bit length so the header size does not depend on it */
+  tlv.type = type;
+  tlv.id = id;
+  tlv.length = 0;
+  start = stream->pos;
+  oma_tlv_stream_write(stream, hdr, write_header_len_type(&tlv, 3, hdr));
+  return start;
+}
+/*---------------------------------------------------------------------------*/
+void
+oma_tlv_stream_end(oma_tlv_stream_t *stream, oma_tlv_type_t type,
+                   uint16_t id, uint32_t start)
+{
+  oma_tlv_t tlv;
+  uint8_t hdr[6];
+  uint32_t pos;
+  size_t len;
+
+  tlv.type = type;
+  tlv.id = id;
+  tlv.length = 0;
+  len = write_header_len_type(&tlv, 3, hdr);
+  tlv.length = stream->pos - start - len;
+  write_header_len_type(&tlv, 3, hdr);
+
+  /* Rewrite the part of the header that is inside the window */
+  pos = stream->pos;
+  stream->pos = start;
+  oma_tlv_stream_write(stream, hdr, len);
+  stream->pos = pos;
+}
+/*---------------------------------------------------------------------------*/
+void
+oma_tlv_stream_write_tlv(oma_tlv_stream_t *stream, const oma_tlv_t *tlv)
+{
+  oma_tlv_stream_write_header(stream, tlv->type, tlv->id, tlv->length);
+  oma_tlv_stream_write(stream, tlv->value, tlv->length);
+}
+/*---------------------------------------------------------------------------*/
+void
+oma_tlv_stream_write_int32(oma_tlv_stream_t *stream, int16_t id, int32_t value)
+{
+  oma_tlv_t tlv;
+  uint8_t buf[4];
+  int32_to_tlv(&tlv, id, value, buf);
+  oma_tlv_stream_write_tlv(stream, &tlv);
+}
+/*---------------------------------------------------------------------------*/
+void
+oma_tlv_stream_write_float32(oma_tlv_stream_t *stream, int16_t id,
+                             int32_t value, int bits)
+{
+  oma_tlv_t tlv;
+  uint8_t b[4];
+  float32_to_tlv(&tlv, id, value, bits, b);
+  oma_tlv_stream_write_tlv(stream, &tlv);
+}
+/*---------------------------------------------------------------------------*/
+size_t
+oma_tlv_stream_get_length(const oma_tlv_stream_t *stream)
+{
+  if(stream->pos <= stream->offset) {
+    return 0;
+  }
+  return MIN(stream->pos - stream->offset, stream->size);
+}
+/*---------------------------------------------------------------------------*/
 /** @} */
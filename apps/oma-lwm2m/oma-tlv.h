@@ -71,6 +71,36 @@ size_t oma_tlv_get_size(const oma_tlv_t *tlv);
 /* read a TLV from the buffer */
 size_t oma_tlv_read(oma_tlv_t *tlv, const uint8_t *buffer, size_t len);
 
+/*
+ * A cursor that walks the TLVs of a buffer in one pass. Object
+ * instances and multiple resources are walked into, so only resources
+ * and resource instances are returned, with the ids of the TLVs they
+ * are in. The values are not copied.
+ */
+#define OMA_TLV_CURSOR_DEPTH 3
+#define OMA_TLV_CURSOR_NO_ID -1
+
+typedef struct {
+  const uint8_t *buffer;
+  size_t pos;
+  /* End of the buffer and of each TLV walked into */
+  size_t end[OMA_TLV_CURSOR_DEPTH];
+  uint8_t depth;
+  /* The object instance and the multiple resource of the current TLV,
+     or OMA_TLV_CURSOR_NO_ID */
+  int32_t instance_id;
+  int32_t resource_id;
+  /* The whole current TLV, with its header */
+  const uint8_t *tlv;
+  size_t tlv_size;
+} oma_tlv_cursor_t;
+
+void oma_tlv_cursor_init(oma_tlv_cursor_t *cursor, const uint8_t *buffer, size_t len);
+
+/* read the next resource or resource instance. Returns 1 if a TLV was
+   read, 0 at the end of the buffer and -1 if the TLVs are malformed */
+int oma_tlv_cursor_next(oma_tlv_cursor_t *cursor, oma_tlv_t *tlv);
+
 /* write a TLV to the buffer */
 size_t oma_tlv_write(const oma_tlv_t *tlv, uint8_t *buffer, size_t len);
 
@@ -85,5 +115,51 @@ size_t oma_tlv_write_float32(int16_t id, int32_t value, int bits, uint8_t *buffe
 /* convert TLV with float32 to fixpoint */
 size_t oma_tlv_float32_to_fix(const oma_tlv_t *tlv, int32_t *value, int bits);
 
+/*
+ * A TLV output stream that only stores the bytes that fall inside the
+ * output window [offset, offset + size). All bytes are still counted
+ * which makes it possible to regenerate the output and resume at any
+ * byte offset, for example for CoAP Block2 transfers, without ever
+ * keeping the full serialization in memory. A stream with size zero
+ * can be used to calculate the length of the serialization.
+ */
+typedef struct {
+  uint8_t *buffer;
+  size_t size;
+  uint32_t offset;
+  uint32_t pos;
+} oma_tlv_stream_t;
+
+void oma_tlv_stream_init(oma_tlv_stream_t *stream, uint8_t *buffer, size_t size, uint32_t offset);
+
+void oma_tlv_stream_write(oma_tlv_stream_t *stream, const uint8_t *data, size_t len);
+
+void oma_tlv_stream_write_header(oma_tlv_stream_t *stream, oma_tlv_type_t type, uint16_t id, uint32_t length);
+
+/*
+ * Start a TLV whose length is not known until its content has been
+ * written. The header gets a 24 bit length that oma_tlv_stream_end()
+ * fills in, so the content is only serialized once.
+ */
+uint32_t oma_tlv_stream_begin(oma_tlv_stream_t *stream, oma_tlv_type_t type, uint16_t id);
+
+void oma_tlv_stream_end(oma_tlv_stream_t *stream, oma_tlv_type_t type, uint16_t id, uint32_t start);
+
+void oma_tlv_stream_write_tlv(oma_tlv_stream_t *stream, const oma_tlv_t *tlv);
+
+void oma_tlv_stream_write_int32(oma_tlv_stream_t *stream, int16_t id, int32_t value);
+
+void oma_tlv_stream_write_float32(oma_tlv_stream_t *stream, int16_t id, int32_t value, int bits);
+
+/* number of bytes stored in the output window */
+size_t oma_tlv_stream_get_length(const oma_tlv_stream_t *stream);
+
+/* total number of bytes in the stream, including bytes outside the window */
+static inline uint32_t
+oma_tlv_stream_get_total(const oma_tlv_stream_t *stream)
+{
+  return stream->pos;
+}
+
 #endif /* OAM_TLV_H_ */
 /** @} */
@@ -49,6 +49,8 @@
 #define ORCHESTRA_RULES { &eb_per_time_source, &unicast_per_neighbor_rpl_storing, &default_common }
 /* Example configuration for RPL non-storing mode: */
 /* #define ORCHESTRA_RULES { &eb_per_time_source, &unicast_per_neighbor_rpl_ns, &default_common } */
+/* Example configuration for RPL storing mode with traffic-adaptive unicast: */
+/* #define ORCHESTRA_RULES { &eb_per_time_source, &unicast_per_neighbor_rpl_adaptive, &default_common } */
 
 #endif /* ORCHESTRA_CONF_RULES */
 
@@ -102,4 +104,35 @@
 #define ORCHESTRA_COLLISION_FREE_HASH             0 /* Set to 1 if ORCHESTRA_LINKADDR_HASH returns unique hashes */
 #endif /* ORCHESTRA_CONF_COLLISION_FREE_HASH */
 
+/* Adaptive unicast rule: a node gets one more cell to its parent for every
+ * that many descendants... */
+#ifdef ORCHESTRA_CONF_ADAPTIVE_NODES_PER_CELL
+#define ORCHESTRA_ADAPTIVE_NODES_PER_CELL         ORCHESTRA_CONF_ADAPTIVE_NODES_PER_CELL
+#else /* ORCHESTRA_CONF_ADAPTIVE_NODES_PER_CELL */
+#define ORCHESTRA_ADAPTIVE_NODES_PER_CELL         4
+#endif /* ORCHESTRA_CONF_ADAPTIVE_NODES_PER_CELL */
+
+/* ...up to this many cells in the unicast slotframe */
+#ifdef ORCHESTRA_CONF_ADAPTIVE_MAX_CELLS
+#define ORCHESTRA_ADAPTIVE_MAX_CELLS              ORCHESTRA_CONF_ADAPTIVE_MAX_CELLS
+#else /* ORCHESTRA_CONF_ADAPTIVE_MAX_CELLS */
+#define ORCHESTRA_ADAPTIVE_MAX_CELLS              4
+#endif /* ORCHESTRA_CONF_ADAPTIVE_MAX_CELLS */
+
+/* Adaptive unicast rule: with this many packets queued for the parent,
+ * new ones are allowed in any slotframe */
+#ifdef ORCHESTRA_CONF_ADAPTIVE_QUEUE_THRESHOLD
+#define ORCHESTRA_ADAPTIVE_QUEUE_THRESHOLD        ORCHESTRA_CONF_ADAPTIVE_QUEUE_THRESHOLD
+#else /* ORCHESTRA_CONF_ADAPTIVE_QUEUE_THRESHOLD */
+#define ORCHESTRA_ADAPTIVE_QUEUE_THRESHOLD        4
+#endif /* ORCHESTRA_CONF_ADAPTIVE_QUEUE_THRESHOLD */
+
+/* Adaptive unicast rule: how often the cells are recomputed from the
+ * routing table */
+#ifdef ORCHESTRA_CONF_ADAPTIVE_UPDATE_PERIOD
+#define ORCHESTRA_ADAPTIVE_UPDATE_PERIOD          ORCHESTRA_CONF_ADAPTIVE_UPDATE_PERIOD
+#else /* ORCHESTRA_CONF_ADAPTIVE_UPDATE_PERIOD */
+#define ORCHESTRA_ADAPTIVE_UPDATE_PERIOD          (10 * CLOCK_SECOND)
+#endif /* ORCHESTRA_CONF_ADAPTIVE_UPDATE_PERIOD */
+
 #endif /* __ORCHESTRA_CONF_H__ */
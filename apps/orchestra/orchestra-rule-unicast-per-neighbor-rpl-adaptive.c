@@ -0,0 +1,281 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \file
+ *         Orchestra: a sender-based unicast slotframe whose capacity follows
+ *         the traffic. Designed for RPL storing mode only.
+ *         A node that forwards for many descendants transmits to its parent
+ *         in more than one timeslot: 1 + descendants / ORCHESTRA_ADAPTIVE_NODES_PER_CELL
+ *         cells, at most ORCHESTRA_ADAPTIVE_MAX_CELLS, evenly spread over the
+ *         slotframe from hash(MAC) % ORCHESTRA_UNICAST_PERIOD.
+ *         The parent counts the routes it has through each child and listens
+ *         at the same cells, so that no signaling is needed. Traffic to
+ *         children uses the first cell only.
+ *         When packets pile up for the parent, new ones may also be sent in
+ *         any other slotframe, e.g. the common shared one.
+ */
+
+#include "contiki.h"
+#include "orchestra.h"
+#include "net/ipv6/uip-ds6-route.h"
+#include "net/ipv6/uip-ds6-nbr.h"
+#include "net/mac/tsch/tsch-queue.h"
+#include "net/packetbuf.h"
+#include <string.h>
+
+#if ORCHESTRA_COLLISION_FREE_HASH && ORCHESTRA_ADAPTIVE_MAX_CELLS == 1
+#define UNICAST_SLOT_SHARED_FLAG    ((ORCHESTRA_UNICAST_PERIOD < (ORCHESTRA_MAX_HASH + 1)) ? LINK_OPTION_SHARED : 0)
+#else
+#define UNICAST_SLOT_SHARED_FLAG      LINK_OPTION_SHARED
+#endif
+
+static uint16_t slotframe_handle = 0;
+static uint16_t channel_offset = 0;
+static struct tsch_slotframe *sf_unicast;
+static struct ctimer update_timer;
+/* The links the schedule should have, one entry per timeslot */
+static uint8_t link_options[ORCHESTRA_UNICAST_PERIOD];
+
+/*---------------------------------------------------------------------------*/
+static uint16_t
+get_node_timeslot(const linkaddr_t *addr)
+{
+  if(addr != NULL && ORCHESTRA_UNICAST_PERIOD > 0) {
+    return ORCHESTRA_LINKADDR_HASH(addr) % ORCHESTRA_UNICAST_PERIOD;
+  } else {
+    return 0xffff;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* The number of routes through a next hop, or of all routes if NULL */
+static int
+count_routes(const linkaddr_t *nexthop)
+{
+  uip_ds6_route_t *r;
+  const uip_lladdr_t *lladdr;
+  int count = 0;
+
+  for(r = uip_ds6_route_head(); r != NULL; r = uip_ds6_route_next(r)) {
+    if(nexthop != NULL) {
+      lladdr = uip_ds6_nbr_lladdr_from_ipaddr(uip_ds6_route_nexthop(r));
+      if(lladdr == NULL || !linkaddr_cmp((const linkaddr_t *)lladdr, nexthop)) {
+        continue;
+      }
+    }
+    count++;
+  }
+  return count;
+}
+/*---------------------------------------------------------------------------*/
+/* The number of cells of a node with a given number of descendants */
+static int
+num_cells(int descendants)
+{
+  int cells = 1 + descendants / ORCHESTRA_ADAPTIVE_NODES_PER_CELL;
+  return cells < ORCHESTRA_ADAPTIVE_MAX_CELLS ? cells : ORCHESTRA_ADAPTIVE_MAX_CELLS;
+}
+/*---------------------------------------------------------------------------*/
+static void
+set_cells(const linkaddr_t *addr, int cells, uint8_t options)
+{
+  uint16_t timeslot = get_node_timeslot(addr);
+  int i;
+
+  if(timeslot == 0xffff) {
+    return;
+  }
+  for(i = 0; i < cells; i++) {
+    link_options[(timeslot + i * ORCHESTRA_UNICAST_PERIOD / cells)
+                 % ORCHESTRA_UNICAST_PERIOD] |= options;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+parent_has_uc_link(void)
+{
+  return orchestra_parent_knows_us
+    && !linkaddr_cmp(&orchestra_parent_linkaddr, &linkaddr_null);
+}
+/*---------------------------------------------------------------------------*/
+static void
+update_schedule(void)
+{
+  nbr_table_item_t *item;
+  struct tsch_link *l;
+  uint16_t timeslot;
+  int descendants;
+
+  memset(link_options, 0, sizeof(link_options));
+
+  /* Our own cells: all of them are for the parent, the first one also
+   * for the children */
+  descendants = count_routes(NULL);
+  set_cells(&linkaddr_node_addr,
+            parent_has_uc_link() ? num_cells(descendants) : 1,
+            LINK_OPTION_TX | UNICAST_SLOT_SHARED_FLAG);
+
+  /* The parent talks to us in its first cell */
+  if(!linkaddr_cmp(&orchestra_parent_linkaddr, &linkaddr_null)) {
+    set_cells(&orchestra_parent_linkaddr, 1, LINK_OPTION_RX);
+  }
+
+  /* Children talk to us in as many cells as they have descendants for.
+   * One of the routes through a child is the route to itself. */
+  for(item = nbr_table_head(nbr_routes); item != NULL;
+      item = nbr_table_next(nbr_routes, item)) {
+    linkaddr_t *addr = nbr_table_get_lladdr(nbr_routes, item);
+    descendants = count_routes(addr) - 1;
+    set_cells(addr, num_cells(descendants > 0 ? descendants : 0), LINK_OPTION_RX);
+  }
+
+  /* Bring the slotframe in line */
+  for(timeslot = 0; timeslot < ORCHESTRA_UNICAST_PERIOD; timeslot++) {
+    l = tsch_schedule_get_link_by_timeslot(sf_unicast, timeslot);
+    if(link_options[timeslot] == 0) {
+      if(l != NULL) {
+        tsch_schedule_remove_link(sf_unicast, l);
+      }
+    } else if(l == NULL || l->link_options != link_options[timeslot]) {
+      tsch_schedule_add_link(sf_unicast, link_options[timeslot], LINK_TYPE_NORMAL,
+                             &tsch_broadcast_address, timeslot, channel_offset);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+update_timer_callback(void *ptr)
+{
+  ctimer_reset(&update_timer);
+  update_schedule();
+}
+/*---------------------------------------------------------------------------*/
+static int
+neighbor_has_uc_link(const linkaddr_t *linkaddr)
+{
+  if(linkaddr != NULL && !linkaddr_cmp(linkaddr, &linkaddr_null)) {
+    if(parent_has_uc_link() && linkaddr_cmp(&orchestra_parent_linkaddr, linkaddr)) {
+      return 1;
+    }
+    if(nbr_table_get_from_lladdr(nbr_routes, (linkaddr_t *)linkaddr) != NULL) {
+      return 1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+child_added(const linkaddr_t *linkaddr)
+{
+  update_schedule();
+}
+/*---------------------------------------------------------------------------*/
+static void
+child_removed(const linkaddr_t *linkaddr)
+{
+  update_schedule();
+}
+/*---------------------------------------------------------------------------*/
+static int
+select_packet(uint16_t *slotframe, uint16_t *timeslot)
+{
+  /* Select data packets we have a unicast link to */
+  const linkaddr_t *dest = packetbuf_addr(PACKETBUF_ADDR_RECEIVER);
+  if(packetbuf_attr(PACKETBUF_ATTR_FRAME_TYPE) == FRAME802154_DATAFRAME
+     && neighbor_has_uc_link(dest)) {
+    if(linkaddr_cmp(dest, &orchestra_parent_linkaddr)) {
+      if(tsch_queue_packet_count(dest) >= ORCHESTRA_ADAPTIVE_QUEUE_THRESHOLD) {
+        /* Congested: any link to the parent will do */
+        if(slotframe != NULL) {
+          *slotframe = 0xffff;
+        }
+        if(timeslot != NULL) {
+          *timeslot = 0xffff;
+        }
+        return 1;
+      }
+      /* Any of our cells */
+      if(slotframe != NULL) {
+        *slotframe = slotframe_handle;
+      }
+      if(timeslot != NULL) {
+        *timeslot = 0xffff;
+      }
+      return 1;
+    }
+    if(slotframe != NULL) {
+      *slotframe = slotframe_handle;
+    }
+    if(timeslot != NULL) {
+      *timeslot = get_node_timeslot(&linkaddr_node_addr);
+    }
+    return 1;
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+new_time_source(const struct tsch_neighbor *old, const struct tsch_neighbor *new)
+{
+  if(new != old) {
+    const linkaddr_t *new_addr = new != NULL ? &new->addr : NULL;
+    if(new_addr != NULL) {
+      linkaddr_copy(&orchestra_parent_linkaddr, new_addr);
+    } else {
+      linkaddr_copy(&orchestra_parent_linkaddr, &linkaddr_null);
+    }
+    update_schedule();
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+init(uint16_t sf_handle)
+{
+  slotframe_handle = sf_handle;
+  channel_offset = sf_handle;
+  /* Slotframe for unicast transmissions */
+  sf_unicast = tsch_schedule_add_slotframe(slotframe_handle, ORCHESTRA_UNICAST_PERIOD);
+  update_schedule();
+  /* The number of descendants changes with DAOs, and the parent may
+   * learn about us, without a callback: update from time to time */
+  ctimer_set(&update_timer, ORCHESTRA_ADAPTIVE_UPDATE_PERIOD,
+             update_timer_callback, NULL);
+}
+/*---------------------------------------------------------------------------*/
+struct orchestra_rule unicast_per_neighbor_rpl_adaptive = {
+  init,
+  new_time_source,
+  select_packet,
+  child_added,
+  child_removed,
+};
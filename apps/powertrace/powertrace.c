@@ -53,6 +53,7 @@ struct powertrace_sniff_stats {
   unsigned long output_txtime, output_rxtime;
 #if NETSTACK_CONF_WITH_IPV6
   uint16_t proto; /* includes proto + possibly flags */
+  uint16_t flow; /* e.g. the CoAP resource, see compower_set_flow() */
 #endif
   uint16_t channel;
   unsigned long last_input_txtime, last_input_rxtime;
@@ -159,7 +160,7 @@ powertrace_print(char *str)
                            s->last_output_rxtime + s->last_output_txtime))) /
                  radio));
 #else
-    printf("%s %lu SP %d.%d %lu %u %u %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu (proto %u(%u) radio %d.%02d%% / %d.%02d%%)\n",
+    printf("%s %lu SP %d.%d %lu %u %u %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu (proto %u(%u) flow %u radio %d.%02d%% / %d.%02d%%)\n",
            str, clock_time(), linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1], seqno,
            s->proto, s->channel,
            s->num_input, s->input_txtime, s->input_rxtime,
@@ -168,7 +169,7 @@ powertrace_print(char *str)
            s->num_output, s->output_txtime, s->output_rxtime,
            s->output_txtime - s->last_output_txtime,
            s->output_rxtime - s->last_output_rxtime,
-           s->proto, s->channel,
+           s->proto, s->channel, s->flow,
            (int)((100L * (s->input_rxtime + s->input_txtime + s->output_rxtime + s->output_txtime)) / all_radio),
            (int)((10000L * (s->input_rxtime + s->input_txtime + s->output_rxtime + s->output_txtime)) / all_radio),
            (int)((100L * (s->input_rxtime + s->input_txtime +
@@ -251,6 +252,7 @@ add_packet_stats(int input_or_output)
     if(s->channel == packetbuf_attr(PACKETBUF_ATTR_CHANNEL)
 #if NETSTACK_CONF_WITH_IPV6
        && s->proto == packetbuf_attr(PACKETBUF_ATTR_NETWORK_ID)
+       && s->flow == packetbuf_attr(PACKETBUF_ATTR_FLOW)
 #endif
        ) {
       add_stats(s, input_or_output);
@@ -264,6 +266,7 @@ add_packet_stats(int input_or_output)
       s->channel = packetbuf_attr(PACKETBUF_ATTR_CHANNEL);
 #if NETSTACK_CONF_WITH_IPV6
       s->proto = packetbuf_attr(PACKETBUF_ATTR_NETWORK_ID);
+      s->flow = packetbuf_attr(PACKETBUF_ATTR_FLOW);
 #endif
       list_add(stats_list, s);
       add_stats(s, input_or_output);
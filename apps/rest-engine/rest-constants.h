@@ -112,7 +112,8 @@ typedef enum {
   HAS_SUB_RESOURCES = (1 << 4),
   IS_SEPARATE = (1 << 5),
   IS_OBSERVABLE = (1 << 6),
-  IS_PERIODIC = (1 << 7)
+  IS_PERIODIC = (1 << 7),
+  IS_SNAPSHOT = (1 << 8)        /* Block2 served from one rendering */
 } rest_resource_flags_t;
 
 #endif /* REST_CONSTANTS_H_ */
@@ -40,6 +40,7 @@
 #include <string.h>
 #include <stdio.h>
 #include "contiki.h"
+#include "sys/compower.h"
 #include "rest-engine.h"
 
 #define DEBUG 0
@@ -55,9 +56,121 @@
 #endif
 
 PROCESS(rest_engine_process, "REST Engine");
+
+#define TIME_BEFORE(a, b) ((clock_time_t)((a) - (b)) > (clock_time_t)-1 / 2)
+
+/* One timer for all periodic resources, armed for the earliest deadline */
+static struct etimer periodic_timer;
 /*---------------------------------------------------------------------------*/
 LIST(restful_services);
 LIST(restful_periodic_services);
+static uint16_t resources_version;
+
+#if REST_ENGINE_DISPATCH_INDEX_SIZE > 0
+/* Resources hashed on the first URI path segment, in activation order */
+static resource_t *dispatch_index[REST_ENGINE_DISPATCH_INDEX_SIZE];
+#endif /* REST_ENGINE_DISPATCH_INDEX_SIZE > 0 */
+/*---------------------------------------------------------------------------*/
+#if REST_ENGINE_DISPATCH_INDEX_SIZE > 0
+static unsigned int
+hash_first_segment(const char *url, int len)
+{
+  unsigned int hash = 0;
+  int i;
+  for(i = 0; i < len && url[i] != '/' && url[i] != '\0'; i++) {
+    hash = hash * 31 + (uint8_t)url[i];
+  }
+  return hash % REST_ENGINE_DISPATCH_INDEX_SIZE;
+}
+/*---------------------------------------------------------------------------*/
+static void
+index_remove(resource_t *resource)
+{
+  resource_t **r;
+  int i;
+  for(i = 0; i < REST_ENGINE_DISPATCH_INDEX_SIZE; i++) {
+    for(r = &dispatch_index[i]; *r != NULL; r = &(*r)->index_next) {
+      if(*r == resource) {
+        *r = resource->index_next;
+        resource->index_next = NULL;
+        return;
+      }
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+index_add(resource_t *resource)
+{
+  resource_t **r;
+
+  index_remove(resource);
+  r = &dispatch_index[hash_first_segment(resource->url, resource->url_len)];
+  /* Keep activation order within the bucket */
+  while(*r != NULL) {
+    r = &(*r)->index_next;
+  }
+  resource->index_next = NULL;
+  *r = resource;
+}
+#endif /* REST_ENGINE_DISPATCH_INDEX_SIZE > 0 */
+/*---------------------------------------------------------------------------*/
+/* Insert a periodic resource into the list ordered by deadline */
+static void
+schedule_periodic(periodic_resource_t *periodic)
+{
+  periodic_resource_t *p;
+  periodic_resource_t *prev = NULL;
+
+  list_remove(restful_periodic_services, periodic);
+  for(p = list_head(restful_periodic_services); p != NULL; p = p->next) {
+    if(TIME_BEFORE(periodic->next_time, p->next_time)) {
+      break;
+    }
+    prev = p;
+  }
+  list_insert(restful_periodic_services, prev, periodic);
+}
+/*---------------------------------------------------------------------------*/
+/* Arm the periodic timer for the earliest deadline. Called by the engine. */
+static void
+update_periodic_timer(void)
+{
+  periodic_resource_t *head = list_head(restful_periodic_services);
+  clock_time_t now = clock_time();
+
+  if(head == NULL) {
+    etimer_stop(&periodic_timer);
+    return;
+  }
+  etimer_set(&periodic_timer, TIME_BEFORE(now, head->next_time) ?
+             head->next_time - now : 0);
+}
+/*---------------------------------------------------------------------------*/
+/* Run the handlers due now or within the periodic window */
+static void
+run_periodic(void)
+{
+  periodic_resource_t *periodic;
+  clock_time_t limit = clock_time() + REST_ENGINE_PERIODIC_WINDOW;
+
+  while((periodic = list_head(restful_periodic_services)) != NULL
+        && !TIME_BEFORE(limit, periodic->next_time)) {
+    PRINTF("Periodic: /%s due (period: %lu)\n",
+           periodic->resource->url, periodic->period);
+
+    /* Call the periodic_handler function, which was checked during adding to list. */
+    periodic->periodic_handler();
+
+    periodic->next_time += periodic->period;
+    if(TIME_BEFORE(periodic->next_time, clock_time())) {
+      /* missed periods are skipped rather than run back to back */
+      periodic->next_time = clock_time() + periodic->period;
+    }
+    schedule_periodic(periodic);
+  }
+  update_periodic_timer();
+}
 /*---------------------------------------------------------------------------*/
 /*- REST Engine API ---------------------------------------------------------*/
 /*---------------------------------------------------------------------------*/
@@ -103,7 +216,12 @@ void
 rest_activate_resource(resource_t *resource, char *path)
 {
   resource->url = path;
+  resource->url_len = strlen(path);
   list_add(restful_services, resource);
+  resources_version++;
+#if REST_ENGINE_DISPATCH_INDEX_SIZE > 0
+  index_add(resource);
+#endif /* REST_ENGINE_DISPATCH_INDEX_SIZE > 0 */
 
   PRINTF("Activating: %s\n", resource->url);
 
@@ -112,7 +230,14 @@ rest_activate_resource(resource_t *resource, char *path)
      && resource->periodic->period) {
     PRINTF("Periodic resource: %p (%s)\n", resource->periodic,
            resource->periodic->resource->url);
-    list_add(restful_periodic_services, resource->periodic);
+    /*
+     * Deadlines are aligned to multiples of the period, so handlers whose
+     * periods are multiples of each other fire in the same wake-up.
+     */
+    resource->periodic->next_time = (clock_time() / resource->periodic->period
+                                     + 1) * resource->periodic->period;
+    schedule_periodic(resource->periodic);
+    process_poll(&rest_engine_process);
   }
 }
 /*---------------------------------------------------------------------------*/
@@ -124,6 +249,27 @@ rest_get_resources(void)
   return restful_services;
 }
 /*---------------------------------------------------------------------------*/
+uint16_t
+rest_get_resources_version(void)
+{
+  return resources_version;
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+rest_get_resource_flow(const resource_t *resource)
+{
+  const resource_t *r;
+  uint16_t flow = 1;
+
+  for(r = list_head(restful_services); r != NULL; r = r->next) {
+    if(r == resource) {
+      return flow;
+    }
+    flow++;
+  }
+  return COMPOWER_FLOW_NONE;
+}
+/*---------------------------------------------------------------------------*/
 int
 rest_invoke_restful_service(void *request, void *response, uint8_t *buffer,
                             uint16_t buffer_size, int32_t *offset)
@@ -136,11 +282,16 @@ rest_invoke_restful_service(void *request, void *response, uint8_t *buffer,
   int url_len, res_url_len;
 
   url_len = REST.get_url(request, &url);
+#if REST_ENGINE_DISPATCH_INDEX_SIZE > 0
+  for(resource = dispatch_index[hash_first_segment(url, url_len)];
+      resource; resource = resource->index_next) {
+#else /* REST_ENGINE_DISPATCH_INDEX_SIZE > 0 */
   for(resource = (resource_t *)list_head(restful_services);
       resource; resource = resource->next) {
+#endif /* REST_ENGINE_DISPATCH_INDEX_SIZE > 0 */
 
     /* if the web service handles that kind of requests and urls matches */
-    res_url_len = strlen(resource->url);
+    res_url_len = resource->url_len;
     if((url_len == res_url_len
         || (url_len > res_url_len
             && (resource->flags & HAS_SUB_RESOURCES)
@@ -149,12 +300,21 @@ rest_invoke_restful_service(void *request, void *response, uint8_t *buffer,
       found = 1;
       rest_resource_flags_t method = REST.get_method_type(request);
 
+      /* The response is sent on behalf of the resource */
+      compower_set_flow(rest_get_resource_flow(resource));
+
       PRINTF("/%s, method %u, resource->flags %u\n", resource->url,
              (uint16_t)method, resource->flags);
 
       if((method & METHOD_GET) && resource->get_handler != NULL) {
         /* call handler function */
-        resource->get_handler(request, response, buffer, buffer_size, offset);
+        if((resource->flags & IS_SNAPSHOT) && REST.snapshot_handler) {
+          REST.snapshot_handler(resource, request, response, buffer,
+                                buffer_size, offset);
+        } else {
+          resource->get_handler(request, response, buffer, buffer_size,
+                                offset);
+        }
       } else if((method & METHOD_POST) && resource->post_handler != NULL) {
         /* call handler function */
         resource->post_handler(request, response, buffer, buffer_size,
@@ -191,38 +351,17 @@ PROCESS_THREAD(rest_engine_process, ev, data)
   /* pause to let REST server finish adding resources. */
   PROCESS_PAUSE();
 
-  /* initialize the PERIODIC_RESOURCE timers, which will be handled by this process. */
-  periodic_resource_t *periodic_resource = NULL;
-
-  for(periodic_resource =
-        (periodic_resource_t *)list_head(restful_periodic_services);
-      periodic_resource; periodic_resource = periodic_resource->next) {
-    if(periodic_resource->periodic_handler && periodic_resource->period) {
-      PRINTF("Periodic: Set timer for /%s to %lu\n",
-             periodic_resource->resource->url, periodic_resource->period);
-      etimer_set(&periodic_resource->periodic_timer,
-                 periodic_resource->period);
-    }
-  }
+  /* the periodic resources are scheduled in deadline order by this process */
+  update_periodic_timer();
+
   while(1) {
     PROCESS_WAIT_EVENT();
 
-    if(ev == PROCESS_EVENT_TIMER) {
-      for(periodic_resource =
-            (periodic_resource_t *)list_head(restful_periodic_services);
-          periodic_resource; periodic_resource = periodic_resource->next) {
-        if(periodic_resource->period
-           && etimer_expired(&periodic_resource->periodic_timer)) {
-
-          PRINTF("Periodic: etimer expired for /%s (period: %lu)\n",
-                 periodic_resource->resource->url, periodic_resource->period);
-
-          /* Call the periodic_handler function, which was checked during adding to list. */
-          (periodic_resource->periodic_handler)();
-
-          etimer_reset(&periodic_resource->periodic_timer);
-        }
-      }
+    if(ev == PROCESS_EVENT_TIMER && data == &periodic_timer) {
+      run_periodic();
+    } else if(ev == PROCESS_EVENT_POLL) {
+      /* a periodic resource has been activated */
+      update_periodic_timer();
     }
   }
 
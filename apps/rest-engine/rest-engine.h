@@ -45,6 +45,27 @@
 #include "contiki-lib.h"
 #include "rest-constants.h"
 
+/*
+ * Number of buckets in the dispatch index that maps the first URI path
+ * segment to the matching resources. Set to 0 to use a linear search of
+ * all resources instead.
+ */
+#ifdef REST_ENGINE_CONF_DISPATCH_INDEX_SIZE
+#define REST_ENGINE_DISPATCH_INDEX_SIZE REST_ENGINE_CONF_DISPATCH_INDEX_SIZE
+#else /* REST_ENGINE_CONF_DISPATCH_INDEX_SIZE */
+#define REST_ENGINE_DISPATCH_INDEX_SIZE 8
+#endif /* REST_ENGINE_CONF_DISPATCH_INDEX_SIZE */
+
+/*
+ * Periodic handlers that are due within this many clock ticks of the
+ * earliest one are run in the same wake-up.
+ */
+#ifdef REST_ENGINE_CONF_PERIODIC_WINDOW
+#define REST_ENGINE_PERIODIC_WINDOW REST_ENGINE_CONF_PERIODIC_WINDOW
+#else /* REST_ENGINE_CONF_PERIODIC_WINDOW */
+#define REST_ENGINE_PERIODIC_WINDOW (CLOCK_SECOND / 4)
+#endif /* REST_ENGINE_CONF_PERIODIC_WINDOW */
+
 /* list of valid REST Enigne implementations */
 #define REGISTERED_ENGINE_ERBIUM coap_rest_implementation
 #define REGISTERED_ENGINE_HELIUM http_rest_implementation
@@ -95,6 +116,8 @@ struct resource_s {
     restful_trigger_handler trigger;
     restful_trigger_handler resume;
   };
+  struct resource_s *index_next;  /* next resource in the dispatch index */
+  uint16_t url_len;               /* length of url, set on activation */
 };
 typedef struct resource_s resource_t;
 
@@ -102,7 +125,7 @@ struct periodic_resource_s {
   struct periodic_resource_s *next; /* for LIST, points to next resource defined */
   const resource_t *resource;
   uint32_t period;
-  struct etimer periodic_timer;
+  clock_time_t next_time;           /* deadline, kept in order by the engine */
   const restful_periodic_handler periodic_handler;
 };
 typedef struct periodic_resource_s periodic_resource_t;
@@ -132,7 +155,7 @@ typedef struct periodic_resource_s periodic_resource_t;
 #define PERIODIC_RESOURCE(name, attributes, get_handler, post_handler, put_handler, delete_handler, period, periodic_handler) \
   periodic_resource_t periodic_##name; \
   resource_t name = { NULL, NULL, IS_OBSERVABLE | IS_PERIODIC, attributes, get_handler, post_handler, put_handler, delete_handler, { .periodic = &periodic_##name } }; \
-  periodic_resource_t periodic_##name = { NULL, &name, period, { { 0 } }, periodic_handler };
+  periodic_resource_t periodic_##name = { NULL, &name, period, 0, periodic_handler };
 
 struct rest_implementation {
   char *name;
@@ -215,6 +238,11 @@ struct rest_implementation {
   /** The handler for resource subscriptions. */
   restful_final_handler subscription_handler;
 
+  /** Calls the GET handler of a resource flagged IS_SNAPSHOT. */
+  void (*snapshot_handler)(resource_t *resource, void *request,
+                           void *response, uint8_t *buffer,
+                           uint16_t buffer_size, int32_t *offset);
+
   /* REST status codes. */
   const struct rest_implementation_status status;
 
@@ -254,5 +282,24 @@ void rest_activate_resource(resource_t *resource, char *path);
  */
 list_t rest_get_resources(void);
 /*---------------------------------------------------------------------------*/
+/**
+ * \brief      Returns a counter that changes whenever a resource is activated.
+ * \return     The current version of the resource list.
+ *
+ * Can be used to invalidate data derived from the resource list.
+ */
+uint16_t rest_get_resources_version(void);
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief      Returns the flow the energy spent on a resource is attributed to.
+ * \param resource The resource
+ * \return     The flow, the position of the resource in the resource list
+ *             (and in /.well-known/core) counted from 1.
+ *
+ * The packets of requests to the resource and of its notifications are
+ * attributed to the flow (see compower_set_flow()).
+ */
+uint16_t rest_get_resource_flow(const resource_t *resource);
+/*---------------------------------------------------------------------------*/
 
 #endif /*REST_ENGINE_H_ */
@@ -40,6 +40,8 @@
 
 #include "contiki.h"
 #include "shell-memdebug.h"
+#include "lib/memb.h"
+#include "lib/mmem.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -55,6 +57,11 @@ SHELL_COMMAND(peek_command,
 	      "peek",
 	      "peek <address>: read a byte from address <address>",
 	      &shell_peek_process);
+PROCESS(shell_mempool_process, "mempool");
+SHELL_COMMAND(mempool_command,
+	      "mempool",
+	      "mempool [name]: show memory pool usage, or the allocation sites of pool [name]",
+	      &shell_mempool_process);
 /*---------------------------------------------------------------------------*/
 PROCESS_THREAD(shell_poke_process, ev, data)
 {
@@ -119,10 +126,60 @@ PROCESS_THREAD(shell_peek_process, ev, data)
   PROCESS_END();
 }
 /*---------------------------------------------------------------------------*/
+PROCESS_THREAD(shell_mempool_process, ev, data)
+{
+  struct mmem_stats mmem_stats;
+  char buf[80];
+#if MEMB_STATS
+  struct memb *m;
+  const char *name;
+#endif /* MEMB_STATS */
+
+  PROCESS_BEGIN();
+
+  mmem_get_stats(&mmem_stats);
+  snprintf(buf, sizeof(buf), ": %u/%u bytes, peak %u, failures %u, largest free %u",
+           mmem_stats.used, mmem_stats.size,
+           mmem_stats.peak, mmem_stats.failures, mmem_stats.largest_free);
+  shell_output_str(&mempool_command, "mmem", buf);
+
+#if MEMB_STATS
+  name = data;
+  if(name != NULL && *name == '\0') {
+    name = NULL;
+  }
+  for(m = memb_pool_list(); m != NULL; m = m->next) {
+    if(name == NULL) {
+      snprintf(buf, sizeof(buf), "%s: %u/%u of %u bytes, peak %u, failures %u",
+               m->name, m->used, m->num, m->size, m->peak, m->failures);
+      shell_output_str(&mempool_command, buf, "");
+    } else if(strcmp(name, m->name) == 0) {
+#if MEMB_TRACK_SITES
+      int i;
+      for(i = 0; i < m->num; i++) {
+        if(memb_site(m, i) != NULL) {
+          snprintf(buf, sizeof(buf), "%d: ", i);
+          shell_output_str(&mempool_command, buf, memb_site(m, i));
+        }
+      }
+#else /* MEMB_TRACK_SITES */
+      shell_output_str(&mempool_command,
+                       "Allocation sites need MEMB_CONF_TRACK_SITES", "");
+#endif /* MEMB_TRACK_SITES */
+    }
+  }
+#else /* MEMB_STATS */
+  shell_output_str(&mempool_command, "Pool statistics need MEMB_CONF_STATS", "");
+#endif /* MEMB_STATS */
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
 void
 shell_memdebug_init(void)
 {
   shell_register_command(&poke_command);
   shell_register_command(&peek_command);
+  shell_register_command(&mempool_command);
 }
 /*---------------------------------------------------------------------------*/
@@ -0,0 +1,388 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \file
+ *         netperf6: measures IPv6/UDP goodput, loss and jitter towards a
+ *         node that runs the same command set. The sender paces a stream
+ *         of datagrams and asks the receiver for a report at the end.
+ */
+
+#include <string.h>
+#include <stdio.h>
+
+#include "contiki.h"
+#include "shell.h"
+#include "contiki-net.h"
+#include "lib/random.h"
+
+#define DEBUG DEBUG_NONE
+#include "net/ip/uip-debug.h"
+
+#ifdef SHELL_NETPERF6_CONF_PORT
+#define SHELL_NETPERF6_PORT SHELL_NETPERF6_CONF_PORT
+#else
+#define SHELL_NETPERF6_PORT 5001
+#endif
+
+/* Times an END message is sent before the sender gives up on a report */
+#ifdef SHELL_NETPERF6_CONF_END_RETRIES
+#define SHELL_NETPERF6_END_RETRIES SHELL_NETPERF6_CONF_END_RETRIES
+#else
+#define SHELL_NETPERF6_END_RETRIES 8
+#endif
+
+#define UIP_IP_BUF   ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
+#define UIP_UDP_BUF  ((struct uip_udp_hdr *)&uip_buf[UIP_LLH_LEN + UIP_IPH_LEN])
+#define NETPERF6_BUF (&uip_buf[UIP_LLH_LEN + UIP_IPUDPH_LEN])
+#define NETPERF6_MAX_SIZE (UIP_BUFSIZE - UIP_LLH_LEN - UIP_IPUDPH_LEN)
+
+/* Messages, all fields in network byte order:
+ * DATA:   type, stream(2), seq(4), sender stream time in us(4), padding
+ * END:    type, stream(2), datagrams sent(4)
+ * REPORT: type, stream(2), received(4), bytes(4), duration in us(4),
+ *         jitter in us(4), out of order(4) */
+#define MSG_DATA   'D'
+#define MSG_END    'E'
+#define MSG_REPORT 'R'
+
+#define DATA_LEN   11
+#define END_LEN    7
+#define REPORT_LEN 23
+
+/* Microseconds elapsed since a reference point. The rtimer gives the
+ * resolution, the clock covers gaps longer than an rtimer wrap */
+struct stream_time {
+  uint32_t us;
+  clock_time_t clock;
+  rtimer_clock_t rtimer;
+};
+
+struct rx_stream {
+  uint16_t stream;
+  uint32_t received, bytes, highest_seq, ooo;
+  uint32_t first_us, last_us;
+  /* RFC 3550 interarrival jitter, in 1/16 us */
+  uint32_t jitter;
+  int32_t last_transit;
+  struct stream_time time;
+};
+
+/*---------------------------------------------------------------------------*/
+PROCESS(shell_netperf6_process, "netperf6");
+PROCESS(shell_netperf6_server_process, "netperf6 server");
+SHELL_COMMAND(netperf6_command,
+	      "netperf6",
+	      "netperf6 <addr> [size] [rate] [count]: measure UDP throughput to addr",
+	      &shell_netperf6_process);
+/*---------------------------------------------------------------------------*/
+static struct uip_udp_conn *server_conn;
+static struct rx_stream rx;
+/*---------------------------------------------------------------------------*/
+static void
+put16(uint8_t *p, uint16_t v)
+{
+  p[0] = v >> 8;
+  p[1] = v;
+}
+/*---------------------------------------------------------------------------*/
+static void
+put32(uint8_t *p, uint32_t v)
+{
+  put16(p, v >> 16);
+  put16(p + 2, v);
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+get16(const uint8_t *p)
+{
+  return ((uint16_t)p[0] << 8) | p[1];
+}
+/*---------------------------------------------------------------------------*/
+static uint32_t
+get32(const uint8_t *p)
+{
+  return ((uint32_t)get16(p) << 16) | get16(p + 2);
+}
+/*---------------------------------------------------------------------------*/
+static uint32_t
+rtimer_to_us(uint32_t ticks)
+{
+  uint32_t rem = ticks % RTIMER_SECOND;
+  uint32_t ms = rem * 1000;
+
+  return (ticks / RTIMER_SECOND) * 1000000UL
+    + (ms / RTIMER_SECOND) * 1000 + ((ms % RTIMER_SECOND) * 1000) / RTIMER_SECOND;
+}
+/*---------------------------------------------------------------------------*/
+static void
+stream_time_start(struct stream_time *t)
+{
+  t->us = 0;
+  t->clock = clock_time();
+  t->rtimer = RTIMER_NOW();
+}
+/*---------------------------------------------------------------------------*/
+static uint32_t
+stream_time_now(struct stream_time *t)
+{
+  clock_time_t now = clock_time();
+  rtimer_clock_t rnow = RTIMER_NOW();
+
+  if((clock_time_t)(now - t->clock) < CLOCK_SECOND) {
+    t->us += rtimer_to_us((rtimer_clock_t)(rnow - t->rtimer));
+  } else {
+    t->us += ((uint32_t)(now - t->clock) * 1000 / CLOCK_SECOND) * 1000;
+  }
+  t->clock = now;
+  t->rtimer = rnow;
+  return t->us;
+}
+/*---------------------------------------------------------------------------*/
+static void
+rx_data(const uint8_t *msg, uint16_t len)
+{
+  uint16_t stream = get16(msg + 1);
+  uint32_t seq = get32(msg + 3);
+  uint32_t now;
+  int32_t transit, d;
+
+  if(stream != rx.stream || rx.received == 0) {
+    memset(&rx, 0, sizeof(rx));
+    rx.stream = stream;
+    stream_time_start(&rx.time);
+  }
+  now = stream_time_now(&rx.time);
+  /* The clocks are not synchronized, only the variation matters */
+  transit = (int32_t)(now - get32(msg + 7));
+  if(rx.received == 0) {
+    rx.first_us = now;
+  } else {
+    d = transit - rx.last_transit;
+    if(d < 0) {
+      d = -d;
+    }
+    rx.jitter += d - ((rx.jitter + 8) >> 4);
+    if(seq < rx.highest_seq) {
+      rx.ooo++;
+    }
+  }
+  rx.last_transit = transit;
+  if(seq > rx.highest_seq) {
+    rx.highest_seq = seq;
+  }
+  rx.last_us = now;
+  rx.received++;
+  rx.bytes += len;
+}
+/*---------------------------------------------------------------------------*/
+static void
+rx_end(const uint8_t *msg)
+{
+  uip_ipaddr_t addr;
+  uint16_t port;
+  uint8_t *report = NETPERF6_BUF;
+  uint16_t stream = get16(msg + 1);
+
+  uip_ipaddr_copy(&addr, &UIP_IP_BUF->srcipaddr);
+  port = UIP_UDP_BUF->srcport;
+  PRINTF("netperf6: stream %u ends, %lu of %lu received\n", stream,
+         (unsigned long)(rx.stream == stream ? rx.received : 0),
+         (unsigned long)get32(msg + 3));
+
+  /* The END is repeated until a report gets through, answer every time */
+  if(rx.stream != stream) {
+    memset(&rx, 0, sizeof(rx));
+    rx.stream = stream;
+  }
+  report[0] = MSG_REPORT;
+  put16(report + 1, stream);
+  put32(report + 3, rx.received);
+  put32(report + 7, rx.bytes);
+  put32(report + 11, rx.last_us - rx.first_us);
+  put32(report + 15, rx.jitter >> 4);
+  put32(report + 19, rx.ooo);
+  uip_udp_packet_sendto(server_conn, report, REPORT_LEN, &addr, port);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(shell_netperf6_server_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  server_conn = udp_new(NULL, 0, NULL);
+  udp_bind(server_conn, UIP_HTONS(SHELL_NETPERF6_PORT));
+
+  while(1) {
+    PROCESS_WAIT_EVENT_UNTIL(ev == tcpip_event);
+    if(uip_newdata()) {
+      const uint8_t *msg = uip_appdata;
+      if(msg[0] == MSG_DATA && uip_datalen() >= DATA_LEN) {
+        rx_data(msg, uip_datalen());
+      } else if(msg[0] == MSG_END && uip_datalen() >= END_LEN) {
+        rx_end(msg);
+      }
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+static void
+print_report(uint32_t sent, const uint8_t *report)
+{
+  char buf[96];
+  uint32_t received = get32(report + 3);
+  uint32_t bytes = get32(report + 7);
+  uint32_t ms = get32(report + 11) / 1000;
+  uint32_t loss, goodput;
+
+  loss = sent > received ? ((sent - received) * 1000UL) / sent : 0;
+  goodput = ms == 0 ? 0 : (bytes / ms) * 1000 + ((bytes % ms) * 1000) / ms;
+
+  snprintf(buf, sizeof(buf), "sent %lu received %lu loss %lu.%lu%%",
+           (unsigned long)sent, (unsigned long)received,
+           (unsigned long)loss / 10, (unsigned long)loss % 10);
+  shell_output_str(&netperf6_command, buf, "");
+  snprintf(buf, sizeof(buf),
+           "goodput %lu bytes/s jitter %lu us out of order %lu in %lu ms",
+           (unsigned long)goodput, (unsigned long)get32(report + 15),
+           (unsigned long)get32(report + 19), (unsigned long)ms);
+  shell_output_str(&netperf6_command, buf, "");
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(shell_netperf6_process, ev, data)
+{
+  static struct uip_udp_conn *conn;
+  static struct etimer et;
+  static struct stream_time time;
+  static uip_ipaddr_t addr;
+  static clock_time_t start;
+  static uint32_t size, rate, count, sent;
+  static uint16_t stream;
+  static uint8_t tries;
+  const char *next;
+  char *end;
+  uint8_t *msg;
+
+  PROCESS_EXITHANDLER(if(conn != NULL) { uip_udp_remove(conn); conn = NULL; });
+
+  PROCESS_BEGIN();
+
+  end = strchr(data, ' ');
+  if(end != NULL) {
+    *end = 0;
+  }
+  if(*(char *)data == 0 || uiplib_ipaddrconv(data, &addr) == 0) {
+    shell_output_str(&netperf6_command,
+                     "netperf6 <addr> [size] [rate] [count]: addr must be an IPv6 address", "");
+    PROCESS_EXIT();
+  }
+  next = end != NULL ? end + 1 : "";
+  size = shell_strtolong(next, &next);
+  rate = shell_strtolong(next, &next);
+  count = shell_strtolong(next, &next);
+  size = size == 0 ? 64 : size;
+  rate = rate == 0 ? 10 : rate;
+  count = count == 0 ? 100 : count;
+  if(size < DATA_LEN) {
+    size = DATA_LEN;
+  } else if(size > NETPERF6_MAX_SIZE) {
+    size = NETPERF6_MAX_SIZE;
+  }
+  if(rate > CLOCK_SECOND) {
+    /* Datagrams are paced on clock ticks */
+    rate = CLOCK_SECOND;
+  }
+
+  conn = udp_new(&addr, UIP_HTONS(SHELL_NETPERF6_PORT), NULL);
+  if(conn == NULL) {
+    shell_output_str(&netperf6_command, "no UDP connection available", "");
+    PROCESS_EXIT();
+  }
+  stream = random_rand();
+
+  stream_time_start(&time);
+  start = clock_time();
+  for(sent = 0; sent < count; sent++) {
+    clock_time_t due = start + (clock_time_t)(sent * CLOCK_SECOND / rate);
+    if((long)(due - clock_time()) > 0) {
+      etimer_set(&et, due - clock_time());
+      PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+    } else {
+      /* Let the stack drain its queues when running behind */
+      PROCESS_PAUSE();
+    }
+    /* The datagram is written in place, uip_udp_packet_send() moves it */
+    msg = NETPERF6_BUF;
+    memset(msg, 0, size);
+    msg[0] = MSG_DATA;
+    put16(msg + 1, stream);
+    put32(msg + 3, sent);
+    put32(msg + 7, stream_time_now(&time));
+    uip_udp_packet_send(conn, msg, size);
+  }
+
+  for(tries = 0; tries < SHELL_NETPERF6_END_RETRIES; tries++) {
+    msg = NETPERF6_BUF;
+    msg[0] = MSG_END;
+    put16(msg + 1, stream);
+    put32(msg + 3, sent);
+    uip_udp_packet_send(conn, msg, END_LEN);
+    etimer_set(&et, CLOCK_SECOND);
+    while(!etimer_expired(&et)) {
+      PROCESS_WAIT_EVENT_UNTIL(ev == tcpip_event || etimer_expired(&et));
+      if(ev == tcpip_event && uip_newdata() && uip_datalen() >= REPORT_LEN) {
+        msg = uip_appdata;
+        if(msg[0] == MSG_REPORT && get16(msg + 1) == stream) {
+          print_report(sent, msg);
+          uip_udp_remove(conn);
+          conn = NULL;
+          PROCESS_EXIT();
+        }
+      }
+    }
+  }
+  shell_output_str(&netperf6_command, "no report received", "");
+  uip_udp_remove(conn);
+  conn = NULL;
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+void
+shell_netperf6_init(void)
+{
+  shell_register_command(&netperf6_command);
+  process_start(&shell_netperf6_server_process, NULL);
+}
+/*---------------------------------------------------------------------------*/
@@ -39,6 +39,14 @@
 #include "contiki.h"
 #include "shell.h"
 #include "contiki-net.h"
+#include "net/net-stats.h"
+#include "net/latency-trace.h"
+
+#ifdef SHELL_NETSTATS_CONF_MAX
+#define SHELL_NETSTATS_MAX SHELL_NETSTATS_CONF_MAX
+#else
+#define SHELL_NETSTATS_MAX 96
+#endif
 
 static const char closed[] =   /*  "CLOSED",*/
 {0x43, 0x4c, 0x4f, 0x53, 0x45, 0x44, 0};
@@ -133,10 +141,145 @@ PROCESS_THREAD(shell_netstat_process, ev, data)
   }
   PROCESS_END();
 }
+#if NET_STATS_ENABLED
+/*---------------------------------------------------------------------------*/
+PROCESS(shell_netstats_process, "netstats");
+SHELL_COMMAND(netstats_command,
+	      "netstats",
+	      "netstats [period]: show network stack counters and their rates",
+	      &shell_netstats_process);
+/*---------------------------------------------------------------------------*/
+/* The counters when last shown, to compute the rates from */
+static uint32_t previous[SHELL_NETSTATS_MAX];
+static clock_time_t previous_time;
+static uint8_t have_previous;
+/*---------------------------------------------------------------------------*/
+static void
+show_netstats(void)
+{
+  char buf[BUFLEN];
+  struct net_stats_group *g;
+  clock_time_t now = clock_time();
+  clock_time_t elapsed = now - previous_time;
+  uint32_t value;
+  uint8_t i;
+  int n = 0;
+
+  for(g = net_stats_list(); g != NULL; g = g->next) {
+    for(i = 0; i < g->num; i++, n++) {
+      value = g->get(i);
+      if(n < SHELL_NETSTATS_MAX && have_previous && elapsed > 0) {
+        snprintf(buf, BUFLEN, "%s.%s %lu %lu/s", g->name, g->names[i],
+                 (unsigned long)value,
+                 (unsigned long)((uint64_t)(value - previous[n]) *
+                                 CLOCK_SECOND / elapsed));
+      } else {
+        snprintf(buf, BUFLEN, "%s.%s %lu", g->name, g->names[i],
+                 (unsigned long)value);
+      }
+      if(n < SHELL_NETSTATS_MAX) {
+        previous[n] = value;
+      }
+      shell_output_str(&netstats_command, buf, "");
+    }
+  }
+  previous_time = now;
+  have_previous = 1;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(shell_netstats_process, ev, data)
+{
+  static struct etimer et;
+  static unsigned long period;
+  const char *next;
+  PROCESS_BEGIN();
+
+  period = shell_strtolong(data, &next);
+  show_netstats();
+  while(period > 0) {
+    etimer_set(&et, period * CLOCK_SECOND);
+    PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+    show_netstats();
+  }
+  PROCESS_END();
+}
+#endif /* NET_STATS_ENABLED */
+#if LATENCY_TRACE_ENABLED
+/*---------------------------------------------------------------------------*/
+PROCESS(shell_latency_process, "latency");
+SHELL_COMMAND(latency_command,
+	      "latency",
+	      "latency [hist|reset]: show the latency of each stage of sent packets",
+	      &shell_latency_process);
+/*---------------------------------------------------------------------------*/
+static void
+show_latency(int with_histogram)
+{
+  char buf[BUFLEN];
+  const struct latency_trace_stats *s;
+  uint32_t failed, lost;
+  uint8_t stage, bucket;
+
+  for(stage = 0; stage < LATENCY_TRACE_STAGES; stage++) {
+    s = latency_trace_get(stage);
+    snprintf(buf, BUFLEN,
+             "%s n %lu mean %lu p50 %lu p90 %lu p99 %lu max %lu us",
+             latency_trace_stage_name(stage), (unsigned long)s->count,
+             (unsigned long)(s->count > 0 ? s->sum / s->count : 0),
+             (unsigned long)latency_trace_percentile(stage, 50),
+             (unsigned long)latency_trace_percentile(stage, 90),
+             (unsigned long)latency_trace_percentile(stage, 99),
+             (unsigned long)s->max);
+    shell_output_str(&latency_command, buf, "");
+    for(bucket = 0; with_histogram && bucket < LATENCY_TRACE_BUCKETS;
+        bucket++) {
+      if(s->histogram[bucket] == 0) {
+        continue;
+      }
+      if(bucket < LATENCY_TRACE_BUCKETS - 1) {
+        snprintf(buf, BUFLEN, "  < %lu us %u",
+                 (unsigned long)latency_trace_bucket_limit(bucket),
+                 s->histogram[bucket]);
+      } else {
+        snprintf(buf, BUFLEN, "  >= %lu us %u",
+                 (unsigned long)latency_trace_bucket_limit(bucket - 1),
+                 s->histogram[bucket]);
+      }
+      shell_output_str(&latency_command, buf, "");
+    }
+  }
+  latency_trace_incomplete(&failed, &lost);
+  snprintf(buf, BUFLEN, "failed %lu lost %lu",
+           (unsigned long)failed, (unsigned long)lost);
+  shell_output_str(&latency_command, buf, "");
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(shell_latency_process, ev, data)
+{
+  const char *arg = data;
+  PROCESS_BEGIN();
+
+  while(arg != NULL && *arg == ' ') {
+    arg++;
+  }
+  if(arg != NULL && strncmp(arg, "reset", 5) == 0) {
+    latency_trace_reset();
+  } else {
+    show_latency(arg != NULL && strncmp(arg, "hist", 4) == 0);
+  }
+  PROCESS_END();
+}
+#endif /* LATENCY_TRACE_ENABLED */
 /*---------------------------------------------------------------------------*/
 void
 shell_netstat_init(void)
 {
   shell_register_command(&netstat_command);
+#if NET_STATS_ENABLED
+  shell_register_command(&netstats_command);
+#endif /* NET_STATS_ENABLED */
+#if LATENCY_TRACE_ENABLED
+  shell_register_command(&latency_command);
+#endif /* LATENCY_TRACE_ENABLED */
 }
 /*---------------------------------------------------------------------------*/
@@ -56,10 +56,33 @@ PROCESS_THREAD(shell_ps_process, ev, data)
   PROCESS_BEGIN();
 
   shell_output_str(&ps_command, "Processes:", "");
+#if PROCESS_CONF_PROFILE
+  {
+    char unitbuf[60];
+    snprintf(unitbuf, sizeof(unitbuf),
+             "calls run/max events latency/max, in 1/%lu s",
+             (unsigned long)RTIMER_SECOND);
+    shell_output_str(&ps_command, unitbuf, "");
+  }
+#endif /* PROCESS_CONF_PROFILE */
   for(p = PROCESS_LIST(); p != NULL; p = p->next) {
     char namebuf[30];
     strncpy(namebuf, PROCESS_NAME_STRING(p), sizeof(namebuf));
+#if PROCESS_CONF_PROFILE
+    {
+      char profbuf[80];
+      snprintf(profbuf, sizeof(profbuf), ": %lu %lu/%lu %lu %lu/%lu",
+               (unsigned long)p->profile.calls,
+               (unsigned long)p->profile.run_time,
+               (unsigned long)p->profile.max_run_time,
+               (unsigned long)p->profile.events,
+               (unsigned long)p->profile.latency,
+               (unsigned long)p->profile.max_latency);
+      shell_output_str(&ps_command, namebuf, profbuf);
+    }
+#else /* PROCESS_CONF_PROFILE */
     shell_output_str(&ps_command, namebuf, "");
+#endif /* PROCESS_CONF_PROFILE */
   }
 
   PROCESS_END();
@@ -383,6 +383,7 @@ struct shell_input {
 #include "shell-irc.h"
 #include "shell-memdebug.h"
 #include "shell-netperf.h"
+#include "shell-netperf6.h"
 #include "shell-netstat.h"
 #include "shell-ping.h"
 #include "shell-power.h"
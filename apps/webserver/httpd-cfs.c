@@ -75,15 +75,25 @@ MEMB(conns, struct httpd_state, CONNS);
 static
 PT_THREAD(send_file(struct httpd_state *s))
 {
+  unsigned int len;
+
   PSOCK_BEGIN(&s->sout);
   
   do {
-    /* Read data from file system into buffer */
-    s->len = cfs_read(s->fd, s->outputbuf, sizeof(s->outputbuf));
+    /* Send straight from the file system if it can map the data */
+    len = sizeof(s->outputbuf);
+    s->outputptr = cfs_map(s->fd, &len);
+    if(s->outputptr != NULL) {
+      s->len = len;
+    } else {
+      /* Read data from file system into buffer */
+      s->len = cfs_read(s->fd, s->outputbuf, sizeof(s->outputbuf));
+      s->outputptr = s->outputbuf;
+    }
 
     /* If there is data in the buffer, send it */
     if(s->len > 0) {
-      PSOCK_SEND(&s->sout, (uint8_t *)s->outputbuf, s->len);
+      PSOCK_SEND(&s->sout, (const uint8_t *)s->outputptr, s->len);
     } else {
       break;
     }
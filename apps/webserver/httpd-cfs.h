@@ -48,6 +48,7 @@ struct httpd_state {
   struct pt outputpt;
   char inputbuf[HTTPD_PATHLEN + 30];
   char outputbuf[UIP_TCP_MSS];
+  const char *outputptr;
   char filename[HTTPD_PATHLEN];
   char state;
   int fd;
@@ -51,6 +51,15 @@
 #define CONNS WEBSERVER_CONF_CGI_CONNS
 #endif /* WEBSERVER_CONF_CGI_CONNS */
 
+/* Send files with PSOCK_SEND() right from the file system data rather
+   than through a generator, so that retransmissions are taken from the
+   data itself. The file data must stay put until it is acked */
+#ifdef WEBSERVER_CONF_ZERO_COPY
+#define ZERO_COPY WEBSERVER_CONF_ZERO_COPY
+#else /* WEBSERVER_CONF_ZERO_COPY */
+#define ZERO_COPY 1
+#endif /* WEBSERVER_CONF_ZERO_COPY */
+
 #define STATE_WAITING 0
 #define STATE_OUTPUT  1
 
@@ -66,6 +75,7 @@ MEMB(conns, struct httpd_state, CONNS);
 #define ISO_colon   0x3a
 
 /*---------------------------------------------------------------------------*/
+#if !ZERO_COPY
 static unsigned short
 generate(void *state)
 {
@@ -80,17 +90,28 @@ generate(void *state)
   
   return s->len;
 }
+#endif /* !ZERO_COPY */
 /*---------------------------------------------------------------------------*/
 static
 PT_THREAD(send_file(struct httpd_state *s))
 {
   PSOCK_BEGIN(&s->sout);
   
+#if ZERO_COPY
+  /* psock walks the file segment by segment, and resends from it */
+  while(s->file.len > 0) {
+    s->len = s->file.len > 0xffff ? 0xffff : s->file.len;
+    PSOCK_SEND(&s->sout, (uint8_t *)s->file.data, s->len);
+    s->file.len -= s->len;
+    s->file.data += s->len;
+  }
+#else /* ZERO_COPY */
   do {
     PSOCK_GENERATOR_SEND(&s->sout, generate, s);
     s->file.len -= s->len;
     s->file.data += s->len;
   } while(s->file.len > 0);
+#endif /* ZERO_COPY */
       
   PSOCK_END(&s->sout);
 }
@@ -192,6 +213,9 @@ PT_THREAD(send_headers(struct httpd_state *s, const char *statushdr))
   PSOCK_BEGIN(&s->sout);
 
   SEND_STRING(&s->sout, statushdr);
+  if(s->gzipped) {
+    SEND_STRING(&s->sout, http_content_encoding_gzip);
+  }
 
   ptr = strrchr(s->filename, ISO_period);
   if(ptr == NULL) {
@@ -214,6 +238,27 @@ PT_THREAD(send_headers(struct httpd_state *s, const char *statushdr))
   PSOCK_END(&s->sout);
 }
 /*---------------------------------------------------------------------------*/
+static int
+open_file(struct httpd_state *s)
+{
+  char name[sizeof(s->filename) + sizeof(http_gz) - 1];
+  size_t len;
+
+  /* Prefer a copy of the file that makefsdata gzipped beforehand. The
+     name is kept without ".gz" to get the right content type */
+  s->gzipped = 0;
+  len = strlen(s->filename);
+  if(s->accept_gzip && len + sizeof(http_gz) <= sizeof(name)) {
+    memcpy(name, s->filename, len);
+    memcpy(name + len, http_gz, sizeof(http_gz));
+    if(httpd_fs_open(name, &s->file)) {
+      s->gzipped = 1;
+      return 1;
+    }
+  }
+  return httpd_fs_open(s->filename, &s->file);
+}
+/*---------------------------------------------------------------------------*/
 static
 PT_THREAD(handle_output(struct httpd_state *s))
 {
@@ -221,9 +266,11 @@ PT_THREAD(handle_output(struct httpd_state *s))
   
   PT_BEGIN(&s->outputpt);
  
-  if(!httpd_fs_open(s->filename, &s->file)) {
+  if(!open_file(s)) {
     strcpy(s->filename, http_404_html);
-    httpd_fs_open(s->filename, &s->file);
+    if(!open_file(s)) {
+      s->file.len = 0;
+    }
     PT_WAIT_THREAD(&s->outputpt,
 		   send_headers(s,
 		   http_header_404));
@@ -234,7 +281,7 @@ PT_THREAD(handle_output(struct httpd_state *s))
 		   send_headers(s,
 		   http_header_200));
     ptr = strrchr(s->filename, ISO_period);
-    if(ptr != NULL && strncmp(ptr, http_shtml, 6) == 0) {
+    if(ptr != NULL && strncmp(ptr, http_shtml, 6) == 0 && !s->gzipped) {
       PT_INIT(&s->scriptpt);
       PT_WAIT_THREAD(&s->outputpt, handle_script(s));
     } else {
@@ -281,6 +328,9 @@ PT_THREAD(handle_input(struct httpd_state *s))
       s->inputbuf[PSOCK_DATALEN(&s->sin) - 2] = 0;
       petsciiconv_topetscii(s->inputbuf, PSOCK_DATALEN(&s->sin) - 2);
       webserver_log(s->inputbuf);
+    } else if(strncmp(s->inputbuf, http_accept_encoding, 16) == 0) {
+      s->inputbuf[PSOCK_DATALEN(&s->sin) - 1] = 0;
+      s->accept_gzip = strstr(s->inputbuf, http_gzip) != NULL;
     }
   }
   
@@ -316,6 +366,8 @@ httpd_appcall(void *state)
     PSOCK_INIT(&s->sout, (uint8_t *)s->inputbuf, sizeof(s->inputbuf) - 1);
     PT_INIT(&s->outputpt);
     s->state = STATE_WAITING;
+    s->accept_gzip = 0;
+    s->gzipped = 0;
     /*    timer_set(&s->timer, CLOCK_SECOND * 100);*/
     s->timer = 0;
     handle_connection(s);
@@ -45,6 +45,9 @@ struct httpd_state {
   char inputbuf[50];
   char filename[20];
   char state;
+  /* The client takes gzip, and the file being sent is gzipped */
+  char accept_gzip;
+  char gzipped;
   struct httpd_fs_file file;  
   int len;
   char *scriptptr;
@@ -55,6 +55,7 @@
 #endif
 
 #include "contiki-conf.h"
+#include "contiki.h"
 #include "cfs/cfs.h"
 #include "cfs-coffee-arch.h"
 #include "cfs/cfs-coffee.h"
@@ -84,6 +85,70 @@
 #define COFFEE_EXTENDED_WEAR_LEVELLING  1
 #endif
 
+/*
+ * Keep an index from file name hashes to file pages in RAM, so that
+ * opening a file reads a single header instead of scanning the
+ * flash. The index is built by the first lookup, and costs
+ * COFFEE_NAME_INDEX_SIZE entries of a page number and a byte. If
+ * more files exist than the index can hold, lookups of names not in
+ * the index fall back to scanning the flash.
+ */
+#ifndef COFFEE_NAME_INDEX
+#define COFFEE_NAME_INDEX 0
+#endif
+
+#ifndef COFFEE_NAME_INDEX_SIZE
+#define COFFEE_NAME_INDEX_SIZE 32
+#endif
+
+/*
+ * Reclaim obsolete sectors from a process, one sector at a time,
+ * so that COFFEE_GC_RESERVE sectors are kept erased and reservations
+ * rarely have to wait for the garbage collector. The process checks
+ * every COFFEE_GC_INTERVAL, and right after files have been removed.
+ */
+#ifndef COFFEE_BACKGROUND_GC
+#define COFFEE_BACKGROUND_GC 0
+#endif
+
+#ifndef COFFEE_GC_RESERVE
+#define COFFEE_GC_RESERVE 1
+#endif
+
+#ifndef COFFEE_GC_INTERVAL
+#define COFFEE_GC_INTERVAL (10 * CLOCK_SECOND)
+#endif
+
+/*
+ * Remember in RAM which log record regions of an opened file have
+ * records in its micro log, for the first COFFEE_LOG_MAP_REGIONS
+ * regions of the file. Reads of the other regions then go straight
+ * to the file extent instead of searching the log. Costs
+ * COFFEE_LOG_MAP_REGIONS / 8 bytes for each of the
+ * COFFEE_MAX_OPEN_FILES cached files; 0 disables the map.
+ */
+#ifndef COFFEE_LOG_MAP_REGIONS
+#define COFFEE_LOG_MAP_REGIONS 0
+#endif
+
+#define WITH_LOG_MAP (COFFEE_MICRO_LOGS && COFFEE_LOG_MAP_REGIONS > 0)
+
+/*
+ * Segmented files, created with cfs_coffee_reserve_segmented(), are
+ * append-only files made of a chain of extents of the same size.
+ * When the last extent is full, appending chains a new extent to it
+ * instead of copying the file to a larger one.
+ */
+#ifndef COFFEE_SEGMENTED_FILES
+#define COFFEE_SEGMENTED_FILES 0
+#endif
+
+/* Count the erasures of every sector since boot, for
+   cfs_coffee_get_erase_count(). */
+#ifndef COFFEE_WEAR_STATS
+#define COFFEE_WEAR_STATS 0
+#endif
+
 #if COFFEE_START & (COFFEE_SECTOR_SIZE - 1)
 #error COFFEE_START must point to the first byte in a sector.
 #endif
@@ -96,6 +161,8 @@
 
 /* File object flags. */
 #define COFFEE_FILE_MODIFIED  0x1
+#define COFFEE_FILE_LOG_MAP   0x2 /* The log map of the file is loaded. */
+#define COFFEE_FILE_SEGMENTED 0x4 /* Segmented, append-only file. */
 
 /* Internal Coffee markers. */
 #define INVALID_PAGE      ((coffee_page_t)-1)
@@ -131,6 +198,8 @@
 #define HDR_FLAG_MODIFIED  0x08 /* Modified file, log exists. */
 #define HDR_FLAG_LOG       0x10 /* Log file. */
 #define HDR_FLAG_ISOLATED  0x20 /* Isolated page. */
+#define HDR_FLAG_SEGMENTED 0x40 /* Extent of a segmented file. */
+#define HDR_FLAG_LINKED    0x80 /* log_page is the next extent. */
 
 /* File header macros. */
 #define CHECK_FLAG(hdr, flag) ((hdr).flags & (flag))
@@ -141,6 +210,8 @@
 #define HDR_MODIFIED(hdr)     CHECK_FLAG(hdr, HDR_FLAG_MODIFIED)
 #define HDR_ISOLATED(hdr)     CHECK_FLAG(hdr, HDR_FLAG_ISOLATED)
 #define HDR_OBSOLETE(hdr)     CHECK_FLAG(hdr, HDR_FLAG_OBSOLETE)
+#define HDR_SEGMENTED(hdr)    CHECK_FLAG(hdr, HDR_FLAG_SEGMENTED)
+#define HDR_LINKED(hdr)       CHECK_FLAG(hdr, HDR_FLAG_LINKED)
 #define HDR_ACTIVE(hdr)       (HDR_ALLOCATED(hdr) && \
                                !HDR_OBSOLETE(hdr) && \
                                !HDR_ISOLATED(hdr))
@@ -168,6 +239,17 @@ struct file {
   int16_t record_count;
   uint8_t references;
   uint8_t flags;
+#if WITH_LOG_MAP
+  uint8_t log_map[(COFFEE_LOG_MAP_REGIONS + 7) / 8];
+#endif /* WITH_LOG_MAP */
+#if COFFEE_SEGMENTED_FILES
+  /* The last extent of a segmented file, and its offset in the file. */
+  coffee_page_t tail_page;
+  cfs_offset_t tail_start;
+  /* The extent last read from, to avoid walking the chain again. */
+  coffee_page_t read_page;
+  cfs_offset_t read_start;
+#endif /* COFFEE_SEGMENTED_FILES */
 };
 
 /* The file descriptor structure. */
@@ -190,6 +272,22 @@ struct file_header {
   char name[COFFEE_NAME_LENGTH];
 };
 
+#if COFFEE_NAME_INDEX
+/* An entry of the file name index. Free entries have the page
+   INVALID_PAGE. */
+struct name_index_entry {
+  coffee_page_t page;
+  uint8_t hash;
+};
+
+/* The index has not been built yet. */
+#define NAME_INDEX_UNBUILT  0
+/* Some files may be missing from the index. */
+#define NAME_INDEX_PARTIAL  1
+/* All files are in the index. */
+#define NAME_INDEX_COMPLETE 2
+#endif /* COFFEE_NAME_INDEX */
+
 /* This is needed because of a buggy compiler. */
 struct log_param {
   cfs_offset_t offset;
@@ -205,6 +303,13 @@ static struct file coffee_files[COFFEE_MAX_OPEN_FILES];
 static struct file_desc coffee_fd_set[COFFEE_FD_SET_SIZE];
 static coffee_page_t next_free;
 static char gc_wait;
+#if COFFEE_WEAR_STATS
+static uint32_t erase_counts[COFFEE_SECTOR_COUNT];
+#endif /* COFFEE_WEAR_STATS */
+#if COFFEE_NAME_INDEX
+static struct name_index_entry name_index[COFFEE_NAME_INDEX_SIZE];
+static uint8_t name_index_state;
+#endif /* COFFEE_NAME_INDEX */
 
 /*---------------------------------------------------------------------------*/
 static void
@@ -349,11 +454,32 @@ isolate_pages(coffee_page_t start, coffee_page_t skip_pages)
 }
 /*---------------------------------------------------------------------------*/
 static void
+erase_sector(coffee_page_t sector, coffee_page_t isolation_count)
+{
+  coffee_page_t first_page;
+
+  first_page = sector * COFFEE_PAGES_PER_SECTOR;
+  if(first_page < next_free) {
+    next_free = first_page;
+  }
+
+  if(isolation_count > 0) {
+    isolate_pages(first_page + COFFEE_PAGES_PER_SECTOR, isolation_count);
+  }
+
+  COFFEE_ERASE(sector);
+#if COFFEE_WEAR_STATS
+  erase_counts[sector]++;
+#endif /* COFFEE_WEAR_STATS */
+  PRINTF("Coffee: Erased sector %d!\n", sector);
+}
+/*---------------------------------------------------------------------------*/
+static void
 collect_garbage(int mode)
 {
   coffee_page_t sector;
   struct sector_status stats;
-  coffee_page_t first_page, isolation_count;
+  coffee_page_t isolation_count;
 
   PRINTF("Coffee: Running the garbage collector in %s mode\n",
          mode == GC_RELUCTANT ? "reluctant" : "greedy");
@@ -373,17 +499,7 @@ collect_garbage(int mode)
 
     if((mode == GC_RELUCTANT && stats.free == 0) ||
        (mode == GC_GREEDY && stats.obsolete > 0)) {
-      first_page = sector * COFFEE_PAGES_PER_SECTOR;
-      if(first_page < next_free) {
-        next_free = first_page;
-      }
-
-      if(isolation_count > 0) {
-        isolate_pages(first_page + COFFEE_PAGES_PER_SECTOR, isolation_count);
-      }
-
-      COFFEE_ERASE(sector);
-      PRINTF("Coffee: Erased sector %d!\n", sector);
+      erase_sector(sector, isolation_count);
 
       if(mode == GC_RELUCTANT && isolation_count > 0) {
         break;
@@ -391,6 +507,82 @@ collect_garbage(int mode)
     }
   }
 }
+#if COFFEE_BACKGROUND_GC
+/*---------------------------------------------------------------------------*/
+PROCESS(coffee_gc_process, "Coffee GC");
+/*---------------------------------------------------------------------------*/
+int
+cfs_coffee_gc_step(void)
+{
+  coffee_page_t sector;
+  struct sector_status stats;
+  coffee_page_t isolation_count;
+  coffee_page_t free_sectors;
+  coffee_page_t victim;
+  coffee_page_t victim_isolation;
+
+  /*
+   * Reading the sector status only takes the headers of the files,
+   * so we go through all sectors every time rather than keeping
+   * iteration state that writes in between would leave stale.
+   */
+  free_sectors = 0;
+  victim = INVALID_PAGE;
+  victim_isolation = 0;
+  for(sector = 0; sector < COFFEE_SECTOR_COUNT; sector++) {
+    isolation_count = get_sector_status(sector, &stats);
+    if(stats.free == COFFEE_PAGES_PER_SECTOR) {
+      free_sectors++;
+    } else if(stats.active == 0 && stats.obsolete > 0 &&
+              victim == INVALID_PAGE) {
+      victim = sector;
+      victim_isolation = isolation_count;
+    }
+  }
+
+  if(free_sectors >= COFFEE_GC_RESERVE || victim == INVALID_PAGE) {
+    return 0;
+  }
+
+  PRINTF("Coffee: %u erased sectors, reclaiming sector %u\n",
+         (unsigned)free_sectors, (unsigned)victim);
+  erase_sector(victim, victim_isolation);
+  gc_wait = 0;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+start_background_gc(void)
+{
+  if(!process_is_running(&coffee_gc_process)) {
+    process_start(&coffee_gc_process, NULL);
+  }
+  process_poll(&coffee_gc_process);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(coffee_gc_process, ev, data)
+{
+  static struct etimer et;
+
+  PROCESS_BEGIN();
+
+  etimer_set(&et, COFFEE_GC_INTERVAL);
+  while(1) {
+    PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_POLL || etimer_expired(&et));
+    if(etimer_expired(&et)) {
+      etimer_reset(&et);
+    }
+
+    /* Erase one sector at a time, letting the other processes run in
+       between. */
+    while(cfs_coffee_gc_step()) {
+      PROCESS_PAUSE();
+    }
+  }
+
+  PROCESS_END();
+}
+#endif /* COFFEE_BACKGROUND_GC */
 /*---------------------------------------------------------------------------*/
 static coffee_page_t
 next_file(coffee_page_t page, struct file_header *hdr)
@@ -412,6 +604,78 @@ next_file(coffee_page_t page, struct file_header *hdr)
   }
   return page + hdr->max_pages;
 }
+#if COFFEE_NAME_INDEX
+/*---------------------------------------------------------------------------*/
+static uint8_t
+name_hash(const char *name)
+{
+  uint8_t hash;
+  int i;
+
+  /* Only the part of the name that fits in a header counts. */
+  hash = 0;
+  for(i = 0; i < COFFEE_NAME_LENGTH - 1 && name[i] != '\0'; i++) {
+    hash = (hash << 3) + (hash >> 5) + name[i];
+  }
+  return hash;
+}
+/*---------------------------------------------------------------------------*/
+static void
+name_index_add(const char *name, coffee_page_t page)
+{
+  int i;
+
+  for(i = 0; i < COFFEE_NAME_INDEX_SIZE; i++) {
+    if(name_index[i].page == INVALID_PAGE) {
+      name_index[i].page = page;
+      name_index[i].hash = name_hash(name);
+      return;
+    }
+  }
+  PRINTF("Coffee: The name index is full\n");
+  name_index_state = NAME_INDEX_PARTIAL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+name_index_remove(coffee_page_t page)
+{
+  int i;
+
+  for(i = 0; i < COFFEE_NAME_INDEX_SIZE; i++) {
+    if(name_index[i].page == page) {
+      name_index[i].page = INVALID_PAGE;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+name_index_clear(void)
+{
+  int i;
+
+  for(i = 0; i < COFFEE_NAME_INDEX_SIZE; i++) {
+    name_index[i].page = INVALID_PAGE;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+name_index_build(void)
+{
+  struct file_header hdr;
+  coffee_page_t page;
+
+  name_index_clear();
+  name_index_state = NAME_INDEX_COMPLETE;
+  for(page = 0; page < COFFEE_PAGE_COUNT; page = next_file(page, &hdr)) {
+    read_header(&hdr, page);
+    if(HDR_ACTIVE(hdr) && !HDR_LOG(hdr)) {
+      name_index_add(hdr.name, page);
+    }
+  }
+  PRINTF("Coffee: Built the name index, %s\n",
+         name_index_state == NAME_INDEX_COMPLETE ? "complete" : "partial");
+}
+#endif /* COFFEE_NAME_INDEX */
 /*---------------------------------------------------------------------------*/
 static struct file *
 load_file(coffee_page_t start, struct file_header *hdr)
@@ -448,6 +712,15 @@ load_file(coffee_page_t start, struct file_header *hdr)
   file->flags = HDR_MODIFIED(*hdr) ? COFFEE_FILE_MODIFIED : 0;
   /* We don't know the amount of records yet. */
   file->record_count = -1;
+#if COFFEE_SEGMENTED_FILES
+  if(HDR_SEGMENTED(*hdr)) {
+    file->flags |= COFFEE_FILE_SEGMENTED;
+  }
+  /* Right for a new file, found by segmented_end() otherwise. */
+  file->tail_page = start;
+  file->tail_start = 0;
+  file->read_page = INVALID_PAGE;
+#endif /* COFFEE_SEGMENTED_FILES */
 
   return file;
 }
@@ -459,6 +732,37 @@ find_file(const char *name)
   struct file_header hdr;
   coffee_page_t page;
 
+#if COFFEE_NAME_INDEX
+  uint8_t hash;
+  int j;
+
+  if(name_index_state == NAME_INDEX_UNBUILT) {
+    name_index_build();
+  }
+
+  /* Only read the headers of the files whose name hash matches. */
+  hash = name_hash(name);
+  for(j = 0; j < COFFEE_NAME_INDEX_SIZE; j++) {
+    if(name_index[j].page == INVALID_PAGE || name_index[j].hash != hash) {
+      continue;
+    }
+    page = name_index[j].page;
+    read_header(&hdr, page);
+    if(HDR_ACTIVE(hdr) && !HDR_LOG(hdr) && strcmp(name, hdr.name) == 0) {
+      for(i = 0; i < COFFEE_MAX_OPEN_FILES; i++) {
+        if(!FILE_FREE(&coffee_files[i]) && coffee_files[i].page == page) {
+          return &coffee_files[i];
+        }
+      }
+      return load_file(page, &hdr);
+    }
+  }
+
+  if(name_index_state == NAME_INDEX_COMPLETE) {
+    return NULL;
+  }
+#endif /* COFFEE_NAME_INDEX */
+
   /* First check if the file metadata is cached. */
   for(i = 0; i < COFFEE_MAX_OPEN_FILES; i++) {
     if(FILE_FREE(&coffee_files[i])) {
@@ -572,6 +876,18 @@ remove_by_page(coffee_page_t page, int remove_log,
 
   hdr.flags |= HDR_FLAG_OBSOLETE;
   write_header(&hdr, page);
+#if COFFEE_SEGMENTED_FILES
+  /* Remove the extents that follow. */
+  while(HDR_LINKED(hdr)) {
+    coffee_page_t next = hdr.log_page;
+    read_header(&hdr, next);
+    hdr.flags |= HDR_FLAG_OBSOLETE;
+    write_header(&hdr, next);
+  }
+#endif /* COFFEE_SEGMENTED_FILES */
+#if COFFEE_NAME_INDEX
+  name_index_remove(page);
+#endif /* COFFEE_NAME_INDEX */
 
   gc_wait = 0;
 
@@ -592,9 +908,15 @@ remove_by_page(coffee_page_t page, int remove_log,
     }
   }
 
+#if COFFEE_BACKGROUND_GC
+  if(gc_allowed) {
+    start_background_gc();
+  }
+#else /* COFFEE_BACKGROUND_GC */
   if(!COFFEE_EXTENDED_WEAR_LEVELLING && gc_allowed) {
     collect_garbage(GC_RELUCTANT);
   }
+#endif /* COFFEE_BACKGROUND_GC */
 
   return 0;
 }
@@ -606,40 +928,64 @@ page_count(cfs_offset_t size)
          COFFEE_PAGE_SIZE;
 }
 /*---------------------------------------------------------------------------*/
-static struct file *
-reserve(const char *name, coffee_page_t pages,
-        int allow_duplicates, unsigned flags)
+static coffee_page_t
+reserve_pages(const char *name, coffee_page_t pages, unsigned flags,
+              struct file_header *hdr)
 {
-  struct file_header hdr;
   coffee_page_t page;
-  struct file *file;
-
-  if(!allow_duplicates && find_file(name) != NULL) {
-    return NULL;
-  }
 
   page = find_contiguous_pages(pages);
   if(page == INVALID_PAGE) {
     if(gc_wait) {
-      return NULL;
+      return INVALID_PAGE;
     }
     collect_garbage(GC_GREEDY);
     page = find_contiguous_pages(pages);
     if(page == INVALID_PAGE) {
       gc_wait = 1;
-      return NULL;
+      return INVALID_PAGE;
     }
   }
 
-  memset(&hdr, 0, sizeof(hdr));
-  strncpy(hdr.name, name, sizeof(hdr.name) - 1);
-  hdr.max_pages = pages;
-  hdr.flags = HDR_FLAG_ALLOCATED | flags;
-  write_header(&hdr, page);
+  memset(hdr, 0, sizeof(*hdr));
+  strncpy(hdr->name, name, sizeof(hdr->name) - 1);
+  hdr->max_pages = pages;
+  hdr->flags = HDR_FLAG_ALLOCATED | flags;
+  write_header(hdr, page);
+#if COFFEE_NAME_INDEX
+  if(!HDR_LOG(*hdr) && name_index_state != NAME_INDEX_UNBUILT) {
+    name_index_add(hdr->name, page);
+  }
+#endif /* COFFEE_NAME_INDEX */
 
   PRINTF("Coffee: Reserved %u pages starting from %u for file %s\n",
          (unsigned)pages, (unsigned)page, name);
 
+#if COFFEE_BACKGROUND_GC
+  /* Replenish the erased sectors that this reservation may have used. */
+  start_background_gc();
+#endif /* COFFEE_BACKGROUND_GC */
+
+  return page;
+}
+/*---------------------------------------------------------------------------*/
+static struct file *
+reserve(const char *name, coffee_page_t pages,
+        int allow_duplicates, unsigned flags)
+{
+  struct file_header hdr;
+  coffee_page_t page;
+  struct file *file;
+
+  if(!allow_duplicates && find_file(name) != NULL) {
+    return NULL;
+  }
+
+  page = reserve_pages(name, pages, flags, &hdr);
+  if(page == INVALID_PAGE) {
+    return NULL;
+  }
+
   file = load_file(page, &hdr);
   if(file != NULL) {
     file->end = 0;
@@ -648,6 +994,132 @@ reserve(const char *name, coffee_page_t pages,
   return file;
 }
 /*---------------------------------------------------------------------------*/
+#if COFFEE_SEGMENTED_FILES
+/* The amount of data in an extent of a given number of pages. */
+#define EXTENT_CAPACITY(pages) \
+  ((cfs_offset_t)(pages) * COFFEE_PAGE_SIZE - sizeof(struct file_header))
+
+static cfs_offset_t
+segmented_end(coffee_page_t page, coffee_page_t *tail_page,
+              cfs_offset_t *tail_start)
+{
+  struct file_header hdr;
+  cfs_offset_t start;
+
+  /* All extents but the last are full. */
+  for(start = 0;; page = hdr.log_page) {
+    read_header(&hdr, page);
+    if(!HDR_LINKED(hdr)) {
+      break;
+    }
+    start += EXTENT_CAPACITY(hdr.max_pages);
+  }
+
+  *tail_page = page;
+  *tail_start = start;
+  return start + file_end(page);
+}
+/*---------------------------------------------------------------------------*/
+static coffee_page_t
+find_extent(struct file *file, cfs_offset_t offset, cfs_offset_t *start)
+{
+  struct file_header hdr;
+  coffee_page_t page;
+
+  if(offset >= file->tail_start) {
+    *start = file->tail_start;
+    return file->tail_page;
+  }
+
+  if(file->read_page != INVALID_PAGE && offset >= file->read_start) {
+    page = file->read_page;
+    *start = file->read_start;
+  } else {
+    page = file->page;
+    *start = 0;
+  }
+
+  while(offset >= *start + EXTENT_CAPACITY(file->max_pages)) {
+    read_header(&hdr, page);
+    *start += EXTENT_CAPACITY(file->max_pages);
+    page = hdr.log_page;
+  }
+
+  file->read_page = page;
+  file->read_start = *start;
+  return page;
+}
+/*---------------------------------------------------------------------------*/
+static int
+read_segmented(struct file_desc *fdp, void *buf, unsigned size)
+{
+  coffee_page_t page;
+  cfs_offset_t start;
+  cfs_offset_t n;
+  unsigned done;
+
+  for(done = 0; done < size; done += n) {
+    page = find_extent(fdp->file, fdp->offset, &start);
+    n = start + EXTENT_CAPACITY(fdp->file->max_pages) - fdp->offset;
+    if(n > size - done) {
+      n = size - done;
+    }
+    COFFEE_READ((char *)buf + done, n,
+                absolute_offset(page, fdp->offset - start));
+    fdp->offset += n;
+  }
+
+  return size;
+}
+/*---------------------------------------------------------------------------*/
+static int
+append_segmented(struct file_desc *fdp, const void *buf, unsigned size)
+{
+  struct file *file;
+  struct file_header hdr, new_hdr;
+  coffee_page_t page;
+  cfs_offset_t n;
+  unsigned done;
+
+  file = fdp->file;
+  if(fdp->offset != file->end) {
+    return -1;
+  }
+
+  for(done = 0; done < size; done += n) {
+    n = file->tail_start + EXTENT_CAPACITY(file->max_pages) - fdp->offset;
+    if(n == 0) {
+      /* The last extent is full: chain a new one to it. */
+      read_header(&hdr, file->tail_page);
+      page = reserve_pages(hdr.name, file->max_pages,
+                           HDR_FLAG_SEGMENTED | HDR_FLAG_LOG, &new_hdr);
+      if(page == INVALID_PAGE) {
+        break;
+      }
+      hdr.log_page = page;
+      hdr.flags |= HDR_FLAG_LINKED;
+      write_header(&hdr, file->tail_page);
+      PRINTF("Coffee: Chained the extent at page %u to %s\n",
+             (unsigned)page, hdr.name);
+
+      file->tail_start += EXTENT_CAPACITY(file->max_pages);
+      file->tail_page = page;
+      continue;
+    }
+
+    if(n > size - done) {
+      n = size - done;
+    }
+    COFFEE_WRITE((char *)buf + done, n,
+                 absolute_offset(file->tail_page, fdp->offset - file->tail_start));
+    fdp->offset += n;
+    file->end = fdp->offset;
+  }
+
+  return done == 0 && size > 0 ? -1 : done;
+}
+#endif /* COFFEE_SEGMENTED_FILES */
+/*---------------------------------------------------------------------------*/
 #if COFFEE_MICRO_LOGS
 static void
 adjust_log_config(struct file_header *hdr,
@@ -678,6 +1150,71 @@ modify_log_buffer(uint16_t log_record_size,
 }
 #endif /* COFFEE_MICRO_LOGS */
 /*---------------------------------------------------------------------------*/
+#if WITH_LOG_MAP
+static void
+load_log_map(struct file *file, struct file_header *hdr)
+{
+  uint16_t log_record_size, log_records;
+  uint16_t processed, batch_size, preferred_batch_size;
+  uint16_t region;
+  int16_t end;
+  int i;
+
+  adjust_log_config(hdr, &log_record_size, &log_records);
+  memset(file->log_map, 0, sizeof(file->log_map));
+
+  /* Records are written in order, so the first free one ends the log. */
+  preferred_batch_size = log_records > COFFEE_LOG_TABLE_LIMIT ?
+    COFFEE_LOG_TABLE_LIMIT : log_records;
+  end = log_records;
+  {
+    uint16_t indices[preferred_batch_size];
+
+    for(processed = 0; processed < log_records && end == log_records;
+        processed += batch_size) {
+      batch_size = log_records - processed >= preferred_batch_size ?
+        preferred_batch_size : log_records - processed;
+
+      COFFEE_READ(&indices, batch_size * sizeof(indices[0]),
+                  absolute_offset(hdr->log_page, processed * sizeof(indices[0])));
+      for(i = 0; i < batch_size; i++) {
+        if(indices[i] == 0) {
+          end = processed + i;
+          break;
+        }
+        region = indices[i] - 1;
+        if(region < COFFEE_LOG_MAP_REGIONS) {
+          file->log_map[region / 8] |= 1 << (region % 8);
+        }
+      }
+    }
+  }
+
+  file->record_count = end;
+  file->flags |= COFFEE_FILE_LOG_MAP;
+}
+/*---------------------------------------------------------------------------*/
+static int
+log_map_has_record(struct file *file, struct file_header *hdr, uint16_t region)
+{
+  if(region >= COFFEE_LOG_MAP_REGIONS) {
+    return 1;
+  }
+  if(!(file->flags & COFFEE_FILE_LOG_MAP)) {
+    load_log_map(file, hdr);
+  }
+  return (file->log_map[region / 8] & (1 << (region % 8))) != 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+log_map_add(struct file *file, uint16_t region)
+{
+  if(region < COFFEE_LOG_MAP_REGIONS) {
+    file->log_map[region / 8] |= 1 << (region % 8);
+  }
+}
+#endif /* WITH_LOG_MAP */
+/*---------------------------------------------------------------------------*/
 #if COFFEE_MICRO_LOGS
 static int
 get_record_index(coffee_page_t log_page, uint16_t search_records,
@@ -722,8 +1259,8 @@ get_record_index(coffee_page_t log_page, uint16_t search_records,
 /*---------------------------------------------------------------------------*/
 #if COFFEE_MICRO_LOGS
 static int
-read_log_page(struct file_header *hdr, int16_t record_count,
-              struct log_param *lp)
+read_log_page(struct file *file, struct file_header *hdr,
+              int16_t record_count, struct log_param *lp)
 {
   uint16_t region;
   int16_t match_index;
@@ -735,6 +1272,16 @@ read_log_page(struct file_header *hdr, int16_t record_count,
   adjust_log_config(hdr, &log_record_size, &log_records);
   region = modify_log_buffer(log_record_size, &lp->offset, &lp->size);
 
+#if WITH_LOG_MAP
+  if(!log_map_has_record(file, hdr, region)) {
+    return -1;
+  }
+  if(record_count < 0) {
+    /* Loading the map has counted the records. */
+    record_count = file->record_count;
+  }
+#endif /* WITH_LOG_MAP */
+
   search_records = record_count < 0 ? log_records : record_count;
   match_index = get_record_index(hdr->log_page, search_records, region);
   if(match_index < 0) {
@@ -773,6 +1320,11 @@ create_log(struct file *file, struct file_header *hdr)
   write_header(hdr, file->page);
 
   file->flags |= COFFEE_FILE_MODIFIED;
+#if WITH_LOG_MAP
+  /* The new log is empty. */
+  memset(file->log_map, 0, sizeof(file->log_map));
+  file->flags |= COFFEE_FILE_LOG_MAP;
+#endif /* WITH_LOG_MAP */
   return log_file->page;
 }
 #endif /* COFFEE_MICRO_LOGS */
@@ -934,7 +1486,7 @@ write_log_page(struct file *file, struct log_param *lp)
     lp_out.size = log_record_size;
 
     if((lp->offset > 0 || lp->size != log_record_size) &&
-       read_log_page(&hdr, log_record, &lp_out) < 0) {
+       read_log_page(file, &hdr, log_record, &lp_out) < 0) {
       COFFEE_READ(copy_buf, sizeof(copy_buf),
                   absolute_offset(file->page, offset));
     }
@@ -954,6 +1506,11 @@ write_log_page(struct file *file, struct log_param *lp)
     COFFEE_WRITE(copy_buf, sizeof(copy_buf),
                  offset + log_record * log_record_size);
     file->record_count = log_record + 1;
+#if WITH_LOG_MAP
+    if(file->flags & COFFEE_FILE_LOG_MAP) {
+      log_map_add(file, region - 1);
+    }
+#endif /* WITH_LOG_MAP */
   }
 
   return lp->size;
@@ -1000,6 +1557,12 @@ cfs_open(const char *name, int flags)
     }
     fdp->file->end = 0;
   } else if(fdp->file->end == UNKNOWN_OFFSET) {
+#if COFFEE_SEGMENTED_FILES
+    if(fdp->file->flags & COFFEE_FILE_SEGMENTED) {
+      fdp->file->end = segmented_end(fdp->file->page, &fdp->file->tail_page,
+                                     &fdp->file->tail_start);
+    } else
+#endif /* COFFEE_SEGMENTED_FILES */
     fdp->file->end = file_end(fdp->file->page);
   }
 
@@ -1041,6 +1604,16 @@ cfs_seek(int fd, cfs_offset_t offset, int whence)
     return (cfs_offset_t)-1;
   }
 
+#if COFFEE_SEGMENTED_FILES
+  if(fdp->file->flags & COFFEE_FILE_SEGMENTED) {
+    /* Segmented files only grow by appending. */
+    if(new_offset < 0 || new_offset > fdp->file->end) {
+      return -1;
+    }
+    return fdp->offset = new_offset;
+  }
+#endif /* COFFEE_SEGMENTED_FILES */
+
   if(new_offset < 0 || new_offset > fdp->file->max_pages * COFFEE_PAGE_SIZE) {
     return -1;
   }
@@ -1103,6 +1676,12 @@ cfs_read(int fd, void *buf, unsigned size)
     size = file->end - fdp->offset;
   }
 
+#if COFFEE_SEGMENTED_FILES
+  if(file->flags & COFFEE_FILE_SEGMENTED) {
+    return read_segmented(fdp, buf, size);
+  }
+#endif /* COFFEE_SEGMENTED_FILES */
+
   /* If the file is not modified, read directly from the file extent. */
   if(!FILE_MODIFIED(file)) {
     COFFEE_READ(buf, size, absolute_offset(file->page, fdp->offset));
@@ -1122,7 +1701,7 @@ cfs_read(int fd, void *buf, unsigned size)
     lp.offset = fdp->offset;
     lp.buf = buf;
     lp.size = bytes_left;
-    r = read_log_page(&hdr, file->record_count, &lp);
+    r = read_log_page(file, &hdr, file->record_count, &lp);
 
     /* Read from the original file if we cannot find the data in the log. */
     if(r < 0) {
@@ -1137,6 +1716,57 @@ cfs_read(int fd, void *buf, unsigned size)
   return size;
 }
 /*---------------------------------------------------------------------------*/
+const void *
+cfs_map(int fd, unsigned *len)
+{
+#ifdef COFFEE_MAP
+  struct file_desc *fdp;
+  struct file *file;
+  coffee_page_t page;
+  cfs_offset_t start;
+  cfs_offset_t n;
+  const void *ptr;
+
+  if(!(FD_VALID(fd) && FD_READABLE(fd))) {
+    return NULL;
+  }
+
+  fdp = &coffee_fd_set[fd];
+  file = fdp->file;
+
+  /* The latest data of a modified file may be in its micro log. */
+  if(FILE_MODIFIED(file)) {
+    return NULL;
+  }
+
+  page = file->page;
+  start = 0;
+  n = file->end - fdp->offset;
+#if COFFEE_SEGMENTED_FILES
+  if(file->flags & COFFEE_FILE_SEGMENTED) {
+    /* Stop at the end of the extent. */
+    page = find_extent(file, fdp->offset, &start);
+    if(n > start + EXTENT_CAPACITY(file->max_pages) - fdp->offset) {
+      n = start + EXTENT_CAPACITY(file->max_pages) - fdp->offset;
+    }
+  }
+#endif /* COFFEE_SEGMENTED_FILES */
+  if(n > *len) {
+    n = *len;
+  }
+
+  ptr = COFFEE_MAP(absolute_offset(page, fdp->offset - start));
+  if(ptr != NULL) {
+    *len = n;
+    fdp->offset += n;
+  }
+  return ptr;
+#else /* COFFEE_MAP */
+  /* The storage is not memory-mapped. */
+  return NULL;
+#endif /* COFFEE_MAP */
+}
+/*---------------------------------------------------------------------------*/
 int
 cfs_write(int fd, const void *buf, unsigned size)
 {
@@ -1157,6 +1787,12 @@ cfs_write(int fd, const void *buf, unsigned size)
   fdp = &coffee_fd_set[fd];
   file = fdp->file;
 
+#if COFFEE_SEGMENTED_FILES
+  if(file->flags & COFFEE_FILE_SEGMENTED) {
+    return append_segmented(fdp, buf, size);
+  }
+#endif /* COFFEE_SEGMENTED_FILES */
+
   /* Attempt to extend the file if we try to write past the end. */
   if(!(fdp->io_flags & CFS_COFFEE_IO_FIRM_SIZE)) {
     while(size + fdp->offset + sizeof(struct file_header) >
@@ -1255,6 +1891,13 @@ cfs_readdir(struct cfs_dir *dir, struct cfs_dirent *record)
     if(HDR_ACTIVE(hdr) && !HDR_LOG(hdr)) {
       memcpy(record->name, hdr.name, sizeof(record->name));
       record->name[sizeof(record->name) - 1] = '\0';
+#if COFFEE_SEGMENTED_FILES
+      if(HDR_SEGMENTED(hdr)) {
+        coffee_page_t tail_page;
+        cfs_offset_t tail_start;
+        record->size = segmented_end(page, &tail_page, &tail_start);
+      } else
+#endif /* COFFEE_SEGMENTED_FILES */
       record->size = file_end(page);
 
       next_page = next_file(page, &hdr);
@@ -1279,6 +1922,15 @@ cfs_coffee_reserve(const char *name, cfs_offset_t size)
   return reserve(name, page_count(size), 0, 0) == NULL ? -1 : 0;
 }
 /*---------------------------------------------------------------------------*/
+#if COFFEE_SEGMENTED_FILES
+int
+cfs_coffee_reserve_segmented(const char *name, cfs_offset_t extent_size)
+{
+  return reserve(name, page_count(extent_size), 0,
+                 HDR_FLAG_SEGMENTED) == NULL ? -1 : 0;
+}
+#endif /* COFFEE_SEGMENTED_FILES */
+/*---------------------------------------------------------------------------*/
 int
 cfs_coffee_configure_log(const char *filename, unsigned log_size,
                          unsigned log_record_size)
@@ -1323,6 +1975,20 @@ cfs_coffee_set_io_semantics(int fd, unsigned flags)
 }
 #endif
 /*---------------------------------------------------------------------------*/
+#if COFFEE_WEAR_STATS
+unsigned
+cfs_coffee_get_sector_count(void)
+{
+  return COFFEE_SECTOR_COUNT;
+}
+/*---------------------------------------------------------------------------*/
+unsigned long
+cfs_coffee_get_erase_count(unsigned sector)
+{
+  return sector < COFFEE_SECTOR_COUNT ? erase_counts[sector] : 0;
+}
+#endif /* COFFEE_WEAR_STATS */
+/*---------------------------------------------------------------------------*/
 int
 cfs_coffee_format(void)
 {
@@ -1332,6 +1998,9 @@ cfs_coffee_format(void)
 
   for(i = 0; i < COFFEE_SECTOR_COUNT; i++) {
     COFFEE_ERASE(i);
+#if COFFEE_WEAR_STATS
+    erase_counts[i]++;
+#endif /* COFFEE_WEAR_STATS */
     PRINTF(".");
   }
 
@@ -1340,6 +2009,10 @@ cfs_coffee_format(void)
   memset(&coffee_fd_set, 0, sizeof(coffee_fd_set));
   next_free = 0;
   gc_wait = 1;
+#if COFFEE_NAME_INDEX
+  name_index_clear();
+  name_index_state = NAME_INDEX_COMPLETE;
+#endif /* COFFEE_NAME_INDEX */
 
   PRINTF(" done!\n");
 
@@ -95,6 +95,18 @@
  */
 int cfs_coffee_reserve(const char *name, cfs_offset_t size);
 
+/**
+ * \brief Reserve space for a segmented, append-only file.
+ * \param name The file name.
+ * \param extent_size The size of each extent of the file.
+ * \return 0 on success, -1 on failure.
+ * A segmented file grows by chaining extents of extent_size bytes as
+ * data is appended, instead of being copied to a larger extent.
+ * Writes are only accepted at the end of the file. Requires
+ * COFFEE_SEGMENTED_FILES.
+ */
+int cfs_coffee_reserve_segmented(const char *name, cfs_offset_t extent_size);
+
 /**
  * \brief Configure the on-demand log file.
  * \param file The file name.
@@ -125,6 +137,30 @@ int cfs_coffee_configure_log(const char *file, unsigned log_size,
  */
 int cfs_coffee_set_io_semantics(int fd, unsigned flags);
 
+/**
+ * \brief Erase one sector in the background garbage collection.
+ * \return 1 if a sector was erased, 0 if there was nothing to do.
+ * With COFFEE_BACKGROUND_GC, Coffee keeps COFFEE_GC_RESERVE sectors
+ * erased from a process of its own, erasing at most one sector before
+ * letting other processes run. This function runs one such step, for
+ * applications that want to reclaim space at a time of their choosing.
+ */
+int cfs_coffee_gc_step(void);
+
+/**
+ * \brief Get the number of sectors used by Coffee.
+ * Requires COFFEE_WEAR_STATS.
+ */
+unsigned cfs_coffee_get_sector_count(void);
+
+/**
+ * \brief Get the number of times a sector has been erased since boot.
+ * \param sector The sector, counted from the start of the Coffee area.
+ * \return The number of erasures, 0 for sectors outside the area.
+ * Requires COFFEE_WEAR_STATS.
+ */
+unsigned long cfs_coffee_get_erase_count(unsigned sector);
+
 /**
  * \brief Format the storage area assigned to Coffee.
  * \return 0 on success, -1 on failure.
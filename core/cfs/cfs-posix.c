@@ -79,6 +79,13 @@ cfs_read(int f, void *b, unsigned int l)
   return read(f, b, l);
 }
 /*---------------------------------------------------------------------------*/
+const void *
+cfs_map(int f, unsigned int *len)
+{
+  /* The data cannot be accessed in place. */
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
 int
 cfs_write(int f, const void *b, unsigned int l)
 {
@@ -102,6 +102,23 @@ cfs_read(int f, void *buf, unsigned int len)
   }
 }
 /*---------------------------------------------------------------------------*/
+const void *
+cfs_map(int f, unsigned int *len)
+{
+  const void *ptr;
+
+  if(f != 1) {
+    return NULL;
+  }
+
+  if(*len > file.filesize - file.fileptr) {
+    *len = file.filesize - file.fileptr;
+  }
+  ptr = &filemem[file.fileptr];
+  file.fileptr += *len;
+  return ptr;
+}
+/*---------------------------------------------------------------------------*/
 int
 cfs_write(int f, const void *buf, unsigned int len)
 {
@@ -108,6 +108,13 @@ cfs_read(int f, void *buf, unsigned int len)
   }
 }
 /*---------------------------------------------------------------------------*/
+const void *
+cfs_map(int f, unsigned int *len)
+{
+  /* The data cannot be accessed in place. */
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
 int
 cfs_write(int f, const void *buf, unsigned int len)
 {
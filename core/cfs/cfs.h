@@ -195,6 +195,27 @@ CCIF void cfs_close(int fd);
 CCIF int cfs_read(int fd, void *buf, unsigned int len);
 #endif
 
+/**
+ * \brief      Access data of an open file without copying it.
+ * \param fd   The file descriptor of the open file.
+ * \param len  The number of bytes wanted, set to the number of bytes
+ *             available at the returned pointer (0 at the end of the file).
+ * \return     A pointer to the data at the current position, or NULL
+ *             if the file system cannot map it.
+ *
+ *             When the file system keeps the data in memory-mapped
+ *             storage, this function returns a pointer to it and
+ *             advances the position, like cfs_read() does. Fewer
+ *             bytes than asked for may be available in one piece.
+ *             Otherwise it returns NULL, leaving the position
+ *             unchanged, and the caller uses cfs_read() instead. The
+ *             data is only valid until the file is written to or
+ *             closed.
+ */
+#ifndef cfs_map
+CCIF const void *cfs_map(int fd, unsigned int *len);
+#endif
+
 /**
  * \brief      Write data to an open file.
  * \param fd   The file descriptor of the open file.
@@ -58,6 +58,7 @@
 #define RADIO_H_
 
 #include <stddef.h>
+#include <stdint.h>
 
 /**
  * Each radio has a set of parameters that designate the current
@@ -170,6 +171,13 @@ enum {
    * it needs to be used with radio.get_object()/set_object(). */
   RADIO_PARAM_LAST_PACKET_TIMESTAMP,
 
+  /*
+   * PHY mode (e.g. data rate) the radio receives with, for radios that
+   * support several. The values are radio specific, 0 being the default.
+   * Transmissions may use another mode, see PACKETBUF_ATTR_PHY_MODE.
+   */
+  RADIO_PARAM_PHY_MODE,
+
   /* Constants (read only) */
 
   /* The lowest radio channel. */
@@ -180,7 +188,13 @@ enum {
   /* The minimum transmission power in dBm. */
   RADIO_CONST_TXPOWER_MIN,
   /* The maximum transmission power in dBm. */
-  RADIO_CONST_TXPOWER_MAX
+  RADIO_CONST_TXPOWER_MAX,
+
+  /* Multi-frame receive ring (see struct radio_rx_ring), for radios that
+   * capture several frames before they are read. Of type
+   * const struct radio_rx_ring *, it needs to be used with
+   * radio.get_object(). */
+  RADIO_CONST_RX_RING
 };
 
 /* Radio power modes */
@@ -231,6 +245,38 @@ enum {
   RADIO_TX_NOACK,
 };
 
+/**
+ * A frame captured in a radio receive ring. The frame (without FCS)
+ * stays in driver memory until released.
+ */
+struct radio_rx_frame {
+  const uint8_t *data;
+  unsigned short len;
+  int16_t rssi;
+  uint8_t link_quality;
+};
+
+/**
+ * Optional multi-frame receive ring. The driver captures back-to-back
+ * frames without CPU involvement where the hardware allows it (DMA,
+ * radio core data queues), and the MAC drains them in a batch, in
+ * place. read() and pending_packet() keep working on the same frames,
+ * one at a time.
+ */
+struct radio_rx_ring {
+  /** Number of frames captured and not released yet */
+  int (* pending)(void);
+
+  /** Get the oldest captured frame, without releasing it. Also sets
+      RADIO_PARAM_LAST_RSSI, RADIO_PARAM_LAST_LINK_QUALITY and
+      RADIO_PARAM_LAST_PACKET_TIMESTAMP. Returns 0 if there is none. */
+  int (* peek)(struct radio_rx_frame *frame);
+
+  /** Release the oldest captured frame, handing its memory back to
+      the driver */
+  void (* release)(void);
+};
+
 /**
  * The structure of a device driver for a radio in Contiki.
  */
@@ -30,7 +30,7 @@
  *
  */
 #include "dev/serial-line.h"
-#include <string.h> /* for memcpy() */
+#include <string.h> /* for memcpy() and memchr() */
 
 #include "lib/ringbuf.h"
 
@@ -45,6 +45,11 @@
 #error Change SERIAL_LINE_CONF_BUFSIZE in contiki-conf.h.
 #endif
 
+#if BUFSIZE > RINGBUF_MAX_SIZE
+#error SERIAL_LINE_CONF_BUFSIZE is larger than the ring buffer supports.
+#error Set RINGBUF_CONF_16BIT in contiki-conf.h.
+#endif
+
 #define IGNORE_CHAR(c) (c == 0x0d)
 #define END 0x0a
 
@@ -95,20 +100,31 @@ PROCESS_THREAD(serial_line_process, ev, data)
   ptr = 0;
 
   while(1) {
-    /* Fill application buffer until newline or empty */
-    int c = ringbuf_get(&rxbuf);
-    
-    if(c == -1) {
+    /* Fill application buffer until newline or empty, a run of
+       received bytes at a time */
+    uint8_t *span;
+    uint8_t *end;
+    int len = ringbuf_peek_span(&rxbuf, &span);
+
+    if(len == 0) {
       /* Buffer empty, wait for poll */
       PROCESS_YIELD();
     } else {
-      if(c != END) {
-        if(ptr < BUFSIZE-1) {
-          buf[ptr++] = (uint8_t)c;
-        } else {
-          /* Ignore character (wait for EOL) */
-        }
+      end = memchr(span, END, len);
+      if(end != NULL) {
+        len = end - span;
+      }
+      if(len > BUFSIZE - 1 - ptr) {
+        /* Ignore characters that do not fit (wait for EOL) */
+        memcpy(&buf[ptr], span, BUFSIZE - 1 - ptr);
+        ptr = BUFSIZE - 1;
       } else {
+        memcpy(&buf[ptr], span, len);
+        ptr += len;
+      }
+      ringbuf_consume(&rxbuf, end != NULL ? len + 1 : len);
+
+      if(end != NULL) {
         /* Terminate */
         buf[ptr++] = (uint8_t)'\0';
 
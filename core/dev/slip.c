@@ -42,6 +42,7 @@
 #define BUF ((struct uip_tcpip_hdr *)&uip_buf[UIP_LLH_LEN])
 
 #include "dev/slip.h"
+#include "lib/crc16.h"
 
 #define SLIP_END     0300
 #define SLIP_ESC     0333
@@ -56,11 +57,44 @@ uint8_t slip_active;
 #define SLIP_STATISTICS(statement)
 #else
 uint16_t slip_rubbish, slip_twopackets, slip_overflow, slip_ip_drop;
+uint16_t slip_crc_errors, slip_seqno_gaps;
 #define SLIP_STATISTICS(statement) statement
 #endif
 
-/* Must be at least one byte larger than UIP_BUFSIZE! */
+/* Incoming frames end with a sequence number and a CRC-16 of the frame
+ * and the sequence number, as sent by tunslip6 -C */
+#ifdef SLIP_CONF_WITH_CRC
+#define SLIP_WITH_CRC SLIP_CONF_WITH_CRC
+#else
+#define SLIP_WITH_CRC 0
+#endif
+
+/* Must be at least one byte larger than UIP_BUFSIZE! Room for several
+ * frames lets the host send them back to back */
+#ifdef SLIP_CONF_RX_BUFSIZE
+#define RX_BUFSIZE SLIP_CONF_RX_BUFSIZE
+#else
 #define RX_BUFSIZE (UIP_BUFSIZE - UIP_LLH_LEN + 16)
+#endif
+
+/* Escape whole frames into a buffer and hand it to slip_arch_write(),
+ * e.g. to send it with DMA, instead of writing one byte at a time */
+#ifdef SLIP_CONF_ARCH_WRITE
+#define SLIP_ARCH_WRITE SLIP_CONF_ARCH_WRITE
+#else
+#define SLIP_ARCH_WRITE 0
+#endif
+
+#if SLIP_ARCH_WRITE
+/* Frames that do not fit once escaped are handed over in several parts */
+#ifdef SLIP_CONF_TX_BUFSIZE
+#define TX_BUFSIZE SLIP_CONF_TX_BUFSIZE
+#else
+#define TX_BUFSIZE (UIP_BUFSIZE - UIP_LLH_LEN + 16)
+#endif
+static uint8_t txbuf[TX_BUFSIZE];
+static uint16_t txlen;
+#endif /* SLIP_ARCH_WRITE */
 
 enum {
   STATE_TWOPACKETS = 0,	/* We have 2 packets and drop incoming data. */
@@ -93,6 +127,56 @@ slip_set_input_callback(void (*c)(void))
   input_callback = c;
 }
 /*---------------------------------------------------------------------------*/
+#if SLIP_ARCH_WRITE
+static void
+tx_flush(void)
+{
+  if(txlen > 0) {
+    slip_arch_write(txbuf, txlen);
+    txlen = 0;
+  }
+}
+#endif /* SLIP_ARCH_WRITE */
+/*---------------------------------------------------------------------------*/
+static void
+tx_byte(uint8_t c)
+{
+#if SLIP_ARCH_WRITE
+  if(txlen == TX_BUFSIZE) {
+    tx_flush();
+  }
+  if(txlen == 0) {
+    /* The previous part may still be read from the buffer */
+    while(slip_arch_write_pending());
+  }
+  txbuf[txlen++] = c;
+#else /* SLIP_ARCH_WRITE */
+  slip_arch_writeb(c);
+#endif /* SLIP_ARCH_WRITE */
+}
+/*---------------------------------------------------------------------------*/
+static void
+tx_escaped(uint8_t c)
+{
+  if(c == SLIP_END) {
+    tx_byte(SLIP_ESC);
+    c = SLIP_ESC_END;
+  } else if(c == SLIP_ESC) {
+    tx_byte(SLIP_ESC);
+    c = SLIP_ESC_ESC;
+  }
+  tx_byte(c);
+}
+/*---------------------------------------------------------------------------*/
+static void
+tx_end(void)
+{
+  tx_byte(SLIP_END);
+#if SLIP_ARCH_WRITE
+  tx_flush();
+#endif /* SLIP_ARCH_WRITE */
+}
+/*---------------------------------------------------------------------------*/
 /* slip_send: forward (IPv4) packets with {UIP_FW_NETIF(..., slip_send)}
  * was used in slip-bridge.c
  */
@@ -101,26 +185,17 @@ slip_send(void)
 {
   uint16_t i;
   uint8_t *ptr;
-  uint8_t c;
 
-  slip_arch_writeb(SLIP_END);
+  tx_byte(SLIP_END);
 
   ptr = &uip_buf[UIP_LLH_LEN];
   for(i = 0; i < uip_len; ++i) {
     if(i == UIP_TCPIP_HLEN) {
       ptr = (uint8_t *)uip_appdata;
     }
-    c = *ptr++;
-    if(c == SLIP_END) {
-      slip_arch_writeb(SLIP_ESC);
-      c = SLIP_ESC_END;
-    } else if(c == SLIP_ESC) {
-      slip_arch_writeb(SLIP_ESC);
-      c = SLIP_ESC_ESC;
-    }
-    slip_arch_writeb(c);
+    tx_escaped(*ptr++);
   }
-  slip_arch_writeb(SLIP_END);
+  tx_end();
 
   return UIP_FW_OK;
 }
@@ -130,22 +205,13 @@ slip_write(const void *_ptr, int len)
 {
   const uint8_t *ptr = _ptr;
   uint16_t i;
-  uint8_t c;
 
-  slip_arch_writeb(SLIP_END);
+  tx_byte(SLIP_END);
 
   for(i = 0; i < len; ++i) {
-    c = *ptr++;
-    if(c == SLIP_END) {
-      slip_arch_writeb(SLIP_ESC);
-      c = SLIP_ESC_END;
-    } else if(c == SLIP_ESC) {
-      slip_arch_writeb(SLIP_ESC);
-      c = SLIP_ESC_ESC;
-    }
-    slip_arch_writeb(c);
+    tx_escaped(*ptr++);
   }
-  slip_arch_writeb(SLIP_END);
+  tx_end();
 
   return len;
 }
@@ -320,6 +386,32 @@ slip_poll_handler(uint8_t *outbuf, uint16_t blen)
   return 0;
 }
 /*---------------------------------------------------------------------------*/
+#if SLIP_WITH_CRC
+/* Check and strip the sequence number and CRC of a frame in uip_buf */
+static uint16_t
+check_frame(uint16_t len)
+{
+  static uint8_t next_seqno;
+  const uint8_t *ptr = &uip_buf[UIP_LLH_LEN];
+
+  if(len < 3) {
+    return 0;
+  }
+  len -= 2;
+  if(crc16_data(ptr, len, 0) != (ptr[len] | ((uint16_t)ptr[len + 1] << 8))) {
+    SLIP_STATISTICS(slip_crc_errors++);
+    return 0;
+  }
+  len--;
+  if(ptr[len] != next_seqno) {
+    /* Frames were lost on the way, most likely to rxbuf overflow */
+    SLIP_STATISTICS(slip_seqno_gaps++);
+  }
+  next_seqno = ptr[len] + 1;
+  return len;
+}
+#endif /* SLIP_WITH_CRC */
+/*---------------------------------------------------------------------------*/
 PROCESS_THREAD(slip_process, ev, data)
 {
   PROCESS_BEGIN();
@@ -334,6 +426,11 @@ PROCESS_THREAD(slip_process, ev, data)
     /* Move packet from rxbuf to buffer provided by uIP. */
     uip_len = slip_poll_handler(&uip_buf[UIP_LLH_LEN],
 				UIP_BUFSIZE - UIP_LLH_LEN);
+#if SLIP_WITH_CRC
+    if(uip_len > 0) {
+      uip_len = check_frame(uip_len);
+    }
+#endif /* SLIP_WITH_CRC */
 #if !NETSTACK_CONF_WITH_IPV6
     if(uip_len == 4 && strncmp((char*)&uip_buf[UIP_LLH_LEN], "?IPA", 4) == 0) {
       char buf[8];
@@ -455,3 +552,14 @@ slip_input_byte(unsigned char c)
   return 0;
 }
 /*---------------------------------------------------------------------------*/
+int
+slip_input_bytes(const unsigned char *data, int len)
+{
+  int wake = 0;
+
+  while(len-- > 0) {
+    wake |= slip_input_byte(*data++);
+  }
+  return wake;
+}
+/*---------------------------------------------------------------------------*/
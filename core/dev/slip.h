@@ -62,6 +62,15 @@ uint8_t slip_send(void);
  */
 int slip_input_byte(unsigned char c);
 
+/**
+ * Input a block of SLIP bytes, as received by DMA or read from a FIFO
+ * in one go. Works like slip_input_byte(), and can also be called from
+ * an interrupt context.
+ *
+ * \return Non-zero if the CPU should be powered up, zero otherwise.
+ */
+int slip_input_bytes(const unsigned char *data, int len);
+
 uint8_t slip_write(const void *ptr, int len);
 
 /* Did we receive any bytes lately? */
@@ -69,6 +78,7 @@ extern uint8_t slip_active;
 
 /* Statistics. */
 extern uint16_t slip_rubbish, slip_twopackets, slip_overflow, slip_ip_drop;
+extern uint16_t slip_crc_errors, slip_seqno_gaps;
 
 /**
  * Set a function to be called when there is activity on the SLIP
@@ -83,4 +93,15 @@ void slip_set_input_callback(void (*callback)(void));
 void slip_arch_init(unsigned long ubr);
 void slip_arch_writeb(unsigned char c);
 
+/*
+ * With SLIP_CONF_ARCH_WRITE, frames are escaped into a buffer of
+ * SLIP_CONF_TX_BUFSIZE bytes and handed to slip_arch_write(), which may
+ * return before they are sent (e.g. when it starts a DMA transfer). The
+ * buffer is not touched again until slip_arch_write_pending() returns
+ * zero. slip_arch_writeb() is still used for short replies and must
+ * also wait for a pending write.
+ */
+void slip_arch_write(const uint8_t *ptr, uint16_t len);
+int slip_arch_write_pending(void);
+
 #endif /* SLIP_H_ */
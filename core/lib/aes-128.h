@@ -51,6 +51,30 @@
 #define AES_128            aes_128_driver
 #endif /* AES_128_CONF */
 
+/*
+ * Software AES: encrypt with a 32-bit lookup table combining SubBytes,
+ * ShiftRows and MixColumns, rather than byte by byte. Several times faster
+ * on 32-bit CPUs, at the cost of 1 KB of ROM and 176 bytes of RAM. Not
+ * worth it on 8/16-bit CPUs.
+ */
+#ifdef AES_128_CONF_WITH_TTABLES
+#define AES_128_WITH_TTABLES AES_128_CONF_WITH_TTABLES
+#else /* AES_128_CONF_WITH_TTABLES */
+#define AES_128_WITH_TTABLES 0
+#endif /* AES_128_CONF_WITH_TTABLES */
+
+/*
+ * Software AES: number of expanded keys to keep, from the most recently
+ * used. Setting one of them again skips the key expansion, which helps
+ * when frames alternate between keys, as with pairwise link-layer keys.
+ * Costs 176 bytes of RAM per key, twice that with T-tables.
+ */
+#ifdef AES_128_CONF_KEY_CACHE_SIZE
+#define AES_128_KEY_CACHE_SIZE AES_128_CONF_KEY_CACHE_SIZE
+#else /* AES_128_CONF_KEY_CACHE_SIZE */
+#define AES_128_KEY_CACHE_SIZE 1
+#endif /* AES_128_CONF_KEY_CACHE_SIZE */
+
 /**
  * Structure of AES drivers.
  */
@@ -55,6 +55,32 @@
 #ifndef CRC16_H_
 #define CRC16_H_
 
+#include "contiki-conf.h"
+
+/* How crc16_add() and crc16_data() compute the checksum:
+ * CRC16_TABLE_NONE: a few shifts per byte, no table
+ * CRC16_TABLE_NIBBLE: two lookups per byte in a table of 32 bytes
+ * CRC16_TABLE_BYTE: one lookup per byte in a table of 512 bytes, the
+ * fastest in software for data blocks */
+#define CRC16_TABLE_NONE   0
+#define CRC16_TABLE_NIBBLE 1
+#define CRC16_TABLE_BYTE   2
+
+#ifdef CRC16_CONF_TABLE
+#define CRC16_TABLE CRC16_CONF_TABLE
+#else
+#define CRC16_TABLE CRC16_TABLE_NONE
+#endif
+
+/* A CPU with a CRC peripheral for this polynomial can compute
+ * crc16_data() with it: CRC16_CONF_ARCH_DATA names a function with the
+ * same arguments and result as crc16_data() */
+#ifdef CRC16_CONF_ARCH_DATA
+#define CRC16_ARCH_DATA CRC16_CONF_ARCH_DATA
+unsigned short CRC16_ARCH_DATA(const unsigned char *data, int datalen,
+                               unsigned short acc);
+#endif
+
 /**
  * \brief      Update an accumulated CRC16 checksum with one byte.
  * \param b    The byte to be added to the checksum
@@ -65,10 +91,11 @@
  *             with one byte. It can be used as a running checksum, or
  *             to checksum an entire data block.
  *
- *             \note The algorithm used in this implementation is
- *             tailored for a running checksum and does not perform as
- *             well as a table-driven algorithm when checksumming an
- *             entire data block.
+ *             \note Unless CRC16_CONF_TABLE selects a table, the
+ *             algorithm used in this implementation is tailored for a
+ *             running checksum and does not perform as well as a
+ *             table-driven algorithm when checksumming an entire data
+ *             block.
  *
  */
 unsigned short crc16_add(unsigned char b, unsigned short crc);
@@ -82,10 +109,9 @@ unsigned short crc16_add(unsigned char b, unsigned short crc);
  *
  *             This function calculates the CRC16 checksum of a data area.
  *
- *             \note The algorithm used in this implementation is
- *             tailored for a running checksum and does not perform as
- *             well as a table-driven algorithm when checksumming an
- *             entire data block.
+ *             \note This uses the CRC peripheral of the CPU if there
+ *             is one (see CRC16_CONF_ARCH_DATA), and otherwise the
+ *             algorithm selected with CRC16_CONF_TABLE.
  */
 unsigned short crc16_data(const unsigned char *data, int datalen,
 			  unsigned short acc);
@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Crypto service, and its software driver.
+ */
+
+#include "lib/crypto-service.h"
+#include "lib/list.h"
+
+LIST(requests);
+static struct crypto_service_request *current;
+static struct pt driver_pt;
+process_event_t crypto_service_event;
+
+PROCESS(crypto_service_process, "Crypto service");
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(crypto_service_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  while(1) {
+    PROCESS_WAIT_UNTIL(list_head(requests) != NULL);
+    current = list_pop(requests);
+    current->status = CRYPTO_SERVICE_PENDING;
+    PROCESS_PT_SPAWN(&driver_pt, CRYPTO_SERVICE.run(&driver_pt, current));
+    if(current->status == CRYPTO_SERVICE_PENDING) {
+      current->status = CRYPTO_SERVICE_ERROR;
+    }
+    process_post(current->process, crypto_service_event, current);
+    current = NULL;
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+void
+crypto_service_submit(struct crypto_service_request *req)
+{
+  if(!process_is_running(&crypto_service_process)) {
+    crypto_service_event = process_alloc_event();
+    if(CRYPTO_SERVICE.init != NULL) {
+      CRYPTO_SERVICE.init();
+    }
+    process_start(&crypto_service_process, NULL);
+  }
+  req->process = PROCESS_CURRENT();
+  req->status = CRYPTO_SERVICE_PENDING;
+  list_add(requests, req);
+  process_poll(&crypto_service_process);
+}
+/*---------------------------------------------------------------------------*/
+int
+crypto_service_cancel(struct crypto_service_request *req)
+{
+  struct crypto_service_request *r;
+
+  for(r = list_head(requests); r != NULL; r = list_item_next(r)) {
+    if(r == req) {
+      list_remove(requests, req);
+      return 1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+crypto_service_sha256(struct crypto_service_request *req,
+                      const uint8_t *data, uint32_t len, uint8_t *hash)
+{
+  req->type = CRYPTO_SERVICE_SHA256;
+  req->u.sha256.data = data;
+  req->u.sha256.len = len;
+  req->u.sha256.hash = hash;
+  crypto_service_submit(req);
+}
+/*---------------------------------------------------------------------------*/
+void
+crypto_service_ecdsa_verify(struct crypto_service_request *req,
+                            const uint8_t *public_key, const uint8_t *hash,
+                            const uint8_t *signature)
+{
+  req->type = CRYPTO_SERVICE_ECDSA_VERIFY;
+  req->u.ecdsa_verify.public_key = public_key;
+  req->u.ecdsa_verify.hash = hash;
+  req->u.ecdsa_verify.signature = signature;
+  crypto_service_submit(req);
+}
+/*---------------------------------------------------------------------------*/
+void
+crypto_service_ecdh(struct crypto_service_request *req,
+                    const uint8_t *public_key, const uint8_t *secret,
+                    uint8_t *shared_secret)
+{
+  req->type = CRYPTO_SERVICE_ECDH;
+  req->u.ecdh.public_key = public_key;
+  req->u.ecdh.secret = secret;
+  req->u.ecdh.shared_secret = shared_secret;
+  crypto_service_submit(req);
+}
+/*---------------------------------------------------------------------------*/
+static struct sha_256_ctx sha_256;
+static struct p_256_ctx p_256;
+static uint32_t offset;
+/*---------------------------------------------------------------------------*/
+static uint8_t
+p_256_status(void)
+{
+  switch(p_256.result) {
+  case P_256_OK:
+    return CRYPTO_SERVICE_OK;
+  case P_256_INVALID_SIGNATURE:
+    return CRYPTO_SERVICE_INVALID_SIGNATURE;
+  case P_256_INVALID_KEY:
+    return CRYPTO_SERVICE_INVALID_KEY;
+  default:
+    return CRYPTO_SERVICE_ERROR;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static
+PT_THREAD(run(struct pt *pt, struct crypto_service_request *req))
+{
+  uint32_t len;
+
+  PT_BEGIN(pt);
+
+  if(req->type == CRYPTO_SERVICE_SHA256) {
+    sha_256_init(&sha_256);
+    offset = 0;
+    while(offset < req->u.sha256.len) {
+      len = MIN(req->u.sha256.len - offset, CRYPTO_SERVICE_SHA256_CHUNK);
+      sha_256_update(&sha_256, req->u.sha256.data + offset, len);
+      offset += len;
+      CRYPTO_SERVICE_YIELD(pt);
+    }
+    sha_256_final(&sha_256, req->u.sha256.hash);
+    req->status = CRYPTO_SERVICE_OK;
+  } else if(req->type == CRYPTO_SERVICE_ECDSA_VERIFY) {
+    PT_INIT(&p_256.pt);
+    while(PT_SCHEDULE(p_256_ecdsa_verify(&p_256,
+                                         req->u.ecdsa_verify.public_key,
+                                         req->u.ecdsa_verify.hash,
+                                         req->u.ecdsa_verify.signature))) {
+      CRYPTO_SERVICE_YIELD(pt);
+    }
+    req->status = p_256_status();
+  } else if(req->type == CRYPTO_SERVICE_ECDH) {
+    PT_INIT(&p_256.pt);
+    while(PT_SCHEDULE(p_256_ecdh(&p_256, req->u.ecdh.public_key,
+                                 req->u.ecdh.secret,
+                                 req->u.ecdh.shared_secret))) {
+      CRYPTO_SERVICE_YIELD(pt);
+    }
+    req->status = p_256_status();
+  } else {
+    req->status = CRYPTO_SERVICE_NOT_SUPPORTED;
+  }
+
+  PT_END(pt);
+}
+/*---------------------------------------------------------------------------*/
+const struct crypto_service_driver crypto_service_driver = {
+  NULL,
+  run
+};
+/*---------------------------------------------------------------------------*/
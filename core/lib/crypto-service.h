@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Crypto service: a queue of SHA-256, ECDSA verification and ECDH
+ *         requests, processed one at a time in the background by a crypto
+ *         driver. The default driver computes them in software, yielding
+ *         between steps, and platforms with a crypto engine set
+ *         CRYPTO_SERVICE_CONF to their own driver.
+ *
+ *         Keys, hashes and signatures are encoded as in lib/p-256.h. The
+ *         buffers of a request must stay valid until it completes. When it
+ *         does, its status is set and crypto_service_event is posted to its
+ *         process, with the request as data.
+ */
+
+#ifndef CRYPTO_SERVICE_H_
+#define CRYPTO_SERVICE_H_
+
+#include "contiki.h"
+#include "lib/p-256.h"
+#include "lib/sha-256.h"
+
+#ifdef CRYPTO_SERVICE_CONF
+#define CRYPTO_SERVICE CRYPTO_SERVICE_CONF
+#else /* CRYPTO_SERVICE_CONF */
+#define CRYPTO_SERVICE crypto_service_driver
+#endif /* CRYPTO_SERVICE_CONF */
+
+/* Bytes hashed by the software driver between two yields */
+#ifdef CRYPTO_SERVICE_CONF_SHA256_CHUNK
+#define CRYPTO_SERVICE_SHA256_CHUNK CRYPTO_SERVICE_CONF_SHA256_CHUNK
+#else /* CRYPTO_SERVICE_CONF_SHA256_CHUNK */
+#define CRYPTO_SERVICE_SHA256_CHUNK 256
+#endif /* CRYPTO_SERVICE_CONF_SHA256_CHUNK */
+
+/* Request types */
+#define CRYPTO_SERVICE_SHA256           0
+#define CRYPTO_SERVICE_ECDSA_VERIFY     1
+#define CRYPTO_SERVICE_ECDH             2
+
+/* Request statuses */
+#define CRYPTO_SERVICE_PENDING            0
+#define CRYPTO_SERVICE_OK                 1
+#define CRYPTO_SERVICE_INVALID_SIGNATURE  2
+#define CRYPTO_SERVICE_INVALID_KEY        3
+#define CRYPTO_SERVICE_NOT_SUPPORTED      4
+#define CRYPTO_SERVICE_ERROR              5
+
+struct crypto_service_request {
+  struct crypto_service_request *next;
+  struct process *process;
+  uint8_t type;
+  volatile uint8_t status;
+  union {
+    struct {
+      const uint8_t *data;
+      uint32_t len;
+      uint8_t *hash;
+    } sha256;
+    struct {
+      const uint8_t *public_key;
+      const uint8_t *hash;
+      const uint8_t *signature;
+    } ecdsa_verify;
+    struct {
+      const uint8_t *public_key;
+      const uint8_t *secret;
+      uint8_t *shared_secret;
+    } ecdh;
+  } u;
+};
+
+/**
+ * Structure of crypto drivers.
+ */
+struct crypto_service_driver {
+
+  /**
+   * \brief Initializes the crypto engine, before the first request.
+   */
+  void (* init)(void);
+
+  /**
+   * \brief Processes a request, setting its status before exiting.
+   *
+   *        The thread runs within the crypto service process. It yields
+   *        with CRYPTO_SERVICE_YIELD(), or waits for an event posted or a
+   *        poll requested by the driver.
+   */
+  PT_THREAD((* run)(struct pt *pt, struct crypto_service_request *req));
+};
+
+PROCESS_NAME(crypto_service_process);
+
+/* Lets the crypto service process run again after other processes */
+#define CRYPTO_SERVICE_YIELD(pt) do { \
+    process_poll(&crypto_service_process); \
+    PT_YIELD(pt); \
+  } while(0)
+
+extern const struct crypto_service_driver CRYPTO_SERVICE;
+
+/**
+ * The event posted to the process of a request when it completes.
+ */
+extern process_event_t crypto_service_event;
+
+/**
+ * \brief Queues a request, that has its type and arguments set, for the
+ *        current process.
+ */
+void crypto_service_submit(struct crypto_service_request *req);
+
+/**
+ * \brief Removes a request from the queue, unless it is being processed.
+ * \return Non-zero if the request was removed
+ */
+int crypto_service_cancel(struct crypto_service_request *req);
+
+/**
+ * \brief Queues the computation of the SHA-256 hash of len bytes of data
+ *        into hash, of SHA_256_DIGEST_LENGTH bytes.
+ */
+void crypto_service_sha256(struct crypto_service_request *req,
+                           const uint8_t *data, uint32_t len, uint8_t *hash);
+
+/**
+ * \brief Queues the verification of an ECDSA signature of a hash. The
+ *        status is CRYPTO_SERVICE_OK if it is valid.
+ */
+void crypto_service_ecdsa_verify(struct crypto_service_request *req,
+                                 const uint8_t *public_key,
+                                 const uint8_t *hash,
+                                 const uint8_t *signature);
+
+/**
+ * \brief Queues the computation of an ECDH shared secret, of P_256_LEN
+ *        bytes.
+ */
+void crypto_service_ecdh(struct crypto_service_request *req,
+                         const uint8_t *public_key, const uint8_t *secret,
+                         uint8_t *shared_secret);
+
+#endif /* CRYPTO_SERVICE_H_ */
@@ -36,6 +36,22 @@
  *           $Revision: 1.3 $
  */
 #include "lib/ifft.h"
+#include <string.h>
+
+/* Butterflies two at a time with the dual 16-bit instructions of the
+   Cortex-M4 and other cores with the ARM DSP extension. The results are
+   the same as those of the portable code */
+#ifdef IFFT_CONF_SIMD
+#define IFFT_SIMD IFFT_CONF_SIMD
+#elif defined(__ARM_FEATURE_SIMD32) && __ARM_FEATURE_SIMD32
+#define IFFT_SIMD 1
+#else
+#define IFFT_SIMD 0
+#endif
+
+#if IFFT_SIMD
+#include <arm_acle.h>
+#endif
 
 /*---------------------------------------------------------------------------*/
 /* constant table of sin values in 8/7 bits resolution */
@@ -97,6 +113,41 @@ static uint16_t ilog2(uint16_t val)
 }
 
 
+#if IFFT_SIMD
+/* Two butterflies with the same twiddle factor: (c, s) packed in cs, the
+   16-bit values of the pairs of samples read and written as words */
+static void
+butterfly2(int16_t *xre, int16_t *xim, int16_t *yre, int16_t *yim,
+           uint32_t cs)
+{
+  uint32_t re, im, a0, a1, t_re, t_im, u;
+  int32_t tr0, tr1, ti0, ti1;
+
+  memcpy(&re, yre, 4);
+  memcpy(&im, yim, 4);
+  /* (im, re) of each sample in the low and high halfwords */
+  a0 = (im & 0xffff) | (re << 16);
+  a1 = (im >> 16) | (re & 0xffff0000);
+  tr0 = __smuadx(a0, cs) >> RESOLUTION;
+  tr1 = __smuadx(a1, cs) >> RESOLUTION;
+  ti0 = __smusd(a0, cs) >> RESOLUTION;
+  ti1 = __smusd(a1, cs) >> RESOLUTION;
+  t_re = ((uint32_t)tr0 & 0xffff) | ((uint32_t)tr1 << 16);
+  t_im = ((uint32_t)ti0 & 0xffff) | ((uint32_t)ti1 << 16);
+
+  memcpy(&u, xre, 4);
+  re = __ssub16(u, t_re);
+  memcpy(yre, &re, 4);
+  re = __sadd16(u, t_re);
+  memcpy(xre, &re, 4);
+  memcpy(&u, xim, 4);
+  im = __ssub16(u, t_im);
+  memcpy(yim, &im, 4);
+  im = __sadd16(u, t_im);
+  memcpy(xim, &im, 4);
+}
+#endif /* IFFT_SIMD */
+
 /* ifft(xre[], n) - integer (fixpoint) version of Fast Fourier Transform
    An integer version of FFT that takes in-samples in an int16_t array
    and does an fft on n samples in the array.
@@ -118,6 +169,9 @@ ifft(int16_t xre[], int16_t xim[], uint16_t n)
   uint16_t nu1;
   int p, k, l, i;
   int32_t c, s, tr, ti;
+#if IFFT_SIMD
+  uint32_t cs;
+#endif /* IFFT_SIMD */
 
   nu = ilog2(n);
   nu1 = nu - 1;
@@ -127,20 +181,28 @@ ifft(int16_t xre[], int16_t xim[], uint16_t n)
     xim[i] = 0;
 
   for (l = 1; l <= nu; l++) {
-    for (k = 0; k < n; k += n2) {
-      for (i = 1; i <= n2; i++) {
-	p = bitrev(k >> nu1, nu);
-	c = cosI((1000 * p) / n);
-	s = sinI((1000 * p) / n);
-
-	tr = ((xre[k + n2] * c + xim[k + n2] * s) >> RESOLUTION);
-	ti = ((xim[k + n2] * c - xre[k + n2] * s) >> RESOLUTION);
-
-	xre[k + n2] = xre[k] - tr;
-	xim[k + n2] = xim[k] - ti;
-	xre[k] += tr;
-	xim[k] += ti;
-	k++;
+    for (k = 0; k < n; k += 2 * n2) {
+      /* All butterflies of a group share their twiddle factor */
+      p = bitrev(k >> nu1, nu);
+      c = cosI((1000 * p) / n);
+      s = sinI((1000 * p) / n);
+
+      i = 0;
+#if IFFT_SIMD
+      cs = ((uint32_t)c & 0xffff) | ((uint32_t)s << 16);
+      for (; i + 1 < n2; i += 2) {
+        butterfly2(&xre[k + i], &xim[k + i], &xre[k + n2 + i],
+                   &xim[k + n2 + i], cs);
+      }
+#endif /* IFFT_SIMD */
+      for (; i < n2; i++) {
+	tr = ((xre[k + n2 + i] * c + xim[k + n2 + i] * s) >> RESOLUTION);
+	ti = ((xim[k + n2 + i] * c - xre[k + n2 + i] * s) >> RESOLUTION);
+
+	xre[k + n2 + i] = xre[k + i] - tr;
+	xim[k + n2 + i] = xim[k + i] - ti;
+	xre[k + i] += tr;
+	xim[k + i] += ti;
       }
     }
     nu1--;
@@ -46,13 +46,26 @@
  */
 
 #include "lib/list.h"
+#include <stdint.h>
 
+#ifndef NULL
 #define NULL 0
+#endif /* NULL */
 
 struct list {
   struct list *next;
 };
 
+#if LIST_WITH_TAILQ
+/* A list declared with LIST_TAILQ() */
+#define IS_TAILQ(list) (((uintptr_t)(list) & 1) != 0)
+#else /* LIST_WITH_TAILQ */
+#define IS_TAILQ(list) 0
+#endif /* LIST_WITH_TAILQ */
+#define TAILQ(list) ((struct list_tailq *)((char *)(list) - 1))
+/* Where the first item of a list is kept */
+#define HEAD(list) (IS_TAILQ(list) ? &TAILQ(list)->head : (list))
+
 /*---------------------------------------------------------------------------*/
 /**
  * Initialize a list.
@@ -65,7 +78,11 @@ struct list {
 void
 list_init(list_t list)
 {
-  *list = NULL;
+  if(IS_TAILQ(list)) {
+    TAILQ(list)->tail = NULL;
+    TAILQ(list)->length = 0;
+  }
+  *HEAD(list) = NULL;
 }
 /*---------------------------------------------------------------------------*/
 /**
@@ -82,7 +99,7 @@ list_init(list_t list)
 void *
 list_head(list_t list)
 {
-  return *list;
+  return *HEAD(list);
 }
 /*---------------------------------------------------------------------------*/
 /**
@@ -100,7 +117,18 @@ list_head(list_t list)
 void
 list_copy(list_t dest, list_t src)
 {
-  *dest = *src;
+  struct list *l;
+
+  *HEAD(dest) = *HEAD(src);
+
+  if(IS_TAILQ(dest)) {
+    TAILQ(dest)->tail = NULL;
+    TAILQ(dest)->length = 0;
+    for(l = *HEAD(dest); l != NULL; l = l->next) {
+      TAILQ(dest)->tail = l;
+      TAILQ(dest)->length++;
+    }
+  }
 }
 /*---------------------------------------------------------------------------*/
 /**
@@ -118,7 +146,11 @@ void *
 list_tail(list_t list)
 {
   struct list *l;
-  
+
+  if(IS_TAILQ(list)) {
+    return TAILQ(list)->tail;
+  }
+
   if(*list == NULL) {
     return NULL;
   }
@@ -144,6 +176,26 @@ list_add(list_t list, void *item)
 {
   struct list *l;
 
+  if(IS_TAILQ(list)) {
+    if(item == TAILQ(list)->tail) {
+      return;
+    }
+    /* Only the tail of a list has no next item, so an item without one
+       is not on the list */
+    if(((struct list *)item)->next != NULL) {
+      list_remove(list, item);
+    }
+    ((struct list *)item)->next = NULL;
+    if(TAILQ(list)->tail == NULL) {
+      TAILQ(list)->head = item;
+    } else {
+      ((struct list *)TAILQ(list)->tail)->next = item;
+    }
+    TAILQ(list)->tail = item;
+    TAILQ(list)->length++;
+    return;
+  }
+
   /* Make sure not to add the same element twice */
   list_remove(list, item);
 
@@ -166,6 +218,22 @@ list_push(list_t list, void *item)
 {
   /*  struct list *l;*/
 
+  if(IS_TAILQ(list)) {
+    if(item == TAILQ(list)->head) {
+      return;
+    }
+    if(((struct list *)item)->next != NULL || item == TAILQ(list)->tail) {
+      list_remove(list, item);
+    }
+    ((struct list *)item)->next = TAILQ(list)->head;
+    TAILQ(list)->head = item;
+    if(TAILQ(list)->tail == NULL) {
+      TAILQ(list)->tail = item;
+    }
+    TAILQ(list)->length++;
+    return;
+  }
+
   /* Make sure not to add the same element twice */
   list_remove(list, item);
 
@@ -186,20 +254,29 @@ void *
 list_chop(list_t list)
 {
   struct list *l, *r;
+  void **head = HEAD(list);
   
-  if(*list == NULL) {
+  if(*head == NULL) {
     return NULL;
   }
-  if(((struct list *)*list)->next == NULL) {
-    l = *list;
-    *list = NULL;
+  if(((struct list *)*head)->next == NULL) {
+    l = *head;
+    *head = NULL;
+    if(IS_TAILQ(list)) {
+      TAILQ(list)->tail = NULL;
+      TAILQ(list)->length = 0;
+    }
     return l;
   }
   
-  for(l = *list; l->next->next != NULL; l = l->next);
+  for(l = *head; l->next->next != NULL; l = l->next);
 
   r = l->next;
   l->next = NULL;
+  if(IS_TAILQ(list)) {
+    TAILQ(list)->tail = l;
+    TAILQ(list)->length--;
+  }
   
   return r;
 }
@@ -218,9 +295,18 @@ void *
 list_pop(list_t list)
 {
   struct list *l;
-  l = *list;
-  if(*list != NULL) {
-    *list = ((struct list *)*list)->next;
+  void **head = HEAD(list);
+  l = *head;
+  if(*head != NULL) {
+    *head = ((struct list *)*head)->next;
+    if(IS_TAILQ(list)) {
+      if(*head == NULL) {
+        TAILQ(list)->tail = NULL;
+      }
+      TAILQ(list)->length--;
+      /* Keeps list_add() and list_push() of the item constant time */
+      l->next = NULL;
+    }
   }
 
   return l;
@@ -240,22 +326,29 @@ void
 list_remove(list_t list, void *item)
 {
   struct list *l, *r;
+  void **head = HEAD(list);
   
-  if(*list == NULL) {
+  if(*head == NULL) {
     return;
   }
   
   r = NULL;
-  for(l = *list; l != NULL; l = l->next) {
+  for(l = *head; l != NULL; l = l->next) {
     if(l == item) {
       if(r == NULL) {
 	/* First on list */
-	*list = l->next;
+	*head = l->next;
       } else {
 	/* Not first on list */
 	r->next = l->next;
       }
       l->next = NULL;
+      if(IS_TAILQ(list)) {
+        if(TAILQ(list)->tail == l) {
+          TAILQ(list)->tail = r;
+        }
+        TAILQ(list)->length--;
+      }
       return;
     }
     r = l;
@@ -277,6 +370,10 @@ list_length(list_t list)
   struct list *l;
   int n = 0;
 
+  if(IS_TAILQ(list)) {
+    return TAILQ(list)->length;
+  }
+
   for(l = *list; l != NULL; l = l->next) {
     ++n;
   }
@@ -308,6 +405,12 @@ list_insert(list_t list, void *previtem, void *newitem)
   
     ((struct list *)newitem)->next = ((struct list *)previtem)->next;
     ((struct list *)previtem)->next = newitem;
+    if(IS_TAILQ(list)) {
+      if(previtem == TAILQ(list)->tail) {
+        TAILQ(list)->tail = newitem;
+      }
+      TAILQ(list)->length++;
+    }
   }
 }
 /*---------------------------------------------------------------------------*/
@@ -60,15 +60,31 @@
  * list with list_remove(). The head and tail of a list can be
  * extracted using list_head() and list_tail(), respectively.
  *
+ * Lists used as queues can be declared with LIST_TAILQ() instead, to
+ * find their tail and length without going through them.
+ *
  * @{
  */
 
 #ifndef LIST_H_
 #define LIST_H_
 
+#include "sys/cc.h"
+
 #define LIST_CONCAT2(s1, s2) s1##s2
 #define LIST_CONCAT(s1, s2) LIST_CONCAT2(s1, s2)
 
+/* Lists declared with LIST_TAILQ() keep their last item and their
+ * length, which needs aligned list heads. Without it, they are plain
+ * lists. */
+#ifdef LIST_CONF_WITH_TAILQ
+#define LIST_WITH_TAILQ LIST_CONF_WITH_TAILQ
+#elif defined(CC_ALIGN)
+#define LIST_WITH_TAILQ 1
+#else
+#define LIST_WITH_TAILQ 0
+#endif
+
 /**
  * Declare a linked list.
  *
@@ -132,6 +148,71 @@
  */
 typedef void ** list_t;
 
+/*
+ * The head of a list declared with LIST_TAILQ(). Its list_t points one
+ * byte past it, which tells the list functions to keep tail and length
+ * up to date.
+ */
+struct list_tailq {
+  void *head;
+  void *tail;
+  unsigned short length;
+}
+#if LIST_WITH_TAILQ
+CC_ALIGN(2)
+#endif /* LIST_WITH_TAILQ */
+;
+
+#if LIST_WITH_TAILQ
+#define LIST_TAILQ_REF(tailq) ((list_t)((char *)(tailq) + 1))
+
+/**
+ * Declare a linked list that keeps its last item and its length.
+ *
+ * This macro declares a list like LIST() does, to be used with the
+ * same functions. list_add(), list_tail() and list_length() then take
+ * constant time instead of going through the list, which suits lists
+ * used as queues. It takes two pointers and a short more than a list
+ * declared with LIST().
+ *
+ * \param name The name of the list.
+ */
+#define LIST_TAILQ(name) \
+         static struct list_tailq LIST_CONCAT(name,_list) = { NULL, NULL, 0 }; \
+         static list_t name = LIST_TAILQ_REF(&LIST_CONCAT(name,_list))
+
+/**
+ * Declare a linked list that keeps its last item and its length
+ * inside a structure declaraction.
+ *
+ * The list is initialized with the LIST_TAILQ_STRUCT_INIT() macro.
+ *
+ * \param name The name of the list.
+ * \sa LIST_TAILQ(), LIST_STRUCT()
+ */
+#define LIST_TAILQ_STRUCT(name) \
+         struct list_tailq LIST_CONCAT(name,_list); \
+         list_t name
+
+/**
+ * Initialize a linked list declared with LIST_TAILQ_STRUCT().
+ *
+ * \param struct_ptr A pointer to the struct
+ * \param name The name of the list.
+ */
+#define LIST_TAILQ_STRUCT_INIT(struct_ptr, name)                        \
+    do {                                                                \
+       (struct_ptr)->name =                                             \
+         LIST_TAILQ_REF(&((struct_ptr)->LIST_CONCAT(name,_list)));      \
+       list_init((struct_ptr)->name);                                   \
+    } while(0)
+#else /* LIST_WITH_TAILQ */
+#define LIST_TAILQ(name) LIST(name)
+#define LIST_TAILQ_STRUCT(name) LIST_STRUCT(name)
+#define LIST_TAILQ_STRUCT_INIT(struct_ptr, name) \
+    LIST_STRUCT_INIT(struct_ptr, name)
+#endif /* LIST_WITH_TAILQ */
+
 void   list_init(list_t list);
 void * list_head(list_t list);
 void * list_tail(list_t list);
@@ -47,57 +47,194 @@
 #include "contiki.h"
 #include "lib/memb.h"
 
+#if MEMB_STATS
+static struct memb *pools;
+#endif /* MEMB_STATS */
+
+#define BITMAP_WORDS(m) (((m)->num + 31) / 32)
+
+#ifdef __GNUC__
+#define CTZ(x)      __builtin_ctzl(x)
+#define POPCOUNT(x) __builtin_popcountl(x)
+#else /* __GNUC__ */
+static int
+CTZ(uint32_t x)
+{
+  int n;
+  for(n = 0; (x & 1) == 0; n++, x >>= 1);
+  return n;
+}
+static int
+POPCOUNT(uint32_t x)
+{
+  int n;
+  for(n = 0; x != 0; x &= x - 1, n++);
+  return n;
+}
+#endif /* __GNUC__ */
+
 /*---------------------------------------------------------------------------*/
-void
-memb_init(struct memb *m)
+/* Index of the chunk "ptr" points to, or -1 */
+static int
+chunk_index(struct memb *m, void *ptr)
 {
-  memset(m->count, 0, m->num);
-  memset(m->mem, 0, m->size * m->num);
+  unsigned long offset;
+
+  if(!memb_inmemb(m, ptr)) {
+    return -1;
+  }
+  offset = (char *)ptr - (char *)m->mem;
+  if(offset % m->size != 0) {
+    return -1;
+  }
+  return offset / m->size;
 }
 /*---------------------------------------------------------------------------*/
-void *
-memb_alloc(struct memb *m)
+/* Index of a free chunk, now marked as used, or -1 */
+static int
+take_chunk(struct memb *m)
 {
   int i;
 
+  if(m->bitmap != NULL) {
+    for(i = 0; i < BITMAP_WORDS(m); i++) {
+      if(m->bitmap[i] != 0xffffffff) {
+        int bit = CTZ(~m->bitmap[i]);
+        if(i * 32 + bit >= m->num) {
+          /* The padding at the end of the bitmap */
+          return -1;
+        }
+        m->bitmap[i] |= (uint32_t)1 << bit;
+        return i * 32 + bit;
+      }
+    }
+    return -1;
+  }
+
   for(i = 0; i < m->num; ++i) {
     if(m->count[i] == 0) {
       /* If this block was unused, we increase the reference count to
-	 indicate that it now is used and return a pointer to the
-	 memory block. */
+	 indicate that it now is used. */
       ++(m->count[i]);
-      return (void *)((char *)m->mem + (i * m->size));
+      return i;
+    }
+  }
+  return -1;
+}
+#if MEMB_STATS
+/*---------------------------------------------------------------------------*/
+static int
+is_used(struct memb *m, int i)
+{
+  if(m->bitmap != NULL) {
+    return (m->bitmap[i / 32] >> (i % 32)) & 1;
+  }
+  return m->count[i] != 0;
+}
+#endif /* MEMB_STATS */
+/*---------------------------------------------------------------------------*/
+void
+memb_init(struct memb *m)
+{
+#if MEMB_STATS
+  struct memb *p;
+
+  for(p = pools; p != NULL && p != m; p = p->next);
+  if(p == NULL) {
+    m->next = pools;
+    pools = m;
+  }
+  m->used = m->peak = m->failures = 0;
+#endif /* MEMB_STATS */
+  if(m->bitmap != NULL) {
+    memset(m->bitmap, 0, BITMAP_WORDS(m) * sizeof(uint32_t));
+  } else {
+    memset(m->count, 0, m->num);
+  }
+  memset(m->mem, 0, m->size * m->num);
+}
+/*---------------------------------------------------------------------------*/
+#if MEMB_TRACK_SITES
+void *
+memb_alloc_site(struct memb *m, const char *site)
+#else /* MEMB_TRACK_SITES */
+void *
+memb_alloc(struct memb *m)
+#endif /* MEMB_TRACK_SITES */
+{
+  int i = take_chunk(m);
+
+  if(i >= 0) {
+#if MEMB_STATS
+    if(++m->used > m->peak) {
+      m->peak = m->used;
     }
+#if MEMB_TRACK_SITES
+    m->sites[i] = site;
+#endif /* MEMB_TRACK_SITES */
+#endif /* MEMB_STATS */
+    return (void *)((char *)m->mem + (i * m->size));
   }
 
+#if MEMB_STATS
+  if(m->failures < 0xffff) {
+    m->failures++;
+  }
+#endif /* MEMB_STATS */
+
   /* No free block was found, so we return NULL to indicate failure to
      allocate block. */
   return NULL;
 }
+#if MEMB_TRACK_SITES
+/*---------------------------------------------------------------------------*/
+void *
+(memb_alloc)(struct memb *m)
+{
+  return memb_alloc_site(m, NULL);
+}
+/*---------------------------------------------------------------------------*/
+const char *
+memb_site(struct memb *m, int index)
+{
+  if(index < 0 || index >= m->num || !is_used(m, index)) {
+    return NULL;
+  }
+  return m->sites[index];
+}
+#endif /* MEMB_TRACK_SITES */
 /*---------------------------------------------------------------------------*/
 char
 memb_free(struct memb *m, void *ptr)
 {
-  int i;
-  char *ptr2;
+  /* Find the block to which the pointer "ptr" points to. */
+  int i = chunk_index(m, ptr);
 
-  /* Walk through the list of blocks and try to find the block to
-     which the pointer "ptr" points to. */
-  ptr2 = (char *)m->mem;
-  for(i = 0; i < m->num; ++i) {
-    
-    if(ptr2 == (char *)ptr) {
-      /* We've found to block to which "ptr" points so we decrease the
-	 reference count and return the new value of it. */
-      if(m->count[i] > 0) {
-	/* Make sure that we don't deallocate free memory. */
-	--(m->count[i]);
-      }
-      return m->count[i];
+  if(i < 0) {
+    return -1;
+  }
+
+  if(m->bitmap != NULL) {
+#if MEMB_STATS
+    if(is_used(m, i)) {
+      m->used--;
     }
-    ptr2 += m->size;
+#endif /* MEMB_STATS */
+    m->bitmap[i / 32] &= ~((uint32_t)1 << (i % 32));
+    return 0;
   }
-  return -1;
+
+  /* We decrease the reference count and return the new value of it. */
+  if(m->count[i] > 0) {
+    /* Make sure that we don't deallocate free memory. */
+    --(m->count[i]);
+#if MEMB_STATS
+    if(m->count[i] == 0) {
+      m->used--;
+    }
+#endif /* MEMB_STATS */
+  }
+  return m->count[i];
 }
 /*---------------------------------------------------------------------------*/
 int
@@ -113,6 +250,14 @@ memb_numfree(struct memb *m)
   int i;
   int num_free = 0;
 
+  if(m->bitmap != NULL) {
+    num_free = m->num;
+    for(i = 0; i < BITMAP_WORDS(m); i++) {
+      num_free -= POPCOUNT(m->bitmap[i]);
+    }
+    return num_free;
+  }
+
   for(i = 0; i < m->num; ++i) {
     if(m->count[i] == 0) {
       ++num_free;
@@ -121,4 +266,12 @@ memb_numfree(struct memb *m)
 
   return num_free;
 }
+#if MEMB_STATS
+/*---------------------------------------------------------------------------*/
+struct memb *
+memb_pool_list(void)
+{
+  return pools;
+}
+#endif /* MEMB_STATS */
 /** @} */
@@ -64,6 +64,23 @@
 #define MEMB_H_
 
 #include "sys/cc.h"
+#include "contiki-conf.h"
+
+/* Keep usage statistics for each memory block, and a list of all the
+ * memory blocks that have been initialized (see memb_pool_list()) */
+#ifdef MEMB_CONF_STATS
+#define MEMB_STATS MEMB_CONF_STATS
+#else
+#define MEMB_STATS 0
+#endif
+
+/* Also remember where each allocated chunk was allocated from, as
+ * "file:line". Costs a pointer per chunk */
+#if MEMB_STATS && defined(MEMB_CONF_TRACK_SITES)
+#define MEMB_TRACK_SITES MEMB_CONF_TRACK_SITES
+#else
+#define MEMB_TRACK_SITES 0
+#endif
 
 /**
  * Declare a memory block.
@@ -89,15 +106,71 @@ MEMB(connections, struct connection, 16);
 #define MEMB(name, structure, num) \
         static char CC_CONCAT(name,_memb_count)[num]; \
         static structure CC_CONCAT(name,_memb_mem)[num]; \
+        MEMB_SITES_DECL(name, num) \
         static struct memb name = {sizeof(structure), num, \
                                           CC_CONCAT(name,_memb_count), \
-                                          (void *)CC_CONCAT(name,_memb_mem)}
+                                          (void *)CC_CONCAT(name,_memb_mem), \
+                                          NULL MEMB_STATS_INIT(name)}
+
+/**
+ * Declare a memory block that keeps track of its free chunks with a
+ * bitmap.
+ *
+ * This macro works like MEMB(), and the memory block is used with the
+ * same functions. It uses one bit per chunk instead of a byte, and
+ * finds free chunks a word at a time, which suits large pools.
+ *
+ * \param name The name of the memory block.
+ *
+ * \param structure The name of the struct that the memory block holds
+ *
+ * \param num The total number of memory chunks in the block.
+ *
+ */
+#define MEMB_BITMAP(name, structure, num) \
+        static uint32_t CC_CONCAT(name,_memb_bitmap)[((num) + 31) / 32]; \
+        static structure CC_CONCAT(name,_memb_mem)[num]; \
+        MEMB_SITES_DECL(name, num) \
+        static struct memb name = {sizeof(structure), num, NULL, \
+                                          (void *)CC_CONCAT(name,_memb_mem), \
+                                          CC_CONCAT(name,_memb_bitmap) \
+                                          MEMB_STATS_INIT(name)}
+
+#define MEMB_STR2(s) #s
+#define MEMB_STR(s) MEMB_STR2(s)
+
+#if MEMB_TRACK_SITES
+#define MEMB_SITES_DECL(name, num) \
+        static const char *CC_CONCAT(name,_memb_sites)[num];
+#define MEMB_STATS_INIT(name) , MEMB_STR(name), NULL, 0, 0, 0, \
+                              CC_CONCAT(name,_memb_sites)
+#elif MEMB_STATS
+#define MEMB_SITES_DECL(name, num)
+#define MEMB_STATS_INIT(name) , MEMB_STR(name)
+#else /* MEMB_STATS */
+#define MEMB_SITES_DECL(name, num)
+#define MEMB_STATS_INIT(name)
+#endif /* MEMB_STATS */
 
 struct memb {
   unsigned short size;
   unsigned short num;
+  /* Reference count of each chunk, or NULL if the block uses bitmap */
   char *count;
   void *mem;
+  /* Allocated chunks, one bit each (see MEMB_BITMAP()) */
+  uint32_t *bitmap;
+#if MEMB_STATS
+  const char *name;
+  struct memb *next;
+  /* Chunks currently allocated, the most ever allocated at once, and
+     allocations that failed for lack of a free chunk */
+  unsigned short used, peak, failures;
+#if MEMB_TRACK_SITES
+  /* Where each allocated chunk was allocated from */
+  const char **sites;
+#endif /* MEMB_TRACK_SITES */
+#endif /* MEMB_STATS */
 };
 
 /**
@@ -132,6 +205,28 @@ int memb_inmemb(struct memb *m, void *ptr);
 
 int  memb_numfree(struct memb *m);
 
+#if MEMB_STATS
+/**
+ * Get the memory blocks that have been initialized with memb_init().
+ *
+ * \return The first memory block, the next one being its next field.
+ */
+struct memb *memb_pool_list(void);
+#endif /* MEMB_STATS */
+
+#if MEMB_TRACK_SITES
+void *memb_alloc_site(struct memb *m, const char *site);
+/* Record the caller of every memb_alloc() */
+#define memb_alloc(m) memb_alloc_site(m, __FILE__ ":" MEMB_STR(__LINE__))
+
+/**
+ * Get where a chunk was allocated from.
+ *
+ * \return The "file:line" of the memb_alloc() call, or NULL
+ */
+const char *memb_site(struct memb *m, int index);
+#endif /* MEMB_TRACK_SITES */
+
 /** @} */
 /** @} */
 
@@ -0,0 +1,313 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \addtogroup mmem
+ * @{
+ */
+
+/**
+ * \file
+ *         Managed memory allocator with segregated free lists. Blocks
+ *         carry a header with their size and the size of the block
+ *         physically before them, so that a freed block is merged with
+ *         its free neighbors in constant time. Free blocks are kept in
+ *         one list per power-of-two size class, and a bitmap tells
+ *         which lists are not empty.
+ */
+
+#include "mmem.h"
+#include "contiki-conf.h"
+#include <stdint.h>
+#include <string.h>
+
+#if MMEM_SIZE_CLASSES
+
+#if MMEM_SIZE > 0xfff0
+#error "MMEM_CONF_SIZE_CLASSES supports heaps up to 64 kB"
+#endif
+
+/* Block sizes are multiples of ALIGN, which leaves the lowest bit of
+   the size free for the free flag */
+#define ALIGN             4
+#define HEAP_SIZE         (MMEM_SIZE & ~(ALIGN - 1))
+
+struct block {
+  /* Size of the block, header included, and FREE if it is free */
+  uint16_t size;
+  /* Size of the block physically before, 0 for the first one */
+  uint16_t prev_size;
+};
+
+/* Free blocks link to each other with heap offsets in their payload */
+struct free_block {
+  struct block hdr;
+  uint16_t next;
+  uint16_t prev;
+};
+
+#define FREE              1
+#define NONE              0xffff
+#define HDR_SIZE          sizeof(struct block)
+#define MIN_BLOCK         sizeof(struct free_block)
+/* Size class c holds free blocks of 2^(c + MIN_CLASS_SHIFT) bytes or
+   more */
+#define MIN_CLASS_SHIFT   3
+#define NUM_CLASSES       (16 - MIN_CLASS_SHIFT)
+
+static uint32_t memory[HEAP_SIZE / sizeof(uint32_t)];
+static uint16_t free_lists[NUM_CLASSES];
+static uint16_t nonempty;
+
+#define HEAP              ((uint8_t *)memory)
+#define BLOCK(offset)     ((struct free_block *)(HEAP + (offset)))
+#define OFFSET(b)         ((uint16_t)((uint8_t *)(b) - HEAP))
+#define SIZE(b)           ((b)->hdr.size & ~FREE)
+
+static unsigned int used;
+#if MMEM_STATS
+static unsigned int peak_used;
+static unsigned int failures;
+#endif /* MMEM_STATS */
+
+/*---------------------------------------------------------------------------*/
+static int
+size_class(uint16_t size)
+{
+  int c;
+
+  for(c = 0; c < NUM_CLASSES - 1 && (size >> (c + MIN_CLASS_SHIFT + 1)) != 0; c++);
+  return c;
+}
+/*---------------------------------------------------------------------------*/
+static void
+insert_free(struct free_block *b)
+{
+  int c = size_class(SIZE(b));
+
+  b->hdr.size |= FREE;
+  b->prev = NONE;
+  b->next = free_lists[c];
+  if(b->next != NONE) {
+    BLOCK(b->next)->prev = OFFSET(b);
+  }
+  free_lists[c] = OFFSET(b);
+  nonempty |= 1 << c;
+}
+/*---------------------------------------------------------------------------*/
+static void
+remove_free(struct free_block *b)
+{
+  int c = size_class(SIZE(b));
+
+  if(b->prev != NONE) {
+    BLOCK(b->prev)->next = b->next;
+  } else {
+    free_lists[c] = b->next;
+    if(b->next == NONE) {
+      nonempty &= ~(1 << c);
+    }
+  }
+  if(b->next != NONE) {
+    BLOCK(b->next)->prev = b->prev;
+  }
+  b->hdr.size &= ~FREE;
+}
+/*---------------------------------------------------------------------------*/
+static struct free_block *
+next_block(struct free_block *b)
+{
+  uint16_t offset = OFFSET(b) + SIZE(b);
+
+  return offset < HEAP_SIZE ? BLOCK(offset) : NULL;
+}
+/*---------------------------------------------------------------------------*/
+static struct free_block *
+find_free(uint16_t size)
+{
+  int c = size_class(size);
+  uint16_t offset;
+  uint16_t mask;
+
+  /* Blocks of the same class may be too small, look for one that fits */
+  for(offset = free_lists[c]; offset != NONE; offset = BLOCK(offset)->next) {
+    if(SIZE(BLOCK(offset)) >= size) {
+      return BLOCK(offset);
+    }
+  }
+  /* Any block of a larger class fits, take the first one */
+  mask = nonempty & ~((2 << c) - 1);
+  for(c++; mask != 0 && c < NUM_CLASSES; c++) {
+    if(mask & (1 << c)) {
+      return BLOCK(free_lists[c]);
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+int
+mmem_alloc(struct mmem *m, unsigned int size)
+{
+  struct free_block *b;
+  struct free_block *rest;
+  struct free_block *next;
+  uint16_t block_size;
+
+  if(size > HEAP_SIZE - HDR_SIZE) {
+    b = NULL;
+  } else {
+    block_size = (size + HDR_SIZE + ALIGN - 1) & ~(ALIGN - 1);
+    if(block_size < MIN_BLOCK) {
+      block_size = MIN_BLOCK;
+    }
+    b = find_free(block_size);
+  }
+  if(b == NULL) {
+#if MMEM_STATS
+    failures++;
+#endif /* MMEM_STATS */
+    return 0;
+  }
+
+  remove_free(b);
+  if(SIZE(b) - block_size >= MIN_BLOCK) {
+    /* Split, and give the remainder back */
+    rest = (struct free_block *)((uint8_t *)b + block_size);
+    rest->hdr.size = SIZE(b) - block_size;
+    rest->hdr.prev_size = block_size;
+    next = next_block(rest);
+    if(next != NULL) {
+      next->hdr.prev_size = rest->hdr.size;
+    }
+    b->hdr.size = block_size;
+    insert_free(rest);
+  }
+
+  used += SIZE(b);
+#if MMEM_STATS
+  if(used > peak_used) {
+    peak_used = used;
+  }
+#endif /* MMEM_STATS */
+
+  m->next = NULL;
+  m->size = size;
+  m->ptr = (uint8_t *)b + HDR_SIZE;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+mmem_free(struct mmem *m)
+{
+  struct free_block *b = (struct free_block *)((uint8_t *)m->ptr - HDR_SIZE);
+  struct free_block *neighbor;
+
+  used -= SIZE(b);
+
+  /* Merge with the next block if it is free */
+  neighbor = next_block(b);
+  if(neighbor != NULL && (neighbor->hdr.size & FREE)) {
+    remove_free(neighbor);
+    b->hdr.size += neighbor->hdr.size;
+  }
+  /* Merge with the previous block if it is free */
+  if(b->hdr.prev_size != 0) {
+    neighbor = (struct free_block *)((uint8_t *)b - b->hdr.prev_size);
+    if(neighbor->hdr.size & FREE) {
+      remove_free(neighbor);
+      neighbor->hdr.size += b->hdr.size;
+      b = neighbor;
+    }
+  }
+  neighbor = next_block(b);
+  if(neighbor != NULL) {
+    neighbor->hdr.prev_size = SIZE(b);
+  }
+  insert_free(b);
+
+  m->ptr = NULL;
+}
+/*---------------------------------------------------------------------------*/
+void
+mmem_init(void)
+{
+  static int inited = 0;
+  struct free_block *b;
+  int c;
+
+  if(inited) {
+    return;
+  }
+  for(c = 0; c < NUM_CLASSES; c++) {
+    free_lists[c] = NONE;
+  }
+  nonempty = 0;
+  used = 0;
+
+  /* The whole heap is one free block */
+  b = BLOCK(0);
+  b->hdr.size = HEAP_SIZE;
+  b->hdr.prev_size = 0;
+  insert_free(b);
+  inited = 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+mmem_get_stats(struct mmem_stats *stats)
+{
+  uint16_t offset;
+  int c;
+
+  stats->size = HEAP_SIZE;
+  stats->used = used;
+#if MMEM_STATS
+  stats->peak = peak_used;
+  stats->failures = failures;
+#else /* MMEM_STATS */
+  stats->peak = 0;
+  stats->failures = 0;
+#endif /* MMEM_STATS */
+
+  stats->largest_free = 0;
+  for(c = NUM_CLASSES - 1; c >= 0 && stats->largest_free == 0; c--) {
+    for(offset = free_lists[c]; offset != NONE; offset = BLOCK(offset)->next) {
+      if(SIZE(BLOCK(offset)) - HDR_SIZE > stats->largest_free) {
+        stats->largest_free = SIZE(BLOCK(offset)) - HDR_SIZE;
+      }
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+#endif /* MMEM_SIZE_CLASSES */
+
+/** @} */
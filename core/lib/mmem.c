@@ -49,15 +49,15 @@
 #include "contiki-conf.h"
 #include <string.h>
 
-#ifdef MMEM_CONF_SIZE
-#define MMEM_SIZE MMEM_CONF_SIZE
-#else
-#define MMEM_SIZE 4096
-#endif
+#if !MMEM_SIZE_CLASSES
 
 LIST(mmemlist);
 unsigned int avail_memory;
 static char memory[MMEM_SIZE];
+#if MMEM_STATS
+static unsigned int peak_used;
+static unsigned int failures;
+#endif /* MMEM_STATS */
 
 /*---------------------------------------------------------------------------*/
 /**
@@ -84,6 +84,9 @@ mmem_alloc(struct mmem *m, unsigned int size)
 {
   /* Check if we have enough memory left for this allocation. */
   if(avail_memory < size) {
+#if MMEM_STATS
+    failures++;
+#endif /* MMEM_STATS */
     return 0;
   }
 
@@ -100,6 +103,11 @@ mmem_alloc(struct mmem *m, unsigned int size)
 
   /* Decrease the amount of available memory. */
   avail_memory -= size;
+#if MMEM_STATS
+  if(MMEM_SIZE - avail_memory > peak_used) {
+    peak_used = MMEM_SIZE - avail_memory;
+  }
+#endif /* MMEM_STATS */
 
   /* Return non-zero to indicate that we were able to allocate
      memory. */
@@ -160,5 +168,29 @@ mmem_init(void)
   inited = 1;
 }
 /*---------------------------------------------------------------------------*/
+/**
+ * \brief      Get the usage of the managed memory
+ * \param stats Filled with the usage statistics
+ *
+ *             The peak use and the number of failed allocations are
+ *             only maintained when MMEM_CONF_STATS is set, and are
+ *             reported as zero otherwise.
+ */
+void
+mmem_get_stats(struct mmem_stats *stats)
+{
+  stats->size = MMEM_SIZE;
+  stats->used = MMEM_SIZE - avail_memory;
+  stats->largest_free = avail_memory;
+#if MMEM_STATS
+  stats->peak = peak_used;
+  stats->failures = failures;
+#else /* MMEM_STATS */
+  stats->peak = 0;
+  stats->failures = 0;
+#endif /* MMEM_STATS */
+}
+/*---------------------------------------------------------------------------*/
+#endif /* !MMEM_SIZE_CLASSES */
 
 /** @} */
@@ -44,6 +44,12 @@
  * stays in place. Therefore, a level of indirection is used: access
  * to allocated memory must always be done using a special macro.
  *
+ * With MMEM_CONF_SIZE_CLASSES, a different implementation is used,
+ * that does not move memory around: free blocks are kept in lists by
+ * size class and merged with their free neighbors, so that freeing is
+ * not proportional to the heap size. Allocated memory then stays in
+ * place, which is still accessed with MMEM_PTR().
+ *
  * \note This module has not been heavily tested.
  * @{
  */
@@ -59,6 +65,29 @@
 #ifndef MMEM_H_
 #define MMEM_H_
 
+#include "contiki-conf.h"
+
+#ifdef MMEM_CONF_SIZE
+#define MMEM_SIZE MMEM_CONF_SIZE
+#else
+#define MMEM_SIZE 4096
+#endif
+
+/* Use the size-class allocator (mmem-sc.c) instead of the compacting
+   one (mmem.c) */
+/* Track the peak use and the allocation failures */
+#ifdef MMEM_CONF_STATS
+#define MMEM_STATS MMEM_CONF_STATS
+#else
+#define MMEM_STATS 0
+#endif
+
+#ifdef MMEM_CONF_SIZE_CLASSES
+#define MMEM_SIZE_CLASSES MMEM_CONF_SIZE_CLASSES
+#else
+#define MMEM_SIZE_CLASSES 0
+#endif
+
 /*---------------------------------------------------------------------------*/
 /**
  * \brief      Get a pointer to the managed memory
@@ -83,9 +112,21 @@ struct mmem {
 /* XXX: tagga minne med "interrupt usage", vilke gr att man r
    speciellt varsam under free(). */
 
+/* Usage of the managed memory, in bytes. The peak and the allocation
+   failures are only tracked with MMEM_CONF_STATS */
+struct mmem_stats {
+  unsigned int size;
+  unsigned int used;
+  unsigned int peak;
+  unsigned int failures;
+  /* Largest allocation that would currently succeed */
+  unsigned int largest_free;
+};
+
 int  mmem_alloc(struct mmem *m, unsigned int size);
 void mmem_free(struct mmem *);
 void mmem_init(void);
+void mmem_get_stats(struct mmem_stats *stats);
 
 #endif /* MMEM_H_ */
 
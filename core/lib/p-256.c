@@ -0,0 +1,565 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Software NIST P-256 elliptic curve operations, with 32-bit limbs
+ *         and Montgomery multiplication.
+ */
+
+#include "lib/p-256.h"
+#include <string.h>
+
+#define LIMBS 8
+
+struct modulus {
+  uint32_t m[LIMBS];
+  uint32_t r2[LIMBS];     /* 2^512 mod m */
+  uint32_t inv;           /* -m^-1 mod 2^32 */
+};
+
+/* The field prime */
+static const struct modulus p = {
+  { 0xffffffff, 0xffffffff, 0xffffffff, 0x00000000,
+    0x00000000, 0x00000000, 0x00000001, 0xffffffff },
+  { 0x00000003, 0x00000000, 0xffffffff, 0xfffffffb,
+    0xfffffffe, 0xffffffff, 0xfffffffd, 0x00000004 },
+  0x00000001
+};
+
+/* The order of the base point */
+static const struct modulus n = {
+  { 0xfc632551, 0xf3b9cac2, 0xa7179e84, 0xbce6faad,
+    0xffffffff, 0xffffffff, 0x00000000, 0xffffffff },
+  { 0xbe79eea2, 0x83244c95, 0x49bd6fa6, 0x4699799c,
+    0x2b6bec59, 0x2845b239, 0xf3d95620, 0x66e12d94 },
+  0xee00bc4f
+};
+
+static const uint32_t curve_b[LIMBS] = {
+  0x27d2604b, 0x3bce3c3e, 0xcc53b0f6, 0x651d06b0,
+  0x769886bc, 0xb3ebbd55, 0xaa3a93e7, 0x5ac635d8
+};
+
+static const uint32_t base_x[LIMBS] = {
+  0xd898c296, 0xf4a13945, 0x2deb33a0, 0x77037d81,
+  0x63a440f2, 0xf8bce6e5, 0xe12c4247, 0x6b17d1f2
+};
+
+static const uint32_t base_y[LIMBS] = {
+  0x37bf51f5, 0xcbb64068, 0x6b315ece, 0x2bce3357,
+  0x7c0f9e16, 0x8ee7eb4a, 0xfe1a7f9b, 0x4fe342e2
+};
+
+static const uint32_t one[LIMBS] = { 1 };
+/*---------------------------------------------------------------------------*/
+static void
+load(uint32_t *r, const uint8_t *bytes)
+{
+  int i;
+
+  for(i = 0; i < LIMBS; i++) {
+    const uint8_t *b = bytes + 4 * (LIMBS - 1 - i);
+    r[i] = ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) |
+      ((uint32_t)b[2] << 8) | b[3];
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+store(uint8_t *bytes, const uint32_t *a)
+{
+  int i;
+
+  for(i = 0; i < LIMBS; i++) {
+    uint8_t *b = bytes + 4 * (LIMBS - 1 - i);
+    b[0] = a[i] >> 24;
+    b[1] = a[i] >> 16;
+    b[2] = a[i] >> 8;
+    b[3] = a[i];
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+cmp(const uint32_t *a, const uint32_t *b)
+{
+  int i;
+
+  for(i = LIMBS - 1; i >= 0; i--) {
+    if(a[i] != b[i]) {
+      return a[i] > b[i] ? 1 : -1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+is_zero(const uint32_t *a)
+{
+  uint32_t bits = 0;
+  int i;
+
+  for(i = 0; i < LIMBS; i++) {
+    bits |= a[i];
+  }
+  return bits == 0;
+}
+/*---------------------------------------------------------------------------*/
+static uint32_t
+add_raw(uint32_t *r, const uint32_t *a, const uint32_t *b)
+{
+  uint64_t c = 0;
+  int i;
+
+  for(i = 0; i < LIMBS; i++) {
+    c += (uint64_t)a[i] + b[i];
+    r[i] = (uint32_t)c;
+    c >>= 32;
+  }
+  return (uint32_t)c;
+}
+/*---------------------------------------------------------------------------*/
+static uint32_t
+sub_raw(uint32_t *r, const uint32_t *a, const uint32_t *b)
+{
+  int64_t c = 0;
+  int i;
+
+  for(i = 0; i < LIMBS; i++) {
+    c += (int64_t)a[i] - b[i];
+    r[i] = (uint32_t)c;
+    c >>= 32;
+  }
+  return (uint32_t)-c;
+}
+/*---------------------------------------------------------------------------*/
+static void
+mod_add(uint32_t *r, const uint32_t *a, const uint32_t *b,
+        const struct modulus *m)
+{
+  if(add_raw(r, a, b) || cmp(r, m->m) >= 0) {
+    sub_raw(r, r, m->m);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+mod_sub(uint32_t *r, const uint32_t *a, const uint32_t *b,
+        const struct modulus *m)
+{
+  if(sub_raw(r, a, b)) {
+    add_raw(r, r, m->m);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* r = a * b / 2^256 mod m, for a, b < m. r may alias a or b */
+static void
+mont_mul(uint32_t *r, const uint32_t *a, const uint32_t *b,
+         const struct modulus *m)
+{
+  uint32_t t[LIMBS + 2];
+  uint64_t c;
+  uint32_t u;
+  int i, j;
+
+  memset(t, 0, sizeof(t));
+  for(i = 0; i < LIMBS; i++) {
+    c = 0;
+    for(j = 0; j < LIMBS; j++) {
+      c += (uint64_t)a[j] * b[i] + t[j];
+      t[j] = (uint32_t)c;
+      c >>= 32;
+    }
+    c += t[LIMBS];
+    t[LIMBS] = (uint32_t)c;
+    t[LIMBS + 1] = (uint32_t)(c >> 32);
+
+    u = t[0] * m->inv;
+    c = ((uint64_t)u * m->m[0] + t[0]) >> 32;
+    for(j = 1; j < LIMBS; j++) {
+      c += (uint64_t)u * m->m[j] + t[j];
+      t[j - 1] = (uint32_t)c;
+      c >>= 32;
+    }
+    c += t[LIMBS];
+    t[LIMBS - 1] = (uint32_t)c;
+    t[LIMBS] = t[LIMBS + 1] + (uint32_t)(c >> 32);
+  }
+
+  if(t[LIMBS] || cmp(t, m->m) >= 0) {
+    sub_raw(t, t, m->m);
+  }
+  memcpy(r, t, LIMBS * sizeof(uint32_t));
+}
+/*---------------------------------------------------------------------------*/
+static void
+to_mont(uint32_t *r, const uint32_t *a, const struct modulus *m)
+{
+  mont_mul(r, a, m->r2, m);
+}
+/*---------------------------------------------------------------------------*/
+static void
+from_mont(uint32_t *r, const uint32_t *a, const struct modulus *m)
+{
+  mont_mul(r, a, one, m);
+}
+/*---------------------------------------------------------------------------*/
+/* r = a^-1, by Fermat's little theorem. Both in the Montgomery domain */
+static void
+mont_inv(uint32_t *r, const uint32_t *a, const struct modulus *m)
+{
+  uint32_t e[LIMBS];
+  uint32_t x[LIMBS];
+  const uint32_t two[LIMBS] = { 2 };
+  int i;
+
+  sub_raw(e, m->m, two);
+  to_mont(x, one, m);
+  for(i = 32 * LIMBS - 1; i >= 0; i--) {
+    mont_mul(x, x, x, m);
+    if((e[i / 32] >> (i % 32)) & 1) {
+      mont_mul(x, x, a, m);
+    }
+  }
+  memcpy(r, x, sizeof(x));
+}
+/*---------------------------------------------------------------------------*/
+static void
+point_set_infinity(struct p_256_point *r)
+{
+  memset(r, 0, sizeof(*r));
+}
+/*---------------------------------------------------------------------------*/
+/* r = 2a, dbl-2001-b. r may alias a */
+static void
+point_double(struct p_256_point *r, const struct p_256_point *a)
+{
+  uint32_t delta[LIMBS], gamma[LIMBS], beta[LIMBS], alpha[LIMBS];
+  uint32_t t1[LIMBS], t2[LIMBS];
+
+  if(is_zero(a->z)) {
+    point_set_infinity(r);
+    return;
+  }
+
+  mont_mul(delta, a->z, a->z, &p);
+  mont_mul(gamma, a->y, a->y, &p);
+  mont_mul(beta, a->x, gamma, &p);
+
+  /* alpha = 3 * (x - delta) * (x + delta) */
+  mod_sub(t1, a->x, delta, &p);
+  mod_add(t2, a->x, delta, &p);
+  mont_mul(t1, t1, t2, &p);
+  mod_add(alpha, t1, t1, &p);
+  mod_add(alpha, alpha, t1, &p);
+
+  /* z3 = (y + z)^2 - gamma - delta */
+  mod_add(t1, a->y, a->z, &p);
+  mont_mul(t1, t1, t1, &p);
+  mod_sub(t1, t1, gamma, &p);
+  mod_sub(r->z, t1, delta, &p);
+
+  /* x3 = alpha^2 - 8 * beta */
+  mod_add(beta, beta, beta, &p);
+  mod_add(beta, beta, beta, &p);
+  mod_add(t2, beta, beta, &p);
+  mont_mul(t1, alpha, alpha, &p);
+  mod_sub(r->x, t1, t2, &p);
+
+  /* y3 = alpha * (4 * beta - x3) - 8 * gamma^2 */
+  mod_sub(t1, beta, r->x, &p);
+  mont_mul(t1, alpha, t1, &p);
+  mont_mul(t2, gamma, gamma, &p);
+  mod_add(t2, t2, t2, &p);
+  mod_add(t2, t2, t2, &p);
+  mod_add(t2, t2, t2, &p);
+  mod_sub(r->y, t1, t2, &p);
+}
+/*---------------------------------------------------------------------------*/
+/* r = a + b. r may alias a or b */
+static void
+point_add(struct p_256_point *r, const struct p_256_point *a,
+          const struct p_256_point *b)
+{
+  uint32_t z1z1[LIMBS], z2z2[LIMBS], u1[LIMBS], u2[LIMBS];
+  uint32_t s1[LIMBS], s2[LIMBS], h[LIMBS], rr[LIMBS];
+  uint32_t t[LIMBS];
+
+  if(is_zero(a->z)) {
+    memcpy(r, b, sizeof(*r));
+    return;
+  }
+  if(is_zero(b->z)) {
+    memcpy(r, a, sizeof(*r));
+    return;
+  }
+
+  mont_mul(z1z1, a->z, a->z, &p);
+  mont_mul(z2z2, b->z, b->z, &p);
+  mont_mul(u1, a->x, z2z2, &p);
+  mont_mul(u2, b->x, z1z1, &p);
+  mont_mul(s1, a->y, b->z, &p);
+  mont_mul(s1, s1, z2z2, &p);
+  mont_mul(s2, b->y, a->z, &p);
+  mont_mul(s2, s2, z1z1, &p);
+  mod_sub(h, u2, u1, &p);
+  mod_sub(rr, s2, s1, &p);
+
+  if(is_zero(h)) {
+    if(is_zero(rr)) {
+      point_double(r, a);
+    } else {
+      point_set_infinity(r);
+    }
+    return;
+  }
+
+  /* z3 = h * z1 * z2 */
+  mont_mul(t, a->z, b->z, &p);
+  mont_mul(r->z, t, h, &p);
+
+  /* u1 = u1 * h^2, h = h^3 */
+  mont_mul(t, h, h, &p);
+  mont_mul(u1, u1, t, &p);
+  mont_mul(h, h, t, &p);
+
+  /* x3 = rr^2 - h^3 - 2 * u1 * h^2 */
+  mont_mul(t, rr, rr, &p);
+  mod_sub(t, t, h, &p);
+  mod_sub(t, t, u1, &p);
+  mod_sub(r->x, t, u1, &p);
+
+  /* y3 = rr * (u1 * h^2 - x3) - s1 * h^3 */
+  mod_sub(t, u1, r->x, &p);
+  mont_mul(t, rr, t, &p);
+  mont_mul(s1, s1, h, &p);
+  mod_sub(r->y, t, s1, &p);
+}
+/*---------------------------------------------------------------------------*/
+/* Loads an affine point, from Montgomery-less coordinates */
+static void
+point_from_affine(struct p_256_point *r, const uint32_t *x, const uint32_t *y)
+{
+  to_mont(r->x, x, &p);
+  to_mont(r->y, y, &p);
+  to_mont(r->z, one, &p);
+}
+/*---------------------------------------------------------------------------*/
+/* The affine X coordinate of a point that is not the infinity */
+static void
+point_affine_x(uint32_t *x, const struct p_256_point *a)
+{
+  uint32_t zinv[LIMBS];
+
+  mont_inv(zinv, a->z, &p);
+  mont_mul(zinv, zinv, zinv, &p);
+  mont_mul(x, a->x, zinv, &p);
+  from_mont(x, x, &p);
+}
+/*---------------------------------------------------------------------------*/
+static int
+check_point(const uint32_t *x, const uint32_t *y)
+{
+  uint32_t xm[LIMBS], lhs[LIMBS], rhs[LIMBS], t[LIMBS];
+
+  if(cmp(x, p.m) >= 0 || cmp(y, p.m) >= 0) {
+    return 0;
+  }
+
+  /* y^2 = x^3 - 3x + b */
+  to_mont(xm, x, &p);
+  to_mont(lhs, y, &p);
+  mont_mul(lhs, lhs, lhs, &p);
+  mont_mul(rhs, xm, xm, &p);
+  mont_mul(rhs, rhs, xm, &p);
+  mod_sub(rhs, rhs, xm, &p);
+  mod_sub(rhs, rhs, xm, &p);
+  mod_sub(rhs, rhs, xm, &p);
+  to_mont(t, curve_b, &p);
+  mod_add(rhs, rhs, t, &p);
+
+  return cmp(lhs, rhs) == 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Is a scalar in [1, n - 1]? */
+static int
+check_scalar(const uint32_t *k)
+{
+  return !is_zero(k) && cmp(k, n.m) < 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+get_bit(const uint32_t *k, int bit)
+{
+  return (k[bit / 32] >> (bit % 32)) & 1;
+}
+/*---------------------------------------------------------------------------*/
+int
+p_256_check_public_key(const uint8_t *public_key)
+{
+  uint32_t x[LIMBS], y[LIMBS];
+
+  load(x, public_key);
+  load(y, public_key + P_256_LEN);
+  return check_point(x, y);
+}
+/*---------------------------------------------------------------------------*/
+int
+p_256_check_private_key(const uint8_t *secret)
+{
+  uint32_t k[LIMBS];
+  int ok;
+
+  load(k, secret);
+  ok = check_scalar(k);
+  memset(k, 0, sizeof(k));
+  return ok;
+}
+/*---------------------------------------------------------------------------*/
+int
+p_256_check_signature(const uint8_t *signature)
+{
+  uint32_t r[LIMBS], s[LIMBS];
+
+  load(r, signature);
+  load(s, signature + P_256_LEN);
+  return check_scalar(r) && check_scalar(s);
+}
+/*---------------------------------------------------------------------------*/
+PT_THREAD(p_256_ecdh(struct p_256_ctx *ctx, const uint8_t *public_key,
+                     const uint8_t *secret, uint8_t *shared_secret))
+{
+  uint32_t x[LIMBS], y[LIMBS];
+  uint32_t mask;
+  int i;
+
+  PT_BEGIN(&ctx->pt);
+
+  load(x, public_key);
+  load(y, public_key + P_256_LEN);
+  load(ctx->u1, secret);
+  if(!check_point(x, y) || !check_scalar(ctx->u1)) {
+    ctx->result = P_256_INVALID_KEY;
+    PT_EXIT(&ctx->pt);
+  }
+  point_from_affine(&ctx->points[0], x, y);
+  point_set_infinity(&ctx->r);
+
+  /*
+   * Double and always add, keeping the sum only for the bits that are set,
+   * so that the sequence of operations does not depend on the secret
+   * beyond its leading zeros
+   */
+  for(ctx->bit = 32 * LIMBS - 1; ctx->bit >= 0; ctx->bit--) {
+    point_double(&ctx->r, &ctx->r);
+    point_add(&ctx->t, &ctx->r, &ctx->points[0]);
+    mask = -(uint32_t)get_bit(ctx->u1, ctx->bit);
+    for(i = 0; i < LIMBS; i++) {
+      ctx->r.x[i] ^= mask & (ctx->r.x[i] ^ ctx->t.x[i]);
+      ctx->r.y[i] ^= mask & (ctx->r.y[i] ^ ctx->t.y[i]);
+      ctx->r.z[i] ^= mask & (ctx->r.z[i] ^ ctx->t.z[i]);
+    }
+    PT_YIELD(&ctx->pt);
+  }
+
+  if(is_zero(ctx->r.z)) {
+    ctx->result = P_256_INVALID_KEY;
+    PT_EXIT(&ctx->pt);
+  }
+  point_affine_x(x, &ctx->r);
+  store(shared_secret, x);
+  memset(ctx->u1, 0, sizeof(ctx->u1));
+  ctx->result = P_256_OK;
+
+  PT_END(&ctx->pt);
+}
+/*---------------------------------------------------------------------------*/
+PT_THREAD(p_256_ecdsa_verify(struct p_256_ctx *ctx, const uint8_t *public_key,
+                             const uint8_t *hash, const uint8_t *signature))
+{
+  uint32_t x[LIMBS], y[LIMBS];
+  uint32_t r[LIMBS], s[LIMBS], e[LIMBS];
+  int sel;
+
+  PT_BEGIN(&ctx->pt);
+
+  load(x, public_key);
+  load(y, public_key + P_256_LEN);
+  if(!check_point(x, y)) {
+    ctx->result = P_256_INVALID_KEY;
+    PT_EXIT(&ctx->pt);
+  }
+  load(r, signature);
+  load(s, signature + P_256_LEN);
+  if(!check_scalar(r) || !check_scalar(s)) {
+    ctx->result = P_256_INVALID_SIGNATURE;
+    PT_EXIT(&ctx->pt);
+  }
+  load(e, hash);
+  if(cmp(e, n.m) >= 0) {
+    sub_raw(e, e, n.m);
+  }
+
+  /* u1 = e / s, u2 = r / s (mod n) */
+  to_mont(s, s, &n);
+  mont_inv(s, s, &n);
+  mont_mul(ctx->u1, e, s, &n);
+  mont_mul(ctx->u2, r, s, &n);
+
+  /* Shamir's trick: G, Q and G + Q */
+  point_from_affine(&ctx->points[0], base_x, base_y);
+  point_from_affine(&ctx->points[1], x, y);
+  point_add(&ctx->points[2], &ctx->points[0], &ctx->points[1]);
+  point_set_infinity(&ctx->r);
+
+  for(ctx->bit = 32 * LIMBS - 1; ctx->bit >= 0; ctx->bit--) {
+    point_double(&ctx->r, &ctx->r);
+    sel = get_bit(ctx->u1, ctx->bit) | (get_bit(ctx->u2, ctx->bit) << 1);
+    if(sel) {
+      point_add(&ctx->r, &ctx->r, &ctx->points[sel - 1]);
+    }
+    PT_YIELD(&ctx->pt);
+  }
+
+  ctx->result = P_256_INVALID_SIGNATURE;
+  if(!is_zero(ctx->r.z)) {
+    point_affine_x(x, &ctx->r);
+    if(cmp(x, n.m) >= 0) {
+      sub_raw(x, x, n.m);
+    }
+    load(r, signature);
+    if(cmp(x, r) == 0) {
+      ctx->result = P_256_OK;
+    }
+  }
+
+  PT_END(&ctx->pt);
+}
+/*---------------------------------------------------------------------------*/
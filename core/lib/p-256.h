@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Software NIST P-256 elliptic curve operations: ECDH and ECDSA
+ *         verification.
+ *
+ *         Numbers, coordinates and hashes are 32-byte big-endian strings,
+ *         and public keys are X || Y (SEC 1 uncompressed, without the 0x04
+ *         prefix). The operations are protothreads, which yield once per bit
+ *         of the scalars so that they do not hold the CPU for long.
+ */
+#ifndef P_256_H_
+#define P_256_H_
+
+#include "sys/pt.h"
+#include <stdint.h>
+
+#define P_256_LEN 32
+
+/* Results */
+#define P_256_OK                0
+#define P_256_INVALID_KEY       1
+#define P_256_INVALID_SIGNATURE 2
+
+/* Jacobian coordinates, in the Montgomery domain */
+struct p_256_point {
+  uint32_t x[8];
+  uint32_t y[8];
+  uint32_t z[8];
+};
+
+struct p_256_ctx {
+  struct pt pt;
+  int bit;
+  uint8_t result;
+  uint32_t u1[8];
+  uint32_t u2[8];
+  struct p_256_point r;
+  struct p_256_point t;
+  struct p_256_point points[3];
+};
+
+/**
+ * \brief Checks that a public key is a point of the curve.
+ * \return Non-zero if it is
+ */
+int p_256_check_public_key(const uint8_t *public_key);
+
+/**
+ * \brief Checks that a private key is in [1, n - 1].
+ * \return Non-zero if it is
+ */
+int p_256_check_private_key(const uint8_t *secret);
+
+/**
+ * \brief Checks that both halves of a signature, r || s, are in [1, n - 1].
+ * \return Non-zero if they are
+ */
+int p_256_check_signature(const uint8_t *signature);
+
+/**
+ * \brief Computes an ECDH shared secret, the X coordinate of
+ *        secret * public_key. ctx->result is P_256_OK on success.
+ */
+PT_THREAD(p_256_ecdh(struct p_256_ctx *ctx, const uint8_t *public_key,
+                     const uint8_t *secret, uint8_t *shared_secret));
+
+/**
+ * \brief Verifies an ECDSA signature, r || s, of a SHA-256 hash.
+ *        ctx->result is P_256_OK if the signature is valid.
+ */
+PT_THREAD(p_256_ecdsa_verify(struct p_256_ctx *ctx, const uint8_t *public_key,
+                             const uint8_t *hash, const uint8_t *signature));
+
+#endif /* P_256_H_ */
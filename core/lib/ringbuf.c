@@ -41,7 +41,7 @@
 #include <sys/cc.h>
 /*---------------------------------------------------------------------------*/
 void
-ringbuf_init(struct ringbuf *r, uint8_t *dataptr, uint8_t size)
+ringbuf_init(struct ringbuf *r, uint8_t *dataptr, ringbuf_index_t size)
 {
   r->data = dataptr;
   r->mask = size - 1;
@@ -58,8 +58,8 @@ ringbuf_put(struct ringbuf *r, uint8_t c)
      XXX: there is a potential risk for a race condition here, because
      the ->get_ptr field may be written concurrently by the
      ringbuf_get() function. To avoid this, access to ->get_ptr must
-     be atomic. We use an uint8_t type, which makes access atomic on
-     most platforms, but C does not guarantee this.
+     be atomic. We use an uint8_t type by default, which makes access
+     atomic on most platforms, but C does not guarantee this.
   */
   if(((r->put_ptr - r->get_ptr) & r->mask) == r->mask) {
     return 0;
@@ -72,7 +72,7 @@ ringbuf_put(struct ringbuf *r, uint8_t c)
    * better safe than sorry.
    */
   CC_ACCESS_NOW(uint8_t, r->data[r->put_ptr]) = c;
-  CC_ACCESS_NOW(uint8_t, r->put_ptr) = (r->put_ptr + 1) & r->mask;
+  CC_ACCESS_NOW(ringbuf_index_t, r->put_ptr) = (r->put_ptr + 1) & r->mask;
   return 1;
 }
 /*---------------------------------------------------------------------------*/
@@ -88,8 +88,8 @@ ringbuf_get(struct ringbuf *r)
      XXX: there is a potential risk for a race condition here, because
      the ->put_ptr field may be written concurrently by the
      ringbuf_put() function. To avoid this, access to ->get_ptr must
-     be atomic. We use an uint8_t type, which makes access atomic on
-     most platforms, but C does not guarantee this.
+     be atomic. We use an uint8_t type by default, which makes access
+     atomic on most platforms, but C does not guarantee this.
   */
   if(((r->put_ptr - r->get_ptr) & r->mask) > 0) {
     /*
@@ -102,7 +102,7 @@ ringbuf_get(struct ringbuf *r)
      * (on some architectures).
      */
     c = CC_ACCESS_NOW(uint8_t, r->data[r->get_ptr]);
-    CC_ACCESS_NOW(uint8_t, r->get_ptr) = (r->get_ptr + 1) & r->mask;
+    CC_ACCESS_NOW(ringbuf_index_t, r->get_ptr) = (r->get_ptr + 1) & r->mask;
     return c;
   } else {
     return -1;
@@ -121,3 +121,100 @@ ringbuf_elements(struct ringbuf *r)
   return (r->put_ptr - r->get_ptr) & r->mask;
 }
 /*---------------------------------------------------------------------------*/
+int
+ringbuf_reserve_span(struct ringbuf *r, uint8_t **span)
+{
+  ringbuf_index_t put_ptr;
+  int len;
+
+  /* Only the consumer modifies ->get_ptr: read it once, so that the
+     result is consistent even if it moves while we compute. */
+  put_ptr = r->put_ptr;
+  len = r->mask - ((put_ptr - CC_ACCESS_NOW(ringbuf_index_t, r->get_ptr)) & r->mask);
+  if(len > r->mask + 1 - put_ptr) {
+    len = r->mask + 1 - put_ptr;
+  }
+  *span = &r->data[put_ptr];
+  return len;
+}
+/*---------------------------------------------------------------------------*/
+void
+ringbuf_commit(struct ringbuf *r, int len)
+{
+  CC_ACCESS_NOW(ringbuf_index_t, r->put_ptr) = (r->put_ptr + len) & r->mask;
+}
+/*---------------------------------------------------------------------------*/
+int
+ringbuf_peek_span(struct ringbuf *r, uint8_t **span)
+{
+  ringbuf_index_t get_ptr;
+  int len;
+
+  /* Same as above, ->put_ptr is only modified by the producer. */
+  get_ptr = r->get_ptr;
+  len = (CC_ACCESS_NOW(ringbuf_index_t, r->put_ptr) - get_ptr) & r->mask;
+  if(len > r->mask + 1 - get_ptr) {
+    len = r->mask + 1 - get_ptr;
+  }
+  *span = &r->data[get_ptr];
+  return len;
+}
+/*---------------------------------------------------------------------------*/
+void
+ringbuf_consume(struct ringbuf *r, int len)
+{
+  CC_ACCESS_NOW(ringbuf_index_t, r->get_ptr) = (r->get_ptr + len) & r->mask;
+}
+/*---------------------------------------------------------------------------*/
+int
+ringbuf_put_bulk(struct ringbuf *r, const uint8_t *data, int len)
+{
+  uint8_t *span;
+  int total;
+  int n;
+  int i;
+
+  /* At most two spans: up to the end of the array, then from its
+     start. The bytes are written through CC_ACCESS_NOW, as in
+     ringbuf_put(), so that the compiler cannot move them past the
+     update of ->put_ptr in ringbuf_commit(). */
+  for(total = 0; total < len; total += n) {
+    n = ringbuf_reserve_span(r, &span);
+    if(n == 0) {
+      break;
+    }
+    if(n > len - total) {
+      n = len - total;
+    }
+    for(i = 0; i < n; i++) {
+      CC_ACCESS_NOW(uint8_t, span[i]) = data[total + i];
+    }
+    ringbuf_commit(r, n);
+  }
+  return total;
+}
+/*---------------------------------------------------------------------------*/
+int
+ringbuf_get_bulk(struct ringbuf *r, uint8_t *data, int len)
+{
+  uint8_t *span;
+  int total;
+  int n;
+  int i;
+
+  for(total = 0; total < len; total += n) {
+    n = ringbuf_peek_span(r, &span);
+    if(n == 0) {
+      break;
+    }
+    if(n > len - total) {
+      n = len - total;
+    }
+    for(i = 0; i < n; i++) {
+      data[total + i] = CC_ACCESS_NOW(uint8_t, span[i]);
+    }
+    ringbuf_consume(r, n);
+  }
+  return total;
+}
+/*---------------------------------------------------------------------------*/
@@ -56,6 +56,24 @@
 
 #include "contiki-conf.h"
 
+/* With RINGBUF_CONF_16BIT, the read and write positions are 16-bit
+   quantities and a ring buffer can hold up to 32768 bytes. Only
+   enable it on platforms where 16-bit loads and stores are atomic
+   (e.g., MSP430 and ARM). */
+#ifdef RINGBUF_CONF_16BIT
+#define RINGBUF_16BIT RINGBUF_CONF_16BIT
+#else /* RINGBUF_CONF_16BIT */
+#define RINGBUF_16BIT 0
+#endif /* RINGBUF_CONF_16BIT */
+
+#if RINGBUF_16BIT
+typedef uint16_t ringbuf_index_t;
+#define RINGBUF_MAX_SIZE 32768
+#else /* RINGBUF_16BIT */
+typedef uint8_t ringbuf_index_t;
+#define RINGBUF_MAX_SIZE 128
+#endif /* RINGBUF_16BIT */
+
 /**
  * \brief      Structure that holds the state of a ring buffer.
  *
@@ -67,10 +85,10 @@
  */
 struct ringbuf {
   uint8_t *data;
-  uint8_t mask;
+  ringbuf_index_t mask;
 
-  /* XXX these must be 8-bit quantities to avoid race conditions. */
-  uint8_t put_ptr, get_ptr;
+  /* XXX these must be accessed atomically to avoid race conditions. */
+  ringbuf_index_t put_ptr, get_ptr;
 };
 
 /**
@@ -82,12 +100,13 @@ struct ringbuf {
  *             This function initiates a ring buffer. The data in the
  *             buffer is stored in an external array, to which a
  *             pointer must be supplied. The size of the ring buffer
- *             must be a power of two and cannot be larger than 128
- *             bytes.
+ *             must be a power of two and cannot be larger than
+ *             RINGBUF_MAX_SIZE bytes. One byte of the array is
+ *             always left unused.
  *
  */
 void    ringbuf_init(struct ringbuf *r, uint8_t *a,
-		     uint8_t size_power_of_two);
+		     ringbuf_index_t size_power_of_two);
 
 /**
  * \brief      Insert a byte into the ring buffer
@@ -129,6 +148,72 @@ int     ringbuf_size(struct ringbuf *r);
  */
 int     ringbuf_elements(struct ringbuf *r);
 
+/**
+ * \brief      Insert several bytes into the ring buffer
+ * \param r    A pointer to a struct ringbuf to hold the state of the ring buffer
+ * \param data The bytes to be written to the buffer
+ * \param len  The number of bytes to write
+ * \return     The number of bytes written, less than len if the buffer got full.
+ *
+ *             This function is the producer side, like
+ *             ringbuf_put(), and the buffer positions are only
+ *             updated once all bytes have been copied.
+ */
+int     ringbuf_put_bulk(struct ringbuf *r, const uint8_t *data, int len);
+
+/**
+ * \brief      Get several bytes from the ring buffer
+ * \param r    A pointer to a struct ringbuf to hold the state of the ring buffer
+ * \param data A buffer to copy the bytes to
+ * \param len  The maximum number of bytes to read
+ * \return     The number of bytes read, 0 if the buffer was empty.
+ *
+ *             This function is the consumer side, like ringbuf_get().
+ */
+int     ringbuf_get_bulk(struct ringbuf *r, uint8_t *data, int len);
+
+/**
+ * \brief      Get the contiguous free space at the write position
+ * \param r    A pointer to a struct ringbuf to hold the state of the ring buffer
+ * \param span Set to point to the first free byte
+ * \return     The number of bytes that can be written at *span.
+ *
+ *             The producer may write up to the returned number of
+ *             bytes at *span, e.g., with DMA, and then make them
+ *             visible to the consumer with ringbuf_commit(). When
+ *             the free space wraps around the end of the array,
+ *             only the first part is returned.
+ */
+int     ringbuf_reserve_span(struct ringbuf *r, uint8_t **span);
+
+/**
+ * \brief      Make bytes written at the reserved span available
+ * \param r    A pointer to a struct ringbuf to hold the state of the ring buffer
+ * \param len  The number of bytes written, at most what ringbuf_reserve_span() returned
+ */
+void    ringbuf_commit(struct ringbuf *r, int len);
+
+/**
+ * \brief      Get the contiguous data at the read position
+ * \param r    A pointer to a struct ringbuf to hold the state of the ring buffer
+ * \param span Set to point to the first byte to be read
+ * \return     The number of bytes that can be read at *span, 0 if the buffer is empty.
+ *
+ *             The consumer may read, or hand to DMA, up to the
+ *             returned number of bytes at *span, and then release
+ *             them with ringbuf_consume(). When the data wraps
+ *             around the end of the array, only the first part is
+ *             returned.
+ */
+int     ringbuf_peek_span(struct ringbuf *r, uint8_t **span);
+
+/**
+ * \brief      Remove bytes from the read position
+ * \param r    A pointer to a struct ringbuf to hold the state of the ring buffer
+ * \param len  The number of bytes to remove, at most what ringbuf_peek_span() returned
+ */
+void    ringbuf_consume(struct ringbuf *r, int len);
+
 #endif /* RINGBUF_H_ */
 
 /** @}*/
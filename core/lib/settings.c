@@ -65,6 +65,21 @@
 #define SETTINGS_BOTTOM_ADDR	(SETTINGS_TOP_ADDR + 1 - SETTINGS_MAX_SIZE)
 #endif
 
+#ifndef SETTINGS_CONF_INDEX_SIZE
+/** Number of keys whose location is cached in RAM. Zero disables the index. */
+#define SETTINGS_CONF_INDEX_SIZE 0
+#endif
+
+#ifndef SETTINGS_CONF_APPEND_UPDATES
+/** If set, settings_set() appends the new value and deletes the old one
+ *  instead of overwriting it in place, spreading wear over the whole
+ *  settings area. */
+#define SETTINGS_CONF_APPEND_UPDATES 0
+#endif
+
+/** Size of the chunks in which items are moved during compaction. */
+#define SETTINGS_COMPACT_CHUNK_SIZE 16
+
 typedef struct {
 #if SETTINGS_CONF_SUPPORT_LARGE_VALUES
   uint8_t size_extra;
@@ -74,20 +89,39 @@ typedef struct {
   settings_key_t key;
 } item_header_t;
 
+#if SETTINGS_CONF_INDEX_SIZE
+/* Location of the first live item of each key, so that look-ups do not
+ * have to walk the store from the top. The index is built on first use
+ * and kept up to date by the functions that modify the store. */
+static struct {
+  settings_key_t key;
+  settings_iter_t iter;
+} key_index[SETTINGS_CONF_INDEX_SIZE];
+static uint8_t index_count;
+static enum {
+  INDEX_UNBUILT,
+  INDEX_PARTIAL,   /* Some keys did not fit in the index */
+  INDEX_COMPLETE
+} index_state;
+/* Iterator of the free slot following the last item */
+static settings_iter_t index_end;
+#endif /* SETTINGS_CONF_INDEX_SIZE */
+
 /*****************************************************************************/
-// MARK: - Public Travesal Functions
+// MARK: - Private Functions
 /*****************************************************************************/
 
 /*---------------------------------------------------------------------------*/
-settings_iter_t
-settings_iter_begin()
+static settings_iter_t
+iter_begin_raw(void)
 {
   return settings_iter_is_valid(SETTINGS_TOP_ADDR) ? SETTINGS_TOP_ADDR : 0;
 }
 
 /*---------------------------------------------------------------------------*/
-settings_iter_t
-settings_iter_next(settings_iter_t ret)
+/* Steps to the next item, deleted or not. */
+static settings_iter_t
+iter_next_raw(settings_iter_t ret)
 {
   if(ret) {
     /* A settings iterator always points to the first byte
@@ -101,6 +135,259 @@ settings_iter_next(settings_iter_t ret)
   return SETTINGS_INVALID_ITER;
 }
 
+/*---------------------------------------------------------------------------*/
+static settings_iter_t
+skip_deleted(settings_iter_t iter)
+{
+  while(iter && settings_iter_get_key(iter) == SETTINGS_DELETED_KEY) {
+    iter = iter_next_raw(iter);
+  }
+  return iter;
+}
+
+/*---------------------------------------------------------------------------*/
+static void
+write_header(settings_iter_t iter, const item_header_t *header)
+{
+  eeprom_write(iter - sizeof(*header), (uint8_t *)header, sizeof(*header));
+}
+
+/*---------------------------------------------------------------------------*/
+/* Marks the end of the store at the given iterator. */
+static void
+clear_header(settings_iter_t iter)
+{
+  item_header_t header;
+
+  if(iter >= SETTINGS_BOTTOM_ADDR + sizeof(header)) {
+    memset(&header, 0xFF, sizeof(header));
+    write_header(iter, &header);
+  }
+}
+
+#if SETTINGS_CONF_INDEX_SIZE
+/*---------------------------------------------------------------------------*/
+static int
+index_lookup(settings_key_t key)
+{
+  int i;
+
+  for(i = 0; i < index_count; i++) {
+    if(key_index[i].key == key) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/*---------------------------------------------------------------------------*/
+static void
+index_insert(settings_key_t key, settings_iter_t iter)
+{
+  if(index_lookup(key) >= 0) {
+    return;
+  }
+  if(index_count < SETTINGS_CONF_INDEX_SIZE) {
+    key_index[index_count].key = key;
+    key_index[index_count].iter = iter;
+    index_count++;
+  } else {
+    index_state = INDEX_PARTIAL;
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+static void
+index_build(void)
+{
+  settings_iter_t iter;
+  settings_iter_t last = 0;
+
+  if(index_state != INDEX_UNBUILT) {
+    return;
+  }
+
+  index_count = 0;
+  index_state = INDEX_COMPLETE;
+  for(iter = iter_begin_raw(); iter; last = iter, iter = iter_next_raw(iter)) {
+    settings_key_t key = settings_iter_get_key(iter);
+    if(key != SETTINGS_DELETED_KEY) {
+      index_insert(key, iter);
+    }
+  }
+  index_end = last ? settings_iter_get_value_addr(last) : SETTINGS_TOP_ADDR;
+}
+
+/*---------------------------------------------------------------------------*/
+static void
+index_added(settings_key_t key, settings_iter_t iter)
+{
+  if(index_state != INDEX_UNBUILT) {
+    index_insert(key, iter);
+    index_end = settings_iter_get_value_addr(iter);
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+static void
+index_deleted(settings_key_t key, settings_iter_t iter)
+{
+  int i;
+
+  if(index_state == INDEX_UNBUILT) {
+    return;
+  }
+
+  i = index_lookup(key);
+  if(i < 0 || key_index[i].iter != iter) {
+    return;
+  }
+  /* The first item of the key is gone, point to the next one */
+  for(iter = settings_iter_next(iter); iter; iter = settings_iter_next(iter)) {
+    if(settings_iter_get_key(iter) == key) {
+      key_index[i].iter = iter;
+      return;
+    }
+  }
+  if(index_state == INDEX_PARTIAL) {
+    /* The freed slot is for one of the keys left out, rebuild */
+    index_state = INDEX_UNBUILT;
+  } else {
+    key_index[i] = key_index[--index_count];
+  }
+}
+#endif /* SETTINGS_CONF_INDEX_SIZE */
+
+/*---------------------------------------------------------------------------*/
+static void
+index_invalidate(void)
+{
+#if SETTINGS_CONF_INDEX_SIZE
+  index_state = INDEX_UNBUILT;
+#endif
+}
+
+/*---------------------------------------------------------------------------*/
+/* Returns the iterator at which the next item will be written. */
+static settings_iter_t
+find_end(void)
+{
+#if SETTINGS_CONF_INDEX_SIZE
+  index_build();
+  return index_end;
+#else
+  settings_iter_t iter;
+  settings_iter_t last = 0;
+
+  for(iter = iter_begin_raw(); iter; last = iter, iter = iter_next_raw(iter)) {
+    /* This block intentionally left blank. */
+  }
+
+  /* Value address of item is the same as the iterator for next item. */
+  return last ? settings_iter_get_value_addr(last) : SETTINGS_TOP_ADDR;
+#endif
+}
+
+/*---------------------------------------------------------------------------*/
+static settings_iter_t
+find_key(settings_key_t key, uint8_t index)
+{
+  settings_iter_t iter;
+
+#if SETTINGS_CONF_INDEX_SIZE
+  int i;
+
+  index_build();
+  i = index_lookup(key);
+  if(i >= 0) {
+    /* Start from the first item of this key */
+    iter = key_index[i].iter;
+  } else if(index_state == INDEX_COMPLETE) {
+    return SETTINGS_INVALID_ITER;
+  } else {
+    iter = settings_iter_begin();
+  }
+#else
+  iter = settings_iter_begin();
+#endif
+
+  for(; iter; iter = settings_iter_next(iter)) {
+    if(settings_iter_get_key(iter) == key) {
+      if(!index) {
+        break;
+      }
+      index--;
+    }
+  }
+
+  return iter;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Moves the live items toward the top of the store, squeezing out
+ * deleted items. Items keep their order. Returns nonzero if any space
+ * was reclaimed. */
+static uint8_t
+compact(void)
+{
+  uint8_t buf[SETTINGS_COMPACT_CHUNK_SIZE];
+  settings_iter_t iter;
+  settings_iter_t end = SETTINGS_TOP_ADDR;
+  settings_iter_t dst = SETTINGS_TOP_ADDR;
+
+  for(iter = iter_begin_raw(); iter;) {
+    eeprom_addr_t start = settings_iter_get_value_addr(iter);
+    eeprom_addr_t size = iter - start;
+
+    if(settings_iter_get_key(iter) != SETTINGS_DELETED_KEY) {
+      if(dst != iter) {
+        /* Items only move up, so copy from the highest byte down:
+         * overlapping bytes are read before they are overwritten. */
+        eeprom_addr_t offset;
+        eeprom_addr_t len;
+
+        for(offset = size; offset > 0; offset -= len) {
+          len = MIN(offset, sizeof(buf));
+          eeprom_read(start + offset - len, buf, len);
+          eeprom_write(dst - size + offset - len, buf, len);
+        }
+      }
+      dst -= size;
+    }
+
+    /* The header of the next item lies below anything written so far */
+    end = start;
+    iter = settings_iter_is_valid(start) ? start : 0;
+  }
+
+  if(dst == end) {
+    return 0;
+  }
+
+  clear_header(dst);
+  index_invalidate();
+
+  return 1;
+}
+
+/*****************************************************************************/
+// MARK: - Public Travesal Functions
+/*****************************************************************************/
+
+/*---------------------------------------------------------------------------*/
+settings_iter_t
+settings_iter_begin()
+{
+  return skip_deleted(iter_begin_raw());
+}
+
+/*---------------------------------------------------------------------------*/
+settings_iter_t
+settings_iter_next(settings_iter_t ret)
+{
+  return skip_deleted(iter_next_raw(ret));
+}
+
 /*---------------------------------------------------------------------------*/
 uint8_t
 settings_iter_is_valid(settings_iter_t iter)
@@ -193,29 +480,42 @@ settings_iter_get_value_bytes(settings_iter_t iter, void *bytes,
 settings_status_t
 settings_iter_delete(settings_iter_t iter)
 {
-  settings_status_t ret = SETTINGS_STATUS_FAILURE;
-
-  settings_iter_t next = settings_iter_next(iter);
-
-  if(!next) {
-    /* Special case: we are the last item. we can get away with
-     * just wiping out our own header.
-     */
-    item_header_t header;
+  item_header_t header;
+  settings_key_t key;
 
-    memset(&header, 0xFF, sizeof(header));
+  if(!settings_iter_is_valid(iter)) {
+    return SETTINGS_STATUS_INVALID_ARGUMENT;
+  }
 
-    eeprom_write(iter - sizeof(header), (uint8_t *)&header, sizeof(header));
+  key = settings_iter_get_key(iter);
+  if(key == SETTINGS_DELETED_KEY) {
+    return SETTINGS_STATUS_NOT_FOUND;
+  }
 
-    ret = SETTINGS_STATUS_OK;
+  if(!iter_next_raw(iter)) {
+    /* Special case: we are the last item. We can get away with
+     * just wiping out our own header, which frees the space at once.
+     */
+    clear_header(iter);
+#if SETTINGS_CONF_INDEX_SIZE
+    index_deleted(key, iter);
+    index_end = iter;
+#endif
+    return SETTINGS_STATUS_OK;
   }
 
-  /* This case requires the settings store to be shifted.
-   * Currently unimplemented. TODO: Writeme!
-   */
-  ret = SETTINGS_STATUS_UNIMPLEMENTED;
+  /* Otherwise turn the item into a tombstone. Only the key changes, so
+   * the store can still be traversed; the space is reclaimed by the
+   * next compaction. */
+  eeprom_read(iter - sizeof(header), (uint8_t *)&header, sizeof(header));
+  header.key = SETTINGS_DELETED_KEY;
+  write_header(iter, &header);
 
-  return ret;
+#if SETTINGS_CONF_INDEX_SIZE
+  index_deleted(key, iter);
+#endif
+
+  return SETTINGS_STATUS_OK;
 }
 
 /*****************************************************************************/
@@ -226,22 +526,7 @@ settings_iter_delete(settings_iter_t iter)
 uint8_t
 settings_check(settings_key_t key, uint8_t index)
 {
-  uint8_t ret = 0;
-
-  settings_iter_t iter;
-
-  for(iter = settings_iter_begin(); iter; iter = settings_iter_next(iter)) {
-    if(settings_iter_get_key(iter) == key) {
-      if(!index) {
-        ret = 1;
-        break;
-      } else {
-        index--;
-      }
-    }
-  }
-
-  return ret;
+  return find_key(key, index) != SETTINGS_INVALID_ITER;
 }
 
 /*---------------------------------------------------------------------------*/
@@ -249,27 +534,15 @@ settings_status_t
 settings_get(settings_key_t key, uint8_t index, uint8_t *value,
              settings_length_t * value_size)
 {
-  settings_status_t ret = SETTINGS_STATUS_NOT_FOUND;
-
-  settings_iter_t iter;
+  settings_iter_t iter = find_key(key, index);
 
-  for(iter = settings_iter_begin(); iter; iter = settings_iter_next(iter)) {
-    if(settings_iter_get_key(iter) == key) {
-      if(!index) {
-        /* We found it! */
-        *value_size = settings_iter_get_value_bytes(iter,
-                                                    (void *)value,
-                                                    *value_size);
-        ret = SETTINGS_STATUS_OK;
-        break;
-      } else {
-        /* Nope, keep looking */
-        index--;
-      }
-    }
+  if(!iter) {
+    return SETTINGS_STATUS_NOT_FOUND;
   }
 
-  return ret;
+  *value_size = settings_iter_get_value_bytes(iter, (void *)value,
+                                              *value_size);
+  return SETTINGS_STATUS_OK;
 }
 
 /*---------------------------------------------------------------------------*/
@@ -283,24 +556,25 @@ settings_add(settings_key_t key, const uint8_t *value,
 
   item_header_t header;
 
-  /* Find the last item. */
-  for(iter = settings_iter_begin(); settings_iter_next(iter);
-      iter = settings_iter_next(iter)) {
-    /* This block intentionally left blank. */
+  if(key == SETTINGS_DELETED_KEY) {
+    ret = SETTINGS_STATUS_INVALID_ARGUMENT;
+    goto bail;
   }
 
-  if(iter) {
-    /* Value address of item is the same as the iterator for next item. */
-    iter = settings_iter_get_value_addr(iter);
-  } else {
-    /* This will be the first setting! */
-    iter = SETTINGS_TOP_ADDR;
-  }
+  iter = find_end();
 
   if(iter < SETTINGS_BOTTOM_ADDR + value_size + sizeof(header)) {
-    /* This value is too big to store. */
-    ret = SETTINGS_STATUS_OUT_OF_SPACE;
-    goto bail;
+    /* Reclaim the space of deleted items and try again */
+    if(value_size > SETTINGS_MAX_VALUE_SIZE || !compact()) {
+      ret = SETTINGS_STATUS_OUT_OF_SPACE;
+      goto bail;
+    }
+    iter = find_end();
+    if(iter < SETTINGS_BOTTOM_ADDR + value_size + sizeof(header)) {
+      /* This value is too big to store. */
+      ret = SETTINGS_STATUS_OUT_OF_SPACE;
+      goto bail;
+    }
   }
 
   header.key = key;
@@ -334,23 +608,26 @@ settings_add(settings_key_t key, const uint8_t *value,
   header.size_check = ~header.size_low;
 
   /* Write the header first */
-  eeprom_write(iter - sizeof(header), (uint8_t *)&header, sizeof(header));
+  write_header(iter, &header);
 
   /* Sanity check, remove once confident */
   if(settings_iter_get_value_length(iter) != value_size) {
+    index_invalidate();
     goto bail;
   }
 
   /* Now write the data */
   eeprom_write(settings_iter_get_value_addr(iter), (uint8_t *)value, value_size);
 
+#if SETTINGS_CONF_INDEX_SIZE
+  index_added(key, iter);
+#endif
+
   /* This should be the last item. If this is not the case,
    * then we need to clear out the phantom setting.
    */
-  if((iter = settings_iter_next(iter))) {
-    memset(&header, 0xFF, sizeof(header));
-
-    eeprom_write(iter - sizeof(header),(uint8_t *)&header, sizeof(header));
+  if((iter = iter_next_raw(iter))) {
+    clear_header(iter);
   }
 
   ret = SETTINGS_STATUS_OK;
@@ -368,19 +645,35 @@ settings_set(settings_key_t key, const uint8_t *value,
 
   settings_iter_t iter;
 
-  for(iter = settings_iter_begin(); iter; iter = settings_iter_next(iter)) {
-    if(settings_iter_get_key(iter) == key) {
-      break;
-    }
-  }
+  iter = find_key(key, 0);
 
   if((iter == EEPROM_NULL) || !settings_iter_is_valid(iter)) {
     ret = settings_add(key, value, value_size);
     goto bail;
   }
 
+  if((SETTINGS_CONF_APPEND_UPDATES
+      || value_size != settings_iter_get_value_length(iter))
+     && !find_key(key, 1)) {
+    /* Append the new value before deleting the old one, so that one of
+     * them survives a power failure. A compaction may move the old item,
+     * which stays the first one of its key. */
+    ret = settings_add(key, value, value_size);
+    if(ret == SETTINGS_STATUS_OK) {
+      ret = settings_iter_delete(find_key(key, 0));
+      goto bail;
+    }
+    /* No room to append, fall back to an in-place update if possible */
+    iter = find_key(key, 0);
+    if(ret != SETTINGS_STATUS_OUT_OF_SPACE
+       || value_size != settings_iter_get_value_length(iter)) {
+      goto bail;
+    }
+  }
+
   if(value_size != settings_iter_get_value_length(iter)) {
-    /* Requires the settings store to be shifted. Currently unimplemented. */
+    /* Replacing one of several values of a key with a value of a different
+     * size would change their order. */
     ret = SETTINGS_STATUS_UNIMPLEMENTED;
     goto bail;
   }
@@ -399,24 +692,13 @@ bail:
 settings_status_t
 settings_delete(settings_key_t key, uint8_t index)
 {
-  settings_status_t ret = SETTINGS_STATUS_NOT_FOUND;
-
-  settings_iter_t iter;
+  settings_iter_t iter = find_key(key, index);
 
-  for(iter = settings_iter_begin(); iter; iter = settings_iter_next(iter)) {
-    if(settings_iter_get_key(iter) == key) {
-      if(!index) {
-        /* We found it! */
-        ret = settings_iter_delete(iter);
-        break;
-      } else {
-        /* Nope, keep looking */
-        index--;
-      }
-    }
+  if(!iter) {
+    return SETTINGS_STATUS_NOT_FOUND;
   }
 
-  return ret;
+  return settings_iter_delete(iter);
 }
 
 /*---------------------------------------------------------------------------*/
@@ -429,6 +711,8 @@ settings_wipe(void)
   const uint32_t x = 0xFFFFFF;
 
   eeprom_write(SETTINGS_TOP_ADDR - sizeof(x), (uint8_t *)&x, sizeof(x));
+
+  index_invalidate();
 }
 
 /*****************************************************************************/
@@ -76,12 +76,23 @@
  *  | -3       | 1 or 2   | size       | The size of the value, in bytes |
  *  | -4 or -5 | variable | value      |                                 |
  *
- *  The end of the key-value pairs is denoted by the first invalid entry.
- *  An invalid entry has any of the following attributes:
+ *  The end of the key-value pairs is denoted by the first invalid entry,
+ *  that is an entry whose size_check byte doesn't match the one's
+ *  compliment of the size byte (or size_low byte).
  *
- *   * The size_check byte doesn't match the one's compliment
- *     of the size byte (or size_low byte).
- *   * The key has a value of 0x0000.
+ *  Deleted entries keep their size but have their key overwritten with
+ *  \ref SETTINGS_DELETED_KEY (0x0000). They are skipped by the traversal
+ *  functions, and their space is reclaimed by compacting the store when
+ *  settings_add() runs out of room.
+ *
+ *  ## Configuration ##
+ *
+ *   * `SETTINGS_CONF_INDEX_SIZE`: number of keys whose location is cached
+ *     in RAM, so that reading a setting does not walk the whole store.
+ *     Defaults to 0 (no index).
+ *   * `SETTINGS_CONF_APPEND_UPDATES`: when set, settings_set() appends the
+ *     new value and deletes the old one instead of rewriting it in place,
+ *     which spreads wear over the settings area. Defaults to 0.
  *
  * @{ */
 
@@ -138,6 +149,8 @@ typedef uint16_t settings_length_t;
 #define SETTINGS_LAST_INDEX        0xFF
 /** Returned when key is invalid. */
 #define SETTINGS_INVALID_KEY       0xFFFF
+/** Key of deleted entries. Not a valid key for new settings. */
+#define SETTINGS_DELETED_KEY       0x0000
 /** Returned if no (further) element was found. */
 #define SETTINGS_INVALID_ITER      EEPROM_NULL
 
@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Software SHA-256 (FIPS 180-4).
+ */
+
+#include "lib/sha-256.h"
+#include <string.h>
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define CH(x, y, z) (((x) & (y)) ^ (~(x) & (z)))
+#define MAJ(x, y, z) (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+#define SIGMA0(x) (ROTR(x, 2) ^ ROTR(x, 13) ^ ROTR(x, 22))
+#define SIGMA1(x) (ROTR(x, 6) ^ ROTR(x, 11) ^ ROTR(x, 25))
+#define GAMMA0(x) (ROTR(x, 7) ^ ROTR(x, 18) ^ ((x) >> 3))
+#define GAMMA1(x) (ROTR(x, 17) ^ ROTR(x, 19) ^ ((x) >> 10))
+
+static const uint32_t k[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+  0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+  0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+  0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+  0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+  0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+  0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+  0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+  0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+/*---------------------------------------------------------------------------*/
+static void
+transform(struct sha_256_ctx *ctx, const uint8_t *block)
+{
+  uint32_t w[16];
+  uint32_t s[8];
+  uint32_t t1, t2;
+  int i;
+
+  for(i = 0; i < 16; i++) {
+    w[i] = ((uint32_t)block[4 * i] << 24) | ((uint32_t)block[4 * i + 1] << 16) |
+      ((uint32_t)block[4 * i + 2] << 8) | block[4 * i + 3];
+  }
+  memcpy(s, ctx->state, sizeof(s));
+
+  for(i = 0; i < 64; i++) {
+    /* The message schedule is kept in a 16-word window */
+    if(i >= 16) {
+      w[i & 15] += GAMMA1(w[(i - 2) & 15]) + w[(i - 7) & 15] +
+        GAMMA0(w[(i - 15) & 15]);
+    }
+    t1 = s[7] + SIGMA1(s[4]) + CH(s[4], s[5], s[6]) + k[i] + w[i & 15];
+    t2 = SIGMA0(s[0]) + MAJ(s[0], s[1], s[2]);
+    s[7] = s[6];
+    s[6] = s[5];
+    s[5] = s[4];
+    s[4] = s[3] + t1;
+    s[3] = s[2];
+    s[2] = s[1];
+    s[1] = s[0];
+    s[0] = t1 + t2;
+  }
+
+  for(i = 0; i < 8; i++) {
+    ctx->state[i] += s[i];
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+sha_256_init(struct sha_256_ctx *ctx)
+{
+  ctx->state[0] = 0x6a09e667;
+  ctx->state[1] = 0xbb67ae85;
+  ctx->state[2] = 0x3c6ef372;
+  ctx->state[3] = 0xa54ff53a;
+  ctx->state[4] = 0x510e527f;
+  ctx->state[5] = 0x9b05688c;
+  ctx->state[6] = 0x1f83d9ab;
+  ctx->state[7] = 0x5be0cd19;
+  ctx->bit_count_high = 0;
+  ctx->bit_count_low = 0;
+  ctx->buf_len = 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+sha_256_update(struct sha_256_ctx *ctx, const uint8_t *data, uint32_t len)
+{
+  uint32_t n;
+
+  ctx->bit_count_high += len >> 29;
+  if(ctx->bit_count_low + (len << 3) < ctx->bit_count_low) {
+    ctx->bit_count_high++;
+  }
+  ctx->bit_count_low += len << 3;
+
+  while(len > 0) {
+    if(ctx->buf_len == 0 && len >= SHA_256_BLOCK_SIZE) {
+      transform(ctx, data);
+      data += SHA_256_BLOCK_SIZE;
+      len -= SHA_256_BLOCK_SIZE;
+      continue;
+    }
+    n = SHA_256_BLOCK_SIZE - ctx->buf_len;
+    if(n > len) {
+      n = len;
+    }
+    memcpy(ctx->buf + ctx->buf_len, data, n);
+    ctx->buf_len += n;
+    data += n;
+    len -= n;
+    if(ctx->buf_len == SHA_256_BLOCK_SIZE) {
+      transform(ctx, ctx->buf);
+      ctx->buf_len = 0;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+sha_256_final(struct sha_256_ctx *ctx, uint8_t *digest)
+{
+  int i;
+
+  ctx->buf[ctx->buf_len++] = 0x80;
+  if(ctx->buf_len > SHA_256_BLOCK_SIZE - 8) {
+    memset(ctx->buf + ctx->buf_len, 0, SHA_256_BLOCK_SIZE - ctx->buf_len);
+    transform(ctx, ctx->buf);
+    ctx->buf_len = 0;
+  }
+  memset(ctx->buf + ctx->buf_len, 0, SHA_256_BLOCK_SIZE - 8 - ctx->buf_len);
+  for(i = 0; i < 4; i++) {
+    ctx->buf[SHA_256_BLOCK_SIZE - 8 + i] = ctx->bit_count_high >> (24 - 8 * i);
+    ctx->buf[SHA_256_BLOCK_SIZE - 4 + i] = ctx->bit_count_low >> (24 - 8 * i);
+  }
+  transform(ctx, ctx->buf);
+
+  for(i = 0; i < 8; i++) {
+    digest[4 * i] = ctx->state[i] >> 24;
+    digest[4 * i + 1] = ctx->state[i] >> 16;
+    digest[4 * i + 2] = ctx->state[i] >> 8;
+    digest[4 * i + 3] = ctx->state[i];
+  }
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Software SHA-256 (FIPS 180-4).
+ */
+#ifndef SHA_256_H_
+#define SHA_256_H_
+
+#include <stdint.h>
+
+#define SHA_256_DIGEST_LENGTH 32
+#define SHA_256_BLOCK_SIZE    64
+
+struct sha_256_ctx {
+  uint32_t state[8];
+  uint32_t bit_count_high;
+  uint32_t bit_count_low;
+  uint8_t buf[SHA_256_BLOCK_SIZE];
+  uint8_t buf_len;
+};
+
+/**
+ * \brief Starts hashing.
+ */
+void sha_256_init(struct sha_256_ctx *ctx);
+
+/**
+ * \brief Hashes more data.
+ */
+void sha_256_update(struct sha_256_ctx *ctx, const uint8_t *data, uint32_t len);
+
+/**
+ * \brief Finishes hashing.
+ * \param digest SHA_256_DIGEST_LENGTH bytes
+ */
+void sha_256_final(struct sha_256_ctx *ctx, uint8_t *digest);
+
+#endif /* SHA_256_H_ */
@@ -0,0 +1,305 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \addtogroup trickle-set
+ * @{
+ */
+
+#include "contiki-conf.h"
+#include "lib/trickle-set.h"
+#include "lib/random.h"
+/*---------------------------------------------------------------------------*/
+#define DEBUG 0
+
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+/*---------------------------------------------------------------------------*/
+#define NONE              0xff
+
+/* The state of an instance: its number of doublings, and flags */
+#define STATE_DOUBLINGS   0x1f
+#define STATE_TX_PENDING  0x20 /* t is still ahead in this interval */
+#define STATE_LINKED      0x40 /* in the list of events */
+#define STATE_RUNNING     0x80
+
+#define DOUBLINGS(e)      ((e)->state & STATE_DOUBLINGS)
+#define INTERVAL(set, e)  ((set)->i_min << DOUBLINGS(e))
+
+/* Whether a is earlier than b, both being within half the clock range */
+#define BEFORE(a, b) \
+  ((clock_time_t)((a) - (b)) > (TRICKLE_TIMER_CLOCK_MAX >> 1))
+/*---------------------------------------------------------------------------*/
+static void run(void *ptr);
+/*---------------------------------------------------------------------------*/
+/* Time t from the start of an interval of length i */
+static clock_time_t
+get_t(clock_time_t start, clock_time_t i, uint8_t r)
+{
+  clock_time_t half;
+
+  half = i >> 1;
+  return trickle_timer_align(start, half + (half >> 8) * r +
+                             (((half & 0xff) * r) >> 8), i);
+}
+/*---------------------------------------------------------------------------*/
+/* The time of the next event of an instance: t, or the interval's end */
+static clock_time_t
+event(struct trickle_set *set, struct trickle_instance *e)
+{
+  clock_time_t i;
+
+  if(e->state & STATE_TX_PENDING) {
+    i = INTERVAL(set, e);
+    return e->end - i + get_t(e->end - i, i, e->r);
+  }
+  return e->end;
+}
+/*---------------------------------------------------------------------------*/
+static void
+remove_event(struct trickle_set *set, uint8_t instance)
+{
+  uint8_t *p;
+
+  if(!(set->instances[instance].state & STATE_LINKED)) {
+    return;
+  }
+  for(p = &set->head; *p != NONE; p = &set->instances[*p].next) {
+    if(*p == instance) {
+      *p = set->instances[instance].next;
+      break;
+    }
+  }
+  set->instances[instance].state &= ~STATE_LINKED;
+}
+/*---------------------------------------------------------------------------*/
+/* Insert an instance in the list, after those with the same event time */
+static void
+insert_event(struct trickle_set *set, uint8_t instance)
+{
+  struct trickle_instance *e;
+  clock_time_t t;
+  uint8_t *p;
+
+  e = &set->instances[instance];
+  t = event(set, e);
+  for(p = &set->head; *p != NONE; p = &set->instances[*p].next) {
+    if(BEFORE(t, event(set, &set->instances[*p]))) {
+      break;
+    }
+  }
+  e->next = *p;
+  *p = instance;
+  e->state |= STATE_LINKED;
+}
+/*---------------------------------------------------------------------------*/
+/* Set the ctimer for the earliest event */
+static void
+schedule(struct trickle_set *set)
+{
+  clock_time_t delay;
+
+  if(set->head == NONE) {
+    ctimer_stop(&set->ct);
+    return;
+  }
+  delay = event(set, &set->instances[set->head]) - clock_time();
+  if(delay > (TRICKLE_TIMER_CLOCK_MAX >> 1)) {
+    /* In the past */
+    delay = 0;
+  }
+  ctimer_set(&set->ct, delay, run, set);
+}
+/*---------------------------------------------------------------------------*/
+/* Start an interval of 2^doublings Imin at time start */
+static void
+new_interval(struct trickle_set *set, uint8_t instance, clock_time_t start,
+             uint8_t doublings)
+{
+  struct trickle_instance *e;
+
+  e = &set->instances[instance];
+  remove_event(set, instance);
+  e->state = STATE_RUNNING | STATE_TX_PENDING | doublings;
+  e->c = 0;
+  e->r = random_rand();
+  e->end = start + INTERVAL(set, e);
+  insert_event(set, instance);
+
+  PRINTF("trickle_set %u: new interval I=%lu, ends %lu\n", instance,
+         (unsigned long)INTERVAL(set, e), (unsigned long)e->end);
+}
+/*---------------------------------------------------------------------------*/
+/* The ctimer callback: handle the events that are due */
+static void
+run(void *ptr)
+{
+  struct trickle_set *set;
+  struct trickle_instance *e;
+  clock_time_t now;
+  uint8_t instance;
+  uint8_t doublings;
+
+  set = (struct trickle_set *)ptr;
+  now = clock_time();
+
+  while(set->head != NONE &&
+        !BEFORE(now, event(set, &set->instances[set->head]))) {
+    instance = set->head;
+    e = &set->instances[instance];
+    set->head = e->next;
+    e->state &= ~STATE_LINKED;
+
+    if(e->state & STATE_TX_PENDING) {
+      e->state &= ~STATE_TX_PENDING;
+      PRINTF("trickle_set %u: fire, c=%u\n", instance, e->c);
+      set->cb(set->cb_arg, instance,
+              set->k == TRICKLE_TIMER_INFINITE_REDUNDANCY || e->c < set->k ?
+              TRICKLE_TIMER_TX_OK : TRICKLE_TIMER_TX_SUPPRESS);
+      /* The callback may have stopped or reset the instance */
+      if((e->state & STATE_RUNNING) && !(e->state & STATE_LINKED)) {
+        insert_event(set, instance);
+      }
+    } else {
+      /* The interval is over: double it, and start the next one where
+         the last one ended */
+      doublings = DOUBLINGS(e);
+      if(doublings < set->i_max) {
+        doublings++;
+      }
+      if(BEFORE(e->end + ((set->i_min << doublings) >> 1), now)) {
+        /* Too late for t in the next interval: start it now instead */
+        new_interval(set, instance, now, doublings);
+      } else {
+        new_interval(set, instance, e->end, doublings);
+      }
+    }
+  }
+
+  schedule(set);
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+trickle_set_config(struct trickle_set *set, clock_time_t i_min,
+                   uint8_t i_max, uint8_t k,
+                   trickle_set_cb_t proto_cb, void *ptr)
+{
+  uint8_t i;
+
+#if TRICKLE_TIMER_ERROR_CHECKING
+  if(TRICKLE_TIMER_IMIN_IS_BAD(i_min)) {
+    PRINTF("trickle_set config: Bad Imin value\n");
+    return TRICKLE_TIMER_ERROR;
+  }
+
+  if(set == NULL || proto_cb == NULL || i_max == 0 || k == 0) {
+    PRINTF("trickle_set config: Bad arguments\n");
+    return TRICKLE_TIMER_ERROR;
+  }
+
+  /* Imax is adjusted down as for trickle timers */
+  while(i_max > 0 && TRICKLE_TIMER_IPAIR_IS_BAD(i_min, i_max)) {
+    i_max--;
+  }
+#endif
+  if(i_max > STATE_DOUBLINGS) {
+    i_max = STATE_DOUBLINGS;
+  }
+
+  set->i_min = i_min;
+  set->i_max = i_max;
+  set->k = k;
+  set->cb = proto_cb;
+  set->cb_arg = ptr;
+
+  set->head = NONE;
+  for(i = 0; i < set->num; i++) {
+    set->instances[i].state = 0;
+  }
+  ctimer_stop(&set->ct);
+
+  PRINTF("trickle_set config: %u instances, Imin=%lu, Imax=%u, k=%u\n",
+         set->num, (unsigned long)i_min, i_max, k);
+
+  return TRICKLE_TIMER_SUCCESS;
+}
+/*---------------------------------------------------------------------------*/
+void
+trickle_set_start(struct trickle_set *set, uint8_t instance)
+{
+  /* Random I in [Imin, Imax], as a number of doublings of Imin */
+  new_interval(set, instance, clock_time(),
+               random_rand() % (set->i_max + 1));
+  schedule(set);
+}
+/*---------------------------------------------------------------------------*/
+void
+trickle_set_stop(struct trickle_set *set, uint8_t instance)
+{
+  remove_event(set, instance);
+  set->instances[instance].state = 0;
+  schedule(set);
+}
+/*---------------------------------------------------------------------------*/
+void
+trickle_set_consistency(struct trickle_set *set, uint8_t instance)
+{
+  if(set->instances[instance].c < 0xff) {
+    set->instances[instance].c++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+trickle_set_inconsistency(struct trickle_set *set, uint8_t instance)
+{
+  struct trickle_instance *e;
+
+  e = &set->instances[instance];
+  /* Nothing to do if I is already Imin */
+  if((e->state & STATE_RUNNING) && DOUBLINGS(e) != 0) {
+    new_interval(set, instance, clock_time(), 0);
+    schedule(set);
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+trickle_set_is_running(struct trickle_set *set, uint8_t instance)
+{
+  return (set->instances[instance].state & STATE_RUNNING) != 0;
+}
+/*---------------------------------------------------------------------------*/
+/** @} */
@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \file
+ *   Sets of trickle timers that share a configuration and a ctimer.
+ */
+
+/** \addtogroup trickle-timer
+ * @{ */
+
+/**
+ * \defgroup trickle-set Sets of trickle timers
+ * A trickle set holds many trickle timers (instances) with the same Imin,
+ * Imax, k and callback, for protocols that run one trickle per resource,
+ * such as one per disseminated object or per MPL seed. The instances are
+ * numbered from 0 and are kept in a list sorted by their next event, and a
+ * single ctimer is set for the earliest one. Each instance only takes the
+ * end of its current interval, the position of t in it, its number of
+ * doublings and its consistency counter: 8 bytes with a 4-byte
+ * clock_time_t, 6 with a 2-byte one.
+ *
+ * The behaviour of each instance is that of a ::trickle_timer. t is drawn
+ * with a resolution of I/512, is aligned like that of trickle timers (see
+ * TRICKLE_TIMER_ALIGN) and the drift is always compensated for.
+ * @{
+ */
+
+#ifndef TRICKLE_SET_H_
+#define TRICKLE_SET_H_
+
+#include "contiki-conf.h"
+#include "lib/trickle-timer.h"
+#include "sys/ctimer.h"
+#include "sys/cc.h"
+
+/**
+ * \brief The largest number of instances of a set
+ */
+#define TRICKLE_SET_MAX_INSTANCES 255
+
+/**
+ * \brief typedef for the callback of a set, called at time t within the
+ *        current interval of one of its instances
+ *
+ * \e instance is the number of the instance, and \e suppress is
+ * TRICKLE_TIMER_TX_OK or TRICKLE_TIMER_TX_SUPPRESS.
+ */
+typedef void (* trickle_set_cb_t)(void *ptr, uint8_t instance,
+                                  uint8_t suppress);
+
+/**
+ * \brief The state of an instance. Not to be used directly.
+ */
+struct trickle_instance {
+  clock_time_t end;   /**< End of the current interval (absolute time) */
+  uint8_t next;       /**< The instance with the next later event */
+  uint8_t r;          /**< Position of t within [I/2, I), in 256ths */
+  uint8_t c;          /**< c: Consistency Counter */
+  uint8_t state;      /**< Number of doublings and flags */
+};
+
+/**
+ * \brief A set of trickle timers, declared with TRICKLE_SET()
+ */
+struct trickle_set {
+  struct trickle_instance *instances;
+  uint8_t num;
+  uint8_t head;       /**< The instance with the earliest event */
+  uint8_t i_max;
+  uint8_t k;
+  clock_time_t i_min;
+  trickle_set_cb_t cb;
+  void *cb_arg;
+  struct ctimer ct;
+};
+
+/**
+ * \brief Declare a set of trickle timers
+ * \param name The name of the set, a struct ::trickle_set
+ * \param num  The number of instances, at most TRICKLE_SET_MAX_INSTANCES
+ */
+#define TRICKLE_SET(name, num) \
+  static struct trickle_instance CC_CONCAT(name, _instances)[num]; \
+  static struct trickle_set name = { CC_CONCAT(name, _instances), num }
+
+/**
+ * \brief           Configure a set of trickle timers and stop all of them
+ * \param set       A set declared with TRICKLE_SET()
+ * \param i_min     Imin, in clock ticks
+ * \param i_max     Imax, as a number of doublings
+ * \param k         The redundancy constant, or
+ *                  #TRICKLE_TIMER_INFINITE_REDUNDANCY
+ * \param proto_cb  Callback for the time t of every instance
+ * \param ptr       The first argument of proto_cb
+ * \retval 0        Error (bad argument)
+ * \retval non-zero Success.
+ *
+ * As with trickle_timer_config(), Imax is adjusted down if Imin << Imax
+ * exceeds the boundaries of clock_time_t.
+ */
+uint8_t trickle_set_config(struct trickle_set *set, clock_time_t i_min,
+                           uint8_t i_max, uint8_t k,
+                           trickle_set_cb_t proto_cb, void *ptr);
+
+/**
+ * \brief Start an instance, with a random I in [Imin, Imax]
+ * \param set      The set
+ * \param instance The number of the instance
+ */
+void trickle_set_start(struct trickle_set *set, uint8_t instance);
+
+/**
+ * \brief Stop an instance
+ */
+void trickle_set_stop(struct trickle_set *set, uint8_t instance);
+
+/**
+ * \brief To be called by the protocol when it hears a consistent
+ *        transmission for an instance
+ */
+void trickle_set_consistency(struct trickle_set *set, uint8_t instance);
+
+/**
+ * \brief To be called by the protocol when it hears an inconsistent
+ *        transmission for an instance, or on an external event
+ */
+void trickle_set_inconsistency(struct trickle_set *set, uint8_t instance);
+
+/**
+ * \brief Checks whether an instance is running
+ */
+int trickle_set_is_running(struct trickle_set *set, uint8_t instance);
+
+#endif /* TRICKLE_SET_H_ */
+/** @} */
+/** @} */
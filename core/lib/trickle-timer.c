@@ -165,6 +165,29 @@ get_t(clock_time_t i_cur)
   return i_cur + (tt_rand() % i_cur);
 }
 /*---------------------------------------------------------------------------*/
+clock_time_t
+trickle_timer_align(clock_time_t start, clock_time_t t, clock_time_t i_cur)
+{
+#if TRICKLE_TIMER_ALIGN
+  clock_time_t aligned;
+
+  /* The latest grid point not later than t */
+  aligned = start + t;
+  aligned = aligned - (aligned % TRICKLE_TIMER_ALIGN) - start;
+  if(aligned <= t && aligned >= (i_cur >> 1)) {
+    return aligned;
+  }
+
+  /* Otherwise the earliest grid point that is later than t */
+  aligned += TRICKLE_TIMER_ALIGN;
+  if(aligned > t && aligned < i_cur) {
+    return aligned;
+  }
+#endif /* TRICKLE_TIMER_ALIGN */
+
+  return t;
+}
+/*---------------------------------------------------------------------------*/
 static void
 schedule_for_end(struct trickle_timer *tt)
 {
@@ -220,6 +243,12 @@ double_interval(void *ptr)
   /* Random t in [I/2, I) */
   loc_clock = get_t(loctt->i_cur);
 
+#if TRICKLE_TIMER_COMPENSATE_DRIFT
+  loc_clock = trickle_timer_align(last_end, loc_clock, loctt->i_cur);
+#else
+  loc_clock = trickle_timer_align(clock_time(), loc_clock, loctt->i_cur);
+#endif
+
   PRINTF("trickle_timer doubling: t=%lu\n", (unsigned long)loc_clock);
 
 #if TRICKLE_TIMER_COMPENSATE_DRIFT
@@ -291,6 +320,7 @@ new_interval(struct trickle_timer *tt)
 
   /* Random t in [I/2, I) */
   loc_clock = get_t(tt->i_cur);
+  loc_clock = trickle_timer_align(clock_time(), loc_clock, tt->i_cur);
 
   ctimer_set(&tt->ct, loc_clock, fire, tt);
 
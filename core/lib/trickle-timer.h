@@ -158,6 +158,26 @@
 #define TRICKLE_TIMER_WIDE_RAND 1
 #endif
 /*---------------------------------------------------------------------------*/
+/**
+ * \brief Aligns transmission points to a common grid of wake-ups
+ *
+ * When non-zero, the time point t of every trickle interval is moved to a
+ * multiple of TRICKLE_TIMER_ALIGN clock ticks, whenever such a multiple
+ * exists within [I/2, I). Transmissions of all trickle timers on the node
+ * (for example RPL DIOs, MPL/ROLL-TM and CoAP observe refreshes) then fall
+ * into the same ticks and share a single radio wake-up.
+ *
+ * This reduces the randomisation of t, so it should be kept small compared
+ * to Imin. 0: Disabled (default)
+ *
+ * To override the default, define TRICKLE_TIMER_CONF_ALIGN in contiki-conf.h
+ */
+#ifdef TRICKLE_TIMER_CONF_ALIGN
+#define TRICKLE_TIMER_ALIGN TRICKLE_TIMER_CONF_ALIGN
+#else
+#define TRICKLE_TIMER_ALIGN 0
+#endif
+/*---------------------------------------------------------------------------*/
 /**
  * \brief Selects a flavor for the 'Find maximum Imax' (max_imax) function.
  *
@@ -507,6 +527,24 @@ void trickle_timer_inconsistency(struct trickle_timer *tt);
  */
 #define trickle_timer_is_running(tt) ((tt)->i_cur != TRICKLE_TIMER_IS_STOPPED)
 
+/**
+ * \brief      Align a trickle transmission point to the shared wake-up grid
+ * \param start The absolute start time of the interval
+ * \param t     The time point in [I/2, I), relative to \e start
+ * \param i_cur The length I of the interval
+ * \return     The aligned time point, relative to \e start
+ *
+ * Returns the multiple of TRICKLE_TIMER_ALIGN in [I/2, I) that is closest to
+ * (and preferably not later than) start + t. If there is none, or if
+ * TRICKLE_TIMER_ALIGN is 0, t is returned unchanged.
+ *
+ * The library applies this to its own timers. Protocols which implement the
+ * trickle algorithm on their own timers can call this to have their
+ * transmissions share wake-ups with the trickle timers of the library.
+ */
+clock_time_t trickle_timer_align(clock_time_t start, clock_time_t t,
+                                 clock_time_t i_cur);
+
 /** @} */
 
 #endif /* TRICKLE_TIMER_H_ */
@@ -50,6 +50,15 @@
 #define PRINTF(...) do {} while (0)
 #endif
 
+/* Relocation entries, symbols and their names are read through buffers
+   of this size, a page of the file system or so, instead of one small
+   read each. 0 reads them directly. */
+#ifdef ELFLOADER_CONF_READ_BUFFER_SIZE
+#define ELFLOADER_READ_BUFFER_SIZE ELFLOADER_CONF_READ_BUFFER_SIZE
+#else
+#define ELFLOADER_READ_BUFFER_SIZE 64
+#endif
+
 #define EI_NIDENT 16
 
 
@@ -163,6 +172,53 @@ seek_read(int fd, unsigned int offset, char *buf, int len)
 #endif /* DEBUG */
 }
 /*---------------------------------------------------------------------------*/
+#if ELFLOADER_READ_BUFFER_SIZE > 0
+struct read_buffer {
+  unsigned int offset;
+  int len;
+  char data[ELFLOADER_READ_BUFFER_SIZE];
+};
+
+static struct read_buffer rel_buf, sym_buf, str_buf;
+
+static void
+buffered_read(struct read_buffer *b, int fd, unsigned int offset,
+              char *buf, int len)
+{
+  int available;
+
+  if(len > (int)sizeof(b->data)) {
+    seek_read(fd, offset, buf, len);
+    return;
+  }
+  if(offset < b->offset || offset + len > b->offset + b->len) {
+    cfs_seek(fd, offset, CFS_SEEK_SET);
+    b->offset = offset;
+    b->len = cfs_read(fd, b->data, sizeof(b->data));
+    if(b->len < 0) {
+      b->len = 0;
+    }
+  }
+  /* The file may end before the buffer, or even before the data */
+  available = b->offset + b->len - offset;
+  memcpy(buf, &b->data[offset - b->offset], available < len ? available : len);
+}
+/*---------------------------------------------------------------------------*/
+static void
+flush_buffers(void)
+{
+  rel_buf.len = sym_buf.len = str_buf.len = 0;
+}
+#define read_rel(fd, offset, buf, len) buffered_read(&rel_buf, fd, offset, buf, len)
+#define read_sym(fd, offset, buf, len) buffered_read(&sym_buf, fd, offset, buf, len)
+#define read_str(fd, offset, buf, len) buffered_read(&str_buf, fd, offset, buf, len)
+#else /* ELFLOADER_READ_BUFFER_SIZE > 0 */
+#define flush_buffers()
+#define read_rel seek_read
+#define read_sym seek_read
+#define read_str seek_read
+#endif /* ELFLOADER_READ_BUFFER_SIZE > 0 */
+/*---------------------------------------------------------------------------*/
 /*
 static void
 seek_write(int fd, unsigned int offset, char *buf, int len)
@@ -183,10 +239,10 @@ find_local_symbol(int fd, const char *symbol,
   struct relevant_section *sect;
   
   for(a = symtab; a < symtab + symtabsize; a += sizeof(s)) {
-    seek_read(fd, a, (char *)&s, sizeof(s));
+    read_sym(fd, a, (char *)&s, sizeof(s));
 
     if(s.st_name != 0) {
-      seek_read(fd, strtab + s.st_name, name, sizeof(name));
+      read_str(fd, strtab + s.st_name, name, sizeof(name));
       if(strcmp(name, symbol) == 0) {
 	if(s.st_shndx == bss.number) {
 	  sect = &bss;
@@ -233,12 +289,12 @@ relocate_section(int fd,
   }
   
   for(a = section; a < section + size; a += rel_size) {
-    seek_read(fd, a, (char *)&rela, rel_size);
-    seek_read(fd,
-	      symtab + sizeof(struct elf32_sym) * ELF32_R_SYM(rela.r_info),
-	      (char *)&s, sizeof(s));
+    read_rel(fd, a, (char *)&rela, rel_size);
+    read_sym(fd,
+	     symtab + sizeof(struct elf32_sym) * ELF32_R_SYM(rela.r_info),
+	     (char *)&s, sizeof(s));
     if(s.st_name != 0) {
-      seek_read(fd, strtab + s.st_name, name, sizeof(name));
+      read_str(fd, strtab + s.st_name, name, sizeof(name));
       PRINTF("name: %s\n", name);
       addr = (char *)symtab_lookup(name);
       /* ADDED */
@@ -300,10 +356,10 @@ find_program_processes(int fd,
   char name[30];
   
   for(a = symtab; a < symtab + size; a += sizeof(s)) {
-    seek_read(fd, a, (char *)&s, sizeof(s));
+    read_sym(fd, a, (char *)&s, sizeof(s));
 
     if(s.st_name != 0) {
-      seek_read(fd, strtab + s.st_name, name, sizeof(name));
+      read_str(fd, strtab + s.st_name, name, sizeof(name));
       if(strcmp(name, "autostart_processes") == 0) {
 	return &data.address[s.st_value];
       }
@@ -438,7 +494,8 @@ elfloader_load(int fd)
       PRINTF("symtab\n");
       symtaboff = shdr.sh_offset;
       symtabsize = shdr.sh_size;
-    } else if(shdr.sh_type == SHT_STRTAB/*strncmp(name, ".strtab", 7) == 0*/) {
+    } else if(shdr.sh_type == SHT_STRTAB && i != ehdr.e_shstrndx
+              /*strncmp(name, ".strtab", 7) == 0*/) {
       PRINTF("strtab\n");
       strtaboff = shdr.sh_offset;
       strtabsize = shdr.sh_size;
@@ -504,6 +561,8 @@ elfloader_load(int fd)
     return ELFLOADER_NO_TEXT;
   }
 
+  flush_buffers();
+
   PRINTF("before allocate ram\n");
   bss.address = (char *)elfloader_arch_allocate_ram(bsssize + datasize);
   data.address = (char *)bss.address + bsssize;
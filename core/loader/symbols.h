@@ -41,4 +41,9 @@ extern const int symbols_nelts;
 
 extern const struct symbols symbols[/* symbols_nelts */];
 
+/* An index of the symbols by the hash of their name (see symtab.c) */
+extern const unsigned short symbols_hash_size;
+extern const unsigned short symbols_hash_start[/* symbols_hash_size + 1 */];
+extern const unsigned short symbols_hash_chain[/* symbols_nelts */];
+
 #endif /* SYMBOLS_H_ */
@@ -41,8 +41,36 @@
 #define SYMTAB_CONF_BINARY_SEARCH 1
 #endif
 
+/* Look symbols up through the hash index made by tools/make-symbols-nm,
+   with a string comparison or two per lookup instead of a dozen. */
+#ifndef SYMTAB_CONF_HASH
+#define SYMTAB_CONF_HASH 0
+#endif
+
 /*---------------------------------------------------------------------------*/
-#if SYMTAB_CONF_BINARY_SEARCH
+#if SYMTAB_CONF_HASH
+void *
+symtab_lookup(const char *name)
+{
+  const char *p;
+  unsigned short h = 5381;
+  unsigned short i, end;
+
+  /* Must match the hash of tools/make-symbols-nm */
+  for(p = name; *p != '\0'; ++p) {
+    h = (h * 33) ^ (unsigned char)*p;
+  }
+  h &= symbols_hash_size - 1;
+
+  end = symbols_hash_start[h + 1];
+  for(i = symbols_hash_start[h]; i < end; ++i) {
+    if(strcmp(name, symbols[symbols_hash_chain[i]].name) == 0) {
+      return symbols[symbols_hash_chain[i]].value;
+    }
+  }
+  return NULL;
+}
+#elif SYMTAB_CONF_BINARY_SEARCH
 void *
 symtab_lookup(const char *name)
 {
@@ -78,5 +106,5 @@ symtab_lookup(const char *name)
   }
   return 0;
 }
-#endif /* SYMTAB_CONF_BINARY_SEARCH */
+#endif /* SYMTAB_CONF_HASH */
 /*---------------------------------------------------------------------------*/
@@ -37,6 +37,15 @@
 
 #define MAX_PATHLEN 80
 #define MAX_HOSTLEN 40
+
+/* States of the chunked transfer-coding parser */
+enum {
+  CHUNK_SIZE,
+  CHUNK_EXTENSION,
+  CHUNK_DATA,
+  CHUNK_DATA_END,
+  CHUNK_TRAILER,
+};
 PROCESS(http_socket_process, "HTTP socket process");
 LIST(socketlist);
 
@@ -56,6 +65,10 @@ static void
 parse_header_init(struct http_socket *s)
 {
   PT_INIT(&s->headerpt);
+  s->server_close = !HTTP_SOCKET_KEEP_ALIVE;
+  s->chunked = 0;
+  s->chunk_state = CHUNK_SIZE;
+  s->chunk_left = 0;
 }
 /*---------------------------------------------------------------------------*/
 static int
@@ -65,8 +78,11 @@ parse_header_byte(struct http_socket *s, char c)
 
   memset(&s->header, -1, sizeof(s->header));
 
-  /* Skip the HTTP response */
-  while(c != ' ') {
+  /* Skip the HTTP response, HTTP/1.0 servers close the connection */
+  for(s->header_chars = 0; c != ' '; s->header_chars++) {
+    if(s->header_chars == 7 && c != '1') {
+      s->server_close = 1;
+    }
     PT_YIELD(&s->headerpt);
   }
 
@@ -131,6 +147,26 @@ parse_header_byte(struct http_socket *s, char c)
             s->header_chars++;
             PT_YIELD(&s->headerpt);
           }
+        } else if(!strcmp(s->header_field, "Transfer-Encoding")) {
+          for(s->header_chars = 0; c != '\r' &&
+                s->header_chars < sizeof(s->header_field) - 1;
+              s->header_chars++) {
+            s->header_field[s->header_chars] = c;
+            PT_YIELD(&s->headerpt);
+          }
+          s->header_field[s->header_chars] = '\0';
+          s->chunked = !strcmp(s->header_field, "chunked");
+        } else if(!strcmp(s->header_field, "Connection")) {
+          for(s->header_chars = 0; c != '\r' &&
+                s->header_chars < sizeof(s->header_field) - 1;
+              s->header_chars++) {
+            s->header_field[s->header_chars] = c;
+            PT_YIELD(&s->headerpt);
+          }
+          s->header_field[s->header_chars] = '\0';
+          if(!strcmp(s->header_field, "close")) {
+            s->server_close = 1;
+          }
         } else if(!strcmp(s->header_field, "Content-Range")) {
           /* Skip the bytes-unit token */
           while(c != ' ' && c != '\t') {
@@ -222,6 +258,78 @@ parse_header_byte(struct http_socket *s, char c)
   PT_END(&s->headerpt);
 }
 /*---------------------------------------------------------------------------*/
+/* Passes the chunk data on, returns 1 once the last chunk is received */
+static int
+parse_chunked(struct http_socket *s, const uint8_t *data, int datalen)
+{
+  int i;
+  int len;
+  char c;
+
+  for(i = 0; i < datalen;) {
+    c = data[i];
+    switch(s->chunk_state) {
+    case CHUNK_SIZE:
+      if(isxdigit((int)c)) {
+        s->chunk_left = s->chunk_left * 16 +
+          (isdigit((int)c) ? c - '0' : tolower((int)c) - 'a' + 10);
+        i++;
+        break;
+      }
+      s->chunk_state = CHUNK_EXTENSION;
+      /* Fall through */
+    case CHUNK_EXTENSION:
+      /* Skip chunk extensions until the end of the line */
+      if(c == '\n') {
+        s->chunk_state = s->chunk_left > 0 ? CHUNK_DATA : CHUNK_TRAILER;
+        s->header_chars = 0;
+      }
+      i++;
+      break;
+    case CHUNK_DATA:
+      len = MIN(datalen - i, s->chunk_left);
+      call_callback(s, HTTP_SOCKET_DATA, &data[i], len);
+      s->chunk_left -= len;
+      i += len;
+      if(s->chunk_left == 0) {
+        s->chunk_state = CHUNK_DATA_END;
+      }
+      break;
+    case CHUNK_DATA_END:
+      if(c == '\n') {
+        s->chunk_state = CHUNK_SIZE;
+      }
+      i++;
+      break;
+    case CHUNK_TRAILER:
+      /* Skip trailer fields until an empty line */
+      if(c == '\n') {
+        if(s->header_chars == 0) {
+          return 1;
+        }
+        s->header_chars = 0;
+      } else if(c != '\r') {
+        s->header_chars++;
+      }
+      i++;
+      break;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+response_done(struct http_socket *s)
+{
+  if(s->server_close) {
+    tcp_socket_close(&s->s);
+    return;
+  }
+  /* Keep the connection for the next request */
+  s->idle = 1;
+  call_callback(s, HTTP_SOCKET_CLOSED, NULL, 0);
+}
+/*---------------------------------------------------------------------------*/
 static int
 input_pt(struct http_socket *s,
          const uint8_t *inputptr, int inputdatalen)
@@ -250,14 +358,26 @@ input_pt(struct http_socket *s,
 
   s->bodylen = 0;
   do {
-    /* Receive the data */
-    call_callback(s, HTTP_SOCKET_DATA, inputptr, inputdatalen);
-
-    /* Close the connection if the expected content length has been received */
-    if(s->header.content_length >= 0 && s->bodylen < s->header.content_length) {
+    if(s->chunked) {
+      if(parse_chunked(s, inputptr, inputdatalen)) {
+        response_done(s);
+        PT_EXIT(&s->pt);
+      }
+    } else {
+      /* Receive the data */
+      if(s->header.content_length >= 0 &&
+         inputdatalen > s->header.content_length - s->bodylen) {
+        inputdatalen = s->header.content_length - s->bodylen;
+      }
+      call_callback(s, HTTP_SOCKET_DATA, inputptr, inputdatalen);
       s->bodylen += inputdatalen;
-      if(s->bodylen >= s->header.content_length) {
-        tcp_socket_close(&s->s);
+
+      /* The response is complete once the expected content length has
+         been received */
+      if(s->header.content_length >= 0 &&
+         s->bodylen >= s->header.content_length) {
+        response_done(s);
+        PT_EXIT(&s->pt);
       }
     }
 
@@ -271,7 +391,8 @@ static void
 start_timeout_timer(struct http_socket *s)
 {
   PROCESS_CONTEXT_BEGIN(&http_socket_process);
-  etimer_set(&s->timeout_timer, HTTP_SOCKET_TIMEOUT);
+  etimer_set(&s->timeout_timer, s->idle ? HTTP_SOCKET_KEEP_ALIVE_TIMEOUT :
+             HTTP_SOCKET_TIMEOUT);
   PROCESS_CONTEXT_END(&http_socket_process);
   s->timeout_timer_started = 1;
 }
@@ -282,6 +403,10 @@ input(struct tcp_socket *tcps, void *ptr,
 {
   struct http_socket *s = ptr;
 
+  if(s->idle) {
+    /* Not expecting anything */
+    return 0;
+  }
   input_pt(s, inputptr, inputdatalen);
   start_timeout_timer(s);
 
@@ -390,76 +515,97 @@ removesocket(struct http_socket *s)
 {
   etimer_stop(&s->timeout_timer);
   s->timeout_timer_started = 0;
+  s->connected = 0;
+  s->idle = 0;
   list_remove(socketlist, s);
 }
 /*---------------------------------------------------------------------------*/
 static void
-event(struct tcp_socket *tcps, void *ptr,
-      tcp_socket_event_t e)
+send_request(struct http_socket *s)
 {
-  struct http_socket *s = ptr;
+  struct tcp_socket *tcps = &s->s;
   char host[MAX_HOSTLEN];
   char path[MAX_PATHLEN];
   uint16_t port;
   char str[42];
   int len;
 
-  if(e == TCP_SOCKET_CONNECTED) {
-    printf("Connected\n");
-    if(parse_url(s->url, host, &port, path)) {
-      tcp_socket_send_str(tcps, s->postdata != NULL ? "POST " : "GET ");
-      if(s->proxy_port != 0) {
-        /* If we are configured to route through a proxy, we should
-           provide the full URL as the path. */
-        tcp_socket_send_str(tcps, s->url);
-      } else {
-        tcp_socket_send_str(tcps, path);
-      }
-      tcp_socket_send_str(tcps, " HTTP/1.1\r\n");
-      tcp_socket_send_str(tcps, "Connection: close\r\n");
-      tcp_socket_send_str(tcps, "Host: ");
-      /* If we have IPv6 host, add the '[' and the ']' characters
-         to the host. As in rfc2732. */
-      if(memchr(host, ':', MAX_HOSTLEN)) {
-        tcp_socket_send_str(tcps, "[");
-      }
-      tcp_socket_send_str(tcps, host);
-      if(memchr(host, ':', MAX_HOSTLEN)) {
-        tcp_socket_send_str(tcps, "]");
+  if(parse_url(s->url, host, &port, path)) {
+    tcp_socket_send_str(tcps, s->postdata != NULL ? "POST " : "GET ");
+    if(s->proxy_port != 0) {
+      /* If we are configured to route through a proxy, we should
+         provide the full URL as the path. */
+      tcp_socket_send_str(tcps, s->url);
+    } else {
+      tcp_socket_send_str(tcps, path);
+    }
+    tcp_socket_send_str(tcps, " HTTP/1.1\r\n");
+#if !HTTP_SOCKET_KEEP_ALIVE
+    tcp_socket_send_str(tcps, "Connection: close\r\n");
+#endif
+    tcp_socket_send_str(tcps, "Host: ");
+    /* If we have IPv6 host, add the '[' and the ']' characters
+       to the host. As in rfc2732. */
+    if(memchr(host, ':', MAX_HOSTLEN)) {
+      tcp_socket_send_str(tcps, "[");
+    }
+    tcp_socket_send_str(tcps, host);
+    if(memchr(host, ':', MAX_HOSTLEN)) {
+      tcp_socket_send_str(tcps, "]");
+    }
+    tcp_socket_send_str(tcps, "\r\n");
+    if(s->postdata != NULL) {
+      if(s->content_type) {
+        tcp_socket_send_str(tcps, "Content-Type: ");
+        tcp_socket_send_str(tcps, s->content_type);
+        tcp_socket_send_str(tcps, "\r\n");
       }
+      tcp_socket_send_str(tcps, "Content-Length: ");
+      sprintf(str, "%u", s->postdatalen);
+      tcp_socket_send_str(tcps, str);
       tcp_socket_send_str(tcps, "\r\n");
-      if(s->postdata != NULL) {
-        if(s->content_type) {
-          tcp_socket_send_str(tcps, "Content-Type: ");
-          tcp_socket_send_str(tcps, s->content_type);
-          tcp_socket_send_str(tcps, "\r\n");
-        }
-        tcp_socket_send_str(tcps, "Content-Length: ");
-        sprintf(str, "%u", s->postdatalen);
-        tcp_socket_send_str(tcps, str);
-        tcp_socket_send_str(tcps, "\r\n");
-      } else if(s->length || s->pos > 0) {
-        tcp_socket_send_str(tcps, "Range: bytes=");
-        if(s->length) {
-          if(s->pos >= 0) {
-            sprintf(str, "%llu-%llu", s->pos, s->pos + s->length - 1);
-          } else {
-            sprintf(str, "-%llu", s->length);
-          }
+    } else if(s->length || s->pos > 0) {
+      tcp_socket_send_str(tcps, "Range: bytes=");
+      if(s->length) {
+        if(s->pos >= 0) {
+          sprintf(str, "%llu-%llu", s->pos, s->pos + s->length - 1);
         } else {
-          sprintf(str, "%llu-", s->pos);
+          sprintf(str, "-%llu", s->length);
         }
-        tcp_socket_send_str(tcps, str);
-        tcp_socket_send_str(tcps, "\r\n");
+      } else {
+        sprintf(str, "%llu-", s->pos);
       }
+      tcp_socket_send_str(tcps, str);
       tcp_socket_send_str(tcps, "\r\n");
-      if(s->postdata != NULL && s->postdatalen) {
-        len = tcp_socket_send(tcps, s->postdata, s->postdatalen);
-        s->postdata += len;
-        s->postdatalen -= len;
-      }
     }
-    parse_header_init(s);
+    tcp_socket_send_str(tcps, "\r\n");
+    if(s->postdata != NULL && s->postdatalen) {
+      len = tcp_socket_send(tcps, s->postdata, s->postdatalen);
+      s->postdata += len;
+      s->postdatalen -= len;
+    }
+  }
+  parse_header_init(s);
+}
+/*---------------------------------------------------------------------------*/
+static void
+event(struct tcp_socket *tcps, void *ptr,
+      tcp_socket_event_t e)
+{
+  struct http_socket *s = ptr;
+  int len;
+
+  if(s->idle && (e == TCP_SOCKET_CLOSED || e == TCP_SOCKET_TIMEDOUT ||
+                 e == TCP_SOCKET_ABORTED)) {
+    /* The idle connection went away, the last response was complete */
+    removesocket(s);
+    return;
+  }
+
+  if(e == TCP_SOCKET_CONNECTED) {
+    printf("Connected\n");
+    s->connected = 1;
+    send_request(s);
   } else if(e == TCP_SOCKET_CLOSED) {
     call_callback(s, HTTP_SOCKET_CLOSED, NULL, 0);
     removesocket(s);
@@ -580,6 +726,9 @@ PROCESS_THREAD(http_socket_process, ev, data)
           s = list_item_next(s)) {
         if(timeout_timer == &s->timeout_timer && s->timeout_timer_started) {
           tcp_socket_close(&s->s);
+          if(s->idle) {
+            removesocket(s);
+          }
           break;
         }
       }
@@ -606,6 +755,8 @@ http_socket_init(struct http_socket *s)
   init();
   uip_create_unspecified(&s->proxy_addr);
   s->proxy_port = 0;
+  s->connected = 0;
+  s->idle = 0;
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -617,12 +768,47 @@ initialize_socket(struct http_socket *s)
   s->postdatalen = 0;
   s->timeout_timer_started = 0;
   PT_INIT(&s->pt);
+  s->idle = 0;
   tcp_socket_register(&s->s, s,
                       s->inputbuf, sizeof(s->inputbuf),
                       s->outputbuf, sizeof(s->outputbuf),
                       input, event);
 }
 /*---------------------------------------------------------------------------*/
+/* Tells whether the idle connection of the socket goes where url does */
+static int
+can_reuse(struct http_socket *s, const char *url)
+{
+  char host[MAX_HOSTLEN];
+  char new_host[MAX_HOSTLEN];
+  uint16_t port;
+  uint16_t new_port;
+
+  return HTTP_SOCKET_KEEP_ALIVE && s->connected && s->idle &&
+    parse_url(s->url, host, &port, NULL) &&
+    parse_url(url, new_host, &new_port, NULL) &&
+    port == new_port && strcmp(host, new_host) == 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+start(struct http_socket *s, int reuse)
+{
+  list_add(socketlist, s);
+
+  if(reuse) {
+    s->did_tcp_connect = 1;
+    send_request(s);
+    if(s->s.c != NULL) {
+      tcpip_poll_tcp(s->s.c);
+    }
+    start_timeout_timer(s);
+    return HTTP_SOCKET_OK;
+  }
+  s->did_tcp_connect = 0;
+  s->connected = 0;
+  return start_request(s);
+}
+/*---------------------------------------------------------------------------*/
 int
 http_socket_get(struct http_socket *s,
                 const char *url,
@@ -631,6 +817,8 @@ http_socket_get(struct http_socket *s,
                 http_socket_callback_t callback,
                 void *callbackptr)
 {
+  int reuse = can_reuse(s, url);
+
   initialize_socket(s);
   strncpy(s->url, url, sizeof(s->url));
   s->pos = pos;
@@ -638,11 +826,7 @@ http_socket_get(struct http_socket *s,
   s->callback = callback;
   s->callbackptr = callbackptr;
 
-  s->did_tcp_connect = 0;
-
-  list_add(socketlist, s);
-
-  return start_request(s);
+  return start(s, reuse);
 }
 /*---------------------------------------------------------------------------*/
 int
@@ -654,6 +838,8 @@ http_socket_post(struct http_socket *s,
                  http_socket_callback_t callback,
                  void *callbackptr)
 {
+  int reuse = can_reuse(s, url);
+
   initialize_socket(s);
   strncpy(s->url, url, sizeof(s->url));
   s->postdata = postdata;
@@ -663,11 +849,7 @@ http_socket_post(struct http_socket *s,
   s->callback = callback;
   s->callbackptr = callbackptr;
 
-  s->did_tcp_connect = 0;
-
-  list_add(socketlist, s);
-
-  return start_request(s);
+  return start(s, reuse);
 }
 /*---------------------------------------------------------------------------*/
 int
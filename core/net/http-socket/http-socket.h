@@ -71,6 +71,22 @@ typedef void (* http_socket_callback_t)(struct http_socket *s,
 
 #define HTTP_SOCKET_TIMEOUT       ((2 * 60 + 30) * CLOCK_SECOND)
 
+/* Keep the connection open after a response, for the next request of the
+   socket to the same host and port. HTTP_SOCKET_CLOSED then tells that
+   the response is complete. */
+#ifdef HTTP_SOCKET_CONF_KEEP_ALIVE
+#define HTTP_SOCKET_KEEP_ALIVE HTTP_SOCKET_CONF_KEEP_ALIVE
+#else
+#define HTTP_SOCKET_KEEP_ALIVE 0
+#endif
+
+/* How long an idle connection is kept open */
+#ifdef HTTP_SOCKET_CONF_KEEP_ALIVE_TIMEOUT
+#define HTTP_SOCKET_KEEP_ALIVE_TIMEOUT HTTP_SOCKET_CONF_KEEP_ALIVE_TIMEOUT
+#else
+#define HTTP_SOCKET_KEEP_ALIVE_TIMEOUT (30 * CLOCK_SECOND)
+#endif
+
 struct http_socket {
   struct http_socket *next;
   struct tcp_socket s;
@@ -91,11 +107,21 @@ struct http_socket {
   uint8_t timeout_timer_started;
   struct pt pt, headerpt;
   int header_chars;
-  char header_field[15];
+  char header_field[18];
   struct http_socket_header header;
   uint8_t header_received;
   uint64_t bodylen;
   const char *content_type;
+
+  /* The connection is up, and no request is waiting for a response */
+  uint8_t connected;
+  uint8_t idle;
+  /* The server closes the connection after the response */
+  uint8_t server_close;
+  /* Chunked transfer-coding of the response body */
+  uint8_t chunked;
+  uint8_t chunk_state;
+  uint32_t chunk_left;
 };
 
 void http_socket_init(struct http_socket *s);
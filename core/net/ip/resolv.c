@@ -161,6 +161,28 @@ int strncasecmp(const char *s1, const char *s2, size_t n);
 #define RESOLV_SUPPORTS_RECORD_EXPIRATION 1
 #endif
 
+/* How long "not found" answers are kept when the server does not give
+   a SOA record to take the time from, and the most they are kept */
+#ifdef RESOLV_CONF_NEGATIVE_TTL
+#define RESOLV_NEGATIVE_TTL RESOLV_CONF_NEGATIVE_TTL
+#else
+#define RESOLV_NEGATIVE_TTL 30
+#endif
+
+#ifdef RESOLV_CONF_MAX_NEGATIVE_TTL
+#define RESOLV_MAX_NEGATIVE_TTL RESOLV_CONF_MAX_NEGATIVE_TTL
+#else
+#define RESOLV_MAX_NEGATIVE_TTL 300
+#endif
+
+/* Names that are looked up during the last eighth of their TTL are
+   queried again in the background, so that they do not expire */
+#if defined(RESOLV_CONF_PREFETCH) && RESOLV_SUPPORTS_RECORD_EXPIRATION
+#define RESOLV_PREFETCH RESOLV_CONF_PREFETCH
+#else
+#define RESOLV_PREFETCH RESOLV_SUPPORTS_RECORD_EXPIRATION
+#endif
+
 #if RESOLV_CONF_SUPPORTS_MDNS && !RESOLV_VERIFY_ANSWER_NAMES
 #error RESOLV_CONF_SUPPORTS_MDNS cannot be set without RESOLV_CONF_VERIFY_ANSWER_NAMES
 #endif
@@ -181,6 +203,7 @@ int strncasecmp(const char *s1, const char *s2, size_t n);
 
 #define DNS_TYPE_A      1
 #define DNS_TYPE_CNAME  5
+#define DNS_TYPE_SOA    6
 #define DNS_TYPE_PTR   12
 #define DNS_TYPE_MX    15
 #define DNS_TYPE_TXT   16
@@ -260,6 +283,12 @@ struct namemap {
 #if RESOLV_SUPPORTS_RECORD_EXPIRATION
   unsigned long expiration;
 #endif /* RESOLV_SUPPORTS_RECORD_EXPIRATION */
+#if RESOLV_PREFETCH
+  /* Lookups after this time start a refresh. While refreshing, the
+     entry is asking but its address is still good */
+  unsigned long prefetch;
+  uint8_t refresh;
+#endif /* RESOLV_PREFETCH */
   uip_ipaddr_t ipaddr;
   uint8_t err;
   uint8_t server;
@@ -283,6 +312,10 @@ static struct uip_udp_conn *resolv_conn = NULL;
 
 static struct etimer retry;
 
+/* Set when check_entries() is polled again to send further new
+   queries right away */
+static uint8_t poll_new;
+
 process_event_t resolv_event_found;
 
 PROCESS(resolv_process, "DNS resolver");
@@ -646,6 +679,54 @@ try_next_server(struct namemap *namemapptr)
   return 0;
 }
 /*---------------------------------------------------------------------------*/
+#if RESOLV_SUPPORTS_RECORD_EXPIRATION
+static uint32_t
+get32(const unsigned char *p)
+{
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+    ((uint32_t)p[2] << 8) | p[3];
+}
+/*---------------------------------------------------------------------------*/
+/** \internal
+ * Finds how long a "not found" answer may be cached: the lower of the
+ * TTL and the MINIMUM field of the SOA record in the authority section,
+ * as in RFC 2308.
+ *
+ * \param rr The first resource record after the questions.
+ */
+static unsigned long
+negative_ttl(unsigned char *rr, uint8_t nanswers, uint8_t nauthrr)
+{
+  const unsigned char *end = (unsigned char *)uip_appdata + uip_datalen();
+  unsigned char *p;
+  uint16_t len;
+  uint32_t ttl, minimum;
+
+  for(nauthrr += nanswers; nauthrr > 0; nauthrr--) {
+    p = skip_name(rr);
+    if(p + 10 > end) {
+      break;
+    }
+    len = (p[8] << 8) | p[9];
+    if(p + 10 + len > end) {
+      break;
+    }
+    if(nanswers > 0) {
+      nanswers--;
+    } else if(((p[0] << 8) | p[1]) == DNS_TYPE_SOA && len >= 22) {
+      ttl = get32(p + 4);
+      minimum = get32(p + 10 + len - 4);
+      if(minimum < ttl) {
+        ttl = minimum;
+      }
+      return ttl < RESOLV_MAX_NEGATIVE_TTL ? ttl : RESOLV_MAX_NEGATIVE_TTL;
+    }
+    rr = p + 10 + len;
+  }
+  return RESOLV_NEGATIVE_TTL;
+}
+#endif /* RESOLV_SUPPORTS_RECORD_EXPIRATION */
+/*---------------------------------------------------------------------------*/
 /** \internal
  * Runs through the list of names to see if there are any that have
  * not yet been queried and, if so, sends out a query.
@@ -661,8 +742,15 @@ check_entries(void)
 
   register struct namemap *namemapptr;
 
+  uint8_t only_new = poll_new;
+
+  poll_new = 0;
   for(i = 0; i < RESOLV_ENTRIES; ++i) {
     namemapptr = &names[i];
+    if(only_new && namemapptr->state != STATE_NEW) {
+      /* Leave the retry timers to the timer polls */
+      continue;
+    }
     if(namemapptr->state == STATE_NEW || namemapptr->state == STATE_ASKING) {
       etimer_set(&retry, CLOCK_SECOND / 4);
       if(namemapptr->state == STATE_ASKING) {
@@ -678,12 +766,20 @@ check_entries(void)
             /* Try the next server (if possible) before failing. Otherwise
                simply mark the entry as failed. */
             if(try_next_server(namemapptr) == 0) {
+#if RESOLV_PREFETCH
+              if(namemapptr->refresh) {
+                /* Keep the address we have until it expires */
+                namemapptr->state = STATE_DONE;
+                namemapptr->refresh = 0;
+                continue;
+              }
+#endif /* RESOLV_PREFETCH */
               /* STATE_ERROR basically means "not found". */
               namemapptr->state = STATE_ERROR;
 
 #if RESOLV_SUPPORTS_RECORD_EXPIRATION
-              /* Keep the "not found" error valid for 30 seconds */
-              namemapptr->expiration = clock_seconds() + 30;
+              /* Keep the "not found" error valid for a while */
+              namemapptr->expiration = clock_seconds() + RESOLV_NEGATIVE_TTL;
 #endif /* RESOLV_SUPPORTS_RECORD_EXPIRATION */
 
               resolv_found(namemapptr->name, NULL);
@@ -778,6 +874,16 @@ check_entries(void)
       break;
     }
   }
+
+  /* Only one query can be sent per poll. Send the queries of other new
+     names at once rather than one per retry tick */
+  for(++i; i < RESOLV_ENTRIES; ++i) {
+    if(names[i].state == STATE_NEW) {
+      poll_new = 1;
+      tcpip_poll_udp(resolv_conn);
+      break;
+    }
+  }
 }
 /*---------------------------------------------------------------------------*/
 /** \internal
@@ -898,8 +1004,13 @@ newdata(void)
 
 /** ANSWER HANDLING SECTION **************************************************/
 
-  if(nanswers == 0) {
-    /* Skip responses with no answers. */
+  if(nanswers == 0 && (is_request
+#if RESOLV_CONF_SUPPORTS_MDNS
+     || (UIP_UDP_BUF->srcport == UIP_HTONS(MDNS_PORT) && hdr->id == 0)
+#endif /* RESOLV_CONF_SUPPORTS_MDNS */
+     )) {
+    /* Skip requests and MDNS responses with no answers. Unicast
+       responses with none tell us that the name has no address. */
     return;
   }
 
@@ -936,13 +1047,21 @@ newdata(void)
     namemapptr->err = hdr->flags2 & DNS_FLAG2_ERR_MASK;
 
 #if RESOLV_SUPPORTS_RECORD_EXPIRATION
-    /* If we remain in the error state, keep it cached for 30 seconds. */
-    namemapptr->expiration = clock_seconds() + 30;
+    /* If we remain in the error state, keep it cached for a while. */
+    namemapptr->expiration = clock_seconds() + RESOLV_NEGATIVE_TTL;
 #endif /* RESOLV_SUPPORTS_RECORD_EXPIRATION */
 
-    /* Check for error. If so, call callback to inform. */
-    if(namemapptr->err != 0) {
+    /* Check for error or for no address. If so, call callback to
+       inform. */
+    if(namemapptr->err != 0 || nanswers == 0) {
       namemapptr->state = STATE_ERROR;
+#if RESOLV_PREFETCH
+      namemapptr->refresh = 0;
+#endif /* RESOLV_PREFETCH */
+#if RESOLV_SUPPORTS_RECORD_EXPIRATION
+      namemapptr->expiration = clock_seconds() +
+        negative_ttl(queryptr, nanswers, (uint8_t)uip_ntohs(hdr->numauthrr));
+#endif /* RESOLV_SUPPORTS_RECORD_EXPIRATION */
       resolv_found(namemapptr->name, NULL);
       return;
     }
@@ -1050,12 +1169,32 @@ newdata(void)
 
     namemapptr->state = STATE_DONE;
 #if RESOLV_SUPPORTS_RECORD_EXPIRATION
-    namemapptr->expiration = ans->ttl[1] + (ans->ttl[0] << 8);
-    namemapptr->expiration += clock_seconds();
+    {
+      uint32_t ttl = ((uint32_t)uip_ntohs(ans->ttl[0]) << 16) |
+        uip_ntohs(ans->ttl[1]);
+
+      namemapptr->expiration = clock_seconds() + ttl;
+#if RESOLV_PREFETCH
+      namemapptr->prefetch = namemapptr->expiration - ttl / 8;
+#if RESOLV_CONF_SUPPORTS_MDNS
+      if(UIP_UDP_BUF->srcport == UIP_HTONS(MDNS_PORT) && hdr->id == 0) {
+        /* MDNS answers are announced again by their owners */
+        namemapptr->prefetch = namemapptr->expiration;
+      }
+#endif /* RESOLV_CONF_SUPPORTS_MDNS */
+#endif /* RESOLV_PREFETCH */
+    }
 #endif /* RESOLV_SUPPORTS_RECORD_EXPIRATION */
 
     uip_ipaddr_copy(&namemapptr->ipaddr, (uip_ipaddr_t *) ans->ipaddr);
 
+#if RESOLV_PREFETCH
+    if(namemapptr->refresh) {
+      /* Nobody is waiting for a refreshed address */
+      namemapptr->refresh = 0;
+      break;
+    }
+#endif /* RESOLV_PREFETCH */
     resolv_found(namemapptr->name, &namemapptr->ipaddr);
     break;
 
@@ -1077,6 +1216,12 @@ newdata(void)
       namemapptr->state = STATE_ASKING;
       process_post(&resolv_process, PROCESS_EVENT_TIMER, NULL);
     }
+#if RESOLV_PREFETCH
+    else if(namemapptr->refresh) {
+      namemapptr->state = STATE_DONE;
+      namemapptr->refresh = 0;
+    }
+#endif /* RESOLV_PREFETCH */
   }
 
 }
@@ -1294,7 +1439,7 @@ resolv_query(const char *name)
     ) {
       lseqi = i;
       lseq = 255;
-    } else if(seqno - nameptr->seqno > lseq) {
+    } else if((uint8_t)(seqno - nameptr->seqno) > lseq) {
       lseq = seqno - nameptr->seqno;
       lseqi = i;
     }
@@ -1386,10 +1531,33 @@ resolv_lookup(const char *name, uip_ipaddr_t ** ipaddr)
           ret = RESOLV_STATUS_EXPIRED;
         }
 #endif /* RESOLV_SUPPORTS_RECORD_EXPIRATION */
+#if RESOLV_PREFETCH
+        if(ret == RESOLV_STATUS_CACHED &&
+           clock_seconds() > nameptr->prefetch
+#if RESOLV_CONF_SUPPORTS_MDNS
+           && !nameptr->is_mdns
+#endif /* RESOLV_CONF_SUPPORTS_MDNS */
+          ) {
+          PRINTF("resolver: Refreshing \"%s\".\n", name);
+          nameptr->state = STATE_NEW;
+          nameptr->refresh = 1;
+          nameptr->server = 0;
+          process_post(&resolv_process, PROCESS_EVENT_TIMER, 0);
+        }
+#endif /* RESOLV_PREFETCH */
+        /* Names in use are the last to be replaced */
+        if(nameptr->seqno != (uint8_t)(seqno - 1)) {
+          nameptr->seqno = seqno++;
+        }
         break;
       case STATE_NEW:
       case STATE_ASKING:
         ret = RESOLV_STATUS_RESOLVING;
+#if RESOLV_PREFETCH
+        if(nameptr->refresh && clock_seconds() <= nameptr->expiration) {
+          ret = RESOLV_STATUS_CACHED;
+        }
+#endif /* RESOLV_PREFETCH */
         break;
       /* Almost certainly a not-found error from server */
       case STATE_ERROR:
@@ -101,6 +101,44 @@ simple_udp_sendto_port(struct simple_udp_connection *c,
 }
 /*---------------------------------------------------------------------------*/
 int
+simple_udp_sendto_batch(struct simple_udp_connection *c,
+                        const struct simple_udp_datagram *datagrams,
+                        int count)
+{
+  struct uip_udp_conn *conn;
+  uip_ipaddr_t curaddr;
+  uint16_t curport;
+  int i;
+
+  conn = c->udp_conn;
+  if(conn == NULL) {
+    return 0;
+  }
+
+  /* Save the remote address and port once for the whole batch */
+  uip_ipaddr_copy(&curaddr, &conn->ripaddr);
+  curport = conn->rport;
+
+#if NETSTACK_CONF_WITH_IPV6
+  tcpip_ipv6_output_batch_begin();
+#endif /* NETSTACK_CONF_WITH_IPV6 */
+  for(i = 0; i < count; i++) {
+    uip_ipaddr_copy(&conn->ripaddr, datagrams[i].to != NULL ?
+                    datagrams[i].to : &c->remote_addr);
+    conn->rport = UIP_HTONS(datagrams[i].to_port != 0 ?
+                            datagrams[i].to_port : c->remote_port);
+    uip_udp_packet_send(conn, datagrams[i].data, datagrams[i].datalen);
+  }
+#if NETSTACK_CONF_WITH_IPV6
+  tcpip_ipv6_output_batch_end();
+#endif /* NETSTACK_CONF_WITH_IPV6 */
+
+  uip_ipaddr_copy(&conn->ripaddr, &curaddr);
+  conn->rport = curport;
+  return count;
+}
+/*---------------------------------------------------------------------------*/
+int
 simple_udp_register(struct simple_udp_connection *c,
                     uint16_t local_port,
                     uip_ipaddr_t *remote_addr,
@@ -155,6 +155,37 @@ int simple_udp_sendto_port(struct simple_udp_connection *c,
 			   const void *data, uint16_t datalen,
 			   const uip_ipaddr_t *to, uint16_t to_port);
 
+/** A datagram to send with simple_udp_sendto_batch() */
+struct simple_udp_datagram {
+  /** The IP address of the receiver, NULL for the remote address of
+      the connection */
+  const uip_ipaddr_t *to;
+  /** The UDP port of the receiver in host byte order, 0 for the
+      remote port of the connection */
+  uint16_t to_port;
+  const void *data;
+  uint16_t datalen;
+};
+
+/**
+ * \brief      Send several UDP packets in one go
+ * \param c    A pointer to a struct simple_udp_connection
+ * \param datagrams An array of datagrams to send
+ * \param count The number of datagrams in the array
+ * \return     The number of datagrams passed to the IP stack
+ *
+ *     This function sends the datagrams in order with the local
+ *     UDP port of the connection. The next hop towards a
+ *     destination is looked up once for consecutive datagrams
+ *     to it, so datagrams to the same receiver should be
+ *     placed next to each other.
+ *
+ * \sa simple_udp_sendto_port()
+ */
+int simple_udp_sendto_batch(struct simple_udp_connection *c,
+                            const struct simple_udp_datagram *datagrams,
+                            int count);
+
 void simple_udp_init(void);
 
 #endif /* SIMPLE_UDP_H */
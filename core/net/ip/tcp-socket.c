@@ -161,14 +161,14 @@ appcall(void *state)
 	   s->listen_port != 0 &&
 	   s->listen_port == uip_htons(uip_conn->lport)) {
 	  s->flags &= ~TCP_SOCKET_FLAGS_LISTENING;
-          s->output_data_max_seg = uip_mss();
+          s->output_data_max_seg = uip_mss() * UIP_TCP_SEND_SEGMENTS;
 	  tcp_markconn(uip_conn, s);
 	  call_event(s, TCP_SOCKET_CONNECTED);
 	  break;
 	}
       }
     } else {
-      s->output_data_max_seg = uip_mss();
+      s->output_data_max_seg = uip_mss() * UIP_TCP_SEND_SEGMENTS;
       call_event(s, TCP_SOCKET_CONNECTED);
     }
 
@@ -41,6 +41,9 @@
 #include "contiki-net.h"
 #include "net/ip/uip-split.h"
 #include "net/ip/uip-packetqueue.h"
+#include "lib/list.h"
+#include "lib/memb.h"
+#include "net/latency-trace.h"
 
 #if NETSTACK_CONF_WITH_IPV6
 #include "net/ipv6/uip-nd6.h"
@@ -85,6 +88,34 @@ process_event_t tcpip_icmp6_event;
 /* Periodic check of active connections. */
 static struct etimer periodic;
 
+/*
+ * Number of incoming packets that can wait for tcpip_process. When
+ * non-zero, tcpip_input() only queues the packet, so the driver can
+ * accept the next one while earlier packets are being processed. The
+ * packet is dropped if the queue is full. When zero, packets are
+ * processed directly from tcpip_input().
+ */
+#ifdef TCPIP_CONF_INPUT_QUEUE
+#define TCPIP_INPUT_QUEUE TCPIP_CONF_INPUT_QUEUE
+#else
+#define TCPIP_INPUT_QUEUE 0
+#endif
+
+#if TCPIP_INPUT_QUEUE
+struct input_packet {
+  struct input_packet *next;
+  /* The link-layer attributes and addresses of the packet, used for
+     example by ND and RPL when processing it */
+  struct packetbuf_attr attrs[PACKETBUF_NUM_ATTRS];
+  struct packetbuf_addr addrs[PACKETBUF_NUM_ADDRS];
+  uint16_t len;
+  uint8_t data[UIP_BUFSIZE];
+};
+
+MEMB(input_memb, struct input_packet, TCPIP_INPUT_QUEUE);
+LIST(input_list);
+#endif /* TCPIP_INPUT_QUEUE */
+
 #if NETSTACK_CONF_WITH_IPV6 && UIP_CONF_IPV6_REASSEMBLY
 /* Timer for reassembly. */
 extern struct etimer uip_reass_timer;
@@ -187,6 +218,17 @@ check_for_tcp_syn(void)
 #endif /* UIP_TCP || UIP_CONF_IP_FORWARD */
 }
 /*---------------------------------------------------------------------------*/
+#if NETSTACK_CONF_WITH_IPV6
+#if UIP_TCP && UIP_TCP_SEND_SEGMENTS > 1
+/* Send what uIP produced, breaking TCP segment trains up into
+   segments no larger than the MSS of the connection. */
+#define tcp_output() \
+  uip_split_segments_output(uip_conn != NULL ? uip_conn->initialmss : UIP_TCP_MSS)
+#else /* UIP_TCP && UIP_TCP_SEND_SEGMENTS > 1 */
+#define tcp_output() tcpip_ipv6_output()
+#endif /* UIP_TCP && UIP_TCP_SEND_SEGMENTS > 1 */
+#endif /* NETSTACK_CONF_WITH_IPV6 */
+/*---------------------------------------------------------------------------*/
 static void
 packet_input(void)
 {
@@ -208,7 +250,7 @@ packet_input(void)
       uip_split_output();
 #else /* UIP_CONF_TCP_SPLIT */
 #if NETSTACK_CONF_WITH_IPV6
-      tcpip_ipv6_output();
+      tcp_output();
 #else /* NETSTACK_CONF_WITH_IPV6 */
       PRINTF("tcpip packet_input output len %d\n", uip_len);
       tcpip_output();
@@ -218,6 +260,33 @@ packet_input(void)
   }
 }
 /*---------------------------------------------------------------------------*/
+#if TCPIP_INPUT_QUEUE
+/* Process the oldest queued packet, one per poll so that the drivers
+   can run in between */
+static void
+input_queue_process(void)
+{
+  struct input_packet *p;
+
+  p = list_pop(input_list);
+  if(p == NULL) {
+    return;
+  }
+
+  memcpy(uip_buf, p->data, p->len);
+  uip_len = p->len;
+  packetbuf_attr_copyfrom(p->attrs, p->addrs);
+  memb_free(&input_memb, p);
+
+  if(list_head(input_list) != NULL) {
+    process_poll(&tcpip_process);
+  }
+
+  packet_input();
+  uip_clear_buf();
+}
+#endif /* TCPIP_INPUT_QUEUE */
+/*---------------------------------------------------------------------------*/
 #if UIP_TCP
 #if UIP_ACTIVE_OPEN
 struct uip_conn *
@@ -428,7 +497,7 @@ eventhandler(process_event_t ev, process_data_t data)
           etimer_restart(&periodic);
           uip_periodic(i);
 #if NETSTACK_CONF_WITH_IPV6
-          tcpip_ipv6_output();
+          tcp_output();
 #else
           if(uip_len > 0) {
             PRINTF("tcpip_output from periodic len %d\n", uip_len);
@@ -485,7 +554,7 @@ eventhandler(process_event_t ev, process_data_t data)
     if(data != NULL) {
       uip_poll_conn(data);
 #if NETSTACK_CONF_WITH_IPV6
-      tcpip_ipv6_output();
+      tcp_output();
 #else /* NETSTACK_CONF_WITH_IPV6 */
       if(uip_len > 0) {
         PRINTF("tcpip_output from tcp poll len %d\n", uip_len);
@@ -515,17 +584,57 @@ eventhandler(process_event_t ev, process_data_t data)
   case PACKET_INPUT:
     packet_input();
     break;
+#if TCPIP_INPUT_QUEUE
+  case PROCESS_EVENT_POLL:
+    input_queue_process();
+    break;
+#endif /* TCPIP_INPUT_QUEUE */
   };
 }
 /*---------------------------------------------------------------------------*/
 void
 tcpip_input(void)
 {
+#if TCPIP_INPUT_QUEUE
+  struct input_packet *p;
+
+  p = memb_alloc(&input_memb);
+  if(p == NULL) {
+    UIP_LOG("tcpip_input: input queue full, dropping packet");
+  } else {
+    memcpy(p->data, uip_buf, uip_len);
+    p->len = uip_len;
+    packetbuf_attr_copyto(p->attrs, p->addrs);
+    list_add(input_list, p);
+    process_poll(&tcpip_process);
+  }
+#else /* TCPIP_INPUT_QUEUE */
   process_post_synch(&tcpip_process, PACKET_INPUT, NULL);
+#endif /* TCPIP_INPUT_QUEUE */
   uip_clear_buf();
 }
 /*---------------------------------------------------------------------------*/
 #if NETSTACK_CONF_WITH_IPV6
+/* The next hop of the last destination routed during a batch */
+static uint8_t batch_active;
+static uint8_t batch_valid;
+static uip_ipaddr_t batch_dest;
+static uip_ipaddr_t batch_nexthop;
+/*---------------------------------------------------------------------------*/
+void
+tcpip_ipv6_output_batch_begin(void)
+{
+  batch_active = 1;
+  batch_valid = 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+tcpip_ipv6_output_batch_end(void)
+{
+  batch_active = 0;
+  batch_valid = 0;
+}
+/*---------------------------------------------------------------------------*/
 void
 tcpip_ipv6_output(void)
 {
@@ -536,6 +645,8 @@ tcpip_ipv6_output(void)
     return;
   }
 
+  LATENCY_TRACE_STAMP(LATENCY_TRACE_IP_OUTPUT);
+
   if(uip_len > UIP_LINK_MTU) {
     UIP_LOG("tcpip_ipv6_output: Packet to big");
     uip_clear_buf();
@@ -570,6 +681,12 @@ tcpip_ipv6_output(void)
 
     nbr = NULL;
 
+    /* In a batch, reuse the next hop of the previous packet */
+    if(nexthop == NULL && batch_valid &&
+       uip_ipaddr_cmp(&batch_dest, &UIP_IP_BUF->destipaddr)) {
+      nexthop = &batch_nexthop;
+    }
+
     /* We first check if the destination address is on our immediate
        link. If so, we simply use the destination address as our
        nexthop address. */
@@ -660,7 +777,28 @@ tcpip_ipv6_output(void)
 
     /* End of next hop determination */
 
+    if(batch_active && nexthop != &batch_nexthop
+#if UIP_CONF_IPV6_RPL && RPL_WITH_NON_STORING
+       && nexthop != &ipaddr
+#endif /* UIP_CONF_IPV6_RPL && RPL_WITH_NON_STORING */
+       ) {
+      uip_ipaddr_copy(&batch_dest, &UIP_IP_BUF->destipaddr);
+      uip_ipaddr_copy(&batch_nexthop, nexthop);
+      batch_valid = 1;
+    }
+
     nbr = uip_ds6_nbr_lookup(nexthop);
+#if UIP_ND6_6LOWPAN
+    /* Link-local addresses are built from the MAC address, they need
+       no multicast address resolution (RFC 6775, 5.6) */
+    if(nbr == NULL && uip_is_addr_linklocal(nexthop)) {
+      uip_lladdr_t lladdr;
+      if(uip_ds6_set_lladdr_from_iid(&lladdr, nexthop)) {
+        nbr = uip_ds6_nbr_add(nexthop, &lladdr, 0, NBR_STALE,
+                              NBR_TABLE_REASON_IPV6_ND, NULL);
+      }
+    }
+#endif /* UIP_ND6_6LOWPAN */
     if(nbr == NULL) {
 #if UIP_ND6_SEND_NA
       if((nbr = uip_ds6_nbr_add(nexthop, NULL, 0, NBR_INCOMPLETE, NBR_TABLE_REASON_IPV6_ND, NULL)) == NULL) {
@@ -752,7 +890,7 @@ tcpip_ipv6_output(void)
 void
 tcpip_poll_udp(struct uip_udp_conn *conn)
 {
-  process_post(&tcpip_process, UDP_POLL, conn);
+  process_post_urgent_coalesce(&tcpip_process, UDP_POLL, conn);
 }
 #endif /* UIP_UDP */
 /*---------------------------------------------------------------------------*/
@@ -760,7 +898,7 @@ tcpip_poll_udp(struct uip_udp_conn *conn)
 void
 tcpip_poll_tcp(struct uip_conn *conn)
 {
-  process_post(&tcpip_process, TCP_POLL, conn);
+  process_post_urgent_coalesce(&tcpip_process, TCP_POLL, conn);
 }
 #endif /* UIP_TCP */
 /*---------------------------------------------------------------------------*/
@@ -811,8 +949,13 @@ tcpip_uipcall(void)
 /*---------------------------------------------------------------------------*/
 PROCESS_THREAD(tcpip_process, ev, data)
 {
+  static struct process_subscription exited_subscription;
+
   PROCESS_BEGIN();
 
+  /* The only broadcast event we handle */
+  process_subscribe(&exited_subscription, PROCESS_EVENT_EXITED);
+
 #if UIP_TCP
   {
     unsigned char i;
@@ -830,6 +973,11 @@ PROCESS_THREAD(tcpip_process, ev, data)
 #endif /* UIP_CONF_ICMP6 */
   etimer_set(&periodic, CLOCK_SECOND / 2);
 
+#if TCPIP_INPUT_QUEUE
+  memb_init(&input_memb);
+  list_init(input_list);
+#endif /* TCPIP_INPUT_QUEUE */
+
   uip_init();
 #ifdef UIP_FALLBACK_INTERFACE
   UIP_FALLBACK_INTERFACE.init();
@@ -353,6 +353,22 @@ void tcpip_set_outputfunc(uint8_t (* f)(void));
  */
 #if NETSTACK_CONF_WITH_IPV6
 void tcpip_ipv6_output(void);
+
+/**
+ * \brief Start sending a batch of packets
+ *
+ * Until tcpip_ipv6_output_batch_end() is called, tcpip_ipv6_output()
+ * reuses the next hop found for the previous packet when the next
+ * packet has the same destination, instead of looking it up again.
+ * Routes do not change during a batch, so it should not span a
+ * yield.
+ */
+void tcpip_ipv6_output_batch_begin(void);
+
+/**
+ * \brief End a batch started with tcpip_ipv6_output_batch_begin()
+ */
+void tcpip_ipv6_output_batch_end(void);
 #endif
 
 /**
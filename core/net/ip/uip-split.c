@@ -156,3 +156,51 @@ uip_split_output(void)
 }
 
 /*-----------------------------------------------------------------------------*/
+#if NETSTACK_CONF_WITH_IPV6 && UIP_TCP && UIP_TCP_SEND_SEGMENTS > 1
+/* Copy of the outgoing segment train. tcpip_ipv6_output() may modify
+   uip_buf (e.g., by inserting extension headers), so each segment is
+   rebuilt from this copy. */
+static uint8_t segment_buf[UIP_BUFSIZE - UIP_LLH_LEN];
+
+void
+uip_split_segments_output(uint16_t segsize)
+{
+  uint16_t hdrlen, datalen, offset, len;
+
+  hdrlen = UIP_IPH_LEN + ((BUF->tcpoffset >> 4) << 2);
+  if(BUF->proto != UIP_PROTO_TCP || segsize == 0 ||
+     uip_len <= hdrlen + segsize) {
+    tcpip_ipv6_output();
+    return;
+  }
+
+  datalen = uip_len - hdrlen;
+  memcpy(segment_buf, &uip_buf[UIP_LLH_LEN], uip_len);
+
+  for(offset = 0; offset < datalen; offset += len) {
+    len = MIN(segsize, datalen - offset);
+
+    memcpy(&uip_buf[UIP_LLH_LEN], segment_buf, hdrlen);
+    memcpy(&uip_buf[UIP_LLH_LEN + hdrlen], &segment_buf[hdrlen + offset], len);
+    uip_len = hdrlen + len;
+
+    /* For IPv6, the IP length field does not include the IPv6 IP header
+       length. */
+    BUF->len[0] = ((uip_len - UIP_IPH_LEN) >> 8);
+    BUF->len[1] = ((uip_len - UIP_IPH_LEN) & 0xff);
+
+    uip_add32(BUF->seqno, offset);
+    BUF->seqno[0] = uip_acc32[0];
+    BUF->seqno[1] = uip_acc32[1];
+    BUF->seqno[2] = uip_acc32[2];
+    BUF->seqno[3] = uip_acc32[3];
+
+    /* Recalculate the TCP checksum. */
+    BUF->tcpchksum = 0;
+    BUF->tcpchksum = ~(uip_tcpchksum());
+
+    tcpip_ipv6_output();
+  }
+}
+#endif /* NETSTACK_CONF_WITH_IPV6 && UIP_TCP && UIP_TCP_SEND_SEGMENTS > 1 */
+/*-----------------------------------------------------------------------------*/
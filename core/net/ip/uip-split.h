@@ -71,6 +71,8 @@
 #ifndef UIP_SPLIT_H_
 #define UIP_SPLIT_H_
 
+#include "net/ip/uip.h"
+
 /**
  * Handle outgoing packets.
  *
@@ -89,6 +91,19 @@
  */
 void uip_split_output(void);
 
+/**
+ * Transmit an outgoing TCP segment train as separate segments.
+ *
+ * \param segsize The largest amount of TCP data per segment
+ *
+ * This function sends the TCP segment in the uip_buf buffer using
+ * tcpip_ipv6_output(). If it carries more than segsize bytes of data,
+ * which happens when UIP_CONF_TCP_SEND_SEGMENTS is larger than one, it
+ * is sent as a train of consecutive segments of at most segsize bytes
+ * each. Other packets are sent unmodified.
+ */
+void uip_split_segments_output(uint16_t segsize);
+
 #endif /* UIP_SPLIT_H_ */
 
 /** @} */
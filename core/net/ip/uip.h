@@ -886,7 +886,11 @@ struct uip_udp_conn *uip_udp_new(const uip_ipaddr_t *ripaddr, uint16_t rport);
  *
  * \hideinitializer
  */
+#if NETSTACK_CONF_WITH_IPV6
+void uip_udp_bind(struct uip_udp_conn *conn, uint16_t port);
+#else /* NETSTACK_CONF_WITH_IPV6 */
 #define uip_udp_bind(conn, port) (conn)->lport = port
+#endif /* NETSTACK_CONF_WITH_IPV6 */
 
 /**
  * Send a UDP datagram of length len on the current connection.
@@ -1478,6 +1482,8 @@ struct uip_stats {
     uip_stats_t drop;     /**< Number of dropped ICMP packets. */
     uip_stats_t typeerr;  /**< Number of ICMP packets with a wrong type. */
     uip_stats_t chkerr;   /**< Number of ICMP packets with a bad checksum. */
+    uip_stats_t ratelimit;/**< Number of ICMP errors not sent because
+                               of rate limiting. */
   } icmp;                 /**< ICMP statistics. */
 #if UIP_TCP
   struct {
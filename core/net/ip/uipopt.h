@@ -421,6 +421,21 @@ void uip_log(char *msg);
 #define UIP_CONNS (UIP_CONF_MAX_CONNECTIONS)
 #endif /* UIP_CONF_MAX_CONNECTIONS */
 
+/**
+ * The number of chains of the local port index of the TCP and UDP
+ * connections (IPv6 only), used to demultiplex received segments and
+ * datagrams without going through all connections. Must be a power of
+ * two, or 0 to go through all connections instead. The index takes
+ * this many bytes, and two more per connection, for TCP and for UDP.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_PORT_HASH_SIZE
+#define UIP_PORT_HASH_SIZE (UIP_CONF_PORT_HASH_SIZE)
+#else /* UIP_CONF_PORT_HASH_SIZE */
+#define UIP_PORT_HASH_SIZE 8
+#endif /* UIP_CONF_PORT_HASH_SIZE */
+
 
 /**
  * The maximum number of simultaneously listening TCP ports.
@@ -485,6 +500,28 @@ void uip_log(char *msg);
 #define UIP_TCP_MSS     (UIP_BUFSIZE - UIP_LLH_LEN - UIP_TCPIP_HLEN)
 #endif /* UIP_CONF_TCP_MSS */
 
+/**
+ * The number of maximum-sized TCP segments that may be in flight at
+ * once on a connection.
+ *
+ * By default, uIP only allows a single unacknowledged segment, which
+ * limits bulk transfers to one MSS per round-trip time. When set
+ * higher, the application may send up to this many segments' worth
+ * of data at once (bounded by the peer's advertised window and by
+ * UIP_BUFSIZE), and the data is transmitted as a train of segments no
+ * larger than the connection's MSS. The data is still acknowledged
+ * and retransmitted as a whole. This requires an uip_buf that is
+ * several times larger than UIP_TCP_MSS, plus an equally large copy
+ * buffer, so it is only useful on platforms with plenty of RAM.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_SEND_SEGMENTS
+#define UIP_TCP_SEND_SEGMENTS (UIP_CONF_TCP_SEND_SEGMENTS)
+#else /* UIP_CONF_TCP_SEND_SEGMENTS */
+#define UIP_TCP_SEND_SEGMENTS 1
+#endif /* UIP_CONF_TCP_SEND_SEGMENTS */
+
 /**
  * The size of the advertised receiver's window.
  *
@@ -619,6 +656,22 @@ void uip_log(char *msg);
 #define UIP_BYTE_ORDER     (UIP_LITTLE_ENDIAN)
 #endif /* UIP_CONF_BYTE_ORDER */
 
+/**
+ * Accumulate the Internet checksum in 32 bits and fold the carries
+ * once at the end instead of after every 16-bit word.
+ *
+ * This is faster on 32-bit CPUs, but not on 8- and 16-bit CPUs where
+ * 32-bit additions are expensive. It has no effect if the platform
+ * provides its own checksum functions with UIP_ARCH_CHKSUM.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_CHKSUM_ACC32
+#define UIP_CHKSUM_ACC32   (UIP_CONF_CHKSUM_ACC32)
+#else /* UIP_CONF_CHKSUM_ACC32 */
+#define UIP_CHKSUM_ACC32   0
+#endif /* UIP_CONF_CHKSUM_ACC32 */
+
 /** @} */
 /*------------------------------------------------------------------------------*/
 
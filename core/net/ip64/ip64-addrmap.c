@@ -46,15 +46,142 @@
 #define NUM_ENTRIES 32
 #endif /* IP64_ADDRMAP_CONF_ENTRIES */
 
+/* Buckets of the hash tables on the connection tuple and on the
+   mapped port */
+#ifdef IP64_ADDRMAP_CONF_HASH_SIZE
+#define HASH_SIZE IP64_ADDRMAP_CONF_HASH_SIZE
+#else /* IP64_ADDRMAP_CONF_HASH_SIZE */
+#define HASH_SIZE 16
+#endif /* IP64_ADDRMAP_CONF_HASH_SIZE */
+
+/* The mappings are aged on a timer wheel of WHEEL_SLOTS slots, each
+   holding the mappings that expire within the same WHEEL_TICK. The
+   wheel should span the longest mapping lifetime, longer ones are
+   carried over from the last slot */
+#ifdef IP64_ADDRMAP_CONF_WHEEL_SLOTS
+#define WHEEL_SLOTS IP64_ADDRMAP_CONF_WHEEL_SLOTS
+#else /* IP64_ADDRMAP_CONF_WHEEL_SLOTS */
+#define WHEEL_SLOTS 32
+#endif /* IP64_ADDRMAP_CONF_WHEEL_SLOTS */
+
+#ifdef IP64_ADDRMAP_CONF_WHEEL_TICK
+#define WHEEL_TICK IP64_ADDRMAP_CONF_WHEEL_TICK
+#else /* IP64_ADDRMAP_CONF_WHEEL_TICK */
+#define WHEEL_TICK (CLOCK_SECOND * 10)
+#endif /* IP64_ADDRMAP_CONF_WHEEL_TICK */
+
 MEMB(entrymemb, struct ip64_addrmap_entry, NUM_ENTRIES);
 LIST(entrylist);
 
+static struct ip64_addrmap_entry *tuple_hash[HASH_SIZE];
+static struct ip64_addrmap_entry *port_hash[HASH_SIZE];
+
+/* Slot wheel_pos holds the mappings expiring in the WHEEL_TICK that
+   starts at wheel_time */
+static struct ip64_addrmap_entry *wheel[WHEEL_SLOTS];
+static uint8_t wheel_pos;
+static clock_time_t wheel_time;
+static uint8_t num_recyclable;
+
 #define FIRST_MAPPED_PORT 10000
 #define LAST_MAPPED_PORT  20000
 static uint16_t mapped_port = FIRST_MAPPED_PORT;
 
 #define printf(...)
 
+/*---------------------------------------------------------------------------*/
+static unsigned
+tuple_hash_index(const uip_ip6addr_t *ip6addr, uint16_t ip6port,
+                 const uip_ip4addr_t *ip4addr, uint16_t ip4port,
+                 uint8_t protocol)
+{
+  uint16_t h;
+  int i;
+
+  h = protocol ^ ip6port ^ ip4port ^ ip4addr->u16[0] ^ ip4addr->u16[1];
+  for(i = 0; i < 8; i++) {
+    h ^= ip6addr->u16[i];
+  }
+  return (h ^ (h >> 8)) % HASH_SIZE;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned
+port_hash_index(uint16_t port)
+{
+  return port % HASH_SIZE;
+}
+/*---------------------------------------------------------------------------*/
+static void
+wheel_remove(struct ip64_addrmap_entry *e)
+{
+  struct ip64_addrmap_entry **p;
+
+  if(e->age_slot >= WHEEL_SLOTS) {
+    /* Already taken off the wheel */
+    return;
+  }
+  for(p = &wheel[e->age_slot]; *p != NULL; p = &(*p)->age_next) {
+    if(*p == e) {
+      *p = e->age_next;
+      return;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t
+wheel_slot(struct ip64_addrmap_entry *e)
+{
+  clock_time_t offset;
+
+  /* Ticks from the start of the current slot until the mapping
+     expires */
+  offset = clock_time() - wheel_time;
+  if(!timer_expired(&e->timer)) {
+    offset += timer_remaining(&e->timer);
+  }
+  offset /= WHEEL_TICK;
+  if(offset >= WHEEL_SLOTS) {
+    offset = WHEEL_SLOTS - 1;
+  }
+  return (wheel_pos + offset) % WHEEL_SLOTS;
+}
+/*---------------------------------------------------------------------------*/
+static void
+wheel_insert(struct ip64_addrmap_entry *e)
+{
+  e->age_slot = wheel_slot(e);
+  e->age_next = wheel[e->age_slot];
+  wheel[e->age_slot] = e;
+}
+/*---------------------------------------------------------------------------*/
+static void
+remove_entry(struct ip64_addrmap_entry *e)
+{
+  struct ip64_addrmap_entry **p;
+
+  for(p = &tuple_hash[tuple_hash_index(&e->ip6addr, e->ip6port,
+                                       &e->ip4addr, e->ip4port,
+                                       e->protocol)];
+      *p != NULL; p = &(*p)->tuple_next) {
+    if(*p == e) {
+      *p = e->tuple_next;
+      break;
+    }
+  }
+  for(p = &port_hash[port_hash_index(e->mapped_port)];
+      *p != NULL; p = &(*p)->port_next) {
+    if(*p == e) {
+      *p = e->port_next;
+      break;
+    }
+  }
+  wheel_remove(e);
+  if(e->flags & FLAGS_RECYCLABLE) {
+    num_recyclable--;
+  }
+  list_remove(entrylist, e);
+  memb_free(&entrymemb, e);
+}
 /*---------------------------------------------------------------------------*/
 struct ip64_addrmap_entry *
 ip64_addrmap_list(void)
@@ -67,24 +194,60 @@ ip64_addrmap_init(void)
 {
   memb_init(&entrymemb);
   list_init(entrylist);
+  memset(tuple_hash, 0, sizeof(tuple_hash));
+  memset(port_hash, 0, sizeof(port_hash));
+  memset(wheel, 0, sizeof(wheel));
+  wheel_pos = 0;
+  wheel_time = clock_time();
+  num_recyclable = 0;
   mapped_port = FIRST_MAPPED_PORT;
 }
 /*---------------------------------------------------------------------------*/
 static void
-check_age(void)
+expire_slot(uint8_t slot)
 {
-  struct ip64_addrmap_entry *m;
+  struct ip64_addrmap_entry *m, **p;
 
-  /* Walk through the list of address mappings, throw away the ones
-     that are too old. */
-  m = list_head(entrylist);
-  while(m != NULL) {
+  p = &wheel[slot];
+  while(*p != NULL) {
+    m = *p;
     if(timer_expired(&m->timer)) {
-      list_remove(entrylist, m);
-      memb_free(&entrymemb, m);
-      m = list_head(entrylist);
+      *p = m->age_next;
+      m->age_slot = WHEEL_SLOTS;
+      remove_entry(m);
     } else {
-      m = list_item_next(m);
+      p = &m->age_next;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+check_age(void)
+{
+  struct ip64_addrmap_entry *m, *next;
+  uint8_t swept;
+
+  /* Turn the wheel up to the current time. The mappings of each slot
+     that is left behind have either expired, or were carried over
+     from the last slot and are put back on the wheel. */
+  for(swept = 0; clock_time() - wheel_time >= WHEEL_TICK; swept++) {
+    if(swept == WHEEL_SLOTS) {
+      /* All slots have been gone through, skip the remaining turns */
+      wheel_time += (clock_time() - wheel_time) / WHEEL_TICK * WHEEL_TICK;
+      break;
+    }
+    m = wheel[wheel_pos];
+    wheel[wheel_pos] = NULL;
+    wheel_pos = (wheel_pos + 1) % WHEEL_SLOTS;
+    wheel_time += WHEEL_TICK;
+    for(; m != NULL; m = next) {
+      next = m->age_next;
+      if(timer_expired(&m->timer)) {
+        m->age_slot = WHEEL_SLOTS;
+        remove_entry(m);
+      } else {
+        wheel_insert(m);
+      }
     }
   }
 }
@@ -94,20 +257,25 @@ recycle(void)
 {
   /* Find the oldest recyclable mapping and remove it. */
   struct ip64_addrmap_entry *m, *oldest;
+  uint8_t i;
 
-  /* Walk through the list of address mappings, throw away the ones
-     that are too old. */
+  if(num_recyclable == 0) {
+    return 0;
+  }
 
+  /* The wheel is sorted on the expiry times, so the oldest recyclable
+     mapping is in the first slot that has one. */
   oldest = NULL;
-  for(m = list_head(entrylist);
-      m != NULL;
-      m = list_item_next(m)) {
-    if(m->flags & FLAGS_RECYCLABLE) {
-      if(oldest == NULL) {
-        oldest = m;
-      } else {
-        if(timer_remaining(&m->timer) <
-           timer_remaining(&oldest->timer)) {
+  for(i = 0; i < WHEEL_SLOTS && oldest == NULL; i++) {
+    for(m = wheel[(wheel_pos + i) % WHEEL_SLOTS];
+        m != NULL;
+        m = m->age_next) {
+      if(m->flags & FLAGS_RECYCLABLE) {
+        if(oldest == NULL || timer_expired(&m->timer)) {
+          oldest = m;
+        } else if(!timer_expired(&oldest->timer) &&
+                  timer_remaining(&m->timer) <
+                  timer_remaining(&oldest->timer)) {
           oldest = m;
         }
       }
@@ -117,8 +285,7 @@ recycle(void)
   /* If we found an oldest recyclable entry, remove it and return
      non-zero. */
   if(oldest != NULL) {
-    list_remove(entrylist, oldest);
-    memb_free(&entrymemb, oldest);
+    remove_entry(oldest);
     return 1;
   }
 
@@ -137,7 +304,9 @@ ip64_addrmap_lookup(const uip_ip6addr_t *ip6addr,
   printf("lookup ip4port %d ip6port %d\n", uip_htons(ip4port),
 	 uip_htons(ip6port));
   check_age();
-  for(m = list_head(entrylist); m != NULL; m = list_item_next(m)) {
+  for(m = tuple_hash[tuple_hash_index(ip6addr, ip6port, ip4addr, ip4port,
+                                      protocol)];
+      m != NULL; m = m->tuple_next) {
     printf("protocol %d %d, ip4port %d %d, ip6port %d %d, ip4 %d ip6 %d\n",
 	   m->protocol, protocol,
 	   m->ip4port, ip4port,
@@ -149,6 +318,11 @@ ip64_addrmap_lookup(const uip_ip6addr_t *ip6addr,
        m->ip6port == ip6port &&
        uip_ip4addr_cmp(&m->ip4addr, ip4addr) &&
        uip_ip6addr_cmp(&m->ip6addr, ip6addr)) {
+      if(timer_expired(&m->timer)) {
+        /* Expired, but its slot has not been swept yet */
+        remove_entry(m);
+        return NULL;
+      }
       m->ip6to4++;
       return m;
     }
@@ -162,12 +336,17 @@ ip64_addrmap_lookup_port(uint16_t mapped_port, uint8_t protocol)
   struct ip64_addrmap_entry *m;
 
   check_age();
-  for(m = list_head(entrylist); m != NULL; m = list_item_next(m)) {
+  for(m = port_hash[port_hash_index(mapped_port)];
+      m != NULL; m = m->port_next) {
     printf("mapped port %d %d, protocol %d %d\n",
 	   m->mapped_port, mapped_port,
 	   m->protocol, protocol);
     if(m->mapped_port == mapped_port &&
        m->protocol == protocol) {
+      if(timer_expired(&m->timer)) {
+        remove_entry(m);
+        return NULL;
+      }
       m->ip4to6++;
       return m;
     }
@@ -182,6 +361,19 @@ increase_mapped_port(void)
     FIRST_MAPPED_PORT;
 }
 /*---------------------------------------------------------------------------*/
+static int
+mapped_port_in_use(uint16_t port)
+{
+  struct ip64_addrmap_entry *n;
+
+  for(n = port_hash[port_hash_index(port)]; n != NULL; n = n->port_next) {
+    if(n->mapped_port == port) {
+      return 1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
 struct ip64_addrmap_entry *
 ip64_addrmap_create(const uip_ip6addr_t *ip6addr,
 		    uint16_t ip6port,
@@ -190,9 +382,15 @@ ip64_addrmap_create(const uip_ip6addr_t *ip6addr,
 		    uint8_t protocol)
 {
   struct ip64_addrmap_entry *m;
+  unsigned h;
 
   check_age();
   m = memb_alloc(&entrymemb);
+  if(m == NULL) {
+    /* Mappings of the current slot may have expired already */
+    expire_slot(wheel_pos);
+    m = memb_alloc(&entrymemb);
+  }
   if(m == NULL) {
     /* We could not allocate an entry, try to recycle one and try to
        allocate again. */
@@ -214,21 +412,20 @@ ip64_addrmap_create(const uip_ip6addr_t *ip6addr,
     /* Pick a new, unused local port. First make sure that the
        mapped_port number does not belong to any active connection. If
        so, we keep increasing the mapped_port until we're free. */
-    {
-      struct ip64_addrmap_entry *n;
-      n = list_head(entrylist);
-      while(n != NULL) {
-	if(n->mapped_port == mapped_port) {
-	  increase_mapped_port();
-	  n = list_head(entrylist);
-	} else {
-	  n = list_item_next(m);
-	}
-      }
+    while(mapped_port_in_use(mapped_port)) {
+      increase_mapped_port();
     }
     m->mapped_port = mapped_port;
     increase_mapped_port();
 
+    h = tuple_hash_index(ip6addr, ip6port, ip4addr, ip4port, protocol);
+    m->tuple_next = tuple_hash[h];
+    tuple_hash[h] = m;
+    h = port_hash_index(m->mapped_port);
+    m->port_next = port_hash[h];
+    port_hash[h] = m;
+    wheel_insert(m);
+
     list_add(entrylist, m);
     return m;
   }
@@ -241,14 +438,20 @@ ip64_addrmap_set_lifetime(struct ip64_addrmap_entry *e,
 {
   if(e != NULL) {
     timer_set(&e->timer, time);
+    /* Mappings refreshed by their traffic mostly stay in their slot */
+    if(wheel_slot(e) != e->age_slot) {
+      wheel_remove(e);
+      wheel_insert(e);
+    }
   }
 }
 /*---------------------------------------------------------------------------*/
 void
 ip64_addrmap_set_recycleble(struct ip64_addrmap_entry *e)
 {
-  if(e != NULL) {
+  if(e != NULL && !(e->flags & FLAGS_RECYCLABLE)) {
     e->flags |= FLAGS_RECYCLABLE;
+    num_recyclable++;
   }
 }
 /*---------------------------------------------------------------------------*/
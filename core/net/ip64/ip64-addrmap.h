@@ -38,6 +38,8 @@
 
 struct ip64_addrmap_entry {
   struct ip64_addrmap_entry *next;
+  /* Chains of the lookup hash tables and of the aging wheel */
+  struct ip64_addrmap_entry *tuple_next, *port_next, *age_next;
   struct timer timer;
   uip_ip6addr_t ip6addr;
   uip_ip4addr_t ip4addr;
@@ -47,6 +49,7 @@ struct ip64_addrmap_entry {
   uint16_t ip4port;
   uint8_t protocol;
   uint8_t flags;
+  uint8_t age_slot;
 };
 
 #define FLAGS_NONE       0
@@ -45,6 +45,7 @@
 #include "net/ipv6/multicast/uip-mcast6.h"
 #include "net/ipv6/multicast/uip-mcast6-route.h"
 #include "net/ipv6/multicast/uip-mcast6-stats.h"
+#include "net/ipv6/multicast/uip-mcast6-dup.h"
 #include "net/ipv6/multicast/esmrf.h"
 #include "net/rpl/rpl.h"
 #include "net/ip/uip.h"
@@ -307,6 +308,15 @@ in()
   }
 
   UIP_MCAST6_STATS_ADD(mcast_in_all);
+
+  /* Drop copies of a datagram we have already seen, e.g. from a previous
+   * preferred parent */
+  if(uip_mcast6_dup_check()) {
+    PRINTF("ESMRF: Duplicate, dropped\n");
+    UIP_MCAST6_STATS_ADD(mcast_dup);
+    return UIP_MCAST6_DROP;
+  }
+
   UIP_MCAST6_STATS_ADD(mcast_in_unique);
 
   /* If we have an entry in the mcast routing table, something with
@@ -367,6 +377,7 @@ static void
 init()
 {
   UIP_MCAST6_STATS_INIT(NULL);
+  uip_mcast6_dup_init();
   uip_mcast6_route_init();
   /* Register the ICMPv6 input handler */
   uip_icmp6_register_input_handler(&esmrf_icmp_handler);
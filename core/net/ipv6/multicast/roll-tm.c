@@ -46,6 +46,7 @@
 #include "net/ipv6/uip-icmp6.h"
 #include "net/ipv6/multicast/uip-mcast6.h"
 #include "net/ipv6/multicast/roll-tm.h"
+#include "lib/trickle-timer.h"
 #include "dev/watchdog.h"
 #include <string.h>
 
@@ -195,6 +196,9 @@ struct trickle_param {
 /*---------------------------------------------------------------------------*/
 /* Sliding Windows */
 struct sliding_window {
+#if ROLL_TM_WIN_HASH_SIZE
+  struct sliding_window *hash_next;
+#endif
   seed_id_t seed_id;
   int16_t lower_bound;          /* lolipop */
   int16_t upper_bound;          /* lolipop */
@@ -225,7 +229,6 @@ struct sliding_window {
  * w: pointer to a sliding window
  */
 #define SLIDING_WINDOW_IS_USED_CLR(w) ((w)->flags &= ~SLIDING_WINDOW_U_BIT)
-#define window_free(w) SLIDING_WINDOW_IS_USED_CLR(w)
 
 /**
  * \brief Set 'Is Seen' bit for window w
@@ -442,6 +445,9 @@ static struct roll_tm_stats stats;
 /*---------------------------------------------------------------------------*/
 static struct trickle_param t[2];
 static struct sliding_window windows[ROLL_TM_WINS];
+#if ROLL_TM_WIN_HASH_SIZE
+static struct sliding_window *window_hash[ROLL_TM_WIN_HASH_SIZE];
+#endif
 static struct mcast_packet buffered_msgs[ROLL_TM_BUFF_NUM];
 /*---------------------------------------------------------------------------*/
 /* Temporary Stores */
@@ -471,6 +477,7 @@ extern uint16_t uip_slen;
 static void icmp_input(void);
 static void icmp_output(void);
 static void window_update_bounds(void);
+static void window_free(struct sliding_window *);
 static void reset_trickle_timer(uint8_t);
 static void handle_timer(void *);
 /*---------------------------------------------------------------------------*/
@@ -514,6 +521,8 @@ double_interval(void *ptr)
   param->t_end = param->t_start + (param->i_min << param->i_current);
 
   next = random_interval(param->i_min, param->i_current);
+  next = trickle_timer_align(param->t_start, next,
+                             param->t_end - param->t_start);
   if(next > offset) {
     next -= offset;
   } else {
@@ -673,6 +682,8 @@ reset_trickle_timer(uint8_t index)
   t[index].i_current = 0;
   t[index].c = 0;
   t[index].t_next = random_interval(t[index].i_min, t[index].i_current);
+  t[index].t_next = trickle_timer_align(t[index].t_start, t[index].t_next,
+                                        t[index].i_min);
 
   VERBOSE_PRINTF
     ("ROLL TM: M=%u Reset at %lu, Start %lu, End %lu, New Interval %lu\n",
@@ -698,9 +709,56 @@ window_allocate()
   return NULL;
 }
 /*---------------------------------------------------------------------------*/
+#if ROLL_TM_WIN_HASH_SIZE
+static uint8_t
+window_hash_index(const seed_id_t *s, uint8_t m)
+{
+  const uint8_t *p = (const uint8_t *)s;
+  uint8_t h = m;
+  uint8_t i;
+
+  /* Seeds of the same lowpan differ mostly in their last bytes */
+  for(i = sizeof(seed_id_t) > 4 ? sizeof(seed_id_t) - 4 : 0;
+      i < sizeof(seed_id_t); i++) {
+    h = (h << 3) ^ (h >> 5) ^ p[i];
+  }
+  return h % ROLL_TM_WIN_HASH_SIZE;
+}
+#endif
+/*---------------------------------------------------------------------------*/
+static void
+window_free(struct sliding_window *w)
+{
+#if ROLL_TM_WIN_HASH_SIZE
+  struct sliding_window **prev;
+
+  if(SLIDING_WINDOW_IS_USED(w)) {
+    prev = &window_hash[window_hash_index(&w->seed_id,
+                                          SLIDING_WINDOW_GET_M(w))];
+    for(; *prev != NULL; prev = &(*prev)->hash_next) {
+      if(*prev == w) {
+        *prev = w->hash_next;
+        break;
+      }
+    }
+  }
+#endif
+  SLIDING_WINDOW_IS_USED_CLR(w);
+}
+/*---------------------------------------------------------------------------*/
 static struct sliding_window *
 window_lookup(seed_id_t *s, uint8_t m)
 {
+#if ROLL_TM_WIN_HASH_SIZE
+  for(iterswptr = window_hash[window_hash_index(s, m)]; iterswptr != NULL;
+      iterswptr = iterswptr->hash_next) {
+    if(seed_id_cmp(s, &iterswptr->seed_id) &&
+       SLIDING_WINDOW_GET_M(iterswptr) == m) {
+      return iterswptr;
+    }
+  }
+  return NULL;
+#else
   for(iterswptr = &windows[ROLL_TM_WINS - 1]; iterswptr >= windows;
       iterswptr--) {
     VERBOSE_PRINTF("ROLL TM: M=%u (%u) ", SLIDING_WINDOW_GET_M(iterswptr), m);
@@ -712,6 +770,7 @@ window_lookup(seed_id_t *s, uint8_t m)
     }
   }
   return NULL;
+#endif
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -741,40 +800,28 @@ window_update_bounds()
   }
 }
 /*---------------------------------------------------------------------------*/
+/* Free the oldest buffered message of window sw and return its buffer */
 static struct mcast_packet *
-buffer_reclaim()
+window_reclaim(struct sliding_window *sw)
 {
-  struct sliding_window *largest = windows;
   struct mcast_packet *rv;
 
-  for(iterswptr = &windows[ROLL_TM_WINS - 1]; iterswptr >= windows;
-      iterswptr--) {
-    if(iterswptr->count > largest->count) {
-      largest = iterswptr;
-    }
-  }
-
-  if(largest->count == 1) {
-    /* Can't reclaim last entry for a window and this is the largest window */
-    return NULL;
-  }
-
   PRINTF("ROLL TM: Reclaim from Seed ");
-  PRINT_SEED(&largest->seed_id);
+  PRINT_SEED(&sw->seed_id);
   PRINTF(" M=%u, count was %u\n",
-         SLIDING_WINDOW_GET_M(largest), largest->count);
-  /* Find the packet at the lowest bound for the largest window */
+         SLIDING_WINDOW_GET_M(sw), sw->count);
+  /* Find the packet at the lowest bound of the window */
   for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
       locmpptr >= buffered_msgs; locmpptr--) {
-    if(MCAST_PACKET_IS_USED(locmpptr) && (locmpptr->sw == largest) &&
-       SEQ_VAL_IS_EQ(locmpptr->seq_val, largest->lower_bound)) {
+    if(MCAST_PACKET_IS_USED(locmpptr) && (locmpptr->sw == sw) &&
+       SEQ_VAL_IS_EQ(locmpptr->seq_val, sw->lower_bound)) {
       rv = locmpptr;
       PRINTF("ROLL TM: Reclaim seq. val %u\n", locmpptr->seq_val);
       MCAST_PACKET_FREE(rv);
-      largest->count--;
+      sw->count--;
       window_update_bounds();
       VERBOSE_PRINTF("ROLL TM: Reclaim - new bounds [%u , %u]\n",
-                     largest->lower_bound, largest->upper_bound);
+                     sw->lower_bound, sw->upper_bound);
       return rv;
     }
   }
@@ -784,6 +831,26 @@ buffer_reclaim()
 }
 /*---------------------------------------------------------------------------*/
 static struct mcast_packet *
+buffer_reclaim()
+{
+  struct sliding_window *largest = windows;
+
+  for(iterswptr = &windows[ROLL_TM_WINS - 1]; iterswptr >= windows;
+      iterswptr--) {
+    if(iterswptr->count > largest->count) {
+      largest = iterswptr;
+    }
+  }
+
+  if(largest->count == 1) {
+    /* Can't reclaim last entry for a window and this is the largest window */
+    return NULL;
+  }
+
+  return window_reclaim(largest);
+}
+/*---------------------------------------------------------------------------*/
+static struct mcast_packet *
 buffer_allocate()
 {
   for(locmpptr = &buffered_msgs[ROLL_TM_BUFF_NUM - 1];
@@ -1008,10 +1075,19 @@ accept(uint8_t in)
   }
 
   /* Allocate a buffer */
-  locmpptr = buffer_allocate();
-  if(!locmpptr) {
-    PRINTF("ROLL TM: Buffer allocation failed, reclaiming\n");
-    locmpptr = buffer_reclaim();
+#if ROLL_TM_BUFF_PER_SEED
+  if(locswptr->count >= ROLL_TM_BUFF_PER_SEED) {
+    /* This seed has used up its share, replace its oldest message */
+    PRINTF("ROLL TM: Seed over quota, reclaiming\n");
+    locmpptr = window_reclaim(locswptr);
+  } else
+#endif
+  {
+    locmpptr = buffer_allocate();
+    if(!locmpptr) {
+      PRINTF("ROLL TM: Buffer allocation failed, reclaiming\n");
+      locmpptr = buffer_reclaim();
+    }
   }
 
   if(!locmpptr) {
@@ -1020,9 +1096,9 @@ accept(uint8_t in)
     PRINTF("ROLL TM: Buffer reclaim failed\n");
     if(locswptr->count == 0) {
       window_free(locswptr);
-      UIP_MCAST6_STATS_ADD(mcast_dropped);
-      return UIP_MCAST6_DROP;
     }
+    UIP_MCAST6_STATS_ADD(mcast_dropped);
+    return UIP_MCAST6_DROP;
   }
 #if UIP_MCAST6_STATS
   if(in == ROLL_TM_DGRAM_IN) {
@@ -1032,6 +1108,12 @@ accept(uint8_t in)
 
   /* We have a window and we have a buffer. Accept this message */
   /* Set the seed ID and correct M for this window */
+#if ROLL_TM_WIN_HASH_SIZE
+  if(!SLIDING_WINDOW_IS_USED(locswptr)) {
+    locswptr->hash_next = window_hash[window_hash_index(seed_ptr, m)];
+    window_hash[window_hash_index(seed_ptr, m)] = locswptr;
+  }
+#endif
   SLIDING_WINDOW_M_CLR(locswptr);
   if(m) {
     SLIDING_WINDOW_M_SET(locswptr);
@@ -1414,6 +1496,9 @@ init()
   PRINTF("ROLL TM: ROLL Multicast - Draft #%u\n", ROLL_TM_VER);
 
   memset(windows, 0, sizeof(windows));
+#if ROLL_TM_WIN_HASH_SIZE
+  memset(window_hash, 0, sizeof(window_hash));
+#endif
   memset(buffered_msgs, 0, sizeof(buffered_msgs));
   memset(t, 0, sizeof(t));
 
@@ -187,6 +187,29 @@
 #define ROLL_TM_BUFF_NUM 6
 #endif
 /*---------------------------------------------------------------------------*/
+/**
+ * Maximum Number of Buffered Messages per Sliding Window
+ * Once a seed has this many messages buffered, a new message from it
+ * replaces its oldest one instead of taking a slot from another seed.
+ * 0: No per-seed limit (default)
+ */
+#ifdef ROLL_TM_CONF_BUFF_PER_SEED
+#define ROLL_TM_BUFF_PER_SEED ROLL_TM_CONF_BUFF_PER_SEED
+#else
+#define ROLL_TM_BUFF_PER_SEED 0
+#endif
+/*---------------------------------------------------------------------------*/
+/**
+ * Number of buckets in the hash table of Sliding Windows by Seed ID
+ * Speeds up window lookups when many seeds are active. 0: Search the windows
+ * linearly (default)
+ */
+#ifdef ROLL_TM_CONF_WIN_HASH_SIZE
+#define ROLL_TM_WIN_HASH_SIZE ROLL_TM_CONF_WIN_HASH_SIZE
+#else
+#define ROLL_TM_WIN_HASH_SIZE 0
+#endif
+/*---------------------------------------------------------------------------*/
 /**
  * Use Short Seed IDs [short: 2, long: 16 (default)]
  * It can be argued that we should (and it would be easy to) support both at
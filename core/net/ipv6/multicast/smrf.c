@@ -46,6 +46,7 @@
 #include "net/ipv6/multicast/uip-mcast6.h"
 #include "net/ipv6/multicast/uip-mcast6-route.h"
 #include "net/ipv6/multicast/uip-mcast6-stats.h"
+#include "net/ipv6/multicast/uip-mcast6-dup.h"
 #include "net/ipv6/multicast/smrf.h"
 #include "net/rpl/rpl.h"
 #include "net/netstack.h"
@@ -131,6 +132,15 @@ in()
   }
 
   UIP_MCAST6_STATS_ADD(mcast_in_all);
+
+  /* Drop copies of a datagram we have already seen, e.g. from a previous
+   * preferred parent */
+  if(uip_mcast6_dup_check()) {
+    PRINTF("SMRF: Duplicate, dropped\n");
+    UIP_MCAST6_STATS_ADD(mcast_dup);
+    return UIP_MCAST6_DROP;
+  }
+
   UIP_MCAST6_STATS_ADD(mcast_in_unique);
 
   /* If we have an entry in the mcast routing table, something with
@@ -192,6 +202,7 @@ init()
 {
   UIP_MCAST6_STATS_INIT(NULL);
 
+  uip_mcast6_dup_init();
   uip_mcast6_route_init();
 }
 /*---------------------------------------------------------------------------*/
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * \addtogroup uip6-multicast
+ * @{
+ */
+/**
+ * \file
+ *    Duplicate suppression cache shared by the multicast forwarding engines
+ */
+#include "contiki.h"
+#include "net/ip/uip.h"
+#include "net/ipv6/multicast/uip-mcast6-dup.h"
+#include "lib/crc16.h"
+
+#include <string.h>
+/*---------------------------------------------------------------------------*/
+#if UIP_MCAST6_DUP_CACHE_SIZE
+struct dup_entry {
+  clock_time_t time;
+  uint16_t len;
+  uint16_t crc;
+};
+
+static struct dup_entry cache[UIP_MCAST6_DUP_CACHE_SIZE];
+static uint8_t next;
+/*---------------------------------------------------------------------------*/
+#define UIP_IP_BUF ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
+#define HOP_LIMIT_OFFSET 7
+/*---------------------------------------------------------------------------*/
+uint8_t
+uip_mcast6_dup_check(void)
+{
+  const uint8_t *ip = (const uint8_t *)UIP_IP_BUF;
+  uint16_t len;
+  uint16_t crc;
+  clock_time_t now;
+  uint8_t i;
+
+  len = uip_len - UIP_LLH_LEN;
+
+  /* The hop limit differs between copies received from different parents */
+  crc = crc16_data(ip, HOP_LIMIT_OFFSET, 0);
+  crc = crc16_data(ip + HOP_LIMIT_OFFSET + 1, len - HOP_LIMIT_OFFSET - 1, crc);
+
+  now = clock_time();
+  for(i = 0; i < UIP_MCAST6_DUP_CACHE_SIZE; i++) {
+    if(cache[i].len == len && cache[i].crc == crc &&
+       (clock_time_t)(now - cache[i].time) < UIP_MCAST6_DUP_LIFETIME) {
+      return 1;
+    }
+  }
+
+  /* Replace the oldest entry */
+  cache[next].time = now;
+  cache[next].len = len;
+  cache[next].crc = crc;
+  next = (next + 1) % UIP_MCAST6_DUP_CACHE_SIZE;
+
+  return 0;
+}
+#endif /* UIP_MCAST6_DUP_CACHE_SIZE */
+/*---------------------------------------------------------------------------*/
+void
+uip_mcast6_dup_init(void)
+{
+#if UIP_MCAST6_DUP_CACHE_SIZE
+  memset(cache, 0, sizeof(cache));
+  next = 0;
+#endif /* UIP_MCAST6_DUP_CACHE_SIZE */
+}
+/*---------------------------------------------------------------------------*/
+/** @} */
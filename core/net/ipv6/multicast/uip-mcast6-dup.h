@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * \addtogroup uip6-multicast
+ * @{
+ */
+/**
+ * \file
+ *    Header file for the duplicate suppression cache shared by the
+ *    multicast forwarding engines
+ *
+ *    SMRF and ESMRF datagrams carry no sequence number. A datagram is
+ *    identified by a checksum over its IPv6 header (without the hop limit)
+ *    and its payload, so that a copy received again after a parent switch
+ *    is recognised and neither forwarded nor delivered twice.
+ */
+#ifndef UIP_MCAST6_DUP_H_
+#define UIP_MCAST6_DUP_H_
+
+#include "contiki.h"
+
+#include <stdint.h>
+/*---------------------------------------------------------------------------*/
+/**
+ * Number of recently seen datagrams remembered. 0: Disable the cache
+ * (default)
+ */
+#ifdef UIP_MCAST6_CONF_DUP_CACHE_SIZE
+#define UIP_MCAST6_DUP_CACHE_SIZE UIP_MCAST6_CONF_DUP_CACHE_SIZE
+#else
+#define UIP_MCAST6_DUP_CACHE_SIZE 0
+#endif
+
+/**
+ * For how long a datagram is remembered, in clock ticks. An application
+ * sending the same datagram again after this time will not be suppressed
+ */
+#ifdef UIP_MCAST6_CONF_DUP_LIFETIME
+#define UIP_MCAST6_DUP_LIFETIME UIP_MCAST6_CONF_DUP_LIFETIME
+#else
+#define UIP_MCAST6_DUP_LIFETIME (2 * CLOCK_SECOND)
+#endif
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Check whether the datagram in uip_buf has been seen recently
+ * \retval 1 The datagram is a duplicate
+ * \retval 0 The datagram has not been seen before and has been recorded
+ *
+ * Always returns 0 when the cache is disabled
+ */
+#if UIP_MCAST6_DUP_CACHE_SIZE
+uint8_t uip_mcast6_dup_check(void);
+#else
+#define uip_mcast6_dup_check() 0
+#endif
+
+/**
+ * \brief Forget all datagrams seen
+ */
+void uip_mcast6_dup_init(void);
+/*---------------------------------------------------------------------------*/
+#endif /* UIP_MCAST6_DUP_H_ */
+/*---------------------------------------------------------------------------*/
+/** @} */
@@ -69,6 +69,15 @@
 #include "net/rime/rime.h"
 #include "net/ipv6/sicslowpan.h"
 #include "net/netstack.h"
+#include "net/net-stats.h"
+#include "net/latency-trace.h"
+#include "lib/memb.h"
+#include "sys/compower.h"
+#include "sys/trace.h"
+#if UIP_CONF_IPV6_RPL
+#include "net/rpl/rpl.h"
+#include "net/rpl/rpl-dag-root.h"
+#endif /* UIP_CONF_IPV6_RPL */
 
 #include <stdio.h>
 
@@ -213,6 +222,27 @@ static int last_tx_status;
 
 static int last_rssi;
 
+enum {
+  STATS_TX, STATS_RX, STATS_FRAG_TX, STATS_FRAG_TX_ERR, STATS_FRAG_RX,
+  STATS_REASSEMBLED, STATS_REASS_TIMEOUT, STATS_REASS_EVICTED,
+  STATS_REASS_DROP, STATS_NUM
+};
+#if NET_STATS_ENABLED
+static uint32_t stats[STATS_NUM];
+static const char * const stats_names[STATS_NUM] = {
+  "tx", "rx", "frag_tx", "frag_tx_err", "frag_rx",
+  "reassembled", "reass_timeout", "reass_evicted", "reass_drop"
+};
+static uint32_t
+stats_get(uint8_t index)
+{
+  return stats[index];
+}
+static struct net_stats_group stats_group = {
+  NULL, "sicslowpan", stats_names, STATS_NUM, stats_get
+};
+#endif /* NET_STATS_ENABLED */
+
 /* ----------------------------------------------------------------- */
 /* Support for reassembling multiple packets                         */
 /* ----------------------------------------------------------------- */
@@ -241,6 +271,16 @@ static uint16_t my_tag;
 #define SICSLOWPAN_REASS_CONTEXTS 2
 #endif
 
+/* The number of reassembly contexts a single link-layer sender may
+ * hold. When a sender is at its quota, a new datagram from it evicts
+ * its own least complete one instead of another sender's.
+ **/
+#ifdef SICSLOWPAN_CONF_REASS_CONTEXTS_PER_SENDER
+#define SICSLOWPAN_REASS_CONTEXTS_PER_SENDER SICSLOWPAN_CONF_REASS_CONTEXTS_PER_SENDER
+#else
+#define SICSLOWPAN_REASS_CONTEXTS_PER_SENDER ((SICSLOWPAN_REASS_CONTEXTS + 1) / 2)
+#endif
+
 /* The size of each fragment (IP payload) for the 6lowpan fragmentation */
 #ifdef SICSLOWPAN_CONF_FRAGMENT_SIZE
 #define SICSLOWPAN_FRAGMENT_SIZE SICSLOWPAN_CONF_FRAGMENT_SIZE
@@ -265,6 +305,8 @@ struct sicslowpan_frag_info {
   uint16_t reassembled_len;
   /** Reassembly %process %timer. */
   struct timer reass_timer;
+  /** The fragments received after the first one */
+  struct sicslowpan_frag_buf *frags;
 
   /** Fragment size of first fragment */
   uint16_t first_frag_len;
@@ -276,30 +318,74 @@ struct sicslowpan_frag_info {
 static struct sicslowpan_frag_info frag_info[SICSLOWPAN_REASS_CONTEXTS];
 
 struct sicslowpan_frag_buf {
-  /* the index of the frag_info */
-  uint8_t index;
+  struct sicslowpan_frag_buf *next;
   /* Fragment offset */
   uint8_t offset;
-  /* Length of this fragment (if zero this buffer is not allocated) */
+  /* Length of this fragment */
   uint8_t len;
   uint8_t data[SICSLOWPAN_FRAGMENT_SIZE];
 };
 
-static struct sicslowpan_frag_buf frag_buf[SICSLOWPAN_FRAGMENT_BUFFERS];
+MEMB(frag_buf_memb, struct sicslowpan_frag_buf, SICSLOWPAN_FRAGMENT_BUFFERS);
+
+/* Attributes of the packet being fragmented, restored before each
+   fragment since the MAC layer may change them while sending. */
+static struct packetbuf_attr frag_attrs[PACKETBUF_NUM_ATTRS];
+static struct packetbuf_addr frag_addrs[PACKETBUF_NUM_ADDRS];
+
+/*
+ * Fragment forwarding: a router relays the fragments of a datagram that
+ * is not for itself as they arrive, instead of reassembling it first.
+ * The first fragment is recompressed for the next hop and sent with a
+ * new tag, the following fragments are relayed with only the tag
+ * rewritten. Datagrams with extension headers that need more than an
+ * in-place update are still reassembled.
+ */
+#ifdef SICSLOWPAN_CONF_FRAG_FORWARDING
+#define SICSLOWPAN_FRAG_FORWARDING (SICSLOWPAN_CONF_FRAG_FORWARDING && UIP_CONF_ROUTER)
+#else
+#define SICSLOWPAN_FRAG_FORWARDING 0
+#endif
+
+/* Number of datagrams that can be forwarded at the same time */
+#ifdef SICSLOWPAN_CONF_FRAG_FORWARD_ENTRIES
+#define SICSLOWPAN_FRAG_FORWARD_ENTRIES SICSLOWPAN_CONF_FRAG_FORWARD_ENTRIES
+#else
+#define SICSLOWPAN_FRAG_FORWARD_ENTRIES 4
+#endif
+
+#if SICSLOWPAN_FRAG_FORWARDING
+/* maps (sender, tag) of a datagram being forwarded to (next hop, tag) */
+struct sicslowpan_frag_fwd {
+  linkaddr_t sender;
+  linkaddr_t nexthop;
+  uint16_t tag;
+  uint16_t new_tag;
+  /** Total length of the datagram, 0 if the entry is not used */
+  uint16_t len;
+  /** Number of bytes of the datagram forwarded so far */
+  uint16_t forwarded_len;
+  struct timer timer;
+};
+
+static struct sicslowpan_frag_fwd frag_fwd[SICSLOWPAN_FRAG_FORWARD_ENTRIES];
+#endif /* SICSLOWPAN_FRAG_FORWARDING */
 
 /*---------------------------------------------------------------------------*/
 static int
 clear_fragments(uint8_t frag_info_index)
 {
-  int i, clear_count;
+  struct sicslowpan_frag_buf *buf;
+  int clear_count;
+
   clear_count = 0;
   frag_info[frag_info_index].len = 0;
-  for(i = 0; i < SICSLOWPAN_FRAGMENT_BUFFERS; i++) {
-    if(frag_buf[i].len > 0 && frag_buf[i].index == frag_info_index) {
-      /* deallocate the buffer */
-      frag_buf[i].len = 0;
-      clear_count++;
-    }
+  while(frag_info[frag_info_index].frags != NULL) {
+    /* deallocate the buffer */
+    buf = frag_info[frag_info_index].frags;
+    frag_info[frag_info_index].frags = buf->next;
+    memb_free(&frag_buf_memb, buf);
+    clear_count++;
   }
   return clear_count;
 }
@@ -313,32 +399,72 @@ timeout_fragments(int not_context)
     if(frag_info[i].len > 0 && i != not_context &&
        timer_expired(&frag_info[i].reass_timer)) {
       /* This context can be freed */
+      NET_STATS_ADD(stats, STATS_REASS_TIMEOUT);
       count += clear_fragments(i);
     }
   }
   return count;
 }
 /*---------------------------------------------------------------------------*/
+/* Is context a further from completion than context b? */
 static int
-store_fragment(uint8_t index, uint8_t offset)
+less_complete(int a, int b)
+{
+  return (uint32_t)frag_info[a].reassembled_len * frag_info[b].len <
+    (uint32_t)frag_info[b].reassembled_len * frag_info[a].len;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Find the least complete reassembly to give up, other than
+ * not_context. If sender is non-NULL only its reassemblies are
+ * considered. If with_buffers is set only reassemblies holding
+ * fragment buffers are considered.
+ */
+static int
+evict_candidate(int not_context, const linkaddr_t *sender, int with_buffers)
 {
   int i;
-  for(i = 0; i < SICSLOWPAN_FRAGMENT_BUFFERS; i++) {
-    if(frag_buf[i].len == 0) {
-      /* copy over the data from packetbuf into the fragment buffer and store offset and len */
-      frag_buf[i].offset = offset; /* frag offset */
-      frag_buf[i].len = packetbuf_datalen() - packetbuf_hdr_len;
-      frag_buf[i].index = index;
-      memcpy(frag_buf[i].data, packetbuf_ptr + packetbuf_hdr_len,
-             packetbuf_datalen() - packetbuf_hdr_len);
-
-      PRINTF("Fragsize: %d\n", frag_buf[i].len);
-      /* return the length of the stored fragment */
-      return frag_buf[i].len;
+  int found = -1;
+
+  for(i = 0; i < SICSLOWPAN_REASS_CONTEXTS; i++) {
+    if(frag_info[i].len == 0 || i == not_context) {
+      continue;
+    }
+    if(sender != NULL && !linkaddr_cmp(&frag_info[i].sender, sender)) {
+      continue;
     }
+    if(with_buffers && frag_info[i].frags == NULL) {
+      continue;
+    }
+    if(found < 0 || less_complete(i, found)) {
+      found = i;
+    }
+  }
+  return found;
+}
+/*---------------------------------------------------------------------------*/
+static int
+store_fragment(uint8_t index, uint8_t offset)
+{
+  struct sicslowpan_frag_buf *buf;
+
+  buf = memb_alloc(&frag_buf_memb);
+  if(buf == NULL) {
+    /* failed */
+    return -1;
   }
-  /* failed */
-  return -1;
+
+  /* copy over the data from packetbuf into the fragment buffer and store offset and len */
+  buf->offset = offset; /* frag offset */
+  buf->len = packetbuf_datalen() - packetbuf_hdr_len;
+  CONTIKI_ARCH_MEMCPY(buf->data, packetbuf_ptr + packetbuf_hdr_len,
+         packetbuf_datalen() - packetbuf_hdr_len);
+  buf->next = frag_info[index].frags;
+  frag_info[index].frags = buf;
+
+  PRINTF("Fragsize: %d\n", buf->len);
+  /* return the length of the stored fragment */
+  return buf->len;
 }
 /*---------------------------------------------------------------------------*/
 /* add a new fragment to the buffer */
@@ -347,13 +473,19 @@ add_fragment(uint16_t tag, uint16_t frag_size, uint8_t offset)
 {
   int i;
   int len;
+  int sender_count;
   int8_t found = -1;
+  const linkaddr_t *sender;
+
+  sender = packetbuf_addr(PACKETBUF_ADDR_SENDER);
 
   if(offset == 0) {
     /* This is a first fragment - check if we can add this */
+    sender_count = 0;
     for(i = 0; i < SICSLOWPAN_REASS_CONTEXTS; i++) {
       /* clear all fragment info with expired timer to free all fragment buffers */
       if(frag_info[i].len > 0 && timer_expired(&frag_info[i].reass_timer)) {
+        NET_STATS_ADD(stats, STATS_REASS_TIMEOUT);
 	clear_fragments(i);
       }
 
@@ -363,18 +495,36 @@ add_fragment(uint16_t tag, uint16_t frag_size, uint8_t offset)
            the loop to free any other expired fragment buffers. */
         found = i;
       }
+
+      if(frag_info[i].len > 0 && linkaddr_cmp(&frag_info[i].sender, sender)) {
+        sender_count++;
+      }
+    }
+
+    if(sender_count >= SICSLOWPAN_REASS_CONTEXTS_PER_SENDER) {
+      /* The sender is at its quota, it has to give up one of its own */
+      found = evict_candidate(-1, sender, 0);
+    } else if(found < 0) {
+      found = evict_candidate(-1, NULL, 0);
     }
 
     if(found < 0) {
       PRINTF("*** Failed to store new fragment session - tag: %d\n", tag);
+      NET_STATS_ADD(stats, STATS_REASS_DROP);
       return -1;
     }
 
+    if(frag_info[found].len > 0) {
+      PRINTF("*** Evicting fragment session - tag: %d\n", frag_info[found].tag);
+      NET_STATS_ADD(stats, STATS_REASS_EVICTED);
+      clear_fragments(found);
+    }
+
     /* Found a free fragment info to store data in */
     frag_info[found].len = frag_size;
     frag_info[found].tag = tag;
-    linkaddr_copy(&frag_info[found].sender,
-                  packetbuf_addr(PACKETBUF_ADDR_SENDER));
+    frag_info[found].reassembled_len = 0;
+    linkaddr_copy(&frag_info[found].sender, sender);
     timer_set(&frag_info[found].reass_timer, SICSLOWPAN_REASS_MAXAGE * CLOCK_SECOND / 16);
     /* first fragment can not be stored immediately but is moved into
        the buffer while uncompressing */
@@ -384,7 +534,7 @@ add_fragment(uint16_t tag, uint16_t frag_size, uint8_t offset)
   /* This is a N-fragment - should find the info */
   for(i = 0; i < SICSLOWPAN_REASS_CONTEXTS; i++) {
     if(frag_info[i].tag == tag && frag_info[i].len > 0 &&
-       linkaddr_cmp(&frag_info[i].sender, packetbuf_addr(PACKETBUF_ADDR_SENDER))) {
+       linkaddr_cmp(&frag_info[i].sender, sender)) {
       /* Tag and Sender match - this must be the correct info to store in */
       found = i;
       break;
@@ -394,6 +544,7 @@ add_fragment(uint16_t tag, uint16_t frag_size, uint8_t offset)
   if(found < 0) {
     /* no entry found for storing the new fragment */
     PRINTF("*** Failed to store N-fragment - could not find session - tag: %d offset: %d\n", tag, offset);
+    NET_STATS_ADD(stats, STATS_REASS_DROP);
     return -1;
   }
 
@@ -402,6 +553,17 @@ add_fragment(uint16_t tag, uint16_t frag_size, uint8_t offset)
   if(len < 0 && timeout_fragments(i) > 0) {
     len = store_fragment(i, offset);
   }
+  if(len < 0) {
+    /* Out of buffers: give up on the least complete other reassembly
+       unless this one is even further from completion */
+    found = evict_candidate(i, NULL, 1);
+    if(found >= 0 && less_complete(found, i)) {
+      PRINTF("*** Evicting fragment session - tag: %d\n", frag_info[found].tag);
+      NET_STATS_ADD(stats, STATS_REASS_EVICTED);
+      clear_fragments(found);
+      len = store_fragment(i, offset);
+    }
+  }
   if(len > 0) {
     frag_info[i].reassembled_len += len;
     return i;
@@ -409,6 +571,7 @@ add_fragment(uint16_t tag, uint16_t frag_size, uint8_t offset)
     /* should we also clear all fragments since we failed to store
        this fragment? */
     PRINTF("*** Failed to store fragment - packet reassembly will fail tag:%d l\n", frag_info[i].tag);
+    NET_STATS_ADD(stats, STATS_REASS_DROP);
     return -1;
   }
 }
@@ -418,17 +581,16 @@ add_fragment(uint16_t tag, uint16_t frag_size, uint8_t offset)
 static void
 copy_frags2uip(int context)
 {
-  int i;
+  struct sicslowpan_frag_buf *buf;
 
   /* Copy from the fragment context info buffer first */
-  memcpy((uint8_t *)UIP_IP_BUF, (uint8_t *)frag_info[context].first_frag,
-	 frag_info[context].first_frag_len);
-  for(i = 0; i < SICSLOWPAN_FRAGMENT_BUFFERS; i++) {
+  CONTIKI_ARCH_MEMCPY((uint8_t *)UIP_IP_BUF,
+                      (uint8_t *)frag_info[context].first_frag,
+                      frag_info[context].first_frag_len);
+  for(buf = frag_info[context].frags; buf != NULL; buf = buf->next) {
     /* And also copy all matching fragments */
-    if(frag_buf[i].len > 0 && frag_buf[i].index == context) {
-      memcpy((uint8_t *)UIP_IP_BUF + (uint16_t)(frag_buf[i].offset << 3),
-	     (uint8_t *)frag_buf[i].data, frag_buf[i].len);
-    }
+    CONTIKI_ARCH_MEMCPY((uint8_t *)UIP_IP_BUF + (uint16_t)(buf->offset << 3),
+                        (uint8_t *)buf->data, buf->len);
   }
   /* deallocate all the fragments for this context */
   clear_fragments(context);
@@ -543,14 +705,23 @@ addr_context_lookup_by_prefix(uip_ipaddr_t *ipaddr)
 /* Remove code to avoid warnings and save flash if no context is used */
 #if SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS > 0
   int i;
+  struct sicslowpan_addr_context *best = NULL;
+
+  /* The bits of the prefix after its length are zero, and must be zero
+     in the address too since they are elided with it */
   for(i = 0; i < SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS; i++) {
-    if((addr_contexts[i].used == 1) &&
+    if((addr_contexts[i].used == 1) && addr_contexts[i].compress &&
+       (addr_contexts[i].valid_until == 0 ||
+        clock_seconds() < addr_contexts[i].valid_until) &&
+       (best == NULL || addr_contexts[i].length > best->length) &&
        uip_ipaddr_prefixcmp(&addr_contexts[i].prefix, ipaddr, 64)) {
-      return &addr_contexts[i];
+      best = &addr_contexts[i];
     }
   }
-#endif /* SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS > 0 */
+  return best;
+#else /* SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS > 0 */
   return NULL;
+#endif /* SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS > 0 */
 }
 /*--------------------------------------------------------------------*/
 /** \brief find the context with the given number */
@@ -1209,7 +1380,7 @@ compress_hdr_ipv6(linkaddr_t *link_destaddr)
 {
   *packetbuf_ptr = SICSLOWPAN_DISPATCH_IPV6;
   packetbuf_hdr_len += SICSLOWPAN_IPV6_HDR_LEN;
-  memcpy(packetbuf_ptr + packetbuf_hdr_len, UIP_IP_BUF, UIP_IPH_LEN);
+  CONTIKI_ARCH_MEMCPY(packetbuf_ptr + packetbuf_hdr_len, UIP_IP_BUF, UIP_IPH_LEN);
   packetbuf_hdr_len += UIP_IPH_LEN;
   uncomp_hdr_len += UIP_IPH_LEN;
   return;
@@ -1227,6 +1398,10 @@ static void
 packet_sent(void *ptr, int status, int transmissions)
 {
   uip_ds6_link_neighbor_callback(status, transmissions);
+  TRACE(SICSLOWPAN_SENT, status, transmissions);
+#if LATENCY_TRACE_ENABLED
+  latency_trace_frame_done((uintptr_t)ptr, status);
+#endif /* LATENCY_TRACE_ENABLED */
 
   if(callback != NULL) {
     callback->output_callback(status);
@@ -1242,6 +1417,8 @@ packet_sent(void *ptr, int status, int transmissions)
 static void
 send_packet(linkaddr_t *dest)
 {
+  void *ptr = NULL;
+
   /* Set the link layer destination address for the packet as a
    * packetbuf attribute. The MAC layer can access the destination
    * address with the function packetbuf_addr(PACKETBUF_ADDR_RECEIVER).
@@ -1253,15 +1430,61 @@ send_packet(linkaddr_t *dest)
   packetbuf_set_addr(PACKETBUF_ADDR_SENDER,(void*)&uip_lladdr);
 #endif
 
+#if LATENCY_TRACE_ENABLED
+  /* The trace of the packet is given back with the result of the frame */
+  ptr = (void *)(uintptr_t)packetbuf_attr(PACKETBUF_ATTR_LATENCY_TRACE);
+  latency_trace_frame((uintptr_t)ptr);
+#endif /* LATENCY_TRACE_ENABLED */
+
   /* Provide a callback function to receive the result of
      a packet transmission. */
-  NETSTACK_LLSEC.send(&packet_sent, NULL);
+  NETSTACK_LLSEC.send(&packet_sent, ptr);
 
   /* If we are sending multiple packets in a row, we need to let the
      watchdog know that we are still alive. */
   watchdog_periodic();
 }
 /*--------------------------------------------------------------------*/
+/** \brief Compress the IP header in uip_buf into packetbuf */
+static void
+compress_hdr(linkaddr_t *dest)
+{
+  if(uip_len >= COMPRESSION_THRESHOLD) {
+    /* Try to compress the headers */
+#if SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_IPV6
+    compress_hdr_ipv6(dest);
+#endif /* SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_IPV6 */
+#if SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC06
+    compress_hdr_iphc(dest);
+#endif /* SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC06 */
+  } else {
+    compress_hdr_ipv6(dest);
+  }
+}
+/*--------------------------------------------------------------------*/
+/** \brief The number of bytes available for 6lowpan in a frame to dest */
+static int
+get_max_payload(linkaddr_t *dest)
+{
+  int framer_hdrlen;
+
+  /* Calculate NETSTACK_FRAMER's header length, that will be added in the NETSTACK_RDC.
+   * We calculate it here only to make a better decision of whether the outgoing packet
+   * needs to be fragmented or not. */
+#ifndef SICSLOWPAN_USE_FIXED_HDRLEN
+  packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, dest);
+  framer_hdrlen = NETSTACK_FRAMER.length();
+  if(framer_hdrlen < 0) {
+    /* Framing failed, we assume the maximum header length */
+    framer_hdrlen = SICSLOWPAN_FIXED_HDRLEN;
+  }
+#else /* USE_FRAMER_HDRLEN */
+  framer_hdrlen = SICSLOWPAN_FIXED_HDRLEN;
+#endif /* USE_FRAMER_HDRLEN */
+
+  return MAC_MAX_PAYLOAD - framer_hdrlen;
+}
+/*--------------------------------------------------------------------*/
 /** \brief Take an IP packet and format it to be sent on an 802.15.4
  *  network using 6lowpan.
  *  \param localdest The MAC address of the destination
@@ -1274,7 +1497,6 @@ send_packet(linkaddr_t *dest)
 static uint8_t
 output(const uip_lladdr_t *localdest)
 {
-  int framer_hdrlen;
   int max_payload;
 
   /* The MAC address of the destination of the packet */
@@ -1292,7 +1514,11 @@ output(const uip_lladdr_t *localdest)
     /* call the attribution when the callback comes, but set attributes
        here ! */
     set_packet_attrs();
+    packetbuf_set_attr(PACKETBUF_ATTR_FLOW, compower_get_flow());
   }
+#if LATENCY_TRACE_ENABLED
+  packetbuf_set_attr(PACKETBUF_ATTR_LATENCY_TRACE, latency_trace_packet());
+#endif /* LATENCY_TRACE_ENABLED */
 
 #if PACKETBUF_WITH_PACKET_TYPE
 #define TCP_FIN 0x01
@@ -1323,41 +1549,18 @@ output(const uip_lladdr_t *localdest)
   }
 
   PRINTFO("sicslowpan output: sending packet len %d\n", uip_len);
+  NET_STATS_ADD(stats, STATS_TX);
+  TRACE(SICSLOWPAN_OUTPUT, uip_len, TRACE_NODE(&dest));
 
-  if(uip_len >= COMPRESSION_THRESHOLD) {
-    /* Try to compress the headers */
-#if SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_IPV6
-    compress_hdr_ipv6(&dest);
-#endif /* SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_IPV6 */
-#if SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC06
-    compress_hdr_iphc(&dest);
-#endif /* SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC06 */
-  } else {
-    compress_hdr_ipv6(&dest);
-  }
+  compress_hdr(&dest);
   PRINTFO("sicslowpan output: header of len %d\n", packetbuf_hdr_len);
 
-  /* Calculate NETSTACK_FRAMER's header length, that will be added in the NETSTACK_RDC.
-   * We calculate it here only to make a better decision of whether the outgoing packet
-   * needs to be fragmented or not. */
-#ifndef SICSLOWPAN_USE_FIXED_HDRLEN
-  packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &dest);
-  framer_hdrlen = NETSTACK_FRAMER.length();
-  if(framer_hdrlen < 0) {
-    /* Framing failed, we assume the maximum header length */
-    framer_hdrlen = SICSLOWPAN_FIXED_HDRLEN;
-  }
-#else /* USE_FRAMER_HDRLEN */
-  framer_hdrlen = SICSLOWPAN_FIXED_HDRLEN;
-#endif /* USE_FRAMER_HDRLEN */
-
-  max_payload = MAC_MAX_PAYLOAD - framer_hdrlen;
+  max_payload = get_max_payload(&dest);
   if((int)uip_len - (int)uncomp_hdr_len > max_payload - (int)packetbuf_hdr_len) {
 #if SICSLOWPAN_CONF_FRAG
     /* Number of bytes processed. */
     uint16_t processed_ip_out_len;
 
-    struct queuebuf *q;
     uint16_t frag_tag;
 
     /*
@@ -1376,6 +1579,7 @@ output(const uip_lladdr_t *localdest)
     }
 
     PRINTFO("Fragmentation sending packet len %d\n", uip_len);
+    TRACE(SICSLOWPAN_FRAG, uip_len, estimated_fragments);
 
     /* Create 1st Fragment */
     PRINTFO("sicslowpan output: 1rst fragment ");
@@ -1401,24 +1605,19 @@ output(const uip_lladdr_t *localdest)
     packetbuf_hdr_len += SICSLOWPAN_FRAG1_HDR_LEN;
     packetbuf_payload_len = (max_payload - packetbuf_hdr_len) & 0xfffffff8;
     PRINTFO("(len %d, tag %d)\n", packetbuf_payload_len, frag_tag);
-    memcpy(packetbuf_ptr + packetbuf_hdr_len,
+    CONTIKI_ARCH_MEMCPY(packetbuf_ptr + packetbuf_hdr_len,
            (uint8_t *)UIP_IP_BUF + uncomp_hdr_len, packetbuf_payload_len);
     packetbuf_set_datalen(packetbuf_payload_len + packetbuf_hdr_len);
-    q = queuebuf_new_from_packetbuf();
-    if(q == NULL) {
-      PRINTFO("could not allocate queuebuf for first fragment, dropping packet\n");
-      return 0;
-    }
+    packetbuf_attr_copyto(frag_attrs, frag_addrs);
     send_packet(&dest);
-    queuebuf_to_packetbuf(q);
-    queuebuf_free(q);
-    q = NULL;
+    NET_STATS_ADD(stats, STATS_FRAG_TX);
 
     /* Check tx result. */
     if((last_tx_status == MAC_TX_COLLISION) ||
        (last_tx_status == MAC_TX_ERR) ||
        (last_tx_status == MAC_TX_ERR_FATAL)) {
       PRINTFO("error in fragment tx, dropping subsequent fragments.\n");
+      NET_STATS_ADD(stats, STATS_FRAG_TX_ERR);
       return 0;
     }
 
@@ -1427,17 +1626,22 @@ output(const uip_lladdr_t *localdest)
 
     /*
      * Create following fragments
-     * Datagram tag is already in the buffer, we need to set the
-     * FRAGN dispatch and for each fragment, the offset
+     * The MAC layer has used packetbuf to send the previous fragment,
+     * so for each fragment we reset it, restore the attributes and
+     * write the FRAGN dispatch, the tag and the offset
      */
     packetbuf_hdr_len = SICSLOWPAN_FRAGN_HDR_LEN;
-/*     PACKETBUF_FRAG_BUF->dispatch_size = */
-/*       uip_htons((SICSLOWPAN_DISPATCH_FRAGN << 8) | uip_len); */
-    SET16(PACKETBUF_FRAG_PTR, PACKETBUF_FRAG_DISPATCH_SIZE,
-          ((SICSLOWPAN_DISPATCH_FRAGN << 8) | uip_len));
     packetbuf_payload_len = (max_payload - packetbuf_hdr_len) & 0xfffffff8;
     while(processed_ip_out_len < uip_len) {
       PRINTFO("sicslowpan output: fragment ");
+      packetbuf_clear();
+      packetbuf_attr_copyfrom(frag_attrs, frag_addrs);
+      packetbuf_ptr = packetbuf_dataptr();
+/*     PACKETBUF_FRAG_BUF->dispatch_size = */
+/*       uip_htons((SICSLOWPAN_DISPATCH_FRAGN << 8) | uip_len); */
+      SET16(PACKETBUF_FRAG_PTR, PACKETBUF_FRAG_DISPATCH_SIZE,
+            ((SICSLOWPAN_DISPATCH_FRAGN << 8) | uip_len));
+      SET16(PACKETBUF_FRAG_PTR, PACKETBUF_FRAG_TAG, frag_tag);
       PACKETBUF_FRAG_PTR[PACKETBUF_FRAG_OFFSET] = processed_ip_out_len >> 3;
 
       /* Copy payload and send */
@@ -1447,18 +1651,11 @@ output(const uip_lladdr_t *localdest)
       }
       PRINTFO("(offset %d, len %d, tag %d)\n",
              processed_ip_out_len >> 3, packetbuf_payload_len, frag_tag);
-      memcpy(packetbuf_ptr + packetbuf_hdr_len,
+      CONTIKI_ARCH_MEMCPY(packetbuf_ptr + packetbuf_hdr_len,
              (uint8_t *)UIP_IP_BUF + processed_ip_out_len, packetbuf_payload_len);
       packetbuf_set_datalen(packetbuf_payload_len + packetbuf_hdr_len);
-      q = queuebuf_new_from_packetbuf();
-      if(q == NULL) {
-        PRINTFO("could not allocate queuebuf, dropping fragment\n");
-        return 0;
-      }
       send_packet(&dest);
-      queuebuf_to_packetbuf(q);
-      queuebuf_free(q);
-      q = NULL;
+      NET_STATS_ADD(stats, STATS_FRAG_TX);
       processed_ip_out_len += packetbuf_payload_len;
 
       /* Check tx result. */
@@ -1466,6 +1663,7 @@ output(const uip_lladdr_t *localdest)
          (last_tx_status == MAC_TX_ERR) ||
          (last_tx_status == MAC_TX_ERR_FATAL)) {
         PRINTFO("error in fragment tx, dropping subsequent fragments.\n");
+        NET_STATS_ADD(stats, STATS_FRAG_TX_ERR);
         return 0;
       }
     }
@@ -1479,14 +1677,218 @@ output(const uip_lladdr_t *localdest)
      * The packet does not need to be fragmented
      * copy "payload" and send
      */
-    memcpy(packetbuf_ptr + packetbuf_hdr_len, (uint8_t *)UIP_IP_BUF + uncomp_hdr_len,
-           uip_len - uncomp_hdr_len);
+    CONTIKI_ARCH_MEMCPY(packetbuf_ptr + packetbuf_hdr_len,
+                        (uint8_t *)UIP_IP_BUF + uncomp_hdr_len,
+                        uip_len - uncomp_hdr_len);
     packetbuf_set_datalen(uip_len - uncomp_hdr_len + packetbuf_hdr_len);
     send_packet(&dest);
   }
   return 1;
 }
 
+#if SICSLOWPAN_FRAG_FORWARDING
+/*--------------------------------------------------------------------*/
+/** \name Fragment forwarding
+ * @{                                                                 */
+/*--------------------------------------------------------------------*/
+static struct sicslowpan_frag_fwd *
+lookup_frag_fwd(uint16_t tag)
+{
+  int i;
+
+  for(i = 0; i < SICSLOWPAN_FRAG_FORWARD_ENTRIES; i++) {
+    if(frag_fwd[i].len > 0 && frag_fwd[i].tag == tag &&
+       linkaddr_cmp(&frag_fwd[i].sender, packetbuf_addr(PACKETBUF_ADDR_SENDER))) {
+      if(timer_expired(&frag_fwd[i].timer)) {
+        frag_fwd[i].len = 0;
+        return NULL;
+      }
+      return &frag_fwd[i];
+    }
+  }
+  return NULL;
+}
+/*--------------------------------------------------------------------*/
+static struct sicslowpan_frag_fwd *
+alloc_frag_fwd(void)
+{
+  int i;
+
+  for(i = 0; i < SICSLOWPAN_FRAG_FORWARD_ENTRIES; i++) {
+    if(frag_fwd[i].len == 0 || timer_expired(&frag_fwd[i].timer)) {
+      return &frag_fwd[i];
+    }
+  }
+  return NULL;
+}
+/*--------------------------------------------------------------------*/
+/* The MAC address of the next hop for the IP header in uip_buf */
+static const uip_lladdr_t *
+forward_nexthop(void)
+{
+  uip_ipaddr_t *nexthop;
+  uip_ds6_route_t *route;
+
+  if(uip_ds6_is_addr_onlink(&UIP_IP_BUF->destipaddr)) {
+    nexthop = &UIP_IP_BUF->destipaddr;
+  } else {
+    route = uip_ds6_route_lookup(&UIP_IP_BUF->destipaddr);
+    if(route != NULL) {
+      nexthop = uip_ds6_route_nexthop(route);
+    } else {
+      nexthop = uip_ds6_defrt_choose();
+    }
+  }
+  if(nexthop == NULL) {
+    return NULL;
+  }
+  return uip_ds6_nbr_lladdr_from_ipaddr(nexthop);
+}
+/*--------------------------------------------------------------------*/
+/**
+ * \brief Forward the first fragment of a datagram that is not for us
+ * \param context The reassembly context holding the uncompressed fragment
+ * \return 1 if the fragment was consumed, 0 if the datagram should be
+ * reassembled as usual
+ *
+ * The IP header is updated as it would be by the IP layer, compressed
+ * again for the next hop and sent in a FRAG1 with a tag of our own. The
+ * rest of the datagram then follows the entry created here.
+ */
+static int
+forward_first_fragment(int8_t context)
+{
+  struct sicslowpan_frag_fwd *fwd;
+  const uip_lladdr_t *lladdr;
+  linkaddr_t nexthop;
+  uint16_t payload_len;
+  int max_payload;
+
+  CONTIKI_ARCH_MEMCPY((uint8_t *)UIP_IP_BUF, frag_info[context].first_frag,
+         frag_info[context].first_frag_len);
+
+  if(uip_ds6_is_my_addr(&UIP_IP_BUF->destipaddr) ||
+     uip_is_addr_mcast(&UIP_IP_BUF->destipaddr) ||
+     uip_is_addr_linklocal(&UIP_IP_BUF->destipaddr) ||
+     UIP_IP_BUF->ttl <= 1) {
+    return 0;
+  }
+
+  /* A routing header must be processed by the IP layer */
+  if(UIP_IP_BUF->proto == UIP_PROTO_ROUTING) {
+    return 0;
+  }
+
+  uip_len = frag_info[context].len;
+  uip_ext_len = 0;
+
+#if UIP_CONF_IPV6_RPL
+  /* The root replaces the RPL headers, which changes the length */
+  if(rpl_dag_root_is_root()) {
+    return 0;
+  }
+  if(!rpl_update_header()) {
+    PRINTF("sicslowpan forward: RPL header update error\n");
+    clear_fragments(context);
+    uip_clear_buf();
+    return 1;
+  }
+  if(uip_len != frag_info[context].len) {
+    return 0;
+  }
+#endif /* UIP_CONF_IPV6_RPL */
+
+  lladdr = forward_nexthop();
+  if(lladdr == NULL) {
+    return 0;
+  }
+  linkaddr_copy(&nexthop, (const linkaddr_t *)lladdr);
+  if(linkaddr_cmp(&nexthop, &frag_info[context].sender)) {
+    return 0;
+  }
+
+  fwd = alloc_frag_fwd();
+  if(fwd == NULL) {
+    PRINTF("sicslowpan forward: no free entry, tag %d\n",
+           frag_info[context].tag);
+    return 0;
+  }
+
+  UIP_IP_BUF->ttl--;
+
+  /* The received frame was already copied, so packetbuf can be reused */
+  uncomp_hdr_len = 0;
+  packetbuf_hdr_len = 0;
+  packetbuf_clear();
+  packetbuf_ptr = packetbuf_dataptr();
+
+  compress_hdr(&nexthop);
+  max_payload = get_max_payload(&nexthop);
+  payload_len = frag_info[context].first_frag_len - uncomp_hdr_len;
+  if(packetbuf_hdr_len + SICSLOWPAN_FRAG1_HDR_LEN + payload_len > max_payload) {
+    /* The header grew when compressed for the next hop */
+    return 0;
+  }
+
+  memmove(packetbuf_ptr + SICSLOWPAN_FRAG1_HDR_LEN, packetbuf_ptr, packetbuf_hdr_len);
+  SET16(PACKETBUF_FRAG_PTR, PACKETBUF_FRAG_DISPATCH_SIZE,
+        ((SICSLOWPAN_DISPATCH_FRAG1 << 8) | frag_info[context].len));
+  fwd->new_tag = my_tag++;
+  SET16(PACKETBUF_FRAG_PTR, PACKETBUF_FRAG_TAG, fwd->new_tag);
+  packetbuf_hdr_len += SICSLOWPAN_FRAG1_HDR_LEN;
+
+  CONTIKI_ARCH_MEMCPY(packetbuf_ptr + packetbuf_hdr_len,
+         (uint8_t *)UIP_IP_BUF + uncomp_hdr_len, payload_len);
+  packetbuf_set_datalen(payload_len + packetbuf_hdr_len);
+
+  linkaddr_copy(&fwd->sender, &frag_info[context].sender);
+  linkaddr_copy(&fwd->nexthop, &nexthop);
+  fwd->tag = frag_info[context].tag;
+  fwd->len = frag_info[context].len;
+  fwd->forwarded_len = frag_info[context].first_frag_len;
+  timer_set(&fwd->timer, SICSLOWPAN_REASS_MAXAGE * CLOCK_SECOND / 16);
+
+  PRINTF("sicslowpan forward: tag %d -> %d\n", fwd->tag, fwd->new_tag);
+
+  clear_fragments(context);
+  uip_clear_buf();
+
+  send_packet(&nexthop);
+  return 1;
+}
+/*--------------------------------------------------------------------*/
+/**
+ * \brief Relay a subsequent fragment of a datagram being forwarded
+ * \param tag The tag of the received fragment
+ * \return 1 if the fragment was relayed, 0 if it is not being forwarded
+ */
+static int
+forward_fragment(uint16_t tag)
+{
+  struct sicslowpan_frag_fwd *fwd;
+  linkaddr_t nexthop;
+
+  fwd = lookup_frag_fwd(tag);
+  if(fwd == NULL) {
+    return 0;
+  }
+
+  SET16(PACKETBUF_FRAG_PTR, PACKETBUF_FRAG_TAG, fwd->new_tag);
+  fwd->forwarded_len += packetbuf_datalen() - SICSLOWPAN_FRAGN_HDR_LEN;
+  linkaddr_copy(&nexthop, &fwd->nexthop);
+  if(fwd->forwarded_len >= fwd->len) {
+    /* This was the last fragment */
+    fwd->len = 0;
+  }
+
+  packetbuf_compact();
+  packetbuf_attr_clear();
+  send_packet(&nexthop);
+  return 1;
+}
+/** @} */
+#endif /* SICSLOWPAN_FRAG_FORWARDING */
+
 /*--------------------------------------------------------------------*/
 /** \brief Process a received 6lowpan packet.
  *
@@ -1519,6 +1921,9 @@ input(void)
 
   /* Update link statistics */
   link_stats_input_callback(packetbuf_addr(PACKETBUF_ADDR_SENDER));
+  NET_STATS_ADD(stats, STATS_RX);
+  TRACE(SICSLOWPAN_INPUT, packetbuf_datalen(),
+        TRACE_NODE(packetbuf_addr(PACKETBUF_ADDR_SENDER)));
 
   /* init */
   uncomp_hdr_len = 0;
@@ -1556,6 +1961,7 @@ input(void)
       is_fragment = 1;
 
       /* Add the fragment to the fragmentation context */
+      NET_STATS_ADD(stats, STATS_FRAG_RX);
       frag_context = add_fragment(frag_tag, frag_size, frag_offset);
 
       if(frag_context == -1) {
@@ -1578,6 +1984,12 @@ input(void)
              frag_size, frag_tag, frag_offset);
       packetbuf_hdr_len += SICSLOWPAN_FRAGN_HDR_LEN;
 
+#if SICSLOWPAN_FRAG_FORWARDING
+      if(forward_fragment(frag_tag)) {
+        return;
+      }
+#endif /* SICSLOWPAN_FRAG_FORWARDING */
+
       /* If this is the last fragment, we may shave off any extrenous
          bytes at the end. We must be liberal in what we accept. */
       PRINTFI("last_fragment?: packetbuf_payload_len %d frag_size %d\n",
@@ -1585,6 +1997,7 @@ input(void)
 
       /* Add the fragment to the fragmentation context (this will also
          copy the payload) */
+      NET_STATS_ADD(stats, STATS_FRAG_RX);
       frag_context = add_fragment(frag_tag, frag_size, frag_offset);
 
       if(frag_context == -1) {
@@ -1623,7 +2036,7 @@ input(void)
       packetbuf_hdr_len += SICSLOWPAN_IPV6_HDR_LEN;
 
       /* Put uncompressed IP header in sicslowpan_buf. */
-      memcpy(buffer, packetbuf_ptr + packetbuf_hdr_len, UIP_IPH_LEN);
+      CONTIKI_ARCH_MEMCPY(buffer, packetbuf_ptr + packetbuf_hdr_len, UIP_IPH_LEN);
 
       /* Update uncomp_hdr_len and packetbuf_hdr_len. */
       packetbuf_hdr_len += UIP_IPH_LEN;
@@ -1669,7 +2082,9 @@ input(void)
   /* copy the payload if buffer is non-null - which is only the case with first fragment
      or packets that are non fragmented */
   if(buffer != NULL) {
-    memcpy((uint8_t *)buffer + uncomp_hdr_len, packetbuf_ptr + packetbuf_hdr_len, packetbuf_payload_len);
+    CONTIKI_ARCH_MEMCPY((uint8_t *)buffer + uncomp_hdr_len,
+                        packetbuf_ptr + packetbuf_hdr_len,
+                        packetbuf_payload_len);
   }
 
   /* update processed_ip_in_len if fragment, sicslowpan_len otherwise */
@@ -1680,6 +2095,11 @@ input(void)
     if(first_fragment != 0) {
       frag_info[frag_context].reassembled_len = uncomp_hdr_len + packetbuf_payload_len;
       frag_info[frag_context].first_frag_len = uncomp_hdr_len + packetbuf_payload_len;
+#if SICSLOWPAN_FRAG_FORWARDING
+      if(forward_first_fragment(frag_context)) {
+        return;
+      }
+#endif /* SICSLOWPAN_FRAG_FORWARDING */
     }
     /* For the last fragment, we are OK if there is extrenous bytes at
        the end of the packet. */
@@ -1687,6 +2107,7 @@ input(void)
       frag_info[frag_context].reassembled_len = frag_size;
       /* copy to uip */
       copy_frags2uip(frag_context);
+      NET_STATS_ADD(stats, STATS_REASSEMBLED);
     }
   }
 
@@ -1744,6 +2165,11 @@ sicslowpan_init(void)
    */
 
   tcpip_set_outputfunc(output);
+  net_stats_register(&stats_group);
+
+#if SICSLOWPAN_CONF_FRAG
+  memb_init(&frag_buf_memb);
+#endif /* SICSLOWPAN_CONF_FRAG */
 
 #if SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC06
 /* Preinitialize any address contexts for better header compression
@@ -1754,6 +2180,8 @@ sicslowpan_init(void)
 #if SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS > 0
   addr_contexts[0].used   = 1;
   addr_contexts[0].number = 0;
+  addr_contexts[0].length = 64;
+  addr_contexts[0].compress = 1;
 #ifdef SICSLOWPAN_CONF_ADDR_CONTEXT_0
   SICSLOWPAN_CONF_ADDR_CONTEXT_0;
 #else
@@ -1770,11 +2198,15 @@ sicslowpan_init(void)
       if (i==1) {
         addr_contexts[1].used   = 1;
         addr_contexts[1].number = 1;
+        addr_contexts[1].length = 64;
+        addr_contexts[1].compress = 1;
         SICSLOWPAN_CONF_ADDR_CONTEXT_1;
 #ifdef SICSLOWPAN_CONF_ADDR_CONTEXT_2
       } else if (i==2) {
         addr_contexts[2].used   = 1;
         addr_contexts[2].number = 2;
+        addr_contexts[2].length = 64;
+        addr_contexts[2].compress = 1;
         SICSLOWPAN_CONF_ADDR_CONTEXT_2;
 #endif
       } else {
@@ -1790,6 +2222,143 @@ sicslowpan_init(void)
 #endif /* SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC06 */
 }
 /*--------------------------------------------------------------------*/
+#if SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC06
+/* The number of bytes compress_addr_64() puts inline */
+static int
+addr_64_len(const uip_ipaddr_t *ipaddr, const uip_lladdr_t *lladdr)
+{
+  if(uip_is_addr_mac_addr_based(ipaddr, lladdr)) {
+    return 0;
+  } else if(sicslowpan_is_iid_16_bit_compressable(ipaddr)) {
+    return 2;
+  }
+  return 8;
+}
+#endif /* SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC06 */
+/*--------------------------------------------------------------------*/
+int
+sicslowpan_hdr_len(const uip_ipaddr_t *src, const uip_ipaddr_t *dest,
+                   uint8_t proto, const linkaddr_t *link_dest)
+{
+#if SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC06
+  /* This follows the choices made by compress_hdr_iphc() */
+  int len;
+
+  if(link_dest == NULL) {
+    link_dest = &linkaddr_null;
+  }
+
+  /* IPHC encoding, traffic class and flow label elided */
+  len = 2;
+  if(addr_context_lookup_by_prefix((uip_ipaddr_t *)dest) != NULL ||
+     addr_context_lookup_by_prefix((uip_ipaddr_t *)src) != NULL) {
+    /* context identifier extension */
+    len++;
+  }
+
+#if UIP_CONF_UDP || UIP_CONF_ROUTER
+  if(proto == UIP_PROTO_UDP) {
+    /* NHC encoding, uncompressed ports and checksum */
+    len += 1 + 4 + 2;
+  } else
+#endif /* UIP_CONF_UDP || UIP_CONF_ROUTER */
+  {
+    len++;
+  }
+
+  if(uip_ds6_if.cur_hop_limit != 1 && uip_ds6_if.cur_hop_limit != 64 &&
+     uip_ds6_if.cur_hop_limit != 255) {
+    len++;
+  }
+
+  if(uip_is_addr_unspecified(src)) {
+    /* elided */
+  } else if(addr_context_lookup_by_prefix((uip_ipaddr_t *)src) != NULL) {
+    len += addr_64_len(src, &uip_lladdr);
+  } else if(uip_is_addr_linklocal(src) && dest->u16[1] == 0 &&
+            dest->u16[2] == 0 && dest->u16[3] == 0) {
+    len += addr_64_len(src, &uip_lladdr);
+  } else {
+    len += 16;
+  }
+
+  if(uip_is_addr_mcast(dest)) {
+    if(sicslowpan_is_mcast_addr_compressable8(dest)) {
+      len += 1;
+    } else if(sicslowpan_is_mcast_addr_compressable32(dest)) {
+      len += 4;
+    } else if(sicslowpan_is_mcast_addr_compressable48(dest)) {
+      len += 6;
+    } else {
+      len += 16;
+    }
+  } else if(addr_context_lookup_by_prefix((uip_ipaddr_t *)dest) != NULL ||
+            (uip_is_addr_linklocal(dest) && dest->u16[1] == 0 &&
+             dest->u16[2] == 0 && dest->u16[3] == 0)) {
+    len += addr_64_len(dest, (const uip_lladdr_t *)link_dest);
+  } else {
+    len += 16;
+  }
+  return len;
+#else /* SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC06 */
+  return SICSLOWPAN_IPV6_HDR_LEN + UIP_IPH_LEN +
+    (proto == UIP_PROTO_UDP ? UIP_UDPH_LEN : 0);
+#endif /* SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC06 */
+}
+/*--------------------------------------------------------------------*/
+int
+sicslowpan_context_set(uint8_t number, const uip_ipaddr_t *prefix,
+                       uint8_t length, unsigned long lifetime,
+                       uint8_t compress)
+{
+#if SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC06 && SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS > 0
+  struct sicslowpan_addr_context *c;
+  int i;
+
+  if(number > 15 || length > 64) {
+    return 0;
+  }
+
+  c = addr_context_lookup_by_number(number);
+  for(i = 0; c == NULL && i < SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS; i++) {
+    if(addr_contexts[i].used == 0) {
+      c = &addr_contexts[i];
+    }
+  }
+  if(c == NULL) {
+    PRINTF("sicslowpan: no room for context %u\n", number);
+    return 0;
+  }
+
+  memset(c->prefix, 0, sizeof(c->prefix));
+  memcpy(c->prefix, prefix, (length + 7) / 8);
+  if(length % 8) {
+    c->prefix[length / 8] &= 0xff << (8 - length % 8);
+  }
+  c->length = length;
+  c->compress = compress;
+  c->valid_until = lifetime == 0 ? 0 : clock_seconds() + lifetime;
+  c->number = number;
+  c->used = 1;
+  return 1;
+#else
+  return 0;
+#endif
+}
+/*--------------------------------------------------------------------*/
+void
+sicslowpan_context_remove(uint8_t number)
+{
+#if SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC06 && SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS > 0
+  struct sicslowpan_addr_context *c;
+
+  c = addr_context_lookup_by_number(number);
+  if(c != NULL) {
+    c->used = 0;
+  }
+#endif
+}
+/*--------------------------------------------------------------------*/
 int
 sicslowpan_get_last_rssi(void)
 {
@@ -220,9 +220,16 @@
  * each context can have upto 8 bytes
  */
 struct sicslowpan_addr_context {
-  uint8_t used; /* possibly use as prefix-length */
+  uint8_t used;
   uint8_t number;
   uint8_t prefix[8];
+  /** Prefix length in bits, the bits of prefix after it are zero */
+  uint8_t length;
+  /** Zero if the context may only be used for decompression */
+  uint8_t compress;
+  /** clock_seconds() when the context stops being used for
+      compression, 0 if it is valid forever */
+  unsigned long valid_until;
 };
 
 /**
@@ -321,6 +328,46 @@ struct sicslowpan_nh_compressor {
 
 int sicslowpan_get_last_rssi(void);
 
+/**
+ * \brief Size of an IPv6 header once compressed, without building it
+ * \param src The source address
+ * \param dest The destination address
+ * \param proto The next header field of the IPv6 header
+ * \param link_dest The link-layer destination, NULL for broadcast
+ * \return The number of bytes the IPv6 header, and the UDP header when
+ *         proto is UIP_PROTO_UDP, take in the 6LoWPAN frame
+ *
+ * The traffic class and flow label are assumed to be zero, the hop
+ * limit to be the interface default and the UDP ports not to be
+ * compressible. Extension headers are not counted, including the ones
+ * a routing protocol inserts when the packet is sent.
+ */
+int sicslowpan_hdr_len(const uip_ipaddr_t *src, const uip_ipaddr_t *dest,
+                       uint8_t proto, const linkaddr_t *link_dest);
+
+/**
+ * \brief Install or update an IPHC address context
+ * \param number The context identifier (0-15)
+ * \param prefix The context prefix
+ * \param length The prefix length in bits, at most 64
+ * \param lifetime The valid lifetime in seconds, 0 for no expiry
+ * \param compress Non-zero if the context may be used for compression
+ * \return 1 if the context was installed, 0 otherwise
+ *
+ * After its lifetime the context is no longer used for compression,
+ * but packets from nodes still using it can be uncompressed until it
+ * is removed or replaced.
+ */
+int sicslowpan_context_set(uint8_t number, const uip_ipaddr_t *prefix,
+                           uint8_t length, unsigned long lifetime,
+                           uint8_t compress);
+
+/**
+ * \brief Remove an IPHC address context
+ * \param number The context identifier (0-15)
+ */
+void sicslowpan_context_remove(uint8_t number);
+
 extern const struct network_driver sicslowpan_driver;
 
 #endif /* SICSLOWPAN_H_ */
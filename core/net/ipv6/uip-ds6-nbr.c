@@ -71,11 +71,89 @@ void LINK_NEIGHBOR_CALLBACK(const linkaddr_t *addr, int status, int numtx);
 
 NBR_TABLE_GLOBAL(uip_ds6_nbr_t, ds6_neighbors);
 
+#if UIP_DS6_NBR_HASH_SIZE
+/* Index of the neighbor cache by IP address. Neighbors whose
+   addresses share a hash are chained through hash_next. */
+static uip_ds6_nbr_t *nbr_hash[UIP_DS6_NBR_HASH_SIZE];
+#endif /* UIP_DS6_NBR_HASH_SIZE */
+
+/*---------------------------------------------------------------------------*/
+#if UIP_DS6_NBR_HASH_SIZE
+static uint8_t
+hash_ipaddr(const uip_ipaddr_t *ipaddr)
+{
+  uint8_t i;
+  uint16_t h;
+
+  /* Neighbors mostly share their prefix, so only the IID is hashed. */
+  h = 0;
+  for(i = 8; i < 16; i++) {
+    h = (h << 3) + (h >> 13) + ipaddr->u8[i];
+  }
+  return h % UIP_DS6_NBR_HASH_SIZE;
+}
+/*---------------------------------------------------------------------------*/
+static void
+hash_add(uip_ds6_nbr_t *nbr)
+{
+  uint8_t h = hash_ipaddr(&nbr->ipaddr);
+
+  nbr->hash_next = nbr_hash[h];
+  nbr_hash[h] = nbr;
+}
+/*---------------------------------------------------------------------------*/
+static void
+hash_remove(uip_ds6_nbr_t *nbr)
+{
+  uip_ds6_nbr_t **p;
+
+  for(p = &nbr_hash[hash_ipaddr(&nbr->ipaddr)]; *p != NULL;
+      p = &(*p)->hash_next) {
+    if(*p == nbr) {
+      *p = nbr->hash_next;
+      nbr->hash_next = NULL;
+      return;
+    }
+  }
+}
+#else /* UIP_DS6_NBR_HASH_SIZE */
+/*---------------------------------------------------------------------------*/
+/* Return the neighbor whose link-layer address the IID of ipaddr is
+   derived from, if it has that IP address. */
+static uip_ds6_nbr_t *
+lookup_from_iid(const uip_ipaddr_t *ipaddr)
+{
+#if UIP_LLADDR_LEN == LINKADDR_SIZE && (UIP_LLADDR_LEN == 8 || UIP_LLADDR_LEN == 6)
+  linkaddr_t lladdr;
+  uip_ds6_nbr_t *nbr;
+
+#if UIP_LLADDR_LEN == 8
+  memcpy(&lladdr, &ipaddr->u8[8], 8);
+#else /* UIP_LLADDR_LEN == 8 */
+  if(ipaddr->u8[11] != 0xff || ipaddr->u8[12] != 0xfe) {
+    return NULL;
+  }
+  memcpy(&lladdr.u8[0], &ipaddr->u8[8], 3);
+  memcpy(&lladdr.u8[3], &ipaddr->u8[13], 3);
+#endif /* UIP_LLADDR_LEN == 8 */
+  lladdr.u8[0] ^= 0x02;
+
+  nbr = nbr_table_get_from_lladdr(ds6_neighbors, &lladdr);
+  if(nbr != NULL && uip_ipaddr_cmp(&nbr->ipaddr, ipaddr)) {
+    return nbr;
+  }
+#endif /* UIP_LLADDR_LEN == LINKADDR_SIZE && ... */
+  return NULL;
+}
+#endif /* UIP_DS6_NBR_HASH_SIZE */
 /*---------------------------------------------------------------------------*/
 void
 uip_ds6_neighbors_init(void)
 {
   link_stats_init();
+#if UIP_DS6_NBR_HASH_SIZE
+  memset(nbr_hash, 0, sizeof(nbr_hash));
+#endif /* UIP_DS6_NBR_HASH_SIZE */
   nbr_table_register(ds6_neighbors, (nbr_table_callback *)uip_ds6_nbr_rm);
 }
 /*---------------------------------------------------------------------------*/
@@ -84,10 +162,24 @@ uip_ds6_nbr_add(const uip_ipaddr_t *ipaddr, const uip_lladdr_t *lladdr,
                 uint8_t isrouter, uint8_t state, nbr_table_reason_t reason,
                 void *data)
 {
-  uip_ds6_nbr_t *nbr = nbr_table_add_lladdr(ds6_neighbors, (linkaddr_t*)lladdr
-                                            , reason, data);
+  uip_ds6_nbr_t *nbr;
+
+#if UIP_DS6_NBR_HASH_SIZE
+  /* The entry of an existing neighbor is reinitialized below, so it
+     must be taken out of the index first. */
+  nbr = nbr_table_get_from_lladdr(ds6_neighbors, (linkaddr_t *)lladdr);
+  if(nbr != NULL) {
+    hash_remove(nbr);
+  }
+#endif /* UIP_DS6_NBR_HASH_SIZE */
+
+  nbr = nbr_table_add_lladdr(ds6_neighbors, (linkaddr_t*)lladdr
+                             , reason, data);
   if(nbr) {
     uip_ipaddr_copy(&nbr->ipaddr, ipaddr);
+#if UIP_DS6_NBR_HASH_SIZE
+    hash_add(nbr);
+#endif /* UIP_DS6_NBR_HASH_SIZE */
 #if UIP_ND6_SEND_NA || UIP_ND6_SEND_RA || !UIP_CONF_ROUTER
     nbr->isrouter = isrouter;
 #endif /* UIP_ND6_SEND_NA || UIP_ND6_SEND_RA || !UIP_CONF_ROUTER */
@@ -101,6 +193,9 @@ uip_ds6_nbr_add(const uip_ipaddr_t *ipaddr, const uip_lladdr_t *lladdr,
     stimer_set(&nbr->sendns, 0);
     nbr->nscount = 0;
 #endif /* UIP_ND6_SEND_NA */
+#if UIP_ND6_6LOWPAN && UIP_CONF_ROUTER
+    nbr->isregistered = 0;
+#endif /* UIP_ND6_6LOWPAN && UIP_CONF_ROUTER */
     PRINTF("Adding neighbor with ip addr ");
     PRINT6ADDR(ipaddr);
     PRINTF(" link addr ");
@@ -126,6 +221,9 @@ uip_ds6_nbr_rm(uip_ds6_nbr_t *nbr)
 #if UIP_CONF_IPV6_QUEUE_PKT
     uip_packetqueue_free(&nbr->packethandle);
 #endif /* UIP_CONF_IPV6_QUEUE_PKT */
+#if UIP_DS6_NBR_HASH_SIZE
+    hash_remove(nbr);
+#endif /* UIP_DS6_NBR_HASH_SIZE */
     NEIGHBOR_STATE_CHANGED(nbr);
     return nbr_table_remove(ds6_neighbors, nbr);
   }
@@ -164,15 +262,32 @@ uip_ds6_nbr_num(void)
 uip_ds6_nbr_t *
 uip_ds6_nbr_lookup(const uip_ipaddr_t *ipaddr)
 {
-  uip_ds6_nbr_t *nbr = nbr_table_head(ds6_neighbors);
-  if(ipaddr != NULL) {
-    while(nbr != NULL) {
-      if(uip_ipaddr_cmp(&nbr->ipaddr, ipaddr)) {
-        return nbr;
-      }
-      nbr = nbr_table_next(ds6_neighbors, nbr);
+  uip_ds6_nbr_t *nbr;
+
+  if(ipaddr == NULL) {
+    return NULL;
+  }
+#if UIP_DS6_NBR_HASH_SIZE
+  for(nbr = nbr_hash[hash_ipaddr(ipaddr)]; nbr != NULL; nbr = nbr->hash_next) {
+    if(uip_ipaddr_cmp(&nbr->ipaddr, ipaddr)) {
+      return nbr;
     }
   }
+#else /* UIP_DS6_NBR_HASH_SIZE */
+  /* Most neighbors use an address derived from their link-layer
+     address, which can be looked up directly. */
+  nbr = lookup_from_iid(ipaddr);
+  if(nbr != NULL) {
+    return nbr;
+  }
+  for(nbr = nbr_table_head(ds6_neighbors);
+      nbr != NULL;
+      nbr = nbr_table_next(ds6_neighbors, nbr)) {
+    if(uip_ipaddr_cmp(&nbr->ipaddr, ipaddr)) {
+      return nbr;
+    }
+  }
+#endif /* UIP_DS6_NBR_HASH_SIZE */
   return NULL;
 }
 /*---------------------------------------------------------------------------*/
@@ -251,6 +366,17 @@ uip_ds6_neighbor_periodic(void)
   while(nbr != NULL) {
     switch(nbr->state) {
     case NBR_REACHABLE:
+#if UIP_ND6_6LOWPAN && UIP_CONF_ROUTER
+      if(nbr->isregistered) {
+        if(stimer_expired(&nbr->reglifetime)) {
+          PRINTF("REACHABLE: registration expired (");
+          PRINT6ADDR(&nbr->ipaddr);
+          PRINTF(")\n");
+          uip_ds6_nbr_rm(nbr);
+        }
+        break;
+      }
+#endif /* UIP_ND6_6LOWPAN && UIP_CONF_ROUTER */
       if(stimer_expired(&nbr->reachable)) {
 #if UIP_CONF_IPV6_RPL
         /* when a neighbor leave its REACHABLE state and is a default router,
@@ -62,10 +62,21 @@
 #define  NBR_DELAY 3
 #define  NBR_PROBE 4
 
+/** \brief Number of buckets in the IP address index of the nbr cache,
+ * 0 to search the cache linearly */
+#ifdef UIP_DS6_NBR_CONF_HASH_SIZE
+#define UIP_DS6_NBR_HASH_SIZE UIP_DS6_NBR_CONF_HASH_SIZE
+#else
+#define UIP_DS6_NBR_HASH_SIZE 0
+#endif
+
 NBR_TABLE_DECLARE(ds6_neighbors);
 
 /** \brief An entry in the nbr cache */
 typedef struct uip_ds6_nbr {
+#if UIP_DS6_NBR_HASH_SIZE
+  struct uip_ds6_nbr *hash_next;
+#endif /* UIP_DS6_NBR_HASH_SIZE */
   uip_ipaddr_t ipaddr;
   uint8_t isrouter;
   uint8_t state;
@@ -74,6 +85,12 @@ typedef struct uip_ds6_nbr {
   struct stimer sendns;
   uint8_t nscount;
 #endif /* UIP_ND6_SEND_NA || UIP_ND6_SEND_RA */
+#if UIP_ND6_6LOWPAN && UIP_CONF_ROUTER
+  /* Address registered by the neighbor (RFC 6775): the entry is kept,
+     without NUD, until the registration expires */
+  struct stimer reglifetime;
+  uint8_t isregistered;
+#endif /* UIP_ND6_6LOWPAN && UIP_CONF_ROUTER */
 #if UIP_CONF_IPV6_QUEUE_PKT
   struct uip_packetqueue_handle packethandle;
 #define UIP_DS6_NBR_PACKET_LIFETIME CLOCK_SECOND * 4
@@ -64,17 +64,31 @@ void NETSTACK_CONF_ROUTING_NEIGHBOR_REMOVED_CALLBACK(const linkaddr_t *addr);
    so that it will be maintained along with the rest of the neighbor
    tables in the system. */
 NBR_TABLE_GLOBAL(struct uip_ds6_route_neighbor_routes, nbr_routes);
-MEMB(neighborroutememb, struct uip_ds6_route_neighbor_route, UIP_DS6_ROUTE_NB);
+#if !UIP_DS6_ROUTE_COMPACT
+MEMB_BITMAP(neighborroutememb, struct uip_ds6_route_neighbor_route, UIP_DS6_ROUTE_NB);
+#endif /* !UIP_DS6_ROUTE_COMPACT */
 
 /* Each route is repressented by a uip_ds6_route_t structure and
    memory for each route is allocated from the routememb memory
    block. These routes are maintained on the routelist. */
 LIST(routelist);
-MEMB(routememb, uip_ds6_route_t, UIP_DS6_ROUTE_NB);
+MEMB_BITMAP(routememb, uip_ds6_route_t, UIP_DS6_ROUTE_NB);
 
 static int num_routes = 0;
 static void rm_routelist_callback(nbr_table_item_t *ptr);
 
+#if UIP_DS6_ROUTE_HASH_SIZE
+/* Host routes are indexed by a hash of their address. Only the
+   remaining prefix routes need to be searched linearly. */
+static uip_ds6_route_t *route_hash[UIP_DS6_ROUTE_HASH_SIZE];
+static int num_prefix_routes;
+
+/* The result of the last successful lookup, for consecutive packets
+   to the same destination. */
+static uip_ds6_route_t *last_route;
+static uip_ipaddr_t last_addr;
+#endif /* UIP_DS6_ROUTE_HASH_SIZE */
+
 #endif /* (UIP_CONF_MAX_ROUTES != 0) */
 
 /* Default routes are held on the defaultrouterlist and their
@@ -156,12 +170,104 @@ uip_ds6_notification_rm(struct uip_ds6_notification *n)
 }
 #endif
 /*---------------------------------------------------------------------------*/
+#if (UIP_CONF_MAX_ROUTES != 0) && UIP_DS6_ROUTE_HASH_SIZE
+static uint16_t
+hash_ipaddr(const uip_ipaddr_t *ipaddr)
+{
+  uint8_t i;
+  uint16_t h;
+
+  /* Routes mostly share their prefix, so only the IID is hashed. */
+  h = 0;
+  for(i = 8; i < 16; i++) {
+    h = (h << 3) + (h >> 13) + ipaddr->u8[i];
+  }
+  return h % UIP_DS6_ROUTE_HASH_SIZE;
+}
+/*---------------------------------------------------------------------------*/
+static void
+index_add(uip_ds6_route_t *r)
+{
+  uint16_t h;
+
+  last_route = NULL;
+  if(r->length == 128) {
+    h = hash_ipaddr(&r->ipaddr);
+    r->hash_next = route_hash[h];
+    route_hash[h] = r;
+  } else {
+    num_prefix_routes++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+index_remove(uip_ds6_route_t *r)
+{
+  uip_ds6_route_t **p;
+
+  last_route = NULL;
+  if(r->length == 128) {
+    for(p = &route_hash[hash_ipaddr(&r->ipaddr)]; *p != NULL;
+        p = &(*p)->hash_next) {
+      if(*p == r) {
+        *p = r->hash_next;
+        return;
+      }
+    }
+  } else {
+    num_prefix_routes--;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static uip_ds6_route_t *
+index_lookup(uip_ipaddr_t *addr)
+{
+  uip_ds6_route_t *r;
+  uip_ds6_route_t *found_route;
+  uint8_t longestmatch;
+
+  if(last_route != NULL && uip_ipaddr_cmp(addr, &last_addr)) {
+    return last_route;
+  }
+
+  found_route = NULL;
+  for(r = route_hash[hash_ipaddr(addr)]; r != NULL; r = r->hash_next) {
+    if(uip_ipaddr_cmp(addr, &r->ipaddr)) {
+      found_route = r;
+      break;
+    }
+  }
+
+  if(found_route == NULL && num_prefix_routes > 0) {
+    longestmatch = 0;
+    for(r = list_head(routelist); r != NULL; r = list_item_next(r)) {
+      if(r->length < 128 && r->length >= longestmatch &&
+         uip_ipaddr_prefixcmp(addr, &r->ipaddr, r->length)) {
+        longestmatch = r->length;
+        found_route = r;
+      }
+    }
+  }
+
+  if(found_route != NULL) {
+    last_route = found_route;
+    uip_ipaddr_copy(&last_addr, addr);
+  }
+  return found_route;
+}
+#endif /* (UIP_CONF_MAX_ROUTES != 0) && UIP_DS6_ROUTE_HASH_SIZE */
+/*---------------------------------------------------------------------------*/
 void
 uip_ds6_route_init(void)
 {
 #if (UIP_CONF_MAX_ROUTES != 0)
   memb_init(&routememb);
   list_init(routelist);
+#if UIP_DS6_ROUTE_HASH_SIZE
+  memset(route_hash, 0, sizeof(route_hash));
+  num_prefix_routes = 0;
+  last_route = NULL;
+#endif /* UIP_DS6_ROUTE_HASH_SIZE */
   nbr_table_register(nbr_routes,
                      (nbr_table_callback *)rm_routelist_callback);
 #endif /* (UIP_CONF_MAX_ROUTES != 0) */
@@ -175,12 +281,76 @@ uip_ds6_route_init(void)
 }
 #if (UIP_CONF_MAX_ROUTES != 0)
 /*---------------------------------------------------------------------------*/
+/* Get the nbr_routes entry of the next hop of a route */
+static struct uip_ds6_route_neighbor_routes *
+route_neighbor(uip_ds6_route_t *route)
+{
+#if UIP_DS6_ROUTE_COMPACT
+  return nbr_table_get_from_index(nbr_routes, route->neighbor_index);
+#else /* UIP_DS6_ROUTE_COMPACT */
+  return route->neighbor_routes;
+#endif /* UIP_DS6_ROUTE_COMPACT */
+}
+/*---------------------------------------------------------------------------*/
+/* Attach a route to the nbr_routes entry of its next hop */
+static int
+route_neighbor_attach(uip_ds6_route_t *route,
+                      struct uip_ds6_route_neighbor_routes *routes)
+{
+#if UIP_DS6_ROUTE_COMPACT
+  route->neighbor_index = nbr_table_get_index(nbr_routes, routes);
+  routes->num_routes++;
+#else /* UIP_DS6_ROUTE_COMPACT */
+  struct uip_ds6_route_neighbor_route *nbrr;
+
+  nbrr = memb_alloc(&neighborroutememb);
+  if(nbrr == NULL) {
+    return 0;
+  }
+  nbrr->route = route;
+  /* Add the route to this neighbor */
+  list_add(routes->route_list, nbrr);
+  route->neighbor_routes = routes;
+#endif /* UIP_DS6_ROUTE_COMPACT */
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Detach a route from its next hop. Returns non-zero if no routes
+   through that neighbor remain. */
+static int
+route_neighbor_detach(uip_ds6_route_t *route)
+{
+  struct uip_ds6_route_neighbor_routes *routes = route_neighbor(route);
+#if UIP_DS6_ROUTE_COMPACT
+  if(routes->num_routes > 0) {
+    routes->num_routes--;
+  }
+  return routes->num_routes == 0;
+#else /* UIP_DS6_ROUTE_COMPACT */
+  struct uip_ds6_route_neighbor_route *neighbor_route;
+
+  /* Find the corresponding neighbor_route and remove it. */
+  for(neighbor_route = list_head(routes->route_list);
+      neighbor_route != NULL && neighbor_route->route != route;
+      neighbor_route = list_item_next(neighbor_route));
+
+  if(neighbor_route == NULL) {
+    PRINTF("uip_ds6_route_rm: neighbor_route was NULL for ");
+    uip_debug_ipaddr_print(&route->ipaddr);
+    PRINTF("\n");
+  }
+  list_remove(routes->route_list, neighbor_route);
+  memb_free(&neighborroutememb, neighbor_route);
+  return list_head(routes->route_list) == NULL;
+#endif /* UIP_DS6_ROUTE_COMPACT */
+}
+/*---------------------------------------------------------------------------*/
 static uip_lladdr_t *
 uip_ds6_route_nexthop_lladdr(uip_ds6_route_t *route)
 {
   if(route != NULL) {
     return (uip_lladdr_t *)nbr_table_get_lladdr(nbr_routes,
-                                                route->neighbor_routes);
+                                                route_neighbor(route));
   } else {
     return NULL;
   }
@@ -254,15 +424,20 @@ uip_ds6_route_t *
 uip_ds6_route_lookup(uip_ipaddr_t *addr)
 {
 #if (UIP_CONF_MAX_ROUTES != 0)
-  uip_ds6_route_t *r;
   uip_ds6_route_t *found_route;
+#if !UIP_DS6_ROUTE_HASH_SIZE
+  uip_ds6_route_t *r;
   uint8_t longestmatch;
+#endif /* !UIP_DS6_ROUTE_HASH_SIZE */
 
   PRINTF("uip-ds6-route: Looking up route for ");
   PRINT6ADDR(addr);
   PRINTF("\n");
 
 
+#if UIP_DS6_ROUTE_HASH_SIZE
+  found_route = index_lookup(addr);
+#else /* UIP_DS6_ROUTE_HASH_SIZE */
   found_route = NULL;
   longestmatch = 0;
   for(r = uip_ds6_route_head();
@@ -278,6 +453,7 @@ uip_ds6_route_lookup(uip_ipaddr_t *addr)
       }
     }
   }
+#endif /* UIP_DS6_ROUTE_HASH_SIZE */
 
   if(found_route != NULL) {
     PRINTF("uip-ds6-route: Found route: ");
@@ -311,7 +487,6 @@ uip_ds6_route_add(uip_ipaddr_t *ipaddr, uint8_t length,
 {
 #if (UIP_CONF_MAX_ROUTES != 0)
   uip_ds6_route_t *r;
-  struct uip_ds6_route_neighbor_route *nbrr;
 
 #if DEBUG != DEBUG_NONE
   assert_nbr_routes_list_sane();
@@ -393,7 +568,11 @@ uip_ds6_route_add(uip_ipaddr_t *ipaddr, uint8_t length,
         PRINTF("uip_ds6_route_add: could not allocate neighbor table entry\n");
         return NULL;
       }
+#if UIP_DS6_ROUTE_COMPACT
+      routes->num_routes = 0;
+#else /* UIP_DS6_ROUTE_COMPACT */
       LIST_STRUCT_INIT(routes, route_list);
+#endif /* UIP_DS6_ROUTE_COMPACT */
 #ifdef NETSTACK_CONF_ROUTING_NEIGHBOR_ADDED_CALLBACK
       NETSTACK_CONF_ROUTING_NEIGHBOR_ADDED_CALLBACK((const linkaddr_t *)nexthop_lladdr);
 #endif
@@ -413,19 +592,13 @@ uip_ds6_route_add(uip_ipaddr_t *ipaddr, uint8_t length,
        and that there is a packet coming soon. */
     list_push(routelist, r);
 
-    nbrr = memb_alloc(&neighborroutememb);
-    if(nbrr == NULL) {
+    if(!route_neighbor_attach(r, routes)) {
       /* This should not happen, as we explicitly deallocated one
          route table entry above. */
       PRINTF("uip_ds6_route_add: could not allocate neighbor route list entry\n");
       memb_free(&routememb, r);
       return NULL;
     }
-
-    nbrr->route = r;
-    /* Add the route to this neighbor */
-    list_add(routes->route_list, nbrr);
-    r->neighbor_routes = routes;
     num_routes++;
 
     PRINTF("uip_ds6_route_add num %d\n", num_routes);
@@ -436,6 +609,9 @@ uip_ds6_route_add(uip_ipaddr_t *ipaddr, uint8_t length,
 
   uip_ipaddr_copy(&(r->ipaddr), ipaddr);
   r->length = length;
+#if UIP_DS6_ROUTE_HASH_SIZE
+  index_add(r);
+#endif /* UIP_DS6_ROUTE_HASH_SIZE */
 
 #ifdef UIP_DS6_ROUTE_STATE_TYPE
   memset(&r->state, 0, sizeof(UIP_DS6_ROUTE_STATE_TYPE));
@@ -467,11 +643,15 @@ void
 uip_ds6_route_rm(uip_ds6_route_t *route)
 {
 #if (UIP_CONF_MAX_ROUTES != 0)
-  struct uip_ds6_route_neighbor_route *neighbor_route;
+  struct uip_ds6_route_neighbor_routes *routes;
 #if DEBUG != DEBUG_NONE
   assert_nbr_routes_list_sane();
 #endif /* DEBUG != DEBUG_NONE */
-  if(route != NULL && route->neighbor_routes != NULL) {
+  if(route != NULL && (routes = route_neighbor(route)) != NULL) {
+#if UIP_DS6_NOTIFICATIONS
+    /* Resolve the next hop while the neighbor entry is still in use. */
+    uip_ipaddr_t *route_nexthop = uip_ds6_route_nexthop(route);
+#endif
 
     PRINTF("uip_ds6_route_rm: removing route: ");
     PRINT6ADDR(&route->ipaddr);
@@ -479,19 +659,11 @@ uip_ds6_route_rm(uip_ds6_route_t *route)
 
     /* Remove the route from the route list */
     list_remove(routelist, route);
+#if UIP_DS6_ROUTE_HASH_SIZE
+    index_remove(route);
+#endif /* UIP_DS6_ROUTE_HASH_SIZE */
 
-    /* Find the corresponding neighbor_route and remove it. */
-    for(neighbor_route = list_head(route->neighbor_routes->route_list);
-        neighbor_route != NULL && neighbor_route->route != route;
-        neighbor_route = list_item_next(neighbor_route));
-
-    if(neighbor_route == NULL) {
-      PRINTF("uip_ds6_route_rm: neighbor_route was NULL for ");
-      uip_debug_ipaddr_print(&route->ipaddr);
-      PRINTF("\n");
-    }
-    list_remove(route->neighbor_routes->route_list, neighbor_route);
-    if(list_head(route->neighbor_routes->route_list) == NULL) {
+    if(route_neighbor_detach(route)) {
       /* If this was the only route using this neighbor, remove the
          neighbor from the table - this implicitly unlocks nexthop */
 #if (DEBUG) & DEBUG_ANNOTATE
@@ -501,14 +673,13 @@ uip_ds6_route_rm(uip_ds6_route_t *route)
       }
 #endif /* (DEBUG) & DEBUG_ANNOTATE */
       PRINTF("uip_ds6_route_rm: removing neighbor too\n");
-      nbr_table_remove(nbr_routes, route->neighbor_routes->route_list);
+      nbr_table_remove(nbr_routes, routes);
 #ifdef NETSTACK_CONF_ROUTING_NEIGHBOR_REMOVED_CALLBACK
       NETSTACK_CONF_ROUTING_NEIGHBOR_REMOVED_CALLBACK(
-          (const linkaddr_t *)nbr_table_get_lladdr(nbr_routes, route->neighbor_routes->route_list));
+          (const linkaddr_t *)nbr_table_get_lladdr(nbr_routes, routes));
 #endif
     }
     memb_free(&routememb, route);
-    memb_free(&neighborroutememb, neighbor_route);
 
     num_routes--;
 
@@ -516,7 +687,7 @@ uip_ds6_route_rm(uip_ds6_route_t *route)
 
 #if UIP_DS6_NOTIFICATIONS
     call_route_callback(UIP_DS6_NOTIFICATION_ROUTE_RM,
-        &route->ipaddr, uip_ds6_route_nexthop(route));
+        &route->ipaddr, route_nexthop);
 #endif
   }
 
@@ -536,6 +707,19 @@ rm_routelist(struct uip_ds6_route_neighbor_routes *routes)
   assert_nbr_routes_list_sane();
 #endif /* DEBUG != DEBUG_NONE */
   PRINTF("uip_ds6_route_rm_routelist\n");
+#if UIP_DS6_ROUTE_COMPACT
+  if(routes != NULL) {
+    uip_ds6_route_t *r;
+    uip_ds6_route_t *next;
+    for(r = list_head(routelist); r != NULL; r = next) {
+      next = list_item_next(r);
+      if(route_neighbor(r) == routes) {
+        uip_ds6_route_rm(r);
+      }
+    }
+    nbr_table_remove(nbr_routes, routes);
+  }
+#else /* UIP_DS6_ROUTE_COMPACT */
   if(routes != NULL && routes->route_list != NULL) {
     struct uip_ds6_route_neighbor_route *r;
     r = list_head(routes->route_list);
@@ -545,6 +729,7 @@ rm_routelist(struct uip_ds6_route_neighbor_routes *routes)
     }
     nbr_table_remove(nbr_routes, routes);
   }
+#endif /* UIP_DS6_ROUTE_COMPACT */
 #if DEBUG != DEBUG_NONE
   assert_nbr_routes_list_sane();
 #endif /* DEBUG != DEBUG_NONE */
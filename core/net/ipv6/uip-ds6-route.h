@@ -88,6 +88,14 @@ void uip_ds6_notification_rm(struct uip_ds6_notification *n);
 #define UIP_DS6_ROUTE_NB 4
 #endif /* UIP_CONF_MAX_ROUTES */
 
+/** \brief Number of buckets in the index of host (/128) routes, 0 to
+ *  search the routing table linearly */
+#ifdef UIP_DS6_ROUTE_CONF_HASH_SIZE
+#define UIP_DS6_ROUTE_HASH_SIZE UIP_DS6_ROUTE_CONF_HASH_SIZE
+#else /* UIP_DS6_ROUTE_CONF_HASH_SIZE */
+#define UIP_DS6_ROUTE_HASH_SIZE 0
+#endif /* UIP_DS6_ROUTE_CONF_HASH_SIZE */
+
 /** \brief define some additional RPL related route state and
  *  neighbor callback for RPL - if not a DS6_ROUTE_STATE is already set */
 #ifndef UIP_DS6_ROUTE_STATE_TYPE
@@ -138,10 +146,28 @@ typedef struct rpl_route_entry {
 } rpl_route_entry_t;
 #endif /* UIP_DS6_ROUTE_STATE_TYPE */
 
+/** \brief Compact route storage: routes refer to their next hop by
+ *  nbr-table index and neighbors only count their routes, instead of
+ *  keeping a list node per route. Removing all routes through a
+ *  neighbor then requires a scan of the routing table. */
+#ifdef UIP_DS6_ROUTE_CONF_COMPACT
+#define UIP_DS6_ROUTE_COMPACT UIP_DS6_ROUTE_CONF_COMPACT
+#else /* UIP_DS6_ROUTE_CONF_COMPACT */
+#define UIP_DS6_ROUTE_COMPACT 0
+#endif /* UIP_DS6_ROUTE_CONF_COMPACT */
+
+#if UIP_DS6_ROUTE_COMPACT && NBR_TABLE_MAX_NEIGHBORS > 255
+#error UIP_DS6_ROUTE_CONF_COMPACT requires at most 255 neighbors
+#endif
+
 /** \brief The neighbor routes hold a list of routing table entries
     that are attached to a specific neihbor. */
 struct uip_ds6_route_neighbor_routes {
+#if UIP_DS6_ROUTE_COMPACT
+  uint16_t num_routes;
+#else /* UIP_DS6_ROUTE_COMPACT */
   LIST_STRUCT(route_list);
+#endif /* UIP_DS6_ROUTE_COMPACT */
 };
 
 /** \brief An entry in the routing table */
@@ -152,12 +178,22 @@ typedef struct uip_ds6_route {
      routes field point to the uip_ds6_route_neighbor_routes that
      belong to the neighbor table entry that this routing table entry
      uses. */
+#if !UIP_DS6_ROUTE_COMPACT
   struct uip_ds6_route_neighbor_routes *neighbor_routes;
+#endif /* !UIP_DS6_ROUTE_COMPACT */
+#if UIP_DS6_ROUTE_HASH_SIZE
+  /* Next host route in the same bucket of the route index. */
+  struct uip_ds6_route *hash_next;
+#endif /* UIP_DS6_ROUTE_HASH_SIZE */
   uip_ipaddr_t ipaddr;
 #ifdef UIP_DS6_ROUTE_STATE_TYPE
   UIP_DS6_ROUTE_STATE_TYPE state;
 #endif
   uint8_t length;
+#if UIP_DS6_ROUTE_COMPACT
+  /* The nbr_routes index of the next hop. */
+  uint8_t neighbor_index;
+#endif /* UIP_DS6_ROUTE_COMPACT */
 } uip_ds6_route_t;
 
 /** \brief A neighbor route list entry, used on the
@@ -89,6 +89,26 @@ static uip_ds6_aaddr_t *locaaddr;
 #endif /* UIP_DS6_AADDR_NB */
 static uip_ds6_prefix_t *locprefix;
 
+/*
+ * A byte hashed from the interface identifier of each unicast and multicast
+ * address, so that lookups compare whole addresses only when it matches
+ */
+static uint8_t addr_hash[UIP_DS6_ADDR_NB];
+static uint8_t maddr_hash[UIP_DS6_MADDR_NB];
+
+#if UIP_DS6_SRC_CACHE_NB > 0
+/* Bumped whenever a unicast address is added, to invalidate the cache */
+static uint8_t addr_generation;
+
+static struct src_cache_entry {
+  uip_ipaddr_t dst;
+  uip_ds6_addr_t *src;
+  uint16_t candidates;
+  uint8_t generation;
+} src_cache[UIP_DS6_SRC_CACHE_NB];
+static uint8_t src_cache_next;
+#endif /* UIP_DS6_SRC_CACHE_NB > 0 */
+
 /*---------------------------------------------------------------------------*/
 void
 uip_ds6_init(void)
@@ -103,6 +123,9 @@ uip_ds6_init(void)
      UIP_DS6_ADDR_NB, UIP_DS6_MADDR_NB, UIP_DS6_AADDR_NB);
   memset(uip_ds6_prefix_list, 0, sizeof(uip_ds6_prefix_list));
   memset(&uip_ds6_if, 0, sizeof(uip_ds6_if));
+#if UIP_DS6_SRC_CACHE_NB > 0
+  memset(src_cache, 0, sizeof(src_cache));
+#endif /* UIP_DS6_SRC_CACHE_NB > 0 */
   uip_ds6_addr_size = sizeof(struct uip_ds6_addr);
   uip_ds6_netif_addr_list_offset = offsetof(struct uip_ds6_netif, addr_list);
 
@@ -161,10 +184,33 @@ uip_ds6_periodic(void)
                 && (uip_len == 0)) {
         uip_ds6_dad(locaddr);
 #endif /* UIP_ND6_DEF_MAXDADNS > 0 */
+#if UIP_ND6_6LOWPAN && !UIP_CONF_ROUTER
+      } else if(!uip_is_addr_linklocal(&locaddr->ipaddr)
+                && stimer_expired(&locaddr->regtimer)
+                && (uip_len == 0)) {
+        uip_ds6_register(locaddr);
+#endif /* UIP_ND6_6LOWPAN && !UIP_CONF_ROUTER */
       }
     }
   }
 
+#if UIP_ND6_6LOWPAN && !UIP_CONF_ROUTER
+  /* Routers do not send periodic RAs: ask the default router for one,
+     unicast, before its lifetime runs out. The RS timer spaces the
+     attempts */
+  if(uip_len == 0 && etimer_expired(&uip_ds6_timer_rs)) {
+    uip_ipaddr_t *router = uip_ds6_defrt_choose();
+    uip_ds6_defrt_t *d = router == NULL ? NULL : uip_ds6_defrt_lookup(router);
+    if(d != NULL && !d->isinfinite &&
+       stimer_remaining(&d->lifetime) < UIP_ND6_MAX_RTR_SOLICITATION_INTERVAL) {
+      PRINTF("Refreshing default router\n");
+      uip_nd6_rs_unicast_output(router);
+      etimer_set(&uip_ds6_timer_rs,
+                 UIP_ND6_RTR_SOLICITATION_INTERVAL * CLOCK_SECOND);
+    }
+  }
+#endif /* UIP_ND6_6LOWPAN && !UIP_CONF_ROUTER */
+
   /* Periodic processing on default routers */
   uip_ds6_defrt_periodic();
   /*  for(locdefrt = uip_ds6_defrt_list;
@@ -191,16 +237,23 @@ uip_ds6_periodic(void)
   uip_ds6_neighbor_periodic();
 #endif /* UIP_ND6_SEND_RA */
 
-#if UIP_CONF_ROUTER && UIP_ND6_SEND_RA
+#if UIP_CONF_ROUTER && UIP_ND6_SEND_RA && !UIP_ND6_6LOWPAN
   /* Periodic RA sending */
   if(stimer_expired(&uip_ds6_timer_ra) && (uip_len == 0)) {
     uip_ds6_send_ra_periodic();
   }
-#endif /* UIP_CONF_ROUTER && UIP_ND6_SEND_RA */
+#endif /* UIP_CONF_ROUTER && UIP_ND6_SEND_RA && !UIP_ND6_6LOWPAN */
   etimer_reset(&uip_ds6_timer_periodic);
   return;
 }
 
+/*---------------------------------------------------------------------------*/
+static uint8_t
+iid_hash(const uip_ipaddr_t *ipaddr)
+{
+  return ipaddr->u8[15] ^ ipaddr->u8[14] ^ ipaddr->u8[13] ^
+    (ipaddr->u8[12] << 1) ^ (ipaddr->u8[11] << 2) ^ (ipaddr->u8[8] << 3);
+}
 /*---------------------------------------------------------------------------*/
 uint8_t
 uip_ds6_list_loop(uip_ds6_element_t *list, uint8_t size,
@@ -332,6 +385,10 @@ uip_ds6_addr_add(uip_ipaddr_t *ipaddr, unsigned long vlifetime, uint8_t type)
       (uip_ds6_element_t **)&locaddr) == FREESPACE) {
     locaddr->isused = 1;
     uip_ipaddr_copy(&locaddr->ipaddr, ipaddr);
+    addr_hash[locaddr - uip_ds6_if.addr_list] = iid_hash(ipaddr);
+#if UIP_DS6_SRC_CACHE_NB > 0
+    addr_generation++;
+#endif /* UIP_DS6_SRC_CACHE_NB > 0 */
     locaddr->type = type;
     if(vlifetime == 0) {
       locaddr->isinfinite = 1;
@@ -345,6 +402,15 @@ uip_ds6_addr_add(uip_ipaddr_t *ipaddr, unsigned long vlifetime, uint8_t type)
               random_rand() % (UIP_ND6_MAX_RTR_SOLICITATION_DELAY *
                                CLOCK_SECOND));
     locaddr->dadnscount = 0;
+#elif UIP_ND6_6LOWPAN && !UIP_CONF_ROUTER
+    /* Global addresses are used once registered with the router */
+    if(uip_is_addr_linklocal(ipaddr)) {
+      locaddr->state = ADDR_PREFERRED;
+    } else {
+      locaddr->state = ADDR_TENTATIVE;
+      stimer_set(&locaddr->regtimer, 0);
+      locaddr->regcount = 0;
+    }
 #else /* UIP_ND6_DEF_MAXDADNS > 0 */
     locaddr->state = ADDR_PREFERRED;
 #endif /* UIP_ND6_DEF_MAXDADNS > 0 */
@@ -373,11 +439,15 @@ uip_ds6_addr_rm(uip_ds6_addr_t *addr)
 uip_ds6_addr_t *
 uip_ds6_addr_lookup(uip_ipaddr_t *ipaddr)
 {
-  if(uip_ds6_list_loop
-     ((uip_ds6_element_t *)uip_ds6_if.addr_list, UIP_DS6_ADDR_NB,
-      sizeof(uip_ds6_addr_t), ipaddr, 128,
-      (uip_ds6_element_t **)&locaddr) == FOUND) {
-    return locaddr;
+  uint8_t hash;
+  uint8_t i;
+
+  hash = iid_hash(ipaddr);
+  for(i = 0; i < UIP_DS6_ADDR_NB; i++) {
+    if(addr_hash[i] == hash && uip_ds6_if.addr_list[i].isused &&
+       uip_ipaddr_cmp(&uip_ds6_if.addr_list[i].ipaddr, ipaddr)) {
+      return &uip_ds6_if.addr_list[i];
+    }
   }
   return NULL;
 }
@@ -430,6 +500,7 @@ uip_ds6_maddr_add(const uip_ipaddr_t *ipaddr)
       (uip_ds6_element_t **)&locmaddr) == FREESPACE) {
     locmaddr->isused = 1;
     uip_ipaddr_copy(&locmaddr->ipaddr, ipaddr);
+    maddr_hash[locmaddr - uip_ds6_if.maddr_list] = iid_hash(ipaddr);
     return locmaddr;
   }
   return NULL;
@@ -449,11 +520,15 @@ uip_ds6_maddr_rm(uip_ds6_maddr_t *maddr)
 uip_ds6_maddr_t *
 uip_ds6_maddr_lookup(const uip_ipaddr_t *ipaddr)
 {
-  if(uip_ds6_list_loop
-     ((uip_ds6_element_t *)uip_ds6_if.maddr_list, UIP_DS6_MADDR_NB,
-      sizeof(uip_ds6_maddr_t), (void*)ipaddr, 128,
-      (uip_ds6_element_t **)&locmaddr) == FOUND) {
-    return locmaddr;
+  uint8_t hash;
+  uint8_t i;
+
+  hash = iid_hash(ipaddr);
+  for(i = 0; i < UIP_DS6_MADDR_NB; i++) {
+    if(maddr_hash[i] == hash && uip_ds6_if.maddr_list[i].isused &&
+       uip_ipaddr_cmp(&uip_ds6_if.maddr_list[i].ipaddr, ipaddr)) {
+      return &uip_ds6_if.maddr_list[i];
+    }
   }
   return NULL;
 }
@@ -501,27 +576,92 @@ uip_ds6_aaddr_lookup(uip_ipaddr_t *ipaddr)
 }
 
 /*---------------------------------------------------------------------------*/
-void
-uip_ds6_select_src(uip_ipaddr_t *src, uip_ipaddr_t *dst)
+#if UIP_DS6_SRC_CACHE_NB > 0
+/*
+ * The preferred global addresses, one bit per slot of the address list.
+ * Addresses change state out of uip-ds6 too, so this is checked every time.
+ */
+static uint16_t
+src_candidates(uint8_t *count, uip_ds6_addr_t **last)
+{
+  uint16_t candidates = 0;
+  uint8_t i;
+
+  *count = 0;
+  for(i = 0; i < UIP_DS6_ADDR_NB; i++) {
+    if(uip_ds6_if.addr_list[i].isused &&
+       uip_ds6_if.addr_list[i].state == ADDR_PREFERRED &&
+       !uip_is_addr_linklocal(&uip_ds6_if.addr_list[i].ipaddr)) {
+      candidates |= (uint16_t)1 << i;
+      (*count)++;
+      *last = &uip_ds6_if.addr_list[i];
+    }
+  }
+  return candidates;
+}
+#endif /* UIP_DS6_SRC_CACHE_NB > 0 */
+/*---------------------------------------------------------------------------*/
+static uip_ds6_addr_t *
+longest_match(uip_ipaddr_t *dst)
 {
   uint8_t best = 0;             /* number of bit in common with best match */
   uint8_t n = 0;
   uip_ds6_addr_t *matchaddr = NULL;
 
-  if(!uip_is_addr_linklocal(dst) && !uip_is_addr_mcast(dst)) {
-    /* find longest match */
-    for(locaddr = uip_ds6_if.addr_list;
-        locaddr < uip_ds6_if.addr_list + UIP_DS6_ADDR_NB; locaddr++) {
-      /* Only preferred global (not link-local) addresses */
-      if(locaddr->isused && locaddr->state == ADDR_PREFERRED &&
-         !uip_is_addr_linklocal(&locaddr->ipaddr)) {
-        n = get_match_length(dst, &locaddr->ipaddr);
-        if(n >= best) {
-          best = n;
-          matchaddr = locaddr;
-        }
+  for(locaddr = uip_ds6_if.addr_list;
+      locaddr < uip_ds6_if.addr_list + UIP_DS6_ADDR_NB; locaddr++) {
+    /* Only preferred global (not link-local) addresses */
+    if(locaddr->isused && locaddr->state == ADDR_PREFERRED &&
+       !uip_is_addr_linklocal(&locaddr->ipaddr)) {
+      n = get_match_length(dst, &locaddr->ipaddr);
+      if(n >= best) {
+        best = n;
+        matchaddr = locaddr;
       }
     }
+  }
+  return matchaddr;
+}
+/*---------------------------------------------------------------------------*/
+static uip_ds6_addr_t *
+select_global_src(uip_ipaddr_t *dst)
+{
+#if UIP_DS6_SRC_CACHE_NB > 0
+  uint16_t candidates;
+  uint8_t count;
+  uip_ds6_addr_t *last = NULL;
+  struct src_cache_entry *e;
+
+  candidates = src_candidates(&count, &last);
+  if(count <= 1) {
+    /* Nothing to choose from */
+    return last;
+  }
+  for(e = src_cache; e < src_cache + UIP_DS6_SRC_CACHE_NB; e++) {
+    if(e->src != NULL && e->candidates == candidates &&
+       e->generation == addr_generation && uip_ipaddr_cmp(&e->dst, dst)) {
+      return e->src;
+    }
+  }
+  e = &src_cache[src_cache_next];
+  src_cache_next = (src_cache_next + 1) % UIP_DS6_SRC_CACHE_NB;
+  uip_ipaddr_copy(&e->dst, dst);
+  e->candidates = candidates;
+  e->generation = addr_generation;
+  e->src = longest_match(dst);
+  return e->src;
+#else /* UIP_DS6_SRC_CACHE_NB > 0 */
+  return longest_match(dst);
+#endif /* UIP_DS6_SRC_CACHE_NB > 0 */
+}
+/*---------------------------------------------------------------------------*/
+void
+uip_ds6_select_src(uip_ipaddr_t *src, uip_ipaddr_t *dst)
+{
+  uip_ds6_addr_t *matchaddr = NULL;
+
+  if(!uip_is_addr_linklocal(dst) && !uip_is_addr_mcast(dst)) {
+    matchaddr = select_global_src(dst);
 #if UIP_IPV6_MULTICAST
   } else if(uip_is_addr_mcast_routable(dst)) {
     matchaddr = uip_ds6_get_global(ADDR_PREFERRED);
@@ -558,6 +698,32 @@ uip_ds6_set_addr_iid(uip_ipaddr_t *ipaddr, uip_lladdr_t *lladdr)
 #endif
 }
 
+/*---------------------------------------------------------------------------*/
+int
+uip_ds6_set_lladdr_from_iid(uip_lladdr_t *lladdr, const uip_ipaddr_t *ipaddr)
+{
+#if (UIP_LLADDR_LEN == 8)
+  /* IIDs built from a 16-bit short address (RFC 4944) are not */
+  if(ipaddr->u8[8] == 0 && ipaddr->u8[9] == 0 && ipaddr->u8[10] == 0 &&
+     ipaddr->u8[11] == 0xff && ipaddr->u8[12] == 0xfe && ipaddr->u8[13] == 0) {
+    return 0;
+  }
+  memcpy(lladdr, ipaddr->u8 + 8, UIP_LLADDR_LEN);
+  ((uint8_t *)lladdr)[0] ^= 0x02;
+  return 1;
+#elif (UIP_LLADDR_LEN == 6)
+  if(ipaddr->u8[11] != 0xff || ipaddr->u8[12] != 0xfe) {
+    return 0;
+  }
+  memcpy(lladdr, ipaddr->u8 + 8, 3);
+  memcpy((uint8_t *)lladdr + 3, ipaddr->u8 + 13, 3);
+  ((uint8_t *)lladdr)[0] ^= 0x02;
+  return 1;
+#else
+  return 0;
+#endif
+}
+
 /*---------------------------------------------------------------------------*/
 uint8_t
 get_match_length(uip_ipaddr_t *src, uip_ipaddr_t *dst)
@@ -626,6 +792,76 @@ uip_ds6_dad_failed(uip_ds6_addr_t *addr)
 }
 #endif /*UIP_ND6_DEF_MAXDADNS > 0 */
 
+#if UIP_ND6_6LOWPAN && !UIP_CONF_ROUTER
+/*---------------------------------------------------------------------------*/
+void
+uip_ds6_register(uip_ds6_addr_t *addr)
+{
+  uip_ipaddr_t *router;
+
+  router = uip_ds6_defrt_choose();
+  if(router == NULL) {
+    /* Wait for a router */
+    stimer_set(&addr->regtimer, UIP_ND6_RTR_SOLICITATION_INTERVAL);
+    return;
+  }
+  if(addr->regcount < UIP_ND6_MAX_UNICAST_SOLICIT) {
+    uip_nd6_ns_output_aro(&addr->ipaddr, router,
+                          UIP_ND6_REGISTRATION_LIFETIME);
+    addr->regcount++;
+    stimer_set(&addr->regtimer, uip_ds6_if.retrans_timer / 1000);
+    return;
+  }
+  addr->regcount = 0;
+  if(addr->state == ADDR_TENTATIVE) {
+    /*
+     * The router does not know about registrations (RFC 4861 only):
+     * use the address as is, EUI-64 based addresses need no DAD
+     */
+    PRINTF("Registration unanswered, using ");
+    PRINT6ADDR(&addr->ipaddr);
+    PRINTF("\n");
+    addr->state = ADDR_PREFERRED;
+    stimer_set(&addr->regtimer,
+               (unsigned long)UIP_ND6_REGISTRATION_LIFETIME *
+               UIP_ND6_ARO_LIFETIME_UNIT);
+  } else {
+    /* Refreshing failed, try again before the registration expires */
+    stimer_set(&addr->regtimer, UIP_ND6_MAX_RTR_SOLICITATION_INTERVAL);
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+void
+uip_ds6_register_done(uip_ds6_addr_t *addr, uint8_t status,
+                      uint16_t lifetime)
+{
+  PRINTF("Registration of ");
+  PRINT6ADDR(&addr->ipaddr);
+  PRINTF(" status %u lifetime %u\n", status, lifetime);
+
+  addr->regcount = 0;
+  switch(status) {
+  case UIP_ND6_ARO_STATUS_SUCCESS:
+    if(lifetime == 0) {
+      lifetime = UIP_ND6_REGISTRATION_LIFETIME;
+    }
+    addr->state = ADDR_PREFERRED;
+    /* Refresh when three quarters of the lifetime have passed */
+    stimer_set(&addr->regtimer,
+               (unsigned long)lifetime * UIP_ND6_ARO_LIFETIME_UNIT / 4 * 3);
+    break;
+  case UIP_ND6_ARO_STATUS_DUPLICATE:
+    uip_ds6_addr_rm(addr);
+    break;
+  default:
+    /* The router has no room for us, try again later */
+    stimer_set(&addr->regtimer, UIP_ND6_MAX_RTR_SOLICITATION_INTERVAL);
+    break;
+  }
+}
+#endif /* UIP_ND6_6LOWPAN && !UIP_CONF_ROUTER */
+
 /*---------------------------------------------------------------------------*/
 #if UIP_CONF_ROUTER
 #if UIP_ND6_SEND_RA
@@ -684,6 +920,30 @@ uip_ds6_send_ra_periodic(void)
 void
 uip_ds6_send_rs(void)
 {
+#if UIP_ND6_6LOWPAN
+  /* Keep soliciting with a truncated binary exponential backoff, there
+     are no periodic RAs to wait for (RFC 6775, 5.3) */
+  if(uip_ds6_defrt_choose() == NULL) {
+    unsigned long interval = UIP_ND6_RTR_SOLICITATION_INTERVAL;
+    uint8_t backoff;
+    PRINTF("Sending RS %u\n", rscount);
+    uip_nd6_rs_output();
+    if(rscount < 255) {
+      rscount++;
+    }
+    if(rscount > UIP_ND6_MAX_RTR_SOLICITATIONS) {
+      for(backoff = rscount - UIP_ND6_MAX_RTR_SOLICITATIONS;
+          backoff > 0 && interval < UIP_ND6_MAX_RTR_SOLICITATION_INTERVAL;
+          backoff--) {
+        interval <<= 1;
+      }
+      if(interval > UIP_ND6_MAX_RTR_SOLICITATION_INTERVAL) {
+        interval = UIP_ND6_MAX_RTR_SOLICITATION_INTERVAL;
+      }
+    }
+    etimer_set(&uip_ds6_timer_rs, interval * CLOCK_SECOND);
+  } else {
+#else /* UIP_ND6_6LOWPAN */
   if((uip_ds6_defrt_choose() == NULL)
      && (rscount < UIP_ND6_MAX_RTR_SOLICITATIONS)) {
     PRINTF("Sending RS %u\n", rscount);
@@ -692,9 +952,13 @@ uip_ds6_send_rs(void)
     etimer_set(&uip_ds6_timer_rs,
                UIP_ND6_RTR_SOLICITATION_INTERVAL * CLOCK_SECOND);
   } else {
+#endif /* UIP_ND6_6LOWPAN */
     PRINTF("Router found ? (boolean): %u\n",
            (uip_ds6_defrt_choose() != NULL));
     etimer_stop(&uip_ds6_timer_rs);
+#if UIP_ND6_6LOWPAN
+    rscount = 0;
+#endif /* UIP_ND6_6LOWPAN */
   }
   return;
 }
@@ -143,6 +143,18 @@
 #endif
 #define UIP_DS6_AADDR_NB UIP_DS6_AADDR_NBS + UIP_DS6_AADDR_NBU
 
+/* Source address selection cache: the source selected for the last
+ * destinations, kept while the preferred global addresses do not change.
+ * Only used when there is more than one such address to choose from */
+#ifndef UIP_CONF_DS6_SRC_CACHE_NB
+#define UIP_DS6_SRC_CACHE_NB 2
+#else
+#define UIP_DS6_SRC_CACHE_NB UIP_CONF_DS6_SRC_CACHE_NB
+#endif
+#if UIP_DS6_SRC_CACHE_NB > 0 && UIP_DS6_ADDR_NB > 16
+#error The source address cache supports up to 16 unicast addresses
+#endif
+
 /*--------------------------------------------------*/
 /* Should we use LinkLayer acks in NUD ?*/
 #ifndef UIP_CONF_DS6_LL_NUD
@@ -212,6 +224,12 @@ typedef struct uip_ds6_addr {
   struct timer dadtimer;
   uint8_t dadnscount;
 #endif /* UIP_ND6_DEF_MAXDADNS > 0 */
+#if UIP_ND6_6LOWPAN && !UIP_CONF_ROUTER
+  /* Next (re)registration with the default router, and the NS sent
+     for it without an answer */
+  struct stimer regtimer;
+  uint8_t regcount;
+#endif /* UIP_ND6_6LOWPAN && !UIP_CONF_ROUTER */
 } uip_ds6_addr_t;
 
 /** \brief Anycast address  */
@@ -344,6 +362,14 @@ uip_ds6_aaddr_t *uip_ds6_aaddr_lookup(uip_ipaddr_t *ipaddr);
 /** \brief set the last 64 bits of an IP address based on the MAC address */
 void uip_ds6_set_addr_iid(uip_ipaddr_t *ipaddr, uip_lladdr_t *lladdr);
 
+/**
+ * \brief Get the MAC address an IP address was built from
+ * \return 1 if the IID of the address is built from a MAC address,
+ * as uip_ds6_set_addr_iid() does, 0 otherwise
+ */
+int uip_ds6_set_lladdr_from_iid(uip_lladdr_t *lladdr,
+                                const uip_ipaddr_t *ipaddr);
+
 /** \brief Get the number of matching bits of two addresses */
 uint8_t get_match_length(uip_ipaddr_t *src, uip_ipaddr_t *dst);
 
@@ -355,6 +381,15 @@ void uip_ds6_dad(uip_ds6_addr_t *ifaddr);
 int uip_ds6_dad_failed(uip_ds6_addr_t *ifaddr);
 #endif /* UIP_ND6_DEF_MAXDADNS */
 
+#if UIP_ND6_6LOWPAN && !UIP_CONF_ROUTER
+/** \brief Register one address with the default router (RFC 6775) */
+void uip_ds6_register(uip_ds6_addr_t *ifaddr);
+
+/** \brief Callback when the router answered a registration */
+void uip_ds6_register_done(uip_ds6_addr_t *ifaddr, uint8_t status,
+                           uint16_t lifetime);
+#endif /* UIP_ND6_6LOWPAN && !UIP_CONF_ROUTER */
+
 /** \brief Source address selection, see RFC 3484 */
 void uip_ds6_select_src(uip_ipaddr_t *src, uip_ipaddr_t *dst);
 
@@ -71,6 +71,29 @@
 /** \brief temporary IP address */
 static uip_ipaddr_t tmp_ipaddr;
 
+#if UIP_ICMP6_ERROR_RATE
+/* A token bucket for the error messages */
+struct error_bucket {
+  clock_time_t refilled;
+  uint8_t tokens;
+};
+
+/* The bucket of a destination of error messages */
+struct error_dest {
+  uip_ipaddr_t ipaddr;
+  struct error_bucket bucket;
+  clock_time_t last_used;
+  uint8_t used;
+};
+
+/* The time to earn one token */
+#define ERROR_PERIOD ((CLOCK_SECOND / UIP_ICMP6_ERROR_RATE) > 0 ? \
+                      (CLOCK_SECOND / UIP_ICMP6_ERROR_RATE) : 1)
+
+static struct error_bucket all_errors;
+static struct error_dest error_dests[UIP_ICMP6_ERROR_DESTS];
+#endif /* UIP_ICMP6_ERROR_RATE */
+
 LIST(echo_reply_callback_list);
 /*---------------------------------------------------------------------------*/
 /* List of input handlers */
@@ -179,6 +202,67 @@ echo_request_input(void)
   return;
 }
 /*---------------------------------------------------------------------------*/
+#if UIP_ICMP6_ERROR_RATE
+/* Takes a token, earned once per period up to burst tokens */
+static int
+bucket_take(struct error_bucket *b, clock_time_t period, uint8_t burst)
+{
+  clock_time_t now = clock_time();
+  clock_time_t earned = (now - b->refilled) / period;
+
+  if(earned >= burst - b->tokens) {
+    b->tokens = burst;
+    b->refilled = now;
+  } else {
+    b->tokens += earned;
+    b->refilled += earned * period;
+  }
+  if(b->tokens == 0) {
+    return 0;
+  }
+  b->tokens--;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Whether an error message may be sent to an address now */
+static int
+error_allowed(const uip_ipaddr_t *dest)
+{
+  struct error_dest *d, *oldest;
+  clock_time_t now = clock_time();
+
+  oldest = &error_dests[0];
+  for(d = error_dests; d < &error_dests[UIP_ICMP6_ERROR_DESTS]; d++) {
+    if(d->used && uip_ipaddr_cmp(&d->ipaddr, dest)) {
+      break;
+    }
+    if(!d->used) {
+      if(oldest->used) {
+        oldest = d;
+      }
+    } else if(oldest->used &&
+              (clock_time_t)(now - d->last_used) >
+              (clock_time_t)(now - oldest->last_used)) {
+      oldest = d;
+    }
+  }
+  if(d == &error_dests[UIP_ICMP6_ERROR_DESTS]) {
+    /* Takes the place of the destination sent to the longest ago */
+    d = oldest;
+    uip_ipaddr_copy(&d->ipaddr, dest);
+    d->bucket.tokens = UIP_ICMP6_ERROR_BURST;
+    d->bucket.refilled = now;
+    d->used = 1;
+  }
+  d->last_used = now;
+
+  return bucket_take(&d->bucket, ERROR_PERIOD, UIP_ICMP6_ERROR_BURST) &&
+    bucket_take(&all_errors, ERROR_PERIOD / UIP_ICMP6_ERROR_DESTS > 0 ?
+                ERROR_PERIOD / UIP_ICMP6_ERROR_DESTS : 1,
+                UIP_ICMP6_ERROR_BURST);
+}
+#endif /* UIP_ICMP6_ERROR_RATE */
+/*---------------------------------------------------------------------------*/
 void
 uip_icmp6_error_output(uint8_t type, uint8_t code, uint32_t param) {
   /* check if originating packet is not an ICMP error */
@@ -194,6 +278,18 @@ uip_icmp6_error_output(uint8_t type, uint8_t code, uint32_t param) {
     }
   }
 
+#if UIP_ICMP6_ERROR_RATE
+  /* Before the packet is turned into an error message */
+  if(!error_allowed(&UIP_IP_BUF->srcipaddr)) {
+    PRINTF("ICMPv6 error to ");
+    PRINT6ADDR(&UIP_IP_BUF->srcipaddr);
+    PRINTF(" rate limited\n");
+    UIP_STAT(++uip_stat.icmp.ratelimit);
+    uip_clear_buf();
+    return;
+  }
+#endif /* UIP_ICMP6_ERROR_RATE */
+
 #if UIP_CONF_IPV6_RPL
   rpl_remove_header();
 #else
@@ -373,6 +469,12 @@ uip_icmp6_init()
   /* Register Echo Request and Reply handlers */
   uip_icmp6_register_input_handler(&echo_request_handler);
   uip_icmp6_register_input_handler(&echo_reply_handler);
+
+#if UIP_ICMP6_ERROR_RATE
+  all_errors.tokens = UIP_ICMP6_ERROR_BURST;
+  all_errors.refilled = clock_time();
+  memset(error_dests, 0, sizeof(error_dests));
+#endif /* UIP_ICMP6_ERROR_RATE */
 }
 /*---------------------------------------------------------------------------*/
 /** @} */
@@ -107,6 +107,33 @@ typedef struct uip_icmp6_error{
   uint32_t param;
 } uip_icmp6_error;
 
+/**
+ * \brief Rate limiting of ICMPv6 error messages (RFC 4443, 2.4 f)
+ *
+ * Token buckets allow UIP_ICMP6_ERROR_RATE errors per second to a
+ * destination, in bursts of up to UIP_ICMP6_ERROR_BURST. The last
+ * UIP_ICMP6_ERROR_DESTS destinations have a bucket of their own, and
+ * all together get UIP_ICMP6_ERROR_DESTS times the rate of one.
+ * A rate of 0 disables the limiting.
+ */
+#ifdef UIP_CONF_ICMP6_ERROR_RATE
+#define UIP_ICMP6_ERROR_RATE UIP_CONF_ICMP6_ERROR_RATE
+#else
+#define UIP_ICMP6_ERROR_RATE 1
+#endif
+
+#ifdef UIP_CONF_ICMP6_ERROR_BURST
+#define UIP_ICMP6_ERROR_BURST UIP_CONF_ICMP6_ERROR_BURST
+#else
+#define UIP_ICMP6_ERROR_BURST 4
+#endif
+
+#ifdef UIP_CONF_ICMP6_ERROR_DESTS
+#define UIP_ICMP6_ERROR_DESTS UIP_CONF_ICMP6_ERROR_DESTS
+#else
+#define UIP_ICMP6_ERROR_DESTS 4
+#endif
+
 /** \name ICMPv6 RFC4443 Message processing and sending */
 /** @{ */
 /**
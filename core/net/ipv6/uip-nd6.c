@@ -74,6 +74,9 @@
 #include "net/ipv6/uip-ds6.h"
 #include "net/ip/uip-nameserver.h"
 #include "lib/random.h"
+#if UIP_ND6_RA_6CO
+#include "net/ipv6/sicslowpan.h"
+#endif /* UIP_ND6_RA_6CO */
 
 /*------------------------------------------------------------------*/
 #define DEBUG 0
@@ -114,6 +117,7 @@ void uip_log(char *msg);
 #define UIP_ND6_OPT_PREFIX_BUF ((uip_nd6_opt_prefix_info *)&uip_buf[uip_l2_l3_icmp_hdr_len + nd6_opt_offset])
 #define UIP_ND6_OPT_MTU_BUF ((uip_nd6_opt_mtu *)&uip_buf[uip_l2_l3_icmp_hdr_len + nd6_opt_offset])
 #define UIP_ND6_OPT_RDNSS_BUF ((uip_nd6_opt_dns *)&uip_buf[uip_l2_l3_icmp_hdr_len + nd6_opt_offset])
+#define UIP_ND6_OPT_6CO_BUF ((uip_nd6_opt_6co *)&uip_buf[uip_l2_l3_icmp_hdr_len + nd6_opt_offset])
 /** @} */
 
 #if UIP_ND6_SEND_NA || UIP_ND6_SEND_RA || !UIP_CONF_ROUTER
@@ -156,13 +160,143 @@ create_llao(uint8_t *llao, uint8_t type) {
          UIP_ND6_OPT_LLAO_LEN - 2 - UIP_LLADDR_LEN);
 }
 
+#if UIP_ND6_6LOWPAN
+/*------------------------------------------------------------------*/
+/* EUI-64 of a link-layer address, as carried in an ARO */
+static void
+eui64_from_lladdr(uint8_t *eui64, const uip_lladdr_t *lladdr)
+{
+  uip_ipaddr_t iid;
+
+  uip_ds6_set_addr_iid(&iid, (uip_lladdr_t *)lladdr);
+  memcpy(eui64, &iid.u8[8], 8);
+  eui64[0] ^= 0x02;
+}
+/*------------------------------------------------------------------*/
+/* create an aro */
+static void
+create_aro(uint8_t *aro, uint8_t status, uint16_t lifetime,
+           const uint8_t *eui64)
+{
+  uip_nd6_opt_aro *opt = (uip_nd6_opt_aro *)aro;
+
+  opt->type = UIP_ND6_OPT_ARO;
+  opt->len = UIP_ND6_OPT_ARO_LEN >> 3;
+  opt->status = status;
+  opt->reserved1 = 0;
+  opt->reserved2 = 0;
+  opt->lifetime = uip_htons(lifetime);
+  memcpy(opt->eui64, eui64, sizeof(opt->eui64));
+}
+#endif /* UIP_ND6_6LOWPAN */
+
 /*------------------------------------------------------------------*/
 
 #if UIP_ND6_SEND_NA
+#if UIP_ND6_6LOWPAN && UIP_CONF_ROUTER
+/**
+ * Address registration (RFC 6775, 6.5)
+ *
+ * The neighbor entry of the host has been created or updated from the
+ * SLLAO of the NS, unless it is registered with another EUI-64. It is
+ * registered for the lifetime of the ARO, and a NA carrying the status
+ * of the registration is sent back.
+ */
+static void
+aro_input(uip_nd6_opt_aro *aro)
+{
+  uip_ipaddr_t tgtipaddr;
+  uint8_t eui64[8];
+  uint8_t nbr_eui64[8];
+  uint16_t lifetime;
+  uint8_t status;
+  const uip_lladdr_t *lladdr;
+
+  lifetime = uip_ntohs(aro->lifetime);
+  memcpy(eui64, aro->eui64, sizeof(eui64));
+  uip_ipaddr_copy(&tgtipaddr, &UIP_ND6_NS_BUF->tgtipaddr);
+
+  nbr = uip_ds6_nbr_lookup(&UIP_IP_BUF->srcipaddr);
+  lladdr = nbr == NULL ? NULL : uip_ds6_nbr_get_ll(nbr);
+  if(lladdr == NULL) {
+    status = UIP_ND6_ARO_STATUS_NBR_CACHE_FULL;
+  } else {
+    eui64_from_lladdr(nbr_eui64, lladdr);
+    if(memcmp(nbr_eui64, eui64, sizeof(eui64)) != 0) {
+      status = UIP_ND6_ARO_STATUS_DUPLICATE;
+    } else {
+      status = UIP_ND6_ARO_STATUS_SUCCESS;
+      if(lifetime == 0) {
+        uip_ds6_nbr_rm(nbr);
+      } else {
+        nbr->isregistered = 1;
+        nbr->state = NBR_REACHABLE;
+        nbr->nscount = 0;
+        stimer_set(&nbr->reglifetime,
+                   (unsigned long)lifetime * UIP_ND6_ARO_LIFETIME_UNIT);
+      }
+    }
+  }
+  PRINTF("ARO from ");
+  PRINT6ADDR(&UIP_IP_BUF->srcipaddr);
+  PRINTF(" lifetime %u, status %u\n", lifetime, status);
+
+  /* A duplicate address cannot be used to reach the host: the NA goes
+     to the link-local address formed from the EUI-64 instead */
+  if(status == UIP_ND6_ARO_STATUS_DUPLICATE) {
+    uip_create_linklocal_prefix(&UIP_IP_BUF->destipaddr);
+    memcpy(&UIP_IP_BUF->destipaddr.u8[8], eui64, sizeof(eui64));
+    UIP_IP_BUF->destipaddr.u8[8] ^= 0x02;
+  } else {
+    uip_ipaddr_copy(&UIP_IP_BUF->destipaddr, &UIP_IP_BUF->srcipaddr);
+  }
+  uip_ds6_select_src(&UIP_IP_BUF->srcipaddr, &UIP_IP_BUF->destipaddr);
+
+  uip_ext_len = 0;
+  UIP_IP_BUF->vtc = 0x60;
+  UIP_IP_BUF->tcflow = 0;
+  UIP_IP_BUF->flow = 0;
+  UIP_IP_BUF->len[0] = 0;       /* length will not be more than 255 */
+  UIP_IP_BUF->len[1] = UIP_ICMPH_LEN + UIP_ND6_NA_LEN + UIP_ND6_OPT_LLAO_LEN +
+    UIP_ND6_OPT_ARO_LEN;
+  UIP_IP_BUF->proto = UIP_PROTO_ICMP6;
+  UIP_IP_BUF->ttl = UIP_ND6_HOP_LIMIT;
+
+  UIP_ICMP_BUF->type = ICMP6_NA;
+  UIP_ICMP_BUF->icode = 0;
+
+  UIP_ND6_NA_BUF->flagsreserved = UIP_ND6_NA_FLAG_SOLICITED |
+    UIP_ND6_NA_FLAG_ROUTER;
+  memset(UIP_ND6_NA_BUF->reserved, 0, sizeof(UIP_ND6_NA_BUF->reserved));
+  uip_ipaddr_copy(&UIP_ND6_NA_BUF->tgtipaddr, &tgtipaddr);
+
+  create_llao(&uip_buf[uip_l2_l3_icmp_hdr_len + UIP_ND6_NA_LEN],
+              UIP_ND6_OPT_TLLAO);
+  create_aro(&uip_buf[uip_l2_l3_icmp_hdr_len + UIP_ND6_NA_LEN +
+                      UIP_ND6_OPT_LLAO_LEN], status, lifetime, eui64);
+
+  UIP_ICMP_BUF->icmpchksum = 0;
+  UIP_ICMP_BUF->icmpchksum = ~uip_icmp6chksum();
+
+  uip_len = UIP_IPH_LEN + UIP_ICMPH_LEN + UIP_ND6_NA_LEN +
+    UIP_ND6_OPT_LLAO_LEN + UIP_ND6_OPT_ARO_LEN;
+
+  UIP_STAT(++uip_stat.nd6.sent);
+  PRINTF("Sending NA to ");
+  PRINT6ADDR(&UIP_IP_BUF->destipaddr);
+  PRINTF(" with target address ");
+  PRINT6ADDR(&UIP_ND6_NA_BUF->tgtipaddr);
+  PRINTF("\n");
+}
+#endif /* UIP_ND6_6LOWPAN && UIP_CONF_ROUTER */
+/*------------------------------------------------------------------*/
 static void
 ns_input(void)
 {
   uint8_t flags;
+#if UIP_ND6_6LOWPAN && UIP_CONF_ROUTER
+  uip_nd6_opt_aro *nd6_opt_aro = NULL;
+#endif /* UIP_ND6_6LOWPAN && UIP_CONF_ROUTER */
   PRINTF("Received NS from ");
   PRINT6ADDR(&UIP_IP_BUF->srcipaddr);
   PRINTF(" to ");
@@ -214,6 +348,12 @@ ns_input(void)
           }
           if(memcmp(&nd6_opt_llao[UIP_ND6_OPT_DATA_OFFSET],
               lladdr, UIP_LLADDR_LEN) != 0) {
+#if UIP_ND6_6LOWPAN && UIP_CONF_ROUTER
+            if(nbr->isregistered) {
+              /* Only a registration changes that, see aro_input() */
+              break;
+            }
+#endif /* UIP_ND6_6LOWPAN && UIP_CONF_ROUTER */
             if(nbr_table_update_lladdr((const linkaddr_t *)lladdr, (const linkaddr_t *)&lladdr_aligned, 1) == 0) {
               /* failed to update the lladdr */
               goto discard;
@@ -229,6 +369,11 @@ ns_input(void)
       }
 #endif /*UIP_CONF_IPV6_CHECKS */
       break;
+#if UIP_ND6_6LOWPAN && UIP_CONF_ROUTER
+    case UIP_ND6_OPT_ARO:
+      nd6_opt_aro = (uip_nd6_opt_aro *)UIP_ND6_OPT_HDR_BUF;
+      break;
+#endif /* UIP_ND6_6LOWPAN && UIP_CONF_ROUTER */
     default:
       PRINTF("ND option not supported in NS");
       break;
@@ -236,6 +381,15 @@ ns_input(void)
     nd6_opt_offset += (UIP_ND6_OPT_HDR_BUF->len << 3);
   }
 
+#if UIP_ND6_6LOWPAN && UIP_CONF_ROUTER
+  /* The ARO is ignored without a SLLAO */
+  if(nd6_opt_aro != NULL && nd6_opt_llao != NULL &&
+     !uip_is_addr_unspecified(&UIP_IP_BUF->srcipaddr)) {
+    aro_input(nd6_opt_aro);
+    return;
+  }
+#endif /* UIP_ND6_6LOWPAN && UIP_CONF_ROUTER */
+
   addr = uip_ds6_addr_lookup(&UIP_ND6_NS_BUF->tgtipaddr);
   if(addr != NULL) {
 #if UIP_ND6_DEF_MAXDADNS > 0
@@ -410,6 +564,52 @@ uip_nd6_ns_output(uip_ipaddr_t * src, uip_ipaddr_t * dest, uip_ipaddr_t * tgt)
   PRINTF("\n");
   return;
 }
+#if UIP_ND6_6LOWPAN && !UIP_CONF_ROUTER
+/*------------------------------------------------------------------*/
+void
+uip_nd6_ns_output_aro(uip_ipaddr_t *addr, uip_ipaddr_t *router,
+                      uint16_t lifetime)
+{
+  uint8_t eui64[8];
+
+  uip_ext_len = 0;
+  UIP_IP_BUF->vtc = 0x60;
+  UIP_IP_BUF->tcflow = 0;
+  UIP_IP_BUF->flow = 0;
+  UIP_IP_BUF->proto = UIP_PROTO_ICMP6;
+  UIP_IP_BUF->ttl = UIP_ND6_HOP_LIMIT;
+  uip_ipaddr_copy(&UIP_IP_BUF->srcipaddr, addr);
+  uip_ipaddr_copy(&UIP_IP_BUF->destipaddr, router);
+
+  UIP_ICMP_BUF->type = ICMP6_NS;
+  UIP_ICMP_BUF->icode = 0;
+  UIP_ND6_NS_BUF->reserved = 0;
+  uip_ipaddr_copy((uip_ipaddr_t *) &UIP_ND6_NS_BUF->tgtipaddr, addr);
+  UIP_IP_BUF->len[0] = 0;       /* length will not be more than 255 */
+  UIP_IP_BUF->len[1] = UIP_ICMPH_LEN + UIP_ND6_NS_LEN + UIP_ND6_OPT_LLAO_LEN +
+    UIP_ND6_OPT_ARO_LEN;
+
+  create_llao(&uip_buf[uip_l2_l3_icmp_hdr_len + UIP_ND6_NS_LEN],
+              UIP_ND6_OPT_SLLAO);
+  eui64_from_lladdr(eui64, &uip_lladdr);
+  create_aro(&uip_buf[uip_l2_l3_icmp_hdr_len + UIP_ND6_NS_LEN +
+                      UIP_ND6_OPT_LLAO_LEN],
+             UIP_ND6_ARO_STATUS_SUCCESS, lifetime, eui64);
+
+  uip_len = UIP_IPH_LEN + UIP_ICMPH_LEN + UIP_ND6_NS_LEN +
+    UIP_ND6_OPT_LLAO_LEN + UIP_ND6_OPT_ARO_LEN;
+
+  UIP_ICMP_BUF->icmpchksum = 0;
+  UIP_ICMP_BUF->icmpchksum = ~uip_icmp6chksum();
+
+  UIP_STAT(++uip_stat.nd6.sent);
+  PRINTF("Sending NS with ARO to ");
+  PRINT6ADDR(router);
+  PRINTF(" for ");
+  PRINT6ADDR(addr);
+  PRINTF(" lifetime %u\n", lifetime);
+}
+#endif /* UIP_ND6_6LOWPAN && !UIP_CONF_ROUTER */
 #if UIP_ND6_SEND_NA
 /*------------------------------------------------------------------*/
 /**
@@ -437,6 +637,10 @@ na_input(void)
   uint8_t is_solicited;
   uint8_t is_override;
   uip_lladdr_t lladdr_aligned;
+#if UIP_ND6_6LOWPAN && !UIP_CONF_ROUTER
+  uip_nd6_opt_aro *nd6_opt_aro = NULL;
+  uint8_t eui64[8];
+#endif /* UIP_ND6_6LOWPAN && !UIP_CONF_ROUTER */
 
   PRINTF("Received NA from ");
   PRINT6ADDR(&UIP_IP_BUF->srcipaddr);
@@ -482,6 +686,11 @@ na_input(void)
     case UIP_ND6_OPT_TLLAO:
       nd6_opt_llao = (uint8_t *)UIP_ND6_OPT_HDR_BUF;
       break;
+#if UIP_ND6_6LOWPAN && !UIP_CONF_ROUTER
+    case UIP_ND6_OPT_ARO:
+      nd6_opt_aro = (uip_nd6_opt_aro *)UIP_ND6_OPT_HDR_BUF;
+      break;
+#endif /* UIP_ND6_6LOWPAN && !UIP_CONF_ROUTER */
     default:
       PRINTF("ND option not supported in NA\n");
       break;
@@ -491,6 +700,17 @@ na_input(void)
   addr = uip_ds6_addr_lookup(&UIP_ND6_NA_BUF->tgtipaddr);
   /* Message processing, including TLLAO if any */
   if(addr != NULL) {
+#if UIP_ND6_6LOWPAN && !UIP_CONF_ROUTER
+    /* Answer of the router to the registration of the address */
+    if(nd6_opt_aro != NULL && is_solicited) {
+      eui64_from_lladdr(eui64, &uip_lladdr);
+      if(memcmp(nd6_opt_aro->eui64, eui64, sizeof(eui64)) == 0) {
+        uip_ds6_register_done(addr, nd6_opt_aro->status,
+                              uip_ntohs(nd6_opt_aro->lifetime));
+      }
+      goto discard;
+    }
+#endif /* UIP_ND6_6LOWPAN && !UIP_CONF_ROUTER */
 #if UIP_ND6_DEF_MAXDADNS > 0
     if(addr->state == ADDR_TENTATIVE) {
       uip_ds6_dad_failed(addr);
@@ -678,8 +898,23 @@ rs_input(void)
 #endif /*UIP_CONF_IPV6_CHECKS */
   }
 
+#if UIP_ND6_6LOWPAN
+  /* There are no periodic RAs to wait for: answer at once, unicast
+     unless the source is unspecified (RFC 6775, 6.5.5) */
+  if(!uip_is_addr_unspecified(&UIP_IP_BUF->srcipaddr)) {
+    uip_ipaddr_t dest;
+    uip_ipaddr_copy(&dest, &UIP_IP_BUF->srcipaddr);
+    uip_ext_len = 0;
+    uip_nd6_ra_output(&dest);
+  } else {
+    uip_ext_len = 0;
+    uip_nd6_ra_output(NULL);
+  }
+  return;
+#else /* UIP_ND6_6LOWPAN */
   /* Schedule a sollicited RA */
   uip_ds6_send_ra_sollicited();
+#endif /* UIP_ND6_6LOWPAN */
 
 discard:
   uip_clear_buf();
@@ -798,15 +1033,19 @@ uip_nd6_ra_output(uip_ipaddr_t * dest)
 
 #if !UIP_CONF_ROUTER
 /*---------------------------------------------------------------------------*/
-void
-uip_nd6_rs_output(void)
+static void
+rs_output(uip_ipaddr_t *dest)
 {
   UIP_IP_BUF->vtc = 0x60;
   UIP_IP_BUF->tcflow = 0;
   UIP_IP_BUF->flow = 0;
   UIP_IP_BUF->proto = UIP_PROTO_ICMP6;
   UIP_IP_BUF->ttl = UIP_ND6_HOP_LIMIT;
-  uip_create_linklocal_allrouters_mcast(&UIP_IP_BUF->destipaddr);
+  if(dest == NULL) {
+    uip_create_linklocal_allrouters_mcast(&UIP_IP_BUF->destipaddr);
+  } else {
+    uip_ipaddr_copy(&UIP_IP_BUF->destipaddr, dest);
+  }
   uip_ds6_select_src(&UIP_IP_BUF->srcipaddr, &UIP_IP_BUF->destipaddr);
   UIP_ICMP_BUF->type = ICMP6_RS;
   UIP_ICMP_BUF->icode = 0;
@@ -836,6 +1075,20 @@ uip_nd6_rs_output(void)
   return;
 }
 /*---------------------------------------------------------------------------*/
+void
+uip_nd6_rs_output(void)
+{
+  rs_output(NULL);
+}
+#if UIP_ND6_6LOWPAN
+/*---------------------------------------------------------------------------*/
+void
+uip_nd6_rs_unicast_output(uip_ipaddr_t *dest)
+{
+  rs_output(dest);
+}
+#endif /* UIP_ND6_6LOWPAN */
+/*---------------------------------------------------------------------------*/
 /**
  * Process a Router Advertisement
  *
@@ -932,8 +1185,11 @@ ra_input(void)
       if((uip_ntohl(nd6_opt_prefix_info->validlt) >=
           uip_ntohl(nd6_opt_prefix_info->preferredlt))
          && (!uip_is_addr_linklocal(&nd6_opt_prefix_info->prefix))) {
-        /* on-link flag related processing */
-        if(nd6_opt_prefix_info->flagsreserved1 & UIP_ND6_RA_FLAG_ONLINK) {
+        /* on-link flag related processing. 6LoWPAN hosts consider no
+           prefix on-link and send everything through their router
+           (RFC 6775, 5.4.1) */
+        if(!UIP_ND6_6LOWPAN &&
+           (nd6_opt_prefix_info->flagsreserved1 & UIP_ND6_RA_FLAG_ONLINK)) {
           prefix =
             uip_ds6_prefix_lookup(&nd6_opt_prefix_info->prefix,
                                   nd6_opt_prefix_info->preflen);
@@ -1029,6 +1285,27 @@ ra_input(void)
       }
       break;
 #endif /* UIP_ND6_RA_RDNSS */
+#if UIP_ND6_RA_6CO
+    case UIP_ND6_OPT_6CO:
+      /* The prefix must fit in the option: 8 bytes for len 2, 16 for 3 */
+      if(UIP_ND6_OPT_6CO_BUF->context_len <= (UIP_ND6_OPT_6CO_BUF->len - 1) * 64) {
+        uint8_t cid = UIP_ND6_OPT_6CO_BUF->flags_cid & UIP_ND6_6CO_CID_MASK;
+        uint16_t lifetime = uip_ntohs(UIP_ND6_OPT_6CO_BUF->lifetime);
+        PRINTF("Processing 6CO option, cid %u length %u lifetime %u\n",
+               cid, UIP_ND6_OPT_6CO_BUF->context_len, lifetime);
+        if(lifetime == 0) {
+          sicslowpan_context_remove(cid);
+        } else {
+          /* Only the first 64 bits are used for compression */
+          sicslowpan_context_set(cid,
+                                 (uip_ipaddr_t *)UIP_ND6_OPT_6CO_BUF->prefix,
+                                 MIN(UIP_ND6_OPT_6CO_BUF->context_len, 64),
+                                 (unsigned long)lifetime * UIP_ND6_6CO_LIFETIME_UNIT,
+                                 UIP_ND6_OPT_6CO_BUF->flags_cid & UIP_ND6_6CO_FLAG_C);
+        }
+      }
+      break;
+#endif /* UIP_ND6_RA_6CO */
     default:
       PRINTF("ND option not supported in RA");
       break;
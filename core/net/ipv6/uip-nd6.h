@@ -65,6 +65,35 @@
 #define UIP_ND6_RTR_SOLICITATION_INTERVAL  4
 /** \brief Maximum router solicitations */
 #define UIP_ND6_MAX_RTR_SOLICITATIONS      3
+/** \brief Maximum router solicitation interval, after backoff (RFC 6775) */
+#define UIP_ND6_MAX_RTR_SOLICITATION_INTERVAL 60
+/** @} */
+
+/** \name RFC 6775 Neighbor Discovery for 6LoWPAN */
+/** @{ */
+/**
+ * Hosts register their global addresses with their default router
+ * through an ARO in a unicast NS, instead of doing multicast DAD, and
+ * resolve link-local addresses from their IID. Routers answer RS with
+ * unicast RAs and send no periodic ones. No multicast needs to be
+ * received by a host.
+ */
+#ifndef UIP_CONF_ND6_6LOWPAN
+#define UIP_ND6_6LOWPAN                    0
+#else
+#define UIP_ND6_6LOWPAN UIP_CONF_ND6_6LOWPAN
+#endif
+/** \brief Registration lifetime requested by hosts, in units of 60 s */
+#ifndef UIP_CONF_ND6_REGISTRATION_LIFETIME
+#define UIP_ND6_REGISTRATION_LIFETIME      60
+#else
+#define UIP_ND6_REGISTRATION_LIFETIME UIP_CONF_ND6_REGISTRATION_LIFETIME
+#endif
+/** Unit of the ARO registration lifetime, in seconds */
+#define UIP_ND6_ARO_LIFETIME_UNIT          60
+#define UIP_ND6_ARO_STATUS_SUCCESS         0
+#define UIP_ND6_ARO_STATUS_DUPLICATE       1
+#define UIP_ND6_ARO_STATUS_NBR_CACHE_FULL  2
 /** @} */
 
 /** \name RFC 4861 Router constants */
@@ -106,11 +135,11 @@
 
 #ifndef UIP_CONF_ND6_DEF_MAXDADNS
 /** \brief Do not try DAD when using EUI-64 as allowed by draft-ietf-6lowpan-nd-15 section 8.2 */
-#if UIP_CONF_LL_802154
+#if UIP_CONF_LL_802154 || UIP_ND6_6LOWPAN
 #define UIP_ND6_DEF_MAXDADNS 0
-#else /* UIP_CONF_LL_802154 */
+#else /* UIP_CONF_LL_802154 || UIP_ND6_6LOWPAN */
 #define UIP_ND6_DEF_MAXDADNS UIP_ND6_SEND_NA
-#endif /* UIP_CONF_LL_802154 */
+#endif /* UIP_CONF_LL_802154 || UIP_ND6_6LOWPAN */
 #else /* UIP_CONF_ND6_DEF_MAXDADNS */
 #define UIP_ND6_DEF_MAXDADNS UIP_CONF_ND6_DEF_MAXDADNS
 #endif /* UIP_CONF_ND6_DEF_MAXDADNS */
@@ -158,6 +187,19 @@
 #endif
 /** @} */
 
+/** \name RFC 6775 RA 6LoWPAN Context Option Constants  */
+/** @{ */
+#ifndef UIP_CONF_ND6_RA_6CO
+#define UIP_ND6_RA_6CO                  UIP_CONF_LL_802154
+#else
+#define UIP_ND6_RA_6CO                  UIP_CONF_ND6_RA_6CO
+#endif
+#define UIP_ND6_6CO_FLAG_C              0x10
+#define UIP_ND6_6CO_CID_MASK            0x0f
+/** Unit of the 6CO valid lifetime, in seconds */
+#define UIP_ND6_6CO_LIFETIME_UNIT       60
+/** @} */
+
 
 /** \name ND6 option types */
 /** @{ */
@@ -168,6 +210,8 @@
 #define UIP_ND6_OPT_MTU                 5
 #define UIP_ND6_OPT_RDNSS               25
 #define UIP_ND6_OPT_DNSSL               31
+#define UIP_ND6_OPT_ARO                 33
+#define UIP_ND6_OPT_6CO                 34
 /** @} */
 
 /** \name ND6 option types */
@@ -192,6 +236,7 @@
 #define UIP_ND6_OPT_MTU_LEN            8
 #define UIP_ND6_OPT_RDNSS_LEN          1
 #define UIP_ND6_OPT_DNSSL_LEN          1
+#define UIP_ND6_OPT_ARO_LEN            16
 
 
 /* Length of TLLAO and SLLAO options, it is L2 dependant */
@@ -314,6 +359,28 @@ typedef struct uip_nd6_opt_mtu {
   uint32_t mtu;
 } uip_nd6_opt_mtu;
 
+/** \brief ND option 6LoWPAN context (RFC 6775) */
+typedef struct uip_nd6_opt_6co {
+  uint8_t type;
+  uint8_t len;
+  uint8_t context_len;
+  uint8_t flags_cid;
+  uint16_t reserved;
+  uint16_t lifetime;
+  uint8_t prefix[16];
+} uip_nd6_opt_6co;
+
+/** \brief ND option address registration (RFC 6775) */
+typedef struct uip_nd6_opt_aro {
+  uint8_t type;
+  uint8_t len;
+  uint8_t status;
+  uint8_t reserved1;
+  uint16_t reserved2;
+  uint16_t lifetime;
+  uint8_t eui64[8];
+} uip_nd6_opt_aro;
+
 /** \brief ND option RDNSS */
 typedef struct uip_nd6_opt_dns {
   uint8_t type;
@@ -382,6 +449,22 @@ uip_nd6_ns_input(void);
 void
 uip_nd6_ns_output(uip_ipaddr_t *src, uip_ipaddr_t *dest, uip_ipaddr_t *tgt);
 
+#if UIP_ND6_6LOWPAN && !UIP_CONF_ROUTER
+/**
+ * \brief Send a unicast NS registering an address (RFC 6775)
+ * \param addr The address to register, used as source and target
+ * \param router The router the address is registered with
+ * \param lifetime Registration lifetime, in units of 60 s, 0 to
+ * deregister
+ *
+ * The NS carries a SLLAO and an ARO. The router answers with a NA
+ * carrying the status of the registration.
+ */
+void
+uip_nd6_ns_output_aro(uip_ipaddr_t *addr, uip_ipaddr_t *router,
+                      uint16_t lifetime);
+#endif /* UIP_ND6_6LOWPAN && !UIP_CONF_ROUTER */
+
 #if UIP_CONF_ROUTER
 #if UIP_ND6_SEND_RA
 /**
@@ -406,6 +489,16 @@ void uip_nd6_ra_output(uip_ipaddr_t *dest);
  */
 void uip_nd6_rs_output(void);
 
+#if UIP_ND6_6LOWPAN && !UIP_CONF_ROUTER
+/**
+ * \brief Send a Router Solicitation to a known router
+ *
+ * Used to refresh the default router before its lifetime runs out,
+ * as routers do not send periodic RAs (RFC 6775).
+ */
+void uip_nd6_rs_unicast_output(uip_ipaddr_t *dest);
+#endif /* UIP_ND6_6LOWPAN && !UIP_CONF_ROUTER */
+
 /**
  * \brief Initialise the uIP ND core
  */
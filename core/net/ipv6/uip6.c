@@ -79,6 +79,7 @@
 #include "net/ipv6/uip-nd6.h"
 #include "net/ipv6/uip-ds6.h"
 #include "net/ipv6/multicast/uip-mcast6.h"
+#include "sys/trace.h"
 
 #if UIP_CONF_IPV6_RPL
 #include "rpl/rpl.h"
@@ -236,6 +237,9 @@ static uint16_t lastport;
 #define TCP_OPT_MSS     2   /* Maximum segment size TCP option */
 
 #define TCP_OPT_MSS_LEN 4   /* Length of TCP MSS option. */
+
+/* Largest amount of data that fits into uip_buf in one go. */
+#define UIP_TCP_SEND_MAX (UIP_BUFSIZE - UIP_LLH_LEN - UIP_TCPIP_HLEN)
 /** @} */
 /**
  * \name TCP variables
@@ -268,6 +272,137 @@ struct uip_udp_conn uip_udp_conns[UIP_UDP_CONNS];
 #endif /* UIP_UDP */
 /** @} */
 
+/*---------------------------------------------------------------------------*/
+/**
+ * \name Local port index
+ * @{
+ */
+/*---------------------------------------------------------------------------*/
+#if UIP_PORT_HASH_SIZE
+/*
+ * The TCP and UDP connections are chained by the hash of their local
+ * port, so that a received segment or datagram is only matched against
+ * the connections of its port. The chains hold connection numbers in
+ * increasing order, to find the same connection as going through the
+ * whole table would. A connection is put in a chain when its local
+ * port is set. A closed or removed connection is left in its chain
+ * until its slot is used again, and is skipped by the lookups.
+ */
+#if (UIP_PORT_HASH_SIZE & (UIP_PORT_HASH_SIZE - 1)) != 0
+#error "UIP_CONF_PORT_HASH_SIZE must be a power of two"
+#endif
+#if UIP_CONNS >= 0xff || UIP_UDP_CONNS >= 0xff
+#error "The local port index holds at most 254 connections"
+#endif
+
+#define PORT_HASH(port) (((port) ^ ((port) >> 8)) & (UIP_PORT_HASH_SIZE - 1))
+#define PORT_NONE 0xff
+
+struct port_index {
+  uint8_t *head;
+  /* The next connection of the chain of each connection */
+  uint8_t *next;
+  /* The chain each connection is in, or PORT_NONE */
+  uint8_t *chain;
+};
+
+#if UIP_TCP
+static uint8_t tcp_head[UIP_PORT_HASH_SIZE];
+static uint8_t tcp_next[UIP_CONNS];
+static uint8_t tcp_chain[UIP_CONNS];
+static const struct port_index tcp_index = { tcp_head, tcp_next, tcp_chain };
+#endif /* UIP_TCP */
+#if UIP_UDP
+static uint8_t udp_head[UIP_PORT_HASH_SIZE];
+static uint8_t udp_next[UIP_UDP_CONNS];
+static uint8_t udp_chain[UIP_UDP_CONNS];
+static const struct port_index udp_index = { udp_head, udp_next, udp_chain };
+#endif /* UIP_UDP */
+
+/*---------------------------------------------------------------------------*/
+static void
+port_index_init(const struct port_index *index, int conns)
+{
+  memset(index->head, PORT_NONE, UIP_PORT_HASH_SIZE);
+  memset(index->chain, PORT_NONE, conns);
+}
+/*---------------------------------------------------------------------------*/
+static void
+port_index_remove(const struct port_index *index, uint8_t c)
+{
+  uint8_t *p;
+
+  if(index->chain[c] == PORT_NONE) {
+    return;
+  }
+  for(p = &index->head[index->chain[c]]; *p != c; p = &index->next[*p]);
+  *p = index->next[c];
+  index->chain[c] = PORT_NONE;
+}
+/*---------------------------------------------------------------------------*/
+static void
+port_index_add(const struct port_index *index, uint8_t c, uint16_t port)
+{
+  uint8_t *p;
+
+  port_index_remove(index, c);
+  index->chain[c] = PORT_HASH(port);
+  for(p = &index->head[index->chain[c]]; *p != PORT_NONE && *p < c;
+      p = &index->next[*p]);
+  index->next[c] = *p;
+  *p = c;
+}
+/*---------------------------------------------------------------------------*/
+#endif /* UIP_PORT_HASH_SIZE */
+
+/* The first and next TCP and UDP connections that may have a local port */
+#if UIP_TCP
+static struct uip_conn *
+tcp_conn_first(uint16_t port)
+{
+#if UIP_PORT_HASH_SIZE
+  uint8_t c = tcp_head[PORT_HASH(port)];
+  return c == PORT_NONE ? NULL : &uip_conns[c];
+#else /* UIP_PORT_HASH_SIZE */
+  return &uip_conns[0];
+#endif /* UIP_PORT_HASH_SIZE */
+}
+static struct uip_conn *
+tcp_conn_next(struct uip_conn *conn)
+{
+#if UIP_PORT_HASH_SIZE
+  uint8_t c = tcp_next[conn - uip_conns];
+  return c == PORT_NONE ? NULL : &uip_conns[c];
+#else /* UIP_PORT_HASH_SIZE */
+  return ++conn < &uip_conns[UIP_CONNS] ? conn : NULL;
+#endif /* UIP_PORT_HASH_SIZE */
+}
+#endif /* UIP_TCP */
+
+#if UIP_UDP
+static struct uip_udp_conn *
+udp_conn_first(uint16_t port)
+{
+#if UIP_PORT_HASH_SIZE
+  uint8_t c = udp_head[PORT_HASH(port)];
+  return c == PORT_NONE ? NULL : &uip_udp_conns[c];
+#else /* UIP_PORT_HASH_SIZE */
+  return &uip_udp_conns[0];
+#endif /* UIP_PORT_HASH_SIZE */
+}
+static struct uip_udp_conn *
+udp_conn_next(struct uip_udp_conn *conn)
+{
+#if UIP_PORT_HASH_SIZE
+  uint8_t c = udp_next[conn - uip_udp_conns];
+  return c == PORT_NONE ? NULL : &uip_udp_conns[c];
+#else /* UIP_PORT_HASH_SIZE */
+  return ++conn < &uip_udp_conns[UIP_UDP_CONNS] ? conn : NULL;
+#endif /* UIP_PORT_HASH_SIZE */
+}
+#endif /* UIP_UDP */
+/** @} */
+
 /*---------------------------------------------------------------------------*/
 /**
  * \name ICMPv6 variables
@@ -318,6 +453,39 @@ uip_add32(uint8_t *op32, uint16_t op16)
 
 #if ! UIP_ARCH_CHKSUM
 /*---------------------------------------------------------------------------*/
+#if UIP_CHKSUM_ACC32
+static uint16_t
+chksum(uint16_t sum, const uint8_t *data, uint16_t len)
+{
+  uint32_t acc;
+
+  /* A 16-bit length can not overflow the accumulator, so the carries
+     are folded in only at the end */
+  acc = sum;
+  while(len >= 8) {
+    acc += ((uint16_t)data[0] << 8) + data[1];
+    acc += ((uint16_t)data[2] << 8) + data[3];
+    acc += ((uint16_t)data[4] << 8) + data[5];
+    acc += ((uint16_t)data[6] << 8) + data[7];
+    data += 8;
+    len -= 8;
+  }
+  while(len >= 2) {
+    acc += ((uint16_t)data[0] << 8) + data[1];
+    data += 2;
+    len -= 2;
+  }
+  if(len == 1) {
+    acc += (uint16_t)data[0] << 8;
+  }
+
+  acc = (acc >> 16) + (acc & 0xffff);
+  acc += acc >> 16;
+
+  /* Return sum in host byte order. */
+  return (uint16_t)acc;
+}
+#else /* UIP_CHKSUM_ACC32 */
 static uint16_t
 chksum(uint16_t sum, const uint8_t *data, uint16_t len)
 {
@@ -348,6 +516,7 @@ chksum(uint16_t sum, const uint8_t *data, uint16_t len)
   /* Return sum in host byte order. */
   return sum;
 }
+#endif /* UIP_CHKSUM_ACC32 */
 /*---------------------------------------------------------------------------*/
 uint16_t
 uip_chksum(uint16_t *data, uint16_t len)
@@ -440,6 +609,9 @@ uip_init(void)
   for(c = 0; c < UIP_CONNS; ++c) {
     uip_conns[c].tcpstateflags = UIP_CLOSED;
   }
+#if UIP_PORT_HASH_SIZE
+  port_index_init(&tcp_index, UIP_CONNS);
+#endif /* UIP_PORT_HASH_SIZE */
 #endif /* UIP_TCP */
 
 #if UIP_ACTIVE_OPEN || UIP_UDP
@@ -450,6 +622,9 @@ uip_init(void)
   for(c = 0; c < UIP_UDP_CONNS; ++c) {
     uip_udp_conns[c].lport = 0;
   }
+#if UIP_PORT_HASH_SIZE
+  port_index_init(&udp_index, UIP_UDP_CONNS);
+#endif /* UIP_PORT_HASH_SIZE */
 #endif /* UIP_UDP */
 
 #if UIP_IPV6_MULTICAST
@@ -474,8 +649,8 @@ uip_connect(const uip_ipaddr_t *ripaddr, uint16_t rport)
 
   /* Check if this port is already in use, and if so try to find
      another one. */
-  for(c = 0; c < UIP_CONNS; ++c) {
-    conn = &uip_conns[c];
+  for(conn = tcp_conn_first(uip_htons(lastport)); conn != NULL;
+      conn = tcp_conn_next(conn)) {
     if(conn->tcpstateflags != UIP_CLOSED &&
        conn->lport == uip_htons(lastport)) {
       goto again;
@@ -522,6 +697,9 @@ uip_connect(const uip_ipaddr_t *ripaddr, uint16_t rport)
   conn->sa = 0;
   conn->sv = 16;   /* Initial value of the RTT variance. */
   conn->lport = uip_htons(lastport);
+#if UIP_PORT_HASH_SIZE
+  port_index_add(&tcp_index, conn - uip_conns, conn->lport);
+#endif /* UIP_PORT_HASH_SIZE */
   conn->rport = rport;
   uip_ipaddr_copy(&conn->ripaddr, ripaddr);
 
@@ -568,8 +746,9 @@ uip_udp_new(const uip_ipaddr_t *ripaddr, uint16_t rport)
     lastport = 4096;
   }
 
-  for(c = 0; c < UIP_UDP_CONNS; ++c) {
-    if(uip_udp_conns[c].lport == uip_htons(lastport)) {
+  for(conn = udp_conn_first(uip_htons(lastport)); conn != NULL;
+      conn = udp_conn_next(conn)) {
+    if(conn->lport == uip_htons(lastport)) {
       goto again;
     }
   }
@@ -586,7 +765,7 @@ uip_udp_new(const uip_ipaddr_t *ripaddr, uint16_t rport)
     return 0;
   }
 
-  conn->lport = UIP_HTONS(lastport);
+  uip_udp_bind(conn, UIP_HTONS(lastport));
   conn->rport = rport;
   if(ripaddr == NULL) {
     memset(&conn->ripaddr, 0, sizeof(uip_ipaddr_t));
@@ -597,6 +776,15 @@ uip_udp_new(const uip_ipaddr_t *ripaddr, uint16_t rport)
 
   return conn;
 }
+/*---------------------------------------------------------------------------*/
+void
+uip_udp_bind(struct uip_udp_conn *conn, uint16_t port)
+{
+  conn->lport = port;
+#if UIP_PORT_HASH_SIZE
+  port_index_add(&udp_index, conn - uip_udp_conns, port);
+#endif /* UIP_PORT_HASH_SIZE */
+}
 #endif /* UIP_UDP */
 /*---------------------------------------------------------------------------*/
 #if UIP_TCP
@@ -1102,6 +1290,7 @@ uip_process(uint8_t flag)
 
   /* This is where the input processing starts. */
   UIP_STAT(++uip_stat.ip.recv);
+  TRACE(UIP6_INPUT, uip_len, UIP_IP_BUF->proto);
 
   /* Start of IP input header processing code. */
 
@@ -1234,6 +1423,7 @@ uip_process(uint8_t flag)
       PRINT6ADDR(&UIP_IP_BUF->destipaddr);
       PRINTF("\n");
       UIP_STAT(++uip_stat.ip.forwarded);
+      TRACE(UIP6_FORWARD, uip_len, UIP_IP_BUF->ttl);
       goto send;
     } else {
       if((uip_is_addr_linklocal(&UIP_IP_BUF->srcipaddr)) &&
@@ -1503,9 +1693,9 @@ uip_process(uint8_t flag)
   }
 
   /* Demultiplex this UDP packet between the UDP "connections". */
-  for(uip_udp_conn = &uip_udp_conns[0];
-      uip_udp_conn < &uip_udp_conns[UIP_UDP_CONNS];
-      ++uip_udp_conn) {
+  for(uip_udp_conn = udp_conn_first(UIP_UDP_BUF->destport);
+      uip_udp_conn != NULL;
+      uip_udp_conn = udp_conn_next(uip_udp_conn)) {
     /* If the local UDP port is non-zero, the connection is considered
        to be used. If so, the local port number is checked against the
        destination port number in the received packet. If the two port
@@ -1607,8 +1797,8 @@ uip_process(uint8_t flag)
 
   /* Demultiplex this segment. */
   /* First check any active connections. */
-  for(uip_connr = &uip_conns[0]; uip_connr <= &uip_conns[UIP_CONNS - 1];
-      ++uip_connr) {
+  for(uip_connr = tcp_conn_first(UIP_TCP_BUF->destport); uip_connr != NULL;
+      uip_connr = tcp_conn_next(uip_connr)) {
     if(uip_connr->tcpstateflags != UIP_CLOSED &&
        UIP_TCP_BUF->destport == uip_connr->lport &&
        UIP_TCP_BUF->srcport == uip_connr->rport &&
@@ -1729,6 +1919,9 @@ uip_process(uint8_t flag)
   uip_connr->sv = 4;
   uip_connr->nrtx = 0;
   uip_connr->lport = UIP_TCP_BUF->destport;
+#if UIP_PORT_HASH_SIZE
+  port_index_add(&tcp_index, uip_connr - uip_conns, uip_connr->lport);
+#endif /* UIP_PORT_HASH_SIZE */
   uip_connr->rport = UIP_TCP_BUF->srcport;
   uip_ipaddr_copy(&uip_connr->ripaddr, &UIP_IP_BUF->srcipaddr);
   uip_connr->tcpstateflags = UIP_SYN_RCVD;
@@ -2060,10 +2253,26 @@ uip_process(uint8_t flag)
          "persistent timer" and uses the retransmission mechanim.
      */
     tmp16 = ((uint16_t)UIP_TCP_BUF->wnd[0] << 8) + (uint16_t)UIP_TCP_BUF->wnd[1];
+#if UIP_TCP_SEND_SEGMENTS > 1
+    /* With multiple segments in flight, the "MSS" seen by the
+       application is the size of a whole train of segments, bounded
+       by the window and by what fits into uip_buf. The train is split
+       into segments of at most initialmss bytes on output. */
+    if(tmp16 == 0) {
+      tmp16 = uip_connr->initialmss;
+    } else if((uint32_t)tmp16 >
+              (uint32_t)uip_connr->initialmss * UIP_TCP_SEND_SEGMENTS) {
+      tmp16 = uip_connr->initialmss * UIP_TCP_SEND_SEGMENTS;
+    }
+    if(tmp16 > UIP_TCP_SEND_MAX) {
+      tmp16 = UIP_TCP_SEND_MAX;
+    }
+#else /* UIP_TCP_SEND_SEGMENTS > 1 */
     if(tmp16 > uip_connr->initialmss ||
         tmp16 == 0) {
       tmp16 = uip_connr->initialmss;
     }
+#endif /* UIP_TCP_SEND_SEGMENTS > 1 */
     uip_connr->mss = tmp16;
 
     /* If this packet constitutes an ACK for outstanding data (flagged
@@ -2300,11 +2509,13 @@ uip_process(uint8_t flag)
       (UIP_IP_BUF->len[0] << 8) | UIP_IP_BUF->len[1]);
 
   UIP_STAT(++uip_stat.ip.sent);
+  TRACE(UIP6_OUTPUT, uip_len, UIP_IP_BUF->proto);
   /* Return and let the caller do the actual transmission. */
   uip_flags = 0;
   return;
 
   drop:
+  TRACE(UIP6_DROP, uip_len, UIP_IP_BUF->proto);
   uip_clear_buf();
   uip_ext_bitmap = 0;
   uip_flags = 0;
@@ -0,0 +1,319 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \file
+ *         End-to-end latency tracing of outgoing packets.
+ */
+
+#include "contiki.h"
+#include "net/latency-trace.h"
+
+#if LATENCY_TRACE_ENABLED
+
+#include "net/mac/mac.h"
+#include <string.h>
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+struct trace {
+  rtimer_clock_t t[LATENCY_TRACE_STAGES];
+  /* The stages stamped, one bit each */
+  uint16_t stamped;
+  /* The id of a slot, 0 when free */
+  uint16_t id;
+  /* The frames given to llsec the MAC is not done with */
+  uint8_t frames;
+  uint8_t failed;
+};
+
+/* The trace of the packet being built above 6LoWPAN */
+static struct trace current;
+static uint8_t current_active;
+
+static struct trace slots[LATENCY_TRACE_SLOTS];
+static uint8_t next_slot;
+static uint16_t next_id;
+
+static struct latency_trace_stats stats[LATENCY_TRACE_STAGES];
+static uint32_t failed_count;
+static uint32_t lost_count;
+
+static const char * const stage_names[LATENCY_TRACE_STAGES] = {
+  "total", "schedule", "engine", "coap", "uip", "6lowpan", "llsec",
+  "mac-wait", "mac-tx"
+};
+/*---------------------------------------------------------------------------*/
+static void
+stamp(struct trace *t, uint8_t stage)
+{
+  t->t[stage] = RTIMER_NOW();
+  t->stamped |= 1 << stage;
+}
+/*---------------------------------------------------------------------------*/
+static struct trace *
+get_slot(uint16_t id)
+{
+  uint8_t i;
+
+  if(id == 0) {
+    return NULL;
+  }
+  for(i = 0; i < LATENCY_TRACE_SLOTS; i++) {
+    if(slots[i].id == id) {
+      return &slots[i];
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static uint32_t
+ticks_to_us(rtimer_clock_t ticks)
+{
+  return (uint32_t)((uint64_t)ticks * 1000000 / RTIMER_SECOND);
+}
+/*---------------------------------------------------------------------------*/
+static void
+add_latency(uint8_t stage, rtimer_clock_t from, rtimer_clock_t to)
+{
+  struct latency_trace_stats *s = &stats[stage];
+  uint32_t us = ticks_to_us((rtimer_clock_t)(to - from));
+  uint8_t bucket;
+
+  for(bucket = 0; bucket < LATENCY_TRACE_BUCKETS - 1 &&
+        us >= latency_trace_bucket_limit(bucket); bucket++);
+  if(s->histogram[bucket] < 0xffff) {
+    s->histogram[bucket]++;
+  }
+  s->count++;
+  s->sum += us;
+  if(us > s->max) {
+    s->max = us;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Add the stages of a completed trace to their histograms */
+static void
+complete(struct trace *t)
+{
+  uint8_t stage, previous;
+
+  if(t->failed || !(t->stamped & (1 << LATENCY_TRACE_MAC_DONE))) {
+    failed_count++;
+  } else {
+    previous = LATENCY_TRACE_STAGES;
+    for(stage = 0; stage < LATENCY_TRACE_STAGES; stage++) {
+      if(t->stamped & (1 << stage)) {
+        if(previous < LATENCY_TRACE_STAGES) {
+          add_latency(stage, t->t[previous], t->t[stage]);
+        } else {
+          /* The first stamp starts the whole trace */
+          t->t[LATENCY_TRACE_CHANGED] = t->t[stage];
+        }
+        previous = stage;
+      }
+    }
+    add_latency(LATENCY_TRACE_CHANGED, t->t[LATENCY_TRACE_CHANGED],
+                t->t[LATENCY_TRACE_MAC_DONE]);
+  }
+  PRINTF("latency-trace: %u done\n", t->id);
+  t->id = 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+latency_trace_begin(rtimer_clock_t start)
+{
+  current.stamped = 0;
+  current.t[LATENCY_TRACE_CHANGED] = start;
+  current.stamped |= 1 << LATENCY_TRACE_CHANGED;
+  stamp(&current, LATENCY_TRACE_NOTIFY);
+  current_active = 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+latency_trace_end(void)
+{
+  current_active = 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+latency_trace_stamp(uint8_t stage)
+{
+  if(current_active) {
+    stamp(&current, stage);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+latency_trace_stamp_id(uint16_t id, uint8_t stage)
+{
+  struct trace *t = get_slot(id);
+
+  /* Stamps below 6LoWPAN are of the first frame. This also keeps the
+     interrupt context of a TSCH transmission from racing with the
+     stamps of the following frames, which only change other fields. */
+  if(t != NULL && !(t->stamped & (1 << stage))) {
+    stamp(t, stage);
+  }
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+latency_trace_packet(void)
+{
+  struct trace *t;
+
+  if(!current_active) {
+    return 0;
+  }
+
+  /* Take the oldest slot back if none is free: its packet was dropped
+     somewhere that did not tell */
+  t = &slots[next_slot];
+  next_slot = (next_slot + 1) % LATENCY_TRACE_SLOTS;
+  if(t->id != 0) {
+    lost_count++;
+  }
+
+  memcpy(t, &current, sizeof(struct trace));
+  if(++next_id == 0) {
+    next_id = 1;
+  }
+  t->id = next_id;
+  t->frames = 0;
+  t->failed = 0;
+  return t->id;
+}
+/*---------------------------------------------------------------------------*/
+void
+latency_trace_frame(uint16_t id)
+{
+  struct trace *t = get_slot(id);
+
+  if(t != NULL) {
+    latency_trace_stamp_id(id, LATENCY_TRACE_LOWPAN);
+    t->frames++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+latency_trace_frame_done(uint16_t id, int status)
+{
+  struct trace *t = get_slot(id);
+
+  if(t == NULL) {
+    return;
+  }
+  if(status != MAC_TX_OK) {
+    t->failed = 1;
+  }
+  stamp(t, LATENCY_TRACE_MAC_DONE);
+  if(t->frames > 0) {
+    t->frames--;
+  }
+  if(t->frames == 0) {
+    complete(t);
+  }
+}
+/*---------------------------------------------------------------------------*/
+const char *
+latency_trace_stage_name(uint8_t stage)
+{
+  return stage < LATENCY_TRACE_STAGES ? stage_names[stage] : NULL;
+}
+/*---------------------------------------------------------------------------*/
+const struct latency_trace_stats *
+latency_trace_get(uint8_t stage)
+{
+  return stage < LATENCY_TRACE_STAGES ? &stats[stage] : NULL;
+}
+/*---------------------------------------------------------------------------*/
+uint32_t
+latency_trace_bucket_limit(uint8_t bucket)
+{
+  if(bucket >= LATENCY_TRACE_BUCKETS - 1) {
+    return 0xffffffff;
+  }
+  return (uint32_t)LATENCY_TRACE_BUCKET_MIN_US << bucket;
+}
+/*---------------------------------------------------------------------------*/
+uint32_t
+latency_trace_percentile(uint8_t stage, uint8_t percent)
+{
+  const struct latency_trace_stats *s = latency_trace_get(stage);
+  uint32_t total, target, sum;
+  uint8_t bucket;
+
+  if(s == NULL) {
+    return 0;
+  }
+  total = 0;
+  for(bucket = 0; bucket < LATENCY_TRACE_BUCKETS; bucket++) {
+    total += s->histogram[bucket];
+  }
+  if(total == 0) {
+    return 0;
+  }
+
+  target = (total * percent + 99) / 100;
+  sum = 0;
+  for(bucket = 0; bucket < LATENCY_TRACE_BUCKETS - 1; bucket++) {
+    sum += s->histogram[bucket];
+    if(sum >= target) {
+      return MIN(latency_trace_bucket_limit(bucket), s->max);
+    }
+  }
+  return s->max;
+}
+/*---------------------------------------------------------------------------*/
+void
+latency_trace_incomplete(uint32_t *failed, uint32_t *lost)
+{
+  *failed = failed_count;
+  *lost = lost_count;
+}
+/*---------------------------------------------------------------------------*/
+void
+latency_trace_reset(void)
+{
+  memset(stats, 0, sizeof(stats));
+  failed_count = 0;
+  lost_count = 0;
+}
+/*---------------------------------------------------------------------------*/
+#endif /* LATENCY_TRACE_ENABLED */
@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \file
+ *         End-to-end latency of outgoing packets, from the change that
+ *         causes a LWM2M notification to the end of the transmission of
+ *         its last frame. Each layer stamps an rtimer timestamp when the
+ *         packet crosses it, and the time spent between two stamps is
+ *         added to a histogram of that stage, which the shell and an
+ *         LWM2M object report.
+ *
+ *         Above 6LoWPAN, a packet is built synchronously, so the stamps
+ *         go to the current trace, which is started and ended around the
+ *         code that sends (LATENCY_TRACE_BEGIN(), LATENCY_TRACE_END()),
+ *         the same way compower_set_flow() attributes energy. When
+ *         6LoWPAN takes the packet, the current trace is copied to a
+ *         slot and its id to the PACKETBUF_ATTR_LATENCY_TRACE attribute,
+ *         which stays with the frames in the MAC queues. The trace is
+ *         complete when the MAC has reported the result of every frame.
+ *
+ *         A stage that lasts longer than the rtimer wraps (e.g. 2 s on a
+ *         16-bit rtimer at 32 kHz) is not measured right.
+ */
+
+#ifndef LATENCY_TRACE_H_
+#define LATENCY_TRACE_H_
+
+#include "contiki.h"
+#include "sys/rtimer.h"
+
+#ifdef LATENCY_TRACE_CONF_ENABLED
+#define LATENCY_TRACE_ENABLED LATENCY_TRACE_CONF_ENABLED
+#else /* LATENCY_TRACE_CONF_ENABLED */
+#define LATENCY_TRACE_ENABLED 0
+#endif /* LATENCY_TRACE_CONF_ENABLED */
+
+/* Packets traced at the same time, below 6LoWPAN */
+#ifdef LATENCY_TRACE_CONF_SLOTS
+#define LATENCY_TRACE_SLOTS LATENCY_TRACE_CONF_SLOTS
+#else /* LATENCY_TRACE_CONF_SLOTS */
+#define LATENCY_TRACE_SLOTS 4
+#endif /* LATENCY_TRACE_CONF_SLOTS */
+
+/* Buckets of the histograms. Bucket i counts the latencies below
+   LATENCY_TRACE_BUCKET_MIN_US << i, the last one all others */
+#ifdef LATENCY_TRACE_CONF_BUCKETS
+#define LATENCY_TRACE_BUCKETS LATENCY_TRACE_CONF_BUCKETS
+#else /* LATENCY_TRACE_CONF_BUCKETS */
+#define LATENCY_TRACE_BUCKETS 16
+#endif /* LATENCY_TRACE_CONF_BUCKETS */
+
+#ifdef LATENCY_TRACE_CONF_BUCKET_MIN_US
+#define LATENCY_TRACE_BUCKET_MIN_US LATENCY_TRACE_CONF_BUCKET_MIN_US
+#else /* LATENCY_TRACE_CONF_BUCKET_MIN_US */
+#define LATENCY_TRACE_BUCKET_MIN_US 128
+#endif /* LATENCY_TRACE_CONF_BUCKET_MIN_US */
+
+/*
+ * The stamps, in the order a packet gets them. The histogram of a stage
+ * is of the time from the previous stamp the packet got to this one. The
+ * histogram of LATENCY_TRACE_CHANGED is of the whole trace.
+ */
+enum {
+  LATENCY_TRACE_CHANGED,    /* The value of a resource changed */
+  LATENCY_TRACE_NOTIFY,     /* The notification is started */
+  LATENCY_TRACE_FORMATTED,  /* The LWM2M engine has written the payload */
+  LATENCY_TRACE_SERIALIZED, /* The CoAP message is serialized */
+  LATENCY_TRACE_IP_OUTPUT,  /* uIP has built the IPv6 packet */
+  LATENCY_TRACE_LOWPAN,     /* 6LoWPAN gives the first frame to llsec */
+  LATENCY_TRACE_MAC_QUEUED, /* The MAC has queued the first frame */
+  LATENCY_TRACE_MAC_TX,     /* The first frame is first transmitted */
+  LATENCY_TRACE_MAC_DONE,   /* The MAC is done with the last frame */
+  LATENCY_TRACE_STAGES
+};
+
+/** The latencies of one stage, in microseconds */
+struct latency_trace_stats {
+  uint32_t count;
+  uint32_t sum;
+  uint32_t max;
+  uint16_t histogram[LATENCY_TRACE_BUCKETS];
+};
+
+#if LATENCY_TRACE_ENABLED
+#define LATENCY_TRACE_BEGIN(start) latency_trace_begin(start)
+#define LATENCY_TRACE_END() latency_trace_end()
+#define LATENCY_TRACE_STAMP(stage) latency_trace_stamp(stage)
+#define LATENCY_TRACE_STAMP_ID(id, stage) latency_trace_stamp_id((id), (stage))
+
+/**
+ * \brief Start the current trace
+ * \param start The time of LATENCY_TRACE_CHANGED
+ */
+void latency_trace_begin(rtimer_clock_t start);
+
+/** \brief End the current trace, once its packets have been sent */
+void latency_trace_end(void);
+
+/** \brief Stamp the current trace, if any */
+void latency_trace_stamp(uint8_t stage);
+
+/**
+ * \brief Stamp a traced packet, as found in its
+ *        PACKETBUF_ATTR_LATENCY_TRACE attribute. Safe from interrupt
+ *        context for LATENCY_TRACE_MAC_TX.
+ */
+void latency_trace_stamp_id(uint16_t id, uint8_t stage);
+
+/**
+ * \brief Trace the packet 6LoWPAN starts to send
+ * \return The id of the trace, 0 if there is no current trace
+ */
+uint16_t latency_trace_packet(void);
+
+/** \brief A frame of a traced packet is given to llsec */
+void latency_trace_frame(uint16_t id);
+
+/**
+ * \brief The MAC is done with a frame of a traced packet
+ * \param status The MAC_TX_ status of the frame
+ */
+void latency_trace_frame_done(uint16_t id, int status);
+
+/** \brief The name of a stage, "total" for LATENCY_TRACE_CHANGED */
+const char *latency_trace_stage_name(uint8_t stage);
+
+/** \brief The latencies of a stage */
+const struct latency_trace_stats *latency_trace_get(uint8_t stage);
+
+/**
+ * \brief The latency, in microseconds, below which a percentage of the
+ *        latencies of a stage are, to the resolution of the histogram
+ */
+uint32_t latency_trace_percentile(uint8_t stage, uint8_t percent);
+
+/** \brief The exclusive upper limit of a bucket, in microseconds */
+uint32_t latency_trace_bucket_limit(uint8_t bucket);
+
+/**
+ * \brief The traces that did not complete
+ * \param failed Set to the number of packets the MAC failed to send
+ * \param lost Set to the number of traces whose slot was taken back
+ *        before they completed
+ */
+void latency_trace_incomplete(uint32_t *failed, uint32_t *lost);
+
+/** \brief Clear the histograms */
+void latency_trace_reset(void);
+#else /* LATENCY_TRACE_ENABLED */
+#define LATENCY_TRACE_BEGIN(start)
+#define LATENCY_TRACE_END()
+#define LATENCY_TRACE_STAMP(stage)
+#define LATENCY_TRACE_STAMP_ID(id, stage)
+#endif /* LATENCY_TRACE_ENABLED */
+
+#endif /* LATENCY_TRACE_H_ */
@@ -33,9 +33,11 @@
 #include "contiki.h"
 #include "sys/clock.h"
 #include "net/packetbuf.h"
+#include "net/netstack.h"
 #include "net/nbr-table.h"
 #include "net/link-stats.h"
 #include <stdio.h>
+#include <string.h>
 
 #define DEBUG 0
 #if DEBUG
@@ -57,6 +59,8 @@
 #define EWMA_SCALE            100
 #define EWMA_ALPHA             15
 #define EWMA_BOOTSTRAP_ALPHA   30
+/* Alpha of the fast reacting ETX */
+#define EWMA_FAST_ALPHA        50
 
 /* ETX fixed point divisor. 128 is the value used by RPL (RFC 6551 and RFC 6719) */
 #define ETX_DIVISOR     LINK_STATS_ETX_DIVISOR
@@ -89,6 +93,13 @@ link_stats_from_lladdr(const linkaddr_t *lladdr)
   return nbr_table_get_from_lladdr(link_stats, lladdr);
 }
 /*---------------------------------------------------------------------------*/
+/* Returns the link stats of the neighbor at a given nbr-table index */
+const struct link_stats *
+link_stats_from_index(int index)
+{
+  return nbr_table_get_from_index(link_stats, index);
+}
+/*---------------------------------------------------------------------------*/
 /* Are the statistics fresh? */
 int
 link_stats_is_fresh(const struct link_stats *stats)
@@ -98,6 +109,99 @@ link_stats_is_fresh(const struct link_stats *stats)
       && stats->freshness >= FRESHNESS_TARGET;
 }
 /*---------------------------------------------------------------------------*/
+/* Worst of the slow and fast ETX */
+uint16_t
+link_stats_get_etx(const struct link_stats *stats)
+{
+  if(stats == NULL) {
+    return 0xffff;
+  }
+#if LINK_STATS_WITH_DUAL_EWMA
+  return MAX(stats->etx, stats->etx_fast);
+#else /* LINK_STATS_WITH_DUAL_EWMA */
+  return stats->etx;
+#endif /* LINK_STATS_WITH_DUAL_EWMA */
+}
+/*---------------------------------------------------------------------------*/
+/* Current radio channel */
+uint8_t
+link_stats_radio_channel(void)
+{
+  radio_value_t channel;
+  if(NETSTACK_RADIO.get_value(RADIO_PARAM_CHANNEL, &channel) != RADIO_RESULT_OK) {
+    return 0;
+  }
+  return channel;
+}
+#if LINK_STATS_WITH_CHANNELS
+/*---------------------------------------------------------------------------*/
+static uint16_t
+saturating_add(uint16_t a, uint16_t b)
+{
+  return a > 0xffff - b ? 0xffff : a + b;
+}
+/*---------------------------------------------------------------------------*/
+static struct link_stats_channel *
+find_channel(const struct link_stats *stats, uint8_t channel, uint8_t phy_mode)
+{
+  int i;
+  for(i = 0; i < LINK_STATS_NUM_CHANNELS; i++) {
+    const struct link_stats_channel *cstats = &stats->channels[i];
+    if(cstats->in_use && cstats->channel == channel && cstats->phy_mode == phy_mode) {
+      return (struct link_stats_channel *)cstats;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+/* Returns the statistics of a link on a given channel and PHY mode */
+const struct link_stats_channel *
+link_stats_get_channel(const struct link_stats *stats, uint8_t channel, uint8_t phy_mode)
+{
+  return stats != NULL ? find_channel(stats, channel, phy_mode) : NULL;
+}
+/*---------------------------------------------------------------------------*/
+/* Are the per-channel statistics fresh? */
+int
+link_stats_channel_is_fresh(const struct link_stats_channel *cstats)
+{
+  return cstats != NULL && cstats->freshness >= FRESHNESS_TARGET;
+}
+/*---------------------------------------------------------------------------*/
+/* Statistics of a link on the channel and PHY mode of the packet in
+ * packetbuf. Replaces the least fresh entry if not tracked yet */
+static struct link_stats_channel *
+packet_channel_stats(struct link_stats *stats)
+{
+  uint8_t channel = LINK_STATS_CHANNEL();
+  uint8_t phy_mode = LINK_STATS_PHY_MODE();
+  struct link_stats_channel *cstats;
+  int i;
+
+  cstats = find_channel(stats, channel, phy_mode);
+  if(cstats == NULL) {
+    cstats = &stats->channels[0];
+    for(i = 0; i < LINK_STATS_NUM_CHANNELS; i++) {
+      if(!stats->channels[i].in_use) {
+        cstats = &stats->channels[i];
+        break;
+      }
+      if(stats->channels[i].freshness < cstats->freshness) {
+        cstats = &stats->channels[i];
+      }
+    }
+    memset(cstats, 0, sizeof(*cstats));
+    cstats->in_use = 1;
+    cstats->channel = channel;
+    cstats->phy_mode = phy_mode;
+    /* Start from what we know of the neighbor */
+    cstats->etx = stats->etx;
+    cstats->rssi = stats->rssi;
+  }
+  return cstats;
+}
+#endif /* LINK_STATS_WITH_CHANNELS */
+/*---------------------------------------------------------------------------*/
 uint16_t
 guess_etx_from_rssi(const struct link_stats *stats)
 {
@@ -146,6 +250,9 @@ link_stats_packet_sent(const linkaddr_t *lladdr, int status, int numtx)
     stats = nbr_table_add_lladdr(link_stats, lladdr, NBR_TABLE_REASON_LINK_STATS, NULL);
     if(stats != NULL) {
       stats->etx = LINK_STATS_INIT_ETX(stats);
+#if LINK_STATS_WITH_DUAL_EWMA
+      stats->etx_fast = stats->etx;
+#endif /* LINK_STATS_WITH_DUAL_EWMA */
     } else {
       return; /* No space left, return */
     }
@@ -163,6 +270,25 @@ link_stats_packet_sent(const linkaddr_t *lladdr, int status, int numtx)
   /* Compute EWMA and update ETX */
   stats->etx = ((uint32_t)stats->etx * (EWMA_SCALE - ewma_alpha) +
       (uint32_t)packet_etx * ewma_alpha) / EWMA_SCALE;
+
+#if LINK_STATS_WITH_DUAL_EWMA
+  stats->etx_fast = ((uint32_t)stats->etx_fast * (EWMA_SCALE - EWMA_FAST_ALPHA) +
+      (uint32_t)packet_etx * EWMA_FAST_ALPHA) / EWMA_SCALE;
+#endif /* LINK_STATS_WITH_DUAL_EWMA */
+
+#if LINK_STATS_WITH_CHANNELS
+  {
+    struct link_stats_channel *cstats = packet_channel_stats(stats);
+    cstats->num_tx = saturating_add(cstats->num_tx, numtx);
+    if(status == MAC_TX_OK) {
+      cstats->num_acked = saturating_add(cstats->num_acked, 1);
+    }
+    ewma_alpha = link_stats_channel_is_fresh(cstats) ? EWMA_ALPHA : EWMA_BOOTSTRAP_ALPHA;
+    cstats->freshness = MIN(cstats->freshness + numtx, FRESHNESS_MAX);
+    cstats->etx = ((uint32_t)cstats->etx * (EWMA_SCALE - ewma_alpha) +
+        (uint32_t)packet_etx * ewma_alpha) / EWMA_SCALE;
+  }
+#endif /* LINK_STATS_WITH_CHANNELS */
 }
 /*---------------------------------------------------------------------------*/
 /* Packet input callback. Updates statistics for receptions on a given link */
@@ -180,6 +306,12 @@ link_stats_input_callback(const linkaddr_t *lladdr)
       /* Initialize */
       stats->rssi = packet_rssi;
       stats->etx = LINK_STATS_INIT_ETX(stats);
+#if LINK_STATS_WITH_DUAL_EWMA
+      stats->etx_fast = stats->etx;
+#endif /* LINK_STATS_WITH_DUAL_EWMA */
+#if LINK_STATS_WITH_CHANNELS
+      packet_channel_stats(stats)->num_rx = 1;
+#endif /* LINK_STATS_WITH_CHANNELS */
     }
     return;
   }
@@ -187,6 +319,19 @@ link_stats_input_callback(const linkaddr_t *lladdr)
   /* Update RSSI EWMA */
   stats->rssi = ((int32_t)stats->rssi * (EWMA_SCALE - EWMA_ALPHA) +
       (int32_t)packet_rssi * EWMA_ALPHA) / EWMA_SCALE;
+
+#if LINK_STATS_WITH_CHANNELS
+  {
+    struct link_stats_channel *cstats = packet_channel_stats(stats);
+    if(cstats->num_rx == 0) {
+      cstats->rssi = packet_rssi;
+    } else {
+      cstats->rssi = ((int32_t)cstats->rssi * (EWMA_SCALE - EWMA_ALPHA) +
+          (int32_t)packet_rssi * EWMA_ALPHA) / EWMA_SCALE;
+    }
+    cstats->num_rx = saturating_add(cstats->num_rx, 1);
+  }
+#endif /* LINK_STATS_WITH_CHANNELS */
 }
 /*---------------------------------------------------------------------------*/
 /* Periodic timer called every FRESHNESS_HALF_LIFE minutes */
@@ -198,6 +343,14 @@ periodic(void *ptr)
   ctimer_reset(&periodic_timer);
   for(stats = nbr_table_head(link_stats); stats != NULL; stats = nbr_table_next(link_stats, stats)) {
     stats->freshness >>= 1;
+#if LINK_STATS_WITH_CHANNELS
+    {
+      int i;
+      for(i = 0; i < LINK_STATS_NUM_CHANNELS; i++) {
+        stats->channels[i].freshness >>= 1;
+      }
+    }
+#endif /* LINK_STATS_WITH_CHANNELS */
   }
 }
 /*---------------------------------------------------------------------------*/
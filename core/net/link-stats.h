@@ -42,18 +42,101 @@
 #define LINK_STATS_ETX_DIVISOR              128
 #endif /* LINK_STATS_CONF_ETX_DIVISOR */
 
+/* Keep, next to the per-neighbor statistics, statistics per channel and
+ * PHY mode the neighbor was reached on. Useful with channel hopping
+ * (TSCH) or radios with several data rates, where a single ETX mixes
+ * links of very different quality */
+#ifdef LINK_STATS_CONF_WITH_CHANNELS
+#define LINK_STATS_WITH_CHANNELS            LINK_STATS_CONF_WITH_CHANNELS
+#else /* LINK_STATS_CONF_WITH_CHANNELS */
+#define LINK_STATS_WITH_CHANNELS            0
+#endif /* LINK_STATS_CONF_WITH_CHANNELS */
+
+/* Number of (channel, PHY mode) pairs tracked per neighbor. When full,
+ * the least fresh pair is replaced */
+#ifdef LINK_STATS_CONF_NUM_CHANNELS
+#define LINK_STATS_NUM_CHANNELS             LINK_STATS_CONF_NUM_CHANNELS
+#else /* LINK_STATS_CONF_NUM_CHANNELS */
+#define LINK_STATS_NUM_CHANNELS             4
+#endif /* LINK_STATS_CONF_NUM_CHANNELS */
+
+/* Channel of the packet in packetbuf, for per-channel statistics. The
+ * default, the current radio channel, suits single-channel MACs. With
+ * TSCH, which sets the channel attribute of every packet it sends and
+ * receives, use packetbuf_attr(PACKETBUF_ATTR_CHANNEL) */
+#ifdef LINK_STATS_CONF_CHANNEL
+#define LINK_STATS_CHANNEL()                LINK_STATS_CONF_CHANNEL()
+#else /* LINK_STATS_CONF_CHANNEL */
+#define LINK_STATS_CHANNEL()                link_stats_radio_channel()
+#endif /* LINK_STATS_CONF_CHANNEL */
+
+/* PHY mode (e.g. data rate) of the packet in packetbuf, for radios
+ * supporting several of them */
+#ifdef LINK_STATS_CONF_PHY_MODE
+#define LINK_STATS_PHY_MODE()               LINK_STATS_CONF_PHY_MODE()
+#else /* LINK_STATS_CONF_PHY_MODE */
+#define LINK_STATS_PHY_MODE()               0
+#endif /* LINK_STATS_CONF_PHY_MODE */
+
+/* Maintain a second, fast reacting ETX next to the regular, stable one.
+ * The fast ETX tracks sudden link degradations */
+#ifdef LINK_STATS_CONF_WITH_DUAL_EWMA
+#define LINK_STATS_WITH_DUAL_EWMA           LINK_STATS_CONF_WITH_DUAL_EWMA
+#else /* LINK_STATS_CONF_WITH_DUAL_EWMA */
+#define LINK_STATS_WITH_DUAL_EWMA           0
+#endif /* LINK_STATS_CONF_WITH_DUAL_EWMA */
+
+#if LINK_STATS_WITH_CHANNELS
+/* Statistics of a link on a given channel and PHY mode */
+struct link_stats_channel {
+  uint16_t etx;               /* ETX using ETX_DIVISOR as fixed point divisor */
+  int16_t rssi;               /* RSSI (received signal strength) */
+  uint16_t num_tx;            /* Transmissions (saturating) */
+  uint16_t num_acked;         /* Acknowledged transmissions (saturating) */
+  uint16_t num_rx;            /* Receptions (saturating) */
+  uint8_t channel;
+  uint8_t phy_mode;
+  uint8_t freshness;          /* Freshness of the statistics */
+  uint8_t in_use;
+};
+#endif /* LINK_STATS_WITH_CHANNELS */
+
 /* All statistics of a given link */
 struct link_stats {
   uint16_t etx;               /* ETX using ETX_DIVISOR as fixed point divisor */
+#if LINK_STATS_WITH_DUAL_EWMA
+  uint16_t etx_fast;          /* Fast reacting ETX, same divisor */
+#endif /* LINK_STATS_WITH_DUAL_EWMA */
   int16_t rssi;               /* RSSI (received signal strength) */
   uint8_t freshness;          /* Freshness of the statistics */
   clock_time_t last_tx_time;  /* Last Tx timestamp */
+#if LINK_STATS_WITH_CHANNELS
+  struct link_stats_channel channels[LINK_STATS_NUM_CHANNELS];
+#endif /* LINK_STATS_WITH_CHANNELS */
 };
 
 /* Returns the neighbor's link statistics */
 const struct link_stats *link_stats_from_lladdr(const linkaddr_t *lladdr);
+/* Returns the link statistics of the neighbor at a given nbr-table
+ * index. All nbr-tables share their indices, so this avoids a lookup
+ * by link-layer address when another table's entry is at hand. */
+const struct link_stats *link_stats_from_index(int index);
 /* Are the statistics fresh? */
 int link_stats_is_fresh(const struct link_stats *stats);
+/* Returns the worst of the slow and fast ETX of a link: what the link is
+ * worth now, reacting quickly to degradations but slowly to improvements.
+ * The regular ETX if the fast one is disabled */
+uint16_t link_stats_get_etx(const struct link_stats *stats);
+#if LINK_STATS_WITH_CHANNELS
+/* Returns the statistics of a link on a given channel and PHY mode,
+ * NULL if none */
+const struct link_stats_channel *link_stats_get_channel(const struct link_stats *stats,
+                                                        uint8_t channel, uint8_t phy_mode);
+/* Are the per-channel statistics fresh? */
+int link_stats_channel_is_fresh(const struct link_stats_channel *cstats);
+#endif /* LINK_STATS_WITH_CHANNELS */
+/* Current radio channel, the default LINK_STATS_CHANNEL() */
+uint8_t link_stats_radio_channel(void);
 
 /* Initializes link-stats module */
 void link_stats_init(void);
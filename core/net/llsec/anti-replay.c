@@ -46,18 +46,84 @@
 #include "net/llsec/anti-replay.h"
 #include "net/packetbuf.h"
 #include "net/llsec/llsec802154.h"
+#if ANTI_REPLAY_WITH_PERSISTENCE
+#include "cfs/cfs.h"
+#endif /* ANTI_REPLAY_WITH_PERSISTENCE */
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else /* DEBUG */
+#define PRINTF(...)
+#endif /* DEBUG */
 
 #if LLSEC802154_USES_FRAME_COUNTER
 
 /* This node's current frame counter value */
 static uint32_t counter;
 
+#if ANTI_REPLAY_WITH_PERSISTENCE
+/* Highest counter value stored in CFS. Counter values up to it may have
+ * been used before a reboot */
+static uint32_t reserved;
+static uint8_t loaded;
+
+/*---------------------------------------------------------------------------*/
+static void
+load_counter(void)
+{
+  int fd;
+  uint32_t stored;
+
+  loaded = 1;
+  fd = cfs_open(ANTI_REPLAY_PERSIST_FILE, CFS_READ);
+  if(fd < 0) {
+    return;
+  }
+  if(cfs_read(fd, &stored, sizeof(stored)) == sizeof(stored)) {
+    counter = reserved = stored;
+    PRINTF("anti-replay: resuming frame counter at %lu\n",
+           (unsigned long)counter);
+  }
+  cfs_close(fd);
+}
+/*---------------------------------------------------------------------------*/
+static void
+reserve_counters(uint32_t end)
+{
+  int fd;
+  int written;
+
+  fd = cfs_open(ANTI_REPLAY_PERSIST_FILE, CFS_WRITE);
+  if(fd < 0) {
+    PRINTF("anti-replay: cfs open error\n");
+    return;
+  }
+  written = cfs_write(fd, &end, sizeof(end));
+  cfs_close(fd);
+  if(written == sizeof(end)) {
+    reserved = end;
+  } else {
+    /* Retried with the next frame */
+    PRINTF("anti-replay: cfs write error\n");
+  }
+}
+#endif /* ANTI_REPLAY_WITH_PERSISTENCE */
 /*---------------------------------------------------------------------------*/
 void
 anti_replay_set_counter(void)
 {
   frame802154_frame_counter_t reordered_counter;
   
+#if ANTI_REPLAY_WITH_PERSISTENCE
+  if(!loaded) {
+    load_counter();
+  }
+  if(counter >= reserved) {
+    reserve_counters(counter + ANTI_REPLAY_PERSIST_WINDOW);
+  }
+#endif /* ANTI_REPLAY_WITH_PERSISTENCE */
   ++counter;
   reordered_counter.u32 = LLSEC802154_HTONL(counter);
   
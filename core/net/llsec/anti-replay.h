@@ -47,6 +47,31 @@
 
 #include "contiki.h"
 
+/*
+ * Persist this node's frame counter in CFS (Coffee on most platforms), so
+ * that it keeps increasing across reboots and neighbors do not take our
+ * frames for replays. To spare the flash, only the end of a window of
+ * counter values is written, once every ANTI_REPLAY_PERSIST_WINDOW frames.
+ * After a reboot, the counter resumes from the end of the last window.
+ */
+#ifdef ANTI_REPLAY_CONF_WITH_PERSISTENCE
+#define ANTI_REPLAY_WITH_PERSISTENCE ANTI_REPLAY_CONF_WITH_PERSISTENCE
+#else /* ANTI_REPLAY_CONF_WITH_PERSISTENCE */
+#define ANTI_REPLAY_WITH_PERSISTENCE 0
+#endif /* ANTI_REPLAY_CONF_WITH_PERSISTENCE */
+
+#ifdef ANTI_REPLAY_CONF_PERSIST_WINDOW
+#define ANTI_REPLAY_PERSIST_WINDOW ANTI_REPLAY_CONF_PERSIST_WINDOW
+#else /* ANTI_REPLAY_CONF_PERSIST_WINDOW */
+#define ANTI_REPLAY_PERSIST_WINDOW 256
+#endif /* ANTI_REPLAY_CONF_PERSIST_WINDOW */
+
+#ifdef ANTI_REPLAY_CONF_PERSIST_FILE
+#define ANTI_REPLAY_PERSIST_FILE ANTI_REPLAY_CONF_PERSIST_FILE
+#else /* ANTI_REPLAY_CONF_PERSIST_FILE */
+#define ANTI_REPLAY_PERSIST_FILE "llsec-counter"
+#endif /* ANTI_REPLAY_CONF_PERSIST_FILE */
+
 struct anti_replay_info {
   uint32_t last_broadcast_counter;
   uint32_t last_unicast_counter;
@@ -0,0 +1,345 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \file
+ *         802.15.4 security implementation, which uses pairwise keys
+ *         derived from a network-wide shared secret
+ *
+ *         The key shared by two nodes is the AES encryption of their
+ *         link-layer addresses, the lower one first, under the shared
+ *         secret. The group key for broadcast frames is derived from the
+ *         null address the same way. The key of each neighbor is derived
+ *         once and kept in the neighbor table, so securing a frame costs
+ *         a table lookup more than with noncoresec, and the expanded key
+ *         is found in the key cache of AES_128 (AES_128_CONF_KEY_CACHE_SIZE)
+ *         as long as it holds the keys of the active neighbors.
+ */
+
+/**
+ * \addtogroup pairwisesec
+ * @{
+ */
+
+#include "net/llsec/pairwisesec/pairwisesec.h"
+#include "net/llsec/anti-replay.h"
+#include "net/llsec/llsec802154.h"
+#include "net/llsec/ccm-star-packetbuf.h"
+#include "net/mac/frame802154.h"
+#include "net/netstack.h"
+#include "net/packetbuf.h"
+#include "net/nbr-table.h"
+#include "net/linkaddr.h"
+#include "lib/aes-128.h"
+#include "lib/ccm-star.h"
+#include <string.h>
+
+#ifdef PAIRWISESEC_CONF_DECORATED_FRAMER
+#define DECORATED_FRAMER PAIRWISESEC_CONF_DECORATED_FRAMER
+#else /* PAIRWISESEC_CONF_DECORATED_FRAMER */
+#define DECORATED_FRAMER framer_802154
+#endif /* PAIRWISESEC_CONF_DECORATED_FRAMER */
+
+extern const struct framer DECORATED_FRAMER;
+
+#ifdef PAIRWISESEC_CONF_SEC_LVL
+#define SEC_LVL         PAIRWISESEC_CONF_SEC_LVL
+#else /* PAIRWISESEC_CONF_SEC_LVL */
+#define SEC_LVL         2
+#endif /* PAIRWISESEC_CONF_SEC_LVL */
+
+#define WITH_ENCRYPTION (SEC_LVL & (1 << 2))
+#define MIC_LEN         LLSEC802154_MIC_LEN(SEC_LVL)
+
+#ifdef PAIRWISESEC_CONF_SECRET
+#define PAIRWISESEC_SECRET PAIRWISESEC_CONF_SECRET
+#else /* PAIRWISESEC_CONF_SECRET */
+#define PAIRWISESEC_SECRET { 0x00 , 0x01 , 0x02 , 0x03 , \
+                             0x04 , 0x05 , 0x06 , 0x07 , \
+                             0x08 , 0x09 , 0x0A , 0x0B , \
+                             0x0C , 0x0D , 0x0E , 0x0F }
+#endif /* PAIRWISESEC_CONF_SECRET */
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else /* DEBUG */
+#define PRINTF(...)
+#endif /* DEBUG */
+
+#if LLSEC802154_USES_AUX_HEADER && SEC_LVL && LLSEC802154_USES_FRAME_COUNTER
+
+struct pairwise_neighbor {
+  struct anti_replay_info anti_replay_info;
+  uint8_t key[AES_128_KEY_LENGTH];
+  /* set once a frame from the neighbor was accepted */
+  uint8_t has_counters;
+};
+
+/* network-wide secret the keys are derived from */
+static const uint8_t secret[AES_128_KEY_LENGTH] = PAIRWISESEC_SECRET;
+static uint8_t group_key[AES_128_KEY_LENGTH];
+NBR_TABLE(struct pairwise_neighbor, neighbors);
+
+/*---------------------------------------------------------------------------*/
+/* Derives the key shared with a neighbor, or the group key */
+static void
+derive_key(const linkaddr_t *neighbor, uint8_t *key)
+{
+  const linkaddr_t *low = &linkaddr_node_addr;
+  const linkaddr_t *high = neighbor;
+
+  if(linkaddr_cmp(neighbor, &linkaddr_null)) {
+    low = &linkaddr_null;
+  } else if(memcmp(neighbor, &linkaddr_node_addr, LINKADDR_SIZE) < 0) {
+    low = neighbor;
+    high = &linkaddr_node_addr;
+  }
+
+  memset(key, 0, AES_128_KEY_LENGTH);
+  memcpy(key, low, LINKADDR_SIZE);
+  memcpy(key + AES_128_KEY_LENGTH / 2, high, LINKADDR_SIZE);
+  AES_128.set_key(secret);
+  AES_128.encrypt(key);
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Returns the key shared with a neighbor. Unless the neighbor is in the
+ * table, it is added when sending, while the key is only derived into
+ * buf when receiving so that unauthentic frames can not evict neighbors.
+ */
+static const uint8_t *
+get_key(const linkaddr_t *neighbor, int add, uint8_t *buf)
+{
+  struct pairwise_neighbor *n;
+
+  if(linkaddr_cmp(neighbor, &linkaddr_null)) {
+    return group_key;
+  }
+  n = nbr_table_get_from_lladdr(neighbors, neighbor);
+  if(n == NULL && add) {
+    n = nbr_table_add_lladdr(neighbors, neighbor, NBR_TABLE_REASON_LLSEC,
+                             NULL);
+    if(n != NULL) {
+      derive_key(neighbor, n->key);
+      n->has_counters = 0;
+    }
+  }
+  if(n == NULL) {
+    derive_key(neighbor, buf);
+    return buf;
+  }
+  return n->key;
+}
+/*---------------------------------------------------------------------------*/
+static int
+aead(uint8_t hdrlen, int forward, const uint8_t *key)
+{
+  uint8_t totlen;
+  uint8_t nonce[CCM_STAR_NONCE_LENGTH];
+  uint8_t *m;
+  uint8_t m_len;
+  uint8_t *a;
+  uint8_t a_len;
+  uint8_t *result;
+  uint8_t generated_mic[MIC_LEN];
+  uint8_t *mic;
+
+  ccm_star_packetbuf_set_nonce(nonce, forward);
+  totlen = packetbuf_totlen();
+  a = packetbuf_hdrptr();
+#if WITH_ENCRYPTION
+  a_len = hdrlen;
+  m = a + a_len;
+  m_len = totlen - hdrlen;
+#else /* WITH_ENCRYPTION */
+  a_len = totlen;
+  m = NULL;
+  m_len = 0;
+#endif /* WITH_ENCRYPTION */
+
+  mic = a + totlen;
+  result = forward ? mic : generated_mic;
+
+  CCM_STAR.set_key(key);
+  CCM_STAR.aead(nonce,
+      m, m_len,
+      a, a_len,
+      result, MIC_LEN,
+      forward);
+
+  if(forward) {
+    packetbuf_set_datalen(packetbuf_datalen() + MIC_LEN);
+    return 1;
+  } else {
+    return (memcmp(generated_mic, mic, MIC_LEN) == 0);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+add_security_header(void)
+{
+  packetbuf_set_attr(PACKETBUF_ATTR_FRAME_TYPE, FRAME802154_DATAFRAME);
+  packetbuf_set_attr(PACKETBUF_ATTR_SECURITY_LEVEL, SEC_LVL);
+}
+/*---------------------------------------------------------------------------*/
+static void
+send(mac_callback_t sent, void *ptr)
+{
+  add_security_header();
+  anti_replay_set_counter();
+  NETSTACK_MAC.send(sent, ptr);
+}
+/*---------------------------------------------------------------------------*/
+static int
+create(void)
+{
+  int result;
+  uint8_t key[AES_128_KEY_LENGTH];
+
+  result = DECORATED_FRAMER.create();
+  if(result == FRAMER_FAILED) {
+    return result;
+  }
+
+  aead(result, 1, get_key(packetbuf_addr(PACKETBUF_ADDR_RECEIVER), 1, key));
+
+  return result;
+}
+/*---------------------------------------------------------------------------*/
+static int
+parse(void)
+{
+  int result;
+  const linkaddr_t *sender;
+  const linkaddr_t *receiver;
+  struct pairwise_neighbor *n;
+  uint8_t key[AES_128_KEY_LENGTH];
+
+  result = DECORATED_FRAMER.parse();
+  if(result == FRAMER_FAILED) {
+    return result;
+  }
+
+  if(packetbuf_attr(PACKETBUF_ATTR_SECURITY_LEVEL) != SEC_LVL) {
+    PRINTF("pairwisesec: received frame with wrong security level\n");
+    return FRAMER_FAILED;
+  }
+  sender = packetbuf_addr(PACKETBUF_ADDR_SENDER);
+  if(linkaddr_cmp(sender, &linkaddr_node_addr)) {
+    PRINTF("pairwisesec: frame from ourselves\n");
+    return FRAMER_FAILED;
+  }
+  receiver = packetbuf_addr(PACKETBUF_ADDR_RECEIVER);
+  if(!linkaddr_cmp(receiver, &linkaddr_null)
+     && !linkaddr_cmp(receiver, &linkaddr_node_addr)) {
+    /* secured with a key we do not have */
+    PRINTF("pairwisesec: frame for another node\n");
+    return FRAMER_FAILED;
+  }
+
+  packetbuf_set_datalen(packetbuf_datalen() - MIC_LEN);
+
+  if(!aead(result, 0, get_key(linkaddr_cmp(receiver, &linkaddr_null) ?
+                              &linkaddr_null : sender, 0, key))) {
+    PRINTF("pairwisesec: received unauthentic frame %lu\n",
+        anti_replay_get_counter());
+    return FRAMER_FAILED;
+  }
+
+  n = nbr_table_get_from_lladdr(neighbors, sender);
+  if(n == NULL) {
+    n = nbr_table_add_lladdr(neighbors, sender, NBR_TABLE_REASON_LLSEC, NULL);
+    if(n == NULL) {
+      PRINTF("pairwisesec: could not get nbr_table_item\n");
+      return FRAMER_FAILED;
+    }
+    derive_key(sender, n->key);
+    n->has_counters = 0;
+  }
+
+  if(!n->has_counters) {
+    /* Locking avoids replay attacks due to removed neighbor table items */
+    if(!nbr_table_lock(neighbors, n)) {
+      nbr_table_remove(neighbors, n);
+      PRINTF("pairwisesec: could not lock\n");
+      return FRAMER_FAILED;
+    }
+    anti_replay_init_info(&n->anti_replay_info);
+    n->has_counters = 1;
+  } else if(anti_replay_was_replayed(&n->anti_replay_info)) {
+    PRINTF("pairwisesec: received replayed frame %lu\n",
+        anti_replay_get_counter());
+    return FRAMER_FAILED;
+  }
+
+  return result;
+}
+/*---------------------------------------------------------------------------*/
+static void
+input(void)
+{
+  NETSTACK_NETWORK.input();
+}
+/*---------------------------------------------------------------------------*/
+static int
+length(void)
+{
+  add_security_header();
+  return DECORATED_FRAMER.length() + MIC_LEN;
+}
+/*---------------------------------------------------------------------------*/
+static void
+init(void)
+{
+  derive_key(&linkaddr_null, group_key);
+  nbr_table_register(neighbors, NULL);
+}
+/*---------------------------------------------------------------------------*/
+const struct llsec_driver pairwisesec_driver = {
+  "pairwisesec",
+  init,
+  send,
+  input
+};
+/*---------------------------------------------------------------------------*/
+const struct framer pairwisesec_framer = {
+  length,
+  create,
+  parse
+};
+/*---------------------------------------------------------------------------*/
+#endif /* LLSEC802154_USES_AUX_HEADER && SEC_LVL && LLSEC802154_USES_FRAME_COUNTER */
+
+/** @} */
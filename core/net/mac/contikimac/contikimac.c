@@ -90,6 +90,30 @@
 #define CYCLE_TIME (RTIMER_ARCH_SECOND / NETSTACK_RDC_CHANNEL_CHECK_RATE)
 #endif
 
+/* Adaptive channel check rate: after a unicast exchange, check the
+   channel CONTIKIMAC_ADAPTIVE_RATE_FACTOR times per cycle for
+   CONTIKIMAC_ADAPTIVE_RATE_CYCLES cycles, so that follow-up packets
+   (e.g. a response to a request) get through without waiting for a
+   full cycle. The regular channel checks are kept in place, so the
+   phase of the node does not change. */
+#ifdef CONTIKIMAC_CONF_WITH_ADAPTIVE_RATE
+#define WITH_ADAPTIVE_RATE                   CONTIKIMAC_CONF_WITH_ADAPTIVE_RATE
+#else
+#define WITH_ADAPTIVE_RATE                   0
+#endif
+
+#ifdef CONTIKIMAC_CONF_ADAPTIVE_RATE_FACTOR
+#define CONTIKIMAC_ADAPTIVE_RATE_FACTOR      CONTIKIMAC_CONF_ADAPTIVE_RATE_FACTOR
+#else
+#define CONTIKIMAC_ADAPTIVE_RATE_FACTOR      4
+#endif
+
+#ifdef CONTIKIMAC_CONF_ADAPTIVE_RATE_CYCLES
+#define CONTIKIMAC_ADAPTIVE_RATE_CYCLES      CONTIKIMAC_CONF_ADAPTIVE_RATE_CYCLES
+#else
+#define CONTIKIMAC_ADAPTIVE_RATE_CYCLES      NETSTACK_RDC_CHANNEL_CHECK_RATE
+#endif
+
 /* CHANNEL_CHECK_RATE is enforced to be a power of two.
  * If RTIMER_ARCH_SECOND is not also a power of two, there will be an inexact
  * number of channel checks per second due to the truncation of CYCLE_TIME.
@@ -104,6 +128,11 @@
 /* Are we currently receiving a burst? */
 static int we_are_receiving_burst = 0;
 
+#if WITH_ADAPTIVE_RATE
+/* Number of cycles left with additional channel checks */
+static volatile uint16_t fast_cycles_left = 0;
+#endif /* WITH_ADAPTIVE_RATE */
+
 /* INTER_PACKET_DEADLINE is the maximum time a receiver waits for the
    next packet of a burst when FRAME_PENDING is set. */
 #ifdef CONTIKIMAC_CONF_INTER_PACKET_DEADLINE
@@ -411,6 +440,10 @@ powercycle(struct rtimer *t, void *ptr)
   while(1) {
     static uint8_t packet_seen;
     static uint8_t count;
+    static rtimer_clock_t next_check;
+#if WITH_ADAPTIVE_RATE
+    static uint8_t fast_check;
+#endif /* WITH_ADAPTIVE_RATE */
 
     packet_seen = 0;
 
@@ -492,9 +525,24 @@ powercycle(struct rtimer *t, void *ptr)
       }
     }
 
+#if WITH_ADAPTIVE_RATE
+    if(fast_cycles_left > 0 && ++fast_check < CONTIKIMAC_ADAPTIVE_RATE_FACTOR) {
+      /* Additional channel check within the current cycle */
+      next_check = cycle_start + fast_check * (CYCLE_TIME / CONTIKIMAC_ADAPTIVE_RATE_FACTOR);
+    } else {
+      fast_check = 0;
+      if(fast_cycles_left > 0) {
+        fast_cycles_left--;
+      }
+      advance_cycle_start();
+      next_check = cycle_start;
+    }
+#else /* WITH_ADAPTIVE_RATE */
     advance_cycle_start();
+    next_check = cycle_start;
+#endif /* WITH_ADAPTIVE_RATE */
 
-    if(RTIMER_CLOCK_LT(RTIMER_NOW() , cycle_start - CHECK_TIME * 4)) {
+    if(RTIMER_CLOCK_LT(RTIMER_NOW() , next_check - CHECK_TIME * 4)) {
       /* Schedule the next powercycle interrupt, or sleep the mcu
       until then.  Sleeping will not exit from this interrupt, so
       ensure an occasional wake cycle or foreground processing will
@@ -503,14 +551,14 @@ powercycle(struct rtimer *t, void *ptr)
 
       static uint8_t sleepcycle;
       if((sleepcycle++ < 16) && !we_are_sending && !radio_is_on) {
-        rtimer_arch_sleep(RTIMER_NOW() - cycle_start);
+        rtimer_arch_sleep(RTIMER_NOW() - next_check);
       } else {
         sleepcycle = 0;
-        schedule_powercycle_fixed(t, cycle_start);
+        schedule_powercycle_fixed(t, next_check);
         PT_YIELD(&pt);
       }
 #else
-      schedule_powercycle_fixed(t, cycle_start);
+      schedule_powercycle_fixed(t, next_check);
       PT_YIELD(&pt);
 #endif
     }
@@ -815,6 +863,13 @@ send_packet(mac_callback_t mac_callback, void *mac_callback_ptr,
     ret = MAC_TX_OK;
   }
 
+#if WITH_ADAPTIVE_RATE
+  if(!is_broadcast && ret == MAC_TX_OK) {
+    /* Be quick to receive the response, if any */
+    fast_cycles_left = CONTIKIMAC_ADAPTIVE_RATE_CYCLES;
+  }
+#endif /* WITH_ADAPTIVE_RATE */
+
 #if WITH_PHASE_OPTIMIZATION
   if(is_known_receiver && got_strobe_ack) {
     PRINTF("no miss %d wake-ups %d\n",
@@ -961,6 +1016,13 @@ input_packet(void)
       /* This is a regular packet that is destined to us or to the
          broadcast address. */
 
+#if WITH_ADAPTIVE_RATE
+      if(!packetbuf_holds_broadcast()) {
+        /* More packets of the same exchange may follow shortly */
+        fast_cycles_left = CONTIKIMAC_ADAPTIVE_RATE_CYCLES;
+      }
+#endif /* WITH_ADAPTIVE_RATE */
+
       /* If FRAME_PENDING is set, we are receiving a packets in a burst */
       we_are_receiving_burst = packetbuf_attr(PACKETBUF_ATTR_PENDING);
       if(we_are_receiving_burst) {
@@ -43,6 +43,9 @@
 
 #include "sys/ctimer.h"
 #include "sys/clock.h"
+#include "sys/trace.h"
+#include "net/net-stats.h"
+#include "net/latency-trace.h"
 
 #include "lib/random.h"
 
@@ -93,11 +96,37 @@
 #define CSMA_MAX_MAX_FRAME_RETRIES 7
 #endif
 
+/* Active queue management, CoDel-like: once packets have been waiting
+ * for more than CSMA_AQM_TARGET for at least CSMA_AQM_INTERVAL, they are
+ * dropped from the head of the queue rather than transmitted */
+#ifdef CSMA_CONF_WITH_AQM
+#define CSMA_WITH_AQM CSMA_CONF_WITH_AQM
+#else
+#define CSMA_WITH_AQM 0
+#endif
+
+/* AQM: acceptable time spent in the queue */
+#ifdef CSMA_CONF_AQM_TARGET
+#define CSMA_AQM_TARGET CSMA_CONF_AQM_TARGET
+#else
+#define CSMA_AQM_TARGET (CLOCK_SECOND / 4)
+#endif
+
+/* AQM: for how long the queuing time may stay above target */
+#ifdef CSMA_CONF_AQM_INTERVAL
+#define CSMA_AQM_INTERVAL CSMA_CONF_AQM_INTERVAL
+#else
+#define CSMA_AQM_INTERVAL CLOCK_SECOND
+#endif
+
 /* Packet metadata */
 struct qbuf_metadata {
   mac_callback_t sent;
   void *cptr;
   uint8_t max_transmissions;
+#if CSMA_WITH_AQM
+  clock_time_t enqueue_time;
+#endif /* CSMA_WITH_AQM */
 };
 
 /* Every neighbor has its own packet queue */
@@ -107,7 +136,12 @@ struct neighbor_queue {
   struct ctimer transmit_timer;
   uint8_t transmissions;
   uint8_t collisions;
-  LIST_STRUCT(queued_packet_list);
+#if CSMA_WITH_AQM
+  /* Since when packets at the head have waited for more than target */
+  uint8_t aqm_above_target;
+  clock_time_t aqm_above_target_since;
+#endif /* CSMA_WITH_AQM */
+  LIST_TAILQ_STRUCT(queued_packet_list);
 };
 
 /* The maximum number of co-existing neighbor queues */
@@ -124,19 +158,60 @@ struct neighbor_queue {
 #define CSMA_MAX_PACKET_PER_NEIGHBOR MAX_QUEUED_PACKETS
 #endif /* CSMA_CONF_MAX_PACKET_PER_NEIGHBOR */
 
+/* Neighbor queues are indexed by the last byte of their address, in
+ * this many lists */
+#ifdef CSMA_CONF_NEIGHBOR_QUEUE_BUCKETS
+#define CSMA_NEIGHBOR_QUEUE_BUCKETS CSMA_CONF_NEIGHBOR_QUEUE_BUCKETS
+#else
+#define CSMA_NEIGHBOR_QUEUE_BUCKETS CSMA_MAX_NEIGHBOR_QUEUES
+#endif /* CSMA_CONF_NEIGHBOR_QUEUE_BUCKETS */
+
 #define MAX_QUEUED_PACKETS QUEUEBUF_NUM
 MEMB(neighbor_memb, struct neighbor_queue, CSMA_MAX_NEIGHBOR_QUEUES);
 MEMB(packet_memb, struct rdc_buf_list, MAX_QUEUED_PACKETS);
 MEMB(metadata_memb, struct qbuf_metadata, MAX_QUEUED_PACKETS);
-LIST(neighbor_list);
+static void *neighbor_buckets[CSMA_NEIGHBOR_QUEUE_BUCKETS];
+
+enum {
+  STATS_QUEUED, STATS_TX_OK, STATS_NOACK, STATS_COLLISION, STATS_REXMIT,
+  STATS_DROP, STATS_AQM_DROP, STATS_QUEUE_LEN, STATS_NUM
+};
+#if NET_STATS_ENABLED
+static uint32_t stats[STATS_QUEUE_LEN];
+static const char * const stats_names[STATS_NUM] = {
+  "queued", "tx_ok", "noack", "collision", "rexmit",
+  "drop", "aqm_drop", "queue_len"
+};
+static uint32_t
+stats_get(uint8_t index)
+{
+  if(index == STATS_QUEUE_LEN) {
+    return MAX_QUEUED_PACKETS - memb_numfree(&packet_memb);
+  }
+  return stats[index];
+}
+static struct net_stats_group stats_group = {
+  NULL, "csma", stats_names, STATS_NUM, stats_get
+};
+#endif /* NET_STATS_ENABLED */
 
 static void packet_sent(void *ptr, int status, int num_transmissions);
 static void transmit_packet_list(void *ptr);
+#if CSMA_WITH_AQM
+static void tx_done(int status, struct rdc_buf_list *q, struct neighbor_queue *n);
+#endif /* CSMA_WITH_AQM */
+/*---------------------------------------------------------------------------*/
+static list_t
+neighbor_bucket(const linkaddr_t *addr)
+{
+  return (list_t)&neighbor_buckets[addr->u8[LINKADDR_SIZE - 1]
+                                   % CSMA_NEIGHBOR_QUEUE_BUCKETS];
+}
 /*---------------------------------------------------------------------------*/
 static struct neighbor_queue *
 neighbor_queue_from_addr(const linkaddr_t *addr)
 {
-  struct neighbor_queue *n = list_head(neighbor_list);
+  struct neighbor_queue *n = list_head(neighbor_bucket(addr));
   while(n != NULL) {
     if(linkaddr_cmp(&n->addr, addr)) {
       return n;
@@ -163,15 +238,71 @@ backoff_period(void)
   return time;
 }
 /*---------------------------------------------------------------------------*/
+#if CSMA_WITH_AQM
+/* Drop a packet that is not at the head of its queue */
+static void
+drop_packet(struct neighbor_queue *n, struct rdc_buf_list *p)
+{
+  struct qbuf_metadata *metadata = (struct qbuf_metadata *)p->ptr;
+  mac_callback_t sent = metadata->sent;
+  void *cptr = metadata->cptr;
+
+  list_remove(n->queued_packet_list, p);
+  queuebuf_free(p->buf);
+  memb_free(&metadata_memb, metadata);
+  memb_free(&packet_memb, p);
+  NET_STATS_ADD(stats, STATS_AQM_DROP);
+  mac_call_sent_callback(sent, cptr, MAC_TX_ERR, 0);
+}
+/*---------------------------------------------------------------------------*/
+static clock_time_t
+sojourn_time(struct rdc_buf_list *p)
+{
+  return clock_time() - ((struct qbuf_metadata *)p->ptr)->enqueue_time;
+}
+/*---------------------------------------------------------------------------*/
+/* Should the packet at the head of the queue be dropped rather than sent? */
+static int
+aqm_should_drop(struct neighbor_queue *n, struct rdc_buf_list *q)
+{
+  if(n->transmissions > 0) {
+    /* Do not interrupt retransmissions */
+    return 0;
+  }
+  if(sojourn_time(q) < CSMA_AQM_TARGET) {
+    n->aqm_above_target = 0;
+    return 0;
+  }
+  if(!n->aqm_above_target) {
+    n->aqm_above_target = 1;
+    n->aqm_above_target_since = clock_time();
+    return 0;
+  }
+  return clock_time() - n->aqm_above_target_since >= CSMA_AQM_INTERVAL;
+}
+#endif /* CSMA_WITH_AQM */
+/*---------------------------------------------------------------------------*/
 static void
 transmit_packet_list(void *ptr)
 {
   struct neighbor_queue *n = ptr;
   if(n) {
     struct rdc_buf_list *q = list_head(n->queued_packet_list);
+#if CSMA_WITH_AQM
+    if(q != NULL && aqm_should_drop(n, q)) {
+      PRINTF("csma: AQM drop, sojourn time %u\n", (unsigned)sojourn_time(q));
+      NET_STATS_ADD(stats, STATS_AQM_DROP);
+      /* Schedules the next packet, if any */
+      tx_done(MAC_TX_ERR, q, n);
+      return;
+    }
+#endif /* CSMA_WITH_AQM */
     if(q != NULL) {
       PRINTF("csma: preparing number %d %p, queue len %d\n", n->transmissions, q,
           list_length(n->queued_packet_list));
+      TRACE(CSMA_TX, n->transmissions, TRACE_NODE(&n->addr));
+      LATENCY_TRACE_STAMP_ID(queuebuf_attr(q->buf, PACKETBUF_ATTR_LATENCY_TRACE),
+                             LATENCY_TRACE_MAC_TX);
       /* Send packets in the neighbor's list */
       NETSTACK_RDC.send_list(packet_sent, n, q);
     }
@@ -219,7 +350,7 @@ free_packet(struct neighbor_queue *n, struct rdc_buf_list *p, int status)
     } else {
       /* This was the last packet in the queue, we free the neighbor */
       ctimer_stop(&n->transmit_timer);
-      list_remove(neighbor_list, n);
+      list_remove(neighbor_bucket(&n->addr), n);
       memb_free(&neighbor_memb, n);
     }
   }
@@ -239,17 +370,20 @@ tx_done(int status, struct rdc_buf_list *q, struct neighbor_queue *n)
   switch(status) {
   case MAC_TX_OK:
     PRINTF("csma: rexmit ok %d\n", n->transmissions);
+    NET_STATS_ADD(stats, STATS_TX_OK);
     break;
   case MAC_TX_COLLISION:
   case MAC_TX_NOACK:
     PRINTF("csma: drop with status %d after %d transmissions, %d collisions\n",
                  status, n->transmissions, n->collisions);
+    NET_STATS_ADD(stats, status == MAC_TX_NOACK ? STATS_NOACK : STATS_COLLISION);
     break;
   default:
     PRINTF("csma: rexmit failed %d: %d\n", n->transmissions, status);
     break;
   }
 
+  TRACE(CSMA_DONE, status, n->transmissions);
   free_packet(n, q, status);
   mac_call_sent_callback(sent, cptr, status, n->transmissions);
 }
@@ -257,6 +391,7 @@ tx_done(int status, struct rdc_buf_list *q, struct neighbor_queue *n)
 static void
 rexmit(struct rdc_buf_list *q, struct neighbor_queue *n)
 {
+  NET_STATS_ADD(stats, STATS_REXMIT);
   schedule_transmission(n);
   /* This is needed to correctly attribute energy that we spent
      transmitting this packet. */
@@ -392,12 +527,30 @@ send_packet(mac_callback_t sent, void *ptr)
       linkaddr_copy(&n->addr, addr);
       n->transmissions = 0;
       n->collisions = CSMA_MIN_BE;
+#if CSMA_WITH_AQM
+      n->aqm_above_target = 0;
+#endif /* CSMA_WITH_AQM */
       /* Init packet list for this neighbor */
-      LIST_STRUCT_INIT(n, queued_packet_list);
+      LIST_TAILQ_STRUCT_INIT(n, queued_packet_list);
       /* Add neighbor to the list */
-      list_add(neighbor_list, n);
+      list_add(neighbor_bucket(addr), n);
+    }
+  }
+
+#if CSMA_WITH_AQM
+  if(n != NULL && list_length(n->queued_packet_list) >= CSMA_MAX_PACKET_PER_NEIGHBOR) {
+    /* Queue full: make room by dropping the oldest packet waiting behind
+     * the head, if it has waited for too long already */
+    struct rdc_buf_list *oldest = list_head(n->queued_packet_list);
+    if(oldest != NULL) {
+      oldest = list_item_next(oldest);
+    }
+    if(oldest != NULL && sojourn_time(oldest) >= CSMA_AQM_TARGET) {
+      PRINTF("csma: AQM drop from full queue\n");
+      drop_packet(n, oldest);
     }
   }
+#endif /* CSMA_WITH_AQM */
 
   if(n != NULL) {
     /* Add packet to the neighbor's queue */
@@ -419,6 +572,9 @@ send_packet(mac_callback_t sent, void *ptr)
             }
             metadata->sent = sent;
             metadata->cptr = ptr;
+#if CSMA_WITH_AQM
+            metadata->enqueue_time = clock_time();
+#endif /* CSMA_WITH_AQM */
 #if PACKETBUF_WITH_PACKET_TYPE
             if(packetbuf_attr(PACKETBUF_ATTR_PACKET_TYPE) ==
                PACKETBUF_ATTR_PACKET_TYPE_ACK) {
@@ -431,6 +587,11 @@ send_packet(mac_callback_t sent, void *ptr)
 
             PRINTF("csma: send_packet, queue length %d, free packets %d\n",
                    list_length(n->queued_packet_list), memb_numfree(&packet_memb));
+            TRACE(CSMA_QUEUE, list_length(n->queued_packet_list),
+                  TRACE_NODE(addr));
+            NET_STATS_ADD(stats, STATS_QUEUED);
+            LATENCY_TRACE_STAMP_ID(packetbuf_attr(PACKETBUF_ATTR_LATENCY_TRACE),
+                                   LATENCY_TRACE_MAC_QUEUED);
             /* If q is the first packet in the neighbor's queue, send asap */
             if(list_head(n->queued_packet_list) == q) {
               schedule_transmission(n);
@@ -445,7 +606,7 @@ send_packet(mac_callback_t sent, void *ptr)
       }
       /* The packet allocation failed. Remove and free neighbor entry if empty. */
       if(list_length(n->queued_packet_list) == 0) {
-        list_remove(neighbor_list, n);
+        list_remove(neighbor_bucket(addr), n);
         memb_free(&neighbor_memb, n);
       }
     } else {
@@ -455,6 +616,8 @@ send_packet(mac_callback_t sent, void *ptr)
   } else {
     PRINTF("csma: could not allocate neighbor, dropping packet\n");
   }
+  TRACE(CSMA_DROP, memb_numfree(&packet_memb), TRACE_NODE(addr));
+  NET_STATS_ADD(stats, STATS_DROP);
   mac_call_sent_callback(sent, ptr, MAC_TX_ERR, 1);
 }
 /*---------------------------------------------------------------------------*/
@@ -491,6 +654,7 @@ init(void)
   memb_init(&packet_memb);
   memb_init(&metadata_memb);
   memb_init(&neighbor_memb);
+  net_stats_register(&stats_group);
 }
 /*---------------------------------------------------------------------------*/
 const struct mac_driver csma_driver = {
@@ -43,42 +43,6 @@
 #define DEBUG DEBUG_NONE
 #include "net/net-debug.h"
 
-/* c.f. IEEE 802.15.4e Table 4b */
-enum ieee802154e_header_ie_id {
-  HEADER_IE_LE_CSL = 0x1a,
-  HEADER_IE_LE_RIT,
-  HEADER_IE_DSME_PAN_DESCRIPTOR,
-  HEADER_IE_RZ_TIME,
-  HEADER_IE_ACK_NACK_TIME_CORRECTION,
-  HEADER_IE_GACK,
-  HEADER_IE_LOW_LATENCY_NETWORK_INFO,
-  HEADER_IE_LIST_TERMINATION_1 = 0x7e,
-  HEADER_IE_LIST_TERMINATION_2 = 0x7f,
-};
-
-/* c.f. IEEE 802.15.4e Table 4c */
-enum ieee802154e_payload_ie_id {
-  PAYLOAD_IE_ESDU = 0,
-  PAYLOAD_IE_MLME,
-  PAYLOAD_IE_LIST_TERMINATION = 0xf,
-};
-
-/* c.f. IEEE 802.15.4e Table 4d */
-enum ieee802154e_mlme_short_subie_id {
-  MLME_SHORT_IE_TSCH_SYNCHRONIZATION = 0x1a,
-  MLME_SHORT_IE_TSCH_SLOFTRAME_AND_LINK,
-  MLME_SHORT_IE_TSCH_TIMESLOT,
-  MLME_SHORT_IE_TSCH_HOPPING_TIMING,
-  MLME_SHORT_IE_TSCH_EB_FILTER,
-  MLME_SHORT_IE_TSCH_MAC_METRICS_1,
-  MLME_SHORT_IE_TSCH_MAC_METRICS_2,
-};
-
-/* c.f. IEEE 802.15.4e Table 4e */
-enum ieee802154e_mlme_long_subie_id {
-  MLME_LONG_IE_TSCH_CHANNEL_HOPPING_SEQUENCE = 0x9,
-};
-
 #define WRITE16(buf, val) \
   do { ((uint8_t *)(buf))[0] = (val) & 0xff; \
        ((uint8_t *)(buf))[1] = ((val) >> 8) & 0xff; } while(0);
@@ -207,6 +171,27 @@ frame80215e_create_ie_mlme(uint8_t *buf, int len,
   }
 }
 
+/* Payload IE. IETF, with a 6top sub-IE. Used to carry 6P messages */
+int
+frame80215e_create_ie_ietf_sixtop(uint8_t *buf, int len,
+    struct ieee802154_ies *ies)
+{
+  int ie_len;
+  if(ies == NULL || ies->ie_sixtop == NULL) {
+    return -1;
+  }
+  /* One byte of sub-IE ID, followed by the 6P message */
+  ie_len = 1 + ies->ie_sixtop_len;
+  if(len >= 2 + ie_len) {
+    buf[2] = IETF_SUBIE_SIXTOP;
+    memcpy(buf + 3, ies->ie_sixtop, ies->ie_sixtop_len);
+    create_payload_ie_descriptor(buf, PAYLOAD_IE_IETF, ie_len);
+    return 2 + ie_len;
+  } else {
+    return -1;
+  }
+}
+
 /* MLME sub-IE. TSCH synchronization. Used in EBs: ASN and join priority */
 int
 frame80215e_create_ie_tsch_synchronization(uint8_t *buf, int len,
@@ -317,6 +302,34 @@ frame80215e_create_ie_tsch_channel_hopping_sequence(uint8_t *buf, int len,
   }
 }
 
+/* MLME sub-IE. Channel blacklist (not standard). Used in EBs: channels
+ * excluded from the hopping sequence */
+int
+frame80215e_create_ie_tsch_channel_blacklist(uint8_t *buf, int len,
+    struct ieee802154_ies *ies)
+{
+  int ie_len;
+  if(ies == NULL) {
+    return -1;
+  }
+  ie_len = ies->ie_channel_blacklist_pending ? 9 : 2;
+  if(len >= 2 + ie_len) {
+    WRITE16(buf + 2, ies->ie_channel_blacklist);
+    if(ies->ie_channel_blacklist_pending) {
+      WRITE16(buf + 4, ies->ie_next_channel_blacklist);
+      buf[6] = ies->ie_channel_blacklist_switch_asn.ls4b;
+      buf[7] = ies->ie_channel_blacklist_switch_asn.ls4b >> 8;
+      buf[8] = ies->ie_channel_blacklist_switch_asn.ls4b >> 16;
+      buf[9] = ies->ie_channel_blacklist_switch_asn.ls4b >> 24;
+      buf[10] = ies->ie_channel_blacklist_switch_asn.ms1b;
+    }
+    create_mlme_short_ie_descriptor(buf, MLME_SHORT_IE_TSCH_CHANNEL_BLACKLIST, ie_len);
+    return 2 + ie_len;
+  } else {
+    return -1;
+  }
+}
+
 /* Parse a header IE */
 static int
 frame802154e_parse_header_ie(const uint8_t *buf, int len,
@@ -397,6 +410,24 @@ frame802154e_parse_mlme_short_ie(const uint8_t *buf, int len,
         return len;
       }
       break;
+    case MLME_SHORT_IE_TSCH_CHANNEL_BLACKLIST:
+      if(len == 2 || len == 9) {
+        if(ies != NULL) {
+          ies->ie_channel_blacklist_present = 1;
+          READ16(buf, ies->ie_channel_blacklist);
+          ies->ie_channel_blacklist_pending = len == 9;
+          if(len == 9) {
+            READ16(buf + 2, ies->ie_next_channel_blacklist);
+            ies->ie_channel_blacklist_switch_asn.ls4b = (uint32_t)buf[4];
+            ies->ie_channel_blacklist_switch_asn.ls4b |= (uint32_t)buf[5] << 8;
+            ies->ie_channel_blacklist_switch_asn.ls4b |= (uint32_t)buf[6] << 16;
+            ies->ie_channel_blacklist_switch_asn.ls4b |= (uint32_t)buf[7] << 24;
+            ies->ie_channel_blacklist_switch_asn.ms1b = (uint8_t)buf[8];
+          }
+        }
+        return len;
+      }
+      break;
     case MLME_SHORT_IE_TSCH_TIMESLOT:
       if(len == 1 || len == 25) {
         if(ies != NULL) {
@@ -440,39 +471,55 @@ frame802154e_parse_mlme_long_ie(const uint8_t *buf, int len,
   return -1;
 }
 
-/* Parse all IEEE 802.15.4e Information Elements (IE) from a frame */
+/* States of the IE iterator */
+enum {
+  PARSING_HEADER_IE,
+  PARSING_PAYLOAD_IE,
+  PARSING_MLME_SUBIE,
+  PARSING_DONE,
+};
+
+/* Start iterating over the IEs of a frame */
+void
+frame802154e_ie_iterator_init(struct ieee802154_ie_iterator *it,
+    const uint8_t *buf, int buf_size)
+{
+  it->start = buf;
+  it->buf = buf;
+  it->buf_size = buf_size;
+  it->nested_mlme_len = 0;
+  /* Always look for a header IE first (at least "list termination 1") */
+  it->state = PARSING_HEADER_IE;
+  it->payload_ie_offset = 0;
+}
+
+/* Get the next IE, walking the frame in place */
 int
-frame802154e_parse_information_elements(const uint8_t *buf, uint8_t buf_size,
-    struct ieee802154_ies *ies)
+frame802154e_ie_next(struct ieee802154_ie_iterator *it,
+    struct ieee802154_ie *ie)
 {
-  const uint8_t *start = buf;
   uint16_t ie_desc;
   uint8_t type;
-  uint8_t id;
-  uint16_t len = 0;
-  int nested_mlme_len = 0;
-  enum {PARSING_HEADER_IE, PARSING_PAYLOAD_IE, PARSING_MLME_SUBIE} parsing_state;
-
-  if(ies == NULL) {
-    return -1;
-  }
+  uint16_t len;
 
-  /* Always look for a header IE first (at least "list termination 1") */
-  parsing_state = PARSING_HEADER_IE;
-  ies->ie_payload_ie_offset = 0;
-
-  /* Loop over all IEs */
-  while(buf_size > 0) {
-    if(buf_size < 2) { /* Not enough space for IE descriptor */
+  while(it->state != PARSING_DONE) {
+    if(it->buf_size == 0) {
+      if(it->state == PARSING_HEADER_IE) {
+        it->payload_ie_offset = it->buf - it->start; /* Save IE header len */
+      }
+      it->state = PARSING_DONE;
+      break;
+    }
+    if(it->buf_size < 2) { /* Not enough space for IE descriptor */
       return -1;
     }
-    READ16(buf, ie_desc);
-    buf_size -= 2;
-    buf += 2;
+    READ16(it->buf, ie_desc);
+    it->buf_size -= 2;
+    it->buf += 2;
     type = ie_desc & 0x8000 ? 1 : 0; /* b15 */
-    PRINTF("frame802154e: ie type %u, current state %u\n", type, parsing_state);
+    PRINTF("frame802154e: ie type %u, current state %u\n", type, it->state);
 
-    switch(parsing_state) {
+    switch(it->state) {
       case PARSING_HEADER_IE:
         if(type != 0) {
           PRINTF("frame802154e: wrong type %04x\n", ie_desc);
@@ -480,36 +527,21 @@ frame802154e_parse_information_elements(const uint8_t *buf, uint8_t buf_size,
         }
         /* Header IE: 2 bytes descriptor, c.f. fig 48n in IEEE 802.15.4e */
         len = ie_desc & 0x007f; /* b0-b6 */
-        id = (ie_desc & 0x7f80) >> 7; /* b7-b14 */
-        PRINTF("frame802154e: header ie len %u id %x\n", len, id);
-        switch(id) {
-          case HEADER_IE_LIST_TERMINATION_1:
-            if(len == 0) {
-              /* End of payload IE list, now expect payload IEs */
-              parsing_state = PARSING_PAYLOAD_IE;
-              ies->ie_payload_ie_offset = buf - start; /* Save IE header len */
-              PRINTF("frame802154e: list termination 1, look for payload IEs\n");
-            } else {
-              PRINTF("frame802154e: list termination 1, wrong len %u\n", len);
-              return -1;
-            }
-            break;
-          case HEADER_IE_LIST_TERMINATION_2:
-            /* End of IE parsing */
-            if(len == 0) {
-              ies->ie_payload_ie_offset = buf - start; /* Save IE header len */
-              PRINTF("frame802154e: list termination 2\n");
-              return buf + len - start;
-            } else {
-              PRINTF("frame802154e: list termination 2, wrong len %u\n", len);
-              return -1;
-            }
-          default:
-            if(len > buf_size || frame802154e_parse_header_ie(buf, len, id, ies) == -1) {
-              PRINTF("frame802154e: failed to parse\n");
-              return -1;
-            }
-            break;
+        ie->kind = FRAME802154E_IE_HEADER;
+        ie->id = (ie_desc & 0x7f80) >> 7; /* b7-b14 */
+        PRINTF("frame802154e: header ie len %u id %x\n", len, ie->id);
+        if(ie->id == HEADER_IE_LIST_TERMINATION_1
+           || ie->id == HEADER_IE_LIST_TERMINATION_2) {
+          if(len != 0) {
+            PRINTF("frame802154e: list termination, wrong len %u\n", len);
+            return -1;
+          }
+          it->payload_ie_offset = it->buf - it->start; /* Save IE header len */
+          /* After list termination 1, expect payload IEs. List
+           * termination 2 ends IE parsing */
+          it->state = ie->id == HEADER_IE_LIST_TERMINATION_1
+            ? PARSING_PAYLOAD_IE : PARSING_DONE;
+          continue;
         }
         break;
       case PARSING_PAYLOAD_IE:
@@ -519,22 +551,24 @@ frame802154e_parse_information_elements(const uint8_t *buf, uint8_t buf_size,
         }
         /* Payload IE: 2 bytes descriptor, c.f. fig 48o in IEEE 802.15.4e */
         len = ie_desc & 0x7ff; /* b0-b10 */
-        id = (ie_desc & 0x7800) >> 11; /* b11-b14 */
-        PRINTF("frame802154e: payload ie len %u id %x\n", len, id);
-        switch(id) {
-          case PAYLOAD_IE_MLME:
-            /* Now expect 'len' bytes of MLME sub-IEs */
-            parsing_state = PARSING_MLME_SUBIE;
-            nested_mlme_len = len;
-            len = 0; /* Reset len as we want to read subIEs and not jump over them */
-            PRINTF("frame802154e: entering MLME ie with len %u\n", nested_mlme_len);
-            break;
-          case PAYLOAD_IE_LIST_TERMINATION:
-            PRINTF("frame802154e: payload ie list termination %u\n", len);
-            return (len == 0) ? buf + len - start : -1;
-          default:
-            PRINTF("frame802154e: non-supported payload ie\n");
+        ie->kind = FRAME802154E_IE_PAYLOAD;
+        ie->id = (ie_desc & 0x7800) >> 11; /* b11-b14 */
+        PRINTF("frame802154e: payload ie len %u id %x\n", len, ie->id);
+        if(ie->id == PAYLOAD_IE_MLME) {
+          /* Now expect 'len' bytes of MLME sub-IEs, and read them rather
+           * than jumping over them */
+          it->state = PARSING_MLME_SUBIE;
+          it->nested_mlme_len = len;
+          PRINTF("frame802154e: entering MLME ie with len %u\n", len);
+          continue;
+        }
+        if(ie->id == PAYLOAD_IE_LIST_TERMINATION) {
+          PRINTF("frame802154e: payload ie list termination %u\n", len);
+          if(len != 0) {
             return -1;
+          }
+          it->state = PARSING_DONE;
+          continue;
         }
         break;
       case PARSING_MLME_SUBIE:
@@ -543,43 +577,113 @@ frame802154e_parse_information_elements(const uint8_t *buf, uint8_t buf_size,
         if(type == 0) {
           /* Short sub-IE, c.f. fig 48r in IEEE 802.15.4e */
           len = ie_desc & 0x00ff; /* b0-b7 */
-          id = (ie_desc & 0x7f00) >> 8; /* b8-b14 */
-          PRINTF("frame802154e: short mlme ie len %u id %x\n", len, id);
-          if(len > buf_size || frame802154e_parse_mlme_short_ie(buf, len, id, ies) == -1) {
-            PRINTF("frame802154e: failed to parse ie\n");
-            return -1;
-          }
+          ie->kind = FRAME802154E_IE_MLME_SHORT;
+          ie->id = (ie_desc & 0x7f00) >> 8; /* b8-b14 */
         } else {
           /* Long sub-IE, c.f. fig 48s in IEEE 802.15.4e */
           len = ie_desc & 0x7ff; /* b0-b10 */
-          id = (ie_desc & 0x7800) >> 11; /* b11-b14 */
-          PRINTF("frame802154e: long mlme ie len %u id %x\n", len, id);
-          if(len > buf_size || frame802154e_parse_mlme_long_ie(buf, len, id, ies) == -1) {
-            PRINTF("frame802154e: failed to parse ie\n");
-            return -1;
-          }
+          ie->kind = FRAME802154E_IE_MLME_LONG;
+          ie->id = (ie_desc & 0x7800) >> 11; /* b11-b14 */
         }
+        PRINTF("frame802154e: mlme ie type %u len %u id %x\n", type, len, ie->id);
         /* Update remaining nested MLME len */
-        nested_mlme_len -= 2 + len;
-        if(nested_mlme_len < 0) {
+        it->nested_mlme_len -= 2 + len;
+        if(it->nested_mlme_len < 0) {
           PRINTF("frame802154e: found more sub-IEs than initially advertised\n");
           /* We found more sub-IEs than initially advertised */
           return -1;
         }
-        if(nested_mlme_len == 0) {
+        if(it->nested_mlme_len == 0) {
           PRINTF("frame802154e: end of MLME IE parsing\n");
           /* End of IE parsing, look for another payload IE */
-          parsing_state = PARSING_PAYLOAD_IE;
+          it->state = PARSING_PAYLOAD_IE;
         }
         break;
     }
-    buf += len;
-    buf_size -= len;
+
+    if(len > it->buf_size) {
+      PRINTF("frame802154e: ie len %u exceeds frame\n", len);
+      return -1;
+    }
+    ie->len = len;
+    ie->content = it->buf;
+    it->buf += len;
+    it->buf_size -= len;
+    return 1;
+  }
+
+  return 0;
+}
+
+/* Skip to the next IE of a given kind and id */
+int
+frame802154e_ie_find(struct ieee802154_ie_iterator *it,
+    uint8_t kind, uint8_t id, struct ieee802154_ie *ie)
+{
+  int ret;
+  while((ret = frame802154e_ie_next(it, ie)) == 1) {
+    if(ie->kind == kind && ie->id == id) {
+      break;
+    }
   }
+  return ret;
+}
 
-  if(parsing_state == PARSING_HEADER_IE) {
-    ies->ie_payload_ie_offset = buf - start; /* Save IE header len */
+/* Number of bytes iterated over */
+int
+frame802154e_ie_iterator_len(const struct ieee802154_ie_iterator *it)
+{
+  return it->buf - it->start;
+}
+
+/* Decode a single IE */
+int
+frame802154e_ie_parse(const struct ieee802154_ie *ie,
+    struct ieee802154_ies *ies)
+{
+  switch(ie->kind) {
+    case FRAME802154E_IE_HEADER:
+      return frame802154e_parse_header_ie(ie->content, ie->len, ie->id, ies);
+    case FRAME802154E_IE_PAYLOAD:
+      if(ie->id == PAYLOAD_IE_IETF) {
+        /* We only support the 6top sub-IE, skip the others */
+        if(ies != NULL && ie->len >= 1 && ie->content[0] == IETF_SUBIE_SIXTOP) {
+          ies->ie_sixtop = ie->content + 1;
+          ies->ie_sixtop_len = ie->len - 1;
+        }
+        return ie->len;
+      }
+      PRINTF("frame802154e: non-supported payload ie\n");
+      return -1;
+    case FRAME802154E_IE_MLME_SHORT:
+      return frame802154e_parse_mlme_short_ie(ie->content, ie->len, ie->id, ies);
+    case FRAME802154E_IE_MLME_LONG:
+      return frame802154e_parse_mlme_long_ie(ie->content, ie->len, ie->id, ies);
+  }
+  return -1;
+}
+
+/* Parse all IEEE 802.15.4e Information Elements (IE) from a frame */
+int
+frame802154e_parse_information_elements(const uint8_t *buf, uint8_t buf_size,
+    struct ieee802154_ies *ies)
+{
+  struct ieee802154_ie_iterator it;
+  struct ieee802154_ie ie;
+  int ret;
+
+  if(ies == NULL) {
+    return -1;
+  }
+
+  frame802154e_ie_iterator_init(&it, buf, buf_size);
+  while((ret = frame802154e_ie_next(&it, &ie)) == 1) {
+    if(frame802154e_ie_parse(&ie, ies) == -1) {
+      PRINTF("frame802154e: failed to parse ie\n");
+      return -1;
+    }
   }
+  ies->ie_payload_ie_offset = it.payload_ie_offset;
 
-  return buf - start;
+  return ret == -1 ? -1 : frame802154e_ie_iterator_len(&it);
 }
@@ -46,6 +46,50 @@
 
 #define FRAME802154E_IE_MAX_LINKS       4
 
+/* c.f. IEEE 802.15.4e Table 4b */
+enum ieee802154e_header_ie_id {
+  HEADER_IE_LE_CSL = 0x1a,
+  HEADER_IE_LE_RIT,
+  HEADER_IE_DSME_PAN_DESCRIPTOR,
+  HEADER_IE_RZ_TIME,
+  HEADER_IE_ACK_NACK_TIME_CORRECTION,
+  HEADER_IE_GACK,
+  HEADER_IE_LOW_LATENCY_NETWORK_INFO,
+  HEADER_IE_LIST_TERMINATION_1 = 0x7e,
+  HEADER_IE_LIST_TERMINATION_2 = 0x7f,
+};
+
+/* c.f. IEEE 802.15.4e Table 4c */
+enum ieee802154e_payload_ie_id {
+  PAYLOAD_IE_ESDU = 0,
+  PAYLOAD_IE_MLME,
+  PAYLOAD_IE_IETF = 0x5,
+  PAYLOAD_IE_LIST_TERMINATION = 0xf,
+};
+
+/* c.f. RFC 8137 and RFC 8480 */
+enum ieee802154e_ietf_subie_id {
+  IETF_SUBIE_SIXTOP = 0xc9,
+};
+
+/* c.f. IEEE 802.15.4e Table 4d */
+enum ieee802154e_mlme_short_subie_id {
+  MLME_SHORT_IE_TSCH_SYNCHRONIZATION = 0x1a,
+  MLME_SHORT_IE_TSCH_SLOFTRAME_AND_LINK,
+  MLME_SHORT_IE_TSCH_TIMESLOT,
+  MLME_SHORT_IE_TSCH_HOPPING_TIMING,
+  MLME_SHORT_IE_TSCH_EB_FILTER,
+  MLME_SHORT_IE_TSCH_MAC_METRICS_1,
+  MLME_SHORT_IE_TSCH_MAC_METRICS_2,
+  /* Not standard, taken from the reserved range */
+  MLME_SHORT_IE_TSCH_CHANNEL_BLACKLIST = 0x70,
+};
+
+/* c.f. IEEE 802.15.4e Table 4e */
+enum ieee802154e_mlme_long_subie_id {
+  MLME_LONG_IE_TSCH_CHANNEL_HOPPING_SEQUENCE = 0x9,
+};
+
 /* Structures used for the Slotframe and Links information element */
 struct tsch_slotframe_and_links_link {
   uint16_t timeslot;
@@ -80,6 +124,48 @@ struct ieee802154_ies {
   /* We include and parse only the sequence len and list and omit unused fields */
   uint16_t ie_hopping_sequence_len;
   uint8_t ie_hopping_sequence_list[TSCH_HOPPING_SEQUENCE_MAX_LEN];
+  /* Payload Short MLME IE: channel blacklist (not standard). Blacklisted
+   * channels, as a bitmap, and when a change is pending, the next bitmap
+   * and the ASN from which it applies */
+  uint8_t ie_channel_blacklist_present;
+  uint8_t ie_channel_blacklist_pending;
+  uint16_t ie_channel_blacklist;
+  uint16_t ie_next_channel_blacklist;
+  struct asn_t ie_channel_blacklist_switch_asn;
+  /* Payload IETF IE: 6top sub-IE. Points to the 6P message, which is
+   * not copied (NULL if none) */
+  const uint8_t *ie_sixtop;
+  uint16_t ie_sixtop_len;
+};
+
+/* Kinds of IEs returned by the IE iterator */
+enum ieee802154e_ie_kind {
+  FRAME802154E_IE_HEADER,
+  FRAME802154E_IE_PAYLOAD,
+  FRAME802154E_IE_MLME_SHORT,
+  FRAME802154E_IE_MLME_LONG,
+};
+
+/* An IE as found in a frame. The content is not copied, it points into
+ * the buffer being iterated over */
+struct ieee802154_ie {
+  uint8_t kind;
+  uint8_t id;
+  uint16_t len;
+  const uint8_t *content;
+};
+
+/* State of a walk over the IEs of a frame. List terminations and the
+ * MLME payload IE are consumed by the iterator, which returns the
+ * MLME sub-IEs they contain instead */
+struct ieee802154_ie_iterator {
+  const uint8_t *start;
+  const uint8_t *buf;
+  int buf_size;
+  int nested_mlme_len;
+  uint8_t state;
+  /* Length of the header IEs, valid once the iterator went past them */
+  uint8_t payload_ie_offset;
 };
 
 /** Insert various Information Elements **/
@@ -112,6 +198,32 @@ int frame80215e_create_ie_tsch_timeslot(uint8_t *buf, int len,
 /* MLME sub-IE. TSCH channel hopping sequence. Used in EBs: hopping sequence */
 int frame80215e_create_ie_tsch_channel_hopping_sequence(uint8_t *buf, int len,
     struct ieee802154_ies *ies);
+/* MLME sub-IE. Channel blacklist (not standard). Used in EBs: channels
+ * excluded from the hopping sequence */
+int frame80215e_create_ie_tsch_channel_blacklist(uint8_t *buf, int len,
+    struct ieee802154_ies *ies);
+
+/* Payload IE. IETF, with a 6top sub-IE. Used to carry 6P messages */
+int frame80215e_create_ie_ietf_sixtop(uint8_t *buf, int len,
+    struct ieee802154_ies *ies);
+
+/* Start a walk over the IEs found in buf */
+void frame802154e_ie_iterator_init(struct ieee802154_ie_iterator *it,
+    const uint8_t *buf, int buf_size);
+/* Get the next IE, without decoding it. Returns 1 if an IE was found,
+ * 0 at the end of the IEs and -1 if the IEs are malformed */
+int frame802154e_ie_next(struct ieee802154_ie_iterator *it,
+    struct ieee802154_ie *ie);
+/* Skip to the next IE of the given kind and id. Same return values as
+ * frame802154e_ie_next */
+int frame802154e_ie_find(struct ieee802154_ie_iterator *it,
+    uint8_t kind, uint8_t id, struct ieee802154_ie *ie);
+/* Number of bytes the iterator went through so far */
+int frame802154e_ie_iterator_len(const struct ieee802154_ie_iterator *it);
+/* Decode a single IE into the matching fields of ies, leaving the
+ * others untouched. Returns -1 if the IE is not supported or malformed */
+int frame802154e_ie_parse(const struct ieee802154_ie *ie,
+    struct ieee802154_ies *ies);
 
 /* Parse all Information Elements of a frame */
 int frame802154e_parse_information_elements(const uint8_t *buf, uint8_t buf_size,
@@ -62,12 +62,122 @@ static uint8_t mac_dsn;
 
 static uint8_t initialized = 0;
 
+#if FRAMER_802154_HDR_TEMPLATES
+/* Longest header without auxiliary security header: FCF, sequence number,
+ * two PAN IDs and two long addresses */
+#define HDR_TEMPLATE_MAX_LEN 23
+
+struct hdr_template {
+  linkaddr_t dest;
+  linkaddr_t src;
+  uint16_t pan_id;
+  /* First FCF byte: frame type, pending and ack request bits */
+  uint8_t fcf0;
+  uint8_t len;
+  uint8_t has_seq;
+  uint8_t hdr[HDR_TEMPLATE_MAX_LEN];
+};
+
+static struct hdr_template hdr_templates[FRAMER_802154_HDR_TEMPLATES];
+/* Next slot to overwrite, round-robin */
+static uint8_t next_template;
+#endif /* FRAMER_802154_HDR_TEMPLATES */
+
+/*---------------------------------------------------------------------------*/
+/* Returns the sequence number of the outgoing frame, consuming a new one
+ * unless the frame has one already (e.g. a retransmission) */
+static uint8_t
+get_seqno(void)
+{
+  uint8_t seq;
+
+  if(packetbuf_attr(PACKETBUF_ATTR_MAC_SEQNO)) {
+    return packetbuf_attr(PACKETBUF_ATTR_MAC_SEQNO);
+  }
+  /* Ensure that the sequence number 0 is not used as it would bypass the above check. */
+  if(mac_dsn == 0) {
+    mac_dsn++;
+  }
+  seq = mac_dsn++;
+  packetbuf_set_attr(PACKETBUF_ATTR_MAC_SEQNO, seq);
+  return seq;
+}
+/*---------------------------------------------------------------------------*/
+#if FRAMER_802154_HDR_TEMPLATES
+static uint8_t
+template_fcf0(const frame802154_t *params)
+{
+  return (params->fcf.frame_type & 7)
+      | ((params->fcf.frame_pending & 1) << 4)
+      | ((params->fcf.ack_required & 1) << 5);
+}
+/*---------------------------------------------------------------------------*/
+static struct hdr_template *
+template_lookup(uint8_t fcf0)
+{
+  struct hdr_template *t;
+
+  for(t = hdr_templates; t < hdr_templates + FRAMER_802154_HDR_TEMPLATES; t++) {
+    if(t->len != 0
+       && t->fcf0 == fcf0
+       && t->pan_id == frame802154_get_pan_id()
+       && linkaddr_cmp(&t->dest, packetbuf_addr(PACKETBUF_ADDR_RECEIVER))
+       && linkaddr_cmp(&t->src, &linkaddr_node_addr)) {
+      return t;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+template_store(const frame802154_t *params, const uint8_t *hdr, int hdr_len)
+{
+  struct hdr_template *t;
+
+  if(hdr_len > HDR_TEMPLATE_MAX_LEN) {
+    return;
+  }
+  t = &hdr_templates[next_template];
+  next_template = (next_template + 1) % FRAMER_802154_HDR_TEMPLATES;
+
+  linkaddr_copy(&t->dest, packetbuf_addr(PACKETBUF_ADDR_RECEIVER));
+  linkaddr_copy(&t->src, &linkaddr_node_addr);
+  t->pan_id = frame802154_get_pan_id();
+  t->fcf0 = template_fcf0(params);
+  t->has_seq = !params->fcf.sequence_number_suppression;
+  t->len = hdr_len;
+  memcpy(t->hdr, hdr, hdr_len);
+}
+/*---------------------------------------------------------------------------*/
+static int
+create_from_template(const struct hdr_template *t, int do_create)
+{
+  uint8_t *hdr;
+
+  if(!do_create) {
+    return t->len;
+  }
+  if(!packetbuf_hdralloc(t->len)) {
+    PRINTF("15.4-OUT: too large header: %u\n", t->len);
+    return FRAMER_FAILED;
+  }
+  hdr = packetbuf_hdrptr();
+  memcpy(hdr, t->hdr, t->len);
+  if(t->has_seq) {
+    hdr[2] = get_seqno();
+  }
+  return t->len;
+}
+#endif /* FRAMER_802154_HDR_TEMPLATES */
 /*---------------------------------------------------------------------------*/
 static int
 create_frame(int type, int do_create)
 {
   frame802154_t params;
   int hdr_len;
+#if FRAMER_802154_HDR_TEMPLATES
+  struct hdr_template *t;
+#endif /* FRAMER_802154_HDR_TEMPLATES */
 
   if(frame802154_get_pan_id() == 0xffff) {
     return -1;
@@ -120,22 +230,21 @@ create_frame(int type, int do_create)
 #endif /* LLSEC802154_USES_EXPLICIT_KEYS */
 #endif /* LLSEC802154_USES_AUX_HEADER */
 
-  /* Increment and set the data sequence number. */
-  if(!do_create) {
-    /* Only length calculation - no sequence number is needed and
-       should not be consumed. */
-
-  } else if(packetbuf_attr(PACKETBUF_ATTR_MAC_SEQNO)) {
-    params.seq = packetbuf_attr(PACKETBUF_ATTR_MAC_SEQNO);
-
-  } else {
-    /* Ensure that the sequence number 0 is not used as it would bypass the above check. */
-    if(mac_dsn == 0) {
-      mac_dsn++;
+#if FRAMER_802154_HDR_TEMPLATES
+  if(!packetbuf_holds_broadcast() && !params.fcf.security_enabled) {
+    t = template_lookup(template_fcf0(&params));
+    if(t != NULL) {
+      return create_from_template(t, do_create);
     }
-    params.seq = mac_dsn++;
-    packetbuf_set_attr(PACKETBUF_ATTR_MAC_SEQNO, params.seq);
   }
+#endif /* FRAMER_802154_HDR_TEMPLATES */
+
+  /* Increment and set the data sequence number. */
+  if(do_create) {
+    params.seq = get_seqno();
+  }
+  /* Else only length calculation - no sequence number is needed and
+     should not be consumed. */
 
   /* Complete the addressing fields. */
   /**
@@ -183,6 +292,11 @@ create_frame(int type, int do_create)
     return hdr_len;
   } else if(packetbuf_hdralloc(hdr_len)) {
     frame802154_create(&params, packetbuf_hdrptr());
+#if FRAMER_802154_HDR_TEMPLATES
+    if(!packetbuf_holds_broadcast() && !params.fcf.security_enabled) {
+      template_store(&params, packetbuf_hdrptr(), hdr_len);
+    }
+#endif /* FRAMER_802154_HDR_TEMPLATES */
 
     PRINTF("15.4-OUT: %2X", params.fcf.frame_type);
     PRINTADDR(params.dest_addr);
@@ -207,13 +321,95 @@ create(void)
   return create_frame(FRAME802154_DATAFRAME, 1);
 }
 /*---------------------------------------------------------------------------*/
+#if FRAMER_802154_WITH_FAST_PARSE
+/* Reads an address of the given mode, sent in reverse byte order */
+static uint8_t *
+parse_addr(uint8_t *p, uint8_t mode, uint8_t *addr)
+{
+  uint8_t len;
+  uint8_t c;
+
+  len = mode == FRAME802154_SHORTADDRMODE ? 2 : 8;
+  if(len < LINKADDR_SIZE) {
+    memset(addr, 0, LINKADDR_SIZE);
+  }
+  for(c = 0; c < len; c++) {
+    addr[c] = p[len - 1 - c];
+  }
+  return p + len;
+}
+/*---------------------------------------------------------------------------*/
+/* Parses the common data frame shape, as frame802154_parse() would.
+ * Returns 0 for any other frame */
+static int
+parse_fast(uint8_t *data, int len, frame802154_t *pf)
+{
+  uint8_t *p;
+  int hdr_len;
+
+  if(len < 2
+     /* Data frame without security */
+     || (data[0] & 0x0f) != FRAME802154_DATAFRAME
+     /* No IE, frame version 2003 or 2006 */
+     || (data[1] & 0x22) != 0
+     /* Short or long addresses on both sides */
+     || (data[1] & 0x08) == 0 || (data[1] & 0x80) == 0) {
+    return 0;
+  }
+
+  pf->fcf.frame_type = FRAME802154_DATAFRAME;
+  pf->fcf.security_enabled = 0;
+  pf->fcf.frame_pending = (data[0] >> 4) & 1;
+  pf->fcf.ack_required = (data[0] >> 5) & 1;
+  pf->fcf.panid_compression = (data[0] >> 6) & 1;
+  pf->fcf.sequence_number_suppression = data[1] & 1;
+  pf->fcf.ie_list_present = 0;
+  pf->fcf.dest_addr_mode = (data[1] >> 2) & 3;
+  pf->fcf.frame_version = (data[1] >> 4) & 3;
+  pf->fcf.src_addr_mode = (data[1] >> 6) & 3;
+
+  hdr_len = 2 + !pf->fcf.sequence_number_suppression + 2
+      + (pf->fcf.dest_addr_mode == FRAME802154_SHORTADDRMODE ? 2 : 8)
+      + (pf->fcf.panid_compression ? 0 : 2)
+      + (pf->fcf.src_addr_mode == FRAME802154_SHORTADDRMODE ? 2 : 8);
+  if(hdr_len > len) {
+    return 0;
+  }
+
+  p = data + 2;
+  if(!pf->fcf.sequence_number_suppression) {
+    pf->seq = *p++;
+  }
+  pf->dest_pid = p[0] + (p[1] << 8);
+  p = parse_addr(p + 2, pf->fcf.dest_addr_mode, pf->dest_addr);
+  if(pf->fcf.panid_compression) {
+    pf->src_pid = pf->dest_pid;
+  } else {
+    pf->src_pid = p[0] + (p[1] << 8);
+    p += 2;
+  }
+  p = parse_addr(p, pf->fcf.src_addr_mode, pf->src_addr);
+
+  pf->payload = p;
+  pf->payload_len = len - hdr_len;
+  return hdr_len;
+}
+#endif /* FRAMER_802154_WITH_FAST_PARSE */
+/*---------------------------------------------------------------------------*/
 static int
 parse(void)
 {
   frame802154_t frame;
   int hdr_len;
 
+#if FRAMER_802154_WITH_FAST_PARSE
+  hdr_len = parse_fast(packetbuf_dataptr(), packetbuf_datalen(), &frame);
+  if(hdr_len == 0) {
+    hdr_len = frame802154_parse(packetbuf_dataptr(), packetbuf_datalen(), &frame);
+  }
+#else /* FRAMER_802154_WITH_FAST_PARSE */
   hdr_len = frame802154_parse(packetbuf_dataptr(), packetbuf_datalen(), &frame);
+#endif /* FRAMER_802154_WITH_FAST_PARSE */
 
   if(hdr_len && packetbuf_hdrreduce(hdr_len)) {
     packetbuf_set_attr(PACKETBUF_ATTR_FRAME_TYPE, frame.fcf.frame_type);
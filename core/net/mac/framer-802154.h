@@ -41,6 +41,24 @@
 
 #include "net/mac/framer.h"
 
+/* Number of cached unicast frame headers. An outgoing unicast data frame
+ * to a recently used destination gets its header copied from the cache,
+ * only the sequence number being patched, instead of built field by
+ * field. Frames with an auxiliary security header are always built */
+#ifdef FRAMER_802154_CONF_HDR_TEMPLATES
+#define FRAMER_802154_HDR_TEMPLATES FRAMER_802154_CONF_HDR_TEMPLATES
+#else /* FRAMER_802154_CONF_HDR_TEMPLATES */
+#define FRAMER_802154_HDR_TEMPLATES 0
+#endif /* FRAMER_802154_CONF_HDR_TEMPLATES */
+
+/* Parse plain data frames (no security, no IE, pre-2012 frame version,
+ * addresses on both sides) without going through frame802154_parse() */
+#ifdef FRAMER_802154_CONF_WITH_FAST_PARSE
+#define FRAMER_802154_WITH_FAST_PARSE FRAMER_802154_CONF_WITH_FAST_PARSE
+#else /* FRAMER_802154_CONF_WITH_FAST_PARSE */
+#define FRAMER_802154_WITH_FAST_PARSE 1
+#endif /* FRAMER_802154_CONF_WITH_FAST_PARSE */
+
 extern const struct framer framer_802154;
 
 #endif /* FRAMER_802154_H_ */
@@ -107,6 +107,19 @@
 #include "net/mac/frame802154.h"
 #endif /* NULLRDC_SEND_802154_ACK */
 
+/* Attribute the radio time of transmissions to the packets sent */
+#ifdef NULLRDC_CONF_COMPOWER
+#define NULLRDC_COMPOWER NULLRDC_CONF_COMPOWER
+#else /* NULLRDC_CONF_COMPOWER */
+#define NULLRDC_COMPOWER 0
+#endif /* NULLRDC_CONF_COMPOWER */
+
+#if NULLRDC_COMPOWER
+#include "sys/compower.h"
+
+static struct compower_activity current_packet;
+#endif /* NULLRDC_COMPOWER */
+
 #define ACK_LEN 3
 
 /*---------------------------------------------------------------------------*/
@@ -117,6 +130,10 @@ send_one_packet(mac_callback_t sent, void *ptr)
   int last_sent_ok = 0;
 
   packetbuf_set_addr(PACKETBUF_ADDR_SENDER, &linkaddr_node_addr);
+#if NULLRDC_COMPOWER
+  /* Everything until now was spent idle */
+  compower_accumulate(&compower_idle_activity);
+#endif /* NULLRDC_COMPOWER */
 #if NULLRDC_802154_AUTOACK || NULLRDC_802154_AUTOACK_HW
   packetbuf_set_attr(PACKETBUF_ATTR_MAC_ACK, 1);
 #endif /* NULLRDC_802154_AUTOACK || NULLRDC_802154_AUTOACK_HW */
@@ -230,6 +247,14 @@ send_one_packet(mac_callback_t sent, void *ptr)
   if(ret == MAC_TX_OK) {
     last_sent_ok = 1;
   }
+#if NULLRDC_COMPOWER
+  /* The radio listens anyway, only the transmission is the packet's */
+  compower_accumulate(&current_packet);
+  compower_idle_activity.listen += current_packet.listen;
+  current_packet.listen = 0;
+  compower_attrconv(&current_packet);
+  compower_clear(&current_packet);
+#endif /* NULLRDC_COMPOWER */
   mac_call_sent_callback(sent, ptr, ret, 1);
   return last_sent_ok;
 }
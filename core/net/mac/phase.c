@@ -50,10 +50,33 @@
 #define PHASE_DRIFT_CORRECT 0
 #endif
 
+/* The drift of a neighbor is measured between two phases at least
+ * PHASE_DRIFT_MIN_INTERVAL apart, for precision, and at most
+ * PHASE_DRIFT_MAX_INTERVAL apart, so that the phase did not drift by
+ * more than half a cycle in between */
+#ifdef PHASE_CONF_DRIFT_MIN_INTERVAL
+#define PHASE_DRIFT_MIN_INTERVAL PHASE_CONF_DRIFT_MIN_INTERVAL
+#else
+#define PHASE_DRIFT_MIN_INTERVAL (10 * CLOCK_SECOND)
+#endif
+
+#ifdef PHASE_CONF_DRIFT_MAX_INTERVAL
+#define PHASE_DRIFT_MAX_INTERVAL PHASE_CONF_DRIFT_MAX_INTERVAL
+#else
+#define PHASE_DRIFT_MAX_INTERVAL (300 * CLOCK_SECOND)
+#endif
+
+/* Drifts are kept in rtimer ticks per PHASE_DRIFT_SCALE cycles */
+#define PHASE_DRIFT_SCALE 256
+
 struct phase {
   rtimer_clock_t time;
 #if PHASE_DRIFT_CORRECT
-  rtimer_clock_t drift;
+  /* clock_time() at time */
+  clock_time_t clock;
+  /* Phase drift, in rtimer ticks per PHASE_DRIFT_SCALE cycles */
+  int32_t drift;
+  uint8_t has_drift;
 #endif
   uint8_t noacks;
   struct timer noacks_timer;
@@ -86,6 +109,57 @@ NBR_TABLE(struct phase, nbr_phase);
 #define PRINTF(...)
 #define PRINTDEBUG(...)
 #endif
+
+#if PHASE_DRIFT_CORRECT
+/* Cycle time of the duty cycling protocol, as given to phase_wait() */
+static rtimer_clock_t phase_cycle_time;
+/*---------------------------------------------------------------------------*/
+/* Number of cycles in a clock_time() interval (rounded), 0 if too long */
+static uint32_t
+cycles_in(clock_time_t interval)
+{
+  uint32_t ticks;
+  if(interval > PHASE_DRIFT_MAX_INTERVAL * 8) {
+    return 0;
+  }
+  ticks = (uint32_t)interval / CLOCK_SECOND * RTIMER_ARCH_SECOND
+    + (uint32_t)interval % CLOCK_SECOND * RTIMER_ARCH_SECOND / CLOCK_SECOND;
+  return (ticks + phase_cycle_time / 2) / phase_cycle_time;
+}
+/*---------------------------------------------------------------------------*/
+/* Measure the drift of a neighbor from a new phase */
+static void
+update_drift(struct phase *e, rtimer_clock_t time)
+{
+  clock_time_t interval = clock_time() - e->clock;
+  uint32_t cycles;
+  int32_t error;
+
+  if(phase_cycle_time == 0
+     || interval < PHASE_DRIFT_MIN_INTERVAL || interval > PHASE_DRIFT_MAX_INTERVAL) {
+    return;
+  }
+  cycles = cycles_in(interval);
+  if(cycles == 0) {
+    return;
+  }
+  /* By how much did the phase move over that many cycles? */
+  error = RTIMER_CLOCK_DIFF(time, (rtimer_clock_t)(e->time + cycles * phase_cycle_time));
+  if(error >= (int32_t)(phase_cycle_time / 2) || -error >= (int32_t)(phase_cycle_time / 2)) {
+    /* We may have miscounted the cycles */
+    return;
+  }
+  error = error * PHASE_DRIFT_SCALE / (int32_t)cycles;
+  if(e->has_drift) {
+    /* Smooth out measurement jitter */
+    e->drift = (3 * e->drift + error) / 4;
+  } else {
+    e->drift = error;
+    e->has_drift = 1;
+  }
+  PRINTF("phase drift %ld ticks per %u cycles\n", (long)e->drift, PHASE_DRIFT_SCALE);
+}
+#endif /* PHASE_DRIFT_CORRECT */
 /*---------------------------------------------------------------------------*/
 void
 phase_update(const linkaddr_t *neighbor, rtimer_clock_t time,
@@ -98,7 +172,8 @@ phase_update(const linkaddr_t *neighbor, rtimer_clock_t time,
   if(e != NULL) {
     if(mac_status == MAC_TX_OK) {
 #if PHASE_DRIFT_CORRECT
-      e->drift = time-e->time;
+      update_drift(e, time);
+      e->clock = clock_time();
 #endif
       e->time = time;
     }
@@ -126,9 +201,11 @@ phase_update(const linkaddr_t *neighbor, rtimer_clock_t time,
       if(e) {
         e->time = time;
 #if PHASE_DRIFT_CORRECT
-      e->drift = 0;
+        e->clock = clock_time();
+        e->drift = 0;
+        e->has_drift = 0;
 #endif
-      e->noacks = 0;
+        e->noacks = 0;
       }
     }
   }
@@ -186,13 +263,10 @@ phase_wait(const linkaddr_t *neighbor, rtimer_clock_t cycle_time,
     sync = (e == NULL) ? now : e->time;
 
 #if PHASE_DRIFT_CORRECT
-    {
-      int32_t s;
-      if(e->drift > cycle_time) {
-        s = e->drift % cycle_time / (e->drift / cycle_time);  /* drift per cycle */
-        s = s * (now - sync) / cycle_time;                    /* estimated drift to now */
-        sync += s;                                            /* add it in */
-      }
+    phase_cycle_time = cycle_time;
+    if(e->has_drift) {
+      /* Move the phase by the drift since it was last seen */
+      sync += e->drift * (int32_t)cycles_in(clock_time() - e->clock) / PHASE_DRIFT_SCALE;
     }
 #endif
 
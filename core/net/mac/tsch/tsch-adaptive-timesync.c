@@ -44,11 +44,18 @@
 
 #if TSCH_ADAPTIVE_TIMESYNC
 
-/* Estimated drift of the time-source neighbor. Can be negative.
+/* Estimated drift of our clock relative to the network. Can be negative.
  * Units used: ppm multiplied by 256. */
 static int32_t drift_ppm;
+/* Spread of the recent drift samples around drift_ppm, same units */
+static int32_t drift_deviation_ppm;
 /* Ticks compensated locally since the last timesync time */
 static int32_t compensated_ticks;
+/* Ticks compensated locally since the last resynchronization with the
+ * time source, used to learn from other neighbors */
+static int32_t compensated_ticks_since_sync;
+/* Was a sample taken from another neighbor since the last resynchronization? */
+static uint8_t observed_since_sync;
 /* Number of already recorded timesync history entries */
 static uint8_t timesync_entry_count;
 /* Since last learning of the  drift; may be more than time since last timesync */
@@ -57,64 +64,104 @@ static uint32_t asn_since_last_learning;
 /* Units in which drift is stored: ppm * 256 */
 #define TSCH_DRIFT_UNIT (1000L * 1000 * 256)
 
+/* Min time over which a drift sample is taken, as smaller time deltas
+ * mean proportionally larger measurement errors */
+#define TSCH_TIMESYNC_MIN_LEARNING_ASN (4 * TSCH_SLOTS_PER_SECOND)
+
+/*---------------------------------------------------------------------------*/
+/* Weight of a drift sample, from the RSSI of the frame it was taken from */
+static uint8_t
+link_weight(int16_t rssi)
+{
+  int16_t w = rssi - TSCH_ADAPTIVE_TIMESYNC_RSSI_FLOOR;
+  if(w < 1) {
+    return 1;
+  }
+  return w > 64 ? 64 : w;
+}
 /*---------------------------------------------------------------------------*/
-/* Add a value to a moving average estimator */
+/* Add a value to a weighted moving average estimator, update the spread
+ * of the samples as a side effect */
 static int32_t
-timesync_entry_add(int32_t val, uint32_t time_delta)
+timesync_entry_add(int32_t val, uint8_t weight)
 {
 #define NUM_TIMESYNC_ENTRIES 8
   static int32_t buffer[NUM_TIMESYNC_ENTRIES];
+  static uint8_t weights[NUM_TIMESYNC_ENTRIES];
   static uint8_t pos;
+  int64_t sum = 0;
+  int32_t sum_weights = 0;
+  int64_t deviation = 0;
   int i;
   if(timesync_entry_count == 0) {
     pos = 0;
   }
   buffer[pos] = val;
+  weights[pos] = weight;
   if(timesync_entry_count < NUM_TIMESYNC_ENTRIES) {
     timesync_entry_count++;
   }
   pos = (pos + 1) % NUM_TIMESYNC_ENTRIES;
 
-  val = 0;
   for(i = 0; i < timesync_entry_count; ++i) {
-    val += buffer[i];
+    sum += (int64_t)buffer[i] * weights[i];
+    sum_weights += weights[i];
   }
-  return val / timesync_entry_count;
+  val = (int32_t)(sum / sum_weights);
+
+  for(i = 0; i < timesync_entry_count; ++i) {
+    deviation += (int64_t)ABS(buffer[i] - val) * weights[i];
+  }
+  drift_deviation_ppm = (int32_t)(deviation / sum_weights);
+
+  return val;
 }
 /*---------------------------------------------------------------------------*/
-/* Learn the neighbor drift rate at ppm */
+/* Learn the drift rate at ppm, from the ticks we had to correct over a
+ * given time */
 static void
-timesync_learn_drift_ticks(uint32_t time_delta_asn, int32_t drift_ticks)
+timesync_learn_drift_ticks(uint32_t time_delta_asn, int32_t real_drift_ticks,
+                           uint8_t weight)
 {
   /* should fit in a 32-bit integer */
   int32_t time_delta_ticks = time_delta_asn * tsch_timing[tsch_ts_timeslot_length];
-  int32_t real_drift_ticks = drift_ticks + compensated_ticks;
   int32_t last_drift_ppm = (int32_t)((int64_t)real_drift_ticks * TSCH_DRIFT_UNIT / time_delta_ticks);
 
-  drift_ppm = timesync_entry_add(last_drift_ppm, time_delta_ticks);
+  drift_ppm = timesync_entry_add(last_drift_ppm, weight);
 
   TSCH_LOG_ADD(tsch_log_message,
       snprintf(log->message, sizeof(log->message),
-          "drift %ld", drift_ppm / 256));
+          "drift %ld dev %ld", drift_ppm / 256, drift_deviation_ppm / 256));
 }
 /*---------------------------------------------------------------------------*/
-/* Either reset or update the neighbor's drift */
+/* Either reset or update the drift */
 void
-tsch_timesync_update(struct tsch_neighbor *n, uint16_t time_delta_asn, int32_t drift_correction)
+tsch_timesync_update(struct tsch_neighbor *n, uint16_t time_delta_asn,
+                     int32_t drift_correction, int16_t rssi)
 {
+  compensated_ticks_since_sync = 0;
+  observed_since_sync = 0;
   /* Account the drift if either this is a new timesource,
    * or the timedelta is not too small, as smaller timedelta
    * means proportionally larger measurement error. */
   if(last_timesource_neighbor != n) {
     last_timesource_neighbor = n;
+#if !TSCH_ADAPTIVE_TIMESYNC_KEEP_DRIFT
     drift_ppm = 0;
     timesync_entry_count = 0;
+#endif /* TSCH_ADAPTIVE_TIMESYNC_KEEP_DRIFT */
+    /* Otherwise, the new time source being synchronized to the same
+     * network as the former one, our drift relative to it is the one
+     * learned so far. Only restart the current measurement */
     compensated_ticks = 0;
     asn_since_last_learning = 0;
   } else {
     asn_since_last_learning += time_delta_asn;
-    if(asn_since_last_learning >= 4 * TSCH_SLOTS_PER_SECOND) {
-      timesync_learn_drift_ticks(asn_since_last_learning, drift_correction);
+    if(asn_since_last_learning >= TSCH_TIMESYNC_MIN_LEARNING_ASN) {
+      /* The time source is the reference: give it a higher weight than
+       * the other neighbors */
+      timesync_learn_drift_ticks(asn_since_last_learning,
+          drift_correction + compensated_ticks, 2 * link_weight(rssi));
       compensated_ticks = 0;
       asn_since_last_learning = 0;
     } else {
@@ -124,6 +171,69 @@ tsch_timesync_update(struct tsch_neighbor *n, uint16_t time_delta_asn, int32_t d
   }
 }
 /*---------------------------------------------------------------------------*/
+/* Learn from a frame received from a neighbor other than the time source */
+void
+tsch_timesync_observe(struct tsch_neighbor *n, uint16_t time_delta_asn,
+                      int32_t drift_correction, int16_t rssi)
+{
+#if TSCH_ADAPTIVE_TIMESYNC_MULTI_SOURCE
+  int32_t real_drift_ticks;
+
+  /* Only once we have a reference to compare samples against, and over a
+   * long enough time since we last synchronized to the time source */
+  if(n == NULL || n == last_timesource_neighbor || last_timesource_neighbor == NULL
+     || timesync_entry_count == 0 || observed_since_sync
+     || time_delta_asn < TSCH_TIMESYNC_MIN_LEARNING_ASN) {
+    return;
+  }
+
+  /* The neighbor is synchronized to the network much like we are. The
+   * offset we observe is what we would have corrected, had it been our
+   * time source, since our last resynchronization */
+  real_drift_ticks = drift_correction + compensated_ticks_since_sync;
+  /* Discard the samples of neighbors that are likely out of sync, or
+   * inaccurate beyond what averaging can fix */
+  if(ABS((int32_t)((int64_t)real_drift_ticks * TSCH_DRIFT_UNIT
+                   / ((int32_t)time_delta_asn * tsch_timing[tsch_ts_timeslot_length])) - drift_ppm)
+     > 256L * TSCH_ADAPTIVE_TIMESYNC_MAX_SAMPLE_DEVIATION_PPM) {
+    return;
+  }
+  /* One sample per resynchronization, as they all cover the same time
+   * and a chatty neighbor would otherwise flood the history */
+  observed_since_sync = 1;
+  timesync_learn_drift_ticks(time_delta_asn, real_drift_ticks, link_weight(rssi));
+#endif /* TSCH_ADAPTIVE_TIMESYNC_MULTI_SOURCE */
+}
+/*---------------------------------------------------------------------------*/
+/* Estimated drift relative to the network, in ppm * 256 */
+int32_t
+tsch_timesync_get_drift(void)
+{
+  return drift_ppm;
+}
+/*---------------------------------------------------------------------------*/
+/* Rx guard time, given the time since the last resynchronization */
+rtimer_clock_t
+tsch_timesync_adaptive_rx_wait(uint32_t time_since_sync_asn)
+{
+  rtimer_clock_t max_wait = tsch_timing[tsch_ts_rx_wait];
+#if TSCH_ADAPTIVE_TIMESYNC_DYNAMIC_RX_WAIT
+  if(timesync_entry_count >= NUM_TIMESYNC_ENTRIES / 2) {
+    /* Both the sender and us may have drifted away by the residual error
+     * of the compensation, on either side of the expected Rx time */
+    int32_t uncertainty_ppm = drift_deviation_ppm + 256L * TSCH_ADAPTIVE_TIMESYNC_RESIDUAL_PPM;
+    int64_t drift_ticks = (int64_t)time_since_sync_asn * tsch_timing[tsch_ts_timeslot_length]
+      * uncertainty_ppm / TSCH_DRIFT_UNIT;
+    int64_t wait = 2 * (2 * drift_ticks + TSCH_TIMESYNC_MEASUREMENT_ERROR)
+      + US_TO_RTIMERTICKS(TSCH_ADAPTIVE_TIMESYNC_MIN_RX_WAIT);
+    if(wait < max_wait) {
+      return (rtimer_clock_t)wait;
+    }
+  }
+#endif /* TSCH_ADAPTIVE_TIMESYNC_DYNAMIC_RX_WAIT */
+  return max_wait;
+}
+/*---------------------------------------------------------------------------*/
 /* Error-accumulation free compensation algorithm */
 static int32_t
 compensate_internal(uint32_t time_delta_usec, int32_t drift_ppm, int32_t *remainder, int16_t *tick_conversion_error)
@@ -162,6 +272,7 @@ tsch_timesync_adaptive_compensate(rtimer_clock_t time_delta_ticks)
     result = compensate_internal(time_delta_usec, drift_ppm,
         &remainder, &tick_conversion_error);
     compensated_ticks += result;
+    compensated_ticks_since_sync += result;
   }
 
   if(TSCH_BASE_DRIFT_PPM) {
@@ -177,8 +288,27 @@ tsch_timesync_adaptive_compensate(rtimer_clock_t time_delta_ticks)
 #else /* TSCH_ADAPTIVE_TIMESYNC */
 /*---------------------------------------------------------------------------*/
 void
-tsch_timesync_update(struct tsch_neighbor *n, uint16_t time_delta_asn, int32_t drift_correction)
+tsch_timesync_update(struct tsch_neighbor *n, uint16_t time_delta_asn,
+                     int32_t drift_correction, int16_t rssi)
+{
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_timesync_observe(struct tsch_neighbor *n, uint16_t time_delta_asn,
+                      int32_t drift_correction, int16_t rssi)
+{
+}
+/*---------------------------------------------------------------------------*/
+int32_t
+tsch_timesync_get_drift(void)
+{
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+rtimer_clock_t
+tsch_timesync_adaptive_rx_wait(uint32_t time_since_sync_asn)
 {
+  return tsch_timing[tsch_ts_rx_wait];
 }
 /*---------------------------------------------------------------------------*/
 int32_t
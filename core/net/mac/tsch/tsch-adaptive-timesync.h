@@ -72,6 +72,62 @@
 #define TSCH_BASE_DRIFT_PPM 0
 #endif
 
+/* Keep the learned drift when the time source changes. Our drift
+ * relative to any synchronized neighbor is the same, this avoids
+ * learning it again from scratch after each parent switch */
+#ifdef TSCH_ADAPTIVE_TIMESYNC_CONF_KEEP_DRIFT
+#define TSCH_ADAPTIVE_TIMESYNC_KEEP_DRIFT TSCH_ADAPTIVE_TIMESYNC_CONF_KEEP_DRIFT
+#else
+#define TSCH_ADAPTIVE_TIMESYNC_KEEP_DRIFT 1
+#endif
+
+/* Also learn the drift from frames received from neighbors other than
+ * the time source, at most one sample between two resynchronizations */
+#ifdef TSCH_ADAPTIVE_TIMESYNC_CONF_MULTI_SOURCE
+#define TSCH_ADAPTIVE_TIMESYNC_MULTI_SOURCE TSCH_ADAPTIVE_TIMESYNC_CONF_MULTI_SOURCE
+#else
+#define TSCH_ADAPTIVE_TIMESYNC_MULTI_SOURCE 1
+#endif
+
+/* Drift samples of other neighbors that far from the current estimate
+ * (in ppm) are discarded */
+#ifdef TSCH_ADAPTIVE_TIMESYNC_CONF_MAX_SAMPLE_DEVIATION_PPM
+#define TSCH_ADAPTIVE_TIMESYNC_MAX_SAMPLE_DEVIATION_PPM TSCH_ADAPTIVE_TIMESYNC_CONF_MAX_SAMPLE_DEVIATION_PPM
+#else
+#define TSCH_ADAPTIVE_TIMESYNC_MAX_SAMPLE_DEVIATION_PPM 20
+#endif
+
+/* Drift samples are weighted by the RSSI above this floor (in dBm) */
+#ifdef TSCH_ADAPTIVE_TIMESYNC_CONF_RSSI_FLOOR
+#define TSCH_ADAPTIVE_TIMESYNC_RSSI_FLOOR TSCH_ADAPTIVE_TIMESYNC_CONF_RSSI_FLOOR
+#else
+#define TSCH_ADAPTIVE_TIMESYNC_RSSI_FLOOR -95
+#endif
+
+/* Shrink the Rx guard time below TSCH_CONF_RX_WAIT once the drift
+ * estimate is settled, to what the estimated residual drift since the
+ * last resynchronization requires */
+#ifdef TSCH_ADAPTIVE_TIMESYNC_CONF_DYNAMIC_RX_WAIT
+#define TSCH_ADAPTIVE_TIMESYNC_DYNAMIC_RX_WAIT TSCH_ADAPTIVE_TIMESYNC_CONF_DYNAMIC_RX_WAIT
+#else
+#define TSCH_ADAPTIVE_TIMESYNC_DYNAMIC_RX_WAIT 0
+#endif
+
+/* Residual drift (in ppm) assumed on top of the spread of the samples,
+ * when computing the dynamic Rx guard time */
+#ifdef TSCH_ADAPTIVE_TIMESYNC_CONF_RESIDUAL_PPM
+#define TSCH_ADAPTIVE_TIMESYNC_RESIDUAL_PPM TSCH_ADAPTIVE_TIMESYNC_CONF_RESIDUAL_PPM
+#else
+#define TSCH_ADAPTIVE_TIMESYNC_RESIDUAL_PPM 2
+#endif
+
+/* Lower bound of the dynamic Rx guard time, in usec */
+#ifdef TSCH_ADAPTIVE_TIMESYNC_CONF_MIN_RX_WAIT
+#define TSCH_ADAPTIVE_TIMESYNC_MIN_RX_WAIT TSCH_ADAPTIVE_TIMESYNC_CONF_MIN_RX_WAIT
+#else
+#define TSCH_ADAPTIVE_TIMESYNC_MIN_RX_WAIT 400
+#endif
+
 /* The approximate number of slots per second */
 #define TSCH_SLOTS_PER_SECOND (1000000 / TSCH_DEFAULT_TS_TIMESLOT_LENGTH)
 
@@ -82,8 +138,22 @@ extern struct tsch_neighbor *last_timesource_neighbor;
 
 /********** Functions *********/
 
-void tsch_timesync_update(struct tsch_neighbor *n, uint16_t time_delta_asn, int32_t drift_correction);
+/* Resynchronization with the time source, which had drifted by
+ * drift_correction ticks. rssi is that of the frame we synchronized on */
+void tsch_timesync_update(struct tsch_neighbor *n, uint16_t time_delta_asn,
+                          int32_t drift_correction, int16_t rssi);
+/* Frame received from another neighbor, that had drifted by
+ * drift_correction ticks since our last resynchronization. Only used to
+ * refine the drift estimate */
+void tsch_timesync_observe(struct tsch_neighbor *n, uint16_t time_delta_asn,
+                           int32_t drift_correction, int16_t rssi);
 
 int32_t tsch_timesync_adaptive_compensate(rtimer_clock_t delta_ticks);
 
+/* Our estimated drift relative to the network, in ppm * 256 */
+int32_t tsch_timesync_get_drift(void);
+/* Rx guard time to use, given the number of slots since the last
+ * resynchronization. At most tsch_timing[tsch_ts_rx_wait] */
+rtimer_clock_t tsch_timesync_adaptive_rx_wait(uint32_t time_since_sync_asn);
+
 #endif /* __TSCH_ADAPTIVE_TIMESYNC_H__ */
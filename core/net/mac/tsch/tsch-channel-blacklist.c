@@ -0,0 +1,351 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Adaptive channel blacklisting: per-channel PRR, blacklist
+ *         decided by the coordinator, propagated in EBs, and applied
+ *         network-wide from a common ASN.
+ */
+
+#include "contiki.h"
+#include "net/mac/tsch/tsch.h"
+#include "net/mac/tsch/tsch-private.h"
+#include "net/mac/tsch/tsch-slot-operation.h"
+#include "net/mac/tsch/tsch-log.h"
+#include "net/mac/tsch/tsch-channel-blacklist.h"
+#include <string.h>
+
+#if TSCH_LOG_LEVEL >= 1
+#define DEBUG DEBUG_PRINT
+#else /* TSCH_LOG_LEVEL */
+#define DEBUG DEBUG_NONE
+#endif /* TSCH_LOG_LEVEL */
+#include "net/net-debug.h"
+
+#if TSCH_WITH_CHANNEL_BLACKLIST
+
+/* Number of channels covered by the blacklist bitmap */
+#define NUM_CHANNELS 16
+
+/* PRR EWMA, in percent (c.f. link-stats.c) */
+#define EWMA_SCALE 100
+#define EWMA_ALPHA 40
+
+struct channel_stats {
+  /* Transmissions and acknowledged transmissions not yet accounted for */
+  uint16_t tx_count;
+  uint16_t ack_count;
+  /* Packet reception ratio, in percent */
+  uint8_t prr;
+  /* Number of periods spent in the blacklist */
+  uint8_t age;
+};
+static struct channel_stats stats[NUM_CHANNELS];
+
+/* A hopping sequence without the blacklisted channels */
+struct channel_map {
+  uint16_t blacklist;
+  uint8_t sequence[TSCH_HOPPING_SEQUENCE_MAX_LEN];
+  struct asn_divisor_t sequence_length;
+};
+/* The map in use, and when switch_pending is set, the map in use from
+ * switch_asn on. Read by slot operation, so modified only when holding
+ * the TSCH lock, or before slot operation starts */
+static struct channel_map maps[2];
+static uint8_t active_map;
+static uint8_t switch_pending;
+static struct asn_t switch_asn;
+
+static struct ctimer period_timer;
+
+/*---------------------------------------------------------------------------*/
+/* Index of a channel in the blacklist bitmap, -1 if out of range */
+static int
+channel_index(uint8_t channel)
+{
+  if(channel >= TSCH_CHANNEL_BLACKLIST_FIRST_CHANNEL
+     && channel < TSCH_CHANNEL_BLACKLIST_FIRST_CHANNEL + NUM_CHANNELS) {
+    return channel - TSCH_CHANNEL_BLACKLIST_FIRST_CHANNEL;
+  }
+  return -1;
+}
+/*---------------------------------------------------------------------------*/
+/* Remove blacklisted channels from the hopping sequence */
+static void
+build_map(struct channel_map *m, uint16_t blacklist)
+{
+  int i;
+  int len = 0;
+  m->blacklist = blacklist;
+  for(i = 0; i < tsch_hopping_sequence_length.val; i++) {
+    int index = channel_index(tsch_hopping_sequence[i]);
+    if(index == -1 || !(blacklist & (1 << index))) {
+      m->sequence[len++] = tsch_hopping_sequence[i];
+    }
+  }
+  if(len == 0) {
+    /* Nothing left: ignore the blacklist */
+    memcpy(m->sequence, tsch_hopping_sequence, tsch_hopping_sequence_length.val);
+    len = tsch_hopping_sequence_length.val;
+  }
+  ASN_DIVISOR_INIT(m->sequence_length, len);
+}
+/*---------------------------------------------------------------------------*/
+/* Has the pending map come into use? */
+static int
+switch_done(void)
+{
+  return switch_pending && (int32_t)ASN_DIFF(current_asn, switch_asn) >= 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Make the pending map the active one once in use. Requires the lock */
+static void
+update_switch(void)
+{
+  if(switch_done()) {
+    active_map = !active_map;
+    switch_pending = 0;
+    PRINTF("TSCH-blacklist: now using blacklist %04x\n", maps[active_map].blacklist);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Take the blacklist of an EB. Requires the lock */
+static void
+adopt(const struct ieee802154_ies *ies)
+{
+  uint16_t blacklist = ies->ie_channel_blacklist;
+  int pending = ies->ie_channel_blacklist_pending;
+
+  if(pending && (int32_t)ASN_DIFF(current_asn, ies->ie_channel_blacklist_switch_asn) >= 0) {
+    /* The switch already happened */
+    blacklist = ies->ie_next_channel_blacklist;
+    pending = 0;
+  }
+
+  if(maps[active_map].blacklist != blacklist) {
+    PRINTF("TSCH-blacklist: blacklist %04x from EB\n", blacklist);
+  }
+  build_map(&maps[active_map], blacklist);
+  if(pending) {
+    build_map(&maps[!active_map], ies->ie_next_channel_blacklist);
+    switch_asn = ies->ie_channel_blacklist_switch_asn;
+  }
+  switch_pending = pending;
+}
+/*---------------------------------------------------------------------------*/
+/* Fold the transmissions of the last period into the PRR. Requires the lock */
+static void
+update_stats(void)
+{
+  int i;
+  for(i = 0; i < NUM_CHANNELS; i++) {
+    struct channel_stats *s = &stats[i];
+    if(s->tx_count >= TSCH_CHANNEL_BLACKLIST_MIN_TX) {
+      uint8_t prr = (uint32_t)s->ack_count * EWMA_SCALE / s->tx_count;
+      s->prr = ((uint16_t)s->prr * (EWMA_SCALE - EWMA_ALPHA) +
+                (uint16_t)prr * EWMA_ALPHA) / EWMA_SCALE;
+      s->tx_count = 0;
+      s->ack_count = 0;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Coordinator only: blacklist the worst channels */
+static uint16_t
+select_blacklist(void)
+{
+  int i;
+  uint16_t in_sequence = 0;
+  uint16_t blacklist = maps[active_map].blacklist;
+  int in_use = 0;
+
+  /* Channels of the hopping sequence */
+  for(i = 0; i < tsch_hopping_sequence_length.val; i++) {
+    int index = channel_index(tsch_hopping_sequence[i]);
+    if(index != -1) {
+      in_sequence |= 1 << index;
+    }
+  }
+
+  for(i = 0; i < NUM_CHANNELS; i++) {
+    uint16_t bit = 1 << i;
+    if(blacklist & bit) {
+      /* Give blacklisted channels another chance after a while */
+      if(++stats[i].age >= TSCH_CHANNEL_BLACKLIST_PROBATION) {
+        blacklist &= ~bit;
+        stats[i].prr = EWMA_SCALE;
+        stats[i].age = 0;
+      }
+    } else {
+      stats[i].age = 0;
+    }
+    if((in_sequence & bit) && !(blacklist & bit)) {
+      in_use++;
+    }
+  }
+
+  /* Blacklist channels below the threshold, worst first, as long as
+   * enough channels are left */
+  while(in_use > TSCH_CHANNEL_BLACKLIST_MIN_CHANNELS) {
+    int worst = -1;
+    for(i = 0; i < NUM_CHANNELS; i++) {
+      if((in_sequence & ~blacklist & (1 << i))
+         && stats[i].prr < TSCH_CHANNEL_BLACKLIST_PRR_THRESHOLD
+         && (worst == -1 || stats[i].prr < stats[worst].prr)) {
+        worst = i;
+      }
+    }
+    if(worst == -1) {
+      break;
+    }
+    blacklist |= 1 << worst;
+    in_use--;
+  }
+
+  return blacklist;
+}
+/*---------------------------------------------------------------------------*/
+static void
+period_expired(void *ptr)
+{
+  ctimer_reset(&period_timer);
+
+  if(!tsch_is_associated || !tsch_get_lock()) {
+    return;
+  }
+
+  update_switch();
+  update_stats();
+
+  if(tsch_is_coordinator && !switch_pending) {
+    uint16_t blacklist = select_blacklist();
+    if(blacklist != maps[active_map].blacklist) {
+      /* Announce the new blacklist in our EBs, use it later */
+      build_map(&maps[!active_map], blacklist);
+      switch_asn = current_asn;
+      ASN_INC(switch_asn, TSCH_CHANNEL_BLACKLIST_SWITCH_DELAY);
+      switch_pending = 1;
+      PRINTF("TSCH-blacklist: blacklist %04x from asn-%x.%lx\n",
+             blacklist, switch_asn.ms1b, (unsigned long)switch_asn.ls4b);
+    }
+  }
+
+  tsch_release_lock();
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_channel_blacklist_tx(uint8_t channel, int acked)
+{
+  int index = channel_index(channel);
+  if(index != -1) {
+    stats[index].tx_count++;
+    if(acked) {
+      stats[index].ack_count++;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+tsch_channel_blacklist_get_channel(const struct asn_t *asn, uint8_t channel_offset)
+{
+  const struct channel_map *m = &maps[active_map];
+  uint16_t index_of_0;
+  uint16_t index_of_offset;
+  if(switch_pending && (int32_t)ASN_DIFF(*asn, switch_asn) >= 0) {
+    m = &maps[!active_map];
+  }
+  index_of_0 = ASN_MOD(*asn, m->sequence_length);
+  index_of_offset = (index_of_0 + channel_offset) % m->sequence_length.val;
+  return m->sequence[index_of_offset];
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+tsch_channel_blacklist_get(void)
+{
+  return switch_done() ? maps[!active_map].blacklist : maps[active_map].blacklist;
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_channel_blacklist_add_ies(struct ieee802154_ies *ies)
+{
+  ies->ie_channel_blacklist_present = 1;
+  ies->ie_channel_blacklist = tsch_channel_blacklist_get();
+  ies->ie_channel_blacklist_pending = switch_pending && !switch_done();
+  if(ies->ie_channel_blacklist_pending) {
+    ies->ie_next_channel_blacklist = maps[!active_map].blacklist;
+    ies->ie_channel_blacklist_switch_asn = switch_asn;
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_channel_blacklist_eb_input(const struct ieee802154_ies *ies)
+{
+  if(ies->ie_channel_blacklist_present && !tsch_is_coordinator
+     && tsch_get_lock()) {
+    adopt(ies);
+    tsch_release_lock();
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_channel_blacklist_start(const struct ieee802154_ies *ies)
+{
+  /* Slot operation is not running yet */
+  active_map = 0;
+  switch_pending = 0;
+  build_map(&maps[active_map], 0);
+  if(ies != NULL && ies->ie_channel_blacklist_present) {
+    adopt(ies);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_channel_blacklist_reset(void)
+{
+  int i;
+  memset(stats, 0, sizeof(stats));
+  for(i = 0; i < NUM_CHANNELS; i++) {
+    stats[i].prr = EWMA_SCALE;
+  }
+  switch_pending = 0;
+  maps[active_map].blacklist = 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_channel_blacklist_init(void)
+{
+  tsch_channel_blacklist_reset();
+  ctimer_set(&period_timer, TSCH_CHANNEL_BLACKLIST_PERIOD, period_expired, NULL);
+}
+
+#endif /* TSCH_WITH_CHANNEL_BLACKLIST */
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Adaptive channel blacklisting. Nodes keep a per-channel packet
+ *         reception ratio of their unicast transmissions. The coordinator
+ *         blacklists its worst channels, and the blacklist propagates
+ *         through the network in EBs. Blacklisted channels are removed
+ *         from the hopping sequence from a given ASN on, so that all
+ *         nodes switch at the same time.
+ */
+
+#ifndef __TSCH_CHANNEL_BLACKLIST_H__
+#define __TSCH_CHANNEL_BLACKLIST_H__
+
+/********** Includes **********/
+
+#include "contiki.h"
+#include "net/mac/tsch/tsch-asn.h"
+#include "net/mac/frame802154e-ie.h"
+
+/******** Configuration *******/
+
+/* The blacklist is a 16-bit bitmap, bit i being channel
+ * TSCH_CHANNEL_BLACKLIST_FIRST_CHANNEL + i. Channels out of this range
+ * are never blacklisted */
+#ifdef TSCH_CHANNEL_BLACKLIST_CONF_FIRST_CHANNEL
+#define TSCH_CHANNEL_BLACKLIST_FIRST_CHANNEL TSCH_CHANNEL_BLACKLIST_CONF_FIRST_CHANNEL
+#else
+#define TSCH_CHANNEL_BLACKLIST_FIRST_CHANNEL 11
+#endif
+
+/* Period of the channel quality assessment */
+#ifdef TSCH_CHANNEL_BLACKLIST_CONF_PERIOD
+#define TSCH_CHANNEL_BLACKLIST_PERIOD TSCH_CHANNEL_BLACKLIST_CONF_PERIOD
+#else
+#define TSCH_CHANNEL_BLACKLIST_PERIOD (60 * CLOCK_SECOND)
+#endif
+
+/* Min number of transmissions on a channel before its PRR is updated */
+#ifdef TSCH_CHANNEL_BLACKLIST_CONF_MIN_TX
+#define TSCH_CHANNEL_BLACKLIST_MIN_TX TSCH_CHANNEL_BLACKLIST_CONF_MIN_TX
+#else
+#define TSCH_CHANNEL_BLACKLIST_MIN_TX 8
+#endif
+
+/* Channels with a PRR (in percent) below this threshold are blacklisted */
+#ifdef TSCH_CHANNEL_BLACKLIST_CONF_PRR_THRESHOLD
+#define TSCH_CHANNEL_BLACKLIST_PRR_THRESHOLD TSCH_CHANNEL_BLACKLIST_CONF_PRR_THRESHOLD
+#else
+#define TSCH_CHANNEL_BLACKLIST_PRR_THRESHOLD 60
+#endif
+
+/* Min number of channels of the hopping sequence left in use */
+#ifdef TSCH_CHANNEL_BLACKLIST_CONF_MIN_CHANNELS
+#define TSCH_CHANNEL_BLACKLIST_MIN_CHANNELS TSCH_CHANNEL_BLACKLIST_CONF_MIN_CHANNELS
+#else
+#define TSCH_CHANNEL_BLACKLIST_MIN_CHANNELS 2
+#endif
+
+/* Number of periods after which a blacklisted channel is tried again.
+ * Blacklisted channels are not used, so their PRR cannot improve otherwise */
+#ifdef TSCH_CHANNEL_BLACKLIST_CONF_PROBATION
+#define TSCH_CHANNEL_BLACKLIST_PROBATION TSCH_CHANNEL_BLACKLIST_CONF_PROBATION
+#else
+#define TSCH_CHANNEL_BLACKLIST_PROBATION 10
+#endif
+
+/* Number of timeslots between the decision of a new blacklist and its
+ * use. Must leave enough time for the EBs to carry it to every node */
+#ifdef TSCH_CHANNEL_BLACKLIST_CONF_SWITCH_DELAY
+#define TSCH_CHANNEL_BLACKLIST_SWITCH_DELAY TSCH_CHANNEL_BLACKLIST_CONF_SWITCH_DELAY
+#else
+#define TSCH_CHANNEL_BLACKLIST_SWITCH_DELAY 12000
+#endif
+
+/********** Functions *********/
+
+/* Module initialization, called by TSCH at startup */
+void tsch_channel_blacklist_init(void);
+/* Clear the blacklist and the channel statistics, called by TSCH when
+ * leaving the network */
+void tsch_channel_blacklist_reset(void);
+/* Start using the hopping sequence, with the blacklist of the EB we
+ * associated with (NULL when starting as coordinator) */
+void tsch_channel_blacklist_start(const struct ieee802154_ies *ies);
+/* Process the blacklist of an EB from our time source */
+void tsch_channel_blacklist_eb_input(const struct ieee802154_ies *ies);
+/* Fill in the blacklist IE of an outgoing EB */
+void tsch_channel_blacklist_add_ies(struct ieee802154_ies *ies);
+/* Record the outcome of a unicast transmission. Called from interrupt */
+void tsch_channel_blacklist_tx(uint8_t channel, int acked);
+/* Return channel from ASN and channel offset, skipping blacklisted channels */
+uint8_t tsch_channel_blacklist_get_channel(const struct asn_t *asn, uint8_t channel_offset);
+/* Current blacklist, as a bitmap */
+uint16_t tsch_channel_blacklist_get(void);
+
+#endif /* __TSCH_CHANNEL_BLACKLIST_H__ */
@@ -170,6 +170,32 @@
 #define TSCH_WITH_LINK_SELECTOR 0
 #endif /* TSCH_CONF_WITH_LINK_SELECTOR */
 
+/* Enable 6P, the 6top Protocol, to negotiate cells with neighbors.
+ * See tsch-sixtop.h */
+#ifdef TSCH_CONF_WITH_SIXTOP
+#define TSCH_WITH_SIXTOP TSCH_CONF_WITH_SIXTOP
+#else /* TSCH_CONF_WITH_SIXTOP */
+#define TSCH_WITH_SIXTOP 0
+#endif /* TSCH_CONF_WITH_SIXTOP */
+
+/* Blacklist channels with a poor packet reception ratio, network-wide.
+ * See tsch-channel-blacklist.h */
+#ifdef TSCH_CONF_WITH_CHANNEL_BLACKLIST
+#define TSCH_WITH_CHANNEL_BLACKLIST TSCH_CONF_WITH_CHANNEL_BLACKLIST
+#else /* TSCH_CONF_WITH_CHANNEL_BLACKLIST */
+#define TSCH_WITH_CHANNEL_BLACKLIST 0
+#endif /* TSCH_CONF_WITH_CHANNEL_BLACKLIST */
+
+/* Max number of frames sent back-to-back to the same neighbor. The sender
+ * sets the frame pending bit when it has more frames for the neighbor, and
+ * both stay on the same link and channel for the next timeslot.
+ * 0 to disable bursts */
+#ifdef TSCH_CONF_BURST_MAX_LEN
+#define TSCH_BURST_MAX_LEN TSCH_CONF_BURST_MAX_LEN
+#else /* TSCH_CONF_BURST_MAX_LEN */
+#define TSCH_BURST_MAX_LEN 0
+#endif /* TSCH_CONF_BURST_MAX_LEN */
+
 /* Estimate the drift of the time-source neighbor and compensate for it? */
 #ifdef TSCH_CONF_ADAPTIVE_TIMESYNC
 #define TSCH_ADAPTIVE_TIMESYNC TSCH_CONF_ADAPTIVE_TIMESYNC
@@ -198,4 +224,38 @@
 #define TSCH_CHANNEL_SCAN_DURATION CLOCK_SECOND
 #endif
 
+/* Longest time spent scanning a channel on which frames keep being
+ * received. Every frame heard extends the scan of the channel by
+ * TSCH_CHANNEL_SCAN_DURATION, up to this */
+#ifdef TSCH_CONF_CHANNEL_SCAN_MAX_DURATION
+#define TSCH_CHANNEL_SCAN_MAX_DURATION TSCH_CONF_CHANNEL_SCAN_MAX_DURATION
+#else
+#define TSCH_CHANNEL_SCAN_MAX_DURATION (4 * TSCH_CHANNEL_SCAN_DURATION)
+#endif
+
+/* Remember the network last joined in CFS: the channel its EB came on,
+ * its PAN ID, timeslot template and hopping sequence. After a reboot,
+ * that channel is scanned first, then the other channels of the hopping
+ * sequence only. EBs that carry the ID of the timeslot template or of the
+ * hopping sequence, but not its content, are completed from the copy */
+#ifdef TSCH_CONF_JOIN_HINTS
+#define TSCH_JOIN_HINTS TSCH_CONF_JOIN_HINTS
+#else
+#define TSCH_JOIN_HINTS 0
+#endif
+
+#ifdef TSCH_CONF_JOIN_HINTS_FILE
+#define TSCH_JOIN_HINTS_FILE TSCH_CONF_JOIN_HINTS_FILE
+#else
+#define TSCH_JOIN_HINTS_FILE "tsch-join"
+#endif
+
+/* How long to scan the channels of the remembered network, before going
+ * back to the whole of TSCH_JOIN_HOPPING_SEQUENCE */
+#ifdef TSCH_CONF_JOIN_HINTS_TIMEOUT
+#define TSCH_JOIN_HINTS_TIMEOUT TSCH_CONF_JOIN_HINTS_TIMEOUT
+#else
+#define TSCH_JOIN_HINTS_TIMEOUT (60 * CLOCK_SECOND)
+#endif
+
 #endif /* __TSCH_CONF_H__ */
@@ -46,6 +46,7 @@
 #include "net/mac/tsch/tsch-schedule.h"
 #include "net/mac/tsch/tsch-security.h"
 #include "net/mac/tsch/tsch-log.h"
+#include "net/mac/tsch/tsch-channel-blacklist.h"
 #include "net/mac/frame802154.h"
 #include "net/mac/framer-802154.h"
 #include "net/netstack.h"
@@ -160,11 +161,18 @@ tsch_packet_parse_eack(const uint8_t *buf, int buf_size,
     return 0;
   }
 
+  /* Only the ACK/NACK time correction IE is of interest here: rather
+   * than clearing and filling in the whole IE structure, walk the IEs in
+   * place and decode that one alone */
   if(ies != NULL) {
-    memset(ies, 0, sizeof(struct ieee802154_ies));
+    ies->ie_time_correction = 0;
+    ies->ie_is_nack = 0;
+    ies->ie_payload_ie_offset = 0;
   }
 
   if(frame->fcf.ie_list_present) {
+    struct ieee802154_ie_iterator it;
+    struct ieee802154_ie ie;
     int mic_len = 0;
 #if LLSEC802154_ENABLED
     /* Check if there is space for the security MIC (if any) */
@@ -173,15 +181,25 @@ tsch_packet_parse_eack(const uint8_t *buf, int buf_size,
       return 0;
     }
 #endif /* LLSEC802154_ENABLED */
-    /* Parse information elements. We need to substract the MIC length, as the exact payload len is needed while parsing */
-    if((ret = frame802154e_parse_information_elements(buf + curr_len, buf_size - curr_len - mic_len, ies)) == -1) {
+    /* Walk information elements. We need to substract the MIC length, as the exact payload len is needed while parsing */
+    frame802154e_ie_iterator_init(&it, buf + curr_len, buf_size - curr_len - mic_len);
+    while((ret = frame802154e_ie_next(&it, &ie)) == 1) {
+      if(ie.kind == FRAME802154E_IE_HEADER
+         && ie.id == HEADER_IE_ACK_NACK_TIME_CORRECTION
+         && frame802154e_ie_parse(&ie, ies) == -1) {
+        return 0;
+      }
+    }
+    if(ret == -1) {
       return 0;
     }
-    curr_len += ret;
-  }
-
-  if(hdr_len != NULL) {
-    *hdr_len += ies->ie_payload_ie_offset;
+    curr_len += frame802154e_ie_iterator_len(&it);
+    if(hdr_len != NULL) {
+      *hdr_len += it.payload_ie_offset;
+    }
+    if(ies != NULL) {
+      ies->ie_payload_ie_offset = it.payload_ie_offset;
+    }
   }
 
   return curr_len;
@@ -277,6 +295,11 @@ tsch_packet_create_eb(uint8_t *buf, int buf_size,
   }
 #endif /* TSCH_PACKET_EB_WITH_SLOTFRAME_AND_LINK */
 
+  /* Add channel blacklist IE */
+#if TSCH_WITH_CHANNEL_BLACKLIST
+  tsch_channel_blacklist_add_ies(&ies);
+#endif /* TSCH_WITH_CHANNEL_BLACKLIST */
+
   /* First add header-IE termination IE to stipulate that next come payload IEs */
   if((ret = frame80215e_create_ie_header_list_termination_1(buf + curr_len, buf_size - curr_len, &ies)) == -1) {
     return -1;
@@ -317,6 +340,13 @@ tsch_packet_create_eb(uint8_t *buf, int buf_size,
   }
   curr_len += ret;
 
+  if(ies.ie_channel_blacklist_present) {
+    if((ret = frame80215e_create_ie_tsch_channel_blacklist(buf + curr_len, buf_size - curr_len, &ies)) == -1) {
+      return -1;
+    }
+    curr_len += ret;
+  }
+
   ies.ie_mlme_len = curr_len - mlme_ie_offset - 2;
   if((ret = frame80215e_create_ie_mlme(buf + mlme_ie_offset, buf_size - mlme_ie_offset, &ies)) == -1) {
     return -1;
@@ -333,6 +363,78 @@ tsch_packet_create_eb(uint8_t *buf, int buf_size,
   return curr_len;
 }
 /*---------------------------------------------------------------------------*/
+/* Create a 6P packet: a data frame carrying a 6P message in a Payload IE */
+int
+tsch_packet_create_sixtop(uint8_t *buf, int buf_size,
+    const linkaddr_t *dest_addr, uint8_t seqno,
+    const uint8_t *msg, uint16_t msg_len, uint8_t *hdr_len)
+{
+  int ret = 0;
+  uint8_t curr_len = 0;
+
+  frame802154_t p;
+  struct ieee802154_ies ies;
+
+  if(buf_size < TSCH_PACKET_MAX_LEN) {
+    return 0;
+  }
+
+  /* Create 802.15.4 header */
+  memset(&p, 0, sizeof(p));
+  p.fcf.frame_type = FRAME802154_DATAFRAME;
+  p.fcf.ie_list_present = 1;
+  p.fcf.frame_version = FRAME802154_IEEE802154E_2012;
+  p.fcf.ack_required = 1;
+  p.fcf.src_addr_mode = LINKADDR_SIZE > 2 ? FRAME802154_LONGADDRMODE : FRAME802154_SHORTADDRMODE;
+  p.fcf.dest_addr_mode = LINKADDR_SIZE > 2 ? FRAME802154_LONGADDRMODE : FRAME802154_SHORTADDRMODE;
+  /* Include one PAN ID, as for data frames created by the framer */
+  p.fcf.panid_compression = 0;
+  p.seq = seqno;
+
+  p.src_pid = frame802154_get_pan_id();
+  p.dest_pid = frame802154_get_pan_id();
+  linkaddr_copy((linkaddr_t *)&p.src_addr, &linkaddr_node_addr);
+  linkaddr_copy((linkaddr_t *)&p.dest_addr, dest_addr);
+
+#if LLSEC802154_ENABLED
+  if(tsch_is_pan_secured) {
+    p.fcf.security_enabled = packetbuf_attr(PACKETBUF_ATTR_SECURITY_LEVEL) > 0;
+    p.aux_hdr.security_control.security_level = packetbuf_attr(PACKETBUF_ATTR_SECURITY_LEVEL);
+    p.aux_hdr.security_control.key_id_mode = packetbuf_attr(PACKETBUF_ATTR_KEY_ID_MODE);
+    p.aux_hdr.security_control.frame_counter_suppression = 1;
+    p.aux_hdr.security_control.frame_counter_size = 1;
+    p.aux_hdr.key_index = packetbuf_attr(PACKETBUF_ATTR_KEY_INDEX);
+  }
+#endif /* LLSEC802154_ENABLED */
+
+  if((curr_len = frame802154_create(&p, buf)) == 0) {
+    return 0;
+  }
+
+  /* The IEs are secured as payload, which is also how the receiver
+   * handles them in slot operation */
+  if(hdr_len != NULL) {
+    *hdr_len = curr_len;
+  }
+
+  memset(&ies, 0, sizeof(ies));
+  ies.ie_sixtop = msg;
+  ies.ie_sixtop_len = msg_len;
+
+  /* Header-IE termination IE, then the 6P message in an IETF IE */
+  if((ret = frame80215e_create_ie_header_list_termination_1(buf + curr_len, buf_size - curr_len, &ies)) == -1) {
+    return -1;
+  }
+  curr_len += ret;
+
+  if((ret = frame80215e_create_ie_ietf_sixtop(buf + curr_len, buf_size - curr_len, &ies)) == -1) {
+    return -1;
+  }
+  curr_len += ret;
+
+  return curr_len;
+}
+/*---------------------------------------------------------------------------*/
 /* Update ASN in EB packet */
 int
 tsch_packet_update_eb(uint8_t *buf, int buf_size, uint8_t tsch_sync_ie_offset)
@@ -89,7 +89,8 @@ by default, useful in case of duplicate seqno */
 /* Construct enhanced ACK packet and return ACK length */
 int tsch_packet_create_eack(uint8_t *buf, int buf_size,
     linkaddr_t *dest_addr, uint8_t seqno, int16_t drift, int nack);
-/* Parse enhanced ACK packet, extract drift and nack */
+/* Parse enhanced ACK packet, extract drift and nack. Only the time
+ * correction, nack and payload IE offset fields of ies are set */
 int tsch_packet_parse_eack(const uint8_t *buf, int buf_size,
     uint8_t seqno, frame802154_t *frame, struct ieee802154_ies *ies, uint8_t *hdr_len);
 /* Create an EB packet */
@@ -97,6 +98,10 @@ int tsch_packet_create_eb(uint8_t *buf, int buf_size,
     uint8_t *hdr_len, uint8_t *tsch_sync_ie_ptr);
 /* Update ASN in EB packet */
 int tsch_packet_update_eb(uint8_t *buf, int buf_size, uint8_t tsch_sync_ie_offset);
+/* Create a 6P packet: a data frame carrying a 6P message in a Payload IE */
+int tsch_packet_create_sixtop(uint8_t *buf, int buf_size,
+    const linkaddr_t *dest_addr, uint8_t seqno,
+    const uint8_t *msg, uint16_t msg_len, uint8_t *hdr_len);
 /* Parse EB and extract ASN and join priority */
 int tsch_packet_parse_eb(const uint8_t *buf, int buf_size,
     frame802154_t *frame, struct ieee802154_ies *ies,
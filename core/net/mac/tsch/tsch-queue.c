@@ -54,6 +54,8 @@
 #include "net/mac/tsch/tsch-schedule.h"
 #include "net/mac/tsch/tsch-slot-operation.h"
 #include "net/mac/tsch/tsch-log.h"
+#include "net/net-stats.h"
+#include "net/latency-trace.h"
 #include <string.h>
 
 #if TSCH_LOG_LEVEL >= 1
@@ -71,12 +73,43 @@
 /* We have as many packets are there are queuebuf in the system */
 MEMB(packet_memb, struct tsch_packet, QUEUEBUF_NUM);
 MEMB(neighbor_memb, struct tsch_neighbor, TSCH_QUEUE_MAX_NEIGHBOR_QUEUES);
+
+enum { STATS_QUEUED, STATS_DROP, STATS_QUEUE_LEN, STATS_NUM };
+#if NET_STATS_ENABLED
+static uint32_t stats[STATS_QUEUE_LEN];
+static const char * const stats_names[STATS_NUM] = {
+  "queued", "drop", "queue_len"
+};
+static uint32_t
+stats_get(uint8_t index)
+{
+  if(index == STATS_QUEUE_LEN) {
+    return QUEUEBUF_NUM - memb_numfree(&packet_memb);
+  }
+  return stats[index];
+}
+static struct net_stats_group stats_group = {
+  NULL, "tsch", stats_names, STATS_NUM, stats_get
+};
+#endif /* NET_STATS_ENABLED */
 LIST(neighbor_list);
+/* Neighbors removed from neighbor_list while a slot operation was in
+ * progress. They are freed once that slot operation is over */
+LIST(retired_neighbor_list);
 
 /* Broadcast and EB virtual neighbors */
 struct tsch_neighbor *n_broadcast;
 struct tsch_neighbor *n_eb;
 
+#if TSCH_QUEUE_SHARED_POLICY == TSCH_QUEUE_SHARED_POLICY_ROUND_ROBIN
+/* The neighbor last served in a shared link. Only compared, never
+ * dereferenced, so it may point to a removed neighbor */
+static const struct tsch_neighbor *last_served_nbr;
+#elif TSCH_QUEUE_SHARED_POLICY == TSCH_QUEUE_SHARED_POLICY_OLDEST
+/* Incremented for every packet enqueued */
+static uint16_t enqueue_seqno;
+#endif
+
 /*---------------------------------------------------------------------------*/
 /* Add a TSCH neighbor */
 struct tsch_neighbor *
@@ -86,21 +119,20 @@ tsch_queue_add_nbr(const linkaddr_t *addr)
   /* If we have an entry for this neighbor already, we simply update it */
   n = tsch_queue_get_nbr(addr);
   if(n == NULL) {
-    if(tsch_get_lock()) {
-      /* Allocate a neighbor */
-      n = memb_alloc(&neighbor_memb);
-      if(n != NULL) {
-        /* Initialize neighbor entry */
-        memset(n, 0, sizeof(struct tsch_neighbor));
-        ringbufindex_init(&n->tx_ringbuf, TSCH_QUEUE_NUM_PER_NEIGHBOR);
-        linkaddr_copy(&n->addr, addr);
-        n->is_broadcast = linkaddr_cmp(addr, &tsch_eb_address)
-          || linkaddr_cmp(addr, &tsch_broadcast_address);
-        tsch_queue_backoff_reset(n);
-        /* Add neighbor to the list */
-        list_add(neighbor_list, n);
-      }
-      tsch_release_lock();
+    /* Allocate a neighbor */
+    n = memb_alloc(&neighbor_memb);
+    if(n != NULL) {
+      /* Initialize neighbor entry */
+      memset(n, 0, sizeof(struct tsch_neighbor));
+      ringbufindex_init(&n->tx_ringbuf, TSCH_QUEUE_NUM_PER_NEIGHBOR);
+      linkaddr_copy(&n->addr, addr);
+      n->is_broadcast = linkaddr_cmp(addr, &tsch_eb_address)
+        || linkaddr_cmp(addr, &tsch_broadcast_address);
+      tsch_queue_backoff_reset(n);
+      /* Add neighbor to the list. The entry is complete and list_add()
+       * links it with a single pointer update, so the slot operation never
+       * sees it half-initialized and we need not take the lock */
+      list_add(neighbor_list, n);
     }
   }
   return n;
@@ -110,14 +142,13 @@ tsch_queue_add_nbr(const linkaddr_t *addr)
 struct tsch_neighbor *
 tsch_queue_get_nbr(const linkaddr_t *addr)
 {
-  if(!tsch_is_locked()) {
-    struct tsch_neighbor *n = list_head(neighbor_list);
-    while(n != NULL) {
-      if(linkaddr_cmp(&n->addr, addr)) {
-        return n;
-      }
-      n = list_item_next(n);
+  /* The neighbor list is updated without lock and is always consistent */
+  struct tsch_neighbor *n = list_head(neighbor_list);
+  while(n != NULL) {
+    if(linkaddr_cmp(&n->addr, addr)) {
+      return n;
     }
+    n = list_item_next(n);
   }
   return NULL;
 }
@@ -198,18 +229,14 @@ tsch_queue_flush_nbr_queue(struct tsch_neighbor *n)
   }
 }
 /*---------------------------------------------------------------------------*/
-/* Remove TSCH neighbor queue */
+/* Free the neighbors removed during a slot operation, once it is over */
 static void
-tsch_queue_remove_nbr(struct tsch_neighbor *n)
+tsch_queue_free_retired_neighbors(void)
 {
-  if(n != NULL) {
-    if(tsch_get_lock()) {
-
-      /* Remove neighbor from list */
-      list_remove(neighbor_list, n);
-
-      tsch_release_lock();
-
+  struct tsch_neighbor *n;
+  /* A slot operation starting now can not reach retired neighbors */
+  if(!tsch_is_in_slot_operation()) {
+    while((n = list_pop(retired_neighbor_list)) != NULL) {
       /* Flush queue */
       tsch_queue_flush_nbr_queue(n);
 
@@ -219,6 +246,21 @@ tsch_queue_remove_nbr(struct tsch_neighbor *n)
   }
 }
 /*---------------------------------------------------------------------------*/
+/* Remove TSCH neighbor queue */
+static void
+tsch_queue_remove_nbr(struct tsch_neighbor *n)
+{
+  if(n != NULL) {
+    /* Remove neighbor from list. This is a single pointer update, so we
+     * need not take the lock, but the slot operation in progress (if any)
+     * may still be using the neighbor: defer freeing it until it is over */
+    list_remove(neighbor_list, n);
+    list_add(retired_neighbor_list, n);
+
+    tsch_queue_free_retired_neighbors();
+  }
+}
+/*---------------------------------------------------------------------------*/
 /* Add packet to neighbor queue. Use same lockfree implementation as ringbuf.c (put is atomic) */
 struct tsch_packet *
 tsch_queue_add_packet(const linkaddr_t *addr, mac_callback_t sent, void *ptr)
@@ -237,15 +279,23 @@ tsch_queue_add_packet(const linkaddr_t *addr, mac_callback_t sent, void *ptr)
 #ifdef TSCH_CALLBACK_PACKET_READY
           TSCH_CALLBACK_PACKET_READY();
 #endif
-          p->qb = queuebuf_new_from_packetbuf();
+          p->qb = queuebuf_take_packetbuf();
           if(p->qb != NULL) {
             p->sent = sent;
             p->ptr = ptr;
             p->ret = MAC_TX_DEFERRED;
             p->transmissions = 0;
+            p->channel = 0;
+#if TSCH_QUEUE_SHARED_POLICY == TSCH_QUEUE_SHARED_POLICY_OLDEST
+            p->enqueue_seqno = enqueue_seqno++;
+#endif
             /* Add to ringbuf (actual add committed through atomic operation) */
             n->tx_array[put_index] = p;
             ringbufindex_put(&n->tx_ringbuf);
+            NET_STATS_ADD(stats, STATS_QUEUED);
+            LATENCY_TRACE_STAMP_ID(queuebuf_attr(p->qb,
+                                                 PACKETBUF_ATTR_LATENCY_TRACE),
+                                   LATENCY_TRACE_MAC_QUEUED);
             return p;
           } else {
             memb_free(&packet_memb, p);
@@ -255,6 +305,7 @@ tsch_queue_add_packet(const linkaddr_t *addr, mac_callback_t sent, void *ptr)
     }
   }
   PRINTF("TSCH-queue:! add packet failed: %u %p %d %p %p\n", tsch_is_locked(), n, put_index, p, p ? p->qb : NULL);
+  NET_STATS_ADD(stats, STATS_DROP);
   return 0;
 }
 /*---------------------------------------------------------------------------*/
@@ -322,6 +373,8 @@ tsch_queue_reset(void)
 void
 tsch_queue_free_unused_neighbors(void)
 {
+  tsch_queue_free_retired_neighbors();
+
   /* Deallocate unneeded neighbors */
   if(!tsch_is_locked()) {
     struct tsch_neighbor *n = list_head(neighbor_list);
@@ -391,19 +444,73 @@ tsch_queue_get_unicast_packet_for_any(struct tsch_neighbor **n, struct tsch_link
   if(!tsch_is_locked()) {
     struct tsch_neighbor *curr_nbr = list_head(neighbor_list);
     struct tsch_packet *p = NULL;
+#if TSCH_QUEUE_SHARED_POLICY != TSCH_QUEUE_SHARED_POLICY_FIRST
+    struct tsch_neighbor *best_nbr = NULL;
+    struct tsch_packet *best_p = NULL;
+#endif
+#if TSCH_QUEUE_SHARED_POLICY == TSCH_QUEUE_SHARED_POLICY_ROUND_ROBIN
+    int after_last_served = 0;
+#endif
     while(curr_nbr != NULL) {
       if(!curr_nbr->is_broadcast && curr_nbr->tx_links_count == 0) {
         /* Only look up for non-broadcast neighbors we do not have a tx link to */
         p = tsch_queue_get_packet_for_nbr(curr_nbr, link);
+#if TSCH_QUEUE_SHARED_POLICY == TSCH_QUEUE_SHARED_POLICY_FIRST
         if(p != NULL) {
           if(n != NULL) {
             *n = curr_nbr;
           }
           return p;
         }
+#else
+        if(p != NULL) {
+#if TSCH_QUEUE_SHARED_POLICY == TSCH_QUEUE_SHARED_POLICY_ROUND_ROBIN
+          if(after_last_served) {
+            /* The first neighbor after the last served one */
+            best_nbr = curr_nbr;
+            best_p = p;
+            break;
+          }
+          if(best_nbr == NULL) {
+            /* Wrap around to the first neighbor */
+            best_nbr = curr_nbr;
+            best_p = p;
+          }
+#elif TSCH_QUEUE_SHARED_POLICY == TSCH_QUEUE_SHARED_POLICY_LONGEST
+          if(best_nbr == NULL
+             || ringbufindex_elements(&curr_nbr->tx_ringbuf)
+             > ringbufindex_elements(&best_nbr->tx_ringbuf)) {
+            best_nbr = curr_nbr;
+            best_p = p;
+          }
+#elif TSCH_QUEUE_SHARED_POLICY == TSCH_QUEUE_SHARED_POLICY_OLDEST
+          if(best_p == NULL
+             || (int16_t)(p->enqueue_seqno - best_p->enqueue_seqno) < 0) {
+            best_nbr = curr_nbr;
+            best_p = p;
+          }
+#endif
+        }
+#endif /* TSCH_QUEUE_SHARED_POLICY */
+      }
+#if TSCH_QUEUE_SHARED_POLICY == TSCH_QUEUE_SHARED_POLICY_ROUND_ROBIN
+      if(curr_nbr == last_served_nbr) {
+        after_last_served = 1;
       }
+#endif
       curr_nbr = list_item_next(curr_nbr);
     }
+#if TSCH_QUEUE_SHARED_POLICY != TSCH_QUEUE_SHARED_POLICY_FIRST
+    if(best_p != NULL) {
+#if TSCH_QUEUE_SHARED_POLICY == TSCH_QUEUE_SHARED_POLICY_ROUND_ROBIN
+      last_served_nbr = best_nbr;
+#endif
+      if(n != NULL) {
+        *n = best_nbr;
+      }
+      return best_p;
+    }
+#endif
   }
   return NULL;
 }
@@ -463,6 +570,7 @@ tsch_queue_init(void)
   list_init(neighbor_list);
   memb_init(&neighbor_memb);
   memb_init(&packet_memb);
+  net_stats_register(&stats_group);
   /* Add virtual EB and the broadcast neighbors */
   n_eb = tsch_queue_add_nbr(&tsch_eb_address);
   n_broadcast = tsch_queue_add_nbr(&tsch_broadcast_address);
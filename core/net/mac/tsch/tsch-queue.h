@@ -97,6 +97,23 @@
 #define TSCH_MAC_MAX_FRAME_RETRIES 8
 #endif
 
+/* Policies for choosing the neighbor to send to in a shared Tx link to
+ * any neighbor we have no dedicated Tx link to */
+/* The first neighbor with a packet, in neighbor list order */
+#define TSCH_QUEUE_SHARED_POLICY_FIRST        0
+/* The neighbor following the one that was last served, round robin */
+#define TSCH_QUEUE_SHARED_POLICY_ROUND_ROBIN  1
+/* The neighbor with the longest queue */
+#define TSCH_QUEUE_SHARED_POLICY_LONGEST      2
+/* The neighbor with the oldest packet at the head of its queue */
+#define TSCH_QUEUE_SHARED_POLICY_OLDEST       3
+
+#ifdef TSCH_QUEUE_CONF_SHARED_POLICY
+#define TSCH_QUEUE_SHARED_POLICY TSCH_QUEUE_CONF_SHARED_POLICY
+#else
+#define TSCH_QUEUE_SHARED_POLICY TSCH_QUEUE_SHARED_POLICY_FIRST
+#endif
+
 /*********** Callbacks *********/
 
 /* Called by TSCH when switching time source */
@@ -119,8 +136,12 @@ struct tsch_packet {
   void *ptr; /* MAC callback parameter */
   uint8_t transmissions; /* #transmissions performed for this packet */
   uint8_t ret; /* status -- MAC return code */
+  uint8_t channel; /* channel of the last transmission */
   uint8_t header_len; /* length of header and header IEs (needed for link-layer security) */
   uint8_t tsch_sync_ie_offset; /* Offset within the frame used for quick update of EB ASN and join priority */
+#if TSCH_QUEUE_SHARED_POLICY == TSCH_QUEUE_SHARED_POLICY_OLDEST
+  uint16_t enqueue_seqno; /* Order in which packets were enqueued */
+#endif
 };
 
 /* TSCH neighbor information */
@@ -177,7 +198,8 @@ int tsch_queue_is_empty(const struct tsch_neighbor *n);
 struct tsch_packet *tsch_queue_get_packet_for_nbr(const struct tsch_neighbor *n, struct tsch_link *link);
 /* Returns the head packet from a neighbor queue (from neighbor address) */
 struct tsch_packet *tsch_queue_get_packet_for_dest_addr(const linkaddr_t *addr, struct tsch_link *link);
-/* Returns the head packet of any neighbor queue with zero backoff counter.
+/* Returns the head packet of any neighbor queue with zero backoff counter,
+ * choosing the neighbor according to TSCH_QUEUE_SHARED_POLICY.
  * Writes pointer to the neighbor in *n */
 struct tsch_packet *tsch_queue_get_unicast_packet_for_any(struct tsch_neighbor **n, struct tsch_link *link);
 /* May the neighbor transmit over a share link? */
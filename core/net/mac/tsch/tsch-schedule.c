@@ -69,6 +69,9 @@ MEMB(slotframe_memb, struct tsch_slotframe, TSCH_SCHEDULE_MAX_SLOTFRAMES);
 /* List of slotframes (each slotframe holds its own list of links) */
 LIST(slotframe_list);
 
+/* Value of next_link_timeslot in a slotframe without a valid next link hint */
+#define NEXT_LINK_INVALID 0xffff
+
 /* Adds and returns a slotframe (NULL if failure) */
 struct tsch_slotframe *
 tsch_schedule_add_slotframe(uint16_t handle, uint16_t size)
@@ -89,6 +92,7 @@ tsch_schedule_add_slotframe(uint16_t handle, uint16_t size)
       sf->handle = handle;
       ASN_DIVISOR_INIT(sf->size, size);
       LIST_STRUCT_INIT(sf, links_list);
+      sf->next_link_timeslot = NEXT_LINK_INVALID;
       /* Add the slotframe to the global list */
       list_add(slotframe_list, sf);
     }
@@ -195,8 +199,16 @@ tsch_schedule_add_link(struct tsch_slotframe *slotframe,
       } else {
         static int current_link_handle = 0;
         struct tsch_neighbor *n;
-        /* Add the link to the slotframe */
-        list_add(slotframe->links_list, l);
+        struct tsch_link *prev = NULL;
+        struct tsch_link *next;
+        /* Add the link to the slotframe, keeping links sorted by timeslot */
+        for(next = list_head(slotframe->links_list);
+            next != NULL && next->timeslot < timeslot;
+            next = list_item_next(next)) {
+          prev = next;
+        }
+        list_insert(slotframe->links_list, prev, l);
+        slotframe->next_link_timeslot = NEXT_LINK_INVALID;
         /* Initialize link */
         l->handle = current_link_handle++;
         l->link_options = link_options;
@@ -257,6 +269,7 @@ tsch_schedule_remove_link(struct tsch_slotframe *slotframe, struct tsch_link *l)
 
       list_remove(slotframe->links_list, l);
       memb_free(&link_memb, l);
+      slotframe->next_link_timeslot = NEXT_LINK_INVALID;
 
       /* Release the lock before we update the neighbor (will take the lock) */
       tsch_release_lock();
@@ -308,6 +321,37 @@ tsch_schedule_get_link_by_timeslot(struct tsch_slotframe *slotframe, uint16_t ti
   return NULL;
 }
 /*---------------------------------------------------------------------------*/
+/* Returns the first link of a slotframe after a given timeslot, or the
+ * first link of the slotframe if there is none after it. Called at the end
+ * of every active slot: the search resumes from the result of the previous
+ * call, so that it only steps over the links passed since. */
+static struct tsch_link *
+next_link_in_slotframe(struct tsch_slotframe *sf, uint16_t timeslot)
+{
+  struct tsch_link *l;
+
+  if(sf->next_link_timeslot != NEXT_LINK_INVALID
+     && timeslot >= sf->next_link_timeslot) {
+    l = sf->next_link;
+    if(l == NULL) {
+      /* There were no links after an earlier timeslot already */
+      return list_head(sf->links_list);
+    }
+  } else {
+    /* No hint, or the slotframe has wrapped around */
+    l = list_head(sf->links_list);
+  }
+
+  while(l != NULL && l->timeslot <= timeslot) {
+    l = list_item_next(l);
+  }
+
+  sf->next_link = l;
+  sf->next_link_timeslot = timeslot;
+
+  return l != NULL ? l : list_head(sf->links_list);
+}
+/*---------------------------------------------------------------------------*/
 /* Returns the next active link after a given ASN, and a backup link (for the same ASN, with Rx flag) */
 struct tsch_link *
 tsch_schedule_get_next_active_link(struct asn_t *asn, uint16_t *time_offset,
@@ -325,8 +369,11 @@ tsch_schedule_get_next_active_link(struct asn_t *asn, uint16_t *time_offset,
     while(sf != NULL) {
       /* Get timeslot from ASN, given the slotframe length */
       uint16_t timeslot = ASN_MOD(*asn, sf->size);
-      struct tsch_link *l = list_head(sf->links_list);
-      while(l != NULL) {
+      /* There is at most one link per timeslot and links are sorted by
+       * timeslot: the earliest link of the slotframe is the first one after
+       * the current timeslot */
+      struct tsch_link *l = next_link_in_slotframe(sf, timeslot);
+      if(l != NULL) {
         uint16_t time_to_timeslot =
           l->timeslot > timeslot ?
           l->timeslot - timeslot :
@@ -368,8 +415,6 @@ tsch_schedule_get_next_active_link(struct asn_t *asn, uint16_t *time_offset,
             curr_best = new_best;
           }
         }
-
-        l = list_item_next(l);
       }
       sf = list_item_next(sf);
     }
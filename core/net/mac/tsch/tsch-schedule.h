@@ -120,8 +120,13 @@ struct tsch_slotframe {
   /* Number of timeslots in the slotframe.
    * Stored as struct asn_divisor_t because we often need ASN%size */
   struct asn_divisor_t size;
-  /* List of links belonging to this slotframe */
+  /* List of links belonging to this slotframe, sorted by timeslot */
   LIST_STRUCT(links_list);
+  /* The first link after timeslot next_link_timeslot (NULL if none), kept
+   * so that the search for the next active link resumes where the previous
+   * one ended. next_link_timeslot is 0xffff when the hint is not valid */
+  struct tsch_link *next_link;
+  uint16_t next_link_timeslot;
 };
 
 /********** Functions *********/
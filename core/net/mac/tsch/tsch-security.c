@@ -70,12 +70,29 @@ static aes_key keys[] = {
 };
 #define N_KEYS (sizeof(keys) / sizeof(aes_key))
 
+/* Nonce of our own frames in the current slot, see
+ * tsch_security_prepare_slot(). Frames of neighbors reuse its ASN part */
+static uint8_t slot_nonce[13];
+static struct asn_t slot_asn;
+static uint8_t slot_nonce_valid;
+
+/*---------------------------------------------------------------------------*/
+static int
+in_prepared_slot(const struct asn_t *asn)
+{
+  return slot_nonce_valid
+    && asn->ls4b == slot_asn.ls4b && asn->ms1b == slot_asn.ms1b;
+}
 /*---------------------------------------------------------------------------*/
 static void
 tsch_security_init_nonce(uint8_t *nonce,
     const linkaddr_t *sender, struct asn_t *asn)
 {
   memcpy(nonce, sender, 8);
+  if(in_prepared_slot(asn)) {
+    memcpy(nonce + 8, slot_nonce + 8, 5);
+    return;
+  }
   nonce[8] = asn->ms1b;
   nonce[9] = (asn->ls4b >> 24) & 0xff;
   nonce[10] = (asn->ls4b >> 16) & 0xff;
@@ -83,6 +100,21 @@ tsch_security_init_nonce(uint8_t *nonce,
   nonce[12] = (asn->ls4b) & 0xff;
 }
 /*---------------------------------------------------------------------------*/
+void
+tsch_security_prepare_slot(struct asn_t *asn)
+{
+  slot_nonce_valid = 0;
+  tsch_security_init_nonce(slot_nonce, &linkaddr_node_addr, asn);
+  slot_asn = *asn;
+  slot_nonce_valid = 1;
+  /* Data and ACKs use the same key: have it loaded before the slot.
+   * Drivers keep a key that is set again, so this costs nothing when
+   * the previous slot used it too */
+  if(TSCH_SECURITY_KEY_INDEX_OTHER > 0 && TSCH_SECURITY_KEY_INDEX_OTHER <= N_KEYS) {
+    CCM_STAR.set_key(keys[TSCH_SECURITY_KEY_INDEX_OTHER - 1]);
+  }
+}
+/*---------------------------------------------------------------------------*/
 static int
 tsch_security_check_level(const frame802154_t *frame)
 {
@@ -172,7 +204,11 @@ tsch_security_secure_frame(uint8_t *hdr, uint8_t *outbuf,
     return 0;
   }
 
-  tsch_security_init_nonce(nonce, &linkaddr_node_addr, asn);
+  if(in_prepared_slot(asn)) {
+    memcpy(nonce, slot_nonce, sizeof(slot_nonce));
+  } else {
+    tsch_security_init_nonce(nonce, &linkaddr_node_addr, asn);
+  }
 
   if(with_encryption) {
     a_len = hdrlen;
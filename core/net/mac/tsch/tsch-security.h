@@ -119,6 +119,10 @@ typedef uint8_t aes_key[16];
 
 /********** Functions *********/
 
+/* Prepare the CCM* nonce of the slot at a given ASN, before the radio
+ * operations of the slot start, so that securing and parsing frames in
+ * the slot only has to run the cipher */
+void tsch_security_prepare_slot(struct asn_t *asn);
 int tsch_security_mic_len(const frame802154_t *frame);
 int tsch_security_secure_frame(uint8_t *hdr, uint8_t *outbuf,
     int hdrlen, int datalen, struct asn_t *asn);
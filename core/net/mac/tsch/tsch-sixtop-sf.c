@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         A simple 6P scheduling function, in the spirit of SF0 and MSF:
+ *         the number of dedicated Tx cells to the time source follows the
+ *         queue occupancy and the observed cell usage.
+ */
+
+#include "contiki.h"
+#include "lib/random.h"
+#include "net/mac/tsch/tsch.h"
+#include "net/mac/tsch/tsch-private.h"
+#include "net/mac/tsch/tsch-queue.h"
+#include "net/mac/tsch/tsch-schedule.h"
+#include "net/mac/tsch/tsch-log.h"
+#include "net/mac/tsch/tsch-sixtop.h"
+#include "net/mac/tsch/tsch-sixtop-sf.h"
+
+#if TSCH_LOG_LEVEL >= 1
+#define DEBUG DEBUG_PRINT
+#else /* TSCH_LOG_LEVEL */
+#define DEBUG DEBUG_NONE
+#endif /* TSCH_LOG_LEVEL */
+#include "net/net-debug.h"
+
+#if TSCH_WITH_SIXTOP && TSCH_SIXTOP_WITH_SF
+
+static struct ctimer sf_timer;
+/* The time source we negotiate cells with */
+static linkaddr_t sf_parent;
+/* Tx cells of the 6P slotframe gone through, and used, since the last
+ * assessment. Updated from slot operation */
+static volatile uint16_t num_cells_elapsed;
+static volatile uint16_t num_cells_used;
+
+static void request_callback(const linkaddr_t *peer, uint8_t cmd, uint8_t rc,
+                             const struct tsch_sixtop_cell *cells, uint8_t num_cells);
+
+/*---------------------------------------------------------------------------*/
+void
+tsch_sixtop_sf_link_elapsed(const struct tsch_link *link, int used)
+{
+  if(link->slotframe_handle == TSCH_SIXTOP_SLOTFRAME_HANDLE
+     && (link->link_options & LINK_OPTION_TX)) {
+    num_cells_elapsed++;
+    if(used) {
+      num_cells_used++;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+reset_usage(void)
+{
+  num_cells_elapsed = 0;
+  num_cells_used = 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+add_cell(const linkaddr_t *peer)
+{
+  struct tsch_sixtop_cell candidates[TSCH_SIXTOP_SF_NUM_CANDIDATES];
+  struct tsch_slotframe *sf = tsch_sixtop_get_slotframe();
+  uint8_t num_candidates = 0;
+  uint8_t attempts;
+
+  if(sf == NULL) {
+    return;
+  }
+  /* Propose random timeslots that are free in our schedule */
+  for(attempts = 0; attempts < 4 * TSCH_SIXTOP_SF_NUM_CANDIDATES
+      && num_candidates < TSCH_SIXTOP_SF_NUM_CANDIDATES; attempts++) {
+    uint16_t timeslot = random_rand() % sf->size.val;
+    uint8_t i;
+    for(i = 0; i < num_candidates && candidates[i].timeslot != timeslot; i++);
+    if(i == num_candidates && tsch_schedule_get_link_by_timeslot(sf, timeslot) == NULL) {
+      candidates[num_candidates].timeslot = timeslot;
+      candidates[num_candidates].channel_offset = 1 + random_rand() % TSCH_SIXTOP_SF_NUM_CHANNEL_OFFSETS;
+      num_candidates++;
+    }
+  }
+  if(num_candidates > 0) {
+    tsch_sixtop_request(peer, TSCH_SIXTOP_CMD_ADD, TSCH_SIXTOP_CELL_OPTION_TX, 1,
+                        candidates, num_candidates, request_callback);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+delete_cell(const linkaddr_t *peer)
+{
+  struct tsch_slotframe *sf;
+  struct tsch_link *l;
+
+  sf = tsch_schedule_get_slotframe_by_handle(TSCH_SIXTOP_SLOTFRAME_HANDLE);
+  if(sf == NULL) {
+    return;
+  }
+  for(l = list_head(sf->links_list); l != NULL; l = list_item_next(l)) {
+    if(linkaddr_cmp(&l->addr, peer) && (l->link_options & LINK_OPTION_TX)) {
+      struct tsch_sixtop_cell cell;
+      cell.timeslot = l->timeslot;
+      cell.channel_offset = l->channel_offset;
+      tsch_sixtop_request(peer, TSCH_SIXTOP_CMD_DELETE, TSCH_SIXTOP_CELL_OPTION_TX, 1,
+                          &cell, 1, request_callback);
+      return;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+request_callback(const linkaddr_t *peer, uint8_t cmd, uint8_t rc,
+                 const struct tsch_sixtop_cell *cells, uint8_t num_cells)
+{
+  PRINTF("TSCH-SF: cmd %u to %u done, rc %u, %u Tx cells\n",
+         cmd, TSCH_LOG_ID_FROM_LINKADDR(peer), rc,
+         tsch_sixtop_count_links(peer, LINK_OPTION_TX));
+  if(rc == TSCH_SIXTOP_RC_ERR_SEQNUM || rc == TSCH_SIXTOP_RC_ERR_CELLLIST) {
+    /* Our schedule with this neighbor does not match its own, start over */
+    tsch_sixtop_request(peer, TSCH_SIXTOP_CMD_CLEAR, 0, 0, NULL, 0, request_callback);
+  }
+  /* Assess usage afresh with the new number of cells */
+  reset_usage();
+}
+/*---------------------------------------------------------------------------*/
+static void
+housekeeping(void *ptr)
+{
+  struct tsch_neighbor *n;
+  const linkaddr_t *parent;
+  int num_cells;
+
+  ctimer_reset(&sf_timer);
+
+  if(!tsch_is_associated || tsch_sixtop_is_busy()) {
+    return;
+  }
+
+  n = tsch_queue_get_time_source();
+  parent = n != NULL ? &n->addr : &linkaddr_null;
+  if(!linkaddr_cmp(parent, &sf_parent)) {
+    /* The time source changed, release our cells with the former one */
+    if(!linkaddr_cmp(&sf_parent, &linkaddr_null)
+       && !tsch_sixtop_request(&sf_parent, TSCH_SIXTOP_CMD_CLEAR, 0, 0, NULL, 0, request_callback)) {
+      tsch_sixtop_remove_links(&sf_parent);
+    }
+    linkaddr_copy(&sf_parent, parent);
+    reset_usage();
+    return;
+  }
+  if(n == NULL) {
+    return;
+  }
+
+  num_cells = tsch_sixtop_count_links(&sf_parent, LINK_OPTION_TX);
+  if(num_cells < TSCH_SIXTOP_SF_MIN_CELLS) {
+    add_cell(&sf_parent);
+  } else if(num_cells < TSCH_SIXTOP_SF_MAX_CELLS
+            && tsch_queue_packet_count(&sf_parent) >= TSCH_SIXTOP_SF_QUEUE_THRESHOLD) {
+    /* Packets are piling up, do not wait for the usage assessment */
+    add_cell(&sf_parent);
+  } else if(num_cells_elapsed >= TSCH_SIXTOP_SF_NUM_CELLS) {
+    if(num_cells_used > TSCH_SIXTOP_SF_USED_HIGH && num_cells < TSCH_SIXTOP_SF_MAX_CELLS) {
+      add_cell(&sf_parent);
+    } else if(num_cells_used < TSCH_SIXTOP_SF_USED_LOW && num_cells > TSCH_SIXTOP_SF_MIN_CELLS) {
+      delete_cell(&sf_parent);
+    }
+    reset_usage();
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_sixtop_sf_reset(void)
+{
+  linkaddr_copy(&sf_parent, &linkaddr_null);
+  reset_usage();
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_sixtop_sf_init(void)
+{
+  tsch_sixtop_sf_reset();
+  ctimer_set(&sf_timer, TSCH_SIXTOP_SF_PERIOD, housekeeping, NULL);
+}
+
+#endif /* TSCH_WITH_SIXTOP && TSCH_SIXTOP_WITH_SF */
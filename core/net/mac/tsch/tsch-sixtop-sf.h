@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         A simple 6P scheduling function. Each node negotiates dedicated
+ *         Tx cells to its time source, adding cells when its queue to the
+ *         time source builds up or when it uses most of the cells it has,
+ *         and deleting cells that mostly go unused.
+ */
+
+#ifndef __TSCH_SIXTOP_SF_H__
+#define __TSCH_SIXTOP_SF_H__
+
+/********** Includes **********/
+
+#include "contiki.h"
+#include "net/mac/tsch/tsch-schedule.h"
+#include "net/mac/tsch/tsch-sixtop.h"
+
+/******** Configuration *******/
+
+/* Period of the scheduling function housekeeping */
+#ifdef TSCH_SIXTOP_SF_CONF_PERIOD
+#define TSCH_SIXTOP_SF_PERIOD TSCH_SIXTOP_SF_CONF_PERIOD
+#else
+#define TSCH_SIXTOP_SF_PERIOD (4 * CLOCK_SECOND)
+#endif
+
+/* Min and max number of Tx cells to the time source */
+#ifdef TSCH_SIXTOP_SF_CONF_MIN_CELLS
+#define TSCH_SIXTOP_SF_MIN_CELLS TSCH_SIXTOP_SF_CONF_MIN_CELLS
+#else
+#define TSCH_SIXTOP_SF_MIN_CELLS 1
+#endif
+
+#ifdef TSCH_SIXTOP_SF_CONF_MAX_CELLS
+#define TSCH_SIXTOP_SF_MAX_CELLS TSCH_SIXTOP_SF_CONF_MAX_CELLS
+#else
+#define TSCH_SIXTOP_SF_MAX_CELLS 8
+#endif
+
+/* Add a cell right away when at least this many packets are queued for
+ * the time source */
+#ifdef TSCH_SIXTOP_SF_CONF_QUEUE_THRESHOLD
+#define TSCH_SIXTOP_SF_QUEUE_THRESHOLD TSCH_SIXTOP_SF_CONF_QUEUE_THRESHOLD
+#else
+#define TSCH_SIXTOP_SF_QUEUE_THRESHOLD 4
+#endif
+
+/* Cell usage is assessed every TSCH_SIXTOP_SF_NUM_CELLS elapsed Tx cells.
+ * A cell is added when more than TSCH_SIXTOP_SF_USED_HIGH of them were used
+ * to transmit, one is deleted when less than TSCH_SIXTOP_SF_USED_LOW were */
+#ifdef TSCH_SIXTOP_SF_CONF_NUM_CELLS
+#define TSCH_SIXTOP_SF_NUM_CELLS TSCH_SIXTOP_SF_CONF_NUM_CELLS
+#else
+#define TSCH_SIXTOP_SF_NUM_CELLS 16
+#endif
+
+#ifdef TSCH_SIXTOP_SF_CONF_USED_HIGH
+#define TSCH_SIXTOP_SF_USED_HIGH TSCH_SIXTOP_SF_CONF_USED_HIGH
+#else
+#define TSCH_SIXTOP_SF_USED_HIGH 12
+#endif
+
+#ifdef TSCH_SIXTOP_SF_CONF_USED_LOW
+#define TSCH_SIXTOP_SF_USED_LOW TSCH_SIXTOP_SF_CONF_USED_LOW
+#else
+#define TSCH_SIXTOP_SF_USED_LOW 4
+#endif
+
+/* Number of candidate cells proposed in an ADD request */
+#ifdef TSCH_SIXTOP_SF_CONF_NUM_CANDIDATES
+#define TSCH_SIXTOP_SF_NUM_CANDIDATES TSCH_SIXTOP_SF_CONF_NUM_CANDIDATES
+#else
+#define TSCH_SIXTOP_SF_NUM_CANDIDATES 3
+#endif
+
+/* Cells get a random channel offset in [1, TSCH_SIXTOP_SF_NUM_CHANNEL_OFFSETS],
+ * leaving channel offset 0 to the minimal schedule */
+#ifdef TSCH_SIXTOP_SF_CONF_NUM_CHANNEL_OFFSETS
+#define TSCH_SIXTOP_SF_NUM_CHANNEL_OFFSETS TSCH_SIXTOP_SF_CONF_NUM_CHANNEL_OFFSETS
+#else
+#define TSCH_SIXTOP_SF_NUM_CHANNEL_OFFSETS 15
+#endif
+
+/********** Functions *********/
+
+/* Module initialization, called by 6P */
+void tsch_sixtop_sf_init(void);
+/* Forget the time source and usage statistics, called by 6P */
+void tsch_sixtop_sf_reset(void);
+/* Called from slot operation for every link it goes through, telling
+ * whether a packet was sent in it */
+void tsch_sixtop_sf_link_elapsed(const struct tsch_link *link, int used);
+
+#endif /* __TSCH_SIXTOP_SF_H__ */
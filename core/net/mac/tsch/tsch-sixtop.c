@@ -0,0 +1,585 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         6P, the 6top Protocol (RFC 8480). Supports the ADD, DELETE and
+ *         CLEAR commands in two-step transactions. Cells are installed in
+ *         the 6P slotframe by the requester when receiving a successful
+ *         response, and by the responder once the response is acknowledged.
+ */
+
+#include "contiki.h"
+#include "net/packetbuf.h"
+#include "net/netstack.h"
+#include "net/nbr-table.h"
+#include "net/mac/mac-sequence.h"
+#include "net/mac/frame802154e-ie.h"
+#include "net/mac/tsch/tsch.h"
+#include "net/mac/tsch/tsch-private.h"
+#include "net/mac/tsch/tsch-schedule.h"
+#include "net/mac/tsch/tsch-log.h"
+#include "net/mac/tsch/tsch-sixtop.h"
+#include "net/mac/tsch/tsch-sixtop-sf.h"
+#include <string.h>
+
+#if TSCH_LOG_LEVEL >= 1
+#define DEBUG DEBUG_PRINT
+#else /* TSCH_LOG_LEVEL */
+#define DEBUG DEBUG_NONE
+#endif /* TSCH_LOG_LEVEL */
+#include "net/net-debug.h"
+
+#if TSCH_WITH_SIXTOP
+
+#define SIXTOP_VERSION      0
+/* Version, type, code, SFID and SeqNum */
+#define SIXTOP_HDR_LEN      4
+/* Metadata, cell options and number of cells */
+#define SIXTOP_REQ_HDR_LEN  4
+#define SIXTOP_CELL_LEN     4
+#define SIXTOP_MAX_LEN      (SIXTOP_HDR_LEN + SIXTOP_REQ_HDR_LEN \
+                             + TSCH_SIXTOP_MAX_CELLS * SIXTOP_CELL_LEN)
+
+#define WRITE16(buf, val) \
+  do { ((uint8_t *)(buf))[0] = (val) & 0xff; \
+       ((uint8_t *)(buf))[1] = ((val) >> 8) & 0xff; } while(0);
+
+#define READ16(buf, var) \
+  (var) = ((uint8_t *)(buf))[0] | ((uint8_t *)(buf))[1] << 8
+
+/* Per-neighbor 6P state. SeqNum is shared by the transactions in both
+ * directions and is 0 only after a CLEAR or a reset */
+struct sixtop_nbr {
+  uint8_t seqnum;
+};
+NBR_TABLE(struct sixtop_nbr, sixtop_nbrs);
+static uint8_t sixtop_nbrs_registered;
+
+/* The transaction we requested, if any */
+static struct {
+  linkaddr_t peer;
+  uint8_t busy;
+  uint8_t cmd;
+  uint8_t seqnum;
+  uint8_t cell_options;
+  tsch_sixtop_callback_t callback;
+  struct ctimer timer;
+} req;
+
+/* The response we are sending. Its cells are applied to the schedule
+ * only once the response is acknowledged */
+static struct {
+  linkaddr_t peer;
+  uint8_t busy;
+  uint8_t cmd;
+  uint8_t cell_options;
+  uint8_t num_cells;
+  struct tsch_sixtop_cell cells[TSCH_SIXTOP_MAX_CELLS];
+} resp;
+
+/*---------------------------------------------------------------------------*/
+static struct sixtop_nbr *
+get_nbr(const linkaddr_t *addr)
+{
+  struct sixtop_nbr *nbr = nbr_table_get_from_lladdr(sixtop_nbrs, addr);
+  if(nbr == NULL) {
+    nbr = nbr_table_add_lladdr(sixtop_nbrs, addr, NBR_TABLE_REASON_MAC, NULL);
+    if(nbr != NULL) {
+      nbr->seqnum = 0;
+    }
+  }
+  return nbr;
+}
+/*---------------------------------------------------------------------------*/
+static void
+increment_seqnum(const linkaddr_t *addr)
+{
+  struct sixtop_nbr *nbr = get_nbr(addr);
+  if(nbr != NULL) {
+    /* Skip 0 when wrapping, it is reserved for after a CLEAR */
+    nbr->seqnum = nbr->seqnum == 0xff ? 1 : nbr->seqnum + 1;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+reset_seqnum(const linkaddr_t *addr)
+{
+  struct sixtop_nbr *nbr = get_nbr(addr);
+  if(nbr != NULL) {
+    nbr->seqnum = 0;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Cell options are expressed from the point of view of the requester */
+static uint8_t
+to_link_options(uint8_t cell_options, int is_requester)
+{
+  uint8_t link_options = 0;
+  if(cell_options & TSCH_SIXTOP_CELL_OPTION_TX) {
+    link_options |= is_requester ? LINK_OPTION_TX : LINK_OPTION_RX;
+  }
+  if(cell_options & TSCH_SIXTOP_CELL_OPTION_RX) {
+    link_options |= is_requester ? LINK_OPTION_RX : LINK_OPTION_TX;
+  }
+  if(cell_options & TSCH_SIXTOP_CELL_OPTION_SHARED) {
+    link_options |= LINK_OPTION_SHARED;
+  }
+  return link_options;
+}
+/*---------------------------------------------------------------------------*/
+struct tsch_slotframe *
+tsch_sixtop_get_slotframe(void)
+{
+  struct tsch_slotframe *sf;
+  sf = tsch_schedule_get_slotframe_by_handle(TSCH_SIXTOP_SLOTFRAME_HANDLE);
+  if(sf == NULL) {
+    sf = tsch_schedule_add_slotframe(TSCH_SIXTOP_SLOTFRAME_HANDLE,
+                                     TSCH_SIXTOP_SLOTFRAME_LENGTH);
+  }
+  return sf;
+}
+/*---------------------------------------------------------------------------*/
+int
+tsch_sixtop_count_links(const linkaddr_t *peer, uint8_t link_options)
+{
+  int count = 0;
+  struct tsch_link *l;
+  struct tsch_slotframe *sf;
+
+  sf = tsch_schedule_get_slotframe_by_handle(TSCH_SIXTOP_SLOTFRAME_HANDLE);
+  if(sf != NULL) {
+    for(l = list_head(sf->links_list); l != NULL; l = list_item_next(l)) {
+      if(linkaddr_cmp(&l->addr, peer)
+         && (l->link_options & link_options) == link_options) {
+        count++;
+      }
+    }
+  }
+  return count;
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_sixtop_remove_links(const linkaddr_t *peer)
+{
+  struct tsch_link *l;
+  struct tsch_slotframe *sf;
+
+  sf = tsch_schedule_get_slotframe_by_handle(TSCH_SIXTOP_SLOTFRAME_HANDLE);
+  if(sf == NULL) {
+    return;
+  }
+  l = list_head(sf->links_list);
+  while(l != NULL) {
+    struct tsch_link *next = list_item_next(l);
+    if(linkaddr_cmp(&l->addr, peer)) {
+      tsch_schedule_remove_link(sf, l);
+    }
+    l = next;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t
+add_links(const linkaddr_t *peer, uint8_t link_options,
+          const struct tsch_sixtop_cell *cells, uint8_t num_cells)
+{
+  uint8_t i;
+  uint8_t added = 0;
+  struct tsch_slotframe *sf = tsch_sixtop_get_slotframe();
+
+  for(i = 0; sf != NULL && i < num_cells; i++) {
+    if(tsch_schedule_add_link(sf, link_options, LINK_TYPE_NORMAL, peer,
+                              cells[i].timeslot, cells[i].channel_offset) != NULL) {
+      added++;
+    }
+  }
+  return added;
+}
+/*---------------------------------------------------------------------------*/
+static void
+remove_links(const linkaddr_t *peer,
+             const struct tsch_sixtop_cell *cells, uint8_t num_cells)
+{
+  uint8_t i;
+  struct tsch_slotframe *sf;
+
+  sf = tsch_schedule_get_slotframe_by_handle(TSCH_SIXTOP_SLOTFRAME_HANDLE);
+  for(i = 0; sf != NULL && i < num_cells; i++) {
+    struct tsch_link *l = tsch_schedule_get_link_by_timeslot(sf, cells[i].timeslot);
+    if(l != NULL && linkaddr_cmp(&l->addr, peer)) {
+      tsch_schedule_remove_link(sf, l);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+write_header(uint8_t *buf, uint8_t type, uint8_t code, uint8_t seqnum)
+{
+  buf[0] = (SIXTOP_VERSION & 0x0f) | ((type & 0x03) << 4);
+  buf[1] = code;
+  buf[2] = TSCH_SIXTOP_SFID;
+  buf[3] = seqnum;
+  return SIXTOP_HDR_LEN;
+}
+/*---------------------------------------------------------------------------*/
+static int
+write_cells(uint8_t *buf, const struct tsch_sixtop_cell *cells, uint8_t num_cells)
+{
+  uint8_t i;
+  for(i = 0; i < num_cells; i++) {
+    WRITE16(buf + i * SIXTOP_CELL_LEN, cells[i].timeslot);
+    WRITE16(buf + i * SIXTOP_CELL_LEN + 2, cells[i].channel_offset);
+  }
+  return num_cells * SIXTOP_CELL_LEN;
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t
+read_cells(const uint8_t *buf, uint16_t len, struct tsch_sixtop_cell *cells)
+{
+  uint8_t i;
+  uint8_t num_cells = len / SIXTOP_CELL_LEN;
+  if(num_cells > TSCH_SIXTOP_MAX_CELLS) {
+    num_cells = TSCH_SIXTOP_MAX_CELLS;
+  }
+  for(i = 0; i < num_cells; i++) {
+    READ16(buf + i * SIXTOP_CELL_LEN, cells[i].timeslot);
+    READ16(buf + i * SIXTOP_CELL_LEN + 2, cells[i].channel_offset);
+  }
+  return num_cells;
+}
+/*---------------------------------------------------------------------------*/
+static void
+end_request(uint8_t rc, const struct tsch_sixtop_cell *cells, uint8_t num_cells)
+{
+  req.busy = 0;
+  ctimer_stop(&req.timer);
+  PRINTF("TSCH-6P: transaction with %u ended, cmd %u rc %u cells %u\n",
+         TSCH_LOG_ID_FROM_LINKADDR(&req.peer), req.cmd, rc, num_cells);
+  if(req.callback != NULL) {
+    req.callback(&req.peer, req.cmd, rc, cells, num_cells);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+request_timeout(void *ptr)
+{
+  if(req.busy) {
+    /* The requester clears its side regardless of the response */
+    if(req.cmd == TSCH_SIXTOP_CMD_CLEAR) {
+      tsch_sixtop_remove_links(&req.peer);
+      reset_seqnum(&req.peer);
+    }
+    end_request(TSCH_SIXTOP_RC_TIMEOUT, NULL, 0);
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+tsch_sixtop_request(const linkaddr_t *peer, uint8_t cmd,
+                    uint8_t cell_options, uint8_t num_cells,
+                    const struct tsch_sixtop_cell *cells,
+                    uint8_t cells_len, tsch_sixtop_callback_t callback)
+{
+  uint8_t buf[SIXTOP_MAX_LEN];
+  struct sixtop_nbr *nbr;
+  int len;
+
+  if(req.busy || peer == NULL || cells_len > TSCH_SIXTOP_MAX_CELLS
+     || (cmd != TSCH_SIXTOP_CMD_ADD && cmd != TSCH_SIXTOP_CMD_DELETE
+         && cmd != TSCH_SIXTOP_CMD_CLEAR)) {
+    return 0;
+  }
+  if((nbr = get_nbr(peer)) == NULL) {
+    PRINTF("TSCH-6P:! no room for neighbor %u\n", TSCH_LOG_ID_FROM_LINKADDR(peer));
+    return 0;
+  }
+
+  len = write_header(buf, TSCH_SIXTOP_TYPE_REQUEST, cmd, nbr->seqnum);
+  /* Metadata, unused */
+  WRITE16(buf + len, 0);
+  len += 2;
+  if(cmd != TSCH_SIXTOP_CMD_CLEAR) {
+    buf[len++] = cell_options;
+    buf[len++] = num_cells;
+    len += write_cells(buf + len, cells, cells_len);
+  }
+
+  if(!tsch_send_sixtop(peer, buf, len, NULL, NULL)) {
+    return 0;
+  }
+
+  linkaddr_copy(&req.peer, peer);
+  req.busy = 1;
+  req.cmd = cmd;
+  req.seqnum = nbr->seqnum;
+  req.cell_options = cell_options;
+  req.callback = callback;
+  ctimer_set(&req.timer, TSCH_SIXTOP_TIMEOUT, request_timeout, NULL);
+
+  PRINTF("TSCH-6P: request to %u, cmd %u seqnum %u cells %u/%u\n",
+         TSCH_LOG_ID_FROM_LINKADDR(peer), cmd, nbr->seqnum, num_cells, cells_len);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+int
+tsch_sixtop_is_busy(void)
+{
+  return req.busy;
+}
+/*---------------------------------------------------------------------------*/
+static void
+response_sent(void *ptr, int status, int transmissions)
+{
+  if(!resp.busy) {
+    return;
+  }
+  resp.busy = 0;
+  if(status != MAC_TX_OK) {
+    PRINTF("TSCH-6P:! response to %u not acknowledged, st %d-%d\n",
+           TSCH_LOG_ID_FROM_LINKADDR(&resp.peer), status, transmissions);
+    return;
+  }
+  if(resp.cmd == TSCH_SIXTOP_CMD_ADD) {
+    add_links(&resp.peer, to_link_options(resp.cell_options, 0),
+              resp.cells, resp.num_cells);
+  } else if(resp.cmd == TSCH_SIXTOP_CMD_DELETE) {
+    remove_links(&resp.peer, resp.cells, resp.num_cells);
+  }
+  increment_seqnum(&resp.peer);
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_response(const linkaddr_t *peer, uint8_t rc, uint8_t seqnum,
+              const struct tsch_sixtop_cell *cells, uint8_t num_cells,
+              mac_callback_t sent)
+{
+  uint8_t buf[SIXTOP_MAX_LEN];
+  int len;
+
+  len = write_header(buf, TSCH_SIXTOP_TYPE_RESPONSE, rc, seqnum);
+  len += write_cells(buf + len, cells, num_cells);
+
+  PRINTF("TSCH-6P: response to %u, rc %u seqnum %u cells %u\n",
+         TSCH_LOG_ID_FROM_LINKADDR(peer), rc, seqnum, num_cells);
+  if(!tsch_send_sixtop(peer, buf, len, sent, NULL) && sent != NULL) {
+    sent(NULL, MAC_TX_ERR, 0);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+request_input(const linkaddr_t *src, uint8_t version, uint8_t cmd,
+              uint8_t sfid, uint8_t seqnum, const uint8_t *buf, uint16_t len)
+{
+  struct tsch_sixtop_cell cells[TSCH_SIXTOP_MAX_CELLS];
+  struct tsch_slotframe *sf;
+  struct sixtop_nbr *nbr;
+  uint8_t cell_options;
+  uint8_t num_cells;
+  uint8_t cells_len;
+  uint8_t i;
+
+  if(version != SIXTOP_VERSION) {
+    send_response(src, TSCH_SIXTOP_RC_ERR_VERSION, seqnum, NULL, 0, NULL);
+    return;
+  }
+  if(sfid != TSCH_SIXTOP_SFID) {
+    send_response(src, TSCH_SIXTOP_RC_ERR_SFID, seqnum, NULL, 0, NULL);
+    return;
+  }
+  if((nbr = get_nbr(src)) == NULL) {
+    send_response(src, TSCH_SIXTOP_RC_ERR_BUSY, seqnum, NULL, 0, NULL);
+    return;
+  }
+
+  if(cmd == TSCH_SIXTOP_CMD_CLEAR) {
+    /* The responder clears its side right away */
+    tsch_sixtop_remove_links(src);
+    nbr->seqnum = 0;
+    send_response(src, TSCH_SIXTOP_RC_SUCCESS, seqnum, NULL, 0, NULL);
+    return;
+  }
+
+  if((cmd != TSCH_SIXTOP_CMD_ADD && cmd != TSCH_SIXTOP_CMD_DELETE)
+     || len < SIXTOP_REQ_HDR_LEN) {
+    send_response(src, TSCH_SIXTOP_RC_ERR, seqnum, NULL, 0, NULL);
+    return;
+  }
+  if(seqnum != nbr->seqnum) {
+    /* Schedule inconsistency, the requester is expected to CLEAR */
+    send_response(src, TSCH_SIXTOP_RC_ERR_SEQNUM, seqnum, NULL, 0, NULL);
+    return;
+  }
+  if(resp.busy || (sf = tsch_sixtop_get_slotframe()) == NULL) {
+    send_response(src, TSCH_SIXTOP_RC_ERR_BUSY, seqnum, NULL, 0, NULL);
+    return;
+  }
+
+  /* Skip metadata */
+  cell_options = buf[2];
+  num_cells = buf[3];
+  cells_len = read_cells(buf + SIXTOP_REQ_HDR_LEN, len - SIXTOP_REQ_HDR_LEN, cells);
+
+  resp.num_cells = 0;
+  for(i = 0; i < cells_len && resp.num_cells < num_cells; i++) {
+    struct tsch_link *l = tsch_schedule_get_link_by_timeslot(sf, cells[i].timeslot);
+    int select;
+    if(cmd == TSCH_SIXTOP_CMD_ADD) {
+      /* Pick candidates that are free in our schedule */
+      select = l == NULL && cells[i].timeslot < sf->size.val;
+    } else {
+      /* Only delete cells we actually have with the requester */
+      select = l != NULL && linkaddr_cmp(&l->addr, src);
+    }
+    if(select) {
+      resp.cells[resp.num_cells++] = cells[i];
+    }
+  }
+
+  if(cmd == TSCH_SIXTOP_CMD_DELETE && resp.num_cells == 0) {
+    send_response(src, TSCH_SIXTOP_RC_ERR_CELLLIST, seqnum, NULL, 0, NULL);
+    return;
+  }
+
+  linkaddr_copy(&resp.peer, src);
+  resp.busy = 1;
+  resp.cmd = cmd;
+  resp.cell_options = cell_options;
+  send_response(src, TSCH_SIXTOP_RC_SUCCESS, seqnum,
+                resp.cells, resp.num_cells, response_sent);
+}
+/*---------------------------------------------------------------------------*/
+static void
+response_input(const linkaddr_t *src, uint8_t rc, uint8_t seqnum,
+               const uint8_t *buf, uint16_t len)
+{
+  struct tsch_sixtop_cell cells[TSCH_SIXTOP_MAX_CELLS];
+  uint8_t num_cells;
+
+  if(!req.busy || !linkaddr_cmp(src, &req.peer) || seqnum != req.seqnum) {
+    PRINTF("TSCH-6P:! unexpected response from %u seqnum %u\n",
+           TSCH_LOG_ID_FROM_LINKADDR(src), seqnum);
+    return;
+  }
+
+  num_cells = read_cells(buf, len, cells);
+  if(req.cmd == TSCH_SIXTOP_CMD_CLEAR) {
+    tsch_sixtop_remove_links(src);
+    reset_seqnum(src);
+  } else if(rc == TSCH_SIXTOP_RC_SUCCESS) {
+    if(req.cmd == TSCH_SIXTOP_CMD_ADD) {
+      add_links(src, to_link_options(req.cell_options, 1), cells, num_cells);
+    } else {
+      remove_links(src, cells, num_cells);
+    }
+    increment_seqnum(src);
+  }
+  end_request(rc, cells, num_cells);
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_sixtop_input(void)
+{
+  /* Copied out of packetbuf, which is needed to reply */
+  uint8_t buf[SIXTOP_MAX_LEN];
+  uint16_t len;
+  linkaddr_t src;
+  struct ieee802154_ies ies;
+  uint8_t version;
+  uint8_t type;
+
+  if(NETSTACK_FRAMER.parse() < 0) {
+    PRINTF("TSCH-6P:! failed to parse %u\n", packetbuf_datalen());
+    return;
+  }
+  /* Seqno of 0xffff means no seqno */
+  if(packetbuf_attr(PACKETBUF_ATTR_MAC_SEQNO) != 0xffff) {
+    if(mac_sequence_is_duplicate()) {
+      PRINTF("TSCH-6P:! drop dup from %u seqno %u\n",
+             TSCH_LOG_ID_FROM_LINKADDR(packetbuf_addr(PACKETBUF_ADDR_SENDER)),
+             packetbuf_attr(PACKETBUF_ATTR_MAC_SEQNO));
+      return;
+    }
+    mac_sequence_register_seqno();
+  }
+
+  memset(&ies, 0, sizeof(ies));
+  if(frame802154e_parse_information_elements(packetbuf_dataptr(), packetbuf_datalen(), &ies) < 0
+     || ies.ie_sixtop == NULL || ies.ie_sixtop_len < SIXTOP_HDR_LEN) {
+    PRINTF("TSCH-6P:! no 6P message\n");
+    return;
+  }
+  len = MIN(ies.ie_sixtop_len, SIXTOP_MAX_LEN);
+  memcpy(buf, ies.ie_sixtop, len);
+  linkaddr_copy(&src, packetbuf_addr(PACKETBUF_ADDR_SENDER));
+
+  version = buf[0] & 0x0f;
+  type = (buf[0] >> 4) & 0x03;
+  if(type == TSCH_SIXTOP_TYPE_REQUEST) {
+    request_input(&src, version, buf[1], buf[2], buf[3],
+                  buf + SIXTOP_HDR_LEN, len - SIXTOP_HDR_LEN);
+  } else if(type == TSCH_SIXTOP_TYPE_RESPONSE && version == SIXTOP_VERSION) {
+    response_input(&src, buf[1], buf[3], buf + SIXTOP_HDR_LEN, len - SIXTOP_HDR_LEN);
+  } else {
+    /* We only run two-step transactions */
+    PRINTF("TSCH-6P:! unsupported message type %u\n", type);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_sixtop_reset(void)
+{
+  struct sixtop_nbr *nbr;
+
+  req.busy = 0;
+  ctimer_stop(&req.timer);
+  resp.busy = 0;
+  /* TSCH resets before initializing its sub-modules */
+  nbr = sixtop_nbrs_registered ? nbr_table_head(sixtop_nbrs) : NULL;
+  while(nbr != NULL) {
+    struct sixtop_nbr *next = nbr_table_next(sixtop_nbrs, nbr);
+    nbr_table_remove(sixtop_nbrs, nbr);
+    nbr = next;
+  }
+#if TSCH_SIXTOP_WITH_SF
+  tsch_sixtop_sf_reset();
+#endif
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_sixtop_init(void)
+{
+  sixtop_nbrs_registered = nbr_table_register(sixtop_nbrs, NULL);
+#if TSCH_SIXTOP_WITH_SF
+  tsch_sixtop_sf_init();
+#endif
+}
+
+#endif /* TSCH_WITH_SIXTOP */
@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         6P, the 6top Protocol (RFC 8480): two-step transactions through
+ *         which neighbors add, delete and clear cells of a dedicated
+ *         slotframe. Which cells to request, and when, is decided by a
+ *         scheduling function (see tsch-sixtop-sf.h).
+ */
+
+#ifndef __TSCH_SIXTOP_H__
+#define __TSCH_SIXTOP_H__
+
+/********** Includes **********/
+
+#include "contiki.h"
+#include "net/linkaddr.h"
+#include "net/mac/tsch/tsch-conf.h"
+#include "net/mac/tsch/tsch-schedule.h"
+
+/******** Configuration *******/
+
+/* Run the built-in scheduling function on top of 6P (see tsch-sixtop-sf.h).
+ * Disable when the application drives 6P itself */
+#ifdef TSCH_SIXTOP_CONF_WITH_SF
+#define TSCH_SIXTOP_WITH_SF TSCH_SIXTOP_CONF_WITH_SF
+#else
+#define TSCH_SIXTOP_WITH_SF 1
+#endif
+
+/* Handle of the slotframe holding the cells negotiated with 6P */
+#ifdef TSCH_SIXTOP_CONF_SLOTFRAME_HANDLE
+#define TSCH_SIXTOP_SLOTFRAME_HANDLE TSCH_SIXTOP_CONF_SLOTFRAME_HANDLE
+#else
+#define TSCH_SIXTOP_SLOTFRAME_HANDLE 1
+#endif
+
+/* Length of the 6P slotframe. The slotframe is created on demand, after
+ * the minimal schedule has been installed */
+#ifdef TSCH_SIXTOP_CONF_SLOTFRAME_LENGTH
+#define TSCH_SIXTOP_SLOTFRAME_LENGTH TSCH_SIXTOP_CONF_SLOTFRAME_LENGTH
+#else
+#define TSCH_SIXTOP_SLOTFRAME_LENGTH 17
+#endif
+
+/* Scheduling Function identifier sent in and expected from 6P messages */
+#ifdef TSCH_SIXTOP_CONF_SFID
+#define TSCH_SIXTOP_SFID TSCH_SIXTOP_CONF_SFID
+#else
+#define TSCH_SIXTOP_SFID 0
+#endif
+
+/* Max number of cells in the cell list of a 6P message */
+#ifdef TSCH_SIXTOP_CONF_MAX_CELLS
+#define TSCH_SIXTOP_MAX_CELLS TSCH_SIXTOP_CONF_MAX_CELLS
+#else
+#define TSCH_SIXTOP_MAX_CELLS 4
+#endif
+
+/* How long a requester waits for a 6P response before giving up */
+#ifdef TSCH_SIXTOP_CONF_TIMEOUT
+#define TSCH_SIXTOP_TIMEOUT TSCH_SIXTOP_CONF_TIMEOUT
+#else
+#define TSCH_SIXTOP_TIMEOUT (10 * CLOCK_SECOND)
+#endif
+
+/********** Constants *********/
+
+/* 6P message types */
+#define TSCH_SIXTOP_TYPE_REQUEST       0
+#define TSCH_SIXTOP_TYPE_RESPONSE      1
+#define TSCH_SIXTOP_TYPE_CONFIRMATION  2
+
+/* 6P commands (the subset we support) */
+#define TSCH_SIXTOP_CMD_ADD            1
+#define TSCH_SIXTOP_CMD_DELETE         2
+#define TSCH_SIXTOP_CMD_CLEAR          7
+
+/* 6P return codes */
+#define TSCH_SIXTOP_RC_SUCCESS         0
+#define TSCH_SIXTOP_RC_EOL             1
+#define TSCH_SIXTOP_RC_ERR             2
+#define TSCH_SIXTOP_RC_RESET           3
+#define TSCH_SIXTOP_RC_ERR_VERSION     4
+#define TSCH_SIXTOP_RC_ERR_SFID        5
+#define TSCH_SIXTOP_RC_ERR_SEQNUM      6
+#define TSCH_SIXTOP_RC_ERR_CELLLIST    7
+#define TSCH_SIXTOP_RC_ERR_BUSY        8
+#define TSCH_SIXTOP_RC_ERR_LOCKED      9
+/* Not a 6P return code: reported locally when no response came in time */
+#define TSCH_SIXTOP_RC_TIMEOUT         0xff
+
+/* 6P cell options, from the point of view of the requester */
+#define TSCH_SIXTOP_CELL_OPTION_TX     1
+#define TSCH_SIXTOP_CELL_OPTION_RX     2
+#define TSCH_SIXTOP_CELL_OPTION_SHARED 4
+
+/************ Types ***********/
+
+struct tsch_sixtop_cell {
+  uint16_t timeslot;
+  uint16_t channel_offset;
+};
+
+/* Called at the end of a transaction we requested, with the return code
+ * of the response and the cells it listed. The 6P layer has already
+ * updated the schedule accordingly */
+typedef void (* tsch_sixtop_callback_t)(const linkaddr_t *peer, uint8_t cmd,
+                                        uint8_t rc,
+                                        const struct tsch_sixtop_cell *cells,
+                                        uint8_t num_cells);
+
+/********** Functions *********/
+
+/* Module initialization, called by TSCH at startup */
+void tsch_sixtop_init(void);
+/* Abort ongoing transactions and forget sequence numbers, called by TSCH
+ * when leaving the network */
+void tsch_sixtop_reset(void);
+/* Process an incoming 6P frame, placed in packetbuf by TSCH */
+void tsch_sixtop_input(void);
+
+/* Start a transaction with a neighbor. For ADD, cells is the candidate
+ * list, of which the responder picks num_cells. For DELETE, cells lists
+ * the num_cells cells to remove. CLEAR takes no cells. Only one
+ * transaction can be requested at a time. Returns 1 if the request was
+ * sent, 0 otherwise */
+int tsch_sixtop_request(const linkaddr_t *peer, uint8_t cmd,
+                        uint8_t cell_options, uint8_t num_cells,
+                        const struct tsch_sixtop_cell *cells,
+                        uint8_t cells_len, tsch_sixtop_callback_t callback);
+/* Is there a transaction we requested waiting for its response? */
+int tsch_sixtop_is_busy(void);
+
+/* Returns the 6P slotframe, creating it if needed (NULL if failure) */
+struct tsch_slotframe *tsch_sixtop_get_slotframe(void);
+/* Number of links with a neighbor in the 6P slotframe that have all
+ * the given link options */
+int tsch_sixtop_count_links(const linkaddr_t *peer, uint8_t link_options);
+/* Removes all links with a neighbor from the 6P slotframe */
+void tsch_sixtop_remove_links(const linkaddr_t *peer);
+
+#endif /* __TSCH_SIXTOP_H__ */
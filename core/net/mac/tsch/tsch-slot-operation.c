@@ -54,6 +54,10 @@
 #include "net/mac/tsch/tsch-packet.h"
 #include "net/mac/tsch/tsch-security.h"
 #include "net/mac/tsch/tsch-adaptive-timesync.h"
+#include "net/mac/tsch/tsch-sixtop-sf.h"
+#include "net/mac/tsch/tsch-channel-blacklist.h"
+#include "sys/trace.h"
+#include "net/latency-trace.h"
 
 #if TSCH_LOG_LEVEL >= 1
 #define DEBUG DEBUG_PRINT
@@ -167,6 +171,20 @@ static struct tsch_link *backup_link = NULL;
 static struct tsch_packet *current_packet = NULL;
 static struct tsch_neighbor *current_neighbor = NULL;
 
+#if TSCH_BURST_MAX_LEN > 0
+/* Burst state: none, sending to current_neighbor, or receiving */
+enum { BURST_NONE, BURST_TX, BURST_RX };
+/* Set within a slot when a frame with the frame pending bit was
+ * acknowledged: the burst continues in the next timeslot */
+static uint8_t burst_link_scheduled = BURST_NONE;
+/* Is the current (or next) slot the continuation of a burst? */
+static uint8_t current_burst = BURST_NONE;
+/* Number of frames sent in the ongoing burst */
+static uint8_t burst_count = 0;
+/* Frame pending bit, in the first byte of the frame control field */
+#define BURST_FRAME_PENDING_BIT (1 << 4)
+#endif /* TSCH_BURST_MAX_LEN > 0 */
+
 /* Protothread for association */
 PT_THREAD(tsch_scan(struct pt *pt));
 /* Protothread for slot operation, called from rtimer interrupt
@@ -231,6 +249,13 @@ tsch_release_lock(void)
   tsch_locked = 0;
 }
 
+/* Is a slot operation in progress? */
+int
+tsch_is_in_slot_operation(void)
+{
+  return tsch_in_slot_operation;
+}
+
 /*---------------------------------------------------------------------------*/
 /* Channel hopping utility functions */
 
@@ -238,9 +263,13 @@ tsch_release_lock(void)
 uint8_t
 tsch_calculate_channel(struct asn_t *asn, uint8_t channel_offset)
 {
+#if TSCH_WITH_CHANNEL_BLACKLIST
+  return tsch_channel_blacklist_get_channel(asn, channel_offset);
+#else /* TSCH_WITH_CHANNEL_BLACKLIST */
   uint16_t index_of_0 = ASN_MOD(*asn, tsch_hopping_sequence_length);
   uint16_t index_of_offset = (index_of_0 + channel_offset) % tsch_hopping_sequence_length.val;
   return tsch_hopping_sequence[index_of_offset];
+#endif /* TSCH_WITH_CHANNEL_BLACKLIST */
 }
 
 /*---------------------------------------------------------------------------*/
@@ -468,11 +497,19 @@ PT_THREAD(tsch_tx_slot(struct pt *pt, struct rtimer *t))
   uint8_t in_queue;
   static int dequeued_index;
   static int packet_ready = 1;
+#if TSCH_BURST_MAX_LEN > 0
+  /* did we ask the neighbor to stay for the next timeslot? */
+  static uint8_t burst_pending;
+#endif /* TSCH_BURST_MAX_LEN > 0 */
 
   PT_BEGIN(pt);
 
   TSCH_DEBUG_TX_EVENT();
 
+#if TSCH_BURST_MAX_LEN > 0
+  burst_pending = 0;
+#endif /* TSCH_BURST_MAX_LEN > 0 */
+
   /* First check if we have space to store a newly dequeued packet (in case of
    * successful Tx or Drop) */
   dequeued_index = ringbufindex_peek_put(&dequeued_ringbuf);
@@ -512,6 +549,18 @@ PT_THREAD(tsch_tx_slot(struct pt *pt, struct rtimer *t))
         packet_ready = 1;
       }
 
+#if TSCH_BURST_MAX_LEN > 0
+      /* Set the frame pending bit if we have more frames for this neighbor.
+       * This is done before securing, as the bit is authenticated */
+      if(!is_broadcast && burst_count + 1 < TSCH_BURST_MAX_LEN
+         && ringbufindex_elements(&current_neighbor->tx_ringbuf) > 1) {
+        burst_pending = 1;
+        ((uint8_t *)packet)[0] |= BURST_FRAME_PENDING_BIT;
+      } else {
+        ((uint8_t *)packet)[0] &= ~BURST_FRAME_PENDING_BIT;
+      }
+#endif /* TSCH_BURST_MAX_LEN > 0 */
+
 #if LLSEC802154_ENABLED
       if(tsch_is_pan_secured) {
         /* If we are going to encrypt, we need to generate the output in a separate buffer and keep
@@ -529,6 +578,12 @@ PT_THREAD(tsch_tx_slot(struct pt *pt, struct rtimer *t))
       if(packet_ready && NETSTACK_RADIO.prepare(packet, packet_len) == 0) { /* 0 means success */
         static rtimer_clock_t tx_duration;
 
+        /* Stamped at the start of the cell, outside of the timing
+           critical part of the slot */
+        LATENCY_TRACE_STAMP_ID(queuebuf_attr(current_packet->qb,
+                                             PACKETBUF_ATTR_LATENCY_TRACE),
+                               LATENCY_TRACE_MAC_TX);
+
 #if CCA_ENABLED
         cca_status = 1;
         /* delay before CCA */
@@ -646,8 +701,10 @@ PT_THREAD(tsch_tx_slot(struct pt *pt, struct rtimer *t))
                             "!truncated dr %d %d", (int)eack_time_correction, (int)drift_correction);
                     );
                   }
+                  radio_value_t ack_rssi;
+                  NETSTACK_RADIO.get_value(RADIO_PARAM_LAST_RSSI, &ack_rssi);
                   is_drift_correction_used = 1;
-                  tsch_timesync_update(current_neighbor, since_last_timesync, drift_correction);
+                  tsch_timesync_update(current_neighbor, since_last_timesync, drift_correction, ack_rssi);
                   /* Keep track of sync time */
                   last_sync_asn = current_asn;
                   tsch_schedule_keepalive();
@@ -670,6 +727,24 @@ PT_THREAD(tsch_tx_slot(struct pt *pt, struct rtimer *t))
 
     current_packet->transmissions++;
     current_packet->ret = mac_tx_status;
+    current_packet->channel = current_channel;
+
+#if TSCH_WITH_CHANNEL_BLACKLIST
+    /* Per-channel PRR of unicast transmissions */
+    if(!current_neighbor->is_broadcast && (mac_tx_status == MAC_TX_OK || mac_tx_status == MAC_TX_NOACK)) {
+      tsch_channel_blacklist_tx(current_channel, mac_tx_status == MAC_TX_OK);
+    }
+#endif /* TSCH_WITH_CHANNEL_BLACKLIST */
+
+#if TSCH_BURST_MAX_LEN > 0
+    /* The neighbor acknowledged a frame announcing more: keep sending */
+    if(burst_pending && mac_tx_status == MAC_TX_OK) {
+      burst_link_scheduled = BURST_TX;
+      burst_count++;
+    } else {
+      burst_count = 0;
+    }
+#endif /* TSCH_BURST_MAX_LEN > 0 */
 
     /* Post TX: Update neighbor state */
     in_queue = update_neighbor_state(current_neighbor, current_packet, current_link, mac_tx_status);
@@ -681,6 +756,8 @@ PT_THREAD(tsch_tx_slot(struct pt *pt, struct rtimer *t))
     }
 
     /* Log every tx attempt */
+    TRACE_ISR(TSCH_TX, mac_tx_status,
+              TRACE_NODE(queuebuf_addr(current_packet->qb, PACKETBUF_ADDR_RECEIVER)));
     TSCH_LOG_ADD(tsch_log_tx,
         log->tx.mac_tx_status = mac_tx_status;
     log->tx.num_tx = current_packet->transmissions;
@@ -738,8 +815,13 @@ PT_THREAD(tsch_rx_slot(struct pt *pt, struct rtimer *t))
     static rtimer_clock_t rx_start_time;
     static rtimer_clock_t expected_rx_time;
     static rtimer_clock_t packet_duration;
+    /* Guard time, centered on the expected Rx time */
+    static rtimer_clock_t rx_wait;
+    static rtimer_clock_t rx_offset;
     uint8_t packet_seen;
 
+    rx_wait = tsch_timesync_adaptive_rx_wait(ASN_DIFF(current_asn, last_sync_asn));
+    rx_offset = tsch_timing[tsch_ts_rx_offset] + (tsch_timing[tsch_ts_rx_wait] - rx_wait) / 2;
     expected_rx_time = current_slot_start + tsch_timing[tsch_ts_tx_offset];
     /* Default start time: expected Rx time */
     rx_start_time = expected_rx_time;
@@ -747,7 +829,7 @@ PT_THREAD(tsch_rx_slot(struct pt *pt, struct rtimer *t))
     current_input = &input_array[input_index];
 
     /* Wait before starting to listen */
-    TSCH_SCHEDULE_AND_YIELD(pt, t, current_slot_start, tsch_timing[tsch_ts_rx_offset] - RADIO_DELAY_BEFORE_RX, "RxBeforeListen");
+    TSCH_SCHEDULE_AND_YIELD(pt, t, current_slot_start, rx_offset - RADIO_DELAY_BEFORE_RX, "RxBeforeListen");
     TSCH_DEBUG_RX_EVENT();
 
     /* Start radio for at least guard time */
@@ -756,7 +838,7 @@ PT_THREAD(tsch_rx_slot(struct pt *pt, struct rtimer *t))
     if(!packet_seen) {
       /* Check if receiving within guard time */
       BUSYWAIT_UNTIL_ABS((packet_seen = NETSTACK_RADIO.receiving_packet()),
-          current_slot_start, tsch_timing[tsch_ts_rx_offset] + tsch_timing[tsch_ts_rx_wait] + RADIO_DELAY_BEFORE_DETECT);
+          current_slot_start, rx_offset + rx_wait + RADIO_DELAY_BEFORE_DETECT);
     }
     if(!packet_seen) {
       /* no packets on air */
@@ -768,7 +850,7 @@ PT_THREAD(tsch_rx_slot(struct pt *pt, struct rtimer *t))
 
       /* Wait until packet is received, turn radio off */
       BUSYWAIT_UNTIL_ABS(!NETSTACK_RADIO.receiving_packet(),
-          current_slot_start, tsch_timing[tsch_ts_rx_offset] + tsch_timing[tsch_ts_rx_wait] + tsch_timing[tsch_ts_max_tx]);
+          current_slot_start, rx_offset + rx_wait + tsch_timing[tsch_ts_max_tx]);
       TSCH_DEBUG_RX_EVENT();
       tsch_radio_off(TSCH_RADIO_CMD_OFF_WITHIN_TIMESLOT);
 
@@ -865,6 +947,13 @@ PT_THREAD(tsch_rx_slot(struct pt *pt, struct rtimer *t))
               TSCH_DEBUG_RX_EVENT();
               NETSTACK_RADIO.transmit(ack_len);
               tsch_radio_off(TSCH_RADIO_CMD_OFF_WITHIN_TIMESLOT);
+
+#if TSCH_BURST_MAX_LEN > 0
+              /* The sender has more frames for us, listen in the next timeslot */
+              if(frame.fcf.frame_pending && !do_nack) {
+                burst_link_scheduled = BURST_RX;
+              }
+#endif /* TSCH_BURST_MAX_LEN > 0 */
             }
 
             /* If the sender is a time source, proceed to clock drift compensation */
@@ -876,14 +965,19 @@ PT_THREAD(tsch_rx_slot(struct pt *pt, struct rtimer *t))
               /* Save estimated drift */
               drift_correction = -estimated_drift;
               is_drift_correction_used = 1;
-              tsch_timesync_update(n, since_last_timesync, -estimated_drift);
+              tsch_timesync_update(n, since_last_timesync, -estimated_drift, current_input->rssi);
               tsch_schedule_keepalive();
+            } else {
+              /* Refine our drift estimate from the other neighbors */
+              tsch_timesync_observe(n, ASN_DIFF(current_asn, last_sync_asn), -estimated_drift, current_input->rssi);
             }
 
             /* Add current input to ringbuf */
             ringbufindex_put(&input_ringbuf);
 
             /* Log every reception */
+            TRACE_ISR(TSCH_RX, current_input->len,
+                      TRACE_NODE((linkaddr_t *)&frame.src_addr));
             TSCH_LOG_ADD(tsch_log_rx,
               log->rx.src = TSCH_LOG_ID_FROM_LINKADDR((linkaddr_t*)&frame.src_addr);
               log->rx.is_unicast = frame.fcf.ack_required;
@@ -947,21 +1041,52 @@ PT_THREAD(tsch_slot_operation(struct rtimer *t, void *ptr))
       /* Reset drift correction */
       drift_correction = 0;
       is_drift_correction_used = 0;
-      /* Get a packet ready to be sent */
-      current_packet = get_packet_and_neighbor_for_link(current_link, &current_neighbor);
-      /* There is no packet to send, and this link does not have Rx flag. Instead of doing
-       * nothing, switch to the backup link (has Rx flag) if any. */
-      if(current_packet == NULL && !(current_link->link_options & LINK_OPTION_RX) && backup_link != NULL) {
-        current_link = backup_link;
+#if TSCH_BURST_MAX_LEN > 0
+      if(current_burst != BURST_NONE) {
+        /* Continuation of a burst: only send to the same neighbor, or listen */
+        current_packet = current_burst == BURST_TX
+          ? tsch_queue_get_packet_for_nbr(current_neighbor, current_link) : NULL;
+        is_active_slot = current_packet != NULL || current_burst == BURST_RX;
+      } else
+#endif /* TSCH_BURST_MAX_LEN > 0 */
+      {
+        /* Get a packet ready to be sent */
         current_packet = get_packet_and_neighbor_for_link(current_link, &current_neighbor);
+#if TSCH_WITH_SIXTOP && TSCH_SIXTOP_WITH_SF
+        /* Let the scheduling function observe cell usage */
+        tsch_sixtop_sf_link_elapsed(current_link, current_packet != NULL);
+#endif
+        /* There is no packet to send, and this link does not have Rx flag. Instead of doing
+         * nothing, switch to the backup link (has Rx flag) if any. */
+        if(current_packet == NULL && !(current_link->link_options & LINK_OPTION_RX) && backup_link != NULL) {
+          current_link = backup_link;
+          current_packet = get_packet_and_neighbor_for_link(current_link, &current_neighbor);
+        }
+        is_active_slot = current_packet != NULL || (current_link->link_options & LINK_OPTION_RX);
+      }
+#if TSCH_BURST_MAX_LEN > 0
+      if(current_burst != BURST_TX) {
+        burst_count = 0;
       }
-      is_active_slot = current_packet != NULL || (current_link->link_options & LINK_OPTION_RX);
+#endif /* TSCH_BURST_MAX_LEN > 0 */
       if(is_active_slot) {
-        /* Hop channel */
-        current_channel = tsch_calculate_channel(&current_asn, current_link->channel_offset);
-        NETSTACK_RADIO.set_value(RADIO_PARAM_CHANNEL, current_channel);
+#if TSCH_BURST_MAX_LEN > 0
+        /* A burst stays on the channel it started on */
+        if(current_burst == BURST_NONE)
+#endif /* TSCH_BURST_MAX_LEN > 0 */
+        {
+          /* Hop channel */
+          current_channel = tsch_calculate_channel(&current_asn, current_link->channel_offset);
+          NETSTACK_RADIO.set_value(RADIO_PARAM_CHANNEL, current_channel);
+        }
         /* Turn the radio on already here if configured so; necessary for radios with slow startup */
         tsch_radio_on(TSCH_RADIO_CMD_ON_START_OF_TIMESLOT);
+#if LLSEC802154_ENABLED
+        if(tsch_is_pan_secured) {
+          /* Nonce and key ready before the radio operations */
+          tsch_security_prepare_slot(&current_asn);
+        }
+#endif /* LLSEC802154_ENABLED */
         /* Decide whether it is a TX/RX/IDLE or OFF slot */
         /* Actual slot operation */
         if(current_packet != NULL) {
@@ -1010,12 +1135,24 @@ PT_THREAD(tsch_slot_operation(struct rtimer *t, void *ptr))
           tsch_queue_update_all_backoff_windows(&current_link->addr);
         }
 
-        /* Get next active link */
-        current_link = tsch_schedule_get_next_active_link(&current_asn, &timeslot_diff, &backup_link);
-        if(current_link == NULL) {
-          /* There is no next link. Fall back to default
-           * behavior: wake up at the next slot. */
+#if TSCH_BURST_MAX_LEN > 0
+        /* A burst continues in the very next timeslot, on the current link.
+         * If we miss it, this loop runs again and falls back to the schedule */
+        current_burst = burst_link_scheduled;
+        burst_link_scheduled = BURST_NONE;
+        if(current_burst != BURST_NONE) {
           timeslot_diff = 1;
+          backup_link = NULL;
+        } else
+#endif /* TSCH_BURST_MAX_LEN > 0 */
+        {
+          /* Get next active link */
+          current_link = tsch_schedule_get_next_active_link(&current_asn, &timeslot_diff, &backup_link);
+          if(current_link == NULL) {
+            /* There is no next link. Fall back to default
+             * behavior: wake up at the next slot. */
+            timeslot_diff = 1;
+          }
         }
         /* Update ASN */
         ASN_INC(current_asn, timeslot_diff);
@@ -1046,6 +1183,12 @@ tsch_slot_operation_start(void)
   rtimer_clock_t time_to_next_active_slot;
   rtimer_clock_t prev_slot_start;
   TSCH_DEBUG_INIT();
+#if TSCH_BURST_MAX_LEN > 0
+  /* No burst survives a resynchronization */
+  burst_link_scheduled = BURST_NONE;
+  current_burst = BURST_NONE;
+  burst_count = 0;
+#endif /* TSCH_BURST_MAX_LEN > 0 */
   do {
     uint16_t timeslot_diff;
     /* Get next active link */
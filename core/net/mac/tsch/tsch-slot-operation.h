@@ -114,6 +114,8 @@ int tsch_is_locked(void);
 int tsch_get_lock(void);
 /* Release TSCH lock */
 void tsch_release_lock(void);
+/* Is a slot operation in progress? */
+int tsch_is_in_slot_operation(void);
 /* Set global time before starting slot operation,
  * with a rtimer time and an ASN */
 void tsch_slot_operation_sync(rtimer_clock_t next_slot_start,
@@ -54,8 +54,14 @@
 #include "net/mac/tsch/tsch-log.h"
 #include "net/mac/tsch/tsch-packet.h"
 #include "net/mac/tsch/tsch-security.h"
+#include "net/mac/tsch/tsch-sixtop.h"
+#include "net/mac/tsch/tsch-channel-blacklist.h"
 #include "net/mac/mac-sequence.h"
 #include "lib/random.h"
+#if TSCH_JOIN_HINTS
+#include "cfs/cfs.h"
+#include <stddef.h>
+#endif /* TSCH_JOIN_HINTS */
 
 #if FRAME802154_VERSION < FRAME802154_IEEE802154E_2012
 #error TSCH: FRAME802154_VERSION must be at least FRAME802154_IEEE802154E_2012
@@ -92,6 +98,26 @@ NBR_TABLE(struct eb_stat, eb_stats);
 uint8_t tsch_hopping_sequence[TSCH_HOPPING_SEQUENCE_MAX_LEN];
 struct asn_divisor_t tsch_hopping_sequence_length;
 
+#if TSCH_JOIN_HINTS
+/* What we know of the network last joined, as stored in CFS */
+struct tsch_join_hint {
+  uint16_t pan_id;
+  uint8_t timeslot_id;
+  uint8_t hopping_sequence_id;
+  uint16_t timeslot[tsch_ts_elements_count];
+  uint8_t hopping_sequence_len;
+  uint8_t hopping_sequence[TSCH_HOPPING_SEQUENCE_MAX_LEN];
+  /* Last, not compared: any channel of the sequence will do */
+  uint8_t channel;
+};
+static struct tsch_join_hint join_hint;
+static uint8_t join_hint_loaded;
+/* join_hint holds a network */
+static uint8_t join_hint_valid;
+/* join_hint was updated at association and is to be stored */
+static uint8_t join_hint_dirty;
+#endif /* TSCH_JOIN_HINTS */
+
 /* Default TSCH timeslot timing (in micro-second) */
 static const uint16_t tsch_default_timing_us[tsch_ts_elements_count] = {
   TSCH_DEFAULT_TS_CCA_OFFSET,
@@ -203,6 +229,12 @@ tsch_reset(void)
 #ifdef TSCH_CALLBACK_LEAVING_NETWORK
   TSCH_CALLBACK_LEAVING_NETWORK();
 #endif
+#if TSCH_WITH_SIXTOP
+  tsch_sixtop_reset();
+#endif
+#if TSCH_WITH_CHANNEL_BLACKLIST
+  tsch_channel_blacklist_reset();
+#endif
 #if TSCH_AUTOSELECT_TIME_SOURCE
   best_neighbor_eb_count = 0;
   nbr_table_register(eb_stats, NULL);
@@ -309,6 +341,11 @@ eb_input(struct input_packet *current_input)
         tsch_disassociate();
       }
 
+#if TSCH_WITH_CHANNEL_BLACKLIST
+      /* Follow the blacklist of our time source */
+      tsch_channel_blacklist_eb_input(&eb_ies);
+#endif
+
       if(eb_ies.ie_join_priority >= TSCH_MAX_JOIN_PRIORITY) {
         /* Join priority unacceptable. Leave network. */
         PRINTF("TSCH:! EB JP too high %u, leaving the network\n",
@@ -343,6 +380,10 @@ tsch_rx_process_pending()
     int is_eb = ret
       && frame.fcf.frame_version == FRAME802154_IEEE802154E_2012
       && frame.fcf.frame_type == FRAME802154_BEACONFRAME;
+#if TSCH_WITH_SIXTOP
+    /* 6P messages are data frames carrying Payload IEs */
+    int is_sixtop = is_data && frame.fcf.ie_list_present;
+#endif
 
     if(is_data) {
       /* Skip EBs and other control messages */
@@ -356,6 +397,12 @@ tsch_rx_process_pending()
     ringbufindex_get(&input_ringbuf);
 
     if(is_data) {
+#if TSCH_WITH_SIXTOP
+      if(is_sixtop) {
+        tsch_sixtop_input();
+        continue;
+      }
+#endif
       /* Pass to upper layers */
       packet_input();
     } else if(is_eb) {
@@ -373,8 +420,12 @@ tsch_tx_process_pending()
   /* Loop on accessing (without removing) a pending input packet */
   while((dequeued_index = ringbufindex_peek_get(&dequeued_ringbuf)) != -1) {
     struct tsch_packet *p = dequeued_array[dequeued_index];
-    /* Put packet into packetbuf for packet_sent callback */
-    queuebuf_to_packetbuf(p->qb);
+    /* Put packet into packetbuf for packet_sent callback. The queuebuf is
+     * not needed anymore, hand its storage over to packetbuf */
+    queuebuf_give_to_packetbuf(p->qb);
+    p->qb = NULL;
+    /* Let upper layers know the channel, e.g. for per-channel link-stats */
+    packetbuf_set_attr(PACKETBUF_ATTR_CHANNEL, p->channel);
     /* Call packet_sent callback */
     mac_call_sent_callback(p->sent, p->ptr, p->ret, p->transmissions);
     /* Free packet queuebuf */
@@ -394,6 +445,9 @@ tsch_start_coordinator(void)
   /* Initialize hopping sequence as default */
   memcpy(tsch_hopping_sequence, TSCH_DEFAULT_HOPPING_SEQUENCE, sizeof(TSCH_DEFAULT_HOPPING_SEQUENCE));
   ASN_DIVISOR_INIT(tsch_hopping_sequence_length, sizeof(TSCH_DEFAULT_HOPPING_SEQUENCE));
+#if TSCH_WITH_CHANNEL_BLACKLIST
+  tsch_channel_blacklist_start(NULL);
+#endif
 #if TSCH_SCHEDULE_WITH_6TISCH_MINIMAL
   tsch_schedule_create_minimal();
 #endif
@@ -414,10 +468,80 @@ tsch_disassociate(void)
 {
   if(tsch_is_associated == 1) {
     tsch_is_associated = 0;
-    process_post(&tsch_process, PROCESS_EVENT_POLL, NULL);
+    process_post_urgent(&tsch_process, PROCESS_EVENT_POLL, NULL);
     PRINTF("TSCH: leaving the network\n");
   }
 }
+#if TSCH_JOIN_HINTS
+/*---------------------------------------------------------------------------*/
+static void
+join_hint_load(void)
+{
+  int fd;
+
+  join_hint_loaded = 1;
+  fd = cfs_open(TSCH_JOIN_HINTS_FILE, CFS_READ);
+  if(fd < 0) {
+    return;
+  }
+  if(cfs_read(fd, &join_hint, sizeof(join_hint)) == sizeof(join_hint)
+     && join_hint.channel != 0
+     && join_hint.hopping_sequence_len > 0
+     && join_hint.hopping_sequence_len <= TSCH_HOPPING_SEQUENCE_MAX_LEN) {
+    join_hint_valid = 1;
+    PRINTF("TSCH: join hint: PAN ID %x, channel %u\n",
+           join_hint.pan_id, join_hint.channel);
+  }
+  cfs_close(fd);
+}
+/*---------------------------------------------------------------------------*/
+/* Remember the network we are associating with, from its EB */
+static void
+join_hint_update(uint16_t pan_id, const struct ieee802154_ies *ies)
+{
+  struct tsch_join_hint hint;
+  radio_value_t channel;
+
+  memset(&hint, 0, sizeof(hint));
+  hint.pan_id = pan_id;
+  if(NETSTACK_RADIO.get_value(RADIO_PARAM_CHANNEL, &channel) == RADIO_RESULT_OK) {
+    hint.channel = channel;
+  }
+  hint.timeslot_id = ies->ie_tsch_timeslot_id;
+  if(hint.timeslot_id != 0) {
+    memcpy(hint.timeslot, ies->ie_tsch_timeslot, sizeof(hint.timeslot));
+  }
+  hint.hopping_sequence_id = ies->ie_channel_hopping_sequence_id;
+  hint.hopping_sequence_len = tsch_hopping_sequence_length.val;
+  memcpy(hint.hopping_sequence, tsch_hopping_sequence,
+         hint.hopping_sequence_len);
+
+  /* Flash is only written for a new network, not for a new channel */
+  if(!join_hint_valid ||
+     memcmp(&hint, &join_hint, offsetof(struct tsch_join_hint, channel)) != 0) {
+    join_hint_dirty = 1;
+  }
+  join_hint = hint;
+  join_hint_valid = 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+join_hint_store(void)
+{
+  int fd;
+
+  join_hint_dirty = 0;
+  fd = cfs_open(TSCH_JOIN_HINTS_FILE, CFS_WRITE);
+  if(fd < 0) {
+    PRINTF("TSCH:! join hint: cfs open error\n");
+    return;
+  }
+  if(cfs_write(fd, &join_hint, sizeof(join_hint)) != sizeof(join_hint)) {
+    PRINTF("TSCH:! join hint: cfs write error\n");
+  }
+  cfs_close(fd);
+}
+#endif /* TSCH_JOIN_HINTS */
 /*---------------------------------------------------------------------------*/
 /* Attempt to associate to a network form an incoming EB */
 static int
@@ -474,6 +598,30 @@ tsch_associate(const struct input_packet *input_eb, rtimer_clock_t timestamp)
     return 0;
   }
 
+#if TSCH_JOIN_HINTS
+  /* Only the ID of the timeslot template or of the hopping sequence was
+   * sent: use the ones remembered with that ID */
+  if(ies.ie_tsch_timeslot_id != 0
+     && ies.ie_tsch_timeslot[tsch_ts_timeslot_length] == 0) {
+    if(!join_hint_valid || join_hint.timeslot_id != ies.ie_tsch_timeslot_id) {
+      PRINTF("TSCH:! parse_eb: unknown timeslot template %u\n", ies.ie_tsch_timeslot_id);
+      return 0;
+    }
+    memcpy(ies.ie_tsch_timeslot, join_hint.timeslot, sizeof(ies.ie_tsch_timeslot));
+  }
+  if(ies.ie_channel_hopping_sequence_id != 0
+     && ies.ie_hopping_sequence_len == 0) {
+    if(!join_hint_valid
+       || join_hint.hopping_sequence_id != ies.ie_channel_hopping_sequence_id) {
+      PRINTF("TSCH:! parse_eb: unknown hopping sequence %u\n", ies.ie_channel_hopping_sequence_id);
+      return 0;
+    }
+    ies.ie_hopping_sequence_len = join_hint.hopping_sequence_len;
+    memcpy(ies.ie_hopping_sequence_list, join_hint.hopping_sequence,
+           join_hint.hopping_sequence_len);
+  }
+#endif /* TSCH_JOIN_HINTS */
+
   /* TSCH timeslot timing */
   for(i = 0; i < tsch_ts_elements_count; i++) {
     if(ies.ie_tsch_timeslot_id == 0) {
@@ -496,6 +644,9 @@ tsch_associate(const struct input_packet *input_eb, rtimer_clock_t timestamp)
       return 0;
     }
   }
+#if TSCH_WITH_CHANNEL_BLACKLIST
+  tsch_channel_blacklist_start(&ies);
+#endif
 
 #if TSCH_CHECK_TIME_AT_ASSOCIATION > 0
   /* Divide by 4k and multiply again to avoid integer overflow */
@@ -563,6 +714,10 @@ tsch_associate(const struct input_packet *input_eb, rtimer_clock_t timestamp)
       /* Start sending keep-alives now that tsch_is_associated is set */
       tsch_schedule_keepalive();
 
+#if TSCH_JOIN_HINTS
+      join_hint_update(frame.src_pid, &ies);
+#endif /* TSCH_JOIN_HINTS */
+
 #ifdef TSCH_CALLBACK_JOINING_NETWORK
       TSCH_CALLBACK_JOINING_NETWORK();
 #endif
@@ -585,6 +740,25 @@ tsch_associate(const struct input_packet *input_eb, rtimer_clock_t timestamp)
   return 0;
 }
 
+/* Pick a channel to scan. The channel the remembered network was found
+ * on comes first, then the channels of its hopping sequence */
+static uint8_t
+scan_channel_pick(int first, clock_time_t scanning_for)
+{
+#if TSCH_JOIN_HINTS
+  if(join_hint_valid && scanning_for < TSCH_JOIN_HINTS_TIMEOUT) {
+    if(first) {
+      return join_hint.channel;
+    }
+    return join_hint.hopping_sequence[
+        random_rand() % join_hint.hopping_sequence_len];
+  }
+#endif /* TSCH_JOIN_HINTS */
+  /* Pick a channel at random in TSCH_JOIN_HOPPING_SEQUENCE */
+  return TSCH_JOIN_HOPPING_SEQUENCE[
+      random_rand() % sizeof(TSCH_JOIN_HOPPING_SEQUENCE)];
+}
+
 /* Processes and protothreads used by TSCH */
 
 /*---------------------------------------------------------------------------*/
@@ -600,11 +774,23 @@ PT_THREAD(tsch_scan(struct pt *pt))
   static struct etimer scan_timer;
   /* Time when we started scanning on current_channel */
   static clock_time_t current_channel_since;
+  /* How long to stay on current_channel, extended when frames are heard */
+  static clock_time_t current_channel_dwell;
+  /* Time when we started scanning */
+  static clock_time_t scan_since;
+  static uint8_t first_channel;
 
   ASN_INIT(current_asn, 0, 0);
 
+#if TSCH_JOIN_HINTS
+  if(!join_hint_loaded) {
+    join_hint_load();
+  }
+#endif /* TSCH_JOIN_HINTS */
+
   etimer_set(&scan_timer, CLOCK_SECOND / TSCH_ASSOCIATION_POLL_FREQUENCY);
-  current_channel_since = clock_time();
+  current_channel_since = scan_since = clock_time();
+  first_channel = 1;
 
   while(!tsch_is_associated && !tsch_is_coordinator) {
     /* Hop to any channel offset */
@@ -616,16 +802,24 @@ PT_THREAD(tsch_scan(struct pt *pt))
     clock_time_t now_time = clock_time();
 
     /* Switch to a (new) channel for scanning */
-    if(current_channel == 0 || now_time - current_channel_since > TSCH_CHANNEL_SCAN_DURATION) {
-      /* Pick a channel at random in TSCH_JOIN_HOPPING_SEQUENCE */
-      uint8_t scan_channel = TSCH_JOIN_HOPPING_SEQUENCE[
-          random_rand() % sizeof(TSCH_JOIN_HOPPING_SEQUENCE)];
+    if(first_channel || current_channel == 0
+       || now_time - current_channel_since > current_channel_dwell) {
+      uint8_t scan_channel = scan_channel_pick(first_channel,
+                                               now_time - scan_since);
       if(current_channel != scan_channel) {
         NETSTACK_RADIO.set_value(RADIO_PARAM_CHANNEL, scan_channel);
         current_channel = scan_channel;
         PRINTF("TSCH: scanning on channel %u\n", scan_channel);
       }
       current_channel_since = now_time;
+      current_channel_dwell = TSCH_CHANNEL_SCAN_DURATION;
+#if TSCH_JOIN_HINTS
+      if(first_channel && join_hint_valid) {
+        /* The network was there before the reboot */
+        current_channel_dwell = TSCH_CHANNEL_SCAN_MAX_DURATION;
+      }
+#endif /* TSCH_JOIN_HINTS */
+      first_channel = 0;
     }
 
     /* Turn radio on and wait for EB */
@@ -648,7 +842,13 @@ PT_THREAD(tsch_scan(struct pt *pt))
       /* Parse EB and attempt to associate */
       PRINTF("TSCH: association: received packet (%u bytes) on channel %u\n", input_eb.len, current_channel);
 
-      tsch_associate(&input_eb, t0);
+      if(!tsch_associate(&input_eb, t0)) {
+        /* There is traffic on this channel, stay a bit longer */
+        clock_time_t dwell = now_time - current_channel_since + TSCH_CHANNEL_SCAN_DURATION;
+        if(dwell > current_channel_dwell) {
+          current_channel_dwell = MIN(dwell, TSCH_CHANNEL_SCAN_MAX_DURATION);
+        }
+      }
     }
 
     if(tsch_is_associated) {
@@ -687,6 +887,14 @@ PROCESS_THREAD(tsch_process, ev, data)
     /* We are part of a TSCH network, start slot operation */
     tsch_slot_operation_start();
 
+#if TSCH_JOIN_HINTS
+    /* Now that slot operation runs from rtimer, write the network we
+     * joined to flash if it changed */
+    if(join_hint_dirty) {
+      join_hint_store();
+    }
+#endif /* TSCH_JOIN_HINTS */
+
     /* Yield our main process. Slot operation will re-schedule itself
      * as long as we are associated */
     PROCESS_YIELD_UNTIL(!tsch_is_associated);
@@ -841,6 +1049,12 @@ tsch_init(void)
   tsch_queue_init();
   tsch_schedule_init();
   tsch_log_init();
+#if TSCH_WITH_SIXTOP
+  tsch_sixtop_init();
+#endif
+#if TSCH_WITH_CHANNEL_BLACKLIST
+  tsch_channel_blacklist_init();
+#endif
   ringbufindex_init(&input_ringbuf, TSCH_MAX_INCOMING_PACKETS);
   ringbufindex_init(&dequeued_ringbuf, TSCH_DEQUEUED_ARRAY_SIZE);
 
@@ -931,6 +1145,61 @@ send_packet(mac_callback_t sent, void *ptr)
   }
 }
 /*---------------------------------------------------------------------------*/
+#if TSCH_WITH_SIXTOP
+/* Enqueue a 6P message for a neighbor. The message is sent in a frame of
+ * its own, within a Payload IE. Returns 1 if success, 0 if failure */
+int
+tsch_send_sixtop(const linkaddr_t *addr, const uint8_t *msg, uint16_t msg_len,
+                 mac_callback_t sent, void *ptr)
+{
+  int len;
+  uint8_t hdr_len = 0;
+  struct tsch_packet *p;
+
+  if(!tsch_is_associated || linkaddr_cmp(addr, &linkaddr_null)) {
+    return 0;
+  }
+
+  /* Linked to the sequence numbers of data frames, which are checked
+   * for duplicates together at the receiver */
+  if(++tsch_packet_seqno == 0) {
+    tsch_packet_seqno++;
+  }
+
+  packetbuf_clear();
+  packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, addr);
+  packetbuf_set_attr(PACKETBUF_ATTR_MAC_SEQNO, tsch_packet_seqno);
+  packetbuf_set_attr(PACKETBUF_ATTR_MAC_ACK, 1);
+  packetbuf_set_attr(PACKETBUF_ATTR_FRAME_TYPE, FRAME802154_DATAFRAME);
+#if LLSEC802154_ENABLED
+  if(tsch_is_pan_secured) {
+    /* Set security level, key id and index */
+    packetbuf_set_attr(PACKETBUF_ATTR_SECURITY_LEVEL, TSCH_SECURITY_KEY_SEC_LEVEL_OTHER);
+    packetbuf_set_attr(PACKETBUF_ATTR_KEY_ID_MODE, FRAME802154_1_BYTE_KEY_ID_MODE); /* Use 1-byte key index */
+    packetbuf_set_attr(PACKETBUF_ATTR_KEY_INDEX, TSCH_SECURITY_KEY_INDEX_OTHER);
+  }
+#endif /* LLSEC802154_ENABLED */
+
+  len = tsch_packet_create_sixtop(packetbuf_dataptr(), PACKETBUF_SIZE,
+      addr, tsch_packet_seqno, msg, msg_len, &hdr_len);
+  if(len <= 0) {
+    PRINTF("TSCH:! can't create 6P packet\n");
+    return 0;
+  }
+  packetbuf_set_datalen(len);
+
+  if((p = tsch_queue_add_packet(addr, sent, ptr)) == NULL) {
+    PRINTF("TSCH:! can't enqueue 6P packet to %u\n",
+           TSCH_LOG_ID_FROM_LINKADDR(addr));
+    return 0;
+  }
+  p->header_len = hdr_len;
+  PRINTF("TSCH: send 6P packet to %u with seqno %u, len %u\n",
+         TSCH_LOG_ID_FROM_LINKADDR(addr), tsch_packet_seqno, len);
+  return 1;
+}
+#endif /* TSCH_WITH_SIXTOP */
+/*---------------------------------------------------------------------------*/
 static void
 packet_input(void)
 {
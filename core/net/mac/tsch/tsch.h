@@ -163,5 +163,8 @@ void tsch_set_eb_period(uint32_t period);
 void tsch_set_coordinator(int enable);
 /* Set the pan as secured or not */
 void tsch_set_pan_secured(int enable);
+/* Enqueue a 6P message for a neighbor (requires TSCH_CONF_WITH_SIXTOP) */
+int tsch_send_sixtop(const linkaddr_t *addr, const uint8_t *msg, uint16_t msg_len,
+                     mac_callback_t sent, void *ptr);
 
 #endif /* __TSCH_H__ */
@@ -60,6 +60,9 @@ static void print_table();
 const linkaddr_t *NBR_TABLE_FIND_REMOVABLE(nbr_table_reason_t reason, void *data);
 #endif /* NBR_TABLE_FIND_REMOVABLE */
 
+#ifdef NBR_TABLE_EVICTION_SCORE
+int NBR_TABLE_EVICTION_SCORE(const linkaddr_t *lladdr);
+#endif /* NBR_TABLE_EVICTION_SCORE */
 
 /* List of link-layer addresses of the neighbors, used as key in the tables */
 typedef struct nbr_table_key {
@@ -79,10 +82,52 @@ static struct nbr_table *all_tables[MAX_NUM_TABLES];
 /* The current number of tables */
 static unsigned num_tables;
 
+#if NBR_TABLE_WITH_SCORED_EVICTION
+/* For each neighbor, the highest priority reason it was added for */
+static uint8_t reason_map[NBR_TABLE_MAX_NEIGHBORS];
+/* For each neighbor, when it was last added or looked up (clock_seconds) */
+static uint16_t last_used[NBR_TABLE_MAX_NEIGHBORS];
+/* Priority of the reasons for adding a neighbor, indexed by reason.
+ * Neighbors we route through or exchange unicast traffic with rank above
+ * neighbors we only overheard */
+static const uint8_t reason_priority[] = {
+  0, /* NBR_TABLE_REASON_UNDEFINED */
+  0, /* NBR_TABLE_REASON_RPL_DIO */
+  2, /* NBR_TABLE_REASON_RPL_DAO */
+  1, /* NBR_TABLE_REASON_RPL_DIS */
+  2, /* NBR_TABLE_REASON_ROUTE */
+  2, /* NBR_TABLE_REASON_IPV6_ND */
+  1, /* NBR_TABLE_REASON_MAC */
+  1, /* NBR_TABLE_REASON_LLSEC */
+  0, /* NBR_TABLE_REASON_LINK_STATS */
+};
+#define REASON_PRIORITY(reason) \
+  ((unsigned)(reason) < sizeof(reason_priority) ? reason_priority[reason] : 0)
+/* Weights of the components of the eviction score */
+#define SCORE_USED_WEIGHT     32
+#define SCORE_PRIORITY_WEIGHT 32
+/* Age, in minutes, at which a neighbor stops losing score */
+#define SCORE_MAX_AGE         64
+#endif /* NBR_TABLE_WITH_SCORED_EVICTION */
+
 /* The neighbor address table */
 MEMB(neighbor_addr_mem, nbr_table_key_t, NBR_TABLE_MAX_NEIGHBORS);
 LIST(nbr_table_keys);
 
+#if NBR_TABLE_WITH_HASH
+#if NBR_TABLE_HASH_SIZE <= NBR_TABLE_MAX_NEIGHBORS
+#error "NBR_TABLE_HASH_SIZE must be larger than NBR_TABLE_MAX_NEIGHBORS"
+#endif
+/* Open-addressing hash table with linear probing. Each slot holds a
+ * neighbor index plus one, 0 for an empty slot */
+#if NBR_TABLE_MAX_NEIGHBORS < 255
+typedef uint8_t nbr_table_slot_t;
+#else
+typedef uint16_t nbr_table_slot_t;
+#endif
+static nbr_table_slot_t hash_slots[NBR_TABLE_HASH_SIZE];
+#endif /* NBR_TABLE_WITH_HASH */
+
 /*---------------------------------------------------------------------------*/
 /* Get a key from a neighbor index */
 static nbr_table_key_t *
@@ -125,17 +170,81 @@ key_from_item(nbr_table_t *table, const nbr_table_item_t *item)
 {
   return key_from_index(index_from_item(table, item));
 }
+#if NBR_TABLE_WITH_HASH
+/*---------------------------------------------------------------------------*/
+/* Home slot of a link-layer address */
+static int
+hash_home(const linkaddr_t *lladdr)
+{
+  int i;
+  uint16_t h = 0;
+  for(i = 0; i < LINKADDR_SIZE; i++) {
+    h = h * 31 + lladdr->u8[i];
+  }
+  return h % NBR_TABLE_HASH_SIZE;
+}
+/*---------------------------------------------------------------------------*/
+/* Slot of a link-layer address, or the empty slot where it would go */
+static int
+hash_slot(const linkaddr_t *lladdr)
+{
+  int slot = hash_home(lladdr);
+  while(hash_slots[slot] != 0
+        && !linkaddr_cmp(lladdr, &key_from_index(hash_slots[slot] - 1)->lladdr)) {
+    slot = (slot + 1) % NBR_TABLE_HASH_SIZE;
+  }
+  return slot;
+}
+/*---------------------------------------------------------------------------*/
+static void
+hash_add(nbr_table_key_t *key)
+{
+  hash_slots[hash_slot(&key->lladdr)] = index_from_key(key) + 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Remove a key, shifting back the keys that probed past it */
+static void
+hash_remove(nbr_table_key_t *key)
+{
+  int hole = hash_slot(&key->lladdr);
+  int slot = hole;
+
+  if(hash_slots[hole] == 0) {
+    return;
+  }
+  hash_slots[hole] = 0;
+  while(1) {
+    int home;
+    slot = (slot + 1) % NBR_TABLE_HASH_SIZE;
+    if(hash_slots[slot] == 0) {
+      return;
+    }
+    home = hash_home(&key_from_index(hash_slots[slot] - 1)->lladdr);
+    /* Can the key move to the hole, i.e. is its home not in (hole, slot]? */
+    if(hole <= slot ? (home <= hole || home > slot) : (home <= hole && home > slot)) {
+      hash_slots[hole] = hash_slots[slot];
+      hash_slots[slot] = 0;
+      hole = slot;
+    }
+  }
+}
+#endif /* NBR_TABLE_WITH_HASH */
 /*---------------------------------------------------------------------------*/
 /* Get the index of a neighbor from its link-layer address */
 static int
 index_from_lladdr(const linkaddr_t *lladdr)
 {
+#if !NBR_TABLE_WITH_HASH
   nbr_table_key_t *key;
+#endif /* !NBR_TABLE_WITH_HASH */
   /* Allow lladdr-free insertion, useful e.g. for IPv6 ND.
    * Only one such entry is possible at a time, indexed by linkaddr_null. */
   if(lladdr == NULL) {
     lladdr = &linkaddr_null;
   }
+#if NBR_TABLE_WITH_HASH
+  return (int)hash_slots[hash_slot(lladdr)] - 1;
+#else /* NBR_TABLE_WITH_HASH */
   key = list_head(nbr_table_keys);
   while(key != NULL) {
     if(lladdr && linkaddr_cmp(lladdr, &key->lladdr)) {
@@ -144,6 +253,7 @@ index_from_lladdr(const linkaddr_t *lladdr)
     key = list_item_next(key);
   }
   return -1;
+#endif /* NBR_TABLE_WITH_HASH */
 }
 /*---------------------------------------------------------------------------*/
 /* Get bit from "used" or "locked" bitmap */
@@ -195,13 +305,80 @@ remove_key(nbr_table_key_t *least_used_key)
   used_map[index_from_key(least_used_key)] = 0;
   /* Remove neighbor from list */
   list_remove(nbr_table_keys, least_used_key);
+#if NBR_TABLE_WITH_HASH
+  hash_remove(least_used_key);
+#endif /* NBR_TABLE_WITH_HASH */
+}
+#if NBR_TABLE_WITH_SCORED_EVICTION
+/*---------------------------------------------------------------------------*/
+/* Number of tables using a neighbor */
+static int
+used_count(int index)
+{
+  int used = used_map[index];
+  int count = 0;
+  while(used != 0) {
+    count += used & 1;
+    used >>= 1;
+  }
+  return count;
+}
+/*---------------------------------------------------------------------------*/
+/* Seconds since a neighbor was last added or looked up */
+static uint16_t
+age_of(int index)
+{
+  return (uint16_t)clock_seconds() - last_used[index];
+}
+/*---------------------------------------------------------------------------*/
+/* How much a neighbor is worth keeping, the higher the better */
+static int
+eviction_score(nbr_table_key_t *key)
+{
+  int index = index_from_key(key);
+  int age = age_of(index) / 60;
+  int score = used_count(index) * SCORE_USED_WEIGHT
+    + REASON_PRIORITY(reason_map[index]) * SCORE_PRIORITY_WEIGHT
+    - (age < SCORE_MAX_AGE ? age : SCORE_MAX_AGE);
+#ifdef NBR_TABLE_EVICTION_SCORE
+  score += NBR_TABLE_EVICTION_SCORE(&key->lladdr);
+#endif /* NBR_TABLE_EVICTION_SCORE */
+  return score;
+}
+/*---------------------------------------------------------------------------*/
+/* Can a neighbor be evicted to make room for one added for this reason? */
+static int
+is_evictable(nbr_table_key_t *key, nbr_table_reason_t reason)
+{
+  int index = index_from_key(key);
+  int victim_priority = REASON_PRIORITY(reason_map[index]);
+  int priority = REASON_PRIORITY(reason);
+
+  if(locked_map[index]) {
+    return 0;
+  }
+  return victim_priority < priority
+    || (victim_priority == priority && age_of(index) >= NBR_TABLE_EVICTION_GUARD_TIME);
 }
 /*---------------------------------------------------------------------------*/
+/* Record that a neighbor was used, possibly for a higher priority reason */
+static void
+touch(int index, nbr_table_reason_t reason, int added)
+{
+  last_used[index] = (uint16_t)clock_seconds();
+  if(added || REASON_PRIORITY(reason) > REASON_PRIORITY(reason_map[index])) {
+    reason_map[index] = reason;
+  }
+}
+#endif /* NBR_TABLE_WITH_SCORED_EVICTION */
+/*---------------------------------------------------------------------------*/
 static nbr_table_key_t *
 nbr_table_allocate(nbr_table_reason_t reason, void *data)
 {
   nbr_table_key_t *key;
+#if !NBR_TABLE_WITH_SCORED_EVICTION
   int least_used_count = 0;
+#endif /* !NBR_TABLE_WITH_SCORED_EVICTION */
   nbr_table_key_t *least_used_key = NULL;
 
   key = memb_alloc(&neighbor_addr_mem);
@@ -231,6 +408,24 @@ nbr_table_allocate(nbr_table_reason_t reason, void *data)
     }
 #endif /* NBR_TABLE_FIND_REMOVABLE */
 
+#if NBR_TABLE_WITH_SCORED_EVICTION
+    if(least_used_key == NULL) {
+      /* No more space, evict the lowest scored neighbor among those the
+       * new one is allowed to replace, oldest first on a tie */
+      int least_score = 0;
+      for(key = list_head(nbr_table_keys); key != NULL; key = list_item_next(key)) {
+        if(is_evictable(key, reason)) {
+          int score = eviction_score(key);
+          if(least_used_key == NULL || score < least_score) {
+            least_used_key = key;
+            least_score = score;
+          }
+        }
+      }
+      PRINTF("*** Scored eviction for reason %u: %s\n", reason,
+             least_used_key != NULL ? "found" : "none");
+    }
+#else /* NBR_TABLE_WITH_SCORED_EVICTION */
     if(least_used_key == NULL) {
       /* No more space, try to free a neighbor.
        * The replacement policy is the following: remove neighbor that is:
@@ -266,6 +461,7 @@ nbr_table_allocate(nbr_table_reason_t reason, void *data)
         key = list_item_next(key);
       }
     }
+#endif /* NBR_TABLE_WITH_SCORED_EVICTION */
 
     if(least_used_key == NULL) {
       /* We haven't found any unlocked item, allocation fails */
@@ -359,6 +555,14 @@ nbr_table_add_lladdr(nbr_table_t *table, const linkaddr_t *lladdr, nbr_table_rea
 
     /* Set link-layer address */
     linkaddr_copy(&key->lladdr, lladdr);
+#if NBR_TABLE_WITH_HASH
+    hash_add(key);
+#endif /* NBR_TABLE_WITH_HASH */
+#if NBR_TABLE_WITH_SCORED_EVICTION
+    touch(index, reason, 1);
+  } else {
+    touch(index, reason, 0);
+#endif /* NBR_TABLE_WITH_SCORED_EVICTION */
   }
 
   /* Get item in the current table */
@@ -378,8 +582,15 @@ nbr_table_add_lladdr(nbr_table_t *table, const linkaddr_t *lladdr, nbr_table_rea
 void *
 nbr_table_get_from_lladdr(nbr_table_t *table, const linkaddr_t *lladdr)
 {
-  void *item = item_from_index(table, index_from_lladdr(lladdr));
-  return nbr_get_bit(used_map, table, item) ? item : NULL;
+  int index = index_from_lladdr(lladdr);
+  void *item = item_from_index(table, index);
+  if(!nbr_get_bit(used_map, table, item)) {
+    return NULL;
+  }
+#if NBR_TABLE_WITH_SCORED_EVICTION
+  last_used[index] = (uint16_t)clock_seconds();
+#endif /* NBR_TABLE_WITH_SCORED_EVICTION */
+  return item;
 }
 /*---------------------------------------------------------------------------*/
 /* Removes a neighbor from the current table (unset "used" bit) */
@@ -413,6 +624,27 @@ nbr_table_unlock(nbr_table_t *table, void *item)
   return nbr_set_bit(locked_map, table, item, 0);
 }
 /*---------------------------------------------------------------------------*/
+/* Get the index of an item, -1 if the item is not in use */
+int
+nbr_table_get_index(nbr_table_t *table, const nbr_table_item_t *item)
+{
+  return nbr_get_bit(used_map, table, (nbr_table_item_t *)item) ?
+    index_from_item(table, item) : -1;
+}
+/*---------------------------------------------------------------------------*/
+/* Get an item from its index, NULL if the item is not in use */
+nbr_table_item_t *
+nbr_table_get_from_index(nbr_table_t *table, int index)
+{
+  nbr_table_item_t *item;
+
+  if(index < 0 || index >= NBR_TABLE_MAX_NEIGHBORS) {
+    return NULL;
+  }
+  item = item_from_index(table, index);
+  return nbr_get_bit(used_map, table, item) ? item : NULL;
+}
+/*---------------------------------------------------------------------------*/
 /* Get link-layer address of an item */
 linkaddr_t *
 nbr_table_get_lladdr(nbr_table_t *table, const void *item)
@@ -446,11 +678,17 @@ nbr_table_update_lladdr(const linkaddr_t *old_addr, const linkaddr_t *new_addr,
     return 0;
   }
   key = key_from_index(index);
+#if NBR_TABLE_WITH_HASH
+  hash_remove(key);
+#endif /* NBR_TABLE_WITH_HASH */
   /**
    * Copy the new lladdr into the key - since we know that there is no
    * conflicting entry.
    */
   memcpy(&key->lladdr, new_addr, sizeof(linkaddr_t));
+#if NBR_TABLE_WITH_HASH
+  hash_add(key);
+#endif /* NBR_TABLE_WITH_HASH */
   return 1;
 }
 /*---------------------------------------------------------------------------*/
@@ -46,6 +46,53 @@
 #define NBR_TABLE_MAX_NEIGHBORS 8
 #endif /* NBR_TABLE_CONF_MAX_NEIGHBORS */
 
+/* Index neighbors by link-layer address in a hash table, for constant
+ * time lookups instead of a scan of all neighbors. Worth it for large
+ * tables only */
+#ifdef NBR_TABLE_CONF_WITH_HASH
+#define NBR_TABLE_WITH_HASH NBR_TABLE_CONF_WITH_HASH
+#else /* NBR_TABLE_CONF_WITH_HASH */
+#define NBR_TABLE_WITH_HASH 0
+#endif /* NBR_TABLE_CONF_WITH_HASH */
+
+/* Number of slots of the hash table, at least NBR_TABLE_MAX_NEIGHBORS + 1 */
+#ifdef NBR_TABLE_CONF_HASH_SIZE
+#define NBR_TABLE_HASH_SIZE NBR_TABLE_CONF_HASH_SIZE
+#else /* NBR_TABLE_CONF_HASH_SIZE */
+#define NBR_TABLE_HASH_SIZE (2 * NBR_TABLE_MAX_NEIGHBORS)
+#endif /* NBR_TABLE_CONF_HASH_SIZE */
+
+/* Replace the default eviction policy (unlocked neighbor used by fewest
+ * tables, oldest first) with a scored one: each neighbor is scored from
+ * the number of tables using it, the reason it was added for, how
+ * recently it was looked up, and optionally an application-provided
+ * link quality score. A new neighbor may only evict one added for a
+ * reason of lower or equal priority, which keeps e.g. neighbors heard
+ * once in a broadcast from pushing out neighbors we route through.
+ * Only used when no NBR_TABLE_FIND_REMOVABLE policy is set */
+#ifdef NBR_TABLE_CONF_WITH_SCORED_EVICTION
+#define NBR_TABLE_WITH_SCORED_EVICTION NBR_TABLE_CONF_WITH_SCORED_EVICTION
+#else /* NBR_TABLE_CONF_WITH_SCORED_EVICTION */
+#define NBR_TABLE_WITH_SCORED_EVICTION 0
+#endif /* NBR_TABLE_CONF_WITH_SCORED_EVICTION */
+
+/* Seconds during which a neighbor that has just been added or looked up
+ * cannot be evicted by a new neighbor of the same priority. Prevents
+ * neighbors of equal worth from continuously replacing each other */
+#ifdef NBR_TABLE_CONF_EVICTION_GUARD_TIME
+#define NBR_TABLE_EVICTION_GUARD_TIME NBR_TABLE_CONF_EVICTION_GUARD_TIME
+#else /* NBR_TABLE_CONF_EVICTION_GUARD_TIME */
+#define NBR_TABLE_EVICTION_GUARD_TIME 30
+#endif /* NBR_TABLE_CONF_EVICTION_GUARD_TIME */
+
+/* Optional link quality score of a neighbor, added to its eviction
+ * score: int NBR_TABLE_CONF_EVICTION_SCORE(const linkaddr_t *lladdr),
+ * the higher the better, within [0, 64] to be on par with the other
+ * components of the score */
+#ifdef NBR_TABLE_CONF_EVICTION_SCORE
+#define NBR_TABLE_EVICTION_SCORE NBR_TABLE_CONF_EVICTION_SCORE
+#endif /* NBR_TABLE_CONF_EVICTION_SCORE */
+
 /* An item in a neighbor table */
 typedef void nbr_table_item_t;
 
@@ -100,6 +147,12 @@ nbr_table_item_t *nbr_table_add_lladdr(nbr_table_t *table, const linkaddr_t *lla
 nbr_table_item_t *nbr_table_get_from_lladdr(nbr_table_t *table, const linkaddr_t *lladdr);
 /** @} */
 
+/** \name Neighbor tables: compact references to table elements */
+/** @{ */
+int nbr_table_get_index(nbr_table_t *table, const nbr_table_item_t *item);
+nbr_table_item_t *nbr_table_get_from_index(nbr_table_t *table, int index);
+/** @} */
+
 /** \name Neighbor tables: set flags (unused, locked, unlocked) */
 /** @{ */
 int nbr_table_remove(nbr_table_t *table, nbr_table_item_t *item);
@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \file
+ *         Registry of network stack counters.
+ */
+
+#include "contiki.h"
+#include "lib/list.h"
+#include "net/net-stats.h"
+
+#if NET_STATS_ENABLED
+
+#if NETSTACK_CONF_WITH_IPV6 || NETSTACK_CONF_WITH_IPV4
+#include "net/ip/uip.h"
+#endif
+#include "net/rime/rimestats.h"
+#if UIP_CONF_IPV6_RPL
+#include "net/rpl/rpl-private.h"
+#endif
+
+LIST(groups);
+static uint8_t initialized;
+
+#if (NETSTACK_CONF_WITH_IPV6 || NETSTACK_CONF_WITH_IPV4) && UIP_STATISTICS == 1
+static const char * const ip_names[] = {
+  "ip.recv", "ip.sent", "ip.forwarded", "ip.drop",
+  "icmp.recv", "icmp.sent", "icmp.drop", "icmp.ratelimit",
+#if UIP_UDP
+  "udp.recv", "udp.sent", "udp.drop",
+#endif
+#if UIP_TCP
+  "tcp.recv", "tcp.sent", "tcp.drop", "tcp.rexmit",
+#endif
+};
+static uint32_t
+ip_get(uint8_t index)
+{
+  const uip_stats_t values[] = {
+    uip_stat.ip.recv, uip_stat.ip.sent, uip_stat.ip.forwarded, uip_stat.ip.drop,
+    uip_stat.icmp.recv, uip_stat.icmp.sent, uip_stat.icmp.drop,
+    uip_stat.icmp.ratelimit,
+#if UIP_UDP
+    uip_stat.udp.recv, uip_stat.udp.sent, uip_stat.udp.drop,
+#endif
+#if UIP_TCP
+    uip_stat.tcp.recv, uip_stat.tcp.sent, uip_stat.tcp.drop, uip_stat.tcp.rexmit,
+#endif
+  };
+  return values[index];
+}
+static struct net_stats_group ip_group = {
+  NULL, "uip", ip_names, sizeof(ip_names) / sizeof(ip_names[0]), ip_get
+};
+#define HAVE_IP_GROUP 1
+#endif /* UIP_STATISTICS */
+
+#if RIMESTATS_CONF_ENABLED
+static const char * const radio_names[] = {
+  "lltx", "llrx", "badcrc", "badsynch", "toolong", "tooshort",
+  "contentiondrop", "sendingdrop", "acktx", "noacktx",
+};
+static uint32_t
+radio_get(uint8_t index)
+{
+  const unsigned long values[] = {
+    RIMESTATS_GET(lltx), RIMESTATS_GET(llrx), RIMESTATS_GET(badcrc),
+    RIMESTATS_GET(badsynch), RIMESTATS_GET(toolong), RIMESTATS_GET(tooshort),
+    RIMESTATS_GET(contentiondrop), RIMESTATS_GET(sendingdrop),
+    RIMESTATS_GET(acktx), RIMESTATS_GET(noacktx),
+  };
+  return values[index];
+}
+static struct net_stats_group radio_group = {
+  NULL, "radio", radio_names, sizeof(radio_names) / sizeof(radio_names[0]),
+  radio_get
+};
+#endif /* RIMESTATS_CONF_ENABLED */
+
+#if UIP_CONF_IPV6_RPL && RPL_CONF_STATS
+static const char * const rpl_names[] = {
+  "mem_overflows", "local_repairs", "global_repairs", "malformed_msgs",
+  "resets", "parent_switch", "forward_errors", "loop_errors",
+  "loop_warnings", "root_repairs", "fast_reroutes",
+};
+static uint32_t
+rpl_get(uint8_t index)
+{
+  /* rpl_stats is all uint16_t, in the order of rpl_names */
+  return ((const uint16_t *)&rpl_stats)[index];
+}
+static struct net_stats_group rpl_group = {
+  NULL, "rpl", rpl_names, sizeof(rpl_names) / sizeof(rpl_names[0]), rpl_get
+};
+#endif /* UIP_CONF_IPV6_RPL && RPL_CONF_STATS */
+/*---------------------------------------------------------------------------*/
+static void
+init(void)
+{
+  if(initialized) {
+    return;
+  }
+  initialized = 1;
+  list_init(groups);
+#if RIMESTATS_CONF_ENABLED
+  list_add(groups, &radio_group);
+#endif
+#if HAVE_IP_GROUP
+  list_add(groups, &ip_group);
+#endif
+#if UIP_CONF_IPV6_RPL && RPL_CONF_STATS
+  list_add(groups, &rpl_group);
+#endif
+}
+/*---------------------------------------------------------------------------*/
+void
+net_stats_register(struct net_stats_group *group)
+{
+  init();
+  list_add(groups, group);
+}
+/*---------------------------------------------------------------------------*/
+struct net_stats_group *
+net_stats_list(void)
+{
+  init();
+  return list_head(groups);
+}
+/*---------------------------------------------------------------------------*/
+int
+net_stats_count(void)
+{
+  struct net_stats_group *g;
+  int count = 0;
+
+  for(g = net_stats_list(); g != NULL; g = g->next) {
+    count += g->num;
+  }
+  return count;
+}
+/*---------------------------------------------------------------------------*/
+#endif /* NET_STATS_ENABLED */
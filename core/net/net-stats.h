@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \file
+ *         A registry of the counters kept by the layers of the network
+ *         stack, read by the shell and the CoAP stats resource.
+ */
+
+#ifndef NET_STATS_H_
+#define NET_STATS_H_
+
+#include "contiki.h"
+
+#ifdef NET_STATS_CONF_ENABLED
+#define NET_STATS_ENABLED NET_STATS_CONF_ENABLED
+#else
+#define NET_STATS_ENABLED 0
+#endif
+
+/** The counters of one layer */
+struct net_stats_group {
+  struct net_stats_group *next;
+  const char *name;
+  /** The names of the counters, num of them */
+  const char * const *names;
+  uint8_t num;
+  /** Get the value of a counter */
+  uint32_t (* get)(uint8_t index);
+};
+
+#if NET_STATS_ENABLED
+#define NET_STATS_ADD(counters, index) ((counters)[index]++)
+
+/**
+ * Make the counters of a group available. Groups for uip_stat, rimestats
+ * and rpl_stats are registered when these are enabled.
+ */
+void net_stats_register(struct net_stats_group *group);
+
+/**
+ * Get the registered groups.
+ *
+ * \return The first group, the next one being its next field.
+ */
+struct net_stats_group *net_stats_list(void);
+
+/** The number of counters of all groups */
+int net_stats_count(void);
+#else /* NET_STATS_ENABLED */
+#define NET_STATS_ADD(counters, index)
+#define net_stats_register(group)
+#endif /* NET_STATS_ENABLED */
+
+#endif /* NET_STATS_H_ */
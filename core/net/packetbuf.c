@@ -51,6 +51,10 @@
 
 struct packetbuf_attr packetbuf_attrs[PACKETBUF_NUM_ATTRS];
 struct packetbuf_addr packetbuf_addrs[PACKETBUF_NUM_ADDRS];
+#if PACKETBUF_WITH_USED_ATTRS
+uint8_t packetbuf_used_attrs[PACKETBUF_USED_ATTRS_LEN];
+#define IS_ATTR_USED(used, type) (((used)[(type) >> 3] & (1 << ((type) & 7))) != 0)
+#endif /* PACKETBUF_WITH_USED_ATTRS */
 
 
 static uint16_t buflen, bufptr;
@@ -88,7 +92,7 @@ packetbuf_copyfrom(const void *from, uint16_t len)
 
   packetbuf_clear();
   l = MIN(PACKETBUF_SIZE, len);
-  memcpy(packetbuf, from, l);
+  CONTIKI_ARCH_MEMCPY(packetbuf, from, l);
   buflen = l;
   return l;
 }
@@ -113,11 +117,25 @@ packetbuf_copyto(void *to)
   if(hdrlen + buflen > PACKETBUF_SIZE) {
     return 0;
   }
-  memcpy(to, packetbuf_hdrptr(), hdrlen);
-  memcpy((uint8_t *)to + hdrlen, packetbuf_dataptr(), buflen);
+  CONTIKI_ARCH_MEMCPY(to, packetbuf_hdrptr(), hdrlen);
+  CONTIKI_ARCH_MEMCPY((uint8_t *)to + hdrlen, packetbuf_dataptr(), buflen);
   return hdrlen + buflen;
 }
 /*---------------------------------------------------------------------------*/
+void *
+packetbuf_swap_storage(void *storage, uint16_t len)
+{
+  uint8_t *former = packetbuf;
+
+  /* Make header and data consecutive */
+  packetbuf_compact();
+  packetbuf = storage;
+  buflen = MIN(PACKETBUF_SIZE, len);
+  bufptr = 0;
+  hdrlen = 0;
+  return former;
+}
+/*---------------------------------------------------------------------------*/
 int
 packetbuf_hdralloc(int size)
 {
@@ -188,7 +206,20 @@ void
 packetbuf_attr_clear(void)
 {
   int i;
-  memset(packetbuf_attrs, 0, sizeof(packetbuf_attrs));
+#if PACKETBUF_WITH_USED_ATTRS
+  for(i = 0; i < PACKETBUF_USED_ATTRS_LEN; ++i) {
+    int j;
+    /* Only clear the attributes in use, skipping eight at once if none */
+    for(j = 0; packetbuf_used_attrs[i] >> j; ++j) {
+      if(IS_ATTR_USED(packetbuf_used_attrs, i * 8 + j)) {
+        packetbuf_attrs[i * 8 + j].val = 0;
+      }
+    }
+    packetbuf_used_attrs[i] = 0;
+  }
+#else /* PACKETBUF_WITH_USED_ATTRS */
+  CONTIKI_ARCH_MEMSET(packetbuf_attrs, 0, sizeof(packetbuf_attrs));
+#endif /* PACKETBUF_WITH_USED_ATTRS */
   for(i = 0; i < PACKETBUF_NUM_ADDRS; ++i) {
     linkaddr_copy(&packetbuf_addrs[i].addr, &linkaddr_null);
   }
@@ -208,13 +239,81 @@ packetbuf_attr_copyfrom(struct packetbuf_attr *attrs,
 {
   memcpy(packetbuf_attrs, attrs, sizeof(packetbuf_attrs));
   memcpy(packetbuf_addrs, addrs, sizeof(packetbuf_addrs));
+#if PACKETBUF_WITH_USED_ATTRS
+  /* We do not know which were set, assume all */
+  memset(packetbuf_used_attrs, 0xff, sizeof(packetbuf_used_attrs));
+#if PACKETBUF_NUM_ATTRS % 8
+  packetbuf_used_attrs[PACKETBUF_USED_ATTRS_LEN - 1] = (1 << (PACKETBUF_NUM_ATTRS % 8)) - 1;
+#endif
+#endif /* PACKETBUF_WITH_USED_ATTRS */
+}
+#if PACKETBUF_WITH_USED_ATTRS
+/*---------------------------------------------------------------------------*/
+int
+packetbuf_attr_pack(packetbuf_attr_t *vals, int max_vals, uint8_t *used)
+{
+  int i, j;
+  int n = 0;
+  memset(used, 0, PACKETBUF_USED_ATTRS_LEN);
+  for(i = 0; i < PACKETBUF_USED_ATTRS_LEN; ++i) {
+    /* Skip eight unused attributes at once */
+    for(j = 0; packetbuf_used_attrs[i] >> j; ++j) {
+      int type = i * 8 + j;
+      if(IS_ATTR_USED(packetbuf_used_attrs, type)
+         && packetbuf_attrs[type].val != 0) {
+        if(n == max_vals) {
+          return -1;
+        }
+        vals[n++] = packetbuf_attrs[type].val;
+        used[i] |= 1 << j;
+      }
+    }
+  }
+  return n;
+}
+/*---------------------------------------------------------------------------*/
+void
+packetbuf_attr_unpack(const packetbuf_attr_t *vals, const uint8_t *used)
+{
+  int i, j;
+  int n = 0;
+  for(i = 0; i < PACKETBUF_USED_ATTRS_LEN; ++i) {
+    uint8_t bits = packetbuf_used_attrs[i] | used[i];
+    for(j = 0; bits >> j; ++j) {
+      int type = i * 8 + j;
+      if(IS_ATTR_USED(used, type)) {
+        packetbuf_attrs[type].val = vals[n++];
+      } else if(IS_ATTR_USED(packetbuf_used_attrs, type)) {
+        packetbuf_attrs[type].val = 0;
+      }
+    }
+  }
+  memcpy(packetbuf_used_attrs, used, PACKETBUF_USED_ATTRS_LEN);
+}
+/*---------------------------------------------------------------------------*/
+packetbuf_attr_t
+packetbuf_attr_packed_get(const packetbuf_attr_t *vals, const uint8_t *used,
+                          uint8_t type)
+{
+  int i;
+  int n = 0;
+  if(!IS_ATTR_USED(used, type)) {
+    return 0;
+  }
+  /* The value is preceded by one per attribute set before it */
+  for(i = 0; i < type; ++i) {
+    n += IS_ATTR_USED(used, i);
+  }
+  return vals[n];
 }
+#endif /* PACKETBUF_WITH_USED_ATTRS */
 /*---------------------------------------------------------------------------*/
 #if !PACKETBUF_CONF_ATTRS_INLINE
 int
 packetbuf_set_attr(uint8_t type, const packetbuf_attr_t val)
 {
   packetbuf_attrs[type].val = val;
+  PACKETBUF_MARK_ATTR_USED(type);
   return 1;
 }
 /*---------------------------------------------------------------------------*/
@@ -66,6 +66,16 @@
 #define PACKETBUF_SIZE 128
 #endif
 
+/* Keep track of the attributes set since the last packetbuf_attr_clear(),
+ * so that clearing, saving and restoring attributes only touches those
+ * in use. Queuebufs then keep a compact snapshot of the attributes
+ * (see packetbuf_attr_pack()) */
+#ifdef PACKETBUF_CONF_WITH_USED_ATTRS
+#define PACKETBUF_WITH_USED_ATTRS PACKETBUF_CONF_WITH_USED_ATTRS
+#else
+#define PACKETBUF_WITH_USED_ATTRS 0
+#endif
+
 #ifdef PACKETBUF_CONF_WITH_PACKET_TYPE
 #define PACKETBUF_WITH_PACKET_TYPE PACKETBUF_CONF_WITH_PACKET_TYPE
 #else
@@ -176,6 +186,23 @@ int packetbuf_copyfrom(const void *from, uint16_t len);
  */
 int packetbuf_copyto(void *to);
 
+/**
+ * \brief      Replace the packetbuf storage with an external buffer
+ * \param storage A 32-bit aligned buffer of PACKETBUF_SIZE bytes
+ * \param len  The length of the packet held in the buffer
+ * \retval     The former packetbuf storage
+ *
+ *             This function hands the packetbuf storage over to the
+ *             caller instead of copying it. The former storage holds
+ *             the header immediately followed by the data, as laid out
+ *             by packetbuf_copyto(), on packetbuf_totlen() bytes as
+ *             returned before the call. The packetbuf then holds the
+ *             len bytes of the new storage as data, with no header.
+ *             Attributes are left untouched.
+ *
+ */
+void *packetbuf_swap_storage(void *storage, uint16_t len);
+
 /**
  * \brief      Extend the header of the packetbuf, for outbound packets
  * \param size The number of bytes the header should be extended
@@ -231,8 +258,13 @@ enum {
   PACKETBUF_ATTR_RSSI,
   PACKETBUF_ATTR_TIMESTAMP,
   PACKETBUF_ATTR_RADIO_TXPOWER,
+  /* Set by radio drivers to the PHY mode + 1 a packet was sent or
+     received with, when not the one the radio listens with
+     (RADIO_PARAM_PHY_MODE) */
+  PACKETBUF_ATTR_PHY_MODE,
   PACKETBUF_ATTR_LISTEN_TIME,
   PACKETBUF_ATTR_TRANSMIT_TIME,
+  PACKETBUF_ATTR_FLOW,
   PACKETBUF_ATTR_MAX_MAC_TRANSMISSIONS,
   PACKETBUF_ATTR_MAC_SEQNO,
   PACKETBUF_ATTR_MAC_ACK,
@@ -241,6 +273,10 @@ enum {
   PACKETBUF_ATTR_TSCH_SLOTFRAME,
   PACKETBUF_ATTR_TSCH_TIMESLOT,
 #endif /* TSCH_WITH_LINK_SELECTOR */
+#if LATENCY_TRACE_CONF_ENABLED
+  /* The id of the latency trace of a packet (see net/latency-trace.h) */
+  PACKETBUF_ATTR_LATENCY_TRACE,
+#endif /* LATENCY_TRACE_CONF_ENABLED */
   
   /* Scope 1 attributes: used between two neighbors only. */
 #if PACKETBUF_WITH_PACKET_TYPE
@@ -298,6 +334,16 @@ enum {
 
 #define PACKETBUF_IS_ADDR(type) ((type) >= PACKETBUF_ADDR_FIRST)
 
+#if PACKETBUF_WITH_USED_ATTRS
+/* Bitmap of the attributes set since the last packetbuf_attr_clear() */
+#define PACKETBUF_USED_ATTRS_LEN ((PACKETBUF_NUM_ATTRS + 7) / 8)
+extern uint8_t packetbuf_used_attrs[];
+#define PACKETBUF_MARK_ATTR_USED(type) \
+  (packetbuf_used_attrs[(type) >> 3] |= 1 << ((type) & 7))
+#else /* PACKETBUF_WITH_USED_ATTRS */
+#define PACKETBUF_MARK_ATTR_USED(type)
+#endif /* PACKETBUF_WITH_USED_ATTRS */
+
 #if PACKETBUF_CONF_ATTRS_INLINE
 
 extern struct packetbuf_attr packetbuf_attrs[];
@@ -307,6 +353,7 @@ static inline int
 packetbuf_set_attr(uint8_t type, const packetbuf_attr_t val)
 {
   packetbuf_attrs[type].val = val;
+  PACKETBUF_MARK_ATTR_USED(type);
   return 1;
 }
 static inline packetbuf_attr_t
@@ -346,6 +393,20 @@ void              packetbuf_attr_copyto(struct packetbuf_attr *attrs,
 				      struct packetbuf_addr *addrs);
 void              packetbuf_attr_copyfrom(struct packetbuf_attr *attrs,
 					struct packetbuf_addr *addrs);
+#if PACKETBUF_WITH_USED_ATTRS
+/* Compact snapshot of the attributes: a bitmap of PACKETBUF_USED_ATTRS_LEN
+ * bytes telling which attributes are set (to a non-zero value), and
+ * their values packed in attribute order. packetbuf_attr_pack() returns
+ * the number of values, or -1 if more than max_vals are set. Addresses
+ * are not part of the snapshot */
+int               packetbuf_attr_pack(packetbuf_attr_t *vals, int max_vals,
+                                      uint8_t *used);
+void              packetbuf_attr_unpack(const packetbuf_attr_t *vals,
+                                        const uint8_t *used);
+/* Value of an attribute in a snapshot */
+packetbuf_attr_t  packetbuf_attr_packed_get(const packetbuf_attr_t *vals,
+                                            const uint8_t *used, uint8_t type);
+#endif /* PACKETBUF_WITH_USED_ATTRS */
 
 #define PACKETBUF_ATTRIBUTES(...) { __VA_ARGS__ PACKETBUF_ATTR_LAST }
 #define PACKETBUF_ATTR_LAST { PACKETBUF_ATTR_NONE, 0 }
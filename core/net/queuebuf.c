@@ -60,9 +60,12 @@ struct queuebuf {
   clock_time_t time;
 #endif /* QUEUEBUF_DEBUG */
 #if WITH_SWAP
-  enum {IN_RAM, IN_CFS} location;
+  /* Allocation order, the oldest swapped queuebuf is brought back first */
+  uint16_t seq;
+  enum {IN_RAM, IN_BATCH, IN_CFS} location;
   union {
 #endif
+    /* In RAM or in the batch */
     struct queuebuf_data *ram_ptr;
 #if WITH_SWAP
     int swap_id;
@@ -72,21 +75,48 @@ struct queuebuf {
 
 /* The actual queuebuf data */
 struct queuebuf_data {
+#if !QUEUEBUF_WITH_ZERO_COPY
   uint8_t data[PACKETBUF_SIZE];
+#endif /* !QUEUEBUF_WITH_ZERO_COPY */
   uint16_t len;
+#if PACKETBUF_WITH_USED_ATTRS
+  /* Compact snapshot of the attributes */
+  packetbuf_attr_t attrs[QUEUEBUF_NUM_ATTRS];
+  uint8_t used_attrs[PACKETBUF_USED_ATTRS_LEN];
+#else /* PACKETBUF_WITH_USED_ATTRS */
   struct packetbuf_attr attrs[PACKETBUF_NUM_ATTRS];
+#endif /* PACKETBUF_WITH_USED_ATTRS */
   struct packetbuf_addr addrs[PACKETBUF_NUM_ADDRS];
 };
 
-MEMB(bufmem, struct queuebuf, QUEUEBUF_NUM);
-MEMB(buframmem, struct queuebuf_data, QUEUEBUFRAM_NUM);
+MEMB_BITMAP(bufmem, struct queuebuf, QUEUEBUF_NUM);
+MEMB_BITMAP(buframmem, struct queuebuf_data, QUEUEBUFRAM_NUM);
+
+#if QUEUEBUF_WITH_ZERO_COPY
+/* Packet storage, aligned like the packetbuf. Every queuebuf_data,
+ * allocated or not, owns one of these through data_ptr, which it
+ * exchanges with the packetbuf's. Kept outside of queuebuf_data as
+ * memb_init() would wipe it */
+static uint32_t storage[QUEUEBUFRAM_NUM][(PACKETBUF_SIZE + 3) / 4];
+static uint8_t *data_ptr[QUEUEBUFRAM_NUM];
+#define QUEUEBUF_DATA(b) data_ptr[(b) - (struct queuebuf_data *)buframmem.mem]
+#else /* QUEUEBUF_WITH_ZERO_COPY */
+#define QUEUEBUF_DATA(b) ((b)->data)
+#endif /* QUEUEBUF_WITH_ZERO_COPY */
 
 #if WITH_SWAP
 
 /* Swapping allows to store up to QUEUEBUF_NUM - QUEUEBUFRAM_NUM
    queuebufs in CFS. The swap is made of several large CFS files.
    Every buffer stored in CFS has a swap id, referring to a specific
-   offset in one of these files. */
+   offset in one of these files.
+
+   Queued packets are mostly sent in the order they were queued, so
+   the newest ones are those swapped: when RAM is full, a new queuebuf
+   goes to a batch of QUEUEBUF_SWAP_BATCH buffers, written to CFS
+   together when the batch is full. Swap ids are handed out in order,
+   so that one write stores a whole batch. As RAM frees up, the oldest
+   swapped queuebufs are brought back, before they are to be sent. */
 #define NQBUF_FILES 4
 #define NQBUF_PER_FILE 256
 #define QBUF_FILE_SIZE (NQBUF_PER_FILE*sizeof(struct queuebuf_data))
@@ -108,6 +138,14 @@ static int next_swap_id = 0;
 static struct qbuf_file qbuf_files[NQBUF_FILES];
 /* The timer used to renew files during inactivity periods */
 static struct ctimer renew_timer;
+/* The queuebufs waiting to be written to CFS together */
+static struct queuebuf_data batch[QUEUEBUF_SWAP_BATCH];
+static struct queuebuf *batch_qbuf[QUEUEBUF_SWAP_BATCH];
+/* The queuebufs in the batch or in CFS */
+static int num_swapped;
+static uint16_t next_seq;
+/* The timer used to bring swapped queuebufs back to RAM */
+static struct ctimer prefetch_timer;
 
 #endif
 
@@ -184,7 +222,7 @@ queuebuf_remove_from_file(int swap_id)
       ctimer_set(&renew_timer, 0, qbuf_renew_all, NULL);
     }
 
-    if(tmpdata_qbuf->swap_id == swap_id) {
+    if(tmpdata_qbuf != NULL && tmpdata_qbuf->swap_id == swap_id) {
       tmpdata_qbuf->swap_id = -1;
     }
   }
@@ -238,13 +276,96 @@ queuebuf_flush_tmpdata(void)
   return 0;
 }
 /*---------------------------------------------------------------------------*/
+/* Writes count queuebufs of the batch, from batch[first], with the
+   swap ids following swap_id, all in the same file */
+static void
+write_batch_run(int first, int count, int swap_id)
+{
+  int fd, i, len;
+  cfs_offset_t offset;
+
+  fd = qbuf_files[swap_id / NQBUF_PER_FILE].fd;
+  offset = (swap_id % NQBUF_PER_FILE) * sizeof(struct queuebuf_data);
+  len = count * sizeof(struct queuebuf_data);
+  if(cfs_seek(fd, offset, CFS_SEEK_SET) == -1 ||
+     cfs_write(fd, &batch[first], len) != len) {
+    PRINTF("write_batch_run: cfs error\n");
+    /* They stay in the batch */
+    for(i = 0; i < count; i++) {
+      queuebuf_remove_from_file(swap_id + i);
+    }
+    return;
+  }
+  for(i = first; i < first + count; i++) {
+    batch_qbuf[i]->location = IN_CFS;
+    batch_qbuf[i]->swap_id = swap_id++;
+    batch_qbuf[i] = NULL;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Writes the batch to CFS, consecutive swap ids in a single write */
+static void
+flush_batch(void)
+{
+  int i, id;
+  int first = 0, count = 0, first_id = 0;
+
+  for(i = 0; i < QUEUEBUF_SWAP_BATCH; i++) {
+    if(batch_qbuf[i] == NULL) {
+      if(count > 0) {
+        write_batch_run(first, count, first_id);
+        count = 0;
+      }
+      continue;
+    }
+    id = get_new_swap_id();
+    /* A new file, or the end of the swap, starts a new write */
+    if(count > 0 && (id != first_id + count || id % NQBUF_PER_FILE == 0)) {
+      write_batch_run(first, count, first_id);
+      count = 0;
+    }
+    if(id == -1) {
+      /* The swap is full */
+      break;
+    }
+    if(count == 0) {
+      first = i;
+      first_id = id;
+    }
+    count++;
+  }
+  if(count > 0) {
+    write_batch_run(first, count, first_id);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* A free buffer of the batch, writing the batch to CFS if needed */
+static int
+batch_slot(void)
+{
+  int i;
+
+  for(i = 0; i < QUEUEBUF_SWAP_BATCH; i++) {
+    if(batch_qbuf[i] == NULL) {
+      return i;
+    }
+  }
+  flush_batch();
+  for(i = 0; i < QUEUEBUF_SWAP_BATCH; i++) {
+    if(batch_qbuf[i] == NULL) {
+      return i;
+    }
+  }
+  return -1;
+}
+/*---------------------------------------------------------------------------*/
 /* If the queuebuf is in CFS, load it to tmpdata */
 static struct queuebuf_data *
 queuebuf_load_to_ram(struct queuebuf *b)
 {
   int fileid, fd, ret;
   cfs_offset_t offset;
-  if(b->location == IN_RAM) { /* the qbuf is loacted in RAM */
+  if(b->location != IN_CFS) { /* the qbuf is loacted in RAM */
     return b->ram_ptr;
   } else { /* the qbuf is located in CFS */
     if(tmpdata_qbuf && tmpdata_qbuf->swap_id == b->swap_id) { /* the qbuf is already in tmpdata */
@@ -267,6 +388,43 @@ queuebuf_load_to_ram(struct queuebuf *b)
     }
   }
 }
+/*---------------------------------------------------------------------------*/
+/* Brings the oldest swapped queuebufs back to RAM, while it has room */
+static void
+prefetch(void *unused)
+{
+  struct queuebuf *b, *oldest;
+  struct queuebuf_data *buframptr;
+  int i;
+
+  while(num_swapped > 0 && memb_numfree(&buframmem) > 0) {
+    oldest = NULL;
+    for(i = 0; i < QUEUEBUF_NUM; i++) {
+      b = &((struct queuebuf *)bufmem.mem)[i];
+      if(b->location != IN_RAM &&
+         (oldest == NULL || (int16_t)(b->seq - oldest->seq) < 0)) {
+        oldest = b;
+      }
+    }
+    if(oldest == NULL) {
+      return;
+    }
+    buframptr = memb_alloc(&buframmem);
+    memcpy(buframptr, queuebuf_load_to_ram(oldest), sizeof(struct queuebuf_data));
+    if(oldest->location == IN_BATCH) {
+      batch_qbuf[oldest->ram_ptr - batch] = NULL;
+    } else {
+      queuebuf_remove_from_file(oldest->swap_id);
+      if(tmpdata_qbuf == oldest) {
+        tmpdata_qbuf = NULL;
+      }
+    }
+    PRINTF("queuebuf: brought %u back to RAM\n", oldest->seq);
+    oldest->location = IN_RAM;
+    oldest->ram_ptr = buframptr;
+    num_swapped--;
+  }
+}
 #else /* WITH_SWAP */
 /*---------------------------------------------------------------------------*/
 static struct queuebuf_data *
@@ -276,18 +434,97 @@ queuebuf_load_to_ram(struct queuebuf *b)
 }
 #endif /* WITH_SWAP */
 /*---------------------------------------------------------------------------*/
+#if PACKETBUF_WITH_USED_ATTRS
+/* Compact snapshot of the packetbuf attributes, taken by pack_attrs() */
+static packetbuf_attr_t packed_attrs[QUEUEBUF_NUM_ATTRS];
+static uint8_t packed_used_attrs[PACKETBUF_USED_ATTRS_LEN];
+static int packed_num_attrs;
+#endif /* PACKETBUF_WITH_USED_ATTRS */
+/*---------------------------------------------------------------------------*/
+/* Takes a snapshot of the packetbuf attributes. Returns 0 if they do
+ * not fit in a queuebuf */
+static int
+pack_attrs(void)
+{
+#if PACKETBUF_WITH_USED_ATTRS
+  packed_num_attrs = packetbuf_attr_pack(packed_attrs, QUEUEBUF_NUM_ATTRS, packed_used_attrs);
+  if(packed_num_attrs < 0) {
+    PRINTF("queuebuf: too many attributes\n");
+    return 0;
+  }
+#endif /* PACKETBUF_WITH_USED_ATTRS */
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Stores the snapshot of the attributes, and the addresses */
+static void
+store_attrs(struct queuebuf_data *buframptr)
+{
+#if PACKETBUF_WITH_USED_ATTRS
+  int i;
+  memcpy(buframptr->attrs, packed_attrs, packed_num_attrs * sizeof(packetbuf_attr_t));
+  memcpy(buframptr->used_attrs, packed_used_attrs, sizeof(packed_used_attrs));
+  for(i = 0; i < PACKETBUF_NUM_ADDRS; i++) {
+    linkaddr_copy(&buframptr->addrs[i].addr, packetbuf_addr(PACKETBUF_ADDR_FIRST + i));
+  }
+#else /* PACKETBUF_WITH_USED_ATTRS */
+  packetbuf_attr_copyto(buframptr->attrs, buframptr->addrs);
+#endif /* PACKETBUF_WITH_USED_ATTRS */
+}
+/*---------------------------------------------------------------------------*/
+static void
+attrs_from_packetbuf(struct queuebuf_data *buframptr)
+{
+  if(pack_attrs()) {
+    store_attrs(buframptr);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+attrs_to_packetbuf(struct queuebuf_data *buframptr)
+{
+#if PACKETBUF_WITH_USED_ATTRS
+  int i;
+  packetbuf_attr_unpack(buframptr->attrs, buframptr->used_attrs);
+  for(i = 0; i < PACKETBUF_NUM_ADDRS; i++) {
+    packetbuf_set_addr(PACKETBUF_ADDR_FIRST + i, &buframptr->addrs[i].addr);
+  }
+#else /* PACKETBUF_WITH_USED_ATTRS */
+  packetbuf_attr_copyfrom(buframptr->attrs, buframptr->addrs);
+#endif /* PACKETBUF_WITH_USED_ATTRS */
+}
+/*---------------------------------------------------------------------------*/
 void
 queuebuf_init(void)
 {
-#if WITH_SWAP
+#if WITH_SWAP || QUEUEBUF_WITH_ZERO_COPY
   int i;
+#endif
+#if WITH_SWAP
   for(i=0; i<NQBUF_FILES; i++) {
     qbuf_files[i].renewable = 1;
     qbuf_renew_file(i);
   }
+  /* Free queuebufs are marked as in RAM, to not be brought back */
+  for(i = 0; i < QUEUEBUF_NUM; i++) {
+    ((struct queuebuf *)bufmem.mem)[i].location = IN_RAM;
+  }
+  for(i = 0; i < QUEUEBUF_SWAP_BATCH; i++) {
+    batch_qbuf[i] = NULL;
+  }
+  tmpdata_qbuf = NULL;
+  num_swapped = 0;
 #endif
   memb_init(&buframmem);
   memb_init(&bufmem);
+#if QUEUEBUF_WITH_ZERO_COPY
+  /* Only once: storage may already have been exchanged with the packetbuf */
+  if(data_ptr[0] == NULL) {
+    for(i = 0; i < QUEUEBUFRAM_NUM; i++) {
+      data_ptr[i] = (uint8_t *)storage[i];
+    }
+  }
+#endif /* QUEUEBUF_WITH_ZERO_COPY */
 #if QUEUEBUF_STATS
   queuebuf_max_len = 0;
 #endif /* QUEUEBUF_STATS */
@@ -299,17 +536,17 @@ queuebuf_numfree(void)
   return memb_numfree(&bufmem);
 }
 /*---------------------------------------------------------------------------*/
-#if QUEUEBUF_DEBUG
-struct queuebuf *
-queuebuf_new_from_packetbuf_debug(const char *file, int line)
-#else /* QUEUEBUF_DEBUG */
-struct queuebuf *
-queuebuf_new_from_packetbuf(void)
-#endif /* QUEUEBUF_DEBUG */
+/* Allocates a queuebuf holding the packetbuf, copied or taken over */
+static struct queuebuf *
+queuebuf_new(int take, const char *file, int line)
 {
   struct queuebuf *buf;
 
   struct queuebuf_data *buframptr;
+
+  if(!pack_attrs()) {
+    return NULL;
+  }
   buf = memb_alloc(&bufmem);
   if(buf != NULL) {
 #if QUEUEBUF_DEBUG
@@ -323,13 +560,23 @@ queuebuf_new_from_packetbuf(void)
     /* If the allocation failed, store the qbuf in swap files */
     if(buf->ram_ptr != NULL) {
       buf->location = IN_RAM;
-      buframptr = buf->ram_ptr;
     } else {
-      buf->location = IN_CFS;
-      buf->swap_id = -1;
-      tmpdata_qbuf = buf;
-      buframptr = &tmpdata;
+      int slot = batch_slot();
+      if(slot == -1) {
+        PRINTF("queuebuf_new_from_packetbuf: swap full\n");
+#if QUEUEBUF_DEBUG
+        list_remove(queuebuf_list, buf);
+#endif /* QUEUEBUF_DEBUG */
+        memb_free(&bufmem, buf);
+        return NULL;
+      }
+      buf->location = IN_BATCH;
+      buf->ram_ptr = &batch[slot];
+      batch_qbuf[slot] = buf;
+      num_swapped++;
     }
+    buf->seq = next_seq++;
+    buframptr = buf->ram_ptr;
 #else
     if(buf->ram_ptr == NULL) {
       PRINTF("queuebuf_new_from_packetbuf: could not queuebuf data\n");
@@ -339,18 +586,17 @@ queuebuf_new_from_packetbuf(void)
     buframptr = buf->ram_ptr;
 #endif
 
-    buframptr->len = packetbuf_copyto(buframptr->data);
-    packetbuf_attr_copyto(buframptr->attrs, buframptr->addrs);
-
-#if WITH_SWAP
-    if(buf->location == IN_CFS) {
-      if(queuebuf_flush_tmpdata() == -1) {
-        /* We were unable to write the data in the swap */
-        memb_free(&bufmem, buf);
-        return NULL;
-      }
+    store_attrs(buframptr);
+#if QUEUEBUF_WITH_ZERO_COPY
+    if(take) {
+      buframptr->len = packetbuf_totlen();
+      QUEUEBUF_DATA(buframptr) = packetbuf_swap_storage(QUEUEBUF_DATA(buframptr), 0);
+      packetbuf_clear();
+    } else
+#endif /* QUEUEBUF_WITH_ZERO_COPY */
+    {
+      buframptr->len = packetbuf_copyto(QUEUEBUF_DATA(buframptr));
     }
-#endif
 
 #if QUEUEBUF_STATS
     ++queuebuf_len;
@@ -366,11 +612,37 @@ queuebuf_new_from_packetbuf(void)
   return buf;
 }
 /*---------------------------------------------------------------------------*/
+#if QUEUEBUF_DEBUG
+struct queuebuf *
+queuebuf_new_from_packetbuf_debug(const char *file, int line)
+{
+  return queuebuf_new(0, file, line);
+}
+/*---------------------------------------------------------------------------*/
+struct queuebuf *
+queuebuf_take_packetbuf_debug(const char *file, int line)
+{
+  return queuebuf_new(1, file, line);
+}
+#else /* QUEUEBUF_DEBUG */
+struct queuebuf *
+queuebuf_new_from_packetbuf(void)
+{
+  return queuebuf_new(0, NULL, 0);
+}
+/*---------------------------------------------------------------------------*/
+struct queuebuf *
+queuebuf_take_packetbuf(void)
+{
+  return queuebuf_new(1, NULL, 0);
+}
+#endif /* QUEUEBUF_DEBUG */
+/*---------------------------------------------------------------------------*/
 void
 queuebuf_update_attr_from_packetbuf(struct queuebuf *buf)
 {
   struct queuebuf_data *buframptr = queuebuf_load_to_ram(buf);
-  packetbuf_attr_copyto(buframptr->attrs, buframptr->addrs);
+  attrs_from_packetbuf(buframptr);
 #if WITH_SWAP
   if(buf->location == IN_CFS) {
     queuebuf_flush_tmpdata();
@@ -382,8 +654,8 @@ void
 queuebuf_update_from_packetbuf(struct queuebuf *buf)
 {
   struct queuebuf_data *buframptr = queuebuf_load_to_ram(buf);
-  packetbuf_attr_copyto(buframptr->attrs, buframptr->addrs);
-  buframptr->len = packetbuf_copyto(buframptr->data);
+  attrs_from_packetbuf(buframptr);
+  buframptr->len = packetbuf_copyto(QUEUEBUF_DATA(buframptr));
 #if WITH_SWAP
   if(buf->location == IN_CFS) {
     queuebuf_flush_tmpdata();
@@ -398,8 +670,20 @@ queuebuf_free(struct queuebuf *buf)
 #if WITH_SWAP
     if(buf->location == IN_RAM) {
       memb_free(&buframmem, buf->ram_ptr);
+      if(num_swapped > 0) {
+        ctimer_set(&prefetch_timer, 0, prefetch, NULL);
+      }
     } else {
-      queuebuf_remove_from_file(buf->swap_id);
+      if(buf->location == IN_BATCH) {
+        batch_qbuf[buf->ram_ptr - batch] = NULL;
+      } else {
+        queuebuf_remove_from_file(buf->swap_id);
+        if(tmpdata_qbuf == buf) {
+          tmpdata_qbuf = NULL;
+        }
+      }
+      buf->location = IN_RAM;
+      num_swapped--;
     }
 #else
     memb_free(&buframmem, buf->ram_ptr);
@@ -420,9 +704,24 @@ queuebuf_to_packetbuf(struct queuebuf *b)
 {
   if(memb_inmemb(&bufmem, b)) {
     struct queuebuf_data *buframptr = queuebuf_load_to_ram(b);
-    packetbuf_copyfrom(buframptr->data, buframptr->len);
-    packetbuf_attr_copyfrom(buframptr->attrs, buframptr->addrs);
+    packetbuf_copyfrom(QUEUEBUF_DATA(buframptr), buframptr->len);
+    attrs_to_packetbuf(buframptr);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+queuebuf_give_to_packetbuf(struct queuebuf *b)
+{
+#if QUEUEBUF_WITH_ZERO_COPY
+  if(memb_inmemb(&bufmem, b)) {
+    struct queuebuf_data *buframptr = queuebuf_load_to_ram(b);
+    QUEUEBUF_DATA(buframptr) = packetbuf_swap_storage(QUEUEBUF_DATA(buframptr), buframptr->len);
+    attrs_to_packetbuf(buframptr);
   }
+#else /* QUEUEBUF_WITH_ZERO_COPY */
+  queuebuf_to_packetbuf(b);
+#endif /* QUEUEBUF_WITH_ZERO_COPY */
+  queuebuf_free(b);
 }
 /*---------------------------------------------------------------------------*/
 void *
@@ -430,7 +729,7 @@ queuebuf_dataptr(struct queuebuf *b)
 {
   if(memb_inmemb(&bufmem, b)) {
     struct queuebuf_data *buframptr = queuebuf_load_to_ram(b);
-    return buframptr->data;
+    return QUEUEBUF_DATA(buframptr);
   }
   return NULL;
 }
@@ -453,7 +752,11 @@ packetbuf_attr_t
 queuebuf_attr(struct queuebuf *b, uint8_t type)
 {
   struct queuebuf_data *buframptr = queuebuf_load_to_ram(b);
+#if PACKETBUF_WITH_USED_ATTRS
+  return packetbuf_attr_packed_get(buframptr->attrs, buframptr->used_attrs, type);
+#else /* PACKETBUF_WITH_USED_ATTRS */
   return buframptr->attrs[type].val;
+#endif /* PACKETBUF_WITH_USED_ATTRS */
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -79,6 +79,36 @@
   #define WITH_SWAP 0
 #endif /* QUEUEBUFRAM_CONF_NUM */
 
+/* With swapping, the number of queuebufs written to CFS at once. They
+   wait in a RAM buffer of this many queuebufs until then */
+#ifdef QUEUEBUF_CONF_SWAP_BATCH
+#define QUEUEBUF_SWAP_BATCH QUEUEBUF_CONF_SWAP_BATCH
+#else /* QUEUEBUF_CONF_SWAP_BATCH */
+#define QUEUEBUF_SWAP_BATCH 4
+#endif /* QUEUEBUF_CONF_SWAP_BATCH */
+
+/* Let queuebufs and the packetbuf exchange their storage instead of
+ * copying packets back and forth, through queuebuf_take_packetbuf() and
+ * queuebuf_give_to_packetbuf(). Requires all queuebufs in RAM */
+#ifdef QUEUEBUF_CONF_WITH_ZERO_COPY
+#define QUEUEBUF_WITH_ZERO_COPY QUEUEBUF_CONF_WITH_ZERO_COPY
+#else /* QUEUEBUF_CONF_WITH_ZERO_COPY */
+#define QUEUEBUF_WITH_ZERO_COPY 0
+#endif /* QUEUEBUF_CONF_WITH_ZERO_COPY */
+
+#if QUEUEBUF_WITH_ZERO_COPY && WITH_SWAP
+#error "QUEUEBUF_CONF_WITH_ZERO_COPY cannot be used with queuebufs swapped to CFS"
+#endif
+
+/* With PACKETBUF_CONF_WITH_USED_ATTRS, the max number of non-zero
+ * attributes a queuebuf can hold. Lower it to save RAM; a packet with
+ * more attributes set cannot be queued */
+#ifdef QUEUEBUF_CONF_NUM_ATTRS
+#define QUEUEBUF_NUM_ATTRS QUEUEBUF_CONF_NUM_ATTRS
+#else /* QUEUEBUF_CONF_NUM_ATTRS */
+#define QUEUEBUF_NUM_ATTRS PACKETBUF_NUM_ATTRS
+#endif /* QUEUEBUF_CONF_NUM_ATTRS */
+
 #ifdef QUEUEBUF_CONF_DEBUG
 #define QUEUEBUF_DEBUG QUEUEBUF_CONF_DEBUG
 #else /* QUEUEBUF_CONF_DEBUG */
@@ -92,14 +122,25 @@ void queuebuf_init(void);
 #if QUEUEBUF_DEBUG
 struct queuebuf *queuebuf_new_from_packetbuf_debug(const char *file, int line);
 #define queuebuf_new_from_packetbuf() queuebuf_new_from_packetbuf_debug(__FILE__, __LINE__)
+struct queuebuf *queuebuf_take_packetbuf_debug(const char *file, int line);
+#define queuebuf_take_packetbuf() queuebuf_take_packetbuf_debug(__FILE__, __LINE__)
 #else /* QUEUEBUF_DEBUG */
 struct queuebuf *queuebuf_new_from_packetbuf(void);
+/* Same as queuebuf_new_from_packetbuf(), but for a caller done with the
+ * packetbuf: with QUEUEBUF_CONF_WITH_ZERO_COPY, the queuebuf takes over
+ * the packetbuf storage instead of copying it. On success, the content
+ * of the packetbuf is undefined afterwards */
+struct queuebuf *queuebuf_take_packetbuf(void);
 #endif /* QUEUEBUF_DEBUG */
 void queuebuf_update_attr_from_packetbuf(struct queuebuf *b);
 void queuebuf_update_from_packetbuf(struct queuebuf *b);
 
 void queuebuf_to_packetbuf(struct queuebuf *b);
 void queuebuf_free(struct queuebuf *b);
+/* Same as queuebuf_to_packetbuf() followed by queuebuf_free(): with
+ * QUEUEBUF_CONF_WITH_ZERO_COPY, the packetbuf takes over the queuebuf
+ * storage instead of copying it */
+void queuebuf_give_to_packetbuf(struct queuebuf *b);
 
 void *queuebuf_dataptr(struct queuebuf *b);
 int queuebuf_datalen(struct queuebuf *b);
@@ -77,6 +77,34 @@ MEMB(collect_neighbors_mem, struct collect_neighbor, MAX_COLLECT_NEIGHBORS);
 #define PRINTF(...)
 #endif
 
+/*---------------------------------------------------------------------------*/
+static void
+insert_sorted(struct collect_neighbor_list *neighbor_list,
+              struct collect_neighbor *n)
+{
+  struct collect_neighbor *p, *prev;
+  uint16_t rtmetric;
+
+  rtmetric = collect_neighbor_rtmetric_link_estimate(n);
+  prev = NULL;
+  for(p = list_head(neighbor_list->list);
+      p != NULL && collect_neighbor_rtmetric_link_estimate(p) <= rtmetric;
+      p = list_item_next(p)) {
+    prev = p;
+  }
+  list_insert(neighbor_list->list, prev, n);
+}
+/*---------------------------------------------------------------------------*/
+/* Move a neighbor whose rtmetric or link estimate has changed to its
+   place in the list */
+static void
+resort(struct collect_neighbor *n)
+{
+  if(n->neighbor_list != NULL) {
+    list_remove(n->neighbor_list->list, n);
+    insert_sorted(n->neighbor_list, n);
+  }
+}
 /*---------------------------------------------------------------------------*/
 static void
 periodic(void *ptr)
@@ -102,6 +130,16 @@ periodic(void *ptr)
       n = list_head(neighbor_list->list);
     }
   }
+
+  /* Link estimates may have been reset, so sort the whole list again */
+  n = list_head(neighbor_list->list);
+  list_init(neighbor_list->list);
+  while(n != NULL) {
+    struct collect_neighbor *next = list_item_next(n);
+    insert_sorted(neighbor_list, n);
+    n = next;
+  }
+
   ctimer_set(&neighbor_list->periodic, PERIODIC_INTERVAL,
              periodic, neighbor_list);
 }
@@ -173,6 +211,7 @@ collect_neighbor_list_add(struct collect_neighbor_list *neighbors_list,
            addr->u8[0], addr->u8[1]);
     n = memb_alloc(&collect_neighbors_mem);
     if(n != NULL) {
+      n->neighbor_list = neighbors_list;
       list_add(neighbors_list->list, n);
     }
   }
@@ -218,6 +257,7 @@ collect_neighbor_list_add(struct collect_neighbor_list *neighbors_list,
     n->rtmetric = nrtmetric;
     collect_link_estimate_new(&n->le);
     n->le_age = 0;
+    resort(n);
     return 1;
   }
   return 0;
@@ -264,21 +304,14 @@ collect_neighbor_list_best(struct collect_neighbor_list *neighbors_list)
     return NULL;
   }
 
-  /*  PRINTF("%d: ", node_id);*/
-  PRINTF("collect_neighbor_best: ");
-
-  /* Find the neighbor with the lowest rtmetric + linkt estimate. */
-  for(n = list_head(neighbors_list->list); n != NULL; n = list_item_next(n)) {
-    PRINTF("%d.%d %d+%d=%d, ",
-           n->addr.u8[0], n->addr.u8[1],
-           n->rtmetric, collect_neighbor_link_estimate(n),
-           collect_neighbor_rtmetric(n));
-    if(collect_neighbor_rtmetric_link_estimate(n) < rtmetric) {
-      rtmetric = collect_neighbor_rtmetric_link_estimate(n);
-      best = n;
-    }
+  /* The neighbor with the lowest rtmetric + link estimate is first
+     on the list. */
+  n = list_head(neighbors_list->list);
+  if(n != NULL && collect_neighbor_rtmetric_link_estimate(n) < rtmetric) {
+    best = n;
   }
-  PRINTF("\n");
+  PRINTF("collect_neighbor_best: %d\n",
+         best != NULL ? best->addr.u8[0] : 0);
 
   return best;
 }
@@ -339,6 +372,7 @@ collect_neighbor_update_rtmetric(struct collect_neighbor *n, uint16_t rtmetric)
            n->addr.u8[0], n->addr.u8[1], rtmetric);
     n->rtmetric = rtmetric;
     n->age = 0;
+    resort(n);
   }
 }
 /*---------------------------------------------------------------------------*/
@@ -351,6 +385,7 @@ collect_neighbor_tx_fail(struct collect_neighbor *n, uint16_t num_tx)
   collect_link_estimate_update_tx_fail(&n->le, num_tx);
   n->le_age = 0;
   n->age = 0;
+  resort(n);
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -362,6 +397,7 @@ collect_neighbor_tx(struct collect_neighbor *n, uint16_t num_tx)
   collect_link_estimate_update_tx(&n->le, num_tx);
   n->le_age = 0;
   n->age = 0;
+  resort(n);
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -372,6 +408,7 @@ collect_neighbor_rx(struct collect_neighbor *n)
   }
   collect_link_estimate_update_rx(&n->le);
   n->age = 0;
+  resort(n);
 }
 /*---------------------------------------------------------------------------*/
 uint16_t
@@ -64,6 +64,9 @@ struct collect_neighbor_list {
 
 struct collect_neighbor {
   struct collect_neighbor *next;
+  /* The list the neighbor is on, which is kept sorted by rtmetric plus
+     link estimate so that the best neighbor comes first */
+  struct collect_neighbor_list *neighbor_list;
   linkaddr_t addr;
   uint16_t rtmetric;
   uint16_t age;
@@ -68,17 +68,38 @@ static const struct packetbuf_attrlist attributes[] =
 /* The recent_packets list holds the sequence number, the originator,
    and the connection for packets that have been recently
    forwarded. This list is maintained to avoid forwarding duplicate
-   packets. */
+   packets. A sink of a large network needs a longer list. */
+#ifdef COLLECT_CONF_NUM_RECENT_PACKETS
+#define NUM_RECENT_PACKETS COLLECT_CONF_NUM_RECENT_PACKETS
+#else /* COLLECT_CONF_NUM_RECENT_PACKETS */
 #define NUM_RECENT_PACKETS 16
+#endif /* COLLECT_CONF_NUM_RECENT_PACKETS */
+
+/* The recent packets are also chained by a hash of their originator
+   and sequence number, so that looking for a duplicate does not scan
+   the whole list. Must be a power of two. */
+#ifdef COLLECT_CONF_RECENT_PACKETS_HASH_SIZE
+#define RECENT_PACKETS_HASH_SIZE COLLECT_CONF_RECENT_PACKETS_HASH_SIZE
+#else /* COLLECT_CONF_RECENT_PACKETS_HASH_SIZE */
+#define RECENT_PACKETS_HASH_SIZE 16
+#endif /* COLLECT_CONF_RECENT_PACKETS_HASH_SIZE */
+
+#if NUM_RECENT_PACKETS > 255
+#error COLLECT_CONF_NUM_RECENT_PACKETS must be less than 256
+#endif
 
 struct recent_packet {
   struct collect_conn *conn;
   linkaddr_t originator;
   uint8_t eseqno;
+  /* The next recent packet with the same hash, plus one (0 if none) */
+  uint8_t next;
 };
 
 static struct recent_packet recent_packets[NUM_RECENT_PACKETS];
 static uint8_t recent_packet_ptr;
+/* The first recent packet of each hash, plus one (0 if none) */
+static uint8_t recent_packets_hash[RECENT_PACKETS_HASH_SIZE];
 
 
 /* This is the header of data packets. The header comtains the routing
@@ -903,6 +924,51 @@ send_ack(struct collect_conn *tc, const linkaddr_t *to, int flags)
   stats.acksent++;
 }
 /*---------------------------------------------------------------------------*/
+static uint8_t
+recent_packet_hash(const linkaddr_t *originator, uint8_t eseqno)
+{
+  uint8_t h;
+  int i;
+
+  h = eseqno;
+  for(i = 0; i < LINKADDR_SIZE; i++) {
+    h = h * 31 + originator->u8[i];
+  }
+  return h & (RECENT_PACKETS_HASH_SIZE - 1);
+}
+/*---------------------------------------------------------------------------*/
+static struct recent_packet *
+find_recent_packet(struct collect_conn *tc, const linkaddr_t *originator,
+                   uint8_t eseqno)
+{
+  uint8_t i;
+
+  for(i = recent_packets_hash[recent_packet_hash(originator, eseqno)];
+      i != 0; i = recent_packets[i - 1].next) {
+    struct recent_packet *r = &recent_packets[i - 1];
+    if(r->conn == tc && r->eseqno == eseqno &&
+       linkaddr_cmp(&r->originator, originator)) {
+      return r;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+remove_recent_packet_hash(uint8_t index)
+{
+  struct recent_packet *r = &recent_packets[index];
+  uint8_t *p;
+
+  for(p = &recent_packets_hash[recent_packet_hash(&r->originator, r->eseqno)];
+      *p != 0; p = &recent_packets[*p - 1].next) {
+    if(*p == index + 1) {
+      *p = r->next;
+      return;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
 static void
 add_packet_to_recent_packets(struct collect_conn *tc)
 {
@@ -911,11 +977,19 @@ add_packet_to_recent_packets(struct collect_conn *tc)
      zero are keepalive or proactive link estimate probes, so we do
      not record them in our history. */
   if(packetbuf_datalen() > sizeof(struct data_msg_hdr)) {
-    recent_packets[recent_packet_ptr].eseqno =
-      packetbuf_attr(PACKETBUF_ATTR_EPACKET_ID);
-    linkaddr_copy(&recent_packets[recent_packet_ptr].originator,
-                  packetbuf_addr(PACKETBUF_ADDR_ESENDER));
-    recent_packets[recent_packet_ptr].conn = tc;
+    struct recent_packet *r = &recent_packets[recent_packet_ptr];
+    uint8_t h;
+
+    /* The oldest packet is forgotten */
+    if(r->conn != NULL) {
+      remove_recent_packet_hash(recent_packet_ptr);
+    }
+    r->eseqno = packetbuf_attr(PACKETBUF_ATTR_EPACKET_ID);
+    linkaddr_copy(&r->originator, packetbuf_addr(PACKETBUF_ADDR_ESENDER));
+    r->conn = tc;
+    h = recent_packet_hash(&r->originator, r->eseqno);
+    r->next = recent_packets_hash[h];
+    recent_packets_hash[h] = recent_packet_ptr + 1;
     recent_packet_ptr = (recent_packet_ptr + 1) % NUM_RECENT_PACKETS;
   }
 }
@@ -925,10 +999,10 @@ node_packet_received(struct unicast_conn *c, const linkaddr_t *from)
 {
   struct collect_conn *tc = (struct collect_conn *)
     ((char *)c - offsetof(struct collect_conn, unicast_conn));
-  int i;
   struct data_msg_hdr hdr;
   uint8_t ackflags = 0;
   struct collect_neighbor *n;
+  struct recent_packet *r;
 
   memcpy(&hdr, packetbuf_dataptr(), sizeof(struct data_msg_hdr));
 
@@ -972,23 +1046,20 @@ node_packet_received(struct unicast_conn *c, const linkaddr_t *from)
       ackflags |= ACK_FLAGS_CONGESTED;
     }
 
-    for(i = 0; i < NUM_RECENT_PACKETS; i++) {
-      if(recent_packets[i].conn == tc &&
-         recent_packets[i].eseqno == packetbuf_attr(PACKETBUF_ATTR_EPACKET_ID) &&
-         linkaddr_cmp(&recent_packets[i].originator,
-                      packetbuf_addr(PACKETBUF_ADDR_ESENDER))) {
-        /* This is a duplicate of a packet we recently received, so we
-           just send an ACK. */
-        PRINTF("%d.%d: found duplicate packet from %d.%d with seqno %d, via %d.%d\n",
-               linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1],
-               recent_packets[i].originator.u8[0], recent_packets[i].originator.u8[1],
-               packetbuf_attr(PACKETBUF_ATTR_EPACKET_ID),
-               packetbuf_addr(PACKETBUF_ADDR_SENDER)->u8[0],
-               packetbuf_addr(PACKETBUF_ADDR_SENDER)->u8[1]);
-        send_ack(tc, &ack_to, ackflags);
-        stats.duprecv++;
-        return;
-      }
+    r = find_recent_packet(tc, packetbuf_addr(PACKETBUF_ADDR_ESENDER),
+                           packetbuf_attr(PACKETBUF_ATTR_EPACKET_ID));
+    if(r != NULL) {
+      /* This is a duplicate of a packet we recently received, so we
+         just send an ACK. */
+      PRINTF("%d.%d: found duplicate packet from %d.%d with seqno %d, via %d.%d\n",
+             linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1],
+             r->originator.u8[0], r->originator.u8[1],
+             packetbuf_attr(PACKETBUF_ATTR_EPACKET_ID),
+             packetbuf_addr(PACKETBUF_ADDR_SENDER)->u8[0],
+             packetbuf_addr(PACKETBUF_ADDR_SENDER)->u8[1]);
+      send_ack(tc, &ack_to, ackflags);
+      stats.duprecv++;
+      return;
     }
 
     /* If we are the sink, the packet has reached its final
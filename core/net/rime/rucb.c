@@ -64,107 +64,159 @@ read_data(struct rucb_conn *c)
   return len;
 }
 /*---------------------------------------------------------------------------*/
+static int
+send_chunk(struct rucb_conn *c)
+{
+  uint8_t *hdr;
+
+  /* The chunk number, since chunks within the window may arrive in
+     any order */
+  if(packetbuf_hdralloc(RUCB_HDRSIZE) == 0) {
+    return 0;
+  }
+  hdr = packetbuf_hdrptr();
+  hdr[0] = c->chunk >> 8;
+  hdr[1] = c->chunk & 0xff;
+  return wrunicast_send(&c->c, &c->receiver, MAX_TRANSMISSIONS);
+}
+/*---------------------------------------------------------------------------*/
+/* Fill the window with chunks. The last chunk, which is shorter than
+   RUCB_DATASIZE, is held back until all others have been acknowledged,
+   so that the receiver sees it last. */
 static void
-acked(struct runicast_conn *ruc, const linkaddr_t *to, uint8_t retransmissions)
+send_chunks(struct rucb_conn *c)
 {
-  struct rucb_conn *c = (struct rucb_conn *)ruc;
   int len;
-  PRINTF("%d.%d: rucb acked\n",
-	 linkaddr_node_addr.u8[0],linkaddr_node_addr.u8[1]);
-  c->chunk++;
-  len = read_data(c);
-  if(len == 0 && c->last_size == 0) {
-    /* Nothing more to do */
+
+  if(c->last != NULL) {
+    if(wrunicast_inflight(&c->c) == 0) {
+      queuebuf_to_packetbuf(c->last);
+      queuebuf_free(c->last);
+      c->last = NULL;
+      send_chunk(c);
+      c->last_size = 0;
+    }
     return;
   }
 
-  if(len >= 0) {
-    runicast_send(&c->c, &c->receiver, MAX_TRANSMISSIONS);
-    c->last_size = len;
-
+  while(c->last_size == RUCB_DATASIZE && !wrunicast_is_window_full(&c->c)) {
+    len = read_data(c);
+    if(len < RUCB_DATASIZE && wrunicast_inflight(&c->c) > 0) {
+      c->last = queuebuf_new_from_packetbuf();
+      if(c->last != NULL) {
+        c->last_size = len;
+        return;
+      }
+    }
+    if(!send_chunk(c)) {
+      PRINTF("%d.%d: rucb could not send chunk %d\n",
+             linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1], c->chunk);
+    }
+    c->chunk++;
+    c->last_size = len < RUCB_DATASIZE ? 0 : len;
   }
 }
 /*---------------------------------------------------------------------------*/
 static void
-timedout(struct runicast_conn *ruc, const linkaddr_t *to, uint8_t retransmissions)
+acked(struct wrunicast_conn *wruc, const linkaddr_t *to, uint8_t retransmissions)
+{
+  struct rucb_conn *c = (struct rucb_conn *)wruc;
+  PRINTF("%d.%d: rucb acked\n",
+	 linkaddr_node_addr.u8[0],linkaddr_node_addr.u8[1]);
+  send_chunks(c);
+}
+/*---------------------------------------------------------------------------*/
+static void
+timedout(struct wrunicast_conn *wruc, const linkaddr_t *to, uint8_t retransmissions)
 {
-  struct rucb_conn *c = (struct rucb_conn *)ruc;
+  struct rucb_conn *c = (struct rucb_conn *)wruc;
   PRINTF("%d.%d: rucb timedout\n",
 	 linkaddr_node_addr.u8[0],linkaddr_node_addr.u8[1]);
+  if(c->last_size < 0) {
+    /* Already reported */
+    return;
+  }
+  c->last_size = -1;
+  if(c->last != NULL) {
+    queuebuf_free(c->last);
+    c->last = NULL;
+  }
   if(c->u->timedout) {
     c->u->timedout(c);
   }
 }
 /*---------------------------------------------------------------------------*/
 static void
-recv(struct runicast_conn *ruc, const linkaddr_t *from, uint8_t seqno)
+recv(struct wrunicast_conn *wruc, const linkaddr_t *from, uint8_t seqno)
 {
-  struct rucb_conn *c = (struct rucb_conn *)ruc;
+  struct rucb_conn *c = (struct rucb_conn *)wruc;
+  uint8_t *hdr;
+  uint16_t chunk;
+  int datalen;
 
   PRINTF("%d.%d: rucb: recv from %d.%d len %d\n",
 	 linkaddr_node_addr.u8[0],linkaddr_node_addr.u8[1],
 	 from->u8[0], from->u8[1], packetbuf_totlen());
 
-  if(seqno == c->last_seqno) {
+  if(packetbuf_datalen() < RUCB_HDRSIZE) {
     return;
   }
-  c->last_seqno = seqno;
+  hdr = packetbuf_dataptr();
+  chunk = (hdr[0] << 8) | hdr[1];
+  packetbuf_hdrreduce(RUCB_HDRSIZE);
+  datalen = packetbuf_datalen();
 
   if(linkaddr_cmp(&c->sender, &linkaddr_null)) {
     linkaddr_copy(&c->sender, from);
     c->u->write_chunk(c, 0, RUCB_FLAG_NEWFILE, packetbuf_dataptr(), 0);
-    c->chunk = 0;
   }
 
-
   if(linkaddr_cmp(&c->sender, from)) {
-    int datalen = packetbuf_datalen();
-
     if(datalen < RUCB_DATASIZE) {
       PRINTF("%d.%d: get %d bytes, file complete\n",
 	     linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1],
 	     datalen);
-      c->u->write_chunk(c, c->chunk * RUCB_DATASIZE,
+      c->u->write_chunk(c, chunk * RUCB_DATASIZE,
 			 RUCB_FLAG_LASTCHUNK, packetbuf_dataptr(), datalen);
+      linkaddr_copy(&c->sender, &linkaddr_null);
     } else {
-      c->u->write_chunk(c, c->chunk * RUCB_DATASIZE,
+      c->u->write_chunk(c, chunk * RUCB_DATASIZE,
 			RUCB_FLAG_NONE, packetbuf_dataptr(), datalen);
     }
-    c->chunk++;
-  }
-
-  if(packetbuf_datalen() < RUCB_DATASIZE) {
-    linkaddr_copy(&c->sender, &linkaddr_null);
   }
 }
 /*---------------------------------------------------------------------------*/
-static const struct runicast_callbacks ruc = {recv, acked, timedout};
+static const struct wrunicast_callbacks ruc = {recv, acked, timedout};
 /*---------------------------------------------------------------------------*/
 void
 rucb_open(struct rucb_conn *c, uint16_t channel,
 	  const struct rucb_callbacks *u)
 {
   linkaddr_copy(&c->sender, &linkaddr_null);
-  runicast_open(&c->c, channel, &ruc);
+  wrunicast_open(&c->c, channel, &ruc);
   c->u = u;
-  c->last_seqno = -1;
+  c->last = NULL;
   c->last_size = -1;
 }
 /*---------------------------------------------------------------------------*/
 void
 rucb_close(struct rucb_conn *c)
 {
-  runicast_close(&c->c);
+  wrunicast_close(&c->c);
+  if(c->last != NULL) {
+    queuebuf_free(c->last);
+    c->last = NULL;
+  }
 }
 /*---------------------------------------------------------------------------*/
 int
 rucb_send(struct rucb_conn *c, const linkaddr_t *receiver)
 {
   c->chunk = 0;
-  read_data(c);
+  c->last_size = RUCB_DATASIZE;
   linkaddr_copy(&c->receiver, receiver);
   linkaddr_copy(&c->sender, &linkaddr_node_addr);
-  runicast_send(&c->c, receiver, MAX_TRANSMISSIONS);
+  send_chunks(c);
   return 0;
 }
 /*---------------------------------------------------------------------------*/
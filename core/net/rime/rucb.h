@@ -40,7 +40,7 @@
 #ifndef RUCB_H_
 #define RUCB_H_
 
-#include "net/rime/runicast.h"
+#include "net/rime/wrunicast.h"
 
 struct rucb_conn;
 
@@ -59,14 +59,20 @@ struct rucb_callbacks {
 };
 
 #define RUCB_DATASIZE 64
+/* Each chunk starts with its number */
+#define RUCB_HDRSIZE  2
 
 struct rucb_conn {
-  struct runicast_conn c;
+  struct wrunicast_conn c;
   const struct rucb_callbacks *u;
   linkaddr_t receiver, sender;
+  /* The next chunk to send */
   uint16_t chunk;
-  uint8_t last_seqno;
+  /* The size of the last chunk read: RUCB_DATASIZE while there is more
+     to send, 0 when done, -1 after a timeout */
   int last_size;
+  /* The last chunk, while it waits for the others to be acknowledged */
+  struct queuebuf *last;
 };
 
 void rucb_open(struct rucb_conn *c, uint16_t channel,
@@ -0,0 +1,391 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \file
+ *         Windowed reliable unicast
+ */
+
+/**
+ * \addtogroup rimewrunicast
+ * @{
+ */
+
+#include "net/rime/wrunicast.h"
+#include "net/rime/rime.h"
+#include <string.h>
+
+#ifdef WRUNICAST_CONF_REXMIT_TIME
+#define REXMIT_TIME WRUNICAST_CONF_REXMIT_TIME
+#else /* WRUNICAST_CONF_REXMIT_TIME */
+#define REXMIT_TIME CLOCK_SECOND
+#endif /* WRUNICAST_CONF_REXMIT_TIME */
+
+#if (WRUNICAST_WINDOW & (WRUNICAST_WINDOW - 1)) != 0 || WRUNICAST_WINDOW > 8
+#error WRUNICAST_CONF_WINDOW must be a power of two up to 8
+#endif
+
+#define SLOT(seqno) ((seqno) & (WRUNICAST_WINDOW - 1))
+
+/* Data packets carry their sequence number and the first packet that
+   the sender has not given up on. ACKs carry the first packet that
+   is missing and the bitmap of the packets received after it. */
+struct wrunicast_hdr {
+  uint8_t type;
+  uint8_t seqno;
+  uint8_t arg;
+};
+
+#define TYPE_DATA 0
+#define TYPE_ACK  1
+
+static const struct packetbuf_attrlist attributes[] =
+  {
+    WRUNICAST_ATTRIBUTES
+    PACKETBUF_ATTR_LAST
+  };
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+static void rexmit(void *ptr);
+/*---------------------------------------------------------------------------*/
+static void
+transmit(struct wrunicast_conn *c, uint8_t seqno)
+{
+  struct wrunicast_hdr *hdr;
+
+  queuebuf_to_packetbuf(c->q[SLOT(seqno)]);
+  if(packetbuf_hdralloc(sizeof(struct wrunicast_hdr)) == 0) {
+    return;
+  }
+  hdr = packetbuf_hdrptr();
+  hdr->type = TYPE_DATA;
+  hdr->seqno = seqno;
+  hdr->arg = c->snd_una;
+  PRINTF("%d.%d: wrunicast: sending packet %d (una %d)\n",
+         linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1],
+         seqno, c->snd_una);
+  unicast_send(&c->c, &c->receiver);
+}
+/*---------------------------------------------------------------------------*/
+/* Remove a packet from the window, and return its retransmissions */
+static uint8_t
+forget(struct wrunicast_conn *c, uint8_t seqno)
+{
+  uint8_t slot = SLOT(seqno);
+
+  queuebuf_free(c->q[slot]);
+  c->q[slot] = NULL;
+  return c->rxmit[slot];
+}
+/*---------------------------------------------------------------------------*/
+/* Move the window past the packets that are no longer in flight */
+static void
+advance(struct wrunicast_conn *c)
+{
+  while(c->snd_una != c->snd_nxt && c->q[SLOT(c->snd_una)] == NULL) {
+    c->snd_una++;
+  }
+  if(c->snd_una == c->snd_nxt) {
+    ctimer_stop(&c->rexmit_timer);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+ack_received(struct wrunicast_conn *c, uint8_t cumack, uint8_t bitmap)
+{
+  uint8_t rxmits[WRUNICAST_WINDOW];
+  uint8_t inflight, seqno, i, n, d;
+  linkaddr_t to;
+
+  inflight = c->snd_nxt - c->snd_una;
+  if((uint8_t)(cumack - c->snd_una) > inflight) {
+    PRINTF("%d.%d: wrunicast: bad ACK %d\n",
+           linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1], cumack);
+    RIMESTATS_ADD(badackrx);
+    return;
+  }
+
+  n = 0;
+  for(i = 0; i < inflight; i++) {
+    seqno = c->snd_una + i;
+    d = seqno - cumack;
+    if(c->q[SLOT(seqno)] != NULL &&
+       ((uint8_t)(cumack - c->snd_una) > i ||
+        (d < 8 && (bitmap & (1 << d))))) {
+      rxmits[n++] = forget(c, seqno);
+    }
+  }
+  if(n == 0) {
+    return;
+  }
+  advance(c);
+  if(c->snd_una != c->snd_nxt) {
+    ctimer_set(&c->rexmit_timer, REXMIT_TIME, rexmit, c);
+  }
+
+  /* The callbacks may send more packets */
+  linkaddr_copy(&to, &c->receiver);
+  for(i = 0; i < n; i++) {
+    if(c->u->sent != NULL) {
+      c->u->sent(c, &to, rxmits[i]);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+rexmit(void *ptr)
+{
+  struct wrunicast_conn *c = ptr;
+  uint8_t rxmits[WRUNICAST_WINDOW];
+  uint8_t inflight, seqno, slot, i, n;
+  linkaddr_t to;
+
+  /* Give up on the packets that have been retransmitted enough */
+  n = 0;
+  inflight = c->snd_nxt - c->snd_una;
+  for(i = 0; i < inflight; i++) {
+    seqno = c->snd_una + i;
+    slot = SLOT(seqno);
+    if(c->q[slot] != NULL && c->rxmit[slot] >= c->max_rxmit[slot]) {
+      PRINTF("%d.%d: wrunicast: packet %d timed out\n",
+             linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1], seqno);
+      RIMESTATS_ADD(timedout);
+      rxmits[n++] = forget(c, seqno);
+    }
+  }
+  advance(c);
+
+  /* Retransmit the others, which have not been acknowledged */
+  inflight = c->snd_nxt - c->snd_una;
+  for(i = 0; i < inflight; i++) {
+    seqno = c->snd_una + i;
+    slot = SLOT(seqno);
+    if(c->q[slot] != NULL) {
+      c->rxmit[slot]++;
+      RIMESTATS_ADD(rexmit);
+      transmit(c, seqno);
+    }
+  }
+  if(inflight > 0) {
+    ctimer_set(&c->rexmit_timer, REXMIT_TIME, rexmit, c);
+  }
+
+  linkaddr_copy(&to, &c->receiver);
+  for(i = 0; i < n; i++) {
+    if(c->u->timedout != NULL) {
+      c->u->timedout(c, &to, rxmits[i]);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Update the receive window with a data packet, and return non-zero
+   if it has not been received before */
+static int
+data_received(struct wrunicast_conn *c, const linkaddr_t *from,
+              uint8_t seqno, uint8_t una)
+{
+  uint8_t d;
+
+  if(!linkaddr_cmp(from, &c->sender)) {
+    linkaddr_copy(&c->sender, from);
+    c->rcv_nxt = una;
+    c->rcv_bitmap = 0;
+  }
+
+  /* The sender has given up on the packets before una */
+  d = una - c->rcv_nxt;
+  if(d > 0 && d <= WRUNICAST_WINDOW) {
+    c->rcv_nxt = una;
+    c->rcv_bitmap = d < 8 ? c->rcv_bitmap >> d : 0;
+  }
+
+  d = seqno - c->rcv_nxt;
+  if(d >= WRUNICAST_WINDOW) {
+    if((uint8_t)(c->rcv_nxt - seqno) <= WRUNICAST_WINDOW) {
+      /* A packet that was received before, but whose ACK was lost */
+      return 0;
+    }
+    /* Out of sync, like after a restart of the sender */
+    c->rcv_nxt = una;
+    c->rcv_bitmap = 0;
+    d = seqno - una;
+    if(d >= WRUNICAST_WINDOW) {
+      c->rcv_nxt = seqno;
+      d = 0;
+    }
+  }
+
+  if(c->rcv_bitmap & (1 << d)) {
+    return 0;
+  }
+  c->rcv_bitmap |= 1 << d;
+  while(c->rcv_bitmap & 1) {
+    c->rcv_bitmap >>= 1;
+    c->rcv_nxt++;
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_ack(struct wrunicast_conn *c, const linkaddr_t *to)
+{
+  struct wrunicast_hdr *hdr;
+
+  packetbuf_clear();
+  hdr = packetbuf_dataptr();
+  hdr->type = TYPE_ACK;
+  hdr->seqno = c->rcv_nxt;
+  hdr->arg = c->rcv_bitmap;
+  packetbuf_set_datalen(sizeof(struct wrunicast_hdr));
+  PRINTF("%d.%d: wrunicast: ACK to %d.%d %d bitmap 0x%02x\n",
+         linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1],
+         to->u8[0], to->u8[1], c->rcv_nxt, c->rcv_bitmap);
+  RIMESTATS_ADD(acktx);
+  unicast_send(&c->c, to);
+}
+/*---------------------------------------------------------------------------*/
+static void
+recv_from_unicast(struct unicast_conn *uc, const linkaddr_t *from)
+{
+  struct wrunicast_conn *c = (struct wrunicast_conn *)uc;
+  struct wrunicast_hdr hdr;
+  linkaddr_t sender;
+
+  if(packetbuf_datalen() < sizeof(struct wrunicast_hdr)) {
+    return;
+  }
+  memcpy(&hdr, packetbuf_dataptr(), sizeof(struct wrunicast_hdr));
+  packetbuf_hdrreduce(sizeof(struct wrunicast_hdr));
+  linkaddr_copy(&sender, from);
+
+  if(hdr.type == TYPE_ACK) {
+    if(c->snd_una != c->snd_nxt && linkaddr_cmp(&sender, &c->receiver)) {
+      RIMESTATS_ADD(ackrx);
+      ack_received(c, hdr.seqno, hdr.arg);
+    }
+  } else if(hdr.type == TYPE_DATA) {
+    RIMESTATS_ADD(reliablerx);
+    PRINTF("%d.%d: wrunicast: got packet %d from %d.%d\n",
+           linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1],
+           hdr.seqno, sender.u8[0], sender.u8[1]);
+    if(data_received(c, &sender, hdr.seqno, hdr.arg) && c->u->recv != NULL) {
+      c->u->recv(c, &sender, hdr.seqno);
+    }
+    send_ack(c, &sender);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static const struct unicast_callbacks wrunicast = {recv_from_unicast, NULL};
+/*---------------------------------------------------------------------------*/
+void
+wrunicast_open(struct wrunicast_conn *c, uint16_t channel,
+               const struct wrunicast_callbacks *u)
+{
+  unicast_open(&c->c, channel, &wrunicast);
+  channel_set_attributes(channel, attributes);
+  c->u = u;
+  memset(c->q, 0, sizeof(c->q));
+  c->snd_una = c->snd_nxt = 0;
+  linkaddr_copy(&c->sender, &linkaddr_null);
+  c->rcv_nxt = 0;
+  c->rcv_bitmap = 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+wrunicast_close(struct wrunicast_conn *c)
+{
+  int i;
+
+  unicast_close(&c->c);
+  ctimer_stop(&c->rexmit_timer);
+  for(i = 0; i < WRUNICAST_WINDOW; i++) {
+    if(c->q[i] != NULL) {
+      queuebuf_free(c->q[i]);
+      c->q[i] = NULL;
+    }
+  }
+  c->snd_una = c->snd_nxt;
+}
+/*---------------------------------------------------------------------------*/
+int
+wrunicast_inflight(struct wrunicast_conn *c)
+{
+  return (uint8_t)(c->snd_nxt - c->snd_una);
+}
+/*---------------------------------------------------------------------------*/
+int
+wrunicast_is_window_full(struct wrunicast_conn *c)
+{
+  return wrunicast_inflight(c) >= WRUNICAST_WINDOW;
+}
+/*---------------------------------------------------------------------------*/
+int
+wrunicast_send(struct wrunicast_conn *c, const linkaddr_t *receiver,
+               uint8_t max_retransmissions)
+{
+  uint8_t slot;
+
+  if(wrunicast_is_window_full(c) ||
+     (wrunicast_inflight(c) > 0 && !linkaddr_cmp(receiver, &c->receiver))) {
+    PRINTF("%d.%d: wrunicast: window full\n",
+           linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1]);
+    return 0;
+  }
+
+  packetbuf_set_attr(PACKETBUF_ATTR_RELIABLE, 1);
+  packetbuf_set_attr(PACKETBUF_ATTR_MAX_MAC_TRANSMISSIONS, 3);
+  slot = SLOT(c->snd_nxt);
+  c->q[slot] = queuebuf_new_from_packetbuf();
+  if(c->q[slot] == NULL) {
+    return 0;
+  }
+  c->rxmit[slot] = 0;
+  c->max_rxmit[slot] = max_retransmissions;
+  linkaddr_copy(&c->receiver, receiver);
+  if(c->snd_una == c->snd_nxt) {
+    ctimer_set(&c->rexmit_timer, REXMIT_TIME, rexmit, c);
+  }
+  c->snd_nxt++;
+  RIMESTATS_ADD(reliabletx);
+  transmit(c, c->snd_nxt - 1);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/** @} */
@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \file
+ *         Windowed reliable unicast header file
+ */
+
+/**
+ * \addtogroup rime
+ * @{
+ */
+
+/**
+ * \defgroup rimewrunicast Windowed single-hop reliable unicast
+ * @{
+ *
+ * The windowed reliable unicast primitive (wrunicast) works like
+ * runicast, with the same callbacks, but lets up to
+ * WRUNICAST_WINDOW packets to the same neighbor be in flight at
+ * once. Packets can be sent back to back, at the speed of the link,
+ * instead of one per round trip.
+ *
+ * Every data packet is acknowledged with the sequence number of the
+ * first packet that is still missing (a cumulative ACK) and a bitmap
+ * of the packets after it that have been received (a selective
+ * ACK). Lost ACKs are therefore covered by the next one, and only
+ * the packets that are missing are retransmitted. Packets are
+ * passed to the receiver as they arrive, possibly out of order, and
+ * duplicates are dropped.
+ *
+ * The send callback is called for each packet when it has been
+ * acknowledged, and the timedout callback when it has been
+ * retransmitted the maximum number of times. wrunicast_send() returns
+ * zero when the window is full.
+ *
+ * \section wrunicast-channels Channels
+ *
+ * The wrunicast module uses 1 channel.
+ *
+ */
+
+#ifndef WRUNICAST_H_
+#define WRUNICAST_H_
+
+#include "net/rime/unicast.h"
+#include "net/queuebuf.h"
+#include "sys/ctimer.h"
+
+/* The number of packets in flight, a power of two up to 8 */
+#ifdef WRUNICAST_CONF_WINDOW
+#define WRUNICAST_WINDOW WRUNICAST_CONF_WINDOW
+#else /* WRUNICAST_CONF_WINDOW */
+#define WRUNICAST_WINDOW 4
+#endif /* WRUNICAST_CONF_WINDOW */
+
+#define WRUNICAST_ATTRIBUTES UNICAST_ATTRIBUTES
+
+struct wrunicast_conn;
+
+struct wrunicast_callbacks {
+  void (* recv)(struct wrunicast_conn *c, const linkaddr_t *from, uint8_t seqno);
+  void (* sent)(struct wrunicast_conn *c, const linkaddr_t *to, uint8_t retransmissions);
+  void (* timedout)(struct wrunicast_conn *c, const linkaddr_t *to, uint8_t retransmissions);
+};
+
+struct wrunicast_conn {
+  struct unicast_conn c;
+  const struct wrunicast_callbacks *u;
+  struct ctimer rexmit_timer;
+  /* Sender: the packets in flight, indexed by their sequence number
+     modulo the window, from snd_una up to snd_nxt */
+  linkaddr_t receiver;
+  struct queuebuf *q[WRUNICAST_WINDOW];
+  uint8_t rxmit[WRUNICAST_WINDOW];
+  uint8_t max_rxmit[WRUNICAST_WINDOW];
+  uint8_t snd_una, snd_nxt;
+  /* Receiver: the first missing packet and, bit i for rcv_nxt + i,
+     the packets received after it */
+  linkaddr_t sender;
+  uint8_t rcv_nxt;
+  uint8_t rcv_bitmap;
+};
+
+void wrunicast_open(struct wrunicast_conn *c, uint16_t channel,
+                    const struct wrunicast_callbacks *u);
+void wrunicast_close(struct wrunicast_conn *c);
+
+/**
+ * Send the packet in the packetbuf.
+ *
+ * \param max_retransmissions The number of times the packet is
+ * retransmitted before it times out.
+ * \return Non-zero if the packet was queued, zero if the window is
+ * full or packets to another receiver are in flight.
+ */
+int wrunicast_send(struct wrunicast_conn *c, const linkaddr_t *receiver,
+                   uint8_t max_retransmissions);
+
+/** The number of packets in flight */
+int wrunicast_inflight(struct wrunicast_conn *c);
+
+/** Non-zero if no more packet can be sent until one is acknowledged */
+int wrunicast_is_window_full(struct wrunicast_conn *c);
+
+#endif /* WRUNICAST_H_ */
+/** @} */
+/** @} */
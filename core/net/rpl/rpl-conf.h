@@ -256,6 +256,32 @@
 #define RPL_REPAIR_ON_DAO_NACK 0
 #endif /* RPL_CONF_RPL_REPAIR_ON_DAO_NACK */
 
+/*
+ * RPL DAO aggregation (storing mode). When enabled, targets received
+ * in DAOs from the sub-DODAG are collected for RPL_DAO_AGGREGATION_DELAY
+ * and forwarded to the preferred parent in a single DAO, instead of
+ * one DAO per target. DAO ACKs for the aggregate are fanned out to the
+ * children that contributed to it.
+ * */
+#ifdef RPL_CONF_DAO_AGGREGATION
+#define RPL_DAO_AGGREGATION RPL_CONF_DAO_AGGREGATION
+#else
+#define RPL_DAO_AGGREGATION 0
+#endif /* RPL_CONF_DAO_AGGREGATION */
+
+#ifdef RPL_CONF_DAO_AGGREGATION_DELAY
+#define RPL_DAO_AGGREGATION_DELAY RPL_CONF_DAO_AGGREGATION_DELAY
+#else
+#define RPL_DAO_AGGREGATION_DELAY (CLOCK_SECOND / 2)
+#endif /* RPL_CONF_DAO_AGGREGATION_DELAY */
+
+/* Maximum size of the options of an aggregated DAO */
+#ifdef RPL_CONF_DAO_AGGREGATION_LEN
+#define RPL_DAO_AGGREGATION_LEN RPL_CONF_DAO_AGGREGATION_LEN
+#else
+#define RPL_DAO_AGGREGATION_LEN 96
+#endif /* RPL_CONF_DAO_AGGREGATION_LEN */
+
 /*
  * Setting the DIO_REFRESH_DAO_ROUTES will make the RPL root always
  * increase the DTSN (Destination Advertisement Trigger Sequence Number)
@@ -279,6 +305,17 @@
 #define RPL_WITH_PROBING 1
 #endif
 
+/*
+ * Keep a backup parent next to the preferred one: a parent of lower
+ * rank than the node, that it switches to at once when the preferred
+ * parent does not acknowledge a packet or returns it in a loop.
+ */
+#ifdef RPL_CONF_WITH_BACKUP_PARENT
+#define RPL_WITH_BACKUP_PARENT RPL_CONF_WITH_BACKUP_PARENT
+#else
+#define RPL_WITH_BACKUP_PARENT 1
+#endif
+
 /*
  * RPL probing interval.
  */
@@ -54,6 +54,7 @@
 #include "lib/list.h"
 #include "lib/memb.h"
 #include "sys/ctimer.h"
+#include "sys/trace.h"
 
 #include <limits.h>
 #include <string.h>
@@ -121,12 +122,9 @@ rpl_print_neighbor_list(void)
 uip_ds6_nbr_t *
 rpl_get_nbr(rpl_parent_t *parent)
 {
-  const linkaddr_t *lladdr = rpl_get_parent_lladdr(parent);
-  if(lladdr != NULL) {
-    return nbr_table_get_from_lladdr(ds6_neighbors, lladdr);
-  } else {
-    return NULL;
-  }
+  /* The parent and neighbor entries of a neighbor share their index */
+  return nbr_table_get_from_index(ds6_neighbors,
+                                  nbr_table_get_index(rpl_parents, parent));
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -192,15 +190,16 @@ rpl_get_parent_lladdr(rpl_parent_t *p)
 uip_ipaddr_t *
 rpl_get_parent_ipaddr(rpl_parent_t *p)
 {
-  const linkaddr_t *lladdr = rpl_get_parent_lladdr(p);
-  return uip_ds6_nbr_ipaddr_from_lladdr((uip_lladdr_t *)lladdr);
+  uip_ds6_nbr_t *nbr = rpl_get_nbr(p);
+  return nbr != NULL ? &nbr->ipaddr : NULL;
 }
 /*---------------------------------------------------------------------------*/
 const struct link_stats *
 rpl_get_parent_link_stats(rpl_parent_t *p)
 {
-  const linkaddr_t *lladdr = rpl_get_parent_lladdr(p);
-  return link_stats_from_lladdr(lladdr);
+  /* Parent selection evaluates this for every parent, so avoid the
+     lookup by link-layer address */
+  return link_stats_from_index(nbr_table_get_index(rpl_parents, p));
 }
 /*---------------------------------------------------------------------------*/
 int
@@ -245,10 +244,25 @@ rpl_set_preferred_parent(rpl_dag_t *dag, rpl_parent_t *p)
     }
     PRINTF("\n");
 
+#if TRACE_ENABLED
+    {
+      uip_ipaddr_t *addr = p != NULL ? rpl_get_parent_ipaddr(p) : NULL;
+      TRACE(RPL_PARENT, p != NULL ? p->rank : INFINITE_RANK,
+            addr != NULL ? TRACE_NODE_IP(addr) : 0);
+    }
+#endif /* TRACE_ENABLED */
+
 #ifdef RPL_CALLBACK_PARENT_SWITCH
     RPL_CALLBACK_PARENT_SWITCH(dag->preferred_parent, p);
 #endif /* RPL_CALLBACK_PARENT_SWITCH */
 
+#if RPL_WITH_BACKUP_PARENT
+    if(p != NULL && p == dag->backup_parent) {
+      /* Stays locked, as the preferred parent */
+      dag->backup_parent = NULL;
+    }
+#endif /* RPL_WITH_BACKUP_PARENT */
+
     /* Always keep the preferred parent locked, so it remains in the
      * neighbor table. */
     nbr_table_unlock(rpl_parents, dag->preferred_parent);
@@ -257,6 +271,19 @@ rpl_set_preferred_parent(rpl_dag_t *dag, rpl_parent_t *p)
   }
 }
 /*---------------------------------------------------------------------------*/
+#if RPL_WITH_BACKUP_PARENT
+static void
+rpl_set_backup_parent(rpl_dag_t *dag, rpl_parent_t *p)
+{
+  if(dag->backup_parent != p) {
+    /* Locked too, so that it is still there when it is needed */
+    nbr_table_unlock(rpl_parents, dag->backup_parent);
+    nbr_table_lock(rpl_parents, p);
+    dag->backup_parent = p;
+  }
+}
+#endif /* RPL_WITH_BACKUP_PARENT */
+/*---------------------------------------------------------------------------*/
 /* Greater-than function for the lollipop counter.                      */
 /*---------------------------------------------------------------------------*/
 static int
@@ -887,6 +914,72 @@ best_parent(rpl_dag_t *dag, int fresh_only)
   return best;
 }
 /*---------------------------------------------------------------------------*/
+#if RPL_WITH_BACKUP_PARENT
+/* The best parent but the preferred one among those closer to the root
+ * than the node, which it can switch to without creating a loop */
+static rpl_parent_t *
+backup_parent(rpl_dag_t *dag)
+{
+  rpl_parent_t *p;
+  rpl_parent_t *best = NULL;
+
+  if(dag->preferred_parent == NULL) {
+    return NULL;
+  }
+
+  for(p = nbr_table_head(rpl_parents); p != NULL; p = nbr_table_next(rpl_parents, p)) {
+    if(p->dag != dag || p == dag->preferred_parent || p->rank == INFINITE_RANK ||
+       DAG_RANK(p->rank, dag->instance) >= DAG_RANK(dag->rank, dag->instance) ||
+       !rpl_parent_is_reachable(p)) {
+      continue;
+    }
+    best = dag->instance->of->best_parent(best, p);
+  }
+
+  return best;
+}
+/*---------------------------------------------------------------------------*/
+/* Makes the backup parent preferred at once, without waiting for the
+ * parent set to be evaluated again. Returns 0 if there is no usable
+ * backup parent */
+int
+rpl_switch_to_backup_parent(rpl_dag_t *dag)
+{
+  rpl_parent_t *last_parent;
+  rpl_parent_t *p;
+  rpl_instance_t *instance;
+
+  p = dag->backup_parent;
+  if(p == NULL || !dag->joined || p->rank == INFINITE_RANK ||
+     DAG_RANK(p->rank, dag->instance) >= DAG_RANK(dag->rank, dag->instance) ||
+     !acceptable_rank(dag, rpl_rank_via_parent(p))) {
+    return 0;
+  }
+
+  instance = dag->instance;
+  last_parent = dag->preferred_parent;
+  PRINTF("RPL: Switching to backup parent ");
+  PRINT6ADDR(rpl_get_parent_ipaddr(p));
+  PRINTF("\n");
+
+  rpl_set_preferred_parent(dag, p);
+  dag->rank = rpl_rank_via_parent(p);
+  instance->of->update_metric_container(instance);
+  rpl_set_default_route(instance, rpl_get_parent_ipaddr(p));
+  RPL_STAT(rpl_stats.parent_switch++);
+  RPL_STAT(rpl_stats.fast_reroutes++);
+
+  if(RPL_IS_STORING(instance) && last_parent != NULL) {
+    /* Send a No-Path DAO to the removed preferred parent. */
+    dao_output(last_parent, RPL_ZERO_LIFETIME);
+  }
+  RPL_LOLLIPOP_INCREMENT(instance->dtsn_out);
+  rpl_schedule_dao(instance);
+  rpl_reset_dio_timer(instance);
+  return 1;
+}
+#endif /* RPL_WITH_BACKUP_PARENT */
+/*---------------------------------------------------------------------------*/
 rpl_parent_t *
 rpl_select_parent(rpl_dag_t *dag)
 {
@@ -920,6 +1013,9 @@ rpl_select_parent(rpl_dag_t *dag)
   }
 
   dag->rank = rpl_rank_via_parent(dag->preferred_parent);
+#if RPL_WITH_BACKUP_PARENT
+  rpl_set_backup_parent(dag, backup_parent(dag));
+#endif /* RPL_WITH_BACKUP_PARENT */
   return dag->preferred_parent;
 }
 /*---------------------------------------------------------------------------*/
@@ -939,6 +1035,11 @@ void
 rpl_nullify_parent(rpl_parent_t *parent)
 {
   rpl_dag_t *dag = parent->dag;
+#if RPL_WITH_BACKUP_PARENT
+  if(parent == dag->backup_parent) {
+    rpl_set_backup_parent(dag, NULL);
+  }
+#endif /* RPL_WITH_BACKUP_PARENT */
   /* This function can be called when the preferred parent is NULL, so we
      need to handle this condition in order to trigger uip_ds6_defrt_rm. */
   if(parent == dag->preferred_parent || dag->preferred_parent == NULL) {
@@ -969,6 +1070,11 @@ rpl_nullify_parent(rpl_parent_t *parent)
 void
 rpl_move_parent(rpl_dag_t *dag_src, rpl_dag_t *dag_dst, rpl_parent_t *parent)
 {
+#if RPL_WITH_BACKUP_PARENT
+  if(parent == dag_src->backup_parent) {
+    rpl_set_backup_parent(dag_src, NULL);
+  }
+#endif /* RPL_WITH_BACKUP_PARENT */
   if(parent == dag_src->preferred_parent) {
       rpl_set_preferred_parent(dag_src, NULL);
       dag_src->rank = INFINITE_RANK;
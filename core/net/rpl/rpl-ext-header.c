@@ -157,6 +157,16 @@ rpl_verify_hbh_header(int uip_ext_opt_offset)
       instance->unicast_dio_target = sender;
       rpl_schedule_unicast_dio_immediately(instance);
     }
+#if RPL_WITH_BACKUP_PARENT
+    /* Going up to the parent it came from would bring the packet back
+     * again: forward it through the backup parent instead */
+    if(!down && sender != NULL &&
+       sender == instance->current_dag->preferred_parent &&
+       rpl_switch_to_backup_parent(instance->current_dag)) {
+      PRINTF("RPL: Loop avoided through the backup parent\n");
+      return 1;
+    }
+#endif /* RPL_WITH_BACKUP_PARENT */
     if(UIP_EXT_HDR_OPT_RPL_BUF->flags & RPL_HDR_OPT_RANK_ERR) {
       RPL_STAT(rpl_stats.loop_errors++);
       PRINTF("RPL: Rank error signalled in RPL option!\n");
@@ -322,11 +332,77 @@ count_matching_bytes(const void *p1, const void *p2, size_t n)
   return n;
 }
 /*---------------------------------------------------------------------------*/
+#if RPL_NS_SRH_CACHE_SIZE
+/* Source routing headers built for recent destinations. An entry is
+   valid as long as the topology version it was built for is current. */
+struct srh_cache_entry {
+  uip_ipaddr_t dest;
+  uip_ipaddr_t next_hop;
+  rpl_dag_t *dag;
+  uint16_t version;
+  uint8_t len;
+  uint8_t hdr[RPL_NS_SRH_CACHE_HDR_LEN];
+};
+static struct srh_cache_entry srh_cache[RPL_NS_SRH_CACHE_SIZE];
+static uint8_t srh_cache_next;
+/*---------------------------------------------------------------------------*/
+static struct srh_cache_entry *
+srh_cache_lookup(const rpl_dag_t *dag, const uip_ipaddr_t *dest)
+{
+  uint8_t i;
+
+  for(i = 0; i < RPL_NS_SRH_CACHE_SIZE; i++) {
+    if(srh_cache[i].len > 0 && srh_cache[i].dag == dag &&
+       srh_cache[i].version == rpl_ns_get_version() &&
+       uip_ipaddr_cmp(&srh_cache[i].dest, dest)) {
+      return &srh_cache[i];
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+srh_cache_add(rpl_dag_t *dag, const uip_ipaddr_t *dest, uint8_t ext_len)
+{
+  struct srh_cache_entry *e;
+
+  if(ext_len > RPL_NS_SRH_CACHE_HDR_LEN) {
+    return;
+  }
+  e = &srh_cache[srh_cache_next];
+  srh_cache_next = (srh_cache_next + 1) % RPL_NS_SRH_CACHE_SIZE;
+
+  uip_ipaddr_copy(&e->dest, dest);
+  uip_ipaddr_copy(&e->next_hop, &UIP_IP_BUF->destipaddr);
+  e->dag = dag;
+  e->version = rpl_ns_get_version();
+  e->len = ext_len;
+  memcpy(e->hdr, UIP_RH_BUF, ext_len);
+}
+#endif /* RPL_NS_SRH_CACHE_SIZE */
+/*---------------------------------------------------------------------------*/
+/* Account for a routing header of ext_len bytes inserted after the
+   IPv6 header */
+static void
+srh_update_len(uint8_t ext_len)
+{
+  uint8_t temp_len;
+
+  /* In-place update of IPv6 length field */
+  temp_len = UIP_IP_BUF->len[1];
+  UIP_IP_BUF->len[1] += ext_len;
+  if(UIP_IP_BUF->len[1] < temp_len) {
+    UIP_IP_BUF->len[0]++;
+  }
+
+  uip_ext_len += ext_len;
+  uip_len += ext_len;
+}
+/*---------------------------------------------------------------------------*/
 static int
 insert_srh_header(void)
 {
   /* Implementation of RFC6554 */
-  uint8_t temp_len;
   uint8_t path_len;
   uint8_t ext_len;
   uint8_t cmpri, cmpre; /* ComprI and ComprE fields of the RPL Source Routing Header */
@@ -337,6 +413,10 @@ insert_srh_header(void)
   rpl_ns_node_t *node;
   rpl_dag_t *dag;
   uip_ipaddr_t node_addr;
+#if RPL_NS_SRH_CACHE_SIZE
+  struct srh_cache_entry *cached;
+  uip_ipaddr_t dest_addr;
+#endif /* RPL_NS_SRH_CACHE_SIZE */
 
   PRINTF("RPL: SRH creating source routing header with destination ");
   PRINT6ADDR(&UIP_IP_BUF->destipaddr);
@@ -352,6 +432,26 @@ insert_srh_header(void)
     return 0;
   }
 
+#if RPL_NS_SRH_CACHE_SIZE
+  cached = srh_cache_lookup(dag, &UIP_IP_BUF->destipaddr);
+  if(cached != NULL) {
+    ext_len = cached->len;
+    if(uip_len + ext_len > UIP_BUFSIZE) {
+      PRINTF("RPL: Packet too long: impossible to add source routing header (%u bytes)\n", ext_len);
+      return 1;
+    }
+    memmove(uip_buf + uip_l2_l3_hdr_len + ext_len,
+        uip_buf + uip_l2_l3_hdr_len, uip_len - UIP_IPH_LEN);
+    memcpy(uip_buf + uip_l2_l3_hdr_len, cached->hdr, ext_len);
+    UIP_RH_BUF->next = UIP_IP_BUF->proto;
+    UIP_IP_BUF->proto = UIP_PROTO_ROUTING;
+    uip_ipaddr_copy(&UIP_IP_BUF->destipaddr, &cached->next_hop);
+    srh_update_len(ext_len);
+    return 1;
+  }
+  uip_ipaddr_copy(&dest_addr, &UIP_IP_BUF->destipaddr);
+#endif /* RPL_NS_SRH_CACHE_SIZE */
+
   dest_node = rpl_ns_get_node(dag, &UIP_IP_BUF->destipaddr);
   if(dest_node == NULL) {
     /* The destination is not found, skip SRH insertion */
@@ -449,15 +549,11 @@ insert_srh_header(void)
   rpl_ns_get_node_global_addr(&node_addr, node);
   uip_ipaddr_copy(&UIP_IP_BUF->destipaddr, &node_addr);
 
-  /* In-place update of IPv6 length field */
-  temp_len = UIP_IP_BUF->len[1];
-  UIP_IP_BUF->len[1] += ext_len;
-  if(UIP_IP_BUF->len[1] < temp_len) {
-    UIP_IP_BUF->len[0]++;
-  }
+#if RPL_NS_SRH_CACHE_SIZE
+  srh_cache_add(dag, &dest_addr, ext_len);
+#endif /* RPL_NS_SRH_CACHE_SIZE */
 
-  uip_ext_len += ext_len;
-  uip_len += ext_len;
+  srh_update_len(ext_len);
 
   return 1;
 }
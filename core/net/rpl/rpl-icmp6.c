@@ -55,6 +55,7 @@
 #include "net/packetbuf.h"
 #include "net/ipv6/multicast/uip-mcast6.h"
 #include "random.h"
+#include "sys/trace.h"
 
 #include <limits.h>
 #include <string.h>
@@ -63,6 +64,16 @@
 
 #include "net/ip/uip-debug.h"
 
+/* A configurable function called whenever a non-storing mode root
+   learns a link from a DAO, e.g. to share the topology with other
+   border routers of the same network over the backbone. The lifetime
+   is in seconds, 0 for a link removed by a No-Path DAO. A peer applies
+   the link with rpl_ns_update_node() or rpl_ns_expire_parent(). */
+#ifdef RPL_CALLBACK_NS_LINK_UPDATE
+void RPL_CALLBACK_NS_LINK_UPDATE(rpl_dag_t *dag, const uip_ipaddr_t *child,
+                                 const uip_ipaddr_t *parent, uint32_t lifetime);
+#endif /* RPL_CALLBACK_NS_LINK_UPDATE */
+
 /*---------------------------------------------------------------------------*/
 #define RPL_DIO_GROUNDED                 0x80
 #define RPL_DIO_MOP_SHIFT                3
@@ -118,23 +129,26 @@ find_route_entry_by_dao_ack(uint8_t seq)
   }
   return NULL;
 }
-#endif /* RPL_WITH_DAO_ACK */
-
-#if RPL_WITH_STORING
-/* prepare for forwarding of DAO */
-static uint8_t
-prepare_for_dao_fwd(uint8_t sequence, uip_ds6_route_t *rep)
+/*---------------------------------------------------------------------------*/
+static int
+dao_ack_is_pending(uint8_t seq, uint8_t seq_in, uip_ipaddr_t *nexthop)
 {
-  /* not pending - or pending but not a retransmission */
-  RPL_LOLLIPOP_INCREMENT(dao_sequence);
+  uip_ds6_route_t *re;
+  uip_ipaddr_t *re_nexthop;
 
-  /* set DAO pending and sequence numbers */
-  rep->state.dao_seqno_in = sequence;
-  rep->state.dao_seqno_out = dao_sequence;
-  RPL_ROUTE_SET_DAO_PENDING(rep);
-  return dao_sequence;
+  for(re = uip_ds6_route_head(); re != NULL; re = uip_ds6_route_next(re)) {
+    if(re->state.dao_seqno_out == seq && RPL_ROUTE_IS_DAO_PENDING(re) &&
+       re->state.dao_seqno_in == seq_in) {
+      re_nexthop = uip_ds6_route_nexthop(re);
+      if(re_nexthop != NULL && uip_ipaddr_cmp(re_nexthop, nexthop)) {
+        return 1;
+      }
+    }
+  }
+  return 0;
 }
-#endif /* RPL_WITH_STORING */
+#endif /* RPL_WITH_DAO_ACK */
+
 /*---------------------------------------------------------------------------*/
 static int
 get_global_addr(uip_ipaddr_t *addr)
@@ -468,6 +482,7 @@ dio_input(void)
   RPL_DEBUG_DIO_INPUT(&from, &dio);
 #endif
 
+  TRACE(RPL_DIO_IN, dio.rank, TRACE_NODE_IP(&from));
   rpl_process_dio(&from, &dio);
 
  discard:
@@ -602,6 +617,7 @@ dio_output(rpl_instance_t *instance, uip_ipaddr_t *uc_addr)
            dag->prefix_info.length);
   }
 
+  TRACE(RPL_DIO_OUT, dag->rank, uc_addr != NULL);
 #if RPL_LEAF_ONLY
 #if (DEBUG) & DEBUG_PRINT
   if(uc_addr == NULL) {
@@ -630,143 +646,195 @@ dio_output(rpl_instance_t *instance, uip_ipaddr_t *uc_addr)
 #endif /* RPL_LEAF_ONLY */
 }
 /*---------------------------------------------------------------------------*/
+#if RPL_WITH_STORING
+/* The outcome of processing the targets of a received DAO */
+struct dao_result {
+  uint8_t forward;   /* Forward the DAO to the preferred parent */
+  uint8_t aggregate; /* Forward targets through the DAO aggregate */
+  uint8_t out_seq;   /* Sequence number of the forwarded DAO */
+  uint8_t ack;       /* Send a DAO ACK */
+  uint8_t status;    /* Status of the DAO ACK */
+};
+
+#if RPL_DAO_AGGREGATION
+/* Targets collected from the sub-DODAG, each followed by its transit
+   option, waiting to be sent to the preferred parent in one DAO. */
+static struct {
+  rpl_instance_t *instance;
+  uint8_t seq;
+  uint8_t len;
+  uint8_t opts[RPL_DAO_AGGREGATION_LEN];
+} dao_agg;
+static struct ctimer dao_agg_timer;
+/*---------------------------------------------------------------------------*/
 static void
-dao_input_storing(void)
+dao_agg_flush(void *ptr)
 {
-#if RPL_WITH_STORING
-  uip_ipaddr_t dao_sender_addr;
-  rpl_dag_t *dag;
   rpl_instance_t *instance;
+  rpl_dag_t *dag;
+  uip_ipaddr_t *parent_ipaddr;
   unsigned char *buffer;
-  uint16_t sequence;
-  uint8_t instance_id;
-  uint8_t lifetime;
-  uint8_t prefixlen;
-  uint8_t flags;
-  uint8_t subopt_type;
-  /*
-  uint8_t pathcontrol;
-  uint8_t pathsequence;
-  */
-  uip_ipaddr_t prefix;
-  uip_ds6_route_t *rep;
-  uint8_t buffer_length;
+  uint8_t len;
   int pos;
-  int len;
-  int i;
-  int learned_from;
-  rpl_parent_t *parent;
-  uip_ds6_nbr_t *nbr;
-  int is_root;
 
-  prefixlen = 0;
-  parent = NULL;
+  instance = dao_agg.instance;
+  len = dao_agg.len;
+  dao_agg.len = 0;
 
-  uip_ipaddr_copy(&dao_sender_addr, &UIP_IP_BUF->srcipaddr);
+  if(len == 0 || instance == NULL || !instance->used) {
+    return;
+  }
+  dag = instance->current_dag;
+  if(dag == NULL || dag->preferred_parent == NULL ||
+     (parent_ipaddr = rpl_get_parent_ipaddr(dag->preferred_parent)) == NULL) {
+    PRINTF("RPL: No parent to send aggregated DAO to\n");
+    return;
+  }
 
   buffer = UIP_ICMP_PAYLOAD;
-  buffer_length = uip_len - uip_l3_icmp_hdr_len;
-
   pos = 0;
-  instance_id = buffer[pos++];
-
-  instance = rpl_get_instance(instance_id);
 
-  lifetime = instance->default_lifetime;
-
-  flags = buffer[pos++];
-  /* reserved */
-  pos++;
-  sequence = buffer[pos++];
-
-  dag = instance->current_dag;
-  is_root = (dag->rank == ROOT_RANK(instance));
-
-  /* Is the DAG ID present? */
-  if(flags & RPL_DAO_D_FLAG) {
-    if(memcmp(&dag->dag_id, &buffer[pos], sizeof(dag->dag_id))) {
-      PRINTF("RPL: Ignoring a DAO for a DAG different from ours\n");
-      return;
-    }
-    pos += 16;
-  }
-
-  learned_from = uip_is_addr_mcast(&dao_sender_addr) ?
-                 RPL_ROUTE_FROM_MULTICAST_DAO : RPL_ROUTE_FROM_UNICAST_DAO;
+  buffer[pos++] = instance->instance_id;
+  buffer[pos] = 0;
+#if RPL_DAO_SPECIFY_DAG
+  buffer[pos] |= RPL_DAO_D_FLAG;
+#endif /* RPL_DAO_SPECIFY_DAG */
+#if RPL_WITH_DAO_ACK
+  buffer[pos] |= RPL_DAO_K_FLAG;
+#endif /* RPL_WITH_DAO_ACK */
+  ++pos;
+  buffer[pos++] = 0; /* reserved */
+  buffer[pos++] = dao_agg.seq;
+#if RPL_DAO_SPECIFY_DAG
+  memcpy(buffer + pos, &dag->dag_id, sizeof(dag->dag_id));
+  pos += sizeof(dag->dag_id);
+#endif /* RPL_DAO_SPECIFY_DAG */
+  memcpy(buffer + pos, dao_agg.opts, len);
+  pos += len;
 
-  /* Destination Advertisement Object */
-  PRINTF("RPL: Received a (%s) DAO with sequence number %u from ",
-      learned_from == RPL_ROUTE_FROM_UNICAST_DAO? "unicast": "multicast", sequence);
-  PRINT6ADDR(&dao_sender_addr);
+  PRINTF("RPL: Sending aggregated DAO with sequence number %u (%u bytes of targets) to ",
+         dao_agg.seq, len);
+  PRINT6ADDR(parent_ipaddr);
   PRINTF("\n");
 
-  if(learned_from == RPL_ROUTE_FROM_UNICAST_DAO) {
-    /* Check whether this is a DAO forwarding loop. */
-    parent = rpl_find_parent(dag, &dao_sender_addr);
-    /* check if this is a new DAO registration with an "illegal" rank */
-    /* if we already route to this node it is likely */
-    if(parent != NULL &&
-       DAG_RANK(parent->rank, instance) < DAG_RANK(dag->rank, instance)) {
-      PRINTF("RPL: Loop detected when receiving a unicast DAO from a node with a lower rank! (%u < %u)\n",
-          DAG_RANK(parent->rank, instance), DAG_RANK(dag->rank, instance));
-      parent->rank = INFINITE_RANK;
-      parent->flags |= RPL_PARENT_FLAG_UPDATED;
-      return;
-    }
-
-    /* If we get the DAO from our parent, we also have a loop. */
-    if(parent != NULL && parent == dag->preferred_parent) {
-      PRINTF("RPL: Loop detected when receiving a unicast DAO from our parent\n");
-      parent->rank = INFINITE_RANK;
-      parent->flags |= RPL_PARENT_FLAG_UPDATED;
-      return;
-    }
+  uip_icmp6_send(parent_ipaddr, ICMP6_RPL, RPL_CODE_DAO, pos);
+}
+/*---------------------------------------------------------------------------*/
+static void
+dao_agg_add(rpl_instance_t *instance, uip_ipaddr_t *prefix,
+            uint8_t prefixlen, uint8_t lifetime)
+{
+  uint8_t *opt;
+  uint8_t prefix_bytes;
+
+  prefix_bytes = (prefixlen + 7) / CHAR_BIT;
+  opt = &dao_agg.opts[dao_agg.len];
+
+  /* Target option */
+  opt[0] = RPL_OPTION_TARGET;
+  opt[1] = 2 + prefix_bytes;
+  opt[2] = 0; /* reserved */
+  opt[3] = prefixlen;
+  memcpy(opt + 4, prefix, prefix_bytes);
+  opt += 4 + prefix_bytes;
+
+  /* Transit information option */
+  opt[0] = RPL_OPTION_TRANSIT;
+  opt[1] = 4;
+  opt[2] = 0; /* flags - ignored */
+  opt[3] = 0; /* path control - ignored */
+  opt[4] = 0; /* path seq - ignored */
+  opt[5] = lifetime;
+
+  dao_agg.len += 4 + prefix_bytes + 6;
+  dao_agg.instance = instance;
+
+  if(ctimer_expired(&dao_agg_timer)) {
+    ctimer_set(&dao_agg_timer, RPL_DAO_AGGREGATION_DELAY, dao_agg_flush, NULL);
   }
-
-  /* Check if there are any RPL options present. */
-  for(i = pos; i < buffer_length; i += len) {
-    subopt_type = buffer[i];
-    if(subopt_type == RPL_OPTION_PAD1) {
-      len = 1;
+}
+#endif /* RPL_DAO_AGGREGATION */
+/*---------------------------------------------------------------------------*/
+/* Arrange for a target to be forwarded to the preferred parent and
+   record the sequence numbers needed to forward the DAO ACK back. */
+static void
+dao_fwd_prepare(struct dao_result *result, uint8_t sequence,
+                uip_ds6_route_t *rep, int retransmission)
+{
+  if(!result->forward) {
+    result->forward = 1;
+#if RPL_DAO_AGGREGATION
+    if(result->aggregate) {
+      if(dao_agg.len == 0) {
+        RPL_LOLLIPOP_INCREMENT(dao_sequence);
+        dao_agg.seq = dao_sequence;
+      }
+      result->out_seq = dao_agg.seq;
+    } else
+#endif /* RPL_DAO_AGGREGATION */
+    if(retransmission && rep != NULL) {
+      /* keep the same seq-no as before for parent also */
+      result->out_seq = rep->state.dao_seqno_out;
     } else {
-      /* The option consists of a two-byte header and a payload. */
-      len = 2 + buffer[i + 1];
+      RPL_LOLLIPOP_INCREMENT(dao_sequence);
+      result->out_seq = dao_sequence;
     }
+  }
 
-    switch(subopt_type) {
-    case RPL_OPTION_TARGET:
-      /* Handle the target option. */
-      prefixlen = buffer[i + 3];
-      memset(&prefix, 0, sizeof(prefix));
-      memcpy(&prefix, buffer + i + 4, (prefixlen + 7) / CHAR_BIT);
-      break;
-    case RPL_OPTION_TRANSIT:
-      /* The path sequence and control are ignored. */
-      /*      pathcontrol = buffer[i + 3];
-              pathsequence = buffer[i + 4];*/
-      lifetime = buffer[i + 5];
-      /* The parent address is also ignored. */
-      break;
-    }
+  if(rep != NULL) {
+    /* set DAO pending and sequence numbers */
+    rep->state.dao_seqno_in = sequence;
+    rep->state.dao_seqno_out = result->out_seq;
+    RPL_ROUTE_SET_DAO_PENDING(rep);
   }
+}
+/*---------------------------------------------------------------------------*/
+static void
+dao_input_storing_target(rpl_instance_t *instance, uip_ipaddr_t *from,
+                         int learned_from, uint8_t flags, uint8_t sequence,
+                         uip_ipaddr_t *prefix, uint8_t prefixlen,
+                         uint8_t lifetime, struct dao_result *result)
+{
+  rpl_dag_t *dag;
+  uip_ds6_route_t *rep;
+  int is_root;
+  int has_parent;
+
+  dag = instance->current_dag;
+  is_root = (dag->rank == ROOT_RANK(instance));
+  has_parent = dag->preferred_parent != NULL &&
+    rpl_get_parent_ipaddr(dag->preferred_parent) != NULL;
 
   PRINTF("RPL: DAO lifetime: %u, prefix length: %u prefix: ",
           (unsigned)lifetime, (unsigned)prefixlen);
-  PRINT6ADDR(&prefix);
+  PRINT6ADDR(prefix);
   PRINTF("\n");
 
 #if RPL_WITH_MULTICAST
-  if(uip_is_addr_mcast_global(&prefix)) {
-    mcast_group = uip_mcast6_route_add(&prefix);
+  if(uip_is_addr_mcast_global(prefix)) {
+    mcast_group = uip_mcast6_route_add(prefix);
     if(mcast_group) {
       mcast_group->dag = dag;
       mcast_group->lifetime = RPL_LIFETIME(instance, lifetime);
     }
-    goto fwd_dao;
+    if(learned_from == RPL_ROUTE_FROM_UNICAST_DAO) {
+      if((flags & RPL_DAO_K_FLAG) && is_root) {
+        result->ack = 1;
+      }
+      if(has_parent) {
+        dao_fwd_prepare(result, sequence, NULL, 0);
+#if RPL_DAO_AGGREGATION
+        if(result->aggregate) {
+          dao_agg_add(instance, prefix, prefixlen, lifetime);
+        }
+#endif /* RPL_DAO_AGGREGATION */
+      }
+    }
+    return;
   }
 #endif
 
-  rep = uip_ds6_route_lookup(&prefix);
+  rep = uip_ds6_route_lookup(prefix);
 
   if(lifetime == RPL_ZERO_LIFETIME) {
     PRINTF("RPL: No-Path DAO received\n");
@@ -775,37 +843,28 @@ dao_input_storing(void)
        !RPL_ROUTE_IS_NOPATH_RECEIVED(rep) &&
        rep->length == prefixlen &&
        uip_ds6_route_nexthop(rep) != NULL &&
-       uip_ipaddr_cmp(uip_ds6_route_nexthop(rep), &dao_sender_addr)) {
+       uip_ipaddr_cmp(uip_ds6_route_nexthop(rep), from)) {
       PRINTF("RPL: Setting expiration timer for prefix ");
-      PRINT6ADDR(&prefix);
+      PRINT6ADDR(prefix);
       PRINTF("\n");
       RPL_ROUTE_SET_NOPATH_RECEIVED(rep);
       rep->state.lifetime = RPL_NOPATH_REMOVAL_DELAY;
 
       /* We forward the incoming No-Path DAO to our parent, if we have
          one. */
-      if(dag->preferred_parent != NULL &&
-         rpl_get_parent_ipaddr(dag->preferred_parent) != NULL) {
-        uint8_t out_seq;
-        out_seq = prepare_for_dao_fwd(sequence, rep);
-
-        PRINTF("RPL: Forwarding No-path DAO to parent - out_seq:%d",
-	       out_seq);
-        PRINT6ADDR(rpl_get_parent_ipaddr(dag->preferred_parent));
-        PRINTF("\n");
-
-        buffer = UIP_ICMP_PAYLOAD;
-        buffer[3] = out_seq; /* add an outgoing seq no before fwd */
-        uip_icmp6_send(rpl_get_parent_ipaddr(dag->preferred_parent),
-                       ICMP6_RPL, RPL_CODE_DAO, buffer_length);
+      if(has_parent) {
+        dao_fwd_prepare(result, sequence, rep, 0);
+#if RPL_DAO_AGGREGATION
+        if(result->aggregate) {
+          dao_agg_add(instance, prefix, prefixlen, lifetime);
+        }
+#endif /* RPL_DAO_AGGREGATION */
       }
     }
     /* independent if we remove or not - ACK the request */
     if(flags & RPL_DAO_K_FLAG) {
       /* indicate that we accepted the no-path DAO */
-      uip_clear_buf();
-      dao_ack_output(instance, &dao_sender_addr, sequence,
-                     RPL_DAO_ACK_UNCONDITIONAL_ACCEPT);
+      result->ack = 1;
     }
     return;
   }
@@ -813,30 +872,30 @@ dao_input_storing(void)
   PRINTF("RPL: Adding DAO route\n");
 
   /* Update and add neighbor - if no room - fail. */
-  if((nbr = rpl_icmp6_update_nbr_table(&dao_sender_addr, NBR_TABLE_REASON_RPL_DAO, instance)) == NULL) {
+  if(rpl_icmp6_update_nbr_table(from, NBR_TABLE_REASON_RPL_DAO, instance) == NULL) {
     PRINTF("RPL: Out of Memory, dropping DAO from ");
-    PRINT6ADDR(&dao_sender_addr);
+    PRINT6ADDR(from);
     PRINTF(", ");
     PRINTLLADDR((uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER));
     PRINTF("\n");
     if(flags & RPL_DAO_K_FLAG) {
       /* signal the failure to add the node */
-      dao_ack_output(instance, &dao_sender_addr, sequence,
-		     is_root ? RPL_DAO_ACK_UNABLE_TO_ADD_ROUTE_AT_ROOT :
-		     RPL_DAO_ACK_UNABLE_TO_ACCEPT);
+      result->ack = 1;
+      result->status = is_root ? RPL_DAO_ACK_UNABLE_TO_ADD_ROUTE_AT_ROOT :
+        RPL_DAO_ACK_UNABLE_TO_ACCEPT;
     }
     return;
   }
 
-  rep = rpl_add_route(dag, &prefix, prefixlen, &dao_sender_addr);
+  rep = rpl_add_route(dag, prefix, prefixlen, from);
   if(rep == NULL) {
     RPL_STAT(rpl_stats.mem_overflows++);
     PRINTF("RPL: Could not add a route after receiving a DAO\n");
     if(flags & RPL_DAO_K_FLAG) {
       /* signal the failure to add the node */
-      dao_ack_output(instance, &dao_sender_addr, sequence,
-		     is_root ? RPL_DAO_ACK_UNABLE_TO_ADD_ROUTE_AT_ROOT :
-		     RPL_DAO_ACK_UNABLE_TO_ACCEPT);
+      result->ack = 1;
+      result->status = is_root ? RPL_DAO_ACK_UNABLE_TO_ADD_ROUTE_AT_ROOT :
+        RPL_DAO_ACK_UNABLE_TO_ACCEPT;
     }
     return;
   }
@@ -845,13 +904,7 @@ dao_input_storing(void)
   rep->state.lifetime = RPL_LIFETIME(instance, lifetime);
   RPL_ROUTE_CLEAR_NOPATH_RECEIVED(rep);
 
-#if RPL_WITH_MULTICAST
-fwd_dao:
-#endif
-
   if(learned_from == RPL_ROUTE_FROM_UNICAST_DAO) {
-    int should_ack = 0;
-
     if(flags & RPL_DAO_K_FLAG) {
       /*
        * check if this route is already installed and we can ack now!
@@ -861,39 +914,188 @@ fwd_dao:
        */
       if((!RPL_ROUTE_IS_DAO_PENDING(rep) &&
           rep->state.dao_seqno_in == sequence) ||
-          dag->rank == ROOT_RANK(instance)) {
-        should_ack = 1;
+          is_root) {
+        result->ack = 1;
       }
     }
 
-    if(dag->preferred_parent != NULL &&
-       rpl_get_parent_ipaddr(dag->preferred_parent) != NULL) {
-      uint8_t out_seq = 0;
+    if(has_parent) {
       /* if this is pending and we get the same seq no it is a retrans */
-      if(RPL_ROUTE_IS_DAO_PENDING(rep) &&
-         rep->state.dao_seqno_in == sequence) {
-        /* keep the same seq-no as before for parent also */
-        out_seq = rep->state.dao_seqno_out;
-      } else {
-        out_seq = prepare_for_dao_fwd(sequence, rep);
+      dao_fwd_prepare(result, sequence, rep,
+                      RPL_ROUTE_IS_DAO_PENDING(rep) &&
+                      rep->state.dao_seqno_in == sequence);
+#if RPL_DAO_AGGREGATION
+      if(result->aggregate) {
+        dao_agg_add(instance, prefix, prefixlen, lifetime);
       }
+#endif /* RPL_DAO_AGGREGATION */
+    }
+  }
+}
+#endif /* RPL_WITH_STORING */
+/*---------------------------------------------------------------------------*/
+static void
+dao_input_storing(void)
+{
+#if RPL_WITH_STORING
+  uip_ipaddr_t dao_sender_addr;
+  rpl_dag_t *dag;
+  rpl_instance_t *instance;
+  unsigned char *buffer;
+  uint16_t sequence;
+  uint8_t instance_id;
+  uint8_t lifetime;
+  uint8_t prefixlen;
+  uint8_t flags;
+  uint8_t subopt_type;
+  uip_ipaddr_t prefix;
+  uint8_t buffer_length;
+  struct dao_result result;
+  int pos;
+  int len;
+  int i;
+  int j;
+  int group;
+  int learned_from;
+  rpl_parent_t *parent;
 
-      PRINTF("RPL: Forwarding DAO to parent ");
-      PRINT6ADDR(rpl_get_parent_ipaddr(dag->preferred_parent));
-      PRINTF(" in seq: %d out seq: %d\n", sequence, out_seq);
+  parent = NULL;
+
+  uip_ipaddr_copy(&dao_sender_addr, &UIP_IP_BUF->srcipaddr);
+
+  buffer = UIP_ICMP_PAYLOAD;
+  buffer_length = uip_len - uip_l3_icmp_hdr_len;
+
+  pos = 0;
+  instance_id = buffer[pos++];
+
+  instance = rpl_get_instance(instance_id);
+
+  lifetime = instance->default_lifetime;
 
-      buffer = UIP_ICMP_PAYLOAD;
-      buffer[3] = out_seq; /* add an outgoing seq no before fwd */
-      uip_icmp6_send(rpl_get_parent_ipaddr(dag->preferred_parent),
-                     ICMP6_RPL, RPL_CODE_DAO, buffer_length);
+  flags = buffer[pos++];
+  /* reserved */
+  pos++;
+  sequence = buffer[pos++];
+
+  dag = instance->current_dag;
+
+  /* Is the DAG ID present? */
+  if(flags & RPL_DAO_D_FLAG) {
+    if(memcmp(&dag->dag_id, &buffer[pos], sizeof(dag->dag_id))) {
+      PRINTF("RPL: Ignoring a DAO for a DAG different from ours\n");
+      return;
     }
-    if(should_ack) {
-      PRINTF("RPL: Sending DAO ACK\n");
-      uip_clear_buf();
-      dao_ack_output(instance, &dao_sender_addr, sequence,
-                     RPL_DAO_ACK_UNCONDITIONAL_ACCEPT);
+    pos += 16;
+  }
+
+  learned_from = uip_is_addr_mcast(&dao_sender_addr) ?
+                 RPL_ROUTE_FROM_MULTICAST_DAO : RPL_ROUTE_FROM_UNICAST_DAO;
+
+  /* Destination Advertisement Object */
+  PRINTF("RPL: Received a (%s) DAO with sequence number %u from ",
+      learned_from == RPL_ROUTE_FROM_UNICAST_DAO? "unicast": "multicast", sequence);
+  PRINT6ADDR(&dao_sender_addr);
+  PRINTF("\n");
+
+  if(learned_from == RPL_ROUTE_FROM_UNICAST_DAO) {
+    /* Check whether this is a DAO forwarding loop. */
+    parent = rpl_find_parent(dag, &dao_sender_addr);
+    /* check if this is a new DAO registration with an "illegal" rank */
+    /* if we already route to this node it is likely */
+    if(parent != NULL &&
+       DAG_RANK(parent->rank, instance) < DAG_RANK(dag->rank, instance)) {
+      PRINTF("RPL: Loop detected when receiving a unicast DAO from a node with a lower rank! (%u < %u)\n",
+          DAG_RANK(parent->rank, instance), DAG_RANK(dag->rank, instance));
+      parent->rank = INFINITE_RANK;
+      parent->flags |= RPL_PARENT_FLAG_UPDATED;
+      return;
+    }
+
+    /* If we get the DAO from our parent, we also have a loop. */
+    if(parent != NULL && parent == dag->preferred_parent) {
+      PRINTF("RPL: Loop detected when receiving a unicast DAO from our parent\n");
+      parent->rank = INFINITE_RANK;
+      parent->flags |= RPL_PARENT_FLAG_UPDATED;
+      return;
+    }
+  }
+
+  memset(&result, 0, sizeof(result));
+  result.status = RPL_DAO_ACK_UNCONDITIONAL_ACCEPT;
+
+#if RPL_DAO_AGGREGATION
+  /* Aggregate the targets of this DAO if they all fit into the
+     pending aggregate, otherwise forward the DAO as it is. */
+  len = 0;
+  for(i = pos; i < buffer_length; i += buffer[i] == RPL_OPTION_PAD1 ? 1 : 2 + buffer[i + 1]) {
+    if(buffer[i] == RPL_OPTION_TARGET) {
+      len += 2 + buffer[i + 1] + 6;
+    }
+  }
+  result.aggregate = (dao_agg.len == 0 || dao_agg.instance == instance) &&
+    dao_agg.len + len <= RPL_DAO_AGGREGATION_LEN;
+#endif /* RPL_DAO_AGGREGATION */
+
+  /* Process the targets. The targets of a group are followed by the
+     transit option that applies to all of them. */
+  group = pos;
+  for(i = pos; i <= buffer_length; i += len) {
+    if(i == buffer_length) {
+      /* Targets without transit option use the default lifetime */
+      subopt_type = RPL_OPTION_TRANSIT;
+      len = 0;
+    } else {
+      subopt_type = buffer[i];
+      if(subopt_type == RPL_OPTION_PAD1) {
+        len = 1;
+      } else {
+        /* The option consists of a two-byte header and a payload. */
+        len = 2 + buffer[i + 1];
+      }
+    }
+
+    if(subopt_type == RPL_OPTION_TRANSIT) {
+      if(len > 0) {
+        /* The path sequence and control are ignored. */
+        lifetime = buffer[i + 5];
+        /* The parent address is also ignored. */
+      }
+      for(j = group; j < i; j += buffer[j] == RPL_OPTION_PAD1 ? 1 : 2 + buffer[j + 1]) {
+        if(buffer[j] == RPL_OPTION_TARGET) {
+          /* Handle the target option. */
+          prefixlen = buffer[j + 3];
+          memset(&prefix, 0, sizeof(prefix));
+          memcpy(&prefix, buffer + j + 4, (prefixlen + 7) / CHAR_BIT);
+          dao_input_storing_target(instance, &dao_sender_addr, learned_from,
+                                   flags, sequence, &prefix, prefixlen,
+                                   lifetime, &result);
+        }
+      }
+      group = i + len;
+      if(len == 0) {
+        break;
+      }
     }
   }
+
+  if(result.forward && !result.aggregate &&
+     dag->preferred_parent != NULL &&
+     rpl_get_parent_ipaddr(dag->preferred_parent) != NULL) {
+    PRINTF("RPL: Forwarding DAO to parent ");
+    PRINT6ADDR(rpl_get_parent_ipaddr(dag->preferred_parent));
+    PRINTF(" in seq: %d out seq: %d\n", sequence, result.out_seq);
+
+    buffer = UIP_ICMP_PAYLOAD;
+    buffer[3] = result.out_seq; /* add an outgoing seq no before fwd */
+    uip_icmp6_send(rpl_get_parent_ipaddr(dag->preferred_parent),
+                   ICMP6_RPL, RPL_CODE_DAO, buffer_length);
+  }
+  if(result.ack) {
+    PRINTF("RPL: Sending DAO ACK\n");
+    uip_clear_buf();
+    dao_ack_output(instance, &dao_sender_addr, sequence, result.status);
+  }
 #endif /* RPL_WITH_STORING */
 }
 /*---------------------------------------------------------------------------*/
@@ -985,11 +1187,18 @@ dao_input_nonstoring(void)
   if(lifetime == RPL_ZERO_LIFETIME) {
     PRINTF("RPL: No-Path DAO received\n");
     rpl_ns_expire_parent(dag, &prefix, &dao_parent_addr);
+#ifdef RPL_CALLBACK_NS_LINK_UPDATE
+    RPL_CALLBACK_NS_LINK_UPDATE(dag, &prefix, &dao_parent_addr, 0);
+#endif /* RPL_CALLBACK_NS_LINK_UPDATE */
   } else {
     if(rpl_ns_update_node(dag, &prefix, &dao_parent_addr, RPL_LIFETIME(instance, lifetime)) == NULL) {
       PRINTF("RPL: failed to add link\n");
       return;
     }
+#ifdef RPL_CALLBACK_NS_LINK_UPDATE
+    RPL_CALLBACK_NS_LINK_UPDATE(dag, &prefix, &dao_parent_addr,
+                                RPL_LIFETIME(instance, lifetime));
+#endif /* RPL_CALLBACK_NS_LINK_UPDATE */
   }
 
   if(flags & RPL_DAO_K_FLAG) {
@@ -1013,6 +1222,7 @@ dao_input(void)
   PRINTF("\n");
 
   instance_id = UIP_ICMP_PAYLOAD[0];
+  TRACE(RPL_DAO_IN, UIP_ICMP_PAYLOAD[3], TRACE_NODE_IP(&UIP_IP_BUF->srcipaddr));
   instance = rpl_get_instance(instance_id);
   if(instance == NULL) {
     PRINTF("RPL: Ignoring a DAO for an unknown RPL instance(%u)\n",
@@ -1242,6 +1452,7 @@ dao_output_target_seq(rpl_parent_t *parent, uip_ipaddr_t *prefix,
   PRINTF("\n");
 
   if(dest_ipaddr != NULL) {
+    TRACE(RPL_DAO_OUT, seq_no, lifetime);
     uip_icmp6_send(dest_ipaddr, ICMP6_RPL, RPL_CODE_DAO, pos);
   }
 }
@@ -1309,10 +1520,16 @@ dao_ack_input(void)
 #endif
 
   } else if(RPL_IS_STORING(instance)) {
-    /* this DAO ACK should be forwarded to another recently registered route */
+    /* this DAO ACK should be forwarded to the recently registered
+       routes. An aggregated DAO covers the routes of several children,
+       and every DAO of a child may have carried several targets. */
     uip_ds6_route_t *re;
     uip_ipaddr_t *nexthop;
-    if((re = find_route_entry_by_dao_ack(sequence)) != NULL) {
+    int found;
+
+    found = 0;
+    while((re = find_route_entry_by_dao_ack(sequence)) != NULL) {
+      found = 1;
       /* pick the recorded seq no from that node and forward DAO ACK - and
          clear the pending flag*/
       RPL_ROUTE_CLEAR_DAO_PENDING(re);
@@ -1320,19 +1537,20 @@ dao_ack_input(void)
       nexthop = uip_ds6_route_nexthop(re);
       if(nexthop == NULL) {
         PRINTF("RPL: No next hop to fwd DAO ACK to\n");
-      } else {
+      } else if(!dao_ack_is_pending(sequence, re->state.dao_seqno_in, nexthop)) {
+        /* Only the last route of a child DAO sends the ACK */
         PRINTF("RPL: Fwd DAO ACK to:");
         PRINT6ADDR(nexthop);
         PRINTF("\n");
-        buffer[2] = re->state.dao_seqno_in;
-        uip_icmp6_send(nexthop, ICMP6_RPL, RPL_CODE_DAO_ACK, 4);
+        dao_ack_output(instance, nexthop, re->state.dao_seqno_in, status);
       }
 
       if(status >= RPL_DAO_ACK_UNABLE_TO_ACCEPT) {
         /* this node did not get in to the routing tables above... - remove */
         uip_ds6_route_rm(re);
       }
-    } else {
+    }
+    if(!found) {
       PRINTF("RPL: No route entry found to forward DAO ACK (seqno %u)\n", sequence);
     }
   }
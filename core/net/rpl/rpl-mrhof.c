@@ -50,6 +50,7 @@
 #include "net/rpl/rpl-private.h"
 #include "net/nbr-table.h"
 #include "net/link-stats.h"
+#include "sys/energest.h"
 
 #define DEBUG DEBUG_NONE
 #include "net/ip/uip-debug.h"
@@ -88,6 +89,21 @@ to the threshold of 96 in the non-squared case) */
 /* Reject parents that have a higher path cost than the following. */
 #define MAX_PATH_COST      32768   /* Eq path ETX of 256 */
 
+/* With the node energy metric container (RPL_DAG_MC_ENERGY), every node
+ * advertises the highest energy estimate found along its path to the root,
+ * where a node's own estimate is the share of time its radio is on (0-255),
+ * or 0 for mains-powered nodes. Among parents with similar path costs, the
+ * parent with the lower estimate is preferred, which moves relaying away
+ * from busy battery-powered nodes. */
+#ifdef RPL_MRHOF_CONF_MAINS_POWERED
+#define RPL_MRHOF_MAINS_POWERED RPL_MRHOF_CONF_MAINS_POWERED
+#else /* RPL_MRHOF_CONF_MAINS_POWERED */
+#define RPL_MRHOF_MAINS_POWERED 0
+#endif /* RPL_MRHOF_CONF_MAINS_POWERED */
+
+/* Parents whose energy estimates differ by less than this are equivalent */
+#define ENERGY_SWITCH_THRESHOLD 16
+
 /*---------------------------------------------------------------------------*/
 static void
 reset(rpl_dag_t *dag)
@@ -120,10 +136,11 @@ parent_link_metric(rpl_parent_t *p)
   const struct link_stats *stats = rpl_get_parent_link_stats(p);
   if(stats != NULL) {
 #if RPL_MRHOF_SQUARED_ETX
-    uint32_t squared_etx = ((uint32_t)stats->etx * stats->etx) / LINK_STATS_ETX_DIVISOR;
+    uint16_t etx = link_stats_get_etx(stats);
+    uint32_t squared_etx = ((uint32_t)etx * etx) / LINK_STATS_ETX_DIVISOR;
     return (uint16_t)MIN(squared_etx, 0xffff);
 #else /* RPL_MRHOF_SQUARED_ETX */
-  return stats->etx;
+  return link_stats_get_etx(stats);
 #endif /* RPL_MRHOF_SQUARED_ETX */
   }
   return 0xffff;
@@ -144,9 +161,6 @@ parent_path_cost(rpl_parent_t *p)
     case RPL_DAG_MC_ETX:
       base = p->mc.obj.etx;
       break;
-    case RPL_DAG_MC_ENERGY:
-      base = p->mc.obj.energy.energy_est << 8;
-      break;
     default:
       base = p->rank;
       break;
@@ -193,6 +207,58 @@ parent_has_usable_link(rpl_parent_t *p)
   return link_metric <= MAX_LINK_METRIC;
 }
 /*---------------------------------------------------------------------------*/
+#if RPL_WITH_MC
+/* Share of time the radio has been on since the last call, 0-255 */
+static uint8_t
+node_energy_estimate(void)
+{
+  static unsigned long last_radio;
+  static unsigned long last_total;
+  unsigned long radio;
+  unsigned long total;
+  uint8_t estimate;
+
+  radio = energest_type_time(ENERGEST_TYPE_LISTEN) +
+    energest_type_time(ENERGEST_TYPE_TRANSMIT);
+  total = energest_type_time(ENERGEST_TYPE_CPU) +
+    energest_type_time(ENERGEST_TYPE_LPM);
+
+  if(total == last_total) {
+    estimate = 0;
+  } else {
+    /* Divide first, the products would overflow over long periods */
+    estimate = MIN((radio - last_radio) /
+                   ((total - last_total) / 256 + 1), 255);
+  }
+  last_radio = radio;
+  last_total = total;
+  return estimate;
+}
+/*---------------------------------------------------------------------------*/
+/* Returns the parent whose path is the less energy-constrained, or NULL if
+ * they are equivalent */
+static rpl_parent_t *
+best_energy_parent(rpl_parent_t *p1, rpl_parent_t *p2)
+{
+  uint8_t p1_energy;
+  uint8_t p2_energy;
+
+  if(p1->dag->instance->mc.type != RPL_DAG_MC_ENERGY) {
+    return NULL;
+  }
+
+  p1_energy = p1->mc.obj.energy.energy_est;
+  p2_energy = p2->mc.obj.energy.energy_est;
+  if(p1_energy + ENERGY_SWITCH_THRESHOLD <= p2_energy) {
+    return p1;
+  }
+  if(p2_energy + ENERGY_SWITCH_THRESHOLD <= p1_energy) {
+    return p2;
+  }
+  return NULL;
+}
+#endif /* RPL_WITH_MC */
+/*---------------------------------------------------------------------------*/
 static rpl_parent_t *
 best_parent(rpl_parent_t *p1, rpl_parent_t *p2)
 {
@@ -216,6 +282,17 @@ best_parent(rpl_parent_t *p1, rpl_parent_t *p2)
   p1_cost = parent_path_cost(p1);
   p2_cost = parent_path_cost(p2);
 
+#if RPL_WITH_MC
+  /* Spread the load over parents of similar costs */
+  if(p1_cost < p2_cost + PARENT_SWITCH_THRESHOLD &&
+     p1_cost > p2_cost - PARENT_SWITCH_THRESHOLD) {
+    rpl_parent_t *p = best_energy_parent(p1, p2);
+    if(p != NULL) {
+      return p;
+    }
+  }
+#endif /* RPL_WITH_MC */
+
   /* Maintain stability of the preferred parent in case of similar ranks. */
   if(p1 == dag->preferred_parent || p2 == dag->preferred_parent) {
     if(p1_cost < p2_cost + PARENT_SWITCH_THRESHOLD &&
@@ -254,6 +331,7 @@ update_metric_container(rpl_instance_t *instance)
   rpl_dag_t *dag;
   uint16_t path_cost;
   uint8_t type;
+  uint8_t energy;
 
   dag = instance->current_dag;
   if(dag == NULL || !dag->joined) {
@@ -265,7 +343,8 @@ update_metric_container(rpl_instance_t *instance)
     /* Configure MC at root only, other nodes are auto-configured when joining */
     instance->mc.type = RPL_DAG_MC;
     instance->mc.flags = 0;
-    instance->mc.aggr = RPL_DAG_MC_AGGR_ADDITIVE;
+    instance->mc.aggr = RPL_DAG_MC == RPL_DAG_MC_ENERGY ?
+      RPL_DAG_MC_AGGR_MAXIMUM : RPL_DAG_MC_AGGR_ADDITIVE;
     instance->mc.prec = 0;
     path_cost = dag->rank;
   } else {
@@ -282,14 +361,20 @@ update_metric_container(rpl_instance_t *instance)
       break;
     case RPL_DAG_MC_ENERGY:
       instance->mc.length = sizeof(instance->mc.obj.energy);
-      if(dag->rank == ROOT_RANK(instance)) {
+      if(dag->rank == ROOT_RANK(instance) || RPL_MRHOF_MAINS_POWERED) {
         type = RPL_DAG_MC_ENERGY_TYPE_MAINS;
+        energy = 0;
+        node_energy_estimate();
       } else {
         type = RPL_DAG_MC_ENERGY_TYPE_BATTERY;
+        energy = node_energy_estimate();
       }
       instance->mc.obj.energy.flags = type << RPL_DAG_MC_ENERGY_TYPE;
-      /* Energy_est is only one byte, use the least significant byte of the path metric. */
-      instance->mc.obj.energy.energy_est = path_cost >> 8;
+      /* Advertise the most constrained node on the path (maximum) */
+      if(dag->rank != ROOT_RANK(instance) && dag->preferred_parent != NULL) {
+        energy = MAX(energy, dag->preferred_parent->mc.obj.energy.energy_est);
+      }
+      instance->mc.obj.energy.energy_est = energy;
       break;
     default:
       PRINTF("RPL: MRHOF, non-supported MC %u\n", instance->mc.type);
@@ -63,6 +63,14 @@ static int num_nodes;
 LIST(nodelist);
 MEMB(nodememb, rpl_ns_node_t, RPL_NS_LINK_NUM);
 
+#if RPL_NS_HASH_SIZE
+/* Nodes indexed by their link identifier */
+static rpl_ns_node_t *node_hash[RPL_NS_HASH_SIZE];
+#endif /* RPL_NS_HASH_SIZE */
+
+/* Topology version, changed whenever a parent changes or a node goes */
+static uint16_t version;
+
 /*---------------------------------------------------------------------------*/
 int
 rpl_ns_num_nodes(void)
@@ -81,11 +89,48 @@ node_matches_address(const rpl_dag_t *dag, const rpl_ns_node_t *node, const uip_
       && !memcmp(((const unsigned char *)addr) + 8, node->link_identifier, 8);
 }
 /*---------------------------------------------------------------------------*/
+#if RPL_NS_HASH_SIZE
+static uint16_t
+hash_link_identifier(const unsigned char *link_identifier)
+{
+  uint8_t i;
+  uint16_t h;
+
+  h = 0;
+  for(i = 0; i < 8; i++) {
+    h = (h << 3) + (h >> 13) + link_identifier[i];
+  }
+  return h % RPL_NS_HASH_SIZE;
+}
+/*---------------------------------------------------------------------------*/
+static void
+hash_remove(rpl_ns_node_t *node)
+{
+  rpl_ns_node_t **p;
+
+  for(p = &node_hash[hash_link_identifier(node->link_identifier)];
+      *p != NULL; p = &(*p)->hash_next) {
+    if(*p == node) {
+      *p = node->hash_next;
+      return;
+    }
+  }
+}
+#endif /* RPL_NS_HASH_SIZE */
+/*---------------------------------------------------------------------------*/
 rpl_ns_node_t *
 rpl_ns_get_node(const rpl_dag_t *dag, const uip_ipaddr_t *addr)
 {
   rpl_ns_node_t *l;
+#if RPL_NS_HASH_SIZE
+  if(addr == NULL) {
+    return NULL;
+  }
+  for(l = node_hash[hash_link_identifier(((const unsigned char *)addr) + 8)];
+      l != NULL; l = l->hash_next) {
+#else /* RPL_NS_HASH_SIZE */
   for(l = list_head(nodelist); l != NULL; l = list_item_next(l)) {
+#endif /* RPL_NS_HASH_SIZE */
     /* Compare prefix and node identifier */
     if(node_matches_address(dag, l, addr)) {
       return l;
@@ -144,6 +189,14 @@ rpl_ns_update_node(rpl_dag_t *dag, const uip_ipaddr_t *child, const uip_ipaddr_t
     child_node->parent = NULL;
     list_add(nodelist, child_node);
     num_nodes++;
+#if RPL_NS_HASH_SIZE
+    memcpy(child_node->link_identifier, ((const unsigned char *)child) + 8, 8);
+    child_node->hash_next =
+      node_hash[hash_link_identifier(child_node->link_identifier)];
+    node_hash[hash_link_identifier(child_node->link_identifier)] = child_node;
+#endif /* RPL_NS_HASH_SIZE */
+  } else if(child_node->parent != parent_node || child_node->dag != dag) {
+    version++;
   }
 
   /* Initialize node */
@@ -176,6 +229,10 @@ rpl_ns_init(void)
   num_nodes = 0;
   memb_init(&nodememb);
   list_init(nodelist);
+#if RPL_NS_HASH_SIZE
+  memset(node_hash, 0, sizeof(node_hash));
+#endif /* RPL_NS_HASH_SIZE */
+  version++;
 }
 /*---------------------------------------------------------------------------*/
 rpl_ns_node_t *
@@ -220,11 +277,21 @@ rpl_ns_periodic(void)
         }
       }
       /* No child found, deallocate node */
+#if RPL_NS_HASH_SIZE
+      hash_remove(l);
+#endif /* RPL_NS_HASH_SIZE */
+      version++;
       list_remove(nodelist, l);
       memb_free(&nodememb, l);
       num_nodes--;
     }
   }
 }
+/*---------------------------------------------------------------------------*/
+uint16_t
+rpl_ns_get_version(void)
+{
+  return version;
+}
 
 #endif /* RPL_WITH_NON_STORING */
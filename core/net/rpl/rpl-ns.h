@@ -49,8 +49,35 @@
 #define RPL_NS_LINK_NUM 32
 #endif /* RPL_NS_CONF_LINK_NUM */
 
+/* Number of buckets in the index of nodes by link identifier,
+ * 0 to search the node list linearly */
+#ifdef RPL_NS_CONF_HASH_SIZE
+#define RPL_NS_HASH_SIZE RPL_NS_CONF_HASH_SIZE
+#else /* RPL_NS_CONF_HASH_SIZE */
+#define RPL_NS_HASH_SIZE 0
+#endif /* RPL_NS_CONF_HASH_SIZE */
+
+/* Number of source routing headers cached for reuse by downward
+ * packets to the same destination, 0 to build every header from the
+ * node list */
+#ifdef RPL_NS_CONF_SRH_CACHE_SIZE
+#define RPL_NS_SRH_CACHE_SIZE RPL_NS_CONF_SRH_CACHE_SIZE
+#else /* RPL_NS_CONF_SRH_CACHE_SIZE */
+#define RPL_NS_SRH_CACHE_SIZE 0
+#endif /* RPL_NS_CONF_SRH_CACHE_SIZE */
+
+/* Longest source routing header that is cached */
+#ifdef RPL_NS_CONF_SRH_CACHE_HDR_LEN
+#define RPL_NS_SRH_CACHE_HDR_LEN RPL_NS_CONF_SRH_CACHE_HDR_LEN
+#else /* RPL_NS_CONF_SRH_CACHE_HDR_LEN */
+#define RPL_NS_SRH_CACHE_HDR_LEN 64
+#endif /* RPL_NS_CONF_SRH_CACHE_HDR_LEN */
+
 typedef struct rpl_ns_node {
   struct rpl_ns_node *next;
+#if RPL_NS_HASH_SIZE
+  struct rpl_ns_node *hash_next;
+#endif /* RPL_NS_HASH_SIZE */
   uint32_t lifetime;
   rpl_dag_t *dag;
   /* Store only IPv6 link identifiers as all nodes in the DAG share the same prefix */
@@ -68,5 +95,8 @@ rpl_ns_node_t *rpl_ns_get_node(const rpl_dag_t *dag, const uip_ipaddr_t *addr);
 int rpl_ns_is_node_reachable(const rpl_dag_t *dag, const uip_ipaddr_t *addr);
 void rpl_ns_get_node_global_addr(uip_ipaddr_t *addr, rpl_ns_node_t *node);
 void rpl_ns_periodic(void);
+/* Returns a counter that changes whenever a path in the topology may
+ * have changed, for invalidating information derived from it */
+uint16_t rpl_ns_get_version(void);
 
 #endif /* RPL_NS_H */
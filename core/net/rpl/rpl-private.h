@@ -318,6 +318,7 @@ struct rpl_stats {
   uint16_t loop_errors;
   uint16_t loop_warnings;
   uint16_t root_repairs;
+  uint16_t fast_reroutes;
 };
 typedef struct rpl_stats rpl_stats_t;
 
@@ -370,6 +371,9 @@ void rpl_nullify_parent(rpl_parent_t *);
 void rpl_remove_parent(rpl_parent_t *);
 void rpl_move_parent(rpl_dag_t *dag_src, rpl_dag_t *dag_dst, rpl_parent_t *parent);
 rpl_parent_t *rpl_select_parent(rpl_dag_t *dag);
+#if RPL_WITH_BACKUP_PARENT
+int rpl_switch_to_backup_parent(rpl_dag_t *dag);
+#endif /* RPL_WITH_BACKUP_PARENT */
 rpl_dag_t *rpl_select_dag(rpl_instance_t *instance,rpl_parent_t *parent);
 void rpl_recalculate_ranks(void);
 
@@ -47,6 +47,7 @@
 #include "net/link-stats.h"
 #include "net/ipv6/multicast/uip-mcast6.h"
 #include "lib/random.h"
+#include "lib/trickle-timer.h"
 #include "sys/ctimer.h"
 
 #define DEBUG DEBUG_NONE
@@ -120,6 +121,8 @@ new_dio_interval(rpl_instance_t *instance)
 
   /* random number between I/2 and I */
   ticks = ticks / 2 + (ticks / 2 * (uint32_t)random_rand()) / RANDOM_RAND_MAX;
+  /* share the radio wake-up with other trickle timers */
+  ticks = trickle_timer_align(clock_time(), ticks, instance->dio_next_delay);
 
   /*
    * The intervals must be equally long among the nodes for Trickle to
@@ -46,6 +46,7 @@
 #include "net/ip/tcpip.h"
 #include "net/ipv6/uip-ds6.h"
 #include "net/ipv6/uip-icmp6.h"
+#include "net/mac/mac.h"
 #include "net/rpl/rpl-private.h"
 #include "net/rpl/rpl-ns.h"
 #include "net/ipv6/multicast/uip-mcast6.h"
@@ -267,6 +268,12 @@ rpl_link_neighbor_callback(const linkaddr_t *addr, int status, int numtx)
         /* Trigger DAG rank recalculation. */
         PRINTF("RPL: rpl_link_neighbor_callback triggering update\n");
         parent->flags |= RPL_PARENT_FLAG_UPDATED;
+#if RPL_WITH_BACKUP_PARENT
+        /* The next packets go through the backup parent right away */
+        if(status == MAC_TX_NOACK && parent == instance->current_dag->preferred_parent) {
+          rpl_switch_to_backup_parent(instance->current_dag);
+        }
+#endif /* RPL_WITH_BACKUP_PARENT */
       }
     }
   }
@@ -142,6 +142,9 @@ struct rpl_dag {
   /* live data for the DAG */
   uint8_t joined;
   rpl_parent_t *preferred_parent;
+#if RPL_WITH_BACKUP_PARENT
+  rpl_parent_t *backup_parent;
+#endif /* RPL_WITH_BACKUP_PARENT */
   rpl_rank_t rank;
   struct rpl_instance *instance;
   rpl_prefix_t prefix_info;
@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \file
+ *         Asynchronous tasks: protothreads waiting for futures, run by
+ *         the async process
+ */
+
+/**
+ * \addtogroup async
+ * @{
+ */
+
+#include "sys/async.h"
+#include "lib/list.h"
+
+/* The task should run on the next poll of the async process */
+#define FLAG_RUNNABLE  0x01
+/* The task runs during the current poll */
+#define FLAG_SCHEDULED 0x02
+
+LIST(tasks);
+
+PROCESS(async_process, "Async tasks");
+
+/*---------------------------------------------------------------------------*/
+static void
+end_task(struct async_task *t)
+{
+  list_remove(tasks, t);
+  t->flags = 0;
+  async_future_complete(&t->done);
+}
+/*---------------------------------------------------------------------------*/
+static struct async_task *
+next_scheduled(void)
+{
+  struct async_task *t;
+
+  for(t = list_head(tasks); t != NULL; t = list_item_next(t)) {
+    if(t->flags & FLAG_SCHEDULED) {
+      return t;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+run_tasks(void)
+{
+  struct async_task *t;
+
+  /* Every runnable task runs once per poll. Tasks woken up meanwhile,
+     including a task that yields, run on the next poll, so that the
+     other processes get their turn. Tasks may start, end or cancel
+     tasks as they run, so look up the next task from the head of the
+     list every time. */
+  for(t = list_head(tasks); t != NULL; t = list_item_next(t)) {
+    if(t->flags & FLAG_RUNNABLE) {
+      t->flags = FLAG_SCHEDULED;
+    }
+  }
+
+  while((t = next_scheduled()) != NULL) {
+    t->flags &= ~FLAG_SCHEDULED;
+    if(t->fn(t) >= PT_EXITED) {
+      end_task(t);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(async_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  while(1) {
+    PROCESS_YIELD();
+    if(ev == PROCESS_EVENT_POLL) {
+      run_tasks();
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+void
+async_task_wake(struct async_task *t)
+{
+  t->flags |= FLAG_RUNNABLE;
+  process_poll(&async_process);
+}
+/*---------------------------------------------------------------------------*/
+void
+async_start(struct async_task *t, async_task_fn_t fn, void *data)
+{
+  if(!process_is_running(&async_process)) {
+    process_start(&async_process, NULL);
+  }
+
+  if(async_is_running(t)) {
+    list_remove(tasks, t);
+  }
+  PT_INIT(&t->pt);
+  t->fn = fn;
+  t->data = data;
+  t->flags = 0;
+  async_future_init(&t->done);
+  list_add(tasks, t);
+  async_task_wake(t);
+}
+/*---------------------------------------------------------------------------*/
+void
+async_cancel(struct async_task *t)
+{
+  if(async_is_running(t)) {
+    end_task(t);
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+async_is_running(struct async_task *t)
+{
+  struct async_task *i;
+
+  for(i = list_head(tasks); i != NULL; i = list_item_next(i)) {
+    if(i == t) {
+      return 1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+async_future_init(struct async_future *f)
+{
+  f->task = NULL;
+  f->done = 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+async_future_bind(struct async_future *f, struct async_task *t)
+{
+  f->task = t;
+}
+/*---------------------------------------------------------------------------*/
+void
+async_future_complete(struct async_future *f)
+{
+  f->done = 1;
+  if(f->task != NULL) {
+    /* Only wake up the task if it still runs: it may have moved on
+       from an ASYNC_AWAIT_ANY() and ended since it bound the future */
+    if(async_is_running(f->task)) {
+      async_task_wake(f->task);
+    }
+    f->task = NULL;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+timer_callback(void *ptr)
+{
+  async_future_complete(&((struct async_timer *)ptr)->future);
+}
+/*---------------------------------------------------------------------------*/
+void
+async_timer_set(struct async_timer *t, clock_time_t interval)
+{
+  async_future_init(&t->future);
+  ctimer_set(&t->ctimer, interval, timer_callback, t);
+}
+/*---------------------------------------------------------------------------*/
+void
+async_timer_stop(struct async_timer *t)
+{
+  ctimer_stop(&t->ctimer);
+}
+/*---------------------------------------------------------------------------*/
+/** @} */
@@ -0,0 +1,273 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \file
+ *         Header file for asynchronous tasks
+ */
+
+/**
+ * \addtogroup sys
+ * @{
+ */
+
+/**
+ * \defgroup async Asynchronous tasks
+ * @{
+ *
+ * An asynchronous task is a protothread that waits for futures:
+ * one-shot completion flags that timers, CoAP requests or other tasks
+ * complete. A task can wait for one future, for all of several, or
+ * for the first of several, which lets a single process drive many
+ * concurrent flows, each with its own state, without threads and
+ * their stacks.
+ *
+ * Tasks are run by the async process. As with protothreads, local
+ * variables are not kept across waits, so a task keeps its state in
+ * a structure of the caller, reached through the data pointer given
+ * to async_start(). Timers and CoAP requests started from a task are
+ * bound to the async process, and futures must be completed from
+ * process context, not from interrupts.
+ *
+ * \code
+ * PT_THREAD(flow(struct async_task *t))
+ * {
+ *   struct flow_state *s = t->data;
+ *
+ *   ASYNC_BEGIN(t);
+ *   async_timer_set(&s->timeout, 10 * CLOCK_SECOND);
+ *   coap_send_request_async(&s->request, &s->response, &addr, port, &s->packet);
+ *   ASYNC_AWAIT_ANY(t, &s->response, &s->timeout.future);
+ *   ...
+ *   ASYNC_END(t);
+ * }
+ * \endcode
+ *
+ */
+
+#ifndef ASYNC_H_
+#define ASYNC_H_
+
+#include "contiki.h"
+
+struct async_task;
+
+/**
+ * A one-shot completion flag. A future is completed once and
+ * wakes up the task waiting for it, if any.
+ */
+struct async_future {
+  struct async_task *task;
+  uint8_t done;
+};
+
+typedef PT_THREAD((* async_task_fn_t)(struct async_task *t));
+
+/**
+ * An asynchronous task, kept by the caller as long as the task runs.
+ */
+struct async_task {
+  struct async_task *next;
+  struct pt pt;
+  async_task_fn_t fn;
+  void *data;                /**< free for use by the caller */
+  struct async_future done;  /**< completed when the task has ended */
+  uint8_t flags;
+};
+
+/**
+ * A timer that completes a future when it expires.
+ */
+struct async_timer {
+  struct async_future future;
+  struct ctimer ctimer;
+};
+
+/**
+ * \brief      Declare the start of an asynchronous task
+ * \param t    The task
+ */
+#define ASYNC_BEGIN(t) PT_BEGIN(&(t)->pt)
+
+/**
+ * \brief      Declare the end of an asynchronous task
+ * \param t    The task
+ */
+#define ASYNC_END(t) PT_END(&(t)->pt)
+
+/**
+ * \brief      End the task before reaching ASYNC_END()
+ * \param t    The task
+ */
+#define ASYNC_EXIT(t) PT_EXIT(&(t)->pt)
+
+/**
+ * \brief      Let other tasks and processes run
+ * \param t    The task
+ */
+#define ASYNC_YIELD(t)                          \
+  do {                                          \
+    async_task_wake(t);                         \
+    PT_YIELD(&(t)->pt);                         \
+  } while(0)
+
+/**
+ * \brief      Wait until a future is complete
+ * \param t    The task
+ * \param f    The future
+ */
+#define ASYNC_AWAIT(t, f)                                       \
+  do {                                                          \
+    async_future_bind((f), (t));                                \
+    PT_WAIT_UNTIL(&(t)->pt, async_future_is_done(f));           \
+  } while(0)
+
+/**
+ * \brief      Wait until two futures are both complete
+ * \param t    The task
+ * \param f1   The first future
+ * \param f2   The second future
+ */
+#define ASYNC_AWAIT_ALL(t, f1, f2)                              \
+  do {                                                          \
+    async_future_bind((f1), (t));                               \
+    async_future_bind((f2), (t));                               \
+    PT_WAIT_UNTIL(&(t)->pt, async_future_is_done(f1) &&         \
+                  async_future_is_done(f2));                    \
+  } while(0)
+
+/**
+ * \brief      Wait until at least one of two futures is complete
+ * \param t    The task
+ * \param f1   The first future
+ * \param f2   The second future
+ *
+ *             The other future stays bound to the task and may wake
+ *             it up later, which is harmless as conditions are
+ *             checked again. Stop its source, e.g. the timer, if the
+ *             task state is about to be reused.
+ */
+#define ASYNC_AWAIT_ANY(t, f1, f2)                              \
+  do {                                                          \
+    async_future_bind((f1), (t));                               \
+    async_future_bind((f2), (t));                               \
+    PT_WAIT_UNTIL(&(t)->pt, async_future_is_done(f1) ||         \
+                  async_future_is_done(f2));                    \
+  } while(0)
+
+/**
+ * \brief      Wait until another task has ended
+ * \param t    The task
+ * \param other The task to wait for
+ */
+#define ASYNC_JOIN(t, other) ASYNC_AWAIT((t), &(other)->done)
+
+/**
+ * \brief      Start an asynchronous task
+ * \param t    The task, kept by the caller until it has ended
+ * \param fn   The protothread function of the task
+ * \param data Passed to the task in t->data
+ *
+ *             The task first runs from the async process, after the
+ *             caller has returned to the scheduler.
+ */
+void async_start(struct async_task *t, async_task_fn_t fn, void *data);
+
+/**
+ * \brief      Stop an asynchronous task before it has ended
+ * \param t    The task
+ *
+ *             Completes the done future of the task.
+ */
+void async_cancel(struct async_task *t);
+
+/**
+ * \brief      Check if a task is still running
+ * \param t    The task
+ */
+int async_is_running(struct async_task *t);
+
+/**
+ * \brief      Schedule a task to run again
+ * \param t    The task
+ */
+void async_task_wake(struct async_task *t);
+
+/**
+ * \brief      Make a future pending again
+ * \param f    The future
+ */
+void async_future_init(struct async_future *f);
+
+/**
+ * \brief      Complete a future, waking up the task waiting for it
+ * \param f    The future
+ */
+void async_future_complete(struct async_future *f);
+
+/**
+ * \brief      Set the task to wake up when a future completes
+ * \param f    The future
+ * \param t    The task
+ */
+void async_future_bind(struct async_future *f, struct async_task *t);
+
+/**
+ * \brief      Check if a future is complete
+ * \param f    The future
+ */
+static inline int
+async_future_is_done(const struct async_future *f)
+{
+  return f->done;
+}
+
+/**
+ * \brief      Start a timer that completes its future when it expires
+ * \param t    The timer
+ * \param interval The time until the timer expires
+ */
+void async_timer_set(struct async_timer *t, clock_time_t interval);
+
+/**
+ * \brief      Stop a timer, its future stays pending
+ * \param t    The timer
+ */
+void async_timer_stop(struct async_timer *t);
+
+PROCESS_NAME(async_process);
+
+#endif /* ASYNC_H_ */
+
+/** @} */
+/** @} */
@@ -114,6 +114,28 @@
 #define CC_ASSIGN_AGGREGATE(dest, src)	*dest = *src
 #endif /* CC_CONF_ASSIGN_AGGREGATE */
 
+/**
+ * Copy and fill functions for whole packets (packetbuf, queuebuf and
+ * uip_buf copies), for CPUs that have something faster than the C
+ * library for large buffers. They take the arguments of memcpy() and
+ * memset().
+ */
+#ifdef CONTIKI_ARCH_CONF_MEMCPY
+#include <stddef.h>
+#define CONTIKI_ARCH_MEMCPY CONTIKI_ARCH_CONF_MEMCPY
+void *CONTIKI_ARCH_MEMCPY(void *dst, const void *src, size_t len);
+#else /* CONTIKI_ARCH_CONF_MEMCPY */
+#define CONTIKI_ARCH_MEMCPY memcpy
+#endif /* CONTIKI_ARCH_CONF_MEMCPY */
+
+#ifdef CONTIKI_ARCH_CONF_MEMSET
+#include <stddef.h>
+#define CONTIKI_ARCH_MEMSET CONTIKI_ARCH_CONF_MEMSET
+void *CONTIKI_ARCH_MEMSET(void *dst, int c, size_t len);
+#else /* CONTIKI_ARCH_CONF_MEMSET */
+#define CONTIKI_ARCH_MEMSET memset
+#endif /* CONTIKI_ARCH_CONF_MEMSET */
+
 #if CC_CONF_NO_VA_ARGS
 #define CC_NO_VA_ARGS CC_CONF_VA_ARGS
 #endif
@@ -49,6 +49,8 @@
 
 struct compower_activity compower_idle_activity;
 
+static uint16_t current_flow;
+
 /*---------------------------------------------------------------------------*/
 void
 compower_init(void)
@@ -95,4 +97,16 @@ compower_accumulate_attrs(struct compower_activity *e)
   e->transmit += packetbuf_attr(PACKETBUF_ATTR_TRANSMIT_TIME);
 }
 /*---------------------------------------------------------------------------*/
+void
+compower_set_flow(uint16_t flow)
+{
+  current_flow = flow;
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+compower_get_flow(void)
+{
+  return current_flow;
+}
+/*---------------------------------------------------------------------------*/
 /** @} */
@@ -65,6 +65,9 @@ struct compower_activity {
   uint32_t listen, transmit;
 };
 
+/* The flow of packets not attributed to any (see compower_set_flow()) */
+#define COMPOWER_FLOW_NONE 0
+
 /**
  * \brief      The default idle communication activity.
  *
@@ -129,6 +132,27 @@ void compower_attrconv(struct compower_activity *a);
  */
 void compower_accumulate_attrs(struct compower_activity *a);
 
+/**
+ * \brief      Attribute the packets sent from now on to a traffic flow
+ * \param flow The flow, or COMPOWER_FLOW_NONE
+ *
+ *             This function is called by protocols above the
+ *             network layer before they send on behalf of something
+ *             whose energy consumption is of interest, such as a
+ *             CoAP resource. The network layer puts the flow in the
+ *             PACKETBUF_ATTR_FLOW attribute of the outgoing packets,
+ *             next to the radio time the MAC protocol spent on
+ *             them, so that it can be summed per flow.
+ *
+ */
+void compower_set_flow(uint16_t flow);
+
+/**
+ * \brief      Get the flow outgoing packets are attributed to
+ * \return     The flow set by compower_set_flow()
+ */
+uint16_t compower_get_flow(void);
+
 #endif /* COMPOWER_H_ */
 
 /** @} */
@@ -62,9 +62,13 @@ static char initialized;
 PROCESS(ctimer_process, "Ctimer process");
 PROCESS_THREAD(ctimer_process, ev, data)
 {
+  static struct process_subscription no_broadcast;
   struct ctimer *c;
   PROCESS_BEGIN();
 
+  /* We are only interested in the events of our own etimers */
+  process_subscribe(&no_broadcast, PROCESS_EVENT_NONE);
+
   for(c = list_head(ctimer_list); c != NULL; c = c->next) {
     etimer_set(&c->etimer, c->etimer.timer.interval);
   }
@@ -49,6 +49,7 @@
 #include "sys/etimer.h"
 #include "sys/process.h"
 
+/* Active timers, sorted by expiration time: the first one expires first */
 static struct etimer *timerlist;
 static clock_time_t next_expiration;
 
@@ -57,33 +58,64 @@ PROCESS(etimer_process, "Event timer");
 static void
 update_time(void)
 {
-  clock_time_t tdist;
-  clock_time_t now;
-  struct etimer *t;
-
   if (timerlist == NULL) {
     next_expiration = 0;
   } else {
-    now = clock_time();
-    t = timerlist;
-    /* Must calculate distance to next time into account due to wraps */
-    tdist = t->timer.start + t->timer.interval - now;
-    for(t = t->next; t != NULL; t = t->next) {
-      if(t->timer.start + t->timer.interval - now < tdist) {
-	tdist = t->timer.start + t->timer.interval - now;
-      }
+    next_expiration = timerlist->timer.start + timerlist->timer.interval;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Time left until a timer expires, 0 if it already has. Unlike
+ * expiration times, this can be compared across clock wraps */
+static clock_time_t
+time_left(struct etimer *t, clock_time_t now)
+{
+  if(timer_expired(&t->timer)) {
+    return 0;
+  }
+  return t->timer.start + t->timer.interval - now;
+}
+/*---------------------------------------------------------------------------*/
+/* Take a timer off the list. Returns 1 if it was on the list */
+static int
+remove_timer(struct etimer *timer)
+{
+  struct etimer **t;
+
+  for(t = &timerlist; *t != NULL; t = &(*t)->next) {
+    if(*t == timer) {
+      *t = timer->next;
+      timer->next = NULL;
+      return 1;
     }
-    next_expiration = now + tdist;
   }
+  timer->next = NULL;
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Insert a timer after all timers expiring no later than it does */
+static void
+insert_timer(struct etimer *timer)
+{
+  struct etimer **t;
+  clock_time_t now = clock_time();
+  clock_time_t left = time_left(timer, now);
+
+  for(t = &timerlist; *t != NULL && time_left(*t, now) <= left; t = &(*t)->next);
+  timer->next = *t;
+  *t = timer;
 }
 /*---------------------------------------------------------------------------*/
 PROCESS_THREAD(etimer_process, ev, data)
 {
-  struct etimer *t, *u;
+  static struct process_subscription exited_subscription;
+  struct etimer *t;
 	
   PROCESS_BEGIN();
 
   timerlist = NULL;
+  /* Other broadcast events are of no interest to us */
+  process_subscribe(&exited_subscription, PROCESS_EVENT_EXITED);
   
   while(1) {
     PROCESS_YIELD();
@@ -104,38 +136,29 @@ PROCESS_THREAD(etimer_process, ev, data)
 	    t = t->next;
 	}
       }
+      update_time();
       continue;
     } else if(ev != PROCESS_EVENT_POLL) {
       continue;
     }
 
-  again:
-    
-    u = NULL;
-    
-    for(t = timerlist; t != NULL; t = t->next) {
-      if(timer_expired(&t->timer)) {
-	if(process_post(t->p, PROCESS_EVENT_TIMER, t) == PROCESS_ERR_OK) {
-	  
-	  /* Reset the process ID of the event timer, to signal that the
-	     etimer has expired. This is later checked in the
-	     etimer_expired() function. */
-	  t->p = PROCESS_NONE;
-	  if(u != NULL) {
-	    u->next = t->next;
-	  } else {
-	    timerlist = t->next;
-	  }
-	  t->next = NULL;
-	  update_time();
-	  goto again;
-	} else {
-	  etimer_request_poll();
-	}
+    /* The list being sorted, expired timers are all at its head */
+    while(timerlist != NULL && timer_expired(&timerlist->timer)) {
+      t = timerlist;
+      if(process_post(t->p, PROCESS_EVENT_TIMER, t) == PROCESS_ERR_OK) {
+	/* Reset the process ID of the event timer, to signal that the
+	   etimer has expired. This is later checked in the
+	   etimer_expired() function. */
+	t->p = PROCESS_NONE;
+	timerlist = t->next;
+	t->next = NULL;
+      } else {
+	/* The event queue is full, try again later */
+	etimer_request_poll();
+	break;
       }
-      u = t;
     }
-    
+    update_time();
   }
   
   PROCESS_END();
@@ -150,25 +173,16 @@ etimer_request_poll(void)
 static void
 add_timer(struct etimer *timer)
 {
-  struct etimer *t;
-
   etimer_request_poll();
 
   if(timer->p != PROCESS_NONE) {
-    for(t = timerlist; t != NULL; t = t->next) {
-      if(t == timer) {
-	/* Timer already on list, bail out. */
-        timer->p = PROCESS_CURRENT();
-	update_time();
-	return;
-      }
-    }
+    /* The timer may already be on the list, at a position that no
+       longer matches its expiration time. */
+    remove_timer(timer);
   }
 
-  /* Timer not on list. */
   timer->p = PROCESS_CURRENT();
-  timer->next = timerlist;
-  timerlist = timer;
+  insert_timer(timer);
 
   update_time();
 }
@@ -206,6 +220,10 @@ void
 etimer_adjust(struct etimer *et, int timediff)
 {
   et->timer.start += timediff;
+  /* Keep the list sorted */
+  if(remove_timer(et)) {
+    insert_timer(et);
+  }
   update_time();
 }
 /*---------------------------------------------------------------------------*/
@@ -242,29 +260,9 @@ etimer_next_expiration_time(void)
 void
 etimer_stop(struct etimer *et)
 {
-  struct etimer *t;
-
-  /* First check if et is the first event timer on the list. */
-  if(et == timerlist) {
-    timerlist = timerlist->next;
-    update_time();
-  } else {
-    /* Else walk through the list and try to find the item before the
-       et timer. */
-    for(t = timerlist; t != NULL && t->next != et; t = t->next);
-
-    if(t != NULL) {
-      /* We've found the item before the event timer that we are about
-	 to remove. We point the items next pointer to the event after
-	 the removed item. */
-      t->next = et->next;
-
-      update_time();
-    }
-  }
+  remove_timer(et);
+  update_time();
 
-  /* Remove the next pointer from the item to be removed. */
-  et->next = NULL;
   /* Set the timer as expired */
   et->p = PROCESS_NONE;
 }
@@ -47,6 +47,10 @@
 
 #include "sys/process.h"
 #include "sys/arg.h"
+#if PROCESS_CONF_PROFILE
+#include "sys/clock.h"
+#include "sys/rtimer.h"
+#endif /* PROCESS_CONF_PROFILE */
 
 /*
  * Pointer to the currently running process structure.
@@ -63,22 +67,69 @@ struct event_data {
   process_event_t ev;
   process_data_t data;
   struct process *p;
+#if PROCESS_CONF_PROFILE
+  rtimer_clock_t time;
+#endif /* PROCESS_CONF_PROFILE */
+};
+
+/*
+ * A ring of events. Urgent events have their own ring, which is
+ * emptied first, so that they neither wait behind nor get dropped
+ * because of a burst of ordinary events.
+ */
+struct event_queue {
+  struct event_data *events;
+  process_num_events_t size;
+  process_num_events_t nevents, fevent;
 };
 
-static process_num_events_t nevents, fevent;
 static struct event_data events[PROCESS_CONF_NUMEVENTS];
+static struct event_queue queue = { events, PROCESS_CONF_NUMEVENTS };
+#if PROCESS_CONF_NUMEVENTS_URGENT
+static struct event_data urgent_events[PROCESS_CONF_NUMEVENTS_URGENT];
+static struct event_queue urgent_queue = { urgent_events, PROCESS_CONF_NUMEVENTS_URGENT };
+#endif /* PROCESS_CONF_NUMEVENTS_URGENT */
+
+/* Number of events in both queues */
+static process_num_events_t nevents;
 
 #if PROCESS_CONF_STATS
+/* High-water marks of the queues */
 process_num_events_t process_maxevents;
+process_num_events_t process_maxevents_urgent;
+/* Posts merged into an identical queued event, and posts that failed */
+uint16_t process_coalesced_events;
+uint16_t process_dropped_events;
 #endif
 
 static volatile unsigned char poll_requested;
 
+/*
+ * Queue of the processes that have been polled. process_poll() may be
+ * called from interrupts: an interrupt that finds the queue being
+ * modified leaves it alone and has do_poll() look for its process in
+ * the whole process list instead.
+ */
+static struct process *poll_queue;
+static volatile unsigned char poll_queue_locked;
+static volatile unsigned char poll_scan;
+
+/* Processes that only receive the broadcast events they subscribed to */
+static struct process_subscription *subscriptions;
+
+#if PROCESS_CONF_PROFILE
+/* When the event being delivered was posted */
+static rtimer_clock_t event_time;
+/* Run time of the processes called synchronously by the current one */
+static uint32_t nested_run_time;
+#endif /* PROCESS_CONF_PROFILE */
+
 #define PROCESS_STATE_NONE        0
 #define PROCESS_STATE_RUNNING     1
 #define PROCESS_STATE_CALLED      2
 
 static void call_process(struct process *p, process_event_t ev, process_data_t data);
+static void do_poll(void);
 
 #define DEBUG 0
 #if DEBUG
@@ -119,6 +170,112 @@ process_start(struct process *p, process_data_t data)
   /* Post a synchronous initialization event to the process. */
   process_post_synch(p, PROCESS_EVENT_INIT, data);
 }
+#if PROCESS_CONF_PROFILE
+/*---------------------------------------------------------------------------*/
+static void
+profile_latency(struct process *p)
+{
+  uint32_t latency;
+
+  if(p->state & PROCESS_STATE_RUNNING) {
+    latency = (rtimer_clock_t)(RTIMER_NOW() - event_time);
+    p->profile.events++;
+    p->profile.latency += latency;
+    if(latency > p->profile.max_latency) {
+      p->profile.max_latency = latency;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+profile_run(struct process *p, rtimer_clock_t start, uint32_t outer_nested)
+{
+  uint32_t elapsed = (rtimer_clock_t)(RTIMER_NOW() - start);
+  uint32_t run_time = elapsed - nested_run_time;
+
+  p->profile.calls++;
+  p->profile.run_time += run_time;
+  if(run_time > p->profile.max_run_time) {
+    p->profile.max_run_time = run_time;
+  }
+  /* The caller, if any, should not be charged for our run time */
+  nested_run_time = outer_nested + elapsed;
+}
+#endif /* PROCESS_CONF_PROFILE */
+/*---------------------------------------------------------------------------*/
+static void
+remove_subscriptions(struct process *p)
+{
+  struct process_subscription **s;
+
+  for(s = &subscriptions; *s != NULL;) {
+    if((*s)->p == p) {
+      *s = (*s)->next;
+    } else {
+      s = &(*s)->next;
+    }
+  }
+  p->subscriptions = 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+remove_poll(struct process *p)
+{
+  struct process **q;
+
+  poll_queue_locked = 1;
+  if(p->pollqueued) {
+    for(q = &poll_queue; *q != NULL; q = &(*q)->pollnext) {
+      if(*q == p) {
+        *q = p->pollnext;
+        p->pollqueued = 0;
+        break;
+      }
+    }
+  }
+  poll_queue_locked = 0;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Deliver a broadcast event to all processes but one. An event from
+ * the event queue has the poll handlers called in between.
+ */
+static void
+call_broadcast(process_event_t ev, process_data_t data,
+               struct process *except, int queued)
+{
+  struct process *p;
+  struct process_subscription *s, *next;
+
+  for(p = process_list; p != NULL; p = p->next) {
+    if(p != except && p->subscriptions == 0) {
+      if(queued && poll_requested) {
+        do_poll();
+      }
+#if PROCESS_CONF_PROFILE
+      if(queued) {
+        profile_latency(p);
+      }
+#endif /* PROCESS_CONF_PROFILE */
+      call_process(p, ev, data);
+    }
+  }
+
+  for(s = subscriptions; s != NULL; s = next) {
+    next = s->next;
+    if(s->ev == ev && s->p != except) {
+      if(queued && poll_requested) {
+        do_poll();
+      }
+#if PROCESS_CONF_PROFILE
+      if(queued) {
+        profile_latency(s->p);
+      }
+#endif /* PROCESS_CONF_PROFILE */
+      call_process(s->p, ev, data);
+    }
+  }
+}
 /*---------------------------------------------------------------------------*/
 static void
 exit_process(struct process *p, struct process *fromprocess)
@@ -144,11 +301,7 @@ exit_process(struct process *p, struct process *fromprocess)
      * this process is about to exit. This will allow services to
      * deallocate state associated with this process.
      */
-    for(q = process_list; q != NULL; q = q->next) {
-      if(p != q) {
-	call_process(q, PROCESS_EVENT_EXITED, (process_data_t)p);
-      }
-    }
+    call_broadcast(PROCESS_EVENT_EXITED, (process_data_t)p, p, 0);
 
     if(p->thread != NULL && p != fromprocess) {
       /* Post the exit event to the process that is about to exit. */
@@ -157,6 +310,9 @@ exit_process(struct process *p, struct process *fromprocess)
     }
   }
 
+  remove_subscriptions(p);
+  remove_poll(p);
+
   if(p == process_list) {
     process_list = process_list->next;
   } else {
@@ -184,10 +340,18 @@ call_process(struct process *p, process_event_t ev, process_data_t data)
   
   if((p->state & PROCESS_STATE_RUNNING) &&
      p->thread != NULL) {
+#if PROCESS_CONF_PROFILE
+    uint32_t outer_nested = nested_run_time;
+    rtimer_clock_t start = RTIMER_NOW();
+    nested_run_time = 0;
+#endif /* PROCESS_CONF_PROFILE */
     PRINTF("process: calling process '%s' with event %d\n", PROCESS_NAME_STRING(p), ev);
     process_current = p;
     p->state = PROCESS_STATE_CALLED;
     ret = p->thread(&p->pt, ev, data);
+#if PROCESS_CONF_PROFILE
+    profile_run(p, start, outer_nested);
+#endif /* PROCESS_CONF_PROFILE */
     if(ret == PT_EXITED ||
        ret == PT_ENDED ||
        ev == PROCESS_EVENT_EXIT) {
@@ -209,12 +373,22 @@ process_init(void)
 {
   lastevent = PROCESS_EVENT_MAX;
 
-  nevents = fevent = 0;
+  nevents = 0;
+  queue.nevents = queue.fevent = 0;
+#if PROCESS_CONF_NUMEVENTS_URGENT
+  urgent_queue.nevents = urgent_queue.fevent = 0;
+#endif /* PROCESS_CONF_NUMEVENTS_URGENT */
 #if PROCESS_CONF_STATS
   process_maxevents = 0;
+  process_maxevents_urgent = 0;
+  process_coalesced_events = 0;
+  process_dropped_events = 0;
 #endif /* PROCESS_CONF_STATS */
 
   process_current = process_list = NULL;
+  poll_queue = NULL;
+  poll_queue_locked = poll_scan = 0;
+  subscriptions = NULL;
 }
 /*---------------------------------------------------------------------------*/
 /*
@@ -222,17 +396,43 @@ process_init(void)
  */
 /*---------------------------------------------------------------------------*/
 static void
+poll_process(struct process *p)
+{
+  if(p->needspoll && process_is_running(p)) {
+    p->state = PROCESS_STATE_RUNNING;
+    p->needspoll = 0;
+    call_process(p, PROCESS_EVENT_POLL, NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
 do_poll(void)
 {
   struct process *p;
+  struct process *next;
 
   poll_requested = 0;
+
+  /* Take the queue of polled processes. Processes polled from now on
+     are queued anew. */
+  poll_queue_locked = 1;
+  next = poll_queue;
+  poll_queue = NULL;
+  poll_queue_locked = 0;
+
   /* Call the processes that needs to be polled. */
-  for(p = process_list; p != NULL; p = p->next) {
-    if(p->needspoll) {
-      p->state = PROCESS_STATE_RUNNING;
-      p->needspoll = 0;
-      call_process(p, PROCESS_EVENT_POLL, NULL);
+  while(next != NULL) {
+    p = next;
+    next = p->pollnext;
+    p->pollqueued = 0;
+    poll_process(p);
+  }
+
+  /* Some processes were polled while the queue was busy */
+  if(poll_scan) {
+    poll_scan = 0;
+    for(p = process_list; p != NULL; p = p->next) {
+      poll_process(p);
     }
   }
 }
@@ -248,7 +448,6 @@ do_event(void)
   process_event_t ev;
   process_data_t data;
   struct process *receiver;
-  struct process *p;
   
   /*
    * If there are any events in the queue, take the first one and walk
@@ -259,30 +458,35 @@ do_event(void)
    */
 
   if(nevents > 0) {
+    struct event_queue *q = &queue;
+
+#if PROCESS_CONF_NUMEVENTS_URGENT
+    if(urgent_queue.nevents > 0) {
+      q = &urgent_queue;
+    }
+#endif /* PROCESS_CONF_NUMEVENTS_URGENT */
     
     /* There are events that we should deliver. */
-    ev = events[fevent].ev;
+    ev = q->events[q->fevent].ev;
     
-    data = events[fevent].data;
-    receiver = events[fevent].p;
+    data = q->events[q->fevent].data;
+    receiver = q->events[q->fevent].p;
+#if PROCESS_CONF_PROFILE
+    event_time = q->events[q->fevent].time;
+#endif /* PROCESS_CONF_PROFILE */
 
     /* Since we have seen the new event, we move pointer upwards
        and decrease the number of events. */
-    fevent = (fevent + 1) % PROCESS_CONF_NUMEVENTS;
+    q->fevent = (q->fevent + 1) % q->size;
+    --q->nevents;
     --nevents;
 
     /* If this is a broadcast event, we deliver it to all events, in
        order of their priority. */
     if(receiver == PROCESS_BROADCAST) {
-      for(p = process_list; p != NULL; p = p->next) {
-
-	/* If we have been requested to poll a process, we do this in
-	   between processing the broadcast event. */
-	if(poll_requested) {
-	  do_poll();
-	}
-	call_process(p, ev, data);
-      }
+      /* If we have been requested to poll a process, we do this in
+	 between processing the broadcast event. */
+      call_broadcast(ev, data, NULL, 1);
     } else {
       /* This is not a broadcast event, so we deliver it to the
 	 specified process. */
@@ -292,6 +496,9 @@ do_event(void)
 	receiver->state = PROCESS_STATE_RUNNING;
       }
 
+#if PROCESS_CONF_PROFILE
+      profile_latency(receiver);
+#endif /* PROCESS_CONF_PROFILE */
       /* Make sure that the process actually is running. */
       call_process(receiver, ev, data);
     }
@@ -318,8 +525,27 @@ process_nevents(void)
   return nevents + poll_requested;
 }
 /*---------------------------------------------------------------------------*/
-int
-process_post(struct process *p, process_event_t ev, process_data_t data)
+#if PROCESS_CONF_COALESCE_EVENTS
+static int
+is_queued(struct event_queue *q, struct process *p,
+          process_event_t ev, process_data_t data)
+{
+  process_num_events_t i;
+  struct event_data *e;
+
+  for(i = 0; i < q->nevents; i++) {
+    e = &q->events[(process_num_events_t)(q->fevent + i) % q->size];
+    if(e->p == p && e->ev == ev && e->data == data) {
+      return 1;
+    }
+  }
+  return 0;
+}
+#endif /* PROCESS_CONF_COALESCE_EVENTS */
+/*---------------------------------------------------------------------------*/
+static int
+post(struct event_queue *q, struct process *p,
+     process_event_t ev, process_data_t data, int coalesce)
 {
   process_num_events_t snum;
 
@@ -331,8 +557,29 @@ process_post(struct process *p, process_event_t ev, process_data_t data)
 	   PROCESS_NAME_STRING(PROCESS_CURRENT()), ev,
 	   p == PROCESS_BROADCAST? "<broadcast>": PROCESS_NAME_STRING(p), nevents);
   }
+
+#if PROCESS_CONF_COALESCE_EVENTS
+  /* The receiver would not tell the difference between the two */
+  if(coalesce && (is_queued(&queue, p, ev, data)
+#if PROCESS_CONF_NUMEVENTS_URGENT
+     || is_queued(&urgent_queue, p, ev, data)
+#endif /* PROCESS_CONF_NUMEVENTS_URGENT */
+     )) {
+#if PROCESS_CONF_STATS
+    process_coalesced_events++;
+#endif /* PROCESS_CONF_STATS */
+    return PROCESS_ERR_OK;
+  }
+#endif /* PROCESS_CONF_COALESCE_EVENTS */
+
+#if PROCESS_CONF_NUMEVENTS_URGENT
+  if(q == &urgent_queue && q->nevents == q->size) {
+    /* Better late than never */
+    q = &queue;
+  }
+#endif /* PROCESS_CONF_NUMEVENTS_URGENT */
   
-  if(nevents == PROCESS_CONF_NUMEVENTS) {
+  if(q->nevents == q->size) {
 #if DEBUG
     if(p == PROCESS_BROADCAST) {
       printf("soft panic: event queue is full when broadcast event %d was posted from %s\n", ev, PROCESS_NAME_STRING(process_current));
@@ -340,24 +587,69 @@ process_post(struct process *p, process_event_t ev, process_data_t data)
       printf("soft panic: event queue is full when event %d was posted to %s from %s\n", ev, PROCESS_NAME_STRING(p), PROCESS_NAME_STRING(process_current));
     }
 #endif /* DEBUG */
+#if PROCESS_CONF_STATS
+    process_dropped_events++;
+#endif /* PROCESS_CONF_STATS */
     return PROCESS_ERR_FULL;
   }
   
-  snum = (process_num_events_t)(fevent + nevents) % PROCESS_CONF_NUMEVENTS;
-  events[snum].ev = ev;
-  events[snum].data = data;
-  events[snum].p = p;
+  snum = (process_num_events_t)(q->fevent + q->nevents) % q->size;
+  q->events[snum].ev = ev;
+  q->events[snum].data = data;
+  q->events[snum].p = p;
+#if PROCESS_CONF_PROFILE
+  q->events[snum].time = RTIMER_NOW();
+#endif /* PROCESS_CONF_PROFILE */
+  ++q->nevents;
   ++nevents;
 
 #if PROCESS_CONF_STATS
-  if(nevents > process_maxevents) {
-    process_maxevents = nevents;
+  if(q == &queue) {
+    if(q->nevents > process_maxevents) {
+      process_maxevents = q->nevents;
+    }
+  } else if(q->nevents > process_maxevents_urgent) {
+    process_maxevents_urgent = q->nevents;
   }
 #endif /* PROCESS_CONF_STATS */
   
   return PROCESS_ERR_OK;
 }
 /*---------------------------------------------------------------------------*/
+int
+process_post(struct process *p, process_event_t ev, process_data_t data)
+{
+  return post(&queue, p, ev, data, 0);
+}
+/*---------------------------------------------------------------------------*/
+int
+process_post_coalesce(struct process *p, process_event_t ev,
+                      process_data_t data)
+{
+  return post(&queue, p, ev, data, 1);
+}
+/*---------------------------------------------------------------------------*/
+int
+process_post_urgent(struct process *p, process_event_t ev, process_data_t data)
+{
+#if PROCESS_CONF_NUMEVENTS_URGENT
+  return post(&urgent_queue, p, ev, data, 0);
+#else /* PROCESS_CONF_NUMEVENTS_URGENT */
+  return post(&queue, p, ev, data, 0);
+#endif /* PROCESS_CONF_NUMEVENTS_URGENT */
+}
+/*---------------------------------------------------------------------------*/
+int
+process_post_urgent_coalesce(struct process *p, process_event_t ev,
+                             process_data_t data)
+{
+#if PROCESS_CONF_NUMEVENTS_URGENT
+  return post(&urgent_queue, p, ev, data, 1);
+#else /* PROCESS_CONF_NUMEVENTS_URGENT */
+  return post(&queue, p, ev, data, 1);
+#endif /* PROCESS_CONF_NUMEVENTS_URGENT */
+}
+/*---------------------------------------------------------------------------*/
 void
 process_post_synch(struct process *p, process_event_t ev, process_data_t data)
 {
@@ -373,12 +665,49 @@ process_poll(struct process *p)
   if(p != NULL) {
     if(p->state == PROCESS_STATE_RUNNING ||
        p->state == PROCESS_STATE_CALLED) {
-      p->needspoll = 1;
+      if(poll_queue_locked) {
+	/* We interrupted an update of the queue */
+	p->needspoll = 1;
+	poll_scan = 1;
+      } else {
+	poll_queue_locked = 1;
+	if(!p->pollqueued) {
+	  p->pollqueued = 1;
+	  p->pollnext = poll_queue;
+	  poll_queue = p;
+	}
+	p->needspoll = 1;
+	poll_queue_locked = 0;
+      }
       poll_requested = 1;
     }
   }
 }
 /*---------------------------------------------------------------------------*/
+void
+process_subscribe(struct process_subscription *s, process_event_t ev)
+{
+  s->p = PROCESS_CURRENT();
+  s->ev = ev;
+  s->next = subscriptions;
+  subscriptions = s;
+  s->p->subscriptions++;
+}
+/*---------------------------------------------------------------------------*/
+void
+process_unsubscribe(struct process_subscription *s)
+{
+  struct process_subscription **q;
+
+  for(q = &subscriptions; *q != NULL; q = &(*q)->next) {
+    if(*q == s) {
+      *q = s->next;
+      s->p->subscriptions--;
+      return;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
 int
 process_is_running(struct process *p)
 {
@@ -88,6 +88,26 @@ typedef unsigned char process_num_events_t;
 #define PROCESS_CONF_NUMEVENTS 32
 #endif /* PROCESS_CONF_NUMEVENTS */
 
+/* Size of the queue of events posted with process_post_urgent(). With 0,
+ * urgent events go to the ordinary queue */
+#ifndef PROCESS_CONF_NUMEVENTS_URGENT
+#define PROCESS_CONF_NUMEVENTS_URGENT 4
+#endif /* PROCESS_CONF_NUMEVENTS_URGENT */
+
+/* Keep CPU usage and event latency statistics for each process, see
+ * struct process_profile */
+#ifndef PROCESS_CONF_PROFILE
+#define PROCESS_CONF_PROFILE 0
+#endif /* PROCESS_CONF_PROFILE */
+
+/* Let process_post_coalesce() and process_post_urgent_coalesce() drop
+ * an event if an identical one (same receiver, event and data) is
+ * already waiting to be delivered. With 0 they work like the ordinary
+ * posts */
+#ifndef PROCESS_CONF_COALESCE_EVENTS
+#define PROCESS_CONF_COALESCE_EVENTS 1
+#endif /* PROCESS_CONF_COALESCE_EVENTS */
+
 #define PROCESS_EVENT_NONE            0x80
 #define PROCESS_EVENT_INIT            0x81
 #define PROCESS_EVENT_POLL            0x82
@@ -312,6 +332,27 @@ static PT_THREAD(process_thread_##name(struct pt *process_pt,	\
 
 /** @} */
 
+#if PROCESS_CONF_PROFILE
+/**
+ * Profile of a process, with times in rtimer ticks. The run time of a
+ * process excludes the time spent in the processes it calls
+ * synchronously, but includes the callbacks it runs on behalf of other
+ * processes, e.g. the ctimer process runs all ctimer callbacks.
+ */
+struct process_profile {
+  /* Number of times the process was called */
+  uint32_t calls;
+  /* Total and longest run time */
+  uint32_t run_time;
+  uint32_t max_run_time;
+  /* Number of events delivered from the event queue, and total and
+   * longest time they waited in the queue */
+  uint32_t events;
+  uint32_t latency;
+  uint32_t max_latency;
+};
+#endif /* PROCESS_CONF_PROFILE */
+
 struct process {
   struct process *next;
 #if PROCESS_CONF_NO_PROCESS_NAMES
@@ -323,6 +364,24 @@ struct process {
   PT_THREAD((* thread)(struct pt *, process_event_t, process_data_t));
   struct pt pt;
   unsigned char state, needspoll;
+  /* Poll queue linkage, see process_poll() */
+  struct process *pollnext;
+  unsigned char pollqueued;
+  /* Number of broadcast subscriptions, see process_subscribe() */
+  unsigned char subscriptions;
+#if PROCESS_CONF_PROFILE
+  struct process_profile profile;
+#endif /* PROCESS_CONF_PROFILE */
+};
+
+/**
+ * A subscription of a process to a broadcast event, see
+ * process_subscribe().
+ */
+struct process_subscription {
+  struct process_subscription *next;
+  struct process *p;
+  process_event_t ev;
 };
 
 /**
@@ -364,6 +423,39 @@ CCIF void process_start(struct process *p, process_data_t data);
  */
 CCIF int process_post(struct process *p, process_event_t ev, process_data_t data);
 
+/**
+ * Post an asynchronous event that may be merged with a queued one.
+ *
+ * This function works like process_post(), but if an identical event
+ * (same process, event and data) is already waiting in one of the
+ * queues, the new one is merged into it. Only use it for events where
+ * the receiver cannot tell one delivery from two, such as requests to
+ * poll something.
+ *
+ * \sa process_post()
+ */
+CCIF int process_post_coalesce(struct process *p, process_event_t ev, process_data_t data);
+
+/**
+ * Post an urgent asynchronous event.
+ *
+ * This function works like process_post(), but the event goes to a
+ * separate queue that is emptied before the ordinary one. This is meant
+ * for latency-critical events, such as those of the networking stack,
+ * that should not wait behind application events. When the urgent
+ * queue is full, the event is posted to the ordinary queue.
+ *
+ * \sa process_post()
+ */
+CCIF int process_post_urgent(struct process *p, process_event_t ev, process_data_t data);
+
+/**
+ * Post an urgent asynchronous event that may be merged with a queued one.
+ *
+ * \sa process_post_urgent(), process_post_coalesce()
+ */
+CCIF int process_post_urgent_coalesce(struct process *p, process_event_t ev, process_data_t data);
+
 /**
  * Post a synchronous event to a process.
  *
@@ -452,6 +544,36 @@ process_current = p
  */
 CCIF process_event_t process_alloc_event(void);
 
+/**
+ * \brief      Subscribe the current process to a broadcast event.
+ * \param s    A pointer to the subscription structure, which must remain
+ *             allocated until the subscription is cancelled
+ * \param ev   The broadcast event
+ *
+ *             By default, a process receives all broadcast events. Once
+ *             it has subscribed to one, it only receives the broadcast
+ *             events it has subscribed to, and the processes it is
+ *             not interested in are not called at all. Subscribing to
+ *             PROCESS_EVENT_NONE, which is never posted, makes the
+ *             process ignore all broadcast events. Services keeping
+ *             state about other processes should subscribe to
+ *             PROCESS_EVENT_EXITED.
+ *
+ *             The subscriptions of a process are cancelled when it
+ *             exits.
+ */
+CCIF void process_subscribe(struct process_subscription *s,
+                            process_event_t ev);
+
+/**
+ * \brief      Cancel a subscription to a broadcast event.
+ * \param s    A pointer to the subscription structure
+ *
+ *             The process receives all broadcast events again after
+ *             its last subscription has been cancelled.
+ */
+CCIF void process_unsubscribe(struct process_subscription *s);
+
 /** @} */
 
 /**
@@ -463,7 +585,8 @@ CCIF process_event_t process_alloc_event(void);
  * Request a process to be polled.
  *
  * This function typically is called from an interrupt handler to
- * cause a process to be polled.
+ * cause a process to be polled. Polled processes are queued, so
+ * that only they are visited when the poll handlers are called.
  *
  * \param p A pointer to the process' process structure.
  */
@@ -54,8 +54,45 @@
 #define PRINTF(...)
 #endif
 
-static struct rtimer *next_rtimer;
+/*
+ * The scheduled tasks, sorted by time. The hardware timer is set for
+ * the first one. An rtimer interrupt that finds the queue being changed
+ * leaves it alone, and the task is run shortly after instead.
+ */
+static struct rtimer *queue;
+static volatile unsigned char queue_locked;
+static volatile unsigned char run_deferred;
+/* Delay of a deferred run, at least two ticks to be in the future */
+#define RETRY_TIME (RTIMER_GUARD_TIME > 2 ? RTIMER_GUARD_TIME : 2)
+/* Set while the due tasks are run */
+static unsigned char running;
+
+/*---------------------------------------------------------------------------*/
+static void
+dequeue(struct rtimer *rtimer)
+{
+  struct rtimer **p;
 
+  for(p = &queue; *p != NULL; p = &(*p)->next) {
+    if(*p == rtimer) {
+      *p = rtimer->next;
+      return;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Let go of the queue and set the hardware timer if the first task changed */
+static void
+unlock_queue(int first_changed)
+{
+  queue_locked = 0;
+  if(run_deferred) {
+    run_deferred = 0;
+    rtimer_arch_schedule(RTIMER_NOW() + RETRY_TIME);
+  } else if(first_changed && !running && queue != NULL) {
+    rtimer_arch_schedule(queue->time);
+  }
+}
 /*---------------------------------------------------------------------------*/
 void
 rtimer_init(void)
@@ -68,23 +105,47 @@ rtimer_set(struct rtimer *rtimer, rtimer_clock_t time,
 	   rtimer_clock_t duration,
 	   rtimer_callback_t func, void *ptr)
 {
-  int first = 0;
+  struct rtimer *first;
+  struct rtimer **p;
 
   PRINTF("rtimer_set time %d\n", time);
 
-  if(next_rtimer == NULL) {
-    first = 1;
+  if(queue_locked) {
+    /* An interrupt of another rtimer_set() or rtimer_cancel() */
+    return RTIMER_ERR_FULL;
   }
+  queue_locked = 1;
+  first = queue;
+
+  /* Setting a scheduled task again moves it */
+  dequeue(rtimer);
 
   rtimer->func = func;
   rtimer->ptr = ptr;
-
   rtimer->time = time;
-  next_rtimer = rtimer;
 
-  if(first == 1) {
-    rtimer_arch_schedule(time);
+  /* After the tasks due at the same time, to keep the order they were set */
+  for(p = &queue; *p != NULL && !RTIMER_CLOCK_LT(time, (*p)->time);
+      p = &(*p)->next);
+  rtimer->next = *p;
+  *p = rtimer;
+
+  unlock_queue(queue != first);
+  return RTIMER_OK;
+}
+/*---------------------------------------------------------------------------*/
+int
+rtimer_cancel(struct rtimer *rtimer)
+{
+  struct rtimer *first;
+
+  if(queue_locked) {
+    return RTIMER_ERR_FULL;
   }
+  queue_locked = 1;
+  first = queue;
+  dequeue(rtimer);
+  unlock_queue(queue != first);
   return RTIMER_OK;
 }
 /*---------------------------------------------------------------------------*/
@@ -92,16 +153,36 @@ void
 rtimer_run_next(void)
 {
   struct rtimer *t;
-  if(next_rtimer == NULL) {
+
+  if(queue_locked) {
+    run_deferred = 1;
     return;
   }
-  t = next_rtimer;
-  next_rtimer = NULL;
-  t->func(t, t->ptr);
-  if(next_rtimer != NULL) {
-    rtimer_arch_schedule(next_rtimer->time);
+
+  /* Run the tasks due by now, as those that were late or are due within
+     the guard time could not be scheduled on their own */
+  running = 1;
+  while((t = queue) != NULL
+        && RTIMER_CLOCK_DIFF(t->time, RTIMER_NOW()) <= RTIMER_GUARD_TIME) {
+    queue = t->next;
+    t->func(t, t->ptr);
+  }
+  running = 0;
+
+  if(queue != NULL) {
+    rtimer_arch_schedule(queue->time);
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+rtimer_next_scheduled(rtimer_clock_t *time)
+{
+  struct rtimer *t = queue;
+  if(t == NULL) {
+    return 0;
   }
-  return;
+  *time = t->time;
+  return 1;
 }
 /*---------------------------------------------------------------------------*/
 
@@ -87,6 +87,7 @@ struct rtimer {
   rtimer_clock_t time;
   rtimer_callback_t func;
   void *ptr;
+  struct rtimer *next;
 };
 
 enum {
@@ -103,25 +104,48 @@ enum {
  * \param duration Unused argument.
  * \param func A function to be called when the task is executed.
  * \param ptr An opaque pointer that will be supplied as an argument to the callback function.
- * \return     Non-zero (true) if the task could be scheduled, zero
- *             (false) if the task could not be scheduled.
+ * \return     RTIMER_OK if the task could be scheduled, or
+ *             RTIMER_ERR_FULL if it was set from an interrupt while
+ *             another task was being set.
  *
  *             This function schedules a real-time task at a specified
- *             time in the future.
+ *             time in the future. Several tasks can be scheduled at
+ *             the same time, and are run in the order of their times.
+ *             Setting a task that is already scheduled reschedules it.
+ *             Tasks may be set from process context and from real-time
+ *             tasks, but not from other interrupts.
  *
  */
 int rtimer_set(struct rtimer *task, rtimer_clock_t time,
 	       rtimer_clock_t duration, rtimer_callback_t func, void *ptr);
 
+/**
+ * \brief      Remove a real-time task from the schedule
+ * \param task The task
+ * \return     RTIMER_OK, or RTIMER_ERR_FULL if it was called from an
+ *             interrupt while another task was being set.
+ */
+int rtimer_cancel(struct rtimer *task);
+
 /**
  * \brief      Execute the next real-time task and schedule the next task, if any
  *
  *             This function is called by the architecture dependent
  *             code to execute and schedule the next real-time task.
+ *             All tasks due within RTIMER_GUARD_TIME are executed.
  *
  */
 void rtimer_run_next(void);
 
+/**
+ * \brief      Get the time of the task scheduled to run next, if any
+ * \param time Set to the time of the scheduled task
+ * \return     Non-zero if a task is scheduled
+ *
+ *             Used by the platforms to find out how long they can sleep.
+ */
+int rtimer_next_scheduled(rtimer_clock_t *time);
+
 /**
  * \brief      Get the current clock time
  * \return     The current time
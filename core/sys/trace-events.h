@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \file
+ *         The events of the binary trace (see trace.h). The list is
+ *         shared with the host decoder in tools/trace-decode, so the
+ *         file must not depend on anything else. Event IDs are part
+ *         of the trace format: add new events, do not renumber them.
+ *
+ *         E(name, id, first argument, second argument)
+ */
+
+#ifndef TRACE_EVENTS_H_
+#define TRACE_EVENTS_H_
+
+#define TRACE_EVENTS(E)                                                 \
+  /* The trace itself */                                                \
+  E(START,             0x0001, "rtimer second low", "high")            \
+  E(DROPPED,           0x0002, "process", "interrupt")                \
+  E(CLOCK_BITS,        0x0003, "timestamp bits", "")                   \
+  /* 6LoWPAN */                                                         \
+  E(SICSLOWPAN_OUTPUT, 0x0101, "IP len", "dest node")                  \
+  E(SICSLOWPAN_FRAG,   0x0102, "IP len", "fragments")                  \
+  E(SICSLOWPAN_SENT,   0x0103, "MAC status", "transmissions")          \
+  E(SICSLOWPAN_INPUT,  0x0104, "frame len", "src node")                \
+  /* CSMA */                                                            \
+  E(CSMA_QUEUE,        0x0201, "queued", "dest node")                  \
+  E(CSMA_TX,           0x0202, "transmission", "dest node")            \
+  E(CSMA_DONE,         0x0203, "MAC status", "transmissions")          \
+  E(CSMA_DROP,         0x0204, "free packets", "dest node")            \
+  /* TSCH slot operation, from the rtimer interrupt */                  \
+  E(TSCH_TX,           0x0301, "MAC status", "dest node")              \
+  E(TSCH_RX,           0x0302, "frame len", "src node")                \
+  /* uIPv6 */                                                           \
+  E(UIP6_INPUT,        0x0401, "IP len", "next header")                \
+  E(UIP6_FORWARD,      0x0402, "IP len", "hop limit")                  \
+  E(UIP6_OUTPUT,       0x0403, "IP len", "next header")                \
+  E(UIP6_DROP,         0x0404, "IP len", "next header")                \
+  /* RPL */                                                             \
+  E(RPL_DIO_IN,        0x0501, "rank", "src node")                     \
+  E(RPL_DIO_OUT,       0x0502, "rank", "unicast")                      \
+  E(RPL_DAO_IN,        0x0503, "sequence", "src node")                 \
+  E(RPL_DAO_OUT,       0x0504, "sequence", "lifetime")                 \
+  E(RPL_PARENT,        0x0505, "rank", "parent node")                  \
+  /* CoAP engine */                                                     \
+  E(COAP_RECEIVE,      0x0601, "code", "MID")                          \
+  E(COAP_SEND,         0x0602, "len", "port")                          \
+  E(COAP_RETRANSMIT,   0x0603, "MID", "retransmission")
+
+#endif /* TRACE_EVENTS_H_ */
@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \file
+ *         Binary trace of hot paths
+ */
+
+#include "contiki.h"
+#include "sys/trace.h"
+#include "lib/ringbufindex.h"
+#include <stdio.h>
+
+#if TRACE_ENABLED
+
+#if (TRACE_RING_LEN & (TRACE_RING_LEN - 1)) != 0 || TRACE_RING_LEN > 128
+#error TRACE_RING_LEN must be a power of two, at most 128
+#endif
+
+/* The frames of the output: SLIP encoded, starting with a marker byte so
+   that they stand out from other console output */
+#define SLIP_END     0300
+#define SLIP_ESC     0333
+#define SLIP_ESC_END 0334
+#define SLIP_ESC_ESC 0335
+#define FRAME_RECORD 'T'
+
+struct trace_record {
+  rtimer_clock_t time;
+  uint16_t event;
+  uint16_t arg[2];
+};
+
+struct trace_ring {
+  struct ringbufindex index;
+  uint16_t dropped;
+  struct trace_record records[TRACE_RING_LEN];
+};
+
+/* Process context, and interrupt context */
+static struct trace_ring rings[2];
+
+PROCESS(trace_process, "Trace");
+/*---------------------------------------------------------------------------*/
+void
+trace_add(uint8_t isr, uint16_t event, uint16_t arg0, uint16_t arg1)
+{
+  struct trace_ring *ring = &rings[isr];
+  struct trace_record *r;
+  int i;
+
+  i = ringbufindex_peek_put(&ring->index);
+  if(i < 0) {
+    ring->dropped++;
+    return;
+  }
+  r = &ring->records[i];
+  r->time = RTIMER_NOW();
+  r->event = event;
+  r->arg[0] = arg0;
+  r->arg[1] = arg1;
+  ringbufindex_put(&ring->index);
+  process_poll(&trace_process);
+}
+/*---------------------------------------------------------------------------*/
+static void
+write_byte(uint8_t c)
+{
+  if(c == SLIP_END) {
+    TRACE_WRITE_BYTE(SLIP_ESC);
+    c = SLIP_ESC_END;
+  } else if(c == SLIP_ESC) {
+    TRACE_WRITE_BYTE(SLIP_ESC);
+    c = SLIP_ESC_ESC;
+  }
+  TRACE_WRITE_BYTE(c);
+}
+/*---------------------------------------------------------------------------*/
+static void
+write_u16(uint16_t v)
+{
+  write_byte(v & 0xff);
+  write_byte(v >> 8);
+}
+/*---------------------------------------------------------------------------*/
+/* Little-endian: time (4 bytes), event, first and second argument */
+static void
+write_record(uint32_t time, uint16_t event, uint16_t arg0, uint16_t arg1)
+{
+  TRACE_WRITE_BYTE(SLIP_END);
+  TRACE_WRITE_BYTE(FRAME_RECORD);
+  write_u16(time & 0xffff);
+  write_u16(time >> 16);
+  write_u16(event);
+  write_u16(arg0);
+  write_u16(arg1);
+  TRACE_WRITE_BYTE(SLIP_END);
+}
+/*---------------------------------------------------------------------------*/
+static void
+drain(void)
+{
+  static uint16_t reported[2];
+  struct trace_record *r, *p, *q;
+  uint16_t dropped[2];
+  int i, j;
+
+  /* The drop counts are only written by the writers of the rings */
+  for(i = 0; i < 2; i++) {
+    dropped[i] = rings[i].dropped - reported[i];
+    reported[i] += dropped[i];
+  }
+  if(dropped[0] || dropped[1]) {
+    write_record(RTIMER_NOW(), TRACE_DROPPED, dropped[0], dropped[1]);
+  }
+
+  /* Merge the rings in time order */
+  for(;;) {
+    i = ringbufindex_peek_get(&rings[0].index);
+    j = ringbufindex_peek_get(&rings[1].index);
+    p = i >= 0 ? &rings[0].records[i] : NULL;
+    q = j >= 0 ? &rings[1].records[j] : NULL;
+    if(p != NULL && (q == NULL || !RTIMER_CLOCK_LT(q->time, p->time))) {
+      r = p;
+    } else if(q != NULL) {
+      r = q;
+    } else {
+      break;
+    }
+    write_record(r->time, r->event, r->arg[0], r->arg[1]);
+    ringbufindex_get(r == p ? &rings[0].index : &rings[1].index);
+  }
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(trace_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  TRACE(START, (uint32_t)RTIMER_SECOND & 0xffff, (uint32_t)RTIMER_SECOND >> 16);
+  TRACE(CLOCK_BITS, sizeof(rtimer_clock_t) * 8, 0);
+
+  while(1) {
+    PROCESS_YIELD_UNTIL(ev == PROCESS_EVENT_POLL);
+    drain();
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+void
+trace_init(void)
+{
+  ringbufindex_init(&rings[0].index, TRACE_RING_LEN);
+  ringbufindex_init(&rings[1].index, TRACE_RING_LEN);
+  process_start(&trace_process, NULL);
+}
+/*---------------------------------------------------------------------------*/
+#endif /* TRACE_ENABLED */
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \file
+ *         Binary trace of hot paths. A trace point stores a compact,
+ *         fixed-size record (rtimer timestamp, event and two 16-bit
+ *         arguments) in a ring buffer, which costs a few instructions
+ *         instead of the milliseconds of a printf. The records are
+ *         written out later, from the trace process, as SLIP frames
+ *         that tools/trace-decode turns back into text.
+ *
+ *         There is one ring for process context and one for interrupt
+ *         context. Each ring has a single writer, so no locking is
+ *         needed (see lib/ringbufindex.h). Trace points in interrupt
+ *         handlers, such as the TSCH slot operation, use TRACE_ISR().
+ *         They must not be in handlers that preempt each other.
+ */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include "contiki.h"
+#include "net/linkaddr.h"
+#include "sys/trace-events.h"
+
+#ifdef TRACE_CONF_ENABLED
+#define TRACE_ENABLED TRACE_CONF_ENABLED
+#else /* TRACE_CONF_ENABLED */
+#define TRACE_ENABLED 0
+#endif /* TRACE_CONF_ENABLED */
+
+/* Records of each ring. Must be a power of two, at most 128 */
+#ifdef TRACE_CONF_RING_LEN
+#define TRACE_RING_LEN TRACE_CONF_RING_LEN
+#else /* TRACE_CONF_RING_LEN */
+#define TRACE_RING_LEN 32
+#endif /* TRACE_CONF_RING_LEN */
+
+/* Writes a byte of the trace output, by default to the console */
+#ifdef TRACE_CONF_WRITE_BYTE
+#define TRACE_WRITE_BYTE(c) TRACE_CONF_WRITE_BYTE(c)
+#else /* TRACE_CONF_WRITE_BYTE */
+#define TRACE_WRITE_BYTE(c) putchar(c)
+#endif /* TRACE_CONF_WRITE_BYTE */
+
+#define TRACE_EVENT_ENUM(name, id, arg0, arg1) TRACE_##name = id,
+enum {
+  TRACE_EVENTS(TRACE_EVENT_ENUM)
+};
+
+/* The node of a link-layer or IPv6 address, as a trace argument */
+#define TRACE_NODE(lladdr) \
+  ((uint16_t)((lladdr)->u8[LINKADDR_SIZE - 2] << 8 | (lladdr)->u8[LINKADDR_SIZE - 1]))
+#define TRACE_NODE_IP(ipaddr) \
+  ((uint16_t)((ipaddr)->u8[14] << 8 | (ipaddr)->u8[15]))
+
+#if TRACE_ENABLED
+#define TRACE(event, arg0, arg1) \
+  trace_add(0, TRACE_##event, (arg0), (arg1))
+#define TRACE_ISR(event, arg0, arg1) \
+  trace_add(1, TRACE_##event, (arg0), (arg1))
+#else /* TRACE_ENABLED */
+#define TRACE(event, arg0, arg1)
+#define TRACE_ISR(event, arg0, arg1)
+#endif /* TRACE_ENABLED */
+
+/**
+ * \brief Start the trace, to be called once at startup
+ */
+void trace_init(void);
+
+/**
+ * \brief Add a record to the trace, through the TRACE() macros
+ * \param isr 1 from interrupt context, 0 from process context
+ */
+void trace_add(uint8_t isr, uint16_t event, uint16_t arg0, uint16_t arg1);
+
+#endif /* TRACE_H_ */
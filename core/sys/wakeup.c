@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \file
+ *         Next wake-up time of the system, merging pending events,
+ *         event timers and real-time tasks
+ */
+
+#include "sys/wakeup.h"
+#include "sys/etimer.h"
+
+/* Farthest wake-up time we can express, as rtimer times are only
+ * compared over half their range */
+#define WAKEUP_MAX_TICKS ((rtimer_clock_t)((rtimer_clock_t)~(rtimer_clock_t)0 >> 1))
+
+/*---------------------------------------------------------------------------*/
+int
+wakeup_next(rtimer_clock_t *time)
+{
+  rtimer_clock_t now;
+  rtimer_clock_t next_rtimer;
+  int ret = WAKEUP_NONE;
+
+  if(process_nevents() > 0) {
+    return WAKEUP_NOW;
+  }
+
+  now = RTIMER_NOW();
+  *time = now + WAKEUP_MAX_TICKS;
+
+  if(etimer_pending()) {
+    clock_time_t until_next_etimer = etimer_next_expiration_time() - clock_time();
+    if(until_next_etimer == 0 || until_next_etimer > (clock_time_t)~(clock_time_t)0 / 2) {
+      /* Expired but not processed yet, as a skipped clock tick may not
+       * have polled the etimer process */
+      etimer_request_poll();
+      return WAKEUP_NOW;
+    }
+    if(until_next_etimer <= WAKEUP_MAX_TICKS / (RTIMER_SECOND / CLOCK_SECOND)) {
+      *time = now + (rtimer_clock_t)until_next_etimer * (RTIMER_SECOND / CLOCK_SECOND);
+    }
+    ret = WAKEUP_AT;
+  }
+
+  if(rtimer_next_scheduled(&next_rtimer)) {
+    if(ret == WAKEUP_NONE || RTIMER_CLOCK_LT(next_rtimer, *time)) {
+      *time = next_rtimer;
+    }
+    ret = WAKEUP_AT;
+  }
+
+  return ret;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \file
+ *         Header file for the next wake-up time of the system
+ */
+
+/**
+ * \addtogroup sys
+ * @{
+ */
+
+/**
+ * \defgroup wakeup Next wake-up time
+ * @{
+ *
+ * The wake-up module gives the platforms a single view of when the
+ * system needs the CPU next: pending events and polls, event timers
+ * (and thereby callback timers, which run on event timers) and the
+ * scheduled real-time task. Platforms use it when going to sleep, to
+ * choose a low-power mode and to program their wake-up timer for
+ * exactly that time rather than waking up on every clock tick.
+ *
+ */
+
+#ifndef WAKEUP_H_
+#define WAKEUP_H_
+
+#include "contiki.h"
+#include "sys/rtimer.h"
+
+/** The system needs the CPU right away */
+#define WAKEUP_NOW   0
+/** The system needs the CPU at a given time */
+#define WAKEUP_AT    1
+/** Nothing is scheduled, only an interrupt can give the system work */
+#define WAKEUP_NONE  2
+
+/**
+ * \brief      Get the next time the system needs the CPU
+ * \param time Set to the wake-up time, in rtimer ticks. With
+ *             WAKEUP_NONE, set to the farthest time that can be expressed
+ * \return     WAKEUP_NOW, WAKEUP_AT or WAKEUP_NONE
+ *
+ *             Wake-up times are at most half the rtimer range away,
+ *             longer sleeps being bounded to that. The system then
+ *             merely wakes up and finds out it can sleep again. This
+ *             function is meant to be called with interrupts disabled,
+ *             right before going to sleep.
+ */
+int wakeup_next(rtimer_clock_t *time);
+
+/**
+ * \brief      Let the clock skip its periodic interrupts
+ * \param time The time, in rtimer ticks, until which the system does
+ *             not need clock interrupts
+ *
+ *             Implemented by the clock drivers that can do it, called
+ *             by the platform right before going to sleep with the time
+ *             wakeup_next() returned. The clock must still count time
+ *             correctly, and resumes periodic interrupts when it wakes
+ *             up.
+ */
+void clock_arch_set_wakeup(rtimer_clock_t time);
+
+#endif /* WAKEUP_H_ */
+
+/** @} */
+/** @} */
@@ -83,6 +83,13 @@ cfs_read (int fd, void *buf, unsigned int len)
   return file_read(file, len, (euint8*)buf);
 }
 
+const void *
+cfs_map (int fd, unsigned int *len)
+{
+  /* The data cannot be accessed in place. */
+  return NULL;
+}
+
 int
 cfs_write (int fd, const void *buf, unsigned int len)
 {
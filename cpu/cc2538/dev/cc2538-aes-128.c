@@ -44,6 +44,7 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 /*---------------------------------------------------------------------------*/
 #define MODULE_NAME     "cc2538-aes-128"
 
@@ -54,6 +55,13 @@
 #define PRINTF(...)
 #endif
 /*---------------------------------------------------------------------------*/
+/* The key last loaded into CC2538_AES_128_KEY_AREA. Loading the same key
+ * again is skipped as long as the key store still holds it, i.e. unless
+ * it was lost in PM2 or cleared by a load of keys of another size. Keys
+ * written into the area without going through this driver go unnoticed */
+static uint8_t loaded_key[AES_128_KEY_LENGTH];
+static uint8_t key_loaded;
+/*---------------------------------------------------------------------------*/
 static uint8_t
 enable_crypto(void)
 {
@@ -79,12 +87,25 @@ set_key(const uint8_t *key)
 
   crypto_enabled = enable_crypto();
 
+  if(key_loaded
+     && (REG(AES_KEY_STORE_WRITTEN_AREA)
+         & (0x00000001 << CC2538_AES_128_KEY_AREA))
+     && (REG(AES_KEY_STORE_SIZE) & AES_KEY_STORE_SIZE_KEY_SIZE_M)
+        == AES_KEY_STORE_SIZE_KEY_SIZE_128
+     && memcmp(loaded_key, key, AES_128_KEY_LENGTH) == 0) {
+    restore_crypto(crypto_enabled);
+    return;
+  }
+
+  key_loaded = 0;
   ret = aes_load_keys(key, AES_KEY_STORE_SIZE_KEY_SIZE_128, 1,
                       CC2538_AES_128_KEY_AREA);
   if(ret != CRYPTO_SUCCESS) {
     PRINTF("%s: aes_load_keys() error %u\n", MODULE_NAME, ret);
     sys_ctrl_reset();
   }
+  memcpy(loaded_key, key, AES_128_KEY_LENGTH);
+  key_loaded = 1;
 
   restore_crypto(crypto_enabled);
 }
@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+/**
+ * \addtogroup cc2538-crypto-service
+ * @{
+ *
+ * \file
+ *         Implementation of the crypto service driver for the CC2538 SoC
+ *
+ *         The PKA engine signals the end of each of its operations by
+ *         polling the crypto service process. Hashing blocks while the hash
+ *         engine processes a chunk, and the crypto engine is released
+ *         between chunks so that the AES driver can use it too.
+ */
+#include "contiki.h"
+#include "dev/cc2538-crypto-service.h"
+#include "dev/crypto.h"
+#include "dev/sha256.h"
+#include "dev/pka.h"
+#include "dev/ecc-algorithm.h"
+#include "dev/ecc-curve.h"
+#include "dev/sys-ctrl.h"
+
+#include <string.h>
+/*---------------------------------------------------------------------------*/
+#define WORDS (P_256_LEN / 4)
+
+static sha256_state_t sha256;
+static uint32_t offset;
+static union {
+  ecc_dsa_verify_state_t verify;
+  ecc_multiply_state_t multiply;
+} ecc;
+/*---------------------------------------------------------------------------*/
+/* From big-endian bytes to PKA words, least significant first */
+static void
+load(uint32_t *words, const uint8_t *bytes)
+{
+  int i;
+
+  for(i = 0; i < WORDS; i++) {
+    words[i] = (uint32_t)bytes[(WORDS - 1 - i) * 4] << 24 |
+      (uint32_t)bytes[(WORDS - 1 - i) * 4 + 1] << 16 |
+      (uint32_t)bytes[(WORDS - 1 - i) * 4 + 2] << 8 |
+      bytes[(WORDS - 1 - i) * 4 + 3];
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+store(uint8_t *bytes, const uint32_t *words)
+{
+  int i;
+
+  for(i = 0; i < WORDS; i++) {
+    bytes[(WORDS - 1 - i) * 4] = words[i] >> 24;
+    bytes[(WORDS - 1 - i) * 4 + 1] = words[i] >> 16;
+    bytes[(WORDS - 1 - i) * 4 + 2] = words[i] >> 8;
+    bytes[(WORDS - 1 - i) * 4 + 3] = words[i];
+  }
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t
+sha256_chunk(struct crypto_service_request *req)
+{
+  uint8_t enabled, ret;
+  uint32_t len;
+
+  enabled = CRYPTO_IS_ENABLED();
+  if(!enabled) {
+    crypto_enable();
+  }
+  if(offset == 0) {
+    sha256_init(&sha256);
+  }
+  len = MIN(req->u.sha256.len - offset, CRYPTO_SERVICE_SHA256_CHUNK);
+  ret = sha256_process(&sha256, req->u.sha256.data + offset, len);
+  offset += len;
+  if(ret == CRYPTO_SUCCESS && offset == req->u.sha256.len) {
+    ret = sha256_done(&sha256, req->u.sha256.hash);
+  }
+  if(!enabled) {
+    crypto_disable();
+  }
+  return ret;
+}
+/*---------------------------------------------------------------------------*/
+static void
+init(void)
+{
+  pka_init();
+}
+/*---------------------------------------------------------------------------*/
+static
+PT_THREAD(run(struct pt *pt, struct crypto_service_request *req))
+{
+  PT_BEGIN(pt);
+
+  if(req->type == CRYPTO_SERVICE_SHA256) {
+    offset = 0;
+    do {
+      if(sha256_chunk(req) != CRYPTO_SUCCESS) {
+        req->status = CRYPTO_SERVICE_ERROR;
+        PT_EXIT(pt);
+      }
+      if(offset < req->u.sha256.len) {
+        CRYPTO_SERVICE_YIELD(pt);
+      }
+    } while(offset < req->u.sha256.len);
+    req->status = CRYPTO_SERVICE_OK;
+
+  } else if(req->type == CRYPTO_SERVICE_ECDSA_VERIFY) {
+    /* The PKA does not check its inputs */
+    if(!p_256_check_public_key(req->u.ecdsa_verify.public_key)) {
+      req->status = CRYPTO_SERVICE_INVALID_KEY;
+      PT_EXIT(pt);
+    }
+    if(!p_256_check_signature(req->u.ecdsa_verify.signature)) {
+      req->status = CRYPTO_SERVICE_INVALID_SIGNATURE;
+      PT_EXIT(pt);
+    }
+    memset(&ecc.verify, 0, sizeof(ecc.verify));
+    ecc.verify.process = &crypto_service_process;
+    ecc.verify.curve_info = &nist_p_256;
+    load(ecc.verify.public.x, req->u.ecdsa_verify.public_key);
+    load(ecc.verify.public.y, req->u.ecdsa_verify.public_key + P_256_LEN);
+    load(ecc.verify.signature_r, req->u.ecdsa_verify.signature);
+    load(ecc.verify.signature_s, req->u.ecdsa_verify.signature + P_256_LEN);
+    load(ecc.verify.hash, req->u.ecdsa_verify.hash);
+    PT_SPAWN(pt, &ecc.verify.pt, ecc_dsa_verify(&ecc.verify));
+    if(ecc.verify.result == PKA_STATUS_SUCCESS) {
+      req->status = CRYPTO_SERVICE_OK;
+    } else if(ecc.verify.result == PKA_STATUS_SIGNATURE_INVALID) {
+      req->status = CRYPTO_SERVICE_INVALID_SIGNATURE;
+    } else {
+      req->status = CRYPTO_SERVICE_ERROR;
+    }
+
+  } else if(req->type == CRYPTO_SERVICE_ECDH) {
+    if(!p_256_check_public_key(req->u.ecdh.public_key) ||
+       !p_256_check_private_key(req->u.ecdh.secret)) {
+      req->status = CRYPTO_SERVICE_INVALID_KEY;
+      PT_EXIT(pt);
+    }
+    memset(&ecc.multiply, 0, sizeof(ecc.multiply));
+    ecc.multiply.process = &crypto_service_process;
+    ecc.multiply.curve_info = &nist_p_256;
+    load(ecc.multiply.point_in.x, req->u.ecdh.public_key);
+    load(ecc.multiply.point_in.y, req->u.ecdh.public_key + P_256_LEN);
+    load(ecc.multiply.secret, req->u.ecdh.secret);
+    PT_SPAWN(pt, &ecc.multiply.pt, ecc_multiply(&ecc.multiply));
+    if(ecc.multiply.result == PKA_STATUS_SUCCESS) {
+      store(req->u.ecdh.shared_secret, ecc.multiply.point_out.x);
+      req->status = CRYPTO_SERVICE_OK;
+    } else {
+      req->status = CRYPTO_SERVICE_ERROR;
+    }
+    memset(ecc.multiply.secret, 0, sizeof(ecc.multiply.secret));
+
+  } else {
+    req->status = CRYPTO_SERVICE_NOT_SUPPORTED;
+  }
+
+  PT_END(pt);
+}
+/*---------------------------------------------------------------------------*/
+const struct crypto_service_driver cc2538_crypto_service_driver = {
+  init,
+  run
+};
+/*---------------------------------------------------------------------------*/
+/** @} */
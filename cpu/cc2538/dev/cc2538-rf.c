@@ -48,6 +48,7 @@
 #include "dev/rfcore.h"
 #include "dev/sys-ctrl.h"
 #include "dev/udma.h"
+#include "lib/ringbufindex.h"
 #include "reg.h"
 
 #include <string.h>
@@ -116,6 +117,22 @@ static uint8_t crc_corr;
 static uint8_t rf_flags;
 static uint8_t rf_channel = CC2538_RF_CHANNEL;
 
+#if CC2538_RF_RX_RING_LEN
+/* Frames moved out of the RX FIFO by the RX ISR, waiting to be read */
+struct rx_ring_slot {
+  uint8_t data[CC2538_RF_MAX_PACKET_LEN];
+  uint8_t len;
+  int8_t rssi;
+  uint8_t crc_corr;
+  rtimer_clock_t timestamp;
+};
+static struct rx_ring_slot rx_ring[CC2538_RF_RX_RING_LEN];
+static struct ringbufindex rx_ring_index;
+/* SFD timestamp of the last frame read from the ring */
+static rtimer_clock_t rx_ring_timestamp;
+static uint8_t rx_ring_timestamp_valid;
+#endif /* CC2538_RF_RX_RING_LEN */
+
 static int on(void);
 static int off(void);
 /*---------------------------------------------------------------------------*/
@@ -477,6 +494,10 @@ init(void)
     return 0;
   }
 
+#if CC2538_RF_RX_RING_LEN
+  ringbufindex_init(&rx_ring_index, CC2538_RF_RX_RING_LEN);
+#endif /* CC2538_RF_RX_RING_LEN */
+
   /* Enable clock for the RF Core while Running, in Sleep and Deep Sleep */
   REG(SYS_CTRL_RCGCRFC) = 1;
   REG(SYS_CTRL_SCGCRFC) = 1;
@@ -680,14 +701,15 @@ send(const void *payload, unsigned short payload_len)
   return transmit(payload_len);
 }
 /*---------------------------------------------------------------------------*/
+/* Moves the frame at the head of the RX FIFO to buf, setting its RSSI and
+ * CRC/correlation byte. Returns the frame length, 0 on error */
 static int
-read(void *buf, unsigned short bufsize)
+read_fifo(void *buf, unsigned short bufsize,
+          int8_t *frame_rssi, uint8_t *frame_crc_corr)
 {
   uint8_t i;
   uint8_t len;
 
-  PRINTF("RF: Read\n");
-
   if((REG(RFCORE_XREG_FSMSTAT1) & RFCORE_XREG_FSMSTAT1_FIFOP) == 0) {
     return 0;
   }
@@ -753,15 +775,13 @@ read(void *buf, unsigned short bufsize)
   }
 
   /* Read the RSSI and CRC/Corr bytes */
-  rssi = ((int8_t)REG(RFCORE_SFR_RFDATA)) - RSSI_OFFSET;
-  crc_corr = REG(RFCORE_SFR_RFDATA);
+  *frame_rssi = ((int8_t)REG(RFCORE_SFR_RFDATA)) - RSSI_OFFSET;
+  *frame_crc_corr = REG(RFCORE_SFR_RFDATA);
 
-  PRINTF("%02x%02x\n", (uint8_t)rssi, crc_corr);
+  PRINTF("%02x%02x\n", (uint8_t)*frame_rssi, *frame_crc_corr);
 
   /* MS bit CRC OK/Not OK, 7 LS Bits, Correlation value */
-  if(crc_corr & CRC_BIT_MASK) {
-    packetbuf_set_attr(PACKETBUF_ATTR_RSSI, rssi);
-    packetbuf_set_attr(PACKETBUF_ATTR_LINK_QUALITY, crc_corr & LQI_BIT_MASK);
+  if(*frame_crc_corr & CRC_BIT_MASK) {
     RIMESTATS_ADD(llrx);
   } else {
     RIMESTATS_ADD(badcrc);
@@ -784,6 +804,110 @@ read(void *buf, unsigned short bufsize)
   return len;
 }
 /*---------------------------------------------------------------------------*/
+#if CC2538_RF_RX_RING_LEN
+/* Called from the RX ISR, or with it disabled: moves complete frames
+ * from the RX FIFO to the ring, as long as there is room */
+static void
+rx_ring_fill(void)
+{
+  struct rx_ring_slot *slot;
+  int put;
+
+  while((REG(RFCORE_XREG_FSMSTAT1) & RFCORE_XREG_FSMSTAT1_FIFOP)
+        && (put = ringbufindex_peek_put(&rx_ring_index)) != -1) {
+    slot = &rx_ring[put];
+    slot->timestamp = get_sfd_timestamp();
+    slot->len = read_fifo(slot->data, sizeof(slot->data),
+                          &slot->rssi, &slot->crc_corr);
+    if(slot->len > 0) {
+      ringbufindex_put(&rx_ring_index);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+rx_ring_pending(void)
+{
+  return ringbufindex_elements(&rx_ring_index);
+}
+/*---------------------------------------------------------------------------*/
+static int
+rx_ring_peek(struct radio_rx_frame *frame)
+{
+  struct rx_ring_slot *slot;
+  int get;
+
+  get = ringbufindex_peek_get(&rx_ring_index);
+  if(get == -1) {
+    return 0;
+  }
+  slot = &rx_ring[get];
+
+  rssi = slot->rssi;
+  crc_corr = slot->crc_corr;
+  rx_ring_timestamp = slot->timestamp;
+  rx_ring_timestamp_valid = 1;
+
+  frame->data = slot->data;
+  frame->len = slot->len;
+  frame->rssi = rssi;
+  frame->link_quality = crc_corr & LQI_BIT_MASK;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+rx_ring_release(void)
+{
+  ringbufindex_get(&rx_ring_index);
+}
+/*---------------------------------------------------------------------------*/
+static const struct radio_rx_ring rx_ring_driver = {
+  rx_ring_pending,
+  rx_ring_peek,
+  rx_ring_release
+};
+#endif /* CC2538_RF_RX_RING_LEN */
+/*---------------------------------------------------------------------------*/
+static int
+read(void *buf, unsigned short bufsize)
+{
+  int len;
+#if CC2538_RF_RX_RING_LEN
+  struct radio_rx_frame frame;
+#endif /* CC2538_RF_RX_RING_LEN */
+
+  PRINTF("RF: Read\n");
+
+#if CC2538_RF_RX_RING_LEN
+  /* Frames already moved to the ring come first */
+  if(rx_ring_peek(&frame)) {
+    len = frame.len;
+    if(len > bufsize) {
+      RIMESTATS_ADD(toolong);
+      len = 0;
+    } else {
+      memcpy(buf, frame.data, len);
+      packetbuf_set_attr(PACKETBUF_ATTR_RSSI, frame.rssi);
+      packetbuf_set_attr(PACKETBUF_ATTR_LINK_QUALITY, frame.link_quality);
+    }
+    rx_ring_release();
+    return len;
+  }
+  if(!poll_mode) {
+    /* The RX ISR owns the RX FIFO */
+    return 0;
+  }
+  rx_ring_timestamp_valid = 0;
+#endif /* CC2538_RF_RX_RING_LEN */
+
+  len = read_fifo(buf, bufsize, &rssi, &crc_corr);
+  if(len > 0) {
+    packetbuf_set_attr(PACKETBUF_ATTR_RSSI, rssi);
+    packetbuf_set_attr(PACKETBUF_ATTR_LINK_QUALITY, crc_corr & LQI_BIT_MASK);
+  }
+  return len;
+}
+/*---------------------------------------------------------------------------*/
 static int
 receiving_packet(void)
 {
@@ -805,6 +929,11 @@ pending_packet(void)
 {
   PRINTF("RF: Pending\n");
 
+#if CC2538_RF_RX_RING_LEN
+  if(rx_ring_pending()) {
+    return 1;
+  }
+#endif /* CC2538_RF_RX_RING_LEN */
   return REG(RFCORE_XREG_FSMSTAT1) & RFCORE_XREG_FSMSTAT1_FIFOP;
 }
 /*---------------------------------------------------------------------------*/
@@ -964,10 +1093,26 @@ get_object(radio_param_t param, void *dest, size_t size)
     if(size != sizeof(rtimer_clock_t) || !dest) {
       return RADIO_RESULT_INVALID_VALUE;
     }
+#if CC2538_RF_RX_RING_LEN
+    if(rx_ring_timestamp_valid) {
+      *(rtimer_clock_t *)dest = rx_ring_timestamp;
+      return RADIO_RESULT_OK;
+    }
+#endif /* CC2538_RF_RX_RING_LEN */
     *(rtimer_clock_t *)dest = get_sfd_timestamp();
     return RADIO_RESULT_OK;
   }
 
+#if CC2538_RF_RX_RING_LEN
+  if(param == RADIO_CONST_RX_RING) {
+    if(size != sizeof(const struct radio_rx_ring *) || !dest) {
+      return RADIO_RESULT_INVALID_VALUE;
+    }
+    *(const struct radio_rx_ring **)dest = &rx_ring_driver;
+    return RADIO_RESULT_OK;
+  }
+#endif /* CC2538_RF_RX_RING_LEN */
+
   return RADIO_RESULT_NOT_SUPPORTED;
 }
 /*---------------------------------------------------------------------------*/
@@ -1027,6 +1172,26 @@ PROCESS_THREAD(cc2538_rf_process, ev, data)
     PROCESS_YIELD_UNTIL((!poll_mode || (poll_mode && (rf_flags & RF_MUST_RESET))) && (ev == PROCESS_EVENT_POLL));
 
     if(!poll_mode) {
+#if CC2538_RF_RX_RING_LEN
+      /* Hand all frames captured since the last poll to the MAC */
+      while(rx_ring_pending()) {
+        packetbuf_clear();
+        len = read(packetbuf_dataptr(), PACKETBUF_SIZE);
+
+        if(len > 0) {
+          packetbuf_set_datalen(len);
+
+          NETSTACK_RDC.input();
+        }
+      }
+      /* Frames left in the FIFO while the ring was full */
+      nvic_interrupt_disable(NVIC_INT_RF_RXTX);
+      rx_ring_fill();
+      nvic_interrupt_enable(NVIC_INT_RF_RXTX);
+      if(rx_ring_pending()) {
+        process_poll(&cc2538_rf_process);
+      }
+#else /* CC2538_RF_RX_RING_LEN */
       packetbuf_clear();
       len = read(packetbuf_dataptr(), PACKETBUF_SIZE);
 
@@ -1035,6 +1200,7 @@ PROCESS_THREAD(cc2538_rf_process, ev, data)
 
         NETSTACK_RDC.input();
       }
+#endif /* CC2538_RF_RX_RING_LEN */
     }
 
     /* If we were polled due to an RF error, reset the transceiver */
@@ -1073,6 +1239,9 @@ cc2538_rf_rx_tx_isr(void)
   ENERGEST_ON(ENERGEST_TYPE_IRQ);
 
   if(!poll_mode) {
+#if CC2538_RF_RX_RING_LEN
+    rx_ring_fill();
+#endif /* CC2538_RF_RX_RING_LEN */
     process_poll(&cc2538_rf_process);
   }
 
@@ -85,6 +85,19 @@
 #else
 #define CC2538_RF_AUTOACK 1
 #endif /* CC2538_RF_CONF_AUTOACK */
+
+/*
+ * Number of frames the RX ring can hold, a power of two, 0 to disable.
+ * With a ring, the RX interrupt moves each frame out of the RX FIFO (over
+ * uDMA if enabled) as soon as it is complete, so that back-to-back frames
+ * do not overflow the FIFO, and the driver process hands them all to the
+ * MAC in one go. Not used in poll mode.
+ */
+#ifdef CC2538_RF_CONF_RX_RING_LEN
+#define CC2538_RF_RX_RING_LEN CC2538_RF_CONF_RX_RING_LEN
+#else
+#define CC2538_RF_RX_RING_LEN 0
+#endif /* CC2538_RF_CONF_RX_RING_LEN */
 /*---------------------------------------------------------------------------
  * Command Strobe Processor
  *---------------------------------------------------------------------------*/
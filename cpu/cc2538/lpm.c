@@ -38,6 +38,7 @@
 #include "contiki-conf.h"
 #include "sys/energest.h"
 #include "sys/process.h"
+#include "sys/wakeup.h"
 #include "dev/sys-ctrl.h"
 #include "dev/scb.h"
 #include "dev/rfcore-xreg.h"
@@ -260,15 +261,15 @@ lpm_enter()
 
   /*
    * Registered peripherals were off. Radio was off: Some Duty Cycling in place.
-   * rtimers run on the Sleep Timer. Thus, if we have a scheduled rtimer
-   * task, a Sleep Timer interrupt will fire and will wake us up.
+   * The Sleep Timer will wake us up when the system needs the CPU next,
+   * be it for a scheduled rtimer task or for an etimer: the SysTick is
+   * frozen in PM1/2 and no periodic clock tick wakes us up in between.
    * Choose the most suitable PM based on anticipated deep sleep duration
    */
-  lpm_exit_time = rtimer_arch_next_trigger();
-  duration = lpm_exit_time - RTIMER_NOW();
-
-  if(duration < DEEP_SLEEP_PM1_THRESHOLD || lpm_exit_time == 0) {
-    /* Anticipated duration too short or no scheduled rtimer task. Use PM0 */
+  if(wakeup_next(&lpm_exit_time) != WAKEUP_AT
+     || RTIMER_CLOCK_DIFF(lpm_exit_time, RTIMER_NOW()) < DEEP_SLEEP_PM1_THRESHOLD) {
+    /* Events pending, nothing scheduled or anticipated duration too short.
+     * Use PM0 */
     enter_pm0();
 
     /* We reach here when the interrupt context that woke us up has returned */
@@ -311,6 +312,16 @@ lpm_enter()
   ENERGEST_IRQ_RESTORE(irq_energest);
   ENERGEST_SWITCH(ENERGEST_TYPE_CPU, ENERGEST_TYPE_LPM);
 
+  /*
+   * Program the Sleep Timer for the wake-up time, unless a scheduled rtimer
+   * task fires about as early. If it fires later, rtimer_isr() reschedules it
+   * when we wake up
+   */
+  if(rtimer_arch_next_trigger() == 0
+     || RTIMER_CLOCK_LT(lpm_exit_time + DEEP_SLEEP_PM2_THRESHOLD, rtimer_arch_next_trigger())) {
+    rtimer_arch_schedule(lpm_exit_time);
+  }
+
   /* Remember the current time so we can keep stats when we wake up */
   if(LPM_CONF_STATS) {
     sleep_enter_time = RTIMER_NOW();
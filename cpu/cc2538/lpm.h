@@ -105,15 +105,16 @@ void lpm_init(void);
  * This PM selection heuristic has the following primary criteria:
  * - Is the RF off?
  * - Are all registered peripherals permitting PM1+?
- * - Is the Sleep Timer scheduled to fire an interrupt?
+ * - Is the system idle, with no pending events (see wakeup_next())?
  *
  * If the answer to any of those questions is no, we will drop to PM0 and
  * will wake up to any interrupt. Best case scenario (if nothing else happens),
  * we will idle until the next SysTick in no more than 1000/CLOCK_SECOND ms
  * (7.8125ms).
  *
- * If all can be answered with 'yes', we can drop to PM1/2 knowing that the
- * Sleep Timer will wake us up. Depending on the estimated deep sleep duration
+ * If all can be answered with 'yes', we can drop to PM1/2 and program the
+ * Sleep Timer to wake us up for the next rtimer task or etimer expiration,
+ * whichever comes first. Depending on the estimated deep sleep duration
  * and the max PM allowed by user configuration, we select the most efficient
  * Power Mode to drop to. If the duration is too short, we simply IDLE in PM0.
  *
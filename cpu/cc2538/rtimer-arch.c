@@ -136,6 +136,8 @@ rtimer_arch_now()
 void
 rtimer_isr()
 {
+  rtimer_clock_t next_task_time;
+
   /*
    * If we were in PM1+, call the wake-up sequence first. This will make sure
    * that the 32MHz OSC is selected as the clock source. We need to do this
@@ -150,7 +152,13 @@ rtimer_isr()
   nvic_interrupt_unpend(NVIC_INT_SM_TIMER);
   nvic_interrupt_disable(NVIC_INT_SM_TIMER);
 
-  rtimer_run_next();
+  if(rtimer_next_scheduled(&next_task_time)
+     && RTIMER_CLOCK_LT(RTIMER_NOW(), next_task_time)) {
+    /* LPM woke us up ahead of the task, for an etimer */
+    rtimer_arch_schedule(next_task_time);
+  } else {
+    rtimer_run_next();
+  }
 
   ENERGEST_OFF(ENERGEST_TYPE_IRQ);
 }
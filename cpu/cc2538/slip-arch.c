@@ -37,11 +37,17 @@
  *
  * SLIP can be configured to operate over UART or over USB-Serial, depending
  * on the value of SLIP_ARCH_CONF_USB
+ *
+ * Over UART, SLIP_ARCH_CONF_DMA sends whole frames with the uDMA instead
+ * of one byte at a time (SLIP_CONF_ARCH_WRITE). Debug output must then
+ * not share the UART, since it would be mixed with the frame being sent
  */
 #include "contiki-conf.h"
 #include "dev/slip.h"
 #include "dev/uart.h"
 #include "usb/usb-serial.h"
+#include "dev/udma.h"
+#include "reg.h"
 
 #ifndef SLIP_ARCH_CONF_USB
 #define SLIP_ARCH_CONF_USB 0
@@ -57,6 +63,37 @@
 #define flush()
 #endif
 
+#ifndef SLIP_ARCH_CONF_DMA
+#define SLIP_ARCH_CONF_DMA 0
+#endif
+
+#if SLIP_ARCH_CONF_DMA && SLIP_ARCH_CONF_USB
+#error "SLIP_ARCH_CONF_DMA is only supported over UART"
+#endif
+
+#if SLIP_ARCH_CONF_DMA && !SLIP_CONF_ARCH_WRITE
+#error "SLIP_ARCH_CONF_DMA requires SLIP_CONF_ARCH_WRITE"
+#endif
+
+#if SLIP_ARCH_CONF_DMA
+#if SLIP_ARCH_CONF_UART == 0
+#define SLIP_UART_BASE     UART_0_BASE
+#define SLIP_DMA_CHANNEL   9
+#define SLIP_DMA_ENC       UDMA_CH9_UART0TX
+#else
+#define SLIP_UART_BASE     UART_1_BASE
+#define SLIP_DMA_CHANNEL   23
+#define SLIP_DMA_ENC       UDMA_CH23_UART1TX
+#endif
+
+/* The most the uDMA moves in one transfer */
+#define SLIP_DMA_MAX_XFER  1024
+
+#define SLIP_DMA_CTRL (UDMA_CHCTL_DSTINC_NONE | UDMA_CHCTL_DSTSIZE_8 | \
+                       UDMA_CHCTL_SRCINC_8 | UDMA_CHCTL_SRCSIZE_8 | \
+                       UDMA_CHCTL_ARBSIZE_4 | UDMA_CHCTL_XFERMODE_BASIC)
+#endif /* SLIP_ARCH_CONF_DMA */
+
 #define SLIP_END     0300
 /*---------------------------------------------------------------------------*/
 /**
@@ -66,12 +103,52 @@
 void
 slip_arch_writeb(unsigned char c)
 {
+#if SLIP_ARCH_CONF_DMA
+  while(slip_arch_write_pending());
+#endif
   write_byte(c);
   if(c == SLIP_END) {
     flush();
   }
 }
 /*---------------------------------------------------------------------------*/
+#if SLIP_ARCH_CONF_DMA
+/**
+ * \brief Start sending an escaped SLIP frame with the uDMA
+ * \param ptr the frame, which must remain valid until it is sent
+ * \param len the length of the frame
+ *
+ * Frames longer than one uDMA transfer are sent in several transfers,
+ * all but the last one being waited for.
+ */
+void
+slip_arch_write(const uint8_t *ptr, uint16_t len)
+{
+  uint16_t n;
+
+  while(len > 0) {
+    while(slip_arch_write_pending());
+    n = len > SLIP_DMA_MAX_XFER ? SLIP_DMA_MAX_XFER : len;
+    udma_set_channel_src(SLIP_DMA_CHANNEL, (uint32_t)(ptr + n - 1));
+    udma_set_channel_control_word(SLIP_DMA_CHANNEL,
+                                  SLIP_DMA_CTRL | udma_xfer_size(n));
+    udma_channel_enable(SLIP_DMA_CHANNEL);
+    ptr += n;
+    len -= n;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Check whether the last frame is still being sent
+ * \return Non-zero while the uDMA is reading from the frame
+ */
+int
+slip_arch_write_pending(void)
+{
+  return udma_channel_get_mode(SLIP_DMA_CHANNEL) != UDMA_CHCTL_XFERMODE_STOP;
+}
+#endif /* SLIP_ARCH_CONF_DMA */
+/*---------------------------------------------------------------------------*/
 /**
  * \brief Initialise the arch-specific SLIP driver
  * \param ubr Ignored for the cc2538
@@ -79,6 +156,14 @@ slip_arch_writeb(unsigned char c)
 void
 slip_arch_init(unsigned long ubr)
 {
+#if SLIP_ARCH_CONF_DMA
+  udma_set_channel_assignment(SLIP_DMA_CHANNEL, SLIP_DMA_ENC);
+  udma_channel_use_primary(SLIP_DMA_CHANNEL);
+  udma_channel_use_single(SLIP_DMA_CHANNEL);
+  udma_channel_mask_clr(SLIP_DMA_CHANNEL);
+  udma_set_channel_dst(SLIP_DMA_CHANNEL, SLIP_UART_BASE + UART_DR);
+  REG(SLIP_UART_BASE + UART_DMACTL) |= UART_DMACTL_TXDMAE;
+#endif
   set_input(slip_input_byte);
 }
 /*---------------------------------------------------------------------------*/
@@ -103,6 +103,10 @@ typedef unsigned short clock_time_t;
 #define UIP_ARCH_ADD32    0
 #define UIP_ARCH_CHKSUM	  0
 
+/* Packet copies on xdata pointers, or by DMA, see memcpy-arch.c */
+#define CONTIKI_ARCH_CONF_MEMCPY memcpy_arch
+#define CONTIKI_ARCH_CONF_MEMSET memset_arch
+
 #define CC_CONF_ASSIGN_AGGREGATE(dest, src)	\
     memcpy(dest, src, sizeof(*dest))
 
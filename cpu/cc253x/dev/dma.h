@@ -122,6 +122,13 @@ typedef struct dma_config {
 #if DMA_ON
 #define DMA_CHANNEL_COUNT 2
 extern dma_config_t dma_conf[DMA_CHANNEL_COUNT];
+
+/* Channel memcpy_arch() copies packets with, channel 0 being for USB */
+#ifdef DMA_CONF_MEMCPY_CHANNEL
+#define DMA_MEMCPY_CHANNEL DMA_CONF_MEMCPY_CHANNEL
+#else
+#define DMA_MEMCPY_CHANNEL 1
+#endif
 #endif
 
 /* DMA-Related Macros */
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Packet copies for the cc253x (see CONTIKI_ARCH_MEMCPY)
+ *
+ *         memcpy() and memset() take generic pointers, which cost a library
+ *         call for each byte accessed. The packet buffers are all in xdata,
+ *         so these work on xdata pointers instead, and copy large buffers
+ *         with a DMA channel when DMA is on. Other buffers are left to the
+ *         library.
+ *
+ *         Bankable
+ */
+
+#include "contiki.h"
+#include "dev/dma.h"
+
+#include <string.h>
+/*---------------------------------------------------------------------------*/
+/* Copies shorter than this are not worth setting up the DMA */
+#ifdef MEMCPY_ARCH_CONF_DMA_MIN
+#define MEMCPY_ARCH_DMA_MIN MEMCPY_ARCH_CONF_DMA_MIN
+#else
+#define MEMCPY_ARCH_DMA_MIN 16
+#endif
+
+/* The DMA length field has 13 bits */
+#define DMA_MAX_LEN 0x1FFF
+
+/* The third byte of a generic pointer is its memory space, 0 for xdata */
+#define IS_XDATA(p) (((const uint8_t *)&(p))[2] == 0)
+/*---------------------------------------------------------------------------*/
+void *
+memcpy_arch(void *dst, const void *src, size_t len)
+{
+  uint8_t __xdata *d;
+  const uint8_t __xdata *s;
+
+  if(!IS_XDATA(dst) || !IS_XDATA(src)) {
+    return memcpy(dst, src, len);
+  }
+  d = (uint8_t __xdata *)(uint16_t)dst;
+  s = (const uint8_t __xdata *)(uint16_t)src;
+
+#if DMA_ON
+  if(len >= MEMCPY_ARCH_DMA_MIN && len <= DMA_MAX_LEN) {
+    dma_conf[DMA_MEMCPY_CHANNEL].src_h = (uint16_t)s >> 8;
+    dma_conf[DMA_MEMCPY_CHANNEL].src_l = (uint16_t)s;
+    dma_conf[DMA_MEMCPY_CHANNEL].dst_h = (uint16_t)d >> 8;
+    dma_conf[DMA_MEMCPY_CHANNEL].dst_l = (uint16_t)d;
+    dma_conf[DMA_MEMCPY_CHANNEL].len_h = len >> 8;
+    dma_conf[DMA_MEMCPY_CHANNEL].len_l = len;
+    dma_conf[DMA_MEMCPY_CHANNEL].wtt = DMA_T_NONE | DMA_BLOCK;
+    dma_conf[DMA_MEMCPY_CHANNEL].inc_prio =
+      DMA_SRC_INC_1 | DMA_DST_INC_1 | DMA_PRIO_HIGH;
+
+    DMA_ARM(DMA_MEMCPY_CHANNEL);
+    while(!(DMAARM & (1 << DMA_MEMCPY_CHANNEL)));
+    DMA_TRIGGER(DMA_MEMCPY_CHANNEL);
+    /* As in usb-arch.c, DMAARM is more reliable than the IRQ flag */
+    while(DMAARM & (1 << DMA_MEMCPY_CHANNEL));
+    DMAIRQ = ~(1 << DMA_MEMCPY_CHANNEL);
+    return dst;
+  }
+#endif /* DMA_ON */
+
+  while(len-- > 0) {
+    *d++ = *s++;
+  }
+  return dst;
+}
+/*---------------------------------------------------------------------------*/
+void *
+memset_arch(void *dst, int c, size_t len)
+{
+  uint8_t __xdata *d;
+
+  if(!IS_XDATA(dst)) {
+    return memset(dst, c, len);
+  }
+  d = (uint8_t __xdata *)(uint16_t)dst;
+  while(len-- > 0) {
+    *d++ = c;
+  }
+  return dst;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/*---------------------------------------------------------------------------*/
+/**
+ * \addtogroup cc26xx-ccm-star
+ * @{
+ *
+ * \file
+ * Implementation of the AES-CCM* driver for the CC13xx/CC26xx
+ *
+ * The key is kept in RAM and loaded to the crypto engine key store before
+ * each operation, as the key store does not survive the PERIPH power
+ * domain being turned off in deep sleep.
+ */
+/*---------------------------------------------------------------------------*/
+#include "contiki.h"
+#include "dev/cc26xx-ccm-star.h"
+#include "lib/aes-128.h"
+#include "ti-lib.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+/*---------------------------------------------------------------------------*/
+#define MODULE_NAME     "cc26xx-ccm-star"
+
+/* Length of the CCM length field: the nonce takes the rest of the IV */
+#define CCM_STAR_LEN_LEN        (15 - CCM_STAR_NONCE_LENGTH)
+
+#define KEY_AREA                CRYPTO_KEY_AREA_0
+
+#define DEBUG 0
+#if DEBUG
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+/*---------------------------------------------------------------------------*/
+static uint32_t key_words[AES_128_KEY_LENGTH / sizeof(uint32_t)];
+/*---------------------------------------------------------------------------*/
+static void
+power_up(void)
+{
+  if(ti_lib_rom_prcm_power_domain_status(PRCM_DOMAIN_PERIPH)
+     != PRCM_DOMAIN_POWER_ON) {
+    ti_lib_rom_prcm_power_domain_on(PRCM_DOMAIN_PERIPH);
+    while((ti_lib_rom_prcm_power_domain_status(PRCM_DOMAIN_PERIPH)
+           != PRCM_DOMAIN_POWER_ON));
+  }
+
+  if(!(HWREG(PRCM_BASE + PRCM_O_SECDMACLKGR) &
+       PRCM_SECDMACLKGR_CRYPTO_CLK_EN_M)) {
+    ti_lib_rom_prcm_peripheral_run_enable(PRCM_PERIPH_CRYPTO);
+    ti_lib_prcm_load_set();
+    while(!ti_lib_prcm_load_get());
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+set_key(const uint8_t *key)
+{
+  memcpy(key_words, key, AES_128_KEY_LENGTH);
+}
+/*---------------------------------------------------------------------------*/
+static void
+aead(const uint8_t *nonce, uint8_t *m, uint8_t m_len, const uint8_t *a,
+     uint8_t a_len, uint8_t *result, uint8_t mic_len, int forward)
+{
+  uint32_t nonce_words[(CCM_STAR_NONCE_LENGTH + 3) / sizeof(uint32_t)];
+  uint32_t tag[AES_128_BLOCK_SIZE / sizeof(uint32_t)];
+  uint32_t ret;
+
+  power_up();
+
+  ret = ti_lib_crypto_aes_load_key(key_words, KEY_AREA);
+  if(ret != AES_SUCCESS) {
+    PRINTF("%s: load key error %lu\n", MODULE_NAME, ret);
+    return;
+  }
+
+  memcpy(nonce_words, nonce, CCM_STAR_NONCE_LENGTH);
+
+  if(forward) {
+    ret = ti_lib_crypto_ccm_auth_encrypt(m_len > 0, mic_len, nonce_words,
+                                         (uint32_t *)m, m_len,
+                                         (uint32_t *)a, a_len,
+                                         KEY_AREA, CCM_STAR_LEN_LEN, false);
+    if(ret != AES_SUCCESS) {
+      PRINTF("%s: encrypt start error %lu\n", MODULE_NAME, ret);
+      return;
+    }
+
+    while((ret = ti_lib_crypto_ccm_auth_encrypt_status()) == AES_DMA_BSY);
+    ret = ti_lib_crypto_ccm_auth_encrypt_result_get(mic_len, tag);
+    if(ret != AES_SUCCESS) {
+      PRINTF("%s: encrypt error %lu\n", MODULE_NAME, ret);
+      return;
+    }
+  } else {
+    /* The engine reads the received MIC right after the ciphertext */
+    ret = ti_lib_crypto_ccm_inv_auth_decrypt(m_len > 0, mic_len, nonce_words,
+                                             (uint32_t *)m, m_len + mic_len,
+                                             (uint32_t *)a, a_len,
+                                             KEY_AREA, CCM_STAR_LEN_LEN,
+                                             false);
+    if(ret != AES_SUCCESS) {
+      PRINTF("%s: decrypt start error %lu\n", MODULE_NAME, ret);
+      return;
+    }
+
+    while((ret = ti_lib_crypto_ccm_inv_auth_decrypt_status()) == AES_DMA_BSY);
+    /* A MIC mismatch is reported here, but it is up to the caller to
+     * compare the MIC we compute against the received one */
+    ret = ti_lib_crypto_ccm_inv_auth_decrypt_result_get(mic_len, (uint32_t *)m,
+                                                        m_len + mic_len, tag);
+    if(ret != AES_SUCCESS && ret != CCM_AUTHENTICATION_FAILED) {
+      PRINTF("%s: decrypt error %lu\n", MODULE_NAME, ret);
+      return;
+    }
+  }
+
+  memcpy(result, tag, mic_len);
+}
+/*---------------------------------------------------------------------------*/
+const struct ccm_star_driver cc26xx_ccm_star_driver = {
+  set_key,
+  aead
+};
+/*---------------------------------------------------------------------------*/
+/** @} */
@@ -102,6 +102,14 @@
 #else
 #define IEEE_MODE_RSSI_THRESHOLD 0xA6
 #endif /* IEEE_MODE_CONF_RSSI_THRESHOLD */
+
+/* Number of RX data queue entries, each holding one frame. The RF core
+ * fills them back-to-back without CPU involvement */
+#ifdef IEEE_MODE_CONF_RX_BUF_CNT
+#define IEEE_MODE_RX_BUF_CNT IEEE_MODE_CONF_RX_BUF_CNT
+#else
+#define IEEE_MODE_RX_BUF_CNT 4
+#endif /* IEEE_MODE_CONF_RX_BUF_CNT */
 /*---------------------------------------------------------------------------*/
 #define STATUS_CRC_OK      0x80
 #define STATUS_CORRELATION 0x7f
@@ -243,11 +251,8 @@ static uint8_t cmd_ieee_rx_buf[RF_CMD_BUFFER_SIZE] CC_ALIGN(4);
 #define DATA_ENTRY_LENSZ_WORD 2 /* 2 bytes */
 
 #define RX_BUF_SIZE 144
-/* Four receive buffers entries with room for 1 IEEE802.15.4 frame in each */
-static uint8_t rx_buf_0[RX_BUF_SIZE] CC_ALIGN(4);
-static uint8_t rx_buf_1[RX_BUF_SIZE] CC_ALIGN(4);
-static uint8_t rx_buf_2[RX_BUF_SIZE] CC_ALIGN(4);
-static uint8_t rx_buf_3[RX_BUF_SIZE] CC_ALIGN(4);
+/* Receive buffers entries with room for 1 IEEE802.15.4 frame in each */
+static uint8_t rx_buf[IEEE_MODE_RX_BUF_CNT][RX_BUF_SIZE] CC_ALIGN(4);
 
 /* The RX Data Queue */
 static dataQueue_t rx_data_queue = { 0 };
@@ -540,26 +545,14 @@ static void
 init_rx_buffers(void)
 {
   rfc_dataEntry_t *entry;
+  int i;
 
-  entry = (rfc_dataEntry_t *)rx_buf_0;
-  entry->pNextEntry = rx_buf_1;
-  entry->config.lenSz = DATA_ENTRY_LENSZ_BYTE;
-  entry->length = sizeof(rx_buf_0) - 8;
-
-  entry = (rfc_dataEntry_t *)rx_buf_1;
-  entry->pNextEntry = rx_buf_2;
-  entry->config.lenSz = DATA_ENTRY_LENSZ_BYTE;
-  entry->length = sizeof(rx_buf_0) - 8;
-
-  entry = (rfc_dataEntry_t *)rx_buf_2;
-  entry->pNextEntry = rx_buf_3;
-  entry->config.lenSz = DATA_ENTRY_LENSZ_BYTE;
-  entry->length = sizeof(rx_buf_0) - 8;
-
-  entry = (rfc_dataEntry_t *)rx_buf_3;
-  entry->pNextEntry = rx_buf_0;
-  entry->config.lenSz = DATA_ENTRY_LENSZ_BYTE;
-  entry->length = sizeof(rx_buf_0) - 8;
+  for(i = 0; i < IEEE_MODE_RX_BUF_CNT; i++) {
+    entry = (rfc_dataEntry_t *)rx_buf[i];
+    entry->pNextEntry = rx_buf[(i + 1) % IEEE_MODE_RX_BUF_CNT];
+    entry->config.lenSz = DATA_ENTRY_LENSZ_BYTE;
+    entry->length = RX_BUF_SIZE - 8;
+  }
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -815,18 +808,15 @@ init(void)
   rf_core_set_modesel();
 
   /* Initialise RX buffers */
-  memset(rx_buf_0, 0, RX_BUF_SIZE);
-  memset(rx_buf_1, 0, RX_BUF_SIZE);
-  memset(rx_buf_2, 0, RX_BUF_SIZE);
-  memset(rx_buf_3, 0, RX_BUF_SIZE);
+  memset(rx_buf, 0, sizeof(rx_buf));
 
   /* Set of RF Core data queue. Circular buffer, no last entry */
-  rx_data_queue.pCurrEntry = rx_buf_0;
+  rx_data_queue.pCurrEntry = rx_buf[0];
 
   rx_data_queue.pLastEntry = NULL;
 
   /* Initialize current read pointer to first element (used in ISR) */
-  rx_read_entry = rx_buf_0;
+  rx_read_entry = rx_buf[0];
 
   /* Populate the RF parameters data structure with default values */
   init_rf_params();
@@ -1015,38 +1005,97 @@ calc_last_packet_timestamp(uint32_t rat_timestamp)
   return RADIO_TO_RTIMER(rat_timestamp64 - rat_offset);
 }
 /*---------------------------------------------------------------------------*/
+/*
+ * The RX data queue doubles as the radio RX ring: finished entries are
+ * handed out in place, in the order the RF core filled them.
+ */
 static int
-read_frame(void *buf, unsigned short buf_len)
+rx_ring_pending(void)
 {
-  int len = 0;
-  rfc_dataEntryGeneral_t *entry = (rfc_dataEntryGeneral_t *)rx_read_entry;
+  int i;
+  int count = 0;
+
+  for(i = 0; i < IEEE_MODE_RX_BUF_CNT; i++) {
+    if(((rfc_dataEntry_t *)rx_buf[i])->status == DATA_ENTRY_STATUS_FINISHED) {
+      count++;
+    }
+  }
+  return count;
+}
+/*---------------------------------------------------------------------------*/
+static int
+rx_ring_peek(struct radio_rx_frame *frame)
+{
+  rfc_dataEntryGeneral_t *entry;
   uint32_t rat_timestamp;
+  int len;
 
   if(rf_is_on()) {
     check_rat_overflow(false);
   }
 
+  entry = (rfc_dataEntryGeneral_t *)rx_read_entry;
+  while(entry->status == DATA_ENTRY_STATUS_FINISHED) {
+    if(rx_read_entry[8] < 4) {
+      PRINTF("RF: too short\n");
+      RIMESTATS_ADD(tooshort);
+
+      release_data_entry();
+      entry = (rfc_dataEntryGeneral_t *)rx_read_entry;
+      continue;
+    }
+
+    len = rx_read_entry[8] - 8;
+
+    last_rssi = (int8_t)rx_read_entry[9 + len + 2];
+    last_corr_lqi = (uint8_t)rx_read_entry[9 + len + 2] & STATUS_CORRELATION;
+
+    /* get the timestamp */
+    memcpy(&rat_timestamp, (char *)rx_read_entry + 9 + len + 4, 4);
+
+    last_packet_timestamp = calc_last_packet_timestamp(rat_timestamp);
+
+    frame->data = (const uint8_t *)&rx_read_entry[9];
+    frame->len = len;
+    frame->rssi = last_rssi;
+    frame->link_quality = last_corr_lqi;
+    return 1;
+  }
+
+  /* No available data */
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+rx_ring_release(void)
+{
+  RIMESTATS_ADD(llrx);
+
+  release_data_entry();
+}
+/*---------------------------------------------------------------------------*/
+static const struct radio_rx_ring rx_ring_driver = {
+  rx_ring_pending,
+  rx_ring_peek,
+  rx_ring_release
+};
+/*---------------------------------------------------------------------------*/
+static int
+read_frame(void *buf, unsigned short buf_len)
+{
+  rfc_dataEntryGeneral_t *entry = (rfc_dataEntryGeneral_t *)rx_read_entry;
+  struct radio_rx_frame frame;
+
   /* wait for entry to become finished */
   rtimer_clock_t t0 = RTIMER_NOW();
   while(entry->status == DATA_ENTRY_STATUS_BUSY
       && RTIMER_CLOCK_LT(RTIMER_NOW(), t0 + (RTIMER_SECOND / 250)));
 
-  if(entry->status != DATA_ENTRY_STATUS_FINISHED) {
-    /* No available data */
-    return 0;
-  }
-
-  if(rx_read_entry[8] < 4) {
-    PRINTF("RF: too short\n");
-    RIMESTATS_ADD(tooshort);
-
-    release_data_entry();
+  if(!rx_ring_peek(&frame)) {
     return 0;
   }
 
-  len = rx_read_entry[8] - 8;
-
-  if(len > buf_len) {
+  if(frame.len > buf_len) {
     PRINTF("RF: too long\n");
     RIMESTATS_ADD(toolong);
 
@@ -1054,15 +1103,7 @@ read_frame(void *buf, unsigned short buf_len)
     return 0;
   }
 
-  memcpy(buf, (char *)&rx_read_entry[9], len);
-
-  last_rssi = (int8_t)rx_read_entry[9 + len + 2];
-  last_corr_lqi = (uint8_t)rx_read_entry[9 + len + 2] & STATUS_CORRELATION;
-
-  /* get the timestamp */
-  memcpy(&rat_timestamp, (char *)rx_read_entry + 9 + len + 4, 4);
-
-  last_packet_timestamp = calc_last_packet_timestamp(rat_timestamp);
+  memcpy(buf, frame.data, frame.len);
 
   if(!poll_mode) {
     /* Not in poll mode: packetbuf should not be accessed in interrupt context.
@@ -1071,11 +1112,10 @@ read_frame(void *buf, unsigned short buf_len)
     packetbuf_set_attr(PACKETBUF_ATTR_RSSI, last_rssi);
     packetbuf_set_attr(PACKETBUF_ATTR_LINK_QUALITY, last_corr_lqi);
   }
-  RIMESTATS_ADD(llrx);
 
-  release_data_entry();
+  rx_ring_release();
 
-  return len;
+  return frame.len;
 }
 /*---------------------------------------------------------------------------*/
 static int
@@ -1251,6 +1291,8 @@ on(void)
 static int
 off(void)
 {
+  int i;
+
   /*
    * If we are in the middle of a BLE operation, we got called by ContikiMAC
    * from within an interrupt context. Abort, but pretend everything is OK.
@@ -1282,17 +1324,10 @@ off(void)
    * Just in case there was an ongoing RX (which started after we begun the
    * shutdown sequence), we don't want to leave the buffer in state == ongoing
    */
-  if(((rfc_dataEntry_t *)rx_buf_0)->status == DATA_ENTRY_STATUS_BUSY) {
-    ((rfc_dataEntry_t *)rx_buf_0)->status = DATA_ENTRY_STATUS_PENDING;
-  }
-  if(((rfc_dataEntry_t *)rx_buf_1)->status == DATA_ENTRY_STATUS_BUSY) {
-    ((rfc_dataEntry_t *)rx_buf_1)->status = DATA_ENTRY_STATUS_PENDING;
-  }
-  if(((rfc_dataEntry_t *)rx_buf_2)->status == DATA_ENTRY_STATUS_BUSY) {
-    ((rfc_dataEntry_t *)rx_buf_2)->status = DATA_ENTRY_STATUS_PENDING;
-  }
-  if(((rfc_dataEntry_t *)rx_buf_3)->status == DATA_ENTRY_STATUS_BUSY) {
-    ((rfc_dataEntry_t *)rx_buf_3)->status = DATA_ENTRY_STATUS_PENDING;
+  for(i = 0; i < IEEE_MODE_RX_BUF_CNT; i++) {
+    if(((rfc_dataEntry_t *)rx_buf[i])->status == DATA_ENTRY_STATUS_BUSY) {
+      ((rfc_dataEntry_t *)rx_buf[i])->status = DATA_ENTRY_STATUS_PENDING;
+    }
   }
 
   return RF_CORE_CMD_OK;
@@ -1541,6 +1576,15 @@ get_object(radio_param_t param, void *dest, size_t size)
     return RADIO_RESULT_OK;
   }
 
+  if(param == RADIO_CONST_RX_RING) {
+    if(size != sizeof(const struct radio_rx_ring *) || !dest) {
+      return RADIO_RESULT_INVALID_VALUE;
+    }
+    *(const struct radio_rx_ring **)dest = &rx_ring_driver;
+
+    return RADIO_RESULT_OK;
+  }
+
   return RADIO_RESULT_NOT_SUPPORTED;
 }
 /*---------------------------------------------------------------------------*/
@@ -48,10 +48,12 @@
 #include "net/packetbuf.h"
 #include "net/rime/rimestats.h"
 #include "net/linkaddr.h"
+#include "net/link-stats.h"
 #include "net/netstack.h"
 #include "sys/energest.h"
 #include "sys/clock.h"
 #include "sys/rtimer.h"
+#include "sys/ctimer.h"
 #include "sys/cc.h"
 #include "lpm.h"
 #include "ti-lib.h"
@@ -107,6 +109,56 @@
 #define PROP_MODE_USE_CRC16 0
 #endif
 /*---------------------------------------------------------------------------*/
+/*
+ * Link adaptation: unicast frames are sent with the fastest PHY mode the
+ * link to their receiver is good enough for, according to link-stats. A
+ * short mode switch frame, sent with the mode receivers listen with, tells
+ * them to receive the next frame with the new mode. Mode switch frames are
+ * always obeyed, so nodes without link adaptation can be sent to
+ */
+#ifdef PROP_MODE_CONF_LINK_ADAPTATION
+#define PROP_MODE_LINK_ADAPTATION PROP_MODE_CONF_LINK_ADAPTATION
+#else
+#define PROP_MODE_LINK_ADAPTATION 0
+#endif
+
+/* Frames shorter than this are not worth a mode switch. This also keeps
+ * ACKs on the mode receivers listen with */
+#ifdef PROP_MODE_CONF_PHY_SWITCH_MIN_LEN
+#define PHY_SWITCH_MIN_LEN PROP_MODE_CONF_PHY_SWITCH_MIN_LEN
+#else
+#define PHY_SWITCH_MIN_LEN 40
+#endif
+
+/* Weakest RSSI of a link for each PHY mode to be used on it */
+#ifdef PROP_MODE_CONF_PHY_MIN_RSSI
+#define PHY_MIN_RSSI PROP_MODE_CONF_PHY_MIN_RSSI
+#else
+#define PHY_MIN_RSSI { -128, -85 }
+#endif
+
+/* Worst ETX of a link for a faster PHY mode to be used on it */
+#ifdef PROP_MODE_CONF_PHY_MAX_ETX
+#define PHY_MAX_ETX PROP_MODE_CONF_PHY_MAX_ETX
+#else
+#define PHY_MAX_ETX (3 * LINK_STATS_ETX_DIVISOR / 2)
+#endif
+
+/* How long the sender waits after a mode switch frame, for receivers to
+ * switch, and how long receivers wait for the frame */
+#ifdef PROP_MODE_CONF_PHY_SWITCH_GUARD
+#define PHY_SWITCH_GUARD PROP_MODE_CONF_PHY_SWITCH_GUARD
+#else
+#define PHY_SWITCH_GUARD (RTIMER_SECOND / 500)
+#endif
+#define PHY_SWITCH_TIMEOUT (CLOCK_SECOND / 64)
+
+/*
+ * A mode switch frame has a 2-byte payload: the new mode and its
+ * complement. No 802.15.4 frame is that short
+ */
+#define PHY_SWITCH_LEN 2
+/*---------------------------------------------------------------------------*/
 /**
  * \brief Returns the current status of a running Radio Op command
  * \param a A pointer with the buffer used to initiate the command
@@ -239,6 +291,17 @@ volatile static uint8_t *rx_read_entry;
 #define TX_BUF_HDR_LEN       2
 
 static uint8_t tx_buf[TX_BUF_HDR_LEN + TX_BUF_PAYLOAD_LEN] CC_ALIGN(4);
+static uint8_t switch_buf[TX_BUF_HDR_LEN + PHY_SWITCH_LEN] CC_ALIGN(4);
+/*---------------------------------------------------------------------------*/
+/* PHY mode we listen with, and PHY mode the RF core is set up for */
+static uint8_t phy_rx = SMARTRF_SETTINGS_PHY_50KBPS;
+static uint8_t phy_current = SMARTRF_SETTINGS_PHY_50KBPS;
+
+static struct ctimer phy_switch_timer;
+
+#if PROP_MODE_LINK_ADAPTATION
+static const int8_t phy_min_rssi[SMARTRF_SETTINGS_PHY_COUNT] = PHY_MIN_RSSI;
+#endif
 /*---------------------------------------------------------------------------*/
 static uint8_t
 rf_is_on(void)
@@ -363,6 +426,14 @@ prop_div_radio_setup(void)
 {
   uint32_t cmd_status;
   rfc_radioOp_t *cmd = (rfc_radioOp_t *)&smartrf_settings_cmd_prop_radio_div_setup;
+  const smartrf_settings_phy_t *phy = &smartrf_settings_phy[phy_current];
+
+  /* Apply the current PHY mode */
+  smartrf_settings_cmd_prop_radio_div_setup.modulation.deviation = phy->deviation;
+  smartrf_settings_cmd_prop_radio_div_setup.symbolRate.preScale = phy->pre_scale;
+  smartrf_settings_cmd_prop_radio_div_setup.symbolRate.rateWord = phy->rate_word;
+  smartrf_settings_cmd_prop_radio_div_setup.rxBw = phy->rx_bw;
+  smartrf_settings_cmd_prop_radio_div_setup.preamConf.nPreamBytes = phy->preamble_bytes;
 
   /* Adjust loDivider depending on the selected band */
   smartrf_settings_cmd_prop_radio_div_setup.loDivider = PROP_MODE_LO_DIVIDER;
@@ -556,6 +627,94 @@ soft_on_prop(void)
   return rx_on_prop();
 }
 /*---------------------------------------------------------------------------*/
+/*
+ * Set the RF core up for a PHY mode. The RF core must be powered and not
+ * in RX or TX
+ */
+static int
+set_phy(uint8_t mode)
+{
+  if(mode == phy_current) {
+    return RF_CORE_CMD_OK;
+  }
+
+  phy_current = mode;
+
+  if(prop_div_radio_setup() != RF_CORE_CMD_OK) {
+    PRINTF("set_phy: prop_div_radio_setup() failed\n");
+    return RF_CORE_CMD_ERROR;
+  }
+
+  return prop_fs();
+}
+/*---------------------------------------------------------------------------*/
+/* Listen with a PHY mode, assuming we are on */
+static void
+switch_rx_phy(uint8_t mode)
+{
+  if(mode == phy_current) {
+    return;
+  }
+
+  rx_off_prop();
+  set_phy(mode);
+  rx_on_prop();
+}
+/*---------------------------------------------------------------------------*/
+static void
+phy_switch_timeout(void *ptr)
+{
+  PRINTF("phy_switch_timeout: no frame after mode switch\n");
+  if(rf_is_on()) {
+    switch_rx_phy(phy_rx);
+  }
+}
+/*---------------------------------------------------------------------------*/
+#if PROP_MODE_LINK_ADAPTATION
+/* The PHY mode for the frame in packetbuf, of length len */
+static uint8_t
+select_phy(unsigned short len)
+{
+  const linkaddr_t *dest = packetbuf_addr(PACKETBUF_ADDR_RECEIVER);
+  const struct link_stats *stats;
+#if LINK_STATS_WITH_CHANNELS
+  const struct link_stats_channel *cstats;
+#endif
+  int mode;
+
+  if(len < PHY_SWITCH_MIN_LEN || linkaddr_cmp(dest, &linkaddr_null)) {
+    return phy_rx;
+  }
+
+  stats = link_stats_from_lladdr(dest);
+  if(stats == NULL || !link_stats_is_fresh(stats)) {
+    return phy_rx;
+  }
+
+  /* Modes are sorted from the slowest to the fastest */
+  for(mode = SMARTRF_SETTINGS_PHY_COUNT - 1; mode > phy_rx; mode--) {
+    if(stats->rssi < phy_min_rssi[mode]) {
+      continue;
+    }
+#if LINK_STATS_WITH_CHANNELS
+    /* Needs LINK_STATS_CONF_PHY_MODE() to give PACKETBUF_ATTR_PHY_MODE */
+    cstats = link_stats_get_channel(stats, link_stats_radio_channel(), mode + 1);
+    if(cstats != NULL && link_stats_channel_is_fresh(cstats) &&
+       cstats->etx > PHY_MAX_ETX) {
+      continue;
+    }
+#else /* LINK_STATS_WITH_CHANNELS */
+    if(link_stats_get_etx(stats) > PHY_MAX_ETX) {
+      continue;
+    }
+#endif /* LINK_STATS_WITH_CHANNELS */
+    return mode;
+  }
+
+  return phy_rx;
+}
+#endif /* PROP_MODE_LINK_ADAPTATION */
+/*---------------------------------------------------------------------------*/
 static const rf_core_primary_mode_t mode_prop = {
   soft_off_prop,
   soft_on_prop,
@@ -627,37 +786,32 @@ prepare(const void *payload, unsigned short payload_len)
   return 0;
 }
 /*---------------------------------------------------------------------------*/
+/*
+ * Send the frame in buf, which has room for the PHY HDR, and wait until it
+ * has been sent. RX must be off
+ */
 static int
-transmit(unsigned short transmit_len)
+tx_frame(uint8_t *buf, unsigned short transmit_len)
 {
   int ret;
-  uint8_t was_off = 0;
   uint32_t cmd_status;
   volatile rfc_CMD_PROP_TX_ADV_t *cmd_tx_adv;
 
   /* Length in .15.4g PHY HDR. Includes the CRC but not the HDR itself */
   uint16_t total_length;
 
-  if(!rf_is_on()) {
-    was_off = 1;
-    if(on() != RF_CORE_CMD_OK) {
-      PRINTF("transmit: on() failed\n");
-      return RADIO_TX_ERR;
-    }
-  }
-
   /*
    * Prepare the .15.4g PHY header
    * MS=0, Length MSBits=0, DW and CRC configurable
    * Total length = transmit_len (payload) + CRC length
    *
-   * The Radio will flip the bits around, so tx_buf[0] must have the length
-   * LSBs (PHR[15:8] and tx_buf[1] will have PHR[7:0]
+   * The Radio will flip the bits around, so buf[0] must have the length
+   * LSBs (PHR[15:8] and buf[1] will have PHR[7:0]
    */
   total_length = transmit_len + CRC_LEN;
 
-  tx_buf[0] = total_length & 0xFF;
-  tx_buf[1] = (total_length >> 8) + DOT_4G_PHR_DW_BIT + DOT_4G_PHR_CRC_BIT;
+  buf[0] = total_length & 0xFF;
+  buf[1] = (total_length >> 8) + DOT_4G_PHR_DW_BIT + DOT_4G_PHR_CRC_BIT;
 
   /* Prepare the CMD_PROP_TX_ADV command */
   cmd_tx_adv = (rfc_CMD_PROP_TX_ADV_t *)&smartrf_settings_cmd_prop_tx_adv;
@@ -667,13 +821,7 @@ transmit(unsigned short transmit_len)
    * one exists, but not including the CRC (which is not present in the buffer)
    */
   cmd_tx_adv->pktLen = transmit_len + DOT_4G_PHR_LEN;
-  cmd_tx_adv->pPkt = tx_buf;
-
-  /* Abort RX */
-  rx_off_prop();
-
-  /* Enable the LAST_COMMAND_DONE interrupt to wake us up */
-  rf_core_cmd_done_en(false, false);
+  cmd_tx_adv->pPkt = buf;
 
   ret = rf_core_send_cmd((uint32_t)cmd_tx_adv, &cmd_status);
 
@@ -714,15 +862,70 @@ transmit(unsigned short transmit_len)
   ENERGEST_OFF(ENERGEST_TYPE_TRANSMIT);
   ENERGEST_ON(ENERGEST_TYPE_LISTEN);
 
+  /* Workaround. Set status to IDLE */
+  cmd_tx_adv->status = RF_CORE_RADIO_OP_STATUS_IDLE;
+
+  return ret;
+}
+/*---------------------------------------------------------------------------*/
+static int
+transmit(unsigned short transmit_len)
+{
+  int ret;
+  uint8_t was_off = 0;
+  uint8_t mode = phy_rx;
+  rtimer_clock_t t0;
+
+  if(!rf_is_on()) {
+    was_off = 1;
+    if(on() != RF_CORE_CMD_OK) {
+      PRINTF("transmit: on() failed\n");
+      return RADIO_TX_ERR;
+    }
+  }
+
+#if PROP_MODE_LINK_ADAPTATION
+  mode = select_phy(transmit_len);
+#endif
+
+  /* Abort RX */
+  rx_off_prop();
+
+  /* Enable the LAST_COMMAND_DONE interrupt to wake us up */
+  rf_core_cmd_done_en(false, false);
+
+  /* We may have been waiting for a frame after a mode switch */
+  ctimer_stop(&phy_switch_timer);
+  set_phy(phy_rx);
+
+  ret = RADIO_TX_OK;
+  if(mode != phy_rx) {
+    /* Tell the receivers, then give them time to switch too */
+    switch_buf[TX_BUF_HDR_LEN] = mode;
+    switch_buf[TX_BUF_HDR_LEN + 1] = ~mode;
+    ret = tx_frame(switch_buf, PHY_SWITCH_LEN);
+    t0 = RTIMER_NOW();
+    if(ret == RADIO_TX_OK && set_phy(mode) == RF_CORE_CMD_OK) {
+      packetbuf_set_attr(PACKETBUF_ATTR_PHY_MODE, mode + 1);
+      while(RTIMER_CLOCK_LT(RTIMER_NOW(), t0 + PHY_SWITCH_GUARD));
+    } else {
+      ret = RADIO_TX_ERR;
+    }
+  }
+
+  if(ret == RADIO_TX_OK) {
+    ret = tx_frame(tx_buf, transmit_len);
+  }
+
+  /* Back to the mode we listen with, e.g. for the ACK */
+  set_phy(phy_rx);
+
   /*
    * Disable LAST_FG_COMMAND_DONE interrupt. We don't really care about it
    * except when we are transmitting
    */
   rf_core_cmd_done_dis(false);
 
-  /* Workaround. Set status to IDLE */
-  cmd_tx_adv->status = RF_CORE_RADIO_OP_STATUS_IDLE;
-
   rx_on_prop();
 
   if(was_off) {
@@ -744,6 +947,7 @@ read_frame(void *buf, unsigned short buf_len)
 {
   rfc_dataEntryGeneral_t *entry = (rfc_dataEntryGeneral_t *)rx_read_entry;
   uint8_t *data_ptr = &entry->data;
+  uint8_t mode;
   int len = 0;
 
   if(entry->status == DATA_ENTRY_STATUS_FINISHED) {
@@ -757,6 +961,18 @@ read_frame(void *buf, unsigned short buf_len)
     data_ptr += 2;
     len -= 2;
 
+    if(len == PHY_SWITCH_LEN && data_ptr[0] < SMARTRF_SETTINGS_PHY_COUNT &&
+       data_ptr[1] == (uint8_t)~data_ptr[0]) {
+      /* A mode switch frame: receive the next frame with the new mode */
+      mode = data_ptr[0];
+      rx_read_entry = entry->pNextEntry;
+      entry->status = DATA_ENTRY_STATUS_PENDING;
+
+      switch_rx_phy(mode);
+      ctimer_set(&phy_switch_timer, PHY_SWITCH_TIMEOUT, phy_switch_timeout, NULL);
+      return 0;
+    }
+
     if(len > 0) {
       if(len <= buf_len) {
         memcpy(buf, data_ptr, len);
@@ -764,11 +980,20 @@ read_frame(void *buf, unsigned short buf_len)
 
       packetbuf_set_attr(PACKETBUF_ATTR_RSSI, (int8_t)data_ptr[len]);
       packetbuf_set_attr(PACKETBUF_ATTR_LINK_QUALITY, 0x7F);
+      if(phy_current != phy_rx) {
+        packetbuf_set_attr(PACKETBUF_ATTR_PHY_MODE, phy_current + 1);
+      }
     }
 
     /* Move read entry pointer to next entry */
     rx_read_entry = entry->pNextEntry;
     entry->status = DATA_ENTRY_STATUS_PENDING;
+
+    if(phy_current != phy_rx) {
+      /* Back to the mode we listen with, e.g. to send the ACK */
+      ctimer_stop(&phy_switch_timer);
+      switch_rx_phy(phy_rx);
+    }
   }
 
   return len;
@@ -940,6 +1165,10 @@ off(void)
   rx_off_prop();
   rf_core_power_down();
 
+  /* The next on() sets the RF core up for the mode we listen with */
+  ctimer_stop(&phy_switch_timer);
+  phy_current = phy_rx;
+
   ENERGEST_OFF(ENERGEST_TYPE_LISTEN);
 
   /* Switch HF clock source to the RCOSC to preserve power */
@@ -978,6 +1207,9 @@ get_value(radio_param_t param, radio_value_t *value)
   case RADIO_PARAM_CCA_THRESHOLD:
     *value = rssi_threshold;
     return RADIO_RESULT_OK;
+  case RADIO_PARAM_PHY_MODE:
+    *value = phy_rx;
+    return RADIO_RESULT_OK;
   case RADIO_PARAM_RSSI:
     *value = get_rssi();
 
@@ -1057,6 +1289,14 @@ set_value(radio_param_t param, radio_value_t value)
   case RADIO_PARAM_CCA_THRESHOLD:
     rssi_threshold = (int8_t)value;
     break;
+  case RADIO_PARAM_PHY_MODE:
+    if(value < 0 || value >= SMARTRF_SETTINGS_PHY_COUNT) {
+      return RADIO_RESULT_INVALID_VALUE;
+    }
+    ctimer_stop(&phy_switch_timer);
+    phy_rx = (uint8_t)value;
+    phy_current = phy_rx;
+    break;
   default:
     return RADIO_RESULT_NOT_SUPPORTED;
   }
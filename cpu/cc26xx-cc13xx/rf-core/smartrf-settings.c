@@ -100,6 +100,18 @@ rfc_CMD_PROP_RADIO_DIV_SETUP_t smartrf_settings_cmd_prop_radio_div_setup =
   .loDivider = 0x05,
 };
 /*---------------------------------------------------------------------------*/
+/*
+ * PHY modes. The first one is the setup above. The others are applied to
+ * it by the driver when switching modes, keeping the overrides
+ */
+const smartrf_settings_phy_t smartrf_settings_phy[SMARTRF_SETTINGS_PHY_COUNT] =
+{
+  /* 50 kbps, 25 kHz deviation, 98 kHz RX bandwidth */
+  { 0x64, 0xf, 0x08000, 0x24, 0x3 },
+  /* 200 kbps, 50 kHz deviation, 311 kHz RX bandwidth */
+  { 0xc8, 0xf, 0x20000, 0x29, 0x4 },
+};
+/*---------------------------------------------------------------------------*/
 /* CMD_FS */
 rfc_CMD_FS_t smartrf_settings_cmd_fs =
 {
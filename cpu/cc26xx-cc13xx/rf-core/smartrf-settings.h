@@ -40,5 +40,21 @@ extern rfc_CMD_FS_t smartrf_settings_cmd_fs;
 extern rfc_CMD_PROP_TX_ADV_t smartrf_settings_cmd_prop_tx_adv;
 extern rfc_CMD_PROP_RX_ADV_t smartrf_settings_cmd_prop_rx_adv;
 /*---------------------------------------------------------------------------*/
+/* PHY modes of the proprietary mode, indices of smartrf_settings_phy[] */
+#define SMARTRF_SETTINGS_PHY_50KBPS      0 /* 2-GFSK, 25 kHz deviation */
+#define SMARTRF_SETTINGS_PHY_200KBPS     1 /* 2-GFSK, 50 kHz deviation */
+#define SMARTRF_SETTINGS_PHY_COUNT       2
+
+/* The CMD_PROP_RADIO_DIV_SETUP fields that differ between PHY modes */
+typedef struct smartrf_settings_phy {
+  uint16_t deviation;      /* 250 Hz steps */
+  uint8_t pre_scale;
+  uint32_t rate_word;
+  uint8_t rx_bw;
+  uint8_t preamble_bytes;
+} smartrf_settings_phy_t;
+
+extern const smartrf_settings_phy_t smartrf_settings_phy[SMARTRF_SETTINGS_PHY_COUNT];
+/*---------------------------------------------------------------------------*/
 #endif // SMARTRF_SETTINGS_H_
 /*---------------------------------------------------------------------------*/
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \file
+ *         crc16_data() with the CRC module of the MSP430 families that
+ *         have one (see CRC16_CONF_ARCH_DATA).
+ *
+ *         The module computes the CRC-CCITT over bytes written to CRCDI
+ *         least significant bit first, which is the bit order of
+ *         crc16_add(). Its register holds the checksum in the reverse bit
+ *         order, as read back from CRCRESR.
+ */
+
+#include "contiki.h"
+#include "lib/crc16.h"
+
+#ifdef __MSP430_HAS_CRC__
+
+/* Bytes checksummed with interrupts off; the module is shared with the
+ * interrupt handlers that may call crc16_data() */
+#define CHUNK 32
+/*---------------------------------------------------------------------------*/
+static unsigned short
+reverse(unsigned short v)
+{
+  unsigned short r;
+  int i;
+
+  r = 0;
+  for(i = 0; i < 16; i++) {
+    r = (r << 1) | (v & 1);
+    v >>= 1;
+  }
+  return r;
+}
+/*---------------------------------------------------------------------------*/
+unsigned short
+crc16_data_arch(const unsigned char *data, int len, unsigned short acc)
+{
+  const unsigned char *end;
+  spl_t s;
+
+  while(len > 0) {
+    end = data + (len < CHUNK ? len : CHUNK);
+    len -= end - data;
+    s = splhigh();
+    CRCINIRES = reverse(acc);
+    while(data < end) {
+      CRCDI_L = *data++;
+    }
+    acc = CRCRESR;
+    splx(s);
+  }
+  return acc;
+}
+/*---------------------------------------------------------------------------*/
+#endif /* __MSP430_HAS_CRC__ */
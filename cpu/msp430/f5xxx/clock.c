@@ -33,6 +33,7 @@
 #include "sys/energest.h"
 #include "sys/clock.h"
 #include "sys/etimer.h"
+#include "sys/wakeup.h"
 #include "rtimer-arch.h"
 #include "dev/watchdog.h"
 #include "isr_compat.h"
@@ -46,8 +47,17 @@
 static volatile unsigned long seconds;
 
 static volatile clock_time_t count = 0;
-/* last_tar is used for calculating clock_fine, last_ccr might be better? */
-static volatile uint16_t last_tar = 0;
+/* Timer value of the next clock tick. The clock interrupt fires then,
+ * unless the system sleeps and needs no tick before the wake-up time
+ * (see clock_arch_set_wakeup()). Missed ticks are counted when the
+ * clock is read */
+static volatile uint16_t next_tick = INTERVAL;
+static volatile uint16_t wakeup_tick;
+static volatile uint8_t skipping_ticks;
+
+/* Ticks skipped at most in a row, so that the timer does not wrap
+ * and energest is flushed often enough */
+#define MAX_SKIPPED_TICKS (CLOCK_SECOND / 2)
 /*---------------------------------------------------------------------------*/
 static inline uint16_t
 read_tar(void)
@@ -61,6 +71,43 @@ read_tar(void)
   return t1;
 }
 /*---------------------------------------------------------------------------*/
+/* Count the ticks elapsed up to now. Called with interrupts disabled */
+static void
+update_count(void)
+{
+  uint16_t now = read_tar();
+  while(!CLOCK_LT(now, next_tick)) {
+    next_tick += INTERVAL;
+    ++count;
+
+    /* Make sure the CLOCK_CONF_SECOND is a power of two, to ensure
+       that the modulo operation below becomes a logical and and not
+       an expensive divide. Algorithm from Wikipedia:
+       http://en.wikipedia.org/wiki/Power_of_two */
+#if (CLOCK_CONF_SECOND & (CLOCK_CONF_SECOND - 1)) != 0
+#error CLOCK_CONF_SECOND must be a power of two (i.e., 1, 2, 4, 8, 16, 32, 64, ...).
+#error Change CLOCK_CONF_SECOND in contiki-conf.h.
+#endif
+    if(count % CLOCK_CONF_SECOND == 0) {
+      ++seconds;
+      energest_flush();
+    }
+    now = read_tar();
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Back to an interrupt on every tick. Called with interrupts disabled */
+static void
+resume_ticks(void)
+{
+  skipping_ticks = 0;
+  do {
+    update_count();
+    TA1CCR1 = next_tick;
+    /* Make sure interrupt time is future */
+  } while(!CLOCK_LT(read_tar(), next_tick));
+}
+/*---------------------------------------------------------------------------*/
 ISR(TIMER1_A1, timera1)
 {
   ENERGEST_ON(ENERGEST_TYPE_IRQ);
@@ -73,25 +120,11 @@ ISR(TIMER1_A1, timera1)
      * Occurs when timer state is toggled between STOP and CONT. */
     while(TA1CTL & MC1 && TA1CCR1 - TA1R == 1);
 
-    last_tar = read_tar();
-    /* Make sure interrupt time is future */
-    while(!CLOCK_LT(last_tar, TA1CCR1)) {
-      TA1CCR1 += INTERVAL;
-      ++count;
-
-      /* Make sure the CLOCK_CONF_SECOND is a power of two, to ensure
-         that the modulo operation below becomes a logical and and not
-         an expensive divide. Algorithm from Wikipedia:
-         http://en.wikipedia.org/wiki/Power_of_two */
-#if (CLOCK_CONF_SECOND & (CLOCK_CONF_SECOND - 1)) != 0
-#error CLOCK_CONF_SECOND must be a power of two (i.e., 1, 2, 4, 8, 16, 32, 64, ...).
-#error Change CLOCK_CONF_SECOND in contiki-conf.h.
-#endif
-      if(count % CLOCK_CONF_SECOND == 0) {
-        ++seconds;
-        energest_flush();
-      }
-      last_tar = read_tar();
+    if(skipping_ticks && CLOCK_LT(read_tar(), wakeup_tick)) {
+      /* Spurious interrupt ahead of the wake-up time, keep sleeping */
+      TA1CCR1 = wakeup_tick;
+    } else {
+      resume_ticks();
     }
 
     if(etimer_pending() &&
@@ -113,12 +146,13 @@ ISR(TIMER1_A1, timera1)
 clock_time_t
 clock_time(void)
 {
-  clock_time_t t1, t2;
-  do {
-    t1 = count;
-    t2 = count;
-  } while(t1 != t2);
-  return t1;
+  clock_time_t t;
+  int s;
+  s = splhigh();
+  update_count();
+  t = count;
+  splx(s);
+  return t;
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -126,6 +160,8 @@ clock_set(clock_time_t clock, clock_time_t fclock)
 {
   TA1R = fclock;
   TA1CCR1 = fclock + INTERVAL;
+  next_tick = fclock + INTERVAL;
+  skipping_ticks = 0;
   count = clock;
 }
 /*---------------------------------------------------------------------------*/
@@ -139,10 +175,13 @@ unsigned short
 clock_fine(void)
 {
   unsigned short t;
-  /* Assign last_tar to local varible that can not be changed by interrupt */
-  t = last_tar;
-  /* perform calc based on t, TAR will not be changed during interrupt */
-  return (unsigned short) (TA1R - t);
+  int s;
+  s = splhigh();
+  update_count();
+  /* Time elapsed since the last tick */
+  t = (unsigned short)(TA1R - (next_tick - INTERVAL));
+  splx(s);
+  return t;
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -175,6 +214,8 @@ clock_init(void)
   TA1CTL |= MC1;
 
   count = 0;
+  next_tick = INTERVAL;
+  skipping_ticks = 0;
 
   /* Enable interrupts. */
   eint();
@@ -217,12 +258,36 @@ clock_set_seconds(unsigned long sec)
 unsigned long
 clock_seconds(void)
 {
-  unsigned long t1, t2;
-  do {
-    t1 = seconds;
-    t2 = seconds;
-  } while(t1 != t2);
-  return t1;
+  unsigned long t;
+  int s;
+  s = splhigh();
+  update_count();
+  t = seconds;
+  splx(s);
+  return t;
+}
+/*---------------------------------------------------------------------------*/
+void
+clock_arch_set_wakeup(rtimer_clock_t t)
+{
+  uint16_t ticks;
+  int s;
+  s = splhigh();
+  update_count();
+  if(CLOCK_LT(next_tick + INTERVAL, t)) {
+    /* Skip the ticks before the last one at or before t, which is when
+       etimers expire */
+    ticks = (uint16_t)(t - next_tick) / INTERVAL;
+    if(ticks > MAX_SKIPPED_TICKS) {
+      ticks = MAX_SKIPPED_TICKS;
+    }
+    wakeup_tick = next_tick + ticks * INTERVAL;
+    skipping_ticks = 1;
+    TA1CCR1 = wakeup_tick;
+  } else if(skipping_ticks) {
+    resume_ticks();
+  }
+  splx(s);
 }
 /*---------------------------------------------------------------------------*/
 rtimer_clock_t
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Packet copies for MSP430 (see CONTIKI_ARCH_MEMCPY), which move a
+ *         word at a time when the two buffers have the same alignment.
+ *
+ *         Block DMA transfers stop the CPU on the MSP430 and take about as
+ *         long per word as this loop, so they are not worth their setup
+ *         here.
+ */
+
+#include "contiki.h"
+
+#include <stdint.h>
+#include <string.h>
+/*---------------------------------------------------------------------------*/
+void *
+memcpy_arch(void *dst, const void *src, size_t len)
+{
+  uint8_t *d = dst;
+  const uint8_t *s = src;
+  uint16_t *dw;
+  const uint16_t *sw;
+
+  if((((uintptr_t)d ^ (uintptr_t)s) & 1) == 0 && len >= 4) {
+    if((uintptr_t)d & 1) {
+      *d++ = *s++;
+      len--;
+    }
+    dw = (uint16_t *)d;
+    sw = (const uint16_t *)s;
+    for(; len >= 2; len -= 2) {
+      *dw++ = *sw++;
+    }
+    d = (uint8_t *)dw;
+    s = (const uint8_t *)sw;
+  }
+  while(len-- > 0) {
+    *d++ = *s++;
+  }
+  return dst;
+}
+/*---------------------------------------------------------------------------*/
+void *
+memset_arch(void *dst, int c, size_t len)
+{
+  uint8_t *d = dst;
+  uint16_t *dw;
+  uint16_t w;
+
+  if(len >= 4) {
+    if((uintptr_t)d & 1) {
+      *d++ = c;
+      len--;
+    }
+    w = (uint8_t)c | (uint16_t)(uint8_t)c << 8;
+    dw = (uint16_t *)d;
+    for(; len >= 2; len -= 2) {
+      *dw++ = w;
+    }
+    d = (uint8_t *)dw;
+  }
+  while(len-- > 0) {
+    *d++ = c;
+  }
+  return dst;
+}
+/*---------------------------------------------------------------------------*/
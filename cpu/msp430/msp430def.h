@@ -120,6 +120,19 @@ void *w_memset(void *out, int value, size_t n);
 #endif /* __GNUC__ &&  __MSP430__ && MSP430_MEMCPY_WORKAROUND */
 
 
+/* Packet copies a word at a time, see memcpy-arch.c */
+#ifndef CONTIKI_ARCH_CONF_MEMCPY
+#define CONTIKI_ARCH_CONF_MEMCPY memcpy_arch
+#endif
+#ifndef CONTIKI_ARCH_CONF_MEMSET
+#define CONTIKI_ARCH_CONF_MEMSET memset_arch
+#endif
+
+/* CRC16 with the CRC module where there is one, see crc16-arch.c */
+#if defined(__MSP430_HAS_CRC__) && !defined(CRC16_CONF_ARCH_DATA)
+#define CRC16_CONF_ARCH_DATA crc16_data_arch
+#endif
+
 /* Moved from the msp430.h file with other msp430 related defines */
 
 #ifdef F_CPU
@@ -34,6 +34,12 @@
  * \file
  *         A MAC protocol implementation that uses nRF52 IPSP implementation
  *         as a link layer.
+ *
+ *         Outgoing packets are queued, and as many as each connection has
+ *         room for are handed to IPSP at once, so that the SoftDevice can
+ *         send several of them in the same connection event. A connection
+ *         that is out of L2CAP credits or SoftDevice buffers is retried
+ *         once a packet has been sent on it, or after a while.
  * \author
  *         Wojciech Bober <wojciech.bober@nordicsemi.no>
  */
@@ -42,6 +48,7 @@
 #include "app_error.h"
 #include "ble_ipsp.h"
 #include "nrf_soc.h"
+#include "nrf_error.h"
 #include "iot_defines.h"
 
 #include "net/mac/nullmac.h"
@@ -51,8 +58,9 @@
 #include "net/packetbuf.h"
 #include "net/netstack.h"
 #include "net/linkaddr.h"
-
-#include "dev/watchdog.h"
+#include "lib/list.h"
+#include "lib/memb.h"
+#include "sys/ctimer.h"
 
 #define DEBUG 0
 #if DEBUG
@@ -66,6 +74,30 @@
 #define BLE_MAC_MAX_INTERFACE_NUM 1 /**< Maximum number of interfaces, i.e., connection to master devices */
 #endif
 
+#if BLE_MAC_MAX_INTERFACE_NUM > 8
+#error "BLE_MAC_MAX_INTERFACE_NUM must be at most 8"
+#endif
+
+#ifdef BLE_MAC_CONF_TX_QUEUE_LEN
+#define BLE_MAC_TX_QUEUE_LEN BLE_MAC_CONF_TX_QUEUE_LEN
+#else
+#define BLE_MAC_TX_QUEUE_LEN 4 /**< Outgoing packets, queued or being sent */
+#endif
+
+#ifdef BLE_MAC_CONF_MAX_INFLIGHT
+#define BLE_MAC_MAX_INFLIGHT BLE_MAC_CONF_MAX_INFLIGHT
+#else
+#define BLE_MAC_MAX_INFLIGHT 3 /**< Packets handed to IPSP at once on a connection */
+#endif
+
+#ifdef BLE_MAC_CONF_TX_TIMEOUT
+#define BLE_MAC_TX_TIMEOUT BLE_MAC_CONF_TX_TIMEOUT
+#else
+#define BLE_MAC_TX_TIMEOUT CLOCK_SECOND /**< How long a packet may wait for a connection to take it */
+#endif
+
+#define BLE_MAC_RETRY_INTERVAL (CLOCK_SECOND / 32)
+
 /*---------------------------------------------------------------------------*/
 process_event_t ble_event_interface_added; /**< This event is broadcast when BLE connection is established */
 process_event_t ble_event_interface_deleted; /**< This event is broadcast when BLE connection is destroyed */
@@ -84,7 +116,40 @@ typedef struct {
 
 static ble_mac_interface_t interfaces[BLE_MAC_MAX_INTERFACE_NUM];
 
-static volatile int busy_tx; /**< Flag is set to 1 when the driver is busy transmitting a packet. */
+/**
+ * \brief An outgoing packet.
+ */
+struct tx_packet {
+  struct tx_packet *next;
+  mac_callback_t sent;
+  void *ptr;
+  clock_time_t queued;
+  uint16_t len;
+  uint8_t todo;     /**< Interfaces the packet is still to be handed to, one bit each */
+  uint8_t inflight; /**< Interfaces the packet is being sent on */
+  uint8_t status;
+  uint8_t data[PACKETBUF_SIZE];
+};
+
+/**
+ * \brief The packets handed to IPSP on an interface, in the order they
+ * are sent. Only the counters are written from interrupt context.
+ */
+typedef struct {
+  struct tx_packet *inflight[BLE_MAC_MAX_INFLIGHT];
+  uint8_t first;
+  uint8_t count;
+  uint8_t consumed;
+  volatile uint8_t completed; /**< TX complete events so far */
+  volatile uint8_t reset;     /**< Set when the connection is lost */
+} ble_mac_tx_state_t;
+
+static ble_mac_tx_state_t tx_state[BLE_MAC_MAX_INTERFACE_NUM];
+
+MEMB(tx_memb, struct tx_packet, BLE_MAC_TX_QUEUE_LEN);
+LIST(tx_queue);
+static struct ctimer retry_timer;
+
 static volatile int busy_rx; /**< Flag is set to 1 when there is a received packet pending. */
 
 struct {
@@ -94,9 +159,6 @@ struct {
   int8_t rssi;
 } input_packet;
 
-static mac_callback_t mac_sent_cb;
-static void *mac_sent_ptr;
-
 /*---------------------------------------------------------------------------*/
 /**
  * \brief Lookup interface by IPSP connection.
@@ -151,6 +213,7 @@ ble_mac_interface_add(eui64_t *peer, ble_ipsp_handle_t *handle)
 static void
 ble_mac_interface_delete(ble_mac_interface_t *interface)
 {
+  tx_state[interface - interfaces].reset = 1;
   memset(interface, 0, sizeof(ble_mac_interface_t));
   process_post(PROCESS_BROADCAST, ble_event_interface_deleted, NULL);
 }
@@ -237,7 +300,10 @@ ble_mac_ipsp_evt_handler_irq(ble_ipsp_handle_t *p_handle, ble_ipsp_evt_t *p_evt)
 
     case BLE_IPSP_EVT_CHANNEL_DATA_TX_COMPLETE: {
       PRINTF("ble-mac: data transmitted\n");
-      busy_tx = 0;
+      if(p_instance != NULL) {
+        tx_state[p_instance - interfaces].completed++;
+        process_poll(&ble_ipsp_process);
+      }
       break;
     }
   }
@@ -245,94 +311,203 @@ ble_mac_ipsp_evt_handler_irq(ble_ipsp_handle_t *p_handle, ble_ipsp_evt_t *p_evt)
   return retval;
 }
 /*---------------------------------------------------------------------------*/
-PROCESS_THREAD(ble_ipsp_process, ev, data)
+/**
+ * \brief Retry the interfaces that were out of credits or buffers.
+ */
+static void
+retry(void *ptr)
 {
-  PROCESS_BEGIN();
-
-  while(1) {
-    PROCESS_WAIT_EVENT();
-    if(ev == PROCESS_EVENT_POLL) {
-      packetbuf_copyfrom(input_packet.payload, input_packet.len);
-      packetbuf_set_attr(PACKETBUF_ATTR_RSSI, input_packet.rssi);
-      packetbuf_set_addr(PACKETBUF_ADDR_SENDER, (const linkaddr_t *)input_packet.src.identifier);
-      packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &linkaddr_node_addr);
-      busy_rx = 0;
-      NETSTACK_LLSEC.input();
+  process_poll(&ble_ipsp_process);
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Account for the packets that IPSP is done with on an interface.
+ * \param s a pointer to the TX state of the interface
+ */
+static void
+tx_account(ble_mac_tx_state_t *s)
+{
+  struct tx_packet *p;
+  uint8_t completed;
+
+  if(s->reset) {
+    s->reset = 0;
+    /* No TX complete events will come for these */
+    while(s->count > 0) {
+      p = s->inflight[s->first];
+      p->inflight--;
+      p->status = MAC_TX_ERR;
+      s->first = (s->first + 1) % BLE_MAC_MAX_INFLIGHT;
+      s->count--;
     }
+    s->consumed = s->completed;
+    return;
   }
 
-  PROCESS_END();
+  completed = s->completed;
+  while(s->consumed != completed && s->count > 0) {
+    p = s->inflight[s->first];
+    p->inflight--;
+    s->first = (s->first + 1) % BLE_MAC_MAX_INFLIGHT;
+    s->count--;
+    s->consumed++;
+  }
+  s->consumed = completed;
 }
-
 /*---------------------------------------------------------------------------*/
 /**
- * \brief Lookup IPSP handle by peer address.
- *
- * \param addr a pointer to eui64 address.
- * \retval a pointer to IPSP handle on success
- * \retval NULL if an IPSP handle for given address haven't been found
+ * \brief Hand queued packets to IPSP, in order on each interface and as
+ * many as the interface has room for, and report the packets that have
+ * been sent.
  */
-static ble_ipsp_handle_t *
-find_handle(const linkaddr_t *addr)
+static void
+tx_service(void)
 {
+  struct tx_packet *p, *next;
+  ble_mac_tx_state_t *s;
+  mac_callback_t sent;
+  void *ptr;
+  uint8_t blocked = 0;
+  uint8_t bit, status;
+  uint32_t err;
   int i;
+
   for(i = 0; i < BLE_MAC_MAX_INTERFACE_NUM; i++) {
-    if(linkaddr_cmp((const linkaddr_t *)&interfaces[i].peer_addr, addr)) {
-      return &interfaces[i].handle;
+    tx_account(&tx_state[i]);
+  }
+
+  for(p = list_head(tx_queue); p != NULL; p = list_item_next(p)) {
+    for(i = 0; i < BLE_MAC_MAX_INTERFACE_NUM; i++) {
+      bit = 1 << i;
+      s = &tx_state[i];
+      if(!(p->todo & bit) || (blocked & bit)) {
+        continue;
+      }
+      if(interfaces[i].handle.cid == 0 || interfaces[i].handle.conn_handle == 0) {
+        p->todo &= ~bit;
+        p->status = MAC_TX_ERR;
+        continue;
+      }
+      if(s->count == BLE_MAC_MAX_INFLIGHT) {
+        blocked |= bit;
+        continue;
+      }
+      PRINTF("ble-mac: sending packet[GAP handle:%d CID:0x%04X]\n",
+             interfaces[i].handle.conn_handle, interfaces[i].handle.cid);
+      err = ble_ipsp_send(&interfaces[i].handle, p->data, p->len);
+      if(err == NRF_SUCCESS) {
+        s->inflight[(s->first + s->count) % BLE_MAC_MAX_INFLIGHT] = p;
+        s->count++;
+        p->inflight++;
+        p->todo &= ~bit;
+      } else if(err == NRF_ERROR_NO_MEM || err == NRF_ERROR_BUSY) {
+        /* Out of L2CAP credits or SoftDevice buffers: keep the order */
+        PRINTF("ble-mac: interface %d is flow controlled\n", i);
+        blocked |= bit;
+      } else {
+        PRINTF("ble-mac: send failed, error %lu\n", (unsigned long)err);
+        p->todo &= ~bit;
+        p->status = MAC_TX_ERR;
+      }
     }
   }
-  return NULL;
+
+  for(p = list_head(tx_queue); p != NULL; p = next) {
+    next = list_item_next(p);
+    if(p->todo != 0 &&
+       clock_time() - p->queued > BLE_MAC_TX_TIMEOUT) {
+      PRINTF("ble-mac: packet timed out\n");
+      p->todo = 0;
+      p->status = MAC_TX_ERR;
+    }
+    if(p->todo == 0 && p->inflight == 0) {
+      sent = p->sent;
+      ptr = p->ptr;
+      status = p->status;
+      list_remove(tx_queue, p);
+      memb_free(&tx_memb, p);
+      mac_call_sent_callback(sent, ptr, status, 1);
+    }
+  }
+
+  if(blocked) {
+    /* Credits may come without any packet completing */
+    ctimer_set(&retry_timer, BLE_MAC_RETRY_INTERVAL, retry, NULL);
+  }
 }
 /*---------------------------------------------------------------------------*/
-/**
- * \brief Send packet on a given IPSP handle.
- *
- * \param handle a pointer to IPSP handle.
- * \return 1 on success, 0 otherwise
- */
-static int
-send_to_peer(ble_ipsp_handle_t *handle)
+PROCESS_THREAD(ble_ipsp_process, ev, data)
 {
-  PRINTF("ble-mac: sending packet[GAP handle:%d CID:0x%04X]\n", handle->conn_handle, handle->cid);
-  return (ble_ipsp_send(handle, packetbuf_dataptr(), packetbuf_datalen()) == NRF_SUCCESS);
+  PROCESS_BEGIN();
+
+  while(1) {
+    PROCESS_WAIT_EVENT();
+    if(ev == PROCESS_EVENT_POLL) {
+      if(busy_rx) {
+        packetbuf_copyfrom(input_packet.payload, input_packet.len);
+        packetbuf_set_attr(PACKETBUF_ATTR_RSSI, input_packet.rssi);
+        packetbuf_set_addr(PACKETBUF_ADDR_SENDER, (const linkaddr_t *)input_packet.src.identifier);
+        packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &linkaddr_node_addr);
+        busy_rx = 0;
+        NETSTACK_LLSEC.input();
+      }
+      tx_service();
+    }
+  }
+
+  PROCESS_END();
 }
+
 /*---------------------------------------------------------------------------*/
+/**
+ * \brief Queue the packet in packetbuf for the interfaces it is for.
+ *
+ * The sent callback is called from the IPSP process once the packet has
+ * been sent on all of them.
+ */
 static void
 send_packet(mac_callback_t sent, void *ptr)
 {
   int i;
   const linkaddr_t *dest;
-  ble_ipsp_handle_t *handle;
-  int ret = 0;
-
-  mac_sent_cb = sent;
-  mac_sent_ptr = ptr;
+  struct tx_packet *p;
+  uint8_t todo = 0;
 
   dest = packetbuf_addr(PACKETBUF_ADDR_RECEIVER);
 
-  if(linkaddr_cmp(dest, &linkaddr_null)) {
-    for(i = 0; i < BLE_MAC_MAX_INTERFACE_NUM; i++) {
-      if(interfaces[i].handle.cid != 0 && interfaces[i].handle.conn_handle != 0) {
-        ret = send_to_peer(&interfaces[i].handle);
-        watchdog_periodic();
-      }
+  for(i = 0; i < BLE_MAC_MAX_INTERFACE_NUM; i++) {
+    if(interfaces[i].handle.cid != 0 && interfaces[i].handle.conn_handle != 0 &&
+       (linkaddr_cmp(dest, &linkaddr_null) ||
+        linkaddr_cmp((const linkaddr_t *)&interfaces[i].peer_addr, dest))) {
+      todo |= 1 << i;
     }
-  } else if((handle = find_handle(dest)) != NULL) {
-    ret = send_to_peer(handle);
-  } else {
-    PRINTF("ble-mac: no connection found for peer");
   }
 
-  if(ret) {
-    busy_tx = 1;
-    while(busy_tx) {
-      watchdog_periodic();
-      sd_app_evt_wait();
-    }
-    mac_call_sent_callback(sent, ptr, MAC_TX_OK, 1);
-  } else {
+  if(todo == 0) {
+    PRINTF("ble-mac: no connection found for peer\n");
     mac_call_sent_callback(sent, ptr, MAC_TX_ERR, 1);
+    return;
   }
+
+  p = memb_alloc(&tx_memb);
+  if(p == NULL) {
+    PRINTF("ble-mac: TX queue is full\n");
+    mac_call_sent_callback(sent, ptr, MAC_TX_ERR, 1);
+    return;
+  }
+
+  p->sent = sent;
+  p->ptr = ptr;
+  p->queued = clock_time();
+  p->len = packetbuf_datalen();
+  memcpy(p->data, packetbuf_dataptr(), p->len);
+  p->todo = todo;
+  p->inflight = 0;
+  p->status = MAC_TX_OK;
+  list_add(tx_queue, p);
+
+  /* Packets queued before the process runs are handed over together */
+  process_poll(&ble_ipsp_process);
 }
 /*---------------------------------------------------------------------------*/
 static int
@@ -368,6 +543,9 @@ init(void)
   ble_event_interface_added = process_alloc_event();
   ble_event_interface_deleted = process_alloc_event();
 
+  memb_init(&tx_memb);
+  list_init(tx_queue);
+
   process_start(&ble_ipsp_process, NULL);
 }
 /*---------------------------------------------------------------------------*/
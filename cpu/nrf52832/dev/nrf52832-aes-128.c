@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \addtogroup nrf52832-aes-128
+ * @{
+ *
+ * \file
+ *         AES-128 on the ECB peripheral of the nRF52.
+ *
+ *         The CCM peripheral of the nRF52 only supports the BLE packet
+ *         format (fixed nonce layout, 4-byte MIC, 1-byte header), so it
+ *         cannot do IEEE 802.15.4 CCM*. The generic CCM* implementation
+ *         runs on top of this driver instead, each AES block taking a few
+ *         microseconds in hardware.
+ */
+#include "contiki.h"
+#include "nrf.h"
+#include "dev/nrf52832-aes-128.h"
+#ifdef SOFTDEVICE_PRESENT
+#include "nrf_soc.h"
+#endif
+#include <string.h>
+
+#ifdef SOFTDEVICE_PRESENT
+/* The SoftDevice owns the ECB peripheral */
+static nrf_ecb_hal_data_t ecb_data;
+#else /* SOFTDEVICE_PRESENT */
+/* Memory layout expected by the ECB peripheral */
+static struct {
+  uint8_t key[AES_128_KEY_LENGTH];
+  uint8_t cleartext[AES_128_BLOCK_SIZE];
+  uint8_t ciphertext[AES_128_BLOCK_SIZE];
+} ecb_data;
+#endif /* SOFTDEVICE_PRESENT */
+/*---------------------------------------------------------------------------*/
+static void
+set_key(const uint8_t *key)
+{
+  memcpy(ecb_data.key, key, AES_128_KEY_LENGTH);
+}
+/*---------------------------------------------------------------------------*/
+static void
+encrypt(uint8_t *plaintext_and_result)
+{
+  memcpy(ecb_data.cleartext, plaintext_and_result, AES_128_BLOCK_SIZE);
+
+#ifdef SOFTDEVICE_PRESENT
+  sd_ecb_block_encrypt(&ecb_data);
+#else /* SOFTDEVICE_PRESENT */
+  NRF_ECB->ECBDATAPTR = (uint32_t)&ecb_data;
+  NRF_ECB->EVENTS_ENDECB = 0;
+  NRF_ECB->EVENTS_ERRORECB = 0;
+  NRF_ECB->TASKS_STARTECB = 1;
+  while(!NRF_ECB->EVENTS_ENDECB && !NRF_ECB->EVENTS_ERRORECB);
+  NRF_ECB->EVENTS_ENDECB = 0;
+#endif /* SOFTDEVICE_PRESENT */
+
+  memcpy(plaintext_and_result, ecb_data.ciphertext, AES_128_BLOCK_SIZE);
+}
+/*---------------------------------------------------------------------------*/
+const struct aes_128_driver nrf52832_aes_128_driver = {
+  set_key,
+  encrypt
+};
+/*---------------------------------------------------------------------------*/
+/**
+ * @}
+ */
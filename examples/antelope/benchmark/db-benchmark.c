@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \file
+ *	Measures how many tuples per second Antelope can process when
+ *	selecting from a synthetic relation with various conditions.
+ */
+
+#include <stdio.h>
+
+#include "contiki.h"
+
+#include "antelope.h"
+#include "relation.h"
+
+#ifndef BENCHMARK_ROWS
+#define BENCHMARK_ROWS	1000
+#endif
+
+static const char *queries[] = {
+  "SELECT id, value FROM bench;",
+  "SELECT id, value FROM bench WHERE value = 500;",
+  "SELECT id, value FROM bench WHERE value > 10 * 25 AND value < 750;",
+  "SELECT id, value FROM bench WHERE value <> 3 AND id = 42;",
+  "SELECT id, value FROM bench WHERE value < 0 OR value > 2 * 2;",
+  "SELECT id, value FROM bench WHERE value * 2 > 1000 AND 1 = 1;"
+};
+
+PROCESS(db_benchmark, "DB benchmark");
+AUTOSTART_PROCESSES(&db_benchmark);
+
+static db_result_t
+create_relation(void)
+{
+  relation_t *rel;
+  attribute_value_t values[2];
+  db_result_t result;
+  int i;
+
+  db_query(NULL, "REMOVE RELATION bench;");
+  if(DB_ERROR(db_query(NULL, "CREATE RELATION bench;")) ||
+     DB_ERROR(db_query(NULL, "CREATE ATTRIBUTE id DOMAIN INT IN bench;")) ||
+     DB_ERROR(db_query(NULL, "CREATE ATTRIBUTE value DOMAIN INT IN bench;"))) {
+    return DB_STORAGE_ERROR;
+  }
+
+  rel = relation_load("bench");
+  if(rel == NULL) {
+    return DB_STORAGE_ERROR;
+  }
+
+  result = relation_batch_begin(rel);
+  for(i = 0; DB_SUCCESS(result) && i < BENCHMARK_ROWS; i++) {
+    values[0].domain = values[1].domain = DOMAIN_INT;
+    VALUE_INT(&values[0]) = i;
+    VALUE_INT(&values[1]) = (i * 7) % BENCHMARK_ROWS;
+    result = relation_insert(rel, values);
+  }
+  if(DB_SUCCESS(result)) {
+    result = relation_batch_commit(rel);
+  } else {
+    relation_batch_abort(rel);
+  }
+
+  relation_release(rel);
+  return result;
+}
+
+PROCESS_THREAD(db_benchmark, ev, data)
+{
+  static db_handle_t handle;
+  static unsigned i;
+  db_result_t result;
+  clock_time_t start;
+  clock_time_t elapsed;
+  unsigned long processed;
+  unsigned long matching;
+
+  PROCESS_BEGIN();
+
+  db_init();
+
+  start = clock_time();
+  result = create_relation();
+  if(DB_ERROR(result)) {
+    printf("Failed to create the relation: %s\n",
+           db_get_result_message(result));
+    PROCESS_EXIT();
+  }
+  elapsed = clock_time() - start;
+  printf("Inserted %u tuples in %lu ms\n", BENCHMARK_ROWS,
+         (unsigned long)elapsed * 1000 / CLOCK_SECOND);
+
+  for(i = 0; i < sizeof(queries) / sizeof(queries[0]); i++) {
+    /* Let other processes run between the measurements. */
+    PROCESS_PAUSE();
+
+    result = db_query(&handle, queries[i]);
+    if(DB_ERROR(result)) {
+      printf("Query \"%s\" failed: %s\n", queries[i],
+             db_get_result_message(result));
+      db_free(&handle);
+      continue;
+    }
+
+    processed = 0;
+    matching = 0;
+    start = clock_time();
+    while(db_processing(&handle)) {
+      result = db_process(&handle);
+      if(result == DB_GOT_ROW) {
+        matching++;
+        processed++;
+      } else if(result == DB_OK) {
+        processed++;
+      } else {
+        if(DB_ERROR(result)) {
+          printf("Processing error: %s\n", db_get_result_message(result));
+        }
+        break;
+      }
+    }
+    elapsed = clock_time() - start;
+    db_free(&handle);
+
+    printf("%s\n  %lu tuples processed, %lu returned, %lu ms",
+           queries[i], processed, matching,
+           (unsigned long)elapsed * 1000 / CLOCK_SECOND);
+    if(elapsed > 0) {
+      printf(", %lu tuples/s", processed * CLOCK_SECOND / elapsed);
+    }
+    printf("\n");
+  }
+
+  printf("Done\n");
+
+  PROCESS_END();
+}
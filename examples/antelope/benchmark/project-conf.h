@@ -0,0 +1,12 @@
+#ifndef PROJECT_CONF_H_
+#define PROJECT_CONF_H_
+
+/* Insert the synthetic tuples in batches. */
+#define DB_FEATURE_BATCH	1
+
+#ifdef CONTIKI_TARGET_NATIVE
+/* The native platform stores the database files with cfs-posix. */
+#define DB_FEATURE_COFFEE	0
+#endif
+
+#endif /* PROJECT_CONF_H_ */
@@ -43,6 +43,7 @@
 #include "er-coap-constants.h"
 #include "er-coap-engine.h"
 #include "lwm2m-engine.h"
+#include "lwm2m-rd-server.h"
 #include "oma-tlv.h"
 #include "dev/serial-line.h"
 #include "serial-protocol.h"
@@ -64,6 +65,9 @@
 
 #define MAX_NODES 10
 
+/* The number of nodes that are asked for their type at the same time */
+#define MAX_DISCOVERIES 3
+
 #define NODE_HAS_TYPE  (1 << 0)
 
 struct node {
@@ -80,7 +84,12 @@ static struct node *current_target;
 static char current_uri[32] = URL_LIGHT_CONTROL;
 static char current_value[32] = "1";
 static int current_request = COAP_PUT;
-static uint8_t fetching_type = 0;
+
+static struct discovery {
+  coap_request_state_t state;
+  coap_packet_t request[1];
+  struct node *node;
+} discoveries[MAX_DISCOVERIES];
 
 PROCESS(router_process, "router process");
 AUTOSTART_PROCESSES(&router_process);
@@ -102,6 +111,21 @@ add_node(const uip_ipaddr_t *addr)
   return NULL;
 }
 /*---------------------------------------------------------------------------*/
+/* Nodes registering with the resource directory need no discovery */
+static void
+rd_callback(const lwm2m_rd_client_t *client, int event)
+{
+  struct node *node;
+
+  if(event == LWM2M_RD_SERVER_REGISTERED) {
+    node = add_node(&client->addr);
+    if(node != NULL) {
+      strncpy(node->type, client->endpoint, sizeof(node->type) - 1);
+      node->flags |= NODE_HAS_TYPE;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
 void
 set_value(const uip_ipaddr_t *addr, char *uri, char *value)
 {
@@ -161,6 +185,66 @@ print_node_list(void)
   printf("\n");
 }
 /*---------------------------------------------------------------------------*/
+static void
+discovery_callback(coap_request_state_t *state)
+{
+  struct discovery *d = state->user_data;
+  const uint8_t *chunk;
+  int len;
+
+  if(state->status == COAP_REQUEST_STATUS_RESPONSE) {
+    len = coap_get_payload(state->response, &chunk);
+    if(len > sizeof(d->node->type) - 1) {
+      len = sizeof(d->node->type) - 1;
+    }
+    memcpy(d->node->type, chunk, len);
+    d->node->type[len] = 0;
+    d->node->flags |= NODE_HAS_TYPE;
+
+    PRINTF("\nNODE ");
+    PRINT6ADDR(&d->node->ipaddr);
+    PRINTF(" HAS TYPE %s\n", d->node->type);
+  } else {
+    /* the request has completed, the next node may be asked */
+    d->node = NULL;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+discover(struct node *node)
+{
+  struct discovery *d = NULL;
+  int i;
+
+  for(i = 0; i < MAX_DISCOVERIES; i++) {
+    if(discoveries[i].node == node) {
+      /* already asked */
+      return;
+    }
+    if(discoveries[i].node == NULL && d == NULL) {
+      d = &discoveries[i];
+    }
+  }
+  if(d == NULL) {
+    return;
+  }
+
+  coap_init_message(d->request, COAP_TYPE_CON, COAP_GET, 0);
+  coap_set_header_uri_path(d->request, URL_DEVICE_MODEL);
+
+  node->retries++;
+
+  PRINTF("CoAP request to [");
+  PRINT6ADDR(&node->ipaddr);
+  PRINTF("]:%u (%u tx)\n", UIP_HTONS(REMOTE_PORT), node->retries);
+
+  d->state.user_data = d;
+  if(coap_send_request(&d->state, &node->ipaddr, REMOTE_PORT, d->request,
+                       discovery_callback)) {
+    d->node = node;
+  }
+}
+/*---------------------------------------------------------------------------*/
 /**
  * This function is will be passed to COAP_BLOCKING_REQUEST() to
  * handle responses.
@@ -176,36 +260,23 @@ client_chunk_handler(void *response)
   /* if(len > 0) { */
   /*   printf("|%.*s (%d,%d)", len, (char *)chunk, len, format); */
   /* } */
-  if(current_target != NULL && fetching_type) {
-    if(len > sizeof(current_target->type) - 1) {
-      len = sizeof(current_target->type) - 1;
+  /* update the current value */
+  if(format == LWM2M_TLV) {
+    oma_tlv_t tlv;
+    /* we can only read int32 for now ? */
+    if(oma_tlv_read(&tlv, chunk, len) > 0) {
+      /* printf("TLV.type=%d len=%d id=%d value[0]=%d\n", */
+      /*        tlv.type, tlv.length, tlv.id, tlv.value[0]); */
+
+      int value = oma_tlv_get_int32(&tlv);
+      snprintf(current_value, sizeof(current_value), "%d", value);
     }
-    memcpy(current_target->type, chunk, len);
-    current_target->type[len] = 0;
-    current_target->flags |= NODE_HAS_TYPE;
-
-    PRINTF("\nNODE ");
-    PRINT6ADDR(&current_target->ipaddr);
-    PRINTF(" HAS TYPE %s\n", current_target->type);
   } else {
-    /* otherwise update the current value */
-    if(format == LWM2M_TLV) {
-      oma_tlv_t tlv;
-      /* we can only read int32 for now ? */
-      if(oma_tlv_read(&tlv, chunk, len) > 0) {
-        /* printf("TLV.type=%d len=%d id=%d value[0]=%d\n", */
-        /*        tlv.type, tlv.length, tlv.id, tlv.value[0]); */
-
-        int value = oma_tlv_get_int32(&tlv);
-        snprintf(current_value, sizeof(current_value), "%d", value);
-      }
-    } else {
-      if(len > sizeof(current_value) - 1) {
-        len = sizeof(current_value) - 1;
-      }
-      memcpy(current_value, chunk, len);
-      current_value[len] = 0;
+    if(len > sizeof(current_value) - 1) {
+      len = sizeof(current_value) - 1;
     }
+    memcpy(current_value, chunk, len);
+    current_value[len] = 0;
   }
 }
 /*---------------------------------------------------------------------------*/
@@ -276,16 +347,17 @@ PROCESS_THREAD(router_process, ev, data)
   /* This way the packet can be treated as pointer as usual. */
   static coap_packet_t request[1];
   static struct etimer timer;
+  struct node *node;
   uip_ds6_route_t *r;
   uip_ipaddr_t *nexthop;
-  int n;
 
   PROCESS_BEGIN();
 
   PROCESS_PAUSE();
 
-  /* receives all CoAP messages */
-  coap_init_engine();
+  /* receives all CoAP messages, and acts as resource directory */
+  lwm2m_rd_server_init();
+  lwm2m_rd_server_set_callback(rd_callback);
 
   setup_network();
 
@@ -302,14 +374,17 @@ PROCESS_THREAD(router_process, ev, data)
       serial_protocol_input((char *) data);
     }
 
+    if(ev == coap_request_event) {
+      printf("\n--Done--\n");
+    }
+
+    /* Ask all nodes without a known type, several at the same time */
     if(etimer_expired(&timer)) {
-      current_target = NULL;
-      n = 0;
       for(r = uip_ds6_route_head(); r != NULL; r = uip_ds6_route_next(r)) {
-        current_target = add_node(&r->ipaddr);
-        if(current_target == NULL ||
-           (current_target->flags & NODE_HAS_TYPE) != 0 ||
-           current_target->retries > 5) {
+        node = add_node(&r->ipaddr);
+        if(node == NULL ||
+           (node->flags & NODE_HAS_TYPE) != 0 ||
+           node->retries > 5) {
           continue;
         }
         PRINTF("  ");
@@ -323,35 +398,10 @@ PROCESS_THREAD(router_process, ev, data)
           PRINTF("-");
         }
         PRINTF("\n");
-        n++;
-        break;
+        discover(node);
       }
     }
 
-    /* This is a node type discovery */
-    if(current_target != NULL &&
-       (current_target->flags & NODE_HAS_TYPE) == 0 &&
-       current_target->retries < 6) {
-
-      /* prepare request, TID is set by COAP_BLOCKING_REQUEST() */
-      coap_init_message(request, COAP_TYPE_CON, COAP_GET, 0);
-      coap_set_header_uri_path(request, URL_DEVICE_MODEL);
-
-      current_target->retries++;
-
-      PRINTF("CoAP request to [");
-      PRINT6ADDR(&current_target->ipaddr);
-      PRINTF("]:%u (%u tx)\n", UIP_HTONS(REMOTE_PORT),
-             current_target->retries);
-
-      fetching_type = 1;
-      COAP_BLOCKING_REQUEST(&current_target->ipaddr, REMOTE_PORT, request,
-                            client_chunk_handler);
-      fetching_type = 0;
-      strncpy(current_uri, URL_LIGHT_CONTROL, sizeof(current_uri));
-      printf("\n--Done--\n");
-    }
-
     /* If having a type this is another type of request */
     if(current_target != NULL &&
        (current_target->flags & NODE_HAS_TYPE) && strlen(current_uri) > 0) {
@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *    3. Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+/**
+ * \file
+ *      Benchmark of the OMA LWM2M / CoAP request path on the native platform.
+ *
+ *      A set of requests is serialized once at startup and the raw
+ *      messages are then replayed in a tight loop. For each request the
+ *      time per operation of coap_parse_message(), the resource handler
+ *      and coap_serialize_message() is reported together with the stack
+ *      used by the handler.
+ *
+ *      Build and run with: make TARGET=native benchmark
+ */
+
+#include "contiki.h"
+#include "lwm2m-engine.h"
+#include "lwm2m-firmware.h"
+#include "lwm2m-connectivity.h"
+#include "ipso-objects.h"
+#include "er-coap.h"
+#include "rest-engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef CONTIKI_TARGET_NATIVE
+#error "The LWM2M benchmark requires the native platform"
+#endif
+
+#ifdef BENCHMARK_CONF_ITERATIONS
+#define BENCHMARK_ITERATIONS BENCHMARK_CONF_ITERATIONS
+#else /* BENCHMARK_CONF_ITERATIONS */
+#define BENCHMARK_ITERATIONS 20000
+#endif /* BENCHMARK_CONF_ITERATIONS */
+
+/* Size of the stack area painted before running a handler */
+#define STACK_PAINT_SIZE  4096
+#define STACK_PAINT_VALUE 0xa5
+
+typedef struct {
+  const char *name;
+  coap_message_type_t type;
+  uint8_t code;
+  const char *uri;
+  int content_format;
+  int accept;
+  int observe;
+  const char *payload;
+} benchmark_request_t;
+
+static const benchmark_request_t requests[] = {
+  { "GET resource", COAP_TYPE_CON, COAP_GET, "3/0/16", -1, -1, -1, NULL },
+  { "GET resource TLV", COAP_TYPE_CON, COAP_GET, "3303/0/5700",
+    -1, LWM2M_TLV, -1, NULL },
+  { "GET instance TLV", COAP_TYPE_CON, COAP_GET, "3303/0",
+    -1, LWM2M_TLV, -1, NULL },
+  { "GET instance JSON", COAP_TYPE_CON, COAP_GET, "3303/0",
+    -1, LWM2M_JSON, -1, NULL },
+  { "GET well-known/core", COAP_TYPE_CON, COAP_GET, ".well-known/core",
+    -1, -1, -1, NULL },
+  { "PUT resource", COAP_TYPE_CON, COAP_PUT, "3/0/13",
+    LWM2M_TEXT_PLAIN, -1, -1, "1000" },
+  { "POST execute", COAP_TYPE_CON, COAP_POST, "5/0/2", -1, -1, -1, NULL },
+  { "GET observe", COAP_TYPE_CON, COAP_GET, "3303/0/5700",
+    -1, -1, 0, NULL },
+};
+
+#define REQUEST_COUNT (sizeof(requests) / sizeof(benchmark_request_t))
+
+static uint8_t capture[COAP_MAX_PACKET_SIZE + 1];
+static uint16_t capture_len;
+static uint8_t work[COAP_MAX_PACKET_SIZE + 1];
+static uint8_t payload[REST_MAX_CHUNK_SIZE];
+static uint8_t output[COAP_MAX_PACKET_SIZE + 1];
+static coap_packet_t request[1];
+static coap_packet_t response[1];
+/* lowest address of the painted stack area */
+static volatile uintptr_t stack_base;
+
+PROCESS(lwm2m_benchmark, "LWM2M benchmark");
+AUTOSTART_PROCESSES(&lwm2m_benchmark);
+/*---------------------------------------------------------------------------*/
+static uint64_t
+now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+/*---------------------------------------------------------------------------*/
+static void __attribute__((noinline))
+stack_paint(void)
+{
+  uint8_t stack[STACK_PAINT_SIZE];
+  memset(stack, STACK_PAINT_VALUE, sizeof(stack));
+  stack_base = (uintptr_t)stack;
+}
+/*---------------------------------------------------------------------------*/
+/* Count the painted bytes below the caller that have been overwritten */
+static unsigned
+stack_used(void)
+{
+  const uint8_t *stack = (const uint8_t *)stack_base;
+  int i;
+  for(i = 0; i < STACK_PAINT_SIZE && stack[i] == STACK_PAINT_VALUE; i++);
+  return STACK_PAINT_SIZE - i;
+}
+/*---------------------------------------------------------------------------*/
+static void
+capture_request(const benchmark_request_t *r)
+{
+  static const uint8_t token[] = { 0x42, 0x17 };
+  coap_packet_t packet[1];
+
+  coap_init_message(packet, r->type, r->code, 0x1234);
+  coap_set_token(packet, token, sizeof(token));
+  coap_set_header_uri_path(packet, r->uri);
+  if(r->observe >= 0) {
+    coap_set_header_observe(packet, r->observe);
+  }
+  if(r->content_format >= 0) {
+    coap_set_header_content_format(packet, r->content_format);
+  }
+  if(r->accept >= 0) {
+    coap_set_header_accept(packet, r->accept);
+  }
+  if(r->payload != NULL) {
+    coap_set_payload(packet, r->payload, strlen(r->payload));
+  }
+  capture_len = coap_serialize_message(packet, capture);
+}
+/*---------------------------------------------------------------------------*/
+static void __attribute__((noinline))
+handle_request(void)
+{
+  int32_t offset = 0;
+  coap_init_message(response, COAP_TYPE_ACK, CONTENT_2_05, request->mid);
+  coap_set_token(response, request->token, request->token_len);
+  rest_invoke_restful_service(request, response, payload,
+                              REST_MAX_CHUNK_SIZE, &offset);
+}
+/*---------------------------------------------------------------------------*/
+static void
+run_benchmark(const benchmark_request_t *r)
+{
+  uint64_t start, parse_time, handle_time, serialize_time;
+  unsigned stack;
+  size_t len = 0;
+  int i;
+
+  capture_request(r);
+
+  /* Parsing modifies the message so each round starts from the capture */
+  start = now_ns();
+  for(i = 0; i < BENCHMARK_ITERATIONS; i++) {
+    memcpy(work, capture, capture_len);
+    coap_parse_message(request, work, capture_len);
+  }
+  parse_time = now_ns() - start;
+
+  stack_paint();
+  handle_request();
+  stack = stack_used();
+
+  start = now_ns();
+  for(i = 0; i < BENCHMARK_ITERATIONS; i++) {
+    handle_request();
+  }
+  handle_time = now_ns() - start;
+
+  start = now_ns();
+  for(i = 0; i < BENCHMARK_ITERATIONS; i++) {
+    len = coap_serialize_message(response, output);
+  }
+  serialize_time = now_ns() - start;
+
+  printf("%-20s %4u B -> %4u B %6lu %8lu %6lu %6u\n", r->name,
+         capture_len, (unsigned)len,
+         (unsigned long)(parse_time / BENCHMARK_ITERATIONS),
+         (unsigned long)(handle_time / BENCHMARK_ITERATIONS),
+         (unsigned long)(serialize_time / BENCHMARK_ITERATIONS),
+         stack);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(lwm2m_benchmark, ev, data)
+{
+  static int i;
+
+  PROCESS_BEGIN();
+
+  lwm2m_engine_init();
+  lwm2m_engine_register_default_objects();
+  lwm2m_firmware_init();
+  lwm2m_connectivity_init();
+  ipso_objects_init();
+
+  /* Let the engine processes start before running the benchmark */
+  PROCESS_PAUSE();
+
+  printf("LWM2M benchmark: %u iterations, ns/op and stack bytes\n",
+         BENCHMARK_ITERATIONS);
+  printf("%-20s %16s %6s %8s %6s %6s\n", "request", "size",
+         "parse", "handler", "serial", "stack");
+  for(i = 0; i < REQUEST_COUNT; i++) {
+    run_benchmark(&requests[i]);
+    PROCESS_PAUSE();
+  }
+
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -72,4 +72,8 @@
 /* Enable client-side support for COAP observe */
 #define COAP_OBSERVE_CLIENT 1
 
+/* Long enough for the relays of the resource directory server, observed
+   as "ep/<endpoint>/<path>" (see LWM2M_RD_SERVER_RELAY_URL_SIZE) */
+#define COAP_OBSERVER_URL_LEN 44
+
 #endif /* PROJECT_CONF_H_ */
@@ -70,9 +70,34 @@ extern speed_t slip_config_b_rate;
 #define SEND_DELAY 0
 #endif
 
+/* Read and write the serial device from two threads of their own, which
+ * also do the SLIP decoding and encoding. Frames are passed to and from
+ * the Contiki thread through single producer, single consumer queues */
+#ifdef SLIP_DEV_CONF_THREAD
+#define SLIP_DEV_THREAD SLIP_DEV_CONF_THREAD
+#else
+#define SLIP_DEV_THREAD 0
+#endif
+
+/* Frames each queue holds, must be a power of two */
+#ifdef SLIP_DEV_CONF_QUEUE_LEN
+#define SLIP_DEV_QUEUE_LEN SLIP_DEV_CONF_QUEUE_LEN
+#else
+#define SLIP_DEV_QUEUE_LEN 32
+#endif
+
+#if SLIP_DEV_THREAD
+#include <poll.h>
+#include <pthread.h>
+#endif /* SLIP_DEV_THREAD */
+
 int devopen(const char *dev, int flags);
 
+#if !SLIP_DEV_THREAD
 static FILE *inslip;
+#endif /* !SLIP_DEV_THREAD */
+/* delay between slip packets */
+static clock_time_t send_delay = SEND_DELAY;
 
 /* for statistics */
 long slip_sent = 0;
@@ -169,6 +194,47 @@ slip_packet_input(unsigned char *data, int len)
   NETSTACK_RDC.input();
 }
 /*---------------------------------------------------------------------------*/
+/* Handle a frame received over SLIP */
+static void
+slip_frame_input(unsigned char *inbuf, int inbufptr)
+{
+  int i;
+
+  if(inbuf[0] == '!') {
+    command_context = CMD_CONTEXT_RADIO;
+    cmd_input(inbuf, inbufptr);
+  } else if(inbuf[0] == '?') {
+#define DEBUG_LINE_MARKER '\r'
+  } else if(inbuf[0] == DEBUG_LINE_MARKER) {
+    fwrite(inbuf + 1, inbufptr - 1, 1, stdout);
+  } else if(is_sensible_string(inbuf, inbufptr)) {
+    /* strings already echoed by serial_input() for verbose>1 */
+    if(slip_config_verbose == 1 || (SLIP_DEV_THREAD && slip_config_verbose > 1)) {
+      fwrite(inbuf, inbufptr, 1, stdout);
+    }
+  } else {
+    if(slip_config_verbose > 2) {
+      printf("Packet from SLIP of length %d - write TUN\n", inbufptr);
+      if(slip_config_verbose > 4) {
+#if WIRESHARK_IMPORT_FORMAT
+        printf("0000");
+        for(i = 0; i < inbufptr; i++) printf(" %02x", inbuf[i]);
+#else
+        printf("         ");
+        for(i = 0; i < inbufptr; i++) {
+          printf("%02x", inbuf[i]);
+          if((i & 3) == 3) printf(" ");
+          if((i & 15) == 15) printf("\n         ");
+        }
+#endif
+        printf("\n");
+      }
+    }
+    slip_packet_input(inbuf, inbufptr);
+  }
+}
+/*---------------------------------------------------------------------------*/
+#if !SLIP_DEV_THREAD
 /*
  * Read from serial, when we have a packet call slip_packet_input. No output
  * buffering, input buffered by stdio.
@@ -178,7 +244,7 @@ serial_input(FILE *inslip)
 {
   static unsigned char inbuf[2048];
   static int inbufptr = 0;
-  int ret,i;
+  int ret;
   unsigned char c;
 
 #ifdef linux
@@ -207,37 +273,7 @@ serial_input(FILE *inslip)
   switch(c) {
   case SLIP_END:
     if(inbufptr > 0) {
-      if(inbuf[0] == '!') {
-	command_context = CMD_CONTEXT_RADIO;
-	cmd_input(inbuf, inbufptr);
-      } else if(inbuf[0] == '?') {
-#define DEBUG_LINE_MARKER '\r'
-      } else if(inbuf[0] == DEBUG_LINE_MARKER) {
-	fwrite(inbuf + 1, inbufptr - 1, 1, stdout);
-      } else if(is_sensible_string(inbuf, inbufptr)) {
-        if(slip_config_verbose == 1) {   /* strings already echoed below for verbose>1 */
-          fwrite(inbuf, inbufptr, 1, stdout);
-        }
-      } else {
-        if(slip_config_verbose > 2) {
-          printf("Packet from SLIP of length %d - write TUN\n", inbufptr);
-          if(slip_config_verbose > 4) {
-#if WIRESHARK_IMPORT_FORMAT
-            printf("0000");
-	    for(i = 0; i < inbufptr; i++) printf(" %02x", inbuf[i]);
-#else
-            printf("         ");
-            for(i = 0; i < inbufptr; i++) {
-              printf("%02x", inbuf[i]);
-              if((i & 3) == 3) printf(" ");
-              if((i & 15) == 15) printf("\n         ");
-            }
-#endif
-            printf("\n");
-          }
-        }
-	slip_packet_input(inbuf, inbufptr);
-      }
+      slip_frame_input(inbuf, inbufptr);
       inbufptr = 0;
     }
     break;
@@ -283,8 +319,6 @@ serial_input(FILE *inslip)
 unsigned char slip_buf[2048];
 int slip_end, slip_begin, slip_packet_end, slip_packet_count;
 static struct timer send_delay_timer;
-/* delay between slip packets */
-static clock_time_t send_delay = SEND_DELAY;
 /*---------------------------------------------------------------------------*/
 static void
 slip_send(int fd, unsigned char c)
@@ -351,6 +385,243 @@ slip_flushbuf(int fd)
     }
   }
 }
+#endif /* !SLIP_DEV_THREAD */
+#if SLIP_DEV_THREAD
+/*---------------------------------------------------------------------------*/
+/* Room for a frame of 2048 bytes with every byte escaped */
+#define FRAME_SIZE (2 * 2048 + 2)
+
+struct frame {
+  int len;
+  uint8_t data[FRAME_SIZE];
+};
+
+/* The producer alone writes head, the consumer alone writes tail */
+struct frame_queue {
+  struct frame frames[SLIP_DEV_QUEUE_LEN];
+  unsigned head, tail;
+};
+
+static struct frame_queue rx_queue, tx_queue;
+/* Pipes that wake up the Contiki thread and the writer thread */
+static int rx_wakeup[2], tx_wakeup[2];
+/*---------------------------------------------------------------------------*/
+static struct frame *
+queue_free_frame(struct frame_queue *q)
+{
+  if(q->head - __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE) == SLIP_DEV_QUEUE_LEN) {
+    return NULL;
+  }
+  return &q->frames[q->head % SLIP_DEV_QUEUE_LEN];
+}
+/*---------------------------------------------------------------------------*/
+static void
+queue_put(struct frame_queue *q)
+{
+  __atomic_store_n(&q->head, q->head + 1, __ATOMIC_RELEASE);
+}
+/*---------------------------------------------------------------------------*/
+static struct frame *
+queue_peek(struct frame_queue *q)
+{
+  if(__atomic_load_n(&q->head, __ATOMIC_ACQUIRE) == q->tail) {
+    return NULL;
+  }
+  return &q->frames[q->tail % SLIP_DEV_QUEUE_LEN];
+}
+/*---------------------------------------------------------------------------*/
+static void
+queue_remove(struct frame_queue *q)
+{
+  __atomic_store_n(&q->tail, q->tail + 1, __ATOMIC_RELEASE);
+}
+/*---------------------------------------------------------------------------*/
+static void
+wakeup(int fd)
+{
+  char c = 0;
+
+  /* A full pipe already has a wakeup pending */
+  if(write(fd, &c, 1) < 0 && errno != EAGAIN) {
+    err(1, "slip-dev: wakeup");
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* SLIP encode a frame and queue it for the writer thread */
+static void
+queue_frame(const uint8_t *p, int len)
+{
+  struct frame *f;
+  int i;
+
+  f = queue_free_frame(&tx_queue);
+  if(f == NULL || 2 * len + 1 > FRAME_SIZE) {
+    PROGRESS("Q");		/* Outqueue is full! */
+    return;
+  }
+  f->len = 0;
+  for(i = 0; i < len; i++) {
+    if(p[i] == SLIP_END) {
+      f->data[f->len++] = SLIP_ESC;
+      f->data[f->len++] = SLIP_ESC_END;
+    } else if(p[i] == SLIP_ESC) {
+      f->data[f->len++] = SLIP_ESC;
+      f->data[f->len++] = SLIP_ESC_ESC;
+    } else {
+      f->data[f->len++] = p[i];
+    }
+  }
+  f->data[f->len++] = SLIP_END;
+  queue_put(&tx_queue);
+  wakeup(tx_wakeup[1]);
+}
+/*---------------------------------------------------------------------------*/
+static void
+write_all(const uint8_t *data, int len)
+{
+  struct pollfd pfd;
+  int n;
+
+  pfd.fd = slipfd;
+  pfd.events = POLLOUT;
+  while(len > 0) {
+    n = write(slipfd, data, len);
+    if(n < 0 && errno != EAGAIN && errno != EINTR) {
+      err(1, "slip-dev: write failed");
+    } else if(n < 0) {
+      poll(&pfd, 1, -1);
+    } else {
+      data += n;
+      len -= n;
+      __atomic_add_fetch(&slip_sent, n, __ATOMIC_RELAXED);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void *
+writer_thread(void *arg)
+{
+  struct frame *f;
+  char c;
+
+  while(1) {
+    if(read(tx_wakeup[0], &c, 1) < 0 && errno != EINTR) {
+      err(1, "slip-dev: writer");
+    }
+    while((f = queue_peek(&tx_queue)) != NULL) {
+      write_all(f->data, f->len);
+      queue_remove(&tx_queue);
+      if(send_delay > 0) {
+        /* A delay between slip packets to avoid losing data */
+        usleep(send_delay * (1000000 / CLOCK_SECOND));
+      }
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void *
+reader_thread(void *arg)
+{
+  static uint8_t buf[512];
+  struct pollfd pfd;
+  struct frame *f = NULL;
+  int len = 0;
+  int esc = 0;
+  int drop = 0;
+  int n, i;
+
+  pfd.fd = slipfd;
+  pfd.events = POLLIN;
+  while(1) {
+    n = read(slipfd, buf, sizeof(buf));
+    if(n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+      err(1, "slip-dev: read");
+    } else if(n < 0) {
+      poll(&pfd, 1, -1);
+      continue;
+    }
+    __atomic_add_fetch(&slip_received, n, __ATOMIC_RELAXED);
+
+    for(i = 0; i < n; i++) {
+      uint8_t c = buf[i];
+      if(c == SLIP_END) {
+        if(len > 0 && !drop) {
+          f->len = len;
+          queue_put(&rx_queue);
+          wakeup(rx_wakeup[1]);
+          f = NULL;
+        }
+        len = 0;
+        esc = 0;
+        drop = 0;
+        continue;
+      }
+      if(c == SLIP_ESC) {
+        esc = 1;
+        continue;
+      }
+      if(esc) {
+        c = c == SLIP_ESC_END ? SLIP_END : c == SLIP_ESC_ESC ? SLIP_ESC : c;
+        esc = 0;
+      }
+      if(f == NULL && (f = queue_free_frame(&rx_queue)) == NULL) {
+        /* The Contiki thread is behind, drop the frame */
+        drop = 1;
+      }
+      if(drop || len >= 2048) {
+        if(!drop) {
+          fprintf(stderr, "*** dropping large packet\n");
+        }
+        drop = 1;
+        continue;
+      }
+      f->data[len++] = c;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static int
+set_fd(fd_set *rset, fd_set *wset)
+{
+  FD_SET(rx_wakeup[0], rset);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_fd(fd_set *rset, fd_set *wset)
+{
+  struct frame *f;
+  char buf[SLIP_DEV_QUEUE_LEN];
+
+  if(FD_ISSET(rx_wakeup[0], rset)) {
+    while(read(rx_wakeup[0], buf, sizeof(buf)) > 0);
+    while((f = queue_peek(&rx_queue)) != NULL) {
+      slip_frame_input(f->data, f->len);
+      queue_remove(&rx_queue);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+start_threads(void)
+{
+  pthread_t thread;
+
+  if(pipe(rx_wakeup) < 0 || pipe(tx_wakeup) < 0) {
+    err(1, "slip-dev: pipe");
+  }
+  fcntl(rx_wakeup[0], F_SETFL, O_NONBLOCK);
+  fcntl(rx_wakeup[1], F_SETFL, O_NONBLOCK);
+  fcntl(tx_wakeup[1], F_SETFL, O_NONBLOCK);
+  fcntl(slipfd, F_SETFL, fcntl(slipfd, F_GETFL) | O_NONBLOCK);
+  if(pthread_create(&thread, NULL, reader_thread, NULL) != 0
+     || pthread_create(&thread, NULL, writer_thread, NULL) != 0) {
+    err(1, "slip-dev: pthread_create");
+  }
+}
+#endif /* SLIP_DEV_THREAD */
 /*---------------------------------------------------------------------------*/
 static void
 write_to_serial(int outfd, const uint8_t *inbuf, int len)
@@ -380,6 +651,9 @@ write_to_serial(int outfd, const uint8_t *inbuf, int len)
     }
   }
 
+#if SLIP_DEV_THREAD
+  queue_frame(p, len);
+#else /* SLIP_DEV_THREAD */
   /* It would be ``nice'' to send a SLIP_END here but it's not
    * really necessary.
    */
@@ -401,6 +675,7 @@ write_to_serial(int outfd, const uint8_t *inbuf, int len)
     }
   }
   slip_send(outfd, SLIP_END);
+#endif /* SLIP_DEV_THREAD */
   PROGRESS("t");
 }
 /*---------------------------------------------------------------------------*/
@@ -458,6 +733,7 @@ stty_telos(int fd)
   /* Flush input and output buffers. */
   if(tcflush(fd, TCIOFLUSH) == -1) err(1, "tcflush");
 }
+#if !SLIP_DEV_THREAD
 /*---------------------------------------------------------------------------*/
 static int
 set_fd(fd_set *rset, fd_set *wset)
@@ -482,6 +758,7 @@ handle_fd(fd_set *rset, fd_set *wset)
     slip_flushbuf(slipfd);
   }
 }
+#endif /* !SLIP_DEV_THREAD */
 /*---------------------------------------------------------------------------*/
 static const struct select_callback slip_callback = { set_fd, handle_fd };
 /*---------------------------------------------------------------------------*/
@@ -526,8 +803,6 @@ slip_init(void)
     }
   }
 
-  select_set_callback(slipfd, &slip_callback);
-
   if(slip_config_host != NULL) {
     fprintf(stderr, "********SLIP opened to ``%s:%s''\n", slip_config_host,
 	    slip_config_port);
@@ -536,11 +811,18 @@ slip_init(void)
     stty_telos(slipfd);
   }
 
+#if SLIP_DEV_THREAD
+  start_threads();
+  select_set_callback(rx_wakeup[0], &slip_callback);
+  queue_frame(NULL, 0);
+#else /* SLIP_DEV_THREAD */
+  select_set_callback(slipfd, &slip_callback);
   timer_set(&send_delay_timer, 0);
   slip_send(slipfd, SLIP_END);
   inslip = fdopen(slipfd, "r");
   if(inslip == NULL) {
     err(1, "main: fdopen");
   }
+#endif /* SLIP_DEV_THREAD */
 }
 /*---------------------------------------------------------------------------*/
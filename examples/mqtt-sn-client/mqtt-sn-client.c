@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \file
+ *         An MQTT-SN client that publishes its uptime every period and
+ *         sleeps in between, the gateway keeping its session.
+ */
+
+#include "contiki.h"
+#include "contiki-net.h"
+#include "net/ip/uiplib.h"
+#include "mqtt-sn.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef MQTT_SN_CLIENT_CONF_GATEWAY
+#define MQTT_SN_CLIENT_GATEWAY MQTT_SN_CLIENT_CONF_GATEWAY
+#else
+#define MQTT_SN_CLIENT_GATEWAY "fd00::1"
+#endif
+
+#define PERIOD      (30 * CLOCK_SECOND)
+#define KEEP_ALIVE  60
+#define TOPIC       "contiki/uptime"
+
+static struct mqtt_sn_connection conn;
+static uint16_t topic_id;
+static uint8_t connected;
+/*---------------------------------------------------------------------------*/
+PROCESS(mqtt_sn_client_process, "MQTT-SN client");
+AUTOSTART_PROCESSES(&mqtt_sn_client_process);
+/*---------------------------------------------------------------------------*/
+static void
+event_callback(struct mqtt_sn_connection *c, mqtt_sn_event_t event, void *data)
+{
+  struct mqtt_sn_topic_event *topic_event = data;
+
+  switch(event) {
+  case MQTT_SN_EVENT_CONNECTED:
+    printf("Connected\n");
+    if(topic_id == 0) {
+      mqtt_sn_register_topic(c, NULL, TOPIC);
+    } else {
+      connected = 1;
+      process_poll(&mqtt_sn_client_process);
+    }
+    break;
+  case MQTT_SN_EVENT_REGACK:
+    if(topic_event->return_code == MQTT_SN_RC_ACCEPTED) {
+      printf("Topic %s has ID %u\n", TOPIC, topic_event->topic_id);
+      topic_id = topic_event->topic_id;
+      connected = 1;
+      process_poll(&mqtt_sn_client_process);
+    }
+    break;
+  case MQTT_SN_EVENT_ASLEEP:
+    printf("Asleep\n");
+    break;
+  case MQTT_SN_EVENT_DISCONNECTED:
+  case MQTT_SN_EVENT_TIMEOUT_ERROR:
+  case MQTT_SN_EVENT_CONNECTION_REFUSED_ERROR:
+    printf("Disconnected (%u)\n", event);
+    /* Start over with a clean session */
+    topic_id = 0;
+    break;
+  default:
+    break;
+  }
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(mqtt_sn_client_process, ev, data)
+{
+  static struct etimer et;
+  static char payload[16];
+  uip_ipaddr_t gateway;
+
+  PROCESS_BEGIN();
+
+  uiplib_ip6addrconv(MQTT_SN_CLIENT_GATEWAY, &gateway);
+  mqtt_sn_register(&conn, "contiki-sn", &gateway, MQTT_SN_DEFAULT_PORT,
+                   event_callback);
+
+  etimer_set(&et, CLOCK_SECOND);
+  while(1) {
+    PROCESS_WAIT_EVENT();
+
+    if(ev == PROCESS_EVENT_TIMER && data == &et) {
+      etimer_set(&et, PERIOD);
+      connected = 0;
+      mqtt_sn_connect(&conn, KEEP_ALIVE);
+    } else if(ev == PROCESS_EVENT_POLL && connected) {
+      snprintf(payload, sizeof(payload), "%lu",
+               (unsigned long)clock_seconds());
+      mqtt_sn_publish(&conn, NULL, MQTT_SN_TOPIC_TYPE_NORMAL, topic_id,
+                      (uint8_t *)payload, strlen(payload),
+                      MQTT_SN_QOS_LEVEL_0, 0);
+      mqtt_sn_sleep(&conn, 2 * PERIOD / CLOCK_SECOND);
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,7 @@
+#include "symbols.h"
+
+const int symbols_nelts = 0;
+const struct symbols symbols[] = {{0,0}};
+const unsigned short symbols_hash_size = 1;
+const unsigned short symbols_hash_start[] = {0, 0};
+const unsigned short symbols_hash_chain[] = {0};
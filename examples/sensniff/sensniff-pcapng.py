@@ -0,0 +1,267 @@
+#!/usr/bin/env python3
+
+# Copyright (c) 2016, SICS Swedish ICT AB.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+# 3. Neither the name of the Institute nor the names of its contributors
+#    may be used to endorse or promote products derived from this software
+#    without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+# ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+# FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+# OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+# HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+# OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+# SUCH DAMAGE.
+#
+# This file is part of the Contiki operating system.
+
+# \file
+#         Capture with the sensniff firmware in batch mode, into a PCAP-NG
+#         file of IEEE 802.15.4 TAP packets (link type 283). Each packet
+#         keeps the timestamp of its SFD, at the resolution of the rtimer
+#         of the sniffer, its RSSI, LQI and channel, and the number of
+#         frames the sniffer dropped before it.
+#
+#           sensniff-pcapng.py -b 460800 -o capture.pcapng /dev/ttyACM0
+#
+#         The input can also be a file holding the output of the firmware,
+#         in which case the timestamps start at the time of conversion.
+
+import os
+import struct
+import sys
+import time
+from optparse import OptionParser
+
+MAGIC = b"\xc1\x1f\xfe\x72"
+PROTOCOL_VERSION = 2
+
+CMD_FRAME = 0x00
+CMD_CHANNEL = 0x01
+CMD_CAPTURE_INFO = 0x04
+CMD_FRAME_BATCH = 0x05
+CMD_SET_CHANNEL = 0x84
+CMD_SET_CAPTURE_MODE = 0x85
+
+CAPTURE_MODE_BATCH = 1
+RECORD_HEADER = struct.Struct(">BBIbBB")
+FLAG_SFD = 0x80
+FLAG_DROPS = 0x7f
+
+LINKTYPE_IEEE802_15_4_TAP = 283
+TAP_FCS_TYPE = 0
+TAP_RSS = 1
+TAP_CHANNEL = 3
+TAP_LQI = 10
+
+class PcapngWriter:
+    def __init__(self, out):
+        self.out = out
+        self.interface = False
+        self.block(0x0a0d0d0a, struct.pack("<IHHq", 0x1a2b3c4d, 1, 0, -1))
+
+    def block(self, block_type, body):
+        body += b"\0" * (-len(body) % 4)
+        length = len(body) + 12
+        self.out.write(struct.pack("<II", block_type, length) + body +
+                       struct.pack("<I", length))
+
+    @staticmethod
+    def option(code, value):
+        return struct.pack("<HH", code, len(value)) + value + \
+            b"\0" * (-len(value) % 4)
+
+    def add_interface(self, second):
+        """Timestamps in units of 1/second: exactly if it is a power of 2
+        or of 10, else in microseconds"""
+        if second & (second - 1) == 0:
+            self.tsresol = 0x80 | (second.bit_length() - 1)
+            self.units = second
+        elif str(second).strip("0") == "1":
+            self.tsresol = len(str(second)) - 1
+            self.units = second
+        else:
+            self.tsresol = 6
+            self.units = 1000000
+        options = self.option(9, bytes([self.tsresol])) + self.option(0, b"")
+        self.block(1, struct.pack("<HHI", LINKTYPE_IEEE802_15_4_TAP, 0, 0) +
+                   options)
+        self.interface = True
+
+    def packet(self, ticks, second, frame, rssi, lqi, channel=None,
+               drops=0, comment=None):
+        tlvs = self.option(TAP_FCS_TYPE, b"\0")
+        tlvs += self.option(TAP_RSS, struct.pack("<f", rssi))
+        if channel is not None:
+            tlvs += self.option(TAP_CHANNEL, struct.pack("<HB", channel, 0))
+        tlvs += self.option(TAP_LQI, bytes([lqi]))
+        data = struct.pack("<BBH", 0, 0, 4 + len(tlvs)) + tlvs + frame
+        ts = ticks * self.units // second
+        options = b""
+        if drops > 0:
+            options += self.option(4, struct.pack("<Q", drops))
+        if comment is not None:
+            options += self.option(1, comment.encode())
+        if options:
+            options += self.option(0, b"")
+        self.block(6, struct.pack("<IIIII", 0, ts >> 32, ts & 0xffffffff,
+                                  len(data), len(data)) +
+                   data + b"\0" * (-len(data) % 4) + options)
+        self.out.flush()
+
+class Capture:
+    def __init__(self, writer):
+        self.writer = writer
+        self.second = 1000000
+        self.width = 32
+        self.last = None
+        self.base = 0
+        self.frames = 0
+        self.drops = 0
+
+    def host_ticks(self):
+        return int(time.time() * self.second)
+
+    def capture_info(self, payload):
+        mode, self.second, self.width = struct.unpack(">BIB", payload[:6])
+        self.last = None
+        self.base = self.host_ticks()
+        if not self.writer.interface:
+            self.writer.add_interface(self.second)
+        sys.stderr.write("capture mode %u, %u ticks per second, %u bits\n" %
+                         (mode, self.second, self.width))
+
+    def unwrap(self, t):
+        """Timestamps of the sniffer wrap around: count the periods"""
+        period = 1 << self.width
+        t &= period - 1
+        if self.last is None:
+            self.offset = self.base - t
+        elif t < self.last & (period - 1):
+            self.offset += period
+        self.last = t
+        return self.offset + t
+
+    def frame(self, payload):
+        if not self.writer.interface:
+            self.writer.add_interface(self.second)
+        self.frames += 1
+        rssi = struct.unpack("b", payload[-2:-1])[0]
+        self.writer.packet(self.host_ticks(), self.second, payload[:-2],
+                           rssi, payload[-1] & 0x7f,
+                           comment="timestamp from the host")
+
+    def batch(self, payload):
+        pos = 0
+        while pos + RECORD_HEADER.size <= len(payload):
+            length, flags, t, rssi, lqi, channel = \
+                RECORD_HEADER.unpack_from(payload, pos)
+            pos += RECORD_HEADER.size
+            frame = payload[pos:pos + length]
+            pos += length
+            self.frames += 1
+            self.drops += flags & FLAG_DROPS
+            self.writer.packet(self.unwrap(t), self.second, frame, rssi, lqi,
+                               channel, flags & FLAG_DROPS,
+                               None if flags & FLAG_SFD else
+                               "timestamp from the sniffer's clock, not SFD")
+
+def commands(stream):
+    """The commands of the firmware: (command, payload)"""
+    buf = b""
+    while True:
+        data = stream.read(4096)
+        if not data:
+            return
+        buf += data
+        while True:
+            start = buf.find(MAGIC)
+            if start < 0:
+                buf = buf[-len(MAGIC) + 1:]
+                break
+            if len(buf) < start + 8:
+                buf = buf[start:]
+                break
+            version, cmd, length = struct.unpack_from(">BBH", buf, start + 4)
+            if version != PROTOCOL_VERSION:
+                buf = buf[start + 1:]
+                continue
+            if len(buf) < start + 8 + length:
+                buf = buf[start:]
+                break
+            yield cmd, buf[start + 8:start + 8 + length]
+            buf = buf[start + 8 + length:]
+
+def open_serial(path, baud):
+    import termios
+    import tty
+    fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+    tty.setraw(fd)
+    attrs = termios.tcgetattr(fd)
+    speed = getattr(termios, "B%d" % baud)
+    attrs[4] = attrs[5] = speed
+    termios.tcsetattr(fd, termios.TCSANOW, attrs)
+    return fd
+
+def command(fd, cmd, value):
+    os.write(fd, MAGIC + struct.pack(">BBHB", PROTOCOL_VERSION, cmd, 1, value))
+
+def main():
+    parser = OptionParser(usage="%prog [options] device-or-file")
+    parser.add_option("-b", "--baud", type="int", default=460800,
+                      help="baud rate of the serial line")
+    parser.add_option("-c", "--channel", type="int", default=None,
+                      help="channel to sniff")
+    parser.add_option("-o", "--output", default=None,
+                      help="PCAP-NG file, or standard output")
+    (options, args) = parser.parse_args()
+    if len(args) != 1:
+        parser.error("a serial device or a file is needed")
+
+    out = open(options.output, "wb") if options.output else \
+        sys.stdout.buffer
+    capture = Capture(PcapngWriter(out))
+
+    fd = os.open(args[0], os.O_RDONLY | os.O_NOCTTY)
+    serial = os.isatty(fd)
+    os.close(fd)
+    if serial:
+        fd = open_serial(args[0], options.baud)
+        if options.channel is not None:
+            command(fd, CMD_SET_CHANNEL, options.channel)
+        command(fd, CMD_SET_CAPTURE_MODE, CAPTURE_MODE_BATCH)
+        stream = os.fdopen(fd, "rb", buffering=0)
+    else:
+        stream = open(args[0], "rb")
+
+    try:
+        for cmd, payload in commands(stream):
+            if cmd == CMD_CAPTURE_INFO:
+                capture.capture_info(payload)
+            elif cmd == CMD_FRAME_BATCH:
+                capture.batch(payload)
+            elif cmd == CMD_FRAME and len(payload) >= 2:
+                capture.frame(payload)
+            elif cmd == CMD_CHANNEL:
+                sys.stderr.write("channel %u\n" % payload[0])
+    except KeyboardInterrupt:
+        pass
+    sys.stderr.write("%u frames, %u dropped by the sniffer\n" %
+                     (capture.frames, capture.drops))
+
+if __name__ == "__main__":
+    main()
@@ -36,6 +36,7 @@
 #include "net/packetbuf.h"
 #include "sys/process.h"
 #include "sys/ctimer.h"
+#include "sys/rtimer.h"
 #include "lib/ringbuf.h"
 
 #include SENSNIFF_IO_DRIVER_H
@@ -72,14 +73,75 @@ static uint8_t in_ct;
 #define CMD_CHANNEL             0x01
 #define CMD_CHANNEL_MIN         0x02
 #define CMD_CHANNEL_MAX         0x03
+#define CMD_CAPTURE_INFO        0x04
+#define CMD_FRAME_BATCH         0x05
 #define CMD_ERR_NOT_SUPPORTED   0x7F
 #define CMD_GET_CHANNEL         0x81
 #define CMD_GET_CHANNEL_MIN     0x82
 #define CMD_GET_CHANNEL_MAX     0x83
 #define CMD_SET_CHANNEL         0x84
+#define CMD_SET_CAPTURE_MODE    0x85
 /*---------------------------------------------------------------------------*/
 #define PROTOCOL_VERSION           2
 /*---------------------------------------------------------------------------*/
+/*
+ * Capture modes. In frame mode (the default), each frame is sent as soon as
+ * it is received, in a CMD_FRAME command. In batch mode, frames are recorded
+ * in a buffer with their SFD timestamp, RSSI, LQI and channel, and each
+ * buffer is sent as one CMD_FRAME_BATCH command, by another process and a
+ * few bytes at a time so that the radio keeps being served meanwhile.
+ *
+ * A record of a batch is:
+ *   length of the frame (1), flags (1), timestamp in rtimer ticks (4),
+ *   RSSI in dBm (1), LQI (1), channel (1), then the frame without its FCS
+ * Multi-byte fields are in network byte order. The flags are FLAG_SFD if
+ * the timestamp was given by the radio (else it is when the frame was read)
+ * and the number of frames that were dropped before this one for lack of
+ * buffer space, up to FLAG_DROPS.
+ */
+#define CAPTURE_MODE_FRAME         0
+#define CAPTURE_MODE_BATCH         1
+
+#define RECORD_HEADER_LEN          9
+#define RECORD_MAX_LEN             (RECORD_HEADER_LEN + 127)
+#define FLAG_SFD                   0x80
+#define FLAG_DROPS                 0x7F
+
+/* Size of each of the two capture buffers */
+#ifdef SENSNIFF_CONF_CAPTURE_BUF_SIZE
+#define CAPTURE_BUF_SIZE SENSNIFF_CONF_CAPTURE_BUF_SIZE
+#else
+#define CAPTURE_BUF_SIZE           512
+#endif
+
+#if CAPTURE_BUF_SIZE < RECORD_MAX_LEN
+#error SENSNIFF_CONF_CAPTURE_BUF_SIZE must hold at least a full frame record
+#endif
+
+/* How long a frame may wait in a buffer that is not full */
+#ifdef SENSNIFF_CONF_BATCH_TIMEOUT
+#define BATCH_TIMEOUT SENSNIFF_CONF_BATCH_TIMEOUT
+#else
+#define BATCH_TIMEOUT              (CLOCK_SECOND / 32)
+#endif
+
+/* Bytes written by the output process each time it runs */
+#define OUTPUT_CHUNK               32
+
+static uint8_t capture_mode;
+static uint8_t capture_channel;
+static uint8_t capture_drops;
+
+static uint8_t capture_buf[2][CAPTURE_BUF_SIZE];
+/* The buffer being filled, and the length of both */
+static uint8_t fill;
+static uint16_t capture_len[2];
+/* Bytes of the other buffer already sent, 0 if it is not being sent */
+static uint16_t output_pos;
+static struct ctimer batch_timer;
+
+PROCESS(sensniff_output_process, "sensniff output process");
+/*---------------------------------------------------------------------------*/
 #define BUFSIZE 32
 
 static struct ringbuf rxbuf;
@@ -154,6 +216,7 @@ set_channel(uint8_t channel)
 {
   if(NETSTACK_RADIO.set_value(RADIO_PARAM_CHANNEL, channel) ==
      RADIO_RESULT_OK) {
+    capture_channel = channel;
     send_channel();
     return;
   }
@@ -193,6 +256,105 @@ send_channel_max(void)
   send_error();
 }
 /*---------------------------------------------------------------------------*/
+static void
+send_capture_info(void)
+{
+  uint32_t second = RTIMER_SECOND;
+
+  send_header(CMD_CAPTURE_INFO, 6);
+  sensniff_io_byte_out(capture_mode);
+  /* Resolution and width of the timestamps */
+  sensniff_io_byte_out(second >> 24);
+  sensniff_io_byte_out((second >> 16) & 0xFF);
+  sensniff_io_byte_out((second >> 8) & 0xFF);
+  sensniff_io_byte_out(second & 0xFF);
+  sensniff_io_byte_out(sizeof(rtimer_clock_t) * 8);
+  sensniff_io_flush();
+}
+/*---------------------------------------------------------------------------*/
+static void
+set_capture_mode(uint8_t mode)
+{
+  radio_value_t chan;
+
+  if(mode != CAPTURE_MODE_FRAME && mode != CAPTURE_MODE_BATCH) {
+    send_error();
+    return;
+  }
+  if(NETSTACK_RADIO.get_value(RADIO_PARAM_CHANNEL, &chan) ==
+     RADIO_RESULT_OK) {
+    capture_channel = chan;
+  }
+  capture_mode = mode;
+  capture_drops = 0;
+  send_capture_info();
+}
+/*---------------------------------------------------------------------------*/
+/* Hand the buffer being filled to the output process, if it is idle */
+static void
+batch_output(void *ptr)
+{
+  if(capture_len[fill] == 0 || capture_len[fill ^ 1] > 0) {
+    return;
+  }
+  ctimer_stop(&batch_timer);
+  fill ^= 1;
+  output_pos = 0;
+  process_poll(&sensniff_output_process);
+}
+/*---------------------------------------------------------------------------*/
+static void
+capture_frame(void)
+{
+  rtimer_clock_t t;
+  uint8_t *record;
+  uint8_t len;
+  uint8_t flags;
+
+  len = packetbuf_datalen() & 0xFF;
+  if(capture_len[fill] + RECORD_HEADER_LEN + len > CAPTURE_BUF_SIZE) {
+    batch_output(NULL);
+    if(capture_len[fill] + RECORD_HEADER_LEN + len > CAPTURE_BUF_SIZE) {
+      /* Both buffers are busy */
+      if(capture_drops < FLAG_DROPS) {
+        capture_drops++;
+      }
+      return;
+    }
+  }
+
+  flags = capture_drops;
+  capture_drops = 0;
+  if(NETSTACK_RADIO.get_object(RADIO_PARAM_LAST_PACKET_TIMESTAMP, &t,
+                               sizeof(t)) == RADIO_RESULT_OK) {
+    flags |= FLAG_SFD;
+  } else {
+    t = RTIMER_NOW();
+  }
+
+  if(capture_len[fill] == 0) {
+    ctimer_set(&batch_timer, BATCH_TIMEOUT, batch_output, NULL);
+  }
+
+  record = &capture_buf[fill][capture_len[fill]];
+  record[0] = len;
+  record[1] = flags;
+  record[2] = (uint32_t)t >> 24;
+  record[3] = ((uint32_t)t >> 16) & 0xFF;
+  record[4] = (t >> 8) & 0xFF;
+  record[5] = t & 0xFF;
+  record[6] = packetbuf_attr(PACKETBUF_ATTR_RSSI) & 0xFF;
+  record[7] = packetbuf_attr(PACKETBUF_ATTR_LINK_QUALITY) & 0xFF;
+  record[8] = capture_channel;
+  memcpy(&record[RECORD_HEADER_LEN], packetbuf_dataptr(), len);
+  capture_len[fill] += RECORD_HEADER_LEN + len;
+
+  if(capture_len[fill] + RECORD_MAX_LEN > CAPTURE_BUF_SIZE) {
+    /* Send it now rather than drop the next frame */
+    batch_output(NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
 static int
 char_in(unsigned char c)
 {
@@ -212,6 +374,15 @@ sensniff_output_frame()
   int i;
   uint8_t len = packetbuf_datalen() & 0xFF;
 
+  if(capture_mode == CAPTURE_MODE_BATCH) {
+    capture_frame();
+    return;
+  }
+  if(capture_len[fill ^ 1] > 0) {
+    /* The last batch is still being sent */
+    return;
+  }
+
   send_header(CMD_FRAME, len + 2);
 
   for(i = 0; i < len; i++) {
@@ -241,6 +412,9 @@ execute_command(void)
   case CMD_SET_CHANNEL:
     set_channel(command.data);
     break;
+  case CMD_SET_CAPTURE_MODE:
+    set_capture_mode(command.data);
+    break;
   default:
     send_error();
     break;
@@ -331,11 +505,61 @@ PROCESS_THREAD(sensniff_process, ev, data)
   /* Register for char inputs with the character I/O peripheral */
   sensniff_io_set_input(&char_in);
 
+  process_start(&sensniff_output_process, NULL);
+
   while(1) {
     PROCESS_YIELD();
 
     if(ev == PROCESS_EVENT_POLL) {
-      process_incoming_data();
+      if(capture_len[fill ^ 1] > 0) {
+        /* Commands are answered between batches */
+        process_poll(&sensniff_process);
+      } else {
+        process_incoming_data();
+      }
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(sensniff_output_process, ev, data)
+{
+  uint8_t *buf;
+  uint16_t len;
+  uint16_t end;
+
+  PROCESS_BEGIN();
+
+  while(1) {
+    PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_POLL);
+
+    buf = capture_buf[fill ^ 1];
+    len = capture_len[fill ^ 1];
+    if(len == 0) {
+      continue;
+    }
+
+    if(output_pos == 0) {
+      send_header(CMD_FRAME_BATCH, len);
+    }
+    end = output_pos + OUTPUT_CHUNK < len ? output_pos + OUTPUT_CHUNK : len;
+    for(; output_pos < end; output_pos++) {
+      sensniff_io_byte_out(buf[output_pos]);
+    }
+
+    if(output_pos < len) {
+      process_poll(&sensniff_output_process);
+    } else {
+      sensniff_io_flush();
+      capture_len[fill ^ 1] = 0;
+      output_pos = 0;
+      /* The buffer that was filled meanwhile may be full already */
+      if(capture_len[fill] + RECORD_MAX_LEN > CAPTURE_BUF_SIZE) {
+        batch_output(NULL);
+      } else if(capture_len[fill] > 0 && ctimer_expired(&batch_timer)) {
+        batch_output(NULL);
+      }
     }
   }
 
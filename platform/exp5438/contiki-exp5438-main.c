@@ -47,6 +47,7 @@
 #include "net/mac/frame802154.h"
 #include "net/netstack.h"
 #include "net/rime/rime.h"
+#include "sys/wakeup.h"
 #include "sys/autostart.h"
 
 #include "sys/node-id.h"
@@ -300,12 +301,17 @@ main(int argc, char **argv)
      * Idle processing.
      */
     int s = splhigh();          /* Disable interrupts. */
+    rtimer_clock_t wakeup_time;
     /* uart1_active is for avoiding LPM3 when still sending or receiving */
-    if(process_nevents() != 0 || uart1_active()) {
+    if(process_nevents() != 0 || uart1_active()
+       || wakeup_next(&wakeup_time) == WAKEUP_NOW) {
       splx(s);                  /* Re-enable interrupts. */
     } else {
       static unsigned long irq_energest = 0;
 
+      /* No clock tick is needed until the system needs the CPU again */
+      clock_arch_set_wakeup(wakeup_time);
+
       /* Re-enable interrupts and go to sleep atomically. */
       ENERGEST_SWITCH(ENERGEST_TYPE_CPU, ENERGEST_TYPE_LPM);
       /* We only want to measure the processing done in IRQs when we
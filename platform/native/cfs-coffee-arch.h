@@ -62,6 +62,10 @@
 #define COFFEE_READ(buf, size, offset)				\
   		xmem_pread((char *)(buf), (size), COFFEE_START + (offset))
 
+/* The storage is a RAM array, which cfs_map() can hand out. */
+#define COFFEE_MAP(offset)					\
+		xmem_map(COFFEE_START + (offset))
+
 #define COFFEE_ERASE(sector)					\
   		xmem_erase(COFFEE_SECTOR_SIZE, COFFEE_START + (sector) * COFFEE_SECTOR_SIZE)
 
@@ -74,4 +78,6 @@
 /* Coffee types. */
 typedef int16_t coffee_page_t;
 
+const void *xmem_map(unsigned long offset);
+
 #endif /* !COFFEE_ARCH_H */
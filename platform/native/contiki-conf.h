@@ -147,6 +147,9 @@ typedef unsigned short uip_stats_t;
 #define UIP_CONF_FWCACHE_SIZE    30
 #define UIP_CONF_BROADCAST       1
 #define UIP_ARCH_IPCHKSUM        1
+#ifndef UIP_CONF_CHKSUM_ACC32
+#define UIP_CONF_CHKSUM_ACC32    1
+#endif
 #define UIP_CONF_UDP             1
 #define UIP_CONF_UDP_CHECKSUMS   1
 #define UIP_CONF_PINGADDRCONF    0
@@ -43,6 +43,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <sys/select.h>
@@ -71,6 +72,7 @@
 #endif /* NETSTACK_CONF_WITH_IPV6 */
 
 #include "net/rime/rime.h"
+#include "sys/trace.h"
 
 #ifdef SELECT_CONF_MAX
 #define SELECT_MAX SELECT_CONF_MAX
@@ -78,6 +80,22 @@
 #define SELECT_MAX 8
 #endif
 
+/* Wait for the fds with epoll, and for the next etimer with a timerfd,
+ * instead of waking up every millisecond with select() */
+#ifdef SELECT_CONF_EPOLL
+#define SELECT_EPOLL SELECT_CONF_EPOLL
+#elif defined(__linux__)
+#define SELECT_EPOLL 1
+#else
+#define SELECT_EPOLL 0
+#endif
+
+#if SELECT_EPOLL
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#endif /* SELECT_EPOLL */
+
 static const struct select_callback *select_callback[SELECT_MAX];
 static int select_max = 0;
 
@@ -140,6 +158,212 @@ const static struct select_callback stdin_fd = {
   stdin_set_fd, stdin_handle_fd
 };
 /*---------------------------------------------------------------------------*/
+#if SELECT_EPOLL
+static int epoll_fd = -1;
+static int epoll_timer_fd = -1;
+/* The etimer expiration the timerfd is armed for, 0 if none */
+static clock_time_t epoll_timer_armed;
+/* What each fd is registered for. Fds that epoll does not support, such
+ * as regular files, are always ready */
+static uint32_t epoll_events[SELECT_MAX];
+static uint8_t epoll_always_ready[SELECT_MAX];
+/*---------------------------------------------------------------------------*/
+static void
+epoll_init(void)
+{
+  struct epoll_event ev;
+
+  epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  epoll_timer_fd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+  if(epoll_fd < 0 || epoll_timer_fd < 0) {
+    perror("epoll");
+    exit(1);
+  }
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.fd = epoll_timer_fd;
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, epoll_timer_fd, &ev);
+}
+/*---------------------------------------------------------------------------*/
+static void
+epoll_register(int fd, uint32_t events)
+{
+  struct epoll_event ev;
+  int op;
+  int ret;
+
+  memset(&ev, 0, sizeof(ev));
+  ev.events = events;
+  ev.data.fd = fd;
+  if(events == 0) {
+    op = EPOLL_CTL_DEL;
+  } else if(epoll_events[fd] == 0) {
+    op = EPOLL_CTL_ADD;
+  } else {
+    op = EPOLL_CTL_MOD;
+  }
+  ret = epoll_ctl(epoll_fd, op, fd, &ev);
+  if(ret < 0 && errno == ENOENT && op == EPOLL_CTL_MOD) {
+    /* Closing the fd took it out of the epoll set */
+    ret = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+  }
+  epoll_always_ready[fd] = ret < 0 && errno == EPERM && events != 0;
+  if(ret < 0 && op != EPOLL_CTL_DEL && !epoll_always_ready[fd]) {
+    perror("epoll_ctl");
+  }
+  epoll_events[fd] = events;
+}
+/*---------------------------------------------------------------------------*/
+static void
+epoll_set_timer(void)
+{
+  struct itimerspec its;
+  clock_time_t next;
+
+  next = etimer_next_expiration_time();
+  if(next == 0 || next == epoll_timer_armed) {
+    return;
+  }
+  /* clock_time() counts from the epoch, as CLOCK_REALTIME does */
+  memset(&its, 0, sizeof(its));
+  its.it_value.tv_sec = next / CLOCK_SECOND;
+  its.it_value.tv_nsec = (next % CLOCK_SECOND) * (1000000000L / CLOCK_SECOND);
+  if(timerfd_settime(epoll_timer_fd, TFD_TIMER_ABSTIME, &its, NULL) < 0) {
+    perror("timerfd_settime");
+  }
+  epoll_timer_armed = next;
+}
+/*---------------------------------------------------------------------------*/
+static void
+wait_fds(int busy)
+{
+  struct epoll_event events[SELECT_MAX + 1];
+  fd_set fdr;
+  fd_set fdw;
+  sigset_t mask;
+  sigset_t oldmask;
+  uint64_t expirations;
+  int timeout;
+  int i;
+  int n;
+
+  if(epoll_fd < 0) {
+    epoll_init();
+  }
+
+  FD_ZERO(&fdr);
+  FD_ZERO(&fdw);
+  for(i = 0; i <= select_max; i++) {
+    if(select_callback[i] != NULL) {
+      select_callback[i]->set_fd(&fdr, &fdw);
+    }
+  }
+
+  timeout = busy ? 0 : -1;
+  for(i = 0; i < SELECT_MAX; i++) {
+    uint32_t ev = (FD_ISSET(i, &fdr) ? EPOLLIN : 0)
+      | (FD_ISSET(i, &fdw) ? EPOLLOUT : 0);
+    if(ev != epoll_events[i]) {
+      epoll_register(i, ev);
+    }
+    if(ev != 0 && epoll_always_ready[i]) {
+      timeout = 0;
+    }
+  }
+  epoll_set_timer();
+
+  /* The rtimer runs from SIGALRM and may poll a process, keep it from
+     doing so between checking for events and going to sleep */
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGALRM);
+  sigprocmask(SIG_BLOCK, &mask, &oldmask);
+  if(process_nevents() > 0) {
+    timeout = 0;
+  }
+  n = epoll_pwait(epoll_fd, events, SELECT_MAX + 1, timeout, &oldmask);
+  sigprocmask(SIG_SETMASK, &oldmask, NULL);
+  if(n < 0) {
+    if(errno != EINTR) {
+      perror("epoll_wait");
+    }
+    n = 0;
+  }
+
+  FD_ZERO(&fdr);
+  FD_ZERO(&fdw);
+  for(i = 0; i < n; i++) {
+    int fd = events[i].data.fd;
+    if(fd == epoll_timer_fd) {
+      if(read(epoll_timer_fd, &expirations, sizeof(expirations)) > 0) {
+        epoll_timer_armed = 0;
+      }
+      continue;
+    }
+    if((events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+       && (epoll_events[fd] & EPOLLIN)) {
+      FD_SET(fd, &fdr);
+    }
+    if((events[i].events & (EPOLLOUT | EPOLLHUP | EPOLLERR))
+       && (epoll_events[fd] & EPOLLOUT)) {
+      FD_SET(fd, &fdw);
+    }
+  }
+  for(i = 0; i < SELECT_MAX; i++) {
+    if(epoll_always_ready[i]) {
+      if(epoll_events[i] & EPOLLIN) {
+        FD_SET(i, &fdr);
+      }
+      if(epoll_events[i] & EPOLLOUT) {
+        FD_SET(i, &fdw);
+      }
+    }
+  }
+  for(i = 0; i <= select_max; i++) {
+    if(select_callback[i] != NULL) {
+      select_callback[i]->handle_fd(&fdr, &fdw);
+    }
+  }
+}
+#else /* SELECT_EPOLL */
+/*---------------------------------------------------------------------------*/
+static void
+wait_fds(int busy)
+{
+  fd_set fdr;
+  fd_set fdw;
+  int maxfd;
+  int i;
+  int retval;
+  struct timeval tv;
+
+  tv.tv_sec = 0;
+  tv.tv_usec = busy ? 1 : 1000;
+
+  FD_ZERO(&fdr);
+  FD_ZERO(&fdw);
+  maxfd = 0;
+  for(i = 0; i <= select_max; i++) {
+    if(select_callback[i] != NULL && select_callback[i]->set_fd(&fdr, &fdw)) {
+      maxfd = i;
+    }
+  }
+
+  retval = select(maxfd + 1, &fdr, &fdw, NULL, &tv);
+  if(retval < 0) {
+    if(errno != EINTR) {
+      perror("select");
+    }
+  } else if(retval > 0) {
+    /* timeout => retval == 0 */
+    for(i = 0; i <= maxfd; i++) {
+      if(select_callback[i] != NULL) {
+        select_callback[i]->handle_fd(&fdr, &fdw);
+      }
+    }
+  }
+}
+#endif /* SELECT_EPOLL */
+/*---------------------------------------------------------------------------*/
 static void
 set_rime_addr(void)
 {
@@ -205,6 +429,9 @@ main(int argc, char **argv)
   process_start(&etimer_process, NULL);
   ctimer_init();
   rtimer_init();
+#if TRACE_ENABLED
+  trace_init();
+#endif /* TRACE_ENABLED */
 
 #if WITH_GUI
   process_start(&ctk_process, NULL);
@@ -251,40 +478,7 @@ main(int argc, char **argv)
 
   select_set_callback(STDIN_FILENO, &stdin_fd);
   while(1) {
-    fd_set fdr;
-    fd_set fdw;
-    int maxfd;
-    int i;
-    int retval;
-    struct timeval tv;
-
-    retval = process_run();
-
-    tv.tv_sec = 0;
-    tv.tv_usec = retval ? 1 : 1000;
-
-    FD_ZERO(&fdr);
-    FD_ZERO(&fdw);
-    maxfd = 0;
-    for(i = 0; i <= select_max; i++) {
-      if(select_callback[i] != NULL && select_callback[i]->set_fd(&fdr, &fdw)) {
-        maxfd = i;
-      }
-    }
-
-    retval = select(maxfd + 1, &fdr, &fdw, NULL, &tv);
-    if(retval < 0) {
-      if(errno != EINTR) {
-        perror("select");
-      }
-    } else if(retval > 0) {
-      /* timeout => retval == 0 */
-      for(i = 0; i <= maxfd; i++) {
-        if(select_callback[i] != NULL) {
-          select_callback[i]->handle_fd(&fdr, &fdw);
-        }
-      }
-    }
+    wait_fds(process_run());
 
     etimer_request_poll();
 
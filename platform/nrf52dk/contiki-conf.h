@@ -130,6 +130,9 @@
 #ifndef UIP_CONF_TCP_MSS
 #define UIP_CONF_TCP_MSS                    64
 #endif
+#ifndef UIP_CONF_CHKSUM_ACC32
+#define UIP_CONF_CHKSUM_ACC32                1
+#endif
 
 #define UIP_CONF_UDP                         1
 #define UIP_CONF_UDP_CHECKSUMS               1
@@ -145,6 +148,20 @@
 #ifndef ENERGEST_CONF_ON
 #define ENERGEST_CONF_ON                     1 /**< Energest Module */
 #endif
+
+#ifndef CRC16_CONF_TABLE
+#define CRC16_CONF_TABLE                     CRC16_TABLE_BYTE /**< Table-driven CRC16 */
+#endif
+/** @} */
+/*---------------------------------------------------------------------------*/
+/**
+ * \name Security
+ *
+ * @{
+ */
+#ifndef AES_128_CONF
+#define AES_128_CONF    nrf52832_aes_128_driver /**< AES-128 driver */
+#endif
 /** @} */
 #endif /* CONTIKI_CONF_H */
 /**
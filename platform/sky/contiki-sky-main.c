@@ -52,6 +52,7 @@
 #include "sys/node-id.h"
 #include "cfs-coffee-arch.h"
 #include "cfs/cfs-coffee.h"
+#include "sys/wakeup.h"
 #include "sys/autostart.h"
 
 #if UIP_CONF_ROUTER
@@ -423,8 +424,10 @@ main(int argc, char **argv)
      * Idle processing.
      */
     int s = splhigh();		/* Disable interrupts. */
+    rtimer_clock_t wakeup_time;
     /* uart1_active is for avoiding LPM3 when still sending or receiving */
-    if(process_nevents() != 0 || uart1_active()) {
+    if(process_nevents() != 0 || uart1_active()
+       || wakeup_next(&wakeup_time) == WAKEUP_NOW) {
       splx(s);			/* Re-enable interrupts. */
     } else {
       static unsigned long irq_energest = 0;
@@ -441,6 +444,9 @@ main(int argc, char **argv)
       }
 #endif
       
+      /* No clock tick is needed until the system needs the CPU again */
+      clock_arch_set_wakeup(wakeup_time);
+
       /* Re-enable interrupts and go to sleep atomically. */
       ENERGEST_SWITCH(ENERGEST_TYPE_CPU, ENERGEST_TYPE_LPM);
       /* We only want to measure the processing done in IRQs when we
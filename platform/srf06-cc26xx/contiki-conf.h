@@ -118,6 +118,11 @@
 #define CONTIKIMAC_CONF_SEND_SW_ACK               1
 #define CONTIKIMAC_CONF_AFTER_ACK_DETECTECT_WAIT_TIME (RTIMER_SECOND / 1000)
 #define CONTIKIMAC_CONF_INTER_PACKET_INTERVAL     (RTIMER_SECOND / 240)
+
+/* Per-PHY mode link statistics, used by prop mode link adaptation */
+#ifndef LINK_STATS_CONF_PHY_MODE
+#define LINK_STATS_CONF_PHY_MODE() packetbuf_attr(PACKETBUF_ATTR_PHY_MODE)
+#endif
 #else
 #define NETSTACK_CONF_RADIO        ieee_mode_driver
 
@@ -185,6 +190,20 @@
 #endif
 /** @} */
 /*---------------------------------------------------------------------------*/
+/**
+ * \name Security
+ *
+ * @{
+ */
+#ifndef CCM_STAR_CONF
+#define CCM_STAR_CONF  cc26xx_ccm_star_driver /**< AES-CCM* driver */
+#endif
+
+#ifndef AES_128_CONF_WITH_TTABLES
+#define AES_128_CONF_WITH_TTABLES            1 /**< Fast software AES-128 */
+#endif
+/** @} */
+/*---------------------------------------------------------------------------*/
 /** @} */
 /**
  * \name IPv6, RIME and network buffer configuration
@@ -237,6 +256,9 @@
 #ifndef UIP_CONF_TCP_MSS
 #define UIP_CONF_TCP_MSS                    64
 #endif
+#ifndef UIP_CONF_CHKSUM_ACC32
+#define UIP_CONF_CHKSUM_ACC32                1
+#endif
 
 #define UIP_CONF_UDP                         1
 #define UIP_CONF_UDP_CHECKSUMS               1
@@ -259,6 +281,10 @@
 #ifndef ENERGEST_CONF_ON
 #define ENERGEST_CONF_ON            0 /**< Energest Module */
 #endif
+
+#ifndef CRC16_CONF_TABLE
+#define CRC16_CONF_TABLE            CRC16_TABLE_BYTE /**< Table-driven CRC16 */
+#endif
 /** @} */
 /*---------------------------------------------------------------------------*/
 /**
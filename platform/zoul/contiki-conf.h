@@ -159,6 +159,10 @@ typedef uint32_t rtimer_clock_t;
 #define ENERGEST_CONF_ON            0 /**< Energest Module */
 #endif
 
+#ifndef CRC16_CONF_TABLE
+#define CRC16_CONF_TABLE            CRC16_TABLE_BYTE /**< Table-driven CRC16 */
+#endif
+
 #ifndef STARTUP_CONF_VERBOSE
 #define STARTUP_CONF_VERBOSE        1 /**< Set to 0 to decrease startup verbosity */
 #endif
@@ -476,6 +480,9 @@ typedef uint32_t rtimer_clock_t;
 #ifndef UIP_CONF_TCP_MSS
 #define UIP_CONF_TCP_MSS                    64
 #endif
+#ifndef UIP_CONF_CHKSUM_ACC32
+#define UIP_CONF_CHKSUM_ACC32                1
+#endif
 #define UIP_CONF_UDP                         1
 #define UIP_CONF_UDP_CHECKSUMS               1
 #define UIP_CONF_ICMP6                       1
@@ -568,6 +575,10 @@ typedef uint32_t rtimer_clock_t;
 #define AES_128_CONF            cc2538_aes_128_driver /**< AES-128 driver */
 #endif
 
+#ifndef CRYPTO_SERVICE_CONF
+#define CRYPTO_SERVICE_CONF     cc2538_crypto_service_driver /**< Crypto service driver */
+#endif
+
 #ifndef CCM_STAR_CONF
 #define CCM_STAR_CONF           cc2538_ccm_star_driver /**< AES-CCM* driver */
 #endif
@@ -0,0 +1,478 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \file
+ *         Microbenchmarks of the network stack, for the native platform.
+ *         Each benchmark runs one operation on a synthetic workload a
+ *         number of times, and prints its cost in nanoseconds and CPU
+ *         cycles per operation, and operations per second:
+ *
+ *         - 6LoWPAN output (IPHC compression) and input (decompression,
+ *           then delivery to a UDP socket)
+ *         - IPv6 route lookup, among BENCH_ROUTES routes
+ *         - neighbor table lookup, among BENCH_NEIGHBORS neighbors
+ *         - 802.15.4 frame parsing
+ *         - CCM* encryption and authentication of a frame
+ *         - CoAP message parsing
+ *
+ *         The native platform builds without optimization, build with
+ *         e.g. CFLAGS=-O2 in the environment to benchmark optimized code.
+ */
+
+#include "contiki.h"
+#include "contiki-net.h"
+#include "net/netstack.h"
+#include "net/packetbuf.h"
+#include "net/nbr-table.h"
+#include "net/ipv6/uip-ds6.h"
+#include "net/ipv6/uip-ds6-route.h"
+#include "net/mac/frame802154.h"
+#include "lib/ccm-star.h"
+#include "er-coap.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef BENCH_CONF_ITERATIONS
+#define BENCH_ITERATIONS BENCH_CONF_ITERATIONS
+#else /* BENCH_CONF_ITERATIONS */
+#define BENCH_ITERATIONS 100000
+#endif /* BENCH_CONF_ITERATIONS */
+
+/* Leave a few neighbor table entries to the stack */
+#define BENCH_NEIGHBORS (NBR_TABLE_MAX_NEIGHBORS - 4)
+#define BENCH_ROUTES    UIP_DS6_ROUTE_NB
+
+#define UDP_SRC_PORT    61617
+#define UDP_DEST_PORT   61618
+#define UDP_PAYLOAD_LEN 32
+
+static uip_lladdr_t nbr_lladdr[BENCH_NEIGHBORS];
+static uip_ipaddr_t nbr_ipaddr[BENCH_NEIGHBORS];
+static uip_ipaddr_t route_ipaddr[BENCH_ROUTES];
+
+/* The IPv6 packet sent, and the 6LoWPAN frame it was compressed into */
+static uint8_t ip_packet[UIP_IPUDPH_LEN + UDP_PAYLOAD_LEN];
+static uint8_t lowpan_frame[PACKETBUF_SIZE];
+static uint16_t lowpan_frame_len;
+static unsigned long delivered;
+
+static uint8_t mac_frame[127];
+static int mac_frame_len;
+
+static uint8_t ccm_nonce[CCM_STAR_NONCE_LENGTH];
+static uint8_t ccm_data[64];
+static uint8_t ccm_mic[8];
+
+static uint8_t coap_message[COAP_MAX_PACKET_SIZE];
+static size_t coap_message_len;
+
+/* Results checked once the benchmarks are done */
+static unsigned long failures;
+static volatile uintptr_t sink;
+
+PROCESS(benchmark_process, "Benchmark");
+PROCESS(udp_sink_process, "UDP sink");
+AUTOSTART_PROCESSES(&benchmark_process);
+/*---------------------------------------------------------------------------*/
+/* A MAC layer that keeps the frames it is given */
+static void
+bench_mac_send(mac_callback_t sent, void *ptr)
+{
+  lowpan_frame_len = packetbuf_datalen();
+  memcpy(lowpan_frame, packetbuf_dataptr(), lowpan_frame_len);
+  mac_call_sent_callback(sent, ptr, MAC_TX_OK, 1);
+}
+/*---------------------------------------------------------------------------*/
+static void
+bench_mac_input(void)
+{
+}
+/*---------------------------------------------------------------------------*/
+static int
+bench_mac_on(void)
+{
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+bench_mac_off(int keep_radio_on)
+{
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned short
+bench_mac_channel_check_interval(void)
+{
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+bench_mac_init(void)
+{
+}
+/*---------------------------------------------------------------------------*/
+const struct mac_driver bench_mac_driver = {
+  "bench",
+  bench_mac_init,
+  bench_mac_send,
+  bench_mac_input,
+  bench_mac_on,
+  bench_mac_off,
+  bench_mac_channel_check_interval,
+};
+/*---------------------------------------------------------------------------*/
+static uint64_t
+now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+/*---------------------------------------------------------------------------*/
+static uint64_t
+now_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __builtin_ia32_rdtsc();
+#else
+  return 0;
+#endif
+}
+/*---------------------------------------------------------------------------*/
+static void
+run(const char *name, void (*op)(unsigned i))
+{
+  uint64_t start_ns, ns, start_cycles, cycles;
+  unsigned i;
+
+  /* Warm up the caches */
+  for(i = 0; i < BENCH_ITERATIONS / 100; i++) {
+    op(i);
+  }
+
+  start_ns = now_ns();
+  start_cycles = now_cycles();
+  for(i = 0; i < BENCH_ITERATIONS; i++) {
+    op(i);
+  }
+  cycles = now_cycles() - start_cycles;
+  ns = now_ns() - start_ns;
+  if(ns == 0) {
+    ns = 1;
+  }
+
+  printf("bench %-26s %8lu ns/op %8lu cycles/op %10lu ops/s\n", name,
+         (unsigned long)(ns / BENCH_ITERATIONS),
+         (unsigned long)(cycles / BENCH_ITERATIONS),
+         (unsigned long)((uint64_t)BENCH_ITERATIONS * 1000000000 / ns));
+}
+/*---------------------------------------------------------------------------*/
+static void
+sicslowpan_output_op(unsigned i)
+{
+  memcpy(uip_buf, ip_packet, sizeof(ip_packet));
+  uip_len = sizeof(ip_packet);
+  uip_ext_len = 0;
+  tcpip_output(&nbr_lladdr[0]);
+}
+/*---------------------------------------------------------------------------*/
+static void
+sicslowpan_input_op(unsigned i)
+{
+  /* The frame sent to the first neighbor, as if that neighbor had sent
+     it to us. Swapping the addresses keeps the UDP checksum valid */
+  packetbuf_copyfrom(lowpan_frame, lowpan_frame_len);
+  packetbuf_set_addr(PACKETBUF_ADDR_SENDER, (linkaddr_t *)&nbr_lladdr[0]);
+  packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &linkaddr_node_addr);
+  NETSTACK_NETWORK.input();
+}
+/*---------------------------------------------------------------------------*/
+static void
+route_lookup_op(unsigned i)
+{
+  uip_ds6_route_t *r;
+
+  r = uip_ds6_route_lookup(&route_ipaddr[i % BENCH_ROUTES]);
+  if(r == NULL) {
+    failures++;
+  }
+  sink = (uintptr_t)r;
+}
+/*---------------------------------------------------------------------------*/
+static void
+route_lookup_miss_op(unsigned i)
+{
+  uip_ipaddr_t addr;
+
+  uip_ip6addr(&addr, 0xfd01, 0, 0, 0, 0, 0, 0, i);
+  sink = (uintptr_t)uip_ds6_route_lookup(&addr);
+}
+/*---------------------------------------------------------------------------*/
+static void
+nbr_lookup_op(unsigned i)
+{
+  nbr_table_item_t *item;
+
+  item = nbr_table_get_from_lladdr(ds6_neighbors,
+                                   (linkaddr_t *)&nbr_lladdr[i % BENCH_NEIGHBORS]);
+  if(item == NULL) {
+    failures++;
+  }
+  sink = (uintptr_t)item;
+}
+/*---------------------------------------------------------------------------*/
+static void
+frame802154_parse_op(unsigned i)
+{
+  frame802154_t frame;
+
+  if(frame802154_parse(mac_frame, mac_frame_len, &frame) == 0) {
+    failures++;
+  }
+  sink = (uintptr_t)frame.payload;
+}
+/*---------------------------------------------------------------------------*/
+static void
+ccm_star_op(unsigned i)
+{
+  /* An 802.15.4 header as authenticated data, and a 64-byte payload */
+  CCM_STAR.aead(ccm_nonce, ccm_data, sizeof(ccm_data), mac_frame, 21,
+                ccm_mic, sizeof(ccm_mic), 1);
+}
+/*---------------------------------------------------------------------------*/
+static void
+coap_parse_op(unsigned i)
+{
+  static coap_packet_t message[1];
+  static uint8_t buf[COAP_MAX_PACKET_SIZE + 1];
+
+  /* Parsing joins the Uri-Path segments in place, start from a copy */
+  memcpy(buf, coap_message, coap_message_len);
+  if(coap_parse_message(message, buf, coap_message_len) != NO_ERROR) {
+    failures++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+init_neighbors(void)
+{
+  int i;
+
+  for(i = 0; i < BENCH_NEIGHBORS; i++) {
+    memset(&nbr_lladdr[i], 0, sizeof(uip_lladdr_t));
+    nbr_lladdr[i].addr[0] = 0x02;
+    nbr_lladdr[i].addr[sizeof(uip_lladdr_t) - 2] = i >> 8;
+    nbr_lladdr[i].addr[sizeof(uip_lladdr_t) - 1] = i + 1;
+    uip_ip6addr(&nbr_ipaddr[i], 0xfe80, 0, 0, 0, 0, 0, 0, 0);
+    uip_ds6_set_addr_iid(&nbr_ipaddr[i], &nbr_lladdr[i]);
+    if(uip_ds6_nbr_add(&nbr_ipaddr[i], &nbr_lladdr[i], 1, NBR_REACHABLE,
+                       NBR_TABLE_REASON_UNDEFINED, NULL) == NULL) {
+      printf("Benchmark: could not add neighbor %d\n", i);
+      failures++;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+init_routes(void)
+{
+  int i;
+
+  for(i = 0; i < BENCH_ROUTES; i++) {
+    uip_ip6addr(&route_ipaddr[i], 0xfd00, 0, 0, 0, 0x0212, 0x4b00, 0, i + 1);
+    if(uip_ds6_route_add(&route_ipaddr[i], 128,
+                         &nbr_ipaddr[i % BENCH_NEIGHBORS]) == NULL) {
+      printf("Benchmark: could not add route %d\n", i);
+      failures++;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+init_ip_packet(void)
+{
+  uint16_t len = UIP_UDPH_LEN + UDP_PAYLOAD_LEN;
+
+  /* A link-local UDP packet to the first neighbor, which IPHC compresses
+     to a few bytes */
+  memset(uip_buf, 0, UIP_LLH_LEN + sizeof(ip_packet));
+  UIP_IP_BUF->vtc = 0x60;
+  UIP_IP_BUF->len[0] = len >> 8;
+  UIP_IP_BUF->len[1] = len & 0xff;
+  UIP_IP_BUF->proto = UIP_PROTO_UDP;
+  UIP_IP_BUF->ttl = 64;
+  uip_ipaddr_copy(&UIP_IP_BUF->srcipaddr, &uip_ds6_get_link_local(-1)->ipaddr);
+  uip_ipaddr_copy(&UIP_IP_BUF->destipaddr, &nbr_ipaddr[0]);
+  UIP_UDP_BUF->srcport = UIP_HTONS(UDP_SRC_PORT);
+  UIP_UDP_BUF->destport = UIP_HTONS(UDP_DEST_PORT);
+  UIP_UDP_BUF->udplen = UIP_HTONS(len);
+  memset((uint8_t *)UIP_UDP_BUF + UIP_UDPH_LEN, 'x', UDP_PAYLOAD_LEN);
+  uip_len = sizeof(ip_packet);
+  uip_ext_len = 0;
+  UIP_UDP_BUF->udpchksum = ~(uip_udpchksum());
+  if(UIP_UDP_BUF->udpchksum == 0) {
+    UIP_UDP_BUF->udpchksum = 0xffff;
+  }
+  memcpy(ip_packet, &uip_buf[UIP_LLH_LEN], sizeof(ip_packet));
+  uip_clear_buf();
+}
+/*---------------------------------------------------------------------------*/
+static void
+init_mac_frame(void)
+{
+  frame802154_t frame;
+  int hdr_len;
+
+  memset(&frame, 0, sizeof(frame));
+  frame.fcf.frame_type = FRAME802154_DATAFRAME;
+  frame.fcf.ack_required = 1;
+  frame.fcf.panid_compression = 1;
+  frame.fcf.dest_addr_mode = FRAME802154_LONGADDRMODE;
+  frame.fcf.src_addr_mode = FRAME802154_LONGADDRMODE;
+  frame.fcf.frame_version = FRAME802154_IEEE802154_2006;
+  frame.seq = 42;
+  frame.dest_pid = IEEE802154_PANID;
+  frame.src_pid = IEEE802154_PANID;
+  memcpy(frame.dest_addr, &nbr_lladdr[0], 8);
+  memcpy(frame.src_addr, &linkaddr_node_addr, 8);
+
+  hdr_len = frame802154_create(&frame, mac_frame);
+  memcpy(mac_frame + hdr_len, lowpan_frame, lowpan_frame_len);
+  mac_frame_len = hdr_len + lowpan_frame_len;
+}
+/*---------------------------------------------------------------------------*/
+static void
+init_ccm_star(void)
+{
+  static const uint8_t key[16] = {
+    0xc0, 0xc1, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7,
+    0xc8, 0xc9, 0xca, 0xcb, 0xcc, 0xcd, 0xce, 0xcf
+  };
+
+  CCM_STAR.set_key(key);
+  memcpy(ccm_nonce, &nbr_lladdr[0], 8);
+  ccm_nonce[12] = FRAME802154_SECURITY_LEVEL_ENC_MIC_64;
+  memset(ccm_data, 'x', sizeof(ccm_data));
+}
+/*---------------------------------------------------------------------------*/
+static void
+init_coap_message(void)
+{
+  static coap_packet_t message[1];
+  static const uint8_t token[] = { 0xde, 0xad, 0xbe, 0xef };
+  static const char payload[] = "mode=on&color=r";
+
+  /* A confirmable PUT to a resource */
+  coap_init_message(message, COAP_TYPE_CON, COAP_PUT, 0x1234);
+  coap_set_token(message, token, sizeof(token));
+  coap_set_header_uri_path(message, "actuators/leds");
+  coap_set_header_uri_query(message, "color=r");
+  coap_set_header_content_format(message, TEXT_PLAIN);
+  coap_set_payload(message, payload, sizeof(payload) - 1);
+  coap_message_len = coap_serialize_message(message, coap_message);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(udp_sink_process, ev, data)
+{
+  static struct uip_udp_conn *conn;
+
+  PROCESS_BEGIN();
+
+  conn = udp_new(NULL, 0, NULL);
+  udp_bind(conn, UIP_HTONS(UDP_DEST_PORT));
+
+  while(1) {
+    PROCESS_YIELD();
+    if(ev == tcpip_event && uip_newdata()) {
+      delivered++;
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(benchmark_process, ev, data)
+{
+  static struct etimer et;
+
+  PROCESS_BEGIN();
+
+  /* Let the stack come up */
+  etimer_set(&et, CLOCK_SECOND);
+  PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+
+  process_start(&udp_sink_process, NULL);
+  init_neighbors();
+  init_routes();
+  init_ip_packet();
+
+  printf("Benchmark: %u iterations, %u neighbors, %u routes\n",
+         BENCH_ITERATIONS, BENCH_NEIGHBORS, BENCH_ROUTES);
+
+  run("sicslowpan_output", sicslowpan_output_op);
+  printf("Benchmark: IPv6 packet of %u bytes, 6LoWPAN frame of %u bytes\n",
+         (unsigned)sizeof(ip_packet), lowpan_frame_len);
+  run("sicslowpan_input", sicslowpan_input_op);
+  if(delivered == 0) {
+    printf("Benchmark: no packet delivered to the UDP socket\n");
+    failures++;
+  }
+
+  run("uip_ds6_route_lookup", route_lookup_op);
+  run("uip_ds6_route_lookup_miss", route_lookup_miss_op);
+  run("nbr_table_get_from_lladdr", nbr_lookup_op);
+
+  init_mac_frame();
+  run("frame802154_parse", frame802154_parse_op);
+
+  init_ccm_star();
+  run("ccm_star_aead", ccm_star_op);
+
+  init_coap_message();
+  run("coap_parse_message", coap_parse_op);
+
+  if(failures > 0) {
+    printf("Benchmark: %lu failures\n", failures);
+    exit(1);
+  }
+  printf("Benchmark: done\n");
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \file
+ *         Node of the performance scenario. Logs "PERF joined <rank>" once
+ *         it has joined the DODAG, then sends a CoAP report to the root
+ *         every PERF_PERIOD seconds, logged as "PERF tx <sequence number>".
+ */
+
+#include "contiki.h"
+#include "lib/random.h"
+#include "net/ip/uip.h"
+#include "net/rpl/rpl.h"
+#include "sys/node-id.h"
+#include "er-coap.h"
+#include "rest-engine.h"
+
+#include <stdio.h>
+
+#ifdef PERF_CONF_PERIOD
+#define PERF_PERIOD (PERF_CONF_PERIOD * CLOCK_SECOND)
+#else /* PERF_CONF_PERIOD */
+#define PERF_PERIOD (60 * CLOCK_SECOND)
+#endif /* PERF_CONF_PERIOD */
+
+PROCESS(perf_node_process, "Performance node");
+AUTOSTART_PROCESSES(&perf_node_process);
+/*---------------------------------------------------------------------------*/
+static void
+send_report(uint16_t seqno)
+{
+  static coap_packet_t request[1];
+  static uint8_t packet[COAP_MAX_PACKET_SIZE + 1];
+  char payload[16];
+  rpl_dag_t *dag;
+  size_t len;
+
+  /* Logged even without a DODAG to send to, it counts as a loss */
+  printf("PERF tx %u\n", seqno);
+
+  dag = rpl_get_any_dag();
+  if(dag == NULL) {
+    return;
+  }
+
+  len = snprintf(payload, sizeof(payload), "%u %u", node_id, seqno);
+  coap_init_message(request, COAP_TYPE_NON, COAP_POST, coap_get_mid());
+  coap_set_header_uri_path(request, "perf");
+  coap_set_payload(request, payload, len);
+  len = coap_serialize_message(request, packet);
+  coap_send_message(&dag->dag_id, UIP_HTONS(COAP_DEFAULT_PORT), packet, len);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(perf_node_process, ev, data)
+{
+  static struct etimer periodic_timer;
+  static struct etimer send_timer;
+  static uint16_t seqno;
+  rpl_dag_t *dag;
+
+  PROCESS_BEGIN();
+
+  rest_init_engine();
+
+  /* Wait until we have joined the DODAG */
+  etimer_set(&periodic_timer, CLOCK_SECOND);
+  while(1) {
+    PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&periodic_timer));
+    dag = rpl_get_any_dag();
+    if(dag != NULL && dag->preferred_parent != NULL) {
+      printf("PERF joined %u\n", dag->rank);
+      break;
+    }
+    etimer_reset(&periodic_timer);
+  }
+
+  etimer_set(&periodic_timer, PERF_PERIOD);
+  while(1) {
+    PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&periodic_timer));
+    etimer_reset(&periodic_timer);
+    etimer_set(&send_timer, random_rand() % PERF_PERIOD);
+    PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&send_timer));
+    send_report(++seqno);
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
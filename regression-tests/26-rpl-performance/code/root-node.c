@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+
+/**
+ * \file
+ *         RPL root of the performance scenario. Logs the CoAP reports of
+ *         the nodes, as "PERF rx <node> <sequence number>".
+ */
+
+#include "contiki.h"
+#include "net/ip/uip.h"
+#include "net/ipv6/uip-ds6.h"
+#include "net/rpl/rpl.h"
+#include "rest-engine.h"
+
+#include <stdio.h>
+
+static void res_post_handler(void *request, void *response, uint8_t *buffer,
+                             uint16_t preferred_size, int32_t *offset);
+
+RESOURCE(res_perf, "title=\"Performance reports\"", NULL, res_post_handler,
+         NULL, NULL);
+
+PROCESS(root_node_process, "RPL root");
+AUTOSTART_PROCESSES(&root_node_process);
+/*---------------------------------------------------------------------------*/
+static void
+res_post_handler(void *request, void *response, uint8_t *buffer,
+                 uint16_t preferred_size, int32_t *offset)
+{
+  const uint8_t *payload;
+  int len;
+
+  len = REST.get_request_payload(request, &payload);
+  if(len > 0) {
+    printf("PERF rx %.*s\n", len, (const char *)payload);
+  }
+  REST.set_response_status(response, REST.status.CHANGED);
+}
+/*---------------------------------------------------------------------------*/
+static void
+create_rpl_dag(void)
+{
+  uip_ipaddr_t ipaddr;
+  uip_ipaddr_t prefix;
+  rpl_dag_t *dag;
+
+  uip_ip6addr(&ipaddr, UIP_DS6_DEFAULT_PREFIX, 0, 0, 0, 0, 0, 0, 0);
+  uip_ds6_set_addr_iid(&ipaddr, &uip_lladdr);
+  uip_ds6_addr_add(&ipaddr, 0, ADDR_AUTOCONF);
+
+  dag = rpl_set_root(RPL_DEFAULT_INSTANCE, &ipaddr);
+  if(dag != NULL) {
+    uip_ip6addr(&prefix, UIP_DS6_DEFAULT_PREFIX, 0, 0, 0, 0, 0, 0, 0);
+    rpl_set_prefix(dag, &prefix, 64);
+    printf("PERF root\n");
+  } else {
+    printf("PERF failed to create the RPL DAG\n");
+  }
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(root_node_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  create_rpl_dag();
+
+  rest_init_engine();
+  rest_activate_resource(&res_perf, "perf");
+
+  while(1) {
+    PROCESS_WAIT_EVENT();
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
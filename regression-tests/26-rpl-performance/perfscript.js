@@ -0,0 +1,168 @@
+/*
+ * Large-network performance scenario. The root is mote 1 of the
+ * simulation, the script adds the other nodes in a grid, runs the
+ * CoAP traffic for DURATION and writes the KPIs to
+ * rpl-performance-<nodes>.json:
+ *
+ * - convergence_s: when the last node joined the DODAG
+ * - pdr: packet delivery ratio of the reports
+ * - latency_ms_p50, _p90, _p99: end-to-end latency of the reports
+ * - duty_cycle_pct: average radio on time, from the PowerTracker
+ *
+ * If baseline-<nodes>.json exists (see "make baseline"), the test fails
+ * when a KPI is more than TOLERANCE worse than its baseline.
+ */
+TIMEOUT(86400000); /* The script ends the test itself */
+
+/* The number of nodes is in the title of the simulation */
+var NODES = parseInt(sim.getTitle().replace(/[^0-9]/g, ""));
+var DURATION = 1800000; /* ms */
+/* Reports sent less than this before the end are still in flight */
+var DRAIN = 30000; /* ms */
+var SPACING = 30.0; /* m, for a transmission range of 50 m */
+var TOLERANCE = 0.10;
+
+var REPORT = "rpl-performance-" + NODES + ".json";
+var BASELINE = "baseline-" + NODES + ".json";
+
+/* Lay the nodes out in a grid around the root */
+var side = Math.ceil(Math.sqrt(NODES));
+var center = Math.floor(NODES / 2);
+var nodeType = sim.getMoteType("perfnode");
+var k, m, pos;
+for(k = 0; k < NODES; k++) {
+  if(k == center) {
+    m = sim.getMoteWithID(1);
+  } else {
+    m = nodeType.generateMote(sim);
+    m.getInterfaces().getMoteID().setMoteID(k < center ? k + 2 : k + 1);
+    sim.addMote(m);
+  }
+  pos = m.getInterfaces().getPosition();
+  pos.setCoordinates((k % side) * SPACING, Math.floor(k / side) * SPACING, 0);
+}
+log.log("Running " + NODES + " nodes for " + DURATION / 1000 + " s\n");
+
+var joined = {};
+var nrJoined = 0;
+var lastJoin = 0;
+var sent = {};
+var nrSent = 0;
+var received = {};
+var nrReceived = 0;
+var latencies = [];
+var fields, key;
+
+GENERATE_MSG(DURATION, "perf-done");
+while(true) {
+  YIELD();
+  if(msg.equals("perf-done")) {
+    break;
+  }
+  if(!msg.startsWith("PERF ")) {
+    continue;
+  }
+  fields = msg.split(" ");
+  if(fields[1] == "joined") {
+    if(!(id in joined)) {
+      joined[id] = time;
+      nrJoined++;
+      lastJoin = time;
+    }
+  } else if(fields[1] == "tx") {
+    if(time <= (DURATION - DRAIN) * 1000) {
+      sent[id + ":" + fields[2]] = time;
+      nrSent++;
+    }
+  } else if(fields[1] == "rx") {
+    key = fields[2] + ":" + fields[3];
+    if((key in sent) && !(key in received)) {
+      received[key] = true;
+      nrReceived++;
+      latencies.push((time - sent[key]) / 1000.0);
+    }
+  }
+}
+
+function percentile(values, p) {
+  if(values.length == 0) {
+    return -1;
+  }
+  return values[Math.min(values.length - 1, Math.floor(values.length * p / 100))];
+}
+
+function dutyCycle() {
+  var tracker = gui.getPlugin("PowerTracker");
+  var stats, match;
+  if(tracker == null) {
+    return -1;
+  }
+  stats = "" + tracker.radioStatistics(true, false, true);
+  match = /AVG ON [0-9]+ us ([0-9.]+) %/.exec(stats);
+  return match == null ? -1 : parseFloat(match[1]);
+}
+
+latencies.sort(function(a, b) { return a - b; });
+var kpis = {
+  convergence_s: nrJoined == NODES - 1 ? lastJoin / 1000000.0 : -1,
+  pdr: nrSent > 0 ? nrReceived / nrSent : -1,
+  latency_ms_p50: percentile(latencies, 50),
+  latency_ms_p90: percentile(latencies, 90),
+  latency_ms_p99: percentile(latencies, 99),
+  duty_cycle_pct: dutyCycle()
+};
+/* Whether a higher value of the KPI is better */
+var higherIsBetter = { pdr: true };
+
+var json = "{\n  \"nodes\": " + NODES + ",\n  \"joined\": " + nrJoined +
+  ",\n  \"sent\": " + nrSent + ",\n  \"received\": " + nrReceived;
+for(key in kpis) {
+  json += ",\n  \"" + key + "\": " + kpis[key];
+}
+json += "\n}\n";
+log.writeFile(REPORT, json);
+log.log(json);
+
+var baseline = null;
+try {
+  baseline = "" + new java.lang.String(java.nio.file.Files.readAllBytes(
+    java.nio.file.Paths.get(BASELINE)));
+} catch(e) {
+  log.log("No " + BASELINE + ", not checking for regressions\n");
+}
+
+var regressions = 0;
+var match, base, value, worse;
+if(baseline != null) {
+  for(key in kpis) {
+    match = new RegExp("\"" + key + "\": (-?[0-9.eE+-]+)").exec(baseline);
+    if(match == null) {
+      continue;
+    }
+    base = parseFloat(match[1]);
+    value = kpis[key];
+    if(base < 0) {
+      continue;
+    }
+    if(value < 0) {
+      worse = true;
+    } else if(higherIsBetter[key]) {
+      worse = value < base * (1 - TOLERANCE);
+    } else {
+      worse = value > base * (1 + TOLERANCE);
+    }
+    if(worse) {
+      log.log("Regression: " + key + " " + value + ", baseline " + base + "\n");
+      regressions++;
+    }
+  }
+}
+
+if(nrJoined < NODES - 1) {
+  log.log("Only " + nrJoined + " of " + (NODES - 1) + " nodes joined\n");
+  log.testFailed();
+} else if(regressions > 0) {
+  log.testFailed();
+} else {
+  log.testOK();
+}
@@ -50,21 +50,185 @@
 /* Should be included from codeprop.h, but the include paths in the makefiles
    isn't set up for that. */
 #define HDR_SIZE 4
+#define FLAG_DELTA 0x0001
+
+/* The format of deltas is described in apps/codeprop/codeprop-delta.h */
+#define DELTA_VERSION 1
+#define DELTA_COPY    0x00
+#define DELTA_INSERT  0x01
+
+/* A copy is only worth it from this length: it costs five bytes, and
+   splits an insert that costs three */
+#define MIN_MATCH     8
+#define MAX_CANDIDATES 256
+#define HASH_SIZE     65536
+
+#define MAX_SIZE      65535
+
+/* Same as core/lib/crc16.c */
+static unsigned short
+crc16_data(const unsigned char *data, int len)
+{
+  unsigned short acc = 0;
+  int i;
+
+  for(i = 0; i < len; ++i) {
+    acc ^= data[i];
+    acc  = (acc >> 8) | (acc << 8);
+    acc ^= (acc & 0xff00) << 4;
+    acc ^= (acc >> 8) >> 4;
+    acc ^= (acc & 0xff00) >> 5;
+  }
+  return acc;
+}
+
+static int
+read_file(const char *name, unsigned char *buf)
+{
+  int fd, len, total;
+
+  if((fd = open(name, O_RDONLY)) < 0) {
+    perror(name);
+    exit(1);
+  }
+  total = 0;
+  while((len = read(fd, buf + total, MAX_SIZE + 1 - total)) > 0) {
+    total += len;
+  }
+  close(fd);
+  if(total > MAX_SIZE) {
+    fprintf(stderr, "%s: larger than %d bytes\n", name, MAX_SIZE);
+    exit(1);
+  }
+  return total;
+}
+
+static unsigned
+hash(const unsigned char *p)
+{
+  return ((p[0] << 8) ^ (p[1] << 5) ^ (p[2] << 2) ^ p[3]) & (HASH_SIZE - 1);
+}
+
+static unsigned char *
+put16(unsigned char *p, unsigned v)
+{
+  p[0] = v >> 8;
+  p[1] = v & 0xff;
+  return p + 2;
+}
+
+static unsigned char *
+put_insert(unsigned char *p, const unsigned char *data, int len)
+{
+  if(len > 0) {
+    *p++ = DELTA_INSERT;
+    p = put16(p, len);
+    memcpy(p, data, len);
+    p += len;
+  }
+  return p;
+}
+
+/* Describe new as copies from old and inserts, greedily taking the
+   longest match found through a hash of the next four bytes */
+static int
+make_delta(const unsigned char *old, int oldlen,
+           const unsigned char *new, int newlen, unsigned char *delta)
+{
+  static int head[HASH_SIZE];
+  static int next[MAX_SIZE + 1];
+  unsigned char *p = delta;
+  int i, j, literal;
+
+  *p++ = 'C';
+  *p++ = 'D';
+  *p++ = DELTA_VERSION;
+  *p++ = 0;
+  p = put16(p, oldlen);
+  p = put16(p, crc16_data(old, oldlen));
+  p = put16(p, newlen);
+  p = put16(p, crc16_data(new, newlen));
+
+  memset(head, -1, sizeof(head));
+  for(j = oldlen - 4; j >= 0; j--) {
+    next[j] = head[hash(&old[j])];
+    head[hash(&old[j])] = j;
+  }
+
+  literal = 0;
+  for(i = 0; i < newlen;) {
+    int best = 0, bestlen = 0, candidates = 0;
+
+    if(i + 4 <= newlen) {
+      for(j = head[hash(&new[i])]; j >= 0 && candidates < MAX_CANDIDATES;
+          j = next[j], candidates++) {
+        int n = 0;
+        while(i + n < newlen && j + n < oldlen && new[i + n] == old[j + n]) {
+          n++;
+        }
+        if(n > bestlen) {
+          best = j;
+          bestlen = n;
+        }
+      }
+    }
+    if(bestlen >= MIN_MATCH) {
+      p = put_insert(p, &new[literal], i - literal);
+      *p++ = DELTA_COPY;
+      p = put16(p, best);
+      p = put16(p, bestlen);
+      i += bestlen;
+      literal = i;
+    } else {
+      i++;
+    }
+  }
+  p = put_insert(p, &new[literal], i - literal);
+  return p - delta;
+}
 
 int
 main(int argc, char **argv) {
   struct sockaddr_in sa;
-  int s, port, fd;
+  int s, port;
   char *ip_addr;
-  int total = 0;
+  static unsigned char old[MAX_SIZE + 1], new[MAX_SIZE + 1];
+  static unsigned char buf[HDR_SIZE + 3 * (MAX_SIZE + 1)];
+  const char *oldname = NULL;
+  int len, flags = 0;
 
+  if(argc == 5 && strcmp(argv[1], "-d") == 0) {
+    oldname = argv[2];
+    argv += 2;
+    argc -= 2;
+  }
   if(argc != 3) {
-    printf("usage: %s ipaddress filename\n", argv[0]);
+    printf("usage: %s [-d oldfile] ipaddress filename\n", argv[0]);
     exit(1);
   }
   ip_addr = argv[1];
   port    = 6510;
 
+  len = read_file(argv[2], new);
+  if(oldname != NULL) {
+    int oldlen = read_file(oldname, old);
+    int newlen = len;
+
+    len = make_delta(old, oldlen, new, newlen, &buf[HDR_SIZE]);
+    if(len > MAX_SIZE) {
+      fprintf(stderr, "delta larger than %d bytes\n", MAX_SIZE);
+      exit(1);
+    }
+    printf("Delta of %d bytes for a module of %d bytes\n", len, newlen);
+    flags = FLAG_DELTA;
+  } else {
+    memcpy(&buf[HDR_SIZE], new, len);
+  }
+  buf[0] = len >> 8;
+  buf[1] = len & 0xff;
+  buf[2] = flags >> 8;
+  buf[3] = flags & 0xff;
+
   /* Create socket. */
   if((s = socket(AF_INET,SOCK_STREAM,0)) < 0){
     perror("Can't create socket");
@@ -75,7 +239,7 @@ main(int argc, char **argv) {
   bzero((char *) &sa, sizeof(sa));
   sa.sin_family = AF_INET;
   sa.sin_addr.s_addr = inet_addr(ip_addr);
-  sa.sin_port = uip_htons(port);
+  sa.sin_port = htons(port);
 
   /* Connect the socket to the remote host. */
   if(connect(s, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
@@ -88,47 +252,32 @@ main(int argc, char **argv) {
     exit(1);
   }
 
-  if((fd = open(argv[2], O_RDONLY)) < 0) {
-    perror("Could not open file");
+  if(write(s, buf, len + HDR_SIZE) == -1) {
+    perror("network send failed");
     exit(1);
   }
-  
-  
-  while(1) {
-    char buf[64000];
-    int len;
-    
-    len = read(fd, &buf[HDR_SIZE], sizeof(buf) - HDR_SIZE);
-    if(len == 0) {
-      printf("File successfully sent (%d bytes)\n", total);
-      len = read(s, buf, sizeof(buf));
-      buf[len] = 0;
-      printf("Reply: %s", buf);
-      if(buf[0] != 'o' || buf[1] != 'k') {
-	/* Cut and pasted from core/loader/elfloader.h */
-	printf("OK                  0\n"
-	       "BAD_HEADER          1\n"
-	       "NO_SYMTAB           2\n"
-	       "NO_STRTAB           3\n"
-	       "NO_TEXT             4\n"
-	       "UNDEFINED           5\n"
-	       "UNKNOWN_SEGMENT     6\n"
-	       "NO_STARTPOINT       7\n"
-	       "TEXT_TO_LARGE       8\n"
-	       "DATA_TO_LARGE       9\n"
-	       "UNKNOWN_RELOC      10\n"
-	       "MULTIPLY_DEFINED   11\n");
-      }
-      exit(0);
-    }
-    total += len;
-    buf[0] = len >> 8;
-    buf[1] = len & 0xff;
-    if(write(s, buf, len + HDR_SIZE) == -1) {
-      perror("network send failed");
-      exit(1);
-    }
+  printf("File successfully sent (%d bytes)\n", len);
+  len = read(s, buf, sizeof(buf) - 1);
+  if(len < 0) {
+    len = 0;
   }
-  
+  buf[len] = 0;
+  printf("Reply: %s", buf);
+  if(buf[0] != 'o' && buf[0] != 'O') {
+    /* Cut and pasted from core/loader/elfloader.h */
+    printf("OK                  0\n"
+           "BAD_HEADER          1\n"
+           "NO_SYMTAB           2\n"
+           "NO_STRTAB           3\n"
+           "NO_TEXT             4\n"
+           "UNDEFINED           5\n"
+           "UNKNOWN_SEGMENT     6\n"
+           "NO_STARTPOINT       7\n"
+           "TEXT_TO_LARGE       8\n"
+           "DATA_TO_LARGE       9\n"
+           "UNKNOWN_RELOC      10\n"
+           "MULTIPLY_DEFINED   11\n");
+  }
+
   return 0;
 }
@@ -0,0 +1,237 @@
+#!/usr/bin/env python3
+
+# Copyright (c) 2016, SICS Swedish ICT AB.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+# 3. Neither the name of the Institute nor the names of its contributors
+#    may be used to endorse or promote products derived from this software
+#    without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+# ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+# FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+# OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+# HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+# OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+# SUCH DAMAGE.
+#
+# This file is part of the Contiki operating system.
+
+# \file
+#         RAM and ROM used by each module of a firmware, and by the static
+#         arrays sized by configuration macros. Run through the %.budget
+#         target of Makefile.include:
+#
+#           make TARGET=sky hello-world.budget
+#
+#         The sizes are those of the symbols of the object files that
+#         went into the firmware. Initialized data counts as both RAM and
+#         ROM. Arrays are attributed to the macro that gives their first
+#         dimension, as found in their declaration (MEMB(), NBR_TABLE() or
+#         a plain array), and the macro is evaluated with the compiler
+#         flags of the build to show what one unit of it costs.
+
+import os
+import re
+import shlex
+import subprocess
+import sys
+from optparse import OptionParser
+
+ROM_TYPES = "tTrRwW"
+RAM_TYPES = "bBcCsSvV"
+DATA_TYPES = "dDgG"
+
+def nm(nm_cmd, path):
+    """The defined symbols of an object or firmware: (name, type, size)"""
+    out = subprocess.check_output(shlex.split(nm_cmd) +
+                                  ["-S", "-td", "--defined-only", path],
+                                  universal_newlines=True)
+    symbols = []
+    for line in out.splitlines():
+        fields = line.split()
+        if len(fields) == 4:
+            symbols.append((fields[3], fields[2], int(fields[1], 10)))
+        elif len(fields) == 3:
+            symbols.append((fields[2], fields[1], 0))
+    return symbols
+
+def source_of(obj):
+    """The source file of an object, from its dependency file"""
+    if obj.endswith(".co"):
+        return obj[:-3] + ".c"
+    dep = obj[:-2] + ".d"
+    try:
+        with open(dep) as f:
+            text = f.read().replace("\\\n", " ")
+    except IOError:
+        return None
+    prerequisites = text.split(":", 1)[1].split()
+    return prerequisites[0] if prerequisites else None
+
+def module_of(source, contiki):
+    """The directory of a source file, relative to Contiki if inside it"""
+    if source is None:
+        return "?"
+    directory = os.path.dirname(os.path.abspath(source))
+    contiki = os.path.abspath(contiki)
+    if directory.startswith(contiki + os.sep):
+        return os.path.relpath(directory, contiki)
+    return "(project)"
+
+def find_sizing(text, symbol):
+    """The macro expression giving the number of elements of a symbol"""
+    name = re.sub(r"\.\d+$", "", symbol)
+    m = re.match(r"(\w+)_memb_(mem|count|bitmap|sites)$", name)
+    if m:
+        d = re.search(r"\bMEMB(?:_BITMAP)?\s*\(\s*" + m.group(1) +
+                      r"\s*,[^,]+,\s*([^;]+?)\s*\)\s*;", text)
+        if d:
+            return d.group(1)
+    m = re.match(r"_(\w+)_mem$", name)
+    if m and re.search(r"\bNBR_TABLE(?:_GLOBAL)?\s*\([^,]+,\s*" +
+                       m.group(1) + r"\s*\)", text):
+        return "NBR_TABLE_MAX_NEIGHBORS"
+    d = re.search(r"\b" + re.escape(name) + r"\s*\[\s*([^\]]+?)\s*\]", text)
+    if d and re.search(r"[A-Z_][A-Z0-9_]{2,}", d.group(1)):
+        return d.group(1)
+    return None
+
+def evaluate(expression, defines, depth=0):
+    """The value of a macro expression, or None"""
+    if depth > 16:
+        return None
+    def substitute(m):
+        word = m.group(0)
+        if word in defines:
+            value = evaluate(defines[word], defines, depth + 1)
+            if value is None:
+                raise ValueError(word)
+            return "(%d)" % value
+        raise ValueError(word)
+    text = re.sub(r"\((?:unsigned|signed|const|u?int\d+_t|char|short|int|long|\s)+\)",
+                  "", expression)
+    text = re.sub(r"\b(0[xX][0-9a-fA-F]+|\d+)[uUlL]*\b", r"\1", text)
+    try:
+        text = re.sub(r"\b[A-Za-z_]\w*\b", substitute, text)
+        text = text.replace("/", "//")
+        if not re.match(r"^[\d\s()+\-*/%<>&|^~x]*$", text):
+            return None
+        return int(eval(text, {"__builtins__": {}}))
+    except (ValueError, SyntaxError, ZeroDivisionError, TypeError):
+        return None
+
+def macro_definitions(cc, source):
+    """The macros defined when compiling a source file"""
+    try:
+        out = subprocess.check_output(shlex.split(cc) + ["-E", "-dM", source],
+                                      universal_newlines=True,
+                                      stderr=open(os.devnull, "w"))
+    except (subprocess.CalledProcessError, OSError):
+        return {}
+    defines = {}
+    for line in out.splitlines():
+        m = re.match(r"#define (\w+) (.*)$", line)
+        if m:
+            defines[m.group(1)] = m.group(2).strip()
+    return defines
+
+def main():
+    parser = OptionParser(usage="%prog [options] firmware objects...")
+    parser.add_option("--nm", default="nm", help="nm of the toolchain")
+    parser.add_option("--cc", default=None,
+                      help="compiler and flags, to evaluate macros with")
+    parser.add_option("--contiki", default=".", help="Contiki directory")
+    parser.add_option("-f", "--files", action="store_true", default=False,
+                      help="break modules down into files")
+    parser.add_option("-m", "--min-size", type="int", default=16,
+                      help="smallest array to attribute to a macro")
+    (options, args) = parser.parse_args()
+    if len(args) < 2:
+        parser.error("a firmware and its objects are needed")
+
+    linked = set(name for (name, t, size) in nm(options.nm, args[0])
+                 if t.isupper())
+
+    modules = {}
+    knobs = {}
+    sources = {}
+    for obj in args[1:]:
+        if not os.path.exists(obj):
+            continue
+        symbols = nm(options.nm, obj)
+        # Objects of the library are only linked if they are needed
+        if not obj.endswith(".co") and \
+           not any(t.isupper() and name in linked for (name, t, size) in symbols):
+            continue
+        source = source_of(obj)
+        module = module_of(source, options.contiki)
+        if options.files:
+            module = os.path.join(module, os.path.basename(obj))
+        rom, ram = modules.get(module, (0, 0))
+        for (name, t, size) in symbols:
+            if t in ROM_TYPES:
+                rom += size
+            elif t in RAM_TYPES:
+                ram += size
+            elif t in DATA_TYPES:
+                rom += size
+                ram += size
+            if (t in RAM_TYPES or t in DATA_TYPES) and size >= options.min_size \
+               and source is not None:
+                if source not in sources:
+                    try:
+                        with open(source) as f:
+                            sources[source] = f.read()
+                    except IOError:
+                        sources[source] = ""
+                sizing = find_sizing(sources[source], name)
+                if sizing is not None:
+                    knobs.setdefault(sizing, []).append(
+                        (re.sub(r"\.\d+$", "", name), os.path.basename(source),
+                         size, source))
+        modules[module] = (rom, ram)
+
+    print("%-40s %8s %8s" % ("Module", "ROM", "RAM"))
+    total_rom = total_ram = 0
+    for module in sorted(modules, key=lambda m: -sum(modules[m])):
+        rom, ram = modules[module]
+        total_rom += rom
+        total_ram += ram
+        print("%-40s %8d %8d" % (module, rom, ram))
+    print("%-40s %8d %8d" % ("Total", total_rom, total_ram))
+
+    if not knobs:
+        return
+    print("")
+    print("%-40s %6s %8s %8s  %s" % ("Sized by", "Value", "RAM", "Per unit",
+                                     "Symbols"))
+    defines = {}
+    for sizing in sorted(knobs, key=lambda k: -sum(s[2] for s in knobs[k])):
+        users = knobs[sizing]
+        ram = sum(s[2] for s in users)
+        value = None
+        if options.cc is not None:
+            source = users[0][3]
+            if source not in defines:
+                defines[source] = macro_definitions(options.cc, source)
+            value = evaluate(sizing, defines[source])
+        print("%-40s %6s %8d %8s  %s" %
+              (sizing, value if value is not None else "?", ram,
+               ram // value if value else "?",
+               ", ".join("%s (%s)" % (s[0], s[1]) for s in users)))
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT AB.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Decodes the binary trace of core/sys/trace.c. Reads the console
+ *         output of a node on stdin, and prints its trace records as
+ *         text, along with the rest of the output.
+ *
+ *         Usage: ./hello-world.native | trace-decode
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../core/sys/trace-events.h"
+
+#define SLIP_END     0300
+#define SLIP_ESC     0333
+#define SLIP_ESC_END 0334
+#define SLIP_ESC_ESC 0335
+#define FRAME_RECORD 'T'
+#define FRAME_LEN    11
+
+#define TRACE_EVENT_ENUM(name, id, arg0, arg1) TRACE_##name = id,
+enum {
+  TRACE_EVENTS(TRACE_EVENT_ENUM)
+};
+
+#define TRACE_EVENT_DESC(name, id, arg0, arg1) { id, #name, { arg0, arg1 } },
+static const struct event_desc {
+  uint16_t id;
+  const char *name;
+  const char *arg[2];
+} events[] = {
+  TRACE_EVENTS(TRACE_EVENT_DESC)
+};
+
+/* Ticks per second, and width of the timestamps, from the first records */
+static uint32_t rtimer_second;
+static int clock_bits = 32;
+static uint32_t last_time;
+static uint64_t ticks;
+static int started;
+/*---------------------------------------------------------------------------*/
+static const struct event_desc *
+find_event(uint16_t id)
+{
+  size_t i;
+
+  for(i = 0; i < sizeof(events) / sizeof(events[0]); i++) {
+    if(events[i].id == id) {
+      return &events[i];
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+get_u16(const uint8_t *p)
+{
+  return p[0] | p[1] << 8;
+}
+/*---------------------------------------------------------------------------*/
+static void
+decode(const uint8_t *frame, int len)
+{
+  const struct event_desc *e;
+  uint32_t time, mask;
+  uint16_t id, arg0, arg1;
+
+  if(len != FRAME_LEN || frame[0] != FRAME_RECORD) {
+    printf("trace: bad frame (%d bytes)\n", len);
+    return;
+  }
+  time = get_u16(&frame[1]) | (uint32_t)get_u16(&frame[3]) << 16;
+  id = get_u16(&frame[5]);
+  arg0 = get_u16(&frame[7]);
+  arg1 = get_u16(&frame[9]);
+
+  if(id == TRACE_START) {
+    /* The node restarted */
+    rtimer_second = arg0 | (uint32_t)arg1 << 16;
+    clock_bits = 32;
+    started = 0;
+  } else if(id == TRACE_CLOCK_BITS && arg0 > 0 && arg0 <= 32) {
+    clock_bits = arg0;
+  }
+
+  /* Timestamps wrap around, keep counting past them */
+  mask = clock_bits < 32 ? (1UL << clock_bits) - 1 : 0xffffffff;
+  if(started) {
+    ticks += (time - last_time) & mask;
+  } else {
+    ticks = 0;
+    started = 1;
+  }
+  last_time = time;
+
+  if(rtimer_second != 0) {
+    printf("%12.6f ", (double)ticks / rtimer_second);
+  } else {
+    printf("%12lu ", (unsigned long)time);
+  }
+  e = find_event(id);
+  if(e == NULL) {
+    printf("event 0x%04x %u %u\n", id, arg0, arg1);
+  } else if(e->arg[1][0] == '\0') {
+    printf("%-18s %s %u\n", e->name, e->arg[0], arg0);
+  } else {
+    printf("%-18s %s %u, %s %u\n", e->name, e->arg[0], arg0, e->arg[1], arg1);
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+main(int argc, char **argv)
+{
+  uint8_t frame[FRAME_LEN + 1];
+  int in_frame = 0;
+  int escaped = 0;
+  int len = 0;
+  int c;
+
+  while((c = getchar()) != EOF) {
+    if(!in_frame) {
+      if(c == SLIP_END) {
+        in_frame = 1;
+        escaped = 0;
+        len = 0;
+      } else {
+        putchar(c);
+      }
+      continue;
+    }
+    if(c == SLIP_END) {
+      if(len > 0) {
+        decode(frame, len);
+        fflush(stdout);
+        in_frame = 0;
+      }
+      continue;
+    }
+    if(escaped) {
+      c = c == SLIP_ESC_END ? SLIP_END : c == SLIP_ESC_ESC ? SLIP_ESC : c;
+      escaped = 0;
+    } else if(c == SLIP_ESC) {
+      escaped = 1;
+      continue;
+    }
+    if(len < (int)sizeof(frame)) {
+      frame[len] = c;
+    }
+    len++;
+  }
+  return 0;
+}
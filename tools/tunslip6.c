@@ -70,13 +70,15 @@ int slipfd = 0;
 uint16_t basedelay=0,delaymsec=0;
 uint32_t startsec,startmsec,delaystartsec,delaystartmsec;
 int timestamp = 0, flowcontrol=0, showprogress=0, flowcontrol_xonxoff=0;
+/* Append a sequence number and a CRC-16 to the frames we send */
+int crcframes = 0;
 
 int ssystem(const char *fmt, ...)
      __attribute__((__format__ (__printf__, 1, 2)));
 void write_to_serial(int outfd, void *inbuf, int len);
 
 void slip_send(int fd, unsigned char c);
-void slip_send_char(int fd, unsigned char c);
+void slip_send_frame(int fd, const unsigned char *p, int len);
 
 #define PROGRESS(s) if(showprogress) fprintf(stderr, s)
 
@@ -86,6 +88,14 @@ char tundev[1024] = { "" };
 #define MIN_DEVMTU 1500
 int devmtu = MIN_DEVMTU;
 
+/* Largest packet read from tun or serial */
+#define MAX_PACKET 2000
+/* Largest packet after SLIP escaping, with the sequence number, CRC and
+   the two SLIP_END */
+#define MAX_FRAME (2 * (MAX_PACKET + 3) + 2)
+/* Frames queued for serial output, written out together */
+#define SLIP_BUFSIZE (16 * MAX_FRAME)
+
 int
 ssystem(const char *fmt, ...) __attribute__((__format__ (__printf__, 1, 2)));
 
@@ -172,7 +182,7 @@ void
 serial_to_tun(FILE *inslip, int outfd)
 {
   static union {
-    unsigned char inbuf[2000];
+    unsigned char inbuf[MAX_PACKET];
   } uip;
   static int inbufptr = 0;
   int ret,i;
@@ -238,19 +248,17 @@ serial_to_tun(FILE *inslip, int outfd)
 	  }
           inet_pton(AF_INET6, ipaddr, &addr);
           if(timestamp) stamptime();
+          unsigned char prefix[10];
           fprintf(stderr,"*** Address:%s => %02x%02x:%02x%02x:%02x%02x:%02x%02x\n",
 		 ipaddr,
 		 addr.s6_addr[0], addr.s6_addr[1],
 		 addr.s6_addr[2], addr.s6_addr[3],
 		 addr.s6_addr[4], addr.s6_addr[5],
 		 addr.s6_addr[6], addr.s6_addr[7]);
-	  slip_send(slipfd, '!');
-	  slip_send(slipfd, 'P');
-	  for(i = 0; i < 8; i++) {
-	    /* need to call the slip_send_char for stuffing */
-	    slip_send_char(slipfd, addr.s6_addr[i]);
-	  }
-	  slip_send(slipfd, SLIP_END);
+	  prefix[0] = '!';
+	  prefix[1] = 'P';
+	  memcpy(prefix + 2, addr.s6_addr, 8);
+	  slip_send_frame(slipfd, prefix, sizeof(prefix));
         }
 #define DEBUG_LINE_MARKER '\r'
       } else if(uip.inbuf[0] == DEBUG_LINE_MARKER) {
@@ -336,51 +344,112 @@ serial_to_tun(FILE *inslip, int outfd)
   goto read_more;
 }
 
-unsigned char slip_buf[2000];
+unsigned char slip_buf[SLIP_BUFSIZE];
 int slip_end, slip_begin;
+unsigned char slip_seqno;
 
 void
-slip_send_char(int fd, unsigned char c)
+slip_send(int fd, unsigned char c)
 {
-  switch(c) {
-  case SLIP_END:
-    slip_send(fd, SLIP_ESC);
-    slip_send(fd, SLIP_ESC_END);
-    break;
-  case SLIP_ESC:
-    slip_send(fd, SLIP_ESC);
-    slip_send(fd, SLIP_ESC_ESC);
-    break;
-  case XON:
-    if(flowcontrol_xonxoff) {
-      slip_send(fd, SLIP_ESC);
-      slip_send(fd, SLIP_ESC_XON);
-    } else {
-      slip_send(fd, c);
-    }
-    break;
-  case XOFF:
-    if(flowcontrol_xonxoff) {
-      slip_send(fd, SLIP_ESC);
-      slip_send(fd, SLIP_ESC_XOFF);
-    } else {
-      slip_send(fd, c);
+  if(slip_end >= sizeof(slip_buf)) {
+    err(1, "slip_send overflow");
+  }
+  slip_buf[slip_end] = c;
+  slip_end++;
+}
+
+/* Room left for frames, after moving queued data to the front */
+int
+slip_room(void)
+{
+  if(slip_begin > 0) {
+    memmove(slip_buf, slip_buf + slip_begin, slip_end - slip_begin);
+    slip_end -= slip_begin;
+    slip_begin = 0;
+  }
+  return sizeof(slip_buf) - slip_end;
+}
+
+/* SLIP escape len bytes to out, return the number of bytes written */
+static int
+slip_escape(unsigned char *out, const unsigned char *p, int len)
+{
+  unsigned char *o = out;
+  int i;
+
+  for(i = 0; i < len; i++) {
+    switch(p[i]) {
+    case SLIP_END:
+      *o++ = SLIP_ESC;
+      *o++ = SLIP_ESC_END;
+      break;
+    case SLIP_ESC:
+      *o++ = SLIP_ESC;
+      *o++ = SLIP_ESC_ESC;
+      break;
+    case XON:
+      if(flowcontrol_xonxoff) {
+        *o++ = SLIP_ESC;
+        *o++ = SLIP_ESC_XON;
+      } else {
+        *o++ = p[i];
+      }
+      break;
+    case XOFF:
+      if(flowcontrol_xonxoff) {
+        *o++ = SLIP_ESC;
+        *o++ = SLIP_ESC_XOFF;
+      } else {
+        *o++ = p[i];
+      }
+      break;
+    default:
+      *o++ = p[i];
+      break;
     }
-    break;
-  default:
-    slip_send(fd, c);
-    break;
   }
+  return o - out;
+}
+
+/* Same CRC-16 as crc16_data() in core/lib/crc16.c */
+static unsigned short
+crc16(const unsigned char *p, int len, unsigned short acc)
+{
+  int i;
+
+  for(i = 0; i < len; i++) {
+    acc ^= p[i];
+    acc = (acc >> 8) | (acc << 8);
+    acc ^= (acc & 0xff00) << 4;
+    acc ^= (acc >> 8) >> 4;
+    acc ^= (acc & 0xff00) >> 5;
+  }
+  return acc;
 }
 
+/*
+ * Queue a frame for serial output, escaped in one go. With -C the
+ * frame ends with a sequence number and a CRC-16 of the frame and the
+ * sequence number, both checked by a mote built with SLIP_CONF_WITH_CRC.
+ */
 void
-slip_send(int fd, unsigned char c)
+slip_send_frame(int fd, const unsigned char *p, int len)
 {
-  if(slip_end >= sizeof(slip_buf)) {
-    err(1, "slip_send overflow");
+  unsigned char trailer[3];
+  unsigned short crc;
+
+  if(len > MAX_PACKET || slip_room() < MAX_FRAME) {
+    err(1, "slip_send_frame overflow");
   }
-  slip_buf[slip_end] = c;
-  slip_end++;
+  slip_end += slip_escape(slip_buf + slip_end, p, len);
+  if(crcframes) {
+    trailer[0] = slip_seqno++;
+    crc = crc16(trailer, 1, crc16(p, len, 0));
+    trailer[1] = crc & 0xff;
+    trailer[2] = crc >> 8;
+    slip_end += slip_escape(slip_buf + slip_end, trailer, sizeof(trailer));
+  }
+  slip_buf[slip_end++] = SLIP_END;
 }
 
 int
@@ -440,59 +509,33 @@ write_to_serial(int outfd, void *inbuf, int len)
   /* It would be ``nice'' to send a SLIP_END here but it's not
    * really necessary.
    */
-  /* slip_send(outfd, SLIP_END); */
-
-  for(i = 0; i < len; i++) {
-    switch(p[i]) {
-    case SLIP_END:
-      slip_send(outfd, SLIP_ESC);
-      slip_send(outfd, SLIP_ESC_END);
-      break;
-    case SLIP_ESC:
-      slip_send(outfd, SLIP_ESC);
-      slip_send(outfd, SLIP_ESC_ESC);
-      break;
-    case XON:
-      if(flowcontrol_xonxoff) {
-        slip_send(outfd, SLIP_ESC);
-        slip_send(outfd, SLIP_ESC_XON);
-      } else {
-        slip_send(outfd, p[i]);
-      }
-      break;
-    case XOFF:
-      if(flowcontrol_xonxoff) {
-        slip_send(outfd, SLIP_ESC);
-        slip_send(outfd, SLIP_ESC_XOFF);
-      } else {
-        slip_send(outfd, p[i]);
-      }
-      break;
-    default:
-      slip_send(outfd, p[i]);
-      break;
-    }
-  }
-  slip_send(outfd, SLIP_END);
+  slip_send_frame(outfd, p, len);
   PROGRESS("t");
 }
 
 
 /*
- * Read from tun, write to slip.
+ * Read from tun, write to slip. Reads up to max packets while they fit
+ * the output buffer, so that they can go out in a single write.
  */
 int
-tun_to_serial(int infd, int outfd)
+tun_to_serial(int infd, int outfd, int max)
 {
   struct {
-    unsigned char inbuf[2000];
+    unsigned char inbuf[MAX_PACKET];
   } uip;
-  int size;
-
-  if((size = read(infd, uip.inbuf, 2000)) == -1) err(1, "tun_to_serial: read");
+  int size, n;
 
-  write_to_serial(outfd, uip.inbuf, size);
-  return size;
+  for(n = 0; n < max && slip_room() >= MAX_FRAME; n++) {
+    if((size = read(infd, uip.inbuf, sizeof(uip.inbuf))) == -1) {
+      if(n > 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        break;
+      }
+      err(1, "tun_to_serial: read");
+    }
+    write_to_serial(outfd, uip.inbuf, size);
+  }
+  return n;
 }
 
 void
@@ -762,7 +805,7 @@ main(int argc, char **argv)
   prog = argv[0];
   setvbuf(stdout, NULL, _IOLBF, 0); /* Line buffered output. */
 
-  while((c = getopt(argc, argv, "B:HILPhXM:s:t:v::d::a:p:T")) != -1) {
+  while((c = getopt(argc, argv, "B:CHILPhXM:s:t:v::d::a:p:T")) != -1) {
     switch(c) {
     case 'B':
       baudrate = atoi(optarg);
@@ -833,6 +876,10 @@ main(int argc, char **argv)
       tap = 1;
       break;
 
+    case 'C':
+      crcframes = 1;
+      break;
+
     case '?':
     case 'h':
     default:
@@ -844,6 +891,8 @@ fprintf(stderr," -B baudrate    9600,19200,38400,57600,115200 (default),230400,4
 #else
 fprintf(stderr," -B baudrate    9600,19200,38400,57600,115200 (default),230400\n");
 #endif
+fprintf(stderr," -C             Sequence number and CRC-16 on frames to the mote\n");
+fprintf(stderr,"                (mote built with SLIP_CONF_WITH_CRC)\n");
 fprintf(stderr," -H             Hardware CTS/RTS flow control (default disabled)\n");
 fprintf(stderr," -I             Inquire IP address\n");
 fprintf(stderr," -X             Software XON/XOFF flow control (default disabled)\n");
@@ -873,7 +922,7 @@ exit(1);
   argv += (optind - 1);
 
   if(argc != 2 && argc != 3) {
-    err(1, "usage: %s [-B baudrate] [-H] [-L] [-s siodev] [-t tundev] [-T] [-v verbosity] [-d delay] [-a serveraddress] [-p serverport] ipaddress", prog);
+    err(1, "usage: %s [-B baudrate] [-C] [-H] [-L] [-s siodev] [-t tundev] [-T] [-v verbosity] [-d delay] [-a serveraddress] [-p serverport] ipaddress", prog);
   }
   ipaddr = argv[1];
 
@@ -962,6 +1011,7 @@ exit(1);
 
   tunfd = tun_alloc(tundev, tap);
   if(tunfd == -1) err(1, "main: open /dev/tun");
+  fcntl(tunfd, F_SETFL, fcntl(tunfd, F_GETFL) | O_NONBLOCK);
   if (timestamp) stamptime();
   fprintf(stderr, "opened %s device ``/dev/%s''\n",
           tap ? "tap" : "tun", tundev);
@@ -980,11 +1030,7 @@ exit(1);
 
     if(got_sigalarm && ipa_enable) {
       /* Send "?IPA". */
-      slip_send(slipfd, '?');
-      slip_send(slipfd, 'I');
-      slip_send(slipfd, 'P');
-      slip_send(slipfd, 'A');
-      slip_send(slipfd, SLIP_END);
+      slip_send_frame(slipfd, (const unsigned char *)"?IPA", 4);
       got_sigalarm = 0;
     }
 
@@ -995,8 +1041,9 @@ exit(1);
     FD_SET(slipfd, &rset);	/* Read from slip ASAP! */
     if(slipfd > maxfd) maxfd = slipfd;
 
-    /* We only have one packet at a time queued for slip output. */
-    if(slip_empty()) {
+    /* Queue packets for slip output while they fit, one at a time
+       when delaying between packets. */
+    if(basedelay ? slip_empty() : slip_room() >= MAX_FRAME) {
       FD_SET(tunfd, &rset);
       if(tunfd > maxfd) maxfd = tunfd;
     }
@@ -1025,9 +1072,8 @@ exit(1);
        if(dmsec>delaymsec) delaymsec=0;
       }
       if(delaymsec==0) {
-        int size;
-        if(slip_empty() && FD_ISSET(tunfd, &rset)) {
-          size=tun_to_serial(tunfd, slipfd);
+        if(FD_ISSET(tunfd, &rset)) {
+          tun_to_serial(tunfd, slipfd, basedelay ? 1 : SLIP_BUFSIZE / MAX_FRAME);
           slip_flushbuf(slipfd);
           if(ipa_enable) sigalarm_reset();
           if(basedelay) {